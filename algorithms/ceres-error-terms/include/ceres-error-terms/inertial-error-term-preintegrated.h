@@ -0,0 +1,142 @@
+#ifndef CERES_ERROR_TERMS_INERTIAL_ERROR_TERM_PREINTEGRATED_H_
+#define CERES_ERROR_TERMS_INERTIAL_ERROR_TERM_PREINTEGRATED_H_
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <ceres/sized_cost_function.h>
+#include <glog/logging.h>
+#include <imu-integrator/common.h>
+
+#include <ceres-error-terms/common.h>
+
+namespace ceres_error_terms {
+
+// IMU measurements between two keyframes preintegrated in the IMU frame of
+// the first keyframe, together with the first-order Jacobians w.r.t. the
+// biases used for the integration.
+struct ImuPreintegration {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double, imu_integrator::kErrorStateSize,
+                        imu_integrator::kErrorStateSize>
+      ErrorStateMatrix;
+
+  ImuPreintegration() : delta_time_seconds(0.0), valid(false) {}
+
+  // Biases the measurements were integrated with.
+  Eigen::Vector3d b_g;
+  Eigen::Vector3d b_a;
+
+  // Rotation, velocity and position increments expressed in the IMU frame
+  // of the first keyframe.
+  Eigen::Matrix3d delta_R;
+  Eigen::Vector3d delta_v;
+  Eigen::Vector3d delta_p;
+  double delta_time_seconds;
+
+  Eigen::Matrix3d J_delta_R_wrt_b_g;
+  Eigen::Matrix3d J_delta_v_wrt_b_g;
+  Eigen::Matrix3d J_delta_v_wrt_b_a;
+  Eigen::Matrix3d J_delta_p_wrt_b_g;
+  Eigen::Matrix3d J_delta_p_wrt_b_a;
+
+  // Covariance of the increments and bias changes, in the error state order
+  // of the imu integrator.
+  ErrorStateMatrix covariance;
+  Eigen::LLT<ErrorStateMatrix> L_cholesky_covariance;
+
+  bool valid;
+};
+
+// On-manifold preintegration alternative to InertialErrorTerm, see Forster et
+// al., "On-Manifold Preintegration for Real-Time Visual-Inertial Odometry".
+// The IMU measurements are integrated once; changes of the bias of the first
+// keyframe are applied as first-order correction as long as they stay below
+// the given thresholds, beyond that the measurements are integrated again.
+// The parameter blocks are the same as for InertialErrorTerm.
+//
+// Note: this error term accepts rotations expressed as quaternions
+// in JPL convention [x, y, z, w]. This convention corresponds to the internal
+// coefficient storage of Eigen so you can directly pass pointer to your
+// Eigen quaternion data, e.g. your_eigen_quaternion.coeffs().data().
+class PreintegratedInertialErrorTerm
+    : public ceres::SizedCostFunction<imu_integrator::kErrorStateSize,
+                                      imu_integrator::kStatePoseBlockSize,
+                                      imu_integrator::kGyroBiasBlockSize,
+                                      imu_integrator::kVelocityBlockSize,
+                                      imu_integrator::kAccelBiasBlockSize,
+                                      imu_integrator::kStatePoseBlockSize,
+                                      imu_integrator::kGyroBiasBlockSize,
+                                      imu_integrator::kVelocityBlockSize,
+                                      imu_integrator::kAccelBiasBlockSize> {
+ public:
+  static constexpr double kDefaultGyroBiasReintegrationThreshold = 1e-2;
+  static constexpr double kDefaultAccelBiasReintegrationThreshold = 1e-1;
+
+  PreintegratedInertialErrorTerm(
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+      double gyro_noise_sigma, double gyro_bias_sigma, double acc_noise_sigma,
+      double acc_bias_sigma, double gravity_magnitude,
+      double gyro_bias_reintegration_threshold =
+          kDefaultGyroBiasReintegrationThreshold,
+      double accel_bias_reintegration_threshold =
+          kDefaultAccelBiasReintegrationThreshold)
+      : imu_timestamps_(imu_timestamps),
+        imu_data_(imu_data),
+        gyro_noise_sigma_squared_(gyro_noise_sigma * gyro_noise_sigma),
+        gyro_bias_sigma_squared_(gyro_bias_sigma * gyro_bias_sigma),
+        acc_noise_sigma_squared_(acc_noise_sigma * acc_noise_sigma),
+        acc_bias_sigma_squared_(acc_bias_sigma * acc_bias_sigma),
+        gravity_magnitude_(gravity_magnitude),
+        gyro_bias_reintegration_threshold_(gyro_bias_reintegration_threshold),
+        accel_bias_reintegration_threshold_(
+            accel_bias_reintegration_threshold),
+        num_integrations_(0u) {
+    CHECK_GT(imu_data.cols(), 0);
+    CHECK_EQ(imu_data.cols(), imu_timestamps.cols());
+
+    CHECK_GT(gyro_noise_sigma, 0.0);
+    CHECK_GT(gyro_bias_sigma, 0.0);
+    CHECK_GT(acc_noise_sigma, 0.0);
+    CHECK_GT(acc_bias_sigma, 0.0);
+    CHECK_GE(gyro_bias_reintegration_threshold, 0.0);
+    CHECK_GE(accel_bias_reintegration_threshold, 0.0);
+  }
+
+  virtual ~PreintegratedInertialErrorTerm() {}
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals_ptr,
+      double** jacobians) const;
+
+  // Number of times the IMU measurements have been integrated so far.
+  size_t getNumIntegrations() const {
+    return num_integrations_;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  void integrate(
+      const Eigen::Vector3d& b_g, const Eigen::Vector3d& b_a,
+      ImuPreintegration* preintegration) const;
+
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps_;
+  const Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data_;
+
+  const double gyro_noise_sigma_squared_;
+  const double gyro_bias_sigma_squared_;
+  const double acc_noise_sigma_squared_;
+  const double acc_bias_sigma_squared_;
+  const double gravity_magnitude_;
+
+  const double gyro_bias_reintegration_threshold_;
+  const double accel_bias_reintegration_threshold_;
+
+  mutable ImuPreintegration preintegration_;
+  mutable size_t num_integrations_;
+};
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_INERTIAL_ERROR_TERM_PREINTEGRATED_H_
@@ -0,0 +1,77 @@
+#ifndef CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_INL_H_
+#define CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_INL_H_
+
+namespace ceres_error_terms {
+namespace internal {
+
+// The fixed switch variable is constant in the problem, so ceres never asks
+// for its Jacobian and the derivative of the switch is compiled out.
+template <SwitchVariable kSwitchVariable>
+inline double* getSwitchVariableJacobian(
+    double** jacobians, const int switch_variable_index) {
+  if (jacobians == nullptr) {
+    return nullptr;
+  }
+  if (kSwitchVariable == SwitchVariable::kFixed) {
+    DCHECK(jacobians[switch_variable_index] == nullptr)
+        << "The switch variable of a loop closure with a fixed switch "
+        << "variable has to be constant.";
+    return nullptr;
+  }
+  return jacobians[switch_variable_index];
+}
+
+}  // namespace internal
+
+template <SwitchVariable kSwitchVariable>
+bool LoopClosureEdgeErrorTermAnalytic<kSwitchVariable>::Evaluate(
+    double const* const* parameters, double* residuals,
+    double** jacobians) const {
+  CHECK_NOTNULL(parameters);
+  CHECK_NOTNULL(residuals);
+
+  double* J_T_M_IA = nullptr;
+  double* J_T_M_IB = nullptr;
+  if (jacobians != nullptr) {
+    J_T_M_IA = jacobians[kIdxPoseA];
+    J_T_M_IB = jacobians[kIdxPoseB];
+  }
+  evaluate(
+      kIdentityPose, parameters[kIdxPoseA], kIdentityPose,
+      parameters[kIdxPoseB], *parameters[kIdxSwitchVariable], residuals,
+      nullptr, J_T_M_IA, nullptr, J_T_M_IB,
+      internal::getSwitchVariableJacobian<kSwitchVariable>(
+          jacobians, kIdxSwitchVariable));
+  return true;
+}
+
+template <SwitchVariable kSwitchVariable>
+bool LoopClosureEdgeBaseframeErrorTermAnalytic<kSwitchVariable>::Evaluate(
+    double const* const* parameters, double* residuals,
+    double** jacobians) const {
+  CHECK_NOTNULL(parameters);
+  CHECK_NOTNULL(residuals);
+
+  double* J_T_G_MA = nullptr;
+  double* J_T_MA_IA = nullptr;
+  double* J_T_G_MB = nullptr;
+  double* J_T_MB_IB = nullptr;
+  if (jacobians != nullptr) {
+    J_T_G_MA = jacobians[kIdxBaseframeA];
+    J_T_MA_IA = jacobians[kIdxPoseA];
+    J_T_G_MB = jacobians[kIdxBaseframeB];
+    J_T_MB_IB = jacobians[kIdxPoseB];
+  }
+  evaluate(
+      parameters[kIdxBaseframeA], parameters[kIdxPoseA],
+      parameters[kIdxBaseframeB], parameters[kIdxPoseB],
+      *parameters[kIdxSwitchVariable], residuals, J_T_G_MA, J_T_MA_IA,
+      J_T_G_MB, J_T_MB_IB,
+      internal::getSwitchVariableJacobian<kSwitchVariable>(
+          jacobians, kIdxSwitchVariable));
+  return true;
+}
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_INL_H_
@@ -0,0 +1,120 @@
+#ifndef CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_H_
+#define CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_H_
+
+#include <Eigen/Core>
+#include <ceres/sized_cost_function.h>
+#include <glog/logging.h>
+
+#include <ceres-error-terms/common.h>
+#include <maplab-common/pose_types.h>
+
+namespace ceres_error_terms {
+
+// Whether the switch variable of a loop closure is optimized. A fixed switch
+// variable has to be set constant in the problem, its Jacobian is then never
+// computed.
+enum class SwitchVariable { kFixed, kFree };
+
+// Residual of LoopClosureEdgeErrorTerm with analytic Jacobians. The poses are
+// stored as [q_JPL, p] like for the autodiff version and the Jacobians w.r.t.
+// the orientations are only valid when multiplied with the Jacobian of the
+// JplPoseParameterization, as for all analytic terms of this package.
+class LoopClosureEdgeErrorTermAnalyticBase {
+ public:
+  static constexpr int kResidualBlockSize = poseblocks::kResidualSize;
+  static constexpr int kSwitchVariableBlockSize = 1;
+
+  // Same arguments as LoopClosureEdgeErrorTerm.
+  LoopClosureEdgeErrorTermAnalyticBase(
+      const Eigen::Matrix<double, 7, 1>& q_AB__A_p_AB,
+      const Eigen::Matrix<double, 6, 6>& T_A_B_covariance);
+
+  // Same arguments and residual as LoopClosureBlockPoseErrorTerm, whose
+  // orientation residual has the opposite sign of LoopClosureEdgeErrorTerm.
+  LoopClosureEdgeErrorTermAnalyticBase(
+      const pose::Transformation& T_A_B,
+      const Eigen::Matrix<double, 6, 6>& T_A_B_covariance);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  // Pose Jacobians are row-major 6x7 and, like the switch variable Jacobian,
+  // only computed if not nullptr.
+  void evaluate(
+      const double* T_G_MA, const double* T_MA_IA, const double* T_G_MB,
+      const double* T_MB_IB, const double switch_variable, double* residuals,
+      double* J_T_G_MA, double* J_T_MA_IA, double* J_T_G_MB,
+      double* J_T_MB_IB, double* J_switch_variable) const;
+
+  // Identity baseframe used for vertices in the same mission.
+  static const double kIdentityPose[poseblocks::kPoseSize];
+
+ private:
+  Eigen::Vector4d q_AB_;
+  Eigen::Vector3d A_p_AB_;
+  // Applied as in the autodiff terms: residual = switch * error^T * W.
+  Eigen::Matrix<double, 6, 6> sqrt_information_matrix_;
+};
+
+// Both vertices are in the same mission frame of reference. The parameter
+// blocks are [T_M_IA, T_M_IB, switch_variable].
+template <SwitchVariable kSwitchVariable>
+class LoopClosureEdgeErrorTermAnalytic
+    : public ceres::SizedCostFunction<
+          LoopClosureEdgeErrorTermAnalyticBase::kResidualBlockSize,
+          poseblocks::kPoseSize, poseblocks::kPoseSize,
+          LoopClosureEdgeErrorTermAnalyticBase::kSwitchVariableBlockSize>,
+      public LoopClosureEdgeErrorTermAnalyticBase {
+ public:
+  using LoopClosureEdgeErrorTermAnalyticBase::
+      LoopClosureEdgeErrorTermAnalyticBase;
+
+  virtual ~LoopClosureEdgeErrorTermAnalytic() {}
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const;
+
+ private:
+  // Don't change the ordering of the enum elements, they have to be the
+  // same as the order of the parameter blocks.
+  enum { kIdxPoseA, kIdxPoseB, kIdxSwitchVariable };
+};
+
+// The vertices are in different mission frames of reference. The parameter
+// blocks are [T_G_MA, T_MA_IA, T_G_MB, T_MB_IB, switch_variable].
+template <SwitchVariable kSwitchVariable>
+class LoopClosureEdgeBaseframeErrorTermAnalytic
+    : public ceres::SizedCostFunction<
+          LoopClosureEdgeErrorTermAnalyticBase::kResidualBlockSize,
+          poseblocks::kPoseSize, poseblocks::kPoseSize, poseblocks::kPoseSize,
+          poseblocks::kPoseSize,
+          LoopClosureEdgeErrorTermAnalyticBase::kSwitchVariableBlockSize>,
+      public LoopClosureEdgeErrorTermAnalyticBase {
+ public:
+  using LoopClosureEdgeErrorTermAnalyticBase::
+      LoopClosureEdgeErrorTermAnalyticBase;
+
+  virtual ~LoopClosureEdgeBaseframeErrorTermAnalytic() {}
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const;
+
+ private:
+  // Don't change the ordering of the enum elements, they have to be the
+  // same as the order of the parameter blocks.
+  enum {
+    kIdxBaseframeA,
+    kIdxPoseA,
+    kIdxBaseframeB,
+    kIdxPoseB,
+    kIdxSwitchVariable
+  };
+};
+
+}  // namespace ceres_error_terms
+
+#include "ceres-error-terms/loop-closure-edge-error-term-analytic-inl.h"
+
+#endif  // CERES_ERROR_TERMS_LOOP_CLOSURE_EDGE_ERROR_TERM_ANALYTIC_H_
@@ -1,7 +1,10 @@
 #ifndef CERES_ERROR_TERMS_PROBLEM_INFORMATION_H_
 #define CERES_ERROR_TERMS_PROBLEM_INFORMATION_H_
 
+#include <map>
 #include <memory>
+#include <tuple>
+#include <typeindex>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -11,17 +14,54 @@
 #include <maplab-common/accessors.h>
 
 #include "ceres-error-terms/common.h"
+#include "ceres-error-terms/residual-block-arena.h"
 #include "ceres-error-terms/residual-information.h"
 
 namespace ceres_error_terms {
 
 struct ProblemInformation {
+  ProblemInformation()
+      : revision(0u),
+        residual_block_arena(std::make_shared<ResidualBlockArena>()) {}
+
   void clearProblemInformation() {
     residual_blocks.clear();
     parameterizations.clear();
     constant_parameter_blocks.clear();
     constant_parameter_blocks.clear();
     parameter_block_group_id.clear();
+    shared_loss_functions.clear();
+    // Cost functions that are still referenced keep the old arena alive.
+    residual_block_arena = std::make_shared<ResidualBlockArena>();
+    ++revision;
+  }
+
+  void reserveResidualBlocks(const size_t num_residual_blocks) {
+    residual_blocks.reserve(num_residual_blocks);
+  }
+
+  // Creates a cost function in the residual block arena instead of on the
+  // heap. The cost function lives as long as the arena, which is kept alive
+  // by the returned pointer.
+  template <typename CostFunctionType, typename... Args>
+  std::shared_ptr<ceres::CostFunction> createCostFunction(Args&&... args) {
+    return residual_block_arena->getShared<ceres::CostFunction>(
+        residual_block_arena->create<CostFunctionType>(
+            std::forward<Args>(args)...));
+  }
+
+  // Loss functions are stateless, so all residuals of a type that use the same
+  // kind of loss with the same scale can share a single instance.
+  template <typename LossFunctionType>
+  std::shared_ptr<ceres::LossFunction> getSharedLossFunction(
+      const ResidualType residual_type, const double scale) {
+    std::shared_ptr<ceres::LossFunction>& loss_function =
+        shared_loss_functions[SharedLossFunctionKey(
+            residual_type, std::type_index(typeid(LossFunctionType)), scale)];
+    if (!loss_function) {
+      loss_function = std::make_shared<LossFunctionType>(scale);
+    }
+    return loss_function;
   }
 
   void addResidualBlock(
@@ -29,11 +69,18 @@ struct ProblemInformation {
       std::shared_ptr<ceres::CostFunction> cost_function,
       std::shared_ptr<ceres::LossFunction> loss_function,
       const std::vector<double*>& parameter_blocks) {
-    ResidualInformation residual_info(
-        residual_type, cost_function, loss_function, parameter_blocks);
-    CHECK(residual_blocks.emplace(cost_function.get(), residual_info).second);
+    ceres::CostFunction* cost_function_ptr = CHECK_NOTNULL(cost_function.get());
+    CHECK(residual_blocks
+              .emplace(
+                  std::piecewise_construct,
+                  std::forward_as_tuple(cost_function_ptr),
+                  std::forward_as_tuple(
+                      residual_type, std::move(cost_function),
+                      std::move(loss_function), parameter_blocks))
+              .second);
     active_parameter_blocks.insert(
         parameter_blocks.begin(), parameter_blocks.end());
+    ++revision;
   }
 
   void setParameterization(
@@ -49,6 +96,7 @@ struct ProblemInformation {
         << it_inserted.first->second.get() << " of block " << parameter_block
         << " with parameterization " << parameterization.get() << ". "
         << "Use replaceParameterization(..) to perform this operation.";
+    ++revision;
   }
 
   void replaceParameterization(
@@ -56,6 +104,7 @@ struct ProblemInformation {
       const std::shared_ptr<ceres::LocalParameterization>& parameterization) {
     CHECK_NOTNULL(parameter_block);
     common::getChecked(parameterizations, parameter_block) = parameterization;
+    ++revision;
   }
 
   // Will not fail if the parameterization was already set.
@@ -64,6 +113,7 @@ struct ProblemInformation {
       const std::shared_ptr<ceres::LocalParameterization>& parameterization) {
     CHECK_NOTNULL(parameter_block);
     parameterizations[parameter_block] = parameterization;
+    ++revision;
   }
 
   // Returns true if it has been set constant.
@@ -73,17 +123,20 @@ struct ProblemInformation {
       return false;
     }
     constant_parameter_blocks.insert(parameter_block);
+    ++revision;
     return true;
   }
 
   void setParameterBlockConstant(double* parameter_block) {
     CHECK_NOTNULL(parameter_block);
     constant_parameter_blocks.insert(parameter_block);
+    ++revision;
   }
 
   void setParameterBlockVariable(double* parameter_block) {
     CHECK_NOTNULL(parameter_block);
     constant_parameter_blocks.erase(parameter_block);
+    ++revision;
   }
 
   bool isParameterBlockConstant(double* parameter_block) const {
@@ -110,6 +163,7 @@ struct ProblemInformation {
     bound_info.upper_bound = upper_bound;
 
     parameter_bounds.emplace(parameter_block, bound_info);
+    ++revision;
   }
 
   void setParameterBlockGroupId(double* parameter_block, int parameter_id) {
@@ -117,6 +171,7 @@ struct ProblemInformation {
     CHECK_GE(parameter_id, 0);
     const bool inserted =
         parameter_block_group_id.emplace(parameter_block, parameter_id).second;
+    ++revision;
     VLOG_IF(50, !inserted) << "Group id of parameter block " << parameter_block
                            << " was already set.";
   }
@@ -140,8 +195,14 @@ struct ProblemInformation {
         residual_info.parameter_blocks.begin(),
         residual_info.parameter_blocks.end(),
         [this](double* param) { this->active_parameter_blocks.erase(param); });
+    ++revision;
   }
 
+  // Incremented by every modification through the methods above, so a built
+  // ceres problem can tell whether it is still up to date. Code that changes
+  // the members directly has to increment it as well.
+  size_t revision;
+
   typedef std::unordered_map<ceres::CostFunction*, ResidualInformation>
       ResidualInformationMap;
   ResidualInformationMap residual_blocks;
@@ -163,6 +224,14 @@ struct ProblemInformation {
   // the default group.
   static constexpr int kDefaultParameterBlockId = -1;
   std::unordered_map<const double*, int> parameter_block_group_id;
+
+  // Owns the cost functions made by createCostFunction().
+  ResidualBlockArena::Ptr residual_block_arena;
+
+  typedef std::tuple<ResidualType, std::type_index, double>
+      SharedLossFunctionKey;
+  std::map<SharedLossFunctionKey, std::shared_ptr<ceres::LossFunction>>
+      shared_loss_functions;
 };
 
 ceres::Problem::Options getDefaultProblemOptions();
@@ -0,0 +1,80 @@
+#ifndef CERES_ERROR_TERMS_RESIDUAL_BLOCK_ARENA_H_
+#define CERES_ERROR_TERMS_RESIDUAL_BLOCK_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace ceres_error_terms {
+
+// Bump allocator for the cost functions of a problem. Problems with millions
+// of residuals otherwise spend seconds allocating and freeing the cost
+// functions one by one. Objects are placed in large blocks and are only
+// destroyed, in reverse order of creation, together with the arena. Share the
+// objects through getShared(), which keeps the arena alive as long as any of
+// them is in use.
+//
+// Not thread-safe, like the ProblemInformation it belongs to.
+class ResidualBlockArena
+    : public std::enable_shared_from_this<ResidualBlockArena> {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(ResidualBlockArena);
+
+  static constexpr size_t kDefaultBlockSizeBytes = 1u << 20;
+
+  explicit ResidualBlockArena(
+      const size_t block_size_bytes = kDefaultBlockSizeBytes);
+  ~ResidualBlockArena();
+
+  ResidualBlockArena(const ResidualBlockArena&) = delete;
+  ResidualBlockArena& operator=(const ResidualBlockArena&) = delete;
+
+  // The returned object is owned by the arena.
+  template <typename ObjectType, typename... Args>
+  ObjectType* create(Args&&... args) {
+    void* memory = allocate(sizeof(ObjectType), alignof(ObjectType));
+    ObjectType* object = new (memory) ObjectType(std::forward<Args>(args)...);
+    destructors_.emplace_back(object, &destroy<ObjectType>);
+    return object;
+  }
+
+  // Shares an object created by this arena. The arena has to be owned by a
+  // shared pointer, no separate control block is allocated for the object.
+  template <typename BaseType, typename ObjectType>
+  std::shared_ptr<BaseType> getShared(ObjectType* object) {
+    CHECK_NOTNULL(object);
+    return std::shared_ptr<BaseType>(shared_from_this(), object);
+  }
+
+  size_t getNumObjects() const {
+    return destructors_.size();
+  }
+  size_t getNumBytesReserved() const;
+
+ private:
+  void* allocate(const size_t size_bytes, const size_t alignment);
+
+  template <typename ObjectType>
+  static void destroy(void* object) {
+    static_cast<ObjectType*>(object)->~ObjectType();
+  }
+
+  struct Block {
+    std::unique_ptr<char[]> memory;
+    size_t size_bytes;
+  };
+
+  const size_t block_size_bytes_;
+  std::vector<Block> blocks_;
+  // Bytes used in the last block.
+  size_t used_bytes_in_last_block_;
+  std::vector<std::pair<void*, void (*)(void*)>> destructors_;
+};
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_RESIDUAL_BLOCK_ARENA_H_
@@ -2,6 +2,7 @@
 #define CERES_ERROR_TERMS_RESIDUAL_INFORMATION_H_
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <ceres/problem.h>
@@ -38,8 +39,8 @@ struct ResidualInformation {
       const std::vector<double*>& _parameter_blocks)
       : latest_residual_block_id(nullptr),
         residual_type(_residual_type),
-        cost_function(_cost_function),
-        loss_function(_loss_function),
+        cost_function(std::move(_cost_function)),
+        loss_function(std::move(_loss_function)),
         parameter_blocks(_parameter_blocks),
         active_(true) {}
 
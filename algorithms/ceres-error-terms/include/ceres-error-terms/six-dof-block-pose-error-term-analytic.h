@@ -0,0 +1,76 @@
+#ifndef CERES_ERROR_TERMS_SIX_DOF_BLOCK_POSE_ERROR_TERM_ANALYTIC_H_
+#define CERES_ERROR_TERMS_SIX_DOF_BLOCK_POSE_ERROR_TERM_ANALYTIC_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <ceres/sized_cost_function.h>
+
+#include <ceres-error-terms/common.h>
+#include <maplab-common/pose_types.h>
+
+namespace ceres_error_terms {
+
+// Analytic versions of SixDoFBlockPoseErrorTerm and
+// SixDoFBlockPoseErrorTermWithExtrinsics, with the same parameter blocks and
+// residuals. The Jacobians w.r.t. the orientations are only valid when
+// multiplied with the Jacobian of the JPL (pose) parameterization, as for all
+// analytic terms of this package.
+class SixDoFBlockPoseErrorTermAnalytic
+    : public ceres::SizedCostFunction<poseblocks::kResidualSize,
+                                      poseblocks::kPoseSize,
+                                      poseblocks::kPoseSize> {
+ public:
+  SixDoFBlockPoseErrorTermAnalytic(
+      const pose::Transformation& T_A_B,
+      const Eigen::Matrix<double, 6, 6>& T_A_B_covariance);
+
+  virtual ~SixDoFBlockPoseErrorTermAnalytic() {}
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  // Don't change the ordering of the enum elements, they have to be the
+  // same as the order of the parameter blocks.
+  enum { kIdxPoseA, kIdxPoseB };
+
+  Eigen::Quaterniond q_A_B_;
+  Eigen::Vector3d p_A_B_;
+  Eigen::Matrix<double, 6, 6> sqrt_information_matrix_;
+};
+
+// See SixDoFBlockPoseErrorTermWithExtrinsics for the frames.
+class SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic
+    : public ceres::SizedCostFunction<
+          poseblocks::kResidualSize, poseblocks::kPoseSize,
+          poseblocks::kPoseSize, poseblocks::kOrientationBlockSize,
+          poseblocks::kPositionBlockSize> {
+ public:
+  SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic(
+      const pose::Transformation& T_Bk_Bkp1,
+      const Eigen::Matrix<double, 6, 6>& T_Bk_Bkp1_covariance);
+
+  virtual ~SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic() {}
+
+  virtual bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  // Don't change the ordering of the enum elements, they have to be the
+  // same as the order of the parameter blocks.
+  enum { kIdxPoseK, kIdxPoseKp1, kIdxOrientationIB, kIdxPositionBI };
+
+  Eigen::Quaterniond q_Bk_Bkp1_;
+  Eigen::Vector3d p_Bk_Bkp1_;
+  Eigen::Matrix<double, 6, 6> sqrt_information_matrix_;
+};
+
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_SIX_DOF_BLOCK_POSE_ERROR_TERM_ANALYTIC_H_
@@ -2,6 +2,8 @@
 #define CERES_ERROR_TERMS_VISUAL_ERROR_TERM_FACTORY_INL_H_
 
 #include <limits>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -19,11 +21,23 @@
 
 namespace ceres_error_terms {
 
+namespace internal {
+
+template <typename CostFunctionType, typename... Args>
+ceres::CostFunction* newCostFunction(
+    ResidualBlockArena* arena, Args&&... args) {
+  if (arena == nullptr) {
+    return new CostFunctionType(std::forward<Args>(args)...);
+  }
+  return arena->create<CostFunctionType>(std::forward<Args>(args)...);
+}
+
+// Allocates from the arena if it is given and on the heap otherwise.
 template <template <typename, typename> class ErrorTerm>
 ceres::CostFunction* createVisualCostFunction(
     const Eigen::Vector2d& measurement, double pixel_sigma,
     ceres_error_terms::visual::VisualErrorType error_term_type,
-    aslam::Camera* camera) {
+    aslam::Camera* camera, ResidualBlockArena* arena) {
   CHECK_NOTNULL(camera);
   ceres::CostFunction* error_term = nullptr;
   switch (camera->getType()) {
@@ -34,24 +48,28 @@ ceres::CostFunction* createVisualCostFunction(
           camera->getDistortion().getType();
       switch (distortion_type) {
         case aslam::Distortion::Type::kNoDistortion:
-          error_term =
-              new ErrorTerm<aslam::PinholeCamera, aslam::NullDistortion>(
-                  measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::PinholeCamera, aslam::NullDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kEquidistant:
-          error_term =
-              new ErrorTerm<aslam::PinholeCamera, aslam::EquidistantDistortion>(
-                  measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::PinholeCamera, aslam::EquidistantDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kRadTan:
-          error_term =
-              new ErrorTerm<aslam::PinholeCamera, aslam::RadTanDistortion>(
-                  measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::PinholeCamera, aslam::RadTanDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kFisheye:
-          error_term =
-              new ErrorTerm<aslam::PinholeCamera, aslam::FisheyeDistortion>(
-                  measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::PinholeCamera, aslam::FisheyeDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         default:
           LOG(FATAL) << "Invalid camera distortion type for ceres error term: "
@@ -66,24 +84,28 @@ ceres::CostFunction* createVisualCostFunction(
           camera->getDistortion().getType();
       switch (distortion_type) {
         case aslam::Distortion::Type::kNoDistortion:
-          error_term = new ErrorTerm<aslam::UnifiedProjectionCamera,
-                                     aslam::NullDistortion>(
-              measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::UnifiedProjectionCamera, aslam::NullDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kEquidistant:
-          error_term = new ErrorTerm<aslam::UnifiedProjectionCamera,
-                                     aslam::EquidistantDistortion>(
-              measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::UnifiedProjectionCamera, aslam::EquidistantDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kRadTan:
-          error_term = new ErrorTerm<aslam::UnifiedProjectionCamera,
-                                     aslam::RadTanDistortion>(
-              measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::UnifiedProjectionCamera, aslam::RadTanDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         case aslam::Distortion::Type::kFisheye:
-          error_term = new ErrorTerm<aslam::UnifiedProjectionCamera,
-                                     aslam::FisheyeDistortion>(
-              measurement, pixel_sigma, error_term_type, derived_camera);
+          error_term = newCostFunction<ErrorTerm<
+              aslam::UnifiedProjectionCamera, aslam::FisheyeDistortion>>(
+              arena, measurement, pixel_sigma, error_term_type,
+              derived_camera);
           break;
         default:
           LOG(FATAL) << "Invalid camera distortion type for ceres error term: "
@@ -98,6 +120,28 @@ ceres::CostFunction* createVisualCostFunction(
   return error_term;
 }
 
+}  // namespace internal
+
+template <template <typename, typename> class ErrorTerm>
+ceres::CostFunction* createVisualCostFunction(
+    const Eigen::Vector2d& measurement, double pixel_sigma,
+    ceres_error_terms::visual::VisualErrorType error_term_type,
+    aslam::Camera* camera) {
+  return internal::createVisualCostFunction<ErrorTerm>(
+      measurement, pixel_sigma, error_term_type, camera, nullptr);
+}
+
+template <template <typename, typename> class ErrorTerm>
+std::shared_ptr<ceres::CostFunction> createVisualCostFunction(
+    const Eigen::Vector2d& measurement, double pixel_sigma,
+    ceres_error_terms::visual::VisualErrorType error_term_type,
+    aslam::Camera* camera, const ResidualBlockArena::Ptr& arena) {
+  CHECK(arena);
+  return arena->getShared<ceres::CostFunction>(
+      internal::createVisualCostFunction<ErrorTerm>(
+          measurement, pixel_sigma, error_term_type, camera, arena.get()));
+}
+
 void replaceUnusedArgumentsOfVisualCostFunctionWithDummies(
     ceres_error_terms::visual::VisualErrorType error_term_type,
     std::vector<double*>* error_term_argument_list,
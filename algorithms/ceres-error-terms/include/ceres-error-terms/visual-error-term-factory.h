@@ -1,11 +1,14 @@
 #ifndef CERES_ERROR_TERMS_VISUAL_ERROR_TERM_FACTORY_H_
 #define CERES_ERROR_TERMS_VISUAL_ERROR_TERM_FACTORY_H_
 
+#include <memory>
 #include <vector>
 
 #include <Eigen/Core>
 #include <aslam/cameras/camera.h>
 
+#include "ceres-error-terms/residual-block-arena.h"
+
 namespace ceres_error_terms {
 
 template <template <typename, typename> class ErrorTerm>
@@ -14,6 +17,14 @@ ceres::CostFunction* createVisualCostFunction(
     ceres_error_terms::visual::VisualErrorType error_term_type,
     aslam::Camera* camera);
 
+// Same as above, but the cost function is created in the residual block
+// arena, see ProblemInformation::createCostFunction().
+template <template <typename, typename> class ErrorTerm>
+std::shared_ptr<ceres::CostFunction> createVisualCostFunction(
+    const Eigen::Vector2d& measurement, double pixel_sigma,
+    ceres_error_terms::visual::VisualErrorType error_term_type,
+    aslam::Camera* camera, const ResidualBlockArena::Ptr& arena);
+
 void replaceUnusedArgumentsOfVisualCostFunctionWithDummies(
     ceres_error_terms::visual::VisualErrorType error_term_type,
     std::vector<double*>* error_term_argument_list,
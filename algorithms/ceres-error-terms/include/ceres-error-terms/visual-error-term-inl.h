@@ -6,6 +6,7 @@
 #include <maplab-common/quaternion-math.h>
 
 #include "ceres-error-terms/common.h"
+#include "ceres-error-terms/visual-projection-fixed-size.h"
 
 namespace ceres_error_terms {
 
@@ -39,15 +40,6 @@ bool VisualReprojectionError<CameraType, DistortionType>::Evaluate(
       parameters[kIdxImuPose] + visual::kOrientationBlockSize);
   Eigen::Map<const Eigen::Quaterniond> q_C_I(parameters[kIdxCameraToImuQ]);
   Eigen::Map<const Eigen::Vector3d> p_C_I(parameters[kIdxCameraToImuP]);
-  Eigen::Map<const Eigen::Matrix<double, CameraType::parameterCount(), 1> >
-      intrinsics_map(parameters[kIdxCameraIntrinsics]);
-  Eigen::Matrix<double, Eigen::Dynamic, 1> distortion_map;
-
-  if (DistortionType::parameterCount() > 0) {
-    distortion_map = Eigen::Map<
-        const Eigen::Matrix<double, DistortionType::parameterCount(), 1> >(
-        parameters[kIdxCameraDistortion]);
-  }
 
   // Jacobian of landmark pose in camera system w.r.t. keyframe pose
   Eigen::Matrix<double, visual::kPositionBlockSize, 3> J_p_C_fi_wrt_q_I_M;
@@ -72,15 +64,11 @@ bool VisualReprojectionError<CameraType, DistortionType>::Evaluate(
   // Jacobian of landmark pose in camera system w.r.t. landmark position
   Eigen::Matrix<double, visual::kPositionBlockSize, 3> J_p_C_fi_wrt_p_B_fi;
 
-  // Jacobians w.r.t. camera intrinsics and distortion coefficients
-  typedef Eigen::Matrix<double, visual::kResidualSize, Eigen::Dynamic>
-      JacobianWrtIntrinsicsType;
-  JacobianWrtIntrinsicsType J_keypoint_wrt_intrinsics(
-      visual::kResidualSize, CameraType::parameterCount());
-  typedef Eigen::Matrix<double, visual::kResidualSize, Eigen::Dynamic>
-      JacobianWrtDistortionType;
-  JacobianWrtDistortionType J_keypoint_wrt_distortion(
-      visual::kResidualSize, DistortionType::parameterCount());
+  // Jacobians w.r.t. camera intrinsics and distortion coefficients. These are
+  // fixed-size for the camera models with a specialized projection.
+  typedef visual::FixedSizeProjection<CameraType, DistortionType> Projection;
+  typename Projection::IntrinsicsJacobian J_keypoint_wrt_intrinsics;
+  typename Projection::DistortionJacobian J_keypoint_wrt_distortion;
 
   Eigen::Matrix3d R_B_LM, R_LM_B;
   Eigen::Matrix3d R_G_LM;
@@ -123,34 +111,31 @@ bool VisualReprojectionError<CameraType, DistortionType>::Evaluate(
   // Jacobian of 2d keypoint (including distortion and intrinsics)
   // w.r.t. to landmark position in camera coordinates
   Eigen::Vector2d reprojected_landmark;
-  typedef Eigen::Matrix<double, visual::kResidualSize,
-                        visual::kPositionBlockSize>
-      VisualJacobianType;
-
-  VisualJacobianType J_keypoint_wrt_p_C_fi;
-  Eigen::VectorXd intrinsics = intrinsics_map;
-  Eigen::VectorXd distortion = distortion_map;
+  typename Projection::PointJacobian J_keypoint_wrt_p_C_fi;
 
   // Only evaluate the jacobian if requested.
-  VisualJacobianType* J_keypoint_wrt_p_C_fi_ptr = nullptr;
+  typename Projection::PointJacobian* J_keypoint_wrt_p_C_fi_ptr = nullptr;
   if (jacobians) {
     J_keypoint_wrt_p_C_fi_ptr = &J_keypoint_wrt_p_C_fi;
   }
-  JacobianWrtIntrinsicsType* J_keypoint_wrt_intrinsics_ptr = nullptr;
+  typename Projection::IntrinsicsJacobian* J_keypoint_wrt_intrinsics_ptr =
+      nullptr;
   if (jacobians && jacobians[kIdxCameraIntrinsics]) {
     J_keypoint_wrt_intrinsics_ptr = &J_keypoint_wrt_intrinsics;
   }
-  JacobianWrtDistortionType* J_keypoint_wrt_distortion_ptr = nullptr;
+  typename Projection::DistortionJacobian* J_keypoint_wrt_distortion_ptr =
+      nullptr;
   if (DistortionType::parameterCount() > 0 && jacobians &&
       jacobians[kIdxCameraDistortion]) {
     J_keypoint_wrt_distortion_ptr = &J_keypoint_wrt_distortion;
   }
 
-  const aslam::ProjectionResult projection_result =
-      camera_ptr_->project3Functional(
-          p_C_fi, &intrinsics, &distortion, &reprojected_landmark,
-          J_keypoint_wrt_p_C_fi_ptr, J_keypoint_wrt_intrinsics_ptr,
-          J_keypoint_wrt_distortion_ptr);
+  const bool projection_valid = Projection::project(
+      *camera_ptr_, p_C_fi, parameters[kIdxCameraIntrinsics],
+      DistortionType::parameterCount() > 0 ? parameters[kIdxCameraDistortion]
+                                           : nullptr,
+      &reprojected_landmark, J_keypoint_wrt_p_C_fi_ptr,
+      J_keypoint_wrt_intrinsics_ptr, J_keypoint_wrt_distortion_ptr);
 
   // Handle projection failures by zeroing the Jacobians and setting the error
   // to zero.
@@ -159,21 +144,18 @@ bool VisualReprojectionError<CameraType, DistortionType>::Evaluate(
   constexpr double kMaxDistanceFromOpticalAxisPxSquare = 1.0e5 * 1.0e5;
   constexpr double kMinDistanceToCameraPlane = 0.05;
   const bool projection_failed =
-      (projection_result == aslam::ProjectionResult::POINT_BEHIND_CAMERA) ||
-      (projection_result == aslam::ProjectionResult::PROJECTION_INVALID) ||
-      (p_C_fi(2, 0) < kMinDistanceToCameraPlane) ||
+      !projection_valid || (p_C_fi(2, 0) < kMinDistanceToCameraPlane) ||
       (reprojected_landmark.squaredNorm() >
        kMaxDistanceFromOpticalAxisPxSquare);
   VLOG_IF(10, projection_failed)
       << "Projection failed for p_C " << p_C_fi.transpose()
-      << " to image coordinates " << reprojected_landmark.transpose()
-      << " with result " << projection_result << ".";
+      << " to image coordinates " << reprojected_landmark.transpose() << ".";
 
   if (jacobians) {
     if (projection_failed && J_keypoint_wrt_intrinsics_ptr != nullptr) {
       J_keypoint_wrt_intrinsics_ptr->setZero();
     }
-    if (projection_failed && J_keypoint_wrt_intrinsics_ptr != nullptr) {
+    if (projection_failed && J_keypoint_wrt_distortion_ptr != nullptr) {
       J_keypoint_wrt_distortion_ptr->setZero();
     }
 
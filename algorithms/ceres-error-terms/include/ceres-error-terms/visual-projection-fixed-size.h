@@ -0,0 +1,272 @@
+#ifndef CERES_ERROR_TERMS_VISUAL_PROJECTION_FIXED_SIZE_H_
+#define CERES_ERROR_TERMS_VISUAL_PROJECTION_FIXED_SIZE_H_
+
+#include <cmath>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <glog/logging.h>
+
+#include "ceres-error-terms/common.h"
+
+namespace ceres_error_terms {
+namespace visual {
+
+// Projection of a point in camera coordinates to image coordinates, including
+// the Jacobians w.r.t. the point, the intrinsics and the distortion
+// coefficients. The parameters are read directly from the ceres parameter
+// blocks. Returns false if the projection is invalid, e.g. because the point
+// lies behind the camera.
+//
+// The generic version goes through aslam::Camera::project3Functional. The
+// specializations below evaluate the most common camera models with
+// fixed-size types and without any dynamic allocation.
+template <typename CameraType, typename DistortionType>
+struct FixedSizeProjection {
+  typedef Eigen::Matrix<double, kResidualSize, kPositionBlockSize>
+      PointJacobian;
+  typedef Eigen::Matrix<double, kResidualSize, Eigen::Dynamic>
+      IntrinsicsJacobian;
+  typedef Eigen::Matrix<double, kResidualSize, Eigen::Dynamic>
+      DistortionJacobian;
+
+  static bool project(
+      const CameraType& camera, const Eigen::Vector3d& p_C,
+      const double* intrinsics, const double* distortion,
+      Eigen::Vector2d* keypoint, PointJacobian* J_keypoint_wrt_p_C,
+      IntrinsicsJacobian* J_keypoint_wrt_intrinsics,
+      DistortionJacobian* J_keypoint_wrt_distortion) {
+    CHECK_NOTNULL(keypoint);
+    const Eigen::VectorXd intrinsics_vector =
+        Eigen::Map<const Eigen::Matrix<double, CameraType::parameterCount(),
+                                       1> >(intrinsics);
+    Eigen::VectorXd distortion_vector;
+    if (DistortionType::parameterCount() > 0) {
+      distortion_vector = Eigen::Map<
+          const Eigen::Matrix<double, DistortionType::parameterCount(), 1> >(
+          distortion);
+    }
+    if (J_keypoint_wrt_intrinsics != nullptr) {
+      J_keypoint_wrt_intrinsics->resize(
+          kResidualSize, CameraType::parameterCount());
+    }
+    if (J_keypoint_wrt_distortion != nullptr) {
+      J_keypoint_wrt_distortion->resize(
+          kResidualSize, DistortionType::parameterCount());
+    }
+
+    const aslam::ProjectionResult projection_result =
+        camera.project3Functional(
+            p_C, &intrinsics_vector, &distortion_vector, keypoint,
+            J_keypoint_wrt_p_C, J_keypoint_wrt_intrinsics,
+            J_keypoint_wrt_distortion);
+    return projection_result !=
+               aslam::ProjectionResult::POINT_BEHIND_CAMERA &&
+           projection_result != aslam::ProjectionResult::PROJECTION_INVALID;
+  }
+};
+
+// Radial-tangential distortion [k1, k2, p1, p2] of normalized image
+// coordinates, see aslam::RadTanDistortion.
+struct RadTanDistortionModel {
+  static constexpr int kParameterCount = 4;
+  typedef Eigen::Matrix<double, kResidualSize, kParameterCount>
+      ParameterJacobian;
+
+  static void distort(
+      const double* parameters, Eigen::Vector2d* point,
+      Eigen::Matrix2d* J_point) {
+    CHECK_NOTNULL(point);
+    const double k1 = parameters[0];
+    const double k2 = parameters[1];
+    const double p1 = parameters[2];
+    const double p2 = parameters[3];
+    const double x = (*point)(0);
+    const double y = (*point)(1);
+
+    const double x2 = x * x;
+    const double y2 = y * y;
+    const double xy = x * y;
+    const double r2 = x2 + y2;
+    const double radial_distortion = k1 * r2 + k2 * r2 * r2;
+
+    if (J_point != nullptr) {
+      const double J_xy =
+          2.0 * k1 * xy + 4.0 * k2 * r2 * xy + 2.0 * p1 * x + 2.0 * p2 * y;
+      (*J_point)(0, 0) = 1.0 + radial_distortion + 2.0 * k1 * x2 +
+                         4.0 * k2 * r2 * x2 + 2.0 * p1 * y + 6.0 * p2 * x;
+      (*J_point)(0, 1) = J_xy;
+      (*J_point)(1, 0) = J_xy;
+      (*J_point)(1, 1) = 1.0 + radial_distortion + 2.0 * k1 * y2 +
+                         4.0 * k2 * r2 * y2 + 6.0 * p1 * y + 2.0 * p2 * x;
+    }
+
+    (*point)(0) += x * radial_distortion + 2.0 * p1 * xy + p2 * (r2 + 2.0 * x2);
+    (*point)(1) += y * radial_distortion + 2.0 * p2 * xy + p1 * (r2 + 2.0 * y2);
+  }
+
+  static void parameterJacobian(
+      const double* /*parameters*/, const Eigen::Vector2d& point,
+      ParameterJacobian* J_parameters) {
+    CHECK_NOTNULL(J_parameters);
+    const double x = point(0);
+    const double y = point(1);
+    const double r2 = x * x + y * y;
+    const double r4 = r2 * r2;
+    (*J_parameters) << x * r2, x * r4, 2.0 * x * y, r2 + 2.0 * x * x, y * r2,
+        y * r4, r2 + 2.0 * y * y, 2.0 * x * y;
+  }
+};
+
+// Equidistant distortion [k1, k2, k3, k4] of normalized image coordinates,
+// see aslam::EquidistantDistortion.
+struct EquidistantDistortionModel {
+  static constexpr int kParameterCount = 4;
+  // Below this radius the distortion is the identity, as in aslam.
+  static constexpr double kMinRadius = 1e-8;
+  typedef Eigen::Matrix<double, kResidualSize, kParameterCount>
+      ParameterJacobian;
+
+  static void distort(
+      const double* parameters, Eigen::Vector2d* point,
+      Eigen::Matrix2d* J_point) {
+    CHECK_NOTNULL(point);
+    const double k1 = parameters[0];
+    const double k2 = parameters[1];
+    const double k3 = parameters[2];
+    const double k4 = parameters[3];
+
+    const double r = point->norm();
+    if (r <= kMinRadius) {
+      if (J_point != nullptr) {
+        J_point->setIdentity();
+      }
+      return;
+    }
+    const double theta = std::atan(r);
+    const double theta2 = theta * theta;
+    const double theta4 = theta2 * theta2;
+    const double theta6 = theta4 * theta2;
+    const double theta8 = theta4 * theta4;
+    const double thetad =
+        theta * (1.0 + k1 * theta2 + k2 * theta4 + k3 * theta6 + k4 * theta8);
+    const double scaling = thetad / r;
+
+    if (J_point != nullptr) {
+      // d(scaling * p) / dp = scaling * I + d(scaling) / dr * p * p^T / r.
+      const double dthetad_dtheta = 1.0 + 3.0 * k1 * theta2 +
+                                    5.0 * k2 * theta4 + 7.0 * k3 * theta6 +
+                                    9.0 * k4 * theta8;
+      const double dtheta_dr = 1.0 / (1.0 + r * r);
+      const double dscaling_dr = (dthetad_dtheta * dtheta_dr - scaling) / r;
+      *J_point = scaling * Eigen::Matrix2d::Identity() +
+                 (dscaling_dr / r) * (*point) * point->transpose();
+    }
+    *point *= scaling;
+  }
+
+  static void parameterJacobian(
+      const double* /*parameters*/, const Eigen::Vector2d& point,
+      ParameterJacobian* J_parameters) {
+    CHECK_NOTNULL(J_parameters);
+    const double r = point.norm();
+    if (r <= kMinRadius) {
+      J_parameters->setZero();
+      return;
+    }
+    const double theta = std::atan(r);
+    const double theta2 = theta * theta;
+    const double theta3 = theta2 * theta;
+    const double theta5 = theta3 * theta2;
+    const double theta7 = theta5 * theta2;
+    const double theta9 = theta7 * theta2;
+    const Eigen::Vector2d point_over_r = point / r;
+    J_parameters->col(0) = point_over_r * theta3;
+    J_parameters->col(1) = point_over_r * theta5;
+    J_parameters->col(2) = point_over_r * theta7;
+    J_parameters->col(3) = point_over_r * theta9;
+  }
+};
+
+// Pinhole projection [fu, fv, cu, cv] followed by the given distortion
+// model, identical to aslam::PinholeCamera::project3Functional.
+template <typename DistortionModel>
+struct PinholeFixedSizeProjection {
+  static constexpr int kIntrinsicsCount = 4;
+  typedef Eigen::Matrix<double, kResidualSize, kPositionBlockSize>
+      PointJacobian;
+  typedef Eigen::Matrix<double, kResidualSize, kIntrinsicsCount>
+      IntrinsicsJacobian;
+  typedef typename DistortionModel::ParameterJacobian DistortionJacobian;
+
+  template <typename CameraType>
+  static bool project(
+      const CameraType& /*camera*/, const Eigen::Vector3d& p_C,
+      const double* intrinsics, const double* distortion,
+      Eigen::Vector2d* keypoint, PointJacobian* J_keypoint_wrt_p_C,
+      IntrinsicsJacobian* J_keypoint_wrt_intrinsics,
+      DistortionJacobian* J_keypoint_wrt_distortion) {
+    CHECK_NOTNULL(keypoint);
+    static_assert(
+        CameraType::parameterCount() == kIntrinsicsCount,
+        "Unexpected number of pinhole intrinsics.");
+    // aslam::PinholeCamera rejects points closer than this to the camera.
+    constexpr double kMinimumDepth = 1e-6;
+    if (!(p_C(2) > kMinimumDepth)) {
+      keypoint->setZero();
+      return false;
+    }
+
+    const double fu = intrinsics[0];
+    const double fv = intrinsics[1];
+    const double cu = intrinsics[2];
+    const double cv = intrinsics[3];
+
+    const double inverse_depth = 1.0 / p_C(2);
+    const Eigen::Vector2d point_undistorted(
+        p_C(0) * inverse_depth, p_C(1) * inverse_depth);
+    Eigen::Vector2d point_distorted = point_undistorted;
+    Eigen::Matrix2d J_distortion;
+    DistortionModel::distort(
+        distortion, &point_distorted,
+        J_keypoint_wrt_p_C != nullptr ? &J_distortion : nullptr);
+
+    (*keypoint) << fu * point_distorted(0) + cu, fv * point_distorted(1) + cv;
+
+    if (J_keypoint_wrt_p_C != nullptr) {
+      Eigen::Matrix<double, kResidualSize, kPositionBlockSize> J_normalized;
+      J_normalized << inverse_depth, 0.0, -point_undistorted(0) * inverse_depth,
+          0.0, inverse_depth, -point_undistorted(1) * inverse_depth;
+      J_keypoint_wrt_p_C->noalias() = J_distortion * J_normalized;
+      J_keypoint_wrt_p_C->row(0) *= fu;
+      J_keypoint_wrt_p_C->row(1) *= fv;
+    }
+    if (J_keypoint_wrt_intrinsics != nullptr) {
+      (*J_keypoint_wrt_intrinsics) << point_distorted(0), 0.0, 1.0, 0.0, 0.0,
+          point_distorted(1), 0.0, 1.0;
+    }
+    if (J_keypoint_wrt_distortion != nullptr) {
+      DistortionModel::parameterJacobian(
+          distortion, point_undistorted, J_keypoint_wrt_distortion);
+      J_keypoint_wrt_distortion->row(0) *= fu;
+      J_keypoint_wrt_distortion->row(1) *= fv;
+    }
+    return true;
+  }
+};
+
+template <>
+struct FixedSizeProjection<aslam::PinholeCamera, aslam::RadTanDistortion>
+    : public PinholeFixedSizeProjection<RadTanDistortionModel> {};
+
+template <>
+struct FixedSizeProjection<aslam::PinholeCamera, aslam::EquidistantDistortion>
+    : public PinholeFixedSizeProjection<EquidistantDistortionModel> {};
+
+}  // namespace visual
+}  // namespace ceres_error_terms
+
+#endif  // CERES_ERROR_TERMS_VISUAL_PROJECTION_FIXED_SIZE_H_
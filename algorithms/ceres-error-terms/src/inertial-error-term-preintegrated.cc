@@ -0,0 +1,376 @@
+#include "ceres-error-terms/inertial-error-term-preintegrated.h"
+
+#include <cmath>
+
+#include <Eigen/Geometry>
+#include <ceres-error-terms/parameterization/quaternion-param-jpl.h>
+#include <maplab-common/geometry.h>
+#include <maplab-common/quaternion-math.h>
+
+namespace ceres_error_terms {
+namespace {
+
+constexpr double kSmallAngle = 1e-8;
+
+inline Eigen::Matrix3d expSO3(const Eigen::Vector3d& phi) {
+  const double angle = phi.norm();
+  if (angle < kSmallAngle) {
+    return Eigen::Matrix3d::Identity() + common::skew(phi);
+  }
+  return Eigen::AngleAxisd(angle, phi / angle).toRotationMatrix();
+}
+
+inline Eigen::Vector3d logSO3(const Eigen::Matrix3d& R) {
+  const Eigen::AngleAxisd angle_axis(R);
+  return angle_axis.angle() * angle_axis.axis();
+}
+
+inline Eigen::Matrix3d rightJacobianSO3(const Eigen::Vector3d& phi) {
+  const double angle = phi.norm();
+  const Eigen::Matrix3d phi_skew = common::skew(phi);
+  if (angle < kSmallAngle) {
+    return Eigen::Matrix3d::Identity() - 0.5 * phi_skew;
+  }
+  const double angle_squared = angle * angle;
+  return Eigen::Matrix3d::Identity() -
+         (1.0 - std::cos(angle)) / angle_squared * phi_skew +
+         (angle - std::sin(angle)) / (angle_squared * angle) * phi_skew *
+             phi_skew;
+}
+
+inline Eigen::Matrix3d inverseRightJacobianSO3(const Eigen::Vector3d& phi) {
+  const double angle = phi.norm();
+  const Eigen::Matrix3d phi_skew = common::skew(phi);
+  if (angle < kSmallAngle) {
+    return Eigen::Matrix3d::Identity() + 0.5 * phi_skew;
+  }
+  return Eigen::Matrix3d::Identity() + 0.5 * phi_skew +
+         (1.0 / (angle * angle) -
+          (1.0 + std::cos(angle)) / (2.0 * angle * std::sin(angle))) *
+             phi_skew * phi_skew;
+}
+
+}  // namespace
+
+constexpr double
+    PreintegratedInertialErrorTerm::kDefaultGyroBiasReintegrationThreshold;
+constexpr double
+    PreintegratedInertialErrorTerm::kDefaultAccelBiasReintegrationThreshold;
+
+void PreintegratedInertialErrorTerm::integrate(
+    const Eigen::Vector3d& b_g, const Eigen::Vector3d& b_a,
+    ImuPreintegration* preintegration) const {
+  CHECK_NOTNULL(preintegration);
+  using imu_integrator::kAccelReadingOffset;
+  using imu_integrator::kErrorStateAccelBiasOffset;
+  using imu_integrator::kErrorStateGyroBiasOffset;
+  using imu_integrator::kErrorStateOrientationOffset;
+  using imu_integrator::kErrorStatePositionOffset;
+  using imu_integrator::kErrorStateVelocityOffset;
+  using imu_integrator::kGyroReadingOffset;
+
+  preintegration->b_g = b_g;
+  preintegration->b_a = b_a;
+  preintegration->delta_R.setIdentity();
+  preintegration->delta_v.setZero();
+  preintegration->delta_p.setZero();
+  preintegration->delta_time_seconds = 0.0;
+  preintegration->J_delta_R_wrt_b_g.setZero();
+  preintegration->J_delta_v_wrt_b_g.setZero();
+  preintegration->J_delta_v_wrt_b_a.setZero();
+  preintegration->J_delta_p_wrt_b_g.setZero();
+  preintegration->J_delta_p_wrt_b_a.setZero();
+  preintegration->covariance.setZero();
+
+  Eigen::Matrix3d& delta_R = preintegration->delta_R;
+  ImuPreintegration::ErrorStateMatrix A;
+  for (int i = 0; i < imu_data_.cols() - 1; ++i) {
+    CHECK_GE(imu_timestamps_(0, i + 1), imu_timestamps_(0, i))
+        << "IMU measurements not properly ordered";
+    const double dt = (imu_timestamps_(0, i + 1) - imu_timestamps_(0, i)) *
+                      imu_integrator::kNanoSecondsToSeconds;
+    const double dt_squared = dt * dt;
+
+    // The readings are averaged over the interval.
+    const Eigen::Vector3d omega =
+        0.5 * (imu_data_.col(i).segment<3>(kGyroReadingOffset) +
+               imu_data_.col(i + 1).segment<3>(kGyroReadingOffset)) -
+        b_g;
+    const Eigen::Vector3d acc =
+        0.5 * (imu_data_.col(i).segment<3>(kAccelReadingOffset) +
+               imu_data_.col(i + 1).segment<3>(kAccelReadingOffset)) -
+        b_a;
+    const Eigen::Matrix3d acc_skew = common::skew(acc);
+    const Eigen::Matrix3d step_R = expSO3(omega * dt);
+    const Eigen::Matrix3d step_J_r = rightJacobianSO3(omega * dt);
+
+    // Transition of the error state of the increments.
+    A.setIdentity();
+    A.block<3, 3>(kErrorStateOrientationOffset, kErrorStateOrientationOffset) =
+        step_R.transpose();
+    A.block<3, 3>(kErrorStateOrientationOffset, kErrorStateGyroBiasOffset) =
+        -step_J_r * dt;
+    A.block<3, 3>(kErrorStateVelocityOffset, kErrorStateOrientationOffset) =
+        -delta_R * acc_skew * dt;
+    A.block<3, 3>(kErrorStateVelocityOffset, kErrorStateAccelBiasOffset) =
+        -delta_R * dt;
+    A.block<3, 3>(kErrorStatePositionOffset, kErrorStateOrientationOffset) =
+        -0.5 * delta_R * acc_skew * dt_squared;
+    A.block<3, 3>(kErrorStatePositionOffset, kErrorStateVelocityOffset) =
+        Eigen::Matrix3d::Identity() * dt;
+    A.block<3, 3>(kErrorStatePositionOffset, kErrorStateAccelBiasOffset) =
+        -0.5 * delta_R * dt_squared;
+
+    ImuPreintegration::ErrorStateMatrix& covariance =
+        preintegration->covariance;
+    covariance = A * covariance * A.transpose();
+    covariance.block<3, 3>(
+        kErrorStateOrientationOffset, kErrorStateOrientationOffset) +=
+        gyro_noise_sigma_squared_ * dt * step_J_r * step_J_r.transpose();
+    covariance.block<3, 3>(
+        kErrorStateVelocityOffset, kErrorStateVelocityOffset) +=
+        acc_noise_sigma_squared_ * dt * Eigen::Matrix3d::Identity();
+    covariance.block<3, 3>(
+        kErrorStateVelocityOffset, kErrorStatePositionOffset) +=
+        0.5 * acc_noise_sigma_squared_ * dt_squared *
+        Eigen::Matrix3d::Identity();
+    covariance.block<3, 3>(
+        kErrorStatePositionOffset, kErrorStateVelocityOffset) +=
+        0.5 * acc_noise_sigma_squared_ * dt_squared *
+        Eigen::Matrix3d::Identity();
+    covariance.block<3, 3>(
+        kErrorStatePositionOffset, kErrorStatePositionOffset) +=
+        0.25 * acc_noise_sigma_squared_ * dt_squared * dt *
+        Eigen::Matrix3d::Identity();
+    covariance.block<3, 3>(
+        kErrorStateGyroBiasOffset, kErrorStateGyroBiasOffset) +=
+        gyro_bias_sigma_squared_ * dt * Eigen::Matrix3d::Identity();
+    covariance.block<3, 3>(
+        kErrorStateAccelBiasOffset, kErrorStateAccelBiasOffset) +=
+        acc_bias_sigma_squared_ * dt * Eigen::Matrix3d::Identity();
+
+    // Bias Jacobians, these depend on the increments before this step.
+    preintegration->J_delta_p_wrt_b_g +=
+        preintegration->J_delta_v_wrt_b_g * dt -
+        0.5 * delta_R * acc_skew * preintegration->J_delta_R_wrt_b_g *
+            dt_squared;
+    preintegration->J_delta_p_wrt_b_a +=
+        preintegration->J_delta_v_wrt_b_a * dt - 0.5 * delta_R * dt_squared;
+    preintegration->J_delta_v_wrt_b_g -=
+        delta_R * acc_skew * preintegration->J_delta_R_wrt_b_g * dt;
+    preintegration->J_delta_v_wrt_b_a -= delta_R * dt;
+    preintegration->J_delta_R_wrt_b_g =
+        step_R.transpose() * preintegration->J_delta_R_wrt_b_g -
+        step_J_r * dt;
+
+    // Increments.
+    preintegration->delta_p +=
+        preintegration->delta_v * dt + 0.5 * delta_R * acc * dt_squared;
+    preintegration->delta_v += delta_R * acc * dt;
+    delta_R = delta_R * step_R;
+    preintegration->delta_time_seconds += dt;
+  }
+
+  preintegration->L_cholesky_covariance.compute(preintegration->covariance);
+  preintegration->valid = true;
+  ++num_integrations_;
+}
+
+bool PreintegratedInertialErrorTerm::Evaluate(
+    double const* const* parameters, double* residuals_ptr,
+    double** jacobians) const {
+  enum {
+    kIdxPoseFrom,
+    kIdxGyroBiasFrom,
+    kIdxVelocityFrom,
+    kIdxAccBiasFrom,
+    kIdxPoseTo,
+    kIdxGyroBiasTo,
+    kIdxVelocityTo,
+    kIdxAccBiasTo
+  };
+  using imu_integrator::kErrorStateAccelBiasOffset;
+  using imu_integrator::kErrorStateGyroBiasOffset;
+  using imu_integrator::kErrorStateOrientationOffset;
+  using imu_integrator::kErrorStatePositionOffset;
+  using imu_integrator::kErrorStateSize;
+  using imu_integrator::kErrorStateVelocityOffset;
+
+  // Keep Jacobians in row-major for Ceres, Eigen default is column-major.
+  typedef Eigen::Matrix<double, kErrorStateSize, 3, Eigen::RowMajor>
+      BlockJacobian;
+  typedef Eigen::Matrix<double, kErrorStateSize,
+                        imu_integrator::kStatePoseBlockSize, Eigen::RowMajor>
+      PoseJacobian;
+  typedef Eigen::Matrix<double, kErrorStateSize, 3> MinimalJacobian;
+
+  Eigen::Map<const Eigen::Vector4d> q_I_M_from(parameters[kIdxPoseFrom]);
+  Eigen::Map<const Eigen::Vector3d> b_g_from(parameters[kIdxGyroBiasFrom]);
+  Eigen::Map<const Eigen::Vector3d> v_M_from(parameters[kIdxVelocityFrom]);
+  Eigen::Map<const Eigen::Vector3d> b_a_from(parameters[kIdxAccBiasFrom]);
+  Eigen::Map<const Eigen::Vector3d> p_M_I_from(
+      parameters[kIdxPoseFrom] + imu_integrator::kStateOrientationBlockSize);
+
+  Eigen::Map<const Eigen::Vector4d> q_I_M_to(parameters[kIdxPoseTo]);
+  Eigen::Map<const Eigen::Vector3d> b_g_to(parameters[kIdxGyroBiasTo]);
+  Eigen::Map<const Eigen::Vector3d> v_M_to(parameters[kIdxVelocityTo]);
+  Eigen::Map<const Eigen::Vector3d> b_a_to(parameters[kIdxAccBiasTo]);
+  Eigen::Map<const Eigen::Vector3d> p_M_I_to(
+      parameters[kIdxPoseTo] + imu_integrator::kStateOrientationBlockSize);
+
+  // Only integrate again if the bias moved too far away from the
+  // linearization point of the bias Jacobians.
+  const bool needs_integration =
+      !preintegration_.valid ||
+      (b_g_from - preintegration_.b_g).norm() >
+          gyro_bias_reintegration_threshold_ ||
+      (b_a_from - preintegration_.b_a).norm() >
+          accel_bias_reintegration_threshold_;
+  if (needs_integration) {
+    integrate(b_g_from, b_a_from, &preintegration_);
+  }
+  CHECK(preintegration_.valid);
+  const ImuPreintegration& preintegration = preintegration_;
+
+  // Increments corrected to first order for the current bias.
+  const Eigen::Vector3d delta_b_g = b_g_from - preintegration.b_g;
+  const Eigen::Vector3d delta_b_a = b_a_from - preintegration.b_a;
+  const Eigen::Vector3d delta_R_correction =
+      preintegration.J_delta_R_wrt_b_g * delta_b_g;
+  const Eigen::Matrix3d delta_R =
+      preintegration.delta_R * expSO3(delta_R_correction);
+  const Eigen::Vector3d delta_v = preintegration.delta_v +
+                                  preintegration.J_delta_v_wrt_b_g * delta_b_g +
+                                  preintegration.J_delta_v_wrt_b_a * delta_b_a;
+  const Eigen::Vector3d delta_p = preintegration.delta_p +
+                                  preintegration.J_delta_p_wrt_b_g * delta_b_g +
+                                  preintegration.J_delta_p_wrt_b_a * delta_b_a;
+
+  Eigen::Matrix3d R_I_M_from, R_I_M_to;
+  common::toRotationMatrixJPL(q_I_M_from, &R_I_M_from);
+  common::toRotationMatrixJPL(q_I_M_to, &R_I_M_to);
+
+  const double dt = preintegration.delta_time_seconds;
+  const Eigen::Vector3d g_M(0.0, 0.0, -gravity_magnitude_);
+  const Eigen::Vector3d I_from_v_rel =
+      R_I_M_from * (v_M_to - v_M_from - g_M * dt);
+  const Eigen::Vector3d I_from_p_rel =
+      R_I_M_from *
+      (p_M_I_to - p_M_I_from - v_M_from * dt - 0.5 * g_M * dt * dt);
+  const Eigen::Vector3d rotation_error =
+      logSO3(delta_R.transpose() * R_I_M_from * R_I_M_to.transpose());
+
+  const Eigen::LLT<ImuPreintegration::ErrorStateMatrix>& L_cholesky =
+      preintegration.L_cholesky_covariance;
+
+  if (residuals_ptr) {
+    Eigen::Map<Eigen::Matrix<double, kErrorStateSize, 1> > residuals(
+        residuals_ptr);
+    residuals << rotation_error, b_g_to - b_g_from, I_from_v_rel - delta_v,
+        b_a_to - b_a_from, I_from_p_rel - delta_p;
+    L_cholesky.matrixL().solveInPlace(residuals);
+  } else {
+    LOG(WARNING)
+        << "Skipped residual calculation, since residual pointer was NULL";
+  }
+
+  if (jacobians == nullptr) {
+    return true;
+  }
+
+  const Eigen::Matrix3d J_r_inv = inverseRightJacobianSO3(rotation_error);
+
+  // Ceres applies the Jacobian of the local parameterization on top of
+  // these Jacobians, so the Jacobians w.r.t. the error state are lifted to
+  // the quaternion with the inverse of the local parameterization.
+  JplQuaternionParameterization quat_parameterization;
+  auto fill_pose_jacobian = [&](
+      const double* q_ptr, MinimalJacobian J_theta,
+      const MinimalJacobian& J_position, double* jacobian_ptr) {
+    Eigen::Matrix<double, 4, 3, Eigen::RowMajor> J_quat_local_param;
+    quat_parameterization.ComputeJacobian(q_ptr, J_quat_local_param.data());
+    L_cholesky.matrixL().solveInPlace(J_theta);
+    Eigen::Map<PoseJacobian> J(jacobian_ptr);
+    J.leftCols<imu_integrator::kStateOrientationBlockSize>() =
+        4.0 * J_theta * J_quat_local_param.transpose();
+    J.rightCols<imu_integrator::kPositionBlockSize>() =
+        L_cholesky.matrixL().solve(J_position);
+  };
+  auto fill_block_jacobian = [&](
+      const MinimalJacobian& J_block, double* jacobian_ptr) {
+    Eigen::Map<BlockJacobian> J(jacobian_ptr);
+    J = L_cholesky.matrixL().solve(J_block);
+  };
+
+  if (jacobians[kIdxPoseFrom] != nullptr) {
+    MinimalJacobian J_theta = MinimalJacobian::Zero();
+    J_theta.middleRows<3>(kErrorStateOrientationOffset) =
+        -J_r_inv * R_I_M_to * R_I_M_from.transpose();
+    J_theta.middleRows<3>(kErrorStateVelocityOffset) =
+        common::skew(I_from_v_rel);
+    J_theta.middleRows<3>(kErrorStatePositionOffset) =
+        common::skew(I_from_p_rel);
+    MinimalJacobian J_position = MinimalJacobian::Zero();
+    J_position.middleRows<3>(kErrorStatePositionOffset) = -R_I_M_from;
+    fill_pose_jacobian(
+        parameters[kIdxPoseFrom], J_theta, J_position,
+        jacobians[kIdxPoseFrom]);
+  }
+  if (jacobians[kIdxGyroBiasFrom] != nullptr) {
+    MinimalJacobian J_b_g = MinimalJacobian::Zero();
+    J_b_g.middleRows<3>(kErrorStateOrientationOffset) =
+        -J_r_inv * expSO3(rotation_error).transpose() *
+        rightJacobianSO3(delta_R_correction) *
+        preintegration.J_delta_R_wrt_b_g;
+    J_b_g.middleRows<3>(kErrorStateGyroBiasOffset) =
+        -Eigen::Matrix3d::Identity();
+    J_b_g.middleRows<3>(kErrorStateVelocityOffset) =
+        -preintegration.J_delta_v_wrt_b_g;
+    J_b_g.middleRows<3>(kErrorStatePositionOffset) =
+        -preintegration.J_delta_p_wrt_b_g;
+    fill_block_jacobian(J_b_g, jacobians[kIdxGyroBiasFrom]);
+  }
+  if (jacobians[kIdxVelocityFrom] != nullptr) {
+    MinimalJacobian J_v = MinimalJacobian::Zero();
+    J_v.middleRows<3>(kErrorStateVelocityOffset) = -R_I_M_from;
+    J_v.middleRows<3>(kErrorStatePositionOffset) = -R_I_M_from * dt;
+    fill_block_jacobian(J_v, jacobians[kIdxVelocityFrom]);
+  }
+  if (jacobians[kIdxAccBiasFrom] != nullptr) {
+    MinimalJacobian J_b_a = MinimalJacobian::Zero();
+    J_b_a.middleRows<3>(kErrorStateAccelBiasOffset) =
+        -Eigen::Matrix3d::Identity();
+    J_b_a.middleRows<3>(kErrorStateVelocityOffset) =
+        -preintegration.J_delta_v_wrt_b_a;
+    J_b_a.middleRows<3>(kErrorStatePositionOffset) =
+        -preintegration.J_delta_p_wrt_b_a;
+    fill_block_jacobian(J_b_a, jacobians[kIdxAccBiasFrom]);
+  }
+
+  if (jacobians[kIdxPoseTo] != nullptr) {
+    MinimalJacobian J_theta = MinimalJacobian::Zero();
+    J_theta.middleRows<3>(kErrorStateOrientationOffset) = J_r_inv;
+    MinimalJacobian J_position = MinimalJacobian::Zero();
+    J_position.middleRows<3>(kErrorStatePositionOffset) = R_I_M_from;
+    fill_pose_jacobian(
+        parameters[kIdxPoseTo], J_theta, J_position, jacobians[kIdxPoseTo]);
+  }
+  if (jacobians[kIdxGyroBiasTo] != nullptr) {
+    MinimalJacobian J_b_g = MinimalJacobian::Zero();
+    J_b_g.middleRows<3>(kErrorStateGyroBiasOffset).setIdentity();
+    fill_block_jacobian(J_b_g, jacobians[kIdxGyroBiasTo]);
+  }
+  if (jacobians[kIdxVelocityTo] != nullptr) {
+    MinimalJacobian J_v = MinimalJacobian::Zero();
+    J_v.middleRows<3>(kErrorStateVelocityOffset) = R_I_M_from;
+    fill_block_jacobian(J_v, jacobians[kIdxVelocityTo]);
+  }
+  if (jacobians[kIdxAccBiasTo] != nullptr) {
+    MinimalJacobian J_b_a = MinimalJacobian::Zero();
+    J_b_a.middleRows<3>(kErrorStateAccelBiasOffset).setIdentity();
+    fill_block_jacobian(J_b_a, jacobians[kIdxAccBiasTo]);
+  }
+  return true;
+}
+
+}  // namespace ceres_error_terms
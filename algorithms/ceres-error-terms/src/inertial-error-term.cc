@@ -38,6 +38,7 @@ void InertialErrorTerm::IntegrateStateAndCovariance(
   InertialStateCovariance phi;
   InertialStateCovariance new_phi_accum;
   InertialStateCovariance Q;
+  InertialStateCovariance phi_Q_accum;
   InertialStateCovariance new_Q_accum;
 
   Q_accum->setZero();
@@ -81,10 +82,18 @@ void InertialErrorTerm::IntegrateStateAndCovariance(
         &next_state_vec, &phi, &Q);
 
     current_state_vec = next_state_vec;
-    new_Q_accum = phi * (*Q_accum) * phi.transpose() + Q;
+    // Q_accum is symmetric: phi * Q_accum * phi^T = phi * (phi * Q_accum)^T.
+    imu_integrator::ImuIntegratorRK4::multiplyTransition(
+        phi, *Q_accum, &phi_Q_accum);
+    const InertialStateCovariance phi_Q_accum_transposed =
+        phi_Q_accum.transpose();
+    imu_integrator::ImuIntegratorRK4::multiplyTransition(
+        phi, phi_Q_accum_transposed, &new_Q_accum);
+    new_Q_accum += Q;
 
     Q_accum->swap(new_Q_accum);
-    new_phi_accum = phi * (*phi_accum);
+    imu_integrator::ImuIntegratorRK4::multiplyTransition(
+        phi, *phi_accum, &new_phi_accum);
     phi_accum->swap(new_phi_accum);
   }
 
@@ -0,0 +1,185 @@
+#include "ceres-error-terms/loop-closure-edge-error-term-analytic.h"
+
+#include <glog/logging.h>
+#include <maplab-common/geometry.h>
+#include <maplab-common/quaternion-math.h>
+
+#include "ceres-error-terms/parameterization/quaternion-param-jpl.h"
+
+namespace ceres_error_terms {
+
+namespace {
+
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 6> LocalPoseJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize,
+                      poseblocks::kPoseSize, Eigen::RowMajor>
+    PoseJacobian;
+
+// Converts a Jacobian w.r.t. the local pose perturbation [delta_theta,
+// delta_p] to the pose block, see BlockPosePriorErrorTerm.
+void setPoseJacobian(
+    const double* q_JPL, const LocalPoseJacobian& J_local, double* J_global) {
+  CHECK_NOTNULL(q_JPL);
+  CHECK_NOTNULL(J_global);
+
+  Eigen::Matrix<double, 4, 3, Eigen::RowMajor> J_quaternion_local;
+  JplQuaternionParameterization parameterization;
+  parameterization.ComputeJacobian(q_JPL, J_quaternion_local.data());
+
+  Eigen::Map<PoseJacobian> J(J_global);
+  J.leftCols<poseblocks::kOrientationBlockSize>() =
+      J_local.leftCols<3>() * 4.0 * J_quaternion_local.transpose();
+  J.rightCols<poseblocks::kPositionBlockSize>() = J_local.rightCols<3>();
+}
+
+}  // namespace
+
+constexpr int LoopClosureEdgeErrorTermAnalyticBase::kResidualBlockSize;
+constexpr int LoopClosureEdgeErrorTermAnalyticBase::kSwitchVariableBlockSize;
+
+const double
+    LoopClosureEdgeErrorTermAnalyticBase::kIdentityPose[poseblocks::kPoseSize] =
+        {0., 0., 0., 1., 0., 0., 0.};
+
+LoopClosureEdgeErrorTermAnalyticBase::LoopClosureEdgeErrorTermAnalyticBase(
+    const Eigen::Matrix<double, 7, 1>& q_AB__A_p_AB,
+    const Eigen::Matrix<double, 6, 6>& T_A_B_covariance)
+    : q_AB_(q_AB__A_p_AB.head<poseblocks::kOrientationBlockSize>()),
+      A_p_AB_(q_AB__A_p_AB.tail<poseblocks::kPositionBlockSize>()) {
+  const Eigen::Matrix<double, 6, 6> L = T_A_B_covariance.llt().matrixL();
+  sqrt_information_matrix_.setIdentity();
+  L.triangularView<Eigen::Lower>().solveInPlace(sqrt_information_matrix_);
+}
+
+LoopClosureEdgeErrorTermAnalyticBase::LoopClosureEdgeErrorTermAnalyticBase(
+    const pose::Transformation& T_A_B,
+    const Eigen::Matrix<double, 6, 6>& T_A_B_covariance)
+    : LoopClosureEdgeErrorTermAnalyticBase(
+          (Eigen::Matrix<double, 7, 1>()
+               << T_A_B.getRotation().toImplementation().inverse().coeffs(),
+           T_A_B.getPosition())
+              .finished(),
+          T_A_B_covariance) {
+  // The weighting is applied as error^T * W, flipping the sign of the
+  // orientation error is the same as flipping the rows of W.
+  sqrt_information_matrix_.bottomRows<3>() *= -1.0;
+}
+
+void LoopClosureEdgeErrorTermAnalyticBase::evaluate(
+    const double* T_G_MA, const double* T_MA_IA, const double* T_G_MB,
+    const double* T_MB_IB, const double switch_variable, double* residuals,
+    double* J_T_G_MA, double* J_T_MA_IA, double* J_T_G_MB, double* J_T_MB_IB,
+    double* J_switch_variable) const {
+  CHECK_NOTNULL(T_G_MA);
+  CHECK_NOTNULL(T_MA_IA);
+  CHECK_NOTNULL(T_G_MB);
+  CHECK_NOTNULL(T_MB_IB);
+  CHECK_NOTNULL(residuals);
+
+  const Eigen::Map<const Eigen::Vector4d> q_G_MA(T_G_MA);
+  const Eigen::Map<const Eigen::Vector4d> q_IA_MA(T_MA_IA);
+  const Eigen::Map<const Eigen::Vector4d> q_G_MB(T_G_MB);
+  const Eigen::Map<const Eigen::Vector4d> q_IB_MB(T_MB_IB);
+  const Eigen::Map<const Eigen::Vector3d> p_G_MA(
+      T_G_MA + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_MA_IA(
+      T_MA_IA + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_G_MB(
+      T_G_MB + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_MB_IB(
+      T_MB_IB + poseblocks::kOrientationBlockSize);
+
+  Eigen::Matrix3d R_G_MA;
+  common::toRotationMatrixJPL(q_G_MA, &R_G_MA);
+  Eigen::Matrix3d R_G_MB;
+  common::toRotationMatrixJPL(q_G_MB, &R_G_MB);
+
+  const Eigen::Vector3d G_p_MA_IA = R_G_MA * p_MA_IA;
+  const Eigen::Vector3d G_p_MB_IB = R_G_MB * p_MB_IB;
+  const Eigen::Vector3d G_p_IA_IB =
+      p_G_MB + G_p_MB_IB - (p_G_MA + G_p_MA_IA);
+
+  // Same sequence of products as in LoopClosureEdgeErrorTerm.
+  Eigen::Vector4d q_G_IA;
+  common::positiveQuaternionProductJPL(
+      q_G_MA, common::quaternionInverseJPL(q_IA_MA), q_G_IA);
+  Eigen::Vector4d q_G_IB;
+  common::positiveQuaternionProductJPL(
+      q_G_MB, common::quaternionInverseJPL(q_IB_MB), q_G_IB);
+  Eigen::Vector4d q_IA_IB_estimated;
+  common::positiveQuaternionProductJPL(
+      common::quaternionInverseJPL(q_G_IA), q_G_IB, q_IA_IB_estimated);
+  Eigen::Vector4d q_IB_lc_IB_estimated;
+  common::positiveQuaternionProductJPL(
+      common::quaternionInverseJPL(q_AB_), q_IA_IB_estimated,
+      q_IB_lc_IB_estimated);
+
+  Eigen::Matrix3d R_IA_G;
+  common::toRotationMatrixJPL(common::quaternionInverseJPL(q_G_IA), &R_IA_G);
+
+  Eigen::Matrix<double, 6, 1> error;
+  error.head<3>() = R_IA_G * G_p_IA_IB - A_p_AB_;
+  error.tail<3>() = 2.0 * q_IB_lc_IB_estimated.head<3>();
+
+  const Eigen::Matrix<double, 6, 1> weighted_error =
+      sqrt_information_matrix_.transpose() * error;
+  Eigen::Map<Eigen::Matrix<double, 6, 1>> residual_vector(residuals);
+  residual_vector = switch_variable * weighted_error;
+  if (J_switch_variable != nullptr) {
+    Eigen::Map<Eigen::Matrix<double, 6, 1>> J_switch(J_switch_variable);
+    J_switch = weighted_error;
+  }
+
+  if (J_T_G_MA == nullptr && J_T_MA_IA == nullptr && J_T_G_MB == nullptr &&
+      J_T_MB_IB == nullptr) {
+    return;
+  }
+
+  // Jacobians of the error w.r.t. the local perturbations of the poses. The
+  // JPL parameterization perturbs the rotations as R_new = (I - [d_theta]x) R.
+  // With the error quaternion perturbed as q_err * dq(M * d_theta), the
+  // orientation error changes by (w * I - [v]x) * M * d_theta.
+  Eigen::Matrix3d R_G_IB;
+  common::toRotationMatrixJPL(q_G_IB, &R_G_IB);
+  const Eigen::Matrix3d R_IB_G = R_G_IB.transpose();
+  const Eigen::Matrix3d d_orientation_error_d_theta =
+      q_IB_lc_IB_estimated(3) * Eigen::Matrix3d::Identity() -
+      common::skew(q_IB_lc_IB_estimated.head<3>());
+  const Eigen::Matrix<double, 6, 6> weighting =
+      switch_variable * sqrt_information_matrix_.transpose();
+
+  LocalPoseJacobian J_error;
+  if (J_T_MA_IA != nullptr) {
+    Eigen::Matrix3d R_IA_MA;
+    common::toRotationMatrixJPL(q_IA_MA, &R_IA_MA);
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() = common::skew(R_IA_G * G_p_IA_IB);
+    J_error.topRightCorner<3, 3>() = -R_IA_MA;
+    J_error.bottomLeftCorner<3, 3>() =
+        d_orientation_error_d_theta * R_IB_G * R_IA_G.transpose();
+    setPoseJacobian(T_MA_IA, weighting * J_error, J_T_MA_IA);
+  }
+  if (J_T_MB_IB != nullptr) {
+    J_error.setZero();
+    J_error.topRightCorner<3, 3>() = R_IA_G * R_G_MB;
+    J_error.bottomLeftCorner<3, 3>() = -d_orientation_error_d_theta;
+    setPoseJacobian(T_MB_IB, weighting * J_error, J_T_MB_IB);
+  }
+  if (J_T_G_MA != nullptr) {
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() =
+        -R_IA_G * common::skew(Eigen::Vector3d(G_p_IA_IB + G_p_MA_IA));
+    J_error.topRightCorner<3, 3>() = -R_IA_G;
+    J_error.bottomLeftCorner<3, 3>() = -d_orientation_error_d_theta * R_IB_G;
+    setPoseJacobian(T_G_MA, weighting * J_error, J_T_G_MA);
+  }
+  if (J_T_G_MB != nullptr) {
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() = R_IA_G * common::skew(G_p_MB_IB);
+    J_error.topRightCorner<3, 3>() = R_IA_G;
+    J_error.bottomLeftCorner<3, 3>() = d_orientation_error_d_theta * R_IB_G;
+    setPoseJacobian(T_G_MB, weighting * J_error, J_T_G_MB);
+  }
+}
+
+}  // namespace ceres_error_terms
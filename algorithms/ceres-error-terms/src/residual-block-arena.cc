@@ -0,0 +1,63 @@
+#include "ceres-error-terms/residual-block-arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace ceres_error_terms {
+
+constexpr size_t ResidualBlockArena::kDefaultBlockSizeBytes;
+
+ResidualBlockArena::ResidualBlockArena(const size_t block_size_bytes)
+    : block_size_bytes_(block_size_bytes), used_bytes_in_last_block_(0u) {
+  CHECK_GT(block_size_bytes_, 0u);
+}
+
+ResidualBlockArena::~ResidualBlockArena() {
+  for (std::vector<std::pair<void*, void (*)(void*)>>::reverse_iterator it =
+           destructors_.rbegin();
+       it != destructors_.rend(); ++it) {
+    it->second(it->first);
+  }
+}
+
+size_t ResidualBlockArena::getNumBytesReserved() const {
+  size_t num_bytes = 0u;
+  for (const Block& block : blocks_) {
+    num_bytes += block.size_bytes;
+  }
+  return num_bytes;
+}
+
+void* ResidualBlockArena::allocate(
+    const size_t size_bytes, const size_t alignment) {
+  CHECK_GT(alignment, 0u);
+  CHECK_EQ(alignment & (alignment - 1u), 0u)
+      << "The alignment has to be a power of two.";
+
+  if (!blocks_.empty()) {
+    const Block& block = blocks_.back();
+    const uintptr_t block_begin =
+        reinterpret_cast<uintptr_t>(block.memory.get());
+    const uintptr_t aligned_address =
+        (block_begin + used_bytes_in_last_block_ + alignment - 1u) &
+        ~static_cast<uintptr_t>(alignment - 1u);
+    const size_t end_offset = aligned_address - block_begin + size_bytes;
+    if (end_offset <= block.size_bytes) {
+      used_bytes_in_last_block_ = end_offset;
+      return reinterpret_cast<void*>(aligned_address);
+    }
+  }
+
+  // Objects larger than a block get a block of their own.
+  Block new_block;
+  new_block.size_bytes = std::max(block_size_bytes_, size_bytes + alignment);
+  new_block.memory.reset(new char[new_block.size_bytes]);
+  blocks_.emplace_back(std::move(new_block));
+  used_bytes_in_last_block_ = 0u;
+  return allocate(size_bytes, alignment);
+}
+
+}  // namespace ceres_error_terms
@@ -0,0 +1,238 @@
+#include "ceres-error-terms/six-dof-block-pose-error-term-analytic.h"
+
+#include <glog/logging.h>
+#include <maplab-common/geometry.h>
+
+#include "ceres-error-terms/parameterization/quaternion-param-jpl.h"
+
+namespace ceres_error_terms {
+
+namespace {
+
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 3> LocalJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 6> LocalPoseJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize,
+                      poseblocks::kOrientationBlockSize, Eigen::RowMajor>
+    OrientationJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize,
+                      poseblocks::kPositionBlockSize, Eigen::RowMajor>
+    PositionJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize,
+                      poseblocks::kPoseSize, Eigen::RowMajor>
+    PoseJacobian;
+
+Eigen::Matrix<double, 6, 6> getSqrtInformationMatrix(
+    const Eigen::Matrix<double, 6, 6>& covariance) {
+  const Eigen::Matrix<double, 6, 6> L = covariance.llt().matrixL();
+  Eigen::Matrix<double, 6, 6> sqrt_information_matrix =
+      Eigen::Matrix<double, 6, 6>::Identity();
+  L.triangularView<Eigen::Lower>().solveInPlace(sqrt_information_matrix);
+  return sqrt_information_matrix;
+}
+
+// Converts a Jacobian w.r.t. the local rotation perturbation to the quaternion
+// coefficients, see BlockPosePriorErrorTerm.
+Eigen::Matrix<double, poseblocks::kResidualSize, 4> getOrientationJacobian(
+    const double* q, const LocalJacobian& J_local) {
+  CHECK_NOTNULL(q);
+  Eigen::Matrix<double, 4, 3, Eigen::RowMajor> J_quaternion_local;
+  JplQuaternionParameterization parameterization;
+  parameterization.ComputeJacobian(q, J_quaternion_local.data());
+  return J_local * 4.0 * J_quaternion_local.transpose();
+}
+
+void setPoseJacobian(
+    const double* pose, const LocalPoseJacobian& J_local, double* J_global) {
+  CHECK_NOTNULL(J_global);
+  Eigen::Map<PoseJacobian> J(J_global);
+  J.leftCols<poseblocks::kOrientationBlockSize>() =
+      getOrientationJacobian(pose, J_local.leftCols<3>());
+  J.rightCols<poseblocks::kPositionBlockSize>() = J_local.rightCols<3>();
+}
+
+// The orientation error is 2 * vec(q_err) of a Hamilton quaternion with a
+// positive scalar part. Perturbing it as q_err * dq(phi) changes the error by
+// (w * I + [v]x) * phi.
+Eigen::Matrix3d getOrientationErrorJacobian(const Eigen::Quaterniond& q_err) {
+  return q_err.w() * Eigen::Matrix3d::Identity() + common::skew(q_err.vec());
+}
+
+}  // namespace
+
+SixDoFBlockPoseErrorTermAnalytic::SixDoFBlockPoseErrorTermAnalytic(
+    const pose::Transformation& T_A_B,
+    const Eigen::Matrix<double, 6, 6>& T_A_B_covariance)
+    : q_A_B_(T_A_B.getRotation().toImplementation()),
+      p_A_B_(T_A_B.getPosition()),
+      sqrt_information_matrix_(getSqrtInformationMatrix(T_A_B_covariance)) {}
+
+bool SixDoFBlockPoseErrorTermAnalytic::Evaluate(
+    double const* const* parameters, double* residuals,
+    double** jacobians) const {
+  CHECK_NOTNULL(parameters);
+  CHECK_NOTNULL(residuals);
+
+  // Like the autodiff version, the coefficients are taken as the Hamilton
+  // quaternions q_G_A and q_G_B.
+  const Eigen::Map<const Eigen::Quaterniond> q_G_A(parameters[kIdxPoseA]);
+  const Eigen::Map<const Eigen::Quaterniond> q_G_B(parameters[kIdxPoseB]);
+  const Eigen::Map<const Eigen::Vector3d> p_G_A(
+      parameters[kIdxPoseA] + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_G_B(
+      parameters[kIdxPoseB] + poseblocks::kOrientationBlockSize);
+
+  Eigen::Quaterniond q_A_measured_A_estimated =
+      q_A_B_.conjugate() * q_G_A.conjugate() * q_G_B;
+  if (q_A_measured_A_estimated.w() < 0.) {
+    q_A_measured_A_estimated.coeffs() = -q_A_measured_A_estimated.coeffs();
+  }
+
+  const Eigen::Matrix3d R_A_G = q_G_A.toRotationMatrix().transpose();
+  const Eigen::Vector3d A_p_A_B = R_A_G * (p_G_B - p_G_A);
+
+  Eigen::Matrix<double, 6, 1> error;
+  error.head<3>() = A_p_A_B - p_A_B_;
+  error.tail<3>() = 2.0 * q_A_measured_A_estimated.vec();
+
+  Eigen::Map<Eigen::Matrix<double, 6, 1>> residual_vector(residuals);
+  residual_vector = sqrt_information_matrix_.transpose() * error;
+
+  if (jacobians == nullptr) {
+    return true;
+  }
+
+  // The JPL parameterization perturbs these Hamilton rotations from the
+  // right, R_G_A_new = R_G_A * (I + [d_theta]x).
+  const Eigen::Matrix3d d_orientation_error_d_phi =
+      getOrientationErrorJacobian(q_A_measured_A_estimated);
+  const Eigen::Matrix<double, 6, 6> weighting =
+      sqrt_information_matrix_.transpose();
+
+  LocalPoseJacobian J_error;
+  if (jacobians[kIdxPoseA] != nullptr) {
+    const Eigen::Matrix3d R_B_A =
+        (R_A_G * q_G_B.toRotationMatrix()).transpose();
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() = common::skew(A_p_A_B);
+    J_error.topRightCorner<3, 3>() = -R_A_G;
+    J_error.bottomLeftCorner<3, 3>() = -d_orientation_error_d_phi * R_B_A;
+    setPoseJacobian(
+        parameters[kIdxPoseA], weighting * J_error, jacobians[kIdxPoseA]);
+  }
+  if (jacobians[kIdxPoseB] != nullptr) {
+    J_error.setZero();
+    J_error.topRightCorner<3, 3>() = R_A_G;
+    J_error.bottomLeftCorner<3, 3>() = d_orientation_error_d_phi;
+    setPoseJacobian(
+        parameters[kIdxPoseB], weighting * J_error, jacobians[kIdxPoseB]);
+  }
+  return true;
+}
+
+SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic::
+    SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic(
+        const pose::Transformation& T_Bk_Bkp1,
+        const Eigen::Matrix<double, 6, 6>& T_Bk_Bkp1_covariance)
+    : q_Bk_Bkp1_(T_Bk_Bkp1.getRotation().toImplementation()),
+      p_Bk_Bkp1_(T_Bk_Bkp1.getPosition()),
+      sqrt_information_matrix_(
+          getSqrtInformationMatrix(T_Bk_Bkp1_covariance)) {}
+
+bool SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic::Evaluate(
+    double const* const* parameters, double* residuals,
+    double** jacobians) const {
+  CHECK_NOTNULL(parameters);
+  CHECK_NOTNULL(residuals);
+
+  const Eigen::Map<const Eigen::Quaterniond> q_G_Ik(parameters[kIdxPoseK]);
+  const Eigen::Map<const Eigen::Quaterniond> q_G_Ikp1(
+      parameters[kIdxPoseKp1]);
+  const Eigen::Map<const Eigen::Quaterniond> q_I_B(
+      parameters[kIdxOrientationIB]);
+  const Eigen::Map<const Eigen::Vector3d> p_G_Ik(
+      parameters[kIdxPoseK] + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_G_Ikp1(
+      parameters[kIdxPoseKp1] + poseblocks::kOrientationBlockSize);
+  const Eigen::Map<const Eigen::Vector3d> p_B_I(parameters[kIdxPositionBI]);
+
+  // T_Bk_Bkp1 = T_B_I * T_G_Ik^-1 * T_G_Ikp1 * T_B_I^-1.
+  const Eigen::Matrix3d R_Ik_G = q_G_Ik.toRotationMatrix().transpose();
+  const Eigen::Matrix3d R_G_Ikp1 = q_G_Ikp1.toRotationMatrix();
+  const Eigen::Matrix3d R_B_I = q_I_B.toRotationMatrix().transpose();
+  const Eigen::Matrix3d R_Bk_Ikp1 = R_B_I * R_Ik_G * R_G_Ikp1;
+  const Eigen::Matrix3d R_Bk_Bkp1 = R_Bk_Ikp1 * R_B_I.transpose();
+  const Eigen::Vector3d I_p_I_B = -R_B_I.transpose() * p_B_I;
+  const Eigen::Vector3d G_p_Ik_Bkp1 = p_G_Ikp1 + R_G_Ikp1 * I_p_I_B - p_G_Ik;
+  const Eigen::Vector3d p_Bk_Bkp1_estimated =
+      R_B_I * R_Ik_G * G_p_Ik_Bkp1 + p_B_I;
+
+  Eigen::Quaterniond q_Bk_measurement_Bk_estimated =
+      q_Bk_Bkp1_.conjugate() * q_I_B.conjugate() * q_G_Ik.conjugate() *
+      q_G_Ikp1 * q_I_B;
+  if (q_Bk_measurement_Bk_estimated.w() < 0.) {
+    q_Bk_measurement_Bk_estimated.coeffs() =
+        -q_Bk_measurement_Bk_estimated.coeffs();
+  }
+
+  Eigen::Matrix<double, 6, 1> error;
+  error.head<3>() = p_Bk_Bkp1_ - p_Bk_Bkp1_estimated;
+  error.tail<3>() = 2.0 * q_Bk_measurement_Bk_estimated.vec();
+
+  Eigen::Map<Eigen::Matrix<double, 6, 1>> residual_vector(residuals);
+  residual_vector = sqrt_information_matrix_.transpose() * error;
+
+  if (jacobians == nullptr) {
+    return true;
+  }
+
+  // The JPL parameterization perturbs these Hamilton rotations from the
+  // right, e.g. R_G_Ik_new = R_G_Ik * (I + [d_theta]x).
+  const Eigen::Matrix3d d_orientation_error_d_phi =
+      getOrientationErrorJacobian(q_Bk_measurement_Bk_estimated);
+  const Eigen::Matrix<double, 6, 6> weighting =
+      sqrt_information_matrix_.transpose();
+
+  if (jacobians[kIdxPoseK] != nullptr) {
+    LocalPoseJacobian J_error;
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() =
+        -R_B_I * common::skew(Eigen::Vector3d(R_Ik_G * G_p_Ik_Bkp1));
+    J_error.topRightCorner<3, 3>() = R_B_I * R_Ik_G;
+    J_error.bottomLeftCorner<3, 3>() =
+        -d_orientation_error_d_phi * R_Bk_Bkp1.transpose() * R_B_I;
+    setPoseJacobian(
+        parameters[kIdxPoseK], weighting * J_error, jacobians[kIdxPoseK]);
+  }
+  if (jacobians[kIdxPoseKp1] != nullptr) {
+    LocalPoseJacobian J_error;
+    J_error.setZero();
+    J_error.topLeftCorner<3, 3>() = R_Bk_Ikp1 * common::skew(I_p_I_B);
+    J_error.topRightCorner<3, 3>() = -R_B_I * R_Ik_G;
+    J_error.bottomLeftCorner<3, 3>() = d_orientation_error_d_phi * R_B_I;
+    setPoseJacobian(
+        parameters[kIdxPoseKp1], weighting * J_error, jacobians[kIdxPoseKp1]);
+  }
+  if (jacobians[kIdxOrientationIB] != nullptr) {
+    LocalJacobian J_error;
+    J_error.topRows<3>() =
+        common::skew(Eigen::Vector3d(R_Bk_Bkp1 * p_B_I)) -
+        common::skew(Eigen::Vector3d(R_B_I * R_Ik_G * (p_G_Ikp1 - p_G_Ik))) -
+        R_Bk_Bkp1 * common::skew(p_B_I);
+    J_error.bottomRows<3>() =
+        d_orientation_error_d_phi *
+        (Eigen::Matrix3d::Identity() - R_Bk_Bkp1.transpose());
+    Eigen::Map<OrientationJacobian> J(jacobians[kIdxOrientationIB]);
+    J = getOrientationJacobian(
+        parameters[kIdxOrientationIB], weighting * J_error);
+  }
+  if (jacobians[kIdxPositionBI] != nullptr) {
+    LocalJacobian J_error;
+    J_error.topRows<3>() = R_Bk_Bkp1 - Eigen::Matrix3d::Identity();
+    J_error.bottomRows<3>().setZero();
+    Eigen::Map<PositionJacobian> J(jacobians[kIdxPositionBI]);
+    J = weighting * J_error;
+  }
+  return true;
+}
+
+}  // namespace ceres_error_terms
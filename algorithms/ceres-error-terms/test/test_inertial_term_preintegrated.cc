@@ -0,0 +1,304 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <ceres-error-terms/inertial-error-term-preintegrated.h>
+#include <ceres-error-terms/parameterization/pose-param-jpl.h>
+#include <maplab-common/gravity-provider.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+using ceres_error_terms::PreintegratedInertialErrorTerm;
+
+class PreintegratedInertialErrorTermTest : public ::testing::Test {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  virtual void SetUp() {
+    rot0_.coeffs() << 0, 0, 0, 1;
+    rot1_.coeffs() << 0, 0, 0, 1;
+    pos0_ << 0, 0, 0;
+    pos1_ << 1.5, 0, 0;
+
+    accel_bias0_ << 0, 0, 0;
+    accel_bias1_ << 0, 0, 0;
+    gyro_bias0_ << 0, 0, 0;
+    gyro_bias1_ << 0, 0, 0;
+
+    velocity0_ << 1, 0, 0;
+    velocity1_ << 2, 0, 0;
+
+    common::GravityProvider gravity_provider(
+        common::locations::kAltitudeZurichMeters,
+        common::locations::kLatitudeZurichDegrees);
+    gravity_magnitude_ = gravity_provider.getGravityMagnitude();
+
+    imu_timestamps_.resize(Eigen::NoChange, 3);
+    imu_data_.resize(Eigen::NoChange, 3);
+    imu_timestamps_ << 0, 0.5 * 1e9, 1.0 * 1e9;
+    imu_data_ << 1, 1, 1, 0, 0, 0, gravity_magnitude_, gravity_magnitude_,
+        gravity_magnitude_, 0, 0, 0, 0, 0, 0, 0, 0, 0;
+  }
+
+  // IMU measurements of a rotating and accelerating IMU at 200 Hz.
+  void createRotatingImuData() {
+    constexpr int kNumMeasurements = 41;
+    constexpr double kDeltaTimeSeconds = 0.005;
+    imu_timestamps_.resize(Eigen::NoChange, kNumMeasurements);
+    imu_data_.resize(Eigen::NoChange, kNumMeasurements);
+    for (int i = 0; i < kNumMeasurements; ++i) {
+      const double time_seconds = i * kDeltaTimeSeconds;
+      imu_timestamps_(0, i) = static_cast<int64_t>(time_seconds * 1e9);
+      imu_data_.col(i) << 0.3 * std::sin(3.0 * time_seconds),
+          0.2 * std::cos(2.0 * time_seconds),
+          gravity_magnitude_ + 0.5 * std::sin(time_seconds),
+          0.2 * std::sin(time_seconds), 0.3 * std::cos(2.0 * time_seconds),
+          0.1 + 0.1 * time_seconds;
+    }
+  }
+
+  void addResidual() {
+    rot0_.normalize();
+    rot1_.normalize();
+    pose0_ << rot0_.coeffs(), pos0_;
+    pose1_ << rot1_.coeffs(), pos1_;
+
+    inertial_term_ = new PreintegratedInertialErrorTerm(
+        imu_data_, imu_timestamps_, 1, 1, 1, 1, gravity_magnitude_);
+
+    problem_.AddResidualBlock(
+        inertial_term_, NULL, pose0_.data(), gyro_bias0_.data(),
+        velocity0_.data(), accel_bias0_.data(), pose1_.data(),
+        gyro_bias1_.data(), velocity1_.data(), accel_bias1_.data());
+
+    ceres::LocalParameterization* pose_parameterization =
+        new ceres_error_terms::JplPoseParameterization;
+    problem_.SetParameterization(pose0_.data(), pose_parameterization);
+    problem_.SetParameterization(pose1_.data(), pose_parameterization);
+  }
+
+  void solve() {
+    ceres::Solver::Options options;
+    options.linear_solver_type = ceres::DENSE_SCHUR;
+    options.minimizer_progress_to_stdout = false;
+    options.max_num_iterations = 500;
+    options.gradient_tolerance = 1e-50;
+    options.function_tolerance = 1e-50;
+    options.parameter_tolerance = 1e-50;
+
+    ceres::Solve(options, &problem_, &summary_);
+
+    LOG(INFO) << summary_.message;
+    LOG(INFO) << summary_.BriefReport();
+  }
+
+  void setStatesConstantExcept(const double* variable_state) {
+    for (double* state :
+         {pose0_.data(), gyro_bias0_.data(), velocity0_.data(),
+          accel_bias0_.data(), pose1_.data(), gyro_bias1_.data(),
+          velocity1_.data(), accel_bias1_.data()}) {
+      if (state != variable_state) {
+        problem_.SetParameterBlockConstant(state);
+      }
+    }
+  }
+
+  ceres::Problem problem_;
+  ceres::Solver::Summary summary_;
+  // Owned by the problem.
+  PreintegratedInertialErrorTerm* inertial_term_;
+
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps_;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data_;
+
+  Eigen::Quaterniond rot0_;
+  Eigen::Quaterniond rot1_;
+  Eigen::Vector3d pos0_;
+  Eigen::Vector3d pos1_;
+  Eigen::Matrix<double, 7, 1> pose0_;
+  Eigen::Matrix<double, 7, 1> pose1_;
+
+  Eigen::Vector3d accel_bias0_;
+  Eigen::Vector3d accel_bias1_;
+  Eigen::Vector3d gyro_bias0_;
+  Eigen::Vector3d gyro_bias1_;
+  Eigen::Vector3d velocity0_;
+  Eigen::Vector3d velocity1_;
+
+  double gravity_magnitude_;
+};
+
+TEST_F(PreintegratedInertialErrorTermTest, ZeroCost) {
+  addResidual();
+  solve();
+
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, FinalPositionOptimization) {
+  pos1_ << 1.43, -0.2, 0.175;
+  addResidual();
+  setStatesConstantExcept(pose1_.data());
+
+  solve();
+  EXPECT_NEAR_EIGEN(pose1_.tail(3), Eigen::Vector3d(1.5, 0, 0), 1e-12);
+  EXPECT_NEAR_EIGEN(pose1_.head(4), Eigen::Vector4d(0, 0, 0, 1), 1e-12);
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, FinalRotationOptimization) {
+  rot1_.coeffs() << 0.05, -0.02, 0.1, 1;
+  addResidual();
+  setStatesConstantExcept(pose1_.data());
+
+  solve();
+  EXPECT_NEAR_EIGEN(pose1_.tail(3), Eigen::Vector3d(1.5, 0, 0), 1e-12);
+  EXPECT_NEAR_EIGEN(pose1_.head(4), Eigen::Vector4d(0, 0, 0, 1), 1e-12);
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, StartVelocityOptimization) {
+  velocity0_ << 1.2, 0.1, -0.1;
+  addResidual();
+  setStatesConstantExcept(velocity0_.data());
+
+  solve();
+  EXPECT_NEAR_EIGEN(velocity0_, Eigen::Vector3d(1, 0, 0), 1e-12);
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(PreintegratedInertialErrorTermTest, StartAccelBiasOptimization) {
+  accel_bias0_ << 0.02, -0.01, 0.03;
+  accel_bias1_ = accel_bias0_;
+  addResidual();
+  problem_.SetParameterBlockConstant(pose0_.data());
+  problem_.SetParameterBlockConstant(pose1_.data());
+  problem_.SetParameterBlockConstant(velocity0_.data());
+  problem_.SetParameterBlockConstant(velocity1_.data());
+  problem_.SetParameterBlockConstant(gyro_bias0_.data());
+  problem_.SetParameterBlockConstant(gyro_bias1_.data());
+
+  solve();
+  EXPECT_NEAR_EIGEN(accel_bias0_, Eigen::Vector3d::Zero(), 1e-9);
+  EXPECT_NEAR_EIGEN(accel_bias1_, Eigen::Vector3d::Zero(), 1e-9);
+  EXPECT_LT(summary_.final_cost, 1e-15);
+}
+
+TEST_F(
+    PreintegratedInertialErrorTermTest, JacobiansMatchNumericDifferentiation) {
+  createRotatingImuData();
+  rot0_ = Eigen::AngleAxisd(0.3, Eigen::Vector3d(1, 2, 3).normalized());
+  rot1_ = Eigen::AngleAxisd(0.5, Eigen::Vector3d(1, -2, 3).normalized());
+  pos0_ << 1, 2, 3;
+  pos1_ << 1.2, 2.1, 2.9;
+  gyro_bias0_ << 0.01, -0.02, 0.005;
+  gyro_bias1_ << 0.012, -0.02, 0.004;
+  accel_bias0_ << 0.05, 0.02, -0.03;
+  accel_bias1_ << 0.04, 0.02, -0.02;
+  velocity0_ << 0.5, 0.1, -0.2;
+  velocity1_ << 0.6, 0.2, -0.1;
+  addResidual();
+
+  std::vector<double*> parameters = {
+      pose0_.data(),       gyro_bias0_.data(), velocity0_.data(),
+      accel_bias0_.data(), pose1_.data(),      gyro_bias1_.data(),
+      velocity1_.data(),   accel_bias1_.data()};
+  const std::vector<int> sizes = {7, 3, 3, 3, 7, 3, 3, 3};
+
+  // Move the bias away from the integration bias, so the first-order bias
+  // correction is part of the Jacobians.
+  Eigen::Matrix<double, 15, 1> residuals;
+  ASSERT_TRUE(
+      inertial_term_->Evaluate(parameters.data(), residuals.data(), nullptr));
+  gyro_bias0_(0) += 0.003;
+  accel_bias0_(1) -= 0.01;
+
+  std::vector<Eigen::Matrix<double, 15, Eigen::Dynamic, Eigen::RowMajor> >
+      jacobians(parameters.size());
+  std::vector<double*> jacobian_ptrs(parameters.size());
+  for (size_t i = 0u; i < parameters.size(); ++i) {
+    jacobians[i].resize(15, sizes[i]);
+    jacobian_ptrs[i] = jacobians[i].data();
+  }
+  ASSERT_TRUE(inertial_term_->Evaluate(
+      parameters.data(), residuals.data(), jacobian_ptrs.data()));
+  EXPECT_EQ(inertial_term_->getNumIntegrations(), 1u);
+
+  constexpr double kStep = 1e-6;
+  ceres_error_terms::JplPoseParameterization pose_parameterization;
+  for (size_t i = 0u; i < parameters.size(); ++i) {
+    const bool is_pose = sizes[i] == 7;
+    const int local_size = is_pose ? 6 : 3;
+    Eigen::MatrixXd jacobian = jacobians[i];
+    if (is_pose) {
+      Eigen::Matrix<double, 7, 6, Eigen::RowMajor> J_local;
+      pose_parameterization.ComputeJacobian(parameters[i], J_local.data());
+      jacobian = jacobians[i] * J_local;
+    }
+
+    const std::vector<double> state(
+        parameters[i], parameters[i] + sizes[i]);
+    for (int j = 0; j < local_size; ++j) {
+      Eigen::Matrix<double, 15, 1> residuals_plus, residuals_minus;
+      for (const double sign : {1.0, -1.0}) {
+        Eigen::VectorXd delta = Eigen::VectorXd::Zero(local_size);
+        delta(j) = sign * kStep;
+        if (is_pose) {
+          pose_parameterization.Plus(
+              state.data(), delta.data(), parameters[i]);
+        } else {
+          Eigen::Map<Eigen::VectorXd>(parameters[i], sizes[i]) =
+              Eigen::Map<const Eigen::VectorXd>(state.data(), sizes[i]) +
+              delta;
+        }
+        ASSERT_TRUE(inertial_term_->Evaluate(
+            parameters.data(),
+            sign > 0.0 ? residuals_plus.data() : residuals_minus.data(),
+            nullptr));
+      }
+      std::copy(state.begin(), state.end(), parameters[i]);
+      const Eigen::Matrix<double, 15, 1> numeric_jacobian =
+          (residuals_plus - residuals_minus) / (2.0 * kStep);
+      EXPECT_NEAR_EIGEN(jacobian.col(j), numeric_jacobian, 1e-5);
+    }
+  }
+}
+
+TEST_F(
+    PreintegratedInertialErrorTermTest, IntegratesAgainOnlyForLargeBiasChange) {
+  createRotatingImuData();
+  addResidual();
+  std::vector<double*> parameters = {
+      pose0_.data(),       gyro_bias0_.data(), velocity0_.data(),
+      accel_bias0_.data(), pose1_.data(),      gyro_bias1_.data(),
+      velocity1_.data(),   accel_bias1_.data()};
+  Eigen::Matrix<double, 15, 1> residuals;
+
+  ASSERT_TRUE(
+      inertial_term_->Evaluate(parameters.data(), residuals.data(), nullptr));
+  EXPECT_EQ(inertial_term_->getNumIntegrations(), 1u);
+
+  // Small bias changes are handled by the first-order correction.
+  gyro_bias0_(2) += 0.5 * PreintegratedInertialErrorTerm::
+                              kDefaultGyroBiasReintegrationThreshold;
+  accel_bias0_(0) += 0.5 * PreintegratedInertialErrorTerm::
+                               kDefaultAccelBiasReintegrationThreshold;
+  ASSERT_TRUE(
+      inertial_term_->Evaluate(parameters.data(), residuals.data(), nullptr));
+  EXPECT_EQ(inertial_term_->getNumIntegrations(), 1u);
+
+  accel_bias0_(0) += PreintegratedInertialErrorTerm::
+      kDefaultAccelBiasReintegrationThreshold;
+  ASSERT_TRUE(
+      inertial_term_->Evaluate(parameters.data(), residuals.data(), nullptr));
+  EXPECT_EQ(inertial_term_->getNumIntegrations(), 2u);
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,326 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <ceres/ceres.h>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/quaternion-math.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include <ceres-error-terms/common.h>
+#include <ceres-error-terms/loop-closure-block-pose-error-term.h>
+#include <ceres-error-terms/loop-closure-edge-error-term-analytic.h>
+#include <ceres-error-terms/loop-closure-edge-error-term.h>
+#include <ceres-error-terms/parameterization/pose-param-jpl.h>
+
+namespace ceres_error_terms {
+
+namespace {
+
+typedef Eigen::Matrix<double, poseblocks::kPoseSize, 1> Pose;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 1> Residual;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize,
+                      poseblocks::kPoseSize, Eigen::RowMajor>
+    PoseJacobian;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 6> LocalPoseJacobian;
+
+constexpr int kNumRandomTrials = 50;
+constexpr double kPrecision = 1e-9;
+
+Pose getRandomPose() {
+  Eigen::Vector4d q = Eigen::Vector4d::Random().normalized();
+  if (q(3) < 0.) {
+    q = -q;
+  }
+  Pose pose;
+  pose << q, 10.0 * Eigen::Vector3d::Random();
+  return pose;
+}
+
+// Only the Jacobians w.r.t. the local parameterization are comparable, as the
+// analytic Jacobians are only valid in the tangent space.
+LocalPoseJacobian getLocalJacobian(
+    const PoseJacobian& J_global, const Pose& pose) {
+  Eigen::Matrix<double, poseblocks::kPoseSize, 6, Eigen::RowMajor> J_plus;
+  JplPoseParameterization pose_parameterization;
+  pose_parameterization.ComputeJacobian(pose.data(), J_plus.data());
+  return J_global * J_plus;
+}
+
+void evaluateCostFunction(
+    const ceres::CostFunction& cost_function,
+    const std::vector<double*>& parameters, const bool switch_is_constant,
+    Residual* residual, std::vector<PoseJacobian>* pose_jacobians,
+    Residual* switch_jacobian) {
+  CHECK_NOTNULL(residual);
+  CHECK_NOTNULL(pose_jacobians);
+  CHECK_NOTNULL(switch_jacobian);
+
+  const size_t num_poses = parameters.size() - 1u;
+  pose_jacobians->resize(num_poses);
+  std::vector<double*> jacobians(parameters.size(), nullptr);
+  for (size_t i = 0u; i < num_poses; ++i) {
+    jacobians[i] = (*pose_jacobians)[i].data();
+  }
+  if (!switch_is_constant) {
+    jacobians.back() = switch_jacobian->data();
+  }
+  ASSERT_TRUE(cost_function.Evaluate(
+      parameters.data(), residual->data(), jacobians.data()));
+}
+
+void expectSameResidualAndJacobians(
+    const ceres::CostFunction& expected_cost_function,
+    const ceres::CostFunction& cost_function, const std::vector<Pose>& poses,
+    const bool switch_is_constant, double* switch_variable) {
+  std::vector<double*> parameters;
+  for (const Pose& pose : poses) {
+    parameters.push_back(const_cast<double*>(pose.data()));
+  }
+  parameters.push_back(switch_variable);
+
+  Residual expected_residual, residual;
+  std::vector<PoseJacobian> expected_pose_jacobians, pose_jacobians;
+  Residual expected_switch_jacobian, switch_jacobian;
+  evaluateCostFunction(
+      expected_cost_function, parameters, false, &expected_residual,
+      &expected_pose_jacobians, &expected_switch_jacobian);
+  evaluateCostFunction(
+      cost_function, parameters, switch_is_constant, &residual,
+      &pose_jacobians, &switch_jacobian);
+
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(residual, expected_residual, kPrecision));
+  for (size_t i = 0u; i < poses.size(); ++i) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        getLocalJacobian(pose_jacobians[i], poses[i]),
+        getLocalJacobian(expected_pose_jacobians[i], poses[i]), kPrecision));
+  }
+  if (!switch_is_constant) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        switch_jacobian, expected_switch_jacobian, kPrecision));
+  }
+}
+
+class LoopClosureEdgeErrorTermAnalyticTest : public ::testing::Test {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  virtual void SetUp() {
+    std::srand(42);
+    q_AB__A_p_AB_ = getRandomPose();
+    const Eigen::Matrix<double, 6, 6> A =
+        Eigen::Matrix<double, 6, 6>::Random();
+    covariance_ =
+        A * A.transpose() + 0.1 * Eigen::Matrix<double, 6, 6>::Identity();
+  }
+
+  template <SwitchVariable kSwitchVariable>
+  void expectSameAsAutodiff(const bool with_baseframes) {
+    const bool switch_is_constant = kSwitchVariable == SwitchVariable::kFixed;
+    std::unique_ptr<ceres::CostFunction> autodiff_cost_function;
+    std::unique_ptr<ceres::CostFunction> analytic_cost_function;
+    if (with_baseframes) {
+      autodiff_cost_function.reset(new ceres::AutoDiffCostFunction<
+                                   LoopClosureEdgeErrorTerm,
+                                   LoopClosureEdgeErrorTerm::kResidualBlockSize,
+                                   poseblocks::kPoseSize, poseblocks::kPoseSize,
+                                   poseblocks::kPoseSize, poseblocks::kPoseSize,
+                                   LoopClosureEdgeErrorTerm::
+                                       kSwitchVariableBlockSize>(
+          new LoopClosureEdgeErrorTerm(q_AB__A_p_AB_, covariance_)));
+      analytic_cost_function.reset(
+          new LoopClosureEdgeBaseframeErrorTermAnalytic<kSwitchVariable>(
+              q_AB__A_p_AB_, covariance_));
+    } else {
+      autodiff_cost_function.reset(new ceres::AutoDiffCostFunction<
+                                   LoopClosureEdgeErrorTerm,
+                                   LoopClosureEdgeErrorTerm::kResidualBlockSize,
+                                   poseblocks::kPoseSize, poseblocks::kPoseSize,
+                                   LoopClosureEdgeErrorTerm::
+                                       kSwitchVariableBlockSize>(
+          new LoopClosureEdgeErrorTerm(q_AB__A_p_AB_, covariance_)));
+      analytic_cost_function.reset(
+          new LoopClosureEdgeErrorTermAnalytic<kSwitchVariable>(
+              q_AB__A_p_AB_, covariance_));
+    }
+
+    const size_t num_poses = with_baseframes ? 4u : 2u;
+    for (int trial = 0; trial < kNumRandomTrials; ++trial) {
+      std::vector<Pose> poses;
+      for (size_t i = 0u; i < num_poses; ++i) {
+        poses.push_back(getRandomPose());
+      }
+      double switch_variable = (trial + 1.0) / kNumRandomTrials;
+      expectSameResidualAndJacobians(
+          *autodiff_cost_function, *analytic_cost_function, poses,
+          switch_is_constant, &switch_variable);
+    }
+  }
+
+  Pose q_AB__A_p_AB_;
+  Eigen::Matrix<double, 6, 6> covariance_;
+};
+
+}  // namespace
+
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, SameMissionFreeSwitch) {
+  expectSameAsAutodiff<SwitchVariable::kFree>(false);
+}
+
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, SameMissionFixedSwitch) {
+  expectSameAsAutodiff<SwitchVariable::kFixed>(false);
+}
+
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, BaseframesFreeSwitch) {
+  expectSameAsAutodiff<SwitchVariable::kFree>(true);
+}
+
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, BaseframesFixedSwitch) {
+  expectSameAsAutodiff<SwitchVariable::kFixed>(true);
+}
+
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, BlockPoseErrorTermConvention) {
+  for (int trial = 0; trial < kNumRandomTrials; ++trial) {
+    aslam::Transformation T_G_MA, T_MA_IA, T_G_MB, T_MB_IB;
+    T_G_MA.setRandom(10.0);
+    T_MA_IA.setRandom(10.0);
+    T_G_MB.setRandom(10.0);
+    T_MB_IB.setRandom(10.0);
+
+    // The block pose term interprets the coefficients as Hamilton q_M_I and
+    // q_M_G, which are the same as the JPL q_I_M and q_G_M of the poses.
+    std::vector<Pose> poses(4u);
+    poses[0] << T_G_MA.getRotation().inverse().toImplementation().coeffs(),
+        T_G_MA.getPosition();
+    poses[1] << T_MA_IA.getRotation().toImplementation().coeffs(),
+        T_MA_IA.getPosition();
+    poses[2] << T_G_MB.getRotation().inverse().toImplementation().coeffs(),
+        T_G_MB.getPosition();
+    poses[3] << T_MB_IB.getRotation().toImplementation().coeffs(),
+        T_MB_IB.getPosition();
+    for (Pose& pose : poses) {
+      if (pose(3) < 0.) {
+        pose.head<4>() *= -1.0;
+      }
+    }
+
+    const aslam::Transformation T_IA_IB =
+        (T_G_MA * T_MA_IA).inverse() * T_G_MB * T_MB_IB;
+    const aslam::Transformation T_IB_measured_IB(
+        aslam::Quaternion(common::ExpMap(Eigen::Vector3d::Random() * 0.1)),
+        Eigen::Vector3d::Random());
+    aslam::Transformation T_A_B = T_IA_IB * T_IB_measured_IB;
+
+    // The block pose term does not keep the orientation error of different
+    // missions on the positive hemisphere, so the sign of the measurement is
+    // chosen such that its error quaternion has a positive scalar part.
+    const Eigen::Quaterniond q_G_IA =
+        Eigen::Quaterniond(poses[0].head<4>()).inverse() *
+        Eigen::Quaterniond(poses[1].head<4>());
+    const Eigen::Quaterniond q_G_IB =
+        Eigen::Quaterniond(poses[2].head<4>()).inverse() *
+        Eigen::Quaterniond(poses[3].head<4>());
+    const Eigen::Quaterniond q_IB_measured_IB =
+        T_A_B.getRotation().toImplementation().inverse() * q_G_IA.inverse() *
+        q_G_IB;
+    if (q_IB_measured_IB.w() < 0.) {
+      T_A_B = aslam::Transformation(
+          aslam::Quaternion(Eigen::Quaterniond(
+              -T_A_B.getRotation().toImplementation().coeffs())),
+          T_A_B.getPosition());
+    }
+
+    ceres::AutoDiffCostFunction<
+        LoopClosureBlockPoseErrorTerm,
+        LoopClosureBlockPoseErrorTerm::residualBlockSize, poseblocks::kPoseSize,
+        poseblocks::kPoseSize, poseblocks::kPoseSize, poseblocks::kPoseSize,
+        LoopClosureBlockPoseErrorTerm::switchVariableBlockSize>
+        autodiff_cost_function(
+            new LoopClosureBlockPoseErrorTerm(T_A_B, covariance_));
+    LoopClosureEdgeBaseframeErrorTermAnalytic<SwitchVariable::kFree>
+        analytic_cost_function(T_A_B, covariance_);
+    double switch_variable = 0.5;
+    expectSameResidualAndJacobians(
+        autodiff_cost_function, analytic_cost_function, poses, false,
+        &switch_variable);
+  }
+}
+
+// Microbenchmark of the evaluation with Jacobians, as done in every iteration
+// of a pose graph relaxation.
+TEST_F(LoopClosureEdgeErrorTermAnalyticTest, EvaluationTiming) {
+  constexpr int kNumEvaluations = 100000;
+  constexpr int kNumPoses = 4;
+
+  std::vector<Pose> poses;
+  std::vector<double*> parameters;
+  for (int i = 0; i < kNumPoses; ++i) {
+    poses.push_back(getRandomPose());
+  }
+  for (Pose& pose : poses) {
+    parameters.push_back(pose.data());
+  }
+  double switch_variable = 1.0;
+  parameters.push_back(&switch_variable);
+
+  ceres::AutoDiffCostFunction<
+      LoopClosureEdgeErrorTerm, LoopClosureEdgeErrorTerm::kResidualBlockSize,
+      poseblocks::kPoseSize, poseblocks::kPoseSize, poseblocks::kPoseSize,
+      poseblocks::kPoseSize, LoopClosureEdgeErrorTerm::kSwitchVariableBlockSize>
+      autodiff_cost_function(
+          new LoopClosureEdgeErrorTerm(q_AB__A_p_AB_, covariance_));
+  LoopClosureEdgeBaseframeErrorTermAnalytic<SwitchVariable::kFree>
+      free_switch_cost_function(q_AB__A_p_AB_, covariance_);
+  LoopClosureEdgeBaseframeErrorTermAnalytic<SwitchVariable::kFixed>
+      fixed_switch_cost_function(q_AB__A_p_AB_, covariance_);
+
+  Residual residual;
+  std::vector<PoseJacobian> pose_jacobians(kNumPoses);
+  Residual switch_jacobian;
+  std::vector<double*> jacobians;
+  for (PoseJacobian& pose_jacobian : pose_jacobians) {
+    jacobians.push_back(pose_jacobian.data());
+  }
+  jacobians.push_back(switch_jacobian.data());
+
+  auto time_evaluations =
+      [&](const ceres::CostFunction& cost_function) -> double {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    double checksum = 0.0;
+    for (int i = 0; i < kNumEvaluations; ++i) {
+      cost_function.Evaluate(
+          parameters.data(), residual.data(), jacobians.data());
+      checksum += residual(0);
+    }
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    EXPECT_TRUE(std::isfinite(checksum));
+    return 1e9 * seconds / kNumEvaluations;
+  };
+
+  const double autodiff_ns = time_evaluations(autodiff_cost_function);
+  const double free_switch_ns = time_evaluations(free_switch_cost_function);
+  // The switch variable is constant for the fixed variant.
+  jacobians.back() = nullptr;
+  const double fixed_switch_ns = time_evaluations(fixed_switch_cost_function);
+
+  LOG(INFO) << "Loop closure evaluation with Jacobians, ns per evaluation:";
+  LOG(INFO) << "  autodiff:                " << autodiff_ns;
+  LOG(INFO) << "  analytic, free switch:   " << free_switch_ns << " ("
+            << autodiff_ns / free_switch_ns << "x)";
+  LOG(INFO) << "  analytic, fixed switch:  " << fixed_switch_ns << " ("
+            << autodiff_ns / fixed_switch_ns << "x)";
+}
+
+}  // namespace ceres_error_terms
+
+MAPLAB_UNITTEST_ENTRYPOINT
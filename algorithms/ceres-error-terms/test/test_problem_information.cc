@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <ceres-error-terms/problem-information.h>
+#include <ceres-error-terms/residual-block-arena.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+namespace ceres_error_terms {
+
+class DifferenceCostFunction : public ceres::SizedCostFunction<1, 1> {
+ public:
+  explicit DifferenceCostFunction(const double target, int* num_destroyed)
+      : target_(target), num_destroyed_(CHECK_NOTNULL(num_destroyed)) {}
+  ~DifferenceCostFunction() {
+    ++*num_destroyed_;
+  }
+
+  bool Evaluate(
+      double const* const* parameters, double* residuals,
+      double** jacobians) const override {
+    residuals[0] = parameters[0][0] - target_;
+    if (jacobians != nullptr && jacobians[0] != nullptr) {
+      jacobians[0][0] = 1.0;
+    }
+    return true;
+  }
+
+ private:
+  const double target_;
+  int* num_destroyed_;
+};
+
+struct alignas(64) OverAlignedObject {
+  char data[200];
+};
+
+TEST(ResidualBlockArenaTest, ObjectsLiveAsLongAsTheArena) {
+  constexpr size_t kBlockSizeBytes = 256u;
+  ResidualBlockArena::Ptr arena =
+      std::make_shared<ResidualBlockArena>(kBlockSizeBytes);
+
+  int num_destroyed = 0;
+  constexpr int kNumObjects = 100;
+  std::vector<std::shared_ptr<ceres::CostFunction>> cost_functions;
+  for (int i = 0; i < kNumObjects; ++i) {
+    cost_functions.emplace_back(arena->getShared<ceres::CostFunction>(
+        arena->create<DifferenceCostFunction>(i, &num_destroyed)));
+    // Larger and more aligned than the blocks.
+    const OverAlignedObject* object = arena->create<OverAlignedObject>();
+    EXPECT_EQ(
+        reinterpret_cast<uintptr_t>(object) % alignof(OverAlignedObject), 0u);
+  }
+  EXPECT_EQ(arena->getNumObjects(), 2u * kNumObjects);
+  EXPECT_GE(
+      arena->getNumBytesReserved(),
+      kNumObjects *
+          (sizeof(OverAlignedObject) + sizeof(DifferenceCostFunction)));
+
+  // The cost functions keep the arena alive.
+  arena.reset();
+  EXPECT_EQ(num_destroyed, 0);
+  cost_functions.resize(1u);
+  EXPECT_EQ(num_destroyed, 0);
+  cost_functions.clear();
+  EXPECT_EQ(num_destroyed, kNumObjects);
+}
+
+TEST(ProblemInformationTest, ArenaCostFunctionsAndSharedLossFunctions) {
+  int num_destroyed = 0;
+  constexpr int kNumResiduals = 10;
+  double parameter = 0.0;
+  {
+    ProblemInformation problem_information;
+    const size_t initial_revision = problem_information.revision;
+    problem_information.reserveResidualBlocks(kNumResiduals);
+    for (int i = 0; i < kNumResiduals; ++i) {
+      std::shared_ptr<ceres::LossFunction> loss_function =
+          problem_information.getSharedLossFunction<ceres::HuberLoss>(
+              ResidualType::kPosePrior, 1.0);
+      problem_information.addResidualBlock(
+          ResidualType::kPosePrior,
+          problem_information.createCostFunction<DifferenceCostFunction>(
+              1.0, &num_destroyed),
+          loss_function, {&parameter});
+    }
+    EXPECT_EQ(problem_information.residual_blocks.size(), kNumResiduals);
+    EXPECT_EQ(problem_information.shared_loss_functions.size(), 1u);
+    EXPECT_GT(problem_information.revision, initial_revision);
+    EXPECT_NE(
+        problem_information
+            .getSharedLossFunction<ceres::HuberLoss>(
+                ResidualType::kPosePrior, 2.0)
+            .get(),
+        problem_information
+            .getSharedLossFunction<ceres::HuberLoss>(
+                ResidualType::kPosePrior, 1.0)
+            .get());
+    EXPECT_NE(
+        problem_information
+            .getSharedLossFunction<ceres::CauchyLoss>(
+                ResidualType::kPosePrior, 1.0)
+            .get(),
+        problem_information
+            .getSharedLossFunction<ceres::HuberLoss>(
+                ResidualType::kPosePrior, 1.0)
+            .get());
+
+    ceres::Problem problem(getDefaultProblemOptions());
+    buildCeresProblemFromProblemInformation(&problem_information, &problem);
+    EXPECT_EQ(problem.NumResidualBlocks(), kNumResiduals);
+
+    ceres::Solver::Options options;
+    options.logging_type = ceres::SILENT;
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    EXPECT_NEAR(parameter, 1.0, 1e-8);
+    EXPECT_EQ(num_destroyed, 0);
+  }
+  EXPECT_EQ(num_destroyed, kNumResiduals);
+}
+
+}  // namespace ceres_error_terms
+
+MAPLAB_UNITTEST_ENTRYPOINT
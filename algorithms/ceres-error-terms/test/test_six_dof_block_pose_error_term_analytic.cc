@@ -0,0 +1,174 @@
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <ceres/ceres.h>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include <ceres-error-terms/common.h>
+#include <ceres-error-terms/parameterization/pose-param-jpl.h>
+#include <ceres-error-terms/parameterization/quaternion-param-jpl.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-analytic.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-autodiff.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-with-extrinsics-autodiff.h>
+
+namespace ceres_error_terms {
+
+namespace {
+
+constexpr int kNumRandomTrials = 50;
+constexpr double kPrecision = 1e-9;
+
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, 1> Residual;
+typedef Eigen::Matrix<double, poseblocks::kResidualSize, Eigen::Dynamic>
+    Jacobian;
+
+Eigen::Vector4d getRandomQuaternion() {
+  Eigen::Vector4d q = Eigen::Vector4d::Random().normalized();
+  if (q(3) < 0.) {
+    q = -q;
+  }
+  return q;
+}
+
+Eigen::VectorXd getRandomPose() {
+  Eigen::VectorXd pose(poseblocks::kPoseSize);
+  pose << getRandomQuaternion(), 10.0 * Eigen::Vector3d::Random();
+  return pose;
+}
+
+// Only the Jacobians w.r.t. the local parameterization are comparable, as the
+// analytic Jacobians are only valid in the tangent space.
+Eigen::MatrixXd getLocalParameterizationJacobian(
+    const Eigen::VectorXd& parameter_block) {
+  Eigen::MatrixXd J_plus;
+  if (parameter_block.size() == poseblocks::kPoseSize) {
+    Eigen::Matrix<double, poseblocks::kPoseSize, 6, Eigen::RowMajor> J;
+    JplPoseParameterization().ComputeJacobian(parameter_block.data(), J.data());
+    J_plus = J;
+  } else if (parameter_block.size() == poseblocks::kOrientationBlockSize) {
+    Eigen::Matrix<double, 4, 3, Eigen::RowMajor> J;
+    JplQuaternionParameterization().ComputeJacobian(
+        parameter_block.data(), J.data());
+    J_plus = J;
+  } else {
+    J_plus = Eigen::MatrixXd::Identity(
+        parameter_block.size(), parameter_block.size());
+  }
+  return J_plus;
+}
+
+void evaluateLocalJacobians(
+    const ceres::CostFunction& cost_function,
+    const std::vector<Eigen::VectorXd>& parameter_blocks, Residual* residual,
+    std::vector<Jacobian>* local_jacobians) {
+  CHECK_NOTNULL(residual);
+  CHECK_NOTNULL(local_jacobians);
+
+  std::vector<const double*> parameters;
+  std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                            Eigen::RowMajor>>
+      jacobians;
+  for (const Eigen::VectorXd& parameter_block : parameter_blocks) {
+    parameters.push_back(parameter_block.data());
+    jacobians.emplace_back(poseblocks::kResidualSize, parameter_block.size());
+  }
+  std::vector<double*> jacobian_pointers;
+  for (size_t i = 0u; i < jacobians.size(); ++i) {
+    jacobian_pointers.push_back(jacobians[i].data());
+  }
+  ASSERT_TRUE(cost_function.Evaluate(
+      parameters.data(), residual->data(), jacobian_pointers.data()));
+
+  local_jacobians->clear();
+  for (size_t i = 0u; i < jacobians.size(); ++i) {
+    local_jacobians->emplace_back(
+        jacobians[i] * getLocalParameterizationJacobian(parameter_blocks[i]));
+  }
+}
+
+void expectSameResidualAndJacobians(
+    const ceres::CostFunction& expected_cost_function,
+    const ceres::CostFunction& cost_function,
+    const std::vector<Eigen::VectorXd>& parameter_blocks) {
+  Residual expected_residual, residual;
+  std::vector<Jacobian> expected_jacobians, jacobians;
+  evaluateLocalJacobians(
+      expected_cost_function, parameter_blocks, &expected_residual,
+      &expected_jacobians);
+  evaluateLocalJacobians(
+      cost_function, parameter_blocks, &residual, &jacobians);
+
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(residual, expected_residual, kPrecision));
+  ASSERT_EQ(jacobians.size(), expected_jacobians.size());
+  for (size_t i = 0u; i < jacobians.size(); ++i) {
+    EXPECT_TRUE(
+        EIGEN_MATRIX_NEAR(jacobians[i], expected_jacobians[i], kPrecision));
+  }
+}
+
+class SixDoFBlockPoseErrorTermAnalyticTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::srand(42);
+  }
+
+  void setRandomMeasurement() {
+    T_A_B_.setRandom(10.0);
+    const Eigen::Matrix<double, 6, 6> A =
+        Eigen::Matrix<double, 6, 6>::Random();
+    T_A_B_covariance_ =
+        A * A.transpose() + 0.1 * Eigen::Matrix<double, 6, 6>::Identity();
+  }
+
+  aslam::Transformation T_A_B_;
+  aslam::TransformationCovariance T_A_B_covariance_;
+};
+
+}  // namespace
+
+TEST_F(SixDoFBlockPoseErrorTermAnalyticTest, SameAsAutodiff) {
+  for (int trial = 0; trial < kNumRandomTrials; ++trial) {
+    setRandomMeasurement();
+    ceres::AutoDiffCostFunction<
+        SixDoFBlockPoseErrorTerm, SixDoFBlockPoseErrorTerm::residualBlockSize,
+        poseblocks::kPoseSize, poseblocks::kPoseSize>
+        autodiff_cost_function(
+            new SixDoFBlockPoseErrorTerm(T_A_B_, T_A_B_covariance_));
+    SixDoFBlockPoseErrorTermAnalytic analytic_cost_function(
+        T_A_B_, T_A_B_covariance_);
+
+    expectSameResidualAndJacobians(
+        autodiff_cost_function, analytic_cost_function,
+        {getRandomPose(), getRandomPose()});
+  }
+}
+
+TEST_F(SixDoFBlockPoseErrorTermAnalyticTest, WithExtrinsicsSameAsAutodiff) {
+  for (int trial = 0; trial < kNumRandomTrials; ++trial) {
+    setRandomMeasurement();
+    ceres::AutoDiffCostFunction<
+        SixDoFBlockPoseErrorTermWithExtrinsics,
+        SixDoFBlockPoseErrorTermWithExtrinsics::kResidualBlockSize,
+        poseblocks::kPoseSize, poseblocks::kPoseSize,
+        poseblocks::kOrientationBlockSize, poseblocks::kPositionBlockSize>
+        autodiff_cost_function(new SixDoFBlockPoseErrorTermWithExtrinsics(
+            T_A_B_, T_A_B_covariance_));
+    SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic analytic_cost_function(
+        T_A_B_, T_A_B_covariance_);
+
+    const Eigen::VectorXd q_I_B = getRandomQuaternion();
+    const Eigen::VectorXd p_B_I = Eigen::Vector3d::Random();
+    expectSameResidualAndJacobians(
+        autodiff_cost_function, analytic_cost_function,
+        {getRandomPose(), getRandomPose(), q_I_B, p_B_I});
+  }
+}
+
+}  // namespace ceres_error_terms
+
+MAPLAB_UNITTEST_ENTRYPOINT
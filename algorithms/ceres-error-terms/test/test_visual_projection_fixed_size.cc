@@ -0,0 +1,91 @@
+#include <memory>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <ceres-error-terms/visual-projection-fixed-size.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+namespace ceres_error_terms {
+
+template <typename DistortionType>
+class FixedSizeProjectionTest : public ::testing::Test {
+ protected:
+  typedef visual::FixedSizeProjection<aslam::PinholeCamera, DistortionType>
+      Projection;
+
+  void SetUp() override {
+    Eigen::VectorXd intrinsics(4);
+    intrinsics << 460.0, 455.0, 370.0, 245.0;
+    Eigen::VectorXd distortion_parameters(4);
+    distortion_parameters << -0.28, 0.07, 0.0002, 0.00002;
+    aslam::Distortion::UniquePtr distortion(
+        new DistortionType(distortion_parameters));
+    camera_.reset(
+        new aslam::PinholeCamera(intrinsics, 752u, 480u, distortion));
+  }
+
+  // Compares the fixed-size projection of the given point against the
+  // generic aslam projection.
+  void expectEqualToCameraProjection(const Eigen::Vector3d& p_C) const {
+    Eigen::Vector2d keypoint;
+    typename Projection::PointJacobian J_point;
+    typename Projection::IntrinsicsJacobian J_intrinsics;
+    typename Projection::DistortionJacobian J_distortion;
+    ASSERT_TRUE(Projection::project(
+        *camera_, p_C, camera_->getParameters().data(),
+        camera_->getDistortion().getParameters().data(), &keypoint, &J_point,
+        &J_intrinsics, &J_distortion));
+
+    Eigen::Vector2d expected_keypoint;
+    Eigen::Matrix<double, 2, 3> expected_J_point;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> expected_J_intrinsics;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> expected_J_distortion;
+    const Eigen::VectorXd intrinsics = camera_->getParameters();
+    const Eigen::VectorXd distortion =
+        camera_->getDistortion().getParameters();
+    camera_->project3Functional(
+        p_C, &intrinsics, &distortion, &expected_keypoint, &expected_J_point,
+        &expected_J_intrinsics, &expected_J_distortion);
+
+    EXPECT_NEAR_EIGEN(keypoint, expected_keypoint, 1e-9);
+    EXPECT_NEAR_EIGEN(J_point, expected_J_point, 1e-9);
+    EXPECT_NEAR_EIGEN(J_intrinsics, expected_J_intrinsics, 1e-9);
+    EXPECT_NEAR_EIGEN(J_distortion, expected_J_distortion, 1e-9);
+  }
+
+  std::unique_ptr<aslam::PinholeCamera> camera_;
+};
+
+typedef ::testing::Types<aslam::RadTanDistortion, aslam::EquidistantDistortion>
+    DistortionTypes;
+TYPED_TEST_CASE(FixedSizeProjectionTest, DistortionTypes);
+
+TYPED_TEST(FixedSizeProjectionTest, MatchesCameraProjection) {
+  constexpr int kNumPoints = 100;
+  for (int i = 0; i < kNumPoints; ++i) {
+    const Eigen::Vector2d keypoint = this->camera_->createRandomKeypoint();
+    Eigen::Vector3d bearing;
+    ASSERT_TRUE(this->camera_->backProject3(keypoint, &bearing));
+    this->expectEqualToCameraProjection(bearing * (1.0 + i * 0.1));
+  }
+}
+
+TYPED_TEST(FixedSizeProjectionTest, RejectsPointsBehindCamera) {
+  typedef typename TestFixture::Projection Projection;
+  Eigen::Vector2d keypoint;
+  EXPECT_FALSE(Projection::project(
+      *this->camera_, Eigen::Vector3d(0.1, 0.2, -1.0),
+      this->camera_->getParameters().data(),
+      this->camera_->getDistortion().getParameters().data(), &keypoint,
+      nullptr, nullptr, nullptr));
+}
+
+}  // namespace ceres_error_terms
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,8 @@
 #ifndef DENSE_RECONSTRUCTION_ASLAM_CV_INTERFACE_H_
 #define DENSE_RECONSTRUCTION_ASLAM_CV_INTERFACE_H_
 
+#include <memory>
+
 #include <Eigen/Dense>
 #include <aslam/cameras/camera.h>
 #include <aslam/common/pose-types.h>
@@ -15,6 +17,25 @@ void getStereoPairFromAslamCvCameras(
     const aslam::Transformation& T_C2_C1, const double scale,
     StereoCameraParameters* stereo_camera_params);
 
+// Undistortion and rectification maps of a stereo pair. They only depend on
+// the calibration, so they are shared by all StereoMatchers of the pair.
+struct StereoRectification {
+  std::shared_ptr<const Undistorter> undistorter_first;
+  std::shared_ptr<const Undistorter> undistorter_second;
+};
+
+// Returns the rectification of the stereo pair, which is only computed the
+// first time it is requested. The cache is keyed by the camera ids and a hash
+// of the calibration, such that a changed calibration gets its own maps.
+// Thread-safe.
+std::shared_ptr<const StereoRectification> getCachedStereoRectification(
+    const aslam::Camera& first_camera, const aslam::Camera& second_camera,
+    const aslam::Transformation& T_C2_C1, const double scale);
+
+// Releases the maps of all stereo pairs. Matchers that are still alive keep
+// their maps.
+void clearStereoRectificationCache();
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
 
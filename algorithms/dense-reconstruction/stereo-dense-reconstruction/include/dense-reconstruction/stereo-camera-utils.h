@@ -157,10 +157,11 @@ class Undistorter {
   explicit Undistorter(
       const CameraParametersPair& input_camera_parameters_pair);
 
-  void undistortImage(const cv::Mat& image, cv::Mat* undistored_image);
+  // Only reads the maps, so it can be called concurrently.
+  void undistortImage(const cv::Mat& image, cv::Mat* undistored_image) const;
 
   // Get camera parameters used to build undistorter.
-  const CameraParametersPair& getCameraParametersPair();
+  const CameraParametersPair& getCameraParametersPair() const;
 
   // Generates a new output camera with fx = fy = (scale * (input_fx +
   // input_fy)/2, center point in the center of the image, R = I, and a
@@ -12,11 +12,15 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "dense-reconstruction/aslam-cv-interface.h"
 #include "dense-reconstruction/stereo-camera-utils.h"
 
 namespace dense_reconstruction {
 namespace stereo {
 
+// Where the disparity maps are computed.
+enum class StereoMatcherBackend { kCpu, kCuda, kOpenCl };
+
 struct StereoMatcherConfig {
   StereoMatcherConfig() {}
 
@@ -33,6 +37,11 @@ struct StereoMatcherConfig {
 
   bool use_sgbm = true;
 
+  // Compute the disparity maps on the GPU if possible: SGBM with the CUDA
+  // semi-global matcher of OpenCV, BM with OpenCL. Falls back to the CPU if
+  // OpenCV was built without the backend or there is no device.
+  bool use_gpu = false;
+
   int sgbm_min_disparity = 0;
   int sgbm_num_disparities = 128;
   int sgbm_sad_window_size = 3;
@@ -46,6 +55,11 @@ struct StereoMatcherConfig {
   // MODE_SGBM = 0, MODE_HH = 1, MODE_SGBM_3WAY = 2, MODE_HH4 = 3
   int sgbm_mode = cv::StereoSGBM::MODE_SGBM;
 
+  // The CUDA matcher uses a census transform cost, so it needs its own
+  // penalties.
+  int cuda_sgm_p1 = 10;
+  int cuda_sgm_p2 = 120;
+
   int bm_pre_filter_size = 9;
   int bm_pre_filter_cap = 31;
   std::string bm_prefilter_type = "xsobel";
@@ -69,11 +83,25 @@ struct StereoMatcherConfig {
 class StereoMatcher {
  public:
   // Initialize the stereo matcher with the stereo camera intrinsics and
-  // extrinsics. This will create and cache an undistorter for this stereo pair.
+  // extrinsics. The undistorter of this stereo pair is taken from the
+  // rectification cache and only created if the pair is not in there yet.
   StereoMatcher(
       const aslam::Camera& first_camera, const aslam::Camera& second_camera,
       const aslam::Transformation& T_C2_C1, const StereoMatcherConfig& config);
 
+  // Undistort and rectify the images of the stereo pair.
+  void rectifyImages(
+      const cv::Mat& first_image, const cv::Mat& second_image,
+      cv::Mat* first_image_undistorted,
+      cv::Mat* second_image_undistorted) const;
+
+  // Compute a disparity map from the rectified images of the stereo pair. The
+  // OpenCV matcher keeps internal buffers, so this must not be called
+  // concurrently on the same StereoMatcher.
+  void computeDisparityMapFromRectifiedImages(
+      const cv::Mat& first_image_undistorted,
+      const cv::Mat& second_image_undistorted, cv::Mat* disparity_map) const;
+
   // Compute a disparity map for the stereo pair.
   void computeDisparityMap(
       const cv::Mat& first_image, const cv::Mat& second_image,
@@ -114,7 +142,15 @@ class StereoMatcher {
     return sad_window_size_;
   }
 
+  StereoMatcherBackend backend() const {
+    return backend_;
+  }
+
  private:
+  // Creates the CUDA semi-global matcher, returns false if it can't be used on
+  // this host.
+  bool createCudaStereoSgm();
+
   const StereoMatcherConfig config_;
 
   const aslam::Camera& first_camera_;
@@ -122,16 +158,12 @@ class StereoMatcher {
 
   const aslam::Transformation T_C2_C1_;
 
-  // Convenience class that stores the camera intrinsics and extrinsics as well
-  // as the undistortion and rectification paramters.
-  StereoCameraParameters stereo_camera_params_;
-
-  // Convenience class to compute and cache the stereo
-  // undistortion/rectification mapping.
-  std::unique_ptr<Undistorter> undistorter_first_;
-  std::unique_ptr<Undistorter> undistorter_second_;
+  // Stereo undistortion/rectification mapping, shared with the other matchers
+  // of this stereo pair.
+  std::shared_ptr<const StereoRectification> rectification_;
 
   cv::Ptr<cv::StereoMatcher> stereo_matcher_;
+  StereoMatcherBackend backend_;
 
   // Cached intrinsics:
   double focal_length_;
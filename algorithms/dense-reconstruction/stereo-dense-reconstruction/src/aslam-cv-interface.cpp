@@ -2,8 +2,12 @@
 
 #include <algorithm>
 #include <iostream>
+#include <functional>
 #include <iterator>
+#include <mutex>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -16,6 +20,54 @@
 
 namespace dense_reconstruction {
 namespace stereo {
+namespace {
+// The rectification maps are keyed by (first camera, second camera,
+// calibration hash).
+typedef std::tuple<aslam::CameraId, aslam::CameraId, size_t>
+    StereoRectificationKey;
+
+struct StereoRectificationKeyHash {
+  size_t operator()(const StereoRectificationKey& key) const {
+    size_t seed = std::hash<aslam::CameraId>()(std::get<0>(key));
+    combineHash(std::hash<aslam::CameraId>()(std::get<1>(key)), &seed);
+    combineHash(std::get<2>(key), &seed);
+    return seed;
+  }
+
+  // See hash_combine in: http://boost.cowic.de/rc/pdf/hash.pdf
+  static void combineHash(const size_t value, size_t* seed) {
+    *seed ^= value + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+  }
+};
+
+void hashVector(const Eigen::VectorXd& vector, size_t* seed) {
+  CHECK_NOTNULL(seed);
+  const std::hash<double> double_hash;
+  for (int i = 0; i < vector.size(); ++i) {
+    StereoRectificationKeyHash::combineHash(double_hash(vector[i]), seed);
+  }
+}
+
+void hashCameraCalibration(const aslam::Camera& camera, size_t* seed) {
+  CHECK_NOTNULL(seed);
+  StereoRectificationKeyHash::combineHash(
+      static_cast<size_t>(camera.getType()), seed);
+  StereoRectificationKeyHash::combineHash(camera.imageWidth(), seed);
+  StereoRectificationKeyHash::combineHash(camera.imageHeight(), seed);
+  hashVector(camera.getParameters(), seed);
+  const aslam::Distortion& distortion = camera.getDistortion();
+  StereoRectificationKeyHash::combineHash(
+      static_cast<size_t>(distortion.getType()), seed);
+  hashVector(distortion.getParameters(), seed);
+}
+
+std::mutex stereo_rectification_cache_mutex;
+std::unordered_map<
+    StereoRectificationKey, std::shared_ptr<const StereoRectification>,
+    StereoRectificationKeyHash>
+    stereo_rectification_cache;
+}  // namespace
+
 
 void getDistortionFromAslamCvCameras(
     const aslam::Camera& camera, std::vector<double>* D,
@@ -101,5 +153,45 @@ void getStereoPairFromAslamCvCameras(
           distortion_model_second, CameraSide::SECOND));
 }
 
+std::shared_ptr<const StereoRectification> getCachedStereoRectification(
+    const aslam::Camera& first_camera, const aslam::Camera& second_camera,
+    const aslam::Transformation& T_C2_C1, const double scale) {
+  size_t calibration_hash = std::hash<double>()(scale);
+  hashCameraCalibration(first_camera, &calibration_hash);
+  hashCameraCalibration(second_camera, &calibration_hash);
+  const Eigen::Matrix4d T_C2_C1_mat = T_C2_C1.getTransformationMatrix();
+  hashVector(
+      Eigen::Map<const Eigen::VectorXd>(T_C2_C1_mat.data(), T_C2_C1_mat.size()),
+      &calibration_hash);
+  const StereoRectificationKey key(
+      first_camera.getId(), second_camera.getId(), calibration_hash);
+
+  // The lock is held while computing the maps, so the matchers of a stereo
+  // pair that are created at the same time compute them once.
+  std::lock_guard<std::mutex> lock(stereo_rectification_cache_mutex);
+  std::shared_ptr<const StereoRectification>& rectification =
+      stereo_rectification_cache[key];
+  if (!rectification) {
+    VLOG(3) << "Computing the rectification maps of stereo pair ["
+            << first_camera.getId() << "/" << second_camera.getId() << "].";
+    StereoCameraParameters stereo_camera_params(scale);
+    getStereoPairFromAslamCvCameras(
+        first_camera, second_camera, T_C2_C1, scale, &stereo_camera_params);
+    std::shared_ptr<StereoRectification> new_rectification =
+        std::make_shared<StereoRectification>();
+    new_rectification->undistorter_first =
+        std::make_shared<const Undistorter>(stereo_camera_params.getFirst());
+    new_rectification->undistorter_second =
+        std::make_shared<const Undistorter>(stereo_camera_params.getSecond());
+    rectification = new_rectification;
+  }
+  return rectification;
+}
+
+void clearStereoRectificationCache() {
+  std::lock_guard<std::mutex> lock(stereo_rectification_cache_mutex);
+  stereo_rectification_cache.clear();
+}
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
@@ -453,7 +453,7 @@ Undistorter::Undistorter(
 }
 
 void Undistorter::undistortImage(
-    const cv::Mat& image, cv::Mat* undistorted_image) {
+    const cv::Mat& image, cv::Mat* undistorted_image) const {
   if (empty_pixels_) {
     cv::remap(
         image, *undistorted_image, map_x_, map_y_, cv::INTER_LINEAR,
@@ -466,7 +466,7 @@ void Undistorter::undistortImage(
   }
 }
 
-const CameraParametersPair& Undistorter::getCameraParametersPair() {
+const CameraParametersPair& Undistorter::getCameraParametersPair() const {
   return used_camera_parameters_pair_;
 }
 
@@ -1,12 +1,16 @@
 #include "dense-reconstruction/stereo-dense-reconstruction.h"
 
+#include <algorithm>
 #include <string>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <aslam/cameras/camera.h>
 #include <map-resources/resource-common.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <vi-map/sensor-manager.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -39,7 +43,31 @@ DEFINE_bool(
     "This affects the number of disparities and the p1/p2 parameter for the "
     "SGBM.");
 
+DEFINE_uint64(
+    dense_stereo_num_matching_threads, 4u,
+    "Number of threads that compute the disparity maps in parallel, each with "
+    "its own stereo matcher.");
+
+DEFINE_uint64(
+    dense_stereo_pipeline_queue_size, 8u,
+    "Maximum number of stereo pairs buffered between the stages of the dense "
+    "reconstruction pipeline.");
+
 namespace dense_reconstruction {
+namespace {
+// A stereo pair passing through the pipeline of
+// computeDepthForStereoCamerasOfMission. The unrectified images are only kept
+// for the visualization. An item without a vertex marks the end of the input.
+struct StereoPairItem {
+  vi_map::Vertex* vertex = nullptr;
+  cv::Mat first_image;
+  cv::Mat second_image;
+  cv::Mat first_image_rectified;
+  cv::Mat second_image_rectified;
+  cv::Mat disparity_map;
+};
+}  // namespace
+
 static std::unordered_set<backend::ResourceType, backend::ResourceTypeHash>
     kSupportedDepthTypes{backend::ResourceType::kRawDepthMap,
                          backend::ResourceType::kPointCloudXYZRGBN};
@@ -202,8 +230,6 @@ void computeDepthForStereoCamerasOfMission(
     config.adaptParamsBasedOnImageSize(first_camera.imageWidth());
   }
 
-  stereo::StereoMatcher matcher(first_camera, second_camera, T_C2_C1, config);
-
   pose_graph::VertexIdList all_vertices;
   vi_map->getAllVertexIdsInMissionAlongGraph(mission_id, &all_vertices);
 
@@ -215,53 +241,115 @@ void computeDepthForStereoCamerasOfMission(
   const size_t end = static_cast<size_t>(
       FLAGS_dense_stereo_debug_reconstruction_end_fraction_of_trajectory *
       static_cast<double>(all_vertices.size()));
-  size_t counter = 0u;
+  const size_t begin_idx = std::min(start, all_vertices.size());
+  const size_t end_idx =
+      std::max(begin_idx, std::min(end + 1u, all_vertices.size()));
+  const pose_graph::VertexIdList vertices_to_process(
+      all_vertices.begin() + begin_idx, all_vertices.begin() + end_idx);
+
+  // Load the images of the processed vertices in the background. Most maps
+  // store raw grayscale images, which are tried first below.
+  if (!vertices_to_process.empty()) {
+    vi_map->prefetchFrameResources<cv::Mat>(
+        vertices_to_process, backend::ResourceType::kRawImage);
+  }
 
-  common::ProgressBar progress_bar(all_vertices.size());
-  progress_bar.update(start);
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (counter < start) {
-      ++counter;
-      continue;
-    } else if (counter > end) {
-      break;
+  // The vertices run through a pipeline of three stages connected by bounded
+  // queues: a thread loads and rectifies the images, the matching threads
+  // compute the disparity maps and this thread converts them and stores the
+  // resources. Every thread has its own StereoMatcher, as the OpenCV matchers
+  // are not thread-safe, while the rectification maps are shared through the
+  // rectification cache. The map is only modified by this thread.
+  const size_t num_matching_threads =
+      std::max<size_t>(1u, FLAGS_dense_stereo_num_matching_threads);
+  const size_t queue_size =
+      std::max<size_t>(1u, FLAGS_dense_stereo_pipeline_queue_size);
+  common::ThreadSafeQueue<StereoPairItem> rectified_queue;
+  common::ThreadSafeQueue<StereoPairItem> disparity_queue;
+
+  std::thread load_thread([&]() {
+    const stereo::StereoMatcher rectifier(
+        first_camera, second_camera, T_C2_C1, config);
+    for (const pose_graph::VertexId& vertex_id : vertices_to_process) {
+      StereoPairItem item;
+      item.vertex = vi_map->getVertexPtr(vertex_id);
+
+      cv::Mat first_image, second_image;
+      const bool has_first_image = getSuitableGrayscaleImageForFrame(
+          *vi_map, *item.vertex, first_camera_idx, &first_image);
+      const bool has_second_image = getSuitableGrayscaleImageForFrame(
+          *vi_map, *item.vertex, second_camera_idx, &second_image);
+      // Vertices without images are passed on with empty images, so the last
+      // stage sees every vertex exactly once.
+      if (has_first_image && has_second_image) {
+        CHECK(!first_image.empty());
+        CHECK(!second_image.empty());
+        CHECK_EQ(first_image.type(), CV_8UC1);
+        CHECK_EQ(second_image.type(), CV_8UC1);
+        CHECK_EQ(first_image.cols, second_image.cols);
+        CHECK_EQ(first_image.rows, second_image.rows);
+
+        rectifier.rectifyImages(
+            first_image, second_image, &item.first_image_rectified,
+            &item.second_image_rectified);
+        if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
+          item.first_image = first_image;
+          item.second_image = second_image;
+        }
+      }
+      CHECK(rectified_queue.PushBlockingIfFull(item, queue_size));
+    }
+    // One end marker per matching thread.
+    for (size_t i = 0u; i < num_matching_threads; ++i) {
+      CHECK(rectified_queue.PushBlockingIfFull(StereoPairItem(), queue_size));
     }
-    ++counter;
+  });
+
+  std::vector<std::thread> matching_threads;
+  for (size_t i = 0u; i < num_matching_threads; ++i) {
+    matching_threads.emplace_back([&]() {
+      const stereo::StereoMatcher worker_matcher(
+          first_camera, second_camera, T_C2_C1, config);
+      StereoPairItem item;
+      while (rectified_queue.PopBlocking(&item) && item.vertex != nullptr) {
+        if (!item.first_image_rectified.empty()) {
+          VLOG(3) << "Computing disparity map for vertex "
+                  << item.vertex->id();
+          worker_matcher.computeDisparityMapFromRectifiedImages(
+              item.first_image_rectified, item.second_image_rectified,
+              &item.disparity_map);
+        }
+        CHECK(disparity_queue.PushBlockingIfFull(item, queue_size));
+      }
+    });
+  }
 
-    vi_map::Vertex* vertex_ptr = vi_map->getVertexPtr(vertex_id);
+  // Only used for the camera parameters of the disparity conversion.
+  const stereo::StereoMatcher matcher(
+      first_camera, second_camera, T_C2_C1, config);
 
-    cv::Mat first_image, second_image;
-    const bool has_first_image = getSuitableGrayscaleImageForFrame(
-        *vi_map, *vertex_ptr, first_camera_idx, &first_image);
-    const bool has_second_image = getSuitableGrayscaleImageForFrame(
-        *vi_map, *vertex_ptr, second_camera_idx, &second_image);
-    if (!(has_first_image && has_second_image)) {
+  common::ProgressBar progress_bar(all_vertices.size());
+  progress_bar.update(start);
+  for (size_t item_idx = 0u; item_idx < vertices_to_process.size();
+       ++item_idx) {
+    StereoPairItem item;
+    CHECK(disparity_queue.PopBlocking(&item));
+    CHECK_NOTNULL(item.vertex);
+    vi_map::Vertex* vertex_ptr = item.vertex;
+
+    if (item.first_image_rectified.empty()) {
       VLOG(3) << "Skipping vertex " << vertex_ptr->id()
               << " - no suitable image was found.";
       progress_bar.increment();
       continue;
     }
-
-    VLOG(3) << "Computing disparity map for vertex " << vertex_ptr->id();
-
-    CHECK(!first_image.empty());
-    CHECK(!second_image.empty());
-    CHECK_EQ(first_image.type(), CV_8UC1);
-    CHECK_EQ(second_image.type(), CV_8UC1);
-    CHECK_EQ(first_image.cols, second_image.cols);
-    CHECK_EQ(first_image.rows, second_image.rows);
+    const cv::Mat& disparity_map = item.disparity_map;
+    const cv::Mat& first_image_rectified = item.first_image_rectified;
 
     if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
-      cv::imshow(kFirstImageWindowName, first_image);
-      cv::imshow(kSecondImageWindowName, second_image);
-    }
-
-    cv::Mat disparity_map, first_image_rectified, second_image_rectified;
-    matcher.computeDisparityMap(
-        first_image, second_image, &disparity_map, &first_image_rectified,
-        &second_image_rectified);
+      cv::imshow(kFirstImageWindowName, item.first_image);
+      cv::imshow(kSecondImageWindowName, item.second_image);
 
-    if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
       cv::Mat color_map_disparity;
       generateColorMap(disparity_map, &color_map_disparity);
       cv::imshow(kDisparityMapWindowName, color_map_disparity);
@@ -318,6 +406,11 @@ void computeDepthForStereoCamerasOfMission(
     }
     progress_bar.increment();
   }
+  load_thread.join();
+  for (std::thread& matching_thread : matching_threads) {
+    matching_thread.join();
+  }
+  vi_map->cancelPrefetching();
 
   if (FLAGS_dense_stereo_images_and_result_in_ocv_windows) {
     cv::destroyAllWindows();
@@ -7,9 +7,19 @@
 #include <aslam/common/pose-types.h>
 #include <gflags/gflags.h>
 #include <opencv2/core/core.hpp>
+#include <opencv2/core/ocl.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+// The CUDA semi-global matcher was added to the cudastereo module of OpenCV
+// 4.4.
+#if defined(HAVE_OPENCV_CUDASTEREO) && \
+    (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 4))
+#define DENSE_RECONSTRUCTION_HAVE_CUDA_SGM
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudastereo.hpp>
+#endif
+
 #include "dense-reconstruction/aslam-cv-interface.h"
 #include "dense-reconstruction/disparity-conversion-utils.h"
 #include "dense-reconstruction/stereo-camera-utils.h"
@@ -20,6 +30,13 @@ DEFINE_double(
 
 DEFINE_bool(dense_stereo_use_sgbm, true, "Use SGBM if enabled, BM otherwise.");
 
+DEFINE_bool(
+    dense_stereo_use_gpu, false,
+    "Compute the disparity maps on the GPU if available, with CUDA for SGBM "
+    "and with OpenCL for BM. Falls back to the CPU otherwise.");
+DEFINE_int32(dense_stereo_cuda_sgm_p1, 10, "");
+DEFINE_int32(dense_stereo_cuda_sgm_p2, 120, "");
+
 DEFINE_int32(dense_stereo_sgbm_min_disparity, 0, "");
 DEFINE_int32(dense_stereo_sgbm_num_disparities, 128, "");
 DEFINE_int32(dense_stereo_sgbm_sad_window_size, 3, "");
@@ -78,6 +95,7 @@ StereoMatcherConfig StereoMatcherConfig::getFromGflags() {
   // General config:
   config.downscaling_factor = FLAGS_dense_stereo_downscaling_factor;
   config.use_sgbm = FLAGS_dense_stereo_use_sgbm;
+  config.use_gpu = FLAGS_dense_stereo_use_gpu;
 
   // SGBM config:
   config.sgbm_min_disparity = FLAGS_dense_stereo_sgbm_min_disparity;
@@ -91,6 +109,8 @@ StereoMatcherConfig StereoMatcherConfig::getFromGflags() {
   config.sgbm_speckle_window_size = FLAGS_dense_stereo_sgbm_speckle_window_size;
   config.sgbm_speckle_range = FLAGS_dense_stereo_sgbm_speckle_range;
   config.sgbm_mode = FLAGS_dense_stereo_sgbm_mode;
+  config.cuda_sgm_p1 = FLAGS_dense_stereo_cuda_sgm_p1;
+  config.cuda_sgm_p2 = FLAGS_dense_stereo_cuda_sgm_p2;
 
   // BM config:
   config.bm_pre_filter_size = FLAGS_dense_stereo_bm_pre_filter_size;
@@ -115,17 +135,14 @@ StereoMatcher::StereoMatcher(
       first_camera_(first_camera),
       second_camera_(second_camera),
       T_C2_C1_(T_C2_C1),
-      stereo_camera_params_(config_.downscaling_factor),
-      undistorter_first_(nullptr),
-      undistorter_second_(nullptr) {
-  getStereoPairFromAslamCvCameras(
-      first_camera_, second_camera_, T_C2_C1_, config_.downscaling_factor,
-      &stereo_camera_params_);
-
-  undistorter_first_.reset(new Undistorter(stereo_camera_params_.getFirst()));
-  undistorter_second_.reset(new Undistorter(stereo_camera_params_.getSecond()));
-
-  if (config_.use_sgbm) {
+      backend_(StereoMatcherBackend::kCpu) {
+  rectification_ = getCachedStereoRectification(
+      first_camera_, second_camera_, T_C2_C1_, config_.downscaling_factor);
+  CHECK(rectification_);
+
+  if (config_.use_sgbm && config_.use_gpu && createCudaStereoSgm()) {
+    VLOG(1) << "Stereo matching algorithm used: SGBM on CUDA";
+  } else if (config_.use_sgbm) {
     VLOG(1) << "Stereo matching algorithm used: SGBM";
     stereo_matcher_ = cv::StereoSGBM::create(
         config_.sgbm_min_disparity, config_.sgbm_num_disparities,
@@ -155,13 +172,25 @@ StereoMatcher::StereoMatcher(
     min_disparity_ = config_.bm_min_disparity;
     num_disparities_ = config_.bm_num_disparities;
     sad_window_size_ = config_.bm_sad_window_size;
+
+    if (config_.use_gpu) {
+      // OpenCV runs BM with OpenCL if it gets UMats.
+      if (cv::ocl::useOpenCL()) {
+        VLOG(1) << "Running BM with OpenCL.";
+        backend_ = StereoMatcherBackend::kOpenCl;
+      } else {
+        LOG(WARNING) << "OpenCL is not available, running BM on the CPU.";
+      }
+    }
   }
 
   // Cache some intrinsics values:
   const std::shared_ptr<OutputCameraParameters> left_params =
-      undistorter_first_->getCameraParametersPair().getOutputPtr();
+      rectification_->undistorter_first->getCameraParametersPair()
+          .getOutputPtr();
   const std::shared_ptr<OutputCameraParameters> right_params =
-      undistorter_second_->getCameraParametersPair().getOutputPtr();
+      rectification_->undistorter_second->getCameraParametersPair()
+          .getOutputPtr();
 
   focal_length_ = left_params->P()(0, 0);
   baseline_ = (right_params->P()(0, 3) - left_params->P()(0, 3)) /
@@ -177,27 +206,124 @@ StereoMatcher::StereoMatcher(
   CHECK_GT(std::abs(baseline_), 1e-6);
 }
 
-void StereoMatcher::computeDisparityMap(
+bool StereoMatcher::createCudaStereoSgm() {
+#ifdef DENSE_RECONSTRUCTION_HAVE_CUDA_SGM
+  if (cv::cuda::getCudaEnabledDeviceCount() == 0) {
+    LOG(WARNING) << "No CUDA device found, running SGBM on the CPU.";
+    return false;
+  }
+  // The CUDA matcher only supports these disparity ranges, use the smallest
+  // one that covers the configured range.
+  int num_disparities = 0;
+  for (const int supported_num_disparities : {64, 128, 256}) {
+    if (config_.sgbm_num_disparities <= supported_num_disparities) {
+      num_disparities = supported_num_disparities;
+      break;
+    }
+  }
+  if (num_disparities == 0) {
+    LOG(WARNING) << "The CUDA matcher supports at most 256 disparities but "
+                 << config_.sgbm_num_disparities << " are configured, "
+                 << "running SGBM on the CPU.";
+    return false;
+  }
+  // Only the HH modes are supported, MODE_HH4 is the closest to the default
+  // MODE_SGBM.
+  const int mode = (config_.sgbm_mode == cv::StereoSGBM::MODE_HH)
+                       ? cv::StereoSGBM::MODE_HH
+                       : cv::StereoSGBM::MODE_HH4;
+  stereo_matcher_ = cv::cuda::createStereoSGM(
+      config_.sgbm_min_disparity, num_disparities, config_.cuda_sgm_p1,
+      config_.cuda_sgm_p2, config_.sgbm_uniqueness_ratio, mode);
+
+  min_disparity_ = config_.sgbm_min_disparity;
+  num_disparities_ = num_disparities;
+  // The census transform window of the CUDA matcher is 9x7.
+  sad_window_size_ = 9;
+  backend_ = StereoMatcherBackend::kCuda;
+  return true;
+#else
+  LOG(WARNING) << "OpenCV was built without the CUDA semi-global matcher, "
+               << "running SGBM on the CPU.";
+  return false;
+#endif
+}
+
+void StereoMatcher::rectifyImages(
     const cv::Mat& first_image, const cv::Mat& second_image,
-    cv::Mat* disparity_map, cv::Mat* first_image_undistorted,
-    cv::Mat* second_image_undistorted) const {
-  CHECK_NOTNULL(disparity_map);
+    cv::Mat* first_image_undistorted, cv::Mat* second_image_undistorted) const {
   CHECK_NOTNULL(first_image_undistorted);
   CHECK_NOTNULL(second_image_undistorted);
-  CHECK(undistorter_first_);
-  CHECK(undistorter_second_);
-  CHECK(stereo_matcher_);
+  CHECK(rectification_);
 
   VLOG(5) << "Undistorting and rectifying images...";
-  undistorter_first_->undistortImage(first_image, first_image_undistorted);
-  undistorter_second_->undistortImage(second_image, second_image_undistorted);
+  rectification_->undistorter_first->undistortImage(
+      first_image, first_image_undistorted);
+  rectification_->undistorter_second->undistortImage(
+      second_image, second_image_undistorted);
+}
+
+void StereoMatcher::computeDisparityMapFromRectifiedImages(
+    const cv::Mat& first_image_undistorted,
+    const cv::Mat& second_image_undistorted, cv::Mat* disparity_map) const {
+  CHECK_NOTNULL(disparity_map);
+  CHECK(stereo_matcher_);
 
   VLOG(5) << "Computing disparity map...";
-  stereo_matcher_->compute(
-      *first_image_undistorted, *second_image_undistorted, *disparity_map);
+  switch (backend_) {
+    case StereoMatcherBackend::kCpu:
+      stereo_matcher_->compute(
+          first_image_undistorted, second_image_undistorted, *disparity_map);
+      break;
+    case StereoMatcherBackend::kCuda: {
+#ifdef DENSE_RECONSTRUCTION_HAVE_CUDA_SGM
+      cv::cuda::GpuMat first_image_gpu, second_image_gpu, disparity_map_gpu;
+      first_image_gpu.upload(first_image_undistorted);
+      second_image_gpu.upload(second_image_undistorted);
+      stereo_matcher_->compute(
+          first_image_gpu, second_image_gpu, disparity_map_gpu);
+      disparity_map_gpu.download(*disparity_map);
+      // Unlike StereoSGBM, the CUDA matcher doesn't filter speckles.
+      if (config_.sgbm_speckle_window_size > 0) {
+        cv::filterSpeckles(
+            *disparity_map,
+            (min_disparity_ - 1) * cv::StereoMatcher::DISP_SCALE,
+            config_.sgbm_speckle_window_size,
+            config_.sgbm_speckle_range * cv::StereoMatcher::DISP_SCALE);
+      }
+#else
+      LOG(FATAL) << "Built without the CUDA semi-global matcher.";
+#endif
+      break;
+    }
+    case StereoMatcherBackend::kOpenCl: {
+      cv::UMat disparity_map_ocl;
+      stereo_matcher_->compute(
+          first_image_undistorted.getUMat(cv::ACCESS_READ),
+          second_image_undistorted.getUMat(cv::ACCESS_READ),
+          disparity_map_ocl);
+      disparity_map_ocl.copyTo(*disparity_map);
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown stereo matcher backend "
+                 << static_cast<int>(backend_);
+  }
   VLOG(5) << "Done.";
 }
 
+void StereoMatcher::computeDisparityMap(
+    const cv::Mat& first_image, const cv::Mat& second_image,
+    cv::Mat* disparity_map, cv::Mat* first_image_undistorted,
+    cv::Mat* second_image_undistorted) const {
+  CHECK_NOTNULL(disparity_map);
+  rectifyImages(
+      first_image, second_image, first_image_undistorted,
+      second_image_undistorted);
+  computeDisparityMapFromRectifiedImages(
+      *first_image_undistorted, *second_image_undistorted, disparity_map);
+}
+
 void StereoMatcher::computePointCloud(
     const cv::Mat& first_image, const cv::Mat& second_image,
     resources::PointCloud* point_cloud) const {
@@ -3,6 +3,9 @@
 #include <vector>
 
 #include <Eigen/Dense>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/pose-types.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <map-resources/resource-common.h>
@@ -13,6 +16,7 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "dense-reconstruction/aslam-cv-interface.h"
 #include "dense-reconstruction/disparity-conversion-utils.h"
 #include "dense-reconstruction/resource-utils.h"
 #include "dense-reconstruction/stereo-camera-utils.h"
@@ -341,6 +345,42 @@ TEST_F(StereoDenseReconstructionTest, TestStereoDenseReconstructionKitti) {
   computeStereoReconstruction("kitti", 388692u);
 }
 
+TEST(StereoRectificationCacheTest, SharesMapsOfTheSameCalibration) {
+  clearStereoRectificationCache();
+  aslam::Camera::Ptr first_camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  aslam::Camera::Ptr second_camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  aslam::Transformation T_C2_C1(
+      Eigen::Quaterniond::Identity(), Eigen::Vector3d(-0.1, 0.0, 0.0));
+  constexpr double kScale = 1.0;
+
+  const std::shared_ptr<const StereoRectification> rectification =
+      getCachedStereoRectification(
+          *first_camera, *second_camera, T_C2_C1, kScale);
+  ASSERT_TRUE(rectification);
+  EXPECT_EQ(
+      rectification, getCachedStereoRectification(
+                         *first_camera, *second_camera, T_C2_C1, kScale));
+
+  // A changed calibration gets its own maps.
+  T_C2_C1.getPosition().x() = -0.2;
+  const std::shared_ptr<const StereoRectification> moved_rectification =
+      getCachedStereoRectification(
+          *first_camera, *second_camera, T_C2_C1, kScale);
+  EXPECT_NE(rectification, moved_rectification);
+  first_camera->getParametersMutable()[0] += 1.0;
+  EXPECT_NE(
+      moved_rectification, getCachedStereoRectification(
+                               *first_camera, *second_camera, T_C2_C1, kScale));
+
+  clearStereoRectificationCache();
+  first_camera->getParametersMutable()[0] -= 1.0;
+  EXPECT_NE(
+      moved_rectification, getCachedStereoRectification(
+                               *first_camera, *second_camera, T_C2_C1, kScale));
+}
+
 }  // namespace stereo
 }  // namespace dense_reconstruction
 
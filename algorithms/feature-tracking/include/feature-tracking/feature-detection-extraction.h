@@ -8,6 +8,7 @@
 #include <aslam/cameras/camera.h>
 #include <aslam/common/memory.h>
 #include <aslam/common/occupancy-grid.h>
+#include <aslam/frames/visual-frame.h>
 #include <aslam/frames/visual-nframe.h>
 #include <aslam/matcher/match.h>
 #include <aslam/tracker/feature-tracker.h>
@@ -27,6 +28,23 @@ class FeatureDetectorExtractor {
 
  private:
   void initialize();
+  cv::Ptr<cv::DescriptorExtractor> createExtractor() const;
+
+  // Splits the keypoints into contiguous blocks and computes the descriptors
+  // of the blocks in parallel, each with its own extractor. The keypoints
+  // keep their order, keypoints without a descriptor are removed. The packed
+  // descriptors are written straight into the column-major layout of the
+  // visual frame, one column per keypoint.
+  void extractDescriptors(
+      const cv::Mat& image, std::vector<cv::KeyPoint>* keypoints,
+      aslam::VisualFrame::DescriptorsT* descriptors) const;
+
+  // Fills the keypoint channels of a frame without keypoints and moves the
+  // descriptors into it.
+  void insertKeypointsAndDescriptorsIntoEmptyFrame(
+      const std::vector<cv::KeyPoint>& keypoints,
+      aslam::VisualFrame::DescriptorsT* descriptors,
+      aslam::VisualFrame* frame) const;
 
   /// \brief  A simple non-maximum suppression algorithm that erases keypoints
   ///         in a specified radius around a queried keypoint if their response
@@ -45,7 +63,10 @@ class FeatureDetectorExtractor {
   const aslam::Camera& camera_;
 
   cv::Ptr<cv::FeatureDetector> detector_;
+  // Returned by getExtractorPtr() for the tracker, which may run while the
+  // next frame is detected. The extraction therefore uses its own extractors.
   cv::Ptr<cv::DescriptorExtractor> extractor_;
+  std::vector<cv::Ptr<cv::DescriptorExtractor>> block_extractors_;
 
  public:
   // Descriptor extractor settings are stored in this struct.
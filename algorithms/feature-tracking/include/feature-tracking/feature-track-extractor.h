@@ -1,7 +1,7 @@
 #ifndef FEATURE_TRACKING_FEATURE_TRACK_EXTRACTOR_H_
 #define FEATURE_TRACKING_FEATURE_TRACK_EXTRACTOR_H_
 
-#include <unordered_map>
+#include <cstdint>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -170,11 +170,50 @@ class FeatureTrackExtractor {
   /// @}
 
  private:
+  /// Bookkeeping of the tracks of one camera. The active opportunistic tracks
+  /// are kept in a pool of slots that are reused once a track ends, and a
+  /// table indexed by the track id holds the state of every track id seen so
+  /// far. The trackers hand out consecutive non-negative track ids, so the
+  /// table stays dense and lookups don't need any hashing.
+  struct CameraTracks {
+    struct TrackIdEntry {
+      TrackIdEntry()
+          : opportunistic_slot(-1),
+            last_seen_update(0u),
+            keypoint_index(-1),
+            previous_keypoint_index(-1) {}
+      /// Pool slot of the active opportunistic track, -1 if there is none.
+      int opportunistic_slot;
+      /// Update in which the track id was last observed, 0 if never.
+      uint32_t last_seen_update;
+      /// Keypoint index in the frame of that update, and in the frame of the
+      /// update before it if it was observed there too (-1 otherwise).
+      int keypoint_index;
+      int previous_keypoint_index;
+    };
+
+    CameraTracks() : num_updates(0u), num_opportunistic_tracks(0u) {}
+
+    /// Grows the table if the track id hasn't been seen before.
+    TrackIdEntry& getEntry(int track_id);
+
+    /// Starts an opportunistic track in a free slot and returns it.
+    aslam::FeatureTrack& addOpportunisticTrack(int track_id);
+    void removeOpportunisticTrack(int slot);
+    void removeAllOpportunisticTracks();
+
+    std::vector<TrackIdEntry> track_id_entries;
+    aslam::FeatureTracks track_pool;
+    std::vector<unsigned char> is_slot_active;
+    std::vector<int> free_slots;
+    uint32_t num_updates;
+    size_t num_opportunistic_tracks;
+  };
+
   const std::shared_ptr<const aslam::NCamera> camera_rig_;
 
-  typedef std::unordered_map<int, aslam::FeatureTrack> TrackIdToFeatureTrackMap;
-  /// Currently opportunistic tracks stored with their id.
-  std::vector<TrackIdToFeatureTrackMap> opportunistic_tracks_;
+  /// Tracks of every camera.
+  std::vector<CameraTracks> camera_tracks_;
   /// Currently persistent tracks stored with their id.
   std::vector<std::unordered_set<int>> persistent_trackids_;
   /// Pointer to the previous frame.
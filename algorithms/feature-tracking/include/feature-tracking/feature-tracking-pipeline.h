@@ -2,6 +2,7 @@
 #define FEATURE_TRACKING_FEATURE_TRACKING_PIPELINE_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <aslam/common/memory.h>
@@ -9,7 +10,9 @@
 #include <aslam/frames/feature-track.h>
 #include <aslam/visualization/feature-track-visualizer.h>
 #include <maplab-common/macros.h>
+#include <opencv2/core/core.hpp>
 #include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
 
 #include "feature-tracking/feature-detection-extraction.h"
 #include "feature-tracking/feature-track-extractor.h"
@@ -21,7 +24,6 @@ class VisualNFrame;
 
 namespace vi_map {
 class VIMap;
-class MissionId;
 }
 
 namespace aslam_cv_visualization {
@@ -43,6 +45,9 @@ class FeatureTrackingPipeline {
   virtual ~FeatureTrackingPipeline() = default;
 
   /// Reruns tracking and triangulation on all missions of the given map.
+  /// The missions are tracked concurrently, each on its own pipeline, see
+  /// --feature_tracker_num_parallel_missions. The new landmarks are added to
+  /// the map once all missions are tracked.
   /// Note: This at first removes all existing landmarks and observations in the
   /// map!
   void runTrackingAndTriangulationForAllMissions(vi_map::VIMap* map);
@@ -62,20 +67,47 @@ class FeatureTrackingPipeline {
   const bool visualize_keypoint_matches_;
 
  private:
+  // Creates an uninitialized pipeline of the same type with its own tracker
+  // state, to track a mission concurrently with the others.
+  virtual FeatureTrackingPipeline::UniquePtr createPipelineForMission()
+      const = 0;
   virtual void initialize(const aslam::NCamera::ConstPtr& ncamera) = 0;
   virtual void trackFeaturesNFrame(
       const aslam::Transformation& T_Bk_Bkp1, aslam::VisualNFrame* nframe_k,
       aslam::VisualNFrame* nframe_kp1) = 0;
 
-  // Loads the raw-images specified in the resources table of the given map and
-  // assigns them to the frames of the nframe of the given vertex.
+  // A landmark of this mission that is only added to the map in
+  // addTriangulatedLandmarksToMap, such that missions can be tracked
+  // concurrently on the same map.
+  struct TriangulatedLandmark {
+    vi_map::LandmarkId landmark_id;
+    // Position in the frame of the vertex of the first observation.
+    Eigen::Vector3d p_B;
+    vi_map::KeypointIdentifier first_observation;
+    std::vector<vi_map::KeypointIdentifier> other_observations;
+  };
+  typedef std::pair<pose_graph::VertexId, std::vector<cv::Mat>>
+      VertexRawImages;
+
+  // Tracks the features and triangulates the landmarks of the mission, but
+  // neither adds the landmarks to the map nor touches any other mission.
+  void trackAndTriangulateMission(
+      const vi_map::MissionId& mission_id, vi_map::VIMap* map);
+  void addTriangulatedLandmarksToMap(vi_map::VIMap* map);
+
+  // Loads the raw-images specified in the resources table of the given map for
+  // all frames of the given vertex.
+  void loadRawImages(
+      const pose_graph::VertexId& vertex_id, const vi_map::VIMap& map,
+      std::vector<cv::Mat>* images) const;
+  // Assigns the raw-images to the frames of the nframe.
   void assignRawImagesToNFrame(
-      const pose_graph::VertexId& vertex_id, vi_map::VIMap* map) const;
+      const std::vector<cv::Mat>& images, aslam::VisualNFrame* nframe) const;
 
-  // Looks for terminated feature tracks, triangulates them and adds them to the
-  // given map.
+  // Looks for terminated feature tracks, triangulates them and queues them to
+  // be added to the given map.
   void extractAndTriangulateTerminatedFeatureTracks(
-      const aslam::VisualNFrame::ConstPtr& nframe, vi_map::VIMap* map);
+      const aslam::VisualNFrame::ConstPtr& nframe, const vi_map::VIMap& map);
 
   aslam_cv_visualization::VisualNFrameFeatureTrackVisualizer
       feature_track_visualizer_;
@@ -88,6 +120,8 @@ class FeatureTrackingPipeline {
 
   bool processed_first_nframe_;
 
+  std::vector<TriangulatedLandmark> triangulated_landmarks_;
+
   statistics::Accumulator<size_t, size_t, statistics::kInfiniteWindowSize>
       successfully_triangulated_landmarks_accumulator_;
 };
@@ -14,6 +14,11 @@
 
 namespace feature_tracking {
 
+// Suppresses every keypoint that has a neighbor closer than the radius whose
+// response scaled by the ratio threshold is still larger than its own.
+// The keypoints are bucketed into a grid with cells of at least the radius, so
+// each keypoint is only compared against the keypoints of the 3x3 cells around
+// it. The order of the remaining keypoints is kept.
 // TODO(magehrig): Local non-maximum suppression only on octave level for
 //                 improved scale invariance.
 inline void localNonMaximumSuppression(
@@ -32,98 +37,99 @@ inline void localNonMaximumSuppression(
   const float radius_sq = radius * radius;
   const size_t num_keypoints = keypoints->size();
 
-  struct KeyPointData {
-    KeyPointData(const cv::KeyPoint& keypoint, const size_t _keypoint_index)
-        : coordinates{keypoint.pt.x, keypoint.pt.y},  // NOLINT
-          response(keypoint.response),
-          keypoint_index(_keypoint_index) {}
-    std::array<float, 2> coordinates;
-    float response;
-    size_t keypoint_index;
-  };
-
-  typedef std::vector<KeyPointData>::const_iterator KeyPointDataIterator;
-
-  std::function<bool(const KeyPointData&, KeyPointDataIterator)>  // NOLINT
-      IsInsideCircle = [radius_sq](
-          const KeyPointData& keypoint_1,
-          KeyPointDataIterator keypoint_iterator_2) -> bool {
-    const float x_diff =
-        keypoint_1.coordinates[0] - keypoint_iterator_2->coordinates[0];
-    const float y_diff =
-        keypoint_1.coordinates[1] - keypoint_iterator_2->coordinates[1];
-    return (x_diff * x_diff + y_diff * y_diff) < radius_sq;
-  };
-
-  std::function<size_t(const int, const int, const int)> Clamp =
-      [](  // NOLINT
-          const int lower, const int upper, const int in) -> size_t {
-    return std::min<int>(std::max<int>(in, lower), upper);
-  };
-
-  std::vector<KeyPointData> keypoint_data_vector;
-  keypoint_data_vector.reserve(num_keypoints);
+  // The grid spans the bounding box of the keypoints, which for the grided
+  // detection is a single detection cell and not the whole image.
+  float min_x = (*keypoints)[0].pt.x;
+  float min_y = (*keypoints)[0].pt.y;
+  float max_x = min_x;
+  float max_y = min_y;
+  for (const cv::KeyPoint& keypoint : *keypoints) {
+    min_x = std::min(min_x, keypoint.pt.x);
+    min_y = std::min(min_y, keypoint.pt.y);
+    max_x = std::max(max_x, keypoint.pt.x);
+    max_y = std::max(max_y, keypoint.pt.y);
+  }
+  // Larger cells are still correct, they only cost more comparisons. This
+  // keeps the grid small for tiny radii.
+  constexpr float kMaxNumGridCellsPerAxis = 256.0f;
+  const float cell_size = std::max(
+      radius,
+      std::max(max_x - min_x, max_y - min_y) / kMaxNumGridCellsPerAxis);
+  const float inv_cell_size = 1.0f / cell_size;
+  const int grid_cols = static_cast<int>((max_x - min_x) * inv_cell_size) + 1;
+  const int grid_rows = static_cast<int>((max_y - min_y) * inv_cell_size) + 1;
+
+  std::vector<int> cell_indices(num_keypoints);
   for (size_t i = 0u; i < num_keypoints; ++i) {
-    keypoint_data_vector.emplace_back((*keypoints)[i], i);
+    const cv::Point2f& point = (*keypoints)[i].pt;
+    const int col = std::min(
+        static_cast<int>((point.x - min_x) * inv_cell_size), grid_cols - 1);
+    const int row = std::min(
+        static_cast<int>((point.y - min_y) * inv_cell_size), grid_rows - 1);
+    cell_indices[i] = row * grid_cols + col;
   }
 
-  // Create LUT of keypoints in y axis.
-  std::sort(
-      keypoint_data_vector.begin(), keypoint_data_vector.end(),
-      [](const KeyPointData& lhs, const KeyPointData& rhs) -> bool {
-        return lhs.coordinates[1] < rhs.coordinates[1];
-      });
-
-  std::vector<size_t> corner_row_LUT;
-  corner_row_LUT.reserve(image_height);
-
-  size_t num_kpts_below_y = 0u;
-  for (size_t y = 0u; y < image_height; ++y) {
-    while (num_kpts_below_y < num_keypoints &&
-           y > keypoint_data_vector[num_kpts_below_y].coordinates[1]) {
-      ++num_kpts_below_y;
+  // Counting sort of the keypoints by cell, row-major. The keypoints of the
+  // cells of a grid row are contiguous, so the three neighboring cells in a
+  // row are a single range [cell_begin[first], cell_begin[last + 1]).
+  std::vector<size_t> cell_begin(grid_rows * grid_cols + 1, 0u);
+  for (const int cell_index : cell_indices) {
+    ++cell_begin[cell_index + 1];
+  }
+  for (size_t cell = 1u; cell < cell_begin.size(); ++cell) {
+    cell_begin[cell] += cell_begin[cell - 1u];
+  }
+  std::vector<float> x(num_keypoints);
+  std::vector<float> y(num_keypoints);
+  std::vector<float> response(num_keypoints);
+  std::vector<size_t> keypoint_index(num_keypoints);
+  {
+    std::vector<size_t> cell_fill(cell_begin.begin(), cell_begin.end() - 1);
+    for (size_t i = 0u; i < num_keypoints; ++i) {
+      const size_t sorted_index = cell_fill[cell_indices[i]]++;
+      const cv::KeyPoint& keypoint = (*keypoints)[i];
+      x[sorted_index] = keypoint.pt.x;
+      y[sorted_index] = keypoint.pt.y;
+      response[sorted_index] = keypoint.response;
+      keypoint_index[sorted_index] = i;
     }
-    corner_row_LUT.push_back(num_kpts_below_y);
   }
-  CHECK_EQ(num_kpts_below_y, keypoint_data_vector.size());
 
-  // Create a list of keypoints to reject.
-  std::vector<bool> erase_keypoints(num_keypoints, false);
-
-  for (size_t i = 0u; i < num_keypoints; ++i) {
-    const KeyPointData& current_keypoint_data = keypoint_data_vector[i];
-    const size_t y_top = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::floor(current_keypoint_data.coordinates[1] - radius));
-    const size_t y_bottom = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::ceil(current_keypoint_data.coordinates[1] + radius));
-    CHECK_LT(y_top, image_height);
-    CHECK_LE(y_bottom, image_height);
-
-    CHECK_LT(corner_row_LUT[y_top], keypoint_data_vector.size());
-    CHECK_LE(corner_row_LUT[y_bottom], keypoint_data_vector.size());
-    KeyPointDataIterator nearest_corners_begin =
-        keypoint_data_vector.begin() + corner_row_LUT[y_top];
-    KeyPointDataIterator nearest_corners_end =
-        keypoint_data_vector.begin() + corner_row_LUT[y_bottom];
-
-    for (KeyPointDataIterator it = nearest_corners_begin;
-         it != nearest_corners_end; ++it) {
-      if (it->keypoint_index == current_keypoint_data.keypoint_index ||
-          erase_keypoints[it->keypoint_index] ||
-          !IsInsideCircle(current_keypoint_data, it)) {
-        continue;
-      }
-      const float response_threshold =
-          ratio_threshold * current_keypoint_data.response;
-      if (response_threshold > it->response) {
-        erase_keypoints[it->keypoint_index] = true;
+  // Indexed like the sorted keypoints. Plain bytes instead of std::vector<bool>
+  // so the inner loop has no branches and can be vectorized.
+  std::vector<unsigned char> suppressed(num_keypoints, 0u);
+  for (int row = 0; row < grid_rows; ++row) {
+    const int row_begin = std::max(row - 1, 0);
+    const int row_end = std::min(row + 1, grid_rows - 1);
+    for (int col = 0; col < grid_cols; ++col) {
+      const int col_begin = std::max(col - 1, 0);
+      const int col_end = std::min(col + 1, grid_cols - 1);
+      const size_t cell = row * grid_cols + col;
+      for (size_t i = cell_begin[cell]; i < cell_begin[cell + 1u]; ++i) {
+        const float x_i = x[i];
+        const float y_i = y[i];
+        const float response_threshold = ratio_threshold * response[i];
+        for (int neighbor_row = row_begin; neighbor_row <= row_end;
+             ++neighbor_row) {
+          const size_t begin = cell_begin[neighbor_row * grid_cols + col_begin];
+          const size_t end =
+              cell_begin[neighbor_row * grid_cols + col_end + 1];
+          for (size_t j = begin; j < end; ++j) {
+            const float x_diff = x_i - x[j];
+            const float y_diff = y_i - y[j];
+            suppressed[j] |= (x_diff * x_diff + y_diff * y_diff < radius_sq) &
+                             (response_threshold > response[j]) & (i != j);
+          }
+        }
       }
     }
   }
 
-  // Remove the flaged non-maximum keypoints.
+  // Remove the flagged non-maximum keypoints.
+  std::vector<bool> erase_keypoints(num_keypoints, false);
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    erase_keypoints[keypoint_index[i]] = suppressed[i] != 0u;
+  }
   std::vector<bool>::iterator it_erase = erase_keypoints.begin();
 
   std::vector<cv::KeyPoint>::iterator it_erase_from = std::remove_if(
@@ -196,11 +202,12 @@ inline void detectKeypointsGrided(
     }
   };
 
+  // One task per cell; the tasks run on the shared task scheduler, so this
+  // does not oversubscribe the cores when several cameras detect at once.
   const size_t num_cells = grid_rows * grid_cols;
-  const size_t num_threads = std::max(size_t(1u), num_cells / 2u);
   common::ParallelProcess(
       num_cells, detectFeaturesOfGridCells, /*kAlwaysParallelize=*/true,
-      num_threads);
+      num_cells);
   cv::KeyPointsFilter::retainBest(*keypoints, max_total_keypoints);
 }
 
@@ -1,6 +1,9 @@
 #ifndef FEATURE_TRACKING_VO_FEATURE_TRACKING_PIPELINE_H_
 #define FEATURE_TRACKING_VO_FEATURE_TRACKING_PIPELINE_H_
 
+#include <future>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <aslam/common/memory.h>
@@ -29,7 +32,15 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
       aslam::FrameToFrameMatchesList* inlier_matches_kp1_k,
       aslam::FrameToFrameMatchesList* outlier_matches_kp1_k);
 
+  // Starts the keypoint detection and descriptor extraction on all frames of
+  // the nframe in the background. trackFeaturesNFrame waits for it, so the
+  // detection on the next nframe can overlap with the matching and outlier
+  // rejection of the current pair.
+  void detectFeaturesNFrameAsync(const aslam::VisualNFrame::Ptr& nframe);
+
  private:
+  virtual FeatureTrackingPipeline::UniquePtr createPipelineForMission()
+      const override;
   virtual void initialize(const aslam::NCamera::ConstPtr& ncamera) override;
   virtual void trackFeaturesNFrame(
       const aslam::Transformation& T_Bk_Bkp1, aslam::VisualNFrame* nframe_k,
@@ -41,6 +52,8 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
       aslam::FrameToFrameMatches* inlier_matches_kp1_k,
       aslam::FrameToFrameMatches* outlier_matches_kp1_k);
 
+  void waitForPendingDetections(const aslam::VisualNFrame& nframe);
+
   aslam::NCamera::ConstPtr ncamera_;
   /// Keypoint detector and descriptor extractors that detect keypoints in each
   /// frame and compute a descriptor for each one of them.
@@ -54,8 +67,13 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
   std::vector<std::unique_ptr<aslam::TrackManager>> track_managers_;
   /// Thread pool for tracking and track extraction.
   std::unique_ptr<aslam::ThreadPool> thread_pool_;
+  /// One single-threaded pool per camera for the background detection, so
+  /// the detections of a camera never run concurrently.
+  std::vector<std::unique_ptr<aslam::ThreadPool>> detection_thread_pools_;
 
-  bool has_feature_extraction_been_performed_on_first_nframe_;
+  std::mutex m_pending_detections_;
+  std::unordered_map<aslam::NFramesId, std::vector<std::future<void>>>
+      pending_detections_;
 };
 }  // namespace feature_tracking
 
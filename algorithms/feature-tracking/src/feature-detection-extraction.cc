@@ -2,12 +2,16 @@
 
 #include "feature-tracking/feature-detection-extraction.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <aslam/common/statistics/statistics.h>
 #include <aslam/common/timer.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/tracker/tracking-helpers.h>
 #include <brisk/brisk.h>
 #include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
 #include <opencv/highgui.h>
 #include <opencv2/core/version.hpp>
 #include <opencv2/features2d.hpp>
@@ -16,6 +20,17 @@
 #include "feature-tracking/grided-detector.h"
 
 DEFINE_bool(use_grided_detections, true, "Use multiple detectors on a grid?");
+DEFINE_int32(
+    feature_tracking_detection_grid_cols, 3,
+    "Number of grid columns of the grided detection. The cells are detected "
+    "in parallel.");
+DEFINE_int32(
+    feature_tracking_detection_grid_rows, 2,
+    "Number of grid rows of the grided detection.");
+DEFINE_int32(
+    feature_tracking_descriptor_extraction_num_blocks, 4,
+    "Number of keypoint blocks whose descriptors are extracted in parallel. "
+    "1 extracts all descriptors on the calling thread.");
 
 namespace feature_tracking {
 
@@ -48,23 +63,156 @@ void FeatureDetectorExtractor::initialize() {
       detector_settings_.orb_detector_patch_size,
       detector_settings_.orb_detector_fast_threshold);
 
+  CHECK_GT(FLAGS_feature_tracking_detection_grid_cols, 0);
+  CHECK_GT(FLAGS_feature_tracking_detection_grid_rows, 0);
+  CHECK_GT(FLAGS_feature_tracking_descriptor_extraction_num_blocks, 0);
+  extractor_ = createExtractor();
+  block_extractors_.reserve(
+      FLAGS_feature_tracking_descriptor_extraction_num_blocks);
+  for (int i = 0; i < FLAGS_feature_tracking_descriptor_extraction_num_blocks;
+       ++i) {
+    block_extractors_.emplace_back(createExtractor());
+  }
+}
+
+cv::Ptr<cv::DescriptorExtractor> FeatureDetectorExtractor::createExtractor()
+    const {
   switch (extractor_settings_.descriptor_type) {
     case SweFeatureTrackingExtractorSettings::DescriptorType::kBrisk:
-      extractor_ = new brisk::BriskDescriptorExtractor(
+      return new brisk::BriskDescriptorExtractor(
           extractor_settings_.rotation_invariant,
           extractor_settings_.scale_invariant);
-      break;
     case SweFeatureTrackingExtractorSettings::DescriptorType::kOcvFreak:
-      extractor_ = cv::xfeatures2d::FREAK::create(
+      return cv::xfeatures2d::FREAK::create(
           extractor_settings_.rotation_invariant,
           extractor_settings_.scale_invariant,
           extractor_settings_.freak_pattern_scale,
           detector_settings_.orb_detector_pyramid_levels);
-      break;
     default:
       LOG(FATAL) << "Unknown descriptor type.";
       break;
   }
+  return cv::Ptr<cv::DescriptorExtractor>();
+}
+
+void FeatureDetectorExtractor::extractDescriptors(
+    const cv::Mat& image, std::vector<cv::KeyPoint>* keypoints,
+    aslam::VisualFrame::DescriptorsT* descriptors) const {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(descriptors);
+  CHECK(!block_extractors_.empty());
+  if (keypoints->empty()) {
+    descriptors->resize(0, 0);
+    return;
+  }
+
+  // The extractors may drop keypoints, e.g. close to the image border, so the
+  // blocks are merged after all of them are done.
+  const size_t num_blocks =
+      std::min(block_extractors_.size(), keypoints->size());
+  const size_t block_size = (keypoints->size() + num_blocks - 1u) / num_blocks;
+  std::vector<std::vector<cv::KeyPoint>> block_keypoints(num_blocks);
+  std::vector<cv::Mat> block_descriptors(num_blocks);
+  if (num_blocks == 1u) {
+    block_keypoints.front().swap(*keypoints);
+  } else {
+    for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+      const size_t begin = std::min(block_idx * block_size, keypoints->size());
+      const size_t end = std::min(begin + block_size, keypoints->size());
+      block_keypoints[block_idx].assign(
+          keypoints->begin() + begin, keypoints->begin() + end);
+    }
+  }
+
+  auto extractBlocks = [&](const std::vector<size_t>& range) {
+    for (const size_t block_idx : range) {
+      if (!block_keypoints[block_idx].empty()) {
+        block_extractors_[block_idx]->compute(
+            image, block_keypoints[block_idx], block_descriptors[block_idx]);
+      }
+    }
+  };
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      num_blocks, extractBlocks, kAlwaysParallelize, num_blocks);
+
+  size_t num_keypoints = 0u;
+  int descriptor_size_bytes = 0;
+  for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+    const cv::Mat& block = block_descriptors[block_idx];
+    if (block_keypoints[block_idx].empty()) {
+      continue;
+    }
+    CHECK_EQ(block.rows, static_cast<int>(block_keypoints[block_idx].size()));
+    CHECK_EQ(block.type(), CV_8UC1);
+    CHECK(descriptor_size_bytes == 0 || descriptor_size_bytes == block.cols);
+    descriptor_size_bytes = block.cols;
+    num_keypoints += block_keypoints[block_idx].size();
+  }
+
+  // A row-major view of the column-major descriptor matrix has one
+  // descriptor per row, which is the layout of the OpenCV extractors. The
+  // blocks are therefore copied once, directly into the frame storage.
+  keypoints->clear();
+  keypoints->reserve(num_keypoints);
+  descriptors->resize(descriptor_size_bytes, num_keypoints);
+  if (num_keypoints == 0u) {
+    return;
+  }
+  cv::Mat descriptors_view(
+      static_cast<int>(num_keypoints), descriptor_size_bytes, CV_8UC1,
+      descriptors->data());
+  int row = 0;
+  for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+    if (block_keypoints[block_idx].empty()) {
+      continue;
+    }
+    const cv::Mat& block = block_descriptors[block_idx];
+    block.copyTo(descriptors_view.rowRange(row, row + block.rows));
+    row += block.rows;
+    keypoints->insert(
+        keypoints->end(), block_keypoints[block_idx].begin(),
+        block_keypoints[block_idx].end());
+  }
+}
+
+void FeatureDetectorExtractor::insertKeypointsAndDescriptorsIntoEmptyFrame(
+    const std::vector<cv::KeyPoint>& keypoints,
+    aslam::VisualFrame::DescriptorsT* descriptors,
+    aslam::VisualFrame* frame) const {
+  CHECK_NOTNULL(descriptors);
+  CHECK_NOTNULL(frame);
+  CHECK(
+      !frame->hasKeypointMeasurements() ||
+      frame->getNumKeypointMeasurements() == 0u);
+  const size_t num_keypoints = keypoints.size();
+  CHECK_EQ(static_cast<size_t>(descriptors->cols()), num_keypoints);
+
+  Eigen::Matrix2Xd measurements(2, num_keypoints);
+  Eigen::VectorXd orientations(num_keypoints);
+  Eigen::VectorXd scores(num_keypoints);
+  Eigen::VectorXd scales(num_keypoints);
+  for (size_t idx = 0u; idx < num_keypoints; ++idx) {
+    const cv::KeyPoint& keypoint = keypoints[idx];
+    measurements(0, idx) = keypoint.pt.x;
+    measurements(1, idx) = keypoint.pt.y;
+    orientations(idx) = keypoint.angle;
+    scores(idx) = keypoint.response;
+    scales(idx) = keypoint.size;
+  }
+  Eigen::VectorXd uncertainties = Eigen::VectorXd::Constant(
+      num_keypoints, detector_settings_.keypoint_uncertainty_px);
+  Eigen::VectorXi track_ids = Eigen::VectorXi::Constant(num_keypoints, -1);
+
+  // Note: It is important that the values are set even if there are no
+  // keypoints as downstream code may rely on the keypoints being set.
+  frame->swapKeypointMeasurements(&measurements);
+  frame->swapKeypointMeasurementUncertainties(&uncertainties);
+  frame->swapKeypointOrientations(&orientations);
+  frame->swapKeypointScores(&scores);
+  frame->swapKeypointScales(&scales);
+  frame->swapDescriptors(descriptors);
+  frame->swapTrackIds(&track_ids);
 }
 
 cv::Ptr<cv::DescriptorExtractor> FeatureDetectorExtractor::getExtractorPtr()
@@ -89,14 +237,13 @@ void FeatureDetectorExtractor::detectAndExtractFeatures(
   if (FLAGS_use_grided_detections) {
     // Grided detection to ensure a certain distribution of keypoints across
     // the image.
-    constexpr size_t kNumGridCols = 3;
-    constexpr size_t kNumGridRows = 2;
     detectKeypointsGrided(
         detector_, image, /*detection_mask=*/cv::Mat(),
         detector_settings_.max_feature_count,
         detector_settings_.detector_nonmaxsuppression_radius,
         detector_settings_.detector_nonmaxsuppression_ratio_threshold,
-        kNumGridCols, kNumGridRows, &keypoints_cv);
+        FLAGS_feature_tracking_detection_grid_rows,
+        FLAGS_feature_tracking_detection_grid_cols, &keypoints_cv);
   } else {
     detector_->detect(image, keypoints_cv);
 
@@ -156,19 +303,12 @@ void FeatureDetectorExtractor::detectAndExtractFeatures(
   timing::Timer timer_extraction("descriptor extraction");
 
   // Compute the descriptors.
-  cv::Mat descriptors_cv;
-  if (!keypoints_cv.empty()) {
-    extractor_->compute(frame->getRawImage(), keypoints_cv, descriptors_cv);
-  } else {
-    descriptors_cv = cv::Mat(0, 0, CV_8UC1);
-  }
+  aslam::VisualFrame::DescriptorsT descriptors;
+  extractDescriptors(frame->getRawImage(), &keypoints_cv, &descriptors);
 
   timer_extraction.Stop();
 
-  // Note: It is important that the values are set even if there are no
-  // keypoints as downstream code may rely on the keypoints being set.
-  aslam::insertCvKeypointsAndDescriptorsIntoEmptyVisualFrame(
-      keypoints_cv, descriptors_cv, detector_settings_.keypoint_uncertainty_px,
-      frame);
+  insertKeypointsAndDescriptorsIntoEmptyFrame(
+      keypoints_cv, &descriptors, frame);
 }
 }  // namespace feature_tracking
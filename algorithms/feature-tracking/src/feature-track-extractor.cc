@@ -1,7 +1,6 @@
 #include <algorithm>
 #include <iterator>
-
-#include <unordered_map>
+#include <map>
 #include <unordered_set>
 
 #include <Eigen/Dense>
@@ -9,6 +8,7 @@
 #include <aslam/frames/visual-frame.h>
 #include <aslam/frames/visual-nframe.h>
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
 
 #include "feature-tracking/feature-track-extractor.h"
 
@@ -36,10 +36,60 @@ FeatureTrackExtractor::FeatureTrackExtractor(
   CHECK(camera_rig);
   const size_t num_cameras = camera_rig->getNumCameras();
   CHECK_GT(num_cameras, 0u);
-  opportunistic_tracks_.resize(num_cameras);
+  camera_tracks_.resize(num_cameras);
   persistent_trackids_.resize(num_cameras);
 }
 
+FeatureTrackExtractor::CameraTracks::TrackIdEntry&
+FeatureTrackExtractor::CameraTracks::getEntry(const int track_id) {
+  CHECK_GE(track_id, 0);
+  if (static_cast<size_t>(track_id) >= track_id_entries.size()) {
+    track_id_entries.resize(track_id + 1);
+  }
+  return track_id_entries[track_id];
+}
+
+aslam::FeatureTrack& FeatureTrackExtractor::CameraTracks::addOpportunisticTrack(
+    const int track_id) {
+  TrackIdEntry& entry = getEntry(track_id);
+  CHECK_LT(entry.opportunistic_slot, 0);
+  if (free_slots.empty()) {
+    entry.opportunistic_slot = track_pool.size();
+    track_pool.emplace_back(track_id);
+    is_slot_active.push_back(true);
+  } else {
+    entry.opportunistic_slot = free_slots.back();
+    free_slots.pop_back();
+    track_pool[entry.opportunistic_slot] = aslam::FeatureTrack(track_id);
+    is_slot_active[entry.opportunistic_slot] = true;
+  }
+  ++num_opportunistic_tracks;
+  return track_pool[entry.opportunistic_slot];
+}
+
+void FeatureTrackExtractor::CameraTracks::removeOpportunisticTrack(
+    const int slot) {
+  CHECK_GE(slot, 0);
+  CHECK_LT(static_cast<size_t>(slot), track_pool.size());
+  CHECK(is_slot_active[slot]);
+  TrackIdEntry& entry = getEntry(track_pool[slot].getTrackId());
+  CHECK_EQ(entry.opportunistic_slot, slot);
+  entry.opportunistic_slot = -1;
+  is_slot_active[slot] = false;
+  free_slots.push_back(slot);
+  CHECK_GT(num_opportunistic_tracks, 0u);
+  --num_opportunistic_tracks;
+}
+
+void FeatureTrackExtractor::CameraTracks::removeAllOpportunisticTracks() {
+  for (size_t slot = 0u; slot < track_pool.size(); ++slot) {
+    if (is_slot_active[slot]) {
+      removeOpportunisticTrack(slot);
+    }
+  }
+  CHECK_EQ(num_opportunistic_tracks, 0u);
+}
+
 size_t FeatureTrackExtractor::extractFromNFrameStream(
     const aslam::VisualNFrame::ConstPtr& nframe,
     aslam::FeatureTracksList* tracks_opportunistic_terminated) {
@@ -54,19 +104,26 @@ size_t FeatureTrackExtractor::extractFromNFrameStream(
   std::vector<std::unordered_set<int>> tracks_persistent_terminated(
       num_cameras);
 
-  // TODO(schneith): Use the thread pool at some point.
+  // The cameras have separate books, so they are processed in parallel.
   const bool kTrackPersistentFeatures = false;
+  auto extract_cameras = [&](const std::vector<size_t>& range) {
+    for (const size_t camera_idx : range) {
+      (*tracks_opportunistic_terminated)[camera_idx].reserve(
+          nframe->getFrame(camera_idx).getNumKeypointMeasurements());
+      extractFromFrameStreamImpl(
+          nframe, camera_idx, kTrackPersistentFeatures,
+          &(*tracks_opportunistic_terminated)[camera_idx],
+          &tracks_persistent_new[camera_idx],
+          &tracks_persistent_continued[camera_idx],
+          &tracks_persistent_terminated[camera_idx]);
+    }
+  };
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      num_cameras, extract_cameras, kAlwaysParallelize, num_cameras);
+
   size_t num_tracks = 0;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    (*tracks_opportunistic_terminated)[camera_idx].reserve(
-        nframe->getFrame(camera_idx).getNumKeypointMeasurements());
-    extractFromFrameStreamImpl(
-        nframe, camera_idx, kTrackPersistentFeatures,
-        &(*tracks_opportunistic_terminated)[camera_idx],
-        &tracks_persistent_new[camera_idx],
-        &tracks_persistent_continued[camera_idx],
-        &tracks_persistent_terminated[camera_idx]);
-
     // This method doesn't track persistent features, therefore the following
     // lists have to be
     // empty.
@@ -99,23 +156,27 @@ void FeatureTrackExtractor::extractFromNFrameStream(
   tracks_persistent_continued->resize(num_cameras);
   tracks_persistent_terminated->resize(num_cameras);
 
-  // TODO(schneith): Use the thread pool at some point.
+  // The cameras have separate books, so they are processed in parallel.
   const bool kTrackpersistentFeatures = true;
   const double kKeypointToTrackRatioGuess = 0.5;
   const size_t num_reserve = kKeypointToTrackRatioGuess *
                              nframe->getFrame(0).getNumKeypointMeasurements();
-  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    (*tracks_opportunistic_terminated)[camera_idx].reserve(num_reserve);
-    (*tracks_opportunistic_terminated)[camera_idx].reserve(num_reserve);
-    (*tracks_persistent_continued)[camera_idx].reserve(num_reserve);
-    (*tracks_persistent_terminated)[camera_idx].reserve(num_reserve);
-    extractFromFrameStreamImpl(
-        nframe, camera_idx, kTrackpersistentFeatures,
-        &(*tracks_opportunistic_terminated)[camera_idx],
-        &(*tracks_persistent_new)[camera_idx],
-        &(*tracks_persistent_continued)[camera_idx],
-        &(*tracks_persistent_terminated)[camera_idx]);
-  }
+  auto extract_cameras = [&](const std::vector<size_t>& range) {
+    for (const size_t camera_idx : range) {
+      (*tracks_opportunistic_terminated)[camera_idx].reserve(num_reserve);
+      (*tracks_persistent_continued)[camera_idx].reserve(num_reserve);
+      (*tracks_persistent_terminated)[camera_idx].reserve(num_reserve);
+      extractFromFrameStreamImpl(
+          nframe, camera_idx, kTrackpersistentFeatures,
+          &(*tracks_opportunistic_terminated)[camera_idx],
+          &(*tracks_persistent_new)[camera_idx],
+          &(*tracks_persistent_continued)[camera_idx],
+          &(*tracks_persistent_terminated)[camera_idx]);
+    }
+  };
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      num_cameras, extract_cameras, kAlwaysParallelize, num_cameras);
   previous_nframe_ = nframe;
 }
 
@@ -177,7 +238,7 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
   CHECK(nframe);
   CHECK_EQ(camera_rig_.get(), nframe->getNCameraShared().get());
   CHECK_LT(camera_idx, nframe->getNumCameras());
-  CHECK_LT(camera_idx, opportunistic_tracks_.size());
+  CHECK_LT(camera_idx, camera_tracks_.size());
   CHECK_LT(camera_idx, persistent_trackids_.size());
   const aslam::VisualFrame& frame = nframe->getFrame(camera_idx);
   CHECK(frame.hasTrackIds());
@@ -187,32 +248,11 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
   CHECK_NOTNULL(tracks_persistent_continued);
   CHECK_NOTNULL(tracks_persistent_terminated);
 
-  // If there is a previous frame, we need to build a LUT mapping track id to
-  // keypoint index in
-  // order to be able to quickly look up the keypoint index in the previous
-  // frame for a given new
-  // track id in the current frame.
-  typedef std::unordered_map<int, int> TrackIdToKeypointIndexMap;
-  TrackIdToKeypointIndexMap previous_frame_track_id_keypoint_index_map;
-  if (previous_nframe_) {
-    const Eigen::VectorXi& previous_track_ids =
-        previous_nframe_->getFrame(camera_idx).getTrackIds();
-
-    const size_t num_track_ids = static_cast<size_t>(previous_track_ids.rows());
-    previous_frame_track_id_keypoint_index_map.reserve(num_track_ids);
-
-    for (size_t keypoint_idx = 0u; keypoint_idx < num_track_ids;
-         ++keypoint_idx) {
-      const int track_id = previous_track_ids(keypoint_idx);
-      if (track_id >= 0) {
-        previous_frame_track_id_keypoint_index_map.insert(
-            std::make_pair(track_id, keypoint_idx));
-      }
-    }
-  }
+  CameraTracks& camera_tracks = camera_tracks_[camera_idx];
+  std::unordered_set<int>& persistent_trackids =
+      persistent_trackids_[camera_idx];
+  const uint32_t update = ++camera_tracks.num_updates;
 
-  // Find currently new and continued tracks.
-  std::unordered_set<int> present_tracks;
   const Eigen::VectorXi& current_track_ids = frame.getTrackIds();
   const size_t num_keypoints = frame.getNumKeypointMeasurements();
   size_t num_track_ids = static_cast<size_t>(current_track_ids.rows());
@@ -227,16 +267,25 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
 
     if (track_id >= 0) {
       CHECK_LT(keypoint_idx_current_frame, num_keypoints);
-      // Add all valid tracks_ids seen in this frame to a list that is compared
-      // to the list of
-      // opportunistic tracks to determine which tracks have terminated.
-      present_tracks.insert(track_id);
-
-      TrackIdToFeatureTrackMap::iterator it_track =
-          opportunistic_tracks_[camera_idx].find(track_id);
-      if (it_track != opportunistic_tracks_[camera_idx].end()) {
+      // Mark the track id as seen in this update. Tracks that are not marked
+      // at the end of the update have terminated. The keypoint index of the
+      // previous frame is kept for looking up the previous observation.
+      CameraTracks::TrackIdEntry& entry = camera_tracks.getEntry(track_id);
+      if (entry.last_seen_update != update) {
+        const bool seen_in_previous_frame =
+            previous_nframe_ && entry.last_seen_update > 0u &&
+            entry.last_seen_update + 1u == update;
+        entry.previous_keypoint_index =
+            seen_in_previous_frame ? entry.keypoint_index : -1;
+        entry.keypoint_index = keypoint_idx_current_frame;
+        entry.last_seen_update = update;
+      }
+      const int keypoint_idx_in_previous_frame = entry.previous_keypoint_index;
+
+      if (entry.opportunistic_slot >= 0) {
         // This is a continued track as there is already an entry in the books.
-        aslam::FeatureTrack& continued_track = it_track->second;
+        const int slot = entry.opportunistic_slot;
+        aslam::FeatureTrack& continued_track = camera_tracks.track_pool[slot];
         const int continued_track_id = continued_track.getTrackId();
         CHECK_EQ(track_id, continued_track_id);
 
@@ -249,29 +298,26 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
           if (track_persistent_features) {
             // Return the current track and convert it to a persistent track.
             tracks_persistent_new->emplace_back(continued_track);
-            opportunistic_tracks_[camera_idx].erase(it_track);
+            camera_tracks.removeOpportunisticTrack(slot);
             // Add it to the list of persistent tracks. This will avoid that a
             // new opportunistic
             // track is spawned for this trackid in the next update and future
             // observations are
             // returned as ContinuedFeatureTracks messages.
-            persistent_trackids_[camera_idx].insert(continued_track_id);
+            persistent_trackids.insert(continued_track_id);
             VLOG(100) << "New persistent track with track id " << track_id
                       << " in camera " << camera_idx;
           } else {
             // Add the track to the terminated tracks. It ends at the previous
             // frame.
             tracks_opportunistic_terminated->emplace_back(continued_track);
-            opportunistic_tracks_[camera_idx].erase(it_track);
+            camera_tracks.removeOpportunisticTrack(slot);
 
-            // Cut and start a new track starting at the current frame.
-            aslam::FeatureTrack new_track(track_id);
-            new_track.addKeypointObservationAtBack(
-                nframe, camera_idx, keypoint_idx_current_frame);
-            CHECK(
-                opportunistic_tracks_[camera_idx]
-                    .emplace(track_id, new_track)
-                    .second);
+            // Cut and start a new track starting at the current frame, reusing
+            // the slot.
+            camera_tracks.addOpportunisticTrack(track_id)
+                .addKeypointObservationAtBack(
+                    nframe, camera_idx, keypoint_idx_current_frame);
           }
         } else {
           // Simply append the current keypoint to the existing track.
@@ -282,25 +328,21 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
         // This is a new track as the TrackId isn't in the books so far. Either
         // we need to start
         // a new track or we output a track continuation message.
-        std::unordered_set<int>::const_iterator it =
-            persistent_trackids_[camera_idx].find(track_id);
         const bool is_persistent_track =
-            (it != persistent_trackids_[camera_idx].end());
+            persistent_trackids.count(track_id) > 0u;
 
         if (is_persistent_track) {
           // Output the ContinuedFeatureTracks message.
           CHECK(previous_nframe_);
-          TrackIdToKeypointIndexMap::iterator it =
-              previous_frame_track_id_keypoint_index_map.find(track_id);
-          CHECK(it != previous_frame_track_id_keypoint_index_map.end());
-          const int keypoint_idx_in_previous_frame = it->second;
+          CHECK_GE(keypoint_idx_in_previous_frame, 0);
           tracks_persistent_continued->emplace_back(
               track_id, aslam::KeypointIdentifier::create(
                             previous_nframe_, camera_idx,
                             keypoint_idx_in_previous_frame));
         } else {
           // This is a new track.
-          aslam::FeatureTrack new_track(track_id);
+          aslam::FeatureTrack& new_track =
+              camera_tracks.addOpportunisticTrack(track_id);
 
           // If there is a previous frame and if we can find the track id in the
           // previous frame,
@@ -309,59 +351,48 @@ void FeatureTrackExtractor::extractFromFrameStreamImpl(
           // This is needed as the tracker writes matches to the frame k-1 and k
           // when starting a
           // new track.
-          if (previous_nframe_) {
-            TrackIdToKeypointIndexMap::iterator it =
-                previous_frame_track_id_keypoint_index_map.find(track_id);
-            if (it != previous_frame_track_id_keypoint_index_map.end()) {
-              // Found the track id in the previous frame.
-              const int keypoint_idx_in_previous_frame = it->second;
-              new_track.addKeypointObservationAtBack(
-                  previous_nframe_, camera_idx, keypoint_idx_in_previous_frame);
-            }
+          if (keypoint_idx_in_previous_frame >= 0) {
+            new_track.addKeypointObservationAtBack(
+                previous_nframe_, camera_idx, keypoint_idx_in_previous_frame);
           }
 
           new_track.addKeypointObservationAtBack(
               nframe, camera_idx, keypoint_idx_current_frame);
-          opportunistic_tracks_[camera_idx].emplace(track_id, new_track);
         }
       }
     }
   }
 
   // Check for opportunistic tracks which terminated in the last frame.
-  TrackIdToFeatureTrackMap::iterator track_it =
-      opportunistic_tracks_[camera_idx].begin();
-  while (track_it != opportunistic_tracks_[camera_idx].end()) {
+  for (size_t slot = 0u; slot < camera_tracks.track_pool.size(); ++slot) {
+    if (!camera_tracks.is_slot_active[slot]) {
+      continue;
+    }
+    const aslam::FeatureTrack& finished_track = camera_tracks.track_pool[slot];
+    const int feature_track_id = finished_track.getTrackId();
     // If it is not new or continued, it is a terminated track!
-    const int feature_track_id = track_it->first;
-
-    if (present_tracks.count(feature_track_id) == 0u) {
-      // Track is not new or continued, so it is a terminated track.
-      const aslam::FeatureTrack& finished_track = track_it->second;
+    if (camera_tracks.getEntry(feature_track_id).last_seen_update != update) {
       // Only return tracks whose length is at least the min. track length.
       if (finished_track.getTrackLength() >= min_track_length_) {
         tracks_opportunistic_terminated->push_back(finished_track);
         VLOG(200) << "Track finished with id " << feature_track_id
                   << " and length " << finished_track.getTrackLength();
       }
-      track_it = opportunistic_tracks_[camera_idx].erase(track_it);
-    } else {
-      ++track_it;
+      camera_tracks.removeOpportunisticTrack(slot);
     }
   }
 
   // Check for persistent tracks that terminated in the last frame.
-  std::unordered_set<int>::iterator trackid_it =
-      persistent_trackids_[camera_idx].begin();
-  while (trackid_it != persistent_trackids_[camera_idx].end()) {
+  std::unordered_set<int>::iterator trackid_it = persistent_trackids.begin();
+  while (trackid_it != persistent_trackids.end()) {
     // If it is not new or continued, it is a terminated track!
     const int feature_track_id = *trackid_it;
 
     // If persistent trackid was not seen during this update, we terminate the
     // persistent track.
-    if (present_tracks.count(feature_track_id) == 0u) {
+    if (camera_tracks.getEntry(feature_track_id).last_seen_update != update) {
       tracks_persistent_terminated->insert(feature_track_id);
-      trackid_it = persistent_trackids_[camera_idx].erase(trackid_it);
+      trackid_it = persistent_trackids.erase(trackid_it);
     } else {
       ++trackid_it;
     }
@@ -428,11 +459,12 @@ size_t FeatureTrackExtractor::abortAndReturnOpportunisticTracks(
   // Get all opportunistic tracks.
   size_t num_tracks = 0;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    for (const TrackIdToFeatureTrackMap::value_type&
-             active_opportunistic_track : opportunistic_tracks_[camera_idx]) {
-      if (active_opportunistic_track.second.getTrackLength() >=
-          min_track_length_) {
-        (*all_tracks)[camera_idx].push_back(active_opportunistic_track.second);
+    const CameraTracks& camera_tracks = camera_tracks_[camera_idx];
+    for (size_t slot = 0u; slot < camera_tracks.track_pool.size(); ++slot) {
+      if (camera_tracks.is_slot_active[slot] &&
+          camera_tracks.track_pool[slot].getTrackLength() >=
+              min_track_length_) {
+        (*all_tracks)[camera_idx].push_back(camera_tracks.track_pool[slot]);
         ++num_tracks;
       }
     }
@@ -452,47 +484,41 @@ void FeatureTrackExtractor::abortAndReturnNLongestOpportunisticTracks(
   aborted_tracks->reserve(num_tracks_to_abort);
 
   // Build an index of track length over all cameras.
-  typedef std::pair<size_t, int> CameraIdxTrackIdPair;
-  typedef std::map<size_t, CameraIdxTrackIdPair>
+  typedef std::pair<size_t, int> CameraIdxSlotPair;
+  typedef std::multimap<size_t, CameraIdxSlotPair>
       TrackLengthOpportunisticTrackMap;
   TrackLengthOpportunisticTrackMap tracklength_track_map;
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    for (const TrackIdToFeatureTrackMap::value_type&
-             active_opportunistic_track : opportunistic_tracks_[camera_idx]) {
-      const aslam::FeatureTrack& track = active_opportunistic_track.second;
+    const CameraTracks& camera_tracks = camera_tracks_[camera_idx];
+    for (size_t slot = 0u; slot < camera_tracks.track_pool.size(); ++slot) {
+      if (!camera_tracks.is_slot_active[slot]) {
+        continue;
+      }
+      const aslam::FeatureTrack& track = camera_tracks.track_pool[slot];
       if (track.getTrackLength() >= min_track_length) {
         tracklength_track_map.emplace(
             std::make_pair(
                 track.getTrackLength(),
-                CameraIdxTrackIdPair(camera_idx, track.getTrackId())));
+                CameraIdxSlotPair(camera_idx, static_cast<int>(slot))));
       }
     }
   }
 
   // Abort and return the N longest tracks.
-  TrackLengthOpportunisticTrackMap::reverse_iterator it_length_trackid =
+  TrackLengthOpportunisticTrackMap::reverse_iterator it_length_slot =
       tracklength_track_map.rbegin();
-  for (; it_length_trackid != tracklength_track_map.rend();
-       ++it_length_trackid) {
-    const size_t camera_idx = it_length_trackid->second.first;
-    const int track_id = it_length_trackid->second.second;
-    CHECK_GE(track_id, 0);
-
-    // Find the active opportunistic track.
-    CHECK_LT(camera_idx, opportunistic_tracks_.size());
-    TrackIdToFeatureTrackMap::iterator it_active_opportunistic_track =
-        opportunistic_tracks_[camera_idx].find(track_id);
-    CHECK(
-        it_active_opportunistic_track !=
-        opportunistic_tracks_[camera_idx].end());
-
-    // Add to output and abort the active track.
-    aborted_tracks->emplace_back(it_active_opportunistic_track->second);
-    opportunistic_tracks_[camera_idx].erase(it_active_opportunistic_track);
-
+  for (; it_length_slot != tracklength_track_map.rend(); ++it_length_slot) {
     if (aborted_tracks->size() >= num_tracks_to_abort) {
       break;
     }
+    const size_t camera_idx = it_length_slot->second.first;
+    const int slot = it_length_slot->second.second;
+    CHECK_LT(camera_idx, camera_tracks_.size());
+    CameraTracks& camera_tracks = camera_tracks_[camera_idx];
+
+    // Add to output and abort the active track.
+    aborted_tracks->emplace_back(camera_tracks.track_pool[slot]);
+    camera_tracks.removeOpportunisticTrack(slot);
   }
   CHECK_LE(aborted_tracks->size(), num_tracks_to_abort);
 }
@@ -512,8 +538,8 @@ void FeatureTrackExtractor::abortPersistentTracksByTrackId(
 
 size_t FeatureTrackExtractor::getNumOpportunisticTracks(
     size_t camera_idx) const {
-  CHECK_LT(camera_idx, opportunistic_tracks_.size());
-  return opportunistic_tracks_[camera_idx].size();
+  CHECK_LT(camera_idx, camera_tracks_.size());
+  return camera_tracks_[camera_idx].num_opportunistic_tracks;
 }
 
 size_t FeatureTrackExtractor::getNumPersistentTracks(size_t camera_idx) const {
@@ -523,10 +549,12 @@ size_t FeatureTrackExtractor::getNumPersistentTracks(size_t camera_idx) const {
 
 void FeatureTrackExtractor::reset() {
   const size_t num_cameras = camera_rig_->getNumCameras();
-  CHECK_EQ(num_cameras, opportunistic_tracks_.size());
+  CHECK_EQ(num_cameras, camera_tracks_.size());
   CHECK_EQ(num_cameras, persistent_trackids_.size());
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
-    opportunistic_tracks_[camera_idx].clear();
+    // The track id table is kept, the observations in the previous frame are
+    // still needed to start new tracks.
+    camera_tracks_[camera_idx].removeAllOpportunisticTracks();
     persistent_trackids_[camera_idx].clear();
   }
 }
@@ -1,8 +1,13 @@
 #include "feature-tracking/feature-tracking-pipeline.h"
 
+#include <algorithm>
+#include <future>
+#include <thread>
+
 #include <aslam/cameras/camera.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/statistics/statistics.h>
+#include <aslam/common/thread-pool.h>
 #include <aslam/common/timer.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/frames/visual-nframe.h>
@@ -13,6 +18,7 @@
 #include <aslam/visualization/feature-track-visualizer.h>
 #include <glog/logging.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <vi-map/check-map-consistency.h>
@@ -45,6 +51,15 @@ DEFINE_bool(
     "Flag indicating whether the map is checked for consistency after "
     "rerunning the feature tracking.");
 
+DEFINE_uint64(
+    feature_tracker_num_parallel_missions, 4u,
+    "Number of missions that are tracked at the same time when rerunning the "
+    "feature tracking on all missions.");
+
+DEFINE_uint64(
+    feature_tracker_image_read_ahead_size, 8u,
+    "Number of vertices whose raw images are loaded ahead of the tracker.");
+
 namespace feature_tracking {
 
 FeatureTrackingPipeline::FeatureTrackingPipeline()
@@ -58,41 +73,89 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForAllMissions(
   CHECK_NOTNULL(map);
 
   // First, remove all landmarks from the map.
-  vi_map::LandmarkIdList landmark_ids;
-  map->getAllLandmarkIds(&landmark_ids);
-
-  common::ProgressBar cleaning_bar(landmark_ids.size());
-  VLOG(1) << "Removing all " << landmark_ids.size()
-          << " landmarks from the map.";
-  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
-    map->removeLandmark(landmark_id);
-    cleaning_bar.increment();
-  }
+  vi_map::MissionIdSet all_mission_ids;
+  map->getAllMissionIds(&all_mission_ids);
+  map->removeAllLandmarksOfMissions(all_mission_ids);
 
   vi_map::MissionIdList mission_id_list;
   map->getAllMissionIds(&mission_id_list);
+  if (mission_id_list.empty()) {
+    return;
+  }
+
+  // Every mission gets its own pipeline, so the tracker state isn't shared.
+  // The missions only read the shared parts of the map while they are
+  // tracked, the landmarks are added afterwards.
+  std::vector<FeatureTrackingPipeline::UniquePtr> mission_pipelines;
+  mission_pipelines.reserve(mission_id_list.size());
+  for (size_t mission_idx = 0u; mission_idx < mission_id_list.size();
+       ++mission_idx) {
+    mission_pipelines.emplace_back(createPipelineForMission());
+    CHECK(mission_pipelines.back());
+  }
 
+  const size_t num_threads = std::max<size_t>(
+      1u, std::min<size_t>(
+              FLAGS_feature_tracker_num_parallel_missions,
+              mission_id_list.size()));
   VLOG(1) << "Running tracking and triangulation for each of the "
-          << mission_id_list.size() << " missions.";
-  for (const vi_map::MissionId& id : mission_id_list) {
-    runTrackingAndTriangulationForMission(id, map);
+          << mission_id_list.size() << " missions on " << num_threads
+          << " threads.";
+  {
+    aslam::ThreadPool thread_pool(num_threads);
+    std::vector<std::future<void>> tracked_missions;
+    tracked_missions.reserve(mission_id_list.size());
+    for (size_t mission_idx = 0u; mission_idx < mission_id_list.size();
+         ++mission_idx) {
+      FeatureTrackingPipeline* mission_pipeline =
+          mission_pipelines[mission_idx].get();
+      const vi_map::MissionId& mission_id = mission_id_list[mission_idx];
+      tracked_missions.emplace_back(
+          thread_pool.enqueue([mission_pipeline, mission_id, map]() {
+            mission_pipeline->trackAndTriangulateMission(mission_id, map);
+          }));
+    }
+    for (std::future<void>& tracked_mission : tracked_missions) {
+      tracked_mission.get();
+    }
+    thread_pool.stop();
+  }
+
+  VLOG(1) << "Adding the triangulated landmarks of all missions to the map.";
+  for (const FeatureTrackingPipeline::UniquePtr& mission_pipeline :
+       mission_pipelines) {
+    mission_pipeline->addTriangulatedLandmarksToMap(map);
+  }
+
+  if (FLAGS_feature_tracker_check_map_for_consistency) {
+    VLOG(1) << "Checking the modified map for consistency...";
+    CHECK(vi_map::checkMapConsistency(*map));
+    VLOG(1) << "The modified map is consistent";
   }
 }
 
-void FeatureTrackingPipeline::assignRawImagesToNFrame(
-    const pose_graph::VertexId& vertex_id, vi_map::VIMap* map) const {
-  CHECK_NOTNULL(map)->hasVertex(vertex_id);
-  vi_map::Vertex& vertex = map->getVertex(vertex_id);
-  const aslam::VisualNFrame::Ptr& nframe = vertex.getVisualNFrameShared();
-  CHECK(nframe);
-  const size_t num_frames = nframe->getNumFrames();
-  // Set the raw images of nframe_kp1.
+void FeatureTrackingPipeline::loadRawImages(
+    const pose_graph::VertexId& vertex_id, const vi_map::VIMap& map,
+    std::vector<cv::Mat>* images) const {
+  CHECK_NOTNULL(images)->clear();
+  CHECK(map.hasVertex(vertex_id));
+  const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+  const size_t num_frames = vertex.numFrames();
+  images->resize(num_frames);
   for (size_t frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
-    cv::Mat image;
-    CHECK(map->getRawImage(vertex, frame_idx, &image))
+    CHECK(map.getRawImage(vertex, frame_idx, &(*images)[frame_idx]))
         << "Vertex " << vertex_id << " does not have a raw image for frame "
         << frame_idx;
+  }
+}
 
+void FeatureTrackingPipeline::assignRawImagesToNFrame(
+    const std::vector<cv::Mat>& images, aslam::VisualNFrame* nframe) const {
+  CHECK_NOTNULL(nframe);
+  const size_t num_frames = nframe->getNumFrames();
+  CHECK_EQ(images.size(), num_frames);
+  for (size_t frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
+    const cv::Mat& image = images[frame_idx];
     if (FLAGS_feature_tracker_publish_raw_images) {
       const std::string topic = feature_tracking_ros_base_topic_ +
                                 "camera_raw_" + std::to_string(frame_idx);
@@ -103,8 +166,7 @@ void FeatureTrackingPipeline::assignRawImagesToNFrame(
 }
 
 void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
-    const aslam::VisualNFrame::ConstPtr& nframe, vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
+    const aslam::VisualNFrame::ConstPtr& nframe, const vi_map::VIMap& map) {
   CHECK(track_extractor_);
 
   aslam::FeatureTracksList terminated_tracks;
@@ -146,7 +208,7 @@ void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
             nframe_id_to_vertex_id_map_.find(keypoint_identifier.getNFrameId());
         CHECK(vertex_iterator != nframe_id_to_vertex_id_map_.end());
         const pose_graph::VertexId& vertex_id = vertex_iterator->second;
-        T_G_Is.emplace_back(map->getVertex_T_G_I(vertex_id));
+        T_G_Is.emplace_back(map.getVertex_T_G_I(vertex_id));
 
         // Obtain the normalized keypoint measurements.
         const Eigen::Vector2d& keypoint_measurement =
@@ -184,21 +246,18 @@ void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
         // Frames: Ib = Landmark base-frame.
         //         G = Global frame.
         const aslam::Transformation T_Ib_G =
-            map->getVertex_T_G_I(first_observation_vertex_id).inverse();
-
-        vi_map::Landmark landmark;
-        landmark.set_p_B(T_Ib_G * G_landmark);
-
-        // Create store landamrk ID and add the landmark to the map.
-        vi_map::LandmarkId landmark_id;
-        common::generateId(&landmark_id);
-        landmark.setId(landmark_id);
-        map->addNewLandmark(
-            landmark, first_observation_vertex_id,
-            first_observation_keypoint_identifier.getFrameIndex(),
+            map.getVertex_T_G_I(first_observation_vertex_id).inverse();
+
+        TriangulatedLandmark landmark;
+        common::generateId(&landmark.landmark_id);
+        landmark.p_B = T_Ib_G * G_landmark;
+        landmark.first_observation = vi_map::KeypointIdentifier(
+            vi_map::VisualFrameIdentifier(
+                first_observation_vertex_id,
+                first_observation_keypoint_identifier.getFrameIndex()),
             first_observation_keypoint_identifier.getKeypointIndex());
 
-        // Add all observations to the map.
+        // Keep all other observations for the map.
         for (const aslam::KeypointIdentifier& keypoint_identifier :
              keypoint_identifiers) {
           NFrameIdToVertexIdMap::iterator vertex_iterator =
@@ -207,16 +266,18 @@ void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
           CHECK(vertex_iterator != nframe_id_to_vertex_id_map_.end());
           const pose_graph::VertexId& vertex_id = vertex_iterator->second;
 
-          // Skip the base observation. This is already added above when we add
+          // Skip the base observation. This is already added when we add
           // the new landmark.
           if (vertex_id == first_observation_vertex_id) {
             continue;
           }
 
-          map->associateKeypointWithExistingLandmark(
-              vertex_id, keypoint_identifier.getFrameIndex(),
-              keypoint_identifier.getKeypointIndex(), landmark_id);
+          landmark.other_observations.emplace_back(
+              vi_map::VisualFrameIdentifier(
+                  vertex_id, keypoint_identifier.getFrameIndex()),
+              keypoint_identifier.getKeypointIndex());
         }
+        triangulated_landmarks_.emplace_back(std::move(landmark));
       }
       successfully_triangulated_landmarks_accumulator_.Add(
           triangulation_result.wasTriangulationSuccessful() ? 1u : 0u);
@@ -224,23 +285,93 @@ void FeatureTrackingPipeline::extractAndTriangulateTerminatedFeatureTracks(
   }
 }
 
+void FeatureTrackingPipeline::addTriangulatedLandmarksToMap(
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  for (const TriangulatedLandmark& triangulated_landmark :
+       triangulated_landmarks_) {
+    // Create the store landmark and add the observations to the map.
+    vi_map::Landmark landmark;
+    landmark.setId(triangulated_landmark.landmark_id);
+    landmark.set_p_B(triangulated_landmark.p_B);
+    const vi_map::KeypointIdentifier& first_observation =
+        triangulated_landmark.first_observation;
+    map->addNewLandmark(
+        landmark, first_observation.frame_id.vertex_id,
+        first_observation.frame_id.frame_index,
+        first_observation.keypoint_index);
+    for (const vi_map::KeypointIdentifier& observation :
+         triangulated_landmark.other_observations) {
+      map->associateKeypointWithExistingLandmark(
+          observation, triangulated_landmark.landmark_id);
+    }
+  }
+  triangulated_landmarks_.clear();
+}
+
 void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
     vi_map::MissionId mission_id, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
+  trackAndTriangulateMission(mission_id, map);
+  addTriangulatedLandmarksToMap(map);
+
+  if (FLAGS_feature_tracker_check_map_for_consistency) {
+    VLOG(1) << "Checking the modified map for consistency...";
+    CHECK(vi_map::checkMapConsistency(*map));
+    VLOG(1) << "The modified map is consistent";
+  }
+}
+
+void FeatureTrackingPipeline::trackAndTriangulateMission(
+    const vi_map::MissionId& mission_id, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
   CHECK(map->hasMission(mission_id)) << "The given mission " << mission_id
                                      << " is not present in the map.";
   VLOG(1) << "Running tracking and triangulation for mission with ID "
           << mission_id;
   nframe_id_to_vertex_id_map_.clear();
-
-  pose_graph::VertexIdList all_vertices;
-  map->getAllVertexIdsInMission(mission_id, &all_vertices);
-
-  VLOG(1) << "Processing a total of " << all_vertices.size() << " vertices.";
-  common::ProgressBar progress_bar(all_vertices.size());
-
-  pose_graph::VertexId vertex_id_k =
+  processed_first_nframe_ = false;
+
+  // The vertices in the order they are tracked, such that their images can be
+  // loaded ahead of the tracker.
+  const pose_graph::Edge::EdgeType backbone_type =
+      map->getGraphTraversalEdgeType(mission_id);
+  pose_graph::VertexIdList ordered_vertex_ids;
+  pose_graph::VertexId current_vertex_id =
       map->getMission(mission_id).getRootVertexId();
+  do {
+    ordered_vertex_ids.emplace_back(current_vertex_id);
+  } while (map->getNextVertex(
+      current_vertex_id, backbone_type, &current_vertex_id));
+
+  VLOG(1) << "Processing a total of " << ordered_vertex_ids.size()
+          << " vertices.";
+  common::ProgressBar progress_bar(ordered_vertex_ids.size());
+
+  const size_t read_ahead_size =
+      std::max<size_t>(1u, FLAGS_feature_tracker_image_read_ahead_size);
+  common::ThreadSafeQueue<VertexRawImages> raw_images_queue;
+  std::thread read_ahead_thread(
+      [this, map, read_ahead_size, &ordered_vertex_ids, &raw_images_queue]() {
+        for (const pose_graph::VertexId& vertex_id : ordered_vertex_ids) {
+          VertexRawImages raw_images;
+          raw_images.first = vertex_id;
+          loadRawImages(vertex_id, *map, &raw_images.second);
+          if (!raw_images_queue.PushBlockingIfFull(
+                  raw_images, read_ahead_size)) {
+            return;
+          }
+        }
+      });
+  auto assign_next_raw_images = [this, &raw_images_queue](
+      const pose_graph::VertexId& vertex_id, aslam::VisualNFrame* nframe) {
+    VertexRawImages raw_images;
+    CHECK(raw_images_queue.PopBlocking(&raw_images));
+    CHECK_EQ(raw_images.first, vertex_id);
+    assignRawImagesToNFrame(raw_images.second, nframe);
+  };
+
+  pose_graph::VertexId vertex_id_k = ordered_vertex_ids.front();
   vi_map::Vertex& root_vertex = map->getVertex(vertex_id_k);
   // Initialize pipeline.
   const size_t num_frames = root_vertex.numFrames();
@@ -256,27 +387,25 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
   initialize(ncamera);
 
   // Process first nframe.
-  assignRawImagesToNFrame(vertex_id_k, map);
   aslam::VisualNFrame::Ptr nframe_k = root_vertex.getVisualNFrameShared();
+  assign_next_raw_images(vertex_id_k, nframe_k.get());
   nframe_k->clearKeypointChannelsOfAllFrames();
   nframe_id_to_vertex_id_map_.insert(
       std::make_pair(nframe_k->getId(), vertex_id_k));
   progress_bar.increment();
 
-  pose_graph::VertexId vertex_id_kp1;
-  while (map->getNextVertex(
-      vertex_id_k, map->getGraphTraversalEdgeType(mission_id),
-      &vertex_id_kp1)) {
+  for (size_t vertex_idx = 1u; vertex_idx < ordered_vertex_ids.size();
+       ++vertex_idx) {
+    const pose_graph::VertexId& vertex_id_kp1 = ordered_vertex_ids[vertex_idx];
     CHECK(vertex_id_k.isValid());
     CHECK(vertex_id_kp1.isValid());
     CHECK_NE(vertex_id_k, vertex_id_kp1);
     CHECK(nframe_k);
 
-    assignRawImagesToNFrame(vertex_id_kp1, map);
-
     vi_map::Vertex& vertex_kp1 = map->getVertex(vertex_id_kp1);
     CHECK_EQ(vertex_kp1.numFrames(), num_frames);
     aslam::VisualNFrame::Ptr nframe_kp1 = vertex_kp1.getVisualNFrameShared();
+    assign_next_raw_images(vertex_id_kp1, nframe_kp1.get());
     nframe_kp1->clearKeypointChannelsOfAllFrames();
     nframe_id_to_vertex_id_map_.insert(
         std::make_pair(nframe_kp1->getId(), vertex_id_kp1));
@@ -288,11 +417,11 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
 
     if (!processed_first_nframe_) {
       map->getVertex(vertex_id_k).resetObservedLandmarkIdsToInvalid();
-      extractAndTriangulateTerminatedFeatureTracks(nframe_k, map);
+      extractAndTriangulateTerminatedFeatureTracks(nframe_k, *map);
       processed_first_nframe_ = true;
     }
     map->getVertex(vertex_id_kp1).resetObservedLandmarkIdsToInvalid();
-    extractAndTriangulateTerminatedFeatureTracks(nframe_kp1, map);
+    extractAndTriangulateTerminatedFeatureTracks(nframe_kp1, *map);
 
     if (FLAGS_feature_tracker_visualize_keypoints) {
       cv::Mat image;
@@ -318,6 +447,8 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
     nframe_k = nframe_kp1;
     progress_bar.increment();
   }
+  read_ahead_thread.join();
+  nframe_k->releaseRawImagesOfAllFrames();
 
   VLOG(1) << "Successfully retracked features and triangulated new landmarks"
           << " for mission " << mission_id;
@@ -334,11 +465,5 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
                    100.0
             << "%";
   }
-
-  if (FLAGS_feature_tracker_check_map_for_consistency) {
-    VLOG(1) << "Checking the modified map for consistency...";
-    CHECK(vi_map::checkMapConsistency(*map));
-    VLOG(1) << "The modified map is consistent";
-  }
 }
 }  // namespace feature_tracking
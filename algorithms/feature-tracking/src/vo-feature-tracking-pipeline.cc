@@ -1,10 +1,10 @@
 #include "feature-tracking/vo-feature-tracking-pipeline.h"
 
-#include <aslam/common/timer.h>
 #include <aslam/geometric-vision/match-outlier-rejection-twopt.h>
 #include <aslam/tracker/feature-tracker-gyro.h>
 #include <aslam/visualization/basic-visualization.h>
 #include <maplab-common/conversions.h>
+#include <maplab-common/telemetry.h>
 #include <visualization/common-rviz-visualization.h>
 
 DEFINE_double(
@@ -56,7 +56,9 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   CHECK_GT(
       nframe_kp1->getMinTimestampNanoseconds(),
       nframe_k->getMinTimestampNanoseconds());
-  timing::Timer timer_eval("SweFeatureTracking::trackFeaturesNFrame");
+  static const common::telemetry::TimerMetric kTimerEval(
+      "SweFeatureTracking::trackFeaturesNFrame");
+  common::telemetry::ScopedTimer timer_eval(kTimerEval);
 
   const size_t num_cameras = nframe_kp1->getNumCameras();
   CHECK_EQ(num_cameras, trackers_.size());
@@ -67,6 +69,11 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   inlier_matches_kp1_k->resize(num_cameras);
   outlier_matches_kp1_k->resize(num_cameras);
 
+  // Frames detected with detectFeaturesNFrameAsync are only tracked once the
+  // detection is done.
+  waitForPendingDetections(*nframe_k);
+  waitForPendingDetections(*nframe_kp1);
+
   CHECK(thread_pool_);
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     aslam::VisualFrame* frame_kp1 =
@@ -79,7 +86,60 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   }
   thread_pool_->waitForEmptyQueue();
 
-  timer_eval.Stop();
+  timer_eval.stop();
+}
+
+void VOFeatureTrackingPipeline::detectFeaturesNFrameAsync(
+    const aslam::VisualNFrame::Ptr& nframe) {
+  CHECK(nframe);
+  CHECK(ncamera_.get() == nframe->getNCameraShared().get());
+  const size_t num_cameras = nframe->getNumCameras();
+  CHECK_EQ(num_cameras, detection_thread_pools_.size());
+
+  std::vector<std::future<void>> detections;
+  detections.reserve(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    if (!nframe->isFrameSet(camera_idx)) {
+      continue;
+    }
+    // The task keeps the nframe alive until its frame is detected.
+    FeatureDetectorExtractor* detector_extractor =
+        detectors_extractors_[camera_idx].get();
+    detections.emplace_back(
+        detection_thread_pools_[camera_idx]->enqueue(
+            [nframe, camera_idx, detector_extractor]() {
+              detector_extractor->detectAndExtractFeatures(
+                  nframe->getFrameShared(camera_idx).get());
+            }));
+  }
+
+  std::lock_guard<std::mutex> lock(m_pending_detections_);
+  CHECK(pending_detections_.emplace(nframe->getId(), std::move(detections))
+            .second)
+      << "The detection on nframe " << nframe->getId()
+      << " was already started.";
+}
+
+void VOFeatureTrackingPipeline::waitForPendingDetections(
+    const aslam::VisualNFrame& nframe) {
+  std::vector<std::future<void>> detections;
+  {
+    std::lock_guard<std::mutex> lock(m_pending_detections_);
+    std::unordered_map<aslam::NFramesId, std::vector<std::future<void>>>::
+        iterator it = pending_detections_.find(nframe.getId());
+    if (it == pending_detections_.end()) {
+      return;
+    }
+    detections.swap(it->second);
+    pending_detections_.erase(it);
+  }
+  static const common::telemetry::TimerMetric kTimerWait(
+      "VOFeatureTrackingPipeline: wait for detection");
+  common::telemetry::ScopedTimer timer_wait(kTimerWait);
+  for (std::future<void>& detection : detections) {
+    detection.get();
+  }
+  timer_wait.stop();
 }
 
 void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
@@ -87,7 +147,9 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
     aslam::VisualFrame* frame_kp1, aslam::VisualFrame* frame_k,
     aslam::FrameToFrameMatches* inlier_matches_kp1_k,
     aslam::FrameToFrameMatches* outlier_matches_kp1_k) {
-  timing::Timer timer("swe-feature-tracker: trackFeaturesSingleCamera");
+  static const common::telemetry::TimerMetric kTimer(
+      "swe-feature-tracker: trackFeaturesSingleCamera");
+  common::telemetry::ScopedTimer timer(kTimer);
   CHECK_LE(camera_idx, track_managers_.size());
   CHECK_NOTNULL(frame_k);
   CHECK_NOTNULL(frame_kp1);
@@ -97,11 +159,14 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
   outlier_matches_kp1_k->clear();
 
   // Initialize keypoints and descriptors in frame_k, if there aren't any.
-  if (!has_feature_extraction_been_performed_on_first_nframe_) {
+  // Checking the frame instead of a pipeline-wide flag keeps this correct for
+  // every camera. Frames detected ahead of time are not detected again.
+  if (!frame_k->hasKeypointMeasurements()) {
     detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_k);
-    has_feature_extraction_been_performed_on_first_nframe_ = true;
   }
-  detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_kp1);
+  if (!frame_kp1->hasKeypointMeasurements()) {
+    detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_kp1);
+  }
 
   if (FLAGS_detection_visualize_keypoints) {
     cv::Mat image;
@@ -124,21 +189,22 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
       ncamera_->get_T_C_B(camera_idx).getRotation();
   aslam::Quaternion q_Ckp1_Ck = q_C_B * q_Bkp1_Bk * q_C_B.inverse();
 
-  statistics::StatsCollector stat_tracking("keypoint tracking (1 image) in ms");
-  timing::Timer timer_tracking("descriptor matching");
+  static const common::telemetry::TimerMetric kTimerTracking(
+      "descriptor matching");
+  common::telemetry::ScopedTimer timer_tracking(kTimerTracking);
   aslam::FrameToFrameMatchesWithScore matches_with_score_kp1_k;
 
   trackers_[camera_idx]->track(
       q_Ckp1_Ck, *frame_k, frame_kp1, &matches_with_score_kp1_k);
-  stat_tracking.AddSample(timer_tracking.Stop() * 1000);
+  timer_tracking.stop();
 
   // Remove outlier matches.
   aslam::FrameToFrameMatchesWithScore inlier_matches_with_score_kp1_k;
   aslam::FrameToFrameMatchesWithScore outlier_matches_with_score_kp1_k;
 
-  statistics::StatsCollector stat_ransac("Twopt RANSAC (1 image) in ms");
-  timing::Timer timer_ransac(
+  static const common::telemetry::TimerMetric kTimerRansac(
       "swe-feature-tracker: trackFeaturesSingleCamera - ransac");
+  common::telemetry::ScopedTimer timer_ransac(kTimerRansac);
   bool ransac_success = aslam::geometric_vision::
       rejectOutlierFeatureMatchesTranslationRotationSAC(
           *frame_kp1, *frame_k, q_Ckp1_Ck, matches_with_score_kp1_k,
@@ -147,7 +213,7 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
           FLAGS_swe_feature_tracker_two_pt_ransac_max_iterations,
           &inlier_matches_with_score_kp1_k, &outlier_matches_with_score_kp1_k);
 
-  stat_ransac.AddSample(timer_ransac.Stop() * 1000);
+  timer_ransac.stop();
 
   LOG_IF(WARNING, !ransac_success)
       << "Match outlier rejection RANSAC failed on camera " << camera_idx
@@ -158,8 +224,9 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
                                << " matches on camera " << camera_idx << ".";
 
   // Assign track ids.
-  timing::Timer timer_track_manager(
+  static const common::telemetry::TimerMetric kTimerTrackManager(
       "swe-feature-tracker: trackFeaturesSingleCamera - track manager");
+  common::telemetry::ScopedTimer timer_track_manager(kTimerTrackManager);
   track_managers_[camera_idx]->applyMatchesToFrames(
       inlier_matches_with_score_kp1_k, frame_kp1, frame_k);
 
@@ -187,7 +254,12 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
                                       std::to_string(camera_idx);
     visualization::RVizVisualizationSink::publish(outlier_topic, outlier_image);
   }
-  timer_track_manager.Stop();
+  timer_track_manager.stop();
+}
+
+FeatureTrackingPipeline::UniquePtr
+VOFeatureTrackingPipeline::createPipelineForMission() const {
+  return FeatureTrackingPipeline::UniquePtr(new VOFeatureTrackingPipeline());
 }
 
 void VOFeatureTrackingPipeline::initialize(
@@ -197,6 +269,10 @@ void VOFeatureTrackingPipeline::initialize(
   // Create a thread pool.
   const size_t num_cameras = ncamera_->numCameras();
   thread_pool_.reset(new aslam::ThreadPool(num_cameras));
+  detection_thread_pools_.reserve(num_cameras);
+  for (size_t cam_idx = 0u; cam_idx < num_cameras; ++cam_idx) {
+    detection_thread_pools_.emplace_back(new aslam::ThreadPool(1u));
+  }
 
   // Create a feature tracker.
   detectors_extractors_.reserve(num_cameras);
@@ -216,16 +292,18 @@ void VOFeatureTrackingPipeline::initialize(
   }
 }
 
-VOFeatureTrackingPipeline::VOFeatureTrackingPipeline()
-    : has_feature_extraction_been_performed_on_first_nframe_(false) {}
+VOFeatureTrackingPipeline::VOFeatureTrackingPipeline() {}
 
 VOFeatureTrackingPipeline::VOFeatureTrackingPipeline(
-    const aslam::NCamera::ConstPtr& ncamera)
-    : has_feature_extraction_been_performed_on_first_nframe_(false) {
+    const aslam::NCamera::ConstPtr& ncamera) {
   initialize(ncamera);
 }
 
 VOFeatureTrackingPipeline::~VOFeatureTrackingPipeline() {
+  for (std::unique_ptr<aslam::ThreadPool>& detection_thread_pool :
+       detection_thread_pools_) {
+    detection_thread_pool->stop();
+  }
   if (thread_pool_) {
     thread_pool_->stop();
   }
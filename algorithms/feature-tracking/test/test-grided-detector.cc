@@ -0,0 +1,91 @@
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core.hpp>
+
+#include "feature-tracking/grided-detector.h"
+
+namespace feature_tracking {
+
+// Reference implementation comparing all pairs of keypoints.
+void bruteForceNonMaximumSuppression(
+    const float radius, const float ratio_threshold,
+    std::vector<cv::KeyPoint>* keypoints) {
+  CHECK_NOTNULL(keypoints);
+  std::vector<cv::KeyPoint> remaining_keypoints;
+  for (const cv::KeyPoint& keypoint : *keypoints) {
+    bool is_suppressed = false;
+    for (const cv::KeyPoint& other : *keypoints) {
+      const float x_diff = keypoint.pt.x - other.pt.x;
+      const float y_diff = keypoint.pt.y - other.pt.y;
+      if (&other != &keypoint &&
+          x_diff * x_diff + y_diff * y_diff < radius * radius &&
+          ratio_threshold * other.response > keypoint.response) {
+        is_suppressed = true;
+        break;
+      }
+    }
+    if (!is_suppressed) {
+      remaining_keypoints.push_back(keypoint);
+    }
+  }
+  keypoints->swap(remaining_keypoints);
+}
+
+TEST(GridedDetector, LocalNonMaximumSuppressionMatchesBruteForce) {
+  constexpr size_t kImageWidth = 752u;
+  constexpr size_t kImageHeight = 480u;
+  constexpr size_t kNumKeypoints = 2000u;
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<float> x_distribution(0.0f, kImageWidth);
+  std::uniform_real_distribution<float> y_distribution(0.0f, kImageHeight);
+  std::uniform_real_distribution<float> response_distribution(0.0f, 100.0f);
+
+  std::vector<cv::KeyPoint> keypoints;
+  for (size_t i = 0u; i < kNumKeypoints; ++i) {
+    keypoints.emplace_back(
+        x_distribution(random_engine), y_distribution(random_engine),
+        /*size=*/7.0f, /*angle=*/-1.0f, response_distribution(random_engine));
+  }
+
+  for (const float radius : {0.5f, 5.0f, 20.0f}) {
+    for (const float ratio_threshold : {0.5f, 0.9f, 1.0f}) {
+      std::vector<cv::KeyPoint> expected_keypoints = keypoints;
+      bruteForceNonMaximumSuppression(
+          radius, ratio_threshold, &expected_keypoints);
+      std::vector<cv::KeyPoint> suppressed_keypoints = keypoints;
+      localNonMaximumSuppression(
+          kImageHeight, radius, ratio_threshold, &suppressed_keypoints);
+
+      ASSERT_EQ(suppressed_keypoints.size(), expected_keypoints.size())
+          << "radius " << radius << ", ratio threshold " << ratio_threshold;
+      EXPECT_LT(suppressed_keypoints.size(), kNumKeypoints);
+      for (size_t i = 0u; i < expected_keypoints.size(); ++i) {
+        EXPECT_EQ(suppressed_keypoints[i].pt, expected_keypoints[i].pt);
+      }
+    }
+  }
+}
+
+TEST(GridedDetector, LocalNonMaximumSuppressionKeepsEqualResponses) {
+  std::vector<cv::KeyPoint> keypoints;
+  keypoints.emplace_back(10.0f, 10.0f, 7.0f, -1.0f, 50.0f);
+  keypoints.emplace_back(12.0f, 10.0f, 7.0f, -1.0f, 50.0f);
+  keypoints.emplace_back(11.0f, 11.0f, 7.0f, -1.0f, 10.0f);
+  // Outside of the radius of the others.
+  keypoints.emplace_back(30.0f, 10.0f, 7.0f, -1.0f, 1.0f);
+
+  localNonMaximumSuppression(
+      /*image_height=*/100u, /*radius=*/5.0f, /*ratio_threshold=*/1.0f,
+      &keypoints);
+  ASSERT_EQ(keypoints.size(), 3u);
+  EXPECT_EQ(keypoints[0].pt, cv::Point2f(10.0f, 10.0f));
+  EXPECT_EQ(keypoints[1].pt, cv::Point2f(12.0f, 10.0f));
+  EXPECT_EQ(keypoints[2].pt, cv::Point2f(30.0f, 10.0f));
+}
+
+}  // namespace feature_tracking
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,89 @@
+#ifndef GEOMETRIC_VISION_PROSAC_NON_CENTRAL_PNP_H_
+#define GEOMETRIC_VISION_PROSAC_NON_CENTRAL_PNP_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/ncamera.h>
+#include <glog/logging.h>
+#include <maplab-common/pose_types.h>
+
+namespace geometric_vision {
+
+struct ProsacNonCentralPnpSettings {
+  ProsacNonCentralPnpSettings()
+      : max_iterations(100u),
+        confidence(0.99),
+        min_inlier_ratio(0.0),
+        num_hypotheses_per_batch(16u),
+        num_threads(1u),
+        run_nonlinear_refinement(false),
+        use_random_seed(true) {}
+
+  // Upper bound on the number of minimal samples that are evaluated.
+  size_t max_iterations;
+  // Probability that at least one all-inlier sample has been drawn when the
+  // search terminates early.
+  double confidence;
+  // Stop once an all-inlier sample would have been drawn with the requested
+  // confidence if the inlier ratio was at least this large. Candidates with
+  // fewer inliers are rejected anyway, so this bounds the work spent on
+  // outlier sets.
+  double min_inlier_ratio;
+  // Hypotheses are generated and scored in batches. The termination criterion
+  // is checked after every batch.
+  size_t num_hypotheses_per_batch;
+  // Number of threads that score the hypotheses of a batch.
+  size_t num_threads;
+  // Run nonlinear refinement over all inliers of the best hypothesis.
+  bool run_nonlinear_refinement;
+  // If false, the sampling is deterministic.
+  bool use_random_seed;
+};
+
+/// \brief Absolute pose estimation of a camera rig with PROSAC.
+///
+/// Minimal samples are drawn by progressive sampling from the best ranked
+/// matches, solved with the generalized P3P solver of openGV and scored on all
+/// matches at once. The search terminates as soon as the best hypothesis so far
+/// has been found with the requested confidence, so clear inlier or outlier
+/// sets need far fewer iterations than the iteration bound.
+class ProsacNonCentralPnp {
+ public:
+  static constexpr size_t kMinimalSampleSize = 3u;
+
+  explicit ProsacNonCentralPnp(const ProsacNonCentralPnpSettings& settings);
+
+  /// @param[in] measurements Keypoint measurements, ordered by decreasing
+  ///            match quality.
+  /// @param[in] measurement_camera_indices Camera of every measurement.
+  /// @param[in] G_landmark_positions Matched landmark of every measurement.
+  /// @param[in] pixel_sigma Inlier threshold [pixels]. It is converted to an
+  ///            angular threshold at the image center of every camera.
+  /// @param[out] T_G_I Estimated pose of the rig body frame.
+  /// @param[out] inliers Indices of the inlier measurements.
+  /// @param[out] inlier_distances_to_model Angular error of every inlier.
+  /// @param[out] num_iters Number of evaluated samples.
+  /// @return True if a pose with at least kMinimalSampleSize inliers has been
+  ///         found.
+  bool compute(
+      const Eigen::Matrix2Xd& measurements,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions, double pixel_sigma,
+      const aslam::NCamera& ncamera, pose::Transformation* T_G_I,
+      std::vector<int>* inliers,
+      std::vector<double>* inlier_distances_to_model, int* num_iters) const;
+
+  /// Number of samples needed to draw at least one all-inlier sample with the
+  /// given confidence for the given inlier ratio.
+  static size_t getNumRequiredIterations(
+      double inlier_ratio, double confidence, size_t max_iterations);
+
+ private:
+  const ProsacNonCentralPnpSettings settings_;
+};
+
+}  // namespace geometric_vision
+
+#endif  // GEOMETRIC_VISION_PROSAC_NON_CENTRAL_PNP_H_
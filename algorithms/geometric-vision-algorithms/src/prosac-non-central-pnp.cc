@@ -0,0 +1,491 @@
+#include "geometric-vision/prosac-non-central-pnp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <maplab-common/parallel-process.h>
+#include <opengv/absolute_pose/NoncentralAbsoluteAdapter.hpp>
+#include <opengv/absolute_pose/methods.hpp>
+#include <opengv/types.hpp>
+
+namespace geometric_vision {
+
+constexpr size_t ProsacNonCentralPnp::kMinimalSampleSize;
+
+namespace {
+
+constexpr size_t kSampleSize = ProsacNonCentralPnp::kMinimalSampleSize;
+constexpr unsigned int kFixedRandomSeed = 42u;
+
+// Draws minimal samples as proposed in "Matching with PROSAC - Progressive
+// Sample Consensus", Chum and Matas, CVPR 2005. The samples are drawn from a
+// growing subset of the best ranked matches, which reaches the full set after
+// about max_iterations samples.
+class ProsacSampler {
+ public:
+  ProsacSampler(size_t num_matches, size_t max_iterations, bool random_seed)
+      : num_matches_(num_matches),
+        subset_size_(kSampleSize),
+        num_samples_(0u),
+        T_n_(static_cast<double>(max_iterations)),
+        T_n_prime_(1u),
+        random_engine_(
+            random_seed ? std::random_device()() : kFixedRandomSeed) {
+    CHECK_GE(num_matches_, kSampleSize);
+    for (size_t i = 0u; i < kSampleSize; ++i) {
+      T_n_ *= static_cast<double>(subset_size_ - i) /
+              static_cast<double>(num_matches_ - i);
+    }
+  }
+
+  void drawSample(std::vector<int>* sample) {
+    CHECK_NOTNULL(sample)->clear();
+    ++num_samples_;
+    if (num_samples_ > T_n_prime_ && subset_size_ < num_matches_) {
+      const double T_n_next = T_n_ * static_cast<double>(subset_size_ + 1u) /
+                              static_cast<double>(subset_size_ + 1u -
+                                                  kSampleSize);
+      T_n_prime_ += static_cast<size_t>(std::ceil(T_n_next - T_n_));
+      T_n_ = T_n_next;
+      ++subset_size_;
+    }
+
+    size_t num_candidates = subset_size_;
+    if (T_n_prime_ >= num_samples_) {
+      // Every sample of this stage contains the newest match of the subset.
+      sample->push_back(static_cast<int>(subset_size_ - 1u));
+      --num_candidates;
+    }
+    std::uniform_int_distribution<int> distribution(
+        0, static_cast<int>(num_candidates) - 1);
+    while (sample->size() < kSampleSize) {
+      const int index = distribution(random_engine_);
+      if (std::find(sample->begin(), sample->end(), index) == sample->end()) {
+        sample->push_back(index);
+      }
+    }
+  }
+
+ private:
+  const size_t num_matches_;
+  size_t subset_size_;
+  size_t num_samples_;
+  double T_n_;
+  size_t T_n_prime_;
+  std::mt19937 random_engine_;
+};
+
+struct Hypothesis {
+  Hypothesis() : num_inliers(0u), cost(0.0) {}
+
+  // Inlier count first, the truncated error as tie breaker.
+  bool isBetterThan(const Hypothesis& other) const {
+    return num_inliers > other.num_inliers ||
+           (num_inliers == other.num_inliers && cost < other.cost);
+  }
+
+  opengv::transformation_t T_G_I;
+  size_t num_inliers;
+  double cost;
+};
+
+// Scores a pose on all measurements at once. The measurements are grouped by
+// camera, so every camera transforms, normalizes and compares all of its
+// landmarks with a few matrix operations.
+class HypothesisScorer {
+ public:
+  HypothesisScorer(
+      const opengv::bearingVectors_t& bearing_vectors,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions, double pixel_sigma,
+      const aslam::NCamera& ncamera) {
+    const size_t num_measurements = bearing_vectors.size();
+    const size_t num_cameras = ncamera.getNumCameras();
+    grouped_to_original_.resize(num_measurements);
+    std::iota(grouped_to_original_.begin(), grouped_to_original_.end(), 0);
+    std::stable_sort(
+        grouped_to_original_.begin(), grouped_to_original_.end(),
+        [&measurement_camera_indices](int lhs, int rhs) {
+          return measurement_camera_indices[lhs] <
+                 measurement_camera_indices[rhs];
+        });
+    G_landmark_positions_.resize(Eigen::NoChange, num_measurements);
+    bearing_vectors_.resize(Eigen::NoChange, num_measurements);
+    for (size_t i = 0u; i < num_measurements; ++i) {
+      G_landmark_positions_.col(i) =
+          G_landmark_positions.col(grouped_to_original_[i]);
+      bearing_vectors_.col(i) = bearing_vectors[grouped_to_original_[i]];
+    }
+
+    size_t start = 0u;
+    for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+      size_t end = start;
+      while (end < num_measurements &&
+             measurement_camera_indices[grouped_to_original_[end]] ==
+                 static_cast<int>(camera_idx)) {
+        ++end;
+      }
+      if (end == start) {
+        continue;
+      }
+      CameraBlock block;
+      const pose::Transformation& T_C_B = ncamera.get_T_C_B(camera_idx);
+      block.R_C_I = T_C_B.getRotationMatrix();
+      block.C_p_I = T_C_B.getPosition();
+      block.threshold =
+          getAngularThreshold(ncamera.getCamera(camera_idx), pixel_sigma);
+      block.start = start;
+      block.size = end - start;
+      camera_blocks_.push_back(block);
+      start = end;
+    }
+    CHECK_EQ(start, num_measurements);
+  }
+
+  // Returns the number of inliers and the sum of the truncated errors.
+  void score(
+      const opengv::transformation_t& T_G_I, Eigen::VectorXd* errors,
+      size_t* num_inliers, double* cost) const {
+    CHECK_NOTNULL(num_inliers);
+    CHECK_NOTNULL(cost);
+    computeErrors(T_G_I, errors);
+    *num_inliers = 0u;
+    *cost = 0.0;
+    for (const CameraBlock& block : camera_blocks_) {
+      const auto block_errors = errors->segment(block.start, block.size);
+      *num_inliers += (block_errors.array() < block.threshold).count();
+      *cost += block_errors.cwiseMin(block.threshold).sum();
+    }
+  }
+
+  // Returns the inliers in increasing order of the original measurement
+  // index.
+  void getInliers(
+      const opengv::transformation_t& T_G_I, std::vector<int>* inliers,
+      std::vector<double>* inlier_distances_to_model) const {
+    CHECK_NOTNULL(inliers)->clear();
+    CHECK_NOTNULL(inlier_distances_to_model)->clear();
+    Eigen::VectorXd errors;
+    computeErrors(T_G_I, &errors);
+    std::vector<int> inlier_grouped_indices;
+    for (const CameraBlock& block : camera_blocks_) {
+      for (size_t i = block.start; i < block.start + block.size; ++i) {
+        if (errors(i) < block.threshold) {
+          inlier_grouped_indices.push_back(static_cast<int>(i));
+        }
+      }
+    }
+    std::sort(
+        inlier_grouped_indices.begin(), inlier_grouped_indices.end(),
+        [this](int lhs, int rhs) {
+          return grouped_to_original_[lhs] < grouped_to_original_[rhs];
+        });
+    for (const int grouped_index : inlier_grouped_indices) {
+      inliers->push_back(grouped_to_original_[grouped_index]);
+      inlier_distances_to_model->push_back(errors(grouped_index));
+    }
+  }
+
+ private:
+  struct CameraBlock {
+    Eigen::Matrix3d R_C_I;
+    Eigen::Vector3d C_p_I;
+    double threshold;
+    size_t start;
+    size_t size;
+  };
+
+  // Same error as openGV uses: one minus the cosine of the angle between the
+  // measured bearing vector and the direction to the landmark.
+  void computeErrors(
+      const opengv::transformation_t& T_G_I, Eigen::VectorXd* errors) const {
+    CHECK_NOTNULL(errors)->resize(G_landmark_positions_.cols());
+    const Eigen::Matrix3d R_I_G = T_G_I.leftCols<3>().transpose();
+    const Eigen::Matrix3Xd I_landmark_positions =
+        R_I_G * (G_landmark_positions_.colwise() - T_G_I.col(3));
+    for (const CameraBlock& block : camera_blocks_) {
+      Eigen::Matrix3Xd C_landmark_positions =
+          block.R_C_I *
+          I_landmark_positions.middleCols(block.start, block.size);
+      C_landmark_positions.colwise() += block.C_p_I;
+      C_landmark_positions.array().rowwise() /=
+          C_landmark_positions.colwise().norm().array();
+      errors->segment(block.start, block.size).array() =
+          1.0 - bearing_vectors_.middleCols(block.start, block.size)
+                    .cwiseProduct(C_landmark_positions)
+                    .colwise()
+                    .sum()
+                    .transpose()
+                    .array();
+    }
+  }
+
+  static double getAngularThreshold(
+      const aslam::Camera& camera, double pixel_sigma) {
+    const Eigen::Vector2d center(
+        0.5 * camera.imageWidth(), 0.5 * camera.imageHeight());
+    Eigen::Vector3d center_bearing;
+    Eigen::Vector3d offset_bearing;
+    CHECK(camera.backProject3(center, &center_bearing));
+    CHECK(camera.backProject3(
+        center + Eigen::Vector2d(pixel_sigma, 0.0), &offset_bearing));
+    return 1.0 - center_bearing.normalized().dot(offset_bearing.normalized());
+  }
+
+  std::vector<int> grouped_to_original_;
+  Eigen::Matrix3Xd G_landmark_positions_;
+  Eigen::Matrix3Xd bearing_vectors_;
+  std::vector<CameraBlock> camera_blocks_;
+};
+
+// Terminates as proposed for PROSAC: the search stops once some subset of the
+// best ranked matches contains enough inliers of the best hypothesis to not be
+// random (non-randomness) and to make it unlikely that a hypothesis with more
+// inliers within that subset was missed (maximality).
+size_t getNumRequiredProsacIterations(
+    const std::vector<int>& inliers,
+    const std::vector<int>& sampled_measurements, size_t num_measurements,
+    double confidence, size_t max_iterations) {
+  // Probability that a wrong pose is consistent with a measurement and the
+  // one-sided normal quantile of the accepted probability of a random inlier
+  // set.
+  constexpr double kProbabilityRandomInlier = 0.05;
+  constexpr double kNonRandomnessQuantile = 2.33;
+
+  std::vector<char> is_inlier(num_measurements, 0);
+  for (const int inlier : inliers) {
+    is_inlier[inlier] = 1;
+  }
+  size_t num_required_iterations = max_iterations;
+  size_t num_subset_inliers = 0u;
+  for (size_t subset_size = 1u; subset_size <= sampled_measurements.size();
+       ++subset_size) {
+    num_subset_inliers += is_inlier[sampled_measurements[subset_size - 1u]];
+    if (subset_size <= kSampleSize) {
+      continue;
+    }
+    // Normal approximation of the binomial distribution of inliers among the
+    // measurements that are not part of the sample.
+    const double num_unsampled = static_cast<double>(subset_size - kSampleSize);
+    const double min_num_non_random_inliers =
+        kSampleSize + num_unsampled * kProbabilityRandomInlier +
+        kNonRandomnessQuantile *
+            std::sqrt(
+                num_unsampled * kProbabilityRandomInlier *
+                (1.0 - kProbabilityRandomInlier));
+    if (static_cast<double>(num_subset_inliers) < min_num_non_random_inliers) {
+      continue;
+    }
+    num_required_iterations = std::min(
+        num_required_iterations,
+        ProsacNonCentralPnp::getNumRequiredIterations(
+            static_cast<double>(num_subset_inliers) /
+                static_cast<double>(subset_size),
+            confidence, max_iterations));
+  }
+  return num_required_iterations;
+}
+
+}  // namespace
+
+ProsacNonCentralPnp::ProsacNonCentralPnp(
+    const ProsacNonCentralPnpSettings& settings)
+    : settings_(settings) {
+  CHECK_GT(settings_.max_iterations, 0u);
+  CHECK_GT(settings_.confidence, 0.0);
+  CHECK_LT(settings_.confidence, 1.0);
+  CHECK_GE(settings_.min_inlier_ratio, 0.0);
+  CHECK_LE(settings_.min_inlier_ratio, 1.0);
+  CHECK_GT(settings_.num_hypotheses_per_batch, 0u);
+  CHECK_GT(settings_.num_threads, 0u);
+}
+
+bool ProsacNonCentralPnp::compute(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions, double pixel_sigma,
+    const aslam::NCamera& ncamera, pose::Transformation* T_G_I,
+    std::vector<int>* inliers, std::vector<double>* inlier_distances_to_model,
+    int* num_iters) const {
+  CHECK_NOTNULL(T_G_I)->setIdentity();
+  CHECK_NOTNULL(inliers)->clear();
+  CHECK_NOTNULL(inlier_distances_to_model)->clear();
+  CHECK_NOTNULL(num_iters);
+  CHECK_GT(pixel_sigma, 0.0);
+  const size_t num_measurements = measurements.cols();
+  CHECK_EQ(measurement_camera_indices.size(), num_measurements);
+  CHECK_EQ(static_cast<size_t>(G_landmark_positions.cols()), num_measurements);
+  *num_iters = 0;
+
+  // Measurements that cannot be back-projected are never inliers and are not
+  // sampled.
+  opengv::bearingVectors_t bearing_vectors(num_measurements);
+  opengv::points_t points(num_measurements);
+  std::vector<int> sampled_measurements;
+  sampled_measurements.reserve(num_measurements);
+  for (size_t i = 0u; i < num_measurements; ++i) {
+    const int camera_idx = measurement_camera_indices[i];
+    CHECK_GE(camera_idx, 0);
+    CHECK_LT(static_cast<size_t>(camera_idx), ncamera.getNumCameras());
+    opengv::bearingVector_t& bearing_vector = bearing_vectors[i];
+    if (ncamera.getCamera(camera_idx)
+            .backProject3(measurements.col(i), &bearing_vector)) {
+      bearing_vector.normalize();
+      sampled_measurements.push_back(static_cast<int>(i));
+    } else {
+      bearing_vector.setZero();
+    }
+    points[i] = G_landmark_positions.col(i);
+  }
+  if (sampled_measurements.size() < kMinimalSampleSize) {
+    return false;
+  }
+
+  const size_t num_cameras = ncamera.getNumCameras();
+  opengv::rotations_t camera_rotations(num_cameras);
+  opengv::translations_t camera_offsets(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    // OpenGV requires T_B_C transformation.
+    const pose::Transformation T_B_C = ncamera.get_T_C_B(camera_idx).inverse();
+    camera_rotations[camera_idx] = T_B_C.getRotationMatrix();
+    camera_offsets[camera_idx] = T_B_C.getPosition();
+  }
+  opengv::absolute_pose::NoncentralAbsoluteAdapter adapter(
+      bearing_vectors, measurement_camera_indices, points, camera_offsets,
+      camera_rotations);
+  const HypothesisScorer scorer(
+      bearing_vectors, measurement_camera_indices, G_landmark_positions,
+      pixel_sigma, ncamera);
+
+  ProsacSampler sampler(
+      sampled_measurements.size(), settings_.max_iterations,
+      settings_.use_random_seed);
+  std::vector<std::vector<int>> samples(settings_.num_hypotheses_per_batch);
+  std::vector<Hypothesis> batch_hypotheses(settings_.num_hypotheses_per_batch);
+  auto score_samples = [&](const std::vector<size_t>& range) {
+    Eigen::VectorXd errors;
+    for (const size_t sample_idx : range) {
+      Hypothesis& hypothesis = batch_hypotheses[sample_idx];
+      hypothesis = Hypothesis();
+      const opengv::transformations_t solutions =
+          opengv::absolute_pose::gp3p(adapter, samples[sample_idx]);
+      for (const opengv::transformation_t& solution : solutions) {
+        Hypothesis candidate;
+        candidate.T_G_I = solution;
+        scorer.score(
+            solution, &errors, &candidate.num_inliers, &candidate.cost);
+        if (candidate.isBetterThan(hypothesis)) {
+          hypothesis = candidate;
+        }
+      }
+    }
+  };
+
+  Hypothesis best_hypothesis;
+  size_t num_samples = 0u;
+  const size_t max_num_samples = getNumRequiredIterations(
+      settings_.min_inlier_ratio, settings_.confidence,
+      settings_.max_iterations);
+  size_t num_required_samples = max_num_samples;
+  while (num_samples < num_required_samples) {
+    const size_t batch_size = std::min(
+        settings_.num_hypotheses_per_batch,
+        num_required_samples - num_samples);
+    for (size_t sample_idx = 0u; sample_idx < batch_size; ++sample_idx) {
+      std::vector<int>& sample = samples[sample_idx];
+      sampler.drawSample(&sample);
+      for (int& index : sample) {
+        index = sampled_measurements[index];
+      }
+    }
+    if (settings_.num_threads > 1u) {
+      constexpr bool kAlwaysParallelize = false;
+      common::ParallelProcess(
+          batch_size, score_samples, kAlwaysParallelize,
+          settings_.num_threads);
+    } else {
+      std::vector<size_t> sample_indices(batch_size);
+      std::iota(sample_indices.begin(), sample_indices.end(), 0u);
+      score_samples(sample_indices);
+    }
+    num_samples += batch_size;
+
+    // Reduce in sample order to stay deterministic for a fixed seed.
+    bool found_better_hypothesis = false;
+    for (size_t sample_idx = 0u; sample_idx < batch_size; ++sample_idx) {
+      if (batch_hypotheses[sample_idx].isBetterThan(best_hypothesis)) {
+        best_hypothesis = batch_hypotheses[sample_idx];
+        found_better_hypothesis = true;
+      }
+    }
+    if (found_better_hypothesis) {
+      scorer.getInliers(
+          best_hypothesis.T_G_I, inliers, inlier_distances_to_model);
+      num_required_samples = getNumRequiredProsacIterations(
+          *inliers, sampled_measurements, num_measurements,
+          settings_.confidence, max_num_samples);
+    }
+  }
+  *num_iters = static_cast<int>(num_samples);
+  VLOG(5) << "PROSAC PnP: " << best_hypothesis.num_inliers << " inliers of "
+          << num_measurements << " after " << num_samples << " samples.";
+
+  if (best_hypothesis.num_inliers < kMinimalSampleSize) {
+    inliers->clear();
+    inlier_distances_to_model->clear();
+    return false;
+  }
+
+  if (settings_.run_nonlinear_refinement &&
+      inliers->size() > kMinimalSampleSize) {
+    adapter.setR(best_hypothesis.T_G_I.leftCols<3>());
+    adapter.sett(best_hypothesis.T_G_I.col(3));
+    Hypothesis refined_hypothesis;
+    refined_hypothesis.T_G_I =
+        opengv::absolute_pose::optimize_nonlinear(adapter, *inliers);
+    Eigen::VectorXd errors;
+    scorer.score(
+        refined_hypothesis.T_G_I, &errors, &refined_hypothesis.num_inliers,
+        &refined_hypothesis.cost);
+    // Keep the refined pose unless it lost inliers.
+    if (refined_hypothesis.num_inliers >= best_hypothesis.num_inliers) {
+      best_hypothesis = refined_hypothesis;
+      scorer.getInliers(
+          best_hypothesis.T_G_I, inliers, inlier_distances_to_model);
+    }
+  }
+
+  T_G_I->getRotation() = pose::Quaternion(
+      static_cast<Eigen::Matrix3d>(best_hypothesis.T_G_I.leftCols(3)));
+  T_G_I->getPosition() = best_hypothesis.T_G_I.rightCols(1);
+  return true;
+}
+
+size_t ProsacNonCentralPnp::getNumRequiredIterations(
+    double inlier_ratio, double confidence, size_t max_iterations) {
+  CHECK_GT(confidence, 0.0);
+  CHECK_LT(confidence, 1.0);
+  if (inlier_ratio <= 0.0) {
+    return max_iterations;
+  }
+  if (inlier_ratio >= 1.0) {
+    return std::min<size_t>(1u, max_iterations);
+  }
+  const double log_outlier_sample_probability = std::log(
+      1.0 - std::pow(inlier_ratio, static_cast<double>(kMinimalSampleSize)));
+  if (log_outlier_sample_probability >= 0.0) {
+    return max_iterations;
+  }
+  const double num_iterations = std::ceil(
+      std::log(1.0 - confidence) / log_outlier_sample_probability);
+  if (num_iterations >= static_cast<double>(max_iterations)) {
+    return max_iterations;
+  }
+  return std::max<size_t>(1u, static_cast<size_t>(num_iterations));
+}
+
+}  // namespace geometric_vision
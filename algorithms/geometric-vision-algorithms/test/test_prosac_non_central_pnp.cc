@@ -0,0 +1,193 @@
+#include "geometric-vision/prosac-non-central-pnp.h"
+
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/pose_types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+namespace geometric_vision {
+
+class ProsacNonCentralPnpTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ncamera_ = aslam::NCamera::createTestNCamera(kNumCameras);
+    CHECK(ncamera_);
+    T_G_I_ = pose::Transformation(
+        pose::Quaternion(Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitZ())),
+        Eigen::Vector3d(1.0, 2.0, 3.0));
+  }
+
+  // Creates kNumMeasurements observations of random landmarks. Outliers
+  // observe a landmark that is far from the one they were generated from. If
+  // outliers_last is set, all inliers come first, as if the measurements were
+  // ranked perfectly.
+  void createMeasurements(double inlier_ratio, bool outliers_last) {
+    std::mt19937 random_engine(kSeed);
+    std::uniform_real_distribution<double> unit_distribution(0.0, 1.0);
+    std::uniform_real_distribution<double> depth_distribution(2.0, 10.0);
+    measurements_.resize(Eigen::NoChange, kNumMeasurements);
+    G_landmark_positions_.resize(Eigen::NoChange, kNumMeasurements);
+    measurement_camera_indices_.resize(kNumMeasurements);
+    is_inlier_.resize(kNumMeasurements);
+    for (int i = 0; i < kNumMeasurements; ++i) {
+      const int camera_idx = i % kNumCameras;
+      const aslam::Camera& camera = ncamera_->getCamera(camera_idx);
+      const Eigen::Vector2d keypoint = camera.createRandomKeypoint();
+      Eigen::Vector3d C_bearing;
+      CHECK(camera.backProject3(keypoint, &C_bearing));
+      const Eigen::Vector3d C_landmark =
+          C_bearing.normalized() * depth_distribution(random_engine);
+      Eigen::Vector3d G_landmark =
+          T_G_I_ * (ncamera_->get_T_C_B(camera_idx).inverse() * C_landmark);
+
+      is_inlier_[i] =
+          outliers_last ? i < inlier_ratio * kNumMeasurements
+                        : unit_distribution(random_engine) < inlier_ratio;
+      if (!is_inlier_[i]) {
+        G_landmark += Eigen::Vector3d::Random().normalized() * 5.0;
+      }
+      measurements_.col(i) = keypoint;
+      G_landmark_positions_.col(i) = G_landmark;
+      measurement_camera_indices_[i] = camera_idx;
+    }
+  }
+
+  bool compute(const ProsacNonCentralPnpSettings& settings) {
+    ProsacNonCentralPnp pnp(settings);
+    return pnp.compute(
+        measurements_, measurement_camera_indices_, G_landmark_positions_,
+        kPixelSigma, *ncamera_, &T_G_I_estimate_, &inliers_,
+        &inlier_distances_to_model_, &num_iters_);
+  }
+
+  void expectCorrectPose() const {
+    EXPECT_NEAR_KINDR_QUATERNION(
+        T_G_I_estimate_.getRotation(), T_G_I_.getRotation(), 1e-6);
+    EXPECT_NEAR_EIGEN(
+        T_G_I_estimate_.getPosition(), T_G_I_.getPosition(), 1e-6);
+    ASSERT_EQ(inliers_.size(), inlier_distances_to_model_.size());
+    size_t num_expected_inliers = 0u;
+    for (const bool is_inlier : is_inlier_) {
+      num_expected_inliers += is_inlier ? 1u : 0u;
+    }
+    EXPECT_EQ(inliers_.size(), num_expected_inliers);
+    for (const int inlier : inliers_) {
+      EXPECT_TRUE(is_inlier_[inlier]);
+    }
+  }
+
+  static constexpr size_t kNumCameras = 2u;
+  static constexpr int kNumMeasurements = 200;
+  static constexpr double kPixelSigma = 1.0;
+  static constexpr unsigned int kSeed = 5u;
+
+  aslam::NCamera::Ptr ncamera_;
+  pose::Transformation T_G_I_;
+
+  Eigen::Matrix2Xd measurements_;
+  Eigen::Matrix3Xd G_landmark_positions_;
+  std::vector<int> measurement_camera_indices_;
+  std::vector<bool> is_inlier_;
+
+  pose::Transformation T_G_I_estimate_;
+  std::vector<int> inliers_;
+  std::vector<double> inlier_distances_to_model_;
+  int num_iters_;
+};
+
+TEST_F(ProsacNonCentralPnpTest, TerminatesEarlyWithoutOutliers) {
+  createMeasurements(1.0, false);
+  ProsacNonCentralPnpSettings settings;
+  settings.use_random_seed = false;
+  ASSERT_TRUE(compute(settings));
+  expectCorrectPose();
+  EXPECT_LE(
+      static_cast<size_t>(num_iters_), settings.num_hypotheses_per_batch);
+}
+
+TEST_F(ProsacNonCentralPnpTest, FindsPoseWithOutliers) {
+  createMeasurements(0.5, false);
+  ProsacNonCentralPnpSettings settings;
+  settings.use_random_seed = false;
+  settings.max_iterations = 1000u;
+  ASSERT_TRUE(compute(settings));
+  expectCorrectPose();
+  EXPECT_LT(static_cast<size_t>(num_iters_), settings.max_iterations);
+}
+
+TEST_F(ProsacNonCentralPnpTest, RankedMatchesNeedFewSamples) {
+  // With 20% inliers, plain RANSAC needs hundreds of samples for 99%
+  // confidence. PROSAC starts sampling from the best ranked matches.
+  createMeasurements(0.2, true);
+  ProsacNonCentralPnpSettings settings;
+  settings.use_random_seed = false;
+  settings.max_iterations = 1000u;
+  ASSERT_TRUE(compute(settings));
+  expectCorrectPose();
+  const size_t num_ransac_iterations =
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          0.2, settings.confidence, settings.max_iterations);
+  EXPECT_LT(static_cast<size_t>(num_iters_), num_ransac_iterations);
+}
+
+TEST_F(ProsacNonCentralPnpTest, ParallelScoringMatchesSerialScoring) {
+  createMeasurements(0.5, false);
+  ProsacNonCentralPnpSettings settings;
+  settings.use_random_seed = false;
+  settings.max_iterations = 1000u;
+  ASSERT_TRUE(compute(settings));
+  const std::vector<int> serial_inliers = inliers_;
+  const int serial_num_iters = num_iters_;
+
+  settings.num_threads = 4u;
+  ASSERT_TRUE(compute(settings));
+  EXPECT_EQ(inliers_, serial_inliers);
+  EXPECT_EQ(num_iters_, serial_num_iters);
+}
+
+TEST_F(ProsacNonCentralPnpTest, MinInlierRatioBoundsSamples) {
+  createMeasurements(0.0, false);
+  ProsacNonCentralPnpSettings settings;
+  settings.use_random_seed = false;
+  settings.max_iterations = 1000u;
+  settings.min_inlier_ratio = 0.5;
+  compute(settings);
+  EXPECT_LE(
+      static_cast<size_t>(num_iters_),
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          settings.min_inlier_ratio, settings.confidence,
+          settings.max_iterations));
+}
+
+TEST(ProsacNonCentralPnpIterationsTest, NumRequiredIterations) {
+  constexpr double kConfidence = 0.99;
+  constexpr size_t kMaxIterations = 1000u;
+  // log(0.01) / log(1 - 0.5^3) = 34.5
+  EXPECT_EQ(
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          0.5, kConfidence, kMaxIterations),
+      35u);
+  EXPECT_EQ(
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          1.0, kConfidence, kMaxIterations),
+      1u);
+  EXPECT_EQ(
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          0.0, kConfidence, kMaxIterations),
+      kMaxIterations);
+  EXPECT_EQ(
+      ProsacNonCentralPnp::getNumRequiredIterations(
+          0.1, kConfidence, kMaxIterations),
+      kMaxIterations);
+}
+
+}  // namespace geometric_vision
+
+MAPLAB_UNITTEST_ENTRYPOINT
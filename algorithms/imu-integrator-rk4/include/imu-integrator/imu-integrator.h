@@ -48,19 +48,35 @@ class ImuIntegratorRK4 {
       Eigen::Matrix<ScalarType, kErrorStateSize,
                     kErrorStateSize>* next_cov) const;
 
+  /// Computes phi * matrix for a transition matrix phi returned by
+  /// integrate(). The bias rows of such a transition are identity rows, so
+  /// only the orientation, velocity and position rows are multiplied.
+  template <typename ScalarType>
+  static inline void multiplyTransition(
+      const Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>& phi,
+      const Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>&
+          matrix,
+      Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>* product);
+
  private:
+  /// Also returns the rotation of the state, which the covariance and
+  /// transition derivatives need at the same state.
   template <typename ScalarType>
   inline void getStateDerivativeRungeKutta(
       const Eigen::Matrix<ScalarType, kImuReadingSize, 1>&
           debiased_imu_readings,
       const Eigen::Matrix<ScalarType, kStateSize, 1>& current_state,
-      Eigen::Matrix<ScalarType, kStateSize, 1>* state_derivative) const;
+      Eigen::Matrix<ScalarType, kStateSize, 1>* state_derivative,
+      Eigen::Matrix<ScalarType, 3, 3>* G_R_B) const;
 
+  /// The current transition has to have the structure of a transition
+  /// integrated from the identity. Only the blocks of the transition
+  /// derivative that can be non-zero are written.
   template <typename ScalarType>
   inline void getCovarianceTransitionDerivativesRungeKutta(
       const Eigen::Matrix<ScalarType, kImuReadingSize, 1>&
           debiased_imu_readings,
-      const Eigen::Matrix<ScalarType, kStateSize, 1>& current_state,
+      const Eigen::Matrix<ScalarType, 3, 3>& G_R_B,
       const Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>&
           current_cov,
       const Eigen::Matrix<ScalarType, kErrorStateSize, kErrorStateSize>&
@@ -288,4 +288,44 @@ TEST_F(PosegraphErrorTerms, ImuIntegratorLinearAccelerationSlope) {
       1e-15);
 }
 
+TEST_F(PosegraphErrorTerms, ImuIntegratorStateOnlyAndTransitionProduct) {
+  gyro_noise_sigma_ = 0.1;
+  gyro_bias_sigma_ = 0.01;
+  acc_noise_sigma_ = 0.2;
+  acc_bias_sigma_ = 0.02;
+  constructIntegrator();
+
+  delta_time_seconds_ = 0.01;
+  debiased_imu_readings_.setRandom();
+  current_state_.setRandom();
+  current_state_.block<kStateOrientationBlockSize, 1>(
+      kStateOrientationOffset, 0).normalize();
+
+  integrate();
+
+  Eigen::Matrix<double, kStateSize, 1> next_state_only;
+  integrator_->integrateStateOnly(
+      current_state_, debiased_imu_readings_, delta_time_seconds_,
+      &next_state_only);
+  EXPECT_NEAR_EIGEN(next_state_only, next_state_, 1e-15);
+
+  // The bias rows of the transition are identity rows.
+  const Eigen::Matrix<double, kErrorStateSize, kErrorStateSize> identity =
+      Eigen::Matrix<double, kErrorStateSize, kErrorStateSize>::Identity();
+  for (const int row :
+       {kErrorStateGyroBiasOffset, kErrorStateAccelBiasOffset}) {
+    const Eigen::Matrix<double, 3, kErrorStateSize> bias_rows =
+        next_phi_.block<3, kErrorStateSize>(row, 0);
+    const Eigen::Matrix<double, 3, kErrorStateSize> identity_rows =
+        identity.block<3, kErrorStateSize>(row, 0);
+    EXPECT_NEAR_EIGEN(bias_rows, identity_rows, 1e-15);
+  }
+
+  const Eigen::Matrix<double, kErrorStateSize, kErrorStateSize> matrix =
+      Eigen::Matrix<double, kErrorStateSize, kErrorStateSize>::Random();
+  Eigen::Matrix<double, kErrorStateSize, kErrorStateSize> product;
+  ImuIntegratorRK4::multiplyTransition(next_phi_, matrix, &product);
+  EXPECT_NEAR_EIGEN(product, next_phi_ * matrix, 1e-12);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,98 @@
+#ifndef LANDMARK_TRIANGULATION_BATCHED_TRIANGULATION_H_
+#define LANDMARK_TRIANGULATION_BATCHED_TRIANGULATION_H_
+
+#include <cstddef>
+
+#include <Eigen/Core>
+#include <aslam/triangulation/triangulation.h>
+
+namespace landmark_triangulation {
+
+// Triangulates a batch of landmarks with the linear N-view midpoint method,
+// i.e. the same least-squares problem aslam::linearTriangulateFromNViews
+// solves, with the ray depths eliminated. The observations are kept as
+// structure-of-arrays in fixed-capacity storage, so filling a batch doesn't
+// allocate, the normal equations of a landmark are summed over contiguous
+// arrays and the 3x3 systems are solved for all landmarks of the batch at
+// once.
+//
+// Usage:
+//   if (!triangulator.hasCapacityFor(num_observations)) {
+//     triangulator.triangulate();
+//     ...read the results...
+//     triangulator.clear();
+//   }
+//   triangulator.addLandmark();
+//   triangulator.addObservation(G_bearing, p_G_C);
+class BatchedNViewTriangulator {
+ public:
+  static constexpr int kMaxNumLandmarks = 64;
+  static constexpr int kMaxNumObservations = 1024;
+
+  BatchedNViewTriangulator();
+
+  // True if a landmark with the given number of observations still fits into
+  // the batch. Landmarks with more than kMaxNumObservations never fit.
+  bool hasCapacityFor(size_t num_observations) const;
+
+  // Starts a new landmark, the following observations belong to it.
+  void addLandmark();
+  // The bearing doesn't need to be normalized.
+  void addObservation(
+      const Eigen::Vector3d& G_bearing_vector, const Eigen::Vector3d& p_G_C);
+  // Removes the last landmark together with its observations.
+  void removeLastLandmark();
+
+  // Solves for all landmarks of the batch.
+  void triangulate();
+  void clear();
+
+  int numLandmarks() const {
+    return num_landmarks_;
+  }
+  int numObservationsOfLandmark(int landmark_index) const;
+
+  // Only valid after triangulate().
+  aslam::TriangulationResult getResult(int landmark_index) const;
+  Eigen::Vector3d getLandmarkPosition(int landmark_index) const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  typedef Eigen::Array<double, kMaxNumObservations, 1> ObservationArray;
+  typedef Eigen::Array<double, kMaxNumLandmarks, 1> LandmarkArray;
+  // Sized to the landmarks of the batch, but never allocates.
+  typedef Eigen::Array<double, Eigen::Dynamic, 1, 0, kMaxNumLandmarks, 1>
+      BatchArray;
+
+  int num_landmarks_;
+  int num_observations_;
+  bool is_triangulated_;
+
+  // First observation of every landmark, one past the end for the last one.
+  Eigen::Array<int, kMaxNumLandmarks + 1, 1> observation_begin_;
+
+  // Camera position of the first observation of every landmark. The other
+  // camera positions are stored relative to it, so the normal equations stay
+  // well conditioned far from the origin.
+  LandmarkArray reference_x_;
+  LandmarkArray reference_y_;
+  LandmarkArray reference_z_;
+
+  // Normalized bearings and relative camera positions of all observations.
+  ObservationArray G_bearing_x_;
+  ObservationArray G_bearing_y_;
+  ObservationArray G_bearing_z_;
+  ObservationArray p_C_x_;
+  ObservationArray p_C_y_;
+  ObservationArray p_C_z_;
+
+  // Triangulated positions and whether the landmark was observable.
+  LandmarkArray p_G_fi_x_;
+  LandmarkArray p_G_fi_y_;
+  LandmarkArray p_G_fi_z_;
+  Eigen::Array<bool, kMaxNumLandmarks, 1> is_observable_;
+};
+
+}  // namespace landmark_triangulation
+#endif  // LANDMARK_TRIANGULATION_BATCHED_TRIANGULATION_H_
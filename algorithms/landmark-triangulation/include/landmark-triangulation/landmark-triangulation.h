@@ -2,15 +2,39 @@
 #define LANDMARK_TRIANGULATION_LANDMARK_TRIANGULATION_H_
 
 #include <string>
+#include <unordered_map>
 
 #include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
 #include <aslam/common/unique-id.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 
 namespace landmark_triangulation {
 
+// The poses of the vertices and the number of observations of the landmarks
+// when the landmarks were last triangulated.
+struct TriangulationRecord {
+  AlignedUnorderedMap<pose_graph::VertexId, aslam::Transformation> T_G_I;
+  std::unordered_map<vi_map::LandmarkId, size_t> num_observations;
+
+  void clear() {
+    T_G_I.clear();
+    num_observations.clear();
+  }
+};
+
 bool retriangulateLandmarks(vi_map::VIMap* map);
+// Also records the state of all vertices and landmarks.
+bool retriangulateLandmarks(vi_map::VIMap* map, TriangulationRecord* record);
+// Only retriangulates the landmarks that are observed by a vertex that moved
+// by more than min_translation_m or min_rotation_rad since the record, whose
+// number of observations changed or that are new. Retriangulates all
+// landmarks if the record is empty. Returns the number of retriangulated
+// landmarks and updates the record.
+size_t retriangulateChangedLandmarks(
+    const double min_translation_m, const double min_rotation_rad,
+    TriangulationRecord* record, vi_map::VIMap* map);
 bool retriangulateLandmarksOfMission(
     const vi_map::MissionId& mission_id, vi_map::VIMap* map);
 void retriangulateLandmarksOfVertex(
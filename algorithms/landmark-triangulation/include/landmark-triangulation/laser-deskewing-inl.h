@@ -0,0 +1,128 @@
+#ifndef LANDMARK_TRIANGULATION_LASER_DESKEWING_INL_H_
+#define LANDMARK_TRIANGULATION_LASER_DESKEWING_INL_H_
+
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace landmark_triangulation {
+
+template <typename Scalar>
+bool LaserDeskewer::forEachDeskewedBlock(
+    const vi_map::LaserEdge& laser_edge,
+    const PointBlockCallback<Scalar>& callback) const {
+  CHECK(callback);
+  const int num_points = laser_edge.getLaserData().cols();
+  if (num_points == 0) {
+    return true;
+  }
+  Knots knots;
+  if (!computeKnots(laser_edge.getLaserTimestamps(), &knots)) {
+    return false;
+  }
+
+  Eigen::Matrix<Scalar, 4, Eigen::Dynamic> block(
+      4, std::min(num_points, options_.num_points_per_block));
+  for (int begin = 0; begin < num_points;
+       begin += options_.num_points_per_block) {
+    const int num_points_in_block =
+        std::min(options_.num_points_per_block, num_points - begin);
+    transformBlock<Scalar>(
+        knots, laser_edge, begin, block.leftCols(num_points_in_block));
+    callback(block.leftCols(num_points_in_block));
+  }
+  return true;
+}
+
+template <typename Scalar>
+bool LaserDeskewer::deskew(
+    const vi_map::LaserEdge& laser_edge,
+    Eigen::Matrix<Scalar, 4, Eigen::Dynamic>* xyzi_G) const {
+  CHECK_NOTNULL(xyzi_G);
+  const int num_points = laser_edge.getLaserData().cols();
+  xyzi_G->resize(4, num_points);
+  if (num_points == 0) {
+    return true;
+  }
+  Knots knots;
+  if (!computeKnots(laser_edge.getLaserTimestamps(), &knots)) {
+    xyzi_G->resize(4, 0);
+    return false;
+  }
+
+  // The blocks are written in place.
+  for (int begin = 0; begin < num_points;
+       begin += options_.num_points_per_block) {
+    const int num_points_in_block =
+        std::min(options_.num_points_per_block, num_points - begin);
+    transformBlock<Scalar>(
+        knots, laser_edge, begin,
+        xyzi_G->middleCols(begin, num_points_in_block));
+  }
+  return true;
+}
+
+template <typename Scalar>
+void LaserDeskewer::transformBlock(
+    const Knots& knots, const vi_map::LaserEdge& laser_edge, const int begin,
+    Eigen::Ref<Eigen::Matrix<Scalar, 4, Eigen::Dynamic>> xyzi_G) const {
+  typedef Eigen::Array<Scalar, 1, Eigen::Dynamic> RowArray;
+  const int num_points = xyzi_G.cols();
+  const int num_knots = knots.p_G_L.cols();
+  CHECK_GE(num_knots, 2);
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns =
+      laser_edge.getLaserTimestamps();
+  const Eigen::Matrix<double, 4, Eigen::Dynamic>& xyzi_L =
+      laser_edge.getLaserData();
+  CHECK_LE(begin + num_points, xyzi_L.cols());
+
+  // Interpolate the pose of every point between the neighboring knots.
+  Eigen::Array<Scalar, 3, Eigen::Dynamic> p_G_L(3, num_points);
+  Eigen::Array<Scalar, 4, Eigen::Dynamic> q_G_L(4, num_points);
+  for (int i = 0; i < num_points; ++i) {
+    const double knot_position =
+        static_cast<double>(
+            timestamps_ns(0, begin + i) - knots.first_timestamp_ns) /
+        knots.knot_spacing_ns;
+    const int knot_idx =
+        std::min(static_cast<int>(knot_position), num_knots - 2);
+    const double alpha = knot_position - knot_idx;
+    p_G_L.col(i) = ((1.0 - alpha) * knots.p_G_L.col(knot_idx) +
+                    alpha * knots.p_G_L.col(knot_idx + 1))
+                       .template cast<Scalar>()
+                       .array();
+    q_G_L.col(i) = ((1.0 - alpha) * knots.q_G_L.col(knot_idx) +
+                    alpha * knots.q_G_L.col(knot_idx + 1))
+                       .normalized()
+                       .template cast<Scalar>()
+                       .array();
+  }
+
+  // Rotate all points at once, v' = v + w * t + u x t with t = 2 * u x v and
+  // q = [u, w].
+  const Eigen::Array<Scalar, 3, Eigen::Dynamic> v =
+      xyzi_L.block(0, begin, 3, num_points).template cast<Scalar>().array();
+  const Scalar kTwo = static_cast<Scalar>(2);
+  const RowArray t_x =
+      kTwo * (q_G_L.row(1) * v.row(2) - q_G_L.row(2) * v.row(1));
+  const RowArray t_y =
+      kTwo * (q_G_L.row(2) * v.row(0) - q_G_L.row(0) * v.row(2));
+  const RowArray t_z =
+      kTwo * (q_G_L.row(0) * v.row(1) - q_G_L.row(1) * v.row(0));
+  xyzi_G.row(0) = (v.row(0) + q_G_L.row(3) * t_x + q_G_L.row(1) * t_z -
+                   q_G_L.row(2) * t_y + p_G_L.row(0))
+                      .matrix();
+  xyzi_G.row(1) = (v.row(1) + q_G_L.row(3) * t_y + q_G_L.row(2) * t_x -
+                   q_G_L.row(0) * t_z + p_G_L.row(1))
+                      .matrix();
+  xyzi_G.row(2) = (v.row(2) + q_G_L.row(3) * t_z + q_G_L.row(0) * t_y -
+                   q_G_L.row(1) * t_x + p_G_L.row(2))
+                      .matrix();
+  xyzi_G.row(3) =
+      xyzi_L.block(3, begin, 1, num_points).template cast<Scalar>();
+}
+
+}  // namespace landmark_triangulation
+
+#endif  // LANDMARK_TRIANGULATION_LASER_DESKEWING_INL_H_
@@ -0,0 +1,87 @@
+#ifndef LANDMARK_TRIANGULATION_LASER_DESKEWING_H_
+#define LANDMARK_TRIANGULATION_LASER_DESKEWING_H_
+
+#include <functional>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <vi-map/laser-edge.h>
+
+#include "landmark-triangulation/pose-interpolation-index.h"
+
+namespace landmark_triangulation {
+
+// Transforms the points of laser edges into the G frame, compensating the
+// motion of the sensor while the points were recorded. Instead of integrating
+// the IMU for every point, the sensor pose is taken from the interpolation
+// index at knots spaced by Options::knot_spacing_ns, and the poses of the
+// points are interpolated linearly between the knots. The transformation is
+// applied to blocks of points at once.
+//
+// The points are written as x, y, z, intensity in double or float precision,
+// either into a given matrix or block by block into a callback, e.g. to
+// integrate them into a voxblox layer without keeping the whole cloud.
+class LaserDeskewer {
+ public:
+  struct Options {
+    Options() : knot_spacing_ns(1000000), num_points_per_block(4096) {}
+    int64_t knot_spacing_ns;
+    int num_points_per_block;
+  };
+
+  template <typename Scalar>
+  using PointBlockCallback = std::function<void(
+      const Eigen::Ref<const Eigen::Matrix<Scalar, 4, Eigen::Dynamic>>&
+          xyzi_G)>;
+
+  // The index must outlive the deskewer.
+  LaserDeskewer(
+      const PoseInterpolationIndex& index_of_mission,
+      const aslam::Transformation& T_G_M, const aslam::Transformation& T_I_L,
+      const Options& options = Options());
+
+  // Returns false if some points were recorded outside of the IMU data of
+  // the mission. The blocks passed to the callback are only valid during the
+  // call.
+  template <typename Scalar>
+  bool forEachDeskewedBlock(
+      const vi_map::LaserEdge& laser_edge,
+      const PointBlockCallback<Scalar>& callback) const;
+
+  template <typename Scalar>
+  bool deskew(
+      const vi_map::LaserEdge& laser_edge,
+      Eigen::Matrix<Scalar, 4, Eigen::Dynamic>* xyzi_G) const;
+
+ private:
+  // Poses T_G_L at first_timestamp_ns + k * knot_spacing_ns, evenly covering
+  // the timestamps of an edge. The quaternions [x, y, z, w] of neighboring
+  // knots lie on the same hemisphere.
+  struct Knots {
+    int64_t first_timestamp_ns;
+    double knot_spacing_ns;
+    Eigen::Matrix<double, 3, Eigen::Dynamic> p_G_L;
+    Eigen::Matrix<double, 4, Eigen::Dynamic> q_G_L;
+  };
+
+  bool computeKnots(
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+      Knots* knots) const;
+
+  // Transforms the points [begin, begin + xyzi_G->cols()).
+  template <typename Scalar>
+  void transformBlock(
+      const Knots& knots, const vi_map::LaserEdge& laser_edge, const int begin,
+      Eigen::Ref<Eigen::Matrix<Scalar, 4, Eigen::Dynamic>> xyzi_G) const;
+
+  const PoseInterpolationIndex& index_of_mission_;
+  const aslam::Transformation T_G_M_;
+  const aslam::Transformation T_I_L_;
+  const Options options_;
+};
+
+}  // namespace landmark_triangulation
+
+#include "landmark-triangulation/laser-deskewing-inl.h"
+
+#endif  // LANDMARK_TRIANGULATION_LASER_DESKEWING_H_
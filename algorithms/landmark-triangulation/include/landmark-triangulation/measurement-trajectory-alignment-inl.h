@@ -0,0 +1,85 @@
+#ifndef LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_INL_H_
+#define LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_INL_H_
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace landmark_triangulation {
+
+template <typename MeasurementType>
+void alignMeasurementsToTrajectory(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const vi_map::SensorId& sensor_id,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    MeasurementTrajectoryAlignment* alignment) {
+  CHECK_NOTNULL(alignment);
+  CHECK(sensor_id.isValid());
+  const vi_map::MeasurementBuffer<MeasurementType>& measurements =
+      map.getOptionalSensorMeasurements<MeasurementType>(
+          sensor_id, mission_id);
+  alignTimestampsToTrajectory(
+      map, mission_id, measurements.timestamps(),
+      maximum_vertex_time_delta_ns, pose_interpolator, alignment);
+  alignment->sensor_id = sensor_id;
+}
+
+template <typename MeasurementType>
+void alignMeasurementsToTrajectories(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    std::vector<MeasurementTrajectoryAlignment>* alignments) {
+  CHECK_NOTNULL(alignments)->clear();
+
+  const vi_map::SensorType sensor_type =
+      vi_map::measurementToSensorType<MeasurementType>();
+  const vi_map::SensorManager& sensor_manager = map.getSensorManager();
+  std::vector<std::pair<vi_map::MissionId, vi_map::SensorId>>
+      missions_and_sensors;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    CHECK(mission_id.isValid());
+    if (!map.hasOptionalSensorData(mission_id)) {
+      continue;
+    }
+    const vi_map::OptionalSensorData& optional_sensor_data =
+        map.getOptionalSensorData(mission_id);
+    vi_map::SensorIdSet sensor_ids;
+    sensor_manager.getAllSensorIdsOfTypeAssociatedWithMission(
+        sensor_type, mission_id, &sensor_ids);
+    for (const vi_map::SensorId& sensor_id : sensor_ids) {
+      if (optional_sensor_data.hasMeasurements<MeasurementType>(sensor_id)) {
+        missions_and_sensors.emplace_back(mission_id, sensor_id);
+      }
+    }
+  }
+  if (missions_and_sensors.empty()) {
+    return;
+  }
+
+  alignments->resize(missions_and_sensors.size());
+  std::function<void(const std::vector<size_t>&)> aligner =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t i : batch) {
+          alignMeasurementsToTrajectory<MeasurementType>(
+              map, missions_and_sensors[i].first,
+              missions_and_sensors[i].second, maximum_vertex_time_delta_ns,
+              pose_interpolator, &(*alignments)[i]);
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = std::min<size_t>(
+      missions_and_sensors.size(), common::getNumHardwareThreads());
+  common::ParallelProcess(
+      missions_and_sensors.size(), aligner, kAlwaysParallelize, num_threads);
+}
+
+}  // namespace landmark_triangulation
+
+#endif  // LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_INL_H_
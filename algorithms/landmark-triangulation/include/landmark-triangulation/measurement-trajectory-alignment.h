@@ -0,0 +1,70 @@
+#ifndef LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_H_
+#define LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_H_
+
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "landmark-triangulation/pose-interpolator.h"
+
+namespace landmark_triangulation {
+
+// The measurements of one optional sensor of a mission matched to the
+// trajectory of the mission. The entries follow the time order of the
+// measurement buffer of the sensor.
+struct MeasurementTrajectoryAlignment {
+  vi_map::MissionId mission_id;
+  vi_map::SensorId sensor_id;
+
+  // Per measurement, the vertex closest in time within the maximum time
+  // delta, or an invalid id if there is none.
+  pose_graph::VertexIdList nearest_vertex_ids;
+
+  // The measurements [interpolated_begin_index, interpolated_end_index) lie
+  // within the IMU data of the mission, T_M_I holds their interpolated
+  // poses.
+  size_t interpolated_begin_index = 0u;
+  size_t interpolated_end_index = 0u;
+  aslam::TransformationVector T_M_I;
+};
+
+// Aligns sorted measurement timestamps to the trajectory of a mission. The
+// measurements are merged with the vertex timestamps and with the IMU
+// timeline of the cached interpolation index in a single linear pass each,
+// instead of searching every measurement on its own.
+void alignTimestampsToTrajectory(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const std::vector<int64_t>& sorted_timestamps_ns,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    MeasurementTrajectoryAlignment* alignment);
+
+// Aligns the measurements of the given sensor to the trajectory of the
+// mission. Works for every optional sensor type.
+template <typename MeasurementType>
+void alignMeasurementsToTrajectory(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const vi_map::SensorId& sensor_id,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    MeasurementTrajectoryAlignment* alignment);
+
+// Aligns the measurements of all sensors of the measurement type that are
+// associated with the missions. The missions and sensors are processed in
+// parallel, one alignment is returned per mission and sensor with
+// measurements.
+template <typename MeasurementType>
+void alignMeasurementsToTrajectories(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    std::vector<MeasurementTrajectoryAlignment>* alignments);
+
+}  // namespace landmark_triangulation
+
+#include "landmark-triangulation/measurement-trajectory-alignment-inl.h"
+
+#endif  // LANDMARK_TRIANGULATION_MEASUREMENT_TRAJECTORY_ALIGNMENT_H_
@@ -0,0 +1,88 @@
+#ifndef LANDMARK_TRIANGULATION_POSE_INTERPOLATION_INDEX_H_
+#define LANDMARK_TRIANGULATION_POSE_INTERPOLATION_INDEX_H_
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <imu-integrator/common.h>
+#include <imu-integrator/imu-integrator.h>
+#include <maplab-common/macros.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+namespace landmark_triangulation {
+
+// Prebuilt IMU timeline of a mission for pose interpolation. The IMU
+// measurements of every outgoing IMU edge along the mission are integrated
+// once, starting from the state of the edge's source vertex, and the state at
+// every measurement is kept. A pose at an arbitrary time is then found by a
+// binary search for the closest measurement before it and at most a single
+// integration step, instead of integrating the whole mission again.
+//
+// The index doesn't observe the map, it needs to be rebuilt after the vertex
+// states or the IMU edges of the mission changed.
+class PoseInterpolationIndex {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(PoseInterpolationIndex);
+
+  PoseInterpolationIndex(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id);
+
+  // False if the mission has no IMU edges with measurements.
+  bool hasImuData() const {
+    return !timestamps_ns_.empty();
+  }
+  int64_t getMinTimestampNanoseconds() const;
+  int64_t getMaxTimestampNanoseconds() const;
+
+  // The timestamp must lie within the IMU measurements of the mission.
+  aslam::Transformation getPoseAtTime(const int64_t timestamp_ns) const;
+  // Sorted timestamps are interpolated in one linear pass over the IMU
+  // timeline, unsorted ones with a binary search each.
+  void getPosesAtTime(
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+      aslam::TransformationVector* poses_M_I) const;
+
+ private:
+  typedef Eigen::Matrix<double, imu_integrator::kStateSize, 1> StateVector;
+
+  void checkTimestampInRange(const int64_t timestamp_ns) const;
+
+  // Integrates from the measurement at before_index, the newest one at or
+  // before the timestamp. The edge of the measurement ends at edge_end_index.
+  aslam::Transformation interpolatePose(
+      const int64_t timestamp_ns, const size_t before_index,
+      const size_t edge_end_index) const;
+
+  // Appends the measurements of the edge and integrates them from the state
+  // of the source vertex.
+  void addImuEdge(const vi_map::Vertex& vertex, const vi_map::ViwlsEdge& edge);
+
+  void getDebiasedImuReadings(
+      const StateVector& state,
+      const Eigen::Matrix<double, imu_integrator::kImuReadingSize, 1>& from,
+      const Eigen::Matrix<double, imu_integrator::kImuReadingSize, 1>& to,
+      Eigen::Matrix<double, 2 * imu_integrator::kImuReadingSize, 1>*
+          debiased_imu_readings) const;
+
+  // Only set if the mission has IMU data.
+  std::unique_ptr<imu_integrator::ImuIntegratorRK4> integrator_;
+
+  // One entry per IMU measurement of all edges, ordered by time. The edges
+  // follow each other, edge i owns the measurements [edge_begin_[i],
+  // edge_begin_[i + 1]).
+  std::vector<int64_t> timestamps_ns_;
+  Eigen::Matrix<double, imu_integrator::kImuReadingSize, Eigen::Dynamic>
+      imu_data_;
+  // Integrated state at every measurement [q_I_M, b_g, v_M, b_a, p_M_I].
+  Eigen::Matrix<double, imu_integrator::kStateSize, Eigen::Dynamic> states_;
+
+  std::vector<size_t> edge_begin_;
+  // Timestamp of the first measurement of every edge.
+  std::vector<int64_t> edge_begin_timestamps_ns_;
+};
+
+}  // namespace landmark_triangulation
+#endif  // LANDMARK_TRIANGULATION_POSE_INTERPOLATION_INDEX_H_
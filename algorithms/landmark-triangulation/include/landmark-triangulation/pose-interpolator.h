@@ -1,38 +1,16 @@
 #ifndef LANDMARK_TRIANGULATION_POSE_INTERPOLATOR_H_
 #define LANDMARK_TRIANGULATION_POSE_INTERPOLATOR_H_
 
-#include <string>
+#include <mutex>
 #include <unordered_map>
-#include <utility>
-#include <vector>
 
 #include <Eigen/Core>
-#include <maplab-common/gravity-provider.h>
-#include <maplab-common/temporal-buffer.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 
-namespace landmark_triangulation {
-
-struct VertexInformation {
-  int64_t timestamp_ns;
-  int64_t timestamp_ns_end;
-  pose_graph::VertexId vertex_id;
-  pose_graph::EdgeId outgoing_imu_edge_id;
-};
-
-struct IMUMeasurement {
-  int64_t timestamp;                            // nanoseconds.
-  Eigen::Matrix<double, 6, 1> imu_measurement;  // 3x1 accel, 3x1 gyro.
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-};
+#include "landmark-triangulation/pose-interpolation-index.h"
 
-struct StateLinearizationPoint {
-  int64_t timestamp;  // nanoseconds.
-  Eigen::Quaterniond q_M_I;
-  Eigen::Matrix<double, 3, 1> p_M_I;
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-};
+namespace landmark_triangulation {
 
 class PoseInterpolator {
  public:
@@ -41,6 +19,9 @@ class PoseInterpolator {
   // imu_timestamps.  Timestamps do not need to be sorted, but must lie within
   // the minimum and maximum timestamp of the mission's IMU measurements.
   // Extrapolating outside this range is not supported.
+  // The interpolation index of a mission is built on the first request and
+  // reused afterwards, so keep the interpolator around for repeated requests
+  // as long as the map doesn't change.
   void getPosesAtTime(
       const vi_map::VIMap& map, vi_map::MissionId mission_id,
       const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
@@ -63,47 +44,24 @@ class PoseInterpolator {
       std::unordered_map<pose_graph::VertexId, int64_t>* vertex_to_time_map)
       const;
 
- private:
-  typedef std::pair<int64_t, StateLinearizationPoint> state_buffer_value_type;
-  typedef common::TemporalBuffer<
-      StateLinearizationPoint,
-      Eigen::aligned_allocator<state_buffer_value_type> >
-      StateBuffer;
+  // Returns the cached index of the mission and builds it if necessary.
+  // Requesting a different map drops all cached indices, which invalidates
+  // the returned references.
+  const PoseInterpolationIndex& getInterpolationIndex(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id) const;
 
+ private:
   // Determine the earliest and latest IMU measurements across an entire
   // mission.
   void getMissionTimeRange(
       const vi_map::VIMap& vi_map, const vi_map::MissionId mission_id,
       int64_t* mission_start_ns_ptr, int64_t* mission_end_ns_ptr) const;
 
-  void getImuDataInRange(
-      const vi_map::VIMap& map, pose_graph::EdgeId imu_edge_id,
-      const std::vector<int64_t>& sorted_timestamps, int64_t range_time_start,
-      int64_t range_time_end,
-      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data) const;
-
-  void buildVertexToTimeList(
-      const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-      std::vector<VertexInformation>* vertices_and_time) const;
-
-  void computeRequestedPosesInRange(
-      const vi_map::VIMap& map, const vi_map::VIMission& mission,
-      const pose_graph::VertexId& vertex_begin_id,
-      const pose_graph::EdgeId& imu_edge_id,
-      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
-      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data,
-      StateBuffer* state_buffer) const;
-
-  void getImuTimeStampsInRange(
-      const std::vector<int64_t>& timestamps, int64_t range_time_start,
-      int64_t range_time_end) const;
-
-  void buildListOfAllRequiredIMUMeasurements(
-      const vi_map::VIMap& map, const std::vector<int64_t>& timestamps,
-      const pose_graph::EdgeId& imu_edge_id, int start_index, int end_index,
-      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data) const;
+  mutable std::mutex m_interpolation_indices_;
+  mutable const vi_map::VIMap* indexed_map_ = nullptr;
+  mutable std::unordered_map<
+      vi_map::MissionId, PoseInterpolationIndex::UniquePtr>
+      interpolation_indices_;
 };
 }  // namespace landmark_triangulation
 #endif  // LANDMARK_TRIANGULATION_POSE_INTERPOLATOR_H_
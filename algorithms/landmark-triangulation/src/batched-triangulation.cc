@@ -0,0 +1,167 @@
+#include "landmark-triangulation/batched-triangulation.h"
+
+#include <glog/logging.h>
+
+namespace landmark_triangulation {
+
+constexpr int BatchedNViewTriangulator::kMaxNumLandmarks;
+constexpr int BatchedNViewTriangulator::kMaxNumObservations;
+
+namespace {
+// The eigenvalues of the normal equations of a landmark with n observations
+// lie in [0, n]. Rejects (nearly) parallel rays, i.e. below about 1e-5 rad of
+// parallax for two observations.
+constexpr double kMinNormalizedDeterminant = 1e-12;
+}  // namespace
+
+BatchedNViewTriangulator::BatchedNViewTriangulator() {
+  clear();
+}
+
+bool BatchedNViewTriangulator::hasCapacityFor(size_t num_observations) const {
+  return num_landmarks_ < kMaxNumLandmarks &&
+         num_observations_ + num_observations <=
+             static_cast<size_t>(kMaxNumObservations);
+}
+
+void BatchedNViewTriangulator::addLandmark() {
+  CHECK_LT(num_landmarks_, kMaxNumLandmarks);
+  is_triangulated_ = false;
+  ++num_landmarks_;
+  observation_begin_(num_landmarks_) = num_observations_;
+}
+
+void BatchedNViewTriangulator::addObservation(
+    const Eigen::Vector3d& G_bearing_vector, const Eigen::Vector3d& p_G_C) {
+  CHECK_GT(num_landmarks_, 0) << "Call addLandmark() first.";
+  CHECK_LT(num_observations_, kMaxNumObservations);
+  const double bearing_norm = G_bearing_vector.norm();
+  CHECK_GT(bearing_norm, 0.0);
+
+  is_triangulated_ = false;
+  const int landmark_index = num_landmarks_ - 1;
+  if (num_observations_ == observation_begin_(landmark_index)) {
+    reference_x_(landmark_index) = p_G_C.x();
+    reference_y_(landmark_index) = p_G_C.y();
+    reference_z_(landmark_index) = p_G_C.z();
+  }
+  G_bearing_x_(num_observations_) = G_bearing_vector.x() / bearing_norm;
+  G_bearing_y_(num_observations_) = G_bearing_vector.y() / bearing_norm;
+  G_bearing_z_(num_observations_) = G_bearing_vector.z() / bearing_norm;
+  p_C_x_(num_observations_) = p_G_C.x() - reference_x_(landmark_index);
+  p_C_y_(num_observations_) = p_G_C.y() - reference_y_(landmark_index);
+  p_C_z_(num_observations_) = p_G_C.z() - reference_z_(landmark_index);
+  ++num_observations_;
+  observation_begin_(num_landmarks_) = num_observations_;
+}
+
+void BatchedNViewTriangulator::removeLastLandmark() {
+  CHECK_GT(num_landmarks_, 0);
+  is_triangulated_ = false;
+  --num_landmarks_;
+  num_observations_ = observation_begin_(num_landmarks_);
+}
+
+void BatchedNViewTriangulator::clear() {
+  num_landmarks_ = 0;
+  num_observations_ = 0;
+  is_triangulated_ = false;
+  observation_begin_(0) = 0;
+}
+
+int BatchedNViewTriangulator::numObservationsOfLandmark(
+    int landmark_index) const {
+  CHECK_GE(landmark_index, 0);
+  CHECK_LT(landmark_index, num_landmarks_);
+  return observation_begin_(landmark_index + 1) -
+         observation_begin_(landmark_index);
+}
+
+void BatchedNViewTriangulator::triangulate() {
+  // Minimizing the squared distance of the landmark to all rays gives
+  //   sum_i (I - b_i * b_i^T) * p_G_fi = sum_i (I - b_i * b_i^T) * p_G_C_i.
+  const int num_landmarks = num_landmarks_;
+  BatchArray a00(num_landmarks), a01(num_landmarks), a02(num_landmarks);
+  BatchArray a11(num_landmarks), a12(num_landmarks), a22(num_landmarks);
+  BatchArray r0(num_landmarks), r1(num_landmarks), r2(num_landmarks);
+  BatchArray num_observations(num_landmarks);
+  Eigen::Array<double, Eigen::Dynamic, 1, 0, kMaxNumObservations, 1>
+      bearing_dot_p;
+  for (int i = 0; i < num_landmarks; ++i) {
+    const int begin = observation_begin_(i);
+    const int n = observation_begin_(i + 1) - begin;
+    num_observations(i) = n;
+
+    const auto bx = G_bearing_x_.segment(begin, n);
+    const auto by = G_bearing_y_.segment(begin, n);
+    const auto bz = G_bearing_z_.segment(begin, n);
+    const auto px = p_C_x_.segment(begin, n);
+    const auto py = p_C_y_.segment(begin, n);
+    const auto pz = p_C_z_.segment(begin, n);
+    bearing_dot_p = bx * px + by * py + bz * pz;
+
+    a00(i) = n - bx.square().sum();
+    a01(i) = -(bx * by).sum();
+    a02(i) = -(bx * bz).sum();
+    a11(i) = n - by.square().sum();
+    a12(i) = -(by * bz).sum();
+    a22(i) = n - bz.square().sum();
+    r0(i) = px.sum() - (bx * bearing_dot_p).sum();
+    r1(i) = py.sum() - (by * bearing_dot_p).sum();
+    r2(i) = pz.sum() - (bz * bearing_dot_p).sum();
+  }
+
+  // Solves all the symmetric 3x3 systems at once through their adjugates.
+  const BatchArray c00 = a11 * a22 - a12 * a12;
+  const BatchArray c01 = a02 * a12 - a01 * a22;
+  const BatchArray c02 = a01 * a12 - a02 * a11;
+  const BatchArray c11 = a00 * a22 - a02 * a02;
+  const BatchArray c12 = a01 * a02 - a00 * a12;
+  const BatchArray c22 = a00 * a11 - a01 * a01;
+  const BatchArray determinant = a00 * c00 + a01 * c01 + a02 * c02;
+
+  is_observable_.head(num_landmarks) =
+      num_observations >= 2.0 &&
+      determinant > kMinNormalizedDeterminant * num_observations.cube();
+  const BatchArray inverse_determinant =
+      is_observable_.head(num_landmarks).select(determinant.inverse(), 0.0);
+
+  p_G_fi_x_.head(num_landmarks) =
+      reference_x_.head(num_landmarks) +
+      inverse_determinant * (c00 * r0 + c01 * r1 + c02 * r2);
+  p_G_fi_y_.head(num_landmarks) =
+      reference_y_.head(num_landmarks) +
+      inverse_determinant * (c01 * r0 + c11 * r1 + c12 * r2);
+  p_G_fi_z_.head(num_landmarks) =
+      reference_z_.head(num_landmarks) +
+      inverse_determinant * (c02 * r0 + c12 * r1 + c22 * r2);
+  is_triangulated_ = true;
+}
+
+aslam::TriangulationResult BatchedNViewTriangulator::getResult(
+    int landmark_index) const {
+  CHECK(is_triangulated_) << "Call triangulate() first.";
+  CHECK_GE(landmark_index, 0);
+  CHECK_LT(landmark_index, num_landmarks_);
+  if (numObservationsOfLandmark(landmark_index) < 2) {
+    return aslam::TriangulationResult(
+        aslam::TriangulationResult::TOO_FEW_MEASUREMENTS);
+  }
+  if (!is_observable_(landmark_index)) {
+    return aslam::TriangulationResult(
+        aslam::TriangulationResult::UNOBSERVABLE);
+  }
+  return aslam::TriangulationResult(aslam::TriangulationResult::SUCCESSFUL);
+}
+
+Eigen::Vector3d BatchedNViewTriangulator::getLandmarkPosition(
+    int landmark_index) const {
+  CHECK(is_triangulated_) << "Call triangulate() first.";
+  CHECK_GE(landmark_index, 0);
+  CHECK_LT(landmark_index, num_landmarks_);
+  return Eigen::Vector3d(
+      p_G_fi_x_(landmark_index), p_G_fi_y_(landmark_index),
+      p_G_fi_z_(landmark_index));
+}
+
+}  // namespace landmark_triangulation
@@ -1,16 +1,21 @@
 #include "landmark-triangulation/landmark-triangulation.h"
 
+#include <algorithm>
+#include <array>
 #include <functional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-#include <aslam/common/statistics/statistics.h>
 #include <aslam/triangulation/triangulation.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/telemetry.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
+#include "landmark-triangulation/batched-triangulation.h"
 #include "landmark-triangulation/pose-interpolator.h"
 
 namespace landmark_triangulation {
@@ -110,168 +115,384 @@ void interpolateVisualFramePosesAllMissions(
   }
 }
 
-void retriangulateLandmarksOfVertex(
+struct LandmarkToTriangulate {
+  vi_map::Landmark* landmark;
+  // Index of the storing vertex into the T_I_G_storing poses.
+  size_t storing_vertex_index;
+};
+typedef std::vector<LandmarkToTriangulate> LandmarkToTriangulateList;
+
+// Collects the landmarks stored in the given vertices together with the
+// inverse global poses of the storing vertices. If landmark_ids is set, only
+// these landmarks are collected.
+void getLandmarksToTriangulate(
+    const pose_graph::VertexIdList& storing_vertex_ids,
+    const std::unordered_set<vi_map::LandmarkId>* landmark_ids,
+    vi_map::VIMap* map, LandmarkToTriangulateList* landmarks,
+    aslam::TransformationVector* T_I_G_storing) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(landmarks)->clear();
+  CHECK_NOTNULL(T_I_G_storing)->clear();
+  T_I_G_storing->reserve(storing_vertex_ids.size());
+  for (size_t i = 0u; i < storing_vertex_ids.size(); ++i) {
+    vi_map::Vertex& storing_vertex = map->getVertex(storing_vertex_ids[i]);
+    const aslam::Transformation& T_G_M_storing =
+        const_cast<const vi_map::VIMap*>(map)
+            ->getMissionBaseFrameForVertex(storing_vertex_ids[i])
+            .get_T_G_M();
+    T_I_G_storing->emplace_back(
+        (T_G_M_storing * storing_vertex.get_T_M_I()).inverse());
+    for (vi_map::Landmark& landmark : storing_vertex.getLandmarks()) {
+      if (landmark_ids == nullptr || landmark_ids->count(landmark.id()) > 0u) {
+        landmarks->push_back(LandmarkToTriangulate{&landmark, i});
+      }
+    }
+  }
+}
+
+// Returns the first index of every range of landmarks, and the end index, such
+// that all ranges have about the same number of observations.
+std::vector<size_t> splitLandmarksByNumObservations(
+    const LandmarkToTriangulateList& landmarks, const size_t num_ranges) {
+  CHECK_GT(num_ranges, 0u);
+  size_t total_num_observations = 0u;
+  for (const LandmarkToTriangulate& landmark : landmarks) {
+    total_num_observations += landmark.landmark->numberOfObservations();
+  }
+
+  std::vector<size_t> range_begin;
+  range_begin.reserve(num_ranges + 1u);
+  range_begin.push_back(0u);
+  size_t num_observations = 0u;
+  for (size_t i = 0u; i < landmarks.size(); ++i) {
+    const size_t next_range_num_observations =
+        total_num_observations * range_begin.size() / num_ranges;
+    if (num_observations >= next_range_num_observations &&
+        range_begin.size() < num_ranges && range_begin.back() < i) {
+      range_begin.push_back(i);
+    }
+    num_observations += landmarks[i].landmark->numberOfObservations();
+  }
+  range_begin.push_back(landmarks.size());
+  return range_begin;
+}
+
+// Computes the global bearing vector and camera position of an observation.
+// Returns false if the keypoint can't be back-projected.
+bool getObservationRay(
+    const FrameToPoseMap& interpolated_frame_poses, const vi_map::VIMap& map,
+    const vi_map::KeypointIdentifier& observation,
+    const vi_map::LandmarkId& landmark_id, Eigen::Vector3d* G_bearing_vector,
+    Eigen::Vector3d* p_G_C) {
+  CHECK_NOTNULL(G_bearing_vector);
+  CHECK_NOTNULL(p_G_C);
+  const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
+  CHECK(map.hasVertex(observer_id))
+      << "Observer " << observer_id << " of store landmark " << landmark_id
+      << " not in currently loaded map!";
+
+  const vi_map::Vertex& observer = map.getVertex(observer_id);
+  const aslam::VisualFrame& visual_frame =
+      observer.getVisualFrame(observation.frame_id.frame_index);
+  const aslam::Transformation& T_G_M_observer =
+      map.getMissionBaseFrameForVertex(observer_id).get_T_G_M();
+
+  // If there are precomputed/interpolated T_M_I, use those.
+  aslam::Transformation T_G_I_observer;
+  FrameToPoseMap::const_iterator it =
+      interpolated_frame_poses.find(visual_frame.getId());
+  if (it != interpolated_frame_poses.end()) {
+    const aslam::Transformation& T_M_I_observer = it->second;
+    T_G_I_observer = T_G_M_observer * T_M_I_observer;
+  } else {
+    const aslam::Transformation& T_M_I_observer = observer.get_T_M_I();
+    T_G_I_observer = T_G_M_observer * T_M_I_observer;
+  }
+
+  Eigen::Vector2d measurement =
+      visual_frame.getKeypointMeasurement(observation.keypoint_index);
+
+  Eigen::Vector3d C_bearing_vector;
+  bool projection_result =
+      observer.getCamera(observation.frame_id.frame_index)
+          ->backProject3(measurement, &C_bearing_vector);
+  if (!projection_result) {
+    static const common::telemetry::Metric kStatsProjectionFailed(
+        "Landmark triangulation failed proj failed.");
+    kStatsProjectionFailed.increment();
+    return false;
+  }
+
+  const aslam::CameraId& cam_id =
+      observer.getCamera(observation.frame_id.frame_index)->getId();
+  aslam::Transformation T_G_C =
+      (T_G_I_observer * observer.getNCameras()->get_T_C_B(cam_id).inverse());
+  *G_bearing_vector = T_G_C.getRotationMatrix() * C_bearing_vector;
+  *p_G_C = T_G_C.getPosition();
+  return true;
+}
+
+void updateTriangulatedLandmark(
+    const aslam::TriangulationResult& triangulation_result,
+    const Eigen::Vector3d& p_G_fi, const aslam::Transformation& T_I_G_storing,
+    const vi_map::VIMap& map, vi_map::Landmark* landmark) {
+  CHECK_NOTNULL(landmark);
+  if (triangulation_result.wasTriangulationSuccessful()) {
+    landmark->set_p_B(T_I_G_storing * p_G_fi);
+    constexpr bool kReEvaluateQuality = true;
+    if (vi_map::isLandmarkWellConstrained(
+            map, *landmark, kReEvaluateQuality)) {
+      static const common::telemetry::Metric kStatsGood("Landmark good");
+      kStatsGood.increment();
+      landmark->setQuality(vi_map::Landmark::Quality::kGood);
+    } else {
+      static const common::telemetry::Metric kStatsBad(
+          "Landmark bad after triangulation");
+      kStatsBad.increment();
+    }
+  } else {
+    static const common::telemetry::Metric kStatsFailed(
+        "Landmark triangulation failed");
+    kStatsFailed.increment();
+    if (triangulation_result.status() ==
+        aslam::TriangulationResult::UNOBSERVABLE) {
+      static const common::telemetry::Metric kStatsUnobservable(
+          "Landmark triangulation failed - unobservable");
+      kStatsUnobservable.increment();
+    } else if (
+        triangulation_result.status() ==
+        aslam::TriangulationResult::UNINITIALIZED) {
+      static const common::telemetry::Metric kStatsUninitialized(
+          "Landmark triangulation failed - uninitialized");
+      kStatsUninitialized.increment();
+    }
+  }
+}
+
+// Landmarks with more observations than fit into a batch are triangulated on
+// their own.
+void retriangulateLandmarkWithManyObservations(
     const FrameToPoseMap& interpolated_frame_poses,
-    pose_graph::VertexId storing_vertex_id, vi_map::VIMap* map) {
+    const aslam::Transformation& T_I_G_storing, vi_map::VIMap* map,
+    vi_map::Landmark* landmark) {
   CHECK_NOTNULL(map);
-  vi_map::Vertex& storing_vertex = map->getVertex(storing_vertex_id);
-  vi_map::LandmarkStore& landmark_store = storing_vertex.getLandmarks();
+  CHECK_NOTNULL(landmark);
+  const vi_map::KeypointIdentifierList& observations =
+      landmark->getObservations();
+  // The following have one entry per measurement:
+  Eigen::Matrix3Xd G_bearing_vectors(3, observations.size());
+  Eigen::Matrix3Xd p_G_C_vector(3, observations.size());
+
+  int num_measurements = 0;
+  for (const vi_map::KeypointIdentifier& observation : observations) {
+    Eigen::Vector3d G_bearing_vector;
+    Eigen::Vector3d p_G_C;
+    if (getObservationRay(
+            interpolated_frame_poses, *map, observation, landmark->id(),
+            &G_bearing_vector, &p_G_C)) {
+      G_bearing_vectors.col(num_measurements) = G_bearing_vector;
+      p_G_C_vector.col(num_measurements) = p_G_C;
+      ++num_measurements;
+    }
+  }
+  G_bearing_vectors.conservativeResize(Eigen::NoChange, num_measurements);
+  p_G_C_vector.conservativeResize(Eigen::NoChange, num_measurements);
+
+  if (num_measurements < 2) {
+    static const common::telemetry::Metric kStatsTooFewMeasurements(
+        "Landmark triangulation too few meas.");
+    kStatsTooFewMeasurements.increment();
+    return;
+  }
 
-  const aslam::Transformation& T_M_I_storing = storing_vertex.get_T_M_I();
-  const aslam::Transformation& T_G_M_storing =
-      const_cast<const vi_map::VIMap*>(map)
-          ->getMissionBaseFrameForVertex(storing_vertex_id)
-          .get_T_G_M();
-  const aslam::Transformation T_G_I_storing = T_G_M_storing * T_M_I_storing;
+  Eigen::Vector3d p_G_fi;
+  const aslam::TriangulationResult triangulation_result =
+      aslam::linearTriangulateFromNViews(
+          G_bearing_vectors, p_G_C_vector, &p_G_fi);
+  updateTriangulatedLandmark(
+      triangulation_result, p_G_fi, T_I_G_storing, *map, landmark);
+}
 
-  for (vi_map::Landmark& landmark : landmark_store) {
-    // The following have one entry per measurement:
-    Eigen::Matrix3Xd G_bearing_vectors;
-    Eigen::Matrix3Xd p_G_C_vector;
+// Retriangulates the landmarks [begin, end) in batches, one batch is solved
+// at once by the BatchedNViewTriangulator.
+void retriangulateLandmarksInRange(
+    const FrameToPoseMap& interpolated_frame_poses,
+    const LandmarkToTriangulateList& landmarks,
+    const aslam::TransformationVector& T_I_G_storing, const size_t begin,
+    const size_t end, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_LE(begin, end);
+  CHECK_LE(end, landmarks.size());
+  const vi_map::VIMap& const_map = *map;
+
+  BatchedNViewTriangulator triangulator;
+  std::array<size_t, BatchedNViewTriangulator::kMaxNumLandmarks>
+      batch_landmark_indices;
+  auto triangulate_batch = [&triangulator, &batch_landmark_indices, &landmarks,
+                            &T_I_G_storing, &const_map]() {
+    triangulator.triangulate();
+    for (int i = 0; i < triangulator.numLandmarks(); ++i) {
+      const LandmarkToTriangulate& landmark =
+          landmarks[batch_landmark_indices[i]];
+      updateTriangulatedLandmark(
+          triangulator.getResult(i), triangulator.getLandmarkPosition(i),
+          T_I_G_storing[landmark.storing_vertex_index], const_map,
+          landmark.landmark);
+    }
+    triangulator.clear();
+  };
 
+  for (size_t landmark_index = begin; landmark_index < end; ++landmark_index) {
+    const LandmarkToTriangulate& landmark_to_triangulate =
+        landmarks[landmark_index];
+    vi_map::Landmark& landmark = *landmark_to_triangulate.landmark;
     landmark.setQuality(vi_map::Landmark::Quality::kBad);
 
     const vi_map::KeypointIdentifierList& observations =
         landmark.getObservations();
     if (observations.size() < 2u) {
-      statistics::StatsCollector stats(
+      static const common::telemetry::Metric kStatsTooFewObservations(
           "Landmark triangulation failed too few observations.");
-      stats.IncrementOne();
+      kStatsTooFewObservations.increment();
+      continue;
+    }
+    if (observations.size() >
+        static_cast<size_t>(BatchedNViewTriangulator::kMaxNumObservations)) {
+      retriangulateLandmarkWithManyObservations(
+          interpolated_frame_poses,
+          T_I_G_storing[landmark_to_triangulate.storing_vertex_index], map,
+          &landmark);
       continue;
     }
 
-    G_bearing_vectors.resize(Eigen::NoChange, observations.size());
-    p_G_C_vector.resize(Eigen::NoChange, observations.size());
-
-    int num_measurements = 0;
+    if (!triangulator.hasCapacityFor(observations.size())) {
+      triangulate_batch();
+    }
+    triangulator.addLandmark();
     for (const vi_map::KeypointIdentifier& observation : observations) {
-      const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
-      CHECK(map->hasVertex(observer_id))
-          << "Observer " << observer_id << " of store landmark "
-          << landmark.id() << " not in currently loaded map!";
-
-      const vi_map::Vertex& observer =
-          const_cast<const vi_map::VIMap*>(map)->getVertex(observer_id);
-      const aslam::VisualFrame& visual_frame =
-          observer.getVisualFrame(observation.frame_id.frame_index);
-      const aslam::Transformation& T_G_M_observer =
-          const_cast<const vi_map::VIMap*>(map)
-              ->getMissionBaseFrameForVertex(observer_id)
-              .get_T_G_M();
-
-      // If there are precomputed/interpolated T_M_I, use those.
-      aslam::Transformation T_G_I_observer;
-      FrameToPoseMap::const_iterator it =
-          interpolated_frame_poses.find(visual_frame.getId());
-      if (it != interpolated_frame_poses.end()) {
-        const aslam::Transformation& T_M_I_observer = it->second;
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
-      } else {
-        const aslam::Transformation& T_M_I_observer = observer.get_T_M_I();
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
+      Eigen::Vector3d G_bearing_vector;
+      Eigen::Vector3d p_G_C;
+      if (getObservationRay(
+              interpolated_frame_poses, const_map, observation, landmark.id(),
+              &G_bearing_vector, &p_G_C)) {
+        triangulator.addObservation(G_bearing_vector, p_G_C);
       }
-
-      Eigen::Vector2d measurement =
-          visual_frame.getKeypointMeasurement(observation.keypoint_index);
-
-      Eigen::Vector3d C_bearing_vector;
-      bool projection_result =
-          observer.getCamera(observation.frame_id.frame_index)
-              ->backProject3(measurement, &C_bearing_vector);
-      if (!projection_result) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed proj failed.");
-        stats.IncrementOne();
-        continue;
-      }
-
-      const aslam::CameraId& cam_id =
-          observer.getCamera(observation.frame_id.frame_index)->getId();
-      aslam::Transformation T_G_C =
-          (T_G_I_observer *
-           observer.getNCameras()->get_T_C_B(cam_id).inverse());
-      G_bearing_vectors.col(num_measurements) =
-          T_G_C.getRotationMatrix() * C_bearing_vector;
-      p_G_C_vector.col(num_measurements) = T_G_C.getPosition();
-      ++num_measurements;
     }
-    G_bearing_vectors.conservativeResize(Eigen::NoChange, num_measurements);
-    p_G_C_vector.conservativeResize(Eigen::NoChange, num_measurements);
 
-    if (num_measurements < 2) {
-      statistics::StatsCollector stats("Landmark triangulation too few meas.");
-      stats.IncrementOne();
+    const int batch_index = triangulator.numLandmarks() - 1;
+    if (triangulator.numObservationsOfLandmark(batch_index) < 2) {
+      static const common::telemetry::Metric kStatsTooFewMeasurements(
+          "Landmark triangulation too few meas.");
+      kStatsTooFewMeasurements.increment();
+      triangulator.removeLastLandmark();
       continue;
     }
-
-    Eigen::Vector3d p_G_fi;
-    aslam::TriangulationResult triangulation_result =
-        aslam::linearTriangulateFromNViews(
-            G_bearing_vectors, p_G_C_vector, &p_G_fi);
-
-    if (triangulation_result.wasTriangulationSuccessful()) {
-      landmark.set_p_B(T_G_I_storing.inverse() * p_G_fi);
-      constexpr bool kReEvaluateQuality = true;
-      if (vi_map::isLandmarkWellConstrained(
-              *map, landmark, kReEvaluateQuality)) {
-        statistics::StatsCollector stats_good("Landmark good");
-        stats_good.IncrementOne();
-        landmark.setQuality(vi_map::Landmark::Quality::kGood);
-      } else {
-        statistics::StatsCollector stats("Landmark bad after triangulation");
-        stats.IncrementOne();
-      }
-    } else {
-      statistics::StatsCollector stats("Landmark triangulation failed");
-      stats.IncrementOne();
-      if (triangulation_result.status() ==
-          aslam::TriangulationResult::UNOBSERVABLE) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed - unobservable");
-        stats.IncrementOne();
-      } else if (
-          triangulation_result.status() ==
-          aslam::TriangulationResult::UNINITIALIZED) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed - uninitialized");
-        stats.IncrementOne();
-      }
-    }
+    batch_landmark_indices[batch_index] = landmark_index;
+  }
+  if (triangulator.numLandmarks() > 0) {
+    triangulate_batch();
   }
 }
 
-bool retriangulateLandmarksOfMission(
-    const vi_map::MissionId& mission_id,
-    const FrameToPoseMap& interpolated_frame_poses, vi_map::VIMap* map) {
+void retriangulateLandmarksOfVertex(
+    const FrameToPoseMap& interpolated_frame_poses,
+    pose_graph::VertexId storing_vertex_id, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
+  LandmarkToTriangulateList landmarks;
+  aslam::TransformationVector T_I_G_storing;
+  constexpr std::unordered_set<vi_map::LandmarkId>* kAllLandmarks = nullptr;
+  getLandmarksToTriangulate(
+      {storing_vertex_id}, kAllLandmarks, map, &landmarks, &T_I_G_storing);
+  retriangulateLandmarksInRange(
+      interpolated_frame_poses, landmarks, T_I_G_storing, 0u,
+      landmarks.size(), map);
+  map->markLandmarksChanged();
+}
 
-  VLOG(1) << "Getting vertices of mission: " << mission_id;
-  pose_graph::VertexIdList relevant_vertex_ids;
-  map->getAllVertexIdsInMissionAlongGraph(mission_id, &relevant_vertex_ids);
+void retriangulateLandmarksInParallel(
+    const FrameToPoseMap& interpolated_frame_poses,
+    const LandmarkToTriangulateList& landmarks,
+    const aslam::TransformationVector& T_I_G_storing, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  if (landmarks.empty()) {
+    return;
+  }
 
-  const size_t num_vertices = relevant_vertex_ids.size();
-  VLOG(1) << "Retriangulating landmarks of " << num_vertices << " vertices.";
+  // The landmarks are split by their number of observations rather than by
+  // storing vertex, as few vertices can store most of the landmarks.
+  const size_t num_threads = common::getNumHardwareThreads();
+  const std::vector<size_t> range_begin =
+      splitLandmarksByNumObservations(landmarks, num_threads);
+  const size_t num_ranges = range_begin.size() - 1u;
 
   common::MultiThreadedProgressBar progress_bar;
   std::function<void(const std::vector<size_t>&)> retriangulator =
-      [&relevant_vertex_ids, map, &progress_bar,
-       &interpolated_frame_poses](const std::vector<size_t>& batch) {
-        progress_bar.setNumElements(batch.size());
-        size_t num_processed = 0u;
+      [&range_begin, num_ranges, &progress_bar, &interpolated_frame_poses,
+       &landmarks, &T_I_G_storing, map](const std::vector<size_t>& batch) {
         for (size_t item : batch) {
-          CHECK_LT(item, relevant_vertex_ids.size());
-          retriangulateLandmarksOfVertex(
-              interpolated_frame_poses, relevant_vertex_ids[item], map);
-          progress_bar.update(++num_processed);
+          CHECK_LT(item, num_ranges);
+          const size_t begin = range_begin[item];
+          const size_t end = range_begin[item + 1u];
+          progress_bar.setNumElements(end - begin);
+          constexpr size_t kNumLandmarksPerProgressUpdate =
+              BatchedNViewTriangulator::kMaxNumLandmarks;
+          for (size_t step_begin = begin; step_begin < end;
+               step_begin += kNumLandmarksPerProgressUpdate) {
+            const size_t step_end =
+                std::min(step_begin + kNumLandmarksPerProgressUpdate, end);
+            retriangulateLandmarksInRange(
+                interpolated_frame_poses, landmarks, T_I_G_storing,
+                step_begin, step_end, map);
+            progress_bar.update(step_end - begin);
+          }
         }
       };
 
-  static constexpr bool kAlwaysParallelize = false;
-  const size_t num_threads = common::getNumHardwareThreads();
+  static constexpr bool kAlwaysParallelize = true;
   common::ParallelProcess(
-      num_vertices, retriangulator, kAlwaysParallelize, num_threads);
+      num_ranges, retriangulator, kAlwaysParallelize, num_threads);
+  // The quality of the landmarks has changed.
+  map->markLandmarksChanged();
+}
+
+bool retriangulateLandmarksOfMission(
+    const vi_map::MissionId& mission_id,
+    const FrameToPoseMap& interpolated_frame_poses, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+
+  VLOG(1) << "Getting vertices of mission: " << mission_id;
+  pose_graph::VertexIdList relevant_vertex_ids;
+  map->getAllVertexIdsInMissionAlongGraph(mission_id, &relevant_vertex_ids);
+
+  LandmarkToTriangulateList landmarks;
+  aslam::TransformationVector T_I_G_storing;
+  constexpr std::unordered_set<vi_map::LandmarkId>* kAllLandmarks = nullptr;
+  getLandmarksToTriangulate(
+      relevant_vertex_ids, kAllLandmarks, map, &landmarks, &T_I_G_storing);
+  VLOG(1) << "Retriangulating " << landmarks.size() << " landmarks of "
+          << relevant_vertex_ids.size() << " vertices.";
+  retriangulateLandmarksInParallel(
+      interpolated_frame_poses, landmarks, T_I_G_storing, map);
   return true;
 }
+
+void recordVertexPoses(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    TriangulationRecord* record) {
+  CHECK_NOTNULL(record);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    record->T_G_I[vertex_id] = map.getVertex_T_G_I(vertex_id);
+  }
+}
+
+void recordNumObservations(
+    const LandmarkToTriangulateList& landmarks, TriangulationRecord* record) {
+  CHECK_NOTNULL(record);
+  for (const LandmarkToTriangulate& landmark : landmarks) {
+    record->num_observations[landmark.landmark->id()] =
+        landmark.landmark->numberOfObservations();
+  }
+}
 }  // namespace
 
 bool retriangulateLandmarks(vi_map::VIMap* map) {
@@ -288,6 +509,108 @@ bool retriangulateLandmarks(vi_map::VIMap* map) {
   return true;
 }
 
+bool retriangulateLandmarks(vi_map::VIMap* map, TriangulationRecord* record) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(record)->clear();
+  if (!retriangulateLandmarks(map)) {
+    return false;
+  }
+
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  recordVertexPoses(*map, vertex_ids, record);
+  LandmarkToTriangulateList landmarks;
+  aslam::TransformationVector T_I_G_storing;
+  constexpr std::unordered_set<vi_map::LandmarkId>* kAllLandmarks = nullptr;
+  getLandmarksToTriangulate(
+      vertex_ids, kAllLandmarks, map, &landmarks, &T_I_G_storing);
+  recordNumObservations(landmarks, record);
+  return true;
+}
+
+size_t retriangulateChangedLandmarks(
+    const double min_translation_m, const double min_rotation_rad,
+    TriangulationRecord* record, vi_map::VIMap* map) {
+  CHECK_NOTNULL(record);
+  CHECK_NOTNULL(map);
+  CHECK_GE(min_translation_m, 0.0);
+  CHECK_GE(min_rotation_rad, 0.0);
+  if (record->T_G_I.empty()) {
+    CHECK(retriangulateLandmarks(map, record));
+    return record->num_observations.size();
+  }
+
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  pose_graph::VertexIdList moved_vertex_ids;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const AlignedUnorderedMap<pose_graph::VertexId, aslam::Transformation>::
+        const_iterator it = record->T_G_I.find(vertex_id);
+    if (it != record->T_G_I.end()) {
+      const aslam::Transformation T_recorded_current =
+          it->second.inverse() * map->getVertex_T_G_I(vertex_id);
+      if (T_recorded_current.getPosition().norm() <= min_translation_m &&
+          aslam::AngleAxis(T_recorded_current.getRotation()).angle() <=
+              min_rotation_rad) {
+        continue;
+      }
+    }
+    moved_vertex_ids.emplace_back(vertex_id);
+  }
+
+  // The landmarks observed by the moved vertices, and the ones that gained or
+  // lost observations, e.g. by merging landmarks after a loop closure.
+  std::unordered_set<vi_map::LandmarkId> landmark_ids;
+  vi_map::LandmarkIdList observed_landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : moved_vertex_ids) {
+    map->getVertex(vertex_id).getAllObservedLandmarkIds(
+        &observed_landmark_ids);
+    for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+      if (landmark_id.isValid() && map->hasLandmark(landmark_id)) {
+        landmark_ids.emplace(landmark_id);
+      }
+    }
+  }
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    for (const vi_map::Landmark& landmark :
+         map->getVertex(vertex_id).getLandmarks()) {
+      const std::unordered_map<vi_map::LandmarkId, size_t>::const_iterator it =
+          record->num_observations.find(landmark.id());
+      if (it == record->num_observations.end() ||
+          it->second != landmark.numberOfObservations()) {
+        landmark_ids.emplace(landmark.id());
+      }
+    }
+  }
+
+  pose_graph::VertexIdSet storing_vertex_id_set;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    storing_vertex_id_set.emplace(map->getLandmarkStoreVertexId(landmark_id));
+  }
+  const pose_graph::VertexIdList storing_vertex_ids(
+      storing_vertex_id_set.begin(), storing_vertex_id_set.end());
+  LandmarkToTriangulateList landmarks;
+  aslam::TransformationVector T_I_G_storing;
+  getLandmarksToTriangulate(
+      storing_vertex_ids, &landmark_ids, map, &landmarks, &T_I_G_storing);
+  VLOG(1) << "Retriangulating " << landmarks.size() << " landmarks, "
+          << moved_vertex_ids.size() << " of " << vertex_ids.size()
+          << " vertices moved since the last triangulation.";
+
+  if (!landmarks.empty()) {
+    // Same poses as for the triangulation of all landmarks.
+    FrameToPoseMap interpolated_frame_poses;
+    interpolateVisualFramePosesAllMissions(*map, &interpolated_frame_poses);
+    retriangulateLandmarksInParallel(
+        interpolated_frame_poses, landmarks, T_I_G_storing, map);
+  }
+  // Vertices that moved less than the thresholds keep their recorded pose,
+  // such that small motions add up.
+  recordVertexPoses(*map, moved_vertex_ids, record);
+  recordNumObservations(landmarks, record);
+  return landmarks.size();
+}
+
 bool retriangulateLandmarksOfMission(
     const vi_map::MissionId& mission_id, vi_map::VIMap* map) {
   const FrameToPoseMap empty_frame_to_pose_map;
@@ -0,0 +1,73 @@
+#include "landmark-triangulation/laser-deskewing.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace landmark_triangulation {
+
+LaserDeskewer::LaserDeskewer(
+    const PoseInterpolationIndex& index_of_mission,
+    const aslam::Transformation& T_G_M, const aslam::Transformation& T_I_L,
+    const Options& options)
+    : index_of_mission_(index_of_mission),
+      T_G_M_(T_G_M),
+      T_I_L_(T_I_L),
+      options_(options) {
+  CHECK_GT(options_.knot_spacing_ns, 0);
+  CHECK_GT(options_.num_points_per_block, 0);
+}
+
+bool LaserDeskewer::computeKnots(
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+    Knots* knots) const {
+  CHECK_NOTNULL(knots);
+  CHECK_GT(timestamps_ns.cols(), 0);
+  const int64_t min_timestamp_ns = timestamps_ns.minCoeff();
+  const int64_t max_timestamp_ns = timestamps_ns.maxCoeff();
+  if (!index_of_mission_.hasImuData() ||
+      min_timestamp_ns < index_of_mission_.getMinTimestampNanoseconds() ||
+      max_timestamp_ns > index_of_mission_.getMaxTimestampNanoseconds()) {
+    return false;
+  }
+
+  // At least two knots, evenly spaced such that the last one lies on the
+  // newest point.
+  const int64_t duration_ns = max_timestamp_ns - min_timestamp_ns;
+  const int num_intervals = static_cast<int>(std::max<int64_t>(
+      1, (duration_ns + options_.knot_spacing_ns - 1) /
+             options_.knot_spacing_ns));
+  knots->first_timestamp_ns = min_timestamp_ns;
+  knots->knot_spacing_ns =
+      duration_ns > 0 ? static_cast<double>(duration_ns) / num_intervals : 1.0;
+
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> knot_timestamps_ns(
+      1, num_intervals + 1);
+  for (int knot_idx = 0; knot_idx < num_intervals; ++knot_idx) {
+    knot_timestamps_ns(0, knot_idx) =
+        min_timestamp_ns +
+        static_cast<int64_t>(std::llround(knot_idx * knots->knot_spacing_ns));
+  }
+  knot_timestamps_ns(0, num_intervals) = max_timestamp_ns;
+
+  aslam::TransformationVector T_M_I;
+  index_of_mission_.getPosesAtTime(knot_timestamps_ns, &T_M_I);
+  CHECK_EQ(static_cast<int>(T_M_I.size()), num_intervals + 1);
+
+  knots->p_G_L.resize(3, num_intervals + 1);
+  knots->q_G_L.resize(4, num_intervals + 1);
+  for (int knot_idx = 0; knot_idx <= num_intervals; ++knot_idx) {
+    const aslam::Transformation T_G_L = T_G_M_ * T_M_I[knot_idx] * T_I_L_;
+    knots->p_G_L.col(knot_idx) = T_G_L.getPosition();
+    knots->q_G_L.col(knot_idx) =
+        T_G_L.getRotation().toImplementation().coeffs();
+    if (knot_idx > 0 &&
+        knots->q_G_L.col(knot_idx).dot(knots->q_G_L.col(knot_idx - 1)) < 0.0) {
+      knots->q_G_L.col(knot_idx) *= -1.0;
+    }
+  }
+  return true;
+}
+
+}  // namespace landmark_triangulation
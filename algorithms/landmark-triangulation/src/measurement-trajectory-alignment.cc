@@ -0,0 +1,86 @@
+#include "landmark-triangulation/measurement-trajectory-alignment.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <maplab-common/columnar-temporal-buffer.h>
+
+#include "landmark-triangulation/pose-interpolation-index.h"
+
+namespace landmark_triangulation {
+
+void alignTimestampsToTrajectory(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const std::vector<int64_t>& sorted_timestamps_ns,
+    const int64_t maximum_vertex_time_delta_ns,
+    const PoseInterpolator& pose_interpolator,
+    MeasurementTrajectoryAlignment* alignment) {
+  CHECK_NOTNULL(alignment);
+  CHECK(mission_id.isValid());
+  CHECK_GE(maximum_vertex_time_delta_ns, 0);
+  CHECK(std::is_sorted(
+      sorted_timestamps_ns.begin(), sorted_timestamps_ns.end()));
+  *alignment = MeasurementTrajectoryAlignment();
+  alignment->mission_id = mission_id;
+
+  // The vertices along the graph are sorted in time, so they are appended to
+  // the buffer, and the nearest vertices of all measurements are found by
+  // one merge of the two sorted timestamp lists.
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+  common::ColumnarTemporalBuffer<pose_graph::VertexId> vertex_buffer;
+  vertex_buffer.reserve(vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    vertex_buffer.addValue(
+        map.getVertex(vertex_id).getMinTimestampNanoseconds(), vertex_id);
+  }
+  std::vector<int> nearest_vertex_indices;
+  vertex_buffer.getNearestIndicesToTimes(
+      sorted_timestamps_ns, maximum_vertex_time_delta_ns,
+      &nearest_vertex_indices);
+  CHECK_EQ(nearest_vertex_indices.size(), sorted_timestamps_ns.size());
+  alignment->nearest_vertex_ids.resize(sorted_timestamps_ns.size());
+  for (size_t i = 0u; i < nearest_vertex_indices.size(); ++i) {
+    if (nearest_vertex_indices[i] != vertex_buffer.kInvalidIndex) {
+      alignment->nearest_vertex_ids[i] =
+          vertex_buffer.values()[nearest_vertex_indices[i]];
+    }
+  }
+
+  if (sorted_timestamps_ns.empty() ||
+      map.getGraphTraversalEdgeType(mission_id) !=
+          pose_graph::Edge::EdgeType::kViwls) {
+    return;
+  }
+  const PoseInterpolationIndex& index =
+      pose_interpolator.getInterpolationIndex(map, mission_id);
+  if (!index.hasImuData()) {
+    return;
+  }
+
+  // Poses can only be interpolated within the IMU data, which is a
+  // contiguous range of the sorted measurements.
+  const std::vector<int64_t>::const_iterator begin_it = std::lower_bound(
+      sorted_timestamps_ns.begin(), sorted_timestamps_ns.end(),
+      index.getMinTimestampNanoseconds());
+  const std::vector<int64_t>::const_iterator end_it = std::upper_bound(
+      begin_it, sorted_timestamps_ns.end(),
+      index.getMaxTimestampNanoseconds());
+  alignment->interpolated_begin_index =
+      std::distance(sorted_timestamps_ns.begin(), begin_it);
+  alignment->interpolated_end_index =
+      std::distance(sorted_timestamps_ns.begin(), end_it);
+  if (begin_it == end_it) {
+    return;
+  }
+  const Eigen::Map<const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>>
+      interpolation_timestamps_ns(&*begin_it, std::distance(begin_it, end_it));
+  index.getPosesAtTime(interpolation_timestamps_ns, &alignment->T_M_I);
+  CHECK_EQ(
+      alignment->T_M_I.size(),
+      alignment->interpolated_end_index - alignment->interpolated_begin_index);
+}
+
+}  // namespace landmark_triangulation
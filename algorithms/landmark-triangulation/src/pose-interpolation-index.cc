@@ -0,0 +1,284 @@
+#include "landmark-triangulation/pose-interpolation-index.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace landmark_triangulation {
+
+PoseInterpolationIndex::PoseInterpolationIndex(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id) {
+  CHECK(mission_id.isValid());
+  pose_graph::VertexIdList all_mission_vertices;
+  map.getAllVertexIdsInMissionAlongGraph(mission_id, &all_mission_vertices);
+
+  // Collect the outgoing IMU edges first, so the measurements are only copied
+  // once.
+  std::vector<std::pair<const vi_map::Vertex*, const vi_map::ViwlsEdge*>>
+      imu_edges;
+  imu_edges.reserve(all_mission_vertices.size());
+  size_t num_measurements = 0u;
+  for (const pose_graph::VertexId& vertex_id : all_mission_vertices) {
+    const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+    pose_graph::EdgeIdSet outgoing_edges;
+    vertex.getOutgoingEdges(&outgoing_edges);
+    pose_graph::EdgeId outgoing_imu_edge_id;
+    for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+      if (map.getEdgeType(edge_id) == pose_graph::Edge::EdgeType::kViwls) {
+        outgoing_imu_edge_id = edge_id;
+        break;
+      }
+    }
+    // We must have reached the end of the graph.
+    if (!outgoing_imu_edge_id.isValid()) {
+      break;
+    }
+    const vi_map::ViwlsEdge& imu_edge =
+        map.getEdgeAs<vi_map::ViwlsEdge>(outgoing_imu_edge_id);
+    if (imu_edge.getImuTimestamps().cols() > 0) {
+      imu_edges.emplace_back(&vertex, &imu_edge);
+      num_measurements += imu_edge.getImuTimestamps().cols();
+    }
+  }
+  if (imu_edges.empty()) {
+    VLOG(2) << "Mission " << mission_id << " has no IMU data to interpolate.";
+    return;
+  }
+
+  const vi_map::Imu& imu_sensor =
+      map.getSensorManager().getSensorForMission<vi_map::Imu>(mission_id);
+  const vi_map::ImuSigmas& imu_sigmas = imu_sensor.getImuSigmas();
+  integrator_.reset(
+      new imu_integrator::ImuIntegratorRK4(
+          imu_sigmas.gyro_noise_density,
+          imu_sigmas.gyro_bias_random_walk_noise_density,
+          imu_sigmas.acc_noise_density,
+          imu_sigmas.acc_bias_random_walk_noise_density,
+          imu_sensor.getGravityMagnitudeMps2()));
+
+  timestamps_ns_.reserve(num_measurements);
+  imu_data_.resize(Eigen::NoChange, num_measurements);
+  states_.resize(Eigen::NoChange, num_measurements);
+  edge_begin_.reserve(imu_edges.size() + 1u);
+  edge_begin_timestamps_ns_.reserve(imu_edges.size());
+  for (const std::pair<const vi_map::Vertex*, const vi_map::ViwlsEdge*>&
+           vertex_and_edge : imu_edges) {
+    addImuEdge(*vertex_and_edge.first, *vertex_and_edge.second);
+  }
+  edge_begin_.push_back(timestamps_ns_.size());
+  CHECK_EQ(timestamps_ns_.size(), num_measurements);
+}
+
+void PoseInterpolationIndex::addImuEdge(
+    const vi_map::Vertex& vertex, const vi_map::ViwlsEdge& edge) {
+  using imu_integrator::kNanoSecondsToSeconds;
+  using imu_integrator::kStateAccelBiasOffset;
+  using imu_integrator::kStateGyroBiasOffset;
+  using imu_integrator::kStateOrientationBlockSize;
+  using imu_integrator::kStatePositionOffset;
+  using imu_integrator::kStateVelocityOffset;
+  CHECK(integrator_);
+
+  const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps =
+      edge.getImuTimestamps();
+  const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data =
+      edge.getImuData();  // 3x1 accel, 3x1 gyro.
+  CHECK_EQ(imu_timestamps.cols(), imu_data.cols());
+  CHECK_GT(imu_timestamps.cols(), 0);
+
+  const size_t begin = timestamps_ns_.size();
+  const int num_measurements = imu_timestamps.cols();
+  edge_begin_.push_back(begin);
+  edge_begin_timestamps_ns_.push_back(imu_timestamps(0, 0));
+  CHECK(
+      edge_begin_timestamps_ns_.size() < 2u ||
+      *(edge_begin_timestamps_ns_.rbegin() + 1) <= imu_timestamps(0, 0))
+      << "IMU edges not properly ordered";
+  for (int i = 0; i < num_measurements; ++i) {
+    timestamps_ns_.push_back(imu_timestamps(0, i));
+  }
+  imu_data_.middleCols(begin, num_measurements) = imu_data;
+
+  // Active to passive and direction switch, so no inversion.
+  const aslam::Transformation& T_M_I = vertex.get_T_M_I();
+  StateVector state;
+  state.head<kStateOrientationBlockSize>() =
+      T_M_I.getRotation().toImplementation().coeffs();
+  state.segment<3>(kStateGyroBiasOffset) = vertex.getGyroBias();
+  state.segment<3>(kStateVelocityOffset) = vertex.get_v_M();
+  state.segment<3>(kStateAccelBiasOffset) = vertex.getAccelBias();
+  state.segment<3>(kStatePositionOffset) = T_M_I.getPosition();
+  states_.col(begin) = state;
+
+  Eigen::Matrix<double, 2 * imu_integrator::kImuReadingSize, 1>
+      debiased_imu_readings;
+  StateVector next_state;
+  for (int i = 0; i < num_measurements - 1; ++i) {
+    CHECK_GE(imu_timestamps(0, i + 1), imu_timestamps(0, i))
+        << "IMU measurements not properly ordered";
+    getDebiasedImuReadings(
+        state, imu_data.col(i), imu_data.col(i + 1), &debiased_imu_readings);
+    const double delta_time_seconds =
+        (imu_timestamps(0, i + 1) - imu_timestamps(0, i)) *
+        kNanoSecondsToSeconds;
+    integrator_->integrateStateOnly(
+        state, debiased_imu_readings, delta_time_seconds, &next_state);
+    state = next_state;
+    states_.col(begin + i + 1) = state;
+  }
+}
+
+void PoseInterpolationIndex::getDebiasedImuReadings(
+    const StateVector& state,
+    const Eigen::Matrix<double, imu_integrator::kImuReadingSize, 1>& from,
+    const Eigen::Matrix<double, imu_integrator::kImuReadingSize, 1>& to,
+    Eigen::Matrix<double, 2 * imu_integrator::kImuReadingSize, 1>*
+        debiased_imu_readings) const {
+  using imu_integrator::kAccelReadingOffset;
+  using imu_integrator::kGyroReadingOffset;
+  using imu_integrator::kStateAccelBiasOffset;
+  using imu_integrator::kStateGyroBiasOffset;
+  CHECK_NOTNULL(debiased_imu_readings);
+  const Eigen::Vector3d gyro_bias = state.segment<3>(kStateGyroBiasOffset);
+  const Eigen::Vector3d accel_bias = state.segment<3>(kStateAccelBiasOffset);
+  *debiased_imu_readings << from.segment<3>(kAccelReadingOffset) - accel_bias,
+      from.segment<3>(kGyroReadingOffset) - gyro_bias,
+      to.segment<3>(kAccelReadingOffset) - accel_bias,
+      to.segment<3>(kGyroReadingOffset) - gyro_bias;
+}
+
+int64_t PoseInterpolationIndex::getMinTimestampNanoseconds() const {
+  CHECK(hasImuData());
+  return timestamps_ns_.front();
+}
+
+int64_t PoseInterpolationIndex::getMaxTimestampNanoseconds() const {
+  CHECK(hasImuData());
+  return timestamps_ns_.back();
+}
+
+aslam::Transformation PoseInterpolationIndex::getPoseAtTime(
+    const int64_t timestamp_ns) const {
+  checkTimestampInRange(timestamp_ns);
+
+  // At the boundary between two edges, the one starting at the vertex wins.
+  const size_t edge_index =
+      std::distance(
+          edge_begin_timestamps_ns_.begin(),
+          std::upper_bound(
+              edge_begin_timestamps_ns_.begin(),
+              edge_begin_timestamps_ns_.end(), timestamp_ns)) -
+      1u;
+  CHECK_LT(edge_index + 1u, edge_begin_.size());
+  const std::vector<int64_t>::const_iterator edge_begin_it =
+      timestamps_ns_.begin() + edge_begin_[edge_index];
+  const std::vector<int64_t>::const_iterator edge_end_it =
+      timestamps_ns_.begin() + edge_begin_[edge_index + 1u];
+  const std::vector<int64_t>::const_iterator after_it =
+      std::upper_bound(edge_begin_it, edge_end_it, timestamp_ns);
+  CHECK(after_it != edge_begin_it);
+  const size_t before_index =
+      std::distance(timestamps_ns_.begin(), after_it) - 1u;
+  return interpolatePose(
+      timestamp_ns, before_index, edge_begin_[edge_index + 1u]);
+}
+
+void PoseInterpolationIndex::checkTimestampInRange(
+    const int64_t timestamp_ns) const {
+  CHECK(hasImuData()) << "No IMU data to interpolate from.";
+  CHECK_GE(timestamp_ns, getMinTimestampNanoseconds())
+      << "Requested sample out of bounds! First available time is "
+      << getMinTimestampNanoseconds() << " but " << timestamp_ns
+      << " was requested.";
+  CHECK_LE(timestamp_ns, getMaxTimestampNanoseconds())
+      << "Requested sample out of bounds! Last available time is "
+      << getMaxTimestampNanoseconds() << " but " << timestamp_ns
+      << " was requested.";
+}
+
+aslam::Transformation PoseInterpolationIndex::interpolatePose(
+    const int64_t timestamp_ns, const size_t before_index,
+    const size_t edge_end_index) const {
+  using imu_integrator::kNanoSecondsToSeconds;
+  using imu_integrator::kStateOrientationBlockSize;
+  using imu_integrator::kStatePositionOffset;
+  CHECK_LT(before_index, edge_end_index);
+  StateVector state = states_.col(before_index);
+  const int64_t timestamp_before_ns = timestamps_ns_[before_index];
+  if (timestamp_before_ns != timestamp_ns) {
+    CHECK_LT(before_index + 1u, edge_end_index)
+        << "No IMU data at time " << timestamp_ns << ", it lies between the "
+        << "IMU edges.";
+    const int64_t timestamp_after_ns = timestamps_ns_[before_index + 1u];
+    CHECK_GT(timestamp_after_ns, timestamp_before_ns);
+    const double alpha =
+        static_cast<double>(timestamp_ns - timestamp_before_ns) /
+        static_cast<double>(timestamp_after_ns - timestamp_before_ns);
+    const Eigen::Matrix<double, imu_integrator::kImuReadingSize, 1>
+        interpolated_imu_measurement =
+            (1.0 - alpha) * imu_data_.col(before_index) +
+            alpha * imu_data_.col(before_index + 1u);
+
+    Eigen::Matrix<double, 2 * imu_integrator::kImuReadingSize, 1>
+        debiased_imu_readings;
+    getDebiasedImuReadings(
+        state, imu_data_.col(before_index), interpolated_imu_measurement,
+        &debiased_imu_readings);
+    StateVector interpolated_state;
+    integrator_->integrateStateOnly(
+        state, debiased_imu_readings,
+        (timestamp_ns - timestamp_before_ns) * kNanoSecondsToSeconds,
+        &interpolated_state);
+    state = interpolated_state;
+  }
+
+  Eigen::Quaterniond q_M_I;
+  q_M_I.coeffs() = state.head<kStateOrientationBlockSize>();
+  const Eigen::Vector3d p_M_I = state.segment<3>(kStatePositionOffset);
+  return aslam::Transformation(q_M_I, p_M_I);
+}
+
+void PoseInterpolationIndex::getPosesAtTime(
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+    aslam::TransformationVector* poses_M_I) const {
+  CHECK_NOTNULL(poses_M_I)->clear();
+  poses_M_I->reserve(timestamps_ns.cols());
+
+  bool timestamps_sorted = true;
+  for (int i = 1; i < timestamps_ns.cols() && timestamps_sorted; ++i) {
+    timestamps_sorted = timestamps_ns(0, i - 1) <= timestamps_ns(0, i);
+  }
+  if (!timestamps_sorted) {
+    for (int i = 0; i < timestamps_ns.cols(); ++i) {
+      poses_M_I->emplace_back(getPoseAtTime(timestamps_ns(0, i)));
+    }
+    return;
+  }
+
+  // Sorted timestamps are merged with the IMU timeline in a single pass, the
+  // edge and the measurement before the timestamp only ever move forward.
+  // This picks the same measurement as the binary searches of
+  // getPoseAtTime.
+  size_t edge_index = 0u;
+  size_t before_index = 0u;
+  for (int i = 0; i < timestamps_ns.cols(); ++i) {
+    const int64_t timestamp_ns = timestamps_ns(0, i);
+    checkTimestampInRange(timestamp_ns);
+    while (edge_index + 1u < edge_begin_timestamps_ns_.size() &&
+           edge_begin_timestamps_ns_[edge_index + 1u] <= timestamp_ns) {
+      ++edge_index;
+    }
+    const size_t edge_end_index = edge_begin_[edge_index + 1u];
+    before_index = std::max(before_index, edge_begin_[edge_index]);
+    CHECK_LE(timestamps_ns_[before_index], timestamp_ns);
+    while (before_index + 1u < edge_end_index &&
+           timestamps_ns_[before_index + 1u] <= timestamp_ns) {
+      ++before_index;
+    }
+    poses_M_I->emplace_back(
+        interpolatePose(timestamp_ns, before_index, edge_end_index));
+  }
+}
+
+}  // namespace landmark_triangulation
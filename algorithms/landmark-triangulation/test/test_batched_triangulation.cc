@@ -0,0 +1,119 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/triangulation/triangulation.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+#include "landmark-triangulation/batched-triangulation.h"
+
+namespace landmark_triangulation {
+
+class BatchedTriangulationTest : public ::testing::Test {
+ protected:
+  BatchedTriangulationTest() : random_engine_(42u), distribution_(-1.0, 1.0) {}
+
+  Eigen::Vector3d getRandomVector(const double scale) {
+    return scale * Eigen::Vector3d(
+                       distribution_(random_engine_),
+                       distribution_(random_engine_),
+                       distribution_(random_engine_));
+  }
+
+  // Adds a landmark observed noise-free from cameras scattered around
+  // p_G_C_center.
+  void addLandmark(
+      const Eigen::Vector3d& p_G_fi, const Eigen::Vector3d& p_G_C_center,
+      const int num_observations) {
+    triangulator_.addLandmark();
+    for (int i = 0; i < num_observations; ++i) {
+      const Eigen::Vector3d p_G_C = p_G_C_center + getRandomVector(1.0);
+      // Bearings don't need to be normalized.
+      const double scale = 1.0 + 3.0 * std::abs(distribution_(random_engine_));
+      triangulator_.addObservation(scale * (p_G_fi - p_G_C), p_G_C);
+    }
+  }
+
+  BatchedNViewTriangulator triangulator_;
+  std::mt19937 random_engine_;
+  std::uniform_real_distribution<double> distribution_;
+};
+
+TEST_F(BatchedTriangulationTest, TriangulatesAllLandmarksOfBatch) {
+  constexpr int kNumLandmarks = 50;
+  constexpr double kFarFromOrigin = 1e4;
+  std::vector<Eigen::Vector3d> p_G_fi;
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    const Eigen::Vector3d p_G_C_center =
+        (i % 2 == 0) ? Eigen::Vector3d::Zero()
+                     : Eigen::Vector3d::Constant(kFarFromOrigin);
+    p_G_fi.push_back(p_G_C_center + getRandomVector(10.0));
+    addLandmark(p_G_fi.back(), p_G_C_center, 2 + i % 7);
+  }
+  ASSERT_EQ(triangulator_.numLandmarks(), kNumLandmarks);
+
+  triangulator_.triangulate();
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    EXPECT_TRUE(triangulator_.getResult(i).wasTriangulationSuccessful());
+    EXPECT_NEAR_EIGEN(triangulator_.getLandmarkPosition(i), p_G_fi[i], 1e-6);
+  }
+}
+
+TEST_F(BatchedTriangulationTest, RejectsDegenerateLandmarks) {
+  const Eigen::Vector3d p_G_fi(1.0, 2.0, 10.0);
+  // Single observation.
+  addLandmark(p_G_fi, Eigen::Vector3d::Zero(), 1);
+  // All observations from the same camera position, i.e. parallel rays.
+  triangulator_.addLandmark();
+  for (int i = 0; i < 3; ++i) {
+    triangulator_.addObservation(p_G_fi, Eigen::Vector3d::Zero());
+  }
+  // A valid landmark after the degenerate ones.
+  addLandmark(p_G_fi, Eigen::Vector3d::Zero(), 3);
+
+  triangulator_.triangulate();
+  EXPECT_EQ(
+      triangulator_.getResult(0).status(),
+      aslam::TriangulationResult::TOO_FEW_MEASUREMENTS);
+  EXPECT_EQ(
+      triangulator_.getResult(1).status(),
+      aslam::TriangulationResult::UNOBSERVABLE);
+  EXPECT_TRUE(triangulator_.getResult(2).wasTriangulationSuccessful());
+  EXPECT_NEAR_EIGEN(triangulator_.getLandmarkPosition(2), p_G_fi, 1e-6);
+}
+
+TEST_F(BatchedTriangulationTest, CapacityAndRemoval) {
+  EXPECT_TRUE(triangulator_.hasCapacityFor(
+      BatchedNViewTriangulator::kMaxNumObservations));
+  EXPECT_FALSE(triangulator_.hasCapacityFor(
+      BatchedNViewTriangulator::kMaxNumObservations + 1));
+
+  const Eigen::Vector3d p_G_fi(-3.0, 0.5, 4.0);
+  addLandmark(p_G_fi, Eigen::Vector3d::Zero(), 4);
+  addLandmark(getRandomVector(5.0), Eigen::Vector3d::Zero(), 6);
+  EXPECT_FALSE(triangulator_.hasCapacityFor(
+      BatchedNViewTriangulator::kMaxNumObservations - 9));
+  triangulator_.removeLastLandmark();
+  ASSERT_EQ(triangulator_.numLandmarks(), 1);
+  EXPECT_EQ(triangulator_.numObservationsOfLandmark(0), 4);
+  EXPECT_TRUE(triangulator_.hasCapacityFor(
+      BatchedNViewTriangulator::kMaxNumObservations - 4));
+
+  triangulator_.triangulate();
+  EXPECT_TRUE(triangulator_.getResult(0).wasTriangulationSuccessful());
+  EXPECT_NEAR_EIGEN(triangulator_.getLandmarkPosition(0), p_G_fi, 1e-6);
+
+  triangulator_.clear();
+  EXPECT_EQ(triangulator_.numLandmarks(), 0);
+  for (int i = 0; i < BatchedNViewTriangulator::kMaxNumLandmarks; ++i) {
+    EXPECT_TRUE(triangulator_.hasCapacityFor(2u));
+    addLandmark(getRandomVector(5.0), Eigen::Vector3d::Zero(), 2);
+  }
+  EXPECT_FALSE(triangulator_.hasCapacityFor(2u));
+}
+
+}  // namespace landmark_triangulation
+
+MAPLAB_UNITTEST_ENTRYPOINT
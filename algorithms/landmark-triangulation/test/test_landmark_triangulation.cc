@@ -43,6 +43,39 @@ TEST_F(ViMappingTest, TestLandmarkTriangulation) {
       kPrecision, kMinPassingLandmarkFraction);
 }
 
+TEST_F(ViMappingTest, TestIncrementalLandmarkTriangulation) {
+  vi_map::VIMap* map = test_app_.getMapMutable();
+  TriangulationRecord record;
+  EXPECT_TRUE(retriangulateLandmarks(map, &record));
+  EXPECT_EQ(map->numLandmarks(), record.num_observations.size());
+  corruptLandmarks();
+
+  // Nothing moved since the record, so the corrupted landmarks are kept.
+  constexpr double kMinTranslationM = 0.01;
+  constexpr double kMinRotationRad = 1e-3;
+  EXPECT_EQ(
+      0u, retriangulateChangedLandmarks(
+              kMinTranslationM, kMinRotationRad, &record, map));
+
+  // Pretend that every vertex moved since the record.
+  const aslam::Transformation T_shift(
+      aslam::Quaternion(), Eigen::Vector3d(1.0, 0.0, 0.0));
+  for (auto& vertex_id_and_T_G_I : record.T_G_I) {
+    vertex_id_and_T_G_I.second = vertex_id_and_T_G_I.second * T_shift;
+  }
+  EXPECT_EQ(
+      map->numLandmarks(), retriangulateChangedLandmarks(
+                               kMinTranslationM, kMinRotationRad, &record,
+                               map));
+  constexpr double kPrecision = 0.1;
+  constexpr double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecision, kMinPassingLandmarkFraction);
+  EXPECT_EQ(
+      0u, retriangulateChangedLandmarks(
+              kMinTranslationM, kMinRotationRad, &record, map));
+}
+
 void checkLandmarkQualityInView(
     const vi_map::VIMap& map, int expected_num_unknown_quality,
     int expected_num_good_quality, int expected_num_bad_quality) {
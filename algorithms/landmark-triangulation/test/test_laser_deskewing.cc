@@ -0,0 +1,117 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <map-optimization-legacy/test/6dof-vi-map-gen.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/laser-edge.h>
+#include <vi-map/vi-map.h>
+
+#include "landmark-triangulation/laser-deskewing.h"
+#include "landmark-triangulation/pose-interpolation-index.h"
+
+namespace landmark_triangulation {
+
+class LaserDeskewingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vimap_gen_.generateVIMap();
+    vi_map::MissionIdList mission_ids;
+    vimap_gen_.vi_map_.getAllMissionIds(&mission_ids);
+    ASSERT_EQ(mission_ids.size(), 1u);
+    mission_id_ = mission_ids[0];
+  }
+
+  // Unsorted points in the middle of the mission.
+  vi_map::LaserEdge createLaserEdge(
+      const PoseInterpolationIndex& index) const {
+    constexpr int kNumPoints = 5000;
+    const int64_t begin_ns = (index.getMinTimestampNanoseconds() +
+                              index.getMaxTimestampNanoseconds()) /
+                             2;
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns(1, kNumPoints);
+    for (int i = 0; i < kNumPoints; ++i) {
+      timestamps_ns(0, i) = begin_ns + ((i * 7919) % kNumPoints) * 20000;
+    }
+    Eigen::Matrix<double, 4, Eigen::Dynamic> xyzi_L =
+        Eigen::Matrix<double, 4, Eigen::Dynamic>::Random(4, kNumPoints);
+    xyzi_L.topRows<3>() *= 20.0;
+    return vi_map::LaserEdge(
+        pose_graph::EdgeId(), pose_graph::VertexId(), pose_graph::VertexId(),
+        timestamps_ns, xyzi_L);
+  }
+
+  map_optimization_legacy::SixDofVIMapGenerator vimap_gen_;
+  vi_map::MissionId mission_id_;
+};
+
+TEST_F(LaserDeskewingTest, PointsMatchPosesOfTheIndex) {
+  const PoseInterpolationIndex index(vimap_gen_.vi_map_, mission_id_);
+  ASSERT_TRUE(index.hasImuData());
+  const vi_map::LaserEdge laser_edge = createLaserEdge(index);
+
+  const aslam::Transformation T_G_M(
+      Eigen::Quaterniond(0.9, 0.1, -0.2, 0.3).normalized(),
+      Eigen::Vector3d(10.0, -5.0, 2.0));
+  const aslam::Transformation T_I_L(
+      Eigen::Quaterniond(0.7, 0.7, 0.0, 0.0).normalized(),
+      Eigen::Vector3d(0.1, 0.0, 0.2));
+  LaserDeskewer::Options options;
+  options.num_points_per_block = 1000;
+  const LaserDeskewer deskewer(index, T_G_M, T_I_L, options);
+
+  Eigen::Matrix<double, 4, Eigen::Dynamic> xyzi_G;
+  ASSERT_TRUE(deskewer.deskew(laser_edge, &xyzi_G));
+  Eigen::Matrix<float, 4, Eigen::Dynamic> xyzi_G_float;
+  ASSERT_TRUE(deskewer.deskew(laser_edge, &xyzi_G_float));
+
+  const Eigen::Matrix<double, 4, Eigen::Dynamic>& xyzi_L =
+      laser_edge.getLaserData();
+  ASSERT_EQ(xyzi_G.cols(), xyzi_L.cols());
+  for (int i = 0; i < xyzi_L.cols(); ++i) {
+    const Eigen::Vector3d p_G =
+        T_G_M * index.getPoseAtTime(laser_edge.getLaserTimestamps()(0, i)) *
+        T_I_L * static_cast<Eigen::Vector3d>(xyzi_L.col(i).head<3>());
+    EXPECT_LT((xyzi_G.col(i).head<3>() - p_G).norm(), 1e-4);
+    EXPECT_LT(
+        (xyzi_G_float.col(i).head<3>().cast<double>() - p_G).norm(), 1e-3);
+    EXPECT_EQ(xyzi_G(3, i), xyzi_L(3, i));
+  }
+
+  // The blocks are the same as the full cloud.
+  int num_points = 0;
+  ASSERT_TRUE(
+      deskewer.forEachDeskewedBlock<double>(
+          laser_edge,
+          [&](const Eigen::Ref<const Eigen::Matrix<double, 4, Eigen::Dynamic>>&
+                  block) {
+            EXPECT_LE(block.cols(), options.num_points_per_block);
+            EXPECT_EQ(block, xyzi_G.middleCols(num_points, block.cols()));
+            num_points += block.cols();
+          }));
+  EXPECT_EQ(num_points, xyzi_L.cols());
+}
+
+TEST_F(LaserDeskewingTest, PointsOutsideOfImuDataAreRejected) {
+  const PoseInterpolationIndex index(vimap_gen_.vi_map_, mission_id_);
+  ASSERT_TRUE(index.hasImuData());
+  const vi_map::LaserEdge laser_edge = createLaserEdge(index);
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns =
+      laser_edge.getLaserTimestamps();
+  timestamps_ns(0, 1) = index.getMaxTimestampNanoseconds() + 1;
+  const vi_map::LaserEdge late_laser_edge(
+      pose_graph::EdgeId(), pose_graph::VertexId(), pose_graph::VertexId(),
+      timestamps_ns, laser_edge.getLaserData());
+
+  const LaserDeskewer deskewer(
+      index, aslam::Transformation(), aslam::Transformation());
+  Eigen::Matrix<float, 4, Eigen::Dynamic> xyzi_G;
+  EXPECT_FALSE(deskewer.deskew(late_laser_edge, &xyzi_G));
+  EXPECT_EQ(xyzi_G.cols(), 0);
+}
+
+}  // namespace landmark_triangulation
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -2,6 +2,7 @@
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/distortion-fisheye.h>
@@ -15,6 +16,8 @@
 #include <vi-map/pose-graph.h>
 #include <vi-map/vi-map.h>
 
+#include "landmark-triangulation/measurement-trajectory-alignment.h"
+#include "landmark-triangulation/pose-interpolation-index.h"
 #include "landmark-triangulation/pose-interpolator.h"
 
 namespace landmark_triangulation {
@@ -140,6 +143,142 @@ TEST_F(ViwlsGraph, PoseInterpolationTestBetweenVertices) {
   }
 }
 
+TEST_F(ViwlsGraph, PoseInterpolationIndexMatchesBatchRequest) {
+  vimap_gen_.generateVIMap();
+  vi_map::VIMap& vi_map = vimap_gen_.vi_map_;
+
+  vi_map::MissionIdList mission_ids;
+  vi_map.getAllMissionIds(&mission_ids);
+  CHECK_EQ(mission_ids.size(), 1u);
+  const vi_map::MissionId& mission_id = mission_ids[0];
+
+  const PoseInterpolationIndex index(vi_map, mission_id);
+  ASSERT_TRUE(index.hasImuData());
+  const int64_t min_timestamp_ns = index.getMinTimestampNanoseconds();
+  const int64_t max_timestamp_ns = index.getMaxTimestampNanoseconds();
+
+  // Unsorted timestamps, mostly in between IMU measurements.
+  constexpr int kNumTimestamps = 100;
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns(kNumTimestamps);
+  for (int i = 0; i < kNumTimestamps; ++i) {
+    const int j = (i * 37) % kNumTimestamps;
+    timestamps_ns(0, i) =
+        min_timestamp_ns + (max_timestamp_ns - min_timestamp_ns) * j /
+                               (kNumTimestamps - 1);
+  }
+
+  PoseInterpolator pose_interpolator;
+  aslam::TransformationVector T_M_I_batch;
+  pose_interpolator.getPosesAtTime(
+      vi_map, mission_id, timestamps_ns, &T_M_I_batch);
+  ASSERT_EQ(static_cast<int>(T_M_I_batch.size()), kNumTimestamps);
+
+  // Single requests reuse the cached index and give the same poses.
+  for (int i = 0; i < kNumTimestamps; ++i) {
+    aslam::TransformationVector T_M_I_single;
+    pose_interpolator.getPosesAtTime(
+        vi_map, mission_id, timestamps_ns.col(i), &T_M_I_single);
+    ASSERT_EQ(T_M_I_single.size(), 1u);
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(T_M_I_single[0], T_M_I_batch[i], 1e-12);
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        index.getPoseAtTime(timestamps_ns(0, i)), T_M_I_batch[i], 1e-12);
+  }
+  EXPECT_EQ(
+      &pose_interpolator.getInterpolationIndex(vi_map, mission_id),
+      &pose_interpolator.getInterpolationIndex(vi_map, mission_id));
+}
+
+TEST_F(ViwlsGraph, SortedPoseRequestMatchesSingleRequests) {
+  vimap_gen_.generateVIMap();
+  vi_map::VIMap& vi_map = vimap_gen_.vi_map_;
+
+  vi_map::MissionIdList mission_ids;
+  vi_map.getAllMissionIds(&mission_ids);
+  CHECK_EQ(mission_ids.size(), 1u);
+  const vi_map::MissionId& mission_id = mission_ids[0];
+
+  const PoseInterpolationIndex index(vi_map, mission_id);
+  ASSERT_TRUE(index.hasImuData());
+  const int64_t min_timestamp_ns = index.getMinTimestampNanoseconds();
+  const int64_t max_timestamp_ns = index.getMaxTimestampNanoseconds();
+
+  // Sorted timestamps including duplicates and both borders.
+  constexpr int kNumTimestamps = 100;
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns(kNumTimestamps);
+  for (int i = 0; i < kNumTimestamps; ++i) {
+    timestamps_ns(0, i) = min_timestamp_ns +
+                          (max_timestamp_ns - min_timestamp_ns) * (i / 2) /
+                              (kNumTimestamps / 2 - 1);
+  }
+  ASSERT_EQ(timestamps_ns(0, kNumTimestamps - 1), max_timestamp_ns);
+
+  aslam::TransformationVector T_M_I_sorted;
+  index.getPosesAtTime(timestamps_ns, &T_M_I_sorted);
+  ASSERT_EQ(static_cast<int>(T_M_I_sorted.size()), kNumTimestamps);
+  for (int i = 0; i < kNumTimestamps; ++i) {
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        index.getPoseAtTime(timestamps_ns(0, i)), T_M_I_sorted[i], 1e-12);
+  }
+}
+
+TEST_F(ViwlsGraph, MeasurementTrajectoryAlignment) {
+  vimap_gen_.generateVIMap();
+  vi_map::VIMap& vi_map = vimap_gen_.vi_map_;
+
+  vi_map::MissionIdList mission_ids;
+  vi_map.getAllMissionIds(&mission_ids);
+  CHECK_EQ(mission_ids.size(), 1u);
+  const vi_map::MissionId& mission_id = mission_ids[0];
+
+  pose_graph::VertexIdList vertex_ids;
+  vi_map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+  ASSERT_GE(vertex_ids.size(), 2u);
+
+  // One measurement slightly after every vertex, one far before the first
+  // vertex and one far after the last.
+  constexpr int64_t kMaximumDeltaNs = 1000;
+  constexpr int64_t kOffsetNs = 10;
+  std::vector<int64_t> timestamps_ns;
+  timestamps_ns.emplace_back(
+      vi_map.getVertex(vertex_ids.front()).getMinTimestampNanoseconds() -
+      100 * kMaximumDeltaNs);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    timestamps_ns.emplace_back(
+        vi_map.getVertex(vertex_id).getMinTimestampNanoseconds() + kOffsetNs);
+  }
+  timestamps_ns.emplace_back(
+      vi_map.getVertex(vertex_ids.back()).getMinTimestampNanoseconds() +
+      100 * kMaximumDeltaNs);
+
+  PoseInterpolator pose_interpolator;
+  MeasurementTrajectoryAlignment alignment;
+  alignTimestampsToTrajectory(
+      vi_map, mission_id, timestamps_ns, kMaximumDeltaNs, pose_interpolator,
+      &alignment);
+  EXPECT_EQ(alignment.mission_id, mission_id);
+  ASSERT_EQ(alignment.nearest_vertex_ids.size(), timestamps_ns.size());
+  EXPECT_FALSE(alignment.nearest_vertex_ids.front().isValid());
+  EXPECT_FALSE(alignment.nearest_vertex_ids.back().isValid());
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    EXPECT_EQ(alignment.nearest_vertex_ids[i + 1u], vertex_ids[i]);
+  }
+
+  const PoseInterpolationIndex& index =
+      pose_interpolator.getInterpolationIndex(vi_map, mission_id);
+  ASSERT_LE(
+      alignment.interpolated_begin_index, alignment.interpolated_end_index);
+  ASSERT_EQ(
+      alignment.T_M_I.size(),
+      alignment.interpolated_end_index - alignment.interpolated_begin_index);
+  ASSERT_FALSE(alignment.T_M_I.empty());
+  for (size_t i = alignment.interpolated_begin_index;
+       i < alignment.interpolated_end_index; ++i) {
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        index.getPoseAtTime(timestamps_ns[i]),
+        alignment.T_M_I[i - alignment.interpolated_begin_index], 1e-12);
+  }
+}
+
 }  // namespace landmark_triangulation
 
 MAPLAB_UNITTEST_ENTRYPOINT
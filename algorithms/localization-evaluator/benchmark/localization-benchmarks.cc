@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+
+#include "localization-evaluator/localization-benchmark.h"
+#include "localization-evaluator/mission-aligner.h"
+
+// Benchmarks the localization of one mission of a map against the other
+// missions over the grid given by --lc_benchmark_detector_engines,
+// --lc_benchmark_projection_files and --lc_benchmark_num_threads:
+//   localization_benchmarks --localization_benchmark_map=<map folder>
+//       --lc_benchmark_out=results.json
+
+DEFINE_string(
+    localization_benchmark_map, "", "Folder of the map to benchmark on.");
+DEFINE_string(
+    localization_benchmark_query_mission, "",
+    "Id of the query mission. Uses the first mission if empty.");
+DEFINE_bool(
+    localization_benchmark_align_missions, false,
+    "Align and co-optimize the missions first. The map poses are used as the "
+    "ground truth, so this is required if the missions aren't aligned yet.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  CHECK(!FLAGS_localization_benchmark_map.empty())
+      << "Set --localization_benchmark_map.";
+
+  vi_map::VIMap map;
+  CHECK(vi_map::serialization::loadMapFromFolder(
+      FLAGS_localization_benchmark_map, &map))
+      << "Could not load the map from " << FLAGS_localization_benchmark_map
+      << '.';
+  CHECK_GE(map.numMissions(), 2u)
+      << "The map needs a query mission and at least one database mission.";
+
+  vi_map::MissionId query_mission_id;
+  if (FLAGS_localization_benchmark_query_mission.empty()) {
+    query_mission_id = map.getIdOfFirstMission();
+  } else {
+    CHECK(map.ensureMissionIdValid(
+        FLAGS_localization_benchmark_query_mission, &query_mission_id))
+        << "Invalid query mission "
+        << FLAGS_localization_benchmark_query_mission << '.';
+  }
+
+  if (FLAGS_localization_benchmark_align_missions) {
+    vi_map::MissionIdList mission_ids;
+    map.getAllMissionIds(&mission_ids);
+    vi_map::MissionIdSet database_mission_ids(
+        mission_ids.begin(), mission_ids.end());
+    database_mission_ids.erase(query_mission_id);
+    constexpr bool kAlignMapMissions = true;
+    constexpr bool kOptimizeOnlyQueryMission = false;
+    localization_evaluator::alignAndCooptimizeMissionsWithoutLandmarkMerge(
+        query_mission_id, database_mission_ids, kAlignMapMissions,
+        kOptimizeOnlyQueryMission, &map);
+  }
+
+  std::vector<localization_evaluator::LocalizationBenchmarkConfig> configs;
+  localization_evaluator::getLocalizationBenchmarkConfigsFromFlags(&configs);
+  std::vector<localization_evaluator::LocalizationBenchmarkResult> results;
+  localization_evaluator::runLocalizationBenchmarks(
+      configs, query_mission_id, &map, &results);
+  return localization_evaluator::writeLocalizationBenchmarkResultsAsJson(
+             results)
+             ? 0
+             : 1;
+}
@@ -0,0 +1,81 @@
+#ifndef LOCALIZATION_EVALUATOR_LOCALIZATION_BENCHMARK_H_
+#define LOCALIZATION_EVALUATOR_LOCALIZATION_BENCHMARK_H_
+
+#include <cstdint>
+#include <iostream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace localization_evaluator {
+
+// One point of the benchmark grid. Empty projection files use the default
+// files of the loop detector.
+struct LocalizationBenchmarkConfig {
+  std::string detector_engine;
+  std::string projection_matrix_filename;
+  std::string projected_quantizer_filename;
+  size_t num_threads;
+
+  std::string getName() const;
+};
+
+struct LocalizationBenchmarkResult {
+  LocalizationBenchmarkConfig config;
+
+  size_t num_database_landmarks;
+  double database_build_time_seconds;
+  // Increase of the resident set size while building the database.
+  int64_t database_memory_kb;
+  // Peak resident set size of the process after the evaluation.
+  int64_t peak_memory_kb;
+
+  size_t num_queries;
+  size_t num_successful_localizations;
+  // Fraction of the queries localized within
+  // --benchmark_position_error_threshold of the ground truth pose of the
+  // query vertex.
+  double recall;
+  double evaluation_time_seconds;
+  double throughput_queries_per_second;
+
+  double latency_mean_ms;
+  double latency_p50_ms;
+  double latency_p90_ms;
+  double latency_p99_ms;
+  double latency_max_ms;
+};
+
+// Builds the grid from --lc_benchmark_detector_engines,
+// --lc_benchmark_projection_files and --lc_benchmark_num_threads.
+void getLocalizationBenchmarkConfigsFromFlags(
+    std::vector<LocalizationBenchmarkConfig>* configs);
+
+// Localizes every vertex of the query mission against a database built from
+// the landmarks of all other missions. The missions need to be aligned, e.g.
+// with alignAndCooptimizeMissionsWithoutLandmarkMerge, as the map poses are
+// the ground truth.
+void runLocalizationBenchmark(
+    const LocalizationBenchmarkConfig& config,
+    const vi_map::MissionId& query_mission_id, vi_map::VIMap* map,
+    LocalizationBenchmarkResult* result);
+void runLocalizationBenchmarks(
+    const std::vector<LocalizationBenchmarkConfig>& configs,
+    const vi_map::MissionId& query_mission_id, vi_map::VIMap* map,
+    std::vector<LocalizationBenchmarkResult>* results);
+
+void writeLocalizationBenchmarkResultsAsJson(
+    const std::vector<LocalizationBenchmarkResult>& results,
+    std::ostream* out);
+// Writes to --lc_benchmark_out or to stdout if the flag is empty.
+bool writeLocalizationBenchmarkResultsAsJson(
+    const std::vector<LocalizationBenchmarkResult>& results);
+
+}  // namespace localization_evaluator
+
+#endif  // LOCALIZATION_EVALUATOR_LOCALIZATION_BENCHMARK_H_
@@ -20,6 +20,8 @@ struct MissionEvaluationStats {
   std::vector<unsigned int> lc_matches_counts;
   std::vector<unsigned int> inliers_counts;
   std::vector<double> localization_errors_meters;
+  // Wall time of every localization query, in the order of the vertices.
+  std::vector<double> query_latencies_seconds;
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -39,6 +41,9 @@ class LocalizationEvaluator {
       double* error_meters, bool* ransac_ok);
   void evaluateMission(
       const vi_map::MissionId& mission_id, MissionEvaluationStats* statistics);
+  void evaluateMission(
+      const vi_map::MissionId& mission_id, const size_t num_threads,
+      MissionEvaluationStats* statistics);
 
  private:
   vi_map::VIMap* map_;
@@ -0,0 +1,341 @@
+#include "localization-evaluator/localization-benchmark.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>  // NOLINT
+#include <sstream>  // NOLINT
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/string-tools.h>
+#include <vi-map/vi-map.h>
+
+#include "localization-evaluator/localization-evaluator.h"
+
+DEFINE_string(
+    lc_benchmark_detector_engines,
+    "kd_tree,inverted_index,inverted_multi_index,"
+    "inverted_multi_index_product_quantization",
+    "Comma separated loop-detector engines of the localization benchmark, see "
+    "--lc_detector_engine.");
+DEFINE_string(
+    lc_benchmark_projection_files, "",
+    "Comma separated projection_matrix_file[:projected_quantizer_file] pairs "
+    "of the localization benchmark, e.g. to compare projection dimensions. "
+    "Empty uses the default files.");
+DEFINE_string(
+    lc_benchmark_num_threads, "1,4",
+    "Comma separated numbers of query threads of the localization benchmark.");
+DEFINE_string(
+    lc_benchmark_out, "",
+    "File the JSON results of the localization benchmark are written to. "
+    "Printed to stdout if empty.");
+
+DECLARE_string(lc_detector_engine);
+DECLARE_string(lc_projection_matrix_filename);
+DECLARE_string(lc_projected_quantizer_filename);
+
+namespace localization_evaluator {
+namespace {
+
+std::vector<std::string> tokenizeList(const std::string& list) {
+  std::vector<std::string> tokens;
+  constexpr bool kRemoveEmpty = true;
+  common::tokenizeString(list, ',', kRemoveEmpty, &tokens);
+  return tokens;
+}
+
+int64_t getResidentSetSizeKb() {
+  std::ifstream statm("/proc/self/statm");
+  size_t num_pages_total = 0u;
+  size_t num_pages_resident = 0u;
+  if (!(statm >> num_pages_total >> num_pages_resident)) {
+    LOG(WARNING) << "Could not read the resident set size.";
+    return 0;
+  }
+  return static_cast<int64_t>(num_pages_resident) * sysconf(_SC_PAGESIZE) /
+         1024;
+}
+
+int64_t getPeakResidentSetSizeKb() {
+  rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  // Kilobytes on Linux.
+  return static_cast<int64_t>(usage.ru_maxrss);
+}
+
+// Nearest-rank percentile of sorted values.
+double getPercentile(
+    const std::vector<double>& sorted_values, const double percentile) {
+  CHECK(!sorted_values.empty());
+  CHECK_GE(percentile, 0.0);
+  CHECK_LE(percentile, 100.0);
+  const size_t rank = static_cast<size_t>(
+      std::ceil(percentile / 100.0 * sorted_values.size()));
+  return sorted_values[std::max<size_t>(rank, 1u) - 1u];
+}
+
+// The loop detector reads its settings from the flags on construction.
+class ScopedDetectorFlags {
+ public:
+  explicit ScopedDetectorFlags(const LocalizationBenchmarkConfig& config)
+      : detector_engine_(FLAGS_lc_detector_engine),
+        projection_matrix_filename_(FLAGS_lc_projection_matrix_filename),
+        projected_quantizer_filename_(FLAGS_lc_projected_quantizer_filename) {
+    FLAGS_lc_detector_engine = config.detector_engine;
+    FLAGS_lc_projection_matrix_filename = config.projection_matrix_filename;
+    FLAGS_lc_projected_quantizer_filename = config.projected_quantizer_filename;
+  }
+  ~ScopedDetectorFlags() {
+    FLAGS_lc_detector_engine = detector_engine_;
+    FLAGS_lc_projection_matrix_filename = projection_matrix_filename_;
+    FLAGS_lc_projected_quantizer_filename = projected_quantizer_filename_;
+  }
+
+ private:
+  const std::string detector_engine_;
+  const std::string projection_matrix_filename_;
+  const std::string projected_quantizer_filename_;
+};
+
+}  // namespace
+
+std::string LocalizationBenchmarkConfig::getName() const {
+  std::ostringstream name;
+  name << "localization/engine:" << detector_engine;
+  if (!projection_matrix_filename.empty()) {
+    name << "/projection:" << projection_matrix_filename;
+  }
+  if (!projected_quantizer_filename.empty()) {
+    name << "/quantizer:" << projected_quantizer_filename;
+  }
+  name << "/threads:" << num_threads;
+  return name.str();
+}
+
+void getLocalizationBenchmarkConfigsFromFlags(
+    std::vector<LocalizationBenchmarkConfig>* configs) {
+  CHECK_NOTNULL(configs)->clear();
+
+  const std::vector<std::string> engines =
+      tokenizeList(FLAGS_lc_benchmark_detector_engines);
+  CHECK(!engines.empty()) << "No detector engines to benchmark.";
+
+  std::vector<std::pair<std::string, std::string>> projection_files;
+  for (const std::string& token :
+       tokenizeList(FLAGS_lc_benchmark_projection_files)) {
+    const size_t separator = token.find(':');
+    if (separator == std::string::npos) {
+      projection_files.emplace_back(token, "");
+    } else {
+      projection_files.emplace_back(
+          token.substr(0u, separator), token.substr(separator + 1u));
+    }
+  }
+  if (projection_files.empty()) {
+    projection_files.emplace_back("", "");
+  }
+
+  std::vector<size_t> thread_counts;
+  for (const std::string& token :
+       tokenizeList(FLAGS_lc_benchmark_num_threads)) {
+    const int num_threads = std::stoi(token);
+    CHECK_GT(num_threads, 0);
+    thread_counts.push_back(static_cast<size_t>(num_threads));
+  }
+  CHECK(!thread_counts.empty()) << "No thread counts to benchmark.";
+
+  for (const std::string& engine : engines) {
+    for (const std::pair<std::string, std::string>& files : projection_files) {
+      for (const size_t num_threads : thread_counts) {
+        configs->push_back(LocalizationBenchmarkConfig{
+            engine, files.first, files.second, num_threads});
+      }
+    }
+  }
+}
+
+void runLocalizationBenchmark(
+    const LocalizationBenchmarkConfig& config,
+    const vi_map::MissionId& query_mission_id, vi_map::VIMap* map,
+    LocalizationBenchmarkResult* result) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(result);
+  CHECK(map->hasMission(query_mission_id));
+  CHECK_GT(config.num_threads, 0u);
+  result->config = config;
+
+  // Collect all database landmarks.
+  vi_map::MissionIdList mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  vi_map::LandmarkIdSet database_landmarks;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    if (mission_id != query_mission_id) {
+      vi_map::LandmarkIdList mission_landmarks;
+      map->getAllLandmarkIdsInMission(mission_id, &mission_landmarks);
+      database_landmarks.insert(
+          mission_landmarks.begin(), mission_landmarks.end());
+    }
+  }
+  CHECK(!database_landmarks.empty())
+      << "The map needs at least one database mission with landmarks.";
+  result->num_database_landmarks = database_landmarks.size();
+
+  LOG(INFO) << "Benchmarking " << config.getName() << " with "
+            << database_landmarks.size() << " database landmarks.";
+
+  MissionEvaluationStats statistics;
+  {
+    const ScopedDetectorFlags detector_flags(config);
+    const int64_t rss_before_kb = getResidentSetSizeKb();
+    const std::chrono::steady_clock::time_point build_start =
+        std::chrono::steady_clock::now();
+    LocalizationEvaluator evaluator(database_landmarks, map);
+    result->database_build_time_seconds =
+        std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - build_start)
+            .count();
+    result->database_memory_kb = getResidentSetSizeKb() - rss_before_kb;
+
+    const std::chrono::steady_clock::time_point evaluation_start =
+        std::chrono::steady_clock::now();
+    evaluator.evaluateMission(
+        query_mission_id, config.num_threads, &statistics);
+    result->evaluation_time_seconds =
+        std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - evaluation_start)
+            .count();
+  }
+  result->peak_memory_kb = getPeakResidentSetSizeKb();
+
+  result->num_queries = statistics.num_vertices;
+  result->num_successful_localizations = statistics.successful_localizations;
+  result->recall = 0.0;
+  result->throughput_queries_per_second = 0.0;
+  result->latency_mean_ms = 0.0;
+  result->latency_p50_ms = 0.0;
+  result->latency_p90_ms = 0.0;
+  result->latency_p99_ms = 0.0;
+  result->latency_max_ms = 0.0;
+  if (result->num_queries == 0u) {
+    LOG(WARNING) << "No vertices in query mission " << query_mission_id << '.';
+    return;
+  }
+  result->recall = static_cast<double>(result->num_successful_localizations) /
+                   result->num_queries;
+  if (result->evaluation_time_seconds > 0.0) {
+    result->throughput_queries_per_second =
+        result->num_queries / result->evaluation_time_seconds;
+  }
+
+  std::vector<double> latencies_ms;
+  latencies_ms.reserve(statistics.query_latencies_seconds.size());
+  double latency_sum_ms = 0.0;
+  for (const double latency_seconds : statistics.query_latencies_seconds) {
+    latencies_ms.push_back(1e3 * latency_seconds);
+    latency_sum_ms += latencies_ms.back();
+  }
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  result->latency_mean_ms = latency_sum_ms / latencies_ms.size();
+  result->latency_p50_ms = getPercentile(latencies_ms, 50.0);
+  result->latency_p90_ms = getPercentile(latencies_ms, 90.0);
+  result->latency_p99_ms = getPercentile(latencies_ms, 99.0);
+  result->latency_max_ms = latencies_ms.back();
+
+  LOG(INFO) << config.getName() << ": recall " << result->recall << ", "
+            << result->throughput_queries_per_second << " queries/s, p50 "
+            << result->latency_p50_ms << " ms, p99 " << result->latency_p99_ms
+            << " ms, database +" << result->database_memory_kb << " kB.";
+}
+
+void runLocalizationBenchmarks(
+    const std::vector<LocalizationBenchmarkConfig>& configs,
+    const vi_map::MissionId& query_mission_id, vi_map::VIMap* map,
+    std::vector<LocalizationBenchmarkResult>* results) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(results)->clear();
+  results->resize(configs.size());
+  // The configurations run one after the other, so they don't compete for the
+  // cores and the memory measurements don't overlap.
+  for (size_t config_idx = 0u; config_idx < configs.size(); ++config_idx) {
+    runLocalizationBenchmark(
+        configs[config_idx], query_mission_id, map, &(*results)[config_idx]);
+  }
+}
+
+void writeLocalizationBenchmarkResultsAsJson(
+    const std::vector<LocalizationBenchmarkResult>& results,
+    std::ostream* out) {
+  CHECK_NOTNULL(out);
+  const std::time_t now = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%F %T", std::localtime(&now));
+
+  *out << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << date << "\",\n"
+       << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "\n"
+       << "  },\n  \"benchmarks\": [";
+  for (size_t i = 0u; i < results.size(); ++i) {
+    const LocalizationBenchmarkResult& result = results[i];
+    const LocalizationBenchmarkConfig& config = result.config;
+    *out << (i == 0u ? "\n" : ",\n") << "    {\n"
+         << "      \"name\": \"" << config.getName() << "\",\n"
+         << "      \"detector_engine\": \"" << config.detector_engine
+         << "\",\n"
+         << "      \"projection_matrix_file\": \""
+         << config.projection_matrix_filename << "\",\n"
+         << "      \"projected_quantizer_file\": \""
+         << config.projected_quantizer_filename << "\",\n"
+         << "      \"num_threads\": " << config.num_threads << ",\n"
+         << "      \"num_database_landmarks\": "
+         << result.num_database_landmarks << ",\n"
+         << "      \"database_build_time_s\": "
+         << result.database_build_time_seconds << ",\n"
+         << "      \"database_memory_kb\": " << result.database_memory_kb
+         << ",\n"
+         << "      \"peak_memory_kb\": " << result.peak_memory_kb << ",\n"
+         << "      \"num_queries\": " << result.num_queries << ",\n"
+         << "      \"num_successful_localizations\": "
+         << result.num_successful_localizations << ",\n"
+         << "      \"recall\": " << result.recall << ",\n"
+         << "      \"evaluation_time_s\": " << result.evaluation_time_seconds
+         << ",\n"
+         << "      \"throughput_qps\": "
+         << result.throughput_queries_per_second << ",\n"
+         << "      \"latency_mean_ms\": " << result.latency_mean_ms << ",\n"
+         << "      \"latency_p50_ms\": " << result.latency_p50_ms << ",\n"
+         << "      \"latency_p90_ms\": " << result.latency_p90_ms << ",\n"
+         << "      \"latency_p99_ms\": " << result.latency_p99_ms << ",\n"
+         << "      \"latency_max_ms\": " << result.latency_max_ms << "\n"
+         << "    }";
+  }
+  *out << "\n  ]\n}\n";
+}
+
+bool writeLocalizationBenchmarkResultsAsJson(
+    const std::vector<LocalizationBenchmarkResult>& results) {
+  if (FLAGS_lc_benchmark_out.empty()) {
+    writeLocalizationBenchmarkResultsAsJson(results, &std::cout);
+    return true;
+  }
+  std::ofstream out(FLAGS_lc_benchmark_out);
+  if (!out.is_open()) {
+    LOG(ERROR) << "Could not open " << FLAGS_lc_benchmark_out << '.';
+    return false;
+  }
+  writeLocalizationBenchmarkResultsAsJson(results, &out);
+  LOG(INFO) << "Wrote the localization benchmark results to "
+            << FLAGS_lc_benchmark_out << '.';
+  return out.good();
+}
+
+}  // namespace localization_evaluator
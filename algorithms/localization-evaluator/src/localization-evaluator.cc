@@ -1,9 +1,12 @@
 #include "localization-evaluator/localization-evaluator.h"
 
+#include <chrono>
+
 #include <Eigen/Core>
 #include <aslam/common/statistics/statistics.h>
 #include <loop-closure-handler/loop-closure-handler.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 DEFINE_double(
     benchmark_position_error_threshold, 0.05,
@@ -73,7 +76,14 @@ bool LocalizationEvaluator::evaluateSingleKeyframe(
 
 void LocalizationEvaluator::evaluateMission(
     const vi_map::MissionId& mission_id, MissionEvaluationStats* statistics) {
+  evaluateMission(mission_id, common::getNumHardwareThreads(), statistics);
+}
+
+void LocalizationEvaluator::evaluateMission(
+    const vi_map::MissionId& mission_id, const size_t num_threads,
+    MissionEvaluationStats* statistics) {
   CHECK_NOTNULL(statistics);
+  CHECK_GT(num_threads, 0u);
 
   pose_graph::VertexIdList vertices;
   map_->getAllVertexIdsInMission(mission_id, &vertices);
@@ -90,10 +100,11 @@ void LocalizationEvaluator::evaluateMission(
   localization_p_G_I.resize(vertices.size(), Eigen::Vector3d::Zero());
   std::vector<double> errors_meters(
       vertices.size(), std::numeric_limits<double>::infinity());
+  std::vector<double> latencies_seconds(vertices.size(), 0.0);
 
   std::function<void(const std::vector<size_t>&)> pose_query =
       [this, &vertices, &is_correct, &inlier_counts, &lc_matches_counts,
-       &localization_p_G_I, &errors_meters,
+       &localization_p_G_I, &errors_meters, &latencies_seconds,
        &ransac_ok](const std::vector<size_t>& batch) {
         for (size_t item : batch) {
           const pose_graph::VertexId& vertex_id = vertices[item];
@@ -102,9 +113,16 @@ void LocalizationEvaluator::evaluateMission(
           unsigned int& inliers_count = inlier_counts[item];
           double& error_meters = errors_meters[item];
           bool ransac_ok_item;
-          if (evaluateSingleKeyframe(
-                  vertex_id, &pnp_p_G_I, &lc_matches_count, &inliers_count,
-                  &error_meters, &ransac_ok_item)) {
+          const std::chrono::steady_clock::time_point query_start =
+              std::chrono::steady_clock::now();
+          const bool is_correct_item = evaluateSingleKeyframe(
+              vertex_id, &pnp_p_G_I, &lc_matches_count, &inliers_count,
+              &error_meters, &ransac_ok_item);
+          latencies_seconds[item] = std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() -
+                                        query_start)
+                                        .count();
+          if (is_correct_item) {
             CHECK_GE(lc_matches_count, inliers_count);
             is_correct[item] = true;
           }
@@ -113,7 +131,6 @@ void LocalizationEvaluator::evaluateMission(
       };
 
   constexpr bool kAlwaysParallelize = true;
-  const size_t num_threads = common::getNumHardwareThreads();
   common::ParallelProcess(
       is_correct.size(), pose_query, kAlwaysParallelize, num_threads);
 
@@ -135,6 +152,7 @@ void LocalizationEvaluator::evaluateMission(
     statistics->inliers_counts.emplace_back(inlier_counts[i]);
     statistics->lc_matches_counts.emplace_back(lc_matches_counts[i]);
     statistics->localization_errors_meters.emplace_back(errors_meters[i]);
+    statistics->query_latencies_seconds.emplace_back(latencies_seconds[i]);
     ++statistics->num_vertices;
   }
 
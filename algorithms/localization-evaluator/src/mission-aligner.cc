@@ -1,5 +1,6 @@
 #include "localization-evaluator/mission-aligner.h"
 
+#include <loop-closure-handler/loop-detector-cache.h>
 #include <loop-closure-handler/loop-detector-node.h>
 #include <map-anchoring/map-anchoring.h>
 #include <map-optimization-legacy/graph-ba-optimizer.h>
@@ -18,20 +19,11 @@ void alignAndCooptimizeMissionsWithoutLandmarkMerge(
   CHECK(!map_missions_ids.empty());
   CHECK_NOTNULL(map);
 
-  loop_detector_node::LoopDetectorNode loop_detector;
-
-  // Add map mission to the DB.
-  for (const vi_map::MissionId& mission_id : map_missions_ids) {
-    pose_graph::VertexId current_vertex_id =
-        map->getMission(mission_id).getRootVertexId();
-
-    VLOG(1) << "Adding map mission to the Loop Closure DB: " << mission_id;
-    do {
-      loop_detector.addVertexToDatabase(current_vertex_id, *map);
-    } while (map->getNextVertex(
-        current_vertex_id, map->getGraphTraversalEdgeType(mission_id),
-        &current_vertex_id));
-  }
+  // The database of the map missions is shared with other commands on the
+  // same missions, e.g. anchoring.
+  const loop_detector_node::LoopDetectorNode::ConstPtr loop_detector =
+      loop_detector_node::LoopDetectorCache::getInstance().getDatabase(
+          map_missions_ids, *map);
 
   // To revert the landmark merge.
   vi_map::VertexKeyPointToStructureMatchList landmark_merge_revert_vector;
@@ -56,7 +48,7 @@ void alignAndCooptimizeMissionsWithoutLandmarkMerge(
     const bool kAddLoopclosureEdges = false;
     unsigned int num_of_lc_matches = 0;
     vi_map::Vertex& vertex = map->getVertex(current_query_vertex);
-    if (loop_detector.findVertexInDatabase(
+    if (loop_detector->findVertexInDatabase(
             vertex, kMergeLandmarks, kAddLoopclosureEdges, map, &T_G_I,
             &num_of_lc_matches, &inlier_constraint)) {
       VLOG(3) << "RANSAC successful.";
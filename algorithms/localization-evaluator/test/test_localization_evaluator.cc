@@ -1,3 +1,7 @@
+#include <sstream>  // NOLINT
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <maplab-common/test/testing-entrypoint.h>
@@ -6,10 +10,13 @@
 #include <vi-map/vi-map.h>
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 
+#include "localization-evaluator/localization-benchmark.h"
 #include "localization-evaluator/localization-evaluator.h"
 #include "localization-evaluator/mission-aligner.h"
 
 DECLARE_bool(lc_use_random_pnp_seed);
+DECLARE_string(lc_benchmark_detector_engines);
+DECLARE_string(lc_benchmark_num_threads);
 
 namespace localization_evaluator {
 
@@ -147,6 +154,10 @@ class ViMappingTest : public ::testing::Test {
     EXPECT_GT(avg_inlier_ratio, 0.75);
   }
 
+  vi_map::VIMap* getMap() {
+    return test_app_.getMapMutable();
+  }
+
  private:
   visual_inertial_mapping::VIMappingTestApp test_app_;
 };
@@ -166,6 +177,37 @@ TEST_F(ViMappingTest, LocalizationEvaluatorWorks) {
   evaluateLocalization(query_mission_id);
 }
 
+TEST_F(ViMappingTest, LocalizationBenchmarkWorks) {
+  createMap();
+  const vi_map::MissionId query_mission_id = alignMissionsForEvaluation();
+
+  FLAGS_lc_benchmark_detector_engines = "inverted_multi_index";
+  FLAGS_lc_benchmark_num_threads = "1,2";
+  std::vector<LocalizationBenchmarkConfig> configs;
+  getLocalizationBenchmarkConfigsFromFlags(&configs);
+  ASSERT_EQ(configs.size(), 2u);
+  EXPECT_EQ(configs[0].num_threads, 1u);
+  EXPECT_EQ(configs[1].num_threads, 2u);
+
+  std::vector<LocalizationBenchmarkResult> results;
+  runLocalizationBenchmarks(configs, query_mission_id, getMap(), &results);
+  ASSERT_EQ(results.size(), configs.size());
+  for (const LocalizationBenchmarkResult& result : results) {
+    EXPECT_GT(result.num_queries, 0u);
+    EXPECT_GT(result.recall, 0.95);
+    EXPECT_GT(result.throughput_queries_per_second, 0.0);
+    EXPECT_LE(result.latency_p50_ms, result.latency_p90_ms);
+    EXPECT_LE(result.latency_p90_ms, result.latency_p99_ms);
+    EXPECT_LE(result.latency_p99_ms, result.latency_max_ms);
+  }
+
+  std::ostringstream json;
+  writeLocalizationBenchmarkResultsAsJson(results, &json);
+  EXPECT_NE(
+      json.str().find("\"detector_engine\": \"inverted_multi_index\""),
+      std::string::npos);
+}
+
 }  // namespace localization_evaluator
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -12,6 +12,17 @@
 #include <glog/logging.h>
 
 namespace descriptor_projection {
+// Resolves --lc_projection_training_num_threads.
+size_t GetNumTrainingThreads();
+
+// Adds the outer products of the given columns of data to the symmetric
+// matrix sum, i.e. sum += data_I * data_I^T. The columns are gathered in
+// blocks that are accumulated with a rank update into per-thread partial sums,
+// which are added up in a fixed order.
+void AccumulateOuterProducts(
+    const Eigen::MatrixXf& data, const std::vector<size_t>& column_indices,
+    const size_t num_threads, Eigen::MatrixXf* sum);
+
 void ComputeCovariance(
     const Eigen::MatrixXf& data, Eigen::MatrixXf* covariance);
 
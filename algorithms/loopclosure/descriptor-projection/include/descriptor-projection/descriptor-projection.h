@@ -273,6 +273,22 @@ void ProjectDescriptor(
       descriptor, projection_matrix, target_dimensions, projected_descriptor);
 }
 
+// Expands the bits of the descriptor to 0/1 floats with bit i of byte j at
+// element 8 * j + i, i.e. the layout of DescriptorToEigenMatrix. Uses SSE2 if
+// available and does not require the descriptor to be aligned.
+void UnpackDescriptorBits(
+    const unsigned char* raw_descriptor, int num_descriptor_bytes,
+    float* unpacked_descriptor);
+
+// Projects all descriptors with a single matrix product after unpacking them
+// into the columns of unpacked_descriptors. The unpacking buffer is only
+// reallocated if it is too small, so it can be reused across calls.
+void ProjectDescriptorBlock(
+    const unsigned char* raw_descriptors, int num_descriptor_bytes,
+    int num_descriptors, const Eigen::MatrixXf& projection_matrix,
+    int target_dimensions, Eigen::MatrixXf* unpacked_descriptors,
+    Eigen::MatrixXf* projected_descriptors);
+
 void ProjectDescriptorBlock(
     const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>&
         raw_descriptors,
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include <descriptor-projection/descriptor-projection.h>
+#include <maplab-common/threading-helpers.h>
 #include <vocabulary-tree/mutable-tree.h>
 #include <vocabulary-tree/types.h>
 
@@ -32,6 +33,21 @@ struct ProjectedDescriptorQuantizer {
     return vocabulary_.Quantize(projected_descriptor);
   }
 
+  // Quantizes every column of projected_descriptors on all hardware threads.
+  inline void Quantize(
+      const Eigen::MatrixXf& projected_descriptors,
+      std::vector<loop_closure::Word>* words) const {
+    CHECK_NOTNULL(words);
+    CHECK(initialized_);
+    CHECK_EQ(projected_descriptors.rows(), target_dimensionality_);
+    descriptor_projection::DescriptorVector features(
+        projected_descriptors.cols());
+    for (int i = 0; i < projected_descriptors.cols(); ++i) {
+      features[i] = projected_descriptors.col(i);
+    }
+    vocabulary_.Quantize(features, common::getNumHardwareThreads(), words);
+  }
+
   inline void GetNearestNeighbors(
       const aslam::common::FeatureDescriptorConstRef& descriptor,
       int num_neighbors, std::vector<loop_closure::Word>* nearest_neighbors,
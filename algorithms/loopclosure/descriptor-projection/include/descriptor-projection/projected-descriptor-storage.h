@@ -0,0 +1,50 @@
+#ifndef DESCRIPTOR_PROJECTION_PROJECTED_DESCRIPTOR_STORAGE_H_
+#define DESCRIPTOR_PROJECTION_PROJECTED_DESCRIPTOR_STORAGE_H_
+
+#include <cstdint>
+
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace descriptor_projection {
+
+// FNV-1a hash of the part of the projection matrix that projects descriptors
+// to target_dimensionality dimensions.
+uint64_t ComputeProjectionFingerprint(
+    const Eigen::MatrixXf& projection_matrix, int target_dimensionality);
+
+// The projected descriptors of all keypoints of a visual frame are stored as
+// frame resource of the map, such that loop-closure and summary map creation
+// don't have to project them again. The resource is a single row 8-bit
+// matrix with a small header that holds the projection fingerprint.
+void SerializeProjectedDescriptors(
+    const Eigen::MatrixXf& projected_descriptors,
+    const uint64_t projection_fingerprint, cv::Mat* resource);
+// Returns false if the resource is invalid or was stored with a different
+// projection.
+bool DeserializeProjectedDescriptors(
+    const cv::Mat& resource, const uint64_t projection_fingerprint,
+    Eigen::MatrixXf* projected_descriptors);
+
+// Stores the projected descriptors of the frame and replaces the ones that
+// were stored before, regardless of their projection.
+void StoreProjectedDescriptors(
+    const vi_map::VisualFrameIdentifier& frame_id,
+    const Eigen::MatrixXf& projected_descriptors,
+    const uint64_t projection_fingerprint, vi_map::VIMap* map);
+
+// Returns false if no descriptors of this projection are stored for the
+// frame, or if their number doesn't match the descriptors of the frame.
+bool GetStoredProjectedDescriptors(
+    const vi_map::VIMap& map, const vi_map::VisualFrameIdentifier& frame_id,
+    const uint64_t projection_fingerprint,
+    Eigen::MatrixXf* projected_descriptors);
+
+}  // namespace descriptor_projection
+
+#endif  // DESCRIPTOR_PROJECTION_PROJECTED_DESCRIPTOR_STORAGE_H_
@@ -1,15 +1,82 @@
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <unordered_map>
+#include <vector>
 
 #include <Eigen/QR>
 #include <descriptor-projection/build-projection-matrix.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 #include <vi-map/vertex.h>
 
 namespace descriptor_projection {
 
+namespace {
+// Adds up the lower triangles of the partial sums in order and returns the
+// full symmetric matrix.
+Eigen::MatrixXf MergeLowerPartialSums(
+    const int dimension, const std::vector<Eigen::MatrixXf>& partial_sums) {
+  Eigen::MatrixXf sum = Eigen::MatrixXf::Zero(dimension, dimension);
+  for (const Eigen::MatrixXf& partial_sum : partial_sums) {
+    sum.triangularView<Eigen::Lower>() += partial_sum;
+  }
+  sum.triangularView<Eigen::StrictlyUpper>() = sum.transpose();
+  return sum;
+}
+}  // namespace
+
+size_t GetNumTrainingThreads() {
+  return FLAGS_lc_projection_training_num_threads > 0u
+             ? FLAGS_lc_projection_training_num_threads
+             : common::getNumHardwareThreads();
+}
+
+void AccumulateOuterProducts(
+    const Eigen::MatrixXf& data, const std::vector<size_t>& column_indices,
+    const size_t num_threads, Eigen::MatrixXf* sum) {
+  CHECK_NOTNULL(sum);
+  CHECK_GT(num_threads, 0u);
+  const int num_rows = data.rows();
+  CHECK_EQ(sum->rows(), num_rows);
+  CHECK_EQ(sum->cols(), num_rows);
+  if (column_indices.empty()) {
+    return;
+  }
+
+  constexpr size_t kBlockSize = 1024u;
+  const size_t num_blocks =
+      (column_indices.size() + kBlockSize - 1u) / kBlockSize;
+  const size_t num_partial_sums = std::min(num_threads, num_blocks);
+  std::vector<Eigen::MatrixXf> partial_sums(num_partial_sums);
+  common::ParallelProcess(
+      num_partial_sums,
+      [&](const std::vector<size_t>& partial_sum_indices) {
+        Eigen::MatrixXf block(num_rows, kBlockSize);
+        for (const size_t partial_sum_idx : partial_sum_indices) {
+          Eigen::MatrixXf& partial_sum = partial_sums[partial_sum_idx];
+          partial_sum.setZero(num_rows, num_rows);
+          for (size_t block_idx = partial_sum_idx; block_idx < num_blocks;
+               block_idx += num_partial_sums) {
+            const size_t block_start = block_idx * kBlockSize;
+            const size_t block_size =
+                std::min(block_start + kBlockSize, column_indices.size()) -
+                block_start;
+            for (size_t i = 0u; i < block_size; ++i) {
+              block.col(i) = data.col(column_indices[block_start + i]);
+            }
+            partial_sum.selfadjointView<Eigen::Lower>().rankUpdate(
+                block.leftCols(block_size));
+          }
+        }
+      },
+      /*always_parallelize=*/true, num_partial_sums);
+  *sum += MergeLowerPartialSums(num_rows, partial_sums);
+}
+
 // Compute the covariance of the descriptors, rows are states, columns are
 // samples.
 void ComputeCovariance(
@@ -18,21 +85,39 @@ void ComputeCovariance(
   CHECK_GT(data.cols(), 0) << "Data must not be empty!";
   VLOG(4) << "Got " << data.cols()
           << " samples to compute the covariance from.";
-  covariance->setZero(data.rows(), data.rows());
   constexpr int kBlockSize = 10000;
   const int num_blocks = data.cols() / kBlockSize + 1;
-  for (int i = 0; i < num_blocks; ++i) {
-    const int block_start = i * kBlockSize;
-    const int block_size =
-        std::min<int>((i + 1) * kBlockSize, data.cols()) - block_start;
-    const Eigen::Block<const Eigen::MatrixXf>& data_block =
-        data.block(0, block_start, data.rows(), block_size);
-
-    const Eigen::MatrixXf centered =
-        data_block.colwise() - data_block.rowwise().mean();
-    double normalizer = std::max(static_cast<int>(data_block.cols() - 1), 1);
-    covariance->noalias() += (centered * centered.adjoint()) / normalizer;
-  }
+  const size_t num_partial_sums =
+      std::min<size_t>(GetNumTrainingThreads(), num_blocks);
+  std::vector<Eigen::MatrixXf> partial_sums(num_partial_sums);
+  common::ParallelProcess(
+      num_partial_sums,
+      [&](const std::vector<size_t>& partial_sum_indices) {
+        for (const size_t partial_sum_idx : partial_sum_indices) {
+          Eigen::MatrixXf& partial_sum = partial_sums[partial_sum_idx];
+          partial_sum.setZero(data.rows(), data.rows());
+          for (int i = partial_sum_idx; i < num_blocks;
+               i += num_partial_sums) {
+            const int block_start = i * kBlockSize;
+            const int block_size =
+                std::min<int>((i + 1) * kBlockSize, data.cols()) -
+                block_start;
+            if (block_size == 0) {
+              continue;
+            }
+            const Eigen::Block<const Eigen::MatrixXf>& data_block =
+                data.block(0, block_start, data.rows(), block_size);
+
+            const Eigen::MatrixXf centered =
+                data_block.colwise() - data_block.rowwise().mean();
+            const float normalizer = std::max(block_size - 1, 1);
+            partial_sum.selfadjointView<Eigen::Lower>().rankUpdate(
+                centered, 1.0f / normalizer);
+          }
+        }
+      },
+      /*always_parallelize=*/true, num_partial_sums);
+  *covariance = MergeLowerPartialSums(data.rows(), partial_sums);
   (*covariance) /= num_blocks;
 }
 
@@ -82,14 +167,17 @@ void BuildCovarianceMatricesOfMatchesAndNonMatches(
     unsigned int long_enough_tracks = 0;
     constexpr size_t kMinTrackLength = 5;
     size_t number_of_used_tracks = 0;
-    Eigen::MatrixXf sumMuMu;
-    sumMuMu.setZero(descriptor_size, descriptor_size);
+    const size_t num_threads = GetNumTrainingThreads();
 
     std::vector<size_t> descriptors_from_tracks;
     descriptors_from_tracks.reserve(500);
 
-    // Centering.
+    // Centering. The track means are weighted by the square root of the track
+    // length, such that their outer products sum up to sumMuMu.
     constexpr int kMaxNumSamples = 50000;
+    Eigen::MatrixXf weighted_means(
+        descriptor_size,
+        std::min<size_t>(tracks.size(), static_cast<size_t>(kMaxNumSamples)));
     for (const Track& track : tracks) {
       if (track.size() < kMinTrackLength) {
         ++too_short_tracks;
@@ -114,9 +202,8 @@ void BuildCovarianceMatricesOfMatchesAndNonMatches(
       CHECK_LE(mean.maxCoeff(), 1.0);
       CHECK_GE(mean.minCoeff(), 0.0);
 
-      Eigen::MatrixXf mu_sq_current = (mean * mean.transpose()).eval();
-
-      sumMuMu += mu_sq_current * track.size();
+      weighted_means.col(number_of_used_tracks) =
+          mean * std::sqrt(static_cast<float>(track.size()));
       ++number_of_used_tracks;
     }
 
@@ -132,22 +219,23 @@ void BuildCovarianceMatricesOfMatchesAndNonMatches(
 
     *sample_size_matches = descriptors_from_tracks.size();
 
-    Eigen::MatrixXf matches;
-    matches.resize(descriptor_size, descriptors_from_tracks.size());
-    matches.setZero();
-
-    int matched_idx = 0;
-    for (const size_t& descriptor_idx : descriptors_from_tracks) {
-      matches.block(0, matched_idx, descriptor_size, 1) =
-          all_descriptors.block(0, descriptor_idx, descriptor_size, 1);
-      ++matched_idx;
-    }
-
     CHECK_GT(descriptors_from_tracks.size(), number_of_used_tracks);
 
-    // Covariance computation for matches.
+    std::vector<size_t> used_track_indices(number_of_used_tracks);
+    std::iota(used_track_indices.begin(), used_track_indices.end(), 0u);
+    Eigen::MatrixXf sumMuMu;
+    sumMuMu.setZero(descriptor_size, descriptor_size);
+    AccumulateOuterProducts(
+        weighted_means, used_track_indices, num_threads, &sumMuMu);
+
+    // Covariance computation for matches, the descriptors are gathered block
+    // by block instead of copying all of them at once.
+    Eigen::MatrixXf sum_matches;
+    sum_matches.setZero(descriptor_size, descriptor_size);
+    AccumulateOuterProducts(
+        all_descriptors, descriptors_from_tracks, num_threads, &sum_matches);
     cov_matches->noalias() =
-        (matches * matches.transpose() - sumMuMu) * 2.0 /
+        (sum_matches - sumMuMu) * 2.0 /
         static_cast<float>(
             descriptors_from_tracks.size() - number_of_used_tracks);
   }  // Scope to limit memory usage.
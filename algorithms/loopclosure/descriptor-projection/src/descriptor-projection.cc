@@ -1,4 +1,9 @@
 #include <fstream>  // NOLINT
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
@@ -24,6 +29,92 @@ void ProjectDescriptor(
       descriptor, projection_matrix, target_dimensions, projected_descriptor);
 }
 
+namespace {
+// Makes sure the buffer has room for the unpacked descriptors without
+// shrinking it.
+void ReserveUnpackingBuffer(
+    int num_descriptor_bits, int num_descriptors,
+    Eigen::MatrixXf* unpacked_descriptors) {
+  CHECK_NOTNULL(unpacked_descriptors);
+  if (unpacked_descriptors->rows() != num_descriptor_bits ||
+      unpacked_descriptors->cols() < num_descriptors) {
+    unpacked_descriptors->resize(num_descriptor_bits, num_descriptors);
+  }
+}
+
+void MultiplyUnpackedDescriptors(
+    const Eigen::MatrixXf& unpacked_descriptors, int num_descriptors,
+    const Eigen::MatrixXf& projection_matrix, int target_dimensions,
+    Eigen::MatrixXf* projected_descriptors) {
+  CHECK_NOTNULL(projected_descriptors);
+  CHECK_LE(target_dimensions, projection_matrix.rows());
+  CHECK_LE(projection_matrix.cols(), unpacked_descriptors.rows());
+  projected_descriptors->resize(target_dimensions, num_descriptors);
+  projected_descriptors->noalias() =
+      projection_matrix.topRows(target_dimensions) *
+      unpacked_descriptors.topLeftCorner(
+          projection_matrix.cols(), num_descriptors);
+}
+}  // namespace
+
+void UnpackDescriptorBits(
+    const unsigned char* raw_descriptor, int num_descriptor_bytes,
+    float* unpacked_descriptor) {
+  CHECK_NOTNULL(raw_descriptor);
+  CHECK_NOTNULL(unpacked_descriptor);
+#ifdef __SSE2__
+  // Every byte is broadcast to 8 lanes, which are compared against the bit
+  // masks. The resulting all-ones lanes select the bit pattern of 1.f.
+  const __m128i kLowBitMasks = _mm_set_epi32(8, 4, 2, 1);
+  const __m128i kHighBitMasks = _mm_set_epi32(128, 64, 32, 16);
+  const __m128 kOnes = _mm_set1_ps(1.f);
+  for (int byte_idx = 0; byte_idx < num_descriptor_bytes; ++byte_idx) {
+    const __m128i value = _mm_set1_epi32(raw_descriptor[byte_idx]);
+    const __m128i low_bits = _mm_cmpeq_epi32(
+        _mm_and_si128(value, kLowBitMasks), kLowBitMasks);
+    const __m128i high_bits = _mm_cmpeq_epi32(
+        _mm_and_si128(value, kHighBitMasks), kHighBitMasks);
+    float* output = unpacked_descriptor + 8 * byte_idx;
+    _mm_storeu_ps(output, _mm_and_ps(_mm_castsi128_ps(low_bits), kOnes));
+    _mm_storeu_ps(output + 4, _mm_and_ps(_mm_castsi128_ps(high_bits), kOnes));
+  }
+#else
+  for (int byte_idx = 0; byte_idx < num_descriptor_bytes; ++byte_idx) {
+    const unsigned char value = raw_descriptor[byte_idx];
+    float* output = unpacked_descriptor + 8 * byte_idx;
+    for (int bit_idx = 0; bit_idx < 8; ++bit_idx) {
+      output[bit_idx] = static_cast<float>((value >> bit_idx) & 1u);
+    }
+  }
+#endif  // __SSE2__
+}
+
+void ProjectDescriptorBlock(
+    const unsigned char* raw_descriptors, int num_descriptor_bytes,
+    int num_descriptors, const Eigen::MatrixXf& projection_matrix,
+    int target_dimensions, Eigen::MatrixXf* unpacked_descriptors,
+    Eigen::MatrixXf* projected_descriptors) {
+  CHECK_NOTNULL(unpacked_descriptors);
+  CHECK_NOTNULL(projected_descriptors);
+  CHECK_GE(num_descriptors, 0);
+  if (num_descriptors == 0) {
+    projected_descriptors->resize(target_dimensions, 0);
+    return;
+  }
+  CHECK_NOTNULL(raw_descriptors);
+  const int num_descriptor_bits = num_descriptor_bytes * 8;
+  ReserveUnpackingBuffer(
+      num_descriptor_bits, num_descriptors, unpacked_descriptors);
+  for (int i = 0; i < num_descriptors; ++i) {
+    UnpackDescriptorBits(
+        raw_descriptors + i * num_descriptor_bytes, num_descriptor_bytes,
+        unpacked_descriptors->col(i).data());
+  }
+  MultiplyUnpackedDescriptors(
+      *unpacked_descriptors, num_descriptors, projection_matrix,
+      target_dimensions, projected_descriptors);
+}
+
 void ProjectDescriptorBlock(
     const std::vector<aslam::common::FeatureDescriptorConstRef>&
         raw_descriptors,
@@ -33,21 +124,21 @@ void ProjectDescriptorBlock(
     return;
   }
   CHECK_NOTNULL(projected_descriptors);
-  projected_descriptors->resize(target_dimensions, raw_descriptors.size());
-  Eigen::MatrixXf converted_descriptors;
   const int num_descriptor_bytes = raw_descriptors[0].size();
-  const int num_descriptor_bits = num_descriptor_bytes * 8;
-  converted_descriptors.resize(num_descriptor_bits, raw_descriptors.size());
-  for (size_t i = 0; i < raw_descriptors.size(); ++i) {
-    DescriptorToEigenMatrix(
-        raw_descriptors[i],
-        converted_descriptors.block(0, i, num_descriptor_bits, 1));
+  const int num_descriptors = raw_descriptors.size();
+  Eigen::MatrixXf unpacked_descriptors;
+  ReserveUnpackingBuffer(
+      num_descriptor_bytes * 8, num_descriptors, &unpacked_descriptors);
+  for (int i = 0; i < num_descriptors; ++i) {
+    CHECK_EQ(
+        static_cast<int>(raw_descriptors[i].size()), num_descriptor_bytes);
+    UnpackDescriptorBits(
+        raw_descriptors[i].data(), num_descriptor_bytes,
+        unpacked_descriptors.col(i).data());
   }
-  *projected_descriptors =
-      projection_matrix.block(
-          0, 0, target_dimensions, projection_matrix.cols()) *
-      converted_descriptors.block(
-          0, 0, projection_matrix.cols(), projected_descriptors->cols());
+  MultiplyUnpackedDescriptors(
+      unpacked_descriptors, num_descriptors, projection_matrix,
+      target_dimensions, projected_descriptors);
 }
 
 void ProjectDescriptorBlock(
@@ -59,17 +150,7 @@ void ProjectDescriptorBlock(
     return;
   }
   CHECK_NOTNULL(projected_descriptors);
-  projected_descriptors->resize(target_dimensions, raw_descriptors.cols());
-  Eigen::MatrixXf converted_descriptors;
-  const int num_descriptor_bytes = raw_descriptors.rows();
-  const int num_descriptor_bits = num_descriptor_bytes * 8;
-  converted_descriptors.resize(num_descriptor_bits, raw_descriptors.cols());
-  for (int i = 0; i < raw_descriptors.cols(); ++i) {
-    DescriptorToEigenMatrix(
-        raw_descriptors.block(0, i, raw_descriptors.rows(), 1),
-        converted_descriptors.block(0, i, num_descriptor_bits, 1));
-  }
-
+  const int num_descriptor_bits = raw_descriptors.rows() * 8;
   if (projection_matrix.cols() == 471) {
     CHECK_EQ(512, num_descriptor_bits)
         << "Projection matrix dimensions don't match the descriptor length. "
@@ -80,11 +161,11 @@ void ProjectDescriptorBlock(
         << "Double check your setting for feature_descriptor_type.";
   }
 
-  *projected_descriptors =
-      projection_matrix.block(
-          0, 0, target_dimensions, projection_matrix.cols()) *
-      converted_descriptors.block(
-          0, 0, projection_matrix.cols(), projected_descriptors->cols());
+  Eigen::MatrixXf unpacked_descriptors;
+  ProjectDescriptorBlock(
+      raw_descriptors.data(), raw_descriptors.rows(), raw_descriptors.cols(),
+      projection_matrix, target_dimensions, &unpacked_descriptors,
+      projected_descriptors);
 }
 
 bool LoadprojectionMatrix(Eigen::MatrixXf* projection_matrix) {
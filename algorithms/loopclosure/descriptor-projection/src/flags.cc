@@ -10,3 +10,14 @@ DEFINE_string(
 DEFINE_int32(
     lc_target_dimensionality, 10,
     "The target dimensionality of the projection.");
+DEFINE_bool(
+    lc_use_stored_projected_descriptors, true,
+    "Use the projected descriptors stored in the map instead of projecting "
+    "the descriptors of a frame again, if they were stored with the same "
+    "projection.");
+DEFINE_uint64(
+    lc_projection_training_num_threads, 0u,
+    "Number of threads that train the projection matrix, in parallel over the "
+    "missions and over the descriptors of every mission. Every mission that is "
+    "processed concurrently keeps its unpacked descriptors in memory. 0 uses "
+    "all hardware threads.");
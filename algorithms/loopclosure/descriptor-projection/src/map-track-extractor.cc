@@ -3,9 +3,11 @@
 
 #include <Eigen/Core>
 #include <aslam/common/feature-descriptor-ref.h>
+#include <descriptor-projection/build-projection-matrix.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/map-track-extractor.h>
 #include <loopclosure-common/types.h>
+#include <maplab-common/parallel-process.h>
 #include <vi-map/vi-map.h>
 #include <vocabulary-tree/distance.h>
 
@@ -25,10 +27,15 @@ void CollectAndConvertDescriptors(
 
   all_descriptors->resize(descriptor_size_bits, all_descriptors_char.cols());
 
-  for (int i = 0; i < all_descriptors_char.cols(); ++i) {
-    DescriptorToEigenMatrix(
-        all_descriptors_char.col(i), all_descriptors->col(i));
-  }
+  common::ParallelProcess(
+      all_descriptors_char.cols(),
+      [&](const std::vector<size_t>& descriptor_indices) {
+        for (const size_t i : descriptor_indices) {
+          DescriptorToEigenMatrix(
+              all_descriptors_char.col(i), all_descriptors->col(i));
+        }
+      },
+      /*always_parallelize=*/false, GetNumTrainingThreads());
 }
 void CollectAndConvertDescriptors(
     const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
@@ -0,0 +1,135 @@
+#include "descriptor-projection/projected-descriptor-storage.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+#include <map-resources/resource-common.h>
+#include <vi-map/vertex.h>
+#include <vi-map/vi-map.h>
+
+namespace descriptor_projection {
+namespace {
+constexpr uint32_t kProjectedDescriptorsMagic = 0x43534450u;  // "PDSC"
+
+struct ProjectedDescriptorsHeader {
+  uint32_t magic;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t padding;
+  uint64_t projection_fingerprint;
+};
+
+void addBytesToFingerprint(
+    const void* data, size_t num_bytes, uint64_t* fingerprint) {
+  CHECK_NOTNULL(fingerprint);
+  constexpr uint64_t kFnvPrime = 1099511628211ull;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0u; i < num_bytes; ++i) {
+    *fingerprint ^= bytes[i];
+    *fingerprint *= kFnvPrime;
+  }
+}
+}  // namespace
+
+uint64_t ComputeProjectionFingerprint(
+    const Eigen::MatrixXf& projection_matrix, int target_dimensionality) {
+  CHECK_GT(target_dimensionality, 0);
+  CHECK_LE(target_dimensionality, projection_matrix.rows());
+  uint64_t fingerprint = 14695981039346656037ull;
+  const int64_t size[2] = {target_dimensionality, projection_matrix.cols()};
+  addBytesToFingerprint(size, sizeof(size), &fingerprint);
+  for (int col = 0; col < projection_matrix.cols(); ++col) {
+    addBytesToFingerprint(
+        projection_matrix.col(col).data(),
+        target_dimensionality * sizeof(float), &fingerprint);
+  }
+  return fingerprint;
+}
+
+void SerializeProjectedDescriptors(
+    const Eigen::MatrixXf& projected_descriptors,
+    const uint64_t projection_fingerprint, cv::Mat* resource) {
+  CHECK_NOTNULL(resource);
+  ProjectedDescriptorsHeader header;
+  header.magic = kProjectedDescriptorsMagic;
+  header.rows = static_cast<uint32_t>(projected_descriptors.rows());
+  header.cols = static_cast<uint32_t>(projected_descriptors.cols());
+  header.padding = 0u;
+  header.projection_fingerprint = projection_fingerprint;
+
+  const size_t num_data_bytes = projected_descriptors.size() * sizeof(float);
+  resource->create(1, sizeof(header) + num_data_bytes, CV_8UC1);
+  std::memcpy(resource->data, &header, sizeof(header));
+  if (num_data_bytes > 0u) {
+    std::memcpy(
+        resource->data + sizeof(header), projected_descriptors.data(),
+        num_data_bytes);
+  }
+}
+
+bool DeserializeProjectedDescriptors(
+    const cv::Mat& resource, const uint64_t projection_fingerprint,
+    Eigen::MatrixXf* projected_descriptors) {
+  CHECK_NOTNULL(projected_descriptors);
+  if (resource.type() != CV_8UC1 || resource.rows != 1 ||
+      !resource.isContinuous() ||
+      resource.total() < sizeof(ProjectedDescriptorsHeader)) {
+    return false;
+  }
+  ProjectedDescriptorsHeader header;
+  std::memcpy(&header, resource.data, sizeof(header));
+  const size_t num_data_bytes =
+      static_cast<size_t>(header.rows) * header.cols * sizeof(float);
+  if (header.magic != kProjectedDescriptorsMagic ||
+      header.projection_fingerprint != projection_fingerprint ||
+      resource.total() != sizeof(header) + num_data_bytes) {
+    return false;
+  }
+  projected_descriptors->resize(header.rows, header.cols);
+  if (num_data_bytes > 0u) {
+    std::memcpy(
+        projected_descriptors->data(), resource.data + sizeof(header),
+        num_data_bytes);
+  }
+  return true;
+}
+
+void StoreProjectedDescriptors(
+    const vi_map::VisualFrameIdentifier& frame_id,
+    const Eigen::MatrixXf& projected_descriptors,
+    const uint64_t projection_fingerprint, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::Vertex* vertex = CHECK_NOTNULL(map->getVertexPtr(frame_id.vertex_id));
+  CHECK_EQ(
+      projected_descriptors.cols(),
+      vertex->getVisualFrame(frame_id.frame_index).getDescriptors().cols());
+  cv::Mat resource;
+  SerializeProjectedDescriptors(
+      projected_descriptors, projection_fingerprint, &resource);
+  if (map->hasProjectedDescriptors(*vertex, frame_id.frame_index)) {
+    map->replaceProjectedDescriptors(resource, frame_id.frame_index, vertex);
+  } else {
+    map->storeProjectedDescriptors(resource, frame_id.frame_index, vertex);
+  }
+}
+
+bool GetStoredProjectedDescriptors(
+    const vi_map::VIMap& map, const vi_map::VisualFrameIdentifier& frame_id,
+    const uint64_t projection_fingerprint,
+    Eigen::MatrixXf* projected_descriptors) {
+  CHECK_NOTNULL(projected_descriptors);
+  const vi_map::Vertex& vertex = map.getVertex(frame_id.vertex_id);
+  if (!map.hasProjectedDescriptors(vertex, frame_id.frame_index)) {
+    return false;
+  }
+  cv::Mat resource;
+  if (!map.getProjectedDescriptors(vertex, frame_id.frame_index, &resource) ||
+      !DeserializeProjectedDescriptors(
+          resource, projection_fingerprint, projected_descriptors)) {
+    return false;
+  }
+  return projected_descriptors->cols() ==
+         vertex.getVisualFrame(frame_id.frame_index).getDescriptors().cols();
+}
+
+}  // namespace descriptor_projection
@@ -1,5 +1,6 @@
 #include "descriptor-projection/train-projection-matrix.h"
 
+#include <algorithm>
 #include <iostream>  // NOLINT
 #include <string>
 #include <utility>
@@ -14,6 +15,7 @@
 #include <loopclosure-common/flags.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/binary-serialization.h>
+#include <maplab-common/parallel-process.h>
 #include <vi-map/vi-map.h>
 
 namespace descriptor_projection {
@@ -57,29 +59,41 @@ void TrainProjectionMatrix(const vi_map::VIMap& map) {
   vi_map::MissionIdList all_mission_ids;
   map.getAllMissionIds(&all_mission_ids);
 
-  std::vector<SubSetCovariance> covariances;
-  for (const vi_map::MissionId& mission_id : all_mission_ids) {
-    Eigen::MatrixXf all_descriptors;
-    SubSetCovariance subset_covariance;
-    std::vector<descriptor_projection::Track> tracks;
-
-    using descriptor_projection::CollectAndConvertDescriptors;
-    CollectAndConvertDescriptors(
-        map, mission_id, descriptor_size, raw_descriptor_matching_threshold,
-        &all_descriptors, &tracks);
-
-    descriptor_projection::BuildCovarianceMatricesOfMatchesAndNonMatches(
-        descriptor_size, all_descriptors, tracks,
-        &subset_covariance.sample_size_matches,
-        &subset_covariance.sample_size_non_matches,
-        &subset_covariance.cov_matches, &subset_covariance.cov_non_matches);
-
+  // The missions are processed concurrently, each of them holding its
+  // unpacked descriptors until its covariances are computed.
+  const size_t num_missions = all_mission_ids.size();
+  std::vector<SubSetCovariance> covariances(num_missions);
+  common::ParallelProcess(
+      num_missions,
+      [&](const std::vector<size_t>& mission_indices) {
+        for (const size_t mission_idx : mission_indices) {
+          Eigen::MatrixXf all_descriptors;
+          SubSetCovariance& subset_covariance = covariances[mission_idx];
+          std::vector<descriptor_projection::Track> tracks;
+
+          using descriptor_projection::CollectAndConvertDescriptors;
+          CollectAndConvertDescriptors(
+              map, all_mission_ids[mission_idx], descriptor_size,
+              raw_descriptor_matching_threshold, &all_descriptors, &tracks);
+
+          descriptor_projection::BuildCovarianceMatricesOfMatchesAndNonMatches(
+              descriptor_size, all_descriptors, tracks,
+              &subset_covariance.sample_size_matches,
+              &subset_covariance.sample_size_non_matches,
+              &subset_covariance.cov_matches,
+              &subset_covariance.cov_non_matches);
+        }
+      },
+      /*always_parallelize=*/true,
+      std::min(num_missions, GetNumTrainingThreads()));
+
+  for (size_t mission_idx = 0u; mission_idx < num_missions; ++mission_idx) {
+    const SubSetCovariance& subset_covariance = covariances[mission_idx];
     match_counts_and_datasets.emplace_back(
-        mission_id, subset_covariance.sample_size_matches);
+        all_mission_ids[mission_idx], subset_covariance.sample_size_matches);
 
     total_sample_size_matches += subset_covariance.sample_size_matches;
     total_sample_size_non_matches += subset_covariance.sample_size_non_matches;
-    covariances.push_back(subset_covariance);
   }
 
   CHECK(!covariances.empty());
@@ -0,0 +1,94 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/feature-descriptor-ref.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+namespace descriptor_projection {
+
+constexpr int kDescriptorBytes = 64;
+constexpr int kNumDescriptors = 100;
+constexpr int kTargetDimensionality = 10;
+
+TEST(DescriptorProjection, UnpackDescriptorBitsMatchesBitLayout) {
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, 1> raw_descriptor;
+  raw_descriptor.setRandom(kDescriptorBytes + 1);
+  // Offset by one byte to exercise unaligned descriptor data.
+  Eigen::VectorXf unpacked(kDescriptorBytes * 8);
+  UnpackDescriptorBits(
+      raw_descriptor.data() + 1, kDescriptorBytes, unpacked.data());
+  for (int bit = 0; bit < kDescriptorBytes * 8; ++bit) {
+    const bool is_set = (raw_descriptor(1 + bit / 8) >> (bit % 8)) & 1;
+    EXPECT_EQ(is_set ? 1.f : 0.f, unpacked(bit));
+  }
+}
+
+TEST(DescriptorProjection, BlockProjectionMatchesSingleProjection) {
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> raw_descriptors;
+  raw_descriptors.setRandom(kDescriptorBytes, kNumDescriptors);
+  Eigen::MatrixXf projection_matrix;
+  projection_matrix.setRandom(kDescriptorBytes * 8, kDescriptorBytes * 8);
+
+  Eigen::MatrixXf expected(kTargetDimensionality, kNumDescriptors);
+  std::vector<aslam::common::FeatureDescriptorConstRef> descriptor_refs;
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    descriptor_refs.emplace_back(
+        &raw_descriptors.coeffRef(0, i), kDescriptorBytes);
+    ProjectDescriptor(
+        descriptor_refs.back(), projection_matrix, kTargetDimensionality,
+        expected.col(i));
+  }
+
+  Eigen::MatrixXf projected;
+  ProjectDescriptorBlock(
+      raw_descriptors, projection_matrix, kTargetDimensionality, &projected);
+  EXPECT_NEAR_EIGEN(expected, projected, 1e-3);
+
+  ProjectDescriptorBlock(
+      descriptor_refs, projection_matrix, kTargetDimensionality, &projected);
+  EXPECT_NEAR_EIGEN(expected, projected, 1e-3);
+
+  // A larger buffer from a previous call is reused for fewer descriptors.
+  Eigen::MatrixXf unpacked_descriptors;
+  ProjectDescriptorBlock(
+      raw_descriptors.data(), kDescriptorBytes, kNumDescriptors,
+      projection_matrix, kTargetDimensionality, &unpacked_descriptors,
+      &projected);
+  EXPECT_NEAR_EIGEN(expected, projected, 1e-3);
+  ProjectDescriptorBlock(
+      raw_descriptors.data(), kDescriptorBytes, kNumDescriptors / 2,
+      projection_matrix, kTargetDimensionality, &unpacked_descriptors,
+      &projected);
+  EXPECT_EQ(kNumDescriptors, unpacked_descriptors.cols());
+  EXPECT_NEAR_EIGEN(
+      expected.leftCols(kNumDescriptors / 2), projected, 1e-3);
+}
+
+TEST(DescriptorProjection, ProjectedDescriptorsSerializationRoundTrip) {
+  Eigen::MatrixXf projection_matrix;
+  projection_matrix.setRandom(kDescriptorBytes * 8, kDescriptorBytes * 8);
+  const uint64_t fingerprint =
+      ComputeProjectionFingerprint(projection_matrix, kTargetDimensionality);
+  EXPECT_NE(
+      fingerprint, ComputeProjectionFingerprint(
+                       projection_matrix, kTargetDimensionality + 1));
+
+  Eigen::MatrixXf projected;
+  projected.setRandom(kTargetDimensionality, kNumDescriptors);
+  cv::Mat resource;
+  SerializeProjectedDescriptors(projected, fingerprint, &resource);
+
+  Eigen::MatrixXf deserialized;
+  ASSERT_TRUE(
+      DeserializeProjectedDescriptors(resource, fingerprint, &deserialized));
+  EXPECT_EQ(projected, deserialized);
+  EXPECT_FALSE(DeserializeProjectedDescriptors(
+      resource, fingerprint + 1u, &deserialized));
+}
+
+}  // namespace descriptor_projection
+
+MAPLAB_UNITTEST_ENTRYPOINT
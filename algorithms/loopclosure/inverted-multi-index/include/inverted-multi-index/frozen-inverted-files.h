@@ -0,0 +1,195 @@
+#ifndef INVERTED_MULTI_INDEX_FROZEN_INVERTED_FILES_H_
+#define INVERTED_MULTI_INDEX_FROZEN_INVERTED_FILES_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+
+#include "inverted-multi-index/inverted-multi-index-common.h"
+
+namespace loop_closure {
+namespace inverted_multi_index {
+namespace common {
+
+// Appends the value as a varint, 7 bits per byte starting with the least
+// significant ones. The high bit of a byte is set if more bytes follow.
+inline void EncodeVarint(uint32_t value, std::vector<uint8_t>* bytes) {
+  CHECK_NOTNULL(bytes);
+  while (value >= 0x80u) {
+    bytes->push_back(static_cast<uint8_t>(value | 0x80u));
+    value >>= 7;
+  }
+  bytes->push_back(static_cast<uint8_t>(value));
+}
+
+// Decodes the varint at position and advances position past it.
+inline uint32_t DecodeVarint(const uint8_t** position) {
+  CHECK_NOTNULL(position);
+  uint32_t value = 0u;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *((*position)++);
+    value |= static_cast<uint32_t>(byte & 0x7fu) << shift;
+    shift += 7;
+  } while ((byte & 0x80u) != 0u);
+  return value;
+}
+
+// Maps signed deltas to unsigned values with a small magnitude, such that
+// small negative deltas also get short varints.
+inline uint32_t ZigZagEncode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+inline int32_t ZigZagDecode(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1u);
+}
+
+// Read-optimized copy of a set of inverted files. The descriptors of all files
+// are stored in one contiguous slab without unused capacity, the descriptor
+// indices of every file as varints of the deltas to their predecessor. Indices
+// are mostly increasing, hence most deltas fit into one or two bytes instead
+// of the four bytes of an int.
+template <typename DescScalarType, int DescDim>
+class FrozenInvertedFiles {
+ public:
+  typedef InvertedFile<DescScalarType, DescDim> InvFile;
+  typedef typename InvFile::Descriptor Descriptor;
+
+  FrozenInvertedFiles() {
+    Clear();
+  }
+
+  inline void Clear() {
+    Aligned<std::vector, Descriptor>().swap(descriptors_);
+    std::vector<uint8_t>().swap(encoded_indices_);
+    file_offsets_.assign(1u, 0u);
+    encoded_index_offsets_.assign(1u, 0u);
+  }
+
+  inline size_t GetNumInvertedFiles() const {
+    return file_offsets_.size() - 1u;
+  }
+
+  inline size_t GetNumEntries(size_t file_idx) const {
+    CHECK_LT(file_idx, GetNumInvertedFiles());
+    return file_offsets_[file_idx + 1u] - file_offsets_[file_idx];
+  }
+
+  inline size_t GetNumEntries() const {
+    return descriptors_.size();
+  }
+
+  // Replaces the content by the given inverted files. Entries for which
+  // skip_entry(descriptor_index) is true are dropped.
+  template <typename SkipEntry>
+  void Freeze(
+      const Aligned<std::vector, InvFile>& inverted_files,
+      const SkipEntry& skip_entry) {
+    Clear();
+    size_t num_entries = 0u;
+    for (const InvFile& inverted_file : inverted_files) {
+      CHECK_EQ(
+          inverted_file.descriptors_.size(), inverted_file.indices_.size());
+      num_entries += inverted_file.indices_.size();
+    }
+    descriptors_.reserve(num_entries);
+    // Most deltas are encoded in at most two bytes.
+    encoded_indices_.reserve(2u * num_entries);
+    file_offsets_.reserve(inverted_files.size() + 1u);
+    encoded_index_offsets_.reserve(inverted_files.size() + 1u);
+
+    for (const InvFile& inverted_file : inverted_files) {
+      int32_t previous_index = 0;
+      const size_t num_file_entries = inverted_file.indices_.size();
+      for (size_t entry_idx = 0u; entry_idx < num_file_entries; ++entry_idx) {
+        const int32_t index = inverted_file.indices_[entry_idx];
+        if (skip_entry(index)) {
+          continue;
+        }
+        descriptors_.push_back(inverted_file.descriptors_[entry_idx]);
+        EncodeVarint(ZigZagEncode(index - previous_index), &encoded_indices_);
+        previous_index = index;
+      }
+      file_offsets_.push_back(descriptors_.size());
+      encoded_index_offsets_.push_back(encoded_indices_.size());
+    }
+    descriptors_.shrink_to_fit();
+    encoded_indices_.shrink_to_fit();
+  }
+
+  // Restores the growable inverted files.
+  void Thaw(Aligned<std::vector, InvFile>* inverted_files) const {
+    CHECK_NOTNULL(inverted_files)->clear();
+    inverted_files->resize(GetNumInvertedFiles());
+    for (size_t file_idx = 0u; file_idx < GetNumInvertedFiles(); ++file_idx) {
+      InvFile& inverted_file = (*inverted_files)[file_idx];
+      inverted_file.descriptors_.reserve(GetNumEntries(file_idx));
+      inverted_file.indices_.reserve(GetNumEntries(file_idx));
+      ForEachEntry(
+          file_idx, [&inverted_file](
+                        int descriptor_index, const Descriptor& descriptor) {
+            inverted_file.descriptors_.push_back(descriptor);
+            inverted_file.indices_.push_back(descriptor_index);
+          });
+    }
+  }
+
+  // Calls visitor(descriptor_index, descriptor) for all entries of the file in
+  // the order they were added.
+  template <typename Visitor>
+  inline void ForEachEntry(size_t file_idx, const Visitor& visitor) const {
+    CHECK_LT(file_idx, GetNumInvertedFiles());
+    const uint8_t* position =
+        encoded_indices_.data() + encoded_index_offsets_[file_idx];
+    int32_t descriptor_index = 0;
+    for (size_t entry_idx = file_offsets_[file_idx];
+         entry_idx < file_offsets_[file_idx + 1u]; ++entry_idx) {
+      descriptor_index += ZigZagDecode(DecodeVarint(&position));
+      visitor(static_cast<int>(descriptor_index), descriptors_[entry_idx]);
+    }
+    CHECK_EQ(
+        position,
+        encoded_indices_.data() + encoded_index_offsets_[file_idx + 1u]);
+  }
+
+  inline size_t GetMemoryUsageBytes() const {
+    return sizeof(Descriptor) * descriptors_.capacity() +
+           sizeof(uint8_t) * encoded_indices_.capacity() +
+           sizeof(size_t) *
+               (file_offsets_.capacity() + encoded_index_offsets_.capacity());
+  }
+
+ private:
+  Aligned<std::vector, Descriptor> descriptors_;
+  // The entries of file i are [file_offsets_[i], file_offsets_[i + 1]).
+  std::vector<size_t> file_offsets_;
+  std::vector<uint8_t> encoded_indices_;
+  std::vector<size_t> encoded_index_offsets_;
+};
+
+// The memory used by growable inverted files, including unused capacity.
+template <typename DescScalarType, int DescDim>
+size_t GetMemoryUsageBytes(
+    const Aligned<std::vector, InvertedFile<DescScalarType, DescDim> >&
+        inverted_files) {
+  typedef InvertedFile<DescScalarType, DescDim> InvFile;
+  size_t num_bytes = sizeof(InvFile) * inverted_files.capacity();
+  for (const InvFile& inverted_file : inverted_files) {
+    num_bytes +=
+        sizeof(typename InvFile::Descriptor) *
+            inverted_file.descriptors_.capacity() +
+        sizeof(int) * inverted_file.indices_.capacity();
+  }
+  return num_bytes;
+}
+
+}  // namespace common
+}  // namespace inverted_multi_index
+}  // namespace loop_closure
+
+#endif  // INVERTED_MULTI_INDEX_FROZEN_INVERTED_FILES_H_
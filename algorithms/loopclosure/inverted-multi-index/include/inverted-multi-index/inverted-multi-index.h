@@ -18,6 +18,7 @@
 #include <maplab-common/eigen-proto.h>
 #include <nabo/nabo.h>
 
+#include "inverted-multi-index/frozen-inverted-files.h"
 #include "inverted-multi-index/inverted-multi-index-common.h"
 #include "inverted-multi-index/inverted_multi_index.pb.h"
 
@@ -42,6 +43,8 @@ class InvertedMultiIndex {
   typedef Eigen::Matrix<float, 2 * kDimSubVectors, Eigen::Dynamic>
       DescriptorMatrixType;
   typedef common::InvertedFile<float, 2 * kDimSubVectors> InvFile;
+  typedef common::FrozenInvertedFiles<float, 2 * kDimSubVectors>
+      FrozenInvFiles;
 
   // Creates the index from a given set of visual words. Each column in words_i
   // specifies a cluster center coordinate.
@@ -57,7 +60,12 @@ class InvertedMultiIndex {
             common::NNSearch::createKDTreeLinearHeap(
                 words_2_, kDimSubVectors, common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
-        max_db_descriptor_index_(0) {
+        max_candidates_for_nn_search_(0),
+        max_db_descriptor_index_(0),
+        num_removed_descriptors_(0),
+        num_removed_entries_(0),
+        reset_count_(0u),
+        is_frozen_(false) {
     CHECK_EQ(words_1.rows(), kDimSubVectors);
     CHECK_GT(words_1.cols(), 0);
     CHECK_EQ(words_2.rows(), kDimSubVectors);
@@ -70,21 +78,46 @@ class InvertedMultiIndex {
     num_closest_words_for_nn_search_ = num_closest_words_for_nn_search;
   }
 
+  // Stops probing further words once the descriptors of the probed words
+  // exceed the budget, such that dense words don't blow up the search time
+  // while sparse regions still probe up to num_closest_words_for_nn_search
+  // words. 0 disables the budget.
+  void SetMaxCandidatesForNNSearch(int max_candidates_for_nn_search) {
+    CHECK_GE(max_candidates_for_nn_search, 0);
+    max_candidates_for_nn_search_ = max_candidates_for_nn_search;
+  }
+
+  // The number of descriptors that have been added and not removed.
   inline int GetNumDescriptorsInIndex() const {
-    return max_db_descriptor_index_;
+    return max_db_descriptor_index_ - num_removed_descriptors_;
+  }
+
+  // The number of removed descriptors that are still stored in the inverted
+  // files, i.e. that haven't been dropped by a compaction yet.
+  inline int GetNumRemovedEntries() const {
+    return num_removed_entries_;
+  }
+
+  inline bool IsDescriptorRemoved(int descriptor_index) const {
+    const size_t index = static_cast<size_t>(descriptor_index);
+    return index < removed_descriptors_.size() && removed_descriptors_[index];
   }
 
   // Clears the inverted multi-index by removing all references to the database
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
     inverted_files_.clear();
+    frozen_inverted_files_.Clear();
+    is_frozen_ = false;
     word_index_map_.clear();
     max_db_descriptor_index_ = 0;
+    resetRemovedDescriptors(0);
   }
 
   // Adds a set of database descriptors to the inverted multi-index.
   // Each column defines a database descriptor.
   void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    Unfreeze();
     const int num_descriptors = descriptors.cols();
     std::vector<std::pair<int, int> > closest_word;
 
@@ -103,6 +136,200 @@ class InvertedMultiIndex {
     }
   }
 
+  // Marks the descriptors with the given indices as removed. They are skipped
+  // by all searches right away, but stay in the inverted files until these are
+  // compacted.
+  void RemoveDescriptors(const std::vector<int>& descriptor_indices) {
+    removed_descriptors_.resize(max_db_descriptor_index_, false);
+    for (const int descriptor_index : descriptor_indices) {
+      CHECK_GE(descriptor_index, 0);
+      CHECK_LT(descriptor_index, max_db_descriptor_index_);
+      if (!removed_descriptors_[descriptor_index]) {
+        removed_descriptors_[descriptor_index] = true;
+        ++num_removed_descriptors_;
+        ++num_removed_entries_;
+      }
+    }
+  }
+
+  // Copies of inverted files without their removed descriptors.
+  struct CompactedInvertedFiles {
+    // The index of the compacted file in inverted_files_ and the number of its
+    // entries that were considered by the compaction.
+    std::vector<std::pair<int, size_t> > inverted_file_indices;
+    Aligned<std::vector, InvFile> inverted_files;
+    int num_dropped_entries = 0;
+    size_t reset_count = 0u;
+  };
+
+  // Copies all inverted files of which at least min_removed_ratio of the
+  // entries are removed, without the removed entries. This only reads the
+  // index, hence it can run concurrently with searches.
+  void CompactInvertedFiles(
+      double min_removed_ratio, CompactedInvertedFiles* compacted) const {
+    CHECK_NOTNULL(compacted);
+    CHECK_GE(min_removed_ratio, 0.0);
+    compacted->inverted_file_indices.clear();
+    compacted->inverted_files.clear();
+    compacted->num_dropped_entries = 0;
+    compacted->reset_count = reset_count_;
+    if (num_removed_entries_ == 0) {
+      return;
+    }
+
+    const int num_inverted_files = static_cast<int>(inverted_files_.size());
+    for (int file_idx = 0; file_idx < num_inverted_files; ++file_idx) {
+      const InvFile& inverted_file = inverted_files_[file_idx];
+      const size_t num_entries = inverted_file.indices_.size();
+      size_t num_removed = 0u;
+      for (const int descriptor_index : inverted_file.indices_) {
+        num_removed += IsDescriptorRemoved(descriptor_index) ? 1u : 0u;
+      }
+      if (num_removed == 0u ||
+          num_removed < min_removed_ratio * static_cast<double>(num_entries)) {
+        continue;
+      }
+
+      InvFile compacted_file;
+      compacted_file.descriptors_.reserve(num_entries - num_removed);
+      compacted_file.indices_.reserve(num_entries - num_removed);
+      for (size_t entry_idx = 0u; entry_idx < num_entries; ++entry_idx) {
+        if (!IsDescriptorRemoved(inverted_file.indices_[entry_idx])) {
+          compacted_file.descriptors_.push_back(
+              inverted_file.descriptors_[entry_idx]);
+          compacted_file.indices_.push_back(inverted_file.indices_[entry_idx]);
+        }
+      }
+      compacted->inverted_file_indices.emplace_back(file_idx, num_entries);
+      compacted->inverted_files.push_back(compacted_file);
+      compacted->num_dropped_entries += static_cast<int>(num_removed);
+    }
+  }
+
+  // Replaces the inverted files by their compacted copies. Descriptors that
+  // were added to the files after the compaction are carried over. Returns
+  // false and keeps the inverted files if the index has been cleared or
+  // replaced in the meantime.
+  bool ApplyCompactedInvertedFiles(CompactedInvertedFiles* compacted) {
+    CHECK_NOTNULL(compacted);
+    if (compacted->reset_count != reset_count_) {
+      return false;
+    }
+    const size_t num_compacted_files = compacted->inverted_file_indices.size();
+    CHECK_EQ(num_compacted_files, compacted->inverted_files.size());
+    for (size_t i = 0u; i < num_compacted_files; ++i) {
+      const int file_idx = compacted->inverted_file_indices[i].first;
+      const size_t num_compacted_entries =
+          compacted->inverted_file_indices[i].second;
+      CHECK_LT(file_idx, static_cast<int>(inverted_files_.size()));
+      InvFile& inverted_file = inverted_files_[file_idx];
+      InvFile& compacted_file = compacted->inverted_files[i];
+      const size_t num_entries = inverted_file.indices_.size();
+      CHECK_GE(num_entries, num_compacted_entries);
+      for (size_t entry_idx = num_compacted_entries; entry_idx < num_entries;
+           ++entry_idx) {
+        compacted_file.descriptors_.push_back(
+            inverted_file.descriptors_[entry_idx]);
+        compacted_file.indices_.push_back(inverted_file.indices_[entry_idx]);
+      }
+      std::swap(inverted_file.descriptors_, compacted_file.descriptors_);
+      std::swap(inverted_file.indices_, compacted_file.indices_);
+    }
+    num_removed_entries_ -= compacted->num_dropped_entries;
+    CHECK_GE(num_removed_entries_, 0);
+    compacted->inverted_file_indices.clear();
+    compacted->inverted_files.clear();
+    compacted->num_dropped_entries = 0;
+    return true;
+  }
+
+  // Drops the removed descriptors from all inverted files.
+  void Compact() {
+    if (is_frozen_) {
+      // Freezing drops the removed descriptors.
+      Unfreeze();
+      Freeze();
+      return;
+    }
+    CompactedInvertedFiles compacted;
+    constexpr double kMinRemovedRatio = 0.0;
+    CompactInvertedFiles(kMinRemovedRatio, &compacted);
+    CHECK(ApplyCompactedInvertedFiles(&compacted));
+  }
+
+  // Converts the growable inverted files into a read-optimized layout, see
+  // common::FrozenInvertedFiles, and drops the removed descriptors. Meant to be
+  // called once the database is complete, e.g. before localization starts.
+  // Adding descriptors to a frozen index unfreezes it first. Compactions of a
+  // frozen index don't find anything to drop, use Compact() instead.
+  void Freeze() {
+    if (is_frozen_) {
+      return;
+    }
+    frozen_inverted_files_.Freeze(
+        inverted_files_,
+        [this](int descriptor_index) {
+          return IsDescriptorRemoved(descriptor_index);
+        });
+    Aligned<std::vector, InvFile>().swap(inverted_files_);
+    resetRemovedDescriptors(num_removed_descriptors_);
+    is_frozen_ = true;
+  }
+
+  // Restores the growable inverted files of a frozen index.
+  void Unfreeze() {
+    if (!is_frozen_) {
+      return;
+    }
+    frozen_inverted_files_.Thaw(&inverted_files_);
+    frozen_inverted_files_.Clear();
+    is_frozen_ = false;
+    ++reset_count_;
+  }
+
+  inline bool IsFrozen() const {
+    return is_frozen_;
+  }
+
+  inline size_t GetNumInvertedFiles() const {
+    return is_frozen_ ? frozen_inverted_files_.GetNumInvertedFiles()
+                      : inverted_files_.size();
+  }
+
+  // Calls visitor(descriptor_index, descriptor) for all entries of the
+  // inverted file, including removed ones, for both layouts.
+  template <typename Visitor>
+  inline void ForEachInvertedFileEntry(
+      size_t file_idx, const Visitor& visitor) const {
+    if (is_frozen_) {
+      frozen_inverted_files_.ForEachEntry(file_idx, visitor);
+      return;
+    }
+    CHECK_LT(file_idx, inverted_files_.size());
+    const InvFile& inverted_file = inverted_files_[file_idx];
+    const size_t num_entries = inverted_file.indices_.size();
+    for (size_t entry_idx = 0u; entry_idx < num_entries; ++entry_idx) {
+      visitor(
+          inverted_file.indices_[entry_idx],
+          inverted_file.descriptors_[entry_idx]);
+    }
+  }
+
+  // The number of entries of the inverted file, including removed ones.
+  inline size_t GetNumInvertedFileEntries(size_t file_idx) const {
+    if (is_frozen_) {
+      return frozen_inverted_files_.GetNumEntries(file_idx);
+    }
+    CHECK_LT(file_idx, inverted_files_.size());
+    return inverted_files_[file_idx].indices_.size();
+  }
+
+  // The memory used by the inverted files, including unused capacity.
+  inline size_t GetInvertedFilesMemoryUsageBytes() const {
+    return frozen_inverted_files_.GetMemoryUsageBytes() +
+           common::GetMemoryUsageBytes(inverted_files_);
+  }
+
   // Finds the n nearest neighbors for a given query feature.
   // This function is thread-safe.
   template <typename DerivedQuery, typename DerivedIndices,
@@ -136,28 +363,24 @@ class InvertedMultiIndex {
         *words_2_index_, words_1_.cols(), words_2_.cols(), &closest_words);
 
     // Performs exhaustive search through all descriptors assigned to the
-    // closest words.
+    // closest words, until the candidate budget is used up.
     std::vector<std::pair<float, int> > nearest_neighbors;
     nearest_neighbors.reserve(num_neighbors + 1);
-    const int num_words_to_use = static_cast<int>(closest_words.size());
-    std::unordered_map<int, int>::const_iterator word_index_map_it;
-
-    for (int i = 0; i < num_words_to_use; ++i) {
-      const int word_index =
-          closest_words[i].first * words_2_.cols() + closest_words[i].second;
-      word_index_map_it = word_index_map_.find(word_index);
-      if (word_index_map_it == word_index_map_.end())
-        continue;
-
-      const InvFile& inverted_file = inverted_files_[word_index_map_it->second];
-      const size_t num_descriptors = inverted_file.descriptors_.size();
-      for (size_t j = 0; j < num_descriptors; ++j) {
-        const float distance =
-            (inverted_file.descriptors_[j] - query_feature).squaredNorm();
-        common::InsertNeighbor(
-            inverted_file.indices_[j], distance, num_neighbors,
-            &nearest_neighbors);
-      }
+    std::vector<int> inverted_file_indices;
+    GetInvertedFilesToProbe(closest_words, &inverted_file_indices);
+
+    const DescriptorType query = query_feature;
+    for (const int file_idx : inverted_file_indices) {
+      ForEachInvertedFileEntry(
+          file_idx,
+          [&](int descriptor_index, const DescriptorType& descriptor) {
+            if (IsDescriptorRemoved(descriptor_index)) {
+              return;
+            }
+            InsertCandidate(
+                descriptor_index, descriptor, query, num_neighbors,
+                &nearest_neighbors);
+          });
     }
 
     for (size_t i = 0; i < nearest_neighbors.size(); ++i) {
@@ -170,38 +393,114 @@ class InvertedMultiIndex {
     }
   }
 
+  // Finds the n nearest neighbors for every column of query_features. Gives
+  // the same results as calling GetNNearestNeighbors for every column, but
+  // groups the queries by the inverted files they visit, such that every
+  // inverted file is only read once for the whole batch instead of once per
+  // query. Column i of indices and distances holds the results of query i.
+  // This function is thread-safe.
+  inline void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK_EQ(query_features.rows(), 2 * kDimSubVectors);
+    CHECK_GT(num_neighbors, 0);
+    const int num_queries = query_features.cols();
+    CHECK_EQ(indices->rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(indices->cols(), num_queries)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->cols(), num_queries)
+        << "The distances parameter must be pre-allocated to hold all results.";
+
+    // Collects the queries visiting each inverted file.
+    std::unordered_map<int, std::vector<int> > inverted_file_to_queries;
+    std::vector<std::pair<int, int> > closest_words;
+    std::vector<int> inverted_file_indices;
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      common::FindClosestWords<kDimSubVectors>(
+          query_features.col(query_idx), num_closest_words_for_nn_search_,
+          *words_1_index_, *words_2_index_, words_1_.cols(), words_2_.cols(),
+          &closest_words);
+      GetInvertedFilesToProbe(closest_words, &inverted_file_indices);
+      for (const int file_idx : inverted_file_indices) {
+        inverted_file_to_queries[file_idx].push_back(query_idx);
+      }
+    }
+
+    // The neighbors are kept sorted by distance and index, hence the order in
+    // which the candidates are visited doesn't change the result.
+    std::vector<std::vector<std::pair<float, int> > > nearest_neighbors(
+        num_queries);
+    DescriptorMatrixType queries;
+    for (const std::pair<const int, std::vector<int> >& file_and_queries :
+         inverted_file_to_queries) {
+      const std::vector<int>& query_indices = file_and_queries.second;
+      const size_t num_file_queries = query_indices.size();
+      queries.resize(Eigen::NoChange, num_file_queries);
+      for (size_t i = 0u; i < num_file_queries; ++i) {
+        queries.col(i) = query_features.col(query_indices[i]);
+      }
+
+      ForEachInvertedFileEntry(
+          file_and_queries.first,
+          [&](int descriptor_index, const DescriptorType& descriptor) {
+            if (IsDescriptorRemoved(descriptor_index)) {
+              return;
+            }
+            for (size_t i = 0u; i < num_file_queries; ++i) {
+              InsertCandidate(
+                  descriptor_index, descriptor, queries.col(i), num_neighbors,
+                  &nearest_neighbors[query_indices[i]]);
+            }
+          });
+    }
+
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      const std::vector<std::pair<float, int> >& query_neighbors =
+          nearest_neighbors[query_idx];
+      for (size_t i = 0; i < query_neighbors.size(); ++i) {
+        (*indices)(i, query_idx) = query_neighbors[i].second;
+        (*distances)(i, query_idx) = query_neighbors[i].first;
+      }
+      for (int i = query_neighbors.size(); i < num_neighbors; ++i) {
+        (*indices)(i, query_idx) = -1;
+        (*distances)(i, query_idx) = std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+
   inline void serialize(
       proto::InvertedMultiIndex* proto_inverted_multi_index) const {
     CHECK_NOTNULL(proto_inverted_multi_index);
 
-    for (const InvFile& inverted_file : inverted_files_) {
+    // Removed descriptors are dropped, as if the index had been compacted.
+    const size_t num_inverted_files = GetNumInvertedFiles();
+    for (size_t file_idx = 0u; file_idx < num_inverted_files; ++file_idx) {
       proto::InvertedFile* proto_inverted_file =
           CHECK_NOTNULL(proto_inverted_multi_index->add_inverted_files());
 
-      const size_t num_descriptors = inverted_file.descriptors_.size();
-      CHECK_GT(num_descriptors, 0u);
-
-      const size_t projected_descriptor_dimensions =
-          static_cast<size_t>(inverted_file.descriptors_[0].rows());
+      Aligned<std::vector, DescriptorType> kept_descriptors;
+      ForEachInvertedFileEntry(
+          file_idx,
+          [&](int descriptor_index, const DescriptorType& descriptor) {
+            if (!IsDescriptorRemoved(descriptor_index)) {
+              kept_descriptors.push_back(descriptor);
+              proto_inverted_file->add_indices(descriptor_index);
+            }
+          });
 
       Eigen::MatrixXf descriptors =
-          Eigen::MatrixXf(projected_descriptor_dimensions, num_descriptors);
-
-      for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
-           ++descriptor_idx) {
-        descriptors.col(descriptor_idx) =
-            inverted_file.descriptors_[descriptor_idx];
+          Eigen::MatrixXf(2 * kDimSubVectors, kept_descriptors.size());
+      for (size_t i = 0u; i < kept_descriptors.size(); ++i) {
+        descriptors.col(i) = kept_descriptors[i];
       }
 
       ::common::eigen_proto::serialize(
           descriptors, proto_inverted_file->mutable_descriptors());
-
-      const size_t num_indices = inverted_file.indices_.size();
-      CHECK_EQ(num_descriptors, num_indices);
-
-      for (const int index : inverted_file.indices_) {
-        proto_inverted_file->add_indices(index);
-      }
     }
 
     proto_inverted_multi_index->set_max_db_descriptor_index(
@@ -221,6 +520,9 @@ class InvertedMultiIndex {
   inline void deserialize(
       const proto::InvertedMultiIndex proto_inverted_multi_index) {
     inverted_files_.clear();
+    frozen_inverted_files_.Clear();
+    is_frozen_ = false;
+    int num_stored_descriptors = 0;
 
     for (const ::loop_closure::proto::InvertedFile& proto_inverted_file :
          proto_inverted_multi_index.inverted_files()) {
@@ -228,9 +530,10 @@ class InvertedMultiIndex {
       ::common::eigen_proto::deserialize(
           proto_inverted_file.descriptors(), &descriptors);
 
-      const int projected_descriptor_dimensions = descriptors.rows();
-      CHECK_EQ(projected_descriptor_dimensions, 2 * kDimSubVectors);
       const int num_descriptors = descriptors.cols();
+      if (num_descriptors > 0) {
+        CHECK_EQ(descriptors.rows(), 2 * kDimSubVectors);
+      }
 
       const int num_indices = proto_inverted_file.indices_size();
       CHECK_EQ(num_indices, num_descriptors);
@@ -245,10 +548,13 @@ class InvertedMultiIndex {
       }
 
       inverted_files_.push_back(inverted_file);
+      num_stored_descriptors += num_indices;
     }
 
     max_db_descriptor_index_ =
         proto_inverted_multi_index.max_db_descriptor_index();
+    CHECK_LE(num_stored_descriptors, max_db_descriptor_index_);
+    resetRemovedDescriptors(max_db_descriptor_index_ - num_stored_descriptors);
 
     word_index_map_.clear();
 
@@ -263,6 +569,66 @@ class InvertedMultiIndex {
   }
 
  protected:
+  // The inverted files of the closest words in the order they are probed. The
+  // probing stops once the candidate budget is reached.
+  inline void GetInvertedFilesToProbe(
+      const std::vector<std::pair<int, int> >& closest_words,
+      std::vector<int>* inverted_file_indices) const {
+    CHECK_NOTNULL(inverted_file_indices)->clear();
+    size_t num_candidates = 0u;
+    for (const std::pair<int, int>& closest_word : closest_words) {
+      if (max_candidates_for_nn_search_ > 0 &&
+          num_candidates >=
+              static_cast<size_t>(max_candidates_for_nn_search_)) {
+        break;
+      }
+      const int word_index =
+          closest_word.first * words_2_.cols() + closest_word.second;
+      const std::unordered_map<int, int>::const_iterator word_index_map_it =
+          word_index_map_.find(word_index);
+      if (word_index_map_it != word_index_map_.end()) {
+        inverted_file_indices->push_back(word_index_map_it->second);
+        num_candidates += GetNumInvertedFileEntries(word_index_map_it->second);
+      }
+    }
+  }
+
+  // Inserts the candidate into the sorted nearest neighbors. The distance of
+  // the first half is compared to the current num_neighbors-th distance first
+  // and the second half is skipped if it is already farther, as
+  // common::InsertNeighbor would drop the candidate anyway.
+  template <typename DerivedQuery>
+  inline static void InsertCandidate(
+      int descriptor_index, const DescriptorType& descriptor,
+      const Eigen::MatrixBase<DerivedQuery>& query, int num_neighbors,
+      std::vector<std::pair<float, int> >* nearest_neighbors) {
+    CHECK_NOTNULL(nearest_neighbors);
+    const float partial_distance =
+        (descriptor.template head<kDimSubVectors>() -
+         query.template head<kDimSubVectors>())
+            .squaredNorm();
+    if (static_cast<int>(nearest_neighbors->size()) >= num_neighbors &&
+        nearest_neighbors->back().first < partial_distance) {
+      return;
+    }
+    const float distance = partial_distance +
+                           (descriptor.template tail<kDimSubVectors>() -
+                            query.template tail<kDimSubVectors>())
+                               .squaredNorm();
+    common::InsertNeighbor(
+        descriptor_index, distance, num_neighbors, nearest_neighbors);
+  }
+
+  // Forgets which descriptors have been removed, e.g. after all inverted files
+  // have been replaced. The given number of descriptors have been removed
+  // before and aren't stored in the inverted files anymore.
+  inline void resetRemovedDescriptors(int num_removed_descriptors) {
+    removed_descriptors_.clear();
+    num_removed_descriptors_ = num_removed_descriptors;
+    num_removed_entries_ = 0;
+    ++reset_count_;
+  }
+
   // The two sets of cluster centers defining the quantization of the descriptor
   // space as the Cartesian product of the two sets of words.
   Eigen::MatrixXf words_1_;
@@ -273,6 +639,9 @@ class InvertedMultiIndex {
   // The number of closest words from the product vocabulary that should be used
   // during nearest neighbor search.
   int num_closest_words_for_nn_search_;
+  // The number of descriptors after which no further words are probed, 0 for
+  // no limit.
+  int max_candidates_for_nn_search_;
   // Hashmap storing for each combined visual word the index in inverted_files_
   // in which all database descriptors assigned to that word can be found.
   // This allows us to easily add descriptors assigned to words that have not
@@ -284,6 +653,19 @@ class InvertedMultiIndex {
   Aligned<std::vector, InvFile> inverted_files_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
+  // Flags the removed descriptors by their index. Removed descriptors are
+  // skipped by the searches until a compaction drops them from the inverted
+  // files.
+  std::vector<bool> removed_descriptors_;
+  int num_removed_descriptors_;
+  // The number of removed descriptors still stored in the inverted files.
+  int num_removed_entries_;
+  // Incremented whenever the inverted files are replaced as a whole, such
+  // that stale compaction results are not applied.
+  size_t reset_count_;
+  // Replaces inverted_files_ while the index is frozen.
+  FrozenInvFiles frozen_inverted_files_;
+  bool is_frozen_;
 };
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
@@ -15,6 +15,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <nabo/nabo.h>
+#include <product-quantization/fast-scan.h>
 #include <product-quantization/product-quantization.h>
 
 #include <inverted-multi-index/inverted-multi-index-common.h>
@@ -55,6 +56,10 @@ class InvertedMultiProductQuantizationIndex {
   typedef product_quantization::ProductQuantization<
       kHalfNumComponents, kNumDimPerComp, kNumCenters, DataType>
       ProductQuantizer;
+  // The 4 bit codes used by fast-scan, which requires at most 16 centers.
+  static constexpr bool kSupportsFastScan =
+      kNumCenters <= product_quantization::kFastScanMaxNumCenters;
+  typedef product_quantization::FastScanCodes<kNumComponents> FastScanCodes;
 
   // Creates the index from a given set of visual words. Each column in words_i
   // specifies a cluster center coordinate. quantizer_centers_i define the
@@ -81,6 +86,7 @@ class InvertedMultiProductQuantizationIndex {
                 words_2_, kOriginalDescDim / 2,
                 common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
+        use_fast_scan_(kSupportsFastScan),
         max_db_descriptor_index_(0) {
     static_assert(
         kNumComponents % 2 == 0,
@@ -125,6 +131,16 @@ class InvertedMultiProductQuantizationIndex {
     num_closest_words_for_nn_search_ = num_closest_words_for_nn_search;
   }
 
+  // Fast-scan is used by default if the quantizers have at most 16 centers.
+  // The nearest neighbors are the same either way, fast-scan only limits the
+  // exact distance computation to the candidates it can't rule out.
+  void SetUseFastScan(bool use_fast_scan) {
+    CHECK(!use_fast_scan || kSupportsFastScan)
+        << "Fast-scan requires at most "
+        << product_quantization::kFastScanMaxNumCenters << " centers.";
+    use_fast_scan_ = use_fast_scan;
+  }
+
   inline int GetNumDescriptorsInIndex() const {
     return max_db_descriptor_index_;
   }
@@ -133,6 +149,7 @@ class InvertedMultiProductQuantizationIndex {
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
     inverted_files_.clear();
+    fast_scan_codes_.clear();
     word_index_map_.clear();
     max_db_descriptor_index_ = 0;
   }
@@ -176,6 +193,11 @@ class InvertedMultiProductQuantizationIndex {
       common::AddDescriptor<DataType, kNumComponents>(
           quantized_residual, max_db_descriptor_index_, word_index,
           &word_index_map_, &inverted_files_);
+      if (kSupportsFastScan) {
+        const size_t inverted_file_index = word_index_map_.at(word_index);
+        fast_scan_codes_.resize(inverted_files_.size());
+        fast_scan_codes_[inverted_file_index].Add(quantized_residual);
+      }
       ++max_db_descriptor_index_;
     }
   }
@@ -228,6 +250,28 @@ class InvertedMultiProductQuantizationIndex {
     AlignedUnorderedMap<int, LookUpTable> table_cache_words_1;
     AlignedUnorderedMap<int, LookUpTable> table_cache_words_2;
 
+    // With fast-scan, the descriptors are first compared using quantized
+    // look-up tables. Any num_neighbors descriptors bound the distance of the
+    // nearest neighbors from above, so only the descriptors whose lower bound
+    // doesn't exceed the smallest such upper bound can be nearest neighbors.
+    // Only those are re-ranked with the float look-up tables.
+    struct RerankCandidate {
+      float lower_bound;
+      const InvFile* inverted_file;
+      int descriptor_index;
+      int word1;
+      int word2;
+      const LookUpTable* lut1;
+      const LookUpTable* lut2;
+    };
+    std::vector<RerankCandidate> candidates;
+    std::vector<float> upper_bounds;
+    upper_bounds.reserve(num_neighbors + 1);
+    float upper_bound_threshold = std::numeric_limits<float>::infinity();
+    Eigen::Matrix<float, kNumComponents, kNumCenters> lut;
+    product_quantization::FastScanLookUpTable<kNumComponents> quantized_lut;
+    std::vector<uint16_t> quantized_distances;
+
     for (int i = 0; i < num_words_to_use; ++i) {
       const int word1 = closest_words[i].first;
       const int word2 = closest_words[i].second;
@@ -266,6 +310,45 @@ class InvertedMultiProductQuantizationIndex {
       const LookUpTable& lut2 = table_it->second;
 
       const InvFile& inverted_file = inverted_files_[word_index_map_it->second];
+      if (use_fast_scan_) {
+        // Quantizes the look-up tables of both halves into one 8 bit table.
+        lut.template topRows<kHalfNumComponents>() = lut1;
+        lut.template bottomRows<kHalfNumComponents>() = lut2;
+        product_quantization::QuantizeLookUpTable(lut, &quantized_lut);
+        product_quantization::ComputeFastScanDistances(
+            quantized_lut, fast_scan_codes_[word_index_map_it->second],
+            &quantized_distances);
+        CHECK_EQ(quantized_distances.size(), inverted_file.indices_.size());
+
+        for (size_t j = 0u; j < quantized_distances.size(); ++j) {
+          const float distance =
+              quantized_lut.ToDistance(quantized_distances[j]);
+          const float lower_bound = distance - quantized_lut.max_error;
+          if (lower_bound > upper_bound_threshold) {
+            continue;
+          }
+          candidates.push_back(
+              {lower_bound, &inverted_file, static_cast<int>(j), word1, word2,
+               &lut1, &lut2});
+
+          const float upper_bound = distance + quantized_lut.max_error;
+          if (static_cast<int>(upper_bounds.size()) < num_neighbors ||
+              upper_bound < upper_bounds.back()) {
+            upper_bounds.insert(
+                std::upper_bound(
+                    upper_bounds.begin(), upper_bounds.end(), upper_bound),
+                upper_bound);
+            if (static_cast<int>(upper_bounds.size()) > num_neighbors) {
+              upper_bounds.pop_back();
+            }
+            if (static_cast<int>(upper_bounds.size()) == num_neighbors) {
+              upper_bound_threshold = upper_bounds.back();
+            }
+          }
+        }
+        continue;
+      }
+
       const int num_descriptors =
           static_cast<int>(inverted_file.descriptors_.size());
       for (int j = 0; j < num_descriptors; ++j) {
@@ -283,6 +366,21 @@ class InvertedMultiProductQuantizationIndex {
       }
     }
 
+    for (const RerankCandidate& candidate : candidates) {
+      if (candidate.lower_bound > upper_bound_threshold) {
+        continue;
+      }
+      const StoredDescriptorType& descriptor =
+          candidate.inverted_file->descriptors_[candidate.descriptor_index];
+      float distance = quantizers_words_1_[candidate.word1].ComputeDistance(
+          *candidate.lut1, descriptor.template head<kHalfNumComponents>());
+      distance += quantizers_words_2_[candidate.word2].ComputeDistance(
+          *candidate.lut2, descriptor.template tail<kHalfNumComponents>());
+      common::InsertNeighbor(
+          candidate.inverted_file->indices_[candidate.descriptor_index],
+          distance, num_neighbors, &nearest_neighbors);
+    }
+
     for (size_t i = 0; i < nearest_neighbors.size(); ++i) {
       indices(i, 0) = nearest_neighbors[i].second;
       distances(i, 0) = nearest_neighbors[i].first;
@@ -331,6 +429,10 @@ class InvertedMultiProductQuantizationIndex {
   // product vocabulary. Each inverted file holds all descriptors assigned to
   // the corresponding word and their indices.
   Aligned<std::vector, InvFile> inverted_files_;
+  // The packed codes of the descriptors of the inverted file with the same
+  // index, if fast-scan is supported.
+  std::vector<FastScanCodes> fast_scan_codes_;
+  bool use_fast_scan_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
 };
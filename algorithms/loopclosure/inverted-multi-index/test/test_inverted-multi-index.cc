@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <utility>
 #include <vector>
 
@@ -6,6 +7,7 @@
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
 
+#include <inverted-multi-index/frozen-inverted-files.h>
 #include <inverted-multi-index/inverted-multi-index-common.h>
 #include <inverted-multi-index/inverted-multi-index.h>
 
@@ -228,6 +230,284 @@ TEST_F(InvertedMultiIndexTest, GetNNearestNeighborsWorks) {
             expected_indices.block(0, 0, num_elements, 1), 1e-9));
   }
 }
+
+TEST_F(InvertedMultiIndexTest, BatchedSearchMatchesPerQuerySearch) {
+  FLAGS_lc_knn_epsilon = 0.2;
+  std::srand(42);
+  const Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(6, 500).array().abs();
+  const Eigen::MatrixXf query_descriptors =
+      Eigen::MatrixXf::Random(6, 40).array().abs();
+
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  index.AddDescriptors(descriptors);
+
+  static constexpr int kNumNeighbors = 5;
+  Eigen::MatrixXi batch_indices(kNumNeighbors, query_descriptors.cols());
+  Eigen::MatrixXf batch_distances(kNumNeighbors, query_descriptors.cols());
+  index.GetNNearestNeighborsForFeatures(
+      query_descriptors, kNumNeighbors, &batch_indices, &batch_distances);
+
+  for (int i = 0; i < query_descriptors.cols(); ++i) {
+    Eigen::VectorXi indices(kNumNeighbors, 1);
+    Eigen::VectorXf distances(kNumNeighbors, 1);
+    index.GetNNearestNeighbors(
+        query_descriptors.block<6, 1>(0, i), kNumNeighbors, indices, distances);
+    EXPECT_TRUE(
+        ::common::MatricesEqual(indices, batch_indices.col(i), 1e-9));
+    for (int j = 0; j < kNumNeighbors; ++j) {
+      EXPECT_EQ(distances(j), batch_distances(j, i));
+    }
+  }
+}
+
+TEST_F(InvertedMultiIndexTest, RemovedDescriptorsAreSkippedAndCompacted) {
+  FLAGS_lc_knn_epsilon = 0.2;
+  std::srand(42);
+  const Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(6, 500).array().abs();
+  const Eigen::MatrixXf query_descriptors =
+      Eigen::MatrixXf::Random(6, 40).array().abs();
+
+  // The reference index only holds the descriptors that are not removed.
+  std::vector<int> removed_indices;
+  std::vector<int> kept_indices;
+  for (int i = 0; i < descriptors.cols(); ++i) {
+    (i % 3 == 0 ? removed_indices : kept_indices).push_back(i);
+  }
+  Eigen::MatrixXf kept_descriptors(6, kept_indices.size());
+  for (size_t i = 0u; i < kept_indices.size(); ++i) {
+    kept_descriptors.col(i) = descriptors.col(kept_indices[i]);
+  }
+  TestableInvertedMultiIndex reference_index(words1_, words2_, 10);
+  reference_index.AddDescriptors(kept_descriptors);
+
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  index.AddDescriptors(descriptors);
+  index.RemoveDescriptors(removed_indices);
+  EXPECT_EQ(
+      index.GetNumDescriptorsInIndex(), static_cast<int>(kept_indices.size()));
+  EXPECT_EQ(
+      index.GetNumRemovedEntries(), static_cast<int>(removed_indices.size()));
+
+  static constexpr int kNumNeighbors = 5;
+  auto expect_same_neighbors_as_reference = [&]() {
+    for (int i = 0; i < query_descriptors.cols(); ++i) {
+      Eigen::VectorXi reference_indices(kNumNeighbors, 1);
+      Eigen::VectorXf reference_distances(kNumNeighbors, 1);
+      reference_index.GetNNearestNeighbors(
+          query_descriptors.block<6, 1>(0, i), kNumNeighbors,
+          reference_indices, reference_distances);
+      Eigen::VectorXi indices(kNumNeighbors, 1);
+      Eigen::VectorXf distances(kNumNeighbors, 1);
+      index.GetNNearestNeighbors(
+          query_descriptors.block<6, 1>(0, i), kNumNeighbors, indices,
+          distances);
+      for (int j = 0; j < kNumNeighbors; ++j) {
+        EXPECT_EQ(
+            indices(j), reference_indices(j) < 0
+                            ? -1
+                            : kept_indices[reference_indices(j)]);
+        EXPECT_EQ(distances(j), reference_distances(j));
+      }
+    }
+  };
+  expect_same_neighbors_as_reference();
+
+  // Descriptors added between the compaction and applying its result must be
+  // carried over.
+  TestableInvertedMultiIndex::CompactedInvertedFiles compacted;
+  index.CompactInvertedFiles(0.0, &compacted);
+  const Eigen::MatrixXf added_descriptors =
+      Eigen::MatrixXf::Random(6, 10).array().abs();
+  index.AddDescriptors(added_descriptors);
+  ASSERT_TRUE(index.ApplyCompactedInvertedFiles(&compacted));
+  EXPECT_EQ(index.GetNumRemovedEntries(), 0);
+  EXPECT_EQ(
+      index.GetNumDescriptorsInIndex(),
+      static_cast<int>(kept_indices.size()) + added_descriptors.cols());
+  size_t num_stored_descriptors = 0u;
+  for (const TestableInvertedMultiIndex::InvFile& inverted_file :
+       index.inverted_files_) {
+    num_stored_descriptors += inverted_file.indices_.size();
+  }
+  EXPECT_EQ(
+      num_stored_descriptors, kept_indices.size() + added_descriptors.cols());
+  for (int i = 0; i < added_descriptors.cols(); ++i) {
+    Eigen::VectorXi indices(1, 1);
+    Eigen::VectorXf distances(1, 1);
+    index.GetNNearestNeighbors(
+        added_descriptors.block<6, 1>(0, i), 1, indices, distances);
+    EXPECT_EQ(indices(0), descriptors.cols() + i);
+    EXPECT_EQ(distances(0), 0.f);
+  }
+
+  // A compaction result is stale once the index has been cleared.
+  index.RemoveDescriptors({static_cast<int>(descriptors.cols())});
+  index.CompactInvertedFiles(0.0, &compacted);
+  index.Clear();
+  EXPECT_FALSE(index.ApplyCompactedInvertedFiles(&compacted));
+}
+
+TEST_F(InvertedMultiIndexTest, VarintsRoundTrip) {
+  const std::vector<int32_t> values = {
+      0, 1, -1, 63, -64, 64, 127, 128, 300, -300, 1 << 20, -(1 << 30)};
+  std::vector<uint8_t> bytes;
+  for (const int32_t value : values) {
+    common::EncodeVarint(common::ZigZagEncode(value), &bytes);
+  }
+  // Values with a magnitude below 64 take a single byte.
+  EXPECT_EQ(bytes[0], 0u);
+  EXPECT_EQ(bytes[1], 2u);
+  EXPECT_EQ(bytes[2], 1u);
+  const uint8_t* position = bytes.data();
+  for (const int32_t value : values) {
+    EXPECT_EQ(common::ZigZagDecode(common::DecodeVarint(&position)), value);
+  }
+  EXPECT_EQ(position, bytes.data() + bytes.size());
+}
+
+TEST_F(InvertedMultiIndexTest, FrozenIndexGivesSameResults) {
+  FLAGS_lc_knn_epsilon = 0.2;
+  std::srand(42);
+  const Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(6, 500).array().abs();
+  const Eigen::MatrixXf query_descriptors =
+      Eigen::MatrixXf::Random(6, 40).array().abs();
+  std::vector<int> removed_indices;
+  for (int i = 0; i < descriptors.cols(); i += 7) {
+    removed_indices.push_back(i);
+  }
+
+  TestableInvertedMultiIndex reference_index(words1_, words2_, 10);
+  reference_index.AddDescriptors(descriptors);
+  reference_index.RemoveDescriptors(removed_indices);
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  index.AddDescriptors(descriptors);
+  index.RemoveDescriptors(removed_indices);
+
+  const size_t growable_memory_bytes = index.GetInvertedFilesMemoryUsageBytes();
+  index.Freeze();
+  EXPECT_TRUE(index.IsFrozen());
+  EXPECT_TRUE(index.inverted_files_.empty());
+  EXPECT_EQ(index.GetNumRemovedEntries(), 0);
+  EXPECT_EQ(
+      index.GetNumDescriptorsInIndex(),
+      reference_index.GetNumDescriptorsInIndex());
+  EXPECT_EQ(index.GetNumInvertedFiles(), reference_index.GetNumInvertedFiles());
+  EXPECT_LT(index.GetInvertedFilesMemoryUsageBytes(), growable_memory_bytes);
+
+  static constexpr int kNumNeighbors = 5;
+  auto expect_same_neighbors_as_reference = [&]() {
+    Eigen::MatrixXi reference_indices(kNumNeighbors, query_descriptors.cols());
+    Eigen::MatrixXf reference_distances(
+        kNumNeighbors, query_descriptors.cols());
+    reference_index.GetNNearestNeighborsForFeatures(
+        query_descriptors, kNumNeighbors, &reference_indices,
+        &reference_distances);
+    Eigen::MatrixXi batch_indices(kNumNeighbors, query_descriptors.cols());
+    Eigen::MatrixXf batch_distances(kNumNeighbors, query_descriptors.cols());
+    index.GetNNearestNeighborsForFeatures(
+        query_descriptors, kNumNeighbors, &batch_indices, &batch_distances);
+    // Missing neighbors have infinite distances, hence compare exactly.
+    EXPECT_TRUE((batch_indices.array() == reference_indices.array()).all());
+    EXPECT_TRUE(
+        (batch_distances.array() == reference_distances.array()).all());
+    for (int i = 0; i < query_descriptors.cols(); ++i) {
+      Eigen::VectorXi indices(kNumNeighbors, 1);
+      Eigen::VectorXf distances(kNumNeighbors, 1);
+      index.GetNNearestNeighbors(
+          query_descriptors.block<6, 1>(0, i), kNumNeighbors, indices,
+          distances);
+      EXPECT_TRUE((indices.array() == reference_indices.col(i).array()).all());
+    }
+  };
+  expect_same_neighbors_as_reference();
+
+  // Removing and compacting works on the frozen index.
+  const std::vector<int> more_removed_indices = {1, 2, 3, 450};
+  reference_index.RemoveDescriptors(more_removed_indices);
+  index.RemoveDescriptors(more_removed_indices);
+  expect_same_neighbors_as_reference();
+  index.Compact();
+  EXPECT_TRUE(index.IsFrozen());
+  EXPECT_EQ(index.GetNumRemovedEntries(), 0);
+  expect_same_neighbors_as_reference();
+
+  // Adding descriptors unfreezes the index.
+  const Eigen::MatrixXf added_descriptors =
+      Eigen::MatrixXf::Random(6, 10).array().abs();
+  reference_index.AddDescriptors(added_descriptors);
+  index.AddDescriptors(added_descriptors);
+  EXPECT_FALSE(index.IsFrozen());
+  expect_same_neighbors_as_reference();
+
+  // Frozen indices serialize like growable ones.
+  index.Freeze();
+  reference_index.Compact();
+  proto::InvertedMultiIndex frozen_proto;
+  index.serialize(&frozen_proto);
+  proto::InvertedMultiIndex reference_proto;
+  reference_index.serialize(&reference_proto);
+  EXPECT_EQ(
+      frozen_proto.SerializeAsString(), reference_proto.SerializeAsString());
+}
+
+TEST_F(InvertedMultiIndexTest, CandidateBudgetLimitsProbedWords) {
+  FLAGS_lc_knn_epsilon = 0.2;
+  std::srand(42);
+  const Eigen::MatrixXf descriptors =
+      Eigen::MatrixXf::Random(6, 500).array().abs();
+  const Eigen::MatrixXf query_descriptors =
+      Eigen::MatrixXf::Random(6, 40).array().abs();
+
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  index.AddDescriptors(descriptors);
+  size_t num_entries = 0u;
+  for (size_t file_idx = 0u; file_idx < index.GetNumInvertedFiles();
+       ++file_idx) {
+    num_entries += index.GetNumInvertedFileEntries(file_idx);
+  }
+  EXPECT_EQ(num_entries, static_cast<size_t>(descriptors.cols()));
+
+  static constexpr int kNumNeighbors = 5;
+  auto search = [&](int max_candidates, Eigen::MatrixXi* indices,
+                    Eigen::MatrixXf* distances) {
+    index.SetMaxCandidatesForNNSearch(max_candidates);
+    indices->resize(kNumNeighbors, query_descriptors.cols());
+    distances->resize(kNumNeighbors, query_descriptors.cols());
+    index.GetNNearestNeighborsForFeatures(
+        query_descriptors, kNumNeighbors, indices, distances);
+    for (int i = 0; i < query_descriptors.cols(); ++i) {
+      Eigen::VectorXi query_indices(kNumNeighbors, 1);
+      Eigen::VectorXf query_distances(kNumNeighbors, 1);
+      index.GetNNearestNeighbors(
+          query_descriptors.block<6, 1>(0, i), kNumNeighbors, query_indices,
+          query_distances);
+      EXPECT_TRUE((query_indices.array() == indices->col(i).array()).all());
+      EXPECT_TRUE(
+          (query_distances.array() == distances->col(i).array()).all());
+    }
+  };
+
+  Eigen::MatrixXi unlimited_indices, large_budget_indices, small_budget_indices;
+  Eigen::MatrixXf unlimited_distances, large_budget_distances,
+      small_budget_distances;
+  search(0, &unlimited_indices, &unlimited_distances);
+  search(
+      descriptors.cols() + 1, &large_budget_indices, &large_budget_distances);
+  EXPECT_TRUE(
+      (large_budget_indices.array() == unlimited_indices.array()).all());
+  EXPECT_TRUE(
+      (large_budget_distances.array() == unlimited_distances.array()).all());
+
+  // Fewer descriptors are compared, so the neighbors can only be farther.
+  search(20, &small_budget_indices, &small_budget_distances);
+  EXPECT_TRUE(
+      (small_budget_distances.array() >= unlimited_distances.array()).all());
+  EXPECT_FALSE(
+      (small_budget_distances.array() == unlimited_distances.array()).all());
+}
 }  // namespace
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
@@ -47,6 +47,22 @@ class LoopClosureHandler {
 
   typedef vi_map::MissionBaseFrameMap MissionBaseFrameMap;
 
+  // The changes to the map that follow from a verified loop closure.
+  struct LoopClosureMapUpdate {
+    pose_graph::VertexId query_vertex_id;
+    pose::Transformation T_G_I_ransac;
+    bool merge_landmarks = false;
+    // Only set if the landmarks are merged.
+    std::vector<int> inliers;
+    LandmarkToLandmarkVector query_landmark_to_map_landmark_pairs;
+    KeypointToLandmarkVector query_keypoint_idx_to_map_landmark_pairs;
+    // Only valid if a loop-closure edge is added.
+    pose_graph::VertexId lc_edge_target_vertex_id;
+    vi_map::LandmarkIdSet commonly_observed_landmarks;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
   friend class LoopClosureHandlerTest;
 
   explicit LoopClosureHandler(vi_map::VIMap* map,
@@ -85,6 +101,38 @@ class LoopClosureHandler {
       pose_graph::VertexId* vertex_id_closest_to_structure_matches,
       std::mutex* map_mutex, bool use_random_pnp_seed = true) const;
 
+  // Same as handleLoopClosure, but doesn't modify the map or take any locks.
+  // The map changes of an accepted loop closure are returned in map_update
+  // and can be applied later with applyMapUpdate, which allows querying many
+  // vertices of an unchanging map in parallel.
+  bool estimateLoopClosure(
+      const vi_map::LoopClosureConstraint& loop_closure_constraint,
+      bool merge_matching_landmarks, bool add_loopclosure_edges,
+      int* num_inliers, double* inlier_ratio,
+      pose::Transformation* T_G_I_ransac,
+      vi_map::LoopClosureConstraint* inlier_constraints,
+      LoopClosureMapUpdate* map_update, bool use_random_pnp_seed = true) const;
+
+  // Same as estimateLoopClosure, but verifies the matches with the given pose
+  // instead of RANSAC. The matches whose landmarks reproject close to their
+  // keypoints are the inliers, and T_G_I is set to the given pose. This is
+  // much cheaper than RANSAC if the pose is known well, e.g. from a verified
+  // neighbor of the query vertex.
+  bool verifyLoopClosureWithPose(
+      const vi_map::LoopClosureConstraint& loop_closure_constraint,
+      const pose::Transformation& T_G_I_prior, bool merge_matching_landmarks,
+      bool add_loopclosure_edges, int* num_inliers, double* inlier_ratio,
+      pose::Transformation* T_G_I,
+      vi_map::LoopClosureConstraint* inlier_constraints,
+      LoopClosureMapUpdate* map_update) const;
+
+  // Merges the landmarks or adds the loop-closure edge of an accepted loop
+  // closure. Landmarks that have been merged since the estimation are
+  // resolved to the landmarks they were merged into.
+  void applyMapUpdate(
+      const LoopClosureMapUpdate& map_update,
+      MergedLandmark3dPositionVector* landmark_pairs_merged) const;
+
   void updateQueryKeyframeInvalidLandmarkAssociations(
       const std::vector<int>& inliers,
       const KeypointToLandmarkVector& query_keypoint_idx_to_landmark_pairs,
@@ -96,6 +144,20 @@ class LoopClosureHandler {
       MergedLandmark3dPositionVector* landmark_pairs_actually_merged) const;
 
  private:
+  bool estimateLoopClosure(
+      const aslam::VisualNFrame& query_vertex_n_frame,
+      const std::vector<vi_map::LandmarkIdList>& query_vertex_landmark_ids,
+      const pose_graph::VertexId& query_vertex_id,
+      const vi_map::VertexKeyPointToStructureMatchList& structure_matches,
+      bool merge_matching_landmarks, bool add_loopclosure_edges,
+      int* num_inliers, double* inlier_ratio,
+      pose::Transformation* T_G_I_ransac,
+      vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches,
+      pose_graph::VertexId* vertex_id_closest_to_structure_matches,
+      std::mutex* map_mutex, bool use_random_pnp_seed,
+      const pose::Transformation* T_G_I_prior,
+      LoopClosureMapUpdate* map_update) const;
+
   inline Eigen::Vector3d getLandmark_p_G_fi(
       const vi_map::LandmarkId landmark_id) const {
     if (map_ != nullptr) {
@@ -0,0 +1,65 @@
+#ifndef LOOP_CLOSURE_HANDLER_LOOP_DETECTOR_CACHE_H_
+#define LOOP_CLOSURE_HANDLER_LOOP_DETECTOR_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "loop-closure-handler/loop-detector-node.h"
+
+namespace loop_detector_node {
+
+// Process-wide cache of the loop-closure databases built from missions of a
+// map, such that consecutive commands, e.g. loop-closure, anchoring and
+// localization evaluation, don't build the same database over and over. A
+// database is reused as long as the topology and the landmarks of the map and
+// all lc_* flags are unchanged, otherwise it is rebuilt on the next request.
+class LoopDetectorCache {
+ public:
+  static LoopDetectorCache& getInstance();
+
+  // Returns the database of the given missions of the map and builds it if
+  // there is no valid one. If a valid database of a subset of the missions is
+  // not in use, the missing missions are added to it instead.
+  LoopDetectorNode::ConstPtr getDatabase(
+      const vi_map::MissionIdSet& mission_ids, const vi_map::VIMap& map);
+
+  // Drops all databases, e.g. before the map is deleted.
+  void clear();
+
+  size_t numCachedDatabases() const;
+  size_t numHits() const;
+  size_t numMisses() const;
+
+ private:
+  struct Entry {
+    const vi_map::VIMap* map;
+    vi_map::MissionIdSet mission_ids;
+    uint64_t topology_revision;
+    uint64_t landmark_revision;
+    std::string settings;
+    LoopDetectorNode::Ptr database;
+  };
+
+  LoopDetectorCache();
+
+  // The name and value of all flags the database depends on.
+  static std::string getSettings();
+  bool isUpToDate(
+      const Entry& entry, const vi_map::VIMap& map,
+      const std::string& settings) const;
+
+  // The most recently used entry comes first.
+  std::list<Entry> entries_;
+  size_t num_hits_;
+  size_t num_misses_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace loop_detector_node
+
+#endif  // LOOP_CLOSURE_HANDLER_LOOP_DETECTOR_CACHE_H_
@@ -49,7 +49,7 @@ class LoopDetectorNode final
   LoopDetectorNode();
 
   void detectLoopClosuresAndMergeLandmarks(
-      const MissionId& mission, vi_map::VIMap* map);
+      const MissionId& mission, vi_map::VIMap* map) const;
 
   void addVertexToDatabase(
       const pose_graph::VertexId& vertex_id, const vi_map::VIMap& map);
@@ -59,8 +59,20 @@ class LoopDetectorNode final
   void addVerticesToDatabase(
       const pose_graph::VertexIdList& vertex_ids, const vi_map::VIMap& map);
 
+  // Removes the frames of the vertices from the database, e.g. after they
+  // have been removed from the map.
+  void removeVerticesFromDatabase(const pose_graph::VertexIdList& vertex_ids);
+
   bool hasMissionInDatabase(const vi_map::MissionId& mission_id) const;
 
+  // Projects the descriptors of all frames of the missions and stores them in
+  // the map, such that they are not projected again when the frames are added
+  // to or searched in a database, see --lc_use_stored_projected_descriptors.
+  // Frames that already store the descriptors of this projection are skipped.
+  // Returns the number of frames whose descriptors were stored.
+  size_t storeProjectedDescriptorsInMap(
+      const vi_map::MissionIdList& mission_ids, vi_map::VIMap* map) const;
+
   void addLandmarkSetToDatabase(
       const vi_map::LandmarkIdSet& landmark_id_set,
       const vi_map::VIMap& map);
@@ -88,6 +100,23 @@ class LoopDetectorNode final
       vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
       const;
 
+  // Same as above, but only keeps the matches to summary map landmarks within
+  // search_radius_meters of the position prior G_p_I_prior. Returns without
+  // querying the database if too few landmarks are within the radius.
+  bool findNFrameInSummaryMapDatabase(
+      const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const Eigen::Vector3d& G_p_I_prior, const double search_radius_meters,
+      pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+      vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+      const;
+
+  // Projects binary descriptors into the space of the descriptors stored in
+  // the database, e.g. the projected descriptors of a summary map.
+  void projectDescriptors(
+      const aslam::VisualFrame::DescriptorsT& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const;
+
   void detectLoopClosuresMissionToDatabase(
       const MissionId& mission_id, const bool merge_landmarks,
       const bool add_lc_edges, int* num_vertex_candidate_links,
@@ -104,7 +133,17 @@ class LoopDetectorNode final
 
   void instantiateVisualizer();
 
+  // Limits the threads that query the vertices of a mission in parallel, e.g.
+  // if loop-closure runs in the background of an online pipeline. All
+  // hardware threads are used if zero, which is the default.
+  void setMaxNumQueryThreads(const size_t max_num_query_threads) {
+    max_num_query_threads_ = max_num_query_threads;
+  }
+
   void clear();
+  // Converts the database into a read-optimized layout once it is complete,
+  // e.g. before localization starts.
+  void freezeDatabase();
 
   std::string printStatus() const;
 
@@ -154,6 +193,15 @@ class LoopDetectorNode final
       KeyframeToKeypointReindexMap* keyframe_to_keypoint_reindexing,
       vi_map::LandmarkIdList* observed_landmark_ids) const;
 
+  // G_p_I_prior may be NULL, all matches are kept then.
+  bool findNFrameInSummaryMapDatabaseWithOptionalPrior(
+      const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const Eigen::Vector3d* G_p_I_prior, const double search_radius_meters,
+      pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+      vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+      const;
+
   bool handleLoopClosures(
       const vi_map::LoopClosureConstraint& constraint,
       const bool merge_landmarks, const bool add_lc_edges, int* num_inliers,
@@ -186,16 +234,44 @@ class LoopDetectorNode final
       vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches,
       pose_graph::VertexId* vertex_id_closest_to_structure_matches) const;
 
-  void queryVertexInDatabase(
-      const pose_graph::VertexId& query_vertex_id, const bool merge_landmarks,
-      const bool add_lc_edges, vi_map::VIMap* map,
-      vi_map::LoopClosureConstraint* raw_constraint,
-      vi_map::LoopClosureConstraint* inlier_constraint,
-      std::vector<double>* inlier_ratios,
-      aslam::TransformationVector* T_G_M2_vector,
-      loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
-          landmark_pairs_merged,
-      std::mutex* map_mutex) const;
+  // The outcome of querying a single vertex of the map in the database.
+  struct VertexQueryResult {
+    vi_map::LoopClosureConstraint raw_constraint;
+    vi_map::LoopClosureConstraint inlier_constraint;
+    bool ransac_ok = false;
+    double inlier_ratio = 0.0;
+    pose::Transformation T_G_M2;
+    // Only valid if ransac_ok is set.
+    loop_closure_handler::LoopClosureHandler::LoopClosureMapUpdate map_update;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  // Only reads the map, so that many vertices can be queried in parallel
+  // without locking. Sets the raw constraint of the result if the vertex has
+  // matches in the database.
+  void findVertexMatchesInDatabase(
+      const pose_graph::VertexId& query_vertex_id, const vi_map::VIMap& map,
+      VertexQueryResult* result) const;
+
+  // Groups the query vertices that revisit the same place into islands, see
+  // --lc_verify_query_islands. The islands hold indices into vertices and
+  // are ordered by decreasing number of matches. Vertices without matches
+  // are left out.
+  void groupQueryVerticesIntoIslands(
+      const pose_graph::VertexIdList& vertices,
+      const Aligned<std::vector, VertexQueryResult>& results,
+      const vi_map::VIMap& map,
+      std::vector<std::vector<size_t>>* islands) const;
+
+  // Estimates the pose of the vertices of an island. Only reads the map, the
+  // map changes are applied afterwards from the results.
+  void verifyQueryIsland(
+      const std::vector<size_t>& island,
+      const pose_graph::VertexIdList& vertices, const bool merge_landmarks,
+      const bool add_lc_edges, const vi_map::VIMap& map,
+      const loop_closure_handler::LoopClosureHandler& handler,
+      Aligned<std::vector, VertexQueryResult>* results) const;
 
   loop_closure_visualization::LoopClosureVisualizer::UniquePtr visualizer_;
   std::shared_ptr<loop_detector::LoopDetector> loop_detector_;
@@ -204,6 +280,7 @@ class LoopDetectorNode final
   // The filename of the serialization file.
   static const std::string serialization_filename_;
   const bool use_random_pnp_seed_;
+  size_t max_num_query_threads_;
 
   // A mapping from the merged landmark id (does not exist anymore) to the
   // landmark id it was merged into (and should exist).
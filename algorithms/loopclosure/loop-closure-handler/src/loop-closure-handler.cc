@@ -1,7 +1,16 @@
 #include "loop-closure-handler/loop-closure-handler.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <aslam/common/statistics/statistics.h>
+#include <aslam/common/timer.h>
 #include <aslam/geometric-vision/pnp-pose-estimator.h>
+#include <geometric-vision/prosac-non-central-pnp.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/landmark-quality-metrics.h>
 
@@ -18,6 +27,24 @@ DEFINE_int32(
 DEFINE_bool(
     lc_nonlinear_refinement_p3p, false,
     "If nonlinear refinement on all ransac inliers should be run.");
+DEFINE_bool(
+    lc_use_prosac_pnp, true,
+    "Verify loop-closure candidates with PROSAC and adaptive termination "
+    "instead of running lc_num_ransac_iters RANSAC iterations.");
+DEFINE_double(
+    lc_ransac_confidence, 0.99,
+    "Confidence of finding the best pose after which the PROSAC verification "
+    "terminates early.");
+DEFINE_int32(
+    lc_ransac_num_threads, 1,
+    "Number of threads that score the PROSAC hypotheses of a loop-closure "
+    "candidate. Candidates of different vertices are already verified in "
+    "parallel by the loop detector.");
+DEFINE_double(
+    lc_pose_verification_max_reprojection_error_px, 4.0,
+    "Matches whose landmarks reproject within this distance of the keypoint "
+    "are inliers when a candidate is verified with a known pose instead of "
+    "RANSAC.");
 DECLARE_double(lc_switch_variable_variance);
 
 DEFINE_double(
@@ -166,6 +193,152 @@ bool addLoopClosureEdge(
   return true;
 }
 
+// Matches are ranked by how ambiguous they are: a query keypoint or map
+// landmark with a single match is more likely to be correct than one with
+// many. Returns the column indices in order of decreasing quality.
+void rankMatchesByAmbiguity(
+    const LoopClosureHandler::KeypointToLandmarkVector&
+        query_keypoint_idx_to_map_landmark_pairs,
+    std::vector<int>* ranked_columns) {
+  CHECK_NOTNULL(ranked_columns);
+  std::unordered_map<FrameKeypointIndexPair, int> num_matches_per_keypoint;
+  std::unordered_map<vi_map::LandmarkId, int> num_matches_per_landmark;
+  for (const LoopClosureHandler::KeypointToLandmarkVector::value_type&
+           keypoint_landmark_pair : query_keypoint_idx_to_map_landmark_pairs) {
+    ++num_matches_per_keypoint[keypoint_landmark_pair.first];
+    ++num_matches_per_landmark[keypoint_landmark_pair.second];
+  }
+  const size_t num_matches = query_keypoint_idx_to_map_landmark_pairs.size();
+  std::vector<int> num_ambiguous_matches(num_matches);
+  for (size_t i = 0u; i < num_matches; ++i) {
+    num_ambiguous_matches[i] =
+        num_matches_per_keypoint[query_keypoint_idx_to_map_landmark_pairs[i]
+                                     .first] +
+        num_matches_per_landmark[query_keypoint_idx_to_map_landmark_pairs[i]
+                                     .second];
+  }
+  ranked_columns->resize(num_matches);
+  std::iota(ranked_columns->begin(), ranked_columns->end(), 0);
+  std::stable_sort(
+      ranked_columns->begin(), ranked_columns->end(),
+      [&num_ambiguous_matches](int lhs, int rhs) {
+        return num_ambiguous_matches[lhs] < num_ambiguous_matches[rhs];
+      });
+}
+
+// Every query keypoint contributes at most one inlier, so the number of
+// distinct query keypoints bounds the number of inliers.
+int getMaxNumInliers(
+    const LoopClosureHandler::KeypointToLandmarkVector&
+        query_keypoint_idx_to_map_landmark_pairs) {
+  std::unordered_set<FrameKeypointIndexPair> query_keypoints;
+  for (const LoopClosureHandler::KeypointToLandmarkVector::value_type&
+           keypoint_landmark_pair : query_keypoint_idx_to_map_landmark_pairs) {
+    query_keypoints.insert(keypoint_landmark_pair.first);
+  }
+  return static_cast<int>(query_keypoints.size());
+}
+
+// Runs PROSAC on the matches ranked by ambiguity. The returned inliers are
+// column indices of the measurements like the ones of the aslam estimator.
+void estimatePoseWithProsac(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const LoopClosureHandler::KeypointToLandmarkVector&
+        query_keypoint_idx_to_map_landmark_pairs,
+    const aslam::NCamera& ncamera, bool use_random_pnp_seed,
+    pose::Transformation* T_G_I_ransac, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iters) {
+  CHECK_NOTNULL(T_G_I_ransac);
+  CHECK_NOTNULL(inliers);
+  CHECK_NOTNULL(inlier_distances_to_model);
+  CHECK_NOTNULL(num_iters);
+  const int num_matches = measurements.cols();
+
+  std::vector<int> ranked_columns;
+  rankMatchesByAmbiguity(
+      query_keypoint_idx_to_map_landmark_pairs, &ranked_columns);
+  Eigen::Matrix2Xd ranked_measurements(2, num_matches);
+  Eigen::Matrix3Xd ranked_G_landmark_positions(3, num_matches);
+  std::vector<int> ranked_camera_indices(num_matches);
+  for (int i = 0; i < num_matches; ++i) {
+    ranked_measurements.col(i) = measurements.col(ranked_columns[i]);
+    ranked_G_landmark_positions.col(i) =
+        G_landmark_positions.col(ranked_columns[i]);
+    ranked_camera_indices[i] = measurement_camera_indices[ranked_columns[i]];
+  }
+
+  geometric_vision::ProsacNonCentralPnpSettings settings;
+  CHECK_GT(FLAGS_lc_num_ransac_iters, 0);
+  settings.max_iterations = static_cast<size_t>(FLAGS_lc_num_ransac_iters);
+  settings.confidence = FLAGS_lc_ransac_confidence;
+  settings.min_inlier_ratio = FLAGS_lc_min_inlier_ratio;
+  CHECK_GT(FLAGS_lc_ransac_num_threads, 0);
+  settings.num_threads = static_cast<size_t>(FLAGS_lc_ransac_num_threads);
+  settings.run_nonlinear_refinement = FLAGS_lc_nonlinear_refinement_p3p;
+  settings.use_random_seed = use_random_pnp_seed;
+  geometric_vision::ProsacNonCentralPnp pose_estimator(settings);
+  std::vector<int> ranked_inliers;
+  std::vector<double> ranked_inlier_distances_to_model;
+  pose_estimator.compute(
+      ranked_measurements, ranked_camera_indices, ranked_G_landmark_positions,
+      FLAGS_lc_ransac_pixel_sigma, ncamera, T_G_I_ransac, &ranked_inliers,
+      &ranked_inlier_distances_to_model, num_iters);
+  CHECK_EQ(ranked_inliers.size(), ranked_inlier_distances_to_model.size());
+
+  // Return the inliers in increasing column order.
+  std::vector<std::pair<int, double>> column_distance_pairs;
+  column_distance_pairs.reserve(ranked_inliers.size());
+  for (size_t i = 0u; i < ranked_inliers.size(); ++i) {
+    column_distance_pairs.emplace_back(
+        ranked_columns[ranked_inliers[i]], ranked_inlier_distances_to_model[i]);
+  }
+  std::sort(column_distance_pairs.begin(), column_distance_pairs.end());
+  inliers->clear();
+  inlier_distances_to_model->clear();
+  for (const std::pair<int, double>& column_distance_pair :
+       column_distance_pairs) {
+    inliers->push_back(column_distance_pair.first);
+    inlier_distances_to_model->push_back(column_distance_pair.second);
+  }
+}
+
+// Keeps the matches whose landmarks reproject close to their keypoints at the
+// given pose. The inliers are increasing column indices of the measurements
+// and the distances are the reprojection errors in pixels.
+void verifyPoseByReprojection(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions, const aslam::NCamera& ncamera,
+    const pose::Transformation& T_G_I, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model) {
+  CHECK_NOTNULL(inliers)->clear();
+  CHECK_NOTNULL(inlier_distances_to_model)->clear();
+  CHECK_EQ(measurements.cols(), G_landmark_positions.cols());
+  const pose::Transformation T_I_G = T_G_I.inverse();
+  const double max_error_squared =
+      FLAGS_lc_pose_verification_max_reprojection_error_px *
+      FLAGS_lc_pose_verification_max_reprojection_error_px;
+  for (int col = 0; col < measurements.cols(); ++col) {
+    const int camera_index = measurement_camera_indices[col];
+    const Eigen::Vector3d p_C = ncamera.get_T_C_B(camera_index) *
+                                (T_I_G * G_landmark_positions.col(col));
+    Eigen::Vector2d projected_keypoint;
+    const aslam::ProjectionResult projection_result =
+        ncamera.getCamera(camera_index).project3(p_C, &projected_keypoint);
+    if (!projection_result.isKeypointVisible()) {
+      continue;
+    }
+    const double error_squared =
+        (projected_keypoint - measurements.col(col)).squaredNorm();
+    if (error_squared <= max_error_squared) {
+      inliers->push_back(col);
+      inlier_distances_to_model->push_back(std::sqrt(error_squared));
+    }
+  }
+}
+
 LoopClosureHandler::LoopClosureHandler(
     vi_map::VIMap* map, LandmarkToLandmarkMap* landmark_id_old_to_new)
     : map_(CHECK_NOTNULL(map)), summary_map_(nullptr),
@@ -213,6 +386,69 @@ bool LoopClosureHandler::handleLoopClosure(
       use_random_pnp_seed);
 }
 
+bool LoopClosureHandler::estimateLoopClosure(
+    const vi_map::LoopClosureConstraint& loop_closure_constraint,
+    bool merge_matching_landmarks, bool add_loopclosure_edges, int* num_inliers,
+    double* inlier_ratio, pose::Transformation* T_G_I_ransac,
+    vi_map::LoopClosureConstraint* inlier_constraints,
+    LoopClosureMapUpdate* map_update, bool use_random_pnp_seed) const {
+  CHECK_NOTNULL(map_);
+  CHECK_NOTNULL(inlier_constraints);
+  CHECK_NOTNULL(map_update);
+
+  const pose_graph::VertexId& query_vertex_id =
+      loop_closure_constraint.query_vertex_id;
+  const vi_map::Vertex& query_vertex = map_->getVertex(query_vertex_id);
+
+  inlier_constraints->query_vertex_id = query_vertex_id;
+
+  std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
+  query_vertex.getAllObservedLandmarkIds(&query_vertex_observed_landmark_ids);
+
+  constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches = nullptr;
+  constexpr std::mutex* kNoMapMutex = nullptr;
+  constexpr pose::Transformation* kNoPosePrior = nullptr;
+  return estimateLoopClosure(
+      query_vertex.getVisualNFrame(), query_vertex_observed_landmark_ids,
+      query_vertex_id, loop_closure_constraint.structure_matches,
+      merge_matching_landmarks, add_loopclosure_edges, num_inliers,
+      inlier_ratio, T_G_I_ransac, &inlier_constraints->structure_matches,
+      kVertexIdClosestToStructureMatches, kNoMapMutex, use_random_pnp_seed,
+      kNoPosePrior, map_update);
+}
+
+bool LoopClosureHandler::verifyLoopClosureWithPose(
+    const vi_map::LoopClosureConstraint& loop_closure_constraint,
+    const pose::Transformation& T_G_I_prior, bool merge_matching_landmarks,
+    bool add_loopclosure_edges, int* num_inliers, double* inlier_ratio,
+    pose::Transformation* T_G_I,
+    vi_map::LoopClosureConstraint* inlier_constraints,
+    LoopClosureMapUpdate* map_update) const {
+  CHECK_NOTNULL(map_);
+  CHECK_NOTNULL(inlier_constraints);
+  CHECK_NOTNULL(map_update);
+
+  const pose_graph::VertexId& query_vertex_id =
+      loop_closure_constraint.query_vertex_id;
+  const vi_map::Vertex& query_vertex = map_->getVertex(query_vertex_id);
+
+  inlier_constraints->query_vertex_id = query_vertex_id;
+
+  std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
+  query_vertex.getAllObservedLandmarkIds(&query_vertex_observed_landmark_ids);
+
+  constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches = nullptr;
+  constexpr std::mutex* kNoMapMutex = nullptr;
+  constexpr bool kUseRandomPnpSeed = false;
+  return estimateLoopClosure(
+      query_vertex.getVisualNFrame(), query_vertex_observed_landmark_ids,
+      query_vertex_id, loop_closure_constraint.structure_matches,
+      merge_matching_landmarks, add_loopclosure_edges, num_inliers,
+      inlier_ratio, T_G_I, &inlier_constraints->structure_matches,
+      kVertexIdClosestToStructureMatches, kNoMapMutex, kUseRandomPnpSeed,
+      &T_G_I_prior, map_update);
+}
+
 bool LoopClosureHandler::handleLoopClosure(
     const aslam::VisualNFrame& query_vertex_n_frame,
     const std::vector<vi_map::LandmarkIdList>& query_vertex_landmark_ids,
@@ -224,13 +460,47 @@ bool LoopClosureHandler::handleLoopClosure(
     MergedLandmark3dPositionVector* landmark_pairs_merged,
     pose_graph::VertexId* vertex_id_closest_to_structure_matches,
     std::mutex* map_mutex, bool use_random_pnp_seed) const {
+  CHECK_NOTNULL(landmark_pairs_merged);
+  CHECK_NOTNULL(map_mutex);
+  // Note: vertex_id_closest_to_structure_matches is optional and may be NULL.
+  LoopClosureMapUpdate map_update;
+  constexpr pose::Transformation* kNoPosePrior = nullptr;
+  if (!estimateLoopClosure(
+          query_vertex_n_frame, query_vertex_landmark_ids, query_vertex_id,
+          structure_matches, merge_matching_landmarks, add_loopclosure_edges,
+          num_inliers, inlier_ratio, T_G_I_ransac, inlier_structure_matches,
+          vertex_id_closest_to_structure_matches, map_mutex,
+          use_random_pnp_seed, kNoPosePrior, &map_update)) {
+    return false;
+  }
+  if (map_update.merge_landmarks ||
+      map_update.lc_edge_target_vertex_id.isValid()) {
+    std::lock_guard<std::mutex> map_lock(*map_mutex);
+    applyMapUpdate(map_update, landmark_pairs_merged);
+  }
+  return true;
+}
+
+bool LoopClosureHandler::estimateLoopClosure(
+    const aslam::VisualNFrame& query_vertex_n_frame,
+    const std::vector<vi_map::LandmarkIdList>& query_vertex_landmark_ids,
+    const pose_graph::VertexId& query_vertex_id,
+    const vi_map::VertexKeyPointToStructureMatchList& structure_matches,
+    bool merge_matching_landmarks, bool add_loopclosure_edges, int* num_inliers,
+    double* inlier_ratio, pose::Transformation* T_G_I_ransac,
+    vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches,
+    pose_graph::VertexId* vertex_id_closest_to_structure_matches,
+    std::mutex* map_mutex, bool use_random_pnp_seed,
+    const pose::Transformation* T_G_I_prior,
+    LoopClosureMapUpdate* map_update) const {
   CHECK_NOTNULL(num_inliers);
   CHECK_NOTNULL(inlier_ratio);
   CHECK_NOTNULL(T_G_I_ransac);
   CHECK_NOTNULL(inlier_structure_matches)->clear();
-  CHECK_NOTNULL(landmark_pairs_merged);
-  CHECK_NOTNULL(map_mutex);
+  CHECK_NOTNULL(map_update);
   // Note: vertex_id_closest_to_structure_matches is optional and may be NULL.
+  // The map mutex may be NULL if the map isn't modified concurrently.
+  // T_G_I_prior is optional, the matches are verified with RANSAC if NULL.
   T_G_I_ransac->setIdentity();
 
   CHECK_EQ(
@@ -271,7 +541,10 @@ bool LoopClosureHandler::handleLoopClosure(
   int col_idx = 0;
   for (const vi_map::VertexKeyPointToStructureMatch& structure_match :
        structure_matches) {
-    map_mutex->lock();
+    std::unique_lock<std::mutex> map_lock;
+    if (map_mutex != nullptr) {
+      map_lock = std::unique_lock<std::mutex>(*map_mutex);
+    }
     vi_map::LandmarkId db_landmark_id = getLandmarkIdAfterMerges(
         structure_match.landmark_result);
 
@@ -306,7 +579,9 @@ bool LoopClosureHandler::handleLoopClosure(
         query_vertex_n_frame.getFrame(structure_match.frame_index_query)
             .getKeypointMeasurement(structure_match.keypoint_index_query);
     G_landmark_positions.col(col_idx) = getLandmark_p_G_fi(db_landmark_id);
-    map_mutex->unlock();
+    if (map_lock.owns_lock()) {
+      map_lock.unlock();
+    }
 
     // Set the frame correspondence to the correct frame for multi-camera
     // systems. We do this for the single-camera case as well.
@@ -353,19 +628,53 @@ bool LoopClosureHandler::handleLoopClosure(
   query_landmark_to_map_landmark_pairs.resize(col_idx);
   measurement_camera_indices.resize(col_idx);
 
-  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
-      FLAGS_lc_nonlinear_refinement_p3p, use_random_pnp_seed);
+  // Bail if the candidate cannot reach the inlier thresholds even if all
+  // query keypoints were inliers.
+  const int max_num_inliers =
+      getMaxNumInliers(query_keypoint_idx_to_map_landmark_pairs);
+  if (max_num_inliers < FLAGS_lc_min_inlier_count ||
+      static_cast<double>(max_num_inliers) <
+          FLAGS_lc_min_inlier_ratio * static_cast<double>(valid_matches)) {
+    VLOG(2) << "Bailing out because too few distinct query keypoints. "
+            << "(#keypoints: " << max_num_inliers
+            << " vs. #valid matches: " << valid_matches << ")";
+    statistics::StatsCollector stats(
+        "LC bailed because too few distinct query keypoints.");
+    stats.IncrementOne();
+    return false;
+  }
+
   std::vector<int> inliers;
   std::vector<double> inlier_distances_to_model;
   int num_iters;
 
   aslam::NCamera::ConstPtr ncamera = query_vertex_n_frame.getNCameraShared();
   CHECK(ncamera != nullptr);
-  pose_estimator.absoluteMultiPoseRansacPinholeCam(
-      measurements, measurement_camera_indices, G_landmark_positions,
-      FLAGS_lc_ransac_pixel_sigma, FLAGS_lc_num_ransac_iters, ncamera,
-      T_G_I_ransac, &inliers, &inlier_distances_to_model, &num_iters);
+  timing::Timer timer_verification("Loop Closure: Verify candidate");
+  if (T_G_I_prior != nullptr) {
+    *T_G_I_ransac = *T_G_I_prior;
+    verifyPoseByReprojection(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        *ncamera, *T_G_I_prior, &inliers, &inlier_distances_to_model);
+    num_iters = 0;
+  } else if (FLAGS_lc_use_prosac_pnp) {
+    estimatePoseWithProsac(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        query_keypoint_idx_to_map_landmark_pairs, *ncamera,
+        use_random_pnp_seed, T_G_I_ransac, &inliers,
+        &inlier_distances_to_model, &num_iters);
+  } else {
+    aslam::geometric_vision::PnpPoseEstimator pose_estimator(
+        FLAGS_lc_nonlinear_refinement_p3p, use_random_pnp_seed);
+    pose_estimator.absoluteMultiPoseRansacPinholeCam(
+        measurements, measurement_camera_indices, G_landmark_positions,
+        FLAGS_lc_ransac_pixel_sigma, FLAGS_lc_num_ransac_iters, ncamera,
+        T_G_I_ransac, &inliers, &inlier_distances_to_model, &num_iters);
+  }
+  timer_verification.Stop();
   CHECK_EQ(inliers.size(), inlier_distances_to_model.size());
+  statistics::StatsCollector stats_num_iters("LC RANSAC iterations");
+  stats_num_iters.AddSample(num_iters);
 
   KeypointToInlierIndexWithReprojectionErrorMap
       keypoint_to_best_structure_match;
@@ -439,25 +748,11 @@ bool LoopClosureHandler::handleLoopClosure(
 
   if (merge_matching_landmarks) {
     CHECK_NOTNULL(map_);
-    std::lock_guard<std::mutex> map_lock(*map_mutex);
-
     // This case should be only handled if a valid query_vertex_id is
     // provided.
     CHECK(query_vertex_id.isValid())
         << "Merging landmark is not possible "
         << "if no valid query_vertex_id is provided.";
-
-    // Also reassociates keypoints of the query frame.
-    mergeLandmarks(
-        inliers, query_landmark_to_map_landmark_pairs, landmark_pairs_merged);
-
-    // Some of the query frame keypoints may have invalid landmark ids
-    // (which means the landmark object don't exist right now), but they
-    // were matched to an existing map landmark. We should handle that
-    // separately, as it's not true landmark merge.
-    vi_map::Vertex& query_vertex = map_->getVertex(query_vertex_id);
-    updateQueryKeyframeInvalidLandmarkAssociations(
-        inliers, query_keypoint_idx_to_map_landmark_pairs, &query_vertex);
   }
   vi_map::LandmarkIdSet commonly_observed_landmarks;
   if (vertex_id_closest_to_structure_matches != nullptr) {
@@ -490,10 +785,9 @@ bool LoopClosureHandler::handleLoopClosure(
         }
         CHECK(lc_edge_target_vertex_id.isValid());
         CHECK(!commonly_observed_landmarks.empty());
-        std::lock_guard<std::mutex> map_lock(*map_mutex);
-        addLoopClosureEdge(
-            query_vertex_id, commonly_observed_landmarks,
-            lc_edge_target_vertex_id, *T_G_I_ransac, map_);
+        map_update->lc_edge_target_vertex_id = lc_edge_target_vertex_id;
+        map_update->commonly_observed_landmarks.swap(
+            commonly_observed_landmarks);
       }
     }
   }
@@ -501,9 +795,49 @@ bool LoopClosureHandler::handleLoopClosure(
   VLOG(4) << "\transac success. Ransac pts: " << G_landmark_positions.cols()
           << " inliers: " << inliers.size()
           << " inlier ratio: " << *inlier_ratio << '.';
+
+  map_update->query_vertex_id = query_vertex_id;
+  map_update->T_G_I_ransac = *T_G_I_ransac;
+  map_update->merge_landmarks = merge_matching_landmarks;
+  if (merge_matching_landmarks) {
+    map_update->inliers.swap(inliers);
+    map_update->query_landmark_to_map_landmark_pairs.swap(
+        query_landmark_to_map_landmark_pairs);
+    map_update->query_keypoint_idx_to_map_landmark_pairs.swap(
+        query_keypoint_idx_to_map_landmark_pairs);
+  }
   return true;
 }
 
+void LoopClosureHandler::applyMapUpdate(
+    const LoopClosureMapUpdate& map_update,
+    MergedLandmark3dPositionVector* landmark_pairs_merged) const {
+  CHECK_NOTNULL(map_);
+  CHECK_NOTNULL(landmark_pairs_merged);
+  CHECK(map_update.query_vertex_id.isValid());
+
+  if (map_update.merge_landmarks) {
+    // Also reassociates keypoints of the query frame.
+    mergeLandmarks(
+        map_update.inliers, map_update.query_landmark_to_map_landmark_pairs,
+        landmark_pairs_merged);
+
+    // Some of the query frame keypoints may have invalid landmark ids
+    // (which means the landmark object don't exist right now), but they
+    // were matched to an existing map landmark. We should handle that
+    // separately, as it's not true landmark merge.
+    vi_map::Vertex& query_vertex = map_->getVertex(map_update.query_vertex_id);
+    updateQueryKeyframeInvalidLandmarkAssociations(
+        map_update.inliers, map_update.query_keypoint_idx_to_map_landmark_pairs,
+        &query_vertex);
+  }
+  if (map_update.lc_edge_target_vertex_id.isValid()) {
+    addLoopClosureEdge(
+        map_update.query_vertex_id, map_update.commonly_observed_landmarks,
+        map_update.lc_edge_target_vertex_id, map_update.T_G_I_ransac, map_);
+  }
+}
+
 void LoopClosureHandler::updateQueryKeyframeInvalidLandmarkAssociations(
     const std::vector<int>& inliers,
     const KeypointToLandmarkVector& query_keypoint_idx_to_landmark_pairs,
@@ -559,6 +893,9 @@ void LoopClosureHandler::mergeLandmarks(
   statistics::StatsCollector stats_total_merge_calls(
       "0.4 Loop closure: Total merge calls");
 
+  std::vector<std::pair<vi_map::LandmarkId, vi_map::LandmarkId>>
+      landmark_id_pairs_to_merge;
+  landmark_id_pairs_to_merge.reserve(inliers.size());
   for (unsigned int i = 0; i < inliers.size(); ++i) {
     vi_map::LandmarkId query_landmark_to_be_deleted =
         query_landmark_to_map_landmark_pairs[inliers[i]].first;
@@ -612,12 +949,17 @@ void LoopClosureHandler::mergeLandmarks(
           map_->getLandmark_G_p_fi(map_landmark);
 
       stats_total_merge_calls.IncrementOne();
-      map_->mergeLandmarks(query_landmark_to_be_deleted, map_landmark);
+      landmark_id_pairs_to_merge.emplace_back(
+          query_landmark_to_be_deleted, map_landmark);
 
       landmark_pairs_actually_merged->emplace_back(
           p_G_landmark_query, p_G_landmark_map);
     }
   }
+
+  // The chains of merges are resolved through landmark_id_old_to_new_ above,
+  // all merges of this update rewrite the map in a single batch.
+  map_->mergeLandmarks(landmark_id_pairs_to_merge);
 }
 
 }  // namespace loop_closure_handler
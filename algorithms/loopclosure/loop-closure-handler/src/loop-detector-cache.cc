@@ -0,0 +1,148 @@
+#include "loop-closure-handler/loop-detector-cache.h"
+
+#include <algorithm>
+#include <sstream>  // NOLINT
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_int32(
+    lc_max_cached_databases, 2,
+    "Maximum number of loop-closure databases kept in memory to be reused by "
+    "subsequent commands on the same missions. Set to 0 to always build a new "
+    "database.");
+
+namespace loop_detector_node {
+namespace {
+bool isSubset(
+    const vi_map::MissionIdSet& subset, const vi_map::MissionIdSet& set) {
+  return std::all_of(
+      subset.begin(), subset.end(), [&set](const vi_map::MissionId& id) {
+        return set.count(id) > 0u;
+      });
+}
+}  // namespace
+
+LoopDetectorCache::LoopDetectorCache() : num_hits_(0u), num_misses_(0u) {}
+
+LoopDetectorCache& LoopDetectorCache::getInstance() {
+  static LoopDetectorCache instance;
+  return instance;
+}
+
+std::string LoopDetectorCache::getSettings() {
+  // Conservatively depends on all lc_* flags, also the ones only used for
+  // querying, and on the type of the descriptors.
+  std::vector<google::CommandLineFlagInfo> flags;
+  google::GetAllFlags(&flags);
+  std::ostringstream settings;
+  for (const google::CommandLineFlagInfo& flag : flags) {
+    if ((flag.name.compare(0u, 3u, "lc_") == 0 &&
+         flag.name != "lc_max_cached_databases") ||
+        flag.name == "feature_descriptor_type") {
+      settings << flag.name << '=' << flag.current_value << ';';
+    }
+  }
+  return settings.str();
+}
+
+bool LoopDetectorCache::isUpToDate(
+    const Entry& entry, const vi_map::VIMap& map,
+    const std::string& settings) const {
+  return entry.map == &map &&
+         entry.topology_revision == map.getTopologyRevision() &&
+         entry.landmark_revision == map.getLandmarkRevision() &&
+         entry.settings == settings;
+}
+
+LoopDetectorNode::ConstPtr LoopDetectorCache::getDatabase(
+    const vi_map::MissionIdSet& mission_ids, const vi_map::VIMap& map) {
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    CHECK(map.hasMission(mission_id));
+  }
+  const std::string settings = getSettings();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t max_num_entries =
+      static_cast<size_t>(std::max(FLAGS_lc_max_cached_databases, 0));
+  // Outdated databases of the map are dropped right away, the revisions of a
+  // map never go back.
+  entries_.remove_if([&map, &settings, this](const Entry& entry) {
+    return entry.map == &map && !isUpToDate(entry, map, settings);
+  });
+
+  std::list<Entry>::iterator extendable_entry = entries_.end();
+  for (std::list<Entry>::iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    if (it->map != &map) {
+      continue;
+    }
+    if (it->mission_ids == mission_ids) {
+      ++num_hits_;
+      VLOG(1) << "Reusing the cached loop-closure database of "
+              << mission_ids.size() << " missions.";
+      entries_.splice(entries_.begin(), entries_, it);
+      return entries_.front().database;
+    }
+    // Only the cache holds the database, so it can be extended.
+    if (extendable_entry == entries_.end() && it->database.use_count() == 1 &&
+        isSubset(it->mission_ids, mission_ids)) {
+      extendable_entry = it;
+    }
+  }
+  ++num_misses_;
+
+  LoopDetectorNode::Ptr database;
+  if (extendable_entry != entries_.end() && max_num_entries > 0u) {
+    VLOG(1) << "Extending the cached loop-closure database of "
+            << extendable_entry->mission_ids.size() << " missions.";
+    entries_.splice(entries_.begin(), entries_, extendable_entry);
+    database = entries_.front().database;
+  } else {
+    database.reset(new LoopDetectorNode);
+    if (max_num_entries > 0u) {
+      entries_.emplace_front();
+      entries_.front().map = &map;
+      entries_.front().database = database;
+    }
+  }
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    if (!database->hasMissionInDatabase(mission_id)) {
+      database->addMissionToDatabase(mission_id, map);
+    }
+  }
+  if (max_num_entries > 0u) {
+    Entry& entry = entries_.front();
+    entry.mission_ids = mission_ids;
+    entry.topology_revision = map.getTopologyRevision();
+    entry.landmark_revision = map.getLandmarkRevision();
+    entry.settings = settings;
+  }
+  while (entries_.size() > max_num_entries) {
+    entries_.pop_back();
+  }
+  return database;
+}
+
+void LoopDetectorCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+size_t LoopDetectorCache::numCachedDatabases() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t LoopDetectorCache::numHits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_hits_;
+}
+
+size_t LoopDetectorCache::numMisses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_misses_;
+}
+
+}  // namespace loop_detector_node
@@ -1,14 +1,16 @@
 #include "loop-closure-handler/loop-detector-node.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <mutex>
 #include <sstream>  // NOLINT
 #include <string>
+#include <vector>
 
 #include <Eigen/Geometry>
-#include <aslam/common/statistics/statistics.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <localization-summary-map/localization-summary-map.h>
@@ -19,6 +21,7 @@
 #include <maplab-common/parallel-process.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/telemetry.h>
 #include <matching-based-loopclosure/detector-settings.h>
 #include <matching-based-loopclosure/loop-detector-interface.h>
 #include <matching-based-loopclosure/matching-based-engine.h>
@@ -33,10 +36,90 @@ DEFINE_bool(
     "If underconstrained landmarks should be filtered for the "
     "loop-closure.");
 DEFINE_bool(lc_use_random_pnp_seed, true, "Use random seed for pnp RANSAC.");
+DEFINE_string(
+    lc_database_snapshot_file, "",
+    "If set, the loop-closure database of a localization summary map is "
+    "loaded from this snapshot file if it was built from the same summary map "
+    "and written to it otherwise.");
+DEFINE_bool(
+    lc_verify_query_islands, true,
+    "Group the query vertices that revisit the same place into islands. Only "
+    "the first vertex of an island is verified with RANSAC, the others are "
+    "checked by reprojection with the pose propagated from it by odometry.");
+DEFINE_double(
+    lc_query_island_max_time_gap_s, 3.0,
+    "Maximum time between two consecutive query vertices of an island.");
+DECLARE_int32(lc_min_inlier_count);
 
 namespace loop_detector_node {
+namespace {
+void addBytesToFingerprint(
+    const void* data, size_t num_bytes, uint64_t* fingerprint) {
+  CHECK_NOTNULL(fingerprint);
+  constexpr uint64_t kFnvPrime = 1099511628211ull;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0u; i < num_bytes; ++i) {
+    *fingerprint ^= bytes[i];
+    *fingerprint *= kFnvPrime;
+  }
+}
+
+template <typename IdType>
+void addIdsToFingerprint(
+    const std::vector<IdType>& ids, uint64_t* fingerprint) {
+  for (const IdType& id : ids) {
+    const size_t id_hash = id.hashToSizeT();
+    addBytesToFingerprint(&id_hash, sizeof(id_hash), fingerprint);
+  }
+}
+
+// FNV-1a hash of all data of the summary map the loop-closure database is
+// built from.
+uint64_t computeDatabaseSourceFingerprint(
+    const summary_map::LocalizationSummaryMap& localization_summary_map) {
+  uint64_t fingerprint = 14695981039346656037ull;
+  const int num_descriptors =
+      localization_summary_map.numProjectedDescriptors();
+  const int64_t descriptors_size[2] = {
+      localization_summary_map.projectedDescriptorDimensionality(),
+      num_descriptors};
+  addBytesToFingerprint(
+      descriptors_size, sizeof(descriptors_size), &fingerprint);
+  // Hashed in blocks, so quantized descriptors are never dequantized at once.
+  constexpr int kBlockSize = 4096;
+  Eigen::MatrixXf descriptor_block;
+  for (int first_descriptor = 0; first_descriptor < num_descriptors;
+       first_descriptor += kBlockSize) {
+    localization_summary_map.getProjectedDescriptors(
+        first_descriptor,
+        std::min(kBlockSize, num_descriptors - first_descriptor),
+        &descriptor_block);
+    addBytesToFingerprint(
+        descriptor_block.data(), descriptor_block.size() * sizeof(float),
+        &fingerprint);
+  }
+  for (const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>* indices :
+       {&localization_summary_map.observerIndices(),
+        &localization_summary_map.observationToLandmarkIndex()}) {
+    const int64_t num_indices = indices->rows();
+    addBytesToFingerprint(&num_indices, sizeof(num_indices), &fingerprint);
+    addBytesToFingerprint(
+        indices->data(), indices->size() * sizeof(unsigned int), &fingerprint);
+  }
+
+  pose_graph::VertexIdList observer_ids;
+  localization_summary_map.getAllObserverIds(&observer_ids);
+  addIdsToFingerprint(observer_ids, &fingerprint);
+  vi_map::LandmarkIdList landmark_ids;
+  localization_summary_map.getAllLandmarkIds(&landmark_ids);
+  addIdsToFingerprint(landmark_ids, &fingerprint);
+  return fingerprint;
+}
+}  // namespace
+
 LoopDetectorNode::LoopDetectorNode()
-    : use_random_pnp_seed_(FLAGS_lc_use_random_pnp_seed) {
+    : use_random_pnp_seed_(FLAGS_lc_use_random_pnp_seed),
+      max_num_query_threads_(0u) {
   matching_based_loopclosure::MatchingBasedEngineSettings
       matching_engine_settings;
   loop_detector_ =
@@ -131,8 +214,22 @@ void LoopDetectorNode::convertFrameToProjectedImageOnlyUsingProvidedLandmarkIds(
   const aslam::VisualFrame::DescriptorsT& original_descriptors =
       frame.getDescriptors();
 
-  aslam::VisualFrame::DescriptorsT valid_descriptors(
-      original_descriptors.rows(), original_descriptors.cols());
+  // The descriptors of frames whose projected descriptors are stored in the
+  // map are not projected again, the stored columns are selected instead.
+  Eigen::MatrixXf stored_projected_descriptors;
+  const bool use_stored_projected_descriptors =
+      FLAGS_lc_use_stored_projected_descriptors &&
+      descriptor_projection::GetStoredProjectedDescriptors(
+          map, frame_id, loop_detector_->GetProjectionFingerprint(),
+          &stored_projected_descriptors);
+
+  aslam::VisualFrame::DescriptorsT valid_descriptors;
+  if (!use_stored_projected_descriptors) {
+    valid_descriptors.resize(
+        original_descriptors.rows(), original_descriptors.cols());
+  }
+  std::vector<int> valid_keypoint_indices;
+  valid_keypoint_indices.reserve(original_measurements.cols());
   Eigen::Matrix2Xd valid_measurements(2, original_measurements.cols());
   vi_map::LandmarkIdList valid_landmark_ids(original_measurements.cols());
 
@@ -165,28 +262,46 @@ void LoopDetectorNode::convertFrameToProjectedImageOnlyUsingProvidedLandmarkIds(
         is_landmark_valid) {
       valid_measurements.col(num_valid_landmarks) =
           original_measurements.col(i);
-      valid_descriptors.col(num_valid_landmarks) = original_descriptors.col(i);
+      if (use_stored_projected_descriptors) {
+        valid_keypoint_indices.emplace_back(i);
+      } else {
+        valid_descriptors.col(num_valid_landmarks) =
+            original_descriptors.col(i);
+      }
       valid_landmark_ids[num_valid_landmarks] = observed_landmark_ids[i];
       ++num_valid_landmarks;
     }
   }
 
   valid_measurements.conservativeResize(Eigen::NoChange, num_valid_landmarks);
-  valid_descriptors.conservativeResize(Eigen::NoChange, num_valid_landmarks);
   valid_landmark_ids.resize(num_valid_landmarks);
 
   if (skip_invalid_landmark_ids) {
-    statistics::StatsCollector stats_landmarks("LC num_landmarks insertion");
-    stats_landmarks.AddSample(num_valid_landmarks);
+    static const common::telemetry::Metric kStatsLandmarks(
+        "LC num_landmarks insertion");
+    kStatsLandmarks.addSample(num_valid_landmarks);
   } else {
-    statistics::StatsCollector stats_landmarks("LC num_landmarks query");
-    stats_landmarks.AddSample(num_valid_landmarks);
+    static const common::telemetry::Metric kStatsLandmarks(
+        "LC num_landmarks query");
+    kStatsLandmarks.addSample(num_valid_landmarks);
   }
 
   projected_image->landmarks.swap(valid_landmark_ids);
   projected_image->measurements.swap(valid_measurements);
-  loop_detector_->ProjectDescriptors(
-      valid_descriptors, &projected_image->projected_descriptors);
+  if (use_stored_projected_descriptors) {
+    Eigen::MatrixXf& projected_descriptors =
+        projected_image->projected_descriptors;
+    projected_descriptors.resize(
+        stored_projected_descriptors.rows(), num_valid_landmarks);
+    for (int i = 0; i < num_valid_landmarks; ++i) {
+      projected_descriptors.col(i) =
+          stored_projected_descriptors.col(valid_keypoint_indices[i]);
+    }
+  } else {
+    valid_descriptors.conservativeResize(Eigen::NoChange, num_valid_landmarks);
+    loop_detector_->ProjectDescriptors(
+        valid_descriptors, &projected_image->projected_descriptors);
+  }
 }
 
 void LoopDetectorNode::convertLocalizationFrameToProjectedImage(
@@ -285,6 +400,12 @@ void LoopDetectorNode::addVertexToDatabase(
   }
 }
 
+void LoopDetectorNode::removeVerticesFromDatabase(
+    const pose_graph::VertexIdList& vertex_ids) {
+  loop_detector_->RemoveVertices(
+      pose_graph::VertexIdSet(vertex_ids.begin(), vertex_ids.end()));
+}
+
 bool LoopDetectorNode::hasMissionInDatabase(
     const vi_map::MissionId& mission_id) const {
   return missions_in_database_.count(mission_id) > 0u;
@@ -315,11 +436,70 @@ void LoopDetectorNode::addVerticesToDatabase(
   }
 }
 
+size_t LoopDetectorNode::storeProjectedDescriptorsInMap(
+    const vi_map::MissionIdList& mission_ids, vi_map::VIMap* map) const {
+  CHECK_NOTNULL(map);
+  const uint64_t projection_fingerprint =
+      loop_detector_->GetProjectionFingerprint();
+  pose_graph::VertexIdList vertex_ids;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList mission_vertex_ids;
+    map->getAllVertexIdsInMissionAlongGraph(mission_id, &mission_vertex_ids);
+    vertex_ids.insert(
+        vertex_ids.end(), mission_vertex_ids.begin(), mission_vertex_ids.end());
+  }
+
+  size_t num_stored_frames = 0u;
+  common::ProgressBar progress_bar(vertex_ids.size());
+  Eigen::MatrixXf projected_descriptors;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    progress_bar.increment();
+    const vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+         ++frame_idx) {
+      if (!vertex.isVisualFrameSet(frame_idx) ||
+          !vertex.isVisualFrameValid(frame_idx)) {
+        continue;
+      }
+      const vi_map::VisualFrameIdentifier frame_id(vertex_id, frame_idx);
+      if (descriptor_projection::GetStoredProjectedDescriptors(
+              *map, frame_id, projection_fingerprint, &projected_descriptors)) {
+        continue;
+      }
+      loop_detector_->ProjectDescriptors(
+          vertex.getVisualFrame(frame_idx).getDescriptors(),
+          &projected_descriptors);
+      descriptor_projection::StoreProjectedDescriptors(
+          frame_id, projected_descriptors, projection_fingerprint, map);
+      ++num_stored_frames;
+    }
+  }
+  return num_stored_frames;
+}
+
 void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
     const summary_map::LocalizationSummaryMap& localization_summary_map) {
   CHECK(
       summary_maps_in_database_.emplace(localization_summary_map.id()).second);
 
+  // The snapshot can only replace the database if it consists of this summary
+  // map alone.
+  const bool use_snapshot = !FLAGS_lc_database_snapshot_file.empty() &&
+                            loop_detector_->NumEntries() == 0u &&
+                            missions_in_database_.empty() &&
+                            summary_maps_in_database_.size() == 1u;
+  uint64_t source_fingerprint = 0u;
+  if (use_snapshot) {
+    source_fingerprint =
+        computeDatabaseSourceFingerprint(localization_summary_map);
+    if (loop_detector_->loadSnapshot(
+            FLAGS_lc_database_snapshot_file, source_fingerprint)) {
+      VLOG(1) << "Loaded the loop-closure database from the snapshot "
+              << FLAGS_lc_database_snapshot_file << ".";
+      return;
+    }
+  }
+
   pose_graph::VertexIdList observer_ids;
   localization_summary_map.getAllObserverIds(&observer_ids);
 
@@ -357,10 +537,12 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
   vi_map::LandmarkIdList observed_landmark_ids;
   localization_summary_map.getAllLandmarkIds(&observed_landmark_ids);
 
-  const Eigen::MatrixXf& projected_descriptors =
-      localization_summary_map.projectedDescriptors();
-
-  const int descriptor_dimensionality = projected_descriptors.rows();
+  const int num_descriptors =
+      localization_summary_map.numProjectedDescriptors();
+  const int descriptor_dimensionality =
+      localization_summary_map.projectedDescriptorDimensionality();
+  // Quantized descriptors are dequantized one at a time.
+  Eigen::MatrixXf projected_descriptor;
 
   const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
       observation_to_landmark_index =
@@ -389,9 +571,10 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
 
     for (size_t i = 0; i < observations.size(); ++i) {
       const int observation_index = observations[i];
-      CHECK_LT(observation_index, projected_descriptors.cols());
-      projected_image.projected_descriptors.col(i) =
-          projected_descriptors.col(observation_index);
+      CHECK_LT(observation_index, num_descriptors);
+      localization_summary_map.getProjectedDescriptors(
+          observation_index, 1, &projected_descriptor);
+      projected_image.projected_descriptors.col(i) = projected_descriptor;
 
       CHECK_LT(observation_index, observation_to_landmark_index.rows());
       const size_t landmark_index =
@@ -401,6 +584,13 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
     }
     loop_detector_->Insert(projected_image_ptr);
   }
+
+  if (use_snapshot &&
+      !loop_detector_->saveSnapshot(
+          FLAGS_lc_database_snapshot_file, source_fingerprint)) {
+    LOG(WARNING) << "Unable to write the loop-closure database snapshot "
+                 << FLAGS_lc_database_snapshot_file << ".";
+  }
 }
 
 void LoopDetectorNode::addLandmarkSetToDatabase(
@@ -449,14 +639,55 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
     pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
     vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
     const {
+  constexpr Eigen::Vector3d* kNoPrior = nullptr;
+  constexpr double kNoSearchRadius = 0.0;
+  return findNFrameInSummaryMapDatabaseWithOptionalPrior(
+      n_frame, skip_untracked_keypoints, localization_summary_map, kNoPrior,
+      kNoSearchRadius, T_G_I, num_of_lc_matches, inlier_structure_matches);
+}
+
+bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
+    const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const Eigen::Vector3d& G_p_I_prior, const double search_radius_meters,
+    pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+    vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+    const {
+  CHECK_GT(search_radius_meters, 0.0);
+  return findNFrameInSummaryMapDatabaseWithOptionalPrior(
+      n_frame, skip_untracked_keypoints, localization_summary_map,
+      &G_p_I_prior, search_radius_meters, T_G_I, num_of_lc_matches,
+      inlier_structure_matches);
+}
+
+bool LoopDetectorNode::findNFrameInSummaryMapDatabaseWithOptionalPrior(
+    const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const Eigen::Vector3d* G_p_I_prior, const double search_radius_meters,
+    pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
+    vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+    const {
   CHECK_NOTNULL(T_G_I);
   CHECK_NOTNULL(num_of_lc_matches);
   CHECK_NOTNULL(inlier_structure_matches);
+  // Note: G_p_I_prior is optional and may be NULL.
 
   CHECK(!summary_maps_in_database_.empty())
       << "No summary maps were added "
       << "to the database. This method only operates on summary maps.";
 
+  if (G_p_I_prior != nullptr && localization_summary_map.hasSpatialIndex()) {
+    std::vector<unsigned int> landmark_indices;
+    localization_summary_map.getLandmarkIndicesInRadius(
+        *G_p_I_prior, search_radius_meters, &landmark_indices);
+    if (static_cast<int>(landmark_indices.size()) < FLAGS_lc_min_inlier_count) {
+      VLOG(3) << "Only " << landmark_indices.size() << " summary map "
+              << "landmarks around the prior, skipping the database query.";
+      *num_of_lc_matches = 0u;
+      return false;
+    }
+  }
+
   loop_closure::FrameToMatches frame_matches_list;
 
   std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
@@ -465,7 +696,29 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
       n_frame, skip_untracked_keypoints, &query_vertex_observed_landmark_ids,
       num_of_lc_matches, &frame_matches_list);
 
-  timing::Timer timer_compute_relative("lc compute absolute transform");
+  if (G_p_I_prior != nullptr) {
+    const double search_radius_squared =
+        search_radius_meters * search_radius_meters;
+    for (loop_closure::FrameToMatches::value_type& frame_matches :
+         frame_matches_list) {
+      loop_closure::MatchVector& matches = frame_matches.second;
+      matches.erase(
+          std::remove_if(
+              matches.begin(), matches.end(),
+              [&](const loop_closure::Match& match) {
+                return (localization_summary_map.getGLandmarkPosition(
+                            match.landmark_result) -
+                        *G_p_I_prior)
+                           .squaredNorm() > search_radius_squared;
+              }),
+          matches.end());
+    }
+    *num_of_lc_matches = loop_closure::getNumberOfMatches(frame_matches_list);
+  }
+
+  static const common::telemetry::TimerMetric kTimerComputeRelative(
+      "lc compute absolute transform");
+  common::telemetry::ScopedTimer timer_compute_relative(kTimerComputeRelative);
   constexpr bool kMergeLandmarks = false;
   constexpr bool kAddLoopclosureEdges = false;
   loop_closure_handler::LoopClosureHandler handler(&localization_summary_map,
@@ -487,6 +740,13 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
   return success;
 }
 
+void LoopDetectorNode::projectDescriptors(
+    const aslam::VisualFrame::DescriptorsT& descriptors,
+    Eigen::MatrixXf* projected_descriptors) const {
+  CHECK_NOTNULL(projected_descriptors);
+  loop_detector_->ProjectDescriptors(descriptors, projected_descriptors);
+}
+
 bool LoopDetectorNode::findNFrameInDatabase(
     const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
     vi_map::VIMap* map, pose::Transformation* T_G_I,
@@ -507,7 +767,9 @@ bool LoopDetectorNode::findNFrameInDatabase(
       n_frame, skip_untracked_keypoints, &query_vertex_observed_landmark_ids,
       num_of_lc_matches, &frame_matches_list);
 
-  timing::Timer timer_compute_relative("lc compute absolute transform");
+  static const common::telemetry::TimerMetric kTimerComputeRelative(
+      "lc compute absolute transform");
+  common::telemetry::ScopedTimer timer_compute_relative(kTimerComputeRelative);
   constexpr bool kMergeLandmarks = false;
   constexpr bool kAddLoopclosureEdges = false;
   loop_closure_handler::LoopClosureHandler handler(map,
@@ -529,7 +791,9 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
 
   *num_of_lc_matches = 0u;
 
-  timing::Timer timer_preprocess("Loop Closure: preprocess frames");
+  static const common::telemetry::TimerMetric kTimerPreprocess(
+      "Loop Closure: preprocess frames");
+  common::telemetry::ScopedTimer timer_preprocess(kTimerPreprocess);
   const size_t num_frames = n_frame.getNumFrames();
   loop_closure::ProjectedImagePtrList projected_image_ptr_list;
   projected_image_ptr_list.reserve(num_frames);
@@ -561,7 +825,7 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
           &(*query_vertex_observed_landmark_ids)[frame_idx]);
     }
   }
-  timer_preprocess.Stop();
+  timer_preprocess.stop();
   constexpr bool kParallelFindIfPossible = true;
   loop_detector_->Find(
       projected_image_ptr_list, kParallelFindIfPossible, frame_matches_list);
@@ -633,12 +897,14 @@ bool LoopDetectorNode::findVertexInDatabase(
       projected_image_ptr_list, kParallelFindIfPossible, &frame_matches_list);
   *num_of_lc_matches = loop_closure::getNumberOfMatches(frame_matches_list);
 
-  timing::Timer timer_compute_relative("lc compute absolute transform");
+  static const common::telemetry::TimerMetric kTimerComputeRelative(
+      "lc compute absolute transform");
+  common::telemetry::ScopedTimer timer_compute_relative(kTimerComputeRelative);
   pose_graph::VertexId vertex_id_closest_to_structure_matches;
   bool ransac_ok = computeAbsoluteTransformFromFrameMatches(
       frame_matches_list, merge_landmarks, add_lc_edges, map, T_G_I,
       inlier_constraint, &vertex_id_closest_to_structure_matches);
-  timer_compute_relative.Stop();
+  timer_compute_relative.stop();
   return ransac_ok;
 }
 
@@ -686,12 +952,12 @@ bool LoopDetectorNode::computeAbsoluteTransformFromFrameMatches(
       map, &T_G_I_ransac, inlier_constraints, &landmark_pairs_merged,
       vertex_id_closest_to_structure_matches, &map_mutex);
 
-  statistics::StatsCollector stats_ransac_inliers(
+  static const common::telemetry::Metric kStatsRansacInliers(
       "LC AbsolutePoseRansacInliers");
-  stats_ransac_inliers.AddSample(num_inliers);
-  statistics::StatsCollector stats_ransac_inlier_ratio(
+  kStatsRansacInliers.addSample(num_inliers);
+  static const common::telemetry::Metric kStatsRansacInlierRatio(
       "LC AbsolutePoseRansacInlierRatio");
-  stats_ransac_inlier_ratio.AddSample(num_inliers);
+  kStatsRansacInlierRatio.addSample(inlier_ratio);
 
   return ransac_ok;
 }
@@ -747,37 +1013,23 @@ bool LoopDetectorNode::computeAbsoluteTransformFromFrameMatches(
       inlier_structure_matches, &landmark_pairs_merged,
       vertex_id_closest_to_structure_matches, &map_mutex);
 
-  statistics::StatsCollector stats_ransac_inliers(
+  static const common::telemetry::Metric kStatsRansacInliers(
       "LC AbsolutePoseRansacInliers");
-  stats_ransac_inliers.AddSample(num_inliers);
-  statistics::StatsCollector stats_ransac_inlier_ratio(
+  kStatsRansacInliers.addSample(num_inliers);
+  static const common::telemetry::Metric kStatsRansacInlierRatio(
       "LC AbsolutePoseRansacInlierRatio");
-  stats_ransac_inlier_ratio.AddSample(num_inliers);
+  kStatsRansacInlierRatio.addSample(inlier_ratio);
 
   return ransac_ok;
 }
 
-void LoopDetectorNode::queryVertexInDatabase(
-    const pose_graph::VertexId& query_vertex_id, const bool merge_landmarks,
-    const bool add_lc_edges, vi_map::VIMap* map,
-    vi_map::LoopClosureConstraint* raw_constraint,
-    vi_map::LoopClosureConstraint* inlier_constraint,
-    std::vector<double>* inlier_ratios,
-    aslam::TransformationVector* T_G_M2_vector,
-    loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
-        landmark_pairs_merged,
-    std::mutex* map_mutex) const {
-  CHECK_NOTNULL(map);
-  CHECK_NOTNULL(raw_constraint);
-  CHECK_NOTNULL(inlier_constraint);
-  CHECK_NOTNULL(inlier_ratios);
-  CHECK_NOTNULL(T_G_M2_vector);
-  CHECK_NOTNULL(landmark_pairs_merged);
-  CHECK_NOTNULL(map_mutex);
+void LoopDetectorNode::findVertexMatchesInDatabase(
+    const pose_graph::VertexId& query_vertex_id, const vi_map::VIMap& map,
+    VertexQueryResult* result) const {
+  CHECK_NOTNULL(result);
   CHECK(query_vertex_id.isValid());
 
-  map_mutex->lock();
-  const vi_map::Vertex& query_vertex = map->getVertex(query_vertex_id);
+  const vi_map::Vertex& query_vertex = map.getVertex(query_vertex_id);
   const size_t num_frames = query_vertex.numFrames();
   loop_closure::ProjectedImagePtrList projected_image_ptr_list;
   projected_image_ptr_list.reserve(num_frames);
@@ -801,12 +1053,11 @@ void LoopDetectorNode::queryVertexInDatabase(
           query_vertex_id, frame_idx);
       constexpr bool kSkipInvalidLandmarkIds = false;
       convertFrameToProjectedImage(
-          *map, query_frame_id, query_vertex.getVisualFrame(frame_idx),
+          map, query_frame_id, query_vertex.getVisualFrame(frame_idx),
           observed_landmark_ids, query_vertex.getMissionId(),
           kSkipInvalidLandmarkIds, projected_image_ptr_list.back().get());
     }
   }
-  map_mutex->unlock();
 
   loop_closure::FrameToMatches frame_matches;
   // Do not parallelize if the current function is running in multiple
@@ -816,6 +1067,7 @@ void LoopDetectorNode::queryVertexInDatabase(
       projected_image_ptr_list, kParallelFindIfPossible, &frame_matches);
 
   if (!frame_matches.empty()) {
+    vi_map::LoopClosureConstraint& raw_constraint = result->raw_constraint;
     for (const loop_closure::FrameIdMatchesPair& id_and_matches :
          frame_matches) {
       vi_map::LoopClosureConstraint tmp_constraint;
@@ -824,33 +1076,140 @@ void LoopDetectorNode::queryVertexInDatabase(
       if (!conversion_success) {
         continue;
       }
-      raw_constraint->query_vertex_id = tmp_constraint.query_vertex_id;
-      raw_constraint->structure_matches.insert(
-          raw_constraint->structure_matches.end(),
+      raw_constraint.query_vertex_id = tmp_constraint.query_vertex_id;
+      raw_constraint.structure_matches.insert(
+          raw_constraint.structure_matches.end(),
           tmp_constraint.structure_matches.begin(),
           tmp_constraint.structure_matches.end());
     }
+  }
+}
+
+void LoopDetectorNode::groupQueryVerticesIntoIslands(
+    const pose_graph::VertexIdList& vertices,
+    const Aligned<std::vector, VertexQueryResult>& results,
+    const vi_map::VIMap& map,
+    std::vector<std::vector<size_t>>* islands) const {
+  CHECK_EQ(vertices.size(), results.size());
+  CHECK_NOTNULL(islands)->clear();
+
+  std::vector<size_t> query_indices;
+  for (size_t index = 0u; index < results.size(); ++index) {
+    if (results[index].raw_constraint.query_vertex_id.isValid()) {
+      query_indices.emplace_back(index);
+    }
+  }
+  if (!FLAGS_lc_verify_query_islands) {
+    for (const size_t index : query_indices) {
+      islands->emplace_back(1u, index);
+    }
+    return;
+  }
+
+  std::vector<int64_t> timestamps_ns(vertices.size(), 0);
+  // The database vertices that store the matched landmarks, as a proxy of the
+  // place that is seen by the query vertex.
+  std::vector<pose_graph::VertexIdSet> matched_vertex_ids(vertices.size());
+  for (const size_t index : query_indices) {
+    timestamps_ns[index] =
+        map.getVertex(vertices[index]).getMinTimestampNanoseconds();
+    for (const vi_map::VertexKeyPointToStructureMatch& match :
+         results[index].raw_constraint.structure_matches) {
+      if (map.hasLandmark(match.landmark_result)) {
+        matched_vertex_ids[index].emplace(
+            map.getLandmarkStoreVertexId(match.landmark_result));
+      }
+    }
+  }
+  std::stable_sort(
+      query_indices.begin(), query_indices.end(),
+      [&timestamps_ns](const size_t lhs, const size_t rhs) {
+        return timestamps_ns[lhs] < timestamps_ns[rhs];
+      });
+
+  const int64_t max_time_gap_ns =
+      static_cast<int64_t>(FLAGS_lc_query_island_max_time_gap_s * 1e9);
+  auto see_same_place = [&](const size_t lhs, const size_t rhs) {
+    if (map.getVertex(vertices[lhs]).getMissionId() !=
+            map.getVertex(vertices[rhs]).getMissionId() ||
+        timestamps_ns[rhs] - timestamps_ns[lhs] > max_time_gap_ns) {
+      return false;
+    }
+    for (const pose_graph::VertexId& vertex_id : matched_vertex_ids[rhs]) {
+      if (matched_vertex_ids[lhs].count(vertex_id) > 0u) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (size_t i = 0u; i < query_indices.size(); ++i) {
+    if (i == 0u || !see_same_place(query_indices[i - 1u], query_indices[i])) {
+      islands->emplace_back();
+    }
+    islands->back().emplace_back(query_indices[i]);
+  }
 
+  // The vertex with the most matches is most likely to pass RANSAC and
+  // provides the pose for the others.
+  for (std::vector<size_t>& island : *islands) {
+    std::stable_sort(
+        island.begin(), island.end(), [&results](size_t lhs, size_t rhs) {
+          return results[lhs].raw_constraint.structure_matches.size() >
+                 results[rhs].raw_constraint.structure_matches.size();
+        });
+  }
+}
+
+void LoopDetectorNode::verifyQueryIsland(
+    const std::vector<size_t>& island,
+    const pose_graph::VertexIdList& vertices, const bool merge_landmarks,
+    const bool add_lc_edges, const vi_map::VIMap& map,
+    const loop_closure_handler::LoopClosureHandler& handler,
+    Aligned<std::vector, VertexQueryResult>* results) const {
+  CHECK_NOTNULL(results);
+  static const common::telemetry::Metric kNumVerifiedByPose(
+      "lc query vertices verified by island pose");
+
+  // The transformation from the mission to the map estimated by the last
+  // vertex of the island that passed RANSAC.
+  bool has_reference = false;
+  pose::Transformation T_G_M_reference;
+  for (const size_t index : island) {
+    CHECK_LT(index, results->size());
+    VertexQueryResult& result = (*results)[index];
+    const pose::Transformation& T_M_I =
+        map.getVertex(vertices[index]).get_T_M_I();
     int num_inliers = 0;
-    double inlier_ratio = 0.0;
 
     // The estimated transformation of this vertex to the map.
-    pose::Transformation T_G_I_ransac;
-    constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches =
-        nullptr;
-    bool ransac_ok = handleLoopClosures(
-        *raw_constraint, merge_landmarks, add_lc_edges, &num_inliers,
-        &inlier_ratio, map, &T_G_I_ransac, inlier_constraint,
-        landmark_pairs_merged, kVertexIdClosestToStructureMatches, map_mutex);
-
-    if (ransac_ok && inlier_ratio != 0.0) {
-      map_mutex->lock();
-      const pose::Transformation& T_M_I = query_vertex.get_T_M_I();
-      const pose::Transformation T_G_M2 = T_G_I_ransac * T_M_I.inverse();
-      map_mutex->unlock();
-
-      T_G_M2_vector->push_back(T_G_M2);
-      inlier_ratios->push_back(inlier_ratio);
+    pose::Transformation T_G_I;
+    if (has_reference) {
+      result.ransac_ok = handler.verifyLoopClosureWithPose(
+          result.raw_constraint, T_G_M_reference * T_M_I, merge_landmarks,
+          add_lc_edges, &num_inliers, &result.inlier_ratio, &T_G_I,
+          &result.inlier_constraint, &result.map_update);
+      if (result.ransac_ok) {
+        kNumVerifiedByPose.addSample(1.0);
+      }
+    }
+    if (!result.ransac_ok) {
+      // Either the first vertex of the island, or the odometry drifted too
+      // much since the reference.
+      result.map_update =
+          loop_closure_handler::LoopClosureHandler::LoopClosureMapUpdate();
+      result.ransac_ok = handler.estimateLoopClosure(
+          result.raw_constraint, merge_landmarks, add_lc_edges, &num_inliers,
+          &result.inlier_ratio, &T_G_I, &result.inlier_constraint,
+          &result.map_update, use_random_pnp_seed_);
+      if (result.ransac_ok && result.inlier_ratio != 0.0) {
+        has_reference = true;
+        T_G_M_reference = T_G_I * T_M_I.inverse();
+      }
+    }
+
+    if (result.ransac_ok && result.inlier_ratio != 0.0) {
+      result.T_G_M2 = T_G_I * T_M_I.inverse();
     }
   }
 }
@@ -894,15 +1253,14 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
     VLOG(1) << "Searching for loop closures in missions " << ss.str();
   }
 
-  std::vector<double> inlier_ratios;
-  aslam::TransformationVector T_G_M_vector;
-
-  std::mutex map_mutex;
-  std::mutex output_mutex;
-
-  loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector
-      landmark_pairs_merged;
-  vi_map::LoopClosureConstraintVector raw_constraints;
+  // The map isn't modified while querying the vertices, so the queries don't
+  // need any locking. Every query writes to its own result, and the results
+  // are transferred and applied to the map in the order of the vertices
+  // afterwards.
+  const vi_map::VIMap& const_map = *map;
+  loop_closure_handler::LoopClosureHandler handler(
+      map, &landmark_id_old_to_new_);
+  Aligned<std::vector, VertexQueryResult> query_results(vertices.size());
 
   // Then search for all in the database.
   common::MultiThreadedProgressBar progress_bar;
@@ -912,54 +1270,68 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
     int num_processed = 0;
     progress_bar.setNumElements(range.size());
     for (const size_t job_index : range) {
-      const pose_graph::VertexId& query_vertex_id = vertices[job_index];
       progress_bar.update(++num_processed);
-
-      // Allocate local buffers to avoid locking.
-      vi_map::LoopClosureConstraint raw_constraint_local;
-      vi_map::LoopClosureConstraint inlier_constraint_local;
-      using loop_closure_handler::LoopClosureHandler;
-      LoopClosureHandler::MergedLandmark3dPositionVector
-          landmark_pairs_merged_local;
-      std::vector<double> inlier_ratios_local;
-      aslam::TransformationVector T_G_M2_vector_local;
-
-      // Perform the actual query.
-      queryVertexInDatabase(
-          query_vertex_id, merge_landmarks, add_lc_edges, map,
-          &raw_constraint_local, &inlier_constraint_local, &inlier_ratios_local,
-          &T_G_M2_vector_local, &landmark_pairs_merged_local, &map_mutex);
-
-      // Lock the output buffers and transfer results.
-      {
-        std::unique_lock<std::mutex> lock_output(output_mutex);
-        if (raw_constraint_local.query_vertex_id.isValid()) {
-          raw_constraints.push_back(raw_constraint_local);
-        }
-        if (inlier_constraint_local.query_vertex_id.isValid()) {
-          inlier_constraints->push_back(inlier_constraint_local);
-        }
-
-        landmark_pairs_merged.insert(
-            landmark_pairs_merged.end(), landmark_pairs_merged_local.begin(),
-            landmark_pairs_merged_local.end());
-        inlier_ratios.insert(
-            inlier_ratios.end(), inlier_ratios_local.begin(),
-            inlier_ratios_local.end());
-        T_G_M_vector.insert(
-            T_G_M_vector.end(), T_G_M2_vector_local.begin(),
-            T_G_M2_vector_local.end());
-      }
+      findVertexMatchesInDatabase(
+          vertices[job_index], const_map, &query_results[job_index]);
     }
   };
 
   constexpr bool kAlwaysParallelize = true;
-  const size_t num_threads = common::getNumHardwareThreads();
+  const size_t num_threads = max_num_query_threads_ > 0u
+                                 ? max_num_query_threads_
+                                 : common::getNumHardwareThreads();
 
-  timing::Timer timing_mission_lc("lc query mission");
+  static const common::telemetry::TimerMetric kTimingMissionLc(
+      "lc query mission");
+  common::telemetry::ScopedTimer timing_mission_lc(kTimingMissionLc);
   common::ParallelProcess(
       vertices.size(), query_helper, kAlwaysParallelize, num_threads);
-  timing_mission_lc.Stop();
+
+  // Consecutive queries of the same place share the RANSAC of their best
+  // vertex, see --lc_verify_query_islands.
+  std::vector<std::vector<size_t>> islands;
+  groupQueryVerticesIntoIslands(vertices, query_results, const_map, &islands);
+  VLOG(1) << "Verifying " << vertices.size() << " query vertices in "
+          << islands.size() << " islands.";
+  std::function<void(const std::vector<size_t>&)> verify_helper =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t island_index : range) {
+          verifyQueryIsland(
+              islands[island_index], vertices, merge_landmarks, add_lc_edges,
+              const_map, handler, &query_results);
+        }
+      };
+  common::ParallelProcess(
+      islands.size(), verify_helper, kAlwaysParallelize, num_threads);
+  timing_mission_lc.stop();
+
+  std::vector<double> inlier_ratios;
+  aslam::TransformationVector T_G_M_vector;
+  loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector
+      landmark_pairs_merged;
+  vi_map::LoopClosureConstraintVector raw_constraints;
+
+  static const common::telemetry::TimerMetric kTimingApplyLc(
+      "lc apply mission loop closures");
+  common::telemetry::ScopedTimer timing_apply_lc(kTimingApplyLc);
+  for (VertexQueryResult& query_result : query_results) {
+    if (query_result.raw_constraint.query_vertex_id.isValid()) {
+      raw_constraints.emplace_back(std::move(query_result.raw_constraint));
+    }
+    if (query_result.inlier_constraint.query_vertex_id.isValid()) {
+      inlier_constraints->emplace_back(
+          std::move(query_result.inlier_constraint));
+    }
+    if (!query_result.ransac_ok) {
+      continue;
+    }
+    handler.applyMapUpdate(query_result.map_update, &landmark_pairs_merged);
+    if (query_result.inlier_ratio != 0.0) {
+      T_G_M_vector.push_back(query_result.T_G_M2);
+      inlier_ratios.push_back(query_result.inlier_ratio);
+    }
+  }
+  timing_apply_lc.stop();
 
   VLOG(1) << "Searched " << vertices.size() << " frames.";
 
@@ -1045,7 +1417,7 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
 }
 
 void LoopDetectorNode::detectLoopClosuresAndMergeLandmarks(
-    const MissionId& mission, vi_map::VIMap* map) {
+    const MissionId& mission, vi_map::VIMap* map) const {
   CHECK_NOTNULL(map);
 
   constexpr bool kMergeLandmarks = true;
@@ -1096,6 +1468,10 @@ void LoopDetectorNode::clear() {
   loop_detector_->Clear();
 }
 
+void LoopDetectorNode::freezeDatabase() {
+  loop_detector_->Freeze();
+}
+
 void LoopDetectorNode::serialize(
     proto::LoopDetectorNode* proto_loop_detector_node) const {
   CHECK_NOTNULL(proto_loop_detector_node);
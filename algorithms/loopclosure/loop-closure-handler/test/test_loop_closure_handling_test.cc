@@ -466,4 +466,97 @@ TEST_F(LoopClosureHandlerTest, LoopClosureHandlingTest) {
   }
 }
 
+TEST_F(LoopClosureHandlerTest, DeferredMapUpdatesMergeLandmarks) {
+  static constexpr bool kMergeLandmarks = true;
+  static constexpr bool kAddLoopClosureEdges = false;
+  FLAGS_lc_ransac_pixel_sigma = 0.8;
+
+  // Estimating the loop closures must leave the map untouched.
+  typedef loop_closure_handler::LoopClosureHandler::LoopClosureMapUpdate
+      LoopClosureMapUpdate;
+  Aligned<std::vector, LoopClosureMapUpdate> map_updates(constraints_.size());
+  for (size_t i = 0u; i < constraints_.size(); ++i) {
+    int num_inliers;
+    double inlier_ratio;
+    pose::Transformation G_T_I;
+    vi_map::LoopClosureConstraint inlier_constraints;
+    EXPECT_TRUE(
+        handler_->estimateLoopClosure(
+            constraints_[i], kMergeLandmarks, kAddLoopClosureEdges,
+            &num_inliers, &inlier_ratio, &G_T_I, &inlier_constraints,
+            &map_updates[i]));
+    EXPECT_GT(num_inliers, 0);
+    EXPECT_GT(inlier_ratio, 0);
+  }
+  for (const LandmarkToLandmarkMap::value_type& old_landmark_to_landmark :
+       duplicate_landmark_to_landmark_map_) {
+    EXPECT_TRUE(hasLandmark(old_landmark_to_landmark.first));
+  }
+
+  loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector
+      landmark_pairs_merged;
+  for (const LoopClosureMapUpdate& map_update : map_updates) {
+    handler_->applyMapUpdate(map_update, &landmark_pairs_merged);
+  }
+
+  for (const ExpectedLandmarkMergeTriple& expected_merge :
+       expected_landmark_merges_) {
+    vi_map::Vertex& query_vertex = map_.getVertex(expected_merge.vertex_id);
+
+    EXPECT_EQ(
+        expected_merge.new_landmark_id,
+        query_vertex.getObservedLandmarkId(
+                kVisualFrameIndex, expected_merge.idx));
+  }
+  for (const LandmarkToLandmarkMap::value_type& old_landmark_to_landmark :
+       duplicate_landmark_to_landmark_map_) {
+    EXPECT_FALSE(hasLandmark(old_landmark_to_landmark.first));
+  }
+}
+
+TEST_F(LoopClosureHandlerTest, VerifyLoopClosureWithKnownPose) {
+  static constexpr bool kMergeLandmarks = true;
+  static constexpr bool kAddLoopClosureEdges = false;
+  FLAGS_lc_ransac_pixel_sigma = 0.8;
+
+  typedef loop_closure_handler::LoopClosureHandler::LoopClosureMapUpdate
+      LoopClosureMapUpdate;
+  for (const vi_map::LoopClosureConstraint& constraint : constraints_) {
+    int num_inliers;
+    double inlier_ratio;
+    pose::Transformation G_T_I;
+    vi_map::LoopClosureConstraint inlier_constraints;
+    LoopClosureMapUpdate map_update;
+    ASSERT_TRUE(
+        handler_->estimateLoopClosure(
+            constraint, kMergeLandmarks, kAddLoopClosureEdges, &num_inliers,
+            &inlier_ratio, &G_T_I, &inlier_constraints, &map_update));
+
+    // The pose found by RANSAC verifies the matches without RANSAC.
+    int num_pose_inliers;
+    double pose_inlier_ratio;
+    pose::Transformation G_T_I_verified;
+    vi_map::LoopClosureConstraint pose_inlier_constraints;
+    LoopClosureMapUpdate pose_map_update;
+    EXPECT_TRUE(
+        handler_->verifyLoopClosureWithPose(
+            constraint, G_T_I, kMergeLandmarks, kAddLoopClosureEdges,
+            &num_pose_inliers, &pose_inlier_ratio, &G_T_I_verified,
+            &pose_inlier_constraints, &pose_map_update));
+    EXPECT_GE(num_pose_inliers, num_inliers);
+    EXPECT_NEAR_EIGEN(
+        G_T_I.getTransformationMatrix(),
+        G_T_I_verified.getTransformationMatrix(), 1e-12);
+
+    // A wrong pose is rejected.
+    pose::Transformation G_T_I_wrong = G_T_I;
+    G_T_I_wrong.getPosition() += Eigen::Vector3d(5.0, 0.0, 0.0);
+    EXPECT_FALSE(
+        handler_->verifyLoopClosureWithPose(
+            constraint, G_T_I_wrong, kMergeLandmarks, kAddLoopClosureEdges,
+            &num_pose_inliers, &pose_inlier_ratio, &G_T_I_verified,
+            &pose_inlier_constraints, &pose_map_update));
+  }
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
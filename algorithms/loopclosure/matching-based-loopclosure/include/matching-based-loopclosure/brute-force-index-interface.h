@@ -0,0 +1,98 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_INTERFACE_H_
+#define MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_INTERFACE_H_
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/timer.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
+#include <maplab-common/binary-serialization.h>
+#include <matching-based-loopclosure/brute-force-index.h>
+#include <matching-based-loopclosure/helpers.h>
+#include <matching-based-loopclosure/index-interface.h>
+
+namespace loop_closure {
+using brute_force_index::BruteForceIndex;
+// Exact nearest neighbor search over all projected descriptors, for offline
+// batch processing of many queries, e.g. when merging missions. Runs on the
+// CPU only; selected with --lc_detector_engine=cpu_brute_force.
+class BruteForceIndexInterface : public IndexInterface {
+ public:
+  enum { kTargetDimensionality = 10 };
+  typedef BruteForceIndex<kTargetDimensionality> Index;
+
+  explicit BruteForceIndexInterface(
+      const std::string& projection_matrix_filepath) {
+    std::ifstream deserializer(projection_matrix_filepath);
+    CHECK(deserializer.is_open()) << "Cannot load projection matrix from file: "
+                                  << projection_matrix_filepath;
+    common::Deserialize(&projection_matrix_, &deserializer);
+
+    index_.reset(new Index());
+  }
+
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        projection_matrix_, kTargetDimensionality);
+  }
+
+  virtual int GetNumDescriptorsInIndex() const {
+    return index_->GetNumDescriptorsInIndex();
+  }
+
+  virtual void Clear() {
+    index_->Clear();
+  }
+
+  virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    CHECK_EQ(descriptors.rows(), kTargetDimensionality);
+    CHECK(index_ != nullptr);
+    index_->AddDescriptors(descriptors);
+  }
+
+  virtual void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK(index_ != nullptr);
+    index_->GetNNearestNeighbors(
+        query_features, num_neighbors, indices, distances);
+  }
+
+  virtual void ProjectDescriptors(
+      const DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    projected_descriptors->resize(kTargetDimensionality, descriptors.cols());
+
+    timing::Timer timer_proj("PL 1.1 project");
+    descriptor_projection::ProjectDescriptorBlock(
+        descriptors, projection_matrix_, kTargetDimensionality,
+        projected_descriptors);
+    timer_proj.Stop();
+  }
+
+  virtual void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    projected_descriptors->resize(kTargetDimensionality, descriptors.size());
+
+    timing::Timer timer_proj("PL 1.1 project");
+    descriptor_projection::ProjectDescriptorBlock(
+        descriptors, projection_matrix_, kTargetDimensionality,
+        projected_descriptors);
+    timer_proj.Stop();
+  }
+
+ private:
+  std::shared_ptr<Index> index_;
+  Eigen::MatrixXf projection_matrix_;
+};
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_INTERFACE_H_
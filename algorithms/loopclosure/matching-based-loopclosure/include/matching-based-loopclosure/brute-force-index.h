@@ -0,0 +1,145 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_H_
+#define MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_H_
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <loopclosure-common/flags.h>
+
+namespace loop_closure {
+namespace brute_force_index {
+// Exact nearest neighbor search over all descriptors. The distances of a block
+// of queries to a block of database descriptors are computed with a single
+// matrix product as |q|^2 + |d|^2 - 2 * d^T * q, which keeps the database
+// streaming through the cache instead of walking a tree per query.
+template <int kDimVectors>
+class BruteForceIndex {
+ public:
+  typedef Eigen::Matrix<float, kDimVectors, Eigen::Dynamic>
+      DescriptorMatrixType;
+  // Number of queries and database descriptors that are compared at once. A
+  // block of distances is 1 MB.
+  static constexpr int kQueryBlockSize = 256;
+  static constexpr int kDatabaseBlockSize = 1024;
+
+  BruteForceIndex() {}
+
+  inline void Clear() {
+    descriptors_.resize(Eigen::NoChange, 0);
+    squared_norms_.resize(0);
+  }
+
+  inline int GetNumDescriptorsInIndex() const {
+    return static_cast<int>(descriptors_.cols());
+  }
+
+  void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    CHECK_EQ(descriptors.rows(), kDimVectors);
+    const int num_old_descriptors = descriptors_.cols();
+    const int num_new_descriptors = descriptors.cols();
+    descriptors_.conservativeResize(
+        Eigen::NoChange, num_old_descriptors + num_new_descriptors);
+    descriptors_.rightCols(num_new_descriptors) = descriptors;
+    squared_norms_.conservativeResize(
+        num_old_descriptors + num_new_descriptors);
+    squared_norms_.tail(num_new_descriptors) =
+        descriptors.colwise().squaredNorm().transpose();
+  }
+
+  // Finds the num_neighbors nearest neighbors of every column of
+  // query_features, sorted by increasing squared distance. Missing neighbors
+  // are returned as index -1 and infinite distance. This function is
+  // thread-safe.
+  void GetNNearestNeighbors(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK_EQ(query_features.rows(), kDimVectors);
+    CHECK_GT(num_neighbors, 0);
+    CHECK_EQ(indices->rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(indices->cols(), query_features.cols());
+    CHECK_EQ(distances->cols(), query_features.cols());
+
+    indices->setConstant(-1);
+    distances->setConstant(std::numeric_limits<float>::infinity());
+
+    const float max_squared_distance =
+        FLAGS_lc_knn_max_radius * FLAGS_lc_knn_max_radius;
+    const int num_queries = query_features.cols();
+    const int num_descriptors = descriptors_.cols();
+
+    // Max-heaps of the current nearest neighbors of every query in the block.
+    typedef std::pair<float, int> DistanceIndexPair;
+    std::vector<std::vector<DistanceIndexPair> > nearest_neighbors(
+        kQueryBlockSize);
+    Eigen::MatrixXf block_distances;
+    for (int query_start = 0; query_start < num_queries;
+         query_start += kQueryBlockSize) {
+      const int query_block_size =
+          std::min(kQueryBlockSize, num_queries - query_start);
+      const auto query_block =
+          query_features.middleCols(query_start, query_block_size);
+      const Eigen::RowVectorXf query_squared_norms =
+          query_block.colwise().squaredNorm();
+      for (int i = 0; i < query_block_size; ++i) {
+        nearest_neighbors[i].clear();
+      }
+
+      for (int database_start = 0; database_start < num_descriptors;
+           database_start += kDatabaseBlockSize) {
+        const int database_block_size =
+            std::min(kDatabaseBlockSize, num_descriptors - database_start);
+        block_distances.noalias() =
+            -2.f * descriptors_.middleCols(database_start, database_block_size)
+                       .transpose() *
+            query_block;
+        block_distances.colwise() +=
+            squared_norms_.segment(database_start, database_block_size);
+        block_distances.rowwise() += query_squared_norms;
+
+        for (int i = 0; i < query_block_size; ++i) {
+          std::vector<DistanceIndexPair>& heap = nearest_neighbors[i];
+          for (int j = 0; j < database_block_size; ++j) {
+            // Rounding can make the distance of equal vectors negative.
+            const float distance = std::max(block_distances(j, i), 0.f);
+            if (distance > max_squared_distance) {
+              continue;
+            }
+            if (static_cast<int>(heap.size()) < num_neighbors) {
+              heap.emplace_back(distance, database_start + j);
+              std::push_heap(heap.begin(), heap.end());
+            } else if (distance < heap.front().first) {
+              std::pop_heap(heap.begin(), heap.end());
+              heap.back() = DistanceIndexPair(distance, database_start + j);
+              std::push_heap(heap.begin(), heap.end());
+            }
+          }
+        }
+      }
+
+      for (int i = 0; i < query_block_size; ++i) {
+        std::vector<DistanceIndexPair>& heap = nearest_neighbors[i];
+        std::sort_heap(heap.begin(), heap.end());
+        for (size_t k = 0u; k < heap.size(); ++k) {
+          (*distances)(k, query_start + i) = heap[k].first;
+          (*indices)(k, query_start + i) = heap[k].second;
+        }
+      }
+    }
+  }
+
+ private:
+  DescriptorMatrixType descriptors_;
+  Eigen::VectorXf squared_norms_;
+};
+}  // namespace brute_force_index
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_BRUTE_FORCE_INDEX_H_
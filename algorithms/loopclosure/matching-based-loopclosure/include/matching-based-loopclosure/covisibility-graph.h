@@ -0,0 +1,221 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_GRAPH_H_
+#define MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_GRAPH_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <descriptor-projection/descriptor-projection.h>
+#include <glog/logging.h>
+#include <loopclosure-common/types.h>
+
+#include "matching-based-loopclosure/scoring.h"
+
+namespace matching_based_loopclosure {
+
+// Assigns dense indices to the keyframes, vertices and landmarks of the
+// database and stores the keyframe and landmark of every database descriptor.
+// The graph is extended whenever an image is inserted, so the covisibility
+// filtering of a query can run on flat arrays instead of hashing the IDs of
+// every match.
+class CovisibilityGraph {
+ public:
+  typedef int DenseIndex;
+  static constexpr DenseIndex kInvalidIndex = -1;
+
+  CovisibilityGraph() {}
+
+  void clear();
+
+  // Adds the keyframe of the image and returns its dense index. The image
+  // does not need to contain its descriptors anymore.
+  DenseIndex addKeyframe(
+      const loop_closure::ProjectedImage& projected_image,
+      size_t num_descriptors);
+  // Associates the descriptor with the keyframe and the landmark observed by
+  // the keypoint of the descriptor.
+  void addDescriptor(
+      int descriptor_index, DenseIndex keyframe_index,
+      const loop_closure::PointLandmarkId& landmark_id);
+
+  // Returns kInvalidIndex if the keyframe is not part of the graph.
+  DenseIndex getKeyframeIndex(
+      const loop_closure::KeyframeId& keyframe_id) const;
+
+  inline DenseIndex getKeyframeIndexOfDescriptor(int descriptor_index) const {
+    CHECK_GE(descriptor_index, 0);
+    CHECK_LT(
+        static_cast<size_t>(descriptor_index),
+        descriptor_keyframe_indices_.size());
+    return descriptor_keyframe_indices_[descriptor_index];
+  }
+  inline DenseIndex getLandmarkIndexOfDescriptor(int descriptor_index) const {
+    CHECK_GE(descriptor_index, 0);
+    CHECK_LT(
+        static_cast<size_t>(descriptor_index),
+        descriptor_landmark_indices_.size());
+    return descriptor_landmark_indices_[descriptor_index];
+  }
+
+  inline DenseIndex getVertexIndex(DenseIndex keyframe_index) const {
+    return keyframes_[keyframe_index].vertex_index;
+  }
+  inline const loop_closure::KeyframeId& getKeyframeId(
+      DenseIndex keyframe_index) const {
+    return keyframes_[keyframe_index].keyframe_id;
+  }
+  inline int64_t getTimestampNanoseconds(DenseIndex keyframe_index) const {
+    return keyframes_[keyframe_index].timestamp_nanoseconds;
+  }
+  inline const loop_closure::DatasetId& getDatasetId(
+      DenseIndex keyframe_index) const {
+    return keyframes_[keyframe_index].dataset_id;
+  }
+  inline size_t getNumDescriptors(DenseIndex keyframe_index) const {
+    return keyframes_[keyframe_index].num_descriptors;
+  }
+  inline const loop_closure::PointLandmarkId& getLandmarkId(
+      DenseIndex landmark_index) const {
+    return landmark_ids_[landmark_index];
+  }
+
+  inline size_t numKeyframes() const {
+    return keyframes_.size();
+  }
+  inline size_t numVertices() const {
+    return vertex_id_to_index_.size();
+  }
+  inline size_t numLandmarks() const {
+    return landmark_ids_.size();
+  }
+
+ private:
+  struct Keyframe {
+    loop_closure::KeyframeId keyframe_id;
+    DenseIndex vertex_index;
+    int64_t timestamp_nanoseconds;
+    loop_closure::DatasetId dataset_id;
+    size_t num_descriptors;
+  };
+
+  std::vector<Keyframe> keyframes_;
+  std::vector<loop_closure::PointLandmarkId> landmark_ids_;
+  std::vector<DenseIndex> descriptor_keyframe_indices_;
+  std::vector<DenseIndex> descriptor_landmark_indices_;
+
+  std::unordered_map<loop_closure::KeyframeId, DenseIndex>
+      keyframe_id_to_index_;
+  std::unordered_map<loop_closure::VertexId, DenseIndex> vertex_id_to_index_;
+  std::unordered_map<loop_closure::PointLandmarkId, DenseIndex>
+      landmark_id_to_index_;
+};
+
+// A match of a query keypoint to a database descriptor in terms of the dense
+// indices of the covisibility graph.
+struct CovisibilityMatch {
+  // Index of the image in the list of query images.
+  int query_image_index;
+  int keypoint_index_query;
+  CovisibilityGraph::DenseIndex keyframe_index;
+  CovisibilityGraph::DenseIndex landmark_index;
+};
+
+// Buffers used while filtering the matches of a query. They only grow, so the
+// filtering does not allocate once a buffer has been used for a few queries.
+struct CovisibilityFilterScratch {
+  CovisibilityFilterScratch() : epoch(0u) {}
+
+  // The matches of the image or vertex that is being filtered.
+  std::vector<CovisibilityMatch> matches;
+
+  // Maps the dense keyframe / vertex and landmark indices to indices local to
+  // the current filtering step. An entry is only valid if its stamp is equal
+  // to the current epoch, which avoids resetting the arrays for every query.
+  uint32_t epoch;
+  std::vector<uint32_t> id_stamps;
+  std::vector<int> id_local_indices;
+  std::vector<uint32_t> landmark_stamps;
+  std::vector<int> landmark_local_indices;
+
+  std::vector<size_t> num_matches_per_id;
+  std::vector<size_t> num_descriptors_per_id;
+  std::vector<scoring::ScoreType> scores;
+  std::vector<int> score_order;
+  std::vector<char> is_id_relevant;
+  // Union-find forest over the local IDs followed by the local landmarks.
+  std::vector<int> component_parents;
+  std::vector<size_t> component_sizes;
+};
+
+// Hands out scratch buffers that are returned to the pool once the lease goes
+// out of scope. This lets concurrent queries reuse the memory of earlier
+// queries without sharing any buffer.
+class CovisibilityFilterScratchPool {
+ public:
+  class Lease {
+   public:
+    Lease(
+        CovisibilityFilterScratchPool* pool,
+        std::unique_ptr<CovisibilityFilterScratch> scratch)
+        : pool_(CHECK_NOTNULL(pool)), scratch_(std::move(scratch)) {
+      CHECK(scratch_);
+    }
+    Lease(Lease&& other) = default;
+    ~Lease() {
+      if (scratch_) {
+        pool_->release(std::move(scratch_));
+      }
+    }
+
+    CovisibilityFilterScratch* get() const {
+      return scratch_.get();
+    }
+    CovisibilityFilterScratch* operator->() const {
+      return scratch_.get();
+    }
+
+   private:
+    CovisibilityFilterScratchPool* pool_;
+    std::unique_ptr<CovisibilityFilterScratch> scratch_;
+  };
+
+  Lease acquire();
+  void clear();
+
+ private:
+  void release(std::unique_ptr<CovisibilityFilterScratch> scratch);
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<CovisibilityFilterScratch>> free_scratches_;
+};
+
+struct CovisibilityFilterSettings {
+  // Connect the matches through their database vertex instead of their
+  // database keyframe.
+  bool connect_by_vertex;
+  // If set, only the matches of the best scoring fraction of all matched IDs
+  // are considered. Scoring is only supported for keyframes.
+  const scoring::computeDenseScoresFunction* compute_scores;
+  float fraction_best_scores;
+  size_t num_descriptors_in_database;
+  // The largest component is only kept if it has more matches than this.
+  size_t min_num_matches;
+  // Keep only one match per query keypoint and landmark.
+  bool make_matches_unique;
+};
+
+// Keeps the largest set of matches that are connected through common database
+// keyframes (or vertices) and landmarks. This is a union-find over the dense
+// indices of the matched IDs and landmarks, which does not allocate if the
+// scratch buffers are large enough. The matches are filtered in place.
+void filterMatchesByCovisibility(
+    const CovisibilityGraph& graph, const CovisibilityFilterSettings& settings,
+    CovisibilityFilterScratch* scratch,
+    std::vector<CovisibilityMatch>* matches);
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_GRAPH_H_
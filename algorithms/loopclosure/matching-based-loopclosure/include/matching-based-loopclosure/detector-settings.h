@@ -11,6 +11,9 @@ static const std::string kAccumulationString = "accumulation";
 static const std::string kProbabilisticString = "probabilistic";
 
 static const std::string kMatchingLDKdTreeString = "kd_tree";
+// Exact search on the CPU. There is no GPU implementation of this engine.
+static const std::string kMatchingLDCpuBruteForceString = "cpu_brute_force";
+static const std::string kMatchingLDKdForestString = "kd_forest";
 static const std::string kMatchingLDInvertedIndexString = "inverted_index";
 static const std::string kMatchingLDInvertedMultiIndexString =
     "inverted_multi_index";
@@ -28,6 +31,8 @@ struct MatchingBasedEngineSettings {
 
   enum class DetectorEngineType {
     kMatchingLDKdTree,
+    kMatchingLDCpuBruteForce,
+    kMatchingLDKdForest,
     kMatchingLDInvertedIndex,
     kMatchingLDInvertedMultiIndex,
     kMatchingLDInvertedMultiIndexProductQuantization,
@@ -46,10 +51,15 @@ struct MatchingBasedEngineSettings {
   std::string projection_matrix_filename;
   std::string projected_quantizer_filename;
   int num_closest_words_for_nn_search;
+  int max_candidates_for_nn_search;
   double min_image_time_seconds;
   size_t min_verify_matches_num;
   float fraction_best_scores;
   int num_nearest_neighbors;
+  double compaction_min_removed_ratio;
+  int kd_forest_num_trees;
+  int kd_forest_max_checks;
+  int kd_forest_max_leaf_size;
 };
 
 }  // namespace matching_based_loopclosure
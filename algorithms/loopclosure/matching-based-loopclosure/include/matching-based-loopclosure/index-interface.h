@@ -1,8 +1,10 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_INDEX_INTERFACE_H_
+#include <cstdint>
 #include <vector>
 
 #include <Eigen/Core>
+#include <glog/logging.h>
 #include <matching-based-loopclosure/helpers.h>
 
 namespace loop_closure {
@@ -22,6 +24,10 @@ class IndexInterface {
   // The number of individual descriptors in the index.
   virtual int GetNumDescriptorsInIndex() const = 0;
 
+  // Identifies the projection of ProjectDescriptors(), such that stored
+  // projected descriptors are only reused with the same projection.
+  virtual uint64_t GetProjectionFingerprint() const = 0;
+
   // Use the projection matrix specific to the used index to project the
   // binary descriptors to a lower dimensional, real valued space.
   virtual void ProjectDescriptors(
@@ -36,6 +42,22 @@ class IndexInterface {
   virtual void GetNNearestNeighborsForFeatures(
       const Eigen::MatrixXf& query_features, int num_neighbors,
       Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const = 0;
+
+  // Converts the index into a read-optimized layout once all descriptors are
+  // added, e.g. before localization starts. Adding descriptors afterwards is
+  // still possible but may be slower. Does nothing for most indices.
+  virtual void Freeze() {}
+
+  // Whether descriptors can be removed from the index without rebuilding it.
+  virtual bool SupportsRemoval() const {
+    return false;
+  }
+
+  // Remove the descriptors with the given indices from the index. The indices
+  // of the remaining descriptors don't change.
+  virtual void RemoveDescriptors(const std::vector<int>& /*indices*/) {
+    LOG(FATAL) << "This index doesn't support removing descriptors.";
+  }
 };
 }  // namespace loop_closure
 #endif  // MATCHING_BASED_LOOPCLOSURE_INDEX_INTERFACE_H_
@@ -1,5 +1,6 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_INVERTED_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_INVERTED_INDEX_INTERFACE_H_
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -9,6 +10,7 @@
 #include <aslam/common/timer.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
 #include <maplab-common/binary-serialization.h>
 #include <matching-based-loopclosure/helpers.h>
 #include <matching-based-loopclosure/index-interface.h>
@@ -74,6 +76,11 @@ class InvertedIndexInterface : public IndexInterface {
     index_.reset(new Index(words_, num_closest_words_for_nn_search));
   }
 
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        vocabulary_.projection_matrix_, vocabulary_.target_dimensionality_);
+  }
+
   virtual int GetNumDescriptorsInIndex() const {
     return index_->GetNumDescriptorsInIndex();
   }
@@ -81,6 +88,10 @@ class InvertedIndexInterface : public IndexInterface {
   virtual void Clear() {
     index_->Clear();
   }
+
+  virtual void Freeze() {
+    index_->Freeze();
+  }
   inline void SetNumClosestWordsForNNSearch(
       int num_closest_words_for_nn_search) {
     index_->SetNumClosestWordsForNNSearch(num_closest_words_for_nn_search);
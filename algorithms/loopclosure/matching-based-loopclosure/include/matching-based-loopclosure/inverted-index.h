@@ -13,6 +13,7 @@
 #include <Eigen/Core>
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
+#include <inverted-multi-index/frozen-inverted-files.h>
 #include <loopclosure-common/flags.h>
 #include <nabo/nabo.h>
 
@@ -26,6 +27,10 @@ class InvertedIndex {
   typedef Eigen::Matrix<float, kDimVectors, Eigen::Dynamic>
       DescriptorMatrixType;
   typedef Nabo::NearestNeighbourSearch<float> NNSearch;
+  typedef inverted_multi_index::common::InvertedFile<float, kDimVectors>
+      InvFile;
+  typedef inverted_multi_index::common::FrozenInvertedFiles<float, kDimVectors>
+      FrozenInvFiles;
   // Switch touch statistics (NNSearch::TOUCH_STATISTICS) off for performance.
   static constexpr int kCollectTouchStatistics = 0;
   // Kd-tree search options. ALLOW_SELF_MATCH means that a point which is
@@ -47,7 +52,8 @@ class InvertedIndex {
             NNSearch::createKDTreeLinearHeap(
                 words_, kDimVectors, kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
-        max_db_descriptor_index_(0) {
+        max_db_descriptor_index_(0),
+        is_frozen_(false) {
     CHECK_EQ(words_.rows(), kDimVectors);
     CHECK_GT(num_closest_words_for_nn_search_, 0);
   }
@@ -57,7 +63,7 @@ class InvertedIndex {
   }
 
   inline int GetNumDescriptorsInIndex() const {
-    return db_descriptors_.size();
+    return max_db_descriptor_index_;
   }
 
   // Clears the inverted index by removing all references to the database
@@ -65,13 +71,56 @@ class InvertedIndex {
   inline void Clear() {
     db_descriptors_.clear();
     db_descriptor_indices_.clear();
+    frozen_inverted_files_.Clear();
+    is_frozen_ = false;
     word_index_map_.clear();
     max_db_descriptor_index_ = 0;
   }
 
+  // Moves the descriptors of all words into a read-optimized layout, see
+  // inverted_multi_index::common::FrozenInvertedFiles. Meant to be called once
+  // the database is complete. Adding descriptors unfreezes the index first.
+  void Freeze() {
+    if (is_frozen_) {
+      return;
+    }
+    Aligned<std::vector, InvFile> inverted_files(db_descriptors_.size());
+    for (size_t word_idx = 0u; word_idx < db_descriptors_.size(); ++word_idx) {
+      inverted_files[word_idx].descriptors_.swap(db_descriptors_[word_idx]);
+      inverted_files[word_idx].indices_.swap(db_descriptor_indices_[word_idx]);
+    }
+    frozen_inverted_files_.Freeze(
+        inverted_files, [](int /*descriptor_index*/) { return false; });
+    Aligned<std::vector, DescriptorBucket>().swap(db_descriptors_);
+    std::vector<std::vector<int> >().swap(db_descriptor_indices_);
+    is_frozen_ = true;
+  }
+
+  // Restores the growable buckets of a frozen index.
+  void Unfreeze() {
+    if (!is_frozen_) {
+      return;
+    }
+    Aligned<std::vector, InvFile> inverted_files;
+    frozen_inverted_files_.Thaw(&inverted_files);
+    frozen_inverted_files_.Clear();
+    db_descriptors_.resize(inverted_files.size());
+    db_descriptor_indices_.resize(inverted_files.size());
+    for (size_t word_idx = 0u; word_idx < inverted_files.size(); ++word_idx) {
+      db_descriptors_[word_idx].swap(inverted_files[word_idx].descriptors_);
+      db_descriptor_indices_[word_idx].swap(inverted_files[word_idx].indices_);
+    }
+    is_frozen_ = false;
+  }
+
+  inline bool IsFrozen() const {
+    return is_frozen_;
+  }
+
   // Adds a set of database descriptors to the inverted index.
   // Each column defines a database descriptor.
   void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    Unfreeze();
     int num_descriptors = descriptors.cols();
     std::unordered_map<int, int>::const_iterator word_index_it;
 
@@ -147,6 +196,17 @@ class InvertedIndex {
       if (word_index_it == word_index_map_.end())
         continue;
 
+      if (is_frozen_) {
+        frozen_inverted_files_.ForEachEntry(
+            word_index_it->second,
+            [&](int descriptor_index, const DescriptorType& descriptor) {
+              const float distance = (descriptor - query_feature).squaredNorm();
+              InsertNeighbor(
+                  descriptor_index, distance, num_neighbors,
+                  &nearest_neighbors);
+            });
+        continue;
+      }
       const Aligned<std::vector, DescriptorType>& descriptors =
           db_descriptors_[word_index_it->second];
       int num_descriptors = static_cast<int>(descriptors.size());
@@ -254,6 +314,10 @@ class InvertedIndex {
   std::vector<std::vector<int> > db_descriptor_indices_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
+  // Replaces db_descriptors_ and db_descriptor_indices_ while the index is
+  // frozen.
+  FrozenInvFiles frozen_inverted_files_;
+  bool is_frozen_;
 };
 }  // namespace inverted_index
 }  // namespace loop_closure
@@ -1,5 +1,6 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_INVERTED_MULTI_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_INVERTED_MULTI_INDEX_INTERFACE_H_
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 #include <Eigen/Dense>
 #include <aslam/common/timer.h>
 #include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
 #include <inverted-multi-index/inverted-multi-index.h>
 #include <inverted-multi-index/inverted-multi-product-quantization-index.h>
 #include <maplab-common/binary-serialization.h>
@@ -122,6 +124,11 @@ class InvertedMultiIndexInterface : public IndexInterface {
     index_.reset(new Index(words_1, words_2, num_closest_words_for_nn_search));
   }
 
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        vocabulary_.projection_matrix_, vocabulary_.target_dimensionality_);
+  }
+
   virtual int GetNumDescriptorsInIndex() const {
     return index_->GetNumDescriptorsInIndex();
   }
@@ -129,17 +136,56 @@ class InvertedMultiIndexInterface : public IndexInterface {
   virtual void Clear() {
     index_->Clear();
   }
+
+  virtual void Freeze() {
+    index_->Freeze();
+  }
+
   inline void SetNumClosestWordsForNNSearch(
       int num_closest_words_for_nn_search) {
     index_->SetNumClosestWordsForNNSearch(num_closest_words_for_nn_search);
   }
 
+  inline void SetMaxCandidatesForNNSearch(int max_candidates_for_nn_search) {
+    index_->SetMaxCandidatesForNNSearch(max_candidates_for_nn_search);
+  }
+
   virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
     CHECK_EQ(descriptors.rows(), 2 * kSubSpaceDimensionality);
     CHECK(index_ != nullptr);
     index_->AddDescriptors(descriptors);
   }
 
+  virtual bool SupportsRemoval() const {
+    return true;
+  }
+
+  virtual void RemoveDescriptors(const std::vector<int>& indices) {
+    CHECK(index_ != nullptr);
+    index_->RemoveDescriptors(indices);
+  }
+
+  inline int GetNumRemovedEntries() const {
+    return index_->GetNumRemovedEntries();
+  }
+
+  // Copies the inverted files with at least the given ratio of removed
+  // entries without them. Only reads the index, so it can run concurrently
+  // to queries.
+  inline void CompactInvertedFiles(
+      double min_removed_ratio,
+      Index::CompactedInvertedFiles* compacted_inverted_files) const {
+    CHECK(index_ != nullptr);
+    index_->CompactInvertedFiles(min_removed_ratio, compacted_inverted_files);
+  }
+
+  // Returns false if the index was reset since the compaction.
+  inline bool ApplyCompactedInvertedFiles(
+      Index::CompactedInvertedFiles* compacted_inverted_files) {
+    CHECK(index_ != nullptr);
+    return index_->ApplyCompactedInvertedFiles(compacted_inverted_files);
+  }
+
   template <typename DerivedQuery, typename DerivedIndices,
             typename DerivedDistances>
   inline void GetNNearestNeighbors(
@@ -188,13 +234,16 @@ class InvertedMultiIndexInterface : public IndexInterface {
     }
   }
 
+  // Searches all query features as one batch, which reads every inverted file
+  // only once.
   virtual void GetNNearestNeighborsForFeatures(
       const Eigen::MatrixXf& query_features, int num_neighbors,
       Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
     CHECK_NOTNULL(indices);
     CHECK_NOTNULL(distances);
-    GetNNearestNeighborsForFeatures(
-        query_features, num_neighbors, *indices, *distances);
+    CHECK_EQ(query_features.rows(), 2 * kSubSpaceDimensionality);
+    index_->GetNNearestNeighborsForFeatures(
+        query_features, num_neighbors, indices, distances);
   }
 
   virtual void ProjectDescriptors(
@@ -289,6 +338,11 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
             num_closest_words_for_nn_search));
   }
 
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        vocabulary_.projection_matrix_, vocabulary_.target_dimensionality_);
+  }
+
   virtual int GetNumDescriptorsInIndex() const {
     return index_->GetNumDescriptorsInIndex();
   }
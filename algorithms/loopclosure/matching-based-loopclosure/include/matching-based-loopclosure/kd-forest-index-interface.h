@@ -0,0 +1,105 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_INTERFACE_H_
+#define MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_INTERFACE_H_
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/reader-writer-lock.h>
+#include <aslam/common/timer.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
+#include <maplab-common/binary-serialization.h>
+#include <matching-based-loopclosure/helpers.h>
+#include <matching-based-loopclosure/index-interface.h>
+#include <matching-based-loopclosure/kd-forest-index.h>
+
+namespace loop_closure {
+using kd_forest_index::KDForestIndex;
+// Approximate nearest neighbor search in a randomized k-d forest. Descriptors
+// are added without rebuilding the index and queries from multiple threads
+// run concurrently, only adding descriptors blocks them.
+class KDForestIndexInterface : public IndexInterface {
+ public:
+  enum { kTargetDimensionality = 10 };
+  typedef KDForestIndex<kTargetDimensionality> Index;
+
+  KDForestIndexInterface(
+      const std::string& projection_matrix_filepath, int num_trees,
+      int max_checks, int max_leaf_size) {
+    std::ifstream deserializer(projection_matrix_filepath);
+    CHECK(deserializer.is_open()) << "Cannot load projection matrix from file: "
+                                  << projection_matrix_filepath;
+    common::Deserialize(&projection_matrix_, &deserializer);
+
+    index_.reset(new Index(num_trees, max_checks, max_leaf_size));
+  }
+
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        projection_matrix_, kTargetDimensionality);
+  }
+
+  virtual int GetNumDescriptorsInIndex() const {
+    aslam::ScopedReadLock lock(&index_mutex_);
+    return index_->GetNumDescriptorsInIndex();
+  }
+
+  virtual void Clear() {
+    aslam::ScopedWriteLock lock(&index_mutex_);
+    index_->Clear();
+  }
+
+  virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    CHECK_EQ(descriptors.rows(), kTargetDimensionality);
+    aslam::ScopedWriteLock lock(&index_mutex_);
+    CHECK(index_ != nullptr);
+    index_->AddDescriptors(descriptors);
+  }
+
+  virtual void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    aslam::ScopedReadLock lock(&index_mutex_);
+    CHECK(index_ != nullptr);
+    index_->GetNNearestNeighbors(
+        query_features, num_neighbors, indices, distances);
+  }
+
+  virtual void ProjectDescriptors(
+      const DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    projected_descriptors->resize(kTargetDimensionality, descriptors.cols());
+
+    timing::Timer timer_proj("PL 1.1 project");
+    descriptor_projection::ProjectDescriptorBlock(
+        descriptors, projection_matrix_, kTargetDimensionality,
+        projected_descriptors);
+    timer_proj.Stop();
+  }
+
+  virtual void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    projected_descriptors->resize(kTargetDimensionality, descriptors.size());
+
+    timing::Timer timer_proj("PL 1.1 project");
+    descriptor_projection::ProjectDescriptorBlock(
+        descriptors, projection_matrix_, kTargetDimensionality,
+        projected_descriptors);
+    timer_proj.Stop();
+  }
+
+ private:
+  std::shared_ptr<Index> index_;
+  Eigen::MatrixXf projection_matrix_;
+  mutable aslam::ReaderWriterMutex index_mutex_;
+};
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_INTERFACE_H_
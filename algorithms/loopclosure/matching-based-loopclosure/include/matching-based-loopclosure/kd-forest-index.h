@@ -0,0 +1,326 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_H_
+#define MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_H_
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <loopclosure-common/flags.h>
+
+namespace loop_closure {
+namespace kd_forest_index {
+// Approximate nearest neighbor search in a forest of randomized k-d trees, as
+// in FLANN. Every tree splits on a dimension drawn at random from the ones
+// with the highest variance, so the trees partition the space differently. A
+// query explores the branches of all trees in a single priority queue ordered
+// by their distance to the query until max_checks descriptors are compared,
+// which trades recall for speed.
+//
+// Descriptors are inserted incrementally: they descend to a leaf of every
+// tree and leaves are split once they hold more than max_leaf_size
+// descriptors, so adding descriptors never rebuilds the trees.
+template <int kDimVectors>
+class KDForestIndex {
+ public:
+  typedef Eigen::Matrix<float, kDimVectors, Eigen::Dynamic>
+      DescriptorMatrixType;
+  // Number of high variance dimensions the split dimension is drawn from.
+  static constexpr int kNumSplitDimensionCandidates = 5;
+
+  KDForestIndex(int num_trees, int max_checks, int max_leaf_size)
+      : max_checks_(max_checks), max_leaf_size_(max_leaf_size) {
+    CHECK_GT(num_trees, 0);
+    CHECK_GT(max_checks_, 0);
+    CHECK_GT(max_leaf_size_, 0);
+    trees_.resize(num_trees);
+    Clear();
+  }
+
+  inline void Clear() {
+    descriptors_.resize(Eigen::NoChange, 0);
+    for (size_t tree_index = 0u; tree_index < trees_.size(); ++tree_index) {
+      Tree& tree = trees_[tree_index];
+      tree.nodes.assign(1u, Node(max_leaf_size_));
+      // Seeded by the tree index to get reproducible trees.
+      tree.random_engine.seed(tree_index);
+    }
+  }
+
+  inline int GetNumDescriptorsInIndex() const {
+    return static_cast<int>(descriptors_.cols());
+  }
+
+  inline int GetNumTrees() const {
+    return static_cast<int>(trees_.size());
+  }
+
+  void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    CHECK_EQ(descriptors.rows(), kDimVectors);
+    const int num_old_descriptors = descriptors_.cols();
+    const int num_new_descriptors = descriptors.cols();
+    descriptors_.conservativeResize(
+        Eigen::NoChange, num_old_descriptors + num_new_descriptors);
+    descriptors_.rightCols(num_new_descriptors) = descriptors;
+    for (Tree& tree : trees_) {
+      for (int i = num_old_descriptors; i < descriptors_.cols(); ++i) {
+        InsertIntoTree(i, &tree);
+      }
+    }
+  }
+
+  // Finds the num_neighbors approximate nearest neighbors of every column of
+  // query_features, sorted by increasing squared distance. Missing neighbors
+  // are returned as index -1 and infinite distance. This function is
+  // thread-safe.
+  void GetNNearestNeighbors(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK_EQ(query_features.rows(), kDimVectors);
+    CHECK_GT(num_neighbors, 0);
+    CHECK_EQ(indices->rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(indices->cols(), query_features.cols());
+    CHECK_EQ(distances->cols(), query_features.cols());
+
+    indices->setConstant(-1);
+    distances->setConstant(std::numeric_limits<float>::infinity());
+
+    const float max_squared_distance =
+        FLAGS_lc_knn_max_radius * FLAGS_lc_knn_max_radius;
+    std::vector<DistanceIndexPair> heap;
+    BranchQueue branches;
+    for (int query_index = 0; query_index < query_features.cols();
+         ++query_index) {
+      const Eigen::Matrix<float, kDimVectors, 1> query =
+          query_features.col(query_index);
+      heap.clear();
+      branches = BranchQueue();
+
+      int num_checks = 0;
+      for (size_t tree_index = 0u; tree_index < trees_.size(); ++tree_index) {
+        SearchBranch(
+            query, num_neighbors, max_squared_distance,
+            Branch(0.f, tree_index, 0), &num_checks, &heap, &branches);
+      }
+      while (!branches.empty() && num_checks < max_checks_) {
+        const Branch branch = branches.top();
+        branches.pop();
+        SearchBranch(
+            query, num_neighbors, max_squared_distance, branch, &num_checks,
+            &heap, &branches);
+      }
+
+      std::sort_heap(heap.begin(), heap.end());
+      for (size_t k = 0u; k < heap.size(); ++k) {
+        (*distances)(k, query_index) = heap[k].first;
+        (*indices)(k, query_index) = heap[k].second;
+      }
+    }
+  }
+
+ private:
+  struct Node {
+    explicit Node(int _max_leaf_size)
+        : split_dimension(-1),
+          split_value(0.f),
+          max_leaf_size(_max_leaf_size) {
+      children[0] = -1;
+      children[1] = -1;
+    }
+    bool isLeaf() const {
+      return split_dimension < 0;
+    }
+
+    int split_dimension;
+    float split_value;
+    // Descriptors smaller than the split value are in the first child.
+    int children[2];
+    // Leaves that cannot be split because all descriptors are equal grow.
+    int max_leaf_size;
+    std::vector<int> descriptor_indices;
+  };
+
+  struct Tree {
+    std::vector<Node> nodes;
+    std::mt19937 random_engine;
+  };
+
+  typedef std::pair<float, int> DistanceIndexPair;
+  // Unexplored subtree with a lower bound of its squared distance to the
+  // query.
+  struct Branch {
+    Branch(float _distance, size_t _tree_index, int _node_index)
+        : distance(_distance),
+          tree_index(_tree_index),
+          node_index(_node_index) {}
+    bool operator>(const Branch& other) const {
+      return distance > other.distance;
+    }
+
+    float distance;
+    size_t tree_index;
+    int node_index;
+  };
+  typedef std::priority_queue<Branch, std::vector<Branch>,
+                              std::greater<Branch> >
+      BranchQueue;
+
+  void InsertIntoTree(int descriptor_index, Tree* tree) {
+    CHECK_NOTNULL(tree);
+    int node_index = 0;
+    while (!tree->nodes[node_index].isLeaf()) {
+      const Node& node = tree->nodes[node_index];
+      const bool is_smaller =
+          descriptors_(node.split_dimension, descriptor_index) <
+          node.split_value;
+      node_index = node.children[is_smaller ? 0 : 1];
+    }
+    Node& leaf = tree->nodes[node_index];
+    leaf.descriptor_indices.push_back(descriptor_index);
+    if (static_cast<int>(leaf.descriptor_indices.size()) >
+        leaf.max_leaf_size) {
+      SplitLeaf(node_index, tree);
+    }
+  }
+
+  void SplitLeaf(int node_index, Tree* tree) {
+    CHECK_NOTNULL(tree);
+    std::vector<int> descriptor_indices;
+    descriptor_indices.swap(tree->nodes[node_index].descriptor_indices);
+
+    Eigen::Matrix<float, kDimVectors, 1> mean;
+    mean.setZero();
+    for (const int descriptor_index : descriptor_indices) {
+      mean += descriptors_.col(descriptor_index);
+    }
+    mean /= static_cast<float>(descriptor_indices.size());
+    Eigen::Matrix<float, kDimVectors, 1> variance;
+    variance.setZero();
+    for (const int descriptor_index : descriptor_indices) {
+      variance += (descriptors_.col(descriptor_index) - mean).cwiseAbs2();
+    }
+
+    // Draw the split dimension from the candidates with the highest variance.
+    std::vector<int> dimensions(kDimVectors);
+    for (int dimension = 0; dimension < kDimVectors; ++dimension) {
+      dimensions[dimension] = dimension;
+    }
+    const int num_candidates =
+        std::min<int>(kNumSplitDimensionCandidates, kDimVectors);
+    std::partial_sort(
+        dimensions.begin(), dimensions.begin() + num_candidates,
+        dimensions.end(), [&variance](int lhs, int rhs) {
+          return variance(lhs) > variance(rhs);
+        });
+    std::uniform_int_distribution<int> candidate_distribution(
+        0, num_candidates - 1);
+    const int split_dimension =
+        dimensions[candidate_distribution(tree->random_engine)];
+    const float split_value = mean(split_dimension);
+
+    std::vector<int> child_descriptor_indices[2];
+    for (const int descriptor_index : descriptor_indices) {
+      const bool is_smaller =
+          descriptors_(split_dimension, descriptor_index) < split_value;
+      child_descriptor_indices[is_smaller ? 0 : 1].push_back(
+          descriptor_index);
+    }
+    if (child_descriptor_indices[0].empty() ||
+        child_descriptor_indices[1].empty()) {
+      // All descriptors are equal along the dimension, try again once the
+      // leaf has doubled in size.
+      Node& leaf = tree->nodes[node_index];
+      leaf.descriptor_indices.swap(descriptor_indices);
+      leaf.max_leaf_size *= 2;
+      return;
+    }
+
+    for (int child = 0; child < 2; ++child) {
+      tree->nodes[node_index].children[child] = tree->nodes.size();
+      tree->nodes.emplace_back(max_leaf_size_);
+      tree->nodes.back().descriptor_indices.swap(
+          child_descriptor_indices[child]);
+    }
+    Node& node = tree->nodes[node_index];
+    node.split_dimension = split_dimension;
+    node.split_value = split_value;
+  }
+
+  // Descends from the branch to the closest leaf, queues the far children on
+  // the way and compares the query to the descriptors in the leaf.
+  void SearchBranch(
+      const Eigen::Matrix<float, kDimVectors, 1>& query, int num_neighbors,
+      float max_squared_distance, const Branch& branch, int* num_checks,
+      std::vector<DistanceIndexPair>* heap, BranchQueue* branches) const {
+    CHECK_NOTNULL(num_checks);
+    CHECK_NOTNULL(heap);
+    CHECK_NOTNULL(branches);
+    const bool is_heap_full = static_cast<int>(heap->size()) == num_neighbors;
+    if (branch.distance > max_squared_distance ||
+        (is_heap_full && branch.distance >= heap->front().first)) {
+      return;
+    }
+
+    const std::vector<Node>& nodes = trees_[branch.tree_index].nodes;
+    int node_index = branch.node_index;
+    while (!nodes[node_index].isLeaf()) {
+      const Node& node = nodes[node_index];
+      const float difference = query(node.split_dimension) - node.split_value;
+      const int near_child = difference < 0.f ? 0 : 1;
+      // As in FLANN the bound accumulates the distances to all split planes
+      // on the path, which is approximate if a dimension is split twice.
+      branches->emplace(
+          branch.distance + difference * difference, branch.tree_index,
+          node.children[1 - near_child]);
+      node_index = node.children[near_child];
+    }
+
+    for (const int descriptor_index : nodes[node_index].descriptor_indices) {
+      ++(*num_checks);
+      const float distance =
+          (descriptors_.col(descriptor_index) - query).squaredNorm();
+      if (distance > max_squared_distance) {
+        continue;
+      }
+      const bool is_full = static_cast<int>(heap->size()) == num_neighbors;
+      if (is_full && distance >= heap->front().first) {
+        continue;
+      }
+      // Every descriptor is in all trees. It can only be closer than the
+      // current neighbors if it has not been compared yet or is one of them.
+      if (std::find_if(
+              heap->begin(), heap->end(),
+              [descriptor_index](const DistanceIndexPair& neighbor) {
+                return neighbor.second == descriptor_index;
+              }) != heap->end()) {
+        continue;
+      }
+      if (!is_full) {
+        heap->emplace_back(distance, descriptor_index);
+        std::push_heap(heap->begin(), heap->end());
+      } else {
+        std::pop_heap(heap->begin(), heap->end());
+        heap->back() = DistanceIndexPair(distance, descriptor_index);
+        std::push_heap(heap->begin(), heap->end());
+      }
+    }
+  }
+
+  DescriptorMatrixType descriptors_;
+  std::vector<Tree> trees_;
+  const int max_checks_;
+  const int max_leaf_size_;
+};
+}  // namespace kd_forest_index
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_KD_FOREST_INDEX_H_
@@ -1,5 +1,6 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_INTERFACE_H_
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -9,6 +10,7 @@
 #include <Eigen/Dense>
 #include <aslam/common/timer.h>
 #include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
 #include <maplab-common/binary-serialization.h>
 #include <matching-based-loopclosure/helpers.h>
 #include <matching-based-loopclosure/index-interface.h>
@@ -31,6 +33,11 @@ class KDTreeIndexInterface : public IndexInterface {
     index_.reset(new Index());
   }
 
+  virtual uint64_t GetProjectionFingerprint() const {
+    return descriptor_projection::ComputeProjectionFingerprint(
+        projection_matrix_, kTargetDimensionality);
+  }
+
   virtual int GetNumDescriptorsInIndex() const {
     return index_->GetNumDescriptorsInIndex();
   }
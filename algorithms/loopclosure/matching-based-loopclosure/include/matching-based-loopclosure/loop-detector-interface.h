@@ -1,7 +1,9 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_INTERFACE_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <descriptor-projection/descriptor-projection.h>
@@ -24,12 +26,25 @@ class LoopDetector {
       const bool parallelize_if_possible,
       loop_closure::FrameToMatches* frame_matches) const = 0;
 
+  // Find multiple queries, each a set of images belonging to the same vertex,
+  // in the database at once. frame_matches_per_query[i] holds the result of
+  // projected_image_ptr_lists[i].
+  virtual void FindBatch(
+      const std::vector<loop_closure::ProjectedImagePtrList>&
+          projected_image_ptr_lists,
+      const bool parallelize_if_possible,
+      std::vector<loop_closure::FrameToMatches>* frame_matches_per_query)
+      const = 0;
+
   // Add the provided image (consisting of projected descriptors) to the
   // descriptor index backend.
   virtual void Insert(
       const std::shared_ptr<loop_closure::ProjectedImage>&
           projected_image_ptr) = 0;
 
+  // Remove all images of the given vertices from the database.
+  virtual void RemoveVertices(const pose_graph::VertexIdSet& vertex_ids) = 0;
+
   // Transforms an image into a set of projected descriptors.
   virtual void ProjectDescriptors(
       const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
@@ -40,7 +55,13 @@ class LoopDetector {
       const loop_closure::DescriptorContainer& descriptors,
       Eigen::MatrixXf* projected_descriptors) const = 0;
 
+  // Identifies the projection of ProjectDescriptors(). Projected descriptors
+  // stored with the same fingerprint can be used instead of projecting again.
+  virtual uint64_t GetProjectionFingerprint() const = 0;
+
   virtual void Clear() = 0;
+  // Converts the database into a read-optimized layout once it is complete.
+  virtual void Freeze() = 0;
   virtual size_t NumEntries() const = 0;
   virtual int NumDescriptors() const = 0;
 
@@ -50,6 +71,17 @@ class LoopDetector {
   virtual void deserialize(
       const matching_based_loopclosure::proto::MatchingBasedLoopDetector&
           matching_based_loop_detector) = 0;
+
+  // Stores the database in a binary snapshot file that can be memory-mapped
+  // by loadSnapshot. The source fingerprint identifies the data the database
+  // was built from. Returns false if the snapshot couldn't be written.
+  virtual bool saveSnapshot(
+      const std::string& file_path,
+      const uint64_t source_fingerprint) const = 0;
+  // Replaces the database with the one of the snapshot. Returns false if there
+  // is no compatible snapshot built from the same source.
+  virtual bool loadSnapshot(
+      const std::string& file_path, const uint64_t source_fingerprint) = 0;
 };
 
 }  // namespace loop_detector
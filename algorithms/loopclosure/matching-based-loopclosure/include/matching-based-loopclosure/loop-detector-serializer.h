@@ -0,0 +1,36 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
+#define MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
+
+#include <cstdint>
+#include <string>
+
+namespace matching_based_loopclosure {
+class MatchingBasedLoopDetector;
+
+// Stores the database of a matching-based loop detector with an inverted
+// multi-index in a binary snapshot file: the words of the vocabulary, the
+// inverted files with the projected descriptors and their indices, the
+// projected images of all keyframes and the mapping of the descriptor indices
+// to the keypoints. All arrays are stored contiguously and read back from a
+// memory mapping of the file, which skips the projection and the word
+// assignment of all descriptors.
+class MatchingBasedLoopDetectorSerializer {
+ public:
+  // The source fingerprint identifies the data the database was built from
+  // and has to be passed again to load the snapshot.
+  static bool saveSnapshot(
+      const MatchingBasedLoopDetector& loop_detector,
+      const uint64_t source_fingerprint, const std::string& file_path);
+
+  // Replaces the database of the loop detector with the one of the snapshot.
+  // Returns false and leaves the loop detector untouched if the file doesn't
+  // exist, was written by an incompatible version, from a different source or
+  // with a different vocabulary.
+  static bool loadSnapshot(
+      const std::string& file_path, const uint64_t source_fingerprint,
+      MatchingBasedLoopDetector* loop_detector);
+};
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_SERIALIZER_H_
@@ -1,7 +1,12 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
 #define MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -10,6 +15,7 @@
 #include <aslam/common/reader-writer-lock.h>
 #include <descriptor-projection/descriptor-projection.h>
 
+#include "matching-based-loopclosure/covisibility-graph.h"
 #include "matching-based-loopclosure/detector-settings.h"
 #include "matching-based-loopclosure/index-interface.h"
 #include "matching-based-loopclosure/loop-detector-interface.h"
@@ -20,10 +26,11 @@ namespace matching_based_loopclosure {
 
 class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
  public:
+  friend class MatchingBasedLoopDetectorSerializer;
   explicit MatchingBasedLoopDetector(
       const MatchingBasedEngineSettings& settings);
 
-  virtual ~MatchingBasedLoopDetector() = default;
+  virtual ~MatchingBasedLoopDetector();
 
   // Find a set of provided images (consisting of projected descriptors), that
   // belong to the same vertex, in the database.
@@ -32,11 +39,27 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const bool parallelize_if_possible,
       loop_closure::FrameToMatches* frame_matches) const override;
 
+  // Same as calling Find for every list of images, but searches the
+  // descriptors of all queries as one batch. Queries that hit the same cells
+  // of the index then share one pass over their inverted files.
+  void FindBatch(
+      const std::vector<loop_closure::ProjectedImagePtrList>&
+          projected_image_ptr_lists,
+      const bool parallelize_if_possible,
+      std::vector<loop_closure::FrameToMatches>* frame_matches_per_query)
+      const override;
+
   // Add the provided image (consisting of projected descriptors) to the
   // descriptor index backend.
   void Insert(
       const loop_closure::ProjectedImage::Ptr& projected_image_ptr) override;
 
+  // Removes the images of the vertices from the database. The descriptors are
+  // only marked as removed in the index, and the inverted files are compacted
+  // in the background once enough of their entries are removed. Only the
+  // inverted multi-index supports removal.
+  void RemoveVertices(const pose_graph::VertexIdSet& vertex_ids) override;
+
   // Transforms an image into a set of projected descriptors.
   void ProjectDescriptors(
       const loop_closure::DescriptorContainer& descriptors,
@@ -47,7 +70,12 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
       Eigen::MatrixXf* projected_descriptors) const override;
 
+  uint64_t GetProjectionFingerprint() const override {
+    return index_interface_->GetProjectionFingerprint();
+  }
+
   void Clear() override;
+  void Freeze() override;
 
   void serialize(proto::MatchingBasedLoopDetector* matching_based_loop_detector)
       const override;
@@ -55,6 +83,12 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const proto::MatchingBasedLoopDetector& matching_based_loop_detector)
       override;
 
+  bool saveSnapshot(
+      const std::string& file_path,
+      const uint64_t source_fingerprint) const override;
+  bool loadSnapshot(
+      const std::string& file_path, const uint64_t source_fingerprint) override;
+
  private:
   typedef std::unordered_map<loop_closure::KeyframeId,
                              loop_closure::ProjectedImage::Ptr>
@@ -65,13 +99,6 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
   typedef std::unordered_map<DescriptorIndex, loop_closure::KeypointId>
       DescriptorIndexToKeypointIdMap;
 
-  typedef loop_closure::IdToMatches<loop_closure::KeyframeId>
-      KeyframeToMatchesMap;
-  typedef loop_closure::IdToMatches<loop_closure::VertexId> VertexToMatchesMap;
-
-  template <typename IdType>
-  using IdToScoreMap = std::unordered_map<IdType, scoring::ScoreType>;
-
   void setKeyframeScoringFunction();
   void setDetectorEngine();
 
@@ -84,52 +111,60 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
   }
 
   // Find the largest connected subgraph of keyframes or vertices and landmarks
-  // to be passed to RANSAC. This is just a plain BFS over landmarks and
-  // keyframes or vertices. This function adds matches to the already existing
-  // matches. There is an option to pass a mutex that is used to lock the
-  // (output) frame matches.
-  template <typename IdType>
+  // to be passed to RANSAC. For keyframes, only the best scoring keyframes are
+  // considered. The matches are filtered in place and the filtering only uses
+  // the scratch buffers and the covisibility graph, i.e. it does not allocate
+  // once the buffers are large enough.
   void doCovisibilityFiltering(
-      const loop_closure::IdToMatches<IdType>& id_to_matches,
-      const bool make_matches_unique,
-      loop_closure::FrameToMatches* frame_matches,
-      std::mutex* frame_matches_mutex = nullptr) const;
-  template <typename IdType>
-  void computeRelevantIdsForFiltering(
-      const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      IdToScoreMap<IdType>* frame_to_score_map) const;
-  // Skip match if not in the set of keyframes that see a lot of the matched
-  // landmarks.
-  template <typename IdType>
-  bool skipMatch(
-      const IdToScoreMap<IdType>& frame_to_score_map,
-      const loop_closure::Match& match) const;
-  template <typename IdType>
-  typename loop_closure::IdToMatches<IdType>::const_iterator
-  getIteratorForMatch(
-      const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      const loop_closure::Match& match) const;
-
-  // Returns true if the match has been successfully retrieved. Returns false,
-  // if the match was too close in time to the query vertex.
-  bool getMatchForDescriptorIndex(
-      int nn_match_descriptor_index,
+      const bool connect_by_vertex, const bool make_matches_unique,
+      CovisibilityFilterScratch* scratch,
+      std::vector<CovisibilityMatch>* matches) const;
+
+  // Adds the matches of all keypoints of the query image, whose nearest
+  // neighbors are stored in the columns starting at first_column. Matches to
+  // images which are too close in time to the query are skipped.
+  void addMatchesForNeighbors(
       const loop_closure::ProjectedImage& projected_image_query,
-      int keypoint_index_query, loop_closure::Match* structure_match) const;
+      int query_image_index, const Eigen::MatrixXi& indices,
+      const Eigen::MatrixXf& distances, int first_column,
+      std::vector<CovisibilityMatch>* matches) const;
+  // Applies the vertex to landmark covisibility filter to the matches of all
+  // images of a query vertex, which are stored in the matches of the scratch,
+  // if requested. The remaining matches are added to the frame matches.
+  void filterMatchesOfVertex(
+      const bool use_vertex_covis_filter,
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+      CovisibilityFilterScratch* scratch,
+      loop_closure::FrameToMatches* frame_matches) const;
+
+  // Rebuilds the covisibility graph from the database, e.g. after
+  // deserialization or removal of vertices.
+  void rebuildCovisibilityGraph();
+
   int getNumNeighborsToSearch() const;
 
+  // Starts compacting the index in the background if enough entries have been
+  // removed and no compaction is running yet.
+  void startCompactionIfNeeded();
+  // Prepares the compacted inverted files under the read lock and swaps them
+  // in under the write lock, so queries are only blocked for the swap.
+  void compactIndex();
+
   const MatchingBasedEngineSettings settings_;
   Database database_;
   KeyframeIdToNumDescriptorsMap keyframe_id_to_num_descriptors_;
   DescriptorIndexToKeypointIdMap descriptor_index_to_keypoint_id_;
   int descriptor_index_;
   std::shared_ptr<loop_closure::IndexInterface> index_interface_;
-  scoring::computeScoresFunction<loop_closure::KeyframeId>
-      compute_keyframe_scores_;
+  scoring::computeDenseScoresFunction compute_keyframe_scores_;
+  CovisibilityGraph covisibility_graph_;
+  mutable CovisibilityFilterScratchPool covisibility_scratch_pool_;
   mutable aslam::ReaderWriterMutex read_write_mutex;
+
+  std::mutex compaction_mutex_;
+  std::thread compaction_thread_;
+  std::atomic<bool> is_compaction_running_;
 };
 }  // namespace matching_based_loopclosure
 
-#include "./matching-based-engine-inl.h"
-
 #endif  // MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
@@ -8,7 +8,6 @@
 #include <utility>
 #include <vector>
 
-#include <boost/math/distributions/binomial.hpp>
 #include <descriptor-projection/descriptor-projection.h>
 #include <loopclosure-common/types.h>
 #include <vi-map/unique-id.h>
@@ -31,6 +30,16 @@ using computeScoresFunction = std::function<void(
         descriptor_count_per_id,
     size_t num_descriptors_in_database, ScoreList<ScoreIdType>* scores)>;
 
+// Same as computeScoresFunction, but for IDs given by dense indices, i.e.
+// num_matches_per_id[i] and num_descriptors_per_id[i] belong to the i-th ID
+// and its score is written to (*scores)[i]. Does not allocate if scores has
+// enough capacity.
+typedef std::function<void(
+    const std::vector<size_t>& num_matches_per_id,
+    const std::vector<size_t>& num_descriptors_per_id,
+    size_t num_descriptors_in_database, std::vector<ScoreType>* scores)>
+    computeDenseScoresFunction;
+
 // Simply score the number of votes/matches for an ID with the number of
 // matches. This is the fastest and simplest scoring function and works well
 // in most scenarios.
@@ -58,6 +67,101 @@ void computeAccumulationScore(
   }
 };
 
+inline void computeDenseAccumulationScore(
+    const std::vector<size_t>& num_matches_per_id,
+    const std::vector<size_t>& /*num_descriptors_per_id*/,
+    size_t /*num_descriptors_in_database*/, std::vector<ScoreType>* scores) {
+  CHECK_NOTNULL(scores);
+  scores->resize(num_matches_per_id.size());
+  for (size_t i = 0u; i < num_matches_per_id.size(); ++i) {
+    (*scores)[i] = static_cast<ScoreType>(num_matches_per_id[i]);
+  }
+}
+
+// Natural logarithm of n!. Tabulated for the vote counts of typical queries,
+// larger arguments fall back to std::lgamma.
+inline double logFactorial(size_t n) {
+  constexpr size_t kNumTabulatedFactorials = 1u << 14;
+  static const std::vector<double> kLogFactorials = [] {
+    std::vector<double> log_factorials(kNumTabulatedFactorials);
+    log_factorials[0] = 0.0;
+    for (size_t i = 1u; i < kNumTabulatedFactorials; ++i) {
+      log_factorials[i] = log_factorials[i - 1u] + std::log(i);
+    }
+    return log_factorials;
+  }();
+  if (n < kNumTabulatedFactorials) {
+    return kLogFactorials[n];
+  }
+  return std::lgamma(static_cast<double>(n) + 1.0);
+}
+
+// Natural logarithm of the binomial probability of num_successes successes
+// in num_trials trials. -infinity if the probability is 0.
+inline double logBinomialProbability(
+    size_t num_trials, size_t num_successes, double success_probability) {
+  CHECK_LE(num_successes, num_trials);
+  CHECK_GE(success_probability, 0.0);
+  CHECK_LE(success_probability, 1.0);
+  const size_t num_failures = num_trials - num_successes;
+  double log_probability = logFactorial(num_trials) -
+                           logFactorial(num_successes) -
+                           logFactorial(num_failures);
+  // Avoids 0 * log(0) for the certain outcomes.
+  if (num_successes > 0u) {
+    log_probability += num_successes * std::log(success_probability);
+  }
+  if (num_failures > 0u) {
+    log_probability += num_failures * std::log1p(-success_probability);
+  }
+  return log_probability;
+}
+
+// Returns the probabilistic score of a single ID, see
+// computeProbabilisticScore. If the probability of the votes is too small to
+// be represented in a double, std::numeric_limits<ScoreType>::max() is
+// returned.
+inline ScoreType computeProbabilisticScoreOfId(
+    size_t num_matches_per_id, size_t num_descriptors_per_id,
+    size_t total_num_matches, size_t num_descriptors_in_database) {
+  CHECK_GT(num_descriptors_per_id, 0u)
+      << "The matching frame must contain "
+      << "at least one descriptor. Otherwise, there cannot be a match.";
+
+  auto score = static_cast<ScoreType>(0);
+  const double success_probability =
+      static_cast<double>(num_descriptors_per_id) /
+      static_cast<double>(num_descriptors_in_database);
+  const auto lower_median_num_votes = static_cast<size_t>(
+      static_cast<double>(total_num_matches) * success_probability);
+
+  // We do not compute scores (they will have a score of 0) of IDs that have
+  // fewer matches than the median/mean because we expect revisited places to
+  // surpass this threshold. Essentially, we cut off the
+  // few-matches-low-probability tail of the binomial distribution. We are
+  // only interested in the numerous-matches-low-probability tail.
+  if (num_matches_per_id > lower_median_num_votes) {
+    // Log probability that the number of votes/matches could be explained by
+    // random matching of descriptors in the database.
+    const double log_random_voting_probability = logBinomialProbability(
+        total_num_matches, num_matches_per_id, success_probability);
+    CHECK_LE(log_random_voting_probability, 1e-9);
+    // Below the smallest subnormal double, where the probability itself
+    // would have underflowed to 0.
+    const double kLogMinProbability =
+        std::log(std::numeric_limits<double>::denorm_min());
+    if (log_random_voting_probability < kLogMinProbability) {
+      score = std::numeric_limits<ScoreType>::max();
+    } else {
+      // A higher score means that a loop is more likely.
+      score = static_cast<ScoreType>(
+          -log_random_voting_probability / std::log(10.0));
+    }
+    CHECK_GT(score, static_cast<ScoreType>(0));
+  }
+  return score;
+}
+
 // Score number of votes associated with an ID in a probabilistic manner.
 //
 // The score returns the negative logarithm of the probability that the number
@@ -82,12 +186,8 @@ void computeAccumulationScore(
 // ones that are available. However, it is possible that you will get better
 // results with other scoring functions for certain datasets.
 //
-// WARNING: This is significantly more expensive than scoring by accumulation.
-//          Make sure that you only use this for a limited number (< 10^4) of
-//          IDs. Can be accelerated significantly by using a smart
-//          implementation (using pre-computed factorials) of the poisson
-//          distribution to approximate the binomial distribution (not yet
-//          implemented).
+// The binomial probabilities are evaluated in log space with tabulated log
+// factorials, which is a few logarithms per ID.
 template <typename ScoreIdType>
 void computeProbabilisticScore(
     const loop_closure::IdToMatches<ScoreIdType>& id_to_matches_map,
@@ -131,51 +231,20 @@ void computeProbabilisticScore(
         it = descriptor_count_per_id.find(id_matches_pair.first);
     CHECK(it != descriptor_count_per_id.cend());
     const size_t num_descriptors_per_id = it->second;
-    CHECK_GT(num_descriptors_per_id, 0u)
-        << "The matching frame must contain "
-        << "at least one descriptor. Otherwise, there cannot be a match.";
-
-    auto score = static_cast<ScoreType>(0);
-    const double success_probability =
-        static_cast<double>(num_descriptors_per_id) /
-        static_cast<double>(num_descriptors_in_database);
-    const auto lower_median_num_votes = static_cast<size_t>(
-        static_cast<double>(total_num_matches) * success_probability);
-
-    // We do not compute scores (they will have a score of 0) of IDs that have
-    // fewer matches than the median/mean because we expect revisited places to
-    // surpass this threshold. Essentially, we cut off the
-    // few-matches-low-probability tail of the binomial distribution. We are
-    // only interested in the numerous-matches-low-probability tail.
-    if (num_matches_per_id > lower_median_num_votes) {
-      // TODO(magehrig): Use poisson approximation for speed-up.
-      boost::math::binomial bin_instance(
-          total_num_matches, success_probability);
-      // Probability that the number of votes/matches could be explained by
-      // random matching of descriptors in the database.
-      const double random_voting_probability =
-          boost::math::pdf(bin_instance, num_matches_per_id);
-      CHECK_GE(random_voting_probability, 0.0);
-      CHECK_LE(random_voting_probability, 1.0);
-      if (random_voting_probability == 0.0) {
-        // This can happen if the probability would be so low that it cannot
-        // be stored in doubles anymore. In that case, we remember the score
-        // entry of the ID with the highest number of associated matches of all
-        // IDs to which this applies.
-        if (num_matches_per_id > num_matches_of_id_with_infinite_score) {
-          num_matches_of_id_with_infinite_score = num_matches_per_id;
-          // Take size as index because we will add this score to the vector
-          // later.
-          index_of_id_with_infinite_score = scores->size();
-        }
-        // Do not yet set score to infinity but max() because at most one score
-        // will be infinity (id with the most matches).
-        score = std::numeric_limits<ScoreType>::max();
-      } else {
-        // A higher score means that a loop is more likely.
-        score = static_cast<ScoreType>(-std::log10(random_voting_probability));
+    const ScoreType score = computeProbabilisticScoreOfId(
+        num_matches_per_id, num_descriptors_per_id, total_num_matches,
+        num_descriptors_in_database);
+    if (score == std::numeric_limits<ScoreType>::max()) {
+      // We remember the score entry of the ID with the highest number of
+      // associated matches of all IDs whose probability underflowed.
+      if (num_matches_per_id > num_matches_of_id_with_infinite_score) {
+        num_matches_of_id_with_infinite_score = num_matches_per_id;
+        // Take size as index because we will add this score to the vector
+        // later.
+        index_of_id_with_infinite_score = scores->size();
       }
-      CHECK_GT(score, static_cast<ScoreType>(0));
+      // Do not yet set score to infinity but max() because at most one score
+      // will be infinity (id with the most matches).
     }
     if (num_matches_of_id_with_infinite_score > 0u) {
       static_assert(std::numeric_limits<ScoreType>::has_infinity, "");
@@ -186,6 +255,47 @@ void computeProbabilisticScore(
   }
 };
 
+inline void computeDenseProbabilisticScore(
+    const std::vector<size_t>& num_matches_per_id,
+    const std::vector<size_t>& num_descriptors_per_id,
+    size_t num_descriptors_in_database, std::vector<ScoreType>* scores) {
+  CHECK_NOTNULL(scores)->clear();
+  static_assert(
+      std::is_arithmetic<ScoreType>::value,
+      "The score type must be arithmetic.");
+  const size_t num_ids = num_matches_per_id.size();
+  CHECK_EQ(num_ids, num_descriptors_per_id.size());
+  if (num_descriptors_in_database == 0u) {
+    LOG(WARNING) << "According to the arguments of this function, the database "
+                 << "is empty.";
+    return;
+  }
+
+  size_t total_num_matches = 0u;
+  for (const size_t num_matches : num_matches_per_id) {
+    total_num_matches += num_matches;
+  }
+
+  scores->resize(num_ids);
+  size_t index_of_id_with_infinite_score = 0u;
+  size_t num_matches_of_id_with_infinite_score = 0u;
+  for (size_t i = 0u; i < num_ids; ++i) {
+    (*scores)[i] = computeProbabilisticScoreOfId(
+        num_matches_per_id[i], num_descriptors_per_id[i], total_num_matches,
+        num_descriptors_in_database);
+    if ((*scores)[i] == std::numeric_limits<ScoreType>::max() &&
+        num_matches_per_id[i] > num_matches_of_id_with_infinite_score) {
+      num_matches_of_id_with_infinite_score = num_matches_per_id[i];
+      index_of_id_with_infinite_score = i;
+    }
+  }
+  if (num_matches_of_id_with_infinite_score > 0u) {
+    static_assert(std::numeric_limits<ScoreType>::has_infinity, "");
+    (*scores)[index_of_id_with_infinite_score] =
+        std::numeric_limits<ScoreType>::infinity();
+  }
+}
+
 }  // namespace scoring
 }  // namespace matching_based_loopclosure
 
@@ -0,0 +1,319 @@
+#include "matching-based-loopclosure/covisibility-graph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace matching_based_loopclosure {
+
+constexpr CovisibilityGraph::DenseIndex CovisibilityGraph::kInvalidIndex;
+
+void CovisibilityGraph::clear() {
+  keyframes_.clear();
+  landmark_ids_.clear();
+  descriptor_keyframe_indices_.clear();
+  descriptor_landmark_indices_.clear();
+  keyframe_id_to_index_.clear();
+  vertex_id_to_index_.clear();
+  landmark_id_to_index_.clear();
+}
+
+CovisibilityGraph::DenseIndex CovisibilityGraph::addKeyframe(
+    const loop_closure::ProjectedImage& projected_image,
+    size_t num_descriptors) {
+  const loop_closure::KeyframeId& keyframe_id = projected_image.keyframe_id;
+  CHECK(keyframe_id.isValid());
+  const DenseIndex keyframe_index = static_cast<DenseIndex>(keyframes_.size());
+  CHECK(keyframe_id_to_index_.emplace(keyframe_id, keyframe_index).second)
+      << "Duplicate keyframe in the covisibility graph.";
+  const DenseIndex num_vertices =
+      static_cast<DenseIndex>(vertex_id_to_index_.size());
+  const DenseIndex vertex_index =
+      vertex_id_to_index_.emplace(keyframe_id.vertex_id, num_vertices)
+          .first->second;
+
+  keyframes_.emplace_back();
+  Keyframe& keyframe = keyframes_.back();
+  keyframe.keyframe_id = keyframe_id;
+  keyframe.vertex_index = vertex_index;
+  keyframe.timestamp_nanoseconds = projected_image.timestamp_nanoseconds;
+  keyframe.dataset_id = projected_image.dataset_id;
+  keyframe.num_descriptors = num_descriptors;
+  return keyframe_index;
+}
+
+void CovisibilityGraph::addDescriptor(
+    int descriptor_index, DenseIndex keyframe_index,
+    const loop_closure::PointLandmarkId& landmark_id) {
+  CHECK_GE(descriptor_index, 0);
+  CHECK_GE(keyframe_index, 0);
+  CHECK_LT(static_cast<size_t>(keyframe_index), keyframes_.size());
+  const size_t descriptor_slot = static_cast<size_t>(descriptor_index);
+  if (descriptor_slot >= descriptor_keyframe_indices_.size()) {
+    descriptor_keyframe_indices_.resize(descriptor_slot + 1u, kInvalidIndex);
+    descriptor_landmark_indices_.resize(descriptor_slot + 1u, kInvalidIndex);
+  }
+  CHECK_EQ(descriptor_keyframe_indices_[descriptor_slot], kInvalidIndex)
+      << "Duplicate descriptor " << descriptor_index
+      << " in the covisibility graph.";
+
+  const DenseIndex num_landmarks =
+      static_cast<DenseIndex>(landmark_ids_.size());
+  const std::pair<std::unordered_map<loop_closure::PointLandmarkId,
+                                     DenseIndex>::const_iterator,
+                  bool>
+      landmark_it = landmark_id_to_index_.emplace(landmark_id, num_landmarks);
+  if (landmark_it.second) {
+    landmark_ids_.push_back(landmark_id);
+  }
+  descriptor_keyframe_indices_[descriptor_slot] = keyframe_index;
+  descriptor_landmark_indices_[descriptor_slot] = landmark_it.first->second;
+}
+
+CovisibilityGraph::DenseIndex CovisibilityGraph::getKeyframeIndex(
+    const loop_closure::KeyframeId& keyframe_id) const {
+  const std::unordered_map<loop_closure::KeyframeId,
+                           DenseIndex>::const_iterator it =
+      keyframe_id_to_index_.find(keyframe_id);
+  return it == keyframe_id_to_index_.cend() ? kInvalidIndex : it->second;
+}
+
+CovisibilityFilterScratchPool::Lease CovisibilityFilterScratchPool::acquire() {
+  std::unique_ptr<CovisibilityFilterScratch> scratch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_scratches_.empty()) {
+      scratch = std::move(free_scratches_.back());
+      free_scratches_.pop_back();
+    }
+  }
+  if (!scratch) {
+    scratch.reset(new CovisibilityFilterScratch);
+  }
+  return Lease(this, std::move(scratch));
+}
+
+void CovisibilityFilterScratchPool::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_scratches_.clear();
+}
+
+void CovisibilityFilterScratchPool::release(
+    std::unique_ptr<CovisibilityFilterScratch> scratch) {
+  CHECK(scratch);
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_scratches_.push_back(std::move(scratch));
+}
+
+void filterMatchesByCovisibility(
+    const CovisibilityGraph& graph, const CovisibilityFilterSettings& settings,
+    CovisibilityFilterScratch* scratch,
+    std::vector<CovisibilityMatch>* matches) {
+  CHECK_NOTNULL(scratch);
+  CHECK_NOTNULL(matches);
+  CHECK(!settings.connect_by_vertex || settings.compute_scores == nullptr)
+      << "Only keyframes can be scored.";
+  if (matches->empty()) {
+    return;
+  }
+  CovisibilityFilterScratch& buffers = *scratch;
+  typedef CovisibilityGraph::DenseIndex DenseIndex;
+  auto get_dense_id = [&graph, &settings](
+      const CovisibilityMatch& match) -> DenseIndex {
+    return settings.connect_by_vertex
+               ? graph.getVertexIndex(match.keyframe_index)
+               : match.keyframe_index;
+  };
+
+  const size_t num_dense_ids = settings.connect_by_vertex
+                                   ? graph.numVertices()
+                                   : graph.numKeyframes();
+  if (buffers.id_stamps.size() < num_dense_ids) {
+    buffers.id_stamps.resize(num_dense_ids, 0u);
+    buffers.id_local_indices.resize(num_dense_ids);
+  }
+  const size_t num_dense_landmarks = graph.numLandmarks();
+  if (buffers.landmark_stamps.size() < num_dense_landmarks) {
+    buffers.landmark_stamps.resize(num_dense_landmarks, 0u);
+    buffers.landmark_local_indices.resize(num_dense_landmarks);
+  }
+  ++buffers.epoch;
+  if (buffers.epoch == 0u) {
+    // The epoch wrapped around, so old stamps could appear valid again.
+    std::fill(buffers.id_stamps.begin(), buffers.id_stamps.end(), 0u);
+    std::fill(
+        buffers.landmark_stamps.begin(), buffers.landmark_stamps.end(), 0u);
+    buffers.epoch = 1u;
+  }
+
+  // Assign local indices to the matched IDs and landmarks and count the
+  // matches of every ID.
+  int num_ids = 0;
+  int num_landmarks = 0;
+  buffers.num_matches_per_id.clear();
+  buffers.num_descriptors_per_id.clear();
+  for (const CovisibilityMatch& match : *matches) {
+    const DenseIndex id = get_dense_id(match);
+    CHECK_GE(id, 0);
+    if (buffers.id_stamps[id] != buffers.epoch) {
+      buffers.id_stamps[id] = buffers.epoch;
+      buffers.id_local_indices[id] = num_ids++;
+      buffers.num_matches_per_id.push_back(0u);
+      buffers.num_descriptors_per_id.push_back(
+          settings.connect_by_vertex
+              ? 0u
+              : graph.getNumDescriptors(match.keyframe_index));
+    }
+    ++buffers.num_matches_per_id[buffers.id_local_indices[id]];
+
+    const DenseIndex landmark = match.landmark_index;
+    CHECK_GE(landmark, 0);
+    if (buffers.landmark_stamps[landmark] != buffers.epoch) {
+      buffers.landmark_stamps[landmark] = buffers.epoch;
+      buffers.landmark_local_indices[landmark] = num_landmarks++;
+    }
+  }
+
+  // Identical matches only count once.
+  std::sort(
+      matches->begin(), matches->end(),
+      [](const CovisibilityMatch& lhs, const CovisibilityMatch& rhs) -> bool {
+        return std::tie(
+                   lhs.query_image_index, lhs.keypoint_index_query,
+                   lhs.keyframe_index, lhs.landmark_index) <
+               std::tie(
+                   rhs.query_image_index, rhs.keypoint_index_query,
+                   rhs.keyframe_index, rhs.landmark_index);
+      });
+  matches->erase(
+      std::unique(
+          matches->begin(), matches->end(),
+          [](const CovisibilityMatch& lhs,
+             const CovisibilityMatch& rhs) -> bool {
+            return lhs.query_image_index == rhs.query_image_index &&
+                   lhs.keypoint_index_query == rhs.keypoint_index_query &&
+                   lhs.keyframe_index == rhs.keyframe_index &&
+                   lhs.landmark_index == rhs.landmark_index;
+          }),
+      matches->end());
+
+  // Only consider the matches of the best scoring IDs, but make sure that we
+  // evaluate at minimum a given number.
+  buffers.is_id_relevant.assign(num_ids, 1);
+  if (settings.compute_scores != nullptr) {
+    (*settings.compute_scores)(
+        buffers.num_matches_per_id, buffers.num_descriptors_per_id,
+        settings.num_descriptors_in_database, &buffers.scores);
+    CHECK_EQ(buffers.scores.size(), static_cast<size_t>(num_ids));
+    constexpr size_t kNumMinimumScoreIdsToEvaluate = 4u;
+    size_t num_score_ids_to_evaluate = std::max<size_t>(
+        static_cast<size_t>(num_ids * settings.fraction_best_scores),
+        kNumMinimumScoreIdsToEvaluate);
+    num_score_ids_to_evaluate =
+        std::min<size_t>(num_score_ids_to_evaluate, num_ids);
+    buffers.score_order.resize(num_ids);
+    std::iota(buffers.score_order.begin(), buffers.score_order.end(), 0);
+    std::nth_element(
+        buffers.score_order.begin(),
+        buffers.score_order.begin() + num_score_ids_to_evaluate,
+        buffers.score_order.end(), [&buffers](int lhs, int rhs) -> bool {
+          return buffers.scores[lhs] > buffers.scores[rhs];
+        });
+    std::fill(buffers.is_id_relevant.begin(), buffers.is_id_relevant.end(), 0);
+    for (size_t i = 0u; i < num_score_ids_to_evaluate; ++i) {
+      buffers.is_id_relevant[buffers.score_order[i]] = 1;
+    }
+  }
+
+  // Connect the IDs and landmarks of all relevant matches. The local IDs are
+  // the nodes [0, num_ids) and the local landmarks follow.
+  const int num_nodes = num_ids + num_landmarks;
+  buffers.component_parents.resize(num_nodes);
+  std::iota(
+      buffers.component_parents.begin(), buffers.component_parents.end(), 0);
+  auto find_root = [&buffers](int node) -> int {
+    while (buffers.component_parents[node] != node) {
+      // Path halving keeps the trees flat.
+      buffers.component_parents[node] =
+          buffers.component_parents[buffers.component_parents[node]];
+      node = buffers.component_parents[node];
+    }
+    return node;
+  };
+  auto get_local_id = [&buffers, &get_dense_id](
+      const CovisibilityMatch& match) -> int {
+    return buffers.id_local_indices[get_dense_id(match)];
+  };
+  for (const CovisibilityMatch& match : *matches) {
+    const int local_id = get_local_id(match);
+    if (!buffers.is_id_relevant[local_id]) {
+      continue;
+    }
+    const int id_root = find_root(local_id);
+    const int landmark_root = find_root(
+        num_ids + buffers.landmark_local_indices[match.landmark_index]);
+    if (id_root != landmark_root) {
+      buffers.component_parents[id_root] = landmark_root;
+    }
+  }
+
+  buffers.component_sizes.assign(num_nodes, 0u);
+  int max_component_root = -1;
+  size_t max_component_size = 0u;
+  for (const CovisibilityMatch& match : *matches) {
+    const int local_id = get_local_id(match);
+    if (!buffers.is_id_relevant[local_id]) {
+      continue;
+    }
+    const int root = find_root(local_id);
+    const size_t component_size = ++buffers.component_sizes[root];
+    if (component_size > max_component_size) {
+      max_component_size = component_size;
+      max_component_root = root;
+    }
+  }
+
+  // Only keep the matches if there is a relevant amount of them.
+  if (max_component_size <= settings.min_num_matches) {
+    matches->clear();
+    return;
+  }
+  matches->erase(
+      std::remove_if(
+          matches->begin(), matches->end(),
+          [&](const CovisibilityMatch& match) -> bool {
+            const int local_id = get_local_id(match);
+            return !buffers.is_id_relevant[local_id] ||
+                   find_root(local_id) != max_component_root;
+          }),
+      matches->end());
+
+  if (settings.make_matches_unique) {
+    // Skip duplicate (keypoint to landmark) matches.
+    std::sort(
+        matches->begin(), matches->end(),
+        [](const CovisibilityMatch& lhs, const CovisibilityMatch& rhs)
+            -> bool {
+              return std::tie(
+                         lhs.query_image_index, lhs.keypoint_index_query,
+                         lhs.landmark_index) <
+                     std::tie(
+                         rhs.query_image_index, rhs.keypoint_index_query,
+                         rhs.landmark_index);
+            });
+    matches->erase(
+        std::unique(
+            matches->begin(), matches->end(),
+            [](const CovisibilityMatch& lhs,
+               const CovisibilityMatch& rhs) -> bool {
+              return lhs.query_image_index == rhs.query_image_index &&
+                     lhs.keypoint_index_query == rhs.keypoint_index_query &&
+                     lhs.landmark_index == rhs.landmark_index;
+            }),
+        matches->end());
+  }
+}
+
+}  // namespace matching_based_loopclosure
@@ -28,6 +28,26 @@ DEFINE_int32(
 DEFINE_int32(
     lc_num_words_for_nn_search, 10,
     "Number of nearest words to retrieve in the inverted index.");
+DEFINE_int32(
+    lc_max_candidates_for_nn_search, 0,
+    "Number of descriptors after which the inverted multi-index stops probing "
+    "further words for a query. 0 always probes lc_num_words_for_nn_search "
+    "words.");
+DEFINE_double(
+    lc_compaction_min_removed_ratio, 0.25,
+    "Ratio of removed to stored index entries after which the inverted files "
+    "are compacted in the background.");
+DEFINE_int32(
+    lc_kd_forest_num_trees, 4,
+    "Number of randomized trees of the kd_forest loop-closure engine.");
+DEFINE_int32(
+    lc_kd_forest_max_checks, 256,
+    "Number of descriptors a query of the kd_forest loop-closure engine is "
+    "compared to. Higher values increase the recall and the search time.");
+DEFINE_int32(
+    lc_kd_forest_max_leaf_size, 16,
+    "Number of descriptors after which a leaf of the kd_forest loop-closure "
+    "engine is split.");
 
 namespace matching_based_loopclosure {
 
@@ -35,16 +55,27 @@ MatchingBasedEngineSettings::MatchingBasedEngineSettings()
     : projection_matrix_filename(FLAGS_lc_projection_matrix_filename),
       projected_quantizer_filename(FLAGS_lc_projected_quantizer_filename),
       num_closest_words_for_nn_search(FLAGS_lc_num_words_for_nn_search),
+      max_candidates_for_nn_search(FLAGS_lc_max_candidates_for_nn_search),
       min_image_time_seconds(FLAGS_lc_min_image_time_seconds),
       min_verify_matches_num(FLAGS_lc_min_verify_matches_num),
       fraction_best_scores(FLAGS_lc_fraction_best_scores),
-      num_nearest_neighbors(FLAGS_lc_num_neighbors) {
+      num_nearest_neighbors(FLAGS_lc_num_neighbors),
+      compaction_min_removed_ratio(FLAGS_lc_compaction_min_removed_ratio),
+      kd_forest_num_trees(FLAGS_lc_kd_forest_num_trees),
+      kd_forest_max_checks(FLAGS_lc_kd_forest_max_checks),
+      kd_forest_max_leaf_size(FLAGS_lc_kd_forest_max_leaf_size) {
   CHECK_GT(num_closest_words_for_nn_search, 0);
+  CHECK_GE(max_candidates_for_nn_search, 0);
   CHECK_GE(min_image_time_seconds, 0.0);
   CHECK_GE(min_verify_matches_num, 0u);
   CHECK_GT(fraction_best_scores, 0.f);
   CHECK_LT(fraction_best_scores, 1.f);
   CHECK_GE(num_nearest_neighbors, -1);
+  CHECK_GE(compaction_min_removed_ratio, 0.0);
+  CHECK_LE(compaction_min_removed_ratio, 1.0);
+  CHECK_GT(kd_forest_num_trees, 0);
+  CHECK_GT(kd_forest_max_checks, 0);
+  CHECK_GT(kd_forest_max_leaf_size, 0);
 
   setKeyframeScoringFunctionType(FLAGS_lc_scoring_function);
   setDetectorEngineType(FLAGS_lc_detector_engine);
@@ -97,6 +128,10 @@ void MatchingBasedEngineSettings::setDetectorEngineType(
   detector_engine_type_string = detector_engine_string;
   if (detector_engine_string == kMatchingLDKdTreeString) {
     detector_engine_type = DetectorEngineType::kMatchingLDKdTree;
+  } else if (detector_engine_string == kMatchingLDCpuBruteForceString) {
+    detector_engine_type = DetectorEngineType::kMatchingLDCpuBruteForce;
+  } else if (detector_engine_string == kMatchingLDKdForestString) {
+    detector_engine_type = DetectorEngineType::kMatchingLDKdForest;
   } else if (detector_engine_string == kMatchingLDInvertedIndexString) {
     detector_engine_type = DetectorEngineType::kMatchingLDInvertedIndex;
   } else if (detector_engine_string == kMatchingLDInvertedMultiIndexString) {
@@ -0,0 +1,622 @@
+#include "matching-based-loopclosure/loop-detector-serializer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/hash-id.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/reader-writer-lock.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <glog/logging.h>
+#include <loopclosure-common/types.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/inverted-multi-index-interface.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+namespace {
+
+// Snapshot file layout, all values in host byte order:
+//   FileHeader
+//   SectionHeader[kNumSections]
+//   the elements of each section, each aligned to kSectionAlignmentBytes
+constexpr char kMagic[8] = {'L', 'C', 'D', 'B', 'S', 'N', 'A', 'P'};
+constexpr uint32_t kVersion = 1u;
+constexpr size_t kSectionAlignmentBytes = 64u;
+
+enum Section : uint32_t {
+  // The two sets of words of the product vocabulary.
+  kWords1,
+  kWords2,
+  kWordIndexMap,
+  // The inverted file i holds the descriptors and indices in the range
+  // [offsets[i], offsets[i + 1]).
+  kInvertedFileOffsets,
+  kInvertedFileDescriptors,
+  kInvertedFileIndices,
+  kKeyframes,
+  // The landmark ids and measurements of all keyframes, concatenated.
+  kLandmarkIds,
+  kMeasurements,
+  kDescriptorKeypoints,
+  kNumSections
+};
+
+typedef loop_closure::InvertedMultiIndexInterface::Index Index;
+typedef Index::InvFile InvertedFile;
+typedef InvertedFile::Descriptor Descriptor;
+static_assert(
+    sizeof(Descriptor) == Descriptor::SizeAtCompileTime * sizeof(float),
+    "The descriptors of an inverted file must be stored without padding.");
+
+typedef uint64_t IdWords[2];
+static_assert(
+    sizeof(aslam::HashId) == sizeof(IdWords),
+    "The ids are stored as two 64 bit words.");
+
+struct WordIndexMapEntry {
+  int32_t visual_word_index;
+  int32_t inverted_file_index;
+};
+
+struct KeyframeRecord {
+  IdWords vertex_id;
+  IdWords dataset_id;
+  int64_t timestamp_nanoseconds;
+  uint64_t frame_index;
+  uint64_t num_descriptors;
+  uint64_t first_landmark;
+  uint64_t num_landmarks;
+  uint64_t first_measurement;
+  uint64_t num_measurements;
+};
+
+struct DescriptorKeypointRecord {
+  int32_t descriptor_index;
+  uint32_t keyframe_index;
+  uint64_t keypoint_index;
+};
+
+constexpr uint32_t kSectionElementSizes[kNumSections] = {
+    sizeof(float),
+    sizeof(float),
+    sizeof(WordIndexMapEntry),
+    sizeof(uint64_t),
+    sizeof(Descriptor),
+    sizeof(int32_t),
+    sizeof(KeyframeRecord),
+    sizeof(IdWords),
+    sizeof(double),
+    sizeof(DescriptorKeypointRecord)};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_sections;
+  uint64_t source_fingerprint;
+  int32_t max_db_descriptor_index;
+  int32_t descriptor_index;
+};
+
+struct SectionHeader {
+  uint32_t section;
+  uint32_t element_size;
+  uint64_t offset;
+  uint64_t num_elements;
+};
+
+size_t alignOffset(size_t offset) {
+  return (offset + kSectionAlignmentBytes - 1u) / kSectionAlignmentBytes *
+         kSectionAlignmentBytes;
+}
+
+template <typename IdType>
+void idToWords(const IdType& id, IdWords words) {
+  aslam::HashId hash_id;
+  id.toHashId(&hash_id);
+  std::memcpy(words, static_cast<const void*>(&hash_id), sizeof(IdWords));
+}
+
+template <typename IdType>
+void idFromWords(const IdWords words, IdType* id) {
+  CHECK_NOTNULL(id);
+  aslam::HashId hash_id;
+  std::memcpy(static_cast<void*>(&hash_id), words, sizeof(IdWords));
+  id->fromHashId(hash_id);
+}
+
+std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+getInvertedMultiIndexInterface(
+    const MatchingBasedEngineSettings& settings,
+    const std::shared_ptr<loop_closure::IndexInterface>& index_interface) {
+  if (settings.detector_engine_type_string !=
+      kMatchingLDInvertedMultiIndexString) {
+    LOG(WARNING) << "Only the inverted multi-index supports snapshots, not "
+                 << settings.detector_engine_type_string << ".";
+    return nullptr;
+  }
+  return std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+      index_interface);
+}
+
+class SectionWriter {
+ public:
+  SectionWriter() : sections_(kNumSections) {}
+
+  template <typename ElementType>
+  void add(Section section, const ElementType* elements, size_t num_elements) {
+    CHECK_LT(section, kNumSections);
+    CHECK_EQ(sizeof(ElementType) % kSectionElementSizes[section], 0u);
+    sections_[section].append(
+        reinterpret_cast<const char*>(elements),
+        num_elements * sizeof(ElementType));
+  }
+
+  template <typename ElementType>
+  void add(Section section, const ElementType& element) {
+    add(section, &element, 1u);
+  }
+
+  bool write(
+      const uint64_t source_fingerprint, const int max_db_descriptor_index,
+      const int descriptor_index, const std::string& file_path) const {
+    FileHeader file_header;
+    std::memcpy(file_header.magic, kMagic, sizeof(kMagic));
+    file_header.version = kVersion;
+    file_header.num_sections = kNumSections;
+    file_header.source_fingerprint = source_fingerprint;
+    file_header.max_db_descriptor_index = max_db_descriptor_index;
+    file_header.descriptor_index = descriptor_index;
+
+    std::vector<SectionHeader> section_headers(kNumSections);
+    size_t offset = sizeof(FileHeader) + kNumSections * sizeof(SectionHeader);
+    for (uint32_t section = 0u; section < kNumSections; ++section) {
+      SectionHeader& section_header = section_headers[section];
+      section_header.section = section;
+      section_header.element_size = kSectionElementSizes[section];
+      offset = alignOffset(offset);
+      section_header.offset = offset;
+      section_header.num_elements =
+          sections_[section].size() / kSectionElementSizes[section];
+      offset += sections_[section].size();
+    }
+
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Unable to open " << file_path << " for writing.";
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&file_header), sizeof(FileHeader));
+    file.write(
+        reinterpret_cast<const char*>(section_headers.data()),
+        kNumSections * sizeof(SectionHeader));
+    for (uint32_t section = 0u; section < kNumSections; ++section) {
+      const size_t position = static_cast<size_t>(file.tellp());
+      CHECK_LE(position, section_headers[section].offset);
+      const std::string padding(
+          section_headers[section].offset - position, '\0');
+      file.write(padding.data(), padding.size());
+      file.write(sections_[section].data(), sections_[section].size());
+    }
+    file.close();
+    if (file.fail()) {
+      LOG(ERROR) << "Failed to write " << file_path;
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::string> sections_;
+};
+
+// Provides the sections of a read-only memory mapping of a snapshot file.
+class SectionReader {
+ public:
+  explicit SectionReader(const std::string& file_path)
+      : data_(nullptr), num_bytes_(0u) {
+    const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) == 0 && file_stat.st_size > 0) {
+      void* data = mmap(
+          nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ,
+          MAP_PRIVATE, file_descriptor, 0);
+      if (data == MAP_FAILED) {
+        LOG(ERROR) << "Unable to map " << file_path;
+      } else {
+        data_ = static_cast<const char*>(data);
+        num_bytes_ = static_cast<size_t>(file_stat.st_size);
+      }
+    }
+    close(file_descriptor);
+  }
+
+  ~SectionReader() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), num_bytes_);
+    }
+  }
+
+  bool isOpen() const {
+    return data_ != nullptr;
+  }
+
+  // Checks the header and the bounds of all sections.
+  bool isValid() const {
+    if (data_ == nullptr ||
+        num_bytes_ <
+            sizeof(FileHeader) + kNumSections * sizeof(SectionHeader)) {
+      return false;
+    }
+    const FileHeader& file_header = getFileHeader();
+    if (std::memcmp(file_header.magic, kMagic, sizeof(kMagic)) != 0) {
+      LOG(WARNING) << "Not a loop detector snapshot file.";
+      return false;
+    }
+    if (file_header.version != kVersion ||
+        file_header.num_sections != kNumSections) {
+      LOG(WARNING) << "Unsupported loop detector snapshot version "
+                   << file_header.version << ", expected " << kVersion << ".";
+      return false;
+    }
+    for (uint32_t section = 0u; section < kNumSections; ++section) {
+      const SectionHeader& section_header = getSectionHeader(section);
+      if (section_header.section != section ||
+          section_header.element_size != kSectionElementSizes[section] ||
+          section_header.offset % kSectionAlignmentBytes != 0u ||
+          section_header.offset > num_bytes_ ||
+          section_header.num_elements >
+              (num_bytes_ - section_header.offset) /
+                  section_header.element_size) {
+        LOG(WARNING) << "Corrupt loop detector snapshot section " << section
+                     << ".";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const FileHeader& getFileHeader() const {
+    CHECK_NOTNULL(data_);
+    return *reinterpret_cast<const FileHeader*>(data_);
+  }
+
+  template <typename ElementType>
+  const ElementType* getSection(Section section, size_t* num_elements) const {
+    CHECK_LT(section, kNumSections);
+    CHECK_NOTNULL(num_elements);
+    CHECK_EQ(sizeof(ElementType), kSectionElementSizes[section]);
+    const SectionHeader& section_header = getSectionHeader(section);
+    *num_elements = section_header.num_elements;
+    return reinterpret_cast<const ElementType*>(data_ + section_header.offset);
+  }
+
+ private:
+  const SectionHeader& getSectionHeader(uint32_t section) const {
+    return reinterpret_cast<const SectionHeader*>(
+        data_ + sizeof(FileHeader))[section];
+  }
+
+  const char* data_;
+  size_t num_bytes_;
+};
+
+bool isSectionEqual(
+    const SectionReader& reader, Section section,
+    const Eigen::MatrixXf& matrix) {
+  size_t num_elements;
+  const float* elements = reader.getSection<float>(section, &num_elements);
+  return num_elements == static_cast<size_t>(matrix.size()) &&
+         std::memcmp(elements, matrix.data(), num_elements * sizeof(float)) ==
+             0;
+}
+
+}  // namespace
+
+bool MatchingBasedLoopDetectorSerializer::saveSnapshot(
+    const MatchingBasedLoopDetector& loop_detector,
+    const uint64_t source_fingerprint, const std::string& file_path) {
+  const std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      index_interface = getInvertedMultiIndexInterface(
+          loop_detector.settings_, loop_detector.index_interface_);
+  if (!index_interface) {
+    return false;
+  }
+  aslam::ScopedReadLock lock(&loop_detector.read_write_mutex);
+  CHECK(index_interface->index_);
+  const Index& index = *index_interface->index_;
+
+  SectionWriter writer;
+  writer.add(kWords1, index.words_1_.data(), index.words_1_.size());
+  writer.add(kWords2, index.words_2_.data(), index.words_2_.size());
+  for (const std::pair<const int, int>& word_index_entry :
+       index.word_index_map_) {
+    writer.add(
+        kWordIndexMap,
+        WordIndexMapEntry{word_index_entry.first, word_index_entry.second});
+  }
+
+  // Removed descriptors are dropped, as if the index had been compacted.
+  uint64_t inverted_file_offset = 0u;
+  writer.add(kInvertedFileOffsets, inverted_file_offset);
+  const size_t num_inverted_files = index.GetNumInvertedFiles();
+  for (size_t file_idx = 0u; file_idx < num_inverted_files; ++file_idx) {
+    index.ForEachInvertedFileEntry(
+        file_idx, [&](int descriptor_index, const Descriptor& descriptor) {
+          if (index.IsDescriptorRemoved(descriptor_index)) {
+            return;
+          }
+          writer.add(kInvertedFileDescriptors, descriptor);
+          writer.add(
+              kInvertedFileIndices, static_cast<int32_t>(descriptor_index));
+          ++inverted_file_offset;
+        });
+    writer.add(kInvertedFileOffsets, inverted_file_offset);
+  }
+
+  std::unordered_map<loop_closure::KeyframeId, uint32_t> keyframe_indices;
+  keyframe_indices.reserve(loop_detector.database_.size());
+  uint64_t num_landmarks = 0u;
+  uint64_t num_measurements = 0u;
+  for (const MatchingBasedLoopDetector::Database::value_type& database_entry :
+       loop_detector.database_) {
+    CHECK(database_entry.second);
+    const loop_closure::ProjectedImage& projected_image =
+        *database_entry.second;
+    const MatchingBasedLoopDetector::KeyframeIdToNumDescriptorsMap::
+        const_iterator num_descriptors_it =
+            loop_detector.keyframe_id_to_num_descriptors_.find(
+                database_entry.first);
+
+    KeyframeRecord keyframe;
+    idToWords(database_entry.first.vertex_id, keyframe.vertex_id);
+    idToWords(projected_image.dataset_id, keyframe.dataset_id);
+    keyframe.timestamp_nanoseconds = projected_image.timestamp_nanoseconds;
+    keyframe.frame_index = database_entry.first.frame_index;
+    keyframe.num_descriptors =
+        num_descriptors_it ==
+                loop_detector.keyframe_id_to_num_descriptors_.end()
+            ? 0u
+            : num_descriptors_it->second;
+    keyframe.first_landmark = num_landmarks;
+    keyframe.num_landmarks = projected_image.landmarks.size();
+    keyframe.first_measurement = num_measurements;
+    keyframe.num_measurements = projected_image.measurements.size();
+    writer.add(kKeyframes, keyframe);
+
+    for (const loop_closure::PointLandmarkId& landmark_id :
+         projected_image.landmarks) {
+      IdWords landmark_id_words;
+      idToWords(landmark_id, landmark_id_words);
+      writer.add(kLandmarkIds, landmark_id_words);
+    }
+    writer.add(
+        kMeasurements, projected_image.measurements.data(),
+        projected_image.measurements.size());
+    num_landmarks += keyframe.num_landmarks;
+    num_measurements += keyframe.num_measurements;
+
+    CHECK(
+        keyframe_indices
+            .emplace(database_entry.first, keyframe_indices.size())
+            .second);
+  }
+
+  for (const MatchingBasedLoopDetector::DescriptorIndexToKeypointIdMap::
+           value_type& descriptor_keypoint :
+       loop_detector.descriptor_index_to_keypoint_id_) {
+    const std::unordered_map<loop_closure::KeyframeId, uint32_t>::
+        const_iterator keyframe_index_it =
+            keyframe_indices.find(descriptor_keypoint.second.frame_id);
+    CHECK(keyframe_index_it != keyframe_indices.end())
+        << "The descriptor " << descriptor_keypoint.first
+        << " belongs to a keyframe that is not in the database.";
+    writer.add(
+        kDescriptorKeypoints,
+        DescriptorKeypointRecord{descriptor_keypoint.first,
+                                 keyframe_index_it->second,
+                                 descriptor_keypoint.second.keypoint_index});
+  }
+
+  return writer.write(
+      source_fingerprint, index.max_db_descriptor_index_,
+      loop_detector.descriptor_index_, file_path);
+}
+
+bool MatchingBasedLoopDetectorSerializer::loadSnapshot(
+    const std::string& file_path, const uint64_t source_fingerprint,
+    MatchingBasedLoopDetector* loop_detector) {
+  CHECK_NOTNULL(loop_detector);
+  const std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      index_interface = getInvertedMultiIndexInterface(
+          loop_detector->settings_, loop_detector->index_interface_);
+  if (!index_interface) {
+    return false;
+  }
+  CHECK(index_interface->index_);
+  Index& index = *index_interface->index_;
+
+  const SectionReader reader(file_path);
+  if (!reader.isOpen()) {
+    VLOG(1) << "No loop detector snapshot at " << file_path << ".";
+    return false;
+  }
+  if (!reader.isValid()) {
+    return false;
+  }
+  const FileHeader& file_header = reader.getFileHeader();
+  if (file_header.source_fingerprint != source_fingerprint) {
+    VLOG(1) << "The loop detector snapshot at " << file_path
+            << " was built from different data.";
+    return false;
+  }
+  if (!isSectionEqual(reader, kWords1, index.words_1_) ||
+      !isSectionEqual(reader, kWords2, index.words_2_)) {
+    LOG(WARNING) << "The loop detector snapshot at " << file_path
+                 << " was built with a different vocabulary.";
+    return false;
+  }
+
+  size_t num_offsets, num_descriptors, num_indices;
+  const uint64_t* offsets =
+      reader.getSection<uint64_t>(kInvertedFileOffsets, &num_offsets);
+  const Descriptor* descriptors =
+      reader.getSection<Descriptor>(kInvertedFileDescriptors, &num_descriptors);
+  const int32_t* indices =
+      reader.getSection<int32_t>(kInvertedFileIndices, &num_indices);
+  if (num_offsets == 0u || offsets[0] != 0u ||
+      offsets[num_offsets - 1u] != num_descriptors ||
+      num_indices != num_descriptors ||
+      file_header.max_db_descriptor_index < 0 ||
+      num_descriptors >
+          static_cast<size_t>(file_header.max_db_descriptor_index)) {
+    LOG(WARNING) << "Corrupt inverted files in " << file_path << ".";
+    return false;
+  }
+  const size_t num_inverted_files = num_offsets - 1u;
+  Aligned<std::vector, InvertedFile> inverted_files(num_inverted_files);
+  for (size_t file_idx = 0u; file_idx < num_inverted_files; ++file_idx) {
+    const uint64_t begin = offsets[file_idx];
+    const uint64_t end = offsets[file_idx + 1u];
+    if (end < begin || end > num_descriptors) {
+      LOG(WARNING) << "Corrupt inverted files in " << file_path << ".";
+      return false;
+    }
+    InvertedFile& inverted_file = inverted_files[file_idx];
+    inverted_file.descriptors_.assign(descriptors + begin, descriptors + end);
+    inverted_file.indices_.assign(indices + begin, indices + end);
+  }
+
+  size_t num_word_index_entries;
+  const WordIndexMapEntry* word_index_entries =
+      reader.getSection<WordIndexMapEntry>(
+          kWordIndexMap, &num_word_index_entries);
+  std::unordered_map<int, int> word_index_map;
+  word_index_map.reserve(num_word_index_entries);
+  for (size_t entry_idx = 0u; entry_idx < num_word_index_entries;
+       ++entry_idx) {
+    const WordIndexMapEntry& entry = word_index_entries[entry_idx];
+    if (entry.inverted_file_index < 0 ||
+        static_cast<size_t>(entry.inverted_file_index) >= num_inverted_files) {
+      LOG(WARNING) << "Corrupt word index map in " << file_path << ".";
+      return false;
+    }
+    word_index_map.emplace(entry.visual_word_index, entry.inverted_file_index);
+  }
+
+  size_t num_keyframes, num_landmark_ids, num_measurements;
+  const KeyframeRecord* keyframes =
+      reader.getSection<KeyframeRecord>(kKeyframes, &num_keyframes);
+  const IdWords* landmark_ids =
+      reader.getSection<IdWords>(kLandmarkIds, &num_landmark_ids);
+  const double* measurements =
+      reader.getSection<double>(kMeasurements, &num_measurements);
+  std::vector<loop_closure::KeyframeId> keyframe_ids(num_keyframes);
+  MatchingBasedLoopDetector::Database database;
+  database.reserve(num_keyframes);
+  MatchingBasedLoopDetector::KeyframeIdToNumDescriptorsMap
+      keyframe_id_to_num_descriptors;
+  keyframe_id_to_num_descriptors.reserve(num_keyframes);
+  for (size_t keyframe_idx = 0u; keyframe_idx < num_keyframes;
+       ++keyframe_idx) {
+    const KeyframeRecord& keyframe = keyframes[keyframe_idx];
+    if (keyframe.first_landmark > num_landmark_ids ||
+        keyframe.num_landmarks > num_landmark_ids - keyframe.first_landmark ||
+        keyframe.first_measurement > num_measurements ||
+        keyframe.num_measurements >
+            num_measurements - keyframe.first_measurement ||
+        keyframe.num_measurements % 2u != 0u) {
+      LOG(WARNING) << "Corrupt keyframe " << keyframe_idx << " in "
+                   << file_path << ".";
+      return false;
+    }
+    loop_closure::KeyframeId& keyframe_id = keyframe_ids[keyframe_idx];
+    idFromWords(keyframe.vertex_id, &keyframe_id.vertex_id);
+    keyframe_id.frame_index = keyframe.frame_index;
+
+    std::shared_ptr<loop_closure::ProjectedImage> projected_image =
+        std::make_shared<loop_closure::ProjectedImage>();
+    projected_image->keyframe_id = keyframe_id;
+    idFromWords(keyframe.dataset_id, &projected_image->dataset_id);
+    projected_image->timestamp_nanoseconds = keyframe.timestamp_nanoseconds;
+    // The database doesn't keep the descriptors of the images, they are
+    // stored in the index only.
+    projected_image->projected_descriptors.resize(
+        Descriptor::RowsAtCompileTime, 0);
+    projected_image->landmarks.resize(keyframe.num_landmarks);
+    for (size_t landmark_idx = 0u; landmark_idx < keyframe.num_landmarks;
+         ++landmark_idx) {
+      idFromWords(
+          landmark_ids[keyframe.first_landmark + landmark_idx],
+          &projected_image->landmarks[landmark_idx]);
+    }
+    projected_image->measurements = Eigen::Map<const Eigen::Matrix2Xd>(
+        measurements + keyframe.first_measurement, 2,
+        keyframe.num_measurements / 2u);
+
+    if (!database.emplace(keyframe_id, projected_image).second) {
+      LOG(WARNING) << "Duplicate keyframe " << keyframe_idx << " in "
+                   << file_path << ".";
+      return false;
+    }
+    if (keyframe.num_descriptors > 0u) {
+      keyframe_id_to_num_descriptors.emplace(
+          keyframe_id, keyframe.num_descriptors);
+    }
+  }
+
+  size_t num_descriptor_keypoints;
+  const DescriptorKeypointRecord* descriptor_keypoints =
+      reader.getSection<DescriptorKeypointRecord>(
+          kDescriptorKeypoints, &num_descriptor_keypoints);
+  MatchingBasedLoopDetector::DescriptorIndexToKeypointIdMap
+      descriptor_index_to_keypoint_id;
+  descriptor_index_to_keypoint_id.reserve(num_descriptor_keypoints);
+  for (size_t record_idx = 0u; record_idx < num_descriptor_keypoints;
+       ++record_idx) {
+    const DescriptorKeypointRecord& record = descriptor_keypoints[record_idx];
+    if (record.keyframe_index >= num_keyframes) {
+      LOG(WARNING) << "Corrupt descriptor index map in " << file_path << ".";
+      return false;
+    }
+    descriptor_index_to_keypoint_id.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(record.descriptor_index),
+        std::forward_as_tuple(
+            keyframe_ids[record.keyframe_index], record.keypoint_index));
+  }
+
+  aslam::ScopedWriteLock lock(&loop_detector->read_write_mutex);
+  index.Clear();
+  index.inverted_files_.swap(inverted_files);
+  index.word_index_map_.swap(word_index_map);
+  index.max_db_descriptor_index_ = file_header.max_db_descriptor_index;
+  index.resetRemovedDescriptors(
+      file_header.max_db_descriptor_index - static_cast<int>(num_descriptors));
+  loop_detector->database_.swap(database);
+  loop_detector->keyframe_id_to_num_descriptors_.swap(
+      keyframe_id_to_num_descriptors);
+  loop_detector->descriptor_index_to_keypoint_id_.swap(
+      descriptor_index_to_keypoint_id);
+  loop_detector->descriptor_index_ = file_header.descriptor_index;
+  loop_detector->rebuildCovisibilityGraph();
+  return true;
+}
+
+}  // namespace matching_based_loopclosure
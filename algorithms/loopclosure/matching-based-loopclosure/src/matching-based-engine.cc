@@ -1,10 +1,10 @@
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -12,14 +12,18 @@
 #include <loopclosure-common/types.h>
 #include <maplab-common/conversions.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/telemetry.h>
 #include <nabo/nabo.h>
 #include <vi-map/loop-constraint.h>
 
+#include "matching-based-loopclosure/brute-force-index-interface.h"
 #include "matching-based-loopclosure/detector-settings.h"
 #include "matching-based-loopclosure/helpers.h"
 #include "matching-based-loopclosure/inverted-index-interface.h"
 #include "matching-based-loopclosure/inverted-multi-index-interface.h"
+#include "matching-based-loopclosure/kd-forest-index-interface.h"
 #include "matching-based-loopclosure/kd-tree-index-interface.h"
+#include "matching-based-loopclosure/loop-detector-serializer.h"
 #include "matching-based-loopclosure/matching-based-engine.h"
 #include "matching-based-loopclosure/scoring.h"
 
@@ -27,7 +31,9 @@ namespace matching_based_loopclosure {
 
 MatchingBasedLoopDetector::MatchingBasedLoopDetector(
     const MatchingBasedEngineSettings& settings)
-    : settings_(settings), descriptor_index_(0) {
+    : settings_(settings),
+      descriptor_index_(0),
+      is_compaction_running_(false) {
   setKeyframeScoringFunction();
   setDetectorEngine();
 
@@ -38,6 +44,13 @@ MatchingBasedLoopDetector::MatchingBasedLoopDetector(
           << "\n\tproj matrix: " << settings_.projection_matrix_filename;
 }
 
+MatchingBasedLoopDetector::~MatchingBasedLoopDetector() {
+  std::lock_guard<std::mutex> compaction_lock(compaction_mutex_);
+  if (compaction_thread_.joinable()) {
+    compaction_thread_.join();
+  }
+}
+
 void MatchingBasedLoopDetector::ProjectDescriptors(
     const aslam::VisualFrame::DescriptorsT& descriptors,
     Eigen::MatrixXf* projected_descriptors) const {
@@ -61,7 +74,9 @@ void MatchingBasedLoopDetector::Find(
   }
   CHECK(doProjectedImagesBelongToSameVertex(projected_image_ptr_list));
 
-  timing::Timer timer_find("Loop Closure: Find projected images of vertex.");
+  static const common::telemetry::TimerMetric kTimerFind(
+      "Loop Closure: Find projected images of vertex.");
+  common::telemetry::ScopedTimer timer_find(kTimerFind);
   aslam::ScopedReadLock lock(&read_write_mutex);
 
   const int num_neighbors_to_search = getNumNeighborsToSearch();
@@ -71,13 +86,18 @@ void MatchingBasedLoopDetector::Find(
   const bool use_vertex_covis_filter = num_query_frames > 1u;
   const bool parallelize = parallelize_if_possible && num_query_frames > 1u;
 
-  loop_closure::FrameToMatches temporary_frame_matches;
-  std::mutex covis_frame_matches_mutex;
-  std::mutex* covis_frame_matches_mutex_ptr =
-      parallelize ? &covis_frame_matches_mutex : nullptr;
+  // The matches of all query images that passed the keyframe covisibility
+  // filter.
+  CovisibilityFilterScratchPool::Lease vertex_scratch =
+      covisibility_scratch_pool_.acquire();
+  vertex_scratch->matches.clear();
+  std::mutex vertex_matches_mutex;
 
   std::function<void(const std::vector<size_t>&)> query_helper = [&](
       const std::vector<size_t>& range) {
+    CovisibilityFilterScratchPool::Lease scratch =
+        covisibility_scratch_pool_.acquire();
+    std::vector<CovisibilityMatch>& image_matches = scratch->matches;
     for (const size_t job_index : range) {
       const loop_closure::ProjectedImage& projected_image_query =
           *projected_image_ptr_list[job_index];
@@ -90,7 +110,9 @@ void MatchingBasedLoopDetector::Find(
       indices.resize(num_neighbors_to_search, num_descriptors_in_query_image);
       Eigen::MatrixXf distances;
       distances.resize(num_neighbors_to_search, num_descriptors_in_query_image);
-      timing::Timer timer_get_nn("Loop Closure: Get neighbors");
+      static const common::telemetry::TimerMetric kTimerGetNn(
+          "Loop Closure: Get neighbors");
+      common::telemetry::ScopedTimer timer_get_nn(kTimerGetNn);
       // If this loop is running in multiple threads and the inverted
       // multi index is utilized as NN search structure, ensure that the nearest
       // neighbor back-end (libnabo) is not multi-threaded. Otherwise,
@@ -98,38 +120,27 @@ void MatchingBasedLoopDetector::Find(
       index_interface_->GetNNearestNeighborsForFeatures(
           projected_image_query.projected_descriptors, num_neighbors_to_search,
           &indices, &distances);
-      timer_get_nn.Stop();
-
-      KeyframeToMatchesMap keyframe_to_matches_map;
-      for (int keypoint_idx = 0; keypoint_idx < indices.cols();
-           ++keypoint_idx) {
-        for (int nn_search_idx = 0; nn_search_idx < indices.rows();
-             ++nn_search_idx) {
-          const int nn_match_descriptor_idx =
-              indices(nn_search_idx, keypoint_idx);
-          const float nn_match_distance =
-              distances(nn_search_idx, keypoint_idx);
-          if (nn_match_descriptor_idx == -1 ||
-              nn_match_distance == std::numeric_limits<float>::infinity()) {
-            break;  // No more results for this feature.
-          }
-          loop_closure::Match structure_match;
-          if (!getMatchForDescriptorIndex(
-                  nn_match_descriptor_idx, projected_image_query, keypoint_idx,
-                  &structure_match)) {
-            continue;
-          }
-
-          keyframe_to_matches_map[structure_match.keyframe_id_result].push_back(
-              structure_match);
-        }
-      }
+      timer_get_nn.stop();
+
+      image_matches.clear();
+      constexpr int kFirstColumn = 0;
+      addMatchesForNeighbors(
+          projected_image_query, static_cast<int>(job_index), indices,
+          distances, kFirstColumn, &image_matches);
       // We don't want to enforce unique matches yet in case of additional
       // vertex-landmark covisibility filtering. The reason for this is that
       // removing non-unique matches can split covisibility clusters.
+      constexpr bool kConnectByVertex = false;
       doCovisibilityFiltering(
-          keyframe_to_matches_map, !use_vertex_covis_filter,
-          &temporary_frame_matches, covis_frame_matches_mutex_ptr);
+          kConnectByVertex, !use_vertex_covis_filter, scratch.get(),
+          &image_matches);
+
+      auto lock = parallelize
+                      ? std::unique_lock<std::mutex>(vertex_matches_mutex)
+                      : std::unique_lock<std::mutex>();
+      vertex_scratch->matches.insert(
+          vertex_scratch->matches.end(), image_matches.begin(),
+          image_matches.end());
     }
   };
   if (parallelize) {
@@ -147,74 +158,233 @@ void MatchingBasedLoopDetector::Find(
     query_helper(proj_img_indices);
   }
 
-  if (use_vertex_covis_filter) {
-    // Convert keyframe matches to vertex matches.
-    const size_t num_frame_matches =
-        loop_closure::getNumberOfMatches(temporary_frame_matches);
-    VertexToMatchesMap vertex_to_matches_map;
-    // Conservative reserve to avoid rehashing.
-    vertex_to_matches_map.reserve(num_frame_matches);
-    for (const loop_closure::FrameToMatches::value_type& id_frame_matches_pair :
-         temporary_frame_matches) {
-      for (const loop_closure::Match& match : id_frame_matches_pair.second) {
-        vertex_to_matches_map[match.keyframe_id_result.vertex_id].push_back(
-            match);
+  filterMatchesOfVertex(
+      use_vertex_covis_filter, projected_image_ptr_list, vertex_scratch.get(),
+      frame_matches_ptr);
+  CHECK_LE(frame_matches_ptr->size(), projected_image_ptr_list.size())
+      << "There cannot be more query frames than projected images.";
+}
+
+void MatchingBasedLoopDetector::FindBatch(
+    const std::vector<loop_closure::ProjectedImagePtrList>&
+        projected_image_ptr_lists,
+    const bool parallelize_if_possible,
+    std::vector<loop_closure::FrameToMatches>* frame_matches_per_query) const {
+  CHECK_NOTNULL(frame_matches_per_query)->clear();
+  const size_t num_queries = projected_image_ptr_lists.size();
+  frame_matches_per_query->resize(num_queries);
+  if (num_queries == 0u) {
+    return;
+  }
+
+  static const common::telemetry::TimerMetric kTimerFind(
+      "Loop Closure: Find batch of vertices.");
+  common::telemetry::ScopedTimer timer_find(kTimerFind);
+  aslam::ScopedReadLock lock(&read_write_mutex);
+  const int num_neighbors_to_search = getNumNeighborsToSearch();
+
+  // Every block of queries is searched as one batch, i.e. the descriptors of
+  // all its images are stacked and passed to the index at once.
+  std::function<void(const std::vector<size_t>&)> batch_helper = [&](
+      const std::vector<size_t>& range) {
+    int num_descriptor_rows = 0;
+    int num_descriptors = 0;
+    for (const size_t query_index : range) {
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list =
+          projected_image_ptr_lists[query_index];
+      if (projected_image_ptr_list.empty()) {
+        // Nothing to search if the query is empty.
+        continue;
+      }
+      CHECK(doProjectedImagesBelongToSameVertex(projected_image_ptr_list));
+      for (const loop_closure::ProjectedImage::Ptr& projected_image :
+           projected_image_ptr_list) {
+        const Eigen::MatrixXf& projected_descriptors =
+            projected_image->projected_descriptors;
+        CHECK_EQ(
+            projected_descriptors.cols(),
+            projected_image->measurements.cols());
+        if (projected_descriptors.cols() == 0) {
+          continue;
+        }
+        if (num_descriptors == 0) {
+          num_descriptor_rows = projected_descriptors.rows();
+        }
+        CHECK_EQ(projected_descriptors.rows(), num_descriptor_rows);
+        num_descriptors += projected_descriptors.cols();
       }
     }
-    doCovisibilityFiltering(
-        vertex_to_matches_map, use_vertex_covis_filter, frame_matches_ptr);
+
+    Eigen::MatrixXi indices(num_neighbors_to_search, num_descriptors);
+    Eigen::MatrixXf distances(num_neighbors_to_search, num_descriptors);
+    if (num_descriptors > 0) {
+      Eigen::MatrixXf query_descriptors(num_descriptor_rows, num_descriptors);
+      int column = 0;
+      for (const size_t query_index : range) {
+        for (const loop_closure::ProjectedImage::Ptr& projected_image :
+             projected_image_ptr_lists[query_index]) {
+          const Eigen::MatrixXf& projected_descriptors =
+              projected_image->projected_descriptors;
+          query_descriptors.middleCols(column, projected_descriptors.cols()) =
+              projected_descriptors;
+          column += projected_descriptors.cols();
+        }
+      }
+      static const common::telemetry::TimerMetric kTimerGetNn(
+          "Loop Closure: Get neighbors of batch");
+      common::telemetry::ScopedTimer timer_get_nn(kTimerGetNn);
+      index_interface_->GetNNearestNeighborsForFeatures(
+          query_descriptors, num_neighbors_to_search, &indices, &distances);
+      timer_get_nn.stop();
+    }
+
+    CovisibilityFilterScratchPool::Lease image_scratch =
+        covisibility_scratch_pool_.acquire();
+    CovisibilityFilterScratchPool::Lease vertex_scratch =
+        covisibility_scratch_pool_.acquire();
+    std::vector<CovisibilityMatch>& image_matches = image_scratch->matches;
+    int first_column = 0;
+    for (const size_t query_index : range) {
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list =
+          projected_image_ptr_lists[query_index];
+      const bool use_vertex_covis_filter = projected_image_ptr_list.size() > 1u;
+      vertex_scratch->matches.clear();
+      for (size_t image_index = 0u;
+           image_index < projected_image_ptr_list.size(); ++image_index) {
+        const loop_closure::ProjectedImage& projected_image =
+            *projected_image_ptr_list[image_index];
+        image_matches.clear();
+        addMatchesForNeighbors(
+            projected_image, static_cast<int>(image_index), indices,
+            distances, first_column, &image_matches);
+        first_column += projected_image.projected_descriptors.cols();
+        constexpr bool kConnectByVertex = false;
+        doCovisibilityFiltering(
+            kConnectByVertex, !use_vertex_covis_filter, image_scratch.get(),
+            &image_matches);
+        vertex_scratch->matches.insert(
+            vertex_scratch->matches.end(), image_matches.begin(),
+            image_matches.end());
+      }
+      filterMatchesOfVertex(
+          use_vertex_covis_filter, projected_image_ptr_list,
+          vertex_scratch.get(), &(*frame_matches_per_query)[query_index]);
+    }
+    CHECK_EQ(first_column, num_descriptors);
+  };
+
+  if (parallelize_if_possible && num_queries > 1u) {
+    constexpr bool kAlwaysParallelize = false;
+    static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
+    common::ParallelProcess(
+        num_queries, batch_helper, kAlwaysParallelize, kNumHardwareThreads);
   } else {
-    frame_matches_ptr->swap(temporary_frame_matches);
+    std::vector<size_t> query_indices(num_queries);
+    std::iota(query_indices.begin(), query_indices.end(), 0u);
+    batch_helper(query_indices);
   }
-  CHECK_LE(frame_matches_ptr->size(), projected_image_ptr_list.size())
-      << "There cannot be more query frames than projected images.";
 }
 
-bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
-    int nn_match_descriptor_index,
+void MatchingBasedLoopDetector::addMatchesForNeighbors(
     const loop_closure::ProjectedImage& projected_image_query,
-    int keypoint_index_query, loop_closure::Match* structure_match_ptr) const {
-  CHECK_GE(nn_match_descriptor_index, 0);
-  CHECK_NOTNULL(structure_match_ptr);
-  loop_closure::Match& structure_match = *structure_match_ptr;
-
-  const DescriptorIndexToKeypointIdMap::const_iterator iter_keypoint_id_result =
-      descriptor_index_to_keypoint_id_.find(nn_match_descriptor_index);
-  CHECK(iter_keypoint_id_result != descriptor_index_to_keypoint_id_.cend());
-  const loop_closure::KeypointId& keypoint_id_result =
-      iter_keypoint_id_result->second;
-  CHECK(keypoint_id_result.isValid());
-
-  const Database::const_iterator iter_image_result =
-      database_.find(keypoint_id_result.frame_id);
-  CHECK(iter_image_result != database_.cend());
-  const loop_closure::ProjectedImage& projected_image_result =
-      *iter_image_result->second;
-
-  // Skip matches to images which are too close in time.
-  if (std::abs(
-          projected_image_query.timestamp_nanoseconds -
-          projected_image_result.timestamp_nanoseconds) <
-          settings_.min_image_time_seconds * kSecondsToNanoSeconds &&
-      projected_image_query.dataset_id == projected_image_result.dataset_id) {
-    return false;
+    int query_image_index, const Eigen::MatrixXi& indices,
+    const Eigen::MatrixXf& distances, int first_column,
+    std::vector<CovisibilityMatch>* matches) const {
+  CHECK_NOTNULL(matches);
+  const int num_keypoints = projected_image_query.projected_descriptors.cols();
+  CHECK_GE(first_column, 0);
+  CHECK_LE(first_column + num_keypoints, indices.cols());
+  CHECK_EQ(indices.rows(), distances.rows());
+  CHECK_EQ(indices.cols(), distances.cols());
+  const double min_image_time_nanoseconds =
+      settings_.min_image_time_seconds * kSecondsToNanoSeconds;
+  for (int keypoint_idx = 0; keypoint_idx < num_keypoints; ++keypoint_idx) {
+    const int column = first_column + keypoint_idx;
+    for (int nn_search_idx = 0; nn_search_idx < indices.rows();
+         ++nn_search_idx) {
+      const int nn_match_descriptor_idx = indices(nn_search_idx, column);
+      const float nn_match_distance = distances(nn_search_idx, column);
+      if (nn_match_descriptor_idx == -1 ||
+          nn_match_distance == std::numeric_limits<float>::infinity()) {
+        break;  // No more results for this feature.
+      }
+      const CovisibilityGraph::DenseIndex keyframe_index =
+          covisibility_graph_.getKeyframeIndexOfDescriptor(
+              nn_match_descriptor_idx);
+      CHECK_NE(keyframe_index, CovisibilityGraph::kInvalidIndex);
+
+      // Skip matches to images which are too close in time.
+      if (std::abs(
+              projected_image_query.timestamp_nanoseconds -
+              covisibility_graph_.getTimestampNanoseconds(keyframe_index)) <
+              min_image_time_nanoseconds &&
+          projected_image_query.dataset_id ==
+              covisibility_graph_.getDatasetId(keyframe_index)) {
+        continue;
+      }
+
+      CovisibilityMatch match;
+      match.query_image_index = query_image_index;
+      match.keypoint_index_query = keypoint_idx;
+      match.keyframe_index = keyframe_index;
+      match.landmark_index = covisibility_graph_.getLandmarkIndexOfDescriptor(
+          nn_match_descriptor_idx);
+      matches->push_back(match);
+    }
   }
+}
 
-  structure_match.keypoint_id_query.frame_id =
-      projected_image_query.keyframe_id;
-  structure_match.keypoint_id_query.keypoint_index =
-      static_cast<size_t>(keypoint_index_query);
-  structure_match.keyframe_id_result = keypoint_id_result.frame_id;
+void MatchingBasedLoopDetector::doCovisibilityFiltering(
+    const bool connect_by_vertex, const bool make_matches_unique,
+    CovisibilityFilterScratch* scratch,
+    std::vector<CovisibilityMatch>* matches) const {
+  CHECK_NOTNULL(scratch);
+  CHECK_NOTNULL(matches);
+  CovisibilityFilterSettings filter_settings;
+  filter_settings.connect_by_vertex = connect_by_vertex;
+  // We do not score vertices because this is done already at keyframe level.
+  filter_settings.compute_scores =
+      connect_by_vertex ? nullptr : &compute_keyframe_scores_;
+  filter_settings.fraction_best_scores = settings_.fraction_best_scores;
+  filter_settings.num_descriptors_in_database =
+      static_cast<size_t>(NumDescriptors());
+  filter_settings.min_num_matches = settings_.min_verify_matches_num;
+  filter_settings.make_matches_unique = make_matches_unique;
+  filterMatchesByCovisibility(
+      covisibility_graph_, filter_settings, scratch, matches);
+}
 
-  if (!projected_image_result.landmarks.empty()) {
+void MatchingBasedLoopDetector::filterMatchesOfVertex(
+    const bool use_vertex_covis_filter,
+    const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+    CovisibilityFilterScratch* scratch,
+    loop_closure::FrameToMatches* frame_matches_ptr) const {
+  CHECK_NOTNULL(scratch);
+  CHECK_NOTNULL(frame_matches_ptr);
+  std::vector<CovisibilityMatch>& matches = scratch->matches;
+  if (use_vertex_covis_filter) {
+    constexpr bool kConnectByVertex = true;
+    doCovisibilityFiltering(
+        kConnectByVertex, use_vertex_covis_filter, scratch, &matches);
+  }
+  for (const CovisibilityMatch& covisibility_match : matches) {
     CHECK_LT(
-        keypoint_id_result.keypoint_index,
-        projected_image_result.landmarks.size());
+        static_cast<size_t>(covisibility_match.query_image_index),
+        projected_image_ptr_list.size());
+    loop_closure::Match structure_match;
+    structure_match.keypoint_id_query.frame_id =
+        projected_image_ptr_list[covisibility_match.query_image_index]
+            ->keyframe_id;
+    structure_match.keypoint_id_query.keypoint_index =
+        static_cast<size_t>(covisibility_match.keypoint_index_query);
+    structure_match.keyframe_id_result =
+        covisibility_graph_.getKeyframeId(covisibility_match.keyframe_index);
     structure_match.landmark_result =
-        projected_image_result.landmarks[keypoint_id_result.keypoint_index];
+        covisibility_graph_.getLandmarkId(covisibility_match.landmark_index);
     CHECK(structure_match.isValid());
+    (*frame_matches_ptr)[structure_match.keypoint_id_query.frame_id].push_back(
+        structure_match);
   }
-  return true;
 }
 
 void MatchingBasedLoopDetector::Insert(
@@ -227,6 +397,9 @@ void MatchingBasedLoopDetector::Insert(
   CHECK_EQ(
       projected_image.projected_descriptors.cols(),
       static_cast<int>(projected_image.landmarks.size()));
+  const CovisibilityGraph::DenseIndex keyframe_index =
+      covisibility_graph_.addKeyframe(
+          projected_image, projected_image.projected_descriptors.cols());
   for (int keypoint_idx = 0;
        keypoint_idx < projected_image.projected_descriptors.cols();
        ++keypoint_idx) {
@@ -238,6 +411,9 @@ void MatchingBasedLoopDetector::Insert(
                 std::forward_as_tuple(
                     projected_image.keyframe_id, keypoint_idx))
             .second);
+    covisibility_graph_.addDescriptor(
+        descriptor_index_, keyframe_index,
+        projected_image.landmarks[keypoint_idx]);
     ++descriptor_index_;
   }
   CHECK(index_interface_ != nullptr);
@@ -257,27 +433,165 @@ void MatchingBasedLoopDetector::Insert(
       << "Duplicate projected image in database.";
 }
 
+void MatchingBasedLoopDetector::RemoveVertices(
+    const pose_graph::VertexIdSet& vertex_ids) {
+  if (vertex_ids.empty()) {
+    return;
+  }
+  {
+    aslam::ScopedWriteLock lock(&read_write_mutex);
+    CHECK(index_interface_ != nullptr);
+    CHECK(index_interface_->SupportsRemoval())
+        << "The loop detector engine " << settings_.detector_engine_type_string
+        << " doesn't support removing vertices.";
+
+    std::vector<DescriptorIndex> removed_descriptor_indices;
+    for (DescriptorIndexToKeypointIdMap::iterator it =
+             descriptor_index_to_keypoint_id_.begin();
+         it != descriptor_index_to_keypoint_id_.end();) {
+      if (vertex_ids.count(it->second.frame_id.vertex_id) > 0u) {
+        removed_descriptor_indices.push_back(it->first);
+        it = descriptor_index_to_keypoint_id_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (Database::iterator it = database_.begin(); it != database_.end();) {
+      if (vertex_ids.count(it->first.vertex_id) > 0u) {
+        keyframe_id_to_num_descriptors_.erase(it->first);
+        it = database_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    index_interface_->RemoveDescriptors(removed_descriptor_indices);
+    rebuildCovisibilityGraph();
+    VLOG(3) << "Removed " << removed_descriptor_indices.size()
+            << " descriptors of " << vertex_ids.size()
+            << " vertices from the loop detector.";
+  }
+  startCompactionIfNeeded();
+}
+
+void MatchingBasedLoopDetector::rebuildCovisibilityGraph() {
+  covisibility_graph_.clear();
+  for (const Database::value_type& database_entry : database_) {
+    CHECK(database_entry.second);
+    const KeyframeIdToNumDescriptorsMap::const_iterator num_descriptors_it =
+        keyframe_id_to_num_descriptors_.find(database_entry.first);
+    CHECK(num_descriptors_it != keyframe_id_to_num_descriptors_.cend());
+    covisibility_graph_.addKeyframe(
+        *database_entry.second, num_descriptors_it->second);
+  }
+  for (const DescriptorIndexToKeypointIdMap::value_type&
+           descriptor_index_keypoint_pair : descriptor_index_to_keypoint_id_) {
+    const loop_closure::KeypointId& keypoint_id =
+        descriptor_index_keypoint_pair.second;
+    const CovisibilityGraph::DenseIndex keyframe_index =
+        covisibility_graph_.getKeyframeIndex(keypoint_id.frame_id);
+    CHECK_NE(keyframe_index, CovisibilityGraph::kInvalidIndex);
+    const Database::const_iterator image_it =
+        database_.find(keypoint_id.frame_id);
+    CHECK(image_it != database_.cend());
+    const std::vector<loop_closure::PointLandmarkId>& landmarks =
+        image_it->second->landmarks;
+    CHECK_LT(keypoint_id.keypoint_index, landmarks.size());
+    covisibility_graph_.addDescriptor(
+        descriptor_index_keypoint_pair.first, keyframe_index,
+        landmarks[keypoint_id.keypoint_index]);
+  }
+}
+
+void MatchingBasedLoopDetector::startCompactionIfNeeded() {
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  CHECK(inverted_multi_index_interface);
+  {
+    aslam::ScopedReadLock lock(&read_write_mutex);
+    const int num_removed_entries =
+        inverted_multi_index_interface->GetNumRemovedEntries();
+    const int num_stored_entries =
+        num_removed_entries +
+        inverted_multi_index_interface->GetNumDescriptorsInIndex();
+    if (num_removed_entries == 0 ||
+        num_removed_entries <
+            settings_.compaction_min_removed_ratio * num_stored_entries) {
+      return;
+    }
+  }
+
+  std::lock_guard<std::mutex> compaction_lock(compaction_mutex_);
+  if (is_compaction_running_) {
+    return;
+  }
+  if (compaction_thread_.joinable()) {
+    compaction_thread_.join();
+  }
+  is_compaction_running_ = true;
+  compaction_thread_ = std::thread([this]() {
+    compactIndex();
+    is_compaction_running_ = false;
+  });
+}
+
+void MatchingBasedLoopDetector::compactIndex() {
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  CHECK(inverted_multi_index_interface);
+
+  loop_closure::InvertedMultiIndexInterface::Index::CompactedInvertedFiles
+      compacted_inverted_files;
+  {
+    aslam::ScopedReadLock lock(&read_write_mutex);
+    inverted_multi_index_interface->CompactInvertedFiles(
+        settings_.compaction_min_removed_ratio, &compacted_inverted_files);
+  }
+  const size_t num_compacted_files =
+      compacted_inverted_files.inverted_file_indices.size();
+  if (num_compacted_files == 0u) {
+    return;
+  }
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  if (!inverted_multi_index_interface->ApplyCompactedInvertedFiles(
+          &compacted_inverted_files)) {
+    VLOG(3) << "Dropped the compacted inverted files as the index was reset.";
+    return;
+  }
+  VLOG(3) << "Compacted " << num_compacted_files
+          << " inverted files of the loop detector.";
+}
+
 void MatchingBasedLoopDetector::Clear() {
   aslam::ScopedWriteLock lock(&read_write_mutex);
   database_.clear();
+  keyframe_id_to_num_descriptors_.clear();
   descriptor_index_to_keypoint_id_.clear();
+  covisibility_graph_.clear();
+  covisibility_scratch_pool_.clear();
   index_interface_->Clear();
   descriptor_index_ = 0;
 }
 
+void MatchingBasedLoopDetector::Freeze() {
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  index_interface_->Freeze();
+}
+
 void MatchingBasedLoopDetector::setKeyframeScoringFunction() {
   typedef MatchingBasedEngineSettings::KeyframeScoringFunctionType
       ScoringFunctionType;
 
   switch (settings_.keyframe_scoring_function_type) {
     case ScoringFunctionType::kAccumulation: {
-      compute_keyframe_scores_ =
-          &scoring::computeAccumulationScore<loop_closure::KeyframeId>;
+      compute_keyframe_scores_ = &scoring::computeDenseAccumulationScore;
       break;
     }
     case ScoringFunctionType::kProbabilistic: {
-      compute_keyframe_scores_ =
-          &scoring::computeProbabilisticScore<loop_closure::KeyframeId>;
+      compute_keyframe_scores_ = &scoring::computeDenseProbabilisticScore;
       break;
     }
     default: {
@@ -299,6 +613,20 @@ void MatchingBasedLoopDetector::setDetectorEngine() {
               settings_.projection_matrix_filename));
       break;
     }
+    case DetectorEngineType::kMatchingLDCpuBruteForce: {
+      index_interface_.reset(
+          new loop_closure::BruteForceIndexInterface(
+              settings_.projection_matrix_filename));
+      break;
+    }
+    case DetectorEngineType::kMatchingLDKdForest: {
+      index_interface_.reset(
+          new loop_closure::KDForestIndexInterface(
+              settings_.projection_matrix_filename,
+              settings_.kd_forest_num_trees, settings_.kd_forest_max_checks,
+              settings_.kd_forest_max_leaf_size));
+      break;
+    }
     case DetectorEngineType::kMatchingLDInvertedIndex: {
       index_interface_.reset(
           new loop_closure::InvertedIndexInterface(
@@ -307,10 +635,13 @@ void MatchingBasedLoopDetector::setDetectorEngine() {
       break;
     }
     case DetectorEngineType::kMatchingLDInvertedMultiIndex: {
-      index_interface_.reset(
+      loop_closure::InvertedMultiIndexInterface* index_interface =
           new loop_closure::InvertedMultiIndexInterface(
               settings_.projected_quantizer_filename,
-              settings_.num_closest_words_for_nn_search));
+              settings_.num_closest_words_for_nn_search);
+      index_interface->SetMaxCandidatesForNNSearch(
+          settings_.max_candidates_for_nn_search);
+      index_interface_.reset(index_interface);
       break;
     }
     case DetectorEngineType::kMatchingLDInvertedMultiIndexProductQuantization: {
@@ -510,6 +841,19 @@ void MatchingBasedLoopDetector::deserialize(
         keyframe_id_to_num_descriptors_.emplace(frame_id, num_descriptors)
             .second);
   }
+  rebuildCovisibilityGraph();
+}
+
+bool MatchingBasedLoopDetector::saveSnapshot(
+    const std::string& file_path, const uint64_t source_fingerprint) const {
+  return MatchingBasedLoopDetectorSerializer::saveSnapshot(
+      *this, source_fingerprint, file_path);
+}
+
+bool MatchingBasedLoopDetector::loadSnapshot(
+    const std::string& file_path, const uint64_t source_fingerprint) {
+  return MatchingBasedLoopDetectorSerializer::loadSnapshot(
+      file_path, source_fingerprint, this);
 }
 
 }  // namespace matching_based_loopclosure
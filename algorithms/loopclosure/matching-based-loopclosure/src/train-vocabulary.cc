@@ -11,6 +11,8 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <loopclosure-common/types.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 #include <vocabulary-tree/tree-builder.h>
 
@@ -33,6 +35,20 @@ DEFINE_int32(
 DEFINE_int32(
     lc_product_quantization_num_words, 256,
     "Number of words in the product vocabulary.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_restarts, 1,
+    "Number of k-means restarts when training a vocabulary.");
+DEFINE_bool(
+    lc_vocabulary_kmeans_parallel_restarts, true,
+    "Run the k-means restarts concurrently. Does not change the result.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_mini_batch_size, 0,
+    "Number of descriptors per mini-batch k-means iteration. 0 runs the full "
+    "Lloyd's algorithm on all descriptors.");
+DEFINE_int32(
+    lc_vocabulary_kmeans_seeding_sample_size, 0,
+    "Number of randomly sampled descriptors the initial k-means++ centers are "
+    "chosen from. 0 uses all descriptors.");
 
 DECLARE_string(load_map);
 
@@ -58,7 +74,15 @@ void MakeVocabulary(
   // Create tree.
   static constexpr int kLevels = 1;
   ProjectedTreeBuilder builder(descriptor_zero);
-  builder.kmeans().SetRestarts(1);
+  CHECK_GT(FLAGS_lc_vocabulary_kmeans_restarts, 0);
+  CHECK_GE(FLAGS_lc_vocabulary_kmeans_mini_batch_size, 0);
+  CHECK_GE(FLAGS_lc_vocabulary_kmeans_seeding_sample_size, 0);
+  builder.kmeans().SetRestarts(FLAGS_lc_vocabulary_kmeans_restarts);
+  builder.kmeans().SetParallelRestarts(
+      FLAGS_lc_vocabulary_kmeans_parallel_restarts);
+  builder.kmeans().SetMiniBatchSize(FLAGS_lc_vocabulary_kmeans_mini_batch_size);
+  builder.kmeans().SetSeedingSampleSize(
+      FLAGS_lc_vocabulary_kmeans_seeding_sample_size);
   builder.Build(descriptors, num_words, kLevels);
   VLOG(3) << "Done. Got " << builder.tree().centers().size() << " centers";
 
@@ -135,16 +159,33 @@ void ProjectDescriptors(
   descriptor_zero.setConstant(FLAGS_lc_target_dimensionality, 1, 0);
 
   projected_descriptors->resize(descriptors.cols(), descriptor_zero);
-  for (int i = 0; i < descriptors.cols(); ++i) {
-    aslam::common::FeatureDescriptorConstRef raw_descriptor(
-        &descriptors.coeffRef(0, i), descriptors.rows());
-    descriptor_projection::ProjectDescriptor(
-        raw_descriptor, projection_matrix, FLAGS_lc_target_dimensionality,
-        (*projected_descriptors)[i]);
-    if (i % 10000 == 0) {
-      LOG(INFO) << "Projected " << i << "/" << descriptors.cols();
+
+  // Projects chunks of descriptors with one matrix product each, reusing the
+  // unpacking buffer of the thread.
+  constexpr int kChunkSize = 10000;
+  const int num_descriptors = descriptors.cols();
+  const int num_chunks = (num_descriptors + kChunkSize - 1) / kChunkSize;
+  auto projection_functor = [&](const std::vector<size_t>& range) -> void {
+    Eigen::MatrixXf unpacked_descriptors;
+    Eigen::MatrixXf projected_chunk;
+    for (const size_t chunk_idx : range) {
+      const int first_descriptor = chunk_idx * kChunkSize;
+      const int chunk_size =
+          std::min(kChunkSize, num_descriptors - first_descriptor);
+      descriptor_projection::ProjectDescriptorBlock(
+          &descriptors.coeffRef(0, first_descriptor), descriptors.rows(),
+          chunk_size, projection_matrix, FLAGS_lc_target_dimensionality,
+          &unpacked_descriptors, &projected_chunk);
+      for (int i = 0; i < chunk_size; ++i) {
+        (*projected_descriptors)[first_descriptor + i] = projected_chunk.col(i);
+      }
+      VLOG(1) << "Projected chunk " << chunk_idx + 1 << "/" << num_chunks;
     }
-  }
+  };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      num_chunks, projection_functor, kAlwaysParallelize, num_threads);
 }
 
 void MakeProductVocabularies(
@@ -152,22 +193,36 @@ void MakeProductVocabularies(
     const Eigen::MatrixXf& base_vocabulary,
     Eigen::MatrixXf* product_vocabulary) {
   CHECK_NOTNULL(product_vocabulary);
-  Aligned<std::vector, DescriptorVector> descriptors_v1;
-  descriptors_v1.resize(base_vocabulary.cols());
-
-  for (const ProjectedDescriptorType& projected_descriptor :
-       input_descriptors) {
-    int best_word = 0;
-    float best_distance = std::numeric_limits<float>::max();
-    for (int i = 0; i < base_vocabulary.cols(); ++i) {
-      float distance =
-          (base_vocabulary.col(i) - projected_descriptor).squaredNorm();
-      if (distance < best_distance) {
-        best_distance = distance;
-        best_word = i;
+  const size_t num_descriptors = input_descriptors.size();
+  std::vector<int> best_words(num_descriptors);
+  auto assign_functor = [&](const std::vector<size_t>& range) -> void {
+    for (size_t descriptor_idx : range) {
+      const ProjectedDescriptorType& projected_descriptor =
+          input_descriptors[descriptor_idx];
+      int best_word = 0;
+      float best_distance = std::numeric_limits<float>::max();
+      for (int i = 0; i < base_vocabulary.cols(); ++i) {
+        float distance =
+            (base_vocabulary.col(i) - projected_descriptor).squaredNorm();
+        if (distance < best_distance) {
+          best_distance = distance;
+          best_word = i;
+        }
       }
+      best_words[descriptor_idx] = best_word;
     }
-    descriptors_v1[best_word].push_back(projected_descriptor);
+  };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      num_descriptors, assign_functor, kAlwaysParallelize, num_threads);
+
+  Aligned<std::vector, DescriptorVector> descriptors_v1;
+  descriptors_v1.resize(base_vocabulary.cols());
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    descriptors_v1[best_words[descriptor_idx]].push_back(
+        input_descriptors[descriptor_idx]);
   }
 
   const int kHalfDescriptorLength = FLAGS_lc_target_dimensionality / 2;
@@ -186,21 +241,23 @@ void MakeProductVocabularies(
   product_vocabulary->resize(
       num_dim_per_component, num_imi_words * num_components * num_pq_words);
 
-  int num_components_stored = 0;
   const unsigned int num_descriptors_per_training = num_pq_words * 200u;
 
-  for (const DescriptorVector& word_descriptors : descriptors_v1) {
-    for (int component = 0;
-         component < FLAGS_lc_product_quantization_num_components;
-         ++component) {
-      LOG(INFO) << "Training component " << num_components_stored << "/"
+  // The codebooks of all words and components are independent of each other
+  // and write to disjoint blocks of the product vocabulary.
+  auto train_functor = [&](const std::vector<size_t>& range) -> void {
+    for (size_t codebook_idx : range) {
+      const DescriptorVector& word_descriptors =
+          descriptors_v1[codebook_idx / num_components];
+      const int component = codebook_idx % num_components;
+      LOG(INFO) << "Training component " << codebook_idx << "/"
                 << num_imi_words * num_components;
       DescriptorVector dim_for_component;
-      dim_for_component.reserve(word_descriptors.size());
-      const int start_block =
-          component * FLAGS_lc_product_quantization_num_dim_per_component;
-      const int block_size =
-          FLAGS_lc_product_quantization_num_dim_per_component;
+      dim_for_component.reserve(
+          std::min<size_t>(
+              word_descriptors.size(), num_descriptors_per_training));
+      const int start_block = component * num_dim_per_component;
+      const int block_size = num_dim_per_component;
       for (const ProjectedDescriptorType& descriptor : word_descriptors) {
         ProjectedDescriptorType sub_descriptor =
             descriptor.block(start_block, 0, block_size, 1);
@@ -212,21 +269,63 @@ void MakeProductVocabularies(
       LOG(INFO) << "Using " << dim_for_component.size() << " descriptors.";
       Eigen::MatrixXf words_product_vocabulary;
       MakeVocabulary(
-          FLAGS_lc_product_quantization_num_words, dim_for_component,
-          block_size, &words_product_vocabulary);
+          num_pq_words, dim_for_component, block_size,
+          &words_product_vocabulary);
       // Now store product vocabulary for component.
       CHECK_LE(
-          num_components_stored * num_pq_words + num_pq_words,
+          static_cast<int>(codebook_idx) * num_pq_words + num_pq_words,
           product_vocabulary->cols());
       product_vocabulary->block(
-          0, num_components_stored * num_pq_words, num_dim_per_component,
+          0, codebook_idx * num_pq_words, num_dim_per_component,
           num_pq_words) = words_product_vocabulary;
-      ++num_components_stored;
     }
-  }
+  };
+  constexpr bool kAlwaysParallelizeTraining = true;
+  common::ParallelProcess(
+      num_imi_words * num_components, train_functor,
+      kAlwaysParallelizeTraining, num_threads);
   LOG(INFO) << "Done with product vocabulary";
 }
 
+// Trains the vocabularies of both descriptor halves concurrently. If the
+// product vocabulary outputs are given, the product vocabulary of each half is
+// trained in the same pass, right after the vocabulary it depends on.
+void MakeHalfVocabularies(
+    const DescriptorVector& descriptors_first_half,
+    const DescriptorVector& descriptors_second_half,
+    int half_descriptor_length, Eigen::MatrixXf* words_first_half,
+    Eigen::MatrixXf* words_second_half,
+    Eigen::MatrixXf* product_vocabulary_first_half,
+    Eigen::MatrixXf* product_vocabulary_second_half) {
+  CHECK_NOTNULL(words_first_half);
+  CHECK_NOTNULL(words_second_half);
+  CHECK_EQ(
+      product_vocabulary_first_half == nullptr,
+      product_vocabulary_second_half == nullptr);
+  const DescriptorVector* descriptors[] = {&descriptors_first_half,
+                                           &descriptors_second_half};
+  Eigen::MatrixXf* words[] = {words_first_half, words_second_half};
+  Eigen::MatrixXf* product_vocabularies[] = {product_vocabulary_first_half,
+                                             product_vocabulary_second_half};
+
+  auto half_functor = [&](const std::vector<size_t>& range) -> void {
+    for (size_t half_idx : range) {
+      MakeVocabulary(
+          FLAGS_lc_number_of_vocabulary_words, *descriptors[half_idx],
+          half_descriptor_length, words[half_idx]);
+      if (product_vocabularies[half_idx] != nullptr) {
+        MakeProductVocabularies(
+            *descriptors[half_idx], *words[half_idx],
+            product_vocabularies[half_idx]);
+      }
+    }
+  };
+  constexpr size_t kNumHalves = 2u;
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      kNumHalves, half_functor, kAlwaysParallelize, kNumHalves);
+}
+
 void MakeVocabularies(
     const Eigen::MatrixXf& projection_matrix,
     const DescriptorVector& projected_descriptors) {
@@ -271,16 +370,11 @@ void MakeVocabularies(
       vocabulary.projection_matrix_ = projection_matrix;
       vocabulary.target_dimensionality_ = FLAGS_lc_target_dimensionality;
 
-      LOG(INFO) << "Creating first vocabulary.";
-      MakeVocabulary(
-          FLAGS_lc_number_of_vocabulary_words, projected_descriptors_first_half,
-          kHalfDescriptorLength, &vocabulary.words_first_half_);
-
-      LOG(INFO) << "Creating second vocabulary.";
-      MakeVocabulary(
-          FLAGS_lc_number_of_vocabulary_words,
-          projected_descriptors_second_half, kHalfDescriptorLength,
-          &vocabulary.words_second_half_);
+      LOG(INFO) << "Creating first and second vocabulary.";
+      MakeHalfVocabularies(
+          projected_descriptors_first_half, projected_descriptors_second_half,
+          kHalfDescriptorLength, &vocabulary.words_first_half_,
+          &vocabulary.words_second_half_, nullptr, nullptr);
 
       std::ofstream out(
           FLAGS_lc_projected_quantizer_filename.c_str(), std::ios_base::binary);
@@ -304,29 +398,18 @@ void MakeVocabularies(
       vocabulary.projection_matrix_ = projection_matrix;
       vocabulary.target_dimensionality_ = FLAGS_lc_target_dimensionality;
 
-      LOG(INFO) << "Creating first vocabulary.";
-      MakeVocabulary(
-          FLAGS_lc_number_of_vocabulary_words, projected_descriptors_first_half,
-          kHalfDescriptorLength, &vocabulary.words_first_half_);
-
-      LOG(INFO) << "Creating second vocabulary.";
-      MakeVocabulary(
-          FLAGS_lc_number_of_vocabulary_words,
-          projected_descriptors_second_half, kHalfDescriptorLength,
-          &vocabulary.words_second_half_);
-
       vocabulary.number_of_components =
           FLAGS_lc_product_quantization_num_components;
       vocabulary.number_of_centers = FLAGS_lc_product_quantization_num_words;
       vocabulary.number_of_dimensions_per_component =
           FLAGS_lc_product_quantization_num_dim_per_component;
 
-      MakeProductVocabularies(
-          projected_descriptors_first_half, vocabulary.words_first_half_,
-          &vocabulary.quantizer_centers_1);
-
-      MakeProductVocabularies(
-          projected_descriptors_second_half, vocabulary.words_second_half_,
+      LOG(INFO) << "Creating first and second vocabulary with their product "
+                << "vocabularies.";
+      MakeHalfVocabularies(
+          projected_descriptors_first_half, projected_descriptors_second_half,
+          kHalfDescriptorLength, &vocabulary.words_first_half_,
+          &vocabulary.words_second_half_, &vocabulary.quantizer_centers_1,
           &vocabulary.quantizer_centers_2);
 
       std::ofstream out(
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <loopclosure-common/flags.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/brute-force-index.h"
+
+namespace loop_closure {
+namespace brute_force_index {
+
+class BruteForceIndexTest : public ::testing::Test {
+ protected:
+  enum { kDimensionality = 10 };
+  typedef BruteForceIndex<kDimensionality> Index;
+
+  void SetUp() override {
+    FLAGS_lc_knn_max_radius = std::numeric_limits<float>::infinity();
+    std::srand(42);
+  }
+
+  // Sorts all database descriptors by their distance to the query.
+  static void findNearestNeighborsExhaustively(
+      const Eigen::MatrixXf& database, const Eigen::VectorXf& query,
+      std::vector<std::pair<float, int> >* nearest_neighbors) {
+    nearest_neighbors->clear();
+    for (int i = 0; i < database.cols(); ++i) {
+      nearest_neighbors->emplace_back(
+          (database.col(i) - query).squaredNorm(), i);
+    }
+    std::sort(nearest_neighbors->begin(), nearest_neighbors->end());
+  }
+};
+
+TEST_F(BruteForceIndexTest, FindsExactNearestNeighbors) {
+  // More descriptors and queries than fit in one block to cover the block
+  // boundaries.
+  constexpr int kNumDescriptors = 2500;
+  constexpr int kNumQueries = 300;
+  constexpr int kNumNeighbors = 5;
+  const Eigen::MatrixXf database =
+      Eigen::MatrixXf::Random(kDimensionality, kNumDescriptors);
+  const Eigen::MatrixXf queries =
+      Eigen::MatrixXf::Random(kDimensionality, kNumQueries);
+
+  // Add the descriptors in two batches to test the incremental insertion.
+  Index index;
+  index.AddDescriptors(database.leftCols(1000));
+  index.AddDescriptors(database.rightCols(kNumDescriptors - 1000));
+  EXPECT_EQ(index.GetNumDescriptorsInIndex(), kNumDescriptors);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  index.GetNNearestNeighbors(queries, kNumNeighbors, &indices, &distances);
+
+  std::vector<std::pair<float, int> > nearest_neighbors;
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    findNearestNeighborsExhaustively(
+        database, queries.col(query_idx), &nearest_neighbors);
+    for (int k = 0; k < kNumNeighbors; ++k) {
+      EXPECT_EQ(indices(k, query_idx), nearest_neighbors[k].second);
+      EXPECT_NEAR(distances(k, query_idx), nearest_neighbors[k].first, 1e-4);
+    }
+  }
+}
+
+TEST_F(BruteForceIndexTest, ReturnsInvalidNeighborsIfNotEnoughFound) {
+  constexpr int kNumNeighbors = 3;
+  const Eigen::MatrixXf queries = Eigen::MatrixXf::Random(kDimensionality, 2);
+  Eigen::MatrixXi indices(kNumNeighbors, queries.cols());
+  Eigen::MatrixXf distances(kNumNeighbors, queries.cols());
+
+  Index index;
+  index.GetNNearestNeighbors(queries, kNumNeighbors, &indices, &distances);
+  EXPECT_TRUE((indices.array() == -1).all());
+  EXPECT_TRUE(
+      (distances.array() == std::numeric_limits<float>::infinity()).all());
+
+  // Only the query itself is within the search radius.
+  index.AddDescriptors(queries.col(0));
+  index.AddDescriptors(queries.col(0) + Eigen::VectorXf::Constant(10, 1.f));
+  FLAGS_lc_knn_max_radius = 1.f;
+  indices.resize(kNumNeighbors, 1);
+  distances.resize(kNumNeighbors, 1);
+  index.GetNNearestNeighbors(
+      queries.leftCols(1), kNumNeighbors, &indices, &distances);
+  EXPECT_EQ(indices(0, 0), 0);
+  EXPECT_NEAR(distances(0, 0), 0.f, 1e-6);
+  EXPECT_EQ(indices(1, 0), -1);
+  EXPECT_EQ(distances(1, 0), std::numeric_limits<float>::infinity());
+}
+
+}  // namespace brute_force_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
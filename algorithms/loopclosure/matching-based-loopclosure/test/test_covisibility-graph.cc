@@ -0,0 +1,232 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+
+#include "matching-based-loopclosure/covisibility-graph.h"
+#include "matching-based-loopclosure/scoring.h"
+
+namespace matching_based_loopclosure {
+
+class CovisibilityGraphTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Database layout:
+    //   keyframe 0 and 1: same vertex, observe landmarks 0 to 3.
+    //   keyframe 2: separate vertex, observes landmarks 4 and 5.
+    //   keyframe 3: separate vertex, observes landmark 3 (shared with 1).
+    common::generateId(&dataset_id_);
+    loop_closure::VertexId vertex_id;
+    common::generateId(&vertex_id);
+    landmark_ids_.resize(kNumLandmarks);
+    for (loop_closure::PointLandmarkId& landmark_id : landmark_ids_) {
+      common::generateId(&landmark_id);
+    }
+    addKeyframe(vertex_id, 0u, {0, 1, 2, 3});
+    addKeyframe(vertex_id, 1u, {0, 1, 2, 3});
+    common::generateId(&vertex_id);
+    addKeyframe(vertex_id, 0u, {4, 5});
+    common::generateId(&vertex_id);
+    addKeyframe(vertex_id, 0u, {3});
+
+    settings_.connect_by_vertex = false;
+    settings_.compute_scores = nullptr;
+    settings_.fraction_best_scores = 1.f;
+    settings_.num_descriptors_in_database = num_descriptors_;
+    settings_.min_num_matches = 0u;
+    settings_.make_matches_unique = false;
+  }
+
+  void addKeyframe(
+      const loop_closure::VertexId& vertex_id, unsigned int frame_index,
+      const std::vector<int>& landmark_indices) {
+    loop_closure::ProjectedImage projected_image;
+    projected_image.keyframe_id.vertex_id = vertex_id;
+    projected_image.keyframe_id.frame_index = frame_index;
+    projected_image.dataset_id = dataset_id_;
+    projected_image.timestamp_nanoseconds = 0;
+    const CovisibilityGraph::DenseIndex keyframe_index = graph_.addKeyframe(
+        projected_image, landmark_indices.size());
+    keyframe_ids_.push_back(projected_image.keyframe_id);
+    for (const int landmark_index : landmark_indices) {
+      graph_.addDescriptor(
+          num_descriptors_++, keyframe_index, landmark_ids_[landmark_index]);
+    }
+  }
+
+  // Matches the query keypoint to the given database descriptor.
+  void addMatch(int keypoint_index, int descriptor_index) {
+    CovisibilityMatch match;
+    match.query_image_index = 0;
+    match.keypoint_index_query = keypoint_index;
+    match.keyframe_index =
+        graph_.getKeyframeIndexOfDescriptor(descriptor_index);
+    match.landmark_index =
+        graph_.getLandmarkIndexOfDescriptor(descriptor_index);
+    matches_.push_back(match);
+  }
+
+  void filter() {
+    filterMatchesByCovisibility(graph_, settings_, &scratch_, &matches_);
+  }
+
+  static constexpr int kNumLandmarks = 6;
+
+  loop_closure::DatasetId dataset_id_;
+  std::vector<loop_closure::PointLandmarkId> landmark_ids_;
+  std::vector<loop_closure::KeyframeId> keyframe_ids_;
+  int num_descriptors_ = 0;
+
+  CovisibilityGraph graph_;
+  CovisibilityFilterSettings settings_;
+  CovisibilityFilterScratch scratch_;
+  std::vector<CovisibilityMatch> matches_;
+};
+
+TEST_F(CovisibilityGraphTest, AssignsDenseIndices) {
+  EXPECT_EQ(graph_.numKeyframes(), 4u);
+  EXPECT_EQ(graph_.numVertices(), 3u);
+  EXPECT_EQ(graph_.numLandmarks(), static_cast<size_t>(kNumLandmarks));
+  for (size_t i = 0u; i < keyframe_ids_.size(); ++i) {
+    const CovisibilityGraph::DenseIndex keyframe_index =
+        graph_.getKeyframeIndex(keyframe_ids_[i]);
+    ASSERT_NE(keyframe_index, CovisibilityGraph::kInvalidIndex);
+    EXPECT_EQ(graph_.getKeyframeId(keyframe_index), keyframe_ids_[i]);
+  }
+  EXPECT_EQ(graph_.getVertexIndex(0), graph_.getVertexIndex(1));
+  EXPECT_NE(graph_.getVertexIndex(1), graph_.getVertexIndex(2));
+  EXPECT_EQ(graph_.getNumDescriptors(0), 4u);
+  EXPECT_EQ(graph_.getNumDescriptors(3), 1u);
+  // Descriptors 3 and 7 observe the same landmark from different keyframes.
+  EXPECT_EQ(
+      graph_.getLandmarkIndexOfDescriptor(3),
+      graph_.getLandmarkIndexOfDescriptor(7));
+  EXPECT_EQ(
+      graph_.getLandmarkId(graph_.getLandmarkIndexOfDescriptor(10)),
+      landmark_ids_[3]);
+
+  loop_closure::KeyframeId unknown_keyframe_id;
+  common::generateId(&unknown_keyframe_id.vertex_id);
+  unknown_keyframe_id.frame_index = 0u;
+  EXPECT_EQ(
+      graph_.getKeyframeIndex(unknown_keyframe_id),
+      CovisibilityGraph::kInvalidIndex);
+
+  graph_.clear();
+  EXPECT_EQ(graph_.numKeyframes(), 0u);
+  EXPECT_EQ(graph_.numLandmarks(), 0u);
+}
+
+TEST_F(CovisibilityGraphTest, KeepsLargestConnectedComponent) {
+  // Keyframe 0, 1 and 3 are connected through landmarks 0 and 3.
+  addMatch(0, 0);
+  addMatch(0, 4);
+  addMatch(1, 7);
+  addMatch(2, 10);
+  // Keyframe 2 is only connected to itself.
+  addMatch(3, 8);
+  addMatch(4, 9);
+  filter();
+  ASSERT_EQ(matches_.size(), 4u);
+  for (const CovisibilityMatch& match : matches_) {
+    EXPECT_NE(match.keyframe_index, 2);
+  }
+}
+
+TEST_F(CovisibilityGraphTest, RejectsSmallComponents) {
+  addMatch(0, 8);
+  addMatch(1, 9);
+  settings_.min_num_matches = 2u;
+  filter();
+  EXPECT_TRUE(matches_.empty());
+}
+
+TEST_F(CovisibilityGraphTest, ConnectsKeyframesOfTheSameVertex) {
+  // Without vertex connectivity, keyframes 0 and 1 do not share a landmark
+  // in these matches.
+  addMatch(0, 0);
+  addMatch(1, 1);
+  addMatch(2, 6);
+  std::vector<CovisibilityMatch> matches = matches_;
+  filter();
+  EXPECT_EQ(matches_.size(), 2u);
+
+  matches_ = matches;
+  settings_.connect_by_vertex = true;
+  filter();
+  EXPECT_EQ(matches_.size(), 3u);
+}
+
+TEST_F(CovisibilityGraphTest, MakesMatchesUnique) {
+  // The same keypoint matches landmark 0 through two keyframes and a
+  // duplicate match.
+  addMatch(0, 0);
+  addMatch(0, 0);
+  addMatch(0, 4);
+  addMatch(1, 1);
+  filter();
+  EXPECT_EQ(matches_.size(), 3u);
+
+  matches_.clear();
+  addMatch(0, 0);
+  addMatch(0, 4);
+  addMatch(1, 1);
+  settings_.make_matches_unique = true;
+  filter();
+  EXPECT_EQ(matches_.size(), 2u);
+}
+
+TEST_F(CovisibilityGraphTest, OnlyConsidersBestScoringKeyframes) {
+  // Add more keyframes than are evaluated at minimum, each with a single
+  // match, and one keyframe with many matches. All of them are connected
+  // through landmarks 0 to 3.
+  loop_closure::VertexId vertex_id;
+  for (int i = 0; i < 6; ++i) {
+    common::generateId(&vertex_id);
+    addKeyframe(vertex_id, 0u, {i % 4});
+  }
+  settings_.num_descriptors_in_database = num_descriptors_;
+  for (int descriptor_index = 11; descriptor_index < 17; ++descriptor_index) {
+    addMatch(descriptor_index, descriptor_index);
+  }
+  addMatch(20, 0);
+  addMatch(21, 1);
+  addMatch(22, 2);
+  addMatch(23, 3);
+
+  const scoring::computeDenseScoresFunction compute_scores =
+      &scoring::computeDenseAccumulationScore;
+  settings_.compute_scores = &compute_scores;
+  settings_.fraction_best_scores = 0.f;
+  filter();
+  // Only the best four keyframes are evaluated: keyframe 0 and three of the
+  // keyframes with a single match.
+  ASSERT_EQ(matches_.size(), 7u);
+  size_t num_matches_of_keyframe_0 = 0u;
+  for (const CovisibilityMatch& match : matches_) {
+    num_matches_of_keyframe_0 += match.keyframe_index == 0 ? 1u : 0u;
+  }
+  EXPECT_EQ(num_matches_of_keyframe_0, 4u);
+}
+
+TEST_F(CovisibilityGraphTest, ReusesScratchFromPool) {
+  CovisibilityFilterScratchPool pool;
+  CovisibilityFilterScratch* first_scratch;
+  {
+    CovisibilityFilterScratchPool::Lease lease = pool.acquire();
+    first_scratch = lease.get();
+    CovisibilityFilterScratchPool::Lease other_lease = pool.acquire();
+    EXPECT_NE(other_lease.get(), first_scratch);
+  }
+  CovisibilityFilterScratchPool::Lease lease = pool.acquire();
+  CovisibilityFilterScratchPool::Lease other_lease = pool.acquire();
+  EXPECT_TRUE(
+      lease.get() == first_scratch || other_lease.get() == first_scratch);
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
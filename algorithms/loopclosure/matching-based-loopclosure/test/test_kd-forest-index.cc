@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <loopclosure-common/flags.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/kd-forest-index.h"
+
+namespace loop_closure {
+namespace kd_forest_index {
+
+class KDForestIndexTest : public ::testing::Test {
+ protected:
+  enum { kDimensionality = 10 };
+  typedef KDForestIndex<kDimensionality> Index;
+  static constexpr int kNumTrees = 4;
+  static constexpr int kMaxLeafSize = 16;
+
+  void SetUp() override {
+    FLAGS_lc_knn_max_radius = std::numeric_limits<float>::infinity();
+    std::srand(42);
+  }
+
+  // Fraction of the exact num_neighbors nearest neighbors that are found.
+  static double computeRecall(
+      const Eigen::MatrixXf& database, const Eigen::MatrixXf& queries,
+      int num_neighbors, int max_checks) {
+    Index index(kNumTrees, max_checks, kMaxLeafSize);
+    // Insert in batches to test the incremental insertion.
+    constexpr int kBatchSize = 300;
+    for (int start = 0; start < database.cols(); start += kBatchSize) {
+      index.AddDescriptors(database.middleCols(
+          start, std::min<int>(kBatchSize, database.cols() - start)));
+    }
+    EXPECT_EQ(index.GetNumDescriptorsInIndex(), database.cols());
+
+    Eigen::MatrixXi indices(num_neighbors, queries.cols());
+    Eigen::MatrixXf distances(num_neighbors, queries.cols());
+    index.GetNNearestNeighbors(queries, num_neighbors, &indices, &distances);
+
+    int num_found = 0;
+    std::vector<std::pair<float, int> > nearest_neighbors;
+    for (int query_idx = 0; query_idx < queries.cols(); ++query_idx) {
+      nearest_neighbors.clear();
+      for (int i = 0; i < database.cols(); ++i) {
+        nearest_neighbors.emplace_back(
+            (database.col(i) - queries.col(query_idx)).squaredNorm(), i);
+      }
+      std::sort(nearest_neighbors.begin(), nearest_neighbors.end());
+      for (int k = 0; k < num_neighbors; ++k) {
+        // The results are sorted and unique.
+        EXPECT_GE(indices(k, query_idx), 0);
+        if (k > 0) {
+          EXPECT_LE(distances(k - 1, query_idx), distances(k, query_idx));
+          EXPECT_NE(indices(k - 1, query_idx), indices(k, query_idx));
+        }
+        EXPECT_NEAR(
+            distances(k, query_idx),
+            (database.col(indices(k, query_idx)) - queries.col(query_idx))
+                .squaredNorm(),
+            1e-4);
+        for (int j = 0; j < num_neighbors; ++j) {
+          if (indices(k, query_idx) == nearest_neighbors[j].second) {
+            ++num_found;
+            break;
+          }
+        }
+      }
+    }
+    return static_cast<double>(num_found) / (num_neighbors * queries.cols());
+  }
+};
+
+TEST_F(KDForestIndexTest, RecallIncreasesWithSearchBudget) {
+  constexpr int kNumDescriptors = 5000;
+  constexpr int kNumQueries = 200;
+  constexpr int kNumNeighbors = 5;
+  const Eigen::MatrixXf database =
+      Eigen::MatrixXf::Random(kDimensionality, kNumDescriptors);
+  const Eigen::MatrixXf queries =
+      Eigen::MatrixXf::Random(kDimensionality, kNumQueries);
+
+  const double small_budget_recall =
+      computeRecall(database, queries, kNumNeighbors, 64);
+  const double large_budget_recall =
+      computeRecall(database, queries, kNumNeighbors, 4000);
+  EXPECT_LT(small_budget_recall, large_budget_recall);
+  EXPECT_GT(large_budget_recall, 0.95);
+}
+
+TEST_F(KDForestIndexTest, HandlesDuplicateDescriptors) {
+  constexpr int kNumNeighbors = 3;
+  Index index(kNumTrees, 1000, kMaxLeafSize);
+  // More equal descriptors than fit into a leaf.
+  const Eigen::MatrixXf duplicates =
+      Eigen::MatrixXf::Ones(kDimensionality, 5 * kMaxLeafSize);
+  index.AddDescriptors(duplicates);
+
+  Eigen::MatrixXi indices(kNumNeighbors, 1);
+  Eigen::MatrixXf distances(kNumNeighbors, 1);
+  index.GetNNearestNeighbors(
+      duplicates.leftCols(1), kNumNeighbors, &indices, &distances);
+  EXPECT_TRUE((distances.array() == 0.f).all());
+  EXPECT_TRUE((indices.array() >= 0).all());
+  EXPECT_NE(indices(0, 0), indices(1, 0));
+  EXPECT_NE(indices(1, 0), indices(2, 0));
+  EXPECT_NE(indices(0, 0), indices(2, 0));
+}
+
+TEST_F(KDForestIndexTest, ReturnsInvalidNeighborsIfNotEnoughFound) {
+  constexpr int kNumNeighbors = 3;
+  const Eigen::MatrixXf queries = Eigen::MatrixXf::Random(kDimensionality, 2);
+  Eigen::MatrixXi indices(kNumNeighbors, queries.cols());
+  Eigen::MatrixXf distances(kNumNeighbors, queries.cols());
+
+  Index index(kNumTrees, 256, kMaxLeafSize);
+  index.GetNNearestNeighbors(queries, kNumNeighbors, &indices, &distances);
+  EXPECT_TRUE((indices.array() == -1).all());
+  EXPECT_TRUE(
+      (distances.array() == std::numeric_limits<float>::infinity()).all());
+
+  // Only the query itself is within the search radius.
+  index.AddDescriptors(queries.col(0));
+  index.AddDescriptors(queries.col(0) + Eigen::VectorXf::Constant(10, 1.f));
+  FLAGS_lc_knn_max_radius = 1.f;
+  indices.resize(kNumNeighbors, 1);
+  distances.resize(kNumNeighbors, 1);
+  index.GetNNearestNeighbors(
+      queries.leftCols(1), kNumNeighbors, &indices, &distances);
+  EXPECT_EQ(indices(0, 0), 0);
+  EXPECT_NEAR(distances(0, 0), 0.f, 1e-6);
+  EXPECT_EQ(indices(1, 0), -1);
+  EXPECT_EQ(distances(1, 0), std::numeric_limits<float>::infinity());
+
+  index.Clear();
+  EXPECT_EQ(index.GetNumDescriptorsInIndex(), 0);
+}
+
+}  // namespace kd_forest_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/loop-detector-interface.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+
+class LoopDetectorSnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    snapshot_file_ = "./loop_detector_snapshot_test.bin";
+    loop_detector_.reset(new MatchingBasedLoopDetector(settings_));
+    constexpr int kNumKeyframes = 50;
+    constexpr int kNumKeypointsPerKeyframe = 40;
+    for (int keyframe_idx = 0; keyframe_idx < kNumKeyframes; ++keyframe_idx) {
+      loop_detector_->Insert(createProjectedImage(
+          kNumKeypointsPerKeyframe, keyframe_idx * kNanosecondsPerImage));
+    }
+  }
+
+  void TearDown() override {
+    std::remove(snapshot_file_.c_str());
+  }
+
+  loop_closure::ProjectedImage::Ptr createProjectedImage(
+      int num_keypoints, int64_t timestamp_nanoseconds) const {
+    loop_closure::ProjectedImage::Ptr projected_image =
+        std::make_shared<loop_closure::ProjectedImage>();
+    projected_image->timestamp_nanoseconds = timestamp_nanoseconds;
+    common::generateId(&projected_image->keyframe_id.vertex_id);
+    projected_image->keyframe_id.frame_index = 0u;
+    common::generateId(&projected_image->dataset_id);
+    projected_image->projected_descriptors =
+        Eigen::MatrixXf::Random(kDescriptorDimensionality, num_keypoints);
+    projected_image->measurements = Eigen::Matrix2Xd::Random(2, num_keypoints);
+    projected_image->landmarks.resize(num_keypoints);
+    for (loop_closure::PointLandmarkId& landmark_id :
+         projected_image->landmarks) {
+      common::generateId(&landmark_id);
+    }
+    return projected_image;
+  }
+
+  static constexpr int kDescriptorDimensionality = 10;
+  static constexpr int64_t kNanosecondsPerImage = 100000000;
+
+  const MatchingBasedEngineSettings settings_;
+  std::unique_ptr<MatchingBasedLoopDetector> loop_detector_;
+  std::string snapshot_file_;
+};
+
+TEST_F(LoopDetectorSnapshotTest, LoadedDatabaseFindsSameMatches) {
+  constexpr uint64_t kSourceFingerprint = 42u;
+  ASSERT_TRUE(loop_detector_->saveSnapshot(snapshot_file_, kSourceFingerprint));
+
+  // The database sizes are only public on the interface.
+  MatchingBasedLoopDetector loaded_loop_detector(settings_);
+  const loop_detector::LoopDetector& loaded = loaded_loop_detector;
+  const loop_detector::LoopDetector& original = *loop_detector_;
+  EXPECT_FALSE(loaded_loop_detector.loadSnapshot(
+      snapshot_file_, kSourceFingerprint + 1u));
+  EXPECT_EQ(loaded.NumEntries(), 0u);
+  ASSERT_TRUE(
+      loaded_loop_detector.loadSnapshot(snapshot_file_, kSourceFingerprint));
+  EXPECT_EQ(loaded.NumEntries(), original.NumEntries());
+  EXPECT_EQ(loaded.NumDescriptors(), original.NumDescriptors());
+
+  constexpr int kNumQueries = 10;
+  constexpr int kNumQueryKeypoints = 100;
+  constexpr bool kParallelize = false;
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    const loop_closure::ProjectedImagePtrList query = {
+        createProjectedImage(kNumQueryKeypoints, 0)};
+    loop_closure::FrameToMatches frame_matches;
+    loop_detector_->Find(query, kParallelize, &frame_matches);
+    loop_closure::FrameToMatches loaded_frame_matches;
+    loaded_loop_detector.Find(query, kParallelize, &loaded_frame_matches);
+
+    ASSERT_EQ(loaded_frame_matches.size(), frame_matches.size());
+    for (const loop_closure::FrameIdMatchesPair& keyframe_matches :
+         frame_matches) {
+      const loop_closure::FrameToMatches::const_iterator loaded_matches_it =
+          loaded_frame_matches.find(keyframe_matches.first);
+      ASSERT_TRUE(loaded_matches_it != loaded_frame_matches.end());
+      ASSERT_EQ(
+          loaded_matches_it->second.size(), keyframe_matches.second.size());
+      for (const loop_closure::Match& match : keyframe_matches.second) {
+        EXPECT_TRUE(
+            std::find(
+                loaded_matches_it->second.begin(),
+                loaded_matches_it->second.end(),
+                match) != loaded_matches_it->second.end());
+      }
+    }
+  }
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <numeric>
 #include <unordered_map>
 #include <utility>
@@ -139,6 +140,25 @@ TEST_F(ScoringTest, ProbabilisticScoring) {
   }
 }
 
+TEST(ScoringLogTableTest, LogBinomialProbability) {
+  // 10 choose 3 * 0.2^3 * 0.8^7.
+  EXPECT_NEAR(
+      std::log(120.0 * std::pow(0.2, 3) * std::pow(0.8, 7)),
+      logBinomialProbability(10u, 3u, 0.2), 1e-12);
+  EXPECT_EQ(0.0, logBinomialProbability(5u, 5u, 1.0));
+  EXPECT_EQ(0.0, logBinomialProbability(5u, 0u, 0.0));
+
+  // Beyond the table, the log factorials come from std::lgamma.
+  constexpr size_t kLargeNumber = 100000u;
+  EXPECT_NEAR(
+      logFactorial(kLargeNumber - 1u) + std::log(kLargeNumber),
+      logFactorial(kLargeNumber), 1e-6);
+  for (size_t n = 1u; n < 100u; ++n) {
+    EXPECT_NEAR(
+        logFactorial(n - 1u) + std::log(n), logFactorial(n), 1e-9);
+  }
+}
+
 }  // namespace scoring
 }  // namespace matching_based_loopclosure
 
@@ -0,0 +1,279 @@
+#ifndef PRODUCT_QUANTIZATION_FAST_SCAN_H_
+#define PRODUCT_QUANTIZATION_FAST_SCAN_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace product_quantization {
+
+// Fast-scan distance computation for product quantizers with at most 16
+// cluster centers per component: The look-up table of a query is quantized to
+// 8 bit and the codes are packed into 4 bit, such that one byte shuffle
+// (pshufb on x86, tbl on aarch64) looks up one component for 16 or 32 codes.
+// The resulting distances are approximations of the float look-up table
+// distances with a known maximal error, see FastScanLookUpTable::max_error.
+static constexpr int kFastScanMaxNumCenters = 16;
+// The number of codes stored in one block of FastScanCodes.
+static constexpr int kFastScanBlockSize = 32;
+
+// The quantized version of a kNumComponents x kNumCenters float look-up table.
+template <int kNumComponents>
+struct FastScanLookUpTable {
+  // Two components share a byte of the packed codes, an odd number of
+  // components is padded with an all zero row.
+  static constexpr int kNumComponentPairs = (kNumComponents + 1) / 2;
+  static_assert(
+      kNumComponents * std::numeric_limits<uint8_t>::max() <=
+          std::numeric_limits<uint16_t>::max(),
+      "The sum of the quantized distances has to fit into 16 bit.");
+
+  inline float ToDistance(uint16_t quantized_distance) const {
+    return offset + static_cast<float>(quantized_distance) / scale;
+  }
+
+  uint8_t entries[2 * kNumComponentPairs][kFastScanMaxNumCenters];
+  // Entry (i, j) approximates (lut(i, j) - min_j lut(i, j)) * scale.
+  float scale;
+  // The sum of the row minima of the float look-up table.
+  float offset;
+  // Upper bound on the difference between ToDistance() and the distance
+  // computed with the float look-up table.
+  float max_error;
+};
+
+// Quantizes the float look-up table, as filled by ProductQuantization::FillLUT,
+// to 8 bit with a scale common to all components.
+template <int kNumComponents, int kNumCenters>
+void QuantizeLookUpTable(
+    const Eigen::Matrix<float, kNumComponents, kNumCenters>& lut,
+    FastScanLookUpTable<kNumComponents>* quantized_lut) {
+  CHECK_NOTNULL(quantized_lut);
+  CHECK_LE(kNumCenters, kFastScanMaxNumCenters);
+  FastScanLookUpTable<kNumComponents>& quantized_lut_ref = *quantized_lut;
+
+  Eigen::Matrix<float, kNumComponents, 1> row_minima = lut.rowwise().minCoeff();
+  const float max_range = (lut.colwise() - row_minima).maxCoeff();
+  constexpr float kMaxQuantizedValue = std::numeric_limits<uint8_t>::max();
+  quantized_lut_ref.scale =
+      max_range > 0.0f ? kMaxQuantizedValue / max_range : 1.0f;
+  quantized_lut_ref.offset = row_minima.sum();
+
+  std::fill_n(
+      &quantized_lut_ref.entries[0][0],
+      2 * FastScanLookUpTable<kNumComponents>::kNumComponentPairs *
+          kFastScanMaxNumCenters,
+      0u);
+  for (int i = 0; i < kNumComponents; ++i) {
+    for (int j = 0; j < kNumCenters; ++j) {
+      const float value = std::round(
+          (lut(i, j) - row_minima[i]) * quantized_lut_ref.scale);
+      quantized_lut_ref.entries[i][j] =
+          static_cast<uint8_t>(std::min(value, kMaxQuantizedValue));
+    }
+  }
+
+  // Every entry is off by at most half a quantization step. One more step and
+  // a relative term cover the float rounding of both distance computations.
+  constexpr float kRelativeFloatError = 1e-5f;
+  quantized_lut_ref.max_error =
+      (0.5f * kNumComponents + 1.0f) / quantized_lut_ref.scale +
+      kRelativeFloatError *
+          (std::abs(quantized_lut_ref.offset) + kNumComponents * max_range);
+}
+
+// Product quantized vectors packed into 4 bit per component, in blocks of
+// kFastScanBlockSize vectors. Within a block, byte b of the k-th group of
+// kFastScanBlockSize bytes holds component 2k of vector b in its lower and
+// component 2k + 1 in its upper nibble.
+template <int kNumComponents>
+class FastScanCodes {
+ public:
+  static constexpr int kNumComponentPairs =
+      FastScanLookUpTable<kNumComponents>::kNumComponentPairs;
+  static constexpr int kNumBytesPerBlock =
+      kNumComponentPairs * kFastScanBlockSize;
+
+  FastScanCodes() : num_codes_(0u) {}
+
+  template <typename DerivedCode>
+  void Add(const Eigen::MatrixBase<DerivedCode>& code) {
+    CHECK_EQ(code.rows(), kNumComponents);
+    CHECK_EQ(code.cols(), 1);
+    const size_t index_in_block = num_codes_ % kFastScanBlockSize;
+    if (index_in_block == 0u) {
+      data_.resize(data_.size() + kNumBytesPerBlock, 0u);
+    }
+    uint8_t* block = &data_[data_.size() - kNumBytesPerBlock];
+    for (int i = 0; i < kNumComponents; ++i) {
+      const int center = static_cast<int>(code(i, 0));
+      DCHECK_GE(center, 0);
+      DCHECK_LT(center, kFastScanMaxNumCenters);
+      const int shift = (i % 2 == 0) ? 0 : 4;
+      block[(i / 2) * kFastScanBlockSize + index_in_block] |=
+          static_cast<uint8_t>(center << shift);
+    }
+    ++num_codes_;
+  }
+
+  inline size_t size() const {
+    return num_codes_;
+  }
+  inline size_t numBlocks() const {
+    return data_.size() / kNumBytesPerBlock;
+  }
+  inline const uint8_t* block(size_t block_index) const {
+    DCHECK_LT(block_index, numBlocks());
+    return data_.data() + block_index * kNumBytesPerBlock;
+  }
+
+  void clear() {
+    data_.clear();
+    num_codes_ = 0u;
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+  size_t num_codes_;
+};
+
+namespace internal {
+// Computes the quantized distances of the kFastScanBlockSize codes of a block.
+template <int kNumComponents>
+inline void ComputeFastScanBlockDistances(
+    const FastScanLookUpTable<kNumComponents>& lut, const uint8_t* block,
+    uint16_t* distances) {
+  constexpr int kNumComponentPairs =
+      FastScanLookUpTable<kNumComponents>::kNumComponentPairs;
+#if defined(__AVX2__)
+  const __m256i mask_4bit = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  // Hold the sums of codes 0-7 and 16-23, and of codes 8-15 and 24-31.
+  __m256i sums_low = zero;
+  __m256i sums_high = zero;
+  for (int k = 0; k < kNumComponentPairs; ++k) {
+    const __m256i codes = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(block + k * kFastScanBlockSize));
+    const __m256i lut_even = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(lut.entries[2 * k])));
+    const __m256i lut_odd = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(lut.entries[2 * k + 1])));
+    const __m256i even = _mm256_shuffle_epi8(
+        lut_even, _mm256_and_si256(codes, mask_4bit));
+    const __m256i odd = _mm256_shuffle_epi8(
+        lut_odd, _mm256_and_si256(_mm256_srli_epi16(codes, 4), mask_4bit));
+    sums_low = _mm256_add_epi16(
+        sums_low, _mm256_add_epi16(
+                      _mm256_unpacklo_epi8(even, zero),
+                      _mm256_unpacklo_epi8(odd, zero)));
+    sums_high = _mm256_add_epi16(
+        sums_high, _mm256_add_epi16(
+                       _mm256_unpackhi_epi8(even, zero),
+                       _mm256_unpackhi_epi8(odd, zero)));
+  }
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(distances),
+      _mm256_permute2x128_si256(sums_low, sums_high, 0x20));
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(distances + 16),
+      _mm256_permute2x128_si256(sums_low, sums_high, 0x31));
+#elif defined(__SSSE3__)
+  const __m128i mask_4bit = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  for (int half = 0; half < 2; ++half) {
+    __m128i sums_low = zero;
+    __m128i sums_high = zero;
+    for (int k = 0; k < kNumComponentPairs; ++k) {
+      const __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          block + k * kFastScanBlockSize + 16 * half));
+      const __m128i even = _mm_shuffle_epi8(
+          _mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(lut.entries[2 * k])),
+          _mm_and_si128(codes, mask_4bit));
+      const __m128i odd = _mm_shuffle_epi8(
+          _mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(lut.entries[2 * k + 1])),
+          _mm_and_si128(_mm_srli_epi16(codes, 4), mask_4bit));
+      sums_low = _mm_add_epi16(
+          sums_low, _mm_add_epi16(
+                        _mm_unpacklo_epi8(even, zero),
+                        _mm_unpacklo_epi8(odd, zero)));
+      sums_high = _mm_add_epi16(
+          sums_high, _mm_add_epi16(
+                         _mm_unpackhi_epi8(even, zero),
+                         _mm_unpackhi_epi8(odd, zero)));
+    }
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(distances + 16 * half), sums_low);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(distances + 16 * half + 8), sums_high);
+  }
+#elif defined(__aarch64__)
+  const uint8x16_t mask_4bit = vdupq_n_u8(0x0f);
+  for (int half = 0; half < 2; ++half) {
+    uint16x8_t sums_low = vdupq_n_u16(0u);
+    uint16x8_t sums_high = vdupq_n_u16(0u);
+    for (int k = 0; k < kNumComponentPairs; ++k) {
+      const uint8x16_t codes =
+          vld1q_u8(block + k * kFastScanBlockSize + 16 * half);
+      const uint8x16_t even =
+          vqtbl1q_u8(vld1q_u8(lut.entries[2 * k]), vandq_u8(codes, mask_4bit));
+      const uint8x16_t odd =
+          vqtbl1q_u8(vld1q_u8(lut.entries[2 * k + 1]), vshrq_n_u8(codes, 4));
+      sums_low = vaddw_u8(sums_low, vget_low_u8(even));
+      sums_low = vaddw_u8(sums_low, vget_low_u8(odd));
+      sums_high = vaddw_high_u8(sums_high, even);
+      sums_high = vaddw_high_u8(sums_high, odd);
+    }
+    vst1q_u16(distances + 16 * half, sums_low);
+    vst1q_u16(distances + 16 * half + 8, sums_high);
+  }
+#else
+  for (int b = 0; b < kFastScanBlockSize; ++b) {
+    uint16_t sum = 0u;
+    for (int k = 0; k < kNumComponentPairs; ++k) {
+      const uint8_t codes = block[k * kFastScanBlockSize + b];
+      sum += lut.entries[2 * k][codes & 0x0f];
+      sum += lut.entries[2 * k + 1][codes >> 4];
+    }
+    distances[b] = sum;
+  }
+#endif
+}
+}  // namespace internal
+
+// Computes the quantized distances between the query of the look-up table and
+// all codes. Entry i of quantized_distances belongs to the i-th added code and
+// converts to an approximate squared distance with lut.ToDistance().
+template <int kNumComponents>
+void ComputeFastScanDistances(
+    const FastScanLookUpTable<kNumComponents>& lut,
+    const FastScanCodes<kNumComponents>& codes,
+    std::vector<uint16_t>* quantized_distances) {
+  CHECK_NOTNULL(quantized_distances);
+  const size_t num_blocks = codes.numBlocks();
+  quantized_distances->resize(num_blocks * kFastScanBlockSize);
+  for (size_t block_index = 0u; block_index < num_blocks; ++block_index) {
+    internal::ComputeFastScanBlockDistances(
+        lut, codes.block(block_index),
+        quantized_distances->data() + block_index * kFastScanBlockSize);
+  }
+  quantized_distances->resize(codes.size());
+}
+
+}  // namespace product_quantization
+
+#endif  // PRODUCT_QUANTIZATION_FAST_SCAN_H_
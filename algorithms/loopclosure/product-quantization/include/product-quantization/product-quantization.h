@@ -1,11 +1,15 @@
 #ifndef PRODUCT_QUANTIZATION_PRODUCT_QUANTIZATION_H_
 #define PRODUCT_QUANTIZATION_PRODUCT_QUANTIZATION_H_
 
+#include <cstdint>
 #include <limits>
+#include <vector>
 
 #include <Eigen/Core>
 #include <glog/logging.h>
 
+#include "product-quantization/fast-scan.h"
+
 namespace product_quantization {
 using Eigen::Block;
 using Eigen::Dynamic;
@@ -171,6 +175,43 @@ class ProductQuantization {
     }
   }
 
+  // Packs a set of quantized vectors into the 4 bit layout used by
+  // ComputeDistancesFastScan. Requires kNumCenters <= kFastScanMaxNumCenters.
+  void PackForFastScan(
+      const QuantizedVectorMatrixType& quantized_vectors,
+      FastScanCodes<kNumComponents>* codes) const {
+    CHECK_NOTNULL(codes)->clear();
+    CHECK_LE(kNumCenters, kFastScanMaxNumCenters);
+    for (int i = 0; i < quantized_vectors.cols(); ++i) {
+      codes->Add(quantized_vectors.col(i));
+    }
+  }
+
+  // Fast-scan variant of ComputeDistances: Quantizes the look-up table to 8 bit
+  // and evaluates it for 16 or 32 packed codes at a time. The distances differ
+  // from the ones of ComputeDistances by at most the max_error of the quantized
+  // look-up table, which is returned if requested.
+  void ComputeDistancesFastScan(
+      const Matrix<float, kNumComponents, kNumCenters>& lut,
+      const FastScanCodes<kNumComponents>& codes,
+      Matrix<float, 1, Dynamic>* squared_distances,
+      float* max_error = nullptr) const {
+    CHECK_NOTNULL(squared_distances);
+    FastScanLookUpTable<kNumComponents> quantized_lut;
+    QuantizeLookUpTable(lut, &quantized_lut);
+    std::vector<uint16_t> quantized_distances;
+    ComputeFastScanDistances(quantized_lut, codes, &quantized_distances);
+
+    squared_distances->resize(Eigen::NoChange, quantized_distances.size());
+    for (size_t i = 0u; i < quantized_distances.size(); ++i) {
+      (*squared_distances)[i] =
+          quantized_lut.ToDistance(quantized_distances[i]);
+    }
+    if (max_error != nullptr) {
+      *max_error = quantized_lut.max_error;
+    }
+  }
+
  private:
   ClusterType cluster_centers_;
 };
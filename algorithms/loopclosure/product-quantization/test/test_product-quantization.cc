@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <cstdlib>
 
 #include <Eigen/Core>
 #include <maplab-common/test/testing-entrypoint.h>
@@ -86,6 +87,74 @@ TEST_F(ProductQuantizationTest, ComputeAndAddDistancesWorks) {
   EXPECT_NEAR_EIGEN(expected_distances, distances, 0.0);
 }
 
+TEST_F(ProductQuantizationTest, ComputeDistancesFastScanWorks) {
+  ProductQuantization<2, 2, 5, uint8_t> product_quantizer(centers_);
+
+  Matrix<float, 2, 5> lut;
+  lut << 25.0, 2.0, 4.0, 13.0, 17.0, 8.0, 5.0, 4.0, 34.0, 17.0;
+
+  FastScanCodes<2> codes;
+  product_quantizer.PackForFastScan(quantized_vectors_, &codes);
+  ASSERT_EQ(codes.size(), 4u);
+
+  Matrix<float, 1, Dynamic> distances;
+  float max_error;
+  product_quantizer.ComputeDistancesFastScan(
+      lut, codes, &distances, &max_error);
+
+  ASSERT_EQ(distances.cols(), 4);
+  Matrix<float, 1, Dynamic> expected_distances;
+  expected_distances.resize(1, 4);
+  expected_distances << 6.0, 36.0, 30.0, 29.0;
+
+  EXPECT_GT(max_error, 0.0f);
+  EXPECT_NEAR_EIGEN(expected_distances, distances, max_error);
+}
+
+TEST(ProductQuantizationFastScanTest, DistancesAreWithinMaxError) {
+  // An odd number of components and a number of vectors that doesn't fill
+  // the last block.
+  constexpr int kNumComponents = 5;
+  constexpr int kNumDimPerComp = 2;
+  constexpr int kNumCenters = 16;
+  constexpr int kNumVectors = 100;
+  typedef ProductQuantization<kNumComponents, kNumDimPerComp, kNumCenters,
+                              uint8_t>
+      ProductQuantizer;
+  std::srand(42);
+  const ProductQuantizer::ClusterType centers =
+      ProductQuantizer::ClusterType::Random();
+  ProductQuantizer product_quantizer(centers);
+
+  const ProductQuantizer::VectorMatrixType vectors =
+      ProductQuantizer::VectorMatrixType::Random(
+          kNumComponents * kNumDimPerComp, kNumVectors);
+  ProductQuantizer::QuantizedVectorMatrixType quantized_vectors;
+  product_quantizer.Quantize(vectors, &quantized_vectors);
+  FastScanCodes<kNumComponents> codes;
+  product_quantizer.PackForFastScan(quantized_vectors, &codes);
+  ASSERT_EQ(codes.size(), static_cast<size_t>(kNumVectors));
+
+  for (int query_idx = 0; query_idx < 10; ++query_idx) {
+    const ProductQuantizer::VectorType query =
+        ProductQuantizer::VectorType::Random();
+    Matrix<float, kNumComponents, kNumCenters> lut;
+    product_quantizer.FillLUT(query, &lut);
+
+    Matrix<float, 1, Dynamic> distances;
+    product_quantizer.ComputeDistances(lut, quantized_vectors, &distances);
+    Matrix<float, 1, Dynamic> fast_scan_distances;
+    float max_error;
+    product_quantizer.ComputeDistancesFastScan(
+        lut, codes, &fast_scan_distances, &max_error);
+
+    ASSERT_EQ(fast_scan_distances.cols(), kNumVectors);
+    // The quantization step is the range of the table divided by 255.
+    EXPECT_LT(max_error, 0.1f * (lut.maxCoeff() - lut.minCoeff()));
+    EXPECT_NEAR_EIGEN(distances, fast_scan_distances, max_error);
+  }
+}
+
 }  // namespace product_quantization
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,5 +1,8 @@
 #ifndef VOCABULARY_TREE_HAMMING_H_
 #define VOCABULARY_TREE_HAMMING_H_
+
+#include <cstddef>
+
 namespace loop_closure {
 inline unsigned int HammingDistance32(unsigned int a, unsigned int b);
 inline unsigned int HammingDistance128(
@@ -10,6 +13,31 @@ inline unsigned int HammingDistance512(
     const unsigned char d1[64], const unsigned char d2[64]);
 inline unsigned int HammingDistance(
     const unsigned char* d1, const unsigned char* d2, unsigned int numBits);
+
+// Implementations of the batched Hamming distance below. The kernel is picked
+// at runtime, such that the same binary uses the widest instructions the CPU
+// supports.
+enum class HammingKernel { kGeneric, kPopcnt, kAvx2, kAvx512Vpopcntdq, kNeon };
+
+bool isHammingKernelSupported(HammingKernel kernel);
+// Detected once, in order AVX-512 VPOPCNTDQ, AVX2, NEON, POPCNT, generic.
+HammingKernel getWidestSupportedHammingKernel();
+const char* getHammingKernelName(HammingKernel kernel);
+
+// Computes the Hamming distances between one query descriptor and
+// num_descriptors descriptors of num_bytes bytes each, which are stored
+// contiguously, e.g. as the columns of a descriptor matrix. Arbitrary
+// descriptor lengths are supported. Much faster than calling
+// HammingDistance() per descriptor when matching a query against many
+// candidates.
+void HammingDistancesToQuery(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances);
+// Uses the given kernel, which must be supported by the CPU.
+void HammingDistancesToQuery(
+    HammingKernel kernel, const unsigned char* query,
+    const unsigned char* descriptors, size_t num_bytes, size_t num_descriptors,
+    unsigned int* distances);
 }  // namespace loop_closure
 
 #include "vocabulary-tree/impl/hamming-inl.h"
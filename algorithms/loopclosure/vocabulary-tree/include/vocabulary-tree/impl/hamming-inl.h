@@ -4,6 +4,8 @@
 #if !defined(__ARM_NEON__)
 #include <emmintrin.h>
 #include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
 #endif  // __ARM_NEON__
 
 #include <glog/logging.h>
@@ -83,18 +85,13 @@ __inline__ uint32_t NEONPopcntofXORed(
     const int numberOf128BitWords) {
   CHECK_NOTNULL(signature1);
   CHECK_NOTNULL(signature2);
-  uint32_t result = 0;
-
+  // Pairwise accumulation of the byte counts, reduced once at the end.
+  uint16x8_t sums = vdupq_n_u16(0u);
   for (int i = 0; i < numberOf128BitWords; ++i) {
     uint8x16_t xor_result = veorq_u8(signature1[i], signature2[i]);
-    uint8x16_t set_bits = vcntq_u8(xor_result);
-    uint8_t result_popcnt[16];
-    vst1q_u8(result_popcnt, set_bits);
-    for (int j = 0; j < 16; ++j) {
-      result += result_popcnt[j];
-    }
+    sums = vpadalq_u8(sums, vcntq_u8(xor_result));
   }
-  return result;
+  return vaddlvq_u16(sums);
 }
 #endif
 
@@ -50,6 +50,31 @@ ClusterMean(
   aslam::common::DescriptorMean(features, mean);
 }
 
+// Moves the center towards the feature with a learning rate of 1 / count,
+// where count is the number of features that contributed to the center so far.
+template <class Feature>
+typename std::enable_if<std::is_floating_point<typename Feature::Scalar>::value,
+                        void>::type
+MiniBatchUpdate(
+    const Feature& feature, size_t count, Feature* const center) {
+  CHECK_NOTNULL(center);
+  CHECK_GT(count, 0u);
+  typedef typename Feature::Scalar Scalar;
+  const Scalar learning_rate =
+      static_cast<Scalar>(1) / static_cast<Scalar>(count);
+  *center += learning_rate * (feature - *center);
+}
+
+// Binary features have no meaningful interpolation between two descriptors.
+template <class Feature>
+typename std::enable_if<std::is_integral<typename Feature::value_type>::value,
+                        void>::type
+MiniBatchUpdate(
+    const Feature& /*feature*/, size_t /*count*/, Feature* const /*center*/) {
+  LOG(FATAL) << "Mini-batch k-means is only supported for floating point "
+             << "features.";
+}
+
 template <class Feature, class Distance, class FeatureAllocator>
 SimpleKmeans<Feature, Distance, FeatureAllocator>::SimpleKmeans(
     const Feature& zero, const Distance& d)
@@ -57,7 +82,10 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::SimpleKmeans(
       distance_(d),
       choose_centers_(InitKMeansPlusPlus<Feature>(zero)),
       max_iterations_(100),
-      restarts_(1) {}
+      restarts_(1),
+      mini_batch_size_(0u),
+      seeding_sample_size_(0u),
+      parallel_restarts_(false) {}
 
 template <class Feature, class Distance, class FeatureAllocator>
 typename SimpleKmeans<Feature, Distance, FeatureAllocator>::SquaredDistanceType
@@ -87,34 +115,91 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterPointers(
   CHECK_NOTNULL(centers);
   CHECK(*centers);
   CHECK_NOTNULL(membership);
-  std::mt19937 generator(random_seed);
+  CHECK_GT(restarts_, 0u);
+  CHECK(!features.empty());
   typedef typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers
       Centers;
 
-  Centers new_centers =
-      aligned_shared<std::vector<Feature, FeatureAllocator> >(**centers);
+  // Draw all seeds up front, so the result is the same no matter whether the
+  // restarts run concurrently or not.
+  std::mt19937 generator(random_seed);
+  std::vector<int> seeding_seeds(restarts_);
+  std::vector<int> clustering_seeds(restarts_);
+  for (size_t start = 0; start < restarts_; ++start) {
+    seeding_seeds[start] = generator();
+    clustering_seeds[start] = generator();
+  }
 
-  std::vector<unsigned int> new_membership(features.size());
-  (*centers)->clear();
+  // Every restart starts from a copy of the given centers, which is what
+  // InitGiven relies on.
+  std::vector<Centers> restart_centers(restarts_);
+  std::vector<std::vector<unsigned int> > restart_memberships(restarts_);
+  std::vector<SquaredDistanceType> restart_sse(restarts_);
+  auto run_restart = [&, this](size_t start, size_t num_threads) {
+    Centers& new_centers = restart_centers[start];
+    new_centers =
+        aligned_shared<std::vector<Feature, FeatureAllocator> >(**centers);
+
+    const size_t seeding_sample_size = std::max(seeding_sample_size_, k);
+    if (seeding_sample_size_ > 0u && seeding_sample_size < features.size()) {
+      // Choose the initial centers from a random subset of the features using
+      // a partial Fisher-Yates shuffle.
+      std::mt19937 sample_generator(seeding_seeds[start]);
+      std::vector<Feature*> features_perm = features;
+      for (size_t i = 0; i < seeding_sample_size; ++i) {
+        const size_t j = i + sample_generator() % (features_perm.size() - i);
+        std::swap(features_perm[i], features_perm[j]);
+      }
+      features_perm.resize(seeding_sample_size);
+      choose_centers_(
+          features_perm, k, distance_, sample_generator(), new_centers.get());
+    } else {
+      choose_centers_(
+          features, k, distance_, seeding_seeds[start], new_centers.get());
+    }
 
-  SquaredDistanceType least_sse =
-      std::numeric_limits<SquaredDistanceType>::max();
+    VLOG(3) << "#\tCluster run " << start;
+    VLOG(3) << "Have " << new_centers->size() << " centers" << std::endl;
+    std::vector<unsigned int>& new_membership = restart_memberships[start];
+    new_membership.resize(features.size(), -1);
+    if (mini_batch_size_ > 0u) {
+      restart_sse[start] = ClusterMiniBatch(
+          features, k, clustering_seeds[start], num_threads, &new_centers,
+          &new_membership);
+    } else {
+      restart_sse[start] = ClusterOnce(
+          features, k, clustering_seeds[start], num_threads, &new_centers,
+          &new_membership);
+    }
+  };
 
-  for (size_t starts = 0; starts < restarts_; ++starts) {
-    choose_centers_(features, k, distance_, generator(), new_centers.get());
+  if (parallel_restarts_ && restarts_ > 1u) {
+    auto restart_functor =
+        [&run_restart](const std::vector<size_t>& range) -> void {
+      for (size_t start : range) {
+        run_restart(start, 1u);
+      }
+    };
+    const bool kAlwaysParallelize = true;
+    common::ParallelProcess(
+        restarts_, restart_functor, kAlwaysParallelize, restarts_);
+  } else {
+    const size_t num_threads = common::getNumHardwareThreads();
+    for (size_t start = 0; start < restarts_; ++start) {
+      run_restart(start, num_threads);
+    }
+  }
 
-    VLOG(3) << "#\tCluster run " << starts;
-    VLOG(3) << "Have " << new_centers->size() << " centers" << std::endl;
-    SquaredDistanceType sse =
-        ClusterOnce(features, k, generator(), &new_centers, &new_membership);
-    if (sse < least_sse) {
-      least_sse = sse;
-      *centers = new_centers;
-      *membership = new_membership;
+  size_t best_start = 0u;
+  for (size_t start = 1u; start < restarts_; ++start) {
+    if (restart_sse[start] < restart_sse[best_start]) {
+      best_start = start;
     }
   }
+  *centers = restart_centers[best_start];
+  membership->swap(restart_memberships[best_start]);
   CHECK(!(*centers)->empty());
-  return least_sse;
+  return restart_sse[best_start];
 }
 
 // This class is the default implementation of a search accelerator that
@@ -188,6 +273,33 @@ class DefaultSearchAccelerator {
     return nearest;
   }
 
+  // Batched version of FindIndexOfClosestFeature. Every database feature is
+  // compared to all queries in turn such that it stays in the cache.
+  void FindIndicesOfClosestFeatures(
+      const std::vector<const Feature*>& query_features,
+      std::vector<unsigned int>* indices) const {
+    CHECK_NOTNULL(indices);
+    CHECK(database_features_);
+    const size_t num_queries = query_features.size();
+    indices->assign(num_queries, 0u);
+    if (database_features_->empty()) {
+      return;
+    }
+    std::vector<SquaredDistanceType> min_distances(
+        num_queries, std::numeric_limits<SquaredDistanceType>::max());
+    for (unsigned int i = 0; i < database_features_->size(); ++i) {
+      const Feature& database_feature = (*database_features_)[i];
+      for (size_t query_idx = 0u; query_idx < num_queries; ++query_idx) {
+        const SquaredDistanceType distance =
+            distance_(*query_features[query_idx], database_feature);
+        if (distance < min_distances[query_idx]) {
+          min_distances[query_idx] = distance;
+          (*indices)[query_idx] = i;
+        }
+      }
+    }
+  }
+
  private:
   std::shared_ptr<std::vector<Feature, FeatureAllocator> > database_features_;
   std::vector<Candidate> candidates_;
@@ -213,7 +325,8 @@ class KDTreeSearchAccelerator {
   KDTreeSearchAccelerator(
       const std::shared_ptr<std::vector<Feature, FeatureAllocator> >&
           database_features,
-      const Distance& /*distance*/) {
+      const Distance& /*distance*/)
+      : is_linear_search_(false) {
     CHECK(database_features);
     if (database_features->empty()) {
       return;
@@ -235,6 +348,7 @@ class KDTreeSearchAccelerator {
     static const size_t kLowFeatureCount = 100;
     if (database_features->size() < kLowFeatureCount) {
       search_type = NNType::BRUTE_FORCE;
+      is_linear_search_ = true;
     }
 
     nns_.reset(
@@ -261,6 +375,49 @@ class KDTreeSearchAccelerator {
     return indices(0, 0);
   }
 
+  // Batched version of FindIndexOfClosestFeature. Small databases compare
+  // every query to the whole database matrix at once, larger ones query the
+  // kd-tree with all queries. The distances of small databases are not
+  // expanded into a matrix product ||c||^2 - 2 * c^T * q as it cancels out
+  // to a different nearest feature for descriptors far from the origin.
+  void FindIndicesOfClosestFeatures(
+      const std::vector<const Feature*>& query_features,
+      std::vector<unsigned int>* indices) const {
+    CHECK_NOTNULL(indices);
+    const int num_queries = static_cast<int>(query_features.size());
+    indices->assign(num_queries, 0u);
+    if (!knn_data_ || num_queries == 0) {
+      return;
+    }
+    CloudType queries(knn_data_->rows(), num_queries);
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      queries.col(query_idx) = *query_features[query_idx];
+    }
+
+    if (is_linear_search_) {
+      for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+        int nearest;
+        (knn_data_->colwise() - queries.col(query_idx))
+            .colwise()
+            .squaredNorm()
+            .minCoeff(&nearest);
+        (*indices)[query_idx] = nearest;
+      }
+      return;
+    }
+
+    const Scalar epsilon = static_cast<Scalar>(FLAGS_lc_kdtree_accelerator_eps);
+    const int num_nearest_neighbors = 1;
+    Eigen::MatrixXi nearest_indices(num_nearest_neighbors, num_queries);
+    CloudType nearest_distances(num_nearest_neighbors, num_queries);
+    nns_->knn(
+        queries, nearest_indices, nearest_distances, num_nearest_neighbors,
+        epsilon, NNType::SORT_RESULTS | NNType::ALLOW_SELF_MATCH);
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      (*indices)[query_idx] = nearest_indices(0, query_idx);
+    }
+  }
+
   void GetNNearestNeighbors(
       const Feature& query_feature, int num_neighbors,
       std::vector<int>* const _indices,
@@ -313,6 +470,8 @@ class KDTreeSearchAccelerator {
  private:
   std::shared_ptr<Nabo::NearestNeighbourSearch<Scalar> > nns_;
   std::shared_ptr<CloudType> knn_data_;
+  // True if the database features are few enough to be searched linearly.
+  bool is_linear_search_;
 };
 
 // A compile time selector of the correct search accelerator:
@@ -369,6 +528,7 @@ template <class Feature, class Distance, class FeatureAllocator>
 typename SimpleKmeans<Feature, Distance, FeatureAllocator>::SquaredDistanceType
 SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnce(
     const std::vector<Feature*>& features, size_t k, int random_seed,
+    size_t num_threads,
     typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers* const
         centers,
     std::vector<unsigned int>* const membership) const {
@@ -423,7 +583,6 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnce(
               search_accelerator, &features, centers->get(), &new_membership);
 
       const bool kAlwaysParallelize = false;
-      const size_t num_threads = common::getNumHardwareThreads();
       common::ParallelProcess(
           features.size(), accelerator, kAlwaysParallelize, num_threads);
     }
@@ -465,7 +624,6 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnce(
     };
 
     const bool kAlwaysParallelize = true;
-    const size_t num_threads = common::getNumHardwareThreads();
     common::ParallelProcess(
         new_centers.size(), mean_functor, kAlwaysParallelize, num_threads);
 
@@ -499,5 +657,79 @@ SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterOnce(
   }
   return sse;
 }
+
+template <class Feature, class Distance, class FeatureAllocator>
+void SimpleKmeans<Feature, Distance, FeatureAllocator>::AssignToClosestCenters(
+    const std::vector<Feature*>& features, size_t num_threads,
+    const typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers&
+        centers,
+    std::vector<unsigned int>* const membership) const {
+  CHECK(centers);
+  CHECK_NOTNULL(membership);
+  typedef
+      typename GetSearchAccelerator<Feature, Distance, FeatureAllocator>::type
+          SearchAccelerator;
+  SearchAccelerator search_accelerator(centers, distance_);
+
+  membership->assign(features.size(), -1);
+  ThreadedClusteringHelper<Feature, Distance, FeatureAllocator,
+                           SearchAccelerator>
+      accelerator(search_accelerator, &features, centers.get(), membership);
+
+  const bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      features.size(), accelerator, kAlwaysParallelize, num_threads);
+}
+
+template <class Feature, class Distance, class FeatureAllocator>
+typename SimpleKmeans<Feature, Distance, FeatureAllocator>::SquaredDistanceType
+SimpleKmeans<Feature, Distance, FeatureAllocator>::ClusterMiniBatch(
+    const std::vector<Feature*>& features, size_t k, int random_seed,
+    size_t num_threads,
+    typename SimpleKmeans<Feature, Distance, FeatureAllocator>::Centers* const
+        centers,
+    std::vector<unsigned int>* const membership) const {
+  CHECK_NOTNULL(centers);
+  CHECK(*centers);
+  CHECK_NOTNULL(membership);
+  CHECK_EQ((*centers)->size(), k);
+  CHECK_GT(mini_batch_size_, 0u);
+
+  std::mt19937 generator(random_seed);
+  // Number of features that contributed to every center so far.
+  std::vector<size_t> center_counts(k, 0u);
+  std::vector<Feature*> batch(mini_batch_size_);
+  std::vector<unsigned int> batch_membership;
+
+  for (size_t iter = 0; iter < max_iterations_; ++iter) {
+    for (Feature*& feature : batch) {
+      feature = features[generator() % features.size()];
+    }
+
+    // All features of the batch are assigned to the centers of the previous
+    // iteration before any center is moved.
+    AssignToClosestCenters(batch, num_threads, *centers, &batch_membership);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const unsigned int center_idx = batch_membership[i];
+      CHECK_LT(center_idx, k);
+      ++center_counts[center_idx];
+      MiniBatchUpdate(
+          *batch[i], center_counts[center_idx], &(**centers)[center_idx]);
+    }
+
+    if (features.size() > 1000 && iter % 100 == 0) {
+      VLOG(3) << "\t#" << iter << " Updated centers from mini-batch.";
+    }
+  }
+
+  AssignToClosestCenters(features, num_threads, *centers, membership);
+
+  // Return the sum squared error
+  SquaredDistanceType sse = SquaredDistanceType();
+  for (size_t i = 0; i < features.size(); ++i) {
+    sse += distance_(*features[i], (**centers)[(*membership)[i]]);
+  }
+  return sse;
+}
 }  // namespace loop_closure
 #endif  // VOCABULARY_TREE_SIMPLE_KMEANS_INL_H_
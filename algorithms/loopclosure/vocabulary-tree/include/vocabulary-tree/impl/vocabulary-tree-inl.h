@@ -2,14 +2,17 @@
 // http://ros.org/wiki/vocabulary_tree
 #ifndef VOCABULARY_TREE_VOCABULARY_TREE_INL_H_
 #define VOCABULARY_TREE_VOCABULARY_TREE_INL_H_
+#include <algorithm>
 #include <limits>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <aslam/common/memory.h>
 #include <loopclosure-common/flags.h>
 #include <maplab-common/binary-serialization.h>
+#include <maplab-common/parallel-process.h>
 
 namespace loop_closure {
 template <class Feature, class Distance, class FeatureAllocator>
@@ -45,6 +48,83 @@ Word VocabularyTree<Feature, Distance, FeatureAllocator>::Quantize(
   return index - word_start_;
 }
 
+template <class Feature, class Distance, class FeatureAllocator>
+void VocabularyTree<Feature, Distance, FeatureAllocator>::Quantize(
+    const std::vector<Feature, FeatureAllocator>& features,
+    size_t num_threads, std::vector<Word>* words) const {
+  CHECK_NOTNULL(words);
+  CHECK(Initialized());
+  CHECK(!search_accelerators_.empty());
+  CHECK_GT(num_threads, 0u);
+  const size_t num_features = features.size();
+  words->resize(num_features);
+  for (const Feature& feature : features) {
+    CHECK_EQ(feature.size(), centers_[0].size());
+  }
+
+  // Number of features that descend the tree together, such that the
+  // features and their state stay in the cache.
+  constexpr size_t kBlockSize = 1024u;
+  const size_t num_blocks = (num_features + kBlockSize - 1u) / kBlockSize;
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_blocks,
+      [&](const std::vector<size_t>& range) {
+        // Pairs of the search accelerator of the current node and the index
+        // of the feature.
+        std::vector<std::pair<int32_t, size_t> > accelerators_and_features;
+        std::vector<const Feature*> node_features;
+        std::vector<unsigned int> closest_children;
+        for (const size_t block_idx : range) {
+          const size_t block_begin = block_idx * kBlockSize;
+          const size_t block_end =
+              std::min(block_begin + kBlockSize, num_features);
+
+          // All features start at the virtual root, which is accelerator 0.
+          accelerators_and_features.clear();
+          for (size_t i = block_begin; i < block_end; ++i) {
+            accelerators_and_features.emplace_back(0, i);
+          }
+          for (unsigned level = 0; level < levels_; ++level) {
+            std::sort(
+                accelerators_and_features.begin(),
+                accelerators_and_features.end());
+            for (size_t begin = 0u; begin < accelerators_and_features.size();) {
+              const int32_t accelerator =
+                  accelerators_and_features[begin].first;
+              CHECK_LT(
+                  accelerator,
+                  static_cast<int32_t>(search_accelerators_.size()));
+              size_t end = begin;
+              node_features.clear();
+              while (end < accelerators_and_features.size() &&
+                     accelerators_and_features[end].first == accelerator) {
+                node_features.push_back(
+                    &features[accelerators_and_features[end].second]);
+                ++end;
+              }
+              search_accelerators_[accelerator].FindIndicesOfClosestFeatures(
+                  node_features, &closest_children);
+              // The children of the accelerator's node start at
+              // accelerator * splits() and become the next accelerators.
+              const int32_t first_child = accelerator * splits();
+              for (size_t i = begin; i < end; ++i) {
+                accelerators_and_features[i].first =
+                    first_child + closest_children[i - begin] + 1;
+              }
+              begin = end;
+            }
+          }
+          for (const std::pair<int32_t, size_t>& accelerator_and_feature :
+               accelerators_and_features) {
+            (*words)[accelerator_and_feature.second] =
+                accelerator_and_feature.first - 1 - word_start_;
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+}
+
 template <class Feature, class Distance, class FeatureAllocator>
 void VocabularyTree<Feature, Distance, FeatureAllocator>::
     GetNearestNeighborTopLevel(
@@ -62,6 +62,36 @@ class SimpleKmeans {
     restarts_ = restarts;
   }
 
+  // Number of randomly sampled features used per iteration to update the
+  // centers (Sculley, "Web-scale k-means clustering"). Only supported for
+  // floating point features. Zero runs the standard Lloyd's algorithm on all
+  // features.
+  size_t GetMiniBatchSize() const {
+    return mini_batch_size_;
+  }
+  void SetMiniBatchSize(size_t mini_batch_size) {
+    mini_batch_size_ = mini_batch_size;
+  }
+
+  // Number of randomly sampled features the initializer chooses the centers
+  // from. Zero passes all features to the initializer.
+  size_t GetSeedingSampleSize() const {
+    return seeding_sample_size_;
+  }
+  void SetSeedingSampleSize(size_t seeding_sample_size) {
+    seeding_sample_size_ = seeding_sample_size;
+  }
+
+  // Runs the restarts concurrently, each on a single thread, instead of one
+  // after the other with every restart parallelized internally. The result
+  // does not depend on this setting.
+  bool GetParallelRestarts() const {
+    return parallel_restarts_;
+  }
+  void SetParallelRestarts(bool parallel_restarts) {
+    parallel_restarts_ = parallel_restarts;
+  }
+
   // Partition a set of features into k clusters.
   // - features   The features to be clustered.
   // - k          The number of clusters.
@@ -88,7 +118,18 @@ class SimpleKmeans {
  private:
   SquaredDistanceType ClusterOnce(
       const std::vector<Feature*>& features, size_t k, int random_seed,
-      Centers* const centers,
+      size_t num_threads, Centers* const centers,
+      std::vector<unsigned int>* const membership) const;
+
+  SquaredDistanceType ClusterMiniBatch(
+      const std::vector<Feature*>& features, size_t k, int random_seed,
+      size_t num_threads, Centers* const centers,
+      std::vector<unsigned int>* const membership) const;
+
+  // Assigns every feature to its closest center.
+  void AssignToClosestCenters(
+      const std::vector<Feature*>& features, size_t num_threads,
+      const Centers& centers,
       std::vector<unsigned int>* const membership) const;
 
   Feature zero_;
@@ -96,6 +137,9 @@ class SimpleKmeans {
   Initializer choose_centers_;
   size_t max_iterations_;
   size_t restarts_;
+  size_t mini_batch_size_;
+  size_t seeding_sample_size_;
+  bool parallel_restarts_;
 };
 
 // Initializer for K-means that randomly selects k features as the cluster
@@ -121,7 +165,7 @@ struct InitRandom {
     }
     // Take the first k permuted features as the initial centers
     for (size_t i = 0; i < centers->size(); ++i) {
-      centers[i] = *features_perm[i];
+      (*centers)[i] = *features_perm[i];
     }
   }
 
@@ -47,6 +47,14 @@ class VocabularyTree {
   // Quantizes a feature into a discrete word.
   Word Quantize(const Feature& f) const;
 
+  // Quantizes many features into words. The features are split into blocks
+  // that are processed in parallel on num_threads threads. The features of a
+  // block descend the tree level by level, all features at the same node are
+  // compared to its children at once.
+  void Quantize(
+      const std::vector<Feature, FeatureAllocator>& features,
+      size_t num_threads, std::vector<Word>* words) const;
+
   // Gets the n nearest buckets.
   void GetNearestNeighborTopLevel(
       const Feature& f, unsigned int num_nearest_neighbors,
@@ -0,0 +1,279 @@
+#include "vocabulary-tree/hamming.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define VOCABULARY_TREE_HAMMING_X86_64
+// The AVX-512 VPOPCNTDQ intrinsics and the CPU feature name are available
+// from GCC 8 and clang 6 on.
+#if (defined(__clang__) && __clang_major__ >= 6) || \
+    (!defined(__clang__) && __GNUC__ >= 8)
+#define VOCABULARY_TREE_HAMMING_AVX512
+#endif
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace loop_closure {
+namespace {
+
+typedef void (*HammingDistancesFunction)(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances);
+
+inline uint64_t loadWord(const unsigned char* data) {
+  uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+// Also used for the bytes that don't fill a whole register in the vectorized
+// kernels.
+inline unsigned int genericDistance(
+    const unsigned char* a, const unsigned char* b, size_t num_bytes) {
+  unsigned int distance = 0u;
+  size_t i = 0u;
+  for (; i + sizeof(uint64_t) <= num_bytes; i += sizeof(uint64_t)) {
+    distance += __builtin_popcountll(loadWord(a + i) ^ loadWord(b + i));
+  }
+  for (; i < num_bytes; ++i) {
+    distance += __builtin_popcount(a[i] ^ b[i]);
+  }
+  return distance;
+}
+
+void genericDistances(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+    distances[idx] =
+        genericDistance(query, descriptors + idx * num_bytes, num_bytes);
+  }
+}
+
+#ifdef VOCABULARY_TREE_HAMMING_X86_64
+__attribute__((target("popcnt"))) void popcntDistances(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  const size_t num_word_bytes = num_bytes - num_bytes % sizeof(uint64_t);
+  for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+    const unsigned char* descriptor = descriptors + idx * num_bytes;
+    uint64_t distance = 0u;
+    for (size_t i = 0u; i < num_word_bytes; i += sizeof(uint64_t)) {
+      distance +=
+          _mm_popcnt_u64(loadWord(query + i) ^ loadWord(descriptor + i));
+    }
+    distances[idx] = static_cast<unsigned int>(distance) +
+                     genericDistance(
+                         query + num_word_bytes, descriptor + num_word_bytes,
+                         num_bytes - num_word_bytes);
+  }
+}
+
+// Nibble lookup popcount on 256 bit registers, like SSSE3PopcntofXORed.
+__attribute__((target("avx2"))) void avx2Distances(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  const __m256i popcount_4bit = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3,
+      1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i mask_4bit = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  const size_t num_vector_bytes = num_bytes - num_bytes % sizeof(__m256i);
+  for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+    const unsigned char* descriptor = descriptors + idx * num_bytes;
+    __m256i sums = zero;
+    for (size_t i = 0u; i < num_vector_bytes; i += sizeof(__m256i)) {
+      const __m256i xored = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + i)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(descriptor + i)));
+      const __m256i lower_nibbles = _mm256_and_si256(xored, mask_4bit);
+      const __m256i higher_nibbles =
+          _mm256_and_si256(_mm256_srli_epi16(xored, 4), mask_4bit);
+      const __m256i counts = _mm256_add_epi8(
+          _mm256_shuffle_epi8(popcount_4bit, lower_nibbles),
+          _mm256_shuffle_epi8(popcount_4bit, higher_nibbles));
+      // Sums up the byte counts into four 64 bit counters.
+      sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, zero));
+    }
+    const __m128i sums_128 = _mm_add_epi64(
+        _mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    const uint64_t distance = static_cast<uint64_t>(
+        _mm_cvtsi128_si64(sums_128) + _mm_extract_epi64(sums_128, 1));
+    distances[idx] = static_cast<unsigned int>(distance) +
+                     genericDistance(
+                         query + num_vector_bytes,
+                         descriptor + num_vector_bytes,
+                         num_bytes - num_vector_bytes);
+  }
+}
+#endif  // VOCABULARY_TREE_HAMMING_X86_64
+
+#ifdef VOCABULARY_TREE_HAMMING_AVX512
+// Covers descriptors of up to 512 bits with a single masked load, longer
+// descriptors in chunks of 512 bits.
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) void
+avx512Distances(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  constexpr size_t kNumRegisterBytes = sizeof(__m512i);
+  const size_t num_tail_bytes = num_bytes % kNumRegisterBytes;
+  const size_t num_vector_bytes = num_bytes - num_tail_bytes;
+  const __mmask64 tail_mask =
+      num_tail_bytes == 0u ? 0u : (~0ull >> (64u - num_tail_bytes));
+  const __m512i query_tail =
+      _mm512_maskz_loadu_epi8(tail_mask, query + num_vector_bytes);
+  for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+    const unsigned char* descriptor = descriptors + idx * num_bytes;
+    __m512i sums = _mm512_popcnt_epi64(_mm512_xor_si512(
+        query_tail,
+        _mm512_maskz_loadu_epi8(tail_mask, descriptor + num_vector_bytes)));
+    for (size_t i = 0u; i < num_vector_bytes; i += kNumRegisterBytes) {
+      sums = _mm512_add_epi64(
+          sums, _mm512_popcnt_epi64(_mm512_xor_si512(
+                    _mm512_loadu_si512(query + i),
+                    _mm512_loadu_si512(descriptor + i))));
+    }
+    distances[idx] = static_cast<unsigned int>(_mm512_reduce_add_epi64(sums));
+  }
+}
+#endif  // VOCABULARY_TREE_HAMMING_AVX512
+
+#if defined(__aarch64__)
+void neonDistances(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  const size_t num_vector_bytes = num_bytes - num_bytes % sizeof(uint8x16_t);
+  for (size_t idx = 0u; idx < num_descriptors; ++idx) {
+    const unsigned char* descriptor = descriptors + idx * num_bytes;
+    // Sixteen bit counters, which can't overflow for descriptors of less
+    // than 32768 bytes.
+    uint16x8_t sums = vdupq_n_u16(0u);
+    for (size_t i = 0u; i < num_vector_bytes; i += sizeof(uint8x16_t)) {
+      const uint8x16_t xored =
+          veorq_u8(vld1q_u8(query + i), vld1q_u8(descriptor + i));
+      sums = vpadalq_u8(sums, vcntq_u8(xored));
+    }
+    distances[idx] = vaddlvq_u16(sums) +
+                     genericDistance(
+                         query + num_vector_bytes,
+                         descriptor + num_vector_bytes,
+                         num_bytes - num_vector_bytes);
+  }
+}
+#endif  // __aarch64__
+
+HammingDistancesFunction getHammingDistancesFunction(HammingKernel kernel) {
+  CHECK(isHammingKernelSupported(kernel))
+      << "The Hamming distance kernel " << getHammingKernelName(kernel)
+      << " is not supported on this CPU.";
+  switch (kernel) {
+#ifdef VOCABULARY_TREE_HAMMING_X86_64
+    case HammingKernel::kPopcnt:
+      return &popcntDistances;
+    case HammingKernel::kAvx2:
+      return &avx2Distances;
+#endif
+#ifdef VOCABULARY_TREE_HAMMING_AVX512
+    case HammingKernel::kAvx512Vpopcntdq:
+      return &avx512Distances;
+#endif
+#if defined(__aarch64__)
+    case HammingKernel::kNeon:
+      return &neonDistances;
+#endif
+    default:
+      return &genericDistances;
+  }
+}
+
+}  // namespace
+
+bool isHammingKernelSupported(HammingKernel kernel) {
+#ifdef VOCABULARY_TREE_HAMMING_X86_64
+  __builtin_cpu_init();
+#endif
+  switch (kernel) {
+    case HammingKernel::kGeneric:
+      return true;
+#ifdef VOCABULARY_TREE_HAMMING_X86_64
+    case HammingKernel::kPopcnt:
+      return __builtin_cpu_supports("popcnt");
+    case HammingKernel::kAvx2:
+      return __builtin_cpu_supports("avx2");
+#endif
+#ifdef VOCABULARY_TREE_HAMMING_AVX512
+    case HammingKernel::kAvx512Vpopcntdq:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+#if defined(__aarch64__)
+    // NEON is part of the base instruction set on aarch64.
+    case HammingKernel::kNeon:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+HammingKernel getWidestSupportedHammingKernel() {
+  static const HammingKernel kWidestKernel = []() {
+    for (const HammingKernel kernel :
+         {HammingKernel::kAvx512Vpopcntdq, HammingKernel::kAvx2,
+          HammingKernel::kNeon, HammingKernel::kPopcnt}) {
+      if (isHammingKernelSupported(kernel)) {
+        return kernel;
+      }
+    }
+    return HammingKernel::kGeneric;
+  }();
+  return kWidestKernel;
+}
+
+const char* getHammingKernelName(HammingKernel kernel) {
+  switch (kernel) {
+    case HammingKernel::kGeneric:
+      return "generic";
+    case HammingKernel::kPopcnt:
+      return "POPCNT";
+    case HammingKernel::kAvx2:
+      return "AVX2";
+    case HammingKernel::kAvx512Vpopcntdq:
+      return "AVX-512 VPOPCNTDQ";
+    case HammingKernel::kNeon:
+      return "NEON";
+  }
+  return "unknown";
+}
+
+void HammingDistancesToQuery(
+    const unsigned char* query, const unsigned char* descriptors,
+    size_t num_bytes, size_t num_descriptors, unsigned int* distances) {
+  static const HammingDistancesFunction kHammingDistances =
+      getHammingDistancesFunction(getWidestSupportedHammingKernel());
+  CHECK_NOTNULL(query);
+  CHECK_NOTNULL(distances);
+  CHECK(descriptors != nullptr || num_descriptors == 0u);
+  kHammingDistances(query, descriptors, num_bytes, num_descriptors, distances);
+}
+
+void HammingDistancesToQuery(
+    HammingKernel kernel, const unsigned char* query,
+    const unsigned char* descriptors, size_t num_bytes, size_t num_descriptors,
+    unsigned int* distances) {
+  CHECK_NOTNULL(query);
+  CHECK_NOTNULL(distances);
+  CHECK(descriptors != nullptr || num_descriptors == 0u);
+  getHammingDistancesFunction(kernel)(
+      query, descriptors, num_bytes, num_descriptors, distances);
+}
+
+}  // namespace loop_closure
@@ -46,6 +46,12 @@ TEST(VocabularyTree, VocabularyTree_AcceleratedQuantization) {
 
   loop_closure::distance::L2<DescriptorType> l2_distance;
 
+  std::vector<loop_closure::Word> batch_words;
+  static const size_t kNumThreads = 4;
+  tree.Quantize(descriptors, kNumThreads, &batch_words);
+  ASSERT_EQ(batch_words.size(), descriptors.size());
+
+  size_t descriptor_idx = 0u;
   for (const DescriptorType& feature : descriptors) {
     int32_t index = -1;  // Virtual root index, which has no associated center.
     for (unsigned level = 0; level < kNumLevels; ++level) {
@@ -70,6 +76,8 @@ TEST(VocabularyTree, VocabularyTree_AcceleratedQuantization) {
     loop_closure::Word word_gt = index - tree.wordstart();
     loop_closure::Word word = tree.Quantize(feature);
     EXPECT_EQ(word_gt, word);
+    EXPECT_EQ(word, batch_words[descriptor_idx]);
+    ++descriptor_idx;
   }
 }
 
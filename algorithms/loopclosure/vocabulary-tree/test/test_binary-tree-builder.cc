@@ -59,6 +59,11 @@ TEST(VocabularyTree, VocabularyTree_BinaryDescriptorsBuilder) {
   using loop_closure::distance::Hamming;
   Hamming<DescriptorType> hamming_distance;
 
+  std::vector<loop_closure::Word> batch_words;
+  static const size_t kNumThreads = 4;
+  tree.Quantize(descriptor_refs, kNumThreads, &batch_words);
+  ASSERT_EQ(batch_words.size(), descriptor_refs.size());
+
   for (int descriptor_idx = 0; descriptor_idx < descriptors.cols();
        ++descriptor_idx) {
     DescriptorType descriptor(
@@ -81,6 +86,7 @@ TEST(VocabularyTree, VocabularyTree_BinaryDescriptorsBuilder) {
     EXPECT_NE(closest_center, -1);
 
     unsigned int leaf_idx = tree.Quantize(descriptor);
+    EXPECT_EQ(static_cast<int>(leaf_idx), batch_words[descriptor_idx]);
     unsigned int other_distance =
         hamming_distance(descriptor, centers.at(leaf_idx));
     if (static_cast<double>(closest_distance) / other_distance < 0.2) {
@@ -0,0 +1,134 @@
+#include <chrono>  // NOLINT
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vocabulary-tree/hamming.h"
+
+namespace loop_closure {
+
+namespace {
+const std::vector<HammingKernel> kAllKernels = {
+    HammingKernel::kGeneric, HammingKernel::kPopcnt, HammingKernel::kAvx2,
+    HammingKernel::kAvx512Vpopcntdq, HammingKernel::kNeon};
+
+unsigned int bitwiseHammingDistance(
+    const unsigned char* a, const unsigned char* b, size_t num_bytes) {
+  unsigned int distance = 0u;
+  for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+    for (int bit_idx = 0; bit_idx < 8; ++bit_idx) {
+      distance += ((a[byte_idx] ^ b[byte_idx]) >> bit_idx) & 1u;
+    }
+  }
+  return distance;
+}
+
+std::vector<unsigned char> randomBytes(size_t num_bytes, std::mt19937* rng) {
+  std::uniform_int_distribution<int> distribution(0, 255);
+  std::vector<unsigned char> bytes(num_bytes);
+  for (unsigned char& byte : bytes) {
+    byte = static_cast<unsigned char>(distribution(*rng));
+  }
+  return bytes;
+}
+}  // namespace
+
+TEST(VocabularyTree, HammingKernelsMatchBitwiseDistance) {
+  std::mt19937 rng(42);
+  constexpr size_t kNumDescriptors = 37u;
+  // Descriptor lengths of BRISK, FREAK and ORB plus some that don't fill
+  // whole registers.
+  for (const size_t num_bytes : {16u, 32u, 48u, 64u, 1u, 7u, 33u, 80u, 130u}) {
+    const std::vector<unsigned char> query = randomBytes(num_bytes, &rng);
+    const std::vector<unsigned char> descriptors =
+        randomBytes(num_bytes * kNumDescriptors, &rng);
+    std::vector<unsigned int> expected_distances(kNumDescriptors);
+    for (size_t idx = 0u; idx < kNumDescriptors; ++idx) {
+      expected_distances[idx] = bitwiseHammingDistance(
+          query.data(), descriptors.data() + idx * num_bytes, num_bytes);
+    }
+
+    for (const HammingKernel kernel : kAllKernels) {
+      if (!isHammingKernelSupported(kernel)) {
+        continue;
+      }
+      std::vector<unsigned int> distances(kNumDescriptors);
+      HammingDistancesToQuery(
+          kernel, query.data(), descriptors.data(), num_bytes,
+          kNumDescriptors, distances.data());
+      EXPECT_EQ(distances, expected_distances)
+          << getHammingKernelName(kernel) << ", " << num_bytes << " bytes";
+    }
+
+    std::vector<unsigned int> distances(kNumDescriptors);
+    HammingDistancesToQuery(
+        query.data(), descriptors.data(), num_bytes, kNumDescriptors,
+        distances.data());
+    EXPECT_EQ(distances, expected_distances);
+    if (num_bytes == 16u || num_bytes == 32u || num_bytes == 64u) {
+      EXPECT_EQ(
+          HammingDistance(query.data(), descriptors.data(), 8u * num_bytes),
+          expected_distances[0]);
+    }
+  }
+}
+
+// Matches a query against as many 48 byte BRISK descriptors as a typical
+// loop closure candidate set has.
+TEST(VocabularyTree, HammingKernelsBenchmark) {
+  constexpr size_t kNumBytes = 48u;
+  constexpr size_t kNumDescriptors = 100000u;
+  constexpr size_t kNumQueries = 50u;
+  std::mt19937 rng(42);
+  const std::vector<unsigned char> queries =
+      randomBytes(kNumBytes * kNumQueries, &rng);
+  const std::vector<unsigned char> descriptors =
+      randomBytes(kNumBytes * kNumDescriptors, &rng);
+  std::vector<unsigned int> distances(kNumDescriptors);
+
+  LOG(INFO) << "Widest supported kernel: "
+            << getHammingKernelName(getWidestSupportedHammingKernel());
+  for (const HammingKernel kernel : kAllKernels) {
+    if (!isHammingKernelSupported(kernel)) {
+      continue;
+    }
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    size_t checksum = 0u;
+    for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+      HammingDistancesToQuery(
+          kernel, queries.data() + query_idx * kNumBytes, descriptors.data(),
+          kNumBytes, kNumDescriptors, distances.data());
+      checksum += distances[query_idx];
+    }
+    const Clock::time_point end = Clock::now();
+    LOG(INFO) << getHammingKernelName(kernel) << ": "
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms for " << kNumQueries << " x " << kNumDescriptors
+              << " distances (checksum " << checksum << ").";
+  }
+
+  // Reference: the per-pair functions.
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point start = Clock::now();
+  size_t checksum = 0u;
+  for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+    const unsigned char* query = queries.data() + query_idx * kNumBytes;
+    for (size_t idx = 0u; idx < kNumDescriptors; ++idx) {
+      const unsigned char* descriptor = descriptors.data() + idx * kNumBytes;
+      distances[idx] = HammingDistance256(query, descriptor) +
+                       HammingDistance128(query + 32, descriptor + 32);
+    }
+    checksum += distances[query_idx];
+  }
+  const Clock::time_point end = Clock::now();
+  LOG(INFO) << "HammingDistance256 + HammingDistance128: "
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << " ms (checksum " << checksum << ").";
+}
+
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
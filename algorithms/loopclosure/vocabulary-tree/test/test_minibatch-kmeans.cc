@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vocabulary-tree/distance.h>
+#include <vocabulary-tree/simple-kmeans.h>
+#include <vocabulary-tree/types.h>
+
+#include "./floating-point-test-helpers.h"
+
+typedef loop_closure::SimpleKmeans<DescriptorType,
+                                   loop_closure::distance::L2<DescriptorType> >
+    Kmeans;
+
+TEST(VocabularyTree, SimpleKMeans_MiniBatchKMeansCluster) {
+  std::mt19937 generator(40);
+  static const size_t kNumfeaturesPerCluster = 100;
+  static const size_t kNumClusters = 50;
+  DescriptorVector gt_centers;
+  DescriptorVector descriptors;
+  std::vector<unsigned int> membership;
+  std::vector<unsigned int> gt_membership;
+
+  GenerateTestData(
+      kNumfeaturesPerCluster, kNumClusters, generator(), &gt_centers,
+      &descriptors, &membership, &gt_membership);
+
+  // Init with ground-truth, the mini-batch updates must not move the centers
+  // away from their clusters.
+  std::shared_ptr<DescriptorVector> centers =
+      aligned_shared<DescriptorVector>(gt_centers);
+
+  DescriptorType descriptor_zero;
+  descriptor_zero.setConstant(
+      kDescriptorDimensionality, 1, static_cast<Scalar>(0));
+
+  Kmeans kmeans(descriptor_zero);
+  kmeans.SetInitMethod(
+      loop_closure::InitGiven<DescriptorType>(descriptor_zero));
+  kmeans.SetMiniBatchSize(500u);
+  kmeans.SetMaxIterations(50u);
+
+  kmeans.Cluster(descriptors, kNumClusters, generator(), &membership, &centers);
+
+  ASSERT_EQ(centers->size(), kNumClusters);
+  ASSERT_EQ(membership.size(), gt_membership.size());
+  for (size_t i = 0; i < membership.size(); ++i) {
+    EXPECT_EQ(membership[i], gt_membership[i]);
+  }
+  for (size_t i = 0; i < kNumClusters; ++i) {
+    EXPECT_LT(((*centers)[i] - gt_centers[i]).norm(), 0.5f);
+  }
+}
+
+TEST(VocabularyTree, SimpleKMeans_ParallelRestartsMatchSerialRestarts) {
+  std::mt19937 generator(40);
+  static const size_t kNumfeaturesPerCluster = 100;
+  static const size_t kNumClusters = 20;
+  DescriptorVector gt_centers;
+  DescriptorVector descriptors;
+  std::vector<unsigned int> membership;
+  std::vector<unsigned int> gt_membership;
+
+  GenerateTestData(
+      kNumfeaturesPerCluster, kNumClusters, generator(), &gt_centers,
+      &descriptors, &membership, &gt_membership);
+
+  DescriptorType descriptor_zero;
+  descriptor_zero.setConstant(
+      kDescriptorDimensionality, 1, static_cast<Scalar>(0));
+
+  const int random_seed = generator();
+  Kmeans kmeans(descriptor_zero);
+  kmeans.SetRestarts(4u);
+  kmeans.SetSeedingSampleSize(500u);
+
+  std::shared_ptr<DescriptorVector> serial_centers =
+      aligned_shared<DescriptorVector>();
+  std::vector<unsigned int> serial_membership;
+  const Kmeans::SquaredDistanceType serial_sse = kmeans.Cluster(
+      descriptors, kNumClusters, random_seed, &serial_membership,
+      &serial_centers);
+
+  kmeans.SetParallelRestarts(true);
+  std::shared_ptr<DescriptorVector> parallel_centers =
+      aligned_shared<DescriptorVector>();
+  std::vector<unsigned int> parallel_membership;
+  const Kmeans::SquaredDistanceType parallel_sse = kmeans.Cluster(
+      descriptors, kNumClusters, random_seed, &parallel_membership,
+      &parallel_centers);
+
+  EXPECT_EQ(parallel_sse, serial_sse);
+  EXPECT_EQ(parallel_membership, serial_membership);
+  ASSERT_EQ(parallel_centers->size(), serial_centers->size());
+  for (size_t i = 0; i < serial_centers->size(); ++i) {
+    EXPECT_EQ((*parallel_centers)[i], (*serial_centers)[i]);
+  }
+}
+
+MAPLAB_UNITTEST_ENTRYPOINT
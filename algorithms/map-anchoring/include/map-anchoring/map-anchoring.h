@@ -39,6 +39,10 @@ bool anchorMissionUsingProvidedLoopDetector(
     const vi_map::MissionId& mission_id,
     const loop_detector_node::LoopDetectorNode& loop_detector,
     vi_map::VIMap* map);
+// Sets and marks T_G_M of the mission as known if the probe was successful.
+bool commitProbeResult(
+    const vi_map::MissionId& mission_id, const ProbeResult& probe_result,
+    vi_map::VIMap* map);
 
 void probeMissionAnchoring(
     const vi_map::MissionId& mission_id,
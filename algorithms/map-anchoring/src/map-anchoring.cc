@@ -1,6 +1,14 @@
 #include "map-anchoring/map-anchoring.h"
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <aslam/common/memory.h>
+#include <loop-closure-handler/loop-detector-cache.h>
 #include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 
@@ -9,6 +17,19 @@ DEFINE_bool(
     "Add missions that got anchored to the loop detector database too.");
 
 namespace map_anchoring {
+namespace {
+void getMissionsWithKnownBaseFrame(
+    const vi_map::VIMap& map, vi_map::MissionIdSet* mission_ids) {
+  CHECK_NOTNULL(mission_ids)->clear();
+  vi_map::MissionIdList all_mission_ids;
+  map.getAllMissionIds(&all_mission_ids);
+  for (const vi_map::MissionId& mission_id : all_mission_ids) {
+    if (map.getMissionBaseFrameForMission(mission_id).is_T_G_M_known()) {
+      mission_ids->emplace(mission_id);
+    }
+  }
+}
+}  // namespace
 
 void setMissionBaseframeKnownState(
     const vi_map::MissionId& mission_id, const bool baseframe_known_state,
@@ -34,10 +55,21 @@ bool anchorMission(const vi_map::MissionId& mission_id, vi_map::VIMap* map) {
     return false;
   }
 
-  loop_detector_node::LoopDetectorNode loop_detector;
-  addAllMissionsWithKnownBaseFrameToProvidedLoopDetector(*map, &loop_detector);
+  vi_map::MissionIdSet known_mission_ids;
+  getMissionsWithKnownBaseFrame(*map, &known_mission_ids);
+  if (known_mission_ids.empty()) {
+    LOG(ERROR) << "At least one mission should have a known T_G_M baseframe "
+               << "transformation.";
+    return false;
+  }
+  // The database is shared with other commands on the same missions.
+  const loop_detector_node::LoopDetectorNode::ConstPtr loop_detector =
+      loop_detector_node::LoopDetectorCache::getInstance().getDatabase(
+          known_mission_ids, *map);
+  VLOG(1) << loop_detector->printStatus();
 
-  return anchorMissionUsingProvidedLoopDetector(mission_id, loop_detector, map);
+  return anchorMissionUsingProvidedLoopDetector(
+      mission_id, *loop_detector, map);
 }
 
 bool anchorAllMissions(vi_map::VIMap* map) {
@@ -49,7 +81,7 @@ bool anchorAllMissions(
     vi_map::VIMap* map, const visualization::ViwlsGraphRvizPlotter* plotter) {
   CHECK_NOTNULL(map);
   // Build a list of all unknown baseframes.
-  std::queue<vi_map::MissionId> missions_with_unknown_baseframe;
+  vi_map::MissionIdList missions_with_unknown_baseframe;
   vi_map::MissionIdList all_missions;
   map->getAllMissionIds(&all_missions);
   for (const vi_map::MissionId& mission_id : all_missions) {
@@ -57,7 +89,7 @@ bool anchorAllMissions(
     const vi_map::MissionBaseFrame& base_frame =
         map->getMissionBaseFrame(mission.getBaseFrameId());
     if (!base_frame.is_T_G_M_known()) {
-      missions_with_unknown_baseframe.push(mission_id);
+      missions_with_unknown_baseframe.push_back(mission_id);
     }
   }
 
@@ -72,33 +104,41 @@ bool anchorAllMissions(
   }
 
   // A loop-detector to which we add all the missions we have already anchored.
-  // This allows us to avoid building the index over and over as we anchor new
-  // missions.
-  loop_detector_node::LoopDetectorNode loop_detector;
+  // It comes from the process-wide cache, which extends the database by the
+  // newly anchored missions instead of building it over and over.
+  loop_detector_node::LoopDetectorNode::ConstPtr loop_detector;
+  vi_map::MissionIdSet database_mission_ids;
 
   // Add the known missions to the database.
   bool initial_mission_added = false;
 
-  // How often do we try to anchor. Prevent locking forever.
+  // The missions are anchored in rounds. In every round all remaining
+  // missions are probed in parallel against the database, which isn't
+  // modified during the round, and the successful probes are committed
+  // afterwards. How many rounds in a row without any newly anchored mission
+  // we try before giving up. Prevent locking forever.
   constexpr int kTrialsPerMission = 2;
-  int remaining_trials_for_mission = kTrialsPerMission;
-  while (!missions_with_unknown_baseframe.empty()) {
+  int remaining_trials = kTrialsPerMission;
+  while (!missions_with_unknown_baseframe.empty() && remaining_trials > 0) {
     if (FLAGS_add_anchored_missions_to_database || !initial_mission_added) {
       VLOG(1) << "Adding known missions to loop-detector.";
-      // Add all missions that have a known base-frame (if any).
-      addAllMissionsWithKnownBaseFrameToProvidedLoopDetector(
-          *map, &loop_detector);
+      // Add all missions that have a known base-frame. Missions which are
+      // already in the database are skipped.
+      getMissionsWithKnownBaseFrame(*map, &database_mission_ids);
+      // Release the database first, such that the cache can extend it.
+      loop_detector.reset();
+      loop_detector =
+          loop_detector_node::LoopDetectorCache::getInstance().getDatabase(
+              database_mission_ids, *map);
+      VLOG(1) << loop_detector->printStatus();
       initial_mission_added = true;
     }
 
-    vi_map::MissionId mission_id = missions_with_unknown_baseframe.front();
-    missions_with_unknown_baseframe.pop();
-
-    // Assemble the current working set.
-    vi_map::MissionIdSet selected_missions;
-    selected_missions.insert(mission_id);
-    vi_map::MissionIdList all_missions;
-    map->getAllMissionIds(&all_missions);
+    // Assemble the current working set. The mission selection is stored in
+    // the map, so it contains all missions that are probed in this round.
+    vi_map::MissionIdSet selected_missions(
+        missions_with_unknown_baseframe.begin(),
+        missions_with_unknown_baseframe.end());
     for (const vi_map::MissionId& mission_id : all_missions) {
       const vi_map::MissionBaseFrame& base_frame =
           map->getMissionBaseFrameForMission(mission_id);
@@ -108,35 +148,57 @@ bool anchorAllMissions(
     }
     map->selectMissions(selected_missions);
 
-    VLOG(1) << "Trying to anchor mission " << mission_id << ".";
-    bool success =
-        anchorMissionUsingProvidedLoopDetector(mission_id, loop_detector, map);
-
-    if (!success) {
-      LOG(WARNING) << "Failed to anchor mission " << mission_id
-                   << ", pushing it back to the work-list.";
-      --remaining_trials_for_mission;
-      if (remaining_trials_for_mission > 0) {
-        missions_with_unknown_baseframe.push(mission_id);
-        continue;
+    // The probes neither merge landmarks nor add loop-closure edges, so they
+    // only read from the map and the loop-detector.
+    const size_t num_candidates = missions_with_unknown_baseframe.size();
+    Aligned<std::vector, ProbeResult> probe_results(num_candidates);
+    std::function<void(const std::vector<size_t>&)> probe_helper =
+        [&](const std::vector<size_t>& range) {
+          for (const size_t candidate_idx : range) {
+            const vi_map::MissionId& mission_id =
+                missions_with_unknown_baseframe[candidate_idx];
+            VLOG(1) << "Trying to anchor mission " << mission_id << ".";
+            probeMissionAnchoring(
+                mission_id, *loop_detector, map,
+                &probe_results[candidate_idx]);
+          }
+        };
+    constexpr bool kAlwaysParallelize = false;
+    const size_t num_threads =
+        std::min<size_t>(num_candidates, common::getNumHardwareThreads());
+    common::ParallelProcess(
+        num_candidates, probe_helper, kAlwaysParallelize, num_threads);
+
+    // Commit the anchors in the order of the missions so the result doesn't
+    // depend on the scheduling of the probes.
+    vi_map::MissionIdList missions_still_unknown;
+    for (size_t candidate_idx = 0u; candidate_idx < num_candidates;
+         ++candidate_idx) {
+      const vi_map::MissionId& mission_id =
+          missions_with_unknown_baseframe[candidate_idx];
+      if (!commitProbeResult(mission_id, probe_results[candidate_idx], map)) {
+        LOG(WARNING) << "Failed to anchor mission " << mission_id
+                     << ", pushing it back to the work-list.";
+        missions_still_unknown.push_back(mission_id);
       }
-
-      // Continuing to next mission, reset number of remaining trials.
-      remaining_trials_for_mission = kTrialsPerMission;
-      continue;
     }
 
-    if (plotter != nullptr) {
-      plotter->visualizeMap(*map);
+    if (missions_still_unknown.size() < num_candidates) {
+      remaining_trials = kTrialsPerMission;
+      if (plotter != nullptr) {
+        plotter->visualizeMap(*map);
+      }
+    } else {
+      --remaining_trials;
     }
+    missions_with_unknown_baseframe.swap(missions_still_unknown);
   }
 
   if (!missions_with_unknown_baseframe.empty()) {
     LOG(ERROR) << "Could not anchor all missions. Still have the following "
                << "unanchored:";
-    while (!missions_with_unknown_baseframe.empty()) {
-      vi_map::MissionId mission_id = missions_with_unknown_baseframe.front();
-      missions_with_unknown_baseframe.pop();
+    for (const vi_map::MissionId& mission_id :
+         missions_with_unknown_baseframe) {
       LOG(ERROR) << "\t" << mission_id;
     }
     map->resetMissionSelection();
@@ -192,6 +254,14 @@ bool anchorMissionUsingProvidedLoopDetector(
   // Probe.
   ProbeResult probe_result;
   probeMissionAnchoring(mission_id, loop_detector, map, &probe_result);
+  return commitProbeResult(mission_id, probe_result, map);
+}
+
+bool commitProbeResult(
+    const vi_map::MissionId& mission_id, const ProbeResult& probe_result,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK(map->hasMission(mission_id));
 
   if (probe_result.wasSuccessful()) {
     CHECK(!probe_result.matching_missions.empty());
@@ -157,6 +157,15 @@ class GraphBaOptimizer {
       std::shared_ptr<ceres::LossFunction> loss_function, aslam::Camera* camera,
       unsigned int* external_landmarks_added, vi_map::Vertex* ba_vertex);
 
+  // Adds the residual of a keypoint that already passed all checks of
+  // addVisualResidualBlockOfKeypoint.
+  void addVisualResidualBlockOfUsableKeypoint(
+      const Eigen::Matrix<double, 2, 1>& image_point_distorted,
+      double image_point_uncertainty, const vi_map::LandmarkId& landmark_id,
+      bool fix_landmark_positions,
+      std::shared_ptr<ceres::LossFunction> loss_function, aslam::Camera* camera,
+      unsigned int* external_landmarks_added, vi_map::Vertex* ba_vertex);
+
   void addVisualResidualBlocks(
       bool fix_intrinsics, bool fix_extrinsics_rotation,
       bool fix_extrinsics_translation, bool fix_landmark_positions,
@@ -203,6 +212,11 @@ class GraphBaOptimizer {
       const ceres::Solver::Options& solver_options, ceres::Problem* problem,
       ceres::Solver::Summary* summary);
 
+  // For SPARSE_SCHUR and ITERATIVE_SCHUR, eliminates the landmarks first,
+  // then the vertex states, then everything else.
+  void setLinearSolverOrdering(
+      const ceres::Problem& problem, ceres::Solver::Options* options) const;
+
   void addIterationCallback(std::function<void(const vi_map::VIMap&)> callback);
 
   void setCameraParameterizationIfPartOfTheProblem(
@@ -226,9 +240,6 @@ class GraphBaOptimizer {
 
   void markLandmarkAsBad(const vi_map::LandmarkId& landmark_id);
 
-  unsigned int getNumOfWellConstrainedLandmarksInFrame(
-      const vi_map::Vertex& ba_vertex, unsigned int frame_idx);
-
   double* get_p_C_I_Mutable(const aslam::CameraId& camera_id);
   double* get_q_C_I_JPL_Mutable(const aslam::CameraId& camera_id);
 
@@ -270,6 +281,7 @@ class GraphBaOptimizer {
   std::shared_ptr<ceres::LocalParameterization> yaw_only_pose_parameterization_;
   std::vector<std::shared_ptr<ceres::IterationCallback> > solver_callbacks_;
   CeresSignalHandlerPtr signal_handler_callback_ptr_;
+  std::shared_ptr<ceres::IterationCallback> iteration_timing_callback_;
   std::shared_ptr<ceres::Problem> ceres_problem_;
 
   typedef ceres::CauchyLoss DefaultLossFunction;
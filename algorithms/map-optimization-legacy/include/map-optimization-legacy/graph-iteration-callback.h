@@ -208,6 +208,24 @@ class GraphIterationCallback : public ceres::IterationCallback {
   BaIterationOptions options_;
 };
 
+// Logs the cost and the timing of every iteration.
+class IterationTimingCallback : public ceres::IterationCallback {
+ public:
+  virtual ~IterationTimingCallback() {}
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary) {
+    LOG(INFO) << "Iteration " << summary.iteration << ": cost "
+              << summary.cost << ", cost change " << summary.cost_change
+              << (summary.step_is_successful ? ", accepted" : ", rejected")
+              << ", " << summary.linear_solver_iterations
+              << " linear solver iterations in "
+              << summary.step_solver_time_in_seconds << "s, iteration took "
+              << summary.iteration_time_in_seconds << "s, "
+              << summary.cumulative_time_in_seconds << "s in total.";
+    return ceres::SOLVER_CONTINUE;
+  }
+};
+
 }  // namespace map_optimization_legacy
 
 #endif  // MAP_OPTIMIZATION_LEGACY_GRAPH_ITERATION_CALLBACK_H_
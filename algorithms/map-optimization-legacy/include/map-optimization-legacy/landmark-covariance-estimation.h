@@ -10,14 +10,29 @@ class LandmarkCovarianceEstimation : public GraphBaOptimizer {
   explicit LandmarkCovarianceEstimation(vi_map::VIMap* map);
   virtual ~LandmarkCovarianceEstimation();
 
+  // Recovers the covariances with ceres::Covariance on the full problem, or
+  // with assignLocalCovarianceToLandmarks if
+  // --cov_estimation_local_schur_complement is set.
   void assignCovarianceToLandmarks(
       const pose_graph::VertexIdSet& fixed_vertices);
 
+  // Scalable alternative to the full covariance recovery. Every landmark gets
+  // the inverse of its local information matrix, i.e. the Schur complement of
+  // its observer poses. The poses are treated as fixed, or, if the pose
+  // standard deviation flags are set, as uncertain with independent marginals
+  // of that size. fixed_vertices are always fixed. Only the visual residuals
+  // are built, the landmarks are processed in parallel and each covariance is
+  // stored in the map as soon as it is computed.
+  void assignLocalCovarianceToLandmarks(
+      const pose_graph::VertexIdSet& fixed_vertices);
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
+  void addVisualErrorTerms();
   void addErrorTerms(const pose_graph::VertexIdSet& fixed_vertices);
   void calculateCovariance(ceres::Problem* problem);
+  void calculateLocalCovariance(const pose_graph::VertexIdSet& fixed_vertices);
 };
 
 }  // namespace map_optimization_legacy
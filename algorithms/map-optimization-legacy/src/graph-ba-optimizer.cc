@@ -1,6 +1,10 @@
 #include "map-optimization-legacy/graph-ba-optimizer.h"
 
 #include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <ceres/loss_function.h>
 #include <gflags/gflags.h>
@@ -21,12 +25,14 @@
 #include <ceres-error-terms/parameterization/quaternion-param-jpl.h>
 #include <ceres-error-terms/pose-prior-error-term.h>
 #include <ceres-error-terms/position-error-term.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-analytic.h>
 #include <ceres-error-terms/six-dof-block-pose-error-term-autodiff.h>
 #include <ceres-error-terms/six-dof-block-pose-error-term-with-extrinsics-autodiff.h>
 #include <ceres-error-terms/switch-prior-error-term.h>
 #include <ceres-error-terms/visual-error-term-factory.h>
 #include <ceres-error-terms/visual-error-term.h>
 #include <maplab-common/gravity-provider.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/progress-bar.h>
 #include <maplab-common/quaternion-math.h>
@@ -57,8 +63,95 @@ DEFINE_bool(
     dwo_only_optimize_selected_mission, false,
     "Fixes all vertices that are not in the mission selected for DW "
     "optimization.");
+DEFINE_string(
+    optimizer_linear_solver_type, "SPARSE_NORMAL_CHOLESKY",
+    "Ceres linear solver type, e.g. SPARSE_NORMAL_CHOLESKY, SPARSE_SCHUR or "
+    "ITERATIVE_SCHUR. The Schur-type solvers eliminate the landmarks first.");
+DEFINE_bool(
+    optimizer_use_analytic_relative_pose_terms, true,
+    "Use the relative pose error terms of transformation edges with analytic "
+    "Jacobians instead of automatic differentiation.");
+DEFINE_bool(
+    optimizer_log_iteration_timing, true,
+    "Log the cost and timing of every iteration and a breakdown of the solver "
+    "time at the end.");
 
 namespace map_optimization_legacy {
+namespace {
+
+constexpr bool kAlwaysParallelize = false;
+
+// Checks of addVisualResidualBlockOfKeypoint, evaluated once per landmark.
+struct LandmarkChecks {
+  LandmarkChecks() : is_well_constrained(false), is_usable(false) {}
+  bool is_well_constrained;
+  // Well constrained and observed by enough missions.
+  bool is_usable;
+};
+typedef std::unordered_map<vi_map::LandmarkId, LandmarkChecks>
+    LandmarkChecksTable;
+
+// The keypoints of a frame that get a visual residual. Frames which pass the
+// minimum number of well constrained landmarks are listed even if none of
+// their keypoints is usable, as their camera is still part of the problem.
+struct FrameVisualResiduals {
+  explicit FrameVisualResiduals(const unsigned int _frame_idx)
+      : frame_idx(_frame_idx) {}
+  unsigned int frame_idx;
+  std::vector<int> keypoint_indices;
+};
+typedef std::vector<FrameVisualResiduals> VertexVisualResiduals;
+
+void collectVisualResidualsOfVertex(
+    const vi_map::Vertex& vertex, const LandmarkChecksTable& landmark_checks,
+    const unsigned int min_landmarks_per_frame,
+    VertexVisualResiduals* vertex_residuals) {
+  CHECK_NOTNULL(vertex_residuals)->clear();
+  const unsigned int num_frames = vertex.numFrames();
+  for (unsigned int frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
+    if (!vertex.isVisualFrameSet(frame_idx) ||
+        !vertex.isVisualFrameValid(frame_idx)) {
+      continue;
+    }
+    const int num_keypoints =
+        vertex.getVisualFrame(frame_idx).getKeypointMeasurements().cols();
+
+    std::vector<const LandmarkChecks*> keypoint_checks(num_keypoints, nullptr);
+    unsigned int well_constrained_landmarks = 0;
+    for (int i = 0; i < num_keypoints; ++i) {
+      const vi_map::LandmarkId landmark_id =
+          vertex.getObservedLandmarkId(frame_idx, i);
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      const LandmarkChecksTable::const_iterator it =
+          landmark_checks.find(landmark_id);
+      CHECK(it != landmark_checks.end());
+      keypoint_checks[i] = &it->second;
+      if (it->second.is_well_constrained) {
+        ++well_constrained_landmarks;
+      }
+    }
+    if (well_constrained_landmarks < min_landmarks_per_frame) {
+      VLOG(3) << " Skipping this visual keyframe. Only "
+              << well_constrained_landmarks
+              << " well constrained landmarks, but " << min_landmarks_per_frame
+              << " required";
+      continue;
+    }
+
+    vertex_residuals->emplace_back(frame_idx);
+    std::vector<int>& keypoint_indices =
+        vertex_residuals->back().keypoint_indices;
+    for (int i = 0; i < num_keypoints; ++i) {
+      if (keypoint_checks[i] != nullptr && keypoint_checks[i]->is_usable) {
+        keypoint_indices.push_back(i);
+      }
+    }
+  }
+}
+
+}  // namespace
 
 GraphBaOptimizer::GraphBaOptimizer(vi_map::VIMap* map)
     : map_(*CHECK_NOTNULL(map)),
@@ -66,7 +159,8 @@ GraphBaOptimizer::GraphBaOptimizer(vi_map::VIMap* map)
       quaternion_parameterization_(nullptr),
       pose_parameterization_(nullptr),
       yaw_only_pose_parameterization_(nullptr),
-      signal_handler_callback_ptr_(nullptr) {
+      signal_handler_callback_ptr_(nullptr),
+      iteration_timing_callback_(new IterationTimingCallback) {
   // Set unit rotation and zero translation to dummy pose objects.
   dummy_7d_0_ << 0, 0, 0, 1, 0, 0, 0;
   dummy_7d_1_ << 0, 0, 0, 1, 0, 0, 0;
@@ -95,7 +189,13 @@ ceres::Solver::Options GraphBaOptimizer::getDefaultSolverOptions() const {
   options.initial_trust_region_radius = 1e5;
   options.max_trust_region_radius = 1e20;
   options.trust_region_strategy_type = ceres::LEVENBERG_MARQUARDT;
-  options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+  CHECK(ceres::StringToLinearSolverType(
+      FLAGS_optimizer_linear_solver_type, &options.linear_solver_type))
+      << "Unknown linear solver type: " << FLAGS_optimizer_linear_solver_type;
+  if (options.linear_solver_type == ceres::ITERATIVE_SCHUR) {
+    options.preconditioner_type = ceres::SCHUR_JACOBI;
+    options.use_explicit_schur_complement = true;
+  }
   options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
   for (std::shared_ptr<ceres::IterationCallback> callback : solver_callbacks_) {
     options.callbacks.push_back(callback.get());
@@ -103,6 +203,11 @@ ceres::Solver::Options GraphBaOptimizer::getDefaultSolverOptions() const {
   if (!solver_callbacks_.empty()) {
     options.update_state_every_iteration = true;
   }
+  // Does not need the state, so it does not require updating it every
+  // iteration.
+  if (FLAGS_optimizer_log_iteration_timing) {
+    options.callbacks.push_back(iteration_timing_callback_.get());
+  }
 
   // Add the ceres signal handler to be able to terminate the optimization
   // with CTRL+C.
@@ -1606,17 +1711,27 @@ void GraphBaOptimizer::addRelativePoseResidualBlocks(
     if (sensor_id.isValid()) {
       // Figure out which optional sensor extrinsics belongs to the current
       // transformation edge.
-      std::shared_ptr<ceres::CostFunction> relative_pose_cost(
-          new ceres::AutoDiffCostFunction<
-              ceres_error_terms::SixDoFBlockPoseErrorTermWithExtrinsics,
-              ceres_error_terms::SixDoFBlockPoseErrorTermWithExtrinsics::
-                  kResidualBlockSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kOrientationBlockSize,
-              ceres_error_terms::poseblocks::kPositionBlockSize>(
-              new ceres_error_terms::SixDoFBlockPoseErrorTermWithExtrinsics(
-                  T_A_B, T_A_B_covariance)));
+      std::shared_ptr<ceres::CostFunction> relative_pose_cost;
+      if (FLAGS_optimizer_use_analytic_relative_pose_terms) {
+        relative_pose_cost = problem_information_.createCostFunction<
+            ceres_error_terms::SixDoFBlockPoseErrorTermWithExtrinsicsAnalytic>(
+            T_A_B, T_A_B_covariance);
+      } else {
+        relative_pose_cost.reset(new ceres::AutoDiffCostFunction<
+                                 ceres_error_terms::
+                                     SixDoFBlockPoseErrorTermWithExtrinsics,
+                                 ceres_error_terms::
+                                     SixDoFBlockPoseErrorTermWithExtrinsics::
+                                         kResidualBlockSize,
+                                 ceres_error_terms::poseblocks::kPoseSize,
+                                 ceres_error_terms::poseblocks::kPoseSize,
+                                 ceres_error_terms::poseblocks::
+                                     kOrientationBlockSize,
+                                 ceres_error_terms::poseblocks::
+                                     kPositionBlockSize>(
+            new ceres_error_terms::SixDoFBlockPoseErrorTermWithExtrinsics(
+                T_A_B, T_A_B_covariance)));
+      }
 
       SensorExtrinsicsIdxMap::const_iterator
           sensor_extrinsics_col_index_iterator =
@@ -1654,14 +1769,21 @@ void GraphBaOptimizer::addRelativePoseResidualBlocks(
       }
       ++num_residual_blocks_added_with_extrinsics;
     } else {
-      std::shared_ptr<ceres::CostFunction> relative_pose_cost(
-          new ceres::AutoDiffCostFunction<
-              ceres_error_terms::SixDoFBlockPoseErrorTerm,
-              ceres_error_terms::SixDoFBlockPoseErrorTerm::residualBlockSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize>(
-              new ceres_error_terms::SixDoFBlockPoseErrorTerm(
-                  T_A_B, T_A_B_covariance)));
+      std::shared_ptr<ceres::CostFunction> relative_pose_cost;
+      if (FLAGS_optimizer_use_analytic_relative_pose_terms) {
+        relative_pose_cost = problem_information_.createCostFunction<
+            ceres_error_terms::SixDoFBlockPoseErrorTermAnalytic>(
+            T_A_B, T_A_B_covariance);
+      } else {
+        relative_pose_cost.reset(new ceres::AutoDiffCostFunction<
+                                 ceres_error_terms::SixDoFBlockPoseErrorTerm,
+                                 ceres_error_terms::SixDoFBlockPoseErrorTerm::
+                                     residualBlockSize,
+                                 ceres_error_terms::poseblocks::kPoseSize,
+                                 ceres_error_terms::poseblocks::kPoseSize>(
+            new ceres_error_terms::SixDoFBlockPoseErrorTerm(
+                T_A_B, T_A_B_covariance)));
+      }
       problem_information_.addResidualBlock(
           residual_type, relative_pose_cost, nullptr,
           {vertex_poses_.col(it_from->second).data(),
@@ -1731,6 +1853,7 @@ void GraphBaOptimizer::removeLandmarksBehindCamera() {
 void GraphBaOptimizer::markLandmarkAsBad(
     const vi_map::LandmarkId& landmark_id) {
   map_.getLandmark(landmark_id).setQuality(vi_map::Landmark::Quality::kBad);
+  map_.markLandmarksChanged();
 }
 
 bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
@@ -1753,6 +1876,39 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
     return false;
   }
 
+  if (min_num_observer_missions > 0u) {
+    vi_map::MissionIdSet observer_missions;
+    map_.getLandmarkObserverMissions(landmark_id, &observer_missions);
+    if (observer_missions.size() < min_num_observer_missions) {
+      return false;
+    }
+  }
+
+  // Skip if the current landmark has not enough observers.
+  if (!vi_map::isLandmarkWellConstrained(
+          const_map_, const_map_.getLandmark(landmark_id))) {
+    return false;
+  }
+
+  addVisualResidualBlockOfUsableKeypoint(
+      image_point_distorted, image_point_uncertainty, landmark_id,
+      fix_landmark_positions, loss_function, camera_ptr,
+      external_landmarks_added, ba_vertex);
+  return true;
+}
+
+void GraphBaOptimizer::addVisualResidualBlockOfUsableKeypoint(
+    const Eigen::Matrix<double, 2, 1>& image_point_distorted,
+    double image_point_uncertainty, const vi_map::LandmarkId& landmark_id,
+    bool fix_landmark_positions,
+    std::shared_ptr<ceres::LossFunction> loss_function,
+    aslam::Camera* camera_ptr, unsigned int* external_landmarks_added,
+    vi_map::Vertex* ba_vertex) {
+  CHECK_NOTNULL(ba_vertex);
+  CHECK_NOTNULL(camera_ptr);
+  CHECK_NOTNULL(external_landmarks_added);
+  CHECK(landmark_id.isValid());
+
   // loss_function may explicitly be nullptr
   vi_map::VIMission& mission = map_.getMission(ba_vertex->getMissionId());
 
@@ -1765,7 +1921,6 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
   CHECK_GE(vertex_it->second, 0);
   CHECK_LT(vertex_it->second, vertex_poses_.cols());
 
-  BaOptimizationOptions ba_options;
   std::shared_ptr<ceres::LocalParameterization>
       baseframe_pose_parameterization = pose_parameterization_;
   if (FLAGS_optimizer_yaw_only_baseframe_parametrization) {
@@ -1776,23 +1931,10 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
     baseframe_pose_parameterization = yaw_only_pose_parameterization_;
   }
 
-  if (min_num_observer_missions > 0u) {
-    vi_map::MissionIdSet observer_missions;
-    map_.getLandmarkObserverMissions(landmark_id, &observer_missions);
-    if (observer_missions.size() < min_num_observer_missions) {
-      return false;
-    }
-  }
-
   vi_map::Vertex& landmark_base_vertex =
       map_.getLandmarkStoreVertex(landmark_id);
   vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
 
-  // Skip if the current landmark has not enough observers.
-  if (!vi_map::isLandmarkWellConstrained(const_map_, landmark)) {
-    return false;
-  }
-
   VertexIdPoseIdxMap::const_iterator landmark_base_vertex_it;
   landmark_base_vertex_it =
       vertex_id_to_pose_idx_.find(landmark_base_vertex.id());
@@ -1810,7 +1952,7 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
               ceres_error_terms::VisualReprojectionError>(
               image_point_distorted, image_point_uncertainty,
               ceres_error_terms::visual::VisualErrorType::kLocalMission,
-              camera_ptr));
+              camera_ptr, problem_information_.residual_block_arena));
       if (camera_ptr->getDistortion().getType() !=
           aslam::Distortion::Type::kNoDistortion) {
         problem_information_.addResidualBlock(
@@ -1843,7 +1985,8 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
           ceres_error_terms::createVisualCostFunction<
               ceres_error_terms::VisualReprojectionError>(
               image_point_distorted, image_point_uncertainty,
-              ceres_error_terms::visual::VisualErrorType::kGlobal, camera_ptr));
+              ceres_error_terms::visual::VisualErrorType::kGlobal, camera_ptr,
+              problem_information_.residual_block_arena));
 
       // Retrieve mission for the landmark vertex.
       vi_map::VIMission& landmark_mission =
@@ -1906,7 +2049,7 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
             ceres_error_terms::VisualReprojectionError>(
             image_point_distorted, image_point_uncertainty,
             ceres_error_terms::visual::VisualErrorType::kLocalKeyframe,
-            camera_ptr));
+            camera_ptr, problem_information_.residual_block_arena));
 
     // For this error term we add dummy pointers for ceres for
     // the parameter blocks we don't use in order to have a single
@@ -1944,7 +2087,6 @@ bool GraphBaOptimizer::addVisualResidualBlockOfKeypoint(
     problem_information_.setParameterBlockConstant(
         landmark_base_vertex.getLandmarks().get_p_B_Mutable(landmark_id));
   }
-  return true;
 }
 
 void GraphBaOptimizer::addVisualResidualBlocks(
@@ -1965,7 +2107,7 @@ void GraphBaOptimizer::addVisualResidualBlocks(
     bool fix_intrinsics, bool fix_extrinsics_rotation,
     bool fix_extrinsics_translation, bool fix_landmark_positions,
     bool include_only_merged_landmarks,
-    unsigned int min_observer_vertices_per_landmark,
+    unsigned int /*min_observer_vertices_per_landmark*/,
     unsigned int min_landmarks_per_frame,
     unsigned int min_num_observer_missions,
     pose_graph::VertexIdSet* vertices_with_visual_residuals) {
@@ -1977,75 +2119,134 @@ void GraphBaOptimizer::addVisualResidualBlocks(
 
   VLOG(3) << "Before keyframes loop " << vertices.size() << " vertices.";
 
-  size_t num_visual_residuals_added = 0u;
-  size_t vertex_idx = 0;
   const size_t num_vertices = vertices.size();
-  common::ProgressBar progress_bar(num_vertices);
+  const size_t num_threads = common::getNumHardwareThreads();
+  std::vector<const vi_map::Vertex*> vertex_ptrs(num_vertices);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    vertex_ptrs[vertex_idx] = &const_map_.getVertex(vertices[vertex_idx]);
+  }
+
+  // The checks of all keypoints only read the map and run in parallel, with
+  // every landmark checked once instead of once per observation. The
+  // residuals are then added on a single thread in the order of the vertices.
+  std::vector<vi_map::LandmarkIdSet> vertex_landmark_ids(num_vertices);
+  common::ParallelProcess(
+      num_vertices,
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t vertex_idx : batch) {
+          const vi_map::Vertex& vertex = *vertex_ptrs[vertex_idx];
+          const unsigned int num_frames = vertex.numFrames();
+          for (unsigned int frame_idx = 0; frame_idx < num_frames;
+               ++frame_idx) {
+            if (!vertex.isVisualFrameSet(frame_idx) ||
+                !vertex.isVisualFrameValid(frame_idx)) {
+              continue;
+            }
+            for (const vi_map::LandmarkId& landmark_id :
+                 vertex.getFrameObservedLandmarkIds(frame_idx)) {
+              if (landmark_id.isValid()) {
+                vertex_landmark_ids[vertex_idx].insert(landmark_id);
+              }
+            }
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
 
-  for (const pose_graph::VertexId& vertex_id : vertices) {
-    size_t num_visual_residuals_added_for_this_vertex = 0u;
+  LandmarkChecksTable landmark_checks;
+  for (const vi_map::LandmarkIdSet& landmark_ids : vertex_landmark_ids) {
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      landmark_checks.emplace(landmark_id, LandmarkChecks());
+    }
+  }
 
+  // The keys are fixed from here on, so the values can be written
+  // concurrently.
+  std::vector<LandmarkChecksTable::value_type*> landmark_entries;
+  landmark_entries.reserve(landmark_checks.size());
+  for (LandmarkChecksTable::value_type& entry : landmark_checks) {
+    landmark_entries.push_back(&entry);
+  }
+  common::ParallelProcess(
+      landmark_entries.size(),
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t entry_idx : batch) {
+          const vi_map::LandmarkId& landmark_id =
+              landmark_entries[entry_idx]->first;
+          LandmarkChecks& checks = landmark_entries[entry_idx]->second;
+          checks.is_well_constrained = vi_map::isLandmarkWellConstrained(
+              const_map_, const_map_.getLandmark(landmark_id));
+          checks.is_usable = checks.is_well_constrained;
+          if (checks.is_usable &&
+              (include_only_merged_landmarks ||
+               min_num_observer_missions > 0u)) {
+            const unsigned int num_observer_missions =
+                const_map_.numLandmarkObserverMissions(landmark_id);
+            CHECK_GT(num_observer_missions, 0u);
+            if ((include_only_merged_landmarks && num_observer_missions < 2u) ||
+                num_observer_missions < min_num_observer_missions) {
+              checks.is_usable = false;
+            }
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  std::vector<VertexVisualResiduals> vertex_residuals(num_vertices);
+  common::ParallelProcess(
+      num_vertices,
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t vertex_idx : batch) {
+          collectVisualResidualsOfVertex(
+              *vertex_ptrs[vertex_idx], landmark_checks,
+              min_landmarks_per_frame, &vertex_residuals[vertex_idx]);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  size_t num_visual_residuals = 0u;
+  for (const VertexVisualResiduals& frames : vertex_residuals) {
+    for (const FrameVisualResiduals& frame : frames) {
+      num_visual_residuals += frame.keypoint_indices.size();
+    }
+  }
+  problem_information_.reserveResidualBlocks(
+      problem_information_.residual_blocks.size() + num_visual_residuals);
+
+  common::ProgressBar progress_bar(num_vertices);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    const pose_graph::VertexId& vertex_id = vertices[vertex_idx];
     vi_map::Vertex& ba_vertex = map_.getVertex(vertex_id);
-    const unsigned int num_frames = ba_vertex.numFrames();
-    for (unsigned int frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
-      if (!ba_vertex.isVisualFrameSet(frame_idx) ||
-          !ba_vertex.isVisualFrameValid(frame_idx)) {
-        continue;
-      }
+
+    VertexIdPoseIdxMap::const_iterator vertex_it;
+    vertex_it = vertex_id_to_pose_idx_.find(vertex_id);
+    CHECK(vertex_it != vertex_id_to_pose_idx_.end());
+    CHECK_GE(vertex_it->second, 0);
+    CHECK_LT(vertex_it->second, vertex_poses_.cols());
+
+    for (const FrameVisualResiduals& frame : vertex_residuals[vertex_idx]) {
       const Eigen::Matrix2Xd& image_points_distorted =
-          ba_vertex.getVisualFrame(frame_idx).getKeypointMeasurements();
+          ba_vertex.getVisualFrame(frame.frame_idx).getKeypointMeasurements();
       const Eigen::VectorXd& image_points_uncertainties =
-          ba_vertex.getVisualFrame(frame_idx)
+          ba_vertex.getVisualFrame(frame.frame_idx)
               .getKeypointMeasurementUncertainties();
 
-      const aslam::Camera::Ptr camera_ptr = ba_vertex.getCamera(frame_idx);
+      const aslam::Camera::Ptr camera_ptr =
+          ba_vertex.getCamera(frame.frame_idx);
       CHECK(camera_ptr != nullptr);
 
-      unsigned int well_constrained_landmarks =
-          getNumOfWellConstrainedLandmarksInFrame(ba_vertex, frame_idx);
-      if (well_constrained_landmarks < min_landmarks_per_frame) {
-        VLOG(3) << " Skipping this visual keyframe. Only "
-                << well_constrained_landmarks
-                << " well constrained landmarks, but "
-                << min_landmarks_per_frame << " required";
-        continue;
-      }
-
-      VertexIdPoseIdxMap::const_iterator vertex_it;
-      vertex_it = vertex_id_to_pose_idx_.find(ba_vertex.id());
-      CHECK(vertex_it != vertex_id_to_pose_idx_.end());
-      CHECK_GE(vertex_it->second, 0);
-      CHECK_LT(vertex_it->second, vertex_poses_.cols());
-
       unsigned int external_landmarks_added = 0;
-      for (int i = 0; i < image_points_distorted.cols(); ++i) {
-        std::shared_ptr<ceres::LossFunction> loss_function(
-            new ceres::LossFunctionWrapper(
-                new ceres::CauchyLoss(3.0 * image_points_uncertainties(i)),
-                ceres::TAKE_OWNERSHIP));
-
-        vi_map::LandmarkId landmark_id =
-            ba_vertex.getObservedLandmarkId(frame_idx, i);
-
-        bool include_this_landmark = true;
-        if (include_only_merged_landmarks && landmark_id.isValid()) {
-          const int num_observer_missions =
-              map_.numLandmarkObserverMissions(landmark_id);
-          CHECK_GT(num_observer_missions, 0);
-          if (num_observer_missions < 2) {
-            include_this_landmark = false;
-          }
-        }
-        if (include_this_landmark &&
-            addVisualResidualBlockOfKeypoint(
-                image_points_distorted.col(i), image_points_uncertainties(i),
-                landmark_id, fix_landmark_positions,
-                min_observer_vertices_per_landmark, min_landmarks_per_frame,
-                min_num_observer_missions, loss_function, camera_ptr.get(),
-                &external_landmarks_added, &ba_vertex)) {
-          ++num_visual_residuals_added;
-          ++num_visual_residuals_added_for_this_vertex;
-        }
+      for (const int keypoint_idx : frame.keypoint_indices) {
+        // Keypoints of the same uncertainty share one loss function.
+        addVisualResidualBlockOfUsableKeypoint(
+            image_points_distorted.col(keypoint_idx),
+            image_points_uncertainties(keypoint_idx),
+            ba_vertex.getObservedLandmarkId(frame.frame_idx, keypoint_idx),
+            fix_landmark_positions,
+            problem_information_.getSharedLossFunction<ceres::CauchyLoss>(
+                ceres_error_terms::ResidualType::kVisualReprojectionError,
+                3.0 * image_points_uncertainties(keypoint_idx)),
+            camera_ptr.get(), &external_landmarks_added, &ba_vertex);
       }
 
       if (image_points_distorted.cols() > 0) {
@@ -2059,17 +2260,16 @@ void GraphBaOptimizer::addVisualResidualBlocks(
             vertex_poses_.col(vertex_it->second).data(),
             pose_parameterization_);
       }
-      if (num_visual_residuals_added_for_this_vertex > 0u) {
-        if (vertices_with_visual_residuals != nullptr) {
-          vertices_with_visual_residuals->emplace(vertex_id);
-        }
+      if (!frame.keypoint_indices.empty() &&
+          vertices_with_visual_residuals != nullptr) {
+        vertices_with_visual_residuals->emplace(vertex_id);
       }
     }  // Loop over all frames in a vertex.
     if (VLOG_IS_ON(2)) {
-      progress_bar.update(++vertex_idx);
+      progress_bar.update(vertex_idx + 1u);
     }
   }  // Loop over all vertices.
-  VLOG(1) << "Added " << num_visual_residuals_added << " visual residuals.";
+  VLOG(1) << "Added " << num_visual_residuals << " visual residuals.";
 }
 
 void GraphBaOptimizer::addDoubleWindowVisualResidualBlocks(
@@ -2112,10 +2312,10 @@ void GraphBaOptimizer::addDoubleWindowVisualResidualBlocks(
             image_points_distorted.col(i);
         const double image_point_uncertainty = image_points_uncertainties(i);
 
-        std::shared_ptr<ceres::LossFunction> loss_function(
-            new ceres::LossFunctionWrapper(
-                new ceres::HuberLoss(3.0 * image_point_uncertainty),
-                ceres::TAKE_OWNERSHIP));
+        std::shared_ptr<ceres::LossFunction> loss_function =
+            problem_information_.getSharedLossFunction<ceres::HuberLoss>(
+                ceres_error_terms::ResidualType::kVisualReprojectionError,
+                3.0 * image_point_uncertainty);
 
         const vi_map::LandmarkId landmark_id =
             ba_vertex.getObservedLandmarkId(frame_idx, i);
@@ -2143,28 +2343,6 @@ void GraphBaOptimizer::addDoubleWindowVisualResidualBlocks(
   }    // Loop over all vertices.
 }
 
-unsigned int GraphBaOptimizer::getNumOfWellConstrainedLandmarksInFrame(
-    const vi_map::Vertex& ba_vertex, unsigned int frame_idx) {
-  CHECK(ba_vertex.isVisualFrameSet(frame_idx));
-  const Eigen::Matrix2Xd& image_points_distorted =
-      ba_vertex.getVisualFrame(frame_idx).getKeypointMeasurements();
-
-  // Count well-constrained observations for the current vertex.
-  unsigned int well_constrained_landmarks = 0;
-  for (int i = 0; i < image_points_distorted.cols(); ++i) {
-    vi_map::LandmarkId landmark_id =
-        ba_vertex.getObservedLandmarkId(frame_idx, i);
-    if (landmark_id.isValid()) {
-      CHECK(const_map_.hasLandmark(landmark_id));
-      if (vi_map::isLandmarkWellConstrained(
-              const_map_, const_map_.getLandmark(landmark_id))) {
-        ++well_constrained_landmarks;
-      }
-    }
-  }
-  return well_constrained_landmarks;
-}
-
 void GraphBaOptimizer::setCameraParameterizationIfPartOfTheProblem(
     const aslam::Camera::Ptr& camera_ptr, bool fix_intrinsics,
     bool fix_extrinsics_rotation, bool fix_extrinsics_translation) {
@@ -2416,13 +2594,79 @@ void GraphBaOptimizer::solve(
     ceres::Solver::Summary* summary) {
   CHECK_NOTNULL(problem);
   CHECK_NOTNULL(summary);
-  ceres::Solve(options, problem, summary);
+  ceres::Solver::Options ordered_options = options;
+  setLinearSolverOrdering(*problem, &ordered_options);
+  ceres::Solve(ordered_options, problem, summary);
 
   if (copy_data_from_solver_back_to_map) {
     copyDataToMap();
   }
 
+  if (FLAGS_optimizer_log_iteration_timing) {
+    LOG(INFO) << "Solved " << summary->num_residual_blocks
+              << " residual blocks in " << summary->total_time_in_seconds
+              << "s: preprocessing " << summary->preprocessor_time_in_seconds
+              << "s, residual evaluation "
+              << summary->residual_evaluation_time_in_seconds
+              << "s, jacobian evaluation "
+              << summary->jacobian_evaluation_time_in_seconds
+              << "s, linear solver " << summary->linear_solver_time_in_seconds
+              << "s.";
+  }
   VLOG(2) << summary->message;
   VLOG(3) << summary->FullReport();
 }
+
+void GraphBaOptimizer::setLinearSolverOrdering(
+    const ceres::Problem& problem, ceres::Solver::Options* options) const {
+  CHECK_NOTNULL(options);
+  if (options->linear_solver_type != ceres::SPARSE_SCHUR &&
+      options->linear_solver_type != ceres::ITERATIVE_SCHUR) {
+    return;
+  }
+  enum Group : int { kLandmarks = 0, kVertexStates = 1, kOthers = 2 };
+
+  std::unordered_set<const double*> landmark_blocks;
+  for (const CostFunctionToLandmarkMap::value_type& cost_and_landmark :
+       residual_to_landmark) {
+    if (const_map_.hasLandmark(cost_and_landmark.second)) {
+      landmark_blocks.insert(
+          map_.getLandmark(cost_and_landmark.second).get_p_B_Mutable());
+    }
+  }
+  std::unordered_set<const double*> vertex_blocks;
+  for (const VertexIdPoseIdxMap::value_type& vertex_id_and_idx :
+       vertex_id_to_pose_idx_) {
+    vi_map::Vertex& vertex = map_.getVertex(vertex_id_and_idx.first);
+    vertex_blocks.insert(vertex_poses_.col(vertex_id_and_idx.second).data());
+    vertex_blocks.insert(vertex.get_v_M_Mutable());
+    vertex_blocks.insert(vertex.getGyroBiasMutable());
+    vertex_blocks.insert(vertex.getAccelBiasMutable());
+  }
+
+  // Ceres requires every parameter block of the problem to be part of the
+  // ordering, so the blocks are taken from the problem itself. Landmarks only
+  // referenced by outdated entries of residual_to_landmark are not in it.
+  std::vector<double*> parameter_blocks;
+  problem.GetParameterBlocks(&parameter_blocks);
+  std::unique_ptr<ceres::ParameterBlockOrdering> ordering(
+      new ceres::ParameterBlockOrdering);
+  for (double* parameter_block : parameter_blocks) {
+    Group group = kOthers;
+    if (landmark_blocks.count(parameter_block) > 0u) {
+      group = kLandmarks;
+    } else if (vertex_blocks.count(parameter_block) > 0u) {
+      group = kVertexStates;
+    }
+    ordering->AddElementToGroup(parameter_block, group);
+  }
+
+  // The first group has to be an independent set, which only the landmarks
+  // are. Without landmarks, ceres is left to find an ordering itself.
+  if (ordering->GroupSize(kLandmarks) == 0) {
+    VLOG(1) << "No landmarks in the problem, using the default ordering.";
+    return;
+  }
+  options->linear_solver_ordering.reset(ordering.release());
+}
 }  // namespace map_optimization_legacy
@@ -1,8 +1,18 @@
 #include <map-optimization-legacy/landmark-covariance-estimation.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Cholesky>
 #include <Eigen/Core>
 #include <ceres/ceres.h>
 #include <gflags/gflags.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 
@@ -13,8 +23,173 @@ DEFINE_uint64(
 DEFINE_uint64(
     cov_estimation_min_observations_per_frame, 5,
     "Minimum required number of observations per frame.");
+DEFINE_bool(
+    cov_estimation_local_schur_complement, false,
+    "Estimate the covariance of every landmark from its own observations "
+    "only, instead of recovering it from the full problem. Scales to large "
+    "maps.");
+DEFINE_double(
+    cov_estimation_pose_position_std_dev_meters, 0.0,
+    "Position standard deviation of the observer poses in the local "
+    "covariance estimation. If this and the orientation standard deviation "
+    "are zero, the poses are treated as fixed.");
+DEFINE_double(
+    cov_estimation_pose_orientation_std_dev_radians, 0.0,
+    "Orientation standard deviation of the observer poses in the local "
+    "covariance estimation.");
 
 namespace map_optimization_legacy {
+namespace {
+
+// Parameter blocks of the visual reprojection error term.
+constexpr size_t kLandmarkBlockIndex = 0u;
+constexpr size_t kLandmarkStoreVertexBlockIndex = 1u;
+constexpr size_t kObserverVertexBlockIndex = 4u;
+constexpr int kPoseLocalSize = 6;
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    RowMajorMatrixXd;
+typedef Eigen::Matrix<double, 3, kPoseLocalSize> LandmarkPoseInformation;
+typedef std::vector<
+    std::pair<const double*, LandmarkPoseInformation>,
+    Eigen::aligned_allocator<
+        std::pair<const double*, LandmarkPoseInformation> > >
+    LandmarkPoseInformationList;
+typedef std::unordered_map<
+    vi_map::LandmarkId,
+    std::vector<const ceres_error_terms::ResidualInformation*> >
+    LandmarkResidualsMap;
+
+void setLargeCovariance(vi_map::Landmark* landmark) {
+  CHECK_NOTNULL(landmark);
+  Eigen::Matrix3d some_large_covariance = Eigen::Matrix3d::Identity();
+  some_large_covariance *= 100;
+  landmark->set_p_B_Covariance(some_large_covariance);
+}
+
+// Linearizes the visual residuals of a single landmark. With the poses fixed,
+// the landmark covariance is the inverse of H_ll = sum_i J_l,i^T J_l,i. Poses
+// with marginal covariance pose_covariance move the landmark estimate by
+// -H_ll^-1 sum_k B_k dp_k, with B_k = sum_i J_l,i^T J_p,i,k over the residuals
+// that contain pose k, which adds H_ll^-1 (sum_k B_k S_p B_k^T) H_ll^-1.
+// Returns false if the landmark is not constrained by its residuals.
+bool computeLocalLandmarkCovariance(
+    const std::vector<const ceres_error_terms::ResidualInformation*>&
+        residuals,
+    const ceres_error_terms::ProblemInformation& problem_information,
+    const std::unordered_set<const double*>& fixed_pose_blocks,
+    const bool propagate_pose_covariance,
+    const Eigen::Matrix<double, kPoseLocalSize, kPoseLocalSize>&
+        pose_covariance,
+    Eigen::Matrix3d* covariance) {
+  CHECK_NOTNULL(covariance);
+
+  Eigen::Matrix3d landmark_information = Eigen::Matrix3d::Zero();
+  LandmarkPoseInformationList pose_information;
+  for (const ceres_error_terms::ResidualInformation* residual : residuals) {
+    CHECK_NOTNULL(residual);
+    const ceres::CostFunction& cost_function = *residual->cost_function;
+    const std::vector<int32_t>& block_sizes =
+        cost_function.parameter_block_sizes();
+    CHECK_EQ(block_sizes.size(), residual->parameter_blocks.size());
+    CHECK_GT(block_sizes.size(), kObserverVertexBlockIndex);
+    CHECK_EQ(block_sizes[kLandmarkBlockIndex], 3);
+    const int num_residuals = cost_function.num_residuals();
+
+    std::vector<RowMajorMatrixXd> jacobians(block_sizes.size());
+    std::vector<double*> jacobian_ptrs(block_sizes.size(), nullptr);
+    jacobians[kLandmarkBlockIndex].resize(num_residuals, 3);
+    jacobian_ptrs[kLandmarkBlockIndex] = jacobians[kLandmarkBlockIndex].data();
+    std::vector<size_t> pose_block_indices;
+    if (propagate_pose_covariance) {
+      for (const size_t block_idx :
+           {kLandmarkStoreVertexBlockIndex, kObserverVertexBlockIndex}) {
+        double* block = residual->parameter_blocks[block_idx];
+        // Dummies of local error terms are constant as well.
+        if (problem_information.constant_parameter_blocks.count(block) > 0u ||
+            fixed_pose_blocks.count(block) > 0u) {
+          continue;
+        }
+        jacobians[block_idx].resize(num_residuals, block_sizes[block_idx]);
+        jacobian_ptrs[block_idx] = jacobians[block_idx].data();
+        pose_block_indices.push_back(block_idx);
+      }
+    }
+
+    Eigen::VectorXd residual_vector(num_residuals);
+    if (!cost_function.Evaluate(
+            residual->parameter_blocks.data(), residual_vector.data(),
+            jacobian_ptrs.data())) {
+      return false;
+    }
+
+    // Same as ceres for losses with a non-positive second derivative, such as
+    // the Huber and Cauchy losses used for the visual terms.
+    double residual_scaling = 1.0;
+    if (residual->loss_function != nullptr) {
+      double rho[3];
+      residual->loss_function->Evaluate(residual_vector.squaredNorm(), rho);
+      residual_scaling = std::sqrt(std::max(rho[1], 0.0));
+    }
+
+    const RowMajorMatrixXd J_landmark =
+        residual_scaling * jacobians[kLandmarkBlockIndex];
+    landmark_information += J_landmark.transpose() * J_landmark;
+
+    for (const size_t block_idx : pose_block_indices) {
+      double* block = residual->parameter_blocks[block_idx];
+      RowMajorMatrixXd J_pose = residual_scaling * jacobians[block_idx];
+      const ceres_error_terms::ProblemInformation::ParameterizationsMap::
+          const_iterator parameterization_it =
+              problem_information.parameterizations.find(block);
+      if (parameterization_it != problem_information.parameterizations.end()) {
+        const ceres::LocalParameterization& parameterization =
+            *parameterization_it->second;
+        RowMajorMatrixXd J_plus(
+            parameterization.GlobalSize(), parameterization.LocalSize());
+        CHECK(parameterization.ComputeJacobian(block, J_plus.data()));
+        J_pose = J_pose * J_plus;
+      }
+      CHECK_EQ(J_pose.cols(), kPoseLocalSize);
+
+      LandmarkPoseInformationList::iterator it = std::find_if(
+          pose_information.begin(), pose_information.end(),
+          [block](const LandmarkPoseInformationList::value_type& entry) {
+            return entry.first == block;
+          });
+      if (it == pose_information.end()) {
+        pose_information.emplace_back(block, LandmarkPoseInformation::Zero());
+        it = pose_information.end() - 1;
+      }
+      it->second += J_landmark.transpose() * J_pose;
+    }
+  }
+
+  const Eigen::LLT<Eigen::Matrix3d> llt(landmark_information);
+  if (llt.info() != Eigen::Success) {
+    return false;
+  }
+  const Eigen::Matrix3d landmark_information_inverse =
+      llt.solve(Eigen::Matrix3d::Identity());
+  if (!landmark_information_inverse.allFinite()) {
+    return false;
+  }
+
+  *covariance = landmark_information_inverse;
+  if (!pose_information.empty()) {
+    Eigen::Matrix3d propagated_pose_information = Eigen::Matrix3d::Zero();
+    for (const LandmarkPoseInformationList::value_type& entry :
+         pose_information) {
+      propagated_pose_information +=
+          entry.second * pose_covariance * entry.second.transpose();
+    }
+    *covariance += landmark_information_inverse *
+                   propagated_pose_information * landmark_information_inverse;
+  }
+  return true;
+}
+
+}  // namespace
 
 LandmarkCovarianceEstimation::LandmarkCovarianceEstimation(vi_map::VIMap* map)
     : GraphBaOptimizer(CHECK_NOTNULL(map)) {}
@@ -23,6 +198,10 @@ LandmarkCovarianceEstimation::~LandmarkCovarianceEstimation() {}
 
 void LandmarkCovarianceEstimation::assignCovarianceToLandmarks(
     const std::unordered_set<pose_graph::VertexId>& fixed_vertices) {
+  if (FLAGS_cov_estimation_local_schur_complement) {
+    assignLocalCovarianceToLandmarks(fixed_vertices);
+    return;
+  }
   addErrorTerms(fixed_vertices);
 
   ceres::Solver::Options options = getDefaultSolverOptions();
@@ -37,19 +216,18 @@ void LandmarkCovarianceEstimation::assignCovarianceToLandmarks(
   calculateCovariance(&problem);
 }
 
-void LandmarkCovarianceEstimation::addErrorTerms(
+void LandmarkCovarianceEstimation::assignLocalCovarianceToLandmarks(
     const pose_graph::VertexIdSet& fixed_vertices) {
+  addVisualErrorTerms();
+  calculateLocalCovariance(fixed_vertices);
+}
+
+void LandmarkCovarianceEstimation::addVisualErrorTerms() {
   bool kFixIntrinsics = true;
   bool kFixExtrinsicsRotation = true;
   bool kFixExtrinsicsTranslation = true;
   bool kFixLandmarkPosition = false;
-  bool kFixAccelBias = false;
-  bool kFixGyroBias = false;
-  bool kFixVelocity = false;
-  bool kUseGivenEdges = false;
-  bool kStoreCachedImuCovariances = false;
   bool kIncludeOnlyMergedLandmarks = false;
-  pose_graph::EdgeIdList edges;
 
   removeLandmarksBehindCamera();
   const size_t kMinNumOfObserverMissions = 0u;
@@ -59,6 +237,18 @@ void LandmarkCovarianceEstimation::addErrorTerms(
       FLAGS_cov_estimation_min_landmark_observer_count,
       FLAGS_cov_estimation_min_observations_per_frame,
       kMinNumOfObserverMissions);
+}
+
+void LandmarkCovarianceEstimation::addErrorTerms(
+    const pose_graph::VertexIdSet& fixed_vertices) {
+  bool kFixAccelBias = false;
+  bool kFixGyroBias = false;
+  bool kFixVelocity = false;
+  bool kUseGivenEdges = false;
+  bool kStoreCachedImuCovariances = false;
+  pose_graph::EdgeIdList edges;
+
+  addVisualErrorTerms();
   BaOptimizationOptions options;
   addInertialResidualBlocks(
       kFixGyroBias, kFixAccelBias, kFixVelocity, kUseGivenEdges, edges,
@@ -116,10 +306,7 @@ void LandmarkCovarianceEstimation::calculateCovariance(
             } else {
               // Not enough landmarks, let's put something big to covariance
               // diagonal.
-              Eigen::Matrix3d some_large_covariance =
-                  Eigen::Matrix3d::Identity();
-              some_large_covariance *= 100;
-              landmark.set_p_B_Covariance(some_large_covariance);
+              setLargeCovariance(&landmark);
             }
           }
         }
@@ -142,4 +329,81 @@ void LandmarkCovarianceEstimation::calculateCovariance(
   }
 }
 
+void LandmarkCovarianceEstimation::calculateLocalCovariance(
+    const pose_graph::VertexIdSet& fixed_vertices) {
+  CHECK_GE(FLAGS_cov_estimation_pose_position_std_dev_meters, 0.0);
+  CHECK_GE(FLAGS_cov_estimation_pose_orientation_std_dev_radians, 0.0);
+  const bool propagate_pose_covariance =
+      FLAGS_cov_estimation_pose_position_std_dev_meters > 0.0 ||
+      FLAGS_cov_estimation_pose_orientation_std_dev_radians > 0.0;
+  // The local pose parameterization is [orientation position].
+  Eigen::Matrix<double, kPoseLocalSize, kPoseLocalSize> pose_covariance =
+      Eigen::Matrix<double, kPoseLocalSize, kPoseLocalSize>::Zero();
+  pose_covariance.diagonal().head<3>().setConstant(
+      FLAGS_cov_estimation_pose_orientation_std_dev_radians *
+      FLAGS_cov_estimation_pose_orientation_std_dev_radians);
+  pose_covariance.diagonal().tail<3>().setConstant(
+      FLAGS_cov_estimation_pose_position_std_dev_meters *
+      FLAGS_cov_estimation_pose_position_std_dev_meters);
+
+  std::unordered_set<const double*> fixed_pose_blocks;
+  for (const pose_graph::VertexId& vertex_id : fixed_vertices) {
+    const VertexIdPoseIdxMap::const_iterator it =
+        vertex_id_to_pose_idx_.find(vertex_id);
+    CHECK(it != vertex_id_to_pose_idx_.end());
+    fixed_pose_blocks.insert(vertex_poses_.col(it->second).data());
+  }
+
+  LOG(INFO) << "Grouping visual residuals by landmark.";
+  LandmarkResidualsMap landmark_residuals;
+  for (const ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& item : problem_information_.residual_blocks) {
+    const ceres_error_terms::ResidualInformation& residual = item.second;
+    if (!residual.active_ ||
+        residual.residual_type !=
+            ceres_error_terms::ResidualType::kVisualReprojectionError) {
+      continue;
+    }
+    const CostFunctionToLandmarkMap::const_iterator it =
+        residual_to_landmark.find(item.first);
+    CHECK(it != residual_to_landmark.end());
+    landmark_residuals[it->second].push_back(&residual);
+  }
+
+  vi_map::LandmarkIdList landmark_ids;
+  const_map_.getAllLandmarkIds(&landmark_ids);
+
+  LOG(INFO) << "Calculating local covariance of " << landmark_ids.size()
+            << " landmarks.";
+  std::atomic<size_t> num_estimated_covariances(0u);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      landmark_ids.size(),
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t landmark_idx : batch) {
+          const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_idx];
+          vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
+
+          Eigen::Matrix3d covariance;
+          const LandmarkResidualsMap::const_iterator it =
+              landmark_residuals.find(landmark_id);
+          if (it != landmark_residuals.end() &&
+              landmark.numberOfObservations() >
+                  FLAGS_cov_estimation_min_landmark_observer_count &&
+              computeLocalLandmarkCovariance(
+                  it->second, problem_information_, fixed_pose_blocks,
+                  propagate_pose_covariance, pose_covariance, &covariance)) {
+            landmark.set_p_B_Covariance(covariance);
+            ++num_estimated_covariances;
+          } else {
+            setLargeCovariance(&landmark);
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+
+  LOG(INFO) << "Estimated the covariance of " << num_estimated_covariances
+            << " out of " << landmark_ids.size() << " landmarks.";
+}
+
 }  // namespace map_optimization_legacy
@@ -0,0 +1,88 @@
+#include <unordered_map>
+#include <utility>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization-legacy/landmark-covariance-estimation.h"
+#include "map-optimization-legacy/test/6dof-vi-map-gen.h"
+
+DECLARE_bool(cov_estimation_local_schur_complement);
+DECLARE_double(cov_estimation_pose_position_std_dev_meters);
+DECLARE_double(cov_estimation_pose_orientation_std_dev_radians);
+
+namespace map_optimization_legacy {
+
+class LandmarkCovarianceTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vimap_gen_.generateVIMap();
+    FLAGS_cov_estimation_local_schur_complement = true;
+  }
+
+  void estimateCovariances(
+      std::unordered_map<vi_map::LandmarkId, Eigen::Matrix3d>* covariances) {
+    CHECK_NOTNULL(covariances)->clear();
+    vi_map::VIMap& map = vimap_gen_.vi_map_;
+    LandmarkCovarianceEstimation estimation(&map);
+    const pose_graph::VertexIdSet kNoFixedVertices;
+    estimation.assignCovarianceToLandmarks(kNoFixedVertices);
+
+    vi_map::LandmarkIdList landmark_ids;
+    map.getAllLandmarkIds(&landmark_ids);
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      Eigen::Matrix3d covariance;
+      EXPECT_TRUE(map.getLandmark(landmark_id).get_p_B_Covariance(&covariance));
+      covariances->emplace(landmark_id, covariance);
+    }
+  }
+
+  SixDofVIMapGenerator vimap_gen_;
+};
+
+TEST_F(LandmarkCovarianceTest, PoseUncertaintyIncreasesLocalCovariance) {
+  FLAGS_cov_estimation_pose_position_std_dev_meters = 0.0;
+  FLAGS_cov_estimation_pose_orientation_std_dev_radians = 0.0;
+  std::unordered_map<vi_map::LandmarkId, Eigen::Matrix3d> fixed_covariances;
+  estimateCovariances(&fixed_covariances);
+  ASSERT_FALSE(fixed_covariances.empty());
+
+  FLAGS_cov_estimation_pose_position_std_dev_meters = 0.1;
+  FLAGS_cov_estimation_pose_orientation_std_dev_radians = 0.01;
+  std::unordered_map<vi_map::LandmarkId, Eigen::Matrix3d>
+      uncertain_covariances;
+  estimateCovariances(&uncertain_covariances);
+  ASSERT_EQ(uncertain_covariances.size(), fixed_covariances.size());
+
+  constexpr double kPrecision = 1e-9;
+  for (const std::pair<const vi_map::LandmarkId, Eigen::Matrix3d>& item :
+       fixed_covariances) {
+    const Eigen::Matrix3d& fixed_covariance = item.second;
+    const Eigen::Matrix3d& uncertain_covariance =
+        uncertain_covariances[item.first];
+    EXPECT_NEAR(
+        (fixed_covariance - fixed_covariance.transpose()).norm(), 0.0,
+        kPrecision);
+    EXPECT_GT(
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(fixed_covariance)
+            .eigenvalues()
+            .minCoeff(),
+        0.0);
+    // The pose uncertainty only adds a positive semi-definite term.
+    EXPECT_GT(
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(
+            uncertain_covariance - fixed_covariance)
+            .eigenvalues()
+            .minCoeff(),
+        -kPrecision);
+  }
+}
+
+}  // namespace map_optimization_legacy
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>  // NOLINT
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ceres-error-terms/problem-information.h>
+#include <ceres/ceres.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/pose_types.h>
+#include <maplab-common/string-tools.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization/optimization-problem.h"
+#include "map-optimization/solver-options.h"
+#include "map-optimization/solver.h"
+#include "map-optimization/vi-map-relaxation.h"
+#include "map-optimization/vi-optimization-builder.h"
+
+// Benchmarks of the map-optimization pipeline on generated maps. The results
+// are written in the JSON format of Google Benchmark, so the same tooling can
+// be used to track regressions:
+//   map_optimization_benchmarks --benchmark_out=results.json
+
+DEFINE_string(
+    benchmark_map_sizes, "100,400,1600",
+    "Comma separated numbers of vertices of the generated benchmark maps.");
+DEFINE_string(
+    benchmark_num_threads, "1,4",
+    "Comma separated numbers of threads used for evaluation and solving.");
+DEFINE_string(
+    benchmark_linear_solvers, "SPARSE_SCHUR,ITERATIVE_SCHUR",
+    "Comma separated ceres linear solver types of the solve benchmarks.");
+DEFINE_int32(
+    benchmark_repetitions, 3, "Number of repetitions of every benchmark.");
+DEFINE_int32(
+    benchmark_solver_iterations, 5,
+    "Number of solver iterations of the solve benchmarks.");
+DEFINE_string(
+    benchmark_out, "",
+    "File the JSON results are written to. Printed to stdout if empty.");
+
+namespace map_optimization {
+namespace {
+
+constexpr int kMapSeed = 42;
+constexpr double kVertexSpacingMeters = 0.5;
+constexpr size_t kLandmarksPerVertex = 20u;
+// Each landmark is observed by this many vertices before and after the
+// storing vertex.
+constexpr int kObservationWindow = 5;
+
+struct BenchmarkResult {
+  std::string name;
+  std::vector<double> real_times_ms;
+  std::vector<double> cpu_times_ms;
+};
+
+class BenchmarkTimer {
+ public:
+  BenchmarkTimer()
+      : real_start_(std::chrono::steady_clock::now()),
+        cpu_start_(std::clock()) {}
+
+  void stop(BenchmarkResult* result) const {
+    CHECK_NOTNULL(result);
+    const std::chrono::duration<double, std::milli> real_time =
+        std::chrono::steady_clock::now() - real_start_;
+    result->real_times_ms.push_back(real_time.count());
+    result->cpu_times_ms.push_back(
+        1e3 * static_cast<double>(std::clock() - cpu_start_) / CLOCKS_PER_SEC);
+  }
+
+ private:
+  const std::chrono::steady_clock::time_point real_start_;
+  const std::clock_t cpu_start_;
+};
+
+template <typename ValueType, typename ParseFunction>
+std::vector<ValueType> parseList(
+    const std::string& list, const ParseFunction& parse) {
+  std::vector<std::string> tokens;
+  constexpr bool kRemoveEmpty = true;
+  common::tokenizeString(list, ',', kRemoveEmpty, &tokens);
+  std::vector<ValueType> values;
+  for (const std::string& token : tokens) {
+    values.push_back(parse(token));
+  }
+  CHECK(!values.empty()) << "Empty benchmark parameter list.";
+  return values;
+}
+
+// Straight trajectory along x with the camera looking at landmarks in front
+// of it. Every vertex stores kLandmarksPerVertex landmarks that are observed
+// by its neighbors within kObservationWindow.
+void generateBenchmarkMap(const size_t num_vertices, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_GT(num_vertices, 0u);
+  vi_map::VIMapGenerator generator(*map, kMapSeed);
+  std::mt19937 random_engine(kMapSeed);
+  std::uniform_real_distribution<double> offset_distribution(-1.0, 1.0);
+  std::uniform_real_distribution<double> depth_distribution(5.0, 10.0);
+
+  const vi_map::MissionId mission_id = generator.createMission();
+  pose_graph::VertexIdList vertex_ids;
+  constexpr int64_t kVertexTimeDeltaNanoseconds = 100000000;
+  for (size_t i = 0u; i < num_vertices; ++i) {
+    const pose::Transformation T_G_I(
+        Eigen::Vector3d(i * kVertexSpacingMeters, 0.0, 0.0),
+        pose::Quaternion());
+    vertex_ids.push_back(generator.createVertex(
+        mission_id, T_G_I, i * kVertexTimeDeltaNanoseconds));
+  }
+
+  const int num_vertices_int = static_cast<int>(num_vertices);
+  for (int i = 0; i < num_vertices_int; ++i) {
+    pose_graph::VertexIdList observers;
+    for (int j = std::max(0, i - kObservationWindow);
+         j <= std::min(num_vertices_int - 1, i + kObservationWindow); ++j) {
+      if (j != i) {
+        observers.push_back(vertex_ids[j]);
+      }
+    }
+    for (size_t k = 0u; k < kLandmarksPerVertex; ++k) {
+      const Eigen::Vector3d p_G_fi(
+          i * kVertexSpacingMeters + offset_distribution(random_engine),
+          2.0 * offset_distribution(random_engine),
+          depth_distribution(random_engine));
+      generator.createLandmark(p_G_fi, vertex_ids[i], observers);
+    }
+  }
+  generator.generateMap<vi_map::ViwlsEdge>();
+}
+
+// Every third vertex is moved, so the solver has work to do.
+void corruptVertices(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  std::mt19937 random_engine(kMapSeed);
+  std::normal_distribution<double> position_distribution(0.0, 0.05);
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  std::sort(vertex_ids.begin(), vertex_ids.end());
+  for (size_t i = 0u; i < vertex_ids.size(); i += 3u) {
+    vi_map::Vertex& vertex = map->getVertex(vertex_ids[i]);
+    const Eigen::Vector3d noise(
+        position_distribution(random_engine),
+        position_distribution(random_engine),
+        position_distribution(random_engine));
+    vertex.set_p_M_I(vertex.get_p_M_I() + noise);
+  }
+}
+
+// The generated maps carry no IMU measurements.
+ViProblemOptions getBenchmarkProblemOptions(const bool relaxation) {
+  ViProblemOptions options = relaxation
+                                 ? initRelaxationProblemOptionsFromGFlags()
+                                 : ViProblemOptions::initFromGFlags();
+  options.add_inertial_constraints = false;
+  return options;
+}
+
+OptimizationProblem* constructProblem(
+    const bool relaxation, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  return constructViProblem(
+      mission_ids, getBenchmarkProblemOptions(relaxation), map);
+}
+
+std::string makeName(
+    const std::string& benchmark, const size_t num_vertices,
+    const std::string& suffix) {
+  std::ostringstream name;
+  name << benchmark << "/vertices:" << num_vertices << suffix;
+  return name.str();
+}
+
+void benchmarkProblemConstruction(
+    const size_t num_vertices, std::vector<BenchmarkResult>* results) {
+  CHECK_NOTNULL(results);
+  BenchmarkResult result;
+  result.name = makeName("construct_problem", num_vertices, "");
+  for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+       ++repetition) {
+    vi_map::VIMap map;
+    generateBenchmarkMap(num_vertices, &map);
+
+    constexpr bool kRelaxation = false;
+    const BenchmarkTimer timer;
+    OptimizationProblem::UniquePtr problem(constructProblem(kRelaxation, &map));
+    timer.stop(&result);
+    CHECK(problem != nullptr);
+  }
+  results->push_back(result);
+}
+
+void benchmarkResidualEvaluation(
+    const size_t num_vertices, const int num_threads,
+    std::vector<BenchmarkResult>* results) {
+  CHECK_NOTNULL(results);
+  BenchmarkResult result;
+  result.name = makeName(
+      "evaluate_residuals_and_jacobians", num_vertices,
+      "/threads:" + std::to_string(num_threads));
+
+  vi_map::VIMap map;
+  generateBenchmarkMap(num_vertices, &map);
+  corruptVertices(&map);
+  constexpr bool kRelaxation = false;
+  OptimizationProblem::UniquePtr problem(constructProblem(kRelaxation, &map));
+  ceres::Problem ceres_problem(ceres_error_terms::getDefaultProblemOptions());
+  ceres_error_terms::buildCeresProblemFromProblemInformation(
+      problem->getProblemInformationMutable(), &ceres_problem);
+
+  ceres::Problem::EvaluateOptions evaluate_options;
+  evaluate_options.num_threads = num_threads;
+  for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+       ++repetition) {
+    double cost;
+    std::vector<double> residuals;
+    ceres::CRSMatrix jacobian;
+    const BenchmarkTimer timer;
+    CHECK(ceres_problem.Evaluate(
+        evaluate_options, &cost, &residuals, nullptr, &jacobian));
+    timer.stop(&result);
+  }
+  results->push_back(result);
+}
+
+// Reports the total solve time and the part spent in the linear solver.
+void benchmarkSolve(
+    const std::string& benchmark, const bool relaxation,
+    const size_t num_vertices, const ceres::LinearSolverType linear_solver,
+    const int num_threads, std::vector<BenchmarkResult>* results) {
+  CHECK_NOTNULL(results);
+  const std::string suffix =
+      "/solver:" +
+      std::string(ceres::LinearSolverTypeToString(linear_solver)) +
+      "/threads:" + std::to_string(num_threads);
+  BenchmarkResult solve_result;
+  solve_result.name = makeName(benchmark, num_vertices, suffix);
+  BenchmarkResult linear_solver_result;
+  linear_solver_result.name =
+      makeName(benchmark + "_linear_solver", num_vertices, suffix);
+
+  ceres::Solver::Options solver_options = initSolverOptionsFromFlags();
+  solver_options.linear_solver_type = linear_solver;
+  solver_options.num_threads = num_threads;
+  solver_options.num_linear_solver_threads = num_threads;
+  solver_options.max_num_iterations = FLAGS_benchmark_solver_iterations;
+  solver_options.minimizer_progress_to_stdout = false;
+  solver_options.logging_type = ceres::SILENT;
+
+  for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+       ++repetition) {
+    vi_map::VIMap map;
+    generateBenchmarkMap(num_vertices, &map);
+    corruptVertices(&map);
+
+    const BenchmarkTimer timer;
+    OptimizationProblem::UniquePtr problem(constructProblem(relaxation, &map));
+    ceres::Problem ceres_problem(
+        ceres_error_terms::getDefaultProblemOptions());
+    ceres_error_terms::buildCeresProblemFromProblemInformation(
+        problem->getProblemInformationMutable(), &ceres_problem);
+    ceres::Solver::Options options = solver_options;
+    setLinearSolverOrdering(ceres_problem, problem.get(), &options);
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &ceres_problem, &summary);
+    problem->getOptimizationStateBufferMutable()->copyAllStatesBackToMap(&map);
+    timer.stop(&solve_result);
+
+    linear_solver_result.real_times_ms.push_back(
+        1e3 * summary.linear_solver_time_in_seconds);
+    linear_solver_result.cpu_times_ms.push_back(
+        1e3 * summary.linear_solver_time_in_seconds);
+  }
+  results->push_back(solve_result);
+  results->push_back(linear_solver_result);
+}
+
+double mean(const std::vector<double>& values) {
+  CHECK(!values.empty());
+  double sum = 0.0;
+  for (const double value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+void writeJson(
+    const std::vector<BenchmarkResult>& results, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  const std::time_t now = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%F %T", std::localtime(&now));
+
+  *out << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << date << "\",\n"
+       << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+       << "    \"repetitions\": " << FLAGS_benchmark_repetitions << "\n"
+       << "  },\n  \"benchmarks\": [";
+  for (size_t i = 0u; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    *out << (i == 0u ? "\n" : ",\n") << "    {\n"
+         << "      \"name\": \"" << result.name << "\",\n"
+         << "      \"iterations\": " << result.real_times_ms.size() << ",\n"
+         << "      \"real_time\": " << mean(result.real_times_ms) << ",\n"
+         << "      \"cpu_time\": " << mean(result.cpu_times_ms) << ",\n"
+         << "      \"real_time_min\": "
+         << *std::min_element(
+                result.real_times_ms.begin(), result.real_times_ms.end())
+         << ",\n"
+         << "      \"time_unit\": \"ms\"\n    }";
+  }
+  *out << "\n  ]\n}\n";
+}
+
+}  // namespace
+}  // namespace map_optimization
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_benchmark_repetitions, 0);
+  CHECK_GT(FLAGS_benchmark_solver_iterations, 0);
+
+  const std::vector<size_t> map_sizes = map_optimization::parseList<size_t>(
+      FLAGS_benchmark_map_sizes,
+      [](const std::string& token) { return std::stoul(token); });
+  const std::vector<int> thread_counts = map_optimization::parseList<int>(
+      FLAGS_benchmark_num_threads,
+      [](const std::string& token) { return std::stoi(token); });
+  const std::vector<ceres::LinearSolverType> linear_solvers =
+      map_optimization::parseList<ceres::LinearSolverType>(
+          FLAGS_benchmark_linear_solvers, [](const std::string& token) {
+            ceres::LinearSolverType type;
+            CHECK(ceres::StringToLinearSolverType(token, &type))
+                << "Unknown linear solver type " << token << ".";
+            return type;
+          });
+
+  std::vector<map_optimization::BenchmarkResult> results;
+  for (const size_t num_vertices : map_sizes) {
+    LOG(INFO) << "Benchmarking maps with " << num_vertices << " vertices.";
+    map_optimization::benchmarkProblemConstruction(num_vertices, &results);
+    for (const int num_threads : thread_counts) {
+      map_optimization::benchmarkResidualEvaluation(
+          num_vertices, num_threads, &results);
+      for (const ceres::LinearSolverType linear_solver : linear_solvers) {
+        constexpr bool kRelaxation = false;
+        map_optimization::benchmarkSolve(
+            "optvi", kRelaxation, num_vertices, linear_solver, num_threads,
+            &results);
+      }
+      // The relaxation only optimizes poses, the solver choice stays fixed.
+      constexpr bool kRelaxation = true;
+      map_optimization::benchmarkSolve(
+          "relax", kRelaxation, num_vertices, linear_solvers.front(),
+          num_threads, &results);
+    }
+  }
+
+  if (FLAGS_benchmark_out.empty()) {
+    map_optimization::writeJson(results, &std::cout);
+  } else {
+    std::ofstream out(FLAGS_benchmark_out);
+    CHECK(out.is_open()) << "Could not open " << FLAGS_benchmark_out << ".";
+    map_optimization::writeJson(results, &out);
+  }
+  return 0;
+}
@@ -2,9 +2,22 @@
 #define MAP_OPTIMIZATION_AUGMENT_LOOPCLOSURE_H_
 
 #include <map-optimization/optimization-problem.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
 
 namespace map_optimization {
+// Loop closure edges whose vertices both belong to the given missions.
+void getLoopclosureEdgesOfMissions(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids,
+    pose_graph::EdgeIdList* loop_closure_edges);
+
 void augmentViProblemWithLoopclosureEdges(OptimizationProblem* problem);
+// Adds only the given loop closure edges. The edges must stay in the map as
+// their switch variables are part of the problem.
+void augmentViProblemWithLoopclosureEdges(
+    const pose_graph::EdgeIdList& loop_closure_edges,
+    OptimizationProblem* problem);
 
 }  // namespace map_optimization
 #endif  // MAP_OPTIMIZATION_AUGMENT_LOOPCLOSURE_H_
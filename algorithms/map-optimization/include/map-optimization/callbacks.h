@@ -1,6 +1,7 @@
 #ifndef MAP_OPTIMIZATION_CALLBACKS_H_
 #define MAP_OPTIMIZATION_CALLBACKS_H_
 
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -59,7 +60,9 @@ class VisualizationCallback : public ceres::IterationCallback {
   ceres::CallbackReturnType operator()(
       const ceres::IterationSummary& /*summary*/) {
     if (iteration_ % visualize_every_n_ == 0u) {
-      plotter_.visualizeMap(map_);
+      // Most iterations only move part of the map, so only the changed
+      // markers are republished.
+      plotter_.visualizeMapUpdate(map_);
     }
     ++iteration_;
     return ceres::SOLVER_CONTINUE;
@@ -75,6 +78,28 @@ class VisualizationCallback : public ceres::IterationCallback {
   size_t iteration_;
 };
 
+// Stops the solver at the first iteration after the deadline. Unlike
+// max_solver_time_in_seconds, this also bounds the outlier rejection solver,
+// which restarts ceres several times.
+class DeadlineCallback : public ceres::IterationCallback {
+ public:
+  explicit DeadlineCallback(
+      const std::chrono::steady_clock::time_point& deadline)
+      : deadline_(deadline) {}
+
+  ceres::CallbackReturnType operator()(
+      const ceres::IterationSummary& /*summary*/) {
+    if (std::chrono::steady_clock::now() >= deadline_) {
+      VLOG(1) << "Optimization deadline reached, stopping the solver.";
+      return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+    }
+    return ceres::SOLVER_CONTINUE;
+  }
+
+ private:
+  const std::chrono::steady_clock::time_point deadline_;
+};
+
 inline void appendSignalHandlerCallback(
     std::vector<std::shared_ptr<ceres::IterationCallback>>* callbacks) {
   CHECK_NOTNULL(callbacks);
@@ -0,0 +1,58 @@
+#ifndef MAP_OPTIMIZATION_COARSE_TO_FINE_RELAXATION_H_
+#define MAP_OPTIMIZATION_COARSE_TO_FINE_RELAXATION_H_
+
+#include <vector>
+
+#include <ceres/ceres.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+
+#include "map-optimization/optimization-problem.h"
+
+namespace map_optimization {
+
+struct CoarseToFineRelaxationOptions {
+  static CoarseToFineRelaxationOptions initFromGFlags();
+
+  bool isEnabled() const {
+    return vertex_stride > 1u;
+  }
+
+  // Every vertex_stride-th vertex along each mission is kept in the
+  // decimated pose graph, plus the first and the last vertex and all loop
+  // closure endpoints. 0 or 1 disables the coarse stage.
+  size_t vertex_stride;
+  // Iterations of the full-resolution problem after the coarse stage.
+  int num_fine_iterations;
+  // Standard deviations of the relative pose between two consecutive
+  // vertices. The covariance between kept vertices grows with the number of
+  // vertices in between.
+  double position_sigma_m;
+  double orientation_sigma_rad;
+
+ protected:
+  CoarseToFineRelaxationOptions() = default;
+};
+
+// Indices into vertices_along_graph of the vertices that are kept in the
+// decimated pose graph, in ascending order.
+void selectDecimatedVertexIndices(
+    const pose_graph::VertexIdList& vertices_along_graph, size_t vertex_stride,
+    const pose_graph::VertexIdSet& loop_closure_vertices,
+    std::vector<size_t>* kept_indices);
+
+// Coarse stage of a pose-graph relaxation: relaxes the decimated pose graph
+// of the keyframes in the problem and interpolates the corrections of the
+// kept vertices to the vertices in between. The kept vertices are linked by
+// relative pose terms that preserve the current odometry and by the loop
+// closure terms of the problem. Only the state buffer of the problem is
+// updated, the caller copies the states back to the map, usually after
+// finishing with a few full-resolution iterations.
+void relaxDecimatedPoseGraph(
+    const CoarseToFineRelaxationOptions& options,
+    const ceres::Solver::Options& solver_options,
+    const vi_map::MissionIdSet& mission_ids, OptimizationProblem* problem);
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_COARSE_TO_FINE_RELAXATION_H_
@@ -0,0 +1,62 @@
+#ifndef MAP_OPTIMIZATION_INCREMENTAL_VI_MAP_RELAXATION_H_
+#define MAP_OPTIMIZATION_INCREMENTAL_VI_MAP_RELAXATION_H_
+
+#include <unordered_set>
+
+#include <ceres/ceres.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+
+#include "map-optimization/optimization-problem.h"
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace map_optimization {
+
+// Pose-graph relaxation that keeps its problem alive while loop closures are
+// added one after the other. Every update only optimizes the keyframe poses
+// within --relaxation_incremental_num_hops of the new loop closure edges and
+// holds the poses of the boundary constant, starting from the previous
+// solution. The loop closure edges must stay in the map for the lifetime of
+// the relaxation.
+class IncrementalVIMapRelaxation {
+ public:
+  // Builds the relaxation problem of the given missions including all loop
+  // closure edges already in the map. Nothing is optimized yet.
+  IncrementalVIMapRelaxation(
+      const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map);
+
+  // Adds the given loop closure edges and optimizes the poses around them.
+  // Edges that are already part of the problem or link vertices outside of
+  // it are skipped. Returns the vertices with updated poses, their poses are
+  // copied back to the map. Returns false if no edge was added.
+  bool addLoopClosureEdges(
+      const pose_graph::EdgeIdList& edge_ids,
+      pose_graph::VertexIdList* updated_vertices);
+
+  size_t numLoopClosureEdges() const {
+    return edges_in_problem_.size();
+  }
+
+ private:
+  void selectAffectedVertices(
+      const pose_graph::VertexIdList& seed_vertices,
+      pose_graph::VertexIdSet* affected_vertices) const;
+
+  // Adds all residual blocks that depend on one of the free parameter blocks.
+  // The remaining parameter blocks of these residuals are held constant.
+  void buildLocalCeresProblem(
+      const std::unordered_set<double*>& free_parameter_blocks,
+      ceres::Problem* problem);
+
+  vi_map::VIMap* const map_;
+  OptimizationProblem::UniquePtr optimization_problem_;
+  pose_graph::EdgeIdSet edges_in_problem_;
+  ceres::Solver::Options solver_options_;
+};
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_INCREMENTAL_VI_MAP_RELAXATION_H_
@@ -0,0 +1,59 @@
+#ifndef MAP_OPTIMIZATION_LOCAL_OPTIMIZATION_WINDOW_H_
+#define MAP_OPTIMIZATION_LOCAL_OPTIMIZATION_WINDOW_H_
+
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+namespace map_optimization {
+
+struct LocalOptimizationWindowOptions {
+  static LocalOptimizationWindowOptions initFromGFlags();
+
+  // Number of vertices the window is centered on. These are taken along the
+  // graph around the center vertex or as the latest vertices of a mission.
+  size_t num_core_vertices;
+  // Vertices that share at least min_num_covisible_landmarks landmarks with
+  // the core vertices are optimized as well, at most
+  // max_num_covisible_vertices of them.
+  size_t max_num_covisible_vertices;
+  size_t min_num_covisible_landmarks;
+  // Maximum number of vertices outside of the window whose observations of
+  // the window landmarks are kept as fixed constraints.
+  size_t max_num_fixed_vertices;
+
+ protected:
+  LocalOptimizationWindowOptions() = default;
+};
+
+// Problem of a local bundle adjustment: the vertices and landmarks to
+// optimize plus the boundary vertices that constrain them but stay fixed.
+struct LocalOptimizationWindow {
+  pose_graph::VertexIdList optimized_vertices;
+  pose_graph::VertexIdList fixed_vertices;
+  vi_map::LandmarkIdSet landmarks;
+  // Missions of all vertices in the window.
+  vi_map::MissionIdSet missions;
+};
+
+// Selects the window around the given vertices, which are expected in graph
+// order. The size of the window only depends on the options, not on the size
+// of the map.
+void selectLocalOptimizationWindow(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& core_vertices,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window);
+
+void selectLocalOptimizationWindowAroundVertex(
+    const vi_map::VIMap& map, const pose_graph::VertexId& center_vertex_id,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window);
+
+void selectLocalOptimizationWindowOfLatestVertices(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window);
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_LOCAL_OPTIMIZATION_WINDOW_H_
@@ -79,6 +79,24 @@ class OptimizationProblem {
     return &problem_books_;
   }
 
+  // If enabled, the ceres problem built by getCeresProblemMutable() is kept
+  // and reused by later calls as long as the problem information doesn't
+  // change, so successive solves skip rebuilding the problem. Disabled by
+  // default.
+  void setKeepCeresProblemAlive(const bool keep_ceres_problem_alive);
+  bool getKeepCeresProblemAlive() const {
+    return keep_ceres_problem_alive_;
+  }
+
+  // Returns a ceres problem built from the current problem information.
+  // Without keep-alive, a new problem is built on every call.
+  ceres::Problem* getCeresProblemMutable();
+  // Drops the kept ceres problem, e.g. after the map states were changed
+  // outside of the state buffer.
+  void resetCeresProblem() {
+    ceres_problem_.reset();
+  }
+
  private:
   // Map from which the problem has been built.
   vi_map::VIMap* const map_;
@@ -100,6 +118,11 @@ class OptimizationProblem {
 
   // Local parameterization that are used when adding cost terms.
   LocalParameterizations local_parameterizations_;
+
+  bool keep_ceres_problem_alive_;
+  std::unique_ptr<ceres::Problem> ceres_problem_;
+  // Revision of the problem information ceres_problem_ was built from.
+  size_t ceres_problem_revision_;
 };
 
 }  // namespace map_optimization
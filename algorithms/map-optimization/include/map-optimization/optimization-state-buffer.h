@@ -15,6 +15,10 @@ namespace map_optimization {
 // convention than the optimization expects, hence, it is buffered here.
 class OptimizationStateBuffer {
  public:
+  OptimizationStateBuffer() : map_(nullptr), copy_back_map_(nullptr) {}
+
+  // The vertices of the map must not be added or removed until the states are
+  // copied back.
   void importStatesOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
   void copyAllStatesBackToMap(vi_map::VIMap* map) const;
@@ -39,10 +43,23 @@ class OptimizationStateBuffer {
   void copyAllSensorCalibrationsBackToMap(vi_map::VIMap* map) const;
   void copyAllCameraCalibrationsBackToMap(vi_map::VIMap* map) const;
 
-  // Keyframe poses as a 7d vector: [q_IM_xyzw, M_p_MI]  (passive JPL).
-  std::unordered_map<pose_graph::VertexId, size_t> vertex_id_to_vertex_idx_;
+  // Map the states were imported from.
+  const vi_map::VIMap* map_;
+
+  // Keyframe poses as a 7d vector: [q_IM_xyzw, M_p_MI]  (passive JPL), stored
+  // in the column of the dense index of the vertex in the map. Only the
+  // columns of the imported vertices are set.
+  pose_graph::VertexIdList imported_vertex_ids_;
+  std::vector<size_t> imported_vertex_indices_;
+  std::vector<bool> is_vertex_imported_;
   Eigen::Matrix<double, 7, Eigen::Dynamic> vertex_q_IM__M_p_MI_;
 
+  // Vertices of imported_vertex_ids_, resolved on the first copy back to the
+  // given map. Later copies, e.g. from CopyBackToMapCallback, are a single
+  // pass over the buffer without id lookups.
+  mutable const vi_map::VIMap* copy_back_map_;
+  mutable std::vector<vi_map::Vertex*> copy_back_vertices_;
+
   // Mission baseframe poses as a 7d vector: [q_IM_xyzw, M_p_MI] (passive JPL).
   std::unordered_map<vi_map::MissionBaseFrameId, size_t>
       baseframe_id_to_baseframe_idx_;
@@ -80,5 +97,23 @@ inline void assertValidQuaternion(const Eigen::Quaterniond& quat) {
                                  << " is not valid. (norm=" << quat.norm()
                                  << ")";
 }
+// Batched version of assertValidQuaternion for the columns of a 4xN array of
+// quaternions [x, y, z, w].
+inline void assertValidQuaternions(const Eigen::Matrix4Xd& quats_xyzw) {
+  constexpr double kEpsilon = 1e-5;
+  const Eigen::Array<double, 1, Eigen::Dynamic> norms =
+      quats_xyzw.colwise().squaredNorm().array();
+  const Eigen::Array<bool, 1, Eigen::Dynamic> is_valid =
+      (quats_xyzw.row(3).array() > 0.0) &&
+      (norms < ((1.0 + kEpsilon) * (1.0 + kEpsilon))) &&
+      (norms > ((1.0 - kEpsilon) * (1.0 - kEpsilon)));
+  if (!is_valid.all()) {
+    for (int i = 0; i < quats_xyzw.cols(); ++i) {
+      if (!is_valid(i)) {
+        assertValidQuaternion(Eigen::Quaterniond(quats_xyzw.col(i).data()));
+      }
+    }
+  }
+}
 }  // namespace map_optimization
 #endif  // MAP_OPTIMIZATION_OPTIMIZATION_STATE_BUFFER_H_
@@ -20,6 +20,27 @@ inline void fixAllBaseframesInProblem(OptimizationProblem* problem) {
         ->setParameterBlockConstantIfPartOfTheProblem(baseframe_state);
   }
 }
+
+// Fixes the pose, velocity and IMU biases of the given vertices.
+inline void fixVertexStatesInProblem(
+    const pose_graph::VertexIdList& vertex_ids, OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  ceres_error_terms::ProblemInformation* problem_information =
+      problem->getProblemInformationMutable();
+  vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    problem_information->setParameterBlockConstantIfPartOfTheProblem(
+        problem->getOptimizationStateBufferMutable()
+            ->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+    problem_information->setParameterBlockConstantIfPartOfTheProblem(
+        vertex.get_v_M_Mutable());
+    problem_information->setParameterBlockConstantIfPartOfTheProblem(
+        vertex.getGyroBiasMutable());
+    problem_information->setParameterBlockConstantIfPartOfTheProblem(
+        vertex.getAccelBiasMutable());
+  }
+}
 }  // namespace map_optimization
 
 #endif  // MAP_OPTIMIZATION_OPTIMIZATION_STATE_FIXING_H_
@@ -7,6 +7,11 @@
 
 namespace map_optimization {
 
+// Implementation of the inertial error terms: kRungeKutta integrates the IMU
+// measurements at every evaluation, kPreintegrated preintegrates them once and
+// corrects for bias changes to first order.
+enum class InertialTermType { kRungeKutta, kPreintegrated };
+
 void addVisualTerms(
     const bool fix_landmark_positions, const bool fix_intrinsics,
     const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
@@ -23,6 +28,20 @@ void addVisualTermsForVertices(
         camera_parameterization,
     const pose_graph::VertexIdList& vertices, OptimizationProblem* problem);
 
+// Only adds the observations of the given landmarks. min_landmarks_per_frame
+// then only counts these landmarks.
+void addVisualTermsForVertices(
+    const bool fix_landmark_positions, const bool fix_intrinsics,
+    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
+    const size_t min_landmarks_per_frame,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    const pose_graph::VertexIdList& vertices,
+    const vi_map::LandmarkIdSet& landmarks, OptimizationProblem* problem);
+
 bool addVisualTermForKeypoint(
     const int keypoint_idx, const int frame_idx,
     const bool fix_landmark_positions, const bool fix_intrinsics,
@@ -37,11 +56,12 @@ bool addVisualTermForKeypoint(
 void addInertialTerms(
     const bool fix_gyro_bias, const bool fix_accel_bias,
     const bool fix_velocity, const double gravity_magnitude,
-    OptimizationProblem* problem);
+    const InertialTermType inertial_term_type, OptimizationProblem* problem);
 
 int addInertialTermsForEdges(
     const bool fix_gyro_bias, const bool fix_accel_bias,
     const bool fix_velocity, const double gravity_magnitude,
+    const InertialTermType inertial_term_type,
     const vi_map::ImuSigmas& imu_sigmas,
     const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
     const pose_graph::EdgeIdList& edges, OptimizationProblem* problem);
@@ -0,0 +1,57 @@
+#ifndef MAP_OPTIMIZATION_PARTITIONED_OPTIMIZATION_H_
+#define MAP_OPTIMIZATION_PARTITIONED_OPTIMIZATION_H_
+
+#include <vector>
+
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization/local-optimization-window.h"
+
+namespace map_optimization {
+
+struct PartitionedOptimizationOptions {
+  static PartitionedOptimizationOptions initFromGFlags();
+
+  // Number of METIS partitions of the map. The partitions are further split
+  // along the landmark coobservation clusters of the missions, so the final
+  // number of partitions can be larger.
+  size_t num_partitions;
+  // Number of alternations between the partition problems and the separator
+  // problem.
+  size_t num_iterations;
+
+ protected:
+  PartitionedOptimizationOptions() = default;
+};
+
+// Problems of a partitioned bundle adjustment. Vertices that share landmarks
+// or inertial edges with another partition are separator vertices, landmarks
+// observed from more than one partition are separator landmarks.
+struct PartitionedOptimizationWindows {
+  // One window per partition: the interior vertices and landmarks of the
+  // partition are optimized, its separator vertices stay fixed.
+  std::vector<LocalOptimizationWindow> partition_windows;
+  // The separator vertices and landmarks, constrained by the fixed interior
+  // vertices they share inertial edges with.
+  LocalOptimizationWindow separator_window;
+};
+
+// Partitions the vertices of the given missions with METIS. A partition never
+// spans two missions without landmark coobservations.
+void partitionMissionsForOptimization(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& missions,
+    const size_t num_partitions,
+    std::vector<pose_graph::VertexIdList>* partitions);
+
+// Derives the partition and separator problems from disjoint lists of
+// vertices.
+void selectPartitionedOptimizationWindows(
+    const vi_map::VIMap& map,
+    const std::vector<pose_graph::VertexIdList>& partitions,
+    PartitionedOptimizationWindows* windows);
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_PARTITIONED_OPTIMIZATION_H_
@@ -0,0 +1,49 @@
+#ifndef MAP_OPTIMIZATION_SOLVER_BACKEND_H_
+#define MAP_OPTIMIZATION_SOLVER_BACKEND_H_
+
+#include <memory>
+#include <string>
+
+#include <ceres-error-terms/problem-information.h>
+#include <ceres/ceres.h>
+
+#include "map-optimization/optimization-problem.h"
+
+DECLARE_string(ba_solver_backend);
+
+namespace map_optimization {
+
+// Alternative solver of an optimization problem, e.g. on an accelerator.
+// Backends are registered by name and selected with --ba_solver_backend;
+// ceres is used for problems the selected backend doesn't support.
+class SolverBackend {
+ public:
+  virtual ~SolverBackend() {}
+
+  virtual bool supportsProblem(
+      const ceres_error_terms::ProblemInformation& problem_information)
+      const = 0;
+
+  // Optimizes the states in the state buffer of the problem. The caller
+  // copies them back to the map.
+  virtual ceres::TerminationType solve(
+      const ceres::Solver::Options& solver_options,
+      OptimizationProblem* optimization_problem) = 0;
+};
+
+// Replaces a backend registered under the same name. "ceres" is reserved.
+void registerSolverBackend(
+    const std::string& name, std::unique_ptr<SolverBackend> backend);
+void unregisterSolverBackend(const std::string& name);
+
+// Returns nullptr for the default ceres solver. CHECK-fails if the selected
+// backend was not registered.
+SolverBackend* getSolverBackendFromFlags();
+
+// True if the problem only has active reprojection, inertial and pose prior
+// terms, i.e. the visual-inertial subset batched backends usually cover.
+bool hasOnlyVisualInertialTerms(
+    const ceres_error_terms::ProblemInformation& problem_information);
+
+}  // namespace map_optimization
+#endif  // MAP_OPTIMIZATION_SOLVER_BACKEND_H_
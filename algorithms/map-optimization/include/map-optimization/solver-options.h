@@ -2,6 +2,7 @@
 #define MAP_OPTIMIZATION_SOLVER_OPTIONS_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <ceres/ceres.h>
@@ -9,6 +10,7 @@
 
 DECLARE_int32(ba_num_iterations);
 DECLARE_bool(ba_use_cgnr_linear_solver);
+DECLARE_string(ba_linear_solver_type);
 DECLARE_bool(ba_use_jacobi_scaling);
 
 namespace map_optimization {
@@ -30,7 +32,18 @@ inline ceres::Solver::Options initSolverOptionsFromFlags() {
   if (FLAGS_ba_use_cgnr_linear_solver) {
     options.linear_solver_type = ceres::CGNR;
   } else {
-    options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+    CHECK(ceres::StringToLinearSolverType(
+        FLAGS_ba_linear_solver_type, &options.linear_solver_type))
+        << "Unknown linear solver type: " << FLAGS_ba_linear_solver_type;
+  }
+
+  // Settings for the Schur-type solvers, which eliminate the landmarks using
+  // the ordering from setLinearSolverOrdering. With the rather small camera
+  // blocks of VI problems, the explicit Schur complement is cheaper than
+  // repeated implicit evaluations in the iterative solver.
+  if (options.linear_solver_type == ceres::ITERATIVE_SCHUR) {
+    options.preconditioner_type = ceres::SCHUR_JACOBI;
+    options.use_explicit_schur_complement = true;
   }
 
   options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
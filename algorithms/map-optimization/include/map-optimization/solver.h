@@ -1,10 +1,31 @@
 #ifndef MAP_OPTIMIZATION_SOLVER_H_
 #define MAP_OPTIMIZATION_SOLVER_H_
 
+#include <ceres/ceres.h>
+
 #include "map-optimization/optimization-problem.h"
 
 namespace map_optimization {
 
+// Elimination groups of the Schur-type linear solvers, eliminated in this
+// order.
+enum class ParameterBlockGroup : int {
+  kLandmarks = 0,
+  kVertexStates = 1,
+  kCalibrationAndBaseframes = 2
+};
+
+// For SPARSE_SCHUR and ITERATIVE_SCHUR, sets an explicit elimination ordering
+// of all parameter blocks in ceres_problem: landmarks first, then the poses,
+// velocities and biases of the keyframes, then everything else. The ordering
+// of other linear solvers is left untouched.
+void setLinearSolverOrdering(
+    const ceres::Problem& ceres_problem,
+    OptimizationProblem* optimization_problem,
+    ceres::Solver::Options* solver_options);
+
+// Uses the backend selected with --ba_solver_backend if it supports the
+// problem, ceres otherwise.
 ceres::TerminationType solve(
     const ceres::Solver::Options& solver_options,
     map_optimization::OptimizationProblem* optimization_problem);
@@ -0,0 +1,65 @@
+#ifndef MAP_OPTIMIZATION_TIME_BUDGETED_OPTIMIZATION_H_
+#define MAP_OPTIMIZATION_TIME_BUDGETED_OPTIMIZATION_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization/local-optimization-window.h"
+#include "map-optimization/optimization-problem.h"
+
+namespace map_optimization {
+
+struct TimeBudgetedOptimizationOptions {
+  static TimeBudgetedOptimizationOptions initFromGFlags();
+
+  bool isEnabled() const {
+    return time_budget_seconds > 0.0;
+  }
+
+  // Wall time of the whole optimization, including the construction of the
+  // problems. Disabled if not positive.
+  double time_budget_seconds;
+  // Number of solves. All but the last one optimize a growing window around
+  // the highest priority vertices, the last one all missions.
+  size_t num_stages;
+  // Vertices of the newest missions by timestamp, which are usually the ones
+  // that were just merged, are solved before all others.
+  size_t num_prioritized_missions;
+  // Stages are skipped once less time than this is left.
+  double min_stage_time_seconds;
+
+ protected:
+  TimeBudgetedOptimizationOptions() = default;
+};
+
+typedef std::unordered_map<pose_graph::VertexId, double> VertexCostMap;
+
+// Evaluates all active residual blocks of the problem at the current states
+// of its state buffer. Every vertex gets the mean robustified cost of the
+// residuals its pose takes part in.
+void computeMeanResidualCostPerVertex(
+    OptimizationProblem* optimization_problem, VertexCostMap* vertex_costs);
+
+// Sorts the vertices of the given missions by decreasing priority: the
+// vertices of the prioritized missions come first, each group ordered by
+// decreasing cost. Vertices without cost are at the end of their group.
+void sortVerticesByOptimizationPriority(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& missions,
+    const vi_map::MissionIdSet& prioritized_missions,
+    const VertexCostMap& vertex_costs, pose_graph::VertexIdList* vertices);
+
+// Selects the windows of all but the last stage. The core of window i are the
+// first (i + 1) / num_stages of the prioritized vertices.
+void selectTimeBudgetedOptimizationWindows(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& sorted_vertices,
+    const TimeBudgetedOptimizationOptions& options,
+    const LocalOptimizationWindowOptions& window_options,
+    std::vector<LocalOptimizationWindow>* windows);
+
+}  // namespace map_optimization
+
+#endif  // MAP_OPTIMIZATION_TIME_BUDGETED_OPTIMIZATION_H_
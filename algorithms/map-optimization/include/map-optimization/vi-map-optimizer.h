@@ -1,10 +1,15 @@
 #ifndef MAP_OPTIMIZATION_VI_MAP_OPTIMIZER_H_
 #define MAP_OPTIMIZATION_VI_MAP_OPTIMIZER_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <ceres/ceres.h>
+#include <map-optimization/local-optimization-window.h>
 #include <map-optimization/outlier-rejection-solver.h>
+#include <map-optimization/partitioned-optimization.h>
+#include <map-optimization/time-budgeted-optimization.h>
 #include <map-optimization/vi-optimization-builder.h>
 #include <vi-map/unique-id.h>
 
@@ -31,6 +36,7 @@ class VIMapOptimizer {
           outlier_rejection_options,
       vi_map::VIMap* map);
 
+  // Runs a time budgeted optimization if --ba_time_budget_seconds is set.
   bool optimizeVisualInertial(
       const map_optimization::ViProblemOptions& options,
       const ceres::Solver::Options& solver_options,
@@ -39,7 +45,69 @@ class VIMapOptimizer {
           outlier_rejection_options,
       vi_map::VIMap* map);
 
+  // Local bundle adjustment of the given window. The solver time is bounded
+  // by --ba_local_max_solver_time_seconds.
+  bool optimizeLocalVisualInertial(
+      const map_optimization::ViProblemOptions& options,
+      const map_optimization::LocalOptimizationWindow& window,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
+  bool optimizeLocalVisualInertial(
+      const map_optimization::ViProblemOptions& options,
+      const ceres::Solver::Options& solver_options,
+      const map_optimization::LocalOptimizationWindow& window,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
+  // Partitioned bundle adjustment of the given missions. The partitions are
+  // optimized one after the other with their separator vertices fixed, then
+  // the separator vertices and landmarks are optimized with the interior
+  // vertices fixed. This is repeated for the configured number of iterations.
+  bool optimizePartitionedVisualInertial(
+      const map_optimization::ViProblemOptions& options,
+      const map_optimization::PartitionedOptimizationOptions&
+          partitioned_options,
+      const vi_map::MissionIdSet& missions_to_optimize,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
+  // Anytime optimization of the given missions within a wall time budget.
+  // The vertices of the newest missions and those with the highest residual
+  // cost are optimized first, in windows that grow with every stage, and the
+  // last stage optimizes all missions. The states are copied back to the map
+  // after every stage, so the map is consistent whenever the budget runs out.
+  bool optimizeTimeBudgetedVisualInertial(
+      const map_optimization::ViProblemOptions& options,
+      const map_optimization::TimeBudgetedOptimizationOptions&
+          time_budget_options,
+      const ceres::Solver::Options& solver_options,
+      const vi_map::MissionIdSet& missions_to_optimize,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      vi_map::VIMap* map);
+
  private:
+  void solve(
+      const ceres::Solver::Options& solver_options,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      map_optimization::OptimizationProblem* optimization_problem,
+      vi_map::VIMap* map);
+
+  // Same as above with additional callbacks that run before the
+  // visualization and signal handler callbacks.
+  void solve(
+      std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks,
+      const ceres::Solver::Options& solver_options,
+      const map_optimization::OutlierRejectionSolverOptions* const
+          outlier_rejection_options,
+      map_optimization::OptimizationProblem* optimization_problem,
+      vi_map::VIMap* map);
+
   visualization::ViwlsGraphRvizPlotter* plotter_;
   bool signal_handler_enabled_;
 };
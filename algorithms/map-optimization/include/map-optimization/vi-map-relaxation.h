@@ -4,6 +4,7 @@
 #include <string>
 
 #include <ceres/ceres.h>
+#include <map-optimization/vi-optimization-builder.h>
 #include <vi-map/unique-id.h>
 
 namespace visualization {
@@ -17,6 +18,10 @@ class VIMap;
 namespace map_optimization {
 struct OptimizationOptions;
 
+// Problem options of a pose-graph relaxation: only the keyframe poses are
+// optimized, all other states stay fixed.
+ViProblemOptions initRelaxationProblemOptionsFromGFlags();
+
 class VIMapRelaxation {
  public:
   VIMapRelaxation(
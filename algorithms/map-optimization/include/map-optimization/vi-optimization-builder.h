@@ -10,6 +10,7 @@
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
 
+#include "map-optimization/local-optimization-window.h"
 #include "map-optimization/optimization-problem.h"
 #include "map-optimization/optimization-terms-addition.h"
 
@@ -25,6 +26,7 @@ struct ViProblemOptions {
   bool fix_velocity;
   size_t min_landmarks_per_frame;
   double gravity_magnitude = std::numeric_limits<double>::quiet_NaN();
+  InertialTermType inertial_term_type;
 
   // Visual constraints.
   bool add_visual_constraints;
@@ -46,5 +48,12 @@ OptimizationProblem* constructViProblem(
     const vi_map::MissionIdSet& mission_ids, const ViProblemOptions& options,
     vi_map::VIMap* map);
 
+// Builds the problem of a local bundle adjustment. The fixed vertices of the
+// window fix the gauge, so no further gauge fixes are applied.
+// Caller takes ownership.
+OptimizationProblem* constructLocalViProblem(
+    const LocalOptimizationWindow& window, const ViProblemOptions& options,
+    vi_map::VIMap* map);
+
 }  // namespace map_optimization
 #endif  // MAP_OPTIMIZATION_VI_OPTIMIZATION_BUILDER_H_
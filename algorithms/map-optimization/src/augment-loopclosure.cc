@@ -1,12 +1,75 @@
 #include "map-optimization/augment-loopclosure.h"
 
+#include <ceres-error-terms/loop-closure-edge-error-term-analytic.h>
 #include <ceres-error-terms/loop-closure-edge-error-term.h>
 #include <ceres-error-terms/switch-prior-error-term.h>
+#include <gflags/gflags.h>
+
+DEFINE_bool(
+    lc_edge_use_analytic_jacobians, true,
+    "Use the loop closure error terms with analytic Jacobians instead of "
+    "automatic differentiation.");
 
 namespace map_optimization {
 
 namespace {
 
+std::shared_ptr<ceres::CostFunction> createLoopClosureCostFunction(
+    const Eigen::Matrix<double, 7, 1>& q_AB__A_p_AB,
+    const aslam::TransformationCovariance& T_A_B_covariance,
+    const bool vertices_are_in_same_baseframe,
+    const bool use_switchable_constraints,
+    ceres_error_terms::ProblemInformation* problem_information) {
+  CHECK_NOTNULL(problem_information);
+  using ceres_error_terms::LoopClosureEdgeErrorTerm;
+  using ceres_error_terms::SwitchVariable;
+
+  if (!FLAGS_lc_edge_use_analytic_jacobians) {
+    if (vertices_are_in_same_baseframe) {
+      return std::shared_ptr<ceres::CostFunction>(
+          new ceres::AutoDiffCostFunction<
+              LoopClosureEdgeErrorTerm,
+              LoopClosureEdgeErrorTerm::kResidualBlockSize,
+              ceres_error_terms::poseblocks::kPoseSize,
+              ceres_error_terms::poseblocks::kPoseSize,
+              LoopClosureEdgeErrorTerm::kSwitchVariableBlockSize>(
+              new LoopClosureEdgeErrorTerm(q_AB__A_p_AB, T_A_B_covariance)));
+    }
+    return std::shared_ptr<ceres::CostFunction>(
+        new ceres::AutoDiffCostFunction<
+            LoopClosureEdgeErrorTerm,
+            LoopClosureEdgeErrorTerm::kResidualBlockSize,
+            ceres_error_terms::poseblocks::kPoseSize,
+            ceres_error_terms::poseblocks::kPoseSize,
+            ceres_error_terms::poseblocks::kPoseSize,
+            ceres_error_terms::poseblocks::kPoseSize,
+            LoopClosureEdgeErrorTerm::kSwitchVariableBlockSize>(
+            new LoopClosureEdgeErrorTerm(q_AB__A_p_AB, T_A_B_covariance)));
+  }
+
+  // Without switchable constraints the switch variable is set constant.
+  using ceres_error_terms::LoopClosureEdgeBaseframeErrorTermAnalytic;
+  using ceres_error_terms::LoopClosureEdgeErrorTermAnalytic;
+  if (vertices_are_in_same_baseframe) {
+    if (use_switchable_constraints) {
+      return problem_information->createCostFunction<
+          LoopClosureEdgeErrorTermAnalytic<SwitchVariable::kFree>>(
+          q_AB__A_p_AB, T_A_B_covariance);
+    }
+    return problem_information->createCostFunction<
+        LoopClosureEdgeErrorTermAnalytic<SwitchVariable::kFixed>>(
+        q_AB__A_p_AB, T_A_B_covariance);
+  }
+  if (use_switchable_constraints) {
+    return problem_information->createCostFunction<
+        LoopClosureEdgeBaseframeErrorTermAnalytic<SwitchVariable::kFree>>(
+        q_AB__A_p_AB, T_A_B_covariance);
+  }
+  return problem_information->createCostFunction<
+      LoopClosureEdgeBaseframeErrorTermAnalytic<SwitchVariable::kFixed>>(
+      q_AB__A_p_AB, T_A_B_covariance);
+}
+
 void addLoopclosureEdges(
     const pose_graph::EdgeIdList& provided_edges,
     const bool use_switchable_constraints, const double cauchy_loss,
@@ -67,46 +130,32 @@ void addLoopclosureEdges(
     const bool vertices_are_in_same_baseframe =
         from_baseframe_id == to_baseframe_id;
 
-    // We only add one baseframe transformation for both vertices if
-    // they are part of the same mission.
-    using ceres_error_terms::LoopClosureEdgeErrorTerm;
-
     // In the current implementation, we reject outliers either using
     // switchable constraints or the Cauchy loss function. We never use both.
     std::shared_ptr<ceres::LossFunction> loss_function = nullptr;
     if (!use_switchable_constraints) {
       if (cauchy_loss > 0.0) {
-        loss_function.reset(new ceres::CauchyLoss(cauchy_loss));
+        loss_function =
+            problem_information->getSharedLossFunction<ceres::CauchyLoss>(
+                ceres_error_terms::ResidualType::kLoopClosure, cauchy_loss);
       }
       problem_information->setParameterBlockConstant(
           loop_closure_edge.getSwitchVariableMutable());
     }
 
+    std::shared_ptr<ceres::CostFunction> loop_closure_cost =
+        createLoopClosureCostFunction(
+            q_AB__A_p_AB, T_A_B_covariance, vertices_are_in_same_baseframe,
+            use_switchable_constraints, problem_information);
+
+    // We only add one baseframe transformation for both vertices if
+    // they are part of the same mission.
     if (vertices_are_in_same_baseframe) {
-      std::shared_ptr<ceres::CostFunction> loop_closure_cost(
-          new ceres::AutoDiffCostFunction<
-              LoopClosureEdgeErrorTerm,
-              LoopClosureEdgeErrorTerm::kResidualBlockSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              LoopClosureEdgeErrorTerm::kSwitchVariableBlockSize>(
-              new LoopClosureEdgeErrorTerm(q_AB__A_p_AB, T_A_B_covariance)));
       problem_information->addResidualBlock(
           ceres_error_terms::ResidualType::kLoopClosure, loop_closure_cost,
           loss_function, {vertex_from_q_IM__M_p_MI, vertex_to_q_IM__M_p_MI,
                           loop_closure_edge.getSwitchVariableMutable()});
     } else {
-      std::shared_ptr<ceres::CostFunction> loop_closure_cost(
-          new ceres::AutoDiffCostFunction<
-              LoopClosureEdgeErrorTerm,
-              LoopClosureEdgeErrorTerm::kResidualBlockSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              ceres_error_terms::poseblocks::kPoseSize,
-              LoopClosureEdgeErrorTerm::kSwitchVariableBlockSize>(
-              new LoopClosureEdgeErrorTerm(q_AB__A_p_AB, T_A_B_covariance)));
-
       double* baseframe_from_q_GM__G_p_GM =
           buffer->get_baseframe_q_GM__G_p_GM_JPL(from_baseframe_id);
       double* baseframe_to_q_GM__G_p_GM =
@@ -178,16 +227,14 @@ void addLoopclosureEdges(
 
 }  // namespace
 
-void augmentViProblemWithLoopclosureEdges(OptimizationProblem* problem) {
-  CHECK_NOTNULL(problem);
-
-  const vi_map::VIMap& map = *CHECK_NOTNULL(problem->getMapMutable());
-  const vi_map::MissionIdSet& missions_to_optimize = problem->getMissionIds();
+void getLoopclosureEdgesOfMissions(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids,
+    pose_graph::EdgeIdList* loop_closure_edges) {
+  CHECK_NOTNULL(loop_closure_edges)->clear();
 
   pose_graph::EdgeIdList edges;
   map.getAllEdgeIds(&edges);
 
-  pose_graph::EdgeIdList lc_edges;
   for (const pose_graph::EdgeId& edge_id : edges) {
     if (map.getEdgeType(edge_id) == pose_graph::Edge::EdgeType::kLoopClosure) {
       const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
@@ -196,14 +243,29 @@ void augmentViProblemWithLoopclosureEdges(OptimizationProblem* problem) {
 
       // Only optimize the edge if it links vertices of missions that are
       // suppposed to be optimized.
-      if (missions_to_optimize.count(vertex_from.getMissionId()) > 0u &&
-          missions_to_optimize.count(vertex_to.getMissionId()) > 0u) {
-        lc_edges.push_back(edge_id);
+      if (mission_ids.count(vertex_from.getMissionId()) > 0u &&
+          mission_ids.count(vertex_to.getMissionId()) > 0u) {
+        loop_closure_edges->push_back(edge_id);
       }
     }
   }
+}
 
-  addLoopclosureEdges(lc_edges, true, 0, problem);
+void augmentViProblemWithLoopclosureEdges(OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+
+  pose_graph::EdgeIdList lc_edges;
+  getLoopclosureEdgesOfMissions(
+      *CHECK_NOTNULL(problem->getMapMutable()), problem->getMissionIds(),
+      &lc_edges);
+  augmentViProblemWithLoopclosureEdges(lc_edges, problem);
+}
+
+void augmentViProblemWithLoopclosureEdges(
+    const pose_graph::EdgeIdList& loop_closure_edges,
+    OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
+  addLoopclosureEdges(loop_closure_edges, true, 0, problem);
 }
 
 }  // namespace map_optimization
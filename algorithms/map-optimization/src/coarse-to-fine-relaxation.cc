@@ -0,0 +1,302 @@
+#include "map-optimization/coarse-to-fine-relaxation.h"
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <aslam/common/memory.h>
+#include <ceres-error-terms/problem-information.h>
+#include <ceres-error-terms/six-dof-block-pose-error-term-analytic.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/pose_types.h>
+#include <vi-map/vi-map.h>
+
+#include "map-optimization/optimization-state-buffer.h"
+
+DEFINE_int32(
+    relaxation_coarse_to_fine_vertex_stride, 0,
+    "If larger than 1, the relaxation first optimizes a pose graph made of "
+    "every n-th vertex of each mission plus the loop closure endpoints and "
+    "interpolates the result to the other vertices before optimizing at full "
+    "resolution.");
+DEFINE_int32(
+    relaxation_coarse_to_fine_num_fine_iterations, 10,
+    "Number of full-resolution iterations after the coarse relaxation.");
+DEFINE_double(
+    relaxation_coarse_to_fine_position_sigma_m, 0.05,
+    "Position standard deviation of the relative pose between two "
+    "consecutive vertices in the coarse relaxation.");
+DEFINE_double(
+    relaxation_coarse_to_fine_orientation_sigma_rad, 0.01,
+    "Orientation standard deviation of the relative pose between two "
+    "consecutive vertices in the coarse relaxation.");
+
+namespace map_optimization {
+namespace {
+
+pose::Transformation getPose(const double* q_IM__M_p_MI) {
+  CHECK_NOTNULL(q_IM__M_p_MI);
+  // The JPL quaternion q_IM has the coefficients of the Hamilton q_M_I.
+  const Eigen::Map<const Eigen::Quaterniond> q_M_I(q_IM__M_p_MI);
+  const Eigen::Map<const Eigen::Vector3d> p_M_I(q_IM__M_p_MI + 4);
+  return pose::Transformation(
+      pose::Quaternion(Eigen::Quaterniond(q_M_I)), p_M_I);
+}
+
+void setPose(
+    const Eigen::Quaterniond& q_M_I, const Eigen::Vector3d& p_M_I,
+    double* q_IM__M_p_MI) {
+  CHECK_NOTNULL(q_IM__M_p_MI);
+  Eigen::Map<Eigen::Vector4d> q_IM(q_IM__M_p_MI);
+  q_IM = q_M_I.normalized().coeffs();
+  ensurePositiveQuaternion(q_IM);
+  Eigen::Map<Eigen::Vector3d>(q_IM__M_p_MI + 4) = p_M_I;
+}
+
+// Vertices of a mission in the problem, in graph order.
+struct DecimatedMission {
+  pose_graph::VertexIdList vertex_ids;
+  std::vector<double*> pose_blocks;
+  Aligned<std::vector, pose::Transformation> T_M_I_initial;
+  std::vector<size_t> kept_indices;
+};
+
+// Moves the vertices between two kept vertices along with them. Each vertex
+// keeps its pose relative to both neighbors, the two resulting poses are
+// blended by the distance along the graph.
+void interpolateCorrections(const DecimatedMission& mission) {
+  for (size_t kept_idx = 1u; kept_idx < mission.kept_indices.size();
+       ++kept_idx) {
+    const size_t begin = mission.kept_indices[kept_idx - 1u];
+    const size_t end = mission.kept_indices[kept_idx];
+    const pose::Transformation T_M_begin = getPose(mission.pose_blocks[begin]);
+    const pose::Transformation T_M_end = getPose(mission.pose_blocks[end]);
+    const pose::Transformation T_begin_M_initial =
+        mission.T_M_I_initial[begin].inverse();
+    const pose::Transformation T_end_M_initial =
+        mission.T_M_I_initial[end].inverse();
+    for (size_t idx = begin + 1u; idx < end; ++idx) {
+      const pose::Transformation T_M_I_from_begin =
+          T_M_begin * T_begin_M_initial * mission.T_M_I_initial[idx];
+      const pose::Transformation T_M_I_from_end =
+          T_M_end * T_end_M_initial * mission.T_M_I_initial[idx];
+      const double fraction =
+          static_cast<double>(idx - begin) / static_cast<double>(end - begin);
+      const Eigen::Quaterniond q_M_I =
+          T_M_I_from_begin.getRotation().toImplementation().slerp(
+              fraction, T_M_I_from_end.getRotation().toImplementation());
+      const Eigen::Vector3d p_M_I =
+          (1.0 - fraction) * T_M_I_from_begin.getPosition() +
+          fraction * T_M_I_from_end.getPosition();
+      setPose(q_M_I, p_M_I, mission.pose_blocks[idx]);
+    }
+  }
+}
+
+}  // namespace
+
+CoarseToFineRelaxationOptions CoarseToFineRelaxationOptions::initFromGFlags() {
+  CHECK_GE(FLAGS_relaxation_coarse_to_fine_vertex_stride, 0);
+  CHECK_GE(FLAGS_relaxation_coarse_to_fine_num_fine_iterations, 0);
+  CHECK_GT(FLAGS_relaxation_coarse_to_fine_position_sigma_m, 0.0);
+  CHECK_GT(FLAGS_relaxation_coarse_to_fine_orientation_sigma_rad, 0.0);
+
+  CoarseToFineRelaxationOptions options;
+  options.vertex_stride =
+      static_cast<size_t>(FLAGS_relaxation_coarse_to_fine_vertex_stride);
+  options.num_fine_iterations =
+      FLAGS_relaxation_coarse_to_fine_num_fine_iterations;
+  options.position_sigma_m = FLAGS_relaxation_coarse_to_fine_position_sigma_m;
+  options.orientation_sigma_rad =
+      FLAGS_relaxation_coarse_to_fine_orientation_sigma_rad;
+  return options;
+}
+
+void selectDecimatedVertexIndices(
+    const pose_graph::VertexIdList& vertices_along_graph,
+    const size_t vertex_stride,
+    const pose_graph::VertexIdSet& loop_closure_vertices,
+    std::vector<size_t>* kept_indices) {
+  CHECK_NOTNULL(kept_indices)->clear();
+  CHECK_GT(vertex_stride, 0u);
+  const size_t num_vertices = vertices_along_graph.size();
+  for (size_t idx = 0u; idx < num_vertices; ++idx) {
+    if (idx % vertex_stride == 0u || idx + 1u == num_vertices ||
+        loop_closure_vertices.count(vertices_along_graph[idx]) > 0u) {
+      kept_indices->push_back(idx);
+    }
+  }
+}
+
+void relaxDecimatedPoseGraph(
+    const CoarseToFineRelaxationOptions& options,
+    const ceres::Solver::Options& solver_options,
+    const vi_map::MissionIdSet& mission_ids, OptimizationProblem* problem) {
+  CHECK(options.isEnabled());
+  CHECK_NOTNULL(problem);
+  const vi_map::VIMap& map = *CHECK_NOTNULL(problem->getMapMutable());
+  OptimizationStateBuffer* buffer =
+      CHECK_NOTNULL(problem->getOptimizationStateBufferMutable());
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+  const std::unordered_set<pose_graph::VertexId>& keyframes_in_problem =
+      problem->getProblemBookkeepingMutable()->keyframes_in_problem;
+  const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization =
+      problem->getLocalParameterizations().pose_parameterization;
+
+  pose_graph::VertexIdSet loop_closure_vertices;
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIds(&edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    if (map.getEdgeType(edge_id) == pose_graph::Edge::EdgeType::kLoopClosure) {
+      const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
+      loop_closure_vertices.insert(edge.from());
+      loop_closure_vertices.insert(edge.to());
+    }
+  }
+
+  std::vector<DecimatedMission> missions;
+  missions.reserve(mission_ids.size());
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+    missions.emplace_back();
+    DecimatedMission& mission = missions.back();
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      if (keyframes_in_problem.count(vertex_id) > 0u) {
+        mission.vertex_ids.push_back(vertex_id);
+        mission.pose_blocks.push_back(
+            buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+        mission.T_M_I_initial.push_back(
+            getPose(mission.pose_blocks.back()));
+      }
+    }
+    selectDecimatedVertexIndices(
+        mission.vertex_ids, options.vertex_stride, loop_closure_vertices,
+        &mission.kept_indices);
+  }
+
+  ceres::Problem coarse_problem(ceres_error_terms::getDefaultProblemOptions());
+  std::unordered_set<double*> vertex_blocks;
+  std::unordered_set<double*> parameter_blocks;
+
+  // Relative pose terms between consecutive kept vertices, such that the
+  // odometry of the skipped vertices is preserved.
+  std::vector<std::shared_ptr<ceres::CostFunction>> odometry_costs;
+  size_t num_kept_vertices = 0u;
+  size_t num_vertices = 0u;
+  for (const DecimatedMission& mission : missions) {
+    num_vertices += mission.vertex_ids.size();
+    num_kept_vertices += mission.kept_indices.size();
+    for (size_t kept_idx = 1u; kept_idx < mission.kept_indices.size();
+         ++kept_idx) {
+      const size_t begin = mission.kept_indices[kept_idx - 1u];
+      const size_t end = mission.kept_indices[kept_idx];
+      const double num_steps = static_cast<double>(end - begin);
+      Eigen::Matrix<double, 6, 6> T_A_B_covariance =
+          Eigen::Matrix<double, 6, 6>::Zero();
+      T_A_B_covariance.diagonal().head<3>().setConstant(
+          num_steps * options.position_sigma_m * options.position_sigma_m);
+      T_A_B_covariance.diagonal().tail<3>().setConstant(
+          num_steps * options.orientation_sigma_rad *
+          options.orientation_sigma_rad);
+      odometry_costs.emplace_back(
+          problem_information->createCostFunction<
+              ceres_error_terms::SixDoFBlockPoseErrorTermAnalytic>(
+              mission.T_M_I_initial[begin].inverse() *
+                  mission.T_M_I_initial[end],
+              T_A_B_covariance));
+      coarse_problem.AddResidualBlock(
+          odometry_costs.back().get(), nullptr, mission.pose_blocks[begin],
+          mission.pose_blocks[end]);
+      vertex_blocks.insert(mission.pose_blocks[begin]);
+      vertex_blocks.insert(mission.pose_blocks[end]);
+    }
+  }
+  parameter_blocks.insert(vertex_blocks.begin(), vertex_blocks.end());
+
+  // The loop closure terms of the full problem only depend on kept vertices.
+  // Their switch variables and baseframes are taken over as well.
+  for (const ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& residual_information_item :
+       problem_information->residual_blocks) {
+    const ceres_error_terms::ResidualInformation& residual_information =
+        residual_information_item.second;
+    if (!residual_information.active_ ||
+        (residual_information.residual_type !=
+             ceres_error_terms::ResidualType::kLoopClosure &&
+         residual_information.residual_type !=
+             ceres_error_terms::ResidualType::kSwitchVariable)) {
+      continue;
+    }
+    coarse_problem.AddResidualBlock(
+        residual_information.cost_function.get(),
+        residual_information.loss_function.get(),
+        residual_information.parameter_blocks);
+    parameter_blocks.insert(
+        residual_information.parameter_blocks.begin(),
+        residual_information.parameter_blocks.end());
+  }
+
+  for (double* parameter_block : parameter_blocks) {
+    const ceres_error_terms::ProblemInformation::ParameterizationsMap::
+        const_iterator parameterization_it =
+            problem_information->parameterizations.find(parameter_block);
+    const bool has_parameterization =
+        parameterization_it != problem_information->parameterizations.end();
+    if (vertex_blocks.count(parameter_block) > 0u) {
+      coarse_problem.SetParameterization(
+          parameter_block, pose_parameterization.get());
+      // Vertices with a gauge fixing parameterization are held constant
+      // entirely, the coarse problem has no inertial terms that constrain
+      // the remaining degrees of freedom.
+      if ((has_parameterization &&
+           parameterization_it->second != pose_parameterization) ||
+          problem_information->isParameterBlockConstant(parameter_block)) {
+        coarse_problem.SetParameterBlockConstant(parameter_block);
+      }
+      continue;
+    }
+    if (has_parameterization) {
+      coarse_problem.SetParameterization(
+          parameter_block, parameterization_it->second.get());
+    }
+    const ceres_error_terms::ProblemInformation::ParameterBoundMap::
+        const_iterator bound_it =
+            problem_information->parameter_bounds.find(parameter_block);
+    if (bound_it != problem_information->parameter_bounds.end()) {
+      coarse_problem.SetParameterLowerBound(
+          parameter_block, bound_it->second.index_in_param_block,
+          bound_it->second.lower_bound);
+      coarse_problem.SetParameterUpperBound(
+          parameter_block, bound_it->second.index_in_param_block,
+          bound_it->second.upper_bound);
+    }
+    if (problem_information->isParameterBlockConstant(parameter_block)) {
+      coarse_problem.SetParameterBlockConstant(parameter_block);
+    }
+  }
+
+  if (coarse_problem.NumResidualBlocks() == 0) {
+    LOG(WARNING) << "The decimated pose graph has no terms, skipping the "
+                 << "coarse relaxation.";
+    return;
+  }
+  LOG(INFO) << "Coarse relaxation of " << num_kept_vertices << " of "
+            << num_vertices << " vertices.";
+  ceres::Solver::Options coarse_solver_options = solver_options;
+  coarse_solver_options.callbacks.clear();
+  ceres::Solver::Summary summary;
+  ceres::Solve(coarse_solver_options, &coarse_problem, &summary);
+  VLOG(1) << summary.BriefReport();
+
+  for (const DecimatedMission& mission : missions) {
+    interpolateCorrections(mission);
+  }
+}
+
+}  // namespace map_optimization
@@ -0,0 +1,224 @@
+#include "map-optimization/incremental-vi-map-relaxation.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include <ceres-error-terms/problem-information.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <map-optimization/augment-loopclosure.h>
+#include <map-optimization/solver-options.h>
+#include <map-optimization/vi-map-relaxation.h>
+#include <map-optimization/vi-optimization-builder.h>
+#include <vi-map/loopclosure-edge.h>
+#include <vi-map/vi-map.h>
+
+DEFINE_int32(
+    relaxation_incremental_num_hops, 20,
+    "Number of pose-graph hops around new loop closure edges that are "
+    "re-optimized by an incremental relaxation.");
+DEFINE_double(
+    relaxation_incremental_max_solver_time_seconds, 0.1,
+    "Maximum solver time of a single incremental relaxation update.");
+
+namespace map_optimization {
+
+IncrementalVIMapRelaxation::IncrementalVIMapRelaxation(
+    const vi_map::MissionIdSet& mission_ids, vi_map::VIMap* map)
+    : map_(CHECK_NOTNULL(map)) {
+  CHECK(!mission_ids.empty());
+  CHECK_GE(FLAGS_relaxation_incremental_num_hops, 0);
+  CHECK_GT(FLAGS_relaxation_incremental_max_solver_time_seconds, 0.0);
+
+  optimization_problem_.reset(constructViProblem(
+      mission_ids, initRelaxationProblemOptionsFromGFlags(), map_));
+  CHECK(optimization_problem_ != nullptr);
+
+  pose_graph::EdgeIdList loop_closure_edges;
+  getLoopclosureEdgesOfMissions(*map_, mission_ids, &loop_closure_edges);
+  augmentViProblemWithLoopclosureEdges(
+      loop_closure_edges, optimization_problem_.get());
+  edges_in_problem_.insert(
+      loop_closure_edges.begin(), loop_closure_edges.end());
+
+  solver_options_ = initSolverOptionsFromFlags();
+  solver_options_.max_solver_time_in_seconds =
+      FLAGS_relaxation_incremental_max_solver_time_seconds;
+  solver_options_.minimizer_progress_to_stdout = false;
+  solver_options_.logging_type = ceres::SILENT;
+}
+
+bool IncrementalVIMapRelaxation::addLoopClosureEdges(
+    const pose_graph::EdgeIdList& edge_ids,
+    pose_graph::VertexIdList* updated_vertices) {
+  CHECK_NOTNULL(updated_vertices)->clear();
+
+  const std::unordered_set<pose_graph::VertexId>& keyframes_in_problem =
+      optimization_problem_->getProblemBookkeepingMutable()
+          ->keyframes_in_problem;
+  pose_graph::EdgeIdList new_edges;
+  pose_graph::VertexIdList seed_vertices;
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    CHECK(map_->getEdgeType(edge_id) ==
+          pose_graph::Edge::EdgeType::kLoopClosure);
+    if (edges_in_problem_.count(edge_id) > 0u) {
+      continue;
+    }
+    const vi_map::Edge& edge = map_->getEdgeAs<vi_map::Edge>(edge_id);
+    if (keyframes_in_problem.count(edge.from()) == 0u ||
+        keyframes_in_problem.count(edge.to()) == 0u) {
+      LOG(WARNING) << "Loop closure edge " << edge_id << " links vertices "
+                   << "outside of the relaxation problem, skipping it.";
+      continue;
+    }
+    new_edges.push_back(edge_id);
+    seed_vertices.push_back(edge.from());
+    seed_vertices.push_back(edge.to());
+  }
+  if (new_edges.empty()) {
+    return false;
+  }
+  augmentViProblemWithLoopclosureEdges(
+      new_edges, optimization_problem_.get());
+  edges_in_problem_.insert(new_edges.begin(), new_edges.end());
+
+  pose_graph::VertexIdSet affected_vertices;
+  selectAffectedVertices(seed_vertices, &affected_vertices);
+
+  OptimizationStateBuffer* buffer =
+      optimization_problem_->getOptimizationStateBufferMutable();
+  std::unordered_set<double*> free_parameter_blocks;
+  for (const pose_graph::VertexId& vertex_id : affected_vertices) {
+    free_parameter_blocks.insert(
+        buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+  }
+  for (const pose_graph::EdgeId& edge_id : edges_in_problem_) {
+    vi_map::LoopClosureEdge& loop_closure_edge =
+        CHECK_NOTNULL(map_->getEdgePtrAs<vi_map::Edge>(edge_id))
+            ->getAs<vi_map::LoopClosureEdge>();
+    if (affected_vertices.count(loop_closure_edge.from()) > 0u ||
+        affected_vertices.count(loop_closure_edge.to()) > 0u) {
+      free_parameter_blocks.insert(
+          loop_closure_edge.getSwitchVariableMutable());
+    }
+  }
+
+  ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
+  buildLocalCeresProblem(free_parameter_blocks, &problem);
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options_, &problem, &summary);
+  VLOG(1) << "Incremental relaxation of " << affected_vertices.size()
+          << " vertices for " << new_edges.size() << " new loop closure(s): "
+          << summary.BriefReport();
+
+  buffer->copyAllStatesBackToMap(map_);
+  updated_vertices->assign(affected_vertices.begin(), affected_vertices.end());
+  return true;
+}
+
+void IncrementalVIMapRelaxation::selectAffectedVertices(
+    const pose_graph::VertexIdList& seed_vertices,
+    pose_graph::VertexIdSet* affected_vertices) const {
+  CHECK_NOTNULL(affected_vertices)->clear();
+  const std::unordered_set<pose_graph::VertexId>& keyframes_in_problem =
+      optimization_problem_->getProblemBookkeepingMutable()
+          ->keyframes_in_problem;
+
+  pose_graph::VertexIdList frontier;
+  for (const pose_graph::VertexId& vertex_id : seed_vertices) {
+    if (affected_vertices->insert(vertex_id).second) {
+      frontier.push_back(vertex_id);
+    }
+  }
+  pose_graph::VertexIdList next_frontier;
+  for (int hop = 0; hop < FLAGS_relaxation_incremental_num_hops; ++hop) {
+    next_frontier.clear();
+    for (const pose_graph::VertexId& vertex_id : frontier) {
+      pose_graph::EdgeIdSet edges;
+      map_->getVertex(vertex_id).getAllEdges(&edges);
+      for (const pose_graph::EdgeId& edge_id : edges) {
+        const vi_map::Edge& edge = map_->getEdgeAs<vi_map::Edge>(edge_id);
+        const pose_graph::VertexId& neighbor_id =
+            edge.from() == vertex_id ? edge.to() : edge.from();
+        if (keyframes_in_problem.count(neighbor_id) > 0u &&
+            affected_vertices->insert(neighbor_id).second) {
+          next_frontier.push_back(neighbor_id);
+        }
+      }
+    }
+    if (next_frontier.empty()) {
+      break;
+    }
+    frontier.swap(next_frontier);
+  }
+}
+
+void IncrementalVIMapRelaxation::buildLocalCeresProblem(
+    const std::unordered_set<double*>& free_parameter_blocks,
+    ceres::Problem* problem) {
+  CHECK_NOTNULL(problem);
+  ceres_error_terms::ProblemInformation* problem_information =
+      optimization_problem_->getProblemInformationMutable();
+
+  std::unordered_set<double*> parameter_blocks;
+  size_t num_residual_blocks = 0u;
+  for (ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& residual_information_item :
+       problem_information->residual_blocks) {
+    ceres_error_terms::ResidualInformation& residual_information =
+        residual_information_item.second;
+    if (!residual_information.active_) {
+      continue;
+    }
+    bool has_free_parameter_block = false;
+    for (double* parameter_block : residual_information.parameter_blocks) {
+      if (free_parameter_blocks.count(parameter_block) > 0u) {
+        has_free_parameter_block = true;
+        break;
+      }
+    }
+    if (!has_free_parameter_block) {
+      continue;
+    }
+    problem->AddResidualBlock(
+        residual_information.cost_function.get(),
+        residual_information.loss_function.get(),
+        residual_information.parameter_blocks);
+    parameter_blocks.insert(
+        residual_information.parameter_blocks.begin(),
+        residual_information.parameter_blocks.end());
+    ++num_residual_blocks;
+  }
+
+  for (double* parameter_block : parameter_blocks) {
+    const ceres_error_terms::ProblemInformation::ParameterizationsMap::
+        const_iterator parameterization_it =
+            problem_information->parameterizations.find(parameter_block);
+    if (parameterization_it != problem_information->parameterizations.end()) {
+      problem->SetParameterization(
+          parameter_block, parameterization_it->second.get());
+    }
+    const ceres_error_terms::ProblemInformation::ParameterBoundMap::
+        const_iterator bound_it =
+            problem_information->parameter_bounds.find(parameter_block);
+    if (bound_it != problem_information->parameter_bounds.end()) {
+      problem->SetParameterLowerBound(
+          parameter_block, bound_it->second.index_in_param_block,
+          bound_it->second.lower_bound);
+      problem->SetParameterUpperBound(
+          parameter_block, bound_it->second.index_in_param_block,
+          bound_it->second.upper_bound);
+    }
+    if (free_parameter_blocks.count(parameter_block) == 0u ||
+        problem_information->isParameterBlockConstant(parameter_block)) {
+      problem->SetParameterBlockConstant(parameter_block);
+    }
+  }
+
+  VLOG(3) << "Local relaxation problem with " << num_residual_blocks
+          << " residual blocks and " << parameter_blocks.size()
+          << " parameter blocks.";
+}
+
+}  // namespace map_optimization
@@ -0,0 +1,265 @@
+#include "map-optimization/local-optimization-window.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_int32(
+    ba_local_num_core_vertices, 10,
+    "Number of vertices a local bundle adjustment window is centered on.");
+DEFINE_int32(
+    ba_local_max_num_covisible_vertices, 20,
+    "Maximum number of covisible vertices that are optimized in addition to "
+    "the core vertices of a local bundle adjustment window.");
+DEFINE_int32(
+    ba_local_min_num_covisible_landmarks, 15,
+    "Minimum number of landmarks a vertex must share with the core vertices "
+    "to be optimized in a local bundle adjustment window.");
+DEFINE_int32(
+    ba_local_max_num_fixed_vertices, 20,
+    "Maximum number of fixed vertices observing the landmarks of a local "
+    "bundle adjustment window.");
+
+namespace map_optimization {
+namespace {
+
+typedef std::unordered_map<pose_graph::VertexId, size_t> VertexCountMap;
+
+// Counts the observations of the given landmarks by every vertex that is not
+// part of the excluded set.
+void countObserverVertices(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdSet& landmarks,
+    const pose_graph::VertexIdSet& excluded_vertices,
+    VertexCountMap* observation_counts) {
+  CHECK_NOTNULL(observation_counts)->clear();
+  for (const vi_map::LandmarkId& landmark_id : landmarks) {
+    map.getLandmark(landmark_id)
+        .forEachObservation([&](const vi_map::KeypointIdentifier& keypoint_id) {
+          const pose_graph::VertexId& vertex_id =
+              keypoint_id.frame_id.vertex_id;
+          if (excluded_vertices.count(vertex_id) == 0u) {
+            ++(*observation_counts)[vertex_id];
+          }
+        });
+  }
+}
+
+// Returns at most max_num_vertices vertices with at least min_count
+// observations, ordered by decreasing count. Ties are broken by id to keep
+// the selection deterministic.
+void selectVerticesWithMostObservations(
+    const VertexCountMap& observation_counts, const size_t min_count,
+    const size_t max_num_vertices, pose_graph::VertexIdList* vertices) {
+  CHECK_NOTNULL(vertices)->clear();
+  for (const VertexCountMap::value_type& vertex_count : observation_counts) {
+    if (vertex_count.second >= min_count) {
+      vertices->push_back(vertex_count.first);
+    }
+  }
+  std::sort(
+      vertices->begin(), vertices->end(),
+      [&observation_counts](
+          const pose_graph::VertexId& lhs, const pose_graph::VertexId& rhs) {
+        const size_t lhs_count = observation_counts.at(lhs);
+        const size_t rhs_count = observation_counts.at(rhs);
+        return lhs_count > rhs_count || (lhs_count == rhs_count && lhs < rhs);
+      });
+  if (vertices->size() > max_num_vertices) {
+    vertices->resize(max_num_vertices);
+  }
+}
+
+void addObservedLandmarks(
+    const vi_map::VIMap& map, const pose_graph::VertexId& vertex_id,
+    vi_map::LandmarkIdSet* landmarks) {
+  CHECK_NOTNULL(landmarks);
+  vi_map::LandmarkIdList observed_landmark_ids;
+  map.getVertex(vertex_id).getAllObservedLandmarkIds(&observed_landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+    if (landmark_id.isValid()) {
+      landmarks->insert(landmark_id);
+    }
+  }
+}
+
+}  // namespace
+
+LocalOptimizationWindowOptions
+LocalOptimizationWindowOptions::initFromGFlags() {
+  CHECK_GT(FLAGS_ba_local_num_core_vertices, 0);
+  CHECK_GE(FLAGS_ba_local_max_num_covisible_vertices, 0);
+  CHECK_GE(FLAGS_ba_local_min_num_covisible_landmarks, 0);
+  CHECK_GE(FLAGS_ba_local_max_num_fixed_vertices, 0);
+
+  LocalOptimizationWindowOptions options;
+  options.num_core_vertices = FLAGS_ba_local_num_core_vertices;
+  options.max_num_covisible_vertices =
+      FLAGS_ba_local_max_num_covisible_vertices;
+  options.min_num_covisible_landmarks =
+      FLAGS_ba_local_min_num_covisible_landmarks;
+  options.max_num_fixed_vertices = FLAGS_ba_local_max_num_fixed_vertices;
+  return options;
+}
+
+void selectLocalOptimizationWindow(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& core_vertices,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window) {
+  CHECK_NOTNULL(window);
+  CHECK(!core_vertices.empty());
+  window->optimized_vertices.clear();
+  window->fixed_vertices.clear();
+  window->landmarks.clear();
+  window->missions.clear();
+
+  pose_graph::VertexIdSet optimized_vertices;
+  for (const pose_graph::VertexId& vertex_id : core_vertices) {
+    CHECK(map.hasVertex(vertex_id));
+    if (optimized_vertices.insert(vertex_id).second) {
+      window->optimized_vertices.push_back(vertex_id);
+      addObservedLandmarks(map, vertex_id, &window->landmarks);
+    }
+  }
+
+  // Covisible vertices are optimized along with their landmarks.
+  VertexCountMap observation_counts;
+  countObserverVertices(
+      map, window->landmarks, optimized_vertices, &observation_counts);
+  const size_t min_num_covisible_landmarks =
+      std::max<size_t>(options.min_num_covisible_landmarks, 1u);
+  pose_graph::VertexIdList covisible_vertices;
+  selectVerticesWithMostObservations(
+      observation_counts, min_num_covisible_landmarks,
+      options.max_num_covisible_vertices, &covisible_vertices);
+  for (const pose_graph::VertexId& vertex_id : covisible_vertices) {
+    optimized_vertices.insert(vertex_id);
+    window->optimized_vertices.push_back(vertex_id);
+    addObservedLandmarks(map, vertex_id, &window->landmarks);
+  }
+
+  // The remaining observers of the window landmarks constrain the window
+  // from the outside.
+  countObserverVertices(
+      map, window->landmarks, optimized_vertices, &observation_counts);
+  constexpr size_t kMinNumObservations = 1u;
+  selectVerticesWithMostObservations(
+      observation_counts, kMinNumObservations, options.max_num_fixed_vertices,
+      &window->fixed_vertices);
+  pose_graph::VertexIdSet fixed_vertices(
+      window->fixed_vertices.begin(), window->fixed_vertices.end());
+
+  // The poses of the landmark store vertices and the inertial neighbors of
+  // the window are part of the problem and need to be fixed as well.
+  auto add_fixed_vertex = [&](const pose_graph::VertexId& vertex_id) {
+    if (optimized_vertices.count(vertex_id) == 0u &&
+        fixed_vertices.insert(vertex_id).second) {
+      window->fixed_vertices.push_back(vertex_id);
+    }
+  };
+  for (const vi_map::LandmarkId& landmark_id : window->landmarks) {
+    add_fixed_vertex(map.getLandmarkStoreVertex(landmark_id).id());
+  }
+  for (const pose_graph::VertexId& vertex_id : window->optimized_vertices) {
+    pose_graph::EdgeIdSet edges;
+    map.getVertex(vertex_id).getAllEdges(&edges);
+    for (const pose_graph::EdgeId& edge_id : edges) {
+      if (map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kViwls) {
+        continue;
+      }
+      const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
+      add_fixed_vertex(edge.from() == vertex_id ? edge.to() : edge.from());
+    }
+  }
+
+  // Without boundary the window covers a complete part of the map; the first
+  // core vertex then anchors the gauge.
+  if (window->fixed_vertices.empty()) {
+    window->fixed_vertices.push_back(window->optimized_vertices.front());
+    window->optimized_vertices.erase(window->optimized_vertices.begin());
+  }
+
+  for (const pose_graph::VertexId& vertex_id : window->optimized_vertices) {
+    window->missions.insert(map.getMissionIdForVertex(vertex_id));
+  }
+  for (const pose_graph::VertexId& vertex_id : window->fixed_vertices) {
+    window->missions.insert(map.getMissionIdForVertex(vertex_id));
+  }
+
+  VLOG(1) << "Local optimization window with "
+          << window->optimized_vertices.size() << " optimized and "
+          << window->fixed_vertices.size() << " fixed vertices, "
+          << window->landmarks.size() << " landmarks and "
+          << window->missions.size() << " mission(s).";
+}
+
+void selectLocalOptimizationWindowAroundVertex(
+    const vi_map::VIMap& map, const pose_graph::VertexId& center_vertex_id,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window) {
+  CHECK_NOTNULL(window);
+  CHECK(map.hasVertex(center_vertex_id));
+  CHECK_GT(options.num_core_vertices, 0u);
+
+  const pose_graph::Edge::EdgeType edge_type = map.getGraphTraversalEdgeType(
+      map.getMissionIdForVertex(center_vertex_id));
+
+  // Grow the core alternately towards the previous and the next vertices.
+  std::vector<pose_graph::VertexId> previous_vertices;
+  std::vector<pose_graph::VertexId> next_vertices;
+  pose_graph::VertexId previous_vertex_id = center_vertex_id;
+  pose_graph::VertexId next_vertex_id = center_vertex_id;
+  bool has_previous = true;
+  bool has_next = true;
+  size_t num_core_vertices = 1u;
+  while (num_core_vertices < options.num_core_vertices &&
+         (has_previous || has_next)) {
+    if (has_previous) {
+      has_previous = map.getPreviousVertex(
+          previous_vertex_id, edge_type, &previous_vertex_id);
+      if (has_previous) {
+        previous_vertices.push_back(previous_vertex_id);
+        ++num_core_vertices;
+      }
+    }
+    if (has_next && num_core_vertices < options.num_core_vertices) {
+      has_next = map.getNextVertex(next_vertex_id, edge_type, &next_vertex_id);
+      if (has_next) {
+        next_vertices.push_back(next_vertex_id);
+        ++num_core_vertices;
+      }
+    }
+  }
+
+  pose_graph::VertexIdList core_vertices(
+      previous_vertices.rbegin(), previous_vertices.rend());
+  core_vertices.push_back(center_vertex_id);
+  core_vertices.insert(
+      core_vertices.end(), next_vertices.begin(), next_vertices.end());
+  selectLocalOptimizationWindow(map, core_vertices, options, window);
+}
+
+void selectLocalOptimizationWindowOfLatestVertices(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const LocalOptimizationWindowOptions& options,
+    LocalOptimizationWindow* window) {
+  CHECK_NOTNULL(window);
+  CHECK(map.hasMission(mission_id));
+  CHECK_GT(options.num_core_vertices, 0u);
+
+  const pose_graph::Edge::EdgeType edge_type =
+      map.getGraphTraversalEdgeType(mission_id);
+  pose_graph::VertexId vertex_id = map.getLastVertexIdOfMission(mission_id);
+  CHECK(vertex_id.isValid());
+  pose_graph::VertexIdList core_vertices{vertex_id};
+  while (core_vertices.size() < options.num_core_vertices &&
+         map.getPreviousVertex(vertex_id, edge_type, &vertex_id)) {
+    core_vertices.push_back(vertex_id);
+  }
+  std::reverse(core_vertices.begin(), core_vertices.end());
+  selectLocalOptimizationWindow(map, core_vertices, options, window);
+}
+
+}  // namespace map_optimization
@@ -81,7 +81,9 @@ OptimizationProblem::OptimizationProblem(
       missions_ids_(mission_ids),
       mission_coobservation_clusters_(
           vi_map_helpers::clusterMissionByLandmarkCoobservations(
-              *map, mission_ids)) {
+              *map, mission_ids)),
+      keep_ceres_problem_alive_(false),
+      ceres_problem_revision_(0u) {
   state_buffer_.importStatesOfMissions(*map, mission_ids);
 
   // Initialize the parameterizations.
@@ -93,6 +95,29 @@ OptimizationProblem::OptimizationProblem(
       new ceres_error_terms::JplQuaternionParameterization);
 }
 
+void OptimizationProblem::setKeepCeresProblemAlive(
+    const bool keep_ceres_problem_alive) {
+  keep_ceres_problem_alive_ = keep_ceres_problem_alive;
+  if (!keep_ceres_problem_alive_) {
+    resetCeresProblem();
+  }
+}
+
+ceres::Problem* OptimizationProblem::getCeresProblemMutable() {
+  if (keep_ceres_problem_alive_ && ceres_problem_ != nullptr &&
+      ceres_problem_revision_ == problem_information_.revision) {
+    VLOG(3) << "Reusing the ceres problem of the previous solve.";
+    return ceres_problem_.get();
+  }
+
+  ceres_problem_.reset(
+      new ceres::Problem(ceres_error_terms::getDefaultProblemOptions()));
+  ceres_error_terms::buildCeresProblemFromProblemInformation(
+      &problem_information_, ceres_problem_.get());
+  ceres_problem_revision_ = problem_information_.revision;
+  return ceres_problem_.get();
+}
+
 void OptimizationProblem::applyGaugeFixesForInitialVertices(
     const std::vector<MissionClusterGaugeFixes>& new_cluster_fixes) {
   CHECK_EQ(new_cluster_fixes.size(), mission_coobservation_clusters_.size());
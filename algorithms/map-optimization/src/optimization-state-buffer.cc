@@ -7,14 +7,18 @@
 #include <aslam/common/unique-id.h>
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/quaternion-math.h>
 #include <vi-map/sensor-manager.h>
 
 namespace map_optimization {
 
 double* OptimizationStateBuffer::get_vertex_q_IM__M_p_MI_JPL(
     const pose_graph::VertexId& id) {
-  const size_t index = common::getChecked(vertex_id_to_vertex_idx_, id);
-  CHECK_LT(index, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
+  CHECK_NOTNULL(map_);
+  const size_t index = map_->getVertexDenseIndex(id);
+  CHECK_LT(index, is_vertex_imported_.size());
+  CHECK(is_vertex_imported_[index])
+      << "The state of vertex " << id << " was not imported.";
   return vertex_q_IM__M_p_MI_.col(index).data();
 }
 
@@ -58,25 +62,37 @@ void OptimizationStateBuffer::copyAllKeyframePosesBackToMap(
   CHECK_NOTNULL(map);
   CHECK_EQ(
       static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()),
-      vertex_id_to_vertex_idx_.size());
-  typedef std::pair<const pose_graph::VertexId, size_t> value_type;
-  for (const value_type& vertex_id_idx : vertex_id_to_vertex_idx_) {
-    vi_map::Vertex& vertex = map->getVertex(vertex_id_idx.first);
-    const size_t vertex_idx = vertex_id_idx.second;
-    Eigen::Map<Eigen::Quaterniond> map_q_M_I(vertex.get_q_M_I_Mutable());
-    Eigen::Map<Eigen::Vector3d> map_p_M_I(vertex.get_p_M_I_Mutable());
+      is_vertex_imported_.size());
+  CHECK_EQ(imported_vertex_ids_.size(), imported_vertex_indices_.size());
+
+  if (copy_back_map_ != map) {
+    copy_back_vertices_.clear();
+    copy_back_vertices_.reserve(imported_vertex_ids_.size());
+    for (const pose_graph::VertexId& vertex_id : imported_vertex_ids_) {
+      copy_back_vertices_.push_back(&map->getVertex(vertex_id));
+    }
+    copy_back_map_ = map;
+  }
 
-    CHECK_LT(vertex_idx, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
+  const size_t num_vertices = copy_back_vertices_.size();
+  for (size_t i = 0u; i < num_vertices; ++i) {
+    vi_map::Vertex& vertex = *copy_back_vertices_[i];
+    const size_t vertex_idx = imported_vertex_indices_[i];
+    DCHECK_LT(vertex_idx, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
+    const Eigen::Map<const Eigen::Matrix<double, 7, 1>> q_IM__M_p_MI(
+        vertex_q_IM__M_p_MI_.col(vertex_idx).data());
 
     // Change from JPL passive quaternion used by error terms to active Hamilton
     // quaternion.
     Eigen::Quaterniond q_I_M_JPL;
-    q_I_M_JPL.coeffs() = vertex_q_IM__M_p_MI_.col(vertex_idx).head<4>();
+    q_I_M_JPL.coeffs() = q_IM__M_p_MI.head<4>();
     assertValidQuaternion(q_I_M_JPL);
 
     // I_q_G_JPL is in fact equal to active G_q_I - no inverse is needed.
-    map_q_M_I = q_I_M_JPL;
-    map_p_M_I = vertex_q_IM__M_p_MI_.col(vertex_idx).tail<3>();
+    Eigen::Map<Eigen::Vector4d>(vertex.get_q_M_I_Mutable()) =
+        q_IM__M_p_MI.head<4>();
+    Eigen::Map<Eigen::Vector3d>(vertex.get_p_M_I_Mutable()) =
+        q_IM__M_p_MI.tail<3>();
   }
 }
 
@@ -181,29 +197,42 @@ void OptimizationStateBuffer::importKeyframePosesOfMissions(
     all_vertices.insert(
         all_vertices.end(), mission_vertices.begin(), mission_vertices.end());
   }
-  vertex_id_to_vertex_idx_.reserve(all_vertices.size());
-  vertex_q_IM__M_p_MI_.resize(Eigen::NoChange, all_vertices.size());
-
-  size_t vertex_idx = 0u;
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
+  map_ = &map;
+  const size_t num_dense_indices = map.numVertexDenseIndices();
+  is_vertex_imported_.assign(num_dense_indices, false);
+  vertex_q_IM__M_p_MI_.resize(Eigen::NoChange, num_dense_indices);
+  imported_vertex_indices_.clear();
+  imported_vertex_indices_.reserve(all_vertices.size());
+  copy_back_map_ = nullptr;
+  copy_back_vertices_.clear();
+
+  // Gathered in import order, s.t. the sign fix and the validation run over
+  // contiguous arrays.
+  const int num_vertices = static_cast<int>(all_vertices.size());
+  Eigen::Matrix4Xd q_M_I(4, num_vertices);
+  Eigen::Matrix3Xd p_M_I(3, num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    const pose_graph::VertexId& vertex_id = all_vertices[i];
     const vi_map::Vertex& ba_vertex = map.getVertex(vertex_id);
+    const size_t vertex_idx = map.getVertexDenseIndex(vertex_id);
 
-    Eigen::Quaterniond q_M_I = ba_vertex.get_q_M_I();
-    ensurePositiveQuaternion(q_M_I.coeffs());
-    assertValidQuaternion(q_M_I);
-
-    // Convert active Hamiltonian rotation (minkindr, Eigen) to passive JPL
-    // which the error terms use. No inverse is required.
-    vertex_q_IM__M_p_MI_.col(vertex_idx) << q_M_I.coeffs(),
-        ba_vertex.get_p_M_I();
+    q_M_I.col(i) = ba_vertex.get_q_M_I().coeffs();
+    p_M_I.col(i) = ba_vertex.get_p_M_I();
     CHECK(ba_vertex.id().isValid());
-    CHECK(vertex_id_to_vertex_idx_.emplace(ba_vertex.id(), vertex_idx).second);
-    ++vertex_idx;
+    CHECK(!is_vertex_imported_[vertex_idx]);
+    is_vertex_imported_[vertex_idx] = true;
+    imported_vertex_indices_.push_back(vertex_idx);
   }
-  CHECK_EQ(
-      static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()),
-      vertex_id_to_vertex_idx_.size());
-  CHECK_EQ(all_vertices.size(), vertex_id_to_vertex_idx_.size());
+  common::ensurePositiveQuaternionBatched(q_M_I);
+  assertValidQuaternions(q_M_I);
+
+  // Convert active Hamiltonian rotation (minkindr, Eigen) to passive JPL
+  // which the error terms use. No inverse is required.
+  for (int i = 0; i < num_vertices; ++i) {
+    vertex_q_IM__M_p_MI_.col(imported_vertex_indices_[i]) << q_M_I.col(i),
+        p_M_I.col(i);
+  }
+  imported_vertex_ids_.swap(all_vertices);
 }
 
 void OptimizationStateBuffer::importBaseframePoseOfMissions(
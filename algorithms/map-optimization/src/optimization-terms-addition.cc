@@ -1,16 +1,187 @@
 #include "map-optimization/optimization-terms-addition.h"
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include <ceres-error-terms/inertial-error-term-preintegrated.h>
 #include <ceres-error-terms/inertial-error-term.h>
 #include <ceres-error-terms/visual-error-term-factory.h>
 #include <ceres-error-terms/visual-error-term.h>
 #include <ceres/ceres.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/progress-bar.h>
-#include <vi-map-helpers/vi-map-queries.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 
 namespace map_optimization {
+namespace {
+
+constexpr bool kAlwaysParallelize = false;
+
+// A visual term that passed all checks of addVisualTermsForVertices and only
+// needs to be added to the problem.
+struct VisualTermDescriptor {
+  VisualTermDescriptor(
+      const int _frame_idx, const int _keypoint_idx,
+      vi_map::Vertex* _landmark_store_vertex)
+      : frame_idx(_frame_idx),
+        keypoint_idx(_keypoint_idx),
+        landmark_store_vertex(_landmark_store_vertex) {}
+  int frame_idx;
+  int keypoint_idx;
+  vi_map::Vertex* landmark_store_vertex;
+};
+
+struct VertexVisualTerms {
+  VertexVisualTerms() : has_frame_in_problem(false) {}
+  bool has_frame_in_problem;
+  std::vector<VisualTermDescriptor> terms;
+};
+
+typedef std::unordered_map<vi_map::LandmarkId, bool>
+    LandmarkWellConstrainedTable;
+
+// Evaluates isLandmarkWellConstrained once for every landmark observed by the
+// given vertices, restricted to landmarks_to_include if set.
+void buildLandmarkWellConstrainedTable(
+    const vi_map::VIMap& map,
+    const std::vector<const vi_map::Vertex*>& vertices,
+    const vi_map::LandmarkIdSet* landmarks_to_include, const size_t num_threads,
+    LandmarkWellConstrainedTable* table) {
+  CHECK_NOTNULL(table)->clear();
+
+  std::vector<vi_map::LandmarkIdSet> vertex_landmark_ids(vertices.size());
+  common::ParallelProcess(
+      vertices.size(),
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t vertex_idx : batch) {
+          const vi_map::Vertex& vertex = *vertices[vertex_idx];
+          vi_map::LandmarkIdSet& landmark_ids = vertex_landmark_ids[vertex_idx];
+          const size_t num_frames = vertex.numFrames();
+          for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+            if (!vertex.isVisualFrameSet(frame_idx) ||
+                !vertex.isVisualFrameValid(frame_idx)) {
+              continue;
+            }
+            for (const vi_map::LandmarkId& landmark_id :
+                 vertex.getFrameObservedLandmarkIds(frame_idx)) {
+              if (landmark_id.isValid() &&
+                  (landmarks_to_include == nullptr ||
+                   landmarks_to_include->count(landmark_id) > 0u)) {
+                landmark_ids.insert(landmark_id);
+              }
+            }
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  for (const vi_map::LandmarkIdSet& landmark_ids : vertex_landmark_ids) {
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      table->emplace(landmark_id, false);
+    }
+  }
+
+  // The keys are fixed from here on, so the values can be written
+  // concurrently.
+  std::vector<LandmarkWellConstrainedTable::value_type*> entries;
+  entries.reserve(table->size());
+  for (LandmarkWellConstrainedTable::value_type& entry : *table) {
+    entries.push_back(&entry);
+  }
+  common::ParallelProcess(
+      entries.size(),
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t entry_idx : batch) {
+          LandmarkWellConstrainedTable::value_type* entry = entries[entry_idx];
+          entry->second = vi_map::isLandmarkWellConstrained(
+              map, map.getLandmark(entry->first));
+        }
+      },
+      kAlwaysParallelize, num_threads);
+}
+
+// Runs the checks of addVisualTermsForVertices on a single vertex without
+// modifying the map or the problem. If landmarks_to_include is set, all other
+// landmarks are skipped.
+void collectVisualTermsForVertex(
+    const vi_map::VIMap& map, const vi_map::Vertex& vertex,
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const LandmarkWellConstrainedTable& is_landmark_well_constrained,
+    const vi_map::LandmarkIdSet* landmarks_to_include,
+    const size_t min_landmarks_per_frame, VertexVisualTerms* vertex_terms) {
+  CHECK_NOTNULL(vertex_terms);
+  const size_t num_frames = vertex.numFrames();
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    if (!vertex.isVisualFrameSet(frame_idx) ||
+        !vertex.isVisualFrameValid(frame_idx)) {
+      continue;
+    }
+    const vi_map::LandmarkIdList& landmark_ids =
+        vertex.getFrameObservedLandmarkIds(frame_idx);
+
+    if (min_landmarks_per_frame > 0) {
+      size_t num_frame_good_landmarks = 0u;
+      for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+        if (!landmark_id.isValid()) {
+          continue;
+        }
+        const LandmarkWellConstrainedTable::const_iterator it =
+            is_landmark_well_constrained.find(landmark_id);
+        if (it != is_landmark_well_constrained.end() && it->second) {
+          ++num_frame_good_landmarks;
+        }
+      }
+      if (num_frame_good_landmarks < min_landmarks_per_frame) {
+        VLOG(3) << " Skipping this visual keyframe. Only "
+                << num_frame_good_landmarks
+                << " well constrained landmarks, but "
+                << min_landmarks_per_frame << " required";
+        continue;
+      }
+    }
+    vertex_terms->has_frame_in_problem = true;
+
+    const size_t num_keypoints =
+        vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
+    CHECK_EQ(landmark_ids.size(), num_keypoints);
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+         ++keypoint_idx) {
+      const vi_map::LandmarkId& landmark_id = landmark_ids[keypoint_idx];
+      // Invalid landmark_id means that the keypoint is not actually
+      // associated to an existing landmark object.
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      if (landmarks_to_include != nullptr &&
+          landmarks_to_include->count(landmark_id) == 0u) {
+        continue;
+      }
+
+      const vi_map::Vertex& landmark_store_vertex =
+          map.getLandmarkStoreVertex(landmark_id);
+
+      // Skip if the landmark is stored in a mission that should not be
+      // optimized.
+      if (missions_to_optimize.count(landmark_store_vertex.getMissionId()) ==
+          0u) {
+        continue;
+      }
+
+      // Skip if the current landmark is not well constrained.
+      if (!is_landmark_well_constrained.at(landmark_id)) {
+        continue;
+      }
+
+      // The map is only modified through this pointer once all vertices have
+      // been collected.
+      vertex_terms->terms.emplace_back(
+          frame_idx, keypoint_idx,
+          const_cast<vi_map::Vertex*>(&landmark_store_vertex));
+    }
+  }
+}
 
 bool addVisualTermForKeypoint(
     const int keypoint_idx, const int frame_idx,
@@ -21,8 +192,10 @@ bool addVisualTermForKeypoint(
         baseframe_parameterization,
     const std::shared_ptr<ceres::LocalParameterization>&
         camera_parameterization,
-    vi_map::Vertex* vertex_ptr, OptimizationProblem* problem) {
+    vi_map::Vertex* vertex_ptr, vi_map::Vertex* landmark_store_vertex_ptr,
+    OptimizationProblem* problem) {
   CHECK_NOTNULL(vertex_ptr);
+  CHECK_NOTNULL(landmark_store_vertex_ptr);
   CHECK_NOTNULL(problem);
 
   CHECK(pose_parameterization != nullptr);
@@ -48,9 +221,9 @@ bool addVisualTermForKeypoint(
   // The keypoint must have a valid association with a landmark.
   CHECK(landmark_id.isValid());
 
-  vi_map::Vertex& landmark_store_vertex =
-      map->getLandmarkStoreVertex(landmark_id);
-  vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+  vi_map::Vertex& landmark_store_vertex = *landmark_store_vertex_ptr;
+  vi_map::Landmark& landmark =
+      landmark_store_vertex.getLandmarks().getLandmark(landmark_id);
 
   const aslam::Camera::Ptr camera_ptr = vertex_ptr->getCamera(frame_idx);
   CHECK(camera_ptr != nullptr);
@@ -110,11 +283,13 @@ bool addVisualTermForKeypoint(
   // to be feeded separately. Shifting by 4 = the quaternione size.
   double* camera_C_p_CI = camera_q_CI + 4;
 
-  std::shared_ptr<ceres::CostFunction> visual_term_cost(
+  // Allocated in the arena of the problem, visual terms are the bulk of the
+  // residuals.
+  std::shared_ptr<ceres::CostFunction> visual_term_cost =
       ceres_error_terms::createVisualCostFunction<
           ceres_error_terms::VisualReprojectionError>(
           image_point_distorted, image_point_uncertainty, error_term_type,
-          camera_ptr.get()));
+          camera_ptr.get(), problem_information->residual_block_arena);
 
   std::vector<double*> cost_term_args = {
       landmark.get_p_B_Mutable(),
@@ -140,10 +315,11 @@ bool addVisualTermForKeypoint(
     problem_information->setParameterBlockConstant(dummy);
   }
 
-  std::shared_ptr<ceres::LossFunction> loss_function(
-      new ceres::LossFunctionWrapper(
-          new ceres::HuberLoss(huber_loss_delta * image_point_uncertainty),
-          ceres::TAKE_OWNERSHIP));
+  // Keypoints of the same uncertainty share one loss function.
+  std::shared_ptr<ceres::LossFunction> loss_function =
+      problem_information->getSharedLossFunction<ceres::HuberLoss>(
+          ceres_error_terms::ResidualType::kVisualReprojectionError,
+          huber_loss_delta * image_point_uncertainty);
 
   problem_information->addResidualBlock(
       ceres_error_terms::ResidualType::kVisualReprojectionError,
@@ -192,85 +368,148 @@ bool addVisualTermForKeypoint(
   return true;
 }
 
-void addVisualTermsForVertices(
+}  // namespace
+
+bool addVisualTermForKeypoint(
+    const int keypoint_idx, const int frame_idx,
     const bool fix_landmark_positions, const bool fix_intrinsics,
     const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
-    const size_t min_landmarks_per_frame,
     const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
     const std::shared_ptr<ceres::LocalParameterization>&
         baseframe_parameterization,
     const std::shared_ptr<ceres::LocalParameterization>&
         camera_parameterization,
-    const pose_graph::VertexIdList& vertices, OptimizationProblem* problem) {
+    vi_map::Vertex* vertex_ptr, OptimizationProblem* problem) {
+  CHECK_NOTNULL(vertex_ptr);
   CHECK_NOTNULL(problem);
-
   vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
-  const vi_map::MissionIdSet& missions_to_optimize = problem->getMissionIds();
+  const vi_map::LandmarkId& landmark_id =
+      vertex_ptr->getObservedLandmarkId(frame_idx, keypoint_idx);
+  CHECK(landmark_id.isValid());
+  return addVisualTermForKeypoint(
+      keypoint_idx, frame_idx, fix_landmark_positions, fix_intrinsics,
+      fix_extrinsics_rotation, fix_extrinsics_translation,
+      pose_parameterization, baseframe_parameterization,
+      camera_parameterization, vertex_ptr,
+      &map->getLandmarkStoreVertex(landmark_id), problem);
+}
 
-  for (const pose_graph::VertexId& vertex_id : vertices) {
-    vi_map::Vertex& vertex = map->getVertex(vertex_id);
-    const size_t num_frames = vertex.numFrames();
-    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-      if (!vertex.isVisualFrameSet(frame_idx) ||
-          !vertex.isVisualFrameValid(frame_idx)) {
-        continue;
-      }
+namespace {
 
-      if (min_landmarks_per_frame > 0) {
-        vi_map_helpers::VIMapQueries queries(*map);
-        const size_t num_frame_good_landmarks =
-            queries.getNumWellConstrainedLandmarks(vertex, frame_idx);
-        if (num_frame_good_landmarks < min_landmarks_per_frame) {
-          VLOG(3) << " Skipping this visual keyframe. Only "
-                  << num_frame_good_landmarks
-                  << " well constrained landmarks, but "
-                  << min_landmarks_per_frame << " required";
-          continue;
-        }
-      }
-      problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
-          vertex_id);
-
-      const aslam::VisualFrame& visual_frame = vertex.getVisualFrame(frame_idx);
-      const size_t num_keypoints = visual_frame.getNumKeypointMeasurements();
-
-      for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
-           ++keypoint_idx) {
-        const vi_map::LandmarkId landmark_id =
-            vertex.getObservedLandmarkId(frame_idx, keypoint_idx);
-        // Invalid landmark_id means that the keypoint is not actually
-        // associated to an existing landmark object.
-        if (!landmark_id.isValid()) {
-          continue;
-        }
+void addVisualTermsForVerticesAndLandmarks(
+    const bool fix_landmark_positions, const bool fix_intrinsics,
+    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
+    const size_t min_landmarks_per_frame,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    const pose_graph::VertexIdList& vertices,
+    const vi_map::LandmarkIdSet* landmarks_to_include,
+    OptimizationProblem* problem) {
+  CHECK_NOTNULL(problem);
 
-        const vi_map::Vertex& landmark_store_vertex =
-            map->getLandmarkStoreVertex(landmark_id);
+  vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
+  const vi_map::VIMap& const_map = *map;
+  const vi_map::MissionIdSet& missions_to_optimize = problem->getMissionIds();
+  const size_t num_threads = common::getNumHardwareThreads();
+
+  // The problem is built in two passes. The checks of every keypoint only
+  // read the map and run in parallel, with the landmark quality evaluated
+  // once per landmark instead of once per observation. The terms are then
+  // added to the problem on a single thread in the order of the vertices.
+  const size_t num_vertices = vertices.size();
+  std::vector<const vi_map::Vertex*> vertex_ptrs(num_vertices);
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    vertex_ptrs[vertex_idx] = &const_map.getVertex(vertices[vertex_idx]);
+  }
 
-        // Skip if the landmark is stored in a mission that should not be
-        // optimized.
-        if (missions_to_optimize.count(landmark_store_vertex.getMissionId()) ==
-            0u) {
-          continue;
+  LandmarkWellConstrainedTable is_landmark_well_constrained;
+  buildLandmarkWellConstrainedTable(
+      const_map, vertex_ptrs, landmarks_to_include, num_threads,
+      &is_landmark_well_constrained);
+
+  std::vector<VertexVisualTerms> vertex_terms(num_vertices);
+  common::ParallelProcess(
+      num_vertices,
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t vertex_idx : batch) {
+          collectVisualTermsForVertex(
+              const_map, *vertex_ptrs[vertex_idx], missions_to_optimize,
+              is_landmark_well_constrained, landmarks_to_include,
+              min_landmarks_per_frame, &vertex_terms[vertex_idx]);
         }
+      },
+      kAlwaysParallelize, num_threads);
 
-        vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+  size_t num_visual_terms = 0u;
+  for (const VertexVisualTerms& terms : vertex_terms) {
+    num_visual_terms += terms.terms.size();
+  }
+  ceres_error_terms::ProblemInformation* problem_information =
+      CHECK_NOTNULL(problem->getProblemInformationMutable());
+  problem_information->reserveResidualBlocks(
+      problem_information->residual_blocks.size() + num_visual_terms);
 
-        // Skip if the current landmark is not well constrained.
-        if (!vi_map::isLandmarkWellConstrained(*map, landmark)) {
-          continue;
-        }
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices; ++vertex_idx) {
+    const VertexVisualTerms& terms = vertex_terms[vertex_idx];
+    if (!terms.has_frame_in_problem) {
+      continue;
+    }
+    const pose_graph::VertexId& vertex_id = vertices[vertex_idx];
+    problem->getProblemBookkeepingMutable()->keyframes_in_problem.emplace(
+        vertex_id);
 
-        addVisualTermForKeypoint(
-            keypoint_idx, frame_idx, fix_landmark_positions, fix_intrinsics,
-            fix_extrinsics_rotation, fix_extrinsics_translation,
-            pose_parameterization, baseframe_parameterization,
-            camera_parameterization, &vertex, problem);
-      }
+    vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    for (const VisualTermDescriptor& term : terms.terms) {
+      addVisualTermForKeypoint(
+          term.keypoint_idx, term.frame_idx, fix_landmark_positions,
+          fix_intrinsics, fix_extrinsics_rotation, fix_extrinsics_translation,
+          pose_parameterization, baseframe_parameterization,
+          camera_parameterization, &vertex, term.landmark_store_vertex,
+          problem);
     }
   }
 }
 
+}  // namespace
+
+void addVisualTermsForVertices(
+    const bool fix_landmark_positions, const bool fix_intrinsics,
+    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
+    const size_t min_landmarks_per_frame,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    const pose_graph::VertexIdList& vertices, OptimizationProblem* problem) {
+  addVisualTermsForVerticesAndLandmarks(
+      fix_landmark_positions, fix_intrinsics, fix_extrinsics_rotation,
+      fix_extrinsics_translation, min_landmarks_per_frame,
+      pose_parameterization, baseframe_parameterization,
+      camera_parameterization, vertices, nullptr, problem);
+}
+
+void addVisualTermsForVertices(
+    const bool fix_landmark_positions, const bool fix_intrinsics,
+    const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
+    const size_t min_landmarks_per_frame,
+    const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        baseframe_parameterization,
+    const std::shared_ptr<ceres::LocalParameterization>&
+        camera_parameterization,
+    const pose_graph::VertexIdList& vertices,
+    const vi_map::LandmarkIdSet& landmarks, OptimizationProblem* problem) {
+  addVisualTermsForVerticesAndLandmarks(
+      fix_landmark_positions, fix_intrinsics, fix_extrinsics_rotation,
+      fix_extrinsics_translation, min_landmarks_per_frame,
+      pose_parameterization, baseframe_parameterization,
+      camera_parameterization, vertices, &landmarks, problem);
+}
+
 void addVisualTerms(
     const bool fix_landmark_positions, const bool fix_intrinsics,
     const bool fix_extrinsics_rotation, const bool fix_extrinsics_translation,
@@ -298,7 +537,7 @@ void addVisualTerms(
 void addInertialTerms(
     const bool fix_gyro_bias, const bool fix_accel_bias,
     const bool fix_velocity, const double gravity_magnitude,
-    OptimizationProblem* problem) {
+    const InertialTermType inertial_term_type, OptimizationProblem* problem) {
   CHECK_NOTNULL(problem);
 
   vi_map::VIMap* map = CHECK_NOTNULL(problem->getMapMutable());
@@ -320,7 +559,8 @@ void addInertialTerms(
 
     num_residuals_added += addInertialTermsForEdges(
         fix_gyro_bias, fix_accel_bias, fix_velocity, gravity_magnitude,
-        imu_sigmas, parameterizations.pose_parameterization, edges, problem);
+        inertial_term_type, imu_sigmas, parameterizations.pose_parameterization,
+        edges, problem);
   }
 
   VLOG(1) << "Added " << num_residuals_added << " inertial residuals.";
@@ -329,6 +569,7 @@ void addInertialTerms(
 int addInertialTermsForEdges(
     const bool fix_gyro_bias, const bool fix_accel_bias,
     const bool fix_velocity, const double gravity_magnitude,
+    const InertialTermType inertial_term_type,
     const vi_map::ImuSigmas& imu_sigmas,
     const std::shared_ptr<ceres::LocalParameterization>& pose_parameterization,
     const pose_graph::EdgeIdList& edges, OptimizationProblem* problem) {
@@ -344,13 +585,30 @@ int addInertialTermsForEdges(
     const vi_map::ViwlsEdge& inertial_edge =
         map->getEdgeAs<vi_map::ViwlsEdge>(edge_id);
 
-    std::shared_ptr<ceres_error_terms::InertialErrorTerm> inertial_term_cost(
-        new ceres_error_terms::InertialErrorTerm(
+    std::shared_ptr<ceres::CostFunction> inertial_term_cost;
+    switch (inertial_term_type) {
+      case InertialTermType::kRungeKutta:
+        inertial_term_cost.reset(new ceres_error_terms::InertialErrorTerm(
             inertial_edge.getImuData(), inertial_edge.getImuTimestamps(),
             imu_sigmas.gyro_noise_density,
             imu_sigmas.gyro_bias_random_walk_noise_density,
             imu_sigmas.acc_noise_density,
             imu_sigmas.acc_bias_random_walk_noise_density, gravity_magnitude));
+        break;
+      case InertialTermType::kPreintegrated:
+        inertial_term_cost.reset(
+            new ceres_error_terms::PreintegratedInertialErrorTerm(
+                inertial_edge.getImuData(), inertial_edge.getImuTimestamps(),
+                imu_sigmas.gyro_noise_density,
+                imu_sigmas.gyro_bias_random_walk_noise_density,
+                imu_sigmas.acc_noise_density,
+                imu_sigmas.acc_bias_random_walk_noise_density,
+                gravity_magnitude));
+        break;
+      default:
+        LOG(FATAL) << "Unknown inertial term type: "
+                   << static_cast<int>(inertial_term_type);
+    }
 
     vi_map::Vertex& vertex_from = map->getVertex(inertial_edge.from());
     vi_map::Vertex& vertex_to = map->getVertex(inertial_edge.to());
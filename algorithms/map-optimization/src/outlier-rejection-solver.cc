@@ -1,8 +1,12 @@
 #include "map-optimization/outlier-rejection-solver.h"
 
 #include <aslam/common/timer.h>
+#include <ceres-error-terms/problem-information.h>
 #include <ceres/ceres.h>
 #include <gflags/gflags.h>
+#include <maplab-common/accessors.h>
+
+#include "map-optimization/solver.h"
 
 DEFINE_int32(
     ba_outlier_rejection_reject_every_n_iters, 3,
@@ -107,16 +111,15 @@ void findOutlierLandmarks(
 ceres::TerminationType solveStep(
     const OutlierRejectionSolverOptions& rejection_options,
     const ceres::Solver::Options& solver_options,
-    OptimizationProblem* optimization_problem,
+    OptimizationProblem* optimization_problem, ceres::Problem* problem,
     OutlierRejectionCallback* callback) {
   CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(problem);
   CHECK_NOTNULL(callback);
 
-  ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
-
   ceres::Solver::Options local_options = solver_options;
+  // The ordering has to follow the landmarks removed in the last round.
+  setLinearSolverOrdering(*problem, optimization_problem, &local_options);
   local_options.callbacks.push_back(callback);
   // Reusing the trust region size from the last iteration.
   local_options.initial_trust_region_radius =
@@ -129,15 +132,19 @@ ceres::TerminationType solveStep(
   local_options.update_state_every_iteration = true;
 
   ceres::Solver::Summary summary;
-  ceres::Solve(local_options, &problem, &summary);
+  ceres::Solve(local_options, problem, &summary);
 
   return summary.termination_type;
 }
 
+// Removes the residual blocks of all outlier landmarks from the problem
+// information as well as from the ceres problem that was built from it, so that
+// the ceres problem can be reused for the next round.
 void rejectOutliers(
     const OutlierRejectionSolverOptions& rejection_options,
-    OptimizationProblem* optimization_problem) {
+    OptimizationProblem* optimization_problem, ceres::Problem* problem) {
   CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(problem);
 
   vi_map::VIMap& map = *optimization_problem->getMapMutable();
 
@@ -163,15 +170,30 @@ void rejectOutliers(
       rejection_options.reprojection_error_other_mission_px,
       &outlier_landmarks);
 
+  ceres_error_terms::ProblemInformation* problem_information =
+      optimization_problem->getProblemInformationMutable();
   for (const vi_map::LandmarkId& landmark_id : outlier_landmarks) {
     const auto range = landmarks_in_problem.equal_range(landmark_id);
     // Deactivate all observation constraints of this landmark.
     for (auto it = range.first; it != range.second; ++it) {
-      optimization_problem->getProblemInformationMutable()
-          ->deactivateCostFunction(it->second);
+      const ceres_error_terms::ResidualInformation& residual_information =
+          common::getChecked(problem_information->residual_blocks, it->second);
+      if (residual_information.active_) {
+        problem->RemoveResidualBlock(
+            residual_information.latest_residual_block_id);
+      }
+      problem_information->deactivateCostFunction(it->second);
     }
     landmarks_in_problem.erase(landmark_id);
-    map.getLandmark(landmark_id).setQuality(vi_map::Landmark::Quality::kBad);
+
+    vi_map::Landmark& landmark = map.getLandmark(landmark_id);
+    if (problem->HasParameterBlock(landmark.get_p_B_Mutable())) {
+      problem->RemoveParameterBlock(landmark.get_p_B_Mutable());
+    }
+    landmark.setQuality(vi_map::Landmark::Quality::kBad);
+  }
+  if (!outlier_landmarks.empty()) {
+    map.markLandmarksChanged();
   }
 
   LOG_IF(INFO, !outlier_landmarks.empty())
@@ -214,12 +236,25 @@ ceres::TerminationType solveWithOutlierRejection(
 
   OutlierRejectionCallback callback(solver_options.initial_trust_region_radius);
 
+  // The ceres problem is built once and shrunk by the rejected landmarks after
+  // every round. Every round continues with the trust region radius of the
+  // previous one.
+  timing::Timer timer_build("BA: Build problem");
+  ceres::Problem::Options problem_options =
+      ceres_error_terms::getDefaultProblemOptions();
+  problem_options.enable_fast_removal = true;
+  ceres::Problem problem(problem_options);
+  ceres_error_terms::buildCeresProblemFromProblemInformation(
+      optimization_problem->getProblemInformationMutable(), &problem);
+  timer_build.Stop();
+
   ceres::TerminationType termination_type =
       ceres::TerminationType::NO_CONVERGENCE;
   for (int i = 0; i < num_outer_iters; ++i) {
     timing::Timer timer_solve("BA: Solve");
     termination_type = solveStep(
-        rejection_options, solver_options, optimization_problem, &callback);
+        rejection_options, solver_options, optimization_problem, &problem,
+        &callback);
     timer_solve.Stop();
 
     timing::Timer timer_copy("BA: CopyDataToMap");
@@ -228,7 +263,7 @@ ceres::TerminationType solveWithOutlierRejection(
     timer_copy.Stop();
 
     timing::Timer timer_reject("BA: Outlier rejection");
-    rejectOutliers(rejection_options, optimization_problem);
+    rejectOutliers(rejection_options, optimization_problem, &problem);
     timer_reject.Stop();
 
     if (termination_type != ceres::TerminationType::NO_CONVERGENCE) {
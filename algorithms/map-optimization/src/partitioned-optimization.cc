@@ -0,0 +1,235 @@
+#include "map-optimization/partitioned-optimization.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <vi-map-helpers/mission-clustering-coobservation.h>
+#include <vi-map-helpers/vi-map-partitioner.h>
+
+DEFINE_int32(
+    ba_partitioned_num_partitions, 4,
+    "Number of METIS partitions of a partitioned bundle adjustment.");
+DEFINE_int32(
+    ba_partitioned_num_iterations, 3,
+    "Number of alternations between the partition problems and the separator "
+    "problem of a partitioned bundle adjustment.");
+
+namespace map_optimization {
+namespace {
+
+void getObservedLandmarks(
+    const vi_map::VIMap& map, const pose_graph::VertexId& vertex_id,
+    vi_map::LandmarkIdList* landmarks) {
+  CHECK_NOTNULL(landmarks)->clear();
+  vi_map::LandmarkIdList observed_landmark_ids;
+  map.getVertex(vertex_id).getAllObservedLandmarkIds(&observed_landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+    if (landmark_id.isValid()) {
+      landmarks->push_back(landmark_id);
+    }
+  }
+}
+
+void getInertialNeighbors(
+    const vi_map::VIMap& map, const pose_graph::VertexId& vertex_id,
+    pose_graph::VertexIdList* neighbors) {
+  CHECK_NOTNULL(neighbors)->clear();
+  pose_graph::EdgeIdSet edges;
+  map.getVertex(vertex_id).getAllEdges(&edges);
+  for (const pose_graph::EdgeId& edge_id : edges) {
+    if (map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::kViwls) {
+      continue;
+    }
+    const vi_map::Edge& edge = map.getEdgeAs<vi_map::Edge>(edge_id);
+    neighbors->push_back(edge.from() == vertex_id ? edge.to() : edge.from());
+  }
+}
+
+// Adds the landmark store vertices and the inertial neighbors of the window
+// that are not optimized as fixed vertices, anchors windows without boundary
+// and collects the missions of the window.
+void completeWindow(
+    const vi_map::VIMap& map, LocalOptimizationWindow* window) {
+  CHECK_NOTNULL(window);
+  const pose_graph::VertexIdSet optimized_vertices(
+      window->optimized_vertices.begin(), window->optimized_vertices.end());
+  pose_graph::VertexIdSet fixed_vertices(
+      window->fixed_vertices.begin(), window->fixed_vertices.end());
+  auto add_fixed_vertex = [&](const pose_graph::VertexId& vertex_id) {
+    if (optimized_vertices.count(vertex_id) == 0u &&
+        fixed_vertices.insert(vertex_id).second) {
+      window->fixed_vertices.push_back(vertex_id);
+    }
+  };
+  for (const vi_map::LandmarkId& landmark_id : window->landmarks) {
+    add_fixed_vertex(map.getLandmarkStoreVertex(landmark_id).id());
+  }
+  pose_graph::VertexIdList neighbors;
+  for (const pose_graph::VertexId& vertex_id : window->optimized_vertices) {
+    getInertialNeighbors(map, vertex_id, &neighbors);
+    for (const pose_graph::VertexId& neighbor_id : neighbors) {
+      add_fixed_vertex(neighbor_id);
+    }
+  }
+
+  if (window->fixed_vertices.empty() && !window->optimized_vertices.empty()) {
+    window->fixed_vertices.push_back(window->optimized_vertices.front());
+    window->optimized_vertices.erase(window->optimized_vertices.begin());
+  }
+
+  window->missions.clear();
+  for (const pose_graph::VertexId& vertex_id : window->optimized_vertices) {
+    window->missions.insert(map.getMissionIdForVertex(vertex_id));
+  }
+  for (const pose_graph::VertexId& vertex_id : window->fixed_vertices) {
+    window->missions.insert(map.getMissionIdForVertex(vertex_id));
+  }
+}
+
+}  // namespace
+
+PartitionedOptimizationOptions
+PartitionedOptimizationOptions::initFromGFlags() {
+  CHECK_GT(FLAGS_ba_partitioned_num_partitions, 0);
+  CHECK_GT(FLAGS_ba_partitioned_num_iterations, 0);
+
+  PartitionedOptimizationOptions options;
+  options.num_partitions = FLAGS_ba_partitioned_num_partitions;
+  options.num_iterations = FLAGS_ba_partitioned_num_iterations;
+  return options;
+}
+
+void partitionMissionsForOptimization(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& missions,
+    const size_t num_partitions,
+    std::vector<pose_graph::VertexIdList>* partitions) {
+  CHECK_NOTNULL(partitions)->clear();
+  CHECK(!missions.empty());
+  CHECK_GT(num_partitions, 0u);
+
+  const std::vector<vi_map::MissionIdSet> clusters =
+      vi_map_helpers::clusterMissionByLandmarkCoobservations(map, missions);
+  std::unordered_map<vi_map::MissionId, size_t> mission_to_cluster;
+  for (size_t cluster_idx = 0u; cluster_idx < clusters.size(); ++cluster_idx) {
+    for (const vi_map::MissionId& mission_id : clusters[cluster_idx]) {
+      mission_to_cluster.emplace(mission_id, cluster_idx);
+    }
+  }
+
+  std::vector<pose_graph::VertexIdList> metis_partitions;
+  if (num_partitions > 1u) {
+    vi_map_helpers::VIMapPartitioner partitioner;
+    partitioner.partitionMapWithMetis(map, num_partitions, &metis_partitions);
+  } else {
+    metis_partitions.resize(1u);
+    map.getAllVertexIds(&metis_partitions.front());
+  }
+
+  for (const pose_graph::VertexIdList& metis_partition : metis_partitions) {
+    std::vector<pose_graph::VertexIdList> cluster_partitions(clusters.size());
+    for (const pose_graph::VertexId& vertex_id : metis_partition) {
+      const std::unordered_map<vi_map::MissionId, size_t>::const_iterator it =
+          mission_to_cluster.find(map.getMissionIdForVertex(vertex_id));
+      if (it != mission_to_cluster.end()) {
+        cluster_partitions[it->second].push_back(vertex_id);
+      }
+    }
+    for (pose_graph::VertexIdList& partition : cluster_partitions) {
+      if (!partition.empty()) {
+        partitions->emplace_back();
+        partitions->back().swap(partition);
+      }
+    }
+  }
+
+  VLOG(1) << "Split " << missions.size() << " mission(s) in "
+          << clusters.size() << " coobservation cluster(s) into "
+          << partitions->size() << " partition(s).";
+}
+
+void selectPartitionedOptimizationWindows(
+    const vi_map::VIMap& map,
+    const std::vector<pose_graph::VertexIdList>& partitions,
+    PartitionedOptimizationWindows* windows) {
+  CHECK_NOTNULL(windows);
+  windows->partition_windows.clear();
+  windows->partition_windows.resize(partitions.size());
+  windows->separator_window = LocalOptimizationWindow();
+
+  std::unordered_map<pose_graph::VertexId, size_t> vertex_to_partition;
+  for (size_t partition_idx = 0u; partition_idx < partitions.size();
+       ++partition_idx) {
+    for (const pose_graph::VertexId& vertex_id : partitions[partition_idx]) {
+      CHECK(map.hasVertex(vertex_id));
+      CHECK(vertex_to_partition.emplace(vertex_id, partition_idx).second)
+          << "Vertex " << vertex_id << " is part of more than one partition.";
+    }
+  }
+
+  // Landmarks observed from more than one partition are separators.
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_to_partition;
+  vi_map::LandmarkIdSet separator_landmarks;
+  vi_map::LandmarkIdList landmarks;
+  for (size_t partition_idx = 0u; partition_idx < partitions.size();
+       ++partition_idx) {
+    for (const pose_graph::VertexId& vertex_id : partitions[partition_idx]) {
+      getObservedLandmarks(map, vertex_id, &landmarks);
+      for (const vi_map::LandmarkId& landmark_id : landmarks) {
+        const std::pair<
+            std::unordered_map<vi_map::LandmarkId, size_t>::iterator, bool>
+            result = landmark_to_partition.emplace(landmark_id, partition_idx);
+        if (!result.second && result.first->second != partition_idx) {
+          separator_landmarks.insert(landmark_id);
+        }
+      }
+    }
+  }
+
+  // So are the vertices observing them or sharing an inertial edge with
+  // another partition.
+  pose_graph::VertexIdList neighbors;
+  for (size_t partition_idx = 0u; partition_idx < partitions.size();
+       ++partition_idx) {
+    LocalOptimizationWindow& window = windows->partition_windows[partition_idx];
+    for (const pose_graph::VertexId& vertex_id : partitions[partition_idx]) {
+      bool is_separator = false;
+      getObservedLandmarks(map, vertex_id, &landmarks);
+      for (const vi_map::LandmarkId& landmark_id : landmarks) {
+        if (separator_landmarks.count(landmark_id) > 0u) {
+          is_separator = true;
+        } else {
+          window.landmarks.insert(landmark_id);
+        }
+      }
+      getInertialNeighbors(map, vertex_id, &neighbors);
+      for (const pose_graph::VertexId& neighbor_id : neighbors) {
+        const std::unordered_map<pose_graph::VertexId, size_t>::const_iterator
+            it = vertex_to_partition.find(neighbor_id);
+        is_separator |=
+            it != vertex_to_partition.end() && it->second != partition_idx;
+      }
+
+      if (is_separator) {
+        window.fixed_vertices.push_back(vertex_id);
+        windows->separator_window.optimized_vertices.push_back(vertex_id);
+      } else {
+        window.optimized_vertices.push_back(vertex_id);
+      }
+    }
+    completeWindow(map, &window);
+  }
+
+  windows->separator_window.landmarks = separator_landmarks;
+  completeWindow(map, &windows->separator_window);
+
+  VLOG(1) << "Partitioned optimization with " << partitions.size()
+          << " partition(s), "
+          << windows->separator_window.optimized_vertices.size()
+          << " separator vertices and " << separator_landmarks.size()
+          << " separator landmarks.";
+}
+
+}  // namespace map_optimization
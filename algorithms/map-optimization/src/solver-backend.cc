@@ -0,0 +1,80 @@
+#include "map-optimization/solver-backend.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_string(
+    ba_solver_backend, "ceres",
+    "Name of the registered solver backend of the bundle adjustment. Problems "
+    "the backend doesn't support are solved with ceres.");
+
+namespace map_optimization {
+namespace {
+
+constexpr char kCeresBackendName[] = "ceres";
+
+typedef std::unordered_map<std::string, std::unique_ptr<SolverBackend>>
+    SolverBackendMap;
+
+SolverBackendMap& getBackends() {
+  static SolverBackendMap backends;
+  return backends;
+}
+
+std::mutex& getBackendsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+}  // namespace
+
+void registerSolverBackend(
+    const std::string& name, std::unique_ptr<SolverBackend> backend) {
+  CHECK(backend);
+  CHECK_NE(name, kCeresBackendName);
+  std::lock_guard<std::mutex> lock(getBackendsMutex());
+  getBackends()[name] = std::move(backend);
+}
+
+void unregisterSolverBackend(const std::string& name) {
+  std::lock_guard<std::mutex> lock(getBackendsMutex());
+  getBackends().erase(name);
+}
+
+SolverBackend* getSolverBackendFromFlags() {
+  if (FLAGS_ba_solver_backend == kCeresBackendName) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(getBackendsMutex());
+  SolverBackendMap::const_iterator it =
+      getBackends().find(FLAGS_ba_solver_backend);
+  CHECK(it != getBackends().end())
+      << "Unknown solver backend: " << FLAGS_ba_solver_backend;
+  return it->second.get();
+}
+
+bool hasOnlyVisualInertialTerms(
+    const ceres_error_terms::ProblemInformation& problem_information) {
+  for (const ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& residual_block : problem_information.residual_blocks) {
+    if (!residual_block.second.active_) {
+      continue;
+    }
+    switch (residual_block.second.residual_type) {
+      case ceres_error_terms::ResidualType::kVisualReprojectionError:
+      case ceres_error_terms::ResidualType::kInertial:
+      case ceres_error_terms::ResidualType::kPosePrior:
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace map_optimization
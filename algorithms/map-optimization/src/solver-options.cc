@@ -3,3 +3,7 @@
 DEFINE_int32(ba_num_iterations, 30, "Max. number of iterations.");
 DEFINE_bool(ba_use_jacobi_scaling, true, "Use jacobin scaling.");
 DEFINE_bool(ba_use_cgnr_linear_solver, false, "Use CGNR linear solver?");
+DEFINE_string(
+    ba_linear_solver_type, "SPARSE_NORMAL_CHOLESKY",
+    "Ceres linear solver type, e.g. SPARSE_NORMAL_CHOLESKY, SPARSE_SCHUR or "
+    "ITERATIVE_SCHUR. Ignored if --ba_use_cgnr_linear_solver is set.");
@@ -1,24 +1,108 @@
 #include "map-optimization/solver.h"
 
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
 #include <ceres-error-terms/problem-information.h>
 #include <ceres/ceres.h>
 
+#include "map-optimization/solver-backend.h"
+
 namespace map_optimization {
 
+void setLinearSolverOrdering(
+    const ceres::Problem& ceres_problem,
+    OptimizationProblem* optimization_problem,
+    ceres::Solver::Options* solver_options) {
+  CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(solver_options);
+  if (solver_options->linear_solver_type != ceres::SPARSE_SCHUR &&
+      solver_options->linear_solver_type != ceres::ITERATIVE_SCHUR) {
+    return;
+  }
+
+  vi_map::VIMap* map = CHECK_NOTNULL(optimization_problem->getMapMutable());
+  const OptimizationProblem::ProblemBookkeeping& bookkeeping =
+      *optimization_problem->getProblemBookkeepingMutable();
+  OptimizationStateBuffer* buffer =
+      optimization_problem->getOptimizationStateBufferMutable();
+
+  std::unordered_set<const double*> landmark_blocks;
+  for (const std::pair<const vi_map::LandmarkId, ceres::CostFunction*>&
+           landmark_and_cost : bookkeeping.landmarks_in_problem) {
+    landmark_blocks.insert(
+        map->getLandmark(landmark_and_cost.first).get_p_B_Mutable());
+  }
+  std::unordered_set<const double*> vertex_blocks;
+  for (const pose_graph::VertexId& vertex_id :
+       bookkeeping.keyframes_in_problem) {
+    vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    vertex_blocks.insert(buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id));
+    vertex_blocks.insert(vertex.get_v_M_Mutable());
+    vertex_blocks.insert(vertex.getGyroBiasMutable());
+    vertex_blocks.insert(vertex.getAccelBiasMutable());
+  }
+
+  // Ceres requires every parameter block of the problem to be part of the
+  // ordering, so the blocks are taken from the problem itself.
+  std::vector<double*> parameter_blocks;
+  ceres_problem.GetParameterBlocks(&parameter_blocks);
+  std::unique_ptr<ceres::ParameterBlockOrdering> ordering(
+      new ceres::ParameterBlockOrdering);
+  for (double* parameter_block : parameter_blocks) {
+    ParameterBlockGroup group = ParameterBlockGroup::kCalibrationAndBaseframes;
+    if (landmark_blocks.count(parameter_block) > 0u) {
+      group = ParameterBlockGroup::kLandmarks;
+    } else if (vertex_blocks.count(parameter_block) > 0u) {
+      group = ParameterBlockGroup::kVertexStates;
+    }
+    ordering->AddElementToGroup(parameter_block, static_cast<int>(group));
+  }
+
+  // The first group has to be an independent set, which only the landmarks
+  // are. Without landmarks, ceres is left to find an ordering itself.
+  if (ordering->GroupSize(static_cast<int>(ParameterBlockGroup::kLandmarks)) ==
+      0) {
+    VLOG(1) << "No landmarks in the problem, using the default ordering.";
+    return;
+  }
+  solver_options->linear_solver_ordering.reset(ordering.release());
+}
+
 ceres::TerminationType solve(
     const ceres::Solver::Options& solver_options,
     map_optimization::OptimizationProblem* optimization_problem) {
   CHECK_NOTNULL(optimization_problem);
 
-  ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
+  SolverBackend* backend = getSolverBackendFromFlags();
+  if (backend != nullptr &&
+      backend->supportsProblem(
+          *optimization_problem->getProblemInformationMutable())) {
+    const ceres::TerminationType termination_type =
+        backend->solve(solver_options, optimization_problem);
+    optimization_problem->getOptimizationStateBufferMutable()
+        ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
+    return termination_type;
+  } else if (backend != nullptr) {
+    LOG(WARNING) << "The solver backend " << FLAGS_ba_solver_backend
+                 << " doesn't support the problem, using ceres.";
+  }
+
+  ceres::Problem* problem =
+      CHECK_NOTNULL(optimization_problem->getCeresProblemMutable());
+
+  ceres::Solver::Options options = solver_options;
+  setLinearSolverOrdering(*problem, optimization_problem, &options);
 
   ceres::Solver::Summary summary;
-  ceres::Solve(solver_options, &problem, &summary);
+  ceres::Solve(options, problem, &summary);
 
   optimization_problem->getOptimizationStateBufferMutable()
       ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
+  if (!optimization_problem->getKeepCeresProblemAlive()) {
+    optimization_problem->resetCeresProblem();
+  }
 
   LOG(INFO) << summary.FullReport();
   return summary.termination_type;
@@ -0,0 +1,168 @@
+#include "map-optimization/time-budgeted-optimization.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <ceres-error-terms/problem-information.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_double(
+    ba_time_budget_seconds, 0.0,
+    "Wall time budget of a visual-inertial optimization. If positive, the "
+    "highest priority parts of the map are solved first and the rest is "
+    "added progressively until the budget is used up.");
+DEFINE_int32(
+    ba_time_budget_num_stages, 3,
+    "Number of solves of a time budgeted optimization. The last one covers "
+    "all missions.");
+DEFINE_int32(
+    ba_time_budget_num_prioritized_missions, 1,
+    "Number of newest missions whose vertices are optimized first in a time "
+    "budgeted optimization.");
+DEFINE_double(
+    ba_time_budget_min_stage_time_seconds, 1.0,
+    "Stages of a time budgeted optimization are skipped once less than this "
+    "time is left.");
+
+namespace map_optimization {
+
+TimeBudgetedOptimizationOptions
+TimeBudgetedOptimizationOptions::initFromGFlags() {
+  CHECK_GT(FLAGS_ba_time_budget_num_stages, 0);
+  CHECK_GE(FLAGS_ba_time_budget_num_prioritized_missions, 0);
+  CHECK_GE(FLAGS_ba_time_budget_min_stage_time_seconds, 0.0);
+
+  TimeBudgetedOptimizationOptions options;
+  options.time_budget_seconds = FLAGS_ba_time_budget_seconds;
+  options.num_stages = FLAGS_ba_time_budget_num_stages;
+  options.num_prioritized_missions =
+      FLAGS_ba_time_budget_num_prioritized_missions;
+  options.min_stage_time_seconds = FLAGS_ba_time_budget_min_stage_time_seconds;
+  return options;
+}
+
+void computeMeanResidualCostPerVertex(
+    OptimizationProblem* optimization_problem, VertexCostMap* vertex_costs) {
+  CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(vertex_costs)->clear();
+
+  OptimizationStateBuffer* buffer =
+      optimization_problem->getOptimizationStateBufferMutable();
+  std::unordered_map<const double*, pose_graph::VertexId> pose_block_to_vertex;
+  for (const pose_graph::VertexId& vertex_id :
+       optimization_problem->getProblemBookkeepingMutable()
+           ->keyframes_in_problem) {
+    pose_block_to_vertex.emplace(
+        buffer->get_vertex_q_IM__M_p_MI_JPL(vertex_id), vertex_id);
+  }
+
+  std::unordered_map<pose_graph::VertexId, size_t> num_residuals;
+  Eigen::VectorXd residuals;
+  for (const ceres_error_terms::ProblemInformation::ResidualInformationMap::
+           value_type& residual_block :
+       optimization_problem->getProblemInformationMutable()->residual_blocks) {
+    const ceres_error_terms::ResidualInformation& residual_info =
+        residual_block.second;
+    if (!residual_info.active_) {
+      continue;
+    }
+    ceres::CostFunction* cost_function =
+        CHECK_NOTNULL(residual_info.cost_function.get());
+    residuals.resize(cost_function->num_residuals());
+    if (!cost_function->Evaluate(
+            residual_info.parameter_blocks.data(), residuals.data(),
+            nullptr)) {
+      continue;
+    }
+    // Same convention as ceres: half the (robustified) squared norm.
+    double cost = residuals.squaredNorm();
+    if (residual_info.loss_function) {
+      double rho[3];
+      residual_info.loss_function->Evaluate(cost, rho);
+      cost = rho[0];
+    }
+    cost *= 0.5;
+
+    for (const double* parameter_block : residual_info.parameter_blocks) {
+      std::unordered_map<const double*, pose_graph::VertexId>::const_iterator
+          it = pose_block_to_vertex.find(parameter_block);
+      if (it != pose_block_to_vertex.end()) {
+        (*vertex_costs)[it->second] += cost;
+        ++num_residuals[it->second];
+      }
+    }
+  }
+
+  for (VertexCostMap::value_type& vertex_cost : *vertex_costs) {
+    vertex_cost.second /= num_residuals[vertex_cost.first];
+  }
+}
+
+void sortVerticesByOptimizationPriority(
+    const vi_map::VIMap& map, const vi_map::MissionIdSet& missions,
+    const vi_map::MissionIdSet& prioritized_missions,
+    const VertexCostMap& vertex_costs, pose_graph::VertexIdList* vertices) {
+  CHECK_NOTNULL(vertices)->clear();
+  for (const vi_map::MissionId& mission_id : missions) {
+    pose_graph::VertexIdList mission_vertices;
+    map.getAllVertexIdsInMissionAlongGraph(mission_id, &mission_vertices);
+    vertices->insert(
+        vertices->end(), mission_vertices.begin(), mission_vertices.end());
+  }
+
+  auto is_prioritized = [&](const pose_graph::VertexId& vertex_id) {
+    return prioritized_missions.count(map.getMissionIdForVertex(vertex_id)) >
+           0u;
+  };
+  auto get_cost = [&](const pose_graph::VertexId& vertex_id) {
+    VertexCostMap::const_iterator it = vertex_costs.find(vertex_id);
+    return it == vertex_costs.end() ? -1.0 : it->second;
+  };
+  // Ties are broken by id to keep the order deterministic.
+  std::sort(
+      vertices->begin(), vertices->end(),
+      [&](const pose_graph::VertexId& lhs, const pose_graph::VertexId& rhs) {
+        const bool lhs_prioritized = is_prioritized(lhs);
+        const bool rhs_prioritized = is_prioritized(rhs);
+        if (lhs_prioritized != rhs_prioritized) {
+          return lhs_prioritized;
+        }
+        const double lhs_cost = get_cost(lhs);
+        const double rhs_cost = get_cost(rhs);
+        return lhs_cost > rhs_cost || (lhs_cost == rhs_cost && lhs < rhs);
+      });
+}
+
+void selectTimeBudgetedOptimizationWindows(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& sorted_vertices,
+    const TimeBudgetedOptimizationOptions& options,
+    const LocalOptimizationWindowOptions& window_options,
+    std::vector<LocalOptimizationWindow>* windows) {
+  CHECK_NOTNULL(windows)->clear();
+  CHECK_GT(options.num_stages, 0u);
+
+  const size_t num_vertices = sorted_vertices.size();
+  size_t previous_num_core_vertices = 0u;
+  for (size_t stage = 0u; stage + 1u < options.num_stages; ++stage) {
+    const size_t num_core_vertices =
+        (stage + 1u) * num_vertices / options.num_stages;
+    if (num_core_vertices == previous_num_core_vertices) {
+      continue;
+    }
+    previous_num_core_vertices = num_core_vertices;
+
+    const pose_graph::VertexIdList core_vertices(
+        sorted_vertices.begin(), sorted_vertices.begin() + num_core_vertices);
+    windows->emplace_back();
+    selectLocalOptimizationWindow(
+        map, core_vertices, window_options, &windows->back());
+    if (windows->back().optimized_vertices.empty()) {
+      windows->pop_back();
+    }
+  }
+}
+
+}  // namespace map_optimization
@@ -1,8 +1,12 @@
 #include "map-optimization/vi-map-optimizer.h"
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <map-optimization/callbacks.h>
 #include <map-optimization/outlier-rejection-solver.h>
@@ -16,6 +20,9 @@
 DEFINE_int32(
     ba_visualize_every_n_iterations, 3,
     "Update the visualization every n optimization iterations.");
+DEFINE_double(
+    ba_local_max_solver_time_seconds, 1.0,
+    "Maximum solver time of a local bundle adjustment.");
 
 namespace map_optimization {
 
@@ -54,11 +61,242 @@ bool VIMapOptimizer::optimizeVisualInertial(
     return false;
   }
 
+  const map_optimization::TimeBudgetedOptimizationOptions time_budget_options =
+      map_optimization::TimeBudgetedOptimizationOptions::initFromGFlags();
+  if (time_budget_options.isEnabled()) {
+    return optimizeTimeBudgetedVisualInertial(
+        options, time_budget_options, solver_options, missions_to_optimize,
+        outlier_rejection_options, map);
+  }
+
   map_optimization::OptimizationProblem::UniquePtr optimization_problem(
       map_optimization::constructViProblem(missions_to_optimize, options, map));
   CHECK(optimization_problem != nullptr);
 
-  std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks;
+  solve(
+      solver_options, outlier_rejection_options, optimization_problem.get(),
+      map);
+  return true;
+}
+
+bool VIMapOptimizer::optimizeLocalVisualInertial(
+    const map_optimization::ViProblemOptions& options,
+    const map_optimization::LocalOptimizationWindow& window,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+
+  ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  solver_options.max_solver_time_in_seconds =
+      FLAGS_ba_local_max_solver_time_seconds;
+  return optimizeLocalVisualInertial(
+      options, solver_options, window, outlier_rejection_options, map);
+}
+
+bool VIMapOptimizer::optimizeLocalVisualInertial(
+    const map_optimization::ViProblemOptions& options,
+    const ceres::Solver::Options& solver_options,
+    const map_optimization::LocalOptimizationWindow& window,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+
+  if (window.optimized_vertices.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  map_optimization::OptimizationProblem::UniquePtr optimization_problem(
+      map_optimization::constructLocalViProblem(window, options, map));
+  CHECK(optimization_problem != nullptr);
+
+  solve(
+      solver_options, outlier_rejection_options, optimization_problem.get(),
+      map);
+  return true;
+}
+
+bool VIMapOptimizer::optimizePartitionedVisualInertial(
+    const map_optimization::ViProblemOptions& options,
+    const map_optimization::PartitionedOptimizationOptions&
+        partitioned_options,
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+
+  if (missions_to_optimize.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  std::vector<pose_graph::VertexIdList> partitions;
+  map_optimization::partitionMissionsForOptimization(
+      *map, missions_to_optimize, partitioned_options.num_partitions,
+      &partitions);
+  map_optimization::PartitionedOptimizationWindows windows;
+  map_optimization::selectPartitionedOptimizationWindows(
+      *map, partitions, &windows);
+
+  // The problems share the state buffers of their missions, so they are
+  // solved one after the other.
+  const ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  for (size_t iteration = 0u; iteration < partitioned_options.num_iterations;
+       ++iteration) {
+    VLOG(1) << "Partitioned optimization iteration " << iteration + 1u << "/"
+            << partitioned_options.num_iterations << ".";
+    for (const map_optimization::LocalOptimizationWindow& window :
+         windows.partition_windows) {
+      if (!window.optimized_vertices.empty()) {
+        optimizeLocalVisualInertial(
+            options, solver_options, window, outlier_rejection_options, map);
+      }
+    }
+    if (!windows.separator_window.optimized_vertices.empty()) {
+      optimizeLocalVisualInertial(
+          options, solver_options, windows.separator_window,
+          outlier_rejection_options, map);
+    }
+  }
+  return true;
+}
+
+bool VIMapOptimizer::optimizeTimeBudgetedVisualInertial(
+    const map_optimization::ViProblemOptions& options,
+    const map_optimization::TimeBudgetedOptimizationOptions&
+        time_budget_options,
+    const ceres::Solver::Options& solver_options,
+    const vi_map::MissionIdSet& missions_to_optimize,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    vi_map::VIMap* map) {
+  // outlier_rejection_options is optional.
+  CHECK_NOTNULL(map);
+  CHECK(time_budget_options.isEnabled());
+
+  if (missions_to_optimize.empty()) {
+    LOG(WARNING) << "Nothing to optimize.";
+    return false;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(
+                             time_budget_options.time_budget_seconds));
+  auto get_remaining_seconds = [&deadline]() {
+    return std::chrono::duration<double>(deadline - Clock::now()).count();
+  };
+
+  // The newest missions are usually the ones that were just merged into the
+  // map.
+  vi_map::MissionIdSet prioritized_missions;
+  vi_map::MissionIdList missions_sorted_by_timestamp;
+  map->getAllMissionIdsSortedByTimestamp(&missions_sorted_by_timestamp);
+  for (vi_map::MissionIdList::const_reverse_iterator it =
+           missions_sorted_by_timestamp.rbegin();
+       it != missions_sorted_by_timestamp.rend() &&
+       prioritized_missions.size() <
+           time_budget_options.num_prioritized_missions;
+       ++it) {
+    if (missions_to_optimize.count(*it) > 0u) {
+      prioritized_missions.insert(*it);
+    }
+  }
+
+  // The residuals of the full problem tell where the map is inconsistent. The
+  // problem is built again for the last stage, as the earlier stages change
+  // the map behind its state buffer.
+  map_optimization::VertexCostMap vertex_costs;
+  {
+    map_optimization::OptimizationProblem::UniquePtr full_problem(
+        map_optimization::constructViProblem(
+            missions_to_optimize, options, map));
+    CHECK(full_problem != nullptr);
+    map_optimization::computeMeanResidualCostPerVertex(
+        full_problem.get(), &vertex_costs);
+  }
+  pose_graph::VertexIdList sorted_vertices;
+  map_optimization::sortVerticesByOptimizationPriority(
+      *map, missions_to_optimize, prioritized_missions, vertex_costs,
+      &sorted_vertices);
+
+  std::vector<map_optimization::LocalOptimizationWindow> windows;
+  map_optimization::selectTimeBudgetedOptimizationWindows(
+      *map, sorted_vertices, time_budget_options,
+      map_optimization::LocalOptimizationWindowOptions::initFromGFlags(),
+      &windows);
+
+  const size_t num_stages = windows.size() + 1u;
+  for (size_t stage = 0u; stage < num_stages; ++stage) {
+    const double remaining_seconds = get_remaining_seconds();
+    if (remaining_seconds < time_budget_options.min_stage_time_seconds) {
+      LOG(INFO) << "Time budget used up after " << stage << "/" << num_stages
+                << " optimization stages.";
+      break;
+    }
+
+    map_optimization::OptimizationProblem::UniquePtr optimization_problem;
+    if (stage < windows.size()) {
+      VLOG(1) << "Time budgeted optimization stage " << stage + 1u << "/"
+              << num_stages << " with "
+              << windows[stage].optimized_vertices.size()
+              << " optimized vertices.";
+      optimization_problem.reset(
+          map_optimization::constructLocalViProblem(
+              windows[stage], options, map));
+    } else {
+      VLOG(1) << "Time budgeted optimization stage " << stage + 1u << "/"
+              << num_stages << " over all missions.";
+      optimization_problem.reset(
+          map_optimization::constructViProblem(
+              missions_to_optimize, options, map));
+    }
+    CHECK(optimization_problem != nullptr);
+
+    // Building the problem takes part of the budget as well.
+    ceres::Solver::Options stage_solver_options = solver_options;
+    stage_solver_options.max_solver_time_in_seconds = std::min(
+        stage_solver_options.max_solver_time_in_seconds,
+        std::max(get_remaining_seconds(), 0.0));
+    std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks;
+    callbacks.emplace_back(new map_optimization::DeadlineCallback(deadline));
+    solve(
+        callbacks, stage_solver_options, outlier_rejection_options,
+        optimization_problem.get(), map);
+  }
+  return true;
+}
+
+void VIMapOptimizer::solve(
+    const ceres::Solver::Options& solver_options,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    map_optimization::OptimizationProblem* optimization_problem,
+    vi_map::VIMap* map) {
+  solve(
+      std::vector<std::shared_ptr<ceres::IterationCallback>>(), solver_options,
+      outlier_rejection_options, optimization_problem, map);
+}
+
+void VIMapOptimizer::solve(
+    std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks,
+    const ceres::Solver::Options& solver_options,
+    const map_optimization::OutlierRejectionSolverOptions* const
+        outlier_rejection_options,
+    map_optimization::OptimizationProblem* optimization_problem,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(map);
+
   if (plotter_) {
     map_optimization::appendVisualizationCallbacks(
         FLAGS_ba_visualize_every_n_iterations,
@@ -73,16 +311,15 @@ bool VIMapOptimizer::optimizeVisualInertial(
   if (outlier_rejection_options != nullptr) {
     map_optimization::solveWithOutlierRejection(
         solver_options_with_callbacks, *outlier_rejection_options,
-        optimization_problem.get());
+        optimization_problem);
   } else {
     map_optimization::solve(
-        solver_options_with_callbacks, optimization_problem.get());
+        solver_options_with_callbacks, optimization_problem);
   }
 
   if (plotter_ != nullptr) {
     plotter_->visualizeMap(*map);
   }
-  return true;
 }
 
 }  // namespace map_optimization
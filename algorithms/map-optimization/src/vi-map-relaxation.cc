@@ -7,6 +7,7 @@
 #include <loop-closure-handler/loop-detector-node.h>
 #include <map-optimization/augment-loopclosure.h>
 #include <map-optimization/callbacks.h>
+#include <map-optimization/coarse-to-fine-relaxation.h>
 #include <map-optimization/outlier-rejection-solver.h>
 #include <map-optimization/solver-options.h>
 #include <map-optimization/solver.h>
@@ -20,6 +21,21 @@ class ViwlsGraphRvizPlotter;
 
 namespace map_optimization {
 
+ViProblemOptions initRelaxationProblemOptionsFromGFlags() {
+  ViProblemOptions options = ViProblemOptions::initFromGFlags();
+
+  // Specific relaxation options.
+  options.fix_accel_bias = true;
+  options.fix_gyro_bias = true;
+  options.fix_velocity = true;
+
+  options.fix_intrinsics = true;
+  options.fix_extrinsics_rotation = true;
+  options.fix_extrinsics_translation = true;
+  options.fix_landmark_positions = true;
+  return options;
+}
+
 VIMapRelaxation::VIMapRelaxation(
     visualization::ViwlsGraphRvizPlotter* plotter, bool signal_handler_enabled)
     : plotter_(plotter), signal_handler_enabled_(signal_handler_enabled) {}
@@ -100,18 +116,8 @@ bool VIMapRelaxation::relax(
   }
   LOG(INFO) << num_lc_edges << " loopclosure edges found.";
 
-  map_optimization::ViProblemOptions options =
-      map_optimization::ViProblemOptions::initFromGFlags();
-
-  // Specific relaxation options.
-  options.fix_accel_bias = true;
-  options.fix_gyro_bias = true;
-  options.fix_velocity = true;
-
-  options.fix_intrinsics = true;
-  options.fix_extrinsics_rotation = true;
-  options.fix_extrinsics_translation = true;
-  options.fix_landmark_positions = true;
+  const map_optimization::ViProblemOptions options =
+      initRelaxationProblemOptionsFromGFlags();
 
   map_optimization::OptimizationProblem* optimization_problem =
       map_optimization::constructViProblem(mission_ids, options, map);
@@ -133,6 +139,18 @@ bool VIMapRelaxation::relax(
   map_optimization::addCallbacksToSolverOptions(
       callbacks, &solver_options_with_callbacks);
 
+  // After large drift corrections the full problem converges slowly, the
+  // coarse stage moves the poses close to the solution first.
+  const CoarseToFineRelaxationOptions coarse_to_fine_options =
+      CoarseToFineRelaxationOptions::initFromGFlags();
+  if (coarse_to_fine_options.isEnabled()) {
+    relaxDecimatedPoseGraph(
+        coarse_to_fine_options, solver_options, mission_ids,
+        optimization_problem);
+    solver_options_with_callbacks.max_num_iterations =
+        coarse_to_fine_options.num_fine_iterations;
+  }
+
   map_optimization::solve(solver_options_with_callbacks, optimization_problem);
 
   visualizePosegraph(*map);
@@ -1,5 +1,7 @@
 #include "map-optimization/vi-optimization-builder.h"
 
+#include <unordered_map>
+
 #include <gflags/gflags.h>
 #include <vi-map-helpers/mission-clustering-coobservation.h>
 
@@ -39,6 +41,11 @@ DEFINE_double(
     ba_altitude_meters, common::locations::kAltitudeZurichMeters,
     "Altitude in meters to estimate the gravity magnitude.");
 
+DEFINE_string(
+    ba_inertial_term_type, "rk4",
+    "Inertial error-term to use: 'rk4' integrates the IMU measurements at "
+    "every evaluation, 'preintegrated' preintegrates them once per edge.");
+
 DEFINE_int32(
     ba_min_landmark_per_frame, 0,
     "Minimum number of landmarks a frame must observe to be included in the "
@@ -54,6 +61,14 @@ ViProblemOptions ViProblemOptions::initFromGFlags() {
   options.fix_accel_bias = FLAGS_ba_fix_accel_bias;
   options.fix_velocity = FLAGS_ba_fix_velocity;
   options.min_landmarks_per_frame = FLAGS_ba_min_landmark_per_frame;
+  if (FLAGS_ba_inertial_term_type == "rk4") {
+    options.inertial_term_type = InertialTermType::kRungeKutta;
+  } else if (FLAGS_ba_inertial_term_type == "preintegrated") {
+    options.inertial_term_type = InertialTermType::kPreintegrated;
+  } else {
+    LOG(FATAL) << "Unknown inertial term type: "
+               << FLAGS_ba_inertial_term_type;
+  }
 
   common::GravityProvider gravity_provider(
       FLAGS_ba_altitude_meters, FLAGS_ba_latitude);
@@ -92,7 +107,7 @@ OptimizationProblem* constructViProblem(
   if (options.add_inertial_constraints) {
     addInertialTerms(
         options.fix_gyro_bias, options.fix_accel_bias, options.fix_velocity,
-        options.gravity_magnitude, problem);
+        options.gravity_magnitude, options.inertial_term_type, problem);
   }
 
   // Fixing open DoF of the visual(-inertial) problem. We assume that if there
@@ -133,4 +148,75 @@ OptimizationProblem* constructViProblem(
   return problem;
 }
 
+OptimizationProblem* constructLocalViProblem(
+    const LocalOptimizationWindow& window, const ViProblemOptions& options,
+    vi_map::VIMap* map) {
+  CHECK(map);
+  CHECK(options.isValid());
+  CHECK(!window.fixed_vertices.empty());
+
+  LOG_IF(
+      FATAL,
+      !options.add_visual_constraints && !options.add_inertial_constraints)
+      << "Either enable visual or inertial constraints; otherwise don't call "
+      << "this function.";
+
+  OptimizationProblem* problem = new OptimizationProblem(map, window.missions);
+  const OptimizationProblem::LocalParameterizations& parameterizations =
+      problem->getLocalParameterizations();
+
+  if (options.add_visual_constraints) {
+    // The fixed vertices only contribute their observations of the window
+    // landmarks.
+    pose_graph::VertexIdList vertices = window.optimized_vertices;
+    vertices.insert(
+        vertices.end(), window.fixed_vertices.begin(),
+        window.fixed_vertices.end());
+    addVisualTermsForVertices(
+        options.fix_landmark_positions, options.fix_intrinsics,
+        options.fix_extrinsics_rotation, options.fix_extrinsics_translation,
+        options.min_landmarks_per_frame,
+        parameterizations.pose_parameterization,
+        parameterizations.baseframe_parameterization,
+        parameterizations.quaternion_parameterization, vertices,
+        window.landmarks, problem);
+  }
+  if (options.add_inertial_constraints) {
+    // All inertial neighbors of the optimized vertices are part of the window.
+    pose_graph::EdgeIdSet added_edges;
+    std::unordered_map<vi_map::MissionId, pose_graph::EdgeIdList>
+        mission_edges;
+    for (const pose_graph::VertexId& vertex_id : window.optimized_vertices) {
+      pose_graph::EdgeIdSet edges;
+      map->getVertex(vertex_id).getAllEdges(&edges);
+      for (const pose_graph::EdgeId& edge_id : edges) {
+        if (map->getEdgeType(edge_id) == pose_graph::Edge::EdgeType::kViwls &&
+            added_edges.insert(edge_id).second) {
+          mission_edges[map->getMissionIdForVertex(vertex_id)].push_back(
+              edge_id);
+        }
+      }
+    }
+
+    const vi_map::SensorManager& sensor_manager = map->getSensorManager();
+    for (const std::pair<const vi_map::MissionId, pose_graph::EdgeIdList>&
+             mission_and_edges : mission_edges) {
+      const vi_map::Imu& imu_sensor =
+          sensor_manager.getSensorForMission<vi_map::Imu>(
+              mission_and_edges.first);
+      addInertialTermsForEdges(
+          options.fix_gyro_bias, options.fix_accel_bias, options.fix_velocity,
+          options.gravity_magnitude, options.inertial_term_type,
+          imu_sensor.getImuSigmas(),
+          parameterizations.pose_parameterization, mission_and_edges.second,
+          problem);
+    }
+  }
+
+  fixVertexStatesInProblem(window.fixed_vertices, problem);
+  fixAllBaseframesInProblem(problem);
+
+  return problem;
+}
+
 }  // namespace map_optimization
@@ -1,10 +1,33 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 #include <ceres/ceres.h>
+#include <gflags/gflags.h>
 #include <map-manager/map-manager.h>
+#include <maplab-common/pose_types.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
+#include <vi-map/loopclosure-edge.h>
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 
+#include "map-optimization/augment-loopclosure.h"
+#include "map-optimization/coarse-to-fine-relaxation.h"
+#include "map-optimization/incremental-vi-map-relaxation.h"
+#include "map-optimization/local-optimization-window.h"
+#include "map-optimization/partitioned-optimization.h"
+#include "map-optimization/solver-backend.h"
+#include "map-optimization/solver-options.h"
+#include "map-optimization/solver.h"
+#include "map-optimization/time-budgeted-optimization.h"
 #include "map-optimization/vi-map-optimizer.h"
+#include "map-optimization/vi-map-relaxation.h"
+#include "map-optimization/vi-optimization-builder.h"
+
+DECLARE_int32(relaxation_coarse_to_fine_vertex_stride);
+DECLARE_int32(relaxation_incremental_num_hops);
 
 namespace visual_inertial_mapping {
 
@@ -12,13 +35,20 @@ class ViMappingTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
     test_app_.loadDataset("./test_maps/vi_app_test");
+    inertial_term_type_ =
+        map_optimization::ViProblemOptions::initFromGFlags()
+            .inertial_term_type;
   }
 
   virtual void corruptVertices();
   virtual void corruptLandmarks();
   bool optimize(bool vision_only);
+  bool optimize(
+      bool vision_only, const ceres::Solver::Options& solver_options);
+  void selectLocalWindow(map_optimization::LocalOptimizationWindow* window);
 
   VIMappingTestApp test_app_;
+  map_optimization::InertialTermType inertial_term_type_;
 };
 
 void ViMappingTest::corruptVertices() {
@@ -37,9 +67,16 @@ void ViMappingTest::corruptLandmarks() {
 }
 
 bool ViMappingTest::optimize(bool vision_only) {
+  return optimize(
+      vision_only, map_optimization::initSolverOptionsFromFlags());
+}
+
+bool ViMappingTest::optimize(
+    bool vision_only, const ceres::Solver::Options& solver_options) {
   map_optimization::ViProblemOptions options =
       map_optimization::ViProblemOptions::initFromGFlags();
   options.fix_landmark_positions = vision_only;
+  options.inertial_term_type = inertial_term_type_;
 
   visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
   constexpr bool kSignalHandlerEnabled = false;
@@ -54,7 +91,23 @@ bool ViMappingTest::optimize(bool vision_only) {
   map_optimization::OutlierRejectionSolverOptions rejection_options =
       map_optimization::OutlierRejectionSolverOptions::initFromFlags();
   return optimizer.optimizeVisualInertial(
-      options, mission_ids, &rejection_options, map);
+      options, solver_options, mission_ids, &rejection_options, map);
+}
+
+void ViMappingTest::selectLocalWindow(
+    map_optimization::LocalOptimizationWindow* window) {
+  const vi_map::VIMap& map = *CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  CHECK(!mission_ids.empty());
+
+  map_optimization::LocalOptimizationWindowOptions options =
+      map_optimization::LocalOptimizationWindowOptions::initFromGFlags();
+  options.num_core_vertices = 5u;
+  options.max_num_covisible_vertices = 5u;
+  options.max_num_fixed_vertices = 5u;
+  map_optimization::selectLocalOptimizationWindowOfLatestVertices(
+      map, mission_ids.front(), options, window);
 }
 
 TEST_F(ViMappingTest, TestIsDatasetConsistent) {
@@ -75,6 +128,21 @@ TEST_F(ViMappingTest, TestCorruptedVisualInertialOptimization) {
       kPrecisionM, kMinPassingLandmarkFraction);
 }
 
+TEST_F(ViMappingTest, TestCorruptedPreintegratedVisualInertialOptimization) {
+  corruptVertices();
+  corruptLandmarks();
+
+  inertial_term_type_ = map_optimization::InertialTermType::kPreintegrated;
+  const bool kVisionOnly = false;
+  EXPECT_TRUE(optimize(kVisionOnly));
+
+  const double kPrecisionM = 0.01;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+  const double kMinPassingLandmarkFraction = 0.99;
+  test_app_.testIfLandmarksMatchReference(
+      kPrecisionM, kMinPassingLandmarkFraction);
+}
+
 TEST_F(ViMappingTest, TestCorruptedVisualOptimization) {
   corruptLandmarks();
 
@@ -88,6 +156,406 @@ TEST_F(ViMappingTest, TestCorruptedVisualOptimization) {
       kPrecisionM, kMinPassingLandmarkFraction);
 }
 
+// Compares the Schur-type linear solvers with the default solver on the test
+// map. The timings are only logged, the accuracy is checked.
+TEST_F(ViMappingTest, TestLinearSolverTypes) {
+  const std::vector<std::string> kLinearSolverTypes = {
+      "SPARSE_NORMAL_CHOLESKY", "SPARSE_SCHUR", "ITERATIVE_SCHUR"};
+  const std::string default_linear_solver_type = FLAGS_ba_linear_solver_type;
+  for (const std::string& linear_solver_type : kLinearSolverTypes) {
+    test_app_.loadDataset("./test_maps/vi_app_test");
+    corruptVertices();
+    corruptLandmarks();
+
+    FLAGS_ba_linear_solver_type = linear_solver_type;
+    const ceres::Solver::Options solver_options =
+        map_optimization::initSolverOptionsFromFlags();
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    const bool kVisionOnly = false;
+    EXPECT_TRUE(optimize(kVisionOnly, solver_options));
+    const std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start;
+    LOG(INFO) << linear_solver_type << ": " << duration.count() << " s";
+
+    const double kPrecisionM = 0.01;
+    test_app_.testIfKeyframesMatchReference(kPrecisionM);
+    const double kMinPassingLandmarkFraction = 0.99;
+    test_app_.testIfLandmarksMatchReference(
+        kPrecisionM, kMinPassingLandmarkFraction);
+  }
+  FLAGS_ba_linear_solver_type = default_linear_solver_type;
+}
+
+class CountingSolverBackend : public map_optimization::SolverBackend {
+ public:
+  explicit CountingSolverBackend(size_t* num_solves)
+      : num_solves_(CHECK_NOTNULL(num_solves)) {}
+
+  bool supportsProblem(const ceres_error_terms::ProblemInformation&
+                       /*problem_information*/) const override {
+    return true;
+  }
+
+  ceres::TerminationType solve(
+      const ceres::Solver::Options& /*solver_options*/,
+      map_optimization::OptimizationProblem* /*optimization_problem*/)
+      override {
+    ++(*num_solves_);
+    return ceres::CONVERGENCE;
+  }
+
+ private:
+  size_t* num_solves_;
+};
+
+TEST_F(ViMappingTest, TestSolverBackendIsSelectedByFlag) {
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructViProblem(
+          mission_ids, map_optimization::ViProblemOptions::initFromGFlags(),
+          map));
+
+  size_t num_solves = 0u;
+  map_optimization::registerSolverBackend(
+      "counting", std::unique_ptr<map_optimization::SolverBackend>(
+                      new CountingSolverBackend(&num_solves)));
+  const std::string default_solver_backend = FLAGS_ba_solver_backend;
+  FLAGS_ba_solver_backend = "counting";
+  EXPECT_EQ(
+      map_optimization::solve(
+          map_optimization::initSolverOptionsFromFlags(), problem.get()),
+      ceres::CONVERGENCE);
+  EXPECT_EQ(num_solves, 1u);
+  FLAGS_ba_solver_backend = default_solver_backend;
+  map_optimization::unregisterSolverBackend("counting");
+
+  // The untouched map still matches the reference.
+  const double kPrecisionM = 1e-6;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+}
+
+TEST_F(ViMappingTest, TestLocalOptimizationWindowIsBounded) {
+  map_optimization::LocalOptimizationWindow window;
+  selectLocalWindow(&window);
+
+  // Up to 5 core and 5 covisible vertices are optimized. Landmark store
+  // vertices and inertial neighbors can add fixed vertices beyond the 5
+  // fixed observers.
+  ASSERT_FALSE(window.optimized_vertices.empty());
+  EXPECT_LE(window.optimized_vertices.size(), 10u);
+  EXPECT_FALSE(window.fixed_vertices.empty());
+  EXPECT_FALSE(window.landmarks.empty());
+
+  const std::unordered_set<pose_graph::VertexId> optimized_vertices(
+      window.optimized_vertices.begin(), window.optimized_vertices.end());
+  EXPECT_EQ(optimized_vertices.size(), window.optimized_vertices.size());
+  for (const pose_graph::VertexId& vertex_id : window.fixed_vertices) {
+    EXPECT_EQ(optimized_vertices.count(vertex_id), 0u);
+  }
+}
+
+TEST_F(ViMappingTest, TestLocalVisualInertialOptimizationFixesBoundary) {
+  corruptVertices();
+
+  map_optimization::LocalOptimizationWindow window;
+  selectLocalWindow(&window);
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  Aligned<std::vector, pose::Transformation> T_M_I_fixed;
+  for (const pose_graph::VertexId& vertex_id : window.fixed_vertices) {
+    T_M_I_fixed.push_back(map->getVertex(vertex_id).get_T_M_I());
+  }
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  EXPECT_TRUE(
+      optimizer.optimizeLocalVisualInertial(options, window, nullptr, map));
+
+  for (size_t i = 0u; i < window.fixed_vertices.size(); ++i) {
+    const pose::Transformation& T_M_I =
+        map->getVertex(window.fixed_vertices[i]).get_T_M_I();
+    EXPECT_NEAR_KINDR_QUATERNION(
+        T_M_I.getRotation(), T_M_I_fixed[i].getRotation(), 1e-9);
+    EXPECT_NEAR_EIGEN(T_M_I.getPosition(), T_M_I_fixed[i].getPosition(), 1e-9);
+  }
+}
+
+TEST_F(ViMappingTest, TestPartitionedOptimizationWindowsAreDisjoint) {
+  const vi_map::VIMap& map = *CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  ASSERT_FALSE(mission_ids.empty());
+
+  // Split the first mission in two halves along the graph.
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIdsInMissionAlongGraph(mission_ids.front(), &vertex_ids);
+  ASSERT_GT(vertex_ids.size(), 2u);
+  const size_t half = vertex_ids.size() / 2u;
+  std::vector<pose_graph::VertexIdList> partitions(2u);
+  partitions[0].assign(vertex_ids.begin(), vertex_ids.begin() + half);
+  partitions[1].assign(vertex_ids.begin() + half, vertex_ids.end());
+
+  map_optimization::PartitionedOptimizationWindows windows;
+  map_optimization::selectPartitionedOptimizationWindows(
+      map, partitions, &windows);
+  ASSERT_EQ(windows.partition_windows.size(), 2u);
+
+  const map_optimization::LocalOptimizationWindow& separator_window =
+      windows.separator_window;
+  EXPECT_FALSE(separator_window.optimized_vertices.empty());
+  EXPECT_FALSE(separator_window.fixed_vertices.empty());
+
+  std::unordered_set<pose_graph::VertexId> optimized_vertices(
+      separator_window.optimized_vertices.begin(),
+      separator_window.optimized_vertices.end());
+  size_t num_optimized_vertices = separator_window.optimized_vertices.size();
+  for (const map_optimization::LocalOptimizationWindow& window :
+       windows.partition_windows) {
+    EXPECT_FALSE(window.fixed_vertices.empty());
+    optimized_vertices.insert(
+        window.optimized_vertices.begin(), window.optimized_vertices.end());
+    num_optimized_vertices += window.optimized_vertices.size();
+    for (const vi_map::LandmarkId& landmark_id : window.landmarks) {
+      EXPECT_EQ(separator_window.landmarks.count(landmark_id), 0u);
+      EXPECT_EQ(
+          windows.partition_windows[0].landmarks.count(landmark_id) +
+              windows.partition_windows[1].landmarks.count(landmark_id),
+          1u);
+    }
+  }
+  // Every vertex is optimized in exactly one of the problems.
+  EXPECT_EQ(num_optimized_vertices, optimized_vertices.size());
+  EXPECT_EQ(num_optimized_vertices, vertex_ids.size());
+}
+
+TEST_F(ViMappingTest, TestCorruptedPartitionedVisualInertialOptimization) {
+  corruptVertices();
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  map_optimization::PartitionedOptimizationOptions partitioned_options =
+      map_optimization::PartitionedOptimizationOptions::initFromGFlags();
+  partitioned_options.num_partitions = 2u;
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  EXPECT_TRUE(optimizer.optimizePartitionedVisualInertial(
+      options, partitioned_options, mission_ids, nullptr, map));
+
+  const double kPrecisionM = 0.05;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+}
+
+TEST_F(ViMappingTest, TestVerticesAreSortedByDecreasingResidualCost) {
+  corruptVertices();
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructViProblem(
+          mission_ids, map_optimization::ViProblemOptions::initFromGFlags(),
+          map));
+  map_optimization::VertexCostMap vertex_costs;
+  map_optimization::computeMeanResidualCostPerVertex(
+      problem.get(), &vertex_costs);
+  ASSERT_FALSE(vertex_costs.empty());
+
+  pose_graph::VertexIdList sorted_vertices;
+  map_optimization::sortVerticesByOptimizationPriority(
+      *map, mission_ids, vi_map::MissionIdSet(), vertex_costs,
+      &sorted_vertices);
+  EXPECT_EQ(sorted_vertices.size(), map->numVertices());
+  for (size_t i = 1u; i < sorted_vertices.size(); ++i) {
+    const double previous_cost = vertex_costs.count(sorted_vertices[i - 1u])
+                                     ? vertex_costs[sorted_vertices[i - 1u]]
+                                     : -1.0;
+    const double cost = vertex_costs.count(sorted_vertices[i])
+                            ? vertex_costs[sorted_vertices[i]]
+                            : -1.0;
+    EXPECT_GE(previous_cost, cost);
+  }
+}
+
+TEST_F(ViMappingTest, TestCorruptedTimeBudgetedVisualInertialOptimization) {
+  corruptVertices();
+
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  map_optimization::TimeBudgetedOptimizationOptions time_budget_options =
+      map_optimization::TimeBudgetedOptimizationOptions::initFromGFlags();
+  // Large enough for all stages to run to convergence.
+  time_budget_options.time_budget_seconds = 600.0;
+  time_budget_options.num_stages = 3u;
+
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+
+  visualization::ViwlsGraphRvizPlotter* plotter = nullptr;
+  constexpr bool kSignalHandlerEnabled = false;
+  map_optimization::VIMapOptimizer optimizer(plotter, kSignalHandlerEnabled);
+  EXPECT_TRUE(optimizer.optimizeTimeBudgetedVisualInertial(
+      options, time_budget_options,
+      map_optimization::initSolverOptionsFromFlags(), mission_ids, nullptr,
+      map));
+
+  const double kPrecisionM = 0.05;
+  test_app_.testIfKeyframesMatchReference(kPrecisionM);
+}
+
+TEST_F(ViMappingTest, TestIncrementalRelaxationOnlyUpdatesAroundNewEdges) {
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  ASSERT_FALSE(mission_ids.empty());
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIdsInMissionAlongGraph(*mission_ids.begin(), &vertex_ids);
+  ASSERT_GT(vertex_ids.size(), 20u);
+
+  FLAGS_relaxation_incremental_num_hops = 2;
+  map_optimization::IncrementalVIMapRelaxation relaxation(mission_ids, map);
+  const size_t num_initial_edges = relaxation.numLoopClosureEdges();
+
+  // A loop closure consistent with the current poses.
+  const pose_graph::VertexId& vertex_id_A = vertex_ids[5u];
+  const pose_graph::VertexId& vertex_id_B = vertex_ids[10u];
+  const pose::Transformation T_A_B =
+      map->getVertex(vertex_id_A).get_T_M_I().inverse() *
+      map->getVertex(vertex_id_B).get_T_M_I();
+  pose_graph::EdgeId edge_id;
+  common::generateId(&edge_id);
+  constexpr double kSwitchVariable = 1.0;
+  constexpr double kSwitchVariableVariance = 1e-3;
+  const Eigen::Matrix<double, 6, 6> T_A_B_covariance =
+      Eigen::Matrix<double, 6, 6>::Identity() * 1e-4;
+  map->addEdge(
+      vi_map::Edge::UniquePtr(new vi_map::LoopClosureEdge(
+          edge_id, vertex_id_A, vertex_id_B, kSwitchVariable,
+          kSwitchVariableVariance, T_A_B, T_A_B_covariance)));
+
+  Aligned<std::vector, pose::Transformation> T_M_I_before;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    T_M_I_before.push_back(map->getVertex(vertex_id).get_T_M_I());
+  }
+
+  pose_graph::VertexIdList updated_vertices;
+  EXPECT_TRUE(relaxation.addLoopClosureEdges({edge_id}, &updated_vertices));
+  EXPECT_EQ(relaxation.numLoopClosureEdges(), num_initial_edges + 1u);
+  ASSERT_FALSE(updated_vertices.empty());
+  EXPECT_LT(updated_vertices.size(), vertex_ids.size());
+
+  const std::unordered_set<pose_graph::VertexId> updated_vertex_set(
+      updated_vertices.begin(), updated_vertices.end());
+  EXPECT_GT(updated_vertex_set.count(vertex_id_A), 0u);
+  EXPECT_GT(updated_vertex_set.count(vertex_id_B), 0u);
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    const pose::Transformation& T_M_I =
+        map->getVertex(vertex_ids[i]).get_T_M_I();
+    if (updated_vertex_set.count(vertex_ids[i]) == 0u) {
+      EXPECT_NEAR_KINDR_QUATERNION(
+          T_M_I.getRotation(), T_M_I_before[i].getRotation(), 1e-9);
+      EXPECT_NEAR_EIGEN(
+          T_M_I.getPosition(), T_M_I_before[i].getPosition(), 1e-9);
+    } else {
+      // The loop closure agrees with the map, so the poses barely move.
+      EXPECT_NEAR_EIGEN(
+          T_M_I.getPosition(), T_M_I_before[i].getPosition(), 1e-2);
+    }
+  }
+
+  // The edge is part of the problem now.
+  EXPECT_FALSE(relaxation.addLoopClosureEdges({edge_id}, &updated_vertices));
+}
+
+TEST(CoarseToFineRelaxationTest, DecimationKeepsEndsAndLoopClosures) {
+  pose_graph::VertexIdList vertex_ids(10u);
+  for (pose_graph::VertexId& vertex_id : vertex_ids) {
+    common::generateId(&vertex_id);
+  }
+  const pose_graph::VertexIdSet loop_closure_vertices = {vertex_ids[5u]};
+  std::vector<size_t> kept_indices;
+  map_optimization::selectDecimatedVertexIndices(
+      vertex_ids, 4u, loop_closure_vertices, &kept_indices);
+  EXPECT_EQ(kept_indices, std::vector<size_t>({0u, 4u, 5u, 8u, 9u}));
+
+  map_optimization::selectDecimatedVertexIndices(
+      vertex_ids, 1u, pose_graph::VertexIdSet(), &kept_indices);
+  EXPECT_EQ(kept_indices.size(), vertex_ids.size());
+}
+
+TEST_F(ViMappingTest, TestCoarseRelaxationKeepsConsistentPoses) {
+  vi_map::VIMap* map = CHECK_NOTNULL(test_app_.getMapMutable());
+  vi_map::MissionIdSet mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  ASSERT_FALSE(mission_ids.empty());
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIdsInMissionAlongGraph(*mission_ids.begin(), &vertex_ids);
+  ASSERT_GT(vertex_ids.size(), 30u);
+
+  // A loop closure consistent with the current poses.
+  const pose_graph::VertexId& vertex_id_A = vertex_ids[3u];
+  const pose_graph::VertexId& vertex_id_B = vertex_ids[27u];
+  const pose::Transformation T_A_B =
+      map->getVertex(vertex_id_A).get_T_M_I().inverse() *
+      map->getVertex(vertex_id_B).get_T_M_I();
+  pose_graph::EdgeId edge_id;
+  common::generateId(&edge_id);
+  constexpr double kSwitchVariable = 1.0;
+  constexpr double kSwitchVariableVariance = 1e-3;
+  const Eigen::Matrix<double, 6, 6> T_A_B_covariance =
+      Eigen::Matrix<double, 6, 6>::Identity() * 1e-4;
+  map->addEdge(
+      vi_map::Edge::UniquePtr(new vi_map::LoopClosureEdge(
+          edge_id, vertex_id_A, vertex_id_B, kSwitchVariable,
+          kSwitchVariableVariance, T_A_B, T_A_B_covariance)));
+
+  Aligned<std::vector, pose::Transformation> T_M_I_before;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    T_M_I_before.push_back(map->getVertex(vertex_id).get_T_M_I());
+  }
+
+  const map_optimization::ViProblemOptions problem_options =
+      map_optimization::initRelaxationProblemOptionsFromGFlags();
+  map_optimization::OptimizationProblem::UniquePtr problem(
+      map_optimization::constructViProblem(mission_ids, problem_options, map));
+  ASSERT_TRUE(problem != nullptr);
+  pose_graph::EdgeIdList loop_closure_edges;
+  map_optimization::getLoopclosureEdgesOfMissions(
+      *map, mission_ids, &loop_closure_edges);
+  map_optimization::augmentViProblemWithLoopclosureEdges(
+      loop_closure_edges, problem.get());
+
+  FLAGS_relaxation_coarse_to_fine_vertex_stride = 10;
+  const map_optimization::CoarseToFineRelaxationOptions options =
+      map_optimization::CoarseToFineRelaxationOptions::initFromGFlags();
+  map_optimization::relaxDecimatedPoseGraph(
+      options, map_optimization::initSolverOptionsFromFlags(), mission_ids,
+      problem.get());
+  problem->getOptimizationStateBufferMutable()->copyAllStatesBackToMap(map);
+
+  // Neither the kept vertices nor the interpolated ones move.
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    const pose::Transformation& T_M_I =
+        map->getVertex(vertex_ids[i]).get_T_M_I();
+    EXPECT_NEAR_KINDR_QUATERNION(
+        T_M_I.getRotation(), T_M_I_before[i].getRotation(), 1e-6);
+    EXPECT_NEAR_EIGEN(T_M_I.getPosition(), T_M_I_before[i].getPosition(), 1e-4);
+  }
+}
+
 }  // namespace visual_inertial_mapping
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,7 @@
 #ifndef MAP_SPARSIFICATION_GRAPH_PARTITION_SAMPLER_H_
 #define MAP_SPARSIFICATION_GRAPH_PARTITION_SAMPLER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,7 +22,13 @@ class GraphPartitionSampler : public SamplerBase {
  public:
   MAPLAB_POINTER_TYPEDEFS(GraphPartitionSampler);
 
+  typedef std::function<SamplerBase::Ptr()> SamplerFactory;
+
+  // All partitions are sampled one after the other with the given sampler.
   explicit GraphPartitionSampler(map_sparsification::SamplerBase::Ptr sampler);
+  // The partitions are sampled in parallel, each with its own sampler created
+  // by the factory, so the samplers don't need to be thread-safe.
+  explicit GraphPartitionSampler(const SamplerFactory& sampler_factory);
   virtual ~GraphPartitionSampler();
 
   void setMaxPartitionedSummarizationFraction(double fraction);
@@ -55,6 +62,8 @@ class GraphPartitionSampler : public SamplerBase {
       bool are_globally_selected);
 
   map_sparsification::SamplerBase::Ptr sampler_;
+  // Empty if the partitions are sampled sequentially by sampler_.
+  SamplerFactory sampler_factory_;
   std::vector<pose_graph::VertexIdList> posegraph_partitioning_;
   double max_partitioned_summarization_fraction_;
 
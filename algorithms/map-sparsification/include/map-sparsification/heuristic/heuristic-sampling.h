@@ -11,6 +11,7 @@
 #include <vi-map/vi-map.h>
 
 #include "map-sparsification/heuristic/cost-functions/sampling-cost.h"
+#include "map-sparsification/heuristic/landmark-score-cache.h"
 #include "map-sparsification/heuristic/scoring/scoring-function.h"
 #include "map-sparsification/sampler-base.h"
 
@@ -30,9 +31,18 @@ class LandmarkSamplingWithCostFunctions : public SamplerBase {
   typedef std::pair<vi_map::LandmarkId, double> StoreLandmarkIdScorePair;
   typedef std::unordered_map<vi_map::LandmarkId, double> LandmarkScoreMap;
 
+  LandmarkSamplingWithCostFunctions();
+
+  // Registering a scoring function clears the score cache.
   void registerScoringFunction(const ScoringFunction::ConstPtr& scoring);
   void registerCostFunction(const SamplingCostFunction::ConstPtr& cost);
 
+  // The landmark scores are cached across calls of sampleMapSegment, e.g. for
+  // the partitions and the global stage of the GraphPartitionSampler. Pass a
+  // cache that outlives the sampler to also reuse the scores in later runs on
+  // the same map; samplers sharing a cache need the same scoring functions.
+  void setScoreCache(const LandmarkScoreCache::Ptr& score_cache);
+
   virtual void sampleMapSegment(
       const vi_map::VIMap& map, unsigned int desired_num_landmarks,
       unsigned int time_limit_seconds,
@@ -47,6 +57,7 @@ class LandmarkSamplingWithCostFunctions : public SamplerBase {
  private:
   std::vector<ScoringFunction::ConstPtr> scoring_functions_;
   std::vector<SamplingCostFunction::ConstPtr> cost_functions_;
+  LandmarkScoreCache::Ptr score_cache_;
 };
 
 }  // namespace sampling
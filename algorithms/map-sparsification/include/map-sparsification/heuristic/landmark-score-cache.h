@@ -0,0 +1,59 @@
+#ifndef MAP_SPARSIFICATION_HEURISTIC_LANDMARK_SCORE_CACHE_H_
+#define MAP_SPARSIFICATION_HEURISTIC_LANDMARK_SCORE_CACHE_H_
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-sparsification/heuristic/scoring/scoring-function.h"
+
+namespace map_sparsification {
+namespace sampling {
+
+// Keeps the summed score of the scoring functions of every landmark, so the
+// descriptors and observations of a landmark are only visited again once its
+// observations changed. A cached score is tagged with a fingerprint of the
+// landmark's observations and recomputed if the fingerprint doesn't match
+// anymore. The cache is only valid for a fixed set of scoring functions, call
+// clear() when they change.
+class LandmarkScoreCache {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LandmarkScoreCache);
+
+  typedef map_sparsification::scoring::ScoringFunction ScoringFunction;
+
+  // Fills the scores of the landmarks, in the same order. Missing or outdated
+  // scores are evaluated in parallel.
+  void getScores(
+      const vi_map::VIMap& map,
+      const std::vector<ScoringFunction::ConstPtr>& scoring_functions,
+      const vi_map::LandmarkIdList& landmark_ids, std::vector<double>* scores);
+
+  void clear();
+  size_t size() const;
+
+  // Computes the same summed score as getScores without caching it.
+  static double evaluateScore(
+      const vi_map::VIMap& map,
+      const std::vector<ScoringFunction::ConstPtr>& scoring_functions,
+      const vi_map::LandmarkId& landmark_id);
+
+  // Independent of the order of the observations.
+  static size_t getObservationFingerprint(const vi_map::Landmark& landmark);
+
+ private:
+  struct CachedScore {
+    size_t observation_fingerprint;
+    double score;
+  };
+  std::unordered_map<vi_map::LandmarkId, CachedScore> cached_scores_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace sampling
+}  // namespace map_sparsification
+#endif  // MAP_SPARSIFICATION_HEURISTIC_LANDMARK_SCORE_CACHE_H_
@@ -2,6 +2,7 @@
 #define MAP_SPARSIFICATION_KEYFRAME_PRUNING_H_
 #include <vector>
 
+#include <aslam/common/pose-types.h>
 #include <posegraph/unique-id.h>
 #include <vi-map/vi-map.h>
 
@@ -14,6 +15,10 @@ struct KeyframingHeuristicsOptions {
   double kf_rotation_threshold_deg;
   size_t kf_every_nth_vertex;
   size_t kf_min_shared_landmarks_obs;
+  // The selection runs in parallel over segments of this many vertices, the
+  // first vertex of every segment is a keyframe. 0 selects the keyframes of
+  // the whole range in one pass.
+  size_t kf_selection_segment_num_vertices;
 
   static KeyframingHeuristicsOptions initializeFromGFlags();
 
@@ -21,9 +26,21 @@ struct KeyframingHeuristicsOptions {
   void deserialize(const proto::KeyframingHeuristicsOptions& proto);
 };
 
+// Decides if a vertex is a keyframe given its relation to the last keyframe.
+// The conditions are evaluated in this order:
+//   - max. temporal spacing (force a keyframe every n-th frame)
+//   - common landmark/track count
+//   - distance and rotation threshold
+bool isKeyframeBasedOnHeuristics(
+    const KeyframingHeuristicsOptions& options,
+    const size_t num_frames_since_last_keyframe,
+    const size_t num_common_landmarks, const aslam::Transformation& T_Bkf_Bi);
+
 // Select and return keyframes along the viwls-backbone on the pose graph
 // between the begin and end vertex. It is assumed that the begin vertex
-// is a keyframe but the last is not necessarily a keyframe.
+// is a keyframe but the last is not necessarily a keyframe. The segments of
+// options.kf_selection_segment_num_vertices vertices are evaluated in
+// parallel.
 size_t selectKeyframesBasedOnHeuristics(
     const vi_map::VIMap& map,
     const pose_graph::VertexId& last_keyframe_id,
@@ -33,7 +50,9 @@ size_t selectKeyframesBasedOnHeuristics(
 
 // Discard all vertices between keyframes and just discards all visual
 // information contained in these frames. The IMU measurements of the edges
-// will be concatenated into a new edge.
+// will be concatenated into a new edge. The vertices between two keyframes are
+// merged into the first keyframe, all segments at once, see
+// VIMap::mergeVertexSegments.
 size_t removeVerticesBetweenKeyframes(
     const pose_graph::VertexIdList& keyframe_ids, vi_map::VIMap* map);
 
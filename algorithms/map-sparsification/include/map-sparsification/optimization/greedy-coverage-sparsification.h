@@ -0,0 +1,49 @@
+#ifndef MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
+#define MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
+
+#include <string>
+
+#include <maplab-common/macros.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "map-sparsification/sampler-base.h"
+
+namespace map_sparsification {
+
+// Fast approximation of the problem LpSolveSparsification solves. Every
+// keyframe k of the segment asks for m_k = min(min_keypoints_per_keyframe,
+// number of its landmarks in the segment) landmarks, and the coverage of a
+// landmark selection S is
+//   f(S) = sum_k min(|S ∩ landmarks of k|, m_k).
+// f is monotone submodular, so picking the landmark with the largest coverage
+// gain until the desired number is reached keeps at least (1 - 1/e) of the
+// best possible coverage with that many landmarks (Nemhauser et al., 1978).
+// Ties, and the picks once every keyframe is covered, go to the landmarks with
+// the most observations, which is the objective of the ILP. The gains are
+// evaluated lazily, so the runtime is close to linear in the number of
+// observations.
+class GreedyCoverageSparsification : public SamplerBase {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(GreedyCoverageSparsification);
+
+  explicit GreedyCoverageSparsification(unsigned int min_keypoints_per_keyframe)
+      : min_keypoints_per_keyframe_(min_keypoints_per_keyframe) {}
+
+  virtual void sampleMapSegment(
+      const vi_map::VIMap& map, unsigned int desired_num_landmarks,
+      unsigned int time_limit_seconds,
+      const vi_map::LandmarkIdSet& segment_store_landmark_id_set,
+      const pose_graph::VertexIdList& segment_vertex_id_list,
+      vi_map::LandmarkIdSet* summary_store_landmark_ids);
+
+  virtual std::string getTypeString() const {
+    return "greedy_coverage";
+  }
+
+ private:
+  const unsigned int min_keypoints_per_keyframe_;
+};
+
+}  // namespace map_sparsification
+#endif  // MAP_SPARSIFICATION_OPTIMIZATION_GREEDY_COVERAGE_SPARSIFICATION_H_
@@ -25,6 +25,10 @@ class SamplerBase {
     // If the map is too large, partition the map using METIS and the solve
     // and ILP problem.
     kLpsolvePartitionIlp = 4,
+    // Greedy approximation of the ILP problem, see
+    // GreedyCoverageSparsification. Much faster, the map is partitioned
+    // like for kLpsolvePartitionIlp.
+    kGreedyCoverage = 5,
   };
 
   virtual ~SamplerBase() {}
@@ -1,7 +1,12 @@
 #include "map-sparsification/graph-partition-sampler.h"
 
+#include <string>
+#include <vector>
+
 #include <aslam/common/timer.h>
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map-helpers/vi-map-partitioner.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <visualization/color-palette.h>
@@ -16,6 +21,15 @@ GraphPartitionSampler::GraphPartitionSampler(
   CHECK(sampler_);
 }
 
+GraphPartitionSampler::GraphPartitionSampler(
+    const SamplerFactory& sampler_factory)
+    : sampler_factory_(sampler_factory),
+      max_partitioned_summarization_fraction_(1.0) {
+  CHECK(sampler_factory_);
+  sampler_ = sampler_factory_();
+  CHECK(sampler_);
+}
+
 GraphPartitionSampler::~GraphPartitionSampler() {}
 
 void GraphPartitionSampler::partitionMapIfNecessary(const vi_map::VIMap& map) {
@@ -79,70 +93,97 @@ void GraphPartitionSampler::sample(
   }
   partition_landmarks_.resize(posegraph_partitioning_.size());
 
-  // TODO(dymczykm) Parallelize this.
-  for (unsigned int i = 0; i < posegraph_partitioning_.size(); ++i) {
-    LOG(INFO) << "Sampling cluster " << (i + 1) << " of "
-              << posegraph_partitioning_.size();
-    if (visualizer_) {
-      visualizer_->plotSegment(map, posegraph_partitioning_, i);
-    }
-
-    vi_map::LandmarkIdSet segment_landmark_id_set;
+  // Build the landmark sets of all segments first, the sampling of the
+  // segments is then independent.
+  const size_t num_partitions = posegraph_partitioning_.size();
+  std::vector<vi_map::LandmarkIdSet> segment_landmark_id_sets(num_partitions);
+  std::vector<unsigned int> desired_num_segment_landmarks(num_partitions);
+  for (size_t i = 0u; i < num_partitions; ++i) {
     unsigned int num_segment_landmarks = 0;
-    LOG(INFO) << "\tBuilding the landmark set for the segment";
+    LOG(INFO) << "Building the landmark set for segment " << (i + 1) << " of "
+              << num_partitions;
     for (const pose_graph::VertexId& vertex_id : posegraph_partitioning_[i]) {
-      for (const vi_map::Landmark landmark :
+      for (const vi_map::Landmark& landmark :
            map.getVertex(vertex_id).getLandmarks()) {
         ++num_segment_landmarks;
         if (map.getLandmark(landmark.id()).getQuality() ==
             vi_map::Landmark::Quality::kGood) {
-          segment_landmark_id_set.insert(landmark.id());
+          segment_landmark_id_sets[i].insert(landmark.id());
         }
       }
     }
+    desired_num_segment_landmarks[i] = retain_ratio * num_segment_landmarks;
+  }
 
-    unsigned int desired_num_landmarks = retain_ratio * num_segment_landmarks;
-
-    // Time limit of the sampling process of a single map partition.
-    const unsigned int kSegmentTimeLimitSeconds = 8;
-
-    LOG(INFO) << "\tSampling out of " << segment_landmark_id_set.size()
-              << " landmarks, desired: " << desired_num_landmarks;
+  // Time limit of the sampling process of a single map partition.
+  const unsigned int kSegmentTimeLimitSeconds = 8;
+
+  std::vector<vi_map::LandmarkIdSet> segment_summary_landmark_id_sets(
+      num_partitions);
+  auto sample_segment = [&](const size_t i, SamplerBase* sampler) {
+    CHECK_NOTNULL(sampler);
+    const vi_map::LandmarkIdSet& segment_landmark_id_set =
+        segment_landmark_id_sets[i];
+    const unsigned int desired_num_landmarks = desired_num_segment_landmarks[i];
+    VLOG(1) << "Sampling segment " << (i + 1) << " out of "
+            << segment_landmark_id_set.size()
+            << " landmarks, desired: " << desired_num_landmarks;
     if (segment_landmark_id_set.size() > desired_num_landmarks) {
-      vi_map::LandmarkIdSet segment_summary_landmark_ids;
-
-      timing::Timer sampling_timer(
-          "GraphPartitionSampler: " +
-          std::to_string(posegraph_partitioning_.size()) +
-          "partitions_sampling_timer");
-      sampler_->sampleMapSegment(
+      sampler->sampleMapSegment(
           map, desired_num_landmarks, kSegmentTimeLimitSeconds,
           segment_landmark_id_set, posegraph_partitioning_[i],
-          &segment_summary_landmark_ids);
-      sampling_timer.Stop();
-
-      LOG(INFO) << "\t" << segment_summary_landmark_ids.size()
-                << " landmarks inserted from this segment.";
-      summary_landmark_ids->insert(
-          segment_summary_landmark_ids.begin(),
-          segment_summary_landmark_ids.end());
+          &segment_summary_landmark_id_sets[i]);
     } else {
       LOG(WARNING) << "Landmark quality filtering left only "
                    << segment_landmark_id_set.size()
                    << " landmarks, less than " << desired_num_landmarks
                    << " landmarks desired. Summarization is not needed.";
-      summary_landmark_ids->insert(segment_landmark_id_set.begin(),
-                                         segment_landmark_id_set.end());
+      segment_summary_landmark_id_sets[i] = segment_landmark_id_set;
     }
+  };
+
+  timing::Timer sampling_timer(
+      "GraphPartitionSampler: " + std::to_string(num_partitions) +
+      "partitions_sampling_timer");
+  if (sampler_factory_ && num_partitions > 1u) {
+    constexpr bool kAlwaysParallelize = true;
+    common::ParallelProcess(
+        num_partitions,
+        [&](const std::vector<size_t>& range) {
+          // Samplers keep state while solving, don't share them among
+          // threads.
+          for (const size_t i : range) {
+            const SamplerBase::Ptr sampler = sampler_factory_();
+            CHECK(sampler);
+            sample_segment(i, sampler.get());
+          }
+        },
+        kAlwaysParallelize, common::getNumHardwareThreads());
+  } else {
+    for (size_t i = 0u; i < num_partitions; ++i) {
+      sample_segment(i, sampler_.get());
+    }
+  }
+  sampling_timer.Stop();
+
+  for (size_t i = 0u; i < num_partitions; ++i) {
+    LOG(INFO) << segment_summary_landmark_id_sets[i].size()
+              << " landmarks inserted from segment " << (i + 1) << " of "
+              << num_partitions << ".";
+    summary_landmark_ids->insert(
+        segment_summary_landmark_id_sets[i].begin(),
+        segment_summary_landmark_id_sets[i].end());
 
     if (visualizer_) {
-      partition_landmarks_[i].insert(segment_landmark_id_set.begin(),
-                                     segment_landmark_id_set.end());
+      visualizer_->plotSegment(map, posegraph_partitioning_, i);
+      partition_landmarks_[i].insert(
+          segment_landmark_id_sets[i].begin(),
+          segment_landmark_id_sets[i].end());
 
       const bool kGloballySelectedLandmarks = false;
-      visualizer_->plotLandmarks(map, i, segment_landmark_id_set,
-                                 posegraph_partitioning_, partition_landmarks_,
-                                 kGloballySelectedLandmarks);
+      visualizer_->plotLandmarks(
+          map, i, segment_landmark_id_sets[i], posegraph_partitioning_,
+          partition_landmarks_, kGloballySelectedLandmarks);
     }
   }
 
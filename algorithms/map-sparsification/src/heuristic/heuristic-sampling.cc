@@ -4,12 +4,19 @@
 #include <map>
 #include <unordered_map>
 
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
 namespace map_sparsification {
 namespace sampling {
 
+LandmarkSamplingWithCostFunctions::LandmarkSamplingWithCostFunctions()
+    : score_cache_(new LandmarkScoreCache) {}
+
 void LandmarkSamplingWithCostFunctions::registerScoringFunction(
     const ScoringFunction::ConstPtr& scoring) {
   scoring_functions_.push_back(scoring);
+  score_cache_->clear();
 }
 
 void LandmarkSamplingWithCostFunctions::registerCostFunction(
@@ -17,6 +24,12 @@ void LandmarkSamplingWithCostFunctions::registerCostFunction(
   cost_functions_.push_back(cost);
 }
 
+void LandmarkSamplingWithCostFunctions::setScoreCache(
+    const LandmarkScoreCache::Ptr& score_cache) {
+  CHECK(score_cache);
+  score_cache_ = score_cache;
+}
+
 void LandmarkSamplingWithCostFunctions::sampleMapSegment(
     const vi_map::VIMap& map, unsigned int desired_num_landmarks,
     unsigned int /*time_limit_seconds*/,
@@ -26,13 +39,18 @@ void LandmarkSamplingWithCostFunctions::sampleMapSegment(
   CHECK_NOTNULL(summary_landmark_ids);
   *summary_landmark_ids = segment_landmark_id_set;
 
+  const vi_map::LandmarkIdList segment_landmark_ids(
+      summary_landmark_ids->begin(), summary_landmark_ids->end());
+  std::vector<double> segment_landmark_scores;
+  score_cache_->getScores(
+      map, scoring_functions_, segment_landmark_ids, &segment_landmark_scores);
   LandmarkScoreMap landmark_scores;
-  for (const vi_map::LandmarkId& landmark_id : *summary_landmark_ids) {
-    double landmark_score = 0.0;
-    for (unsigned int i = 0; i < scoring_functions_.size(); ++i) {
-      landmark_score += (*scoring_functions_[i])(landmark_id, map);
-    }
-    CHECK(landmark_scores.emplace(landmark_id, landmark_score).second);
+  landmark_scores.reserve(segment_landmark_ids.size());
+  for (size_t i = 0u; i < segment_landmark_ids.size(); ++i) {
+    CHECK(
+        landmark_scores.emplace(segment_landmark_ids[i],
+                                segment_landmark_scores[i])
+            .second);
   }
 
   KeyframeKeypointCountMap keyframe_keypoint_counts;
@@ -79,16 +97,34 @@ void LandmarkSamplingWithCostFunctions::sampleMapSegment(
       VLOG(3) << "\tInner iteration, already removed: "
               << num_landmarks_removed_in_iter;
 
-      LandmarkScoreMap landmark_costs;
       unsigned int num_zero_cost_landmarks = 0;
       // Evaluate cost for each (still present) landmark.
-      for (const vi_map::LandmarkId& landmark_id : *summary_landmark_ids) {
-        double landmark_cost_values = 0.0;
-        for (unsigned int i = 0; i < cost_functions_.size(); ++i) {
-          landmark_cost_values +=
-              (*cost_functions_[i])(landmark_id, map, keyframe_keypoint_counts);
-        }
-        CHECK(landmark_costs.emplace(landmark_id, landmark_cost_values).second);
+      const vi_map::LandmarkIdList remaining_landmark_ids(
+          summary_landmark_ids->begin(), summary_landmark_ids->end());
+      std::vector<double> remaining_landmark_costs(
+          remaining_landmark_ids.size());
+      constexpr bool kAlwaysParallelize = false;
+      common::ParallelProcess(
+          remaining_landmark_ids.size(),
+          [&](const std::vector<size_t>& range) {
+            for (const size_t landmark_idx : range) {
+              double landmark_cost_values = 0.0;
+              for (unsigned int i = 0; i < cost_functions_.size(); ++i) {
+                landmark_cost_values += (*cost_functions_[i])(
+                    remaining_landmark_ids[landmark_idx], map,
+                    keyframe_keypoint_counts);
+              }
+              remaining_landmark_costs[landmark_idx] = landmark_cost_values;
+            }
+          },
+          kAlwaysParallelize, common::getNumHardwareThreads());
+      LandmarkScoreMap landmark_costs;
+      landmark_costs.reserve(remaining_landmark_ids.size());
+      for (size_t i = 0u; i < remaining_landmark_ids.size(); ++i) {
+        CHECK(
+            landmark_costs
+                .emplace(remaining_landmark_ids[i], remaining_landmark_costs[i])
+                .second);
       }
 
       std::vector<StoreLandmarkIdScorePair> sorted_scores_and_costs;
@@ -0,0 +1,99 @@
+#include "map-sparsification/heuristic/landmark-score-cache.h"
+
+#include <functional>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace map_sparsification {
+namespace sampling {
+
+void LandmarkScoreCache::getScores(
+    const vi_map::VIMap& map,
+    const std::vector<ScoringFunction::ConstPtr>& scoring_functions,
+    const vi_map::LandmarkIdList& landmark_ids, std::vector<double>* scores) {
+  CHECK_NOTNULL(scores)->resize(landmark_ids.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const size_t num_landmarks = landmark_ids.size();
+  std::vector<size_t> observation_fingerprints(num_landmarks);
+  std::vector<unsigned char> is_cached(num_landmarks, 0u);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_landmarks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_idx : range) {
+          const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_idx];
+          const size_t observation_fingerprint =
+              getObservationFingerprint(map.getLandmark(landmark_id));
+          observation_fingerprints[landmark_idx] = observation_fingerprint;
+
+          const std::unordered_map<vi_map::LandmarkId, CachedScore>::
+              const_iterator it = cached_scores_.find(landmark_id);
+          if (it != cached_scores_.end() &&
+              it->second.observation_fingerprint == observation_fingerprint) {
+            (*scores)[landmark_idx] = it->second.score;
+            is_cached[landmark_idx] = 1u;
+          } else {
+            (*scores)[landmark_idx] =
+                evaluateScore(map, scoring_functions, landmark_id);
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+
+  size_t num_evaluated_scores = 0u;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    if (is_cached[landmark_idx] == 0u) {
+      ++num_evaluated_scores;
+      cached_scores_[landmark_ids[landmark_idx]] = CachedScore{
+          observation_fingerprints[landmark_idx], (*scores)[landmark_idx]};
+    }
+  }
+  VLOG(2) << "Evaluated " << num_evaluated_scores << " of " << num_landmarks
+          << " landmark scores, the others were cached.";
+}
+
+void LandmarkScoreCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cached_scores_.clear();
+}
+
+size_t LandmarkScoreCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cached_scores_.size();
+}
+
+double LandmarkScoreCache::evaluateScore(
+    const vi_map::VIMap& map,
+    const std::vector<ScoringFunction::ConstPtr>& scoring_functions,
+    const vi_map::LandmarkId& landmark_id) {
+  double landmark_score = 0.0;
+  for (const ScoringFunction::ConstPtr& scoring_function : scoring_functions) {
+    CHECK(scoring_function);
+    landmark_score += (*scoring_function)(landmark_id, map);
+  }
+  return landmark_score;
+}
+
+size_t LandmarkScoreCache::getObservationFingerprint(
+    const vi_map::Landmark& landmark) {
+  const vi_map::KeypointIdentifierList& observations =
+      landmark.getObservations();
+  // Mix the hashes before summing them, the plain KeypointIdentifier hashes
+  // xor the frame and keypoint index and would cancel out easily.
+  size_t fingerprint = observations.size();
+  for (const vi_map::KeypointIdentifier& observation : observations) {
+    size_t hash = std::hash<vi_map::KeypointIdentifier>()(observation);
+    hash ^= hash >> 33u;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33u;
+    fingerprint += hash;
+  }
+  return fingerprint;
+}
+
+}  // namespace sampling
+}  // namespace map_sparsification
@@ -1,11 +1,15 @@
 #include "map-sparsification/keyframe-pruning.h"
 
+#include <algorithm>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <posegraph/unique-id.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
@@ -17,29 +21,66 @@ DEFINE_double(kf_rotation_threshold_deg, 20,
 DEFINE_uint64(kf_every_nth_vertex, 10, "Force a keyframe every n-th vertex.");
 DEFINE_uint64(kf_min_shared_landmarks_obs, 20,
               "Coobserved landmark number to add a new keyframe.");
+DEFINE_uint64(
+    kf_selection_segment_num_vertices, 0u,
+    "If set, the keyframes are selected in parallel over mission segments of "
+    "this many vertices. Every segment starts with a keyframe, so the "
+    "selection differs from the default single pass over the whole mission.");
 
 namespace map_sparsification {
 namespace {
-size_t removeAllVerticesBetweenTwoVertices(
-    pose_graph::Edge::EdgeType traversal_edge,
+void getAllVerticesBetweenTwoVertices(
+    const vi_map::VIMap& map, pose_graph::Edge::EdgeType traversal_edge,
     const pose_graph::VertexId& start_kf_id,
     const pose_graph::VertexId& end_kf_id,
-    vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
+    pose_graph::VertexIdList* vertices_to_merge) {
+  CHECK_NOTNULL(vertices_to_merge)->clear();
   CHECK(traversal_edge != pose_graph::Edge::EdgeType::kUndefined);
   CHECK(start_kf_id.isValid());
   CHECK(end_kf_id.isValid());
 
-  size_t num_merged_vertices = 0u;
-  pose_graph::VertexId current_vertex_id;
-  while (map->getNextVertex(start_kf_id, traversal_edge, &current_vertex_id) &&
+  pose_graph::VertexId current_vertex_id = start_kf_id;
+  while (map.getNextVertex(current_vertex_id, traversal_edge,
+                           &current_vertex_id) &&
          current_vertex_id != end_kf_id) {
     CHECK(current_vertex_id.isValid());
     CHECK(start_kf_id != current_vertex_id);
-    map->mergeNeighboringVertices(start_kf_id, current_vertex_id);
-    ++num_merged_vertices;
+    vertices_to_merge->emplace_back(current_vertex_id);
+  }
+}
+
+// Selects the keyframes among the vertices [begin, end) given that
+// *last_keyframe_id was the last keyframe before them.
+void selectKeyframesOfSegment(
+    const vi_map::VIMap& map, const KeyframingHeuristicsOptions& options,
+    const pose_graph::VertexIdList::const_iterator& begin,
+    const pose_graph::VertexIdList::const_iterator& end,
+    pose_graph::VertexId last_keyframe_id,
+    std::vector<pose_graph::VertexId>* selected_keyframes) {
+  CHECK_NOTNULL(selected_keyframes);
+  CHECK(last_keyframe_id.isValid());
+  size_t num_frames_since_last_keyframe = 0u;
+
+  // TODO(schneith): Online-viwls should add special vio constraints (rot. only,
+  // stationary) and avoid keyframes during these states.
+  vi_map_helpers::VIMapQueries queries(map);
+  for (pose_graph::VertexIdList::const_iterator it = begin; it != end; ++it) {
+    const pose_graph::VertexId& current_vertex_id = *it;
+    const size_t common_observations =
+        queries.getNumberOfCommonLandmarks(current_vertex_id, last_keyframe_id);
+    const aslam::Transformation T_Bkf_Bi =
+        map.getVertex_T_G_I(last_keyframe_id).inverse() *
+        map.getVertex_T_G_I(current_vertex_id);
+    if (isKeyframeBasedOnHeuristics(
+            options, num_frames_since_last_keyframe, common_observations,
+            T_Bkf_Bi)) {
+      num_frames_since_last_keyframe = 0u;
+      last_keyframe_id = current_vertex_id;
+      selected_keyframes->emplace_back(current_vertex_id);
+    } else {
+      ++num_frames_since_last_keyframe;
+    }
   }
-  return num_merged_vertices;
 }
 }  // namespace
 
@@ -50,6 +91,8 @@ KeyframingHeuristicsOptions::initializeFromGFlags() {
   options.kf_rotation_threshold_deg = FLAGS_kf_rotation_threshold_deg;
   options.kf_every_nth_vertex = FLAGS_kf_every_nth_vertex;
   options.kf_min_shared_landmarks_obs = FLAGS_kf_min_shared_landmarks_obs;
+  options.kf_selection_segment_num_vertices =
+      FLAGS_kf_selection_segment_num_vertices;
   return options;
 }
 
@@ -60,6 +103,8 @@ void KeyframingHeuristicsOptions::serialize(
   proto->set_kf_rotation_threshold_deg(kf_rotation_threshold_deg);
   proto->set_kf_every_nth_vertex(kf_every_nth_vertex);
   proto->set_kf_min_shared_landmarks_obs(kf_min_shared_landmarks_obs);
+  proto->set_kf_selection_segment_num_vertices(
+      kf_selection_segment_num_vertices);
 }
 
 void KeyframingHeuristicsOptions::deserialize(
@@ -72,6 +117,37 @@ void KeyframingHeuristicsOptions::deserialize(
   kf_every_nth_vertex = proto.kf_every_nth_vertex();
   CHECK(proto.has_kf_min_shared_landmarks_obs());
   kf_min_shared_landmarks_obs = proto.kf_min_shared_landmarks_obs();
+  // Optional for compatibility with options serialized before the field was
+  // introduced.
+  kf_selection_segment_num_vertices =
+      proto.has_kf_selection_segment_num_vertices()
+          ? proto.kf_selection_segment_num_vertices()
+          : 0u;
+}
+
+bool isKeyframeBasedOnHeuristics(
+    const KeyframingHeuristicsOptions& options,
+    const size_t num_frames_since_last_keyframe,
+    const size_t num_common_landmarks, const aslam::Transformation& T_Bkf_Bi) {
+  // Add a keyframe every n-th frame.
+  if (num_frames_since_last_keyframe >= options.kf_every_nth_vertex) {
+    return true;
+  }
+
+  // Insert a keyframe if the common landmark observations between the last
+  // keyframe and this current vertex frame drop below a certain threshold.
+  if (num_common_landmarks < options.kf_min_shared_landmarks_obs) {
+    return true;
+  }
+
+  // Select keyframe if the distance or rotation to the last keyframe exceeds
+  // a threshold.
+  const double distance_to_last_keyframe_m = T_Bkf_Bi.getPosition().norm();
+  const double rotation_to_last_keyframe_rad =
+      aslam::AngleAxis(T_Bkf_Bi.getRotation()).angle();
+  return distance_to_last_keyframe_m >= options.kf_distance_threshold_m ||
+         rotation_to_last_keyframe_rad >=
+             options.kf_rotation_threshold_deg * kDegToRad;
 }
 
 size_t selectKeyframesBasedOnHeuristics(
@@ -89,64 +165,57 @@ size_t selectKeyframesBasedOnHeuristics(
   pose_graph::Edge::EdgeType backbone_type =
       map.getGraphTraversalEdgeType(mission_id);
 
-  pose_graph::VertexId last_keyframe_id = start_keyframe_id;
+  // Collect the vertices first, the selection then runs independently on
+  // every segment.
+  pose_graph::VertexIdList vertex_ids;
   pose_graph::VertexId current_vertex_id = start_keyframe_id;
-  size_t num_frames_since_last_keyframe = 0u;
-
-  auto insert_keyframe = [&](const pose_graph::VertexId& keyframe_id) {
-    CHECK(keyframe_id.isValid());
-    num_frames_since_last_keyframe = 0u;
-    last_keyframe_id = keyframe_id;
-    selected_keyframes->emplace_back(keyframe_id);
-  };
-
-  // The first vertex in the range is always a keyframe.
-  insert_keyframe(start_keyframe_id);
-
-  // Traverse the posegraph and select keyframes to keep based on the following
-  // conditions.
-  // The ordering of the condition evaluation is important.
-  //   - max. temporal spacing (force a keyframe every n-th frame)
-  //   - common landmark/track count
-  //   - distance and rotation threshold
-  // TODO(schneith): Online-viwls should add special vio constraints (rot. only,
-  // stationary) and avoid keyframes during these states.
   while (map.getNextVertex(current_vertex_id, backbone_type,
                            &current_vertex_id)) {
-    // Add a keyframe every n-th frame.
-    if (num_frames_since_last_keyframe >= options.kf_every_nth_vertex) {
-      insert_keyframe(current_vertex_id);
-      continue;
-    }
-
-    // Insert a keyframe if the common landmark observations between the last
-    // keyframe and this current vertex frame drop below a certain threshold.
-    vi_map_helpers::VIMapQueries queries(map);
-    const size_t common_observations =
-        queries.getNumberOfCommonLandmarks(current_vertex_id, last_keyframe_id);
-    if (common_observations < options.kf_min_shared_landmarks_obs) {
-      insert_keyframe(current_vertex_id);
-      continue;
-    }
+    vertex_ids.emplace_back(current_vertex_id);
+  }
 
-    // Select keyframe if the distance or rotation to the last keyframe exceeds
-    // a threshold.
-    aslam::Transformation T_M_Bkf = map.getVertex_T_G_I(last_keyframe_id);
-    aslam::Transformation T_M_Bi = map.getVertex_T_G_I(current_vertex_id);
-
-    aslam::Transformation T_Bkf_Bi = T_M_Bkf.inverse() * T_M_Bi;
-    const double distance_to_last_keyframe_m = T_Bkf_Bi.getPosition().norm();
-    const double rotation_to_last_keyframe_rad =
-        aslam::AngleAxis(T_Bkf_Bi.getRotation()).angle();
-
-    if (distance_to_last_keyframe_m >= options.kf_distance_threshold_m ||
-        rotation_to_last_keyframe_rad >=
-        options.kf_rotation_threshold_deg * kDegToRad) {
-      insert_keyframe(current_vertex_id);
-      continue;
-    }
+  // The first vertex in the range is always a keyframe.
+  selected_keyframes->emplace_back(start_keyframe_id);
+  if (vertex_ids.empty()) {
+    return selected_keyframes->size();
+  }
 
-    ++num_frames_since_last_keyframe;
+  // Every segment but the first one starts with a keyframe, so the segments
+  // don't depend on each other.
+  const size_t segment_num_vertices =
+      options.kf_selection_segment_num_vertices > 0u
+          ? options.kf_selection_segment_num_vertices
+          : vertex_ids.size();
+  const size_t num_segments =
+      (vertex_ids.size() + segment_num_vertices - 1u) / segment_num_vertices;
+  std::vector<std::vector<pose_graph::VertexId>> segment_keyframes(
+      num_segments);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_segments,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t segment_idx : range) {
+          const size_t begin_idx = segment_idx * segment_num_vertices;
+          const size_t end_idx =
+              std::min(begin_idx + segment_num_vertices, vertex_ids.size());
+          pose_graph::VertexIdList::const_iterator begin_it =
+              vertex_ids.begin() + begin_idx;
+          pose_graph::VertexId last_keyframe_id = start_keyframe_id;
+          if (segment_idx > 0u) {
+            last_keyframe_id = *begin_it;
+            segment_keyframes[segment_idx].emplace_back(last_keyframe_id);
+            ++begin_it;
+          }
+          selectKeyframesOfSegment(
+              map, options, begin_it, vertex_ids.begin() + end_idx,
+              last_keyframe_id, &segment_keyframes[segment_idx]);
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+
+  for (const std::vector<pose_graph::VertexId>& keyframes : segment_keyframes) {
+    selected_keyframes->insert(
+        selected_keyframes->end(), keyframes.begin(), keyframes.end());
   }
 
   return selected_keyframes->size();
@@ -164,13 +233,21 @@ size_t removeVerticesBetweenKeyframes(
   pose_graph::Edge::EdgeType traversal_edge =
       map->getGraphTraversalEdgeType(mission_id);
 
+  // Collect the vertices between all keyframes first, the segments are then
+  // merged at once.
+  std::vector<std::pair<pose_graph::VertexId, pose_graph::VertexIdList>>
+      segments(keyframe_ids.size() - 1u);
   size_t num_removed_vertices = 0u;
   for (size_t idx = 0u; idx < keyframe_ids.size() - 1; ++idx) {
     CHECK_EQ(mission_id, map->getMissionIdForVertex(keyframe_ids[idx + 1]))
         << "All keyframes must be of the same mission.";
-    num_removed_vertices += removeAllVerticesBetweenTwoVertices(
-        traversal_edge, keyframe_ids[idx], keyframe_ids[idx + 1], map);
+    segments[idx].first = keyframe_ids[idx];
+    getAllVerticesBetweenTwoVertices(
+        *map, traversal_edge, keyframe_ids[idx], keyframe_ids[idx + 1],
+        &segments[idx].second);
+    num_removed_vertices += segments[idx].second.size();
   }
+  map->mergeVertexSegments(segments);
   return num_removed_vertices;
 }
 
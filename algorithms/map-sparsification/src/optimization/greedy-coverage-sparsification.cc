@@ -0,0 +1,137 @@
+#include "map-sparsification/optimization/greedy-coverage-sparsification.h"
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace map_sparsification {
+
+void GreedyCoverageSparsification::sampleMapSegment(
+    const vi_map::VIMap& map, unsigned int desired_num_landmarks,
+    unsigned int /*time_limit_seconds*/,
+    const vi_map::LandmarkIdSet& segment_landmark_id_set,
+    const pose_graph::VertexIdList& segment_vertex_id_list,
+    vi_map::LandmarkIdSet* summary_landmark_ids) {
+  CHECK_NOTNULL(summary_landmark_ids)->clear();
+
+  // Bail out early if the desired count is smaller than the current count.
+  if (segment_landmark_id_set.size() <= desired_num_landmarks) {
+    LOG(WARNING) << "Nothing to summarize, bailing out early.";
+    summary_landmark_ids->insert(
+        segment_landmark_id_set.begin(), segment_landmark_id_set.end());
+    return;
+  }
+
+  const vi_map::LandmarkIdList landmark_ids(
+      segment_landmark_id_set.begin(), segment_landmark_id_set.end());
+  const size_t num_landmarks = landmark_ids.size();
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_ids_to_indices;
+  landmark_ids_to_indices.reserve(num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    landmark_ids_to_indices.emplace(landmark_ids[landmark_idx], landmark_idx);
+  }
+
+  // The keyframes observing every landmark, and the number of landmarks every
+  // keyframe still misses.
+  std::vector<std::vector<size_t>> keyframes_of_landmarks(num_landmarks);
+  std::vector<unsigned int> num_missing_landmarks_of_keyframes;
+  num_missing_landmarks_of_keyframes.reserve(segment_vertex_id_list.size());
+  std::vector<size_t> keyframe_landmark_indices;
+  for (const pose_graph::VertexId& vertex_id : segment_vertex_id_list) {
+    vi_map::LandmarkIdList observed_landmark_ids;
+    map.getVertex(vertex_id).getAllObservedLandmarkIds(&observed_landmark_ids);
+    keyframe_landmark_indices.clear();
+    for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      const std::unordered_map<vi_map::LandmarkId, size_t>::const_iterator it =
+          landmark_ids_to_indices.find(landmark_id);
+      if (it != landmark_ids_to_indices.end()) {
+        keyframe_landmark_indices.push_back(it->second);
+      }
+    }
+    std::sort(
+        keyframe_landmark_indices.begin(), keyframe_landmark_indices.end());
+    keyframe_landmark_indices.erase(
+        std::unique(
+            keyframe_landmark_indices.begin(), keyframe_landmark_indices.end()),
+        keyframe_landmark_indices.end());
+    const unsigned int num_required_landmarks = std::min<unsigned int>(
+        min_keypoints_per_keyframe_, keyframe_landmark_indices.size());
+    if (num_required_landmarks == 0u) {
+      continue;
+    }
+    const size_t keyframe_idx = num_missing_landmarks_of_keyframes.size();
+    num_missing_landmarks_of_keyframes.push_back(num_required_landmarks);
+    for (const size_t landmark_idx : keyframe_landmark_indices) {
+      keyframes_of_landmarks[landmark_idx].push_back(keyframe_idx);
+    }
+  }
+
+  // Number of keyframes that still miss landmarks among the observers.
+  auto get_coverage_gain = [&](const size_t landmark_idx) {
+    size_t gain = 0u;
+    for (const size_t keyframe_idx : keyframes_of_landmarks[landmark_idx]) {
+      if (num_missing_landmarks_of_keyframes[keyframe_idx] > 0u) {
+        ++gain;
+      }
+    }
+    return gain;
+  };
+
+  // Candidates ordered by coverage gain and then by number of observations.
+  // The gains only shrink as landmarks are selected, so a stored gain is an
+  // upper bound and only the top candidate needs to be re-evaluated.
+  typedef std::tuple<size_t, size_t, size_t> Candidate;
+  std::priority_queue<Candidate> candidates;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    candidates.emplace(
+        get_coverage_gain(landmark_idx),
+        map.getLandmark(landmark_ids[landmark_idx]).numberOfObservations(),
+        landmark_idx);
+  }
+
+  size_t coverage = 0u;
+  while (summary_landmark_ids->size() < desired_num_landmarks) {
+    CHECK(!candidates.empty());
+    Candidate candidate = candidates.top();
+    candidates.pop();
+    const size_t landmark_idx = std::get<2>(candidate);
+    const size_t gain = get_coverage_gain(landmark_idx);
+    if (gain < std::get<0>(candidate)) {
+      std::get<0>(candidate) = gain;
+      candidates.push(candidate);
+      continue;
+    }
+
+    summary_landmark_ids->emplace(landmark_ids[landmark_idx]);
+    coverage += gain;
+    for (const size_t keyframe_idx : keyframes_of_landmarks[landmark_idx]) {
+      if (num_missing_landmarks_of_keyframes[keyframe_idx] > 0u) {
+        --num_missing_landmarks_of_keyframes[keyframe_idx];
+      }
+    }
+  }
+
+  const size_t num_uncovered_keyframes = std::count_if(
+      num_missing_landmarks_of_keyframes.begin(),
+      num_missing_landmarks_of_keyframes.end(),
+      [](const unsigned int num_missing) { return num_missing > 0u; });
+  LOG_IF(WARNING, num_uncovered_keyframes > 0u)
+      << num_uncovered_keyframes << " of "
+      << num_missing_landmarks_of_keyframes.size()
+      << " keyframes keep less than " << min_keypoints_per_keyframe_
+      << " landmarks.";
+  VLOG(1) << "Selected " << summary_landmark_ids->size()
+          << " landmarks with a keyframe coverage of " << coverage << ".";
+  CHECK_EQ(desired_num_landmarks, summary_landmark_ids->size());
+}
+
+}  // namespace map_sparsification
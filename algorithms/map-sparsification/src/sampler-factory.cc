@@ -9,6 +9,7 @@
 #include "map-sparsification/heuristic/random-sampling.h"
 #include "map-sparsification/heuristic/scoring/descriptor-variance-scoring.h"
 #include "map-sparsification/heuristic/scoring/observation-count-scoring.h"
+#include "map-sparsification/optimization/greedy-coverage-sparsification.h"
 #include "map-sparsification/optimization/lp-solve-sparsification.h"
 
 namespace map_sparsification {
@@ -76,10 +77,17 @@ SamplerBase::Ptr createSampler(SamplerBase::Type sampler_type) {
               FLAGS_sparsification_min_keypoints_per_keyframe));
     } break;
     case SamplerBase::Type::kLpsolvePartitionIlp: {
-      SamplerBase::Ptr ilp_sampler =
-          createSampler(SamplerBase::Type::kLpsolveIlp);
-      CHECK(ilp_sampler != nullptr);
-      sampler.reset(new GraphPartitionSampler(ilp_sampler));
+      // Every partition gets its own ILP solver so they can run in parallel.
+      sampler.reset(new GraphPartitionSampler([]() {
+        return createSampler(SamplerBase::Type::kLpsolveIlp);
+      }));
+    } break;
+    case SamplerBase::Type::kGreedyCoverage: {
+      sampler.reset(new GraphPartitionSampler([]() {
+        return SamplerBase::Ptr(
+            new GreedyCoverageSparsification(
+                FLAGS_sparsification_min_keypoints_per_keyframe));
+      }));
     } break;
     default:
       LOG(FATAL) << "Unknown landmark sampler type: "
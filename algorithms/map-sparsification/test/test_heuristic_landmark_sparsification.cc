@@ -1,9 +1,11 @@
 #include <memory>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <map-sparsification/heuristic/cost-functions/min-keypoints-per-keyframe-cost.h>
 #include <map-sparsification/heuristic/heuristic-sampling.h>
+#include <map-sparsification/heuristic/landmark-score-cache.h>
 #include <map-sparsification/heuristic/scoring/descriptor-variance-scoring.h>
 #include <map-sparsification/heuristic/scoring/observation-count-scoring.h>
 #include <maplab-common/test/testing-entrypoint.h>
@@ -45,6 +47,13 @@ class MapSparsification : public testing::Test {
     return kNumDesiredNumLandmarks;
   }
 
+  vi_map::VIMap* getMap() {
+    return generator_map_.get();
+  }
+  vi_map::LandmarkIdList getLandmarkIds() const {
+    return vi_map::LandmarkIdList(landmark_ids_, landmark_ids_ + kNumLandmarks);
+  }
+
  private:
   void initializeMapData();
   void addMissionAndVertices();
@@ -235,4 +244,42 @@ TEST_F(MapSparsification, KeyframeKeypointConstraintSparsificationTest) {
   expectPreservedLandmark(summary_landmark_list, landmark_to_be_preserved);
 }
 
+TEST_F(MapSparsification, ScoreCacheIsUpdatedWithObservations) {
+  generateMapToTestObservationCount();
+  vi_map::VIMap* map = getMap();
+  const vi_map::LandmarkIdList landmark_ids = getLandmarkIds();
+
+  using map_sparsification::scoring::ObservationCountScoringFunction;
+  using map_sparsification::scoring::ScoringFunction;
+  const std::vector<ScoringFunction::ConstPtr> scoring_functions = {
+      std::make_shared<ObservationCountScoringFunction>()};
+
+  map_sparsification::sampling::LandmarkScoreCache score_cache;
+  std::vector<double> scores;
+  score_cache.getScores(*map, scoring_functions, landmark_ids, &scores);
+  ASSERT_EQ(landmark_ids.size(), scores.size());
+  EXPECT_EQ(landmark_ids.size(), score_cache.size());
+  for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+    EXPECT_EQ(
+        map->getLandmark(landmark_ids[i]).numberOfObserverVertices(),
+        scores[i]);
+  }
+
+  // Dropping an observation has to invalidate the cached score.
+  vi_map::Landmark& landmark = map->getLandmark(landmark_ids[1]);
+  const double score_before = scores[1];
+  landmark.removeObservation(0u);
+  std::vector<double> updated_scores;
+  score_cache.getScores(
+      *map, scoring_functions, landmark_ids, &updated_scores);
+  EXPECT_EQ(landmark.numberOfObserverVertices(), updated_scores[1]);
+  EXPECT_LT(updated_scores[1], score_before);
+  for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+    if (i != 1u) {
+      EXPECT_EQ(scores[i], updated_scores[i]);
+    }
+  }
+  EXPECT_EQ(landmark_ids.size(), score_cache.size());
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
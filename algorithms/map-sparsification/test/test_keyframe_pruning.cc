@@ -0,0 +1,81 @@
+#include <memory>
+#include <vector>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "map-sparsification/keyframe-pruning.h"
+
+namespace map_sparsification {
+
+class KeyframePruningTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    constexpr int kSeed = 42;
+    generator_.reset(new vi_map::VIMapGenerator(map_, kSeed));
+    const vi_map::MissionId mission_id =
+        generator_->createMission(pose::Transformation());
+    for (size_t i = 0u; i < kNumVertices; ++i) {
+      vertex_ids_.emplace_back(
+          generator_->createVertex(mission_id, pose::Transformation()));
+    }
+    generator_->generateMap();
+
+    // Only the temporal spacing triggers keyframes.
+    options_.kf_distance_threshold_m = 1e3;
+    options_.kf_rotation_threshold_deg = 180.0;
+    options_.kf_every_nth_vertex = 3u;
+    options_.kf_min_shared_landmarks_obs = 0u;
+    options_.kf_selection_segment_num_vertices = 0u;
+  }
+
+  pose_graph::VertexIdList selectKeyframes() const {
+    pose_graph::VertexIdList keyframe_ids;
+    selectKeyframesBasedOnHeuristics(
+        map_, vertex_ids_.front(), vertex_ids_.back(), options_,
+        &keyframe_ids);
+    return keyframe_ids;
+  }
+
+  pose_graph::VertexIdList getVertexIds(
+      const std::vector<size_t>& indices) const {
+    pose_graph::VertexIdList vertex_ids;
+    for (const size_t index : indices) {
+      vertex_ids.emplace_back(vertex_ids_[index]);
+    }
+    return vertex_ids;
+  }
+
+  static constexpr size_t kNumVertices = 20u;
+
+  vi_map::VIMap map_;
+  std::unique_ptr<vi_map::VIMapGenerator> generator_;
+  pose_graph::VertexIdList vertex_ids_;
+  KeyframingHeuristicsOptions options_;
+};
+
+TEST_F(KeyframePruningTest, SelectsKeyframesInOnePass) {
+  EXPECT_EQ(getVertexIds({0u, 4u, 8u, 12u, 16u}), selectKeyframes());
+}
+
+TEST_F(KeyframePruningTest, DefaultOptionsSelectKeyframesInOnePass) {
+  options_.kf_selection_segment_num_vertices =
+      KeyframingHeuristicsOptions::initializeFromGFlags()
+          .kf_selection_segment_num_vertices;
+  EXPECT_EQ(getVertexIds({0u, 4u, 8u, 12u, 16u}), selectKeyframes());
+}
+
+TEST_F(KeyframePruningTest, EverySegmentStartsWithAKeyframe) {
+  // The segments start at the vertices 1, 9 and 17.
+  options_.kf_selection_segment_num_vertices = 8u;
+  EXPECT_EQ(getVertexIds({0u, 4u, 8u, 9u, 13u, 17u}), selectKeyframes());
+
+  // Segments longer than the mission are the same as a single pass.
+  options_.kf_selection_segment_num_vertices = 2u * kNumVertices;
+  EXPECT_EQ(getVertexIds({0u, 4u, 8u, 12u, 16u}), selectKeyframes());
+}
+
+}  // namespace map_sparsification
+
+MAPLAB_UNITTEST_ENTRYPOINT
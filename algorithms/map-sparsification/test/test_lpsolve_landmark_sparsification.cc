@@ -6,6 +6,7 @@
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 
 #include "map-sparsification/graph-partition-sampler.h"
+#include "map-sparsification/optimization/greedy-coverage-sparsification.h"
 #include "map-sparsification/sampler-factory.h"
 
 namespace map_sparsification {
@@ -30,6 +31,11 @@ class ViMappingTest : public ::testing::Test {
     sampler_ = createSampler(SamplerBase::Type::kLpsolveIlp);
   }
 
+  void constructGreedyCoverageSampler() {
+    constexpr unsigned int kMinKeypointsPerKeyframe = 30u;
+    sampler_.reset(new GreedyCoverageSparsification(kMinKeypointsPerKeyframe));
+  }
+
   void sampleLandmarks(vi_map::LandmarkIdSet* landmarks_to_keep) {
     CHECK(sampler_ != nullptr);
     CHECK_NOTNULL(landmarks_to_keep);
@@ -122,6 +128,24 @@ TEST_F(ViMappingTest, PartitionedLpsolveLandmarkSparsificationWorks) {
   evaluteLandmarkSelection(landmarks_to_keep);
 }
 
+TEST_F(ViMappingTest, GreedyCoverageLandmarkSparsificationWorks) {
+  constructGreedyCoverageSampler();
+
+  vi_map::LandmarkIdSet landmarks_to_keep;
+  sampleLandmarks(&landmarks_to_keep);
+
+  evaluteLandmarkSelection(landmarks_to_keep);
+}
+
+TEST_F(ViMappingTest, PartitionedGreedyCoverageLandmarkSparsificationWorks) {
+  constructGreedyCoverageSampler();
+
+  vi_map::LandmarkIdSet landmarks_to_keep;
+  sampleLandmarksWithPartitioning(&landmarks_to_keep);
+
+  evaluteLandmarkSelection(landmarks_to_keep);
+}
+
 }  // namespace map_sparsification
 
 MAPLAB_UNITTEST_ENTRYPOINT
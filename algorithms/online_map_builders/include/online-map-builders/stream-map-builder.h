@@ -1,9 +1,14 @@
 #ifndef ONLINE_MAP_BUILDERS_STREAM_MAP_BUILDER_H_
 #define ONLINE_MAP_BUILDERS_STREAM_MAP_BUILDER_H_
 
+#include <deque>
+#include <future>
 #include <memory>
 
 #include <Eigen/Dense>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/thread-pool.h>
+#include <map-sparsification/keyframe-pruning.h>
 #include <posegraph/unique-id.h>
 #include <sensors/imu.h>
 #include <sensors/sensor.h>
@@ -31,6 +36,7 @@ class StreamMapBuilder {
   StreamMapBuilder(
       const std::shared_ptr<aslam::NCamera>& camera_rig,
       vi_map::Imu::UniquePtr imu, vi_map::VIMap* map);
+  ~StreamMapBuilder();
 
   // Deep copies the nframe.
   void apply(const vio::VioUpdate& update);
@@ -42,6 +48,16 @@ class StreamMapBuilder {
 
   pose_graph::VertexId getRootVertexId() const;
   pose_graph::VertexId getLastVertexId() const;
+  // The newest vertex that is neither modified by the tracker nor merged by
+  // the online keyframing anymore, all older vertices are final as well.
+  // Invalid if there is no such vertex yet.
+  pose_graph::VertexId getLastSettledVertexId() const;
+
+  // Premultiplies the poses of all vertices added from now on, e.g. after the
+  // existing vertices were moved by a relaxation while the map is built.
+  // Composes with the corrections that were applied before.
+  void applyPoseCorrectionToNewVertices(
+      const aslam::Transformation& T_corrected_uncorrected);
 
   void removeAllVerticesAfterVertexId(
       const pose_graph::VertexId& vertiex_id_from,
@@ -49,6 +65,14 @@ class StreamMapBuilder {
 
   bool checkConsistency() const;
 
+  // With --map_builder_online_keyframing, the most recent vertices are held
+  // back until the tracker is done with them. Keeps them all as keyframes, call
+  // once no more updates will be applied.
+  void finishOnlineKeyframing();
+  // Blocks until all images have been written to the map resource folder, the
+  // map must not be saved before.
+  void waitForPendingResourceWrites();
+
  private:
   void addRootViwlsVertex(
       const std::shared_ptr<aslam::VisualNFrame>& nframe,
@@ -69,6 +93,18 @@ class StreamMapBuilder {
       const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
       const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_measurements);
 
+  // Decides on the oldest vertex after the last keyframe that the tracker no
+  // longer modifies. Non-keyframes are merged into the IMU edge between the
+  // keyframes right away.
+  void selectKeyframesOnline();
+  size_t getNumberOfCommonTracks(
+      const pose_graph::VertexId& vertex_id_a,
+      const pose_graph::VertexId& vertex_id_b) const;
+
+  // Queues the images of the vertex to be written to the map resource folder,
+  // so the map builder doesn't wait for the disk.
+  void storeImagesAsResources(const pose_graph::VertexId& vertex_id);
+
   inline const vi_map::VIMap* constMap() const;
 
   vi_map::VIMap* const map_;
@@ -77,7 +113,21 @@ class StreamMapBuilder {
   pose_graph::VertexId last_vertex_;
   const std::shared_ptr<aslam::NCamera> camera_rig_;
 
+  const bool online_keyframing_;
+  const map_sparsification::KeyframingHeuristicsOptions keyframing_options_;
+  pose_graph::VertexId last_keyframe_id_;
+  size_t num_frames_since_last_keyframe_;
+  aslam::Transformation T_corrected_uncorrected_;
+
+  std::unique_ptr<aslam::ThreadPool> resource_writer_thread_pool_;
+  std::deque<std::future<void>> pending_resource_writes_;
+
   static constexpr size_t kKeepNMostRecentImages = 10u;
+  // The tracker still modifies the tracks of the two most recent frames.
+  static constexpr size_t kNumHeldBackVertices = 2u;
+  static_assert(
+      kKeepNMostRecentImages > kNumHeldBackVertices,
+      "The images of the held back vertices are needed once keyframed.");
 };
 
 }  // namespace online_map_builders
@@ -1,5 +1,8 @@
 #include "online-map-builders/stream-map-builder.h"
 
+#include <chrono>
+#include <unordered_set>
+
 #include <aslam/common/stl-helpers.h>
 #include <aslam/frames/visual-nframe.h>
 #include <glog/logging.h>
@@ -14,6 +17,11 @@ DEFINE_bool(
     map_builder_save_image_as_resources, false,
     "Store the images associated with the visual frames to the map resource "
     "folder.");
+DEFINE_bool(
+    map_builder_online_keyframing, false,
+    "Select keyframes while building the map with the --kf_* heuristics and "
+    "merge the other vertices into the IMU edges between the keyframes right "
+    "away. Only the images of the keyframes are stored as resources.");
 
 namespace online_map_builders {
 
@@ -31,12 +39,41 @@ pose_graph::VertexId StreamMapBuilder::getLastVertexId() const {
   return last_vertex_;
 }
 
+pose_graph::VertexId StreamMapBuilder::getLastSettledVertexId() const {
+  if (!last_vertex_.isValid()) {
+    return pose_graph::VertexId();
+  }
+  if (online_keyframing_) {
+    // Only the vertices after the last keyframe are still merged.
+    return last_keyframe_id_;
+  }
+  const pose_graph::Edge::EdgeType backbone_type =
+      constMap()->getGraphTraversalEdgeType(mission_id_);
+  pose_graph::VertexId vertex_id = last_vertex_;
+  for (size_t i = 0u; i < kNumHeldBackVertices; ++i) {
+    if (!constMap()->getPreviousVertex(vertex_id, backbone_type, &vertex_id)) {
+      return pose_graph::VertexId();
+    }
+  }
+  return vertex_id;
+}
+
+void StreamMapBuilder::applyPoseCorrectionToNewVertices(
+    const aslam::Transformation& T_corrected_uncorrected) {
+  T_corrected_uncorrected_ = T_corrected_uncorrected * T_corrected_uncorrected_;
+}
+
 StreamMapBuilder::StreamMapBuilder(
     const std::shared_ptr<aslam::NCamera>& camera_rig, vi_map::VIMap* map)
     : map_(CHECK_NOTNULL(map)),
       manipulation_(map),
       mission_id_(common::createRandomId<vi_map::MissionId>()),
-      camera_rig_(camera_rig) {
+      camera_rig_(camera_rig),
+      online_keyframing_(FLAGS_map_builder_online_keyframing),
+      keyframing_options_(
+          map_sparsification::KeyframingHeuristicsOptions::
+              initializeFromGFlags()),
+      num_frames_since_last_keyframe_(0u) {
   CHECK(camera_rig);
   map_->addNewMissionWithBaseframe(
       mission_id_, aslam::Transformation(),
@@ -50,7 +87,12 @@ StreamMapBuilder::StreamMapBuilder(
     : map_(CHECK_NOTNULL(map)),
       manipulation_(map),
       mission_id_(common::createRandomId<vi_map::MissionId>()),
-      camera_rig_(camera_rig) {
+      camera_rig_(camera_rig),
+      online_keyframing_(FLAGS_map_builder_online_keyframing),
+      keyframing_options_(
+          map_sparsification::KeyframingHeuristicsOptions::
+              initializeFromGFlags()),
+      num_frames_since_last_keyframe_(0u) {
   CHECK(camera_rig);
   map_->addNewMissionWithBaseframe(
       mission_id_, aslam::Transformation(),
@@ -59,6 +101,10 @@ StreamMapBuilder::StreamMapBuilder(
   map_->getSensorManager().addSensor(std::move(imu), mission_id_);
 }
 
+StreamMapBuilder::~StreamMapBuilder() {
+  waitForPendingResourceWrites();
+}
+
 void StreamMapBuilder::apply(const vio::VioUpdate& update) {
   CHECK(update.check());
   constexpr bool kDeepCopyNFrame = true;
@@ -110,6 +156,9 @@ void StreamMapBuilder::addRootViwlsVertex(
   map_->getMission(mission_id_).setRootVertexId(root_vertex_id);
 
   last_vertex_ = root_vertex_id;
+  last_keyframe_id_ = root_vertex_id;
+  num_frames_since_last_keyframe_ = 0u;
+  storeImagesAsResources(root_vertex_id);
 }
 
 void StreamMapBuilder::addViwlsVertexAndEdge(
@@ -125,6 +174,12 @@ void StreamMapBuilder::addViwlsVertexAndEdge(
 
   addImuEdge(new_vertex_id, imu_timestamps, imu_data);
 
+  if (online_keyframing_) {
+    selectKeyframesOnline();
+  } else {
+    storeImagesAsResources(new_vertex_id);
+  }
+
   if (kKeepNMostRecentImages > 0u) {
     manipulation_.releaseOldVisualFrameImages(
         last_vertex_, kKeepNMostRecentImages);
@@ -151,30 +206,156 @@ pose_graph::VertexId StreamMapBuilder::addViwlsVertex(
   // Create and add the new map vertex.
   pose_graph::VertexId vertex_id =
       common::createRandomId<pose_graph::VertexId>();
-  vi_map::Vertex* map_vertex = new vi_map::Vertex(
-      vertex_id, vinode_state.getImuBias(), nframe, invalid_landmark_ids,
-      mission_id_);
+  vi_map::Vertex* map_vertex = map_->emplaceVertex(
+      mission_id_, vertex_id, vinode_state.getImuBias(), nframe,
+      invalid_landmark_ids, mission_id_);
   // Set pose and velocity.
-  map_vertex->set_T_M_I(vinode_state.get_T_M_I());
-  map_vertex->set_v_M(vinode_state.get_v_M_I());
-  map_->addVertex(vi_map::Vertex::UniquePtr(map_vertex));
-
-  // Optionally dump the image to disk.
-  if (FLAGS_map_builder_save_image_as_resources) {
-    CHECK(map_->hasMapFolder())
-        << "Cannot store resources to a map that has no associated map folder, "
-        << "please set the map folder in the VIMap constructor or by using "
-        << "map.setMapFolder()!";
-    map_->useMapResourceFolder();
-    for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames();
-         ++frame_idx) {
-      if (nframe->isFrameSet(frame_idx)) {
-        map_->storeRawImage(
-            nframe->getFrame(frame_idx).getRawImage(), frame_idx, map_vertex);
+  map_vertex->set_T_M_I(T_corrected_uncorrected_ * vinode_state.get_T_M_I());
+  map_vertex->set_v_M(
+      T_corrected_uncorrected_.getRotation().rotate(
+          vinode_state.get_v_M_I()));
+
+  return vertex_id;
+}
+
+void StreamMapBuilder::selectKeyframesOnline() {
+  CHECK(last_keyframe_id_.isValid());
+  const pose_graph::Edge::EdgeType backbone_type =
+      constMap()->getGraphTraversalEdgeType(mission_id_);
+
+  pose_graph::VertexId candidate_id;
+  while (constMap()->getNextVertex(
+      last_keyframe_id_, backbone_type, &candidate_id)) {
+    // Only decide on vertices that are followed by enough newer vertices.
+    pose_graph::VertexId vertex_id = candidate_id;
+    size_t num_newer_vertices = 0u;
+    while (num_newer_vertices < kNumHeldBackVertices &&
+           constMap()->getNextVertex(vertex_id, backbone_type, &vertex_id)) {
+      ++num_newer_vertices;
+    }
+    if (num_newer_vertices < kNumHeldBackVertices) {
+      return;
+    }
+
+    // The landmarks are only initialized once the map is finished, so the
+    // shared landmarks are approximated by the shared feature tracks.
+    const size_t num_common_tracks =
+        getNumberOfCommonTracks(candidate_id, last_keyframe_id_);
+    const aslam::Transformation T_Bkf_Bi =
+        constMap()->getVertex_T_G_I(last_keyframe_id_).inverse() *
+        constMap()->getVertex_T_G_I(candidate_id);
+    if (map_sparsification::isKeyframeBasedOnHeuristics(
+            keyframing_options_, num_frames_since_last_keyframe_,
+            num_common_tracks, T_Bkf_Bi)) {
+      last_keyframe_id_ = candidate_id;
+      num_frames_since_last_keyframe_ = 0u;
+      storeImagesAsResources(candidate_id);
+    } else {
+      map_->mergeNeighboringVertices(last_keyframe_id_, candidate_id);
+      ++num_frames_since_last_keyframe_;
+    }
+  }
+}
+
+size_t StreamMapBuilder::getNumberOfCommonTracks(
+    const pose_graph::VertexId& vertex_id_a,
+    const pose_graph::VertexId& vertex_id_b) const {
+  const aslam::VisualNFrame& nframe_a =
+      constMap()->getVertex(vertex_id_a).getVisualNFrame();
+  const aslam::VisualNFrame& nframe_b =
+      constMap()->getVertex(vertex_id_b).getVisualNFrame();
+  CHECK_EQ(nframe_a.getNumFrames(), nframe_b.getNumFrames());
+
+  size_t num_common_tracks = 0u;
+  for (size_t frame_idx = 0u; frame_idx < nframe_a.getNumFrames();
+       ++frame_idx) {
+    if (!nframe_a.isFrameSet(frame_idx) || !nframe_b.isFrameSet(frame_idx)) {
+      continue;
+    }
+    const aslam::VisualFrame& frame_a = nframe_a.getFrame(frame_idx);
+    const aslam::VisualFrame& frame_b = nframe_b.getFrame(frame_idx);
+    if (!frame_a.hasTrackIds() || !frame_b.hasTrackIds()) {
+      continue;
+    }
+    const Eigen::VectorXi& track_ids_a = frame_a.getTrackIds();
+    const Eigen::VectorXi& track_ids_b = frame_b.getTrackIds();
+    std::unordered_set<int> tracks_a;
+    for (int i = 0; i < track_ids_a.rows(); ++i) {
+      if (track_ids_a(i) >= 0) {
+        tracks_a.insert(track_ids_a(i));
       }
     }
+    for (int i = 0; i < track_ids_b.rows(); ++i) {
+      num_common_tracks += tracks_a.count(track_ids_b(i));
+    }
   }
-  return vertex_id;
+  return num_common_tracks;
+}
+
+void StreamMapBuilder::storeImagesAsResources(
+    const pose_graph::VertexId& vertex_id) {
+  if (!FLAGS_map_builder_save_image_as_resources) {
+    return;
+  }
+  CHECK(map_->hasMapFolder())
+      << "Cannot store resources to a map that has no associated map folder, "
+      << "please set the map folder in the VIMap constructor or by using "
+      << "map.setMapFolder()!";
+  map_->useMapResourceFolder();
+  if (!resource_writer_thread_pool_) {
+    constexpr size_t kNumResourceWriterThreads = 1u;
+    resource_writer_thread_pool_.reset(
+        new aslam::ThreadPool(kNumResourceWriterThreads));
+  }
+
+  // Drop the writes that are done, so the queue only grows if the disk can't
+  // keep up.
+  while (!pending_resource_writes_.empty() &&
+         pending_resource_writes_.front().wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready) {
+    pending_resource_writes_.front().get();
+    pending_resource_writes_.pop_front();
+  }
+
+  vi_map::Vertex* map_vertex = map_->getVertexPtr(vertex_id);
+  const aslam::VisualNFrame& nframe = map_vertex->getVisualNFrame();
+  for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+    if (!nframe.isFrameSet(frame_idx)) {
+      continue;
+    }
+    // The task shares the image data, so it is freed as soon as it is written
+    // and the frame released its image.
+    const cv::Mat image = nframe.getFrame(frame_idx).getRawImage();
+    const backend::ResourceId resource_id = map_->reserveFrameResource(
+        frame_idx, backend::ResourceType::kRawImage, map_vertex);
+    vi_map::VIMap* map = map_;
+    pending_resource_writes_.emplace_back(
+        resource_writer_thread_pool_->enqueue([map, image, resource_id]() {
+          map->storeReservedFrameResource(
+              image, backend::ResourceType::kRawImage, resource_id);
+        }));
+  }
+}
+
+void StreamMapBuilder::finishOnlineKeyframing() {
+  if (!online_keyframing_ || !last_keyframe_id_.isValid()) {
+    return;
+  }
+  const pose_graph::Edge::EdgeType backbone_type =
+      constMap()->getGraphTraversalEdgeType(mission_id_);
+  pose_graph::VertexId vertex_id = last_keyframe_id_;
+  while (constMap()->getNextVertex(vertex_id, backbone_type, &vertex_id)) {
+    storeImagesAsResources(vertex_id);
+    last_keyframe_id_ = vertex_id;
+  }
+  num_frames_since_last_keyframe_ = 0u;
+}
+
+void StreamMapBuilder::waitForPendingResourceWrites() {
+  for (std::future<void>& pending_write : pending_resource_writes_) {
+    pending_write.get();
+  }
+  pending_resource_writes_.clear();
 }
 
 void StreamMapBuilder::removeAllVerticesAfterVertexId(
@@ -183,6 +364,11 @@ void StreamMapBuilder::removeAllVerticesAfterVertexId(
   CHECK_NOTNULL(removed_vertex_ids);
   manipulation_.removePosegraphAfter(vertex_id_from, removed_vertex_ids);
   last_vertex_ = vertex_id_from;
+  if (last_keyframe_id_.isValid() &&
+      !constMap()->hasVertex(last_keyframe_id_)) {
+    last_keyframe_id_ = vertex_id_from;
+    num_frames_since_last_keyframe_ = 0u;
+  }
 }
 
 void StreamMapBuilder::addImuEdge(
@@ -243,10 +429,9 @@ void StreamMapBuilder::addImuEdge(
 
   // Add the edge.
   pose_graph::EdgeId edge_id = common::createRandomId<pose_graph::EdgeId>();
-  map_->addEdge(
-      aligned_unique<vi_map::ViwlsEdge>(
-          edge_id, last_vertex_, target_vertex_id, imu_timestamps,
-          imu_measurements));
+  map_->emplaceEdge<vi_map::ViwlsEdge>(
+      mission_id_, edge_id, last_vertex_, target_vertex_id, imu_timestamps,
+      imu_measurements);
 
   last_vertex_ = target_vertex_id;
 }
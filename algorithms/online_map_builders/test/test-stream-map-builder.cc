@@ -0,0 +1,267 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <opencv2/core/core.hpp>
+#include <vi-map/vi-map.h>
+#include <vio-common/vio-types.h>
+#include <vio-common/vio-update.h>
+
+#include "online-map-builders/stream-map-builder.h"
+
+DECLARE_bool(map_builder_online_keyframing);
+DECLARE_bool(map_builder_save_image_as_resources);
+DECLARE_double(kf_distance_threshold_m);
+DECLARE_double(kf_rotation_threshold_deg);
+DECLARE_uint64(kf_every_nth_vertex);
+DECLARE_uint64(kf_min_shared_landmarks_obs);
+
+namespace online_map_builders {
+
+class StreamMapBuilderTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    constexpr size_t kNumCameras = 1u;
+    ncamera_ = aslam::NCamera::createTestNCamera(kNumCameras);
+    ASSERT_TRUE(common::removePath(kMapFolder));
+    map_.reset(new vi_map::VIMap(kMapFolder));
+
+    // Only every fourth vertex is a keyframe, the other heuristics never
+    // trigger.
+    FLAGS_kf_every_nth_vertex = 3u;
+    FLAGS_kf_min_shared_landmarks_obs = 0u;
+    FLAGS_kf_distance_threshold_m = 1e3;
+    FLAGS_kf_rotation_threshold_deg = 180.0;
+  }
+
+  virtual void TearDown() {
+    map_builder_.reset();
+    map_.reset();
+    common::removePath(kMapFolder);
+    FLAGS_map_builder_online_keyframing = false;
+    FLAGS_map_builder_save_image_as_resources = false;
+  }
+
+  void createMapBuilder() {
+    map_builder_.reset(new StreamMapBuilder(ncamera_, map_.get()));
+  }
+
+  static int64_t getTimestampNanoseconds(const size_t update_idx) {
+    return static_cast<int64_t>(update_idx) * kTimeBetweenUpdatesNs;
+  }
+
+  // The image of every update is filled with the index of the update, so the
+  // stored resources can be traced back to their vertex.
+  void applyUpdate(const size_t update_idx, const int track_id) {
+    const int64_t timestamp_ns = getTimestampNanoseconds(update_idx);
+    vio::SynchronizedNFrameImu::Ptr nframe_imu =
+        aligned_shared<vio::SynchronizedNFrameImu>();
+    nframe_imu->nframe = aslam::VisualNFrame::createEmptyTestVisualNFrame(
+        ncamera_, timestamp_ns);
+    aslam::VisualFrame& frame = *nframe_imu->nframe->getFrameShared(0u);
+    frame.setKeypointMeasurements(Eigen::Matrix2Xd::Ones(2, 1));
+    frame.setTrackIds(Eigen::VectorXi::Constant(1, track_id));
+    const aslam::Camera& camera = ncamera_->getCamera(0u);
+    frame.setRawImage(
+        cv::Mat(
+            camera.imageHeight(), camera.imageWidth(), CV_8UC1,
+            cv::Scalar(update_idx)));
+
+    // The last IMU measurement of the previous edge is repeated.
+    if (update_idx == 0u) {
+      nframe_imu->imu_timestamps.resize(1, 1);
+      nframe_imu->imu_timestamps << timestamp_ns;
+    } else {
+      nframe_imu->imu_timestamps.resize(1, 2);
+      nframe_imu->imu_timestamps << getTimestampNanoseconds(update_idx - 1u),
+          timestamp_ns;
+    }
+    nframe_imu->imu_measurements.setZero(
+        6, nframe_imu->imu_timestamps.cols());
+
+    vio::VioUpdate update;
+    update.timestamp_ns = timestamp_ns;
+    update.vio_state = vio::EstimatorState::kRunning;
+    update.vio_update_type = vio::UpdateType::kNormalUpdate;
+    update.keyframe_and_imudata = nframe_imu;
+    update.vinode.set_T_M_I(getVioPose(update_idx));
+    update.vinode.set_v_M_I(getVelocity());
+    update.localization_state = vio::LocalizationState::kUninitialized;
+    map_builder_->apply(update);
+  }
+
+  static aslam::Transformation getVioPose(const size_t update_idx) {
+    return aslam::Transformation(
+        aslam::Position3D(0.01 * update_idx, 0.0, 0.0), aslam::Quaternion());
+  }
+
+  static Eigen::Vector3d getVelocity() {
+    return Eigen::Vector3d(0.1, 0.0, 0.0);
+  }
+
+  void getVertexIdsSortedByTimestamp(pose_graph::VertexIdList* vertex_ids) {
+    CHECK_NOTNULL(vertex_ids);
+    map_->getAllVertexIdsInMissionAlongGraph(
+        map_builder_->getMissionId(), vertex_ids);
+  }
+
+  size_t getUpdateIndex(const pose_graph::VertexId& vertex_id) const {
+    return static_cast<size_t>(
+        map_->getVertex(vertex_id).getMinTimestampNanoseconds() /
+        kTimeBetweenUpdatesNs);
+  }
+
+  static constexpr int64_t kTimeBetweenUpdatesNs = 100000000;
+  static constexpr char kMapFolder[] = "./stream_map_builder_test_map";
+
+  aslam::NCamera::Ptr ncamera_;
+  std::unique_ptr<vi_map::VIMap> map_;
+  std::unique_ptr<StreamMapBuilder> map_builder_;
+};
+
+constexpr int64_t StreamMapBuilderTest::kTimeBetweenUpdatesNs;
+constexpr char StreamMapBuilderTest::kMapFolder[];
+
+TEST_F(StreamMapBuilderTest, OnlineKeyframingMergesNonKeyframes) {
+  FLAGS_map_builder_online_keyframing = true;
+  createMapBuilder();
+  constexpr size_t kNumUpdates = 13u;
+  constexpr int kTrackId = 0;
+  for (size_t update_idx = 0u; update_idx < kNumUpdates; ++update_idx) {
+    applyUpdate(update_idx, kTrackId);
+  }
+
+  // The two most recent vertices are held back, the others are keyframes or
+  // already merged into the keyframe before them.
+  pose_graph::VertexIdList vertex_ids;
+  getVertexIdsSortedByTimestamp(&vertex_ids);
+  const std::vector<size_t> kExpectedUpdateIndices = {0u, 4u, 8u, 11u, 12u};
+  ASSERT_EQ(vertex_ids.size(), kExpectedUpdateIndices.size());
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    EXPECT_EQ(getUpdateIndex(vertex_ids[i]), kExpectedUpdateIndices[i]);
+  }
+  EXPECT_EQ(map_builder_->getLastSettledVertexId(), vertex_ids[2]);
+  EXPECT_TRUE(map_builder_->checkConsistency());
+
+  // The IMU edges span the merged vertices.
+  pose_graph::EdgeIdList edge_ids;
+  map_->getOutgoingOfType(
+      pose_graph::Edge::EdgeType::kViwls, vertex_ids[0], &edge_ids);
+  ASSERT_EQ(edge_ids.size(), 1u);
+  const vi_map::ViwlsEdge& edge =
+      map_->getEdgeAs<vi_map::ViwlsEdge>(edge_ids.front());
+  EXPECT_EQ(edge.to(), vertex_ids[1]);
+  EXPECT_EQ(edge.getImuTimestamps()(0), getTimestampNanoseconds(0u));
+  EXPECT_EQ(
+      edge.getImuTimestamps()(edge.getImuTimestamps().cols() - 1),
+      getTimestampNanoseconds(4u));
+
+  // The held back vertices are kept once the map is finished.
+  map_builder_->finishOnlineKeyframing();
+  getVertexIdsSortedByTimestamp(&vertex_ids);
+  EXPECT_EQ(vertex_ids.size(), kExpectedUpdateIndices.size());
+  EXPECT_EQ(map_builder_->getLastSettledVertexId(), vertex_ids.back());
+}
+
+TEST_F(StreamMapBuilderTest, OnlineKeyframingKeepsVerticesWithoutCommonTracks) {
+  FLAGS_kf_min_shared_landmarks_obs = 1u;
+  FLAGS_map_builder_online_keyframing = true;
+  createMapBuilder();
+  // The track is lost after the second update, the vertex after that is the
+  // first to share no track with the last keyframe.
+  constexpr size_t kNumUpdates = 6u;
+  for (size_t update_idx = 0u; update_idx < kNumUpdates; ++update_idx) {
+    const int track_id = update_idx < 2u ? 0 : 1;
+    applyUpdate(update_idx, track_id);
+  }
+
+  pose_graph::VertexIdList vertex_ids;
+  getVertexIdsSortedByTimestamp(&vertex_ids);
+  const std::vector<size_t> kExpectedUpdateIndices = {0u, 2u, 4u, 5u};
+  ASSERT_EQ(vertex_ids.size(), kExpectedUpdateIndices.size());
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    EXPECT_EQ(getUpdateIndex(vertex_ids[i]), kExpectedUpdateIndices[i]);
+  }
+  EXPECT_TRUE(map_builder_->checkConsistency());
+}
+
+TEST_F(StreamMapBuilderTest, ImagesAreStoredAsResourcesOfTheirVertex) {
+  FLAGS_map_builder_online_keyframing = true;
+  FLAGS_map_builder_save_image_as_resources = true;
+  createMapBuilder();
+  constexpr size_t kNumUpdates = 13u;
+  constexpr int kTrackId = 0;
+  for (size_t update_idx = 0u; update_idx < kNumUpdates; ++update_idx) {
+    applyUpdate(update_idx, kTrackId);
+  }
+  map_builder_->finishOnlineKeyframing();
+  map_builder_->waitForPendingResourceWrites();
+
+  // Only the keyframes have images, each one its own.
+  pose_graph::VertexIdList vertex_ids;
+  getVertexIdsSortedByTimestamp(&vertex_ids);
+  ASSERT_EQ(vertex_ids.size(), 5u);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = map_->getVertex(vertex_id);
+    cv::Mat image;
+    ASSERT_TRUE(
+        map_->getFrameResource(
+            vertex, 0u, backend::ResourceType::kRawImage, &image));
+    ASSERT_FALSE(image.empty());
+    double min_value, max_value;
+    cv::minMaxLoc(image, &min_value, &max_value);
+    EXPECT_EQ(min_value, max_value);
+    EXPECT_EQ(static_cast<size_t>(min_value), getUpdateIndex(vertex_id));
+  }
+}
+
+TEST_F(StreamMapBuilderTest, PoseCorrectionAppliesToNewVerticesOnly) {
+  createMapBuilder();
+  constexpr int kTrackId = 0;
+  applyUpdate(0u, kTrackId);
+  const aslam::Transformation T_corrected_uncorrected(
+      aslam::Position3D(1.0, 2.0, 0.0),
+      aslam::Quaternion(aslam::AngleAxis(0.5, 0.0, 0.0, 1.0)));
+  map_builder_->applyPoseCorrectionToNewVertices(T_corrected_uncorrected);
+  applyUpdate(1u, kTrackId);
+
+  // The second correction composes with the first one.
+  const aslam::Transformation T_second_correction(
+      aslam::Position3D(0.0, -1.0, 0.5),
+      aslam::Quaternion(aslam::AngleAxis(0.2, 1.0, 0.0, 0.0)));
+  map_builder_->applyPoseCorrectionToNewVertices(T_second_correction);
+  applyUpdate(2u, kTrackId);
+
+  pose_graph::VertexIdList vertex_ids;
+  getVertexIdsSortedByTimestamp(&vertex_ids);
+  ASSERT_EQ(vertex_ids.size(), 3u);
+  const std::vector<aslam::Transformation> kExpectedCorrections = {
+      aslam::Transformation(), T_corrected_uncorrected,
+      T_second_correction * T_corrected_uncorrected};
+  constexpr double kPrecision = 1e-10;
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    const vi_map::Vertex& vertex = map_->getVertex(vertex_ids[i]);
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        vertex.get_T_M_I(), kExpectedCorrections[i] * getVioPose(i),
+        kPrecision);
+    EXPECT_NEAR_EIGEN(
+        vertex.get_v_M(),
+        kExpectedCorrections[i].getRotation().rotate(getVelocity()),
+        kPrecision);
+  }
+}
+
+}  // namespace online_map_builders
+
+MAPLAB_UNITTEST_ENTRYPOINT
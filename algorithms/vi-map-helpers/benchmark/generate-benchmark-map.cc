@@ -0,0 +1,38 @@
+#include <string>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "vi-map-helpers/benchmark-map-generator.h"
+
+// Writes a synthetic benchmark map configured by the --benchmark_map_* flags:
+//   generate_benchmark_map --benchmark_map_folder=/tmp/benchmark_map \
+//       --benchmark_map_num_missions=100 \
+//       --benchmark_map_num_landmarks_per_frame=500
+
+DEFINE_string(
+    benchmark_map_folder, "", "Folder the benchmark map is written to.");
+DEFINE_bool(
+    benchmark_map_overwrite, false,
+    "Overwrite an existing map in the benchmark map folder.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+  CHECK(!FLAGS_benchmark_map_folder.empty())
+      << "Specify the output folder with --benchmark_map_folder.";
+
+  const vi_map_helpers::BenchmarkMapGenerator generator(
+      vi_map_helpers::BenchmarkMapOptions::fromGflags());
+  LOG(INFO) << "Writing a benchmark map with " << generator.numLandmarks()
+            << " landmarks to " << FLAGS_benchmark_map_folder << '.';
+  if (!generator.generateMapToFolder(
+          FLAGS_benchmark_map_folder, FLAGS_benchmark_map_overwrite)) {
+    LOG(ERROR) << "Saving the benchmark map failed.";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>  // NOLINT
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/pose_types.h>
+#include <maplab-common/string-tools.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-nearest-neighbor-lookup.h"
+
+// Compares the per-query and the batched searches of the vertex
+// nearest-neighbor lookup on generated maps. The results are written in the
+// JSON format of Google Benchmark:
+//   nearest_neighbor_lookup_benchmarks --benchmark_out=results.json
+
+DEFINE_string(
+    benchmark_map_sizes, "1000,10000",
+    "Comma separated numbers of vertices of the generated benchmark maps.");
+DEFINE_string(
+    benchmark_num_neighbors, "1,10",
+    "Comma separated numbers of neighbors of the batched k-NN benchmarks.");
+DEFINE_int32(
+    benchmark_num_queries, 10000, "Number of queries of every benchmark.");
+DEFINE_int32(
+    benchmark_repetitions, 5, "Number of repetitions of every benchmark.");
+DEFINE_string(
+    benchmark_out, "",
+    "File the JSON results are written to. Printed to stdout if empty.");
+
+namespace vi_map_helpers {
+namespace {
+
+constexpr int kMapSeed = 42;
+constexpr double kMapExtentMeters = 100.0;
+
+struct BenchmarkResult {
+  std::string name;
+  std::vector<double> real_times_ms;
+  std::vector<double> cpu_times_ms;
+};
+
+class BenchmarkTimer {
+ public:
+  BenchmarkTimer()
+      : real_start_(std::chrono::steady_clock::now()),
+        cpu_start_(std::clock()) {}
+
+  void stop(BenchmarkResult* result) const {
+    CHECK_NOTNULL(result);
+    const std::chrono::duration<double, std::milli> real_time =
+        std::chrono::steady_clock::now() - real_start_;
+    result->real_times_ms.push_back(real_time.count());
+    result->cpu_times_ms.push_back(
+        1e3 * static_cast<double>(std::clock() - cpu_start_) / CLOCKS_PER_SEC);
+  }
+
+ private:
+  const std::chrono::steady_clock::time_point real_start_;
+  const std::clock_t cpu_start_;
+};
+
+std::vector<int> parseList(const std::string& list) {
+  std::vector<std::string> tokens;
+  constexpr bool kRemoveEmpty = true;
+  common::tokenizeString(list, ',', kRemoveEmpty, &tokens);
+  std::vector<int> values;
+  for (const std::string& token : tokens) {
+    values.push_back(std::stoi(token));
+    CHECK_GT(values.back(), 0);
+  }
+  CHECK(!values.empty()) << "Empty benchmark parameter list.";
+  return values;
+}
+
+// Vertices uniformly distributed in a cube.
+void generateBenchmarkMap(const int num_vertices, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::VIMapGenerator generator(*map, kMapSeed);
+  std::mt19937 random_engine(kMapSeed);
+  std::uniform_real_distribution<double> distribution(0.0, kMapExtentMeters);
+  const vi_map::MissionId mission_id = generator.createMission();
+  for (int i = 0; i < num_vertices; ++i) {
+    pose::Transformation T_G_I;
+    T_G_I.getPosition() << distribution(random_engine),
+        distribution(random_engine), distribution(random_engine);
+    generator.createVertex(mission_id, T_G_I);
+  }
+  generator.generateMap();
+}
+
+Eigen::MatrixXd generateQueries() {
+  std::mt19937 random_engine(kMapSeed + 1);
+  std::uniform_real_distribution<double> distribution(0.0, kMapExtentMeters);
+  Eigen::MatrixXd queries(3, FLAGS_benchmark_num_queries);
+  for (int i = 0; i < queries.cols(); ++i) {
+    queries.col(i) << distribution(random_engine), distribution(random_engine),
+        distribution(random_engine);
+  }
+  return queries;
+}
+
+std::string makeName(
+    const std::string& benchmark, const int num_vertices,
+    const std::string& suffix) {
+  std::ostringstream name;
+  name << benchmark << "/vertices:" << num_vertices
+       << "/queries:" << FLAGS_benchmark_num_queries << suffix;
+  return name.str();
+}
+
+void benchmarkMap(
+    const int num_vertices, const std::vector<int>& num_neighbors_list,
+    std::vector<BenchmarkResult>* results) {
+  CHECK_NOTNULL(results);
+  vi_map::VIMap map;
+  generateBenchmarkMap(num_vertices, &map);
+  const VIMapNearestNeighborLookupVertexId lookup(map);
+  CHECK_EQ(lookup.size(), static_cast<size_t>(num_vertices));
+  const Eigen::MatrixXd queries = generateQueries();
+
+  BenchmarkResult per_query_result;
+  per_query_result.name = makeName("closest_per_query", num_vertices, "");
+  for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+       ++repetition) {
+    std::vector<pose_graph::VertexId> closest_vertex_ids(queries.cols());
+    const BenchmarkTimer timer;
+    for (int i = 0; i < queries.cols(); ++i) {
+      const aslam::Position3D p_G_query = queries.col(i);
+      lookup.getClosestDataItem(p_G_query, &closest_vertex_ids[i]);
+    }
+    timer.stop(&per_query_result);
+  }
+  results->push_back(per_query_result);
+
+  BenchmarkResult batched_result;
+  batched_result.name = makeName("closest_batched", num_vertices, "");
+  std::vector<pose_graph::VertexId> closest_vertex_ids;
+  std::vector<bool> has_closest_vertex;
+  for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+       ++repetition) {
+    const BenchmarkTimer timer;
+    lookup.getClosestDataItems(
+        queries, &closest_vertex_ids, &has_closest_vertex);
+    timer.stop(&batched_result);
+  }
+  results->push_back(batched_result);
+
+  for (const int num_neighbors : num_neighbors_list) {
+    BenchmarkResult knn_result;
+    knn_result.name = makeName(
+        "knn_batched", num_vertices,
+        "/neighbors:" + std::to_string(num_neighbors));
+    // The buffers are reused across the repetitions.
+    Eigen::MatrixXi indices;
+    Eigen::MatrixXd distances_squared;
+    for (int repetition = 0; repetition < FLAGS_benchmark_repetitions;
+         ++repetition) {
+      const BenchmarkTimer timer;
+      lookup.getKClosestDataItemIndices(
+          queries, num_neighbors, &indices, &distances_squared);
+      timer.stop(&knn_result);
+    }
+    results->push_back(knn_result);
+  }
+}
+
+double mean(const std::vector<double>& values) {
+  CHECK(!values.empty());
+  double sum = 0.0;
+  for (const double value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+void writeJson(
+    const std::vector<BenchmarkResult>& results, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  const std::time_t now = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%F %T", std::localtime(&now));
+
+  *out << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << date << "\",\n"
+       << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+       << "    \"repetitions\": " << FLAGS_benchmark_repetitions << "\n"
+       << "  },\n  \"benchmarks\": [";
+  for (size_t i = 0u; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    *out << (i == 0u ? "\n" : ",\n") << "    {\n"
+         << "      \"name\": \"" << result.name << "\",\n"
+         << "      \"iterations\": " << result.real_times_ms.size() << ",\n"
+         << "      \"real_time\": " << mean(result.real_times_ms) << ",\n"
+         << "      \"cpu_time\": " << mean(result.cpu_times_ms) << ",\n"
+         << "      \"real_time_min\": "
+         << *std::min_element(
+                result.real_times_ms.begin(), result.real_times_ms.end())
+         << ",\n"
+         << "      \"time_unit\": \"ms\"\n    }";
+  }
+  *out << "\n  ]\n}\n";
+}
+
+}  // namespace
+}  // namespace vi_map_helpers
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_benchmark_repetitions, 0);
+  CHECK_GT(FLAGS_benchmark_num_queries, 0);
+
+  const std::vector<int> map_sizes =
+      vi_map_helpers::parseList(FLAGS_benchmark_map_sizes);
+  const std::vector<int> num_neighbors_list =
+      vi_map_helpers::parseList(FLAGS_benchmark_num_neighbors);
+
+  std::vector<vi_map_helpers::BenchmarkResult> results;
+  for (const int num_vertices : map_sizes) {
+    LOG(INFO) << "Benchmarking maps with " << num_vertices << " vertices.";
+    vi_map_helpers::benchmarkMap(num_vertices, num_neighbors_list, &results);
+  }
+
+  if (FLAGS_benchmark_out.empty()) {
+    vi_map_helpers::writeJson(results, &std::cout);
+  } else {
+    std::ofstream out(FLAGS_benchmark_out);
+    CHECK(out.is_open()) << "Could not open " << FLAGS_benchmark_out << ".";
+    vi_map_helpers::writeJson(results, &out);
+  }
+  return 0;
+}
@@ -0,0 +1,329 @@
+#ifndef VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_INL_H_
+#define VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_INL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace vi_map_helpers {
+
+namespace internal {
+// 21 bits per axis fit into a 64 bit Morton code.
+constexpr int kMaxOctreeLevel = 21;
+
+inline Eigen::Vector3d getPositionFromCache(
+    const VIMapGlobalPositionCache& position_cache,
+    const pose_graph::VertexId& vertex_id) {
+  return position_cache.getVertex_T_G_I(vertex_id).getPosition();
+}
+
+inline Eigen::Vector3d getPositionFromCache(
+    const VIMapGlobalPositionCache& position_cache,
+    const vi_map::LandmarkId& landmark_id) {
+  return position_cache.getLandmark_G_p_fi(landmark_id);
+}
+
+// Inserts two zero bits in front of each of the lower 21 bits.
+inline uint64_t spreadBitsForMortonCode(uint64_t value) {
+  value &= 0x1fffffu;
+  value = (value | value << 32) & 0x1f00000000ffffu;
+  value = (value | value << 16) & 0x1f0000ff0000ffu;
+  value = (value | value << 8) & 0x100f00f00f00f00fu;
+  value = (value | value << 4) & 0x10c30c30c30c30c3u;
+  value = (value | value << 2) & 0x1249249249249249u;
+  return value;
+}
+}  // namespace internal
+
+template <typename ObjectIdType>
+constexpr size_t
+    AdaptiveSpatialDatabase<ObjectIdType>::kDefaultMaxObjectsPerLeaf;
+
+template <typename ObjectIdType>
+AdaptiveSpatialDatabase<ObjectIdType>::AdaptiveSpatialDatabase(
+    const vi_map::VIMap& map, const double min_leaf_size_meters,
+    const size_t max_objects_per_leaf)
+    : AdaptiveSpatialDatabase(
+          map, VIMapGlobalPositionCache(map), min_leaf_size_meters,
+          max_objects_per_leaf) {}
+
+template <typename ObjectIdType>
+AdaptiveSpatialDatabase<ObjectIdType>::AdaptiveSpatialDatabase(
+    const vi_map::VIMap& map, const VIMapGlobalPositionCache& position_cache,
+    const double min_leaf_size_meters, const size_t max_objects_per_leaf)
+    : max_objects_per_leaf_(max_objects_per_leaf),
+      max_level_(0),
+      p_G_root_min_(Eigen::Vector3d::Zero()),
+      root_size_(min_leaf_size_meters) {
+  CHECK_GT(min_leaf_size_meters, 0.0);
+  CHECK_GT(max_objects_per_leaf, 0u);
+  CHECK(position_cache.isUpToDate());
+
+  std::vector<ObjectIdType> object_ids;
+  map.getAllIds(&object_ids);
+  const size_t num_objects = object_ids.size();
+  CHECK_LT(num_objects, std::numeric_limits<uint32_t>::max());
+  if (num_objects == 0u) {
+    return;
+  }
+
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+
+  Eigen::Matrix3Xd p_G_objects(3, num_objects);
+  common::ParallelProcess(
+      num_objects,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          p_G_objects.col(idx) =
+              internal::getPositionFromCache(position_cache, object_ids[idx]);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  // The root is a cube, so all cells of a level have the same size. Cells are
+  // split down to the deepest level whose cells are still larger than the
+  // minimum leaf size.
+  p_G_root_min_ = p_G_objects.rowwise().minCoeff();
+  const Eigen::Vector3d p_G_max = p_G_objects.rowwise().maxCoeff();
+  root_size_ = std::max((p_G_max - p_G_root_min_).maxCoeff(), root_size_);
+  while (max_level_ < internal::kMaxOctreeLevel &&
+         std::ldexp(root_size_, -(max_level_ + 1)) >= min_leaf_size_meters) {
+    ++max_level_;
+  }
+
+  std::vector<std::pair<uint64_t, uint32_t>> codes_and_indices(num_objects);
+  common::ParallelProcess(
+      num_objects,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          codes_and_indices[idx] = std::make_pair(
+              getMortonCode(p_G_objects.col(idx)), static_cast<uint32_t>(idx));
+        }
+      },
+      kAlwaysParallelize, num_threads);
+  std::sort(codes_and_indices.begin(), codes_and_indices.end());
+
+  std::vector<uint64_t> sorted_morton_codes(num_objects);
+  object_ids_.resize(num_objects);
+  p_G_objects_.resize(Eigen::NoChange, num_objects);
+  common::ParallelProcess(
+      num_objects,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          const uint32_t object_idx = codes_and_indices[idx].second;
+          sorted_morton_codes[idx] = codes_and_indices[idx].first;
+          object_ids_[idx] = object_ids[object_idx];
+          p_G_objects_.col(idx) = p_G_objects.col(object_idx);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  buildTree(sorted_morton_codes);
+}
+
+template <typename ObjectIdType>
+uint64_t AdaptiveSpatialDatabase<ObjectIdType>::getMortonCode(
+    const Eigen::Vector3d& p_G) const {
+  const int64_t num_cells_per_axis = int64_t{1} << max_level_;
+  const Eigen::Vector3d cell_coordinates =
+      (p_G - p_G_root_min_) * (num_cells_per_axis / root_size_);
+  uint64_t code = 0u;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int64_t cell_index = std::min(
+        std::max(
+            static_cast<int64_t>(std::floor(cell_coordinates[axis])),
+            int64_t{0}),
+        num_cells_per_axis - 1);
+    code |= internal::spreadBitsForMortonCode(static_cast<uint64_t>(cell_index))
+            << axis;
+  }
+  return code;
+}
+
+template <typename ObjectIdType>
+void AdaptiveSpatialDatabase<ObjectIdType>::buildTree(
+    const std::vector<uint64_t>& sorted_morton_codes) {
+  CHECK_EQ(sorted_morton_codes.size(), object_ids_.size());
+  nodes_.clear();
+
+  Node root;
+  root.p_G_min = p_G_root_min_;
+  root.size = root_size_;
+  root.level = 0;
+  root.begin = 0u;
+  root.end = static_cast<uint32_t>(object_ids_.size());
+  root.first_child = -1;
+  root.num_children = 0;
+  nodes_.emplace_back(root);
+
+  for (size_t node_idx = 0u; node_idx < nodes_.size(); ++node_idx) {
+    // Copy, the vector grows below.
+    const Node node = nodes_[node_idx];
+    if (node.end - node.begin <= max_objects_per_leaf_ ||
+        node.level == max_level_) {
+      continue;
+    }
+
+    // The octant of a level is given by three bits of the Morton code, and
+    // the objects of an octant are contiguous since the codes are sorted.
+    const int shift = 3 * (max_level_ - node.level - 1);
+    const double child_size = node.size / 2.0;
+    nodes_[node_idx].first_child = static_cast<int>(nodes_.size());
+    uint32_t child_begin = node.begin;
+    while (child_begin < node.end) {
+      const uint64_t octant = (sorted_morton_codes[child_begin] >> shift) & 7u;
+      uint32_t child_end = child_begin + 1u;
+      while (child_end < node.end &&
+             ((sorted_morton_codes[child_end] >> shift) & 7u) == octant) {
+        ++child_end;
+      }
+
+      Node child;
+      child.p_G_min =
+          node.p_G_min +
+          child_size * Eigen::Vector3d(
+                           static_cast<double>(octant & 1u),
+                           static_cast<double>((octant >> 1) & 1u),
+                           static_cast<double>((octant >> 2) & 1u));
+      child.size = child_size;
+      child.level = node.level + 1;
+      child.begin = child_begin;
+      child.end = child_end;
+      child.first_child = -1;
+      child.num_children = 0;
+      nodes_.emplace_back(child);
+      ++nodes_[node_idx].num_children;
+
+      child_begin = child_end;
+    }
+  }
+  VLOG(3) << "Built spatial octree with " << nodes_.size() << " cells and "
+          << numLeaves() << " leaves for " << object_ids_.size()
+          << " objects.";
+}
+
+template <typename ObjectIdType>
+void AdaptiveSpatialDatabase<ObjectIdType>::collectObjectsInRadius(
+    const Eigen::Vector3d& p_G_center, const double radius_meters,
+    std::vector<int>* node_stack,
+    std::vector<ObjectIdType>* object_ids) const {
+  CHECK_NOTNULL(node_stack)->clear();
+  CHECK_NOTNULL(object_ids);
+  if (nodes_.empty()) {
+    return;
+  }
+  const double squared_radius = radius_meters * radius_meters;
+
+  node_stack->push_back(0);
+  while (!node_stack->empty()) {
+    const Node& node = nodes_[node_stack->back()];
+    node_stack->pop_back();
+
+    const Eigen::Vector3d p_G_max =
+        node.p_G_min + Eigen::Vector3d::Constant(node.size);
+    const Eigen::Vector3d p_G_closest =
+        p_G_center.cwiseMax(node.p_G_min).cwiseMin(p_G_max);
+    if ((p_G_closest - p_G_center).squaredNorm() > squared_radius) {
+      continue;
+    }
+
+    // Take the whole cell if even its farthest corner is within the radius.
+    const Eigen::Vector3d farthest_corner_offset =
+        (p_G_center - node.p_G_min)
+            .cwiseAbs()
+            .cwiseMax((p_G_center - p_G_max).cwiseAbs());
+    if (farthest_corner_offset.squaredNorm() <= squared_radius) {
+      object_ids->insert(
+          object_ids->end(), object_ids_.begin() + node.begin,
+          object_ids_.begin() + node.end);
+      continue;
+    }
+
+    if (node.first_child < 0) {
+      for (uint32_t idx = node.begin; idx < node.end; ++idx) {
+        if ((p_G_objects_.col(idx) - p_G_center).squaredNorm() <=
+            squared_radius) {
+          object_ids->push_back(object_ids_[idx]);
+        }
+      }
+      continue;
+    }
+    for (int child_idx = 0; child_idx < node.num_children; ++child_idx) {
+      node_stack->push_back(node.first_child + child_idx);
+    }
+  }
+}
+
+template <typename ObjectIdType>
+void AdaptiveSpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+    const Eigen::Vector3d& p_G_center, const double radius_meters,
+    std::vector<ObjectIdType>* object_ids) const {
+  CHECK_NOTNULL(object_ids)->clear();
+  CHECK_GT(radius_meters, 0.0);
+  std::vector<int> node_stack;
+  collectObjectsInRadius(p_G_center, radius_meters, &node_stack, object_ids);
+}
+
+template <typename ObjectIdType>
+void AdaptiveSpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+    const Eigen::Vector3d& p_G_center, const double radius_meters,
+    std::unordered_set<ObjectIdType>* object_ids) const {
+  CHECK_NOTNULL(object_ids)->clear();
+  std::vector<ObjectIdType> object_id_list;
+  getObjectIdsInRadius(p_G_center, radius_meters, &object_id_list);
+  object_ids->insert(object_id_list.begin(), object_id_list.end());
+}
+
+template <typename ObjectIdType>
+void AdaptiveSpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
+    const Eigen::Matrix3Xd& p_G_centers, const double radius_meters,
+    std::vector<std::vector<ObjectIdType>>* object_ids_per_center) const {
+  CHECK_NOTNULL(object_ids_per_center);
+  CHECK_GT(radius_meters, 0.0);
+  object_ids_per_center->resize(p_G_centers.cols());
+
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      p_G_centers.cols(),
+      [&](const std::vector<size_t>& range) {
+        std::vector<int> node_stack;
+        for (const size_t idx : range) {
+          std::vector<ObjectIdType>& object_ids =
+              (*object_ids_per_center)[idx];
+          object_ids.clear();
+          collectObjectsInRadius(
+              p_G_centers.col(idx), radius_meters, &node_stack, &object_ids);
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+}
+
+template <typename ObjectIdType>
+size_t AdaptiveSpatialDatabase<ObjectIdType>::numLeaves() const {
+  return std::count_if(
+      nodes_.begin(), nodes_.end(),
+      [](const Node& node) { return node.first_child < 0; });
+}
+
+template <typename ObjectIdType>
+double AdaptiveSpatialDatabase<ObjectIdType>::getSmallestLeafSize() const {
+  CHECK(!nodes_.empty());
+  double smallest_leaf_size = std::numeric_limits<double>::max();
+  for (const Node& node : nodes_) {
+    if (node.first_child < 0) {
+      smallest_leaf_size = std::min(smallest_leaf_size, node.size);
+    }
+  }
+  return smallest_leaf_size;
+}
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_INL_H_
@@ -0,0 +1,109 @@
+#ifndef VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_H_
+#define VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_H_
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include <Eigen/Core>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-global-position-cache.h"
+
+namespace vi_map_helpers {
+
+// Sparse octree over the vertices or landmarks of a map. Unlike the uniform
+// grid of SpatialDatabase, a cell is only split into its (non-empty) octants
+// if it holds more than max_objects_per_leaf objects and is larger than
+// min_leaf_size_meters, so dense areas get small cells while long, sparse
+// traverses don't allocate any empty cells. Radius queries descend only into
+// the cells that intersect the sphere and take the cells that lie inside the
+// sphere as a whole.
+//
+// The objects are sorted along their Morton code, hence every cell is a
+// contiguous range of the object ids and positions. The database is
+// immutable after construction and queries don't lock, so it can be queried
+// from any number of threads. It doesn't observe the map, i.e. it needs to be
+// rebuilt after objects were added, removed or moved.
+template <typename ObjectIdType>
+class AdaptiveSpatialDatabase {
+ public:
+  static constexpr size_t kDefaultMaxObjectsPerLeaf = 32u;
+
+  // Computes the positions and the cell codes in parallel. The cache needs to
+  // be up to date.
+  AdaptiveSpatialDatabase(
+      const vi_map::VIMap& map, const VIMapGlobalPositionCache& position_cache,
+      const double min_leaf_size_meters,
+      const size_t max_objects_per_leaf = kDefaultMaxObjectsPerLeaf);
+  AdaptiveSpatialDatabase(
+      const vi_map::VIMap& map, const double min_leaf_size_meters,
+      const size_t max_objects_per_leaf = kDefaultMaxObjectsPerLeaf);
+
+  void getObjectIdsInRadius(
+      const Eigen::Vector3d& p_G_center, const double radius_meters,
+      std::vector<ObjectIdType>* object_ids) const;
+  void getObjectIdsInRadius(
+      const Eigen::Vector3d& p_G_center, const double radius_meters,
+      std::unordered_set<ObjectIdType>* object_ids) const;
+
+  // Runs the queries of all centers in parallel. The output vectors are
+  // cleared and reused, so their memory is kept across calls.
+  void getObjectIdsInRadius(
+      const Eigen::Matrix3Xd& p_G_centers, const double radius_meters,
+      std::vector<std::vector<ObjectIdType>>* object_ids_per_center) const;
+
+  inline size_t size() const {
+    return object_ids_.size();
+  }
+  inline bool empty() const {
+    return object_ids_.empty();
+  }
+  inline size_t numCells() const {
+    return nodes_.size();
+  }
+  size_t numLeaves() const;
+  // Edge length of the smallest leaf, at least min_leaf_size_meters.
+  double getSmallestLeafSize() const;
+
+ private:
+  struct Node {
+    Eigen::Vector3d p_G_min;
+    double size;
+    int level;
+    // The objects [begin, end) lie inside this cell.
+    uint32_t begin;
+    uint32_t end;
+    // Children are stored contiguously, -1 for leaves.
+    int first_child;
+    int num_children;
+  };
+
+  uint64_t getMortonCode(const Eigen::Vector3d& p_G) const;
+  // Splits the cells breadth-first, so the children of a cell are contiguous.
+  void buildTree(const std::vector<uint64_t>& sorted_morton_codes);
+
+  // Appends the ids of all objects within the radius.
+  void collectObjectsInRadius(
+      const Eigen::Vector3d& p_G_center, const double radius_meters,
+      std::vector<int>* node_stack, std::vector<ObjectIdType>* object_ids)
+      const;
+
+  // Sorted by Morton code.
+  std::vector<ObjectIdType> object_ids_;
+  Eigen::Matrix3Xd p_G_objects_;
+
+  std::vector<Node> nodes_;
+  size_t max_objects_per_leaf_;
+  int max_level_;
+  Eigen::Vector3d p_G_root_min_;
+  double root_size_;
+};
+
+}  // namespace vi_map_helpers
+
+#include "vi-map-helpers/adaptive-spatial-database-inl.h"
+
+#endif  // VI_MAP_HELPERS_ADAPTIVE_SPATIAL_DATABASE_H_
@@ -0,0 +1,92 @@
+#ifndef VI_MAP_HELPERS_BENCHMARK_MAP_GENERATOR_H_
+#define VI_MAP_HELPERS_BENCHMARK_MAP_GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/ncamera.h>
+#include <maplab-common/pose_types.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+namespace vi_map_helpers {
+
+struct BenchmarkMapOptions {
+  // The defaults are overridden by the --benchmark_map_* flags.
+  static BenchmarkMapOptions fromGflags();
+
+  size_t num_missions = 1u;
+  size_t num_vertices_per_mission = 1000u;
+  // Number of keypoints with a landmark per frame.
+  size_t num_landmarks_per_frame = 100u;
+  // Number of consecutive vertices of a mission observing each landmark.
+  size_t num_observations_per_landmark = 5u;
+  // Fraction of the landmarks of every frame of the second and later missions
+  // that are landmarks of the first mission at the same place.
+  double cross_mission_overlap = 0.2;
+  // Viwls edges with simulated IMU measurements, odometry edges otherwise.
+  bool use_imu_edges = true;
+  int seed = 42;
+};
+
+// Generates large synthetic maps for benchmarking, e.g. 100 missions of 1000
+// vertices with 500 landmarks per frame for 10M landmarks. All missions
+// drive along parallel straight lines at constant velocity through the same
+// area, the landmarks are noise-free and observed by consecutive vertices.
+// The geometry, the descriptors and the observations only depend on the seed,
+// every vertex is generated independently and in parallel.
+class BenchmarkMapGenerator {
+ public:
+  explicit BenchmarkMapGenerator(const BenchmarkMapOptions& options);
+
+  // The map has to be empty.
+  void generateMap(vi_map::VIMap* map) const;
+
+  // Generates the map and saves it to the folder.
+  bool generateMapToFolder(
+      const std::string& map_folder, const bool overwrite) const;
+
+  size_t numLandmarks() const;
+
+ private:
+  // Layout of the keypoints of every frame of a mission: first the landmarks
+  // of the track, i.e. landmark k created at the vertex t steps before is
+  // keypoint t * num_new_landmarks_per_vertex + k, then the overlapping
+  // landmarks of the first mission.
+  struct MissionLayout {
+    size_t num_new_landmarks_per_vertex;
+    size_t num_overlapping_landmarks;
+    size_t num_keypoints;
+  };
+
+  uint64_t hash(
+      const size_t mission_idx, const size_t vertex_idx,
+      const size_t landmark_idx) const;
+  pose::Transformation get_T_M_I(
+      const size_t mission_idx, const size_t vertex_idx) const;
+  int64_t getTimestampNanoseconds(
+      const size_t mission_idx, const size_t vertex_idx) const;
+  Eigen::Vector3d get_p_M_fi(
+      const size_t mission_idx, const size_t vertex_idx,
+      const size_t landmark_idx) const;
+
+  vi_map::Vertex::UniquePtr generateVertex(
+      const size_t mission_idx, const size_t vertex_idx,
+      const std::vector<vi_map::MissionId>& mission_ids,
+      const std::vector<pose_graph::VertexIdList>& vertex_ids,
+      const std::vector<vi_map::LandmarkIdList>& landmark_ids) const;
+  vi_map::Edge::UniquePtr generateEdge(
+      const size_t mission_idx, const size_t vertex_idx,
+      const std::vector<pose_graph::VertexIdList>& vertex_ids) const;
+
+  const BenchmarkMapOptions options_;
+  std::vector<MissionLayout> mission_layouts_;
+  aslam::NCamera::Ptr n_camera_;
+};
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_BENCHMARK_MAP_GENERATOR_H_
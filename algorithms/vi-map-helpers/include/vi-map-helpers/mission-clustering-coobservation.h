@@ -1,14 +1,18 @@
 #ifndef VI_MAP_HELPERS_MISSION_CLUSTERING_COOBSERVATION_H_
 #define VI_MAP_HELPERS_MISSION_CLUSTERING_COOBSERVATION_H_
 
+#include <cstdint>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
 
+// Determines which of the given missions observe common landmarks. The
+// landmarks are visited once, in parallel, and the missions observing each of
+// them are combined into a mission-by-mission bit matrix; observations of
+// missions that are not given are ignored.
 class MissionCoobservationCachedQuery {
  public:
   MissionCoobservationCachedQuery(
@@ -18,10 +22,21 @@ class MissionCoobservationCachedQuery {
       const vi_map::MissionId& mission_id,
       const vi_map::MissionIdSet& other_mission_ids) const;
 
+  // Groups the missions into the connected components of the coobservation
+  // graph.
+  void getClusters(std::vector<vi_map::MissionIdSet>* clusters) const;
+
  private:
-  typedef std::unordered_map<vi_map::MissionId, vi_map::LandmarkIdSet>
-      MissionLandmarksMap;
-  MissionLandmarksMap mission_landmark_map_;
+  const uint64_t* getRow(const size_t mission_index) const {
+    return coobservation_matrix_.data() + mission_index * num_words_per_row_;
+  }
+
+  vi_map::MissionIdList missions_;
+  std::unordered_map<vi_map::MissionId, size_t> mission_indices_;
+  // Row i has bit j set if the missions i and j observe a common landmark.
+  // The diagonal is set for missions that observe any landmark.
+  size_t num_words_per_row_;
+  std::vector<uint64_t> coobservation_matrix_;
 };
 
 std::vector<vi_map::MissionIdSet> clusterMissionByLandmarkCoobservations(
@@ -125,8 +125,8 @@ void SpatialDatabase<ObjectIdType>::getObjectIdsInRadius(
   // Calculate number of grid units in x, y, and z directions
   // that are maximally needed to cover the sphere of given radius in space.
   Eigen::Vector3d radius_in_grid_units, unit_vector(1, 1, 1);
-  radius_in_grid_units = radius * unit_vector;
-  radius_in_grid_units.cwiseQuotient(grid_cell_size_);
+  radius_in_grid_units =
+      (radius * unit_vector).cwiseQuotient(grid_cell_size_);
   // Add 1 in order to get ceiling after casting int.
   radius_in_grid_units += unit_vector;
   Eigen::Vector3i num_of_grid_units_in_radius =
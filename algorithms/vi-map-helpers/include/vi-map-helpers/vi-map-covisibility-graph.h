@@ -0,0 +1,83 @@
+#ifndef VI_MAP_HELPERS_VI_MAP_COVISIBILITY_GRAPH_H_
+#define VI_MAP_HELPERS_VI_MAP_COVISIBILITY_GRAPH_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+namespace vi_map_helpers {
+
+// Weighted covisibility graph of the vertices of a map: two vertices are
+// adjacent if they observe common landmarks, the weight is the number of
+// distinct common landmarks. The graph is built once for all vertices, in
+// parallel, and stored as a CSR adjacency indexed by the dense vertex indices
+// of the map, so covisibility queries don't need to intersect landmark sets.
+//
+// Landmark removals and merges are applied incrementally, call
+// removeLandmark() or mergeLandmarks() before changing the map. Any other
+// change of the observations, and added vertices, require a rebuild().
+class VIMapCovisibilityGraph {
+ public:
+  explicit VIMapCovisibilityGraph(const vi_map::VIMap& map);
+
+  void rebuild();
+
+  // False for vertices added after the last rebuild.
+  bool hasVertex(const pose_graph::VertexId& vertex_id) const;
+
+  // The number of landmarks observed by both vertices. Not defined for
+  // vertex_id_1 == vertex_id_2.
+  int getNumberOfCommonLandmarks(
+      const pose_graph::VertexId& vertex_id_1,
+      const pose_graph::VertexId& vertex_id_2) const;
+
+  // Calls the action for every other vertex observing landmarks in common
+  // with the vertex, in no particular order.
+  void forEachCovisibleVertex(
+      const pose_graph::VertexId& vertex_id,
+      const std::function<void(
+          const pose_graph::VertexId& covisible_vertex_id,
+          int num_common_landmarks)>& action) const;
+
+  // Removes the landmark from the covisibility of its observers. Call before
+  // removing the landmark from the map.
+  void removeLandmark(const vi_map::LandmarkId& landmark_id);
+  // Call before VIMap::mergeLandmarks with the same arguments.
+  void mergeLandmarks(
+      const vi_map::LandmarkId& landmark_id_to_merge,
+      const vi_map::LandmarkId& landmark_id_into);
+
+  size_t numEdges() const;
+
+ private:
+  // Sorted and unique dense indices of the vertices observing the landmark.
+  void getObserverVertexIndices(
+      const vi_map::LandmarkId& landmark_id,
+      std::vector<size_t>* vertex_indices) const;
+  void addToCommonLandmarks(
+      size_t vertex_index_1, size_t vertex_index_2, int delta);
+  void addToCommonLandmarksDirected(
+      size_t vertex_index_from, size_t vertex_index_to, int delta);
+  size_t getCheckedVertexIndex(const pose_graph::VertexId& vertex_id) const;
+
+  const vi_map::VIMap& map_;
+
+  // The neighbors of vertex i are neighbor_vertex_indices_[row_begin_[i]] to
+  // neighbor_vertex_indices_[row_begin_[i + 1] - 1], sorted by index.
+  std::vector<size_t> row_begin_;
+  std::vector<size_t> neighbor_vertex_indices_;
+  std::vector<int> num_common_landmarks_;
+
+  // Adjacencies that appeared through landmark merges since the last
+  // rebuild, per dense vertex index.
+  std::unordered_map<size_t, std::unordered_map<size_t, int>>
+      added_neighbors_;
+};
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_VI_MAP_COVISIBILITY_GRAPH_H_
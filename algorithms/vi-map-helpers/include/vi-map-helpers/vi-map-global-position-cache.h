@@ -0,0 +1,72 @@
+#ifndef VI_MAP_HELPERS_VI_MAP_GLOBAL_POSITION_CACHE_H_
+#define VI_MAP_HELPERS_VI_MAP_GLOBAL_POSITION_CACHE_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <maplab-common/pose_types.h>
+#include <posegraph/unique-id.h>
+#include <vi-map/unique-id.h>
+#include <vi-map/vi-map.h>
+
+namespace vi_map_helpers {
+
+// Global landmark positions and vertex poses of a map, stored in flat arrays
+// indexed by the dense vertex and landmark indices of the map, for bulk
+// geometric queries that would otherwise walk landmark -> storing vertex ->
+// mission baseframe for every single landmark.
+//
+// The vertex poses and baseframes can be modified through raw pointers, which
+// the cache can't observe. Hence, entries are invalidated explicitly and
+// recomputed by update(), which only recomputes the invalidated vertices and
+// the landmarks they store. Adding or removing vertices or landmarks
+// invalidates the whole cache if the number of dense indices changes,
+// otherwise the storing vertices have to be invalidated as well.
+class VIMapGlobalPositionCache {
+ public:
+  typedef Aligned<std::vector, pose::Transformation> TransformationVector;
+
+  explicit VIMapGlobalPositionCache(const vi_map::VIMap& map);
+
+  void invalidateVertex(const pose_graph::VertexId& vertex_id);
+  // E.g. after the baseframe of the mission has changed.
+  void invalidateMission(const vi_map::MissionId& mission_id);
+  void invalidateAll();
+
+  // Recomputes the invalidated entries in parallel and returns the number of
+  // recomputed vertices.
+  size_t update();
+
+  bool isUpToDate() const;
+
+  // Column i holds the global position of the landmark with dense index i.
+  // Columns of unused indices are undefined.
+  const Eigen::Matrix3Xd& getLandmarkPositions_G() const;
+  // Element i holds T_G_I of the vertex with dense index i.
+  const TransformationVector& getVertexTransformations_T_G_I() const;
+
+  Eigen::Vector3d getLandmark_G_p_fi(const vi_map::LandmarkId& id) const;
+  const pose::Transformation& getVertex_T_G_I(
+      const pose_graph::VertexId& id) const;
+
+ private:
+  void resize();
+  // Recomputes the given vertices and the landmarks they store. The vertex
+  // poses are composed with the baseframes in one batch.
+  void updateVertices(const std::vector<size_t>& vertex_indices);
+
+  const vi_map::VIMap& map_;
+
+  Eigen::Matrix3Xd landmark_G_p_fi_;
+  TransformationVector vertex_T_G_I_;
+
+  // Dense vertex indices that have to be recomputed.
+  std::vector<size_t> invalidated_vertex_indices_;
+  std::vector<bool> is_vertex_invalidated_;
+  bool is_invalidated_completely_;
+};
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_VI_MAP_GLOBAL_POSITION_CACHE_H_
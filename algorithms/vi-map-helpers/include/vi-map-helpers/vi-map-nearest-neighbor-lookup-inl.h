@@ -1,11 +1,15 @@
 #ifndef VI_MAP_HELPERS_VI_MAP_NEAREST_NEIGHBOR_LOOKUP_INL_H_
 #define VI_MAP_HELPERS_VI_MAP_NEAREST_NEIGHBOR_LOOKUP_INL_H_
 
+#include <algorithm>
 #include <functional>
 #include <limits>
 #include <unordered_set>
+#include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 namespace vi_map_helpers {
 
@@ -106,6 +110,114 @@ VIMapNearestNeighborLookup<QueryType, DataType>::getAllDataItemsWithinRadius(
   }
 }
 
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::
+    getKClosestDataItemIndices(
+        const Eigen::MatrixXd& queries, const int num_neighbors,
+        Eigen::MatrixXi* indices, Eigen::MatrixXd* distances_squared) const {
+  getKClosestDataItemIndices(
+      queries, num_neighbors, std::numeric_limits<double>::infinity(), indices,
+      distances_squared);
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::
+    getKClosestDataItemIndices(
+        const Eigen::MatrixXd& queries, const int num_neighbors,
+        const double max_search_radius, Eigen::MatrixXi* indices,
+        Eigen::MatrixXd* distances_squared) const {
+  CHECK_NOTNULL(indices);
+  CHECK_NOTNULL(distances_squared);
+  CHECK_GT(num_neighbors, 0);
+  CHECK_GT(max_search_radius, 0.0);
+  const int num_queries = queries.cols();
+  // Eigen only reallocates if the number of coefficients changes.
+  indices->resize(num_neighbors, num_queries);
+  indices->setConstant(-1);
+  distances_squared->resize(num_neighbors, num_queries);
+  distances_squared->setConstant(std::numeric_limits<double>::infinity());
+  if (empty() || num_queries == 0) {
+    return;
+  }
+  CHECK(nn_index_);
+  CHECK_EQ(queries.rows(), nn_index_data_.rows());
+
+  // libnabo requires k to not exceed the number of data points.
+  const int num_searched_neighbors =
+      std::min(num_neighbors, static_cast<int>(size()));
+  constexpr double kSearchNNEpsilon = 0.0;
+  const int kOptionFlags = Nabo::NNSearchD::ALLOW_SELF_MATCH;
+
+  // The blocks of the parallel process are contiguous, so every block can be
+  // searched with a single call.
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_queries,
+      [&](const std::vector<size_t>& range) {
+        const int first_query = static_cast<int>(range.front());
+        const int num_block_queries = static_cast<int>(range.size());
+        CHECK_EQ(
+            static_cast<int>(range.back()),
+            first_query + num_block_queries - 1);
+        const Nabo::NNSearchD::Matrix block_queries =
+            queries.middleCols(first_query, num_block_queries);
+        Nabo::NNSearchD::IndexMatrix block_indices(
+            num_searched_neighbors, num_block_queries);
+        Nabo::NNSearchD::Matrix block_distances_squared(
+            num_searched_neighbors, num_block_queries);
+        nn_index_->knn(
+            block_queries, block_indices, block_distances_squared,
+            num_searched_neighbors, kSearchNNEpsilon, kOptionFlags,
+            max_search_radius);
+
+        for (int col = 0; col < num_block_queries; ++col) {
+          for (int row = 0; row < num_searched_neighbors; ++row) {
+            const double distance_squared = block_distances_squared(row, col);
+            if (distance_squared == std::numeric_limits<double>::infinity()) {
+              break;
+            }
+            CHECK_GE(block_indices(row, col), 0);
+            CHECK_LT(block_indices(row, col), static_cast<int>(size()));
+            (*indices)(row, first_query + col) = block_indices(row, col);
+            (*distances_squared)(row, first_query + col) = distance_squared;
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+}
+
+template <typename QueryType, typename DataType>
+void VIMapNearestNeighborLookup<QueryType, DataType>::getClosestDataItems(
+    const Eigen::MatrixXd& queries, std::vector<DataType>* closest_data_items,
+    std::vector<bool>* has_closest_data_item) const {
+  CHECK_NOTNULL(closest_data_items);
+  CHECK_NOTNULL(has_closest_data_item);
+  constexpr int kNumNeighbors = 1;
+  Eigen::MatrixXi indices;
+  Eigen::MatrixXd distances_squared;
+  getKClosestDataItemIndices(
+      queries, kNumNeighbors, &indices, &distances_squared);
+
+  const size_t num_queries = queries.cols();
+  closest_data_items->resize(num_queries);
+  has_closest_data_item->assign(num_queries, false);
+  for (size_t query_idx = 0u; query_idx < num_queries; ++query_idx) {
+    const int nn_index = indices(0, query_idx);
+    if (nn_index >= 0) {
+      (*closest_data_items)[query_idx] = data_items_[nn_index];
+      (*has_closest_data_item)[query_idx] = true;
+    }
+  }
+}
+
+template <typename QueryType, typename DataType>
+const DataType& VIMapNearestNeighborLookup<QueryType, DataType>::getDataItem(
+    const int index) const {
+  CHECK_GE(index, 0);
+  CHECK_LT(static_cast<size_t>(index), data_items_.size());
+  return data_items_[index];
+}
+
 template <>
 inline size_t getQueryTypeDimension<vi_map::GpsUtmMeasurement>() {
   return 3u;
@@ -116,6 +228,11 @@ inline size_t getQueryTypeDimension<vi_map::GpsWgsMeasurement>() {
   return 2u;
 }
 
+template <>
+inline size_t getQueryTypeDimension<aslam::Position3D>() {
+  return 3u;
+}
+
 template <>
 inline Eigen::VectorXd queryTypeToVector(
     const vi_map::GpsWgsMeasurement& wgs_measurement) {
@@ -263,6 +380,18 @@ void VIMapNearestNeighborLookup<GpsQueryType, GpsDataType>::buildIndex() {
   }
 }
 
+template <class QueryContainer>
+Eigen::MatrixXd queryTypesToMatrix(const QueryContainer& queries) {
+  typedef typename QueryContainer::value_type QueryType;
+  Eigen::MatrixXd query_matrix(
+      getQueryTypeDimension<QueryType>(), queries.size());
+  int col_idx = 0;
+  for (const QueryType& query : queries) {
+    query_matrix.col(col_idx++) = queryTypeToVector(query);
+  }
+  return query_matrix;
+}
+
 }  // namespace vi_map_helpers
 
 #endif  // VI_MAP_HELPERS_VI_MAP_NEAREST_NEIGHBOR_LOOKUP_INL_H_
@@ -92,6 +92,28 @@ class VIMapNearestNeighborLookup {
       std::unordered_set<DataType, std::hash<DataType>, std::equal_to<DataType>,
                          Allocator>* data_items_within_search_radius) const;
 
+  // Batched k-nearest-neighbor search, one query per column. The queries are
+  // split into blocks that are searched in parallel. Column i of the outputs
+  // holds the indices of the data items closest to query i and their squared
+  // distances, sorted by distance. Missing neighbors, e.g. outside of the
+  // search radius, have index -1 and infinite distance. The output matrices
+  // are only reallocated if their size changes, so they can be reused.
+  void getKClosestDataItemIndices(
+      const Eigen::MatrixXd& queries, const int num_neighbors,
+      const double max_search_radius, Eigen::MatrixXi* indices,
+      Eigen::MatrixXd* distances_squared) const;
+  void getKClosestDataItemIndices(
+      const Eigen::MatrixXd& queries, const int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXd* distances_squared) const;
+
+  // Batched version of getClosestDataItem. Entry i of has_closest_data_item
+  // is false if no data item was found for query i.
+  void getClosestDataItems(
+      const Eigen::MatrixXd& queries, std::vector<DataType>* closest_data_items,
+      std::vector<bool>* has_closest_data_item) const;
+
+  inline const DataType& getDataItem(const int index) const;
+
   inline size_t size() const;
   inline bool empty() const;
 
@@ -125,6 +147,10 @@ inline Eigen::VectorXd queryTypeToVector(const QueryType& query);
 template <class QueryType>
 inline size_t getQueryTypeDimension();
 
+// Stacks the queries as columns for the batched queries.
+template <class QueryContainer>
+Eigen::MatrixXd queryTypesToMatrix(const QueryContainer& queries);
+
 template <class GpsMeasurement, class GpsDataType>
 GpsDataType createDataItem(
     const GpsMeasurement& gps_measuremnt, const vi_map::MissionId& mission_id);
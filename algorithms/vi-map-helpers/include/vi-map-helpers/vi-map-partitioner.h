@@ -5,7 +5,7 @@
 #include <unordered_map>
 #include <vector>
 
-#include <Eigen/Sparse>
+#include <maplab-common/csr-graph.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
@@ -30,7 +30,7 @@ class VIMapPartitioner {
     size_t score;
   };
   typedef std::vector<GraphEdge> GraphEdgeVector;
-  typedef Eigen::Triplet<int32_t> EdgeTriplet;
+  typedef common::CsrGraph<int32_t> Graph;
 
   // This method finds coobserver edges between posegraph vertices. The edges
   // are weighted according to the number of landmarks coobserved by the two
@@ -53,9 +53,9 @@ class VIMapPartitioner {
       const vi_map::VIMap& map,
       std::unordered_map<pose_graph::VertexId, size_t>* vertex_indices) const;
 
-  void partitionGraphFromTriplets(
-      const std::vector<EdgeTriplet>& edge_triplets,
-      const size_t num_graph_vertices, const size_t num_partitions,
+  // The graph has to store every edge in both directions.
+  void partitionGraph(
+      const Graph& graph, const size_t num_partitions,
       bool require_contiguous_partitions,
       std::vector<int32_t>* partition_indices) const;
 
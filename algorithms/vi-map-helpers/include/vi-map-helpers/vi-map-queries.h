@@ -22,6 +22,7 @@ typedef std::unordered_map<vi_map::MissionId, pose_graph::VertexIdList>
 }  // namespace vi_map
 
 namespace vi_map_helpers {
+class VIMapCovisibilityGraph;
 
 // Finds a vertex with the largest number of overlapping (i.e. commonly
 // observed) landmarks. Useful for creation of loop closure edges.
@@ -35,6 +36,13 @@ pose_graph::VertexId getVertexIdWithMostOverlappingLandmarks(
 class VIMapQueries {
  public:
   explicit VIMapQueries(const vi_map::VIMap& map);
+  // The vertex covisibility queries read from the graph instead of
+  // intersecting the landmarks of the vertices, the graph needs to be up to
+  // date with the map. The graph counts every common landmark once, even if
+  // a vertex observes it in several frames.
+  VIMapQueries(
+      const vi_map::VIMap& map,
+      const VIMapCovisibilityGraph& covisibility_graph);
 
   // ==================
   // GLOBAL MAP QUERIES
@@ -199,6 +207,7 @@ class VIMapQueries {
   };
 
   const vi_map::VIMap& map_;
+  const VIMapCovisibilityGraph* const covisibility_graph_;
 };
 
 }  // namespace vi_map_helpers
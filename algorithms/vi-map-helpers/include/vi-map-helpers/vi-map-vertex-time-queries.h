@@ -1,14 +1,18 @@
 #ifndef VI_MAP_HELPERS_VI_MAP_VERTEX_TIME_QUERIES_H_
 #define VI_MAP_HELPERS_VI_MAP_VERTEX_TIME_QUERIES_H_
 
+#include <limits>
 #include <unordered_map>
+#include <vector>
 
-#include <maplab-common/temporal-buffer.h>
 #include <posegraph/unique-id.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
 
+// Index of the vertices sorted by their minimal frame timestamp. All queries
+// are binary searches over a contiguous timestamp array. The index is not
+// updated when vertices are added or removed.
 class VIMapVertexTimeQueries {
  public:
   VIMapVertexTimeQueries() = delete;
@@ -19,14 +23,44 @@ class VIMapVertexTimeQueries {
 
   bool getClosestVertexInTime(const int64_t timestamp_nanoseconds,
                               pose_graph::VertexId* vertex_id) const;
+  // Returns false if the closest vertex is further than max_delta_nanoseconds
+  // away.
+  bool getClosestVertexInTime(
+      const int64_t timestamp_nanoseconds, const int64_t max_delta_nanoseconds,
+      pose_graph::VertexId* vertex_id) const;
+
+  // All vertices with a timestamp in [begin, end], sorted by timestamp.
+  void getVerticesInTimeRange(
+      const int64_t begin_timestamp_nanoseconds,
+      const int64_t end_timestamp_nanoseconds,
+      pose_graph::VertexIdList* vertex_ids) const;
+
+  // Closest vertex for every query timestamp, the query timestamps have to be
+  // sorted. Each search starts at the result of the previous query. Vertices
+  // further than max_delta_nanoseconds away are returned as invalid ids.
+  // Returns the number of valid vertex ids.
+  size_t getClosestVerticesInTime(
+      const std::vector<int64_t>& sorted_timestamps_nanoseconds,
+      pose_graph::VertexIdList* vertex_ids,
+      const int64_t max_delta_nanoseconds =
+          std::numeric_limits<int64_t>::max()) const;
+
+  size_t size() const {
+    return timestamps_nanoseconds_.size();
+  }
 
  private:
   void buildVertexIdTimestampIndex(const pose_graph::VertexIdList& vertex_ids);
 
+  // Index of the closest timestamp, searching from begin_index on.
+  size_t getClosestIndex(
+      const int64_t timestamp_nanoseconds, const size_t begin_index) const;
+
   vi_map::VIMap::Ptr map_;
 
-  typedef common::TemporalBuffer<pose_graph::VertexId> VertexIdTimestampIndex;
-  VertexIdTimestampIndex vertex_timestamp_index_;
+  // Both sorted by timestamp.
+  std::vector<int64_t> timestamps_nanoseconds_;
+  pose_graph::VertexIdList vertex_ids_;
 };
 
 class VIMapMissionsVertexTimeQueries {
@@ -39,6 +73,9 @@ class VIMapMissionsVertexTimeQueries {
                                         const vi_map::MissionId& mission_id,
                                         pose_graph::VertexId* vertex_id) const;
 
+  const VIMapVertexTimeQueries& getIndexForMission(
+      const vi_map::MissionId& mission_id) const;
+
   std::unordered_map<vi_map::MissionId, VIMapVertexTimeQueries>
       mission_to_vertex_timestamp_index_map_;
 };
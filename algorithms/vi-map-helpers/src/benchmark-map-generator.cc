@@ -0,0 +1,488 @@
+#include "vi-map-helpers/benchmark-map-generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/map-manager-config.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+#include <sensors/imu.h>
+#include <vi-map/landmark.h>
+#include <vi-map/sensor-manager.h>
+#include <vi-map/transformation-edge.h>
+#include <vi-map/vertex.h>
+#include <vi-map/viwls-edge.h>
+
+DEFINE_uint64(
+    benchmark_map_num_missions, 1u,
+    "Number of missions of the generated benchmark map.");
+DEFINE_uint64(
+    benchmark_map_num_vertices_per_mission, 1000u,
+    "Number of vertices per mission of the generated benchmark map.");
+DEFINE_uint64(
+    benchmark_map_num_landmarks_per_frame, 100u,
+    "Number of keypoints with a landmark per frame of the generated "
+    "benchmark map.");
+DEFINE_uint64(
+    benchmark_map_num_observations_per_landmark, 5u,
+    "Number of consecutive vertices observing each landmark of the generated "
+    "benchmark map.");
+DEFINE_double(
+    benchmark_map_cross_mission_overlap, 0.2,
+    "Fraction of the landmarks per frame of all but the first mission that "
+    "are landmarks of the first mission.");
+DEFINE_bool(
+    benchmark_map_use_imu_edges, true,
+    "Connect the vertices with IMU edges with simulated measurements instead "
+    "of odometry edges.");
+DEFINE_int32(
+    benchmark_map_seed, 42, "Seed of the generated benchmark map.");
+
+namespace vi_map_helpers {
+
+namespace {
+
+constexpr double kVertexSpacingMeters = 0.5;
+constexpr int64_t kVertexPeriodNanoseconds = 100000000;
+// Missions drive next to each other, with some time in between.
+constexpr double kMissionLateralOffsetMeters = 0.1;
+constexpr int64_t kMissionPauseNanoseconds = 60000000000;
+constexpr size_t kNumImuMeasurementsPerEdge = 20u;
+constexpr double kGravityAcceleration = 9.81;
+
+constexpr uint32_t kCameraWidth = 640u;
+constexpr uint32_t kCameraHeight = 480u;
+constexpr double kCameraFocalLength = 400.0;
+constexpr double kMinLandmarkDepthMeters = 5.0;
+constexpr double kMaxLandmarkDepthMeters = 30.0;
+constexpr double kKeypointUncertaintyPixels = 0.8;
+constexpr int kDescriptorSizeBytes = 48;
+
+// SplitMix64, cheap enough to derive all random values of a landmark from its
+// indices wherever it is needed.
+inline uint64_t splitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+inline double uniform(
+    const double min_value, const double max_value, uint64_t* state) {
+  const double unit = (splitMix64(state) >> 11) * (1.0 / (1ull << 53));
+  return min_value + unit * (max_value - min_value);
+}
+
+// Camera looking along the x axis of the mission frame.
+Eigen::Matrix3d get_R_M_I() {
+  Eigen::Matrix3d R_M_I;
+  R_M_I << 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, 0.0, -1.0, 0.0;
+  return R_M_I;
+}
+
+}  // namespace
+
+BenchmarkMapOptions BenchmarkMapOptions::fromGflags() {
+  BenchmarkMapOptions options;
+  options.num_missions = FLAGS_benchmark_map_num_missions;
+  options.num_vertices_per_mission =
+      FLAGS_benchmark_map_num_vertices_per_mission;
+  options.num_landmarks_per_frame = FLAGS_benchmark_map_num_landmarks_per_frame;
+  options.num_observations_per_landmark =
+      FLAGS_benchmark_map_num_observations_per_landmark;
+  options.cross_mission_overlap = FLAGS_benchmark_map_cross_mission_overlap;
+  options.use_imu_edges = FLAGS_benchmark_map_use_imu_edges;
+  options.seed = FLAGS_benchmark_map_seed;
+  return options;
+}
+
+BenchmarkMapGenerator::BenchmarkMapGenerator(
+    const BenchmarkMapOptions& options)
+    : options_(options) {
+  CHECK_GT(options_.num_missions, 0u);
+  CHECK_GT(options_.num_vertices_per_mission, 0u);
+  CHECK_GT(options_.num_observations_per_landmark, 0u);
+  CHECK_GE(
+      options_.num_landmarks_per_frame, options_.num_observations_per_landmark);
+  CHECK_GE(options_.cross_mission_overlap, 0.0);
+  CHECK_LE(options_.cross_mission_overlap, 1.0);
+
+  const size_t num_observations = options_.num_observations_per_landmark;
+  mission_layouts_.resize(options_.num_missions);
+  for (size_t mission_idx = 0u; mission_idx < options_.num_missions;
+       ++mission_idx) {
+    MissionLayout& layout = mission_layouts_[mission_idx];
+    if (mission_idx == 0u) {
+      layout.num_overlapping_landmarks = 0u;
+    } else {
+      // Overlapping landmarks are the first landmarks created at the vertex
+      // of the first mission with the same index.
+      layout.num_overlapping_landmarks = std::min(
+          static_cast<size_t>(std::round(
+              options_.cross_mission_overlap *
+              options_.num_landmarks_per_frame)),
+          mission_layouts_[0].num_new_landmarks_per_vertex);
+    }
+    layout.num_new_landmarks_per_vertex = std::max<size_t>(
+        1u,
+        (options_.num_landmarks_per_frame - layout.num_overlapping_landmarks) /
+            num_observations);
+    layout.num_keypoints =
+        layout.num_new_landmarks_per_vertex * num_observations +
+        layout.num_overlapping_landmarks;
+  }
+
+  Eigen::VectorXd intrinsics(4);
+  intrinsics << kCameraFocalLength, kCameraFocalLength, kCameraWidth / 2.0,
+      kCameraHeight / 2.0;
+  aslam::Camera::Ptr camera(
+      new aslam::PinholeCamera(intrinsics, kCameraWidth, kCameraHeight));
+  aslam::CameraId camera_id;
+  common::generateId(&camera_id);
+  camera->setId(camera_id);
+  std::vector<aslam::Camera::Ptr> cameras;
+  Aligned<std::vector, aslam::Transformation> T_C_B_vector;
+  cameras.push_back(camera);
+  T_C_B_vector.push_back(aslam::Transformation());
+  aslam::NCameraId n_camera_id;
+  common::generateId(&n_camera_id);
+  n_camera_.reset(new aslam::NCamera(
+      n_camera_id, T_C_B_vector, cameras, "Benchmark camera rig"));
+}
+
+size_t BenchmarkMapGenerator::numLandmarks() const {
+  size_t num_landmarks = 0u;
+  for (const MissionLayout& layout : mission_layouts_) {
+    num_landmarks +=
+        layout.num_new_landmarks_per_vertex * options_.num_vertices_per_mission;
+  }
+  return num_landmarks;
+}
+
+uint64_t BenchmarkMapGenerator::hash(
+    const size_t mission_idx, const size_t vertex_idx,
+    const size_t landmark_idx) const {
+  uint64_t state = static_cast<uint64_t>(options_.seed);
+  state = splitMix64(&state) ^ mission_idx;
+  state = splitMix64(&state) ^ vertex_idx;
+  state = splitMix64(&state) ^ landmark_idx;
+  return splitMix64(&state);
+}
+
+pose::Transformation BenchmarkMapGenerator::get_T_M_I(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  const Eigen::Vector3d p_M_I(
+      vertex_idx * kVertexSpacingMeters,
+      mission_idx * kMissionLateralOffsetMeters, 0.0);
+  return pose::Transformation(p_M_I, pose::Quaternion(get_R_M_I()));
+}
+
+int64_t BenchmarkMapGenerator::getTimestampNanoseconds(
+    const size_t mission_idx, const size_t vertex_idx) const {
+  const int64_t mission_duration_nanoseconds =
+      options_.num_vertices_per_mission * kVertexPeriodNanoseconds +
+      kMissionPauseNanoseconds;
+  return mission_idx * mission_duration_nanoseconds +
+         vertex_idx * kVertexPeriodNanoseconds;
+}
+
+Eigen::Vector3d BenchmarkMapGenerator::get_p_M_fi(
+    const size_t mission_idx, const size_t vertex_idx,
+    const size_t landmark_idx) const {
+  uint64_t state = hash(mission_idx, vertex_idx, landmark_idx);
+  // Far enough to stay in front of all observing vertices.
+  const double min_depth =
+      kMinLandmarkDepthMeters +
+      options_.num_observations_per_landmark * kVertexSpacingMeters;
+  const double depth = uniform(min_depth, kMaxLandmarkDepthMeters, &state);
+  // Central half of the image, such that the landmark stays visible while
+  // the vertices approach it.
+  const double u =
+      uniform(kCameraWidth / 4.0, 3.0 * kCameraWidth / 4.0, &state);
+  const double v =
+      uniform(kCameraHeight / 4.0, 3.0 * kCameraHeight / 4.0, &state);
+  const Eigen::Vector3d p_I_fi(
+      (u - kCameraWidth / 2.0) / kCameraFocalLength * depth,
+      (v - kCameraHeight / 2.0) / kCameraFocalLength * depth, depth);
+  return get_T_M_I(mission_idx, vertex_idx) * p_I_fi;
+}
+
+vi_map::Vertex::UniquePtr BenchmarkMapGenerator::generateVertex(
+    const size_t mission_idx, const size_t vertex_idx,
+    const std::vector<vi_map::MissionId>& mission_ids,
+    const std::vector<pose_graph::VertexIdList>& vertex_ids,
+    const std::vector<vi_map::LandmarkIdList>& landmark_ids) const {
+  const MissionLayout& layout = mission_layouts_[mission_idx];
+  const size_t num_new_landmarks = layout.num_new_landmarks_per_vertex;
+  const size_t num_observations = options_.num_observations_per_landmark;
+  const pose::Transformation T_M_I = get_T_M_I(mission_idx, vertex_idx);
+  const pose::Transformation T_C_M = n_camera_->get_T_C_B(0u) * T_M_I.inverse();
+  const aslam::Camera& camera = n_camera_->getCamera(0u);
+
+  Eigen::Matrix2Xd image_points(2, layout.num_keypoints);
+  aslam::VisualFrame::DescriptorsT descriptors(
+      kDescriptorSizeBytes, layout.num_keypoints);
+  vi_map::LandmarkIdList observed_landmark_ids(layout.num_keypoints);
+  auto set_keypoint = [&](
+      const size_t keypoint_idx, const size_t landmark_mission_idx,
+      const size_t landmark_vertex_idx, const size_t landmark_idx) {
+    Eigen::Vector2d keypoint;
+    camera.project3(
+        T_C_M * get_p_M_fi(
+                    landmark_mission_idx, landmark_vertex_idx, landmark_idx),
+        &keypoint);
+    image_points.col(keypoint_idx) = keypoint;
+    // The descriptor of a landmark is the same in all frames.
+    uint64_t state =
+        ~hash(landmark_mission_idx, landmark_vertex_idx, landmark_idx);
+    for (int byte_idx = 0; byte_idx < kDescriptorSizeBytes; byte_idx += 8) {
+      const uint64_t bits = splitMix64(&state);
+      for (int i = 0; i < 8; ++i) {
+        descriptors(byte_idx + i, keypoint_idx) =
+            static_cast<unsigned char>(bits >> (8 * i));
+      }
+    }
+  };
+
+  for (size_t age = 0u; age < num_observations; ++age) {
+    for (size_t landmark_idx = 0u; landmark_idx < num_new_landmarks;
+         ++landmark_idx) {
+      const size_t keypoint_idx = age * num_new_landmarks + landmark_idx;
+      if (vertex_idx < age) {
+        // Keypoints of landmarks that would have been created before the
+        // start of the mission remain without landmark.
+        set_keypoint(
+            keypoint_idx, mission_idx, vertex_idx,
+            layout.num_keypoints + keypoint_idx);
+        continue;
+      }
+      const size_t creating_vertex_idx = vertex_idx - age;
+      set_keypoint(
+          keypoint_idx, mission_idx, creating_vertex_idx, landmark_idx);
+      observed_landmark_ids[keypoint_idx] = landmark_ids[mission_idx].at(
+          creating_vertex_idx * num_new_landmarks + landmark_idx);
+    }
+  }
+  const size_t num_first_mission_new_landmarks =
+      mission_layouts_[0].num_new_landmarks_per_vertex;
+  for (size_t overlap_idx = 0u; overlap_idx < layout.num_overlapping_landmarks;
+       ++overlap_idx) {
+    const size_t keypoint_idx =
+        num_new_landmarks * num_observations + overlap_idx;
+    set_keypoint(keypoint_idx, 0u, vertex_idx, overlap_idx);
+    observed_landmark_ids[keypoint_idx] =
+        landmark_ids[0][vertex_idx * num_first_mission_new_landmarks +
+                        overlap_idx];
+  }
+
+  aslam::FrameId frame_id;
+  common::generateId(&frame_id);
+  const pose_graph::VertexId& vertex_id = vertex_ids[mission_idx][vertex_idx];
+  vi_map::Vertex::UniquePtr vertex(new vi_map::Vertex(
+      vertex_id, Eigen::Matrix<double, 6, 1>::Zero(), image_points,
+      Eigen::VectorXd::Constant(
+          layout.num_keypoints, kKeypointUncertaintyPixels),
+      descriptors, observed_landmark_ids, mission_ids[mission_idx], frame_id,
+      getTimestampNanoseconds(mission_idx, vertex_idx), n_camera_));
+  vertex->set_T_M_I(T_M_I);
+  vertex->set_v_M(Eigen::Vector3d(
+      kVertexSpacingMeters /
+          aslam::time::nanoSecondsToSeconds(kVertexPeriodNanoseconds),
+      0.0, 0.0));
+
+  // The landmarks created at this vertex, with all their observations.
+  const pose::Transformation T_I_M = T_M_I.inverse();
+  for (size_t landmark_idx = 0u; landmark_idx < num_new_landmarks;
+       ++landmark_idx) {
+    vi_map::Landmark landmark;
+    landmark.setId(
+        landmark_ids[mission_idx][vertex_idx * num_new_landmarks +
+                                  landmark_idx]);
+    landmark.set_p_B(
+        T_I_M * get_p_M_fi(mission_idx, vertex_idx, landmark_idx));
+    landmark.setQuality(vi_map::Landmark::Quality::kGood);
+    for (size_t age = 0u; age < num_observations &&
+                          vertex_idx + age < options_.num_vertices_per_mission;
+         ++age) {
+      landmark.addObservation(
+          vertex_ids[mission_idx][vertex_idx + age], 0u,
+          age * num_new_landmarks + landmark_idx);
+    }
+    if (mission_idx == 0u) {
+      for (size_t other_mission_idx = 1u;
+           other_mission_idx < options_.num_missions; ++other_mission_idx) {
+        const MissionLayout& other_layout =
+            mission_layouts_[other_mission_idx];
+        if (landmark_idx < other_layout.num_overlapping_landmarks) {
+          landmark.addObservation(
+              vertex_ids[other_mission_idx][vertex_idx], 0u,
+              other_layout.num_new_landmarks_per_vertex * num_observations +
+                  landmark_idx);
+        }
+      }
+    }
+    vertex->getLandmarks().addLandmark(landmark);
+  }
+  return vertex;
+}
+
+vi_map::Edge::UniquePtr BenchmarkMapGenerator::generateEdge(
+    const size_t mission_idx, const size_t vertex_idx,
+    const std::vector<pose_graph::VertexIdList>& vertex_ids) const {
+  CHECK_GT(vertex_idx, 0u);
+  pose_graph::EdgeId edge_id;
+  common::generateId(&edge_id);
+  const pose_graph::VertexId& from = vertex_ids[mission_idx][vertex_idx - 1u];
+  const pose_graph::VertexId& to = vertex_ids[mission_idx][vertex_idx];
+
+  if (!options_.use_imu_edges) {
+    const pose::Transformation T_A_B =
+        get_T_M_I(mission_idx, vertex_idx - 1u).inverse() *
+        get_T_M_I(mission_idx, vertex_idx);
+    constexpr double kOdometryCovariance = 1e-4;
+    return vi_map::Edge::UniquePtr(new vi_map::TransformationEdge(
+        vi_map::Edge::EdgeType::kOdometry, edge_id, from, to, T_A_B,
+        kOdometryCovariance * Eigen::Matrix<double, 6, 6>::Identity()));
+  }
+
+  // Constant velocity, the accelerometer only measures gravity.
+  const int64_t start_timestamp_nanoseconds =
+      getTimestampNanoseconds(mission_idx, vertex_idx - 1u);
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps(
+      kNumImuMeasurementsPerEdge + 1u);
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data(
+      6, kNumImuMeasurementsPerEdge + 1u);
+  const Eigen::Vector3d I_specific_force =
+      get_R_M_I().transpose() *
+      Eigen::Vector3d(0.0, 0.0, kGravityAcceleration);
+  for (size_t i = 0u; i <= kNumImuMeasurementsPerEdge; ++i) {
+    imu_timestamps(i) =
+        start_timestamp_nanoseconds +
+        i * kVertexPeriodNanoseconds / kNumImuMeasurementsPerEdge;
+    imu_data.col(i) << I_specific_force, Eigen::Vector3d::Zero();
+  }
+  return vi_map::Edge::UniquePtr(
+      new vi_map::ViwlsEdge(edge_id, from, to, imu_timestamps, imu_data));
+}
+
+void BenchmarkMapGenerator::generateMap(vi_map::VIMap* map) const {
+  CHECK_NOTNULL(map);
+  CHECK_EQ(map->numMissions(), 0u);
+  CHECK_EQ(map->numVertices(), 0u);
+
+  const size_t num_missions = options_.num_missions;
+  const size_t num_vertices_per_mission = options_.num_vertices_per_mission;
+  const size_t num_vertices = num_missions * num_vertices_per_mission;
+  const size_t num_threads = common::getNumHardwareThreads();
+  constexpr bool kAlwaysParallelize = false;
+
+  // All ids are generated up front, such that every vertex can be generated
+  // independently.
+  std::vector<vi_map::MissionId> mission_ids(num_missions);
+  std::vector<pose_graph::VertexIdList> vertex_ids(num_missions);
+  std::vector<vi_map::LandmarkIdList> landmark_ids(num_missions);
+  std::function<void(const std::vector<size_t>&)> generate_ids =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t mission_idx : batch) {
+          common::generateId(&mission_ids[mission_idx]);
+          vertex_ids[mission_idx].resize(num_vertices_per_mission);
+          for (pose_graph::VertexId& vertex_id : vertex_ids[mission_idx]) {
+            common::generateId(&vertex_id);
+          }
+          landmark_ids[mission_idx].resize(
+              num_vertices_per_mission *
+              mission_layouts_[mission_idx].num_new_landmarks_per_vertex);
+          for (vi_map::LandmarkId& landmark_id : landmark_ids[mission_idx]) {
+            common::generateId(&landmark_id);
+          }
+        }
+      };
+  common::ParallelProcess(
+      num_missions, generate_ids, kAlwaysParallelize, num_threads);
+
+  vi_map::SensorManager& sensor_manager = map->getSensorManager();
+  vi_map::ImuSigmas imu_sigmas;
+  imu_sigmas.gyro_noise_density = 0.1;
+  imu_sigmas.gyro_bias_random_walk_noise_density = 0.1;
+  imu_sigmas.acc_noise_density = 0.1;
+  imu_sigmas.acc_bias_random_walk_noise_density = 0.1;
+  vi_map::SensorId imu_sensor_id;
+  common::generateId(&imu_sensor_id);
+  vi_map::Imu::UniquePtr imu_sensor =
+      aligned_unique<vi_map::Imu>(imu_sensor_id, std::string("imu0"));
+  imu_sensor->setImuSigmas(imu_sigmas);
+  sensor_manager.addSensor(std::move(imu_sensor));
+
+  const vi_map::Mission::BackBone backbone_type =
+      options_.use_imu_edges ? vi_map::Mission::BackBone::kViwls
+                             : vi_map::Mission::BackBone::kOdometry;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    map->addNewMissionWithBaseframe(
+        mission_id, pose::Transformation(),
+        Eigen::Matrix<double, 6, 6>::Zero(), n_camera_, backbone_type);
+    sensor_manager.associateExistingSensorWithMission(
+        imu_sensor_id, mission_id);
+  }
+
+  VLOG(1) << "Generating " << num_vertices << " vertices with "
+          << numLandmarks() << " landmarks.";
+  map->reserveForMerge(
+      num_vertices, num_vertices - num_missions, numLandmarks());
+  std::vector<vi_map::Vertex::UniquePtr> vertices(num_vertices);
+  std::vector<vi_map::Edge::UniquePtr> edges(num_vertices);
+  std::function<void(const std::vector<size_t>&)> generate_vertices =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          const size_t mission_idx = idx / num_vertices_per_mission;
+          const size_t vertex_idx = idx % num_vertices_per_mission;
+          vertices[idx] = generateVertex(
+              mission_idx, vertex_idx, mission_ids, vertex_ids, landmark_ids);
+          if (vertex_idx > 0u) {
+            edges[idx] = generateEdge(mission_idx, vertex_idx, vertex_ids);
+          }
+        }
+      };
+  common::ParallelProcess(
+      num_vertices, generate_vertices, kAlwaysParallelize, num_threads);
+
+  map->addVertices(&vertices);
+  for (vi_map::Edge::UniquePtr& edge : edges) {
+    if (edge) {
+      map->addEdge(std::move(edge));
+    }
+  }
+  for (size_t mission_idx = 0u; mission_idx < num_missions; ++mission_idx) {
+    map->getMission(mission_ids[mission_idx])
+        .setRootVertexId(vertex_ids[mission_idx][0]);
+    const size_t num_new_landmarks =
+        mission_layouts_[mission_idx].num_new_landmarks_per_vertex;
+    for (size_t idx = 0u; idx < landmark_ids[mission_idx].size(); ++idx) {
+      map->addLandmarkIndexReference(
+          landmark_ids[mission_idx][idx],
+          vertex_ids[mission_idx][idx / num_new_landmarks]);
+    }
+  }
+}
+
+bool BenchmarkMapGenerator::generateMapToFolder(
+    const std::string& map_folder, const bool overwrite) const {
+  CHECK(!map_folder.empty());
+  vi_map::VIMap map;
+  generateMap(&map);
+  backend::SaveConfig config;
+  config.overwrite_existing_files = overwrite;
+  return map.saveToFolder(map_folder, config);
+}
+
+}  // namespace vi_map_helpers
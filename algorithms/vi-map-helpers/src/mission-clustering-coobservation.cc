@@ -1,81 +1,140 @@
 #include "vi-map-helpers/mission-clustering-coobservation.h"
 
+#include <algorithm>
+#include <mutex>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <maplab-common/accessors.h>
+#include <maplab-common/csr-graph.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 
-#include "vi-map-helpers/vi-map-queries.h"
-
 namespace vi_map_helpers {
 namespace {
-bool haveCommonElements(
-    const vi_map::LandmarkIdSet& set_a, const vi_map::LandmarkIdSet& set_b) {
-  // Make sure we loop over the smaller set.
-  if (set_b.size() < set_a.size()) {
-    return haveCommonElements(set_b, set_a);
-  }
+constexpr size_t kNumBitsPerWord = 64u;
 
-  for (const vi_map::LandmarkId& landmark_id : set_a) {
-    if (set_b.count(landmark_id) > 0u) {
-      return true;
-    }
-  }
-  return false;
+inline void setBit(const size_t bit, uint64_t* words) {
+  words[bit / kNumBitsPerWord] |= uint64_t{1} << (bit % kNumBitsPerWord);
+}
+
+inline bool isBitSet(const size_t bit, const uint64_t* words) {
+  return (words[bit / kNumBitsPerWord] >> (bit % kNumBitsPerWord)) & 1u;
 }
 }  // namespace
 
 MissionCoobservationCachedQuery::MissionCoobservationCachedQuery(
-    const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids) {
-  for (const vi_map::MissionId& mission_id : mission_ids) {
-    vi_map_helpers::VIMapQueries queries(vi_map);
-    queries.getLandmarksObservedByMission(
-        mission_id, &mission_landmark_map_[mission_id]);
+    const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids)
+    : missions_(mission_ids.begin(), mission_ids.end()),
+      num_words_per_row_(
+          (mission_ids.size() + kNumBitsPerWord - 1u) / kNumBitsPerWord),
+      coobservation_matrix_(missions_.size() * num_words_per_row_, 0u) {
+  for (size_t mission_idx = 0u; mission_idx < missions_.size();
+       ++mission_idx) {
+    CHECK(missions_[mission_idx].isValid());
+    mission_indices_.emplace(missions_[mission_idx], mission_idx);
   }
+
+  vi_map::LandmarkIdList landmark_ids;
+  vi_map.getAllLandmarkIds(&landmark_ids);
+
+  // Every block fills its own matrix, which are merged at the end.
+  std::mutex m_coobservation_matrix;
+  common::ParallelProcess(
+      landmark_ids.size(),
+      [&](const std::vector<size_t>& landmark_indices) {
+        std::vector<uint64_t> block_matrix(coobservation_matrix_.size(), 0u);
+        std::vector<uint64_t> landmark_missions(num_words_per_row_);
+        std::vector<size_t> observing_mission_indices;
+        for (const size_t landmark_idx : landmark_indices) {
+          std::fill(landmark_missions.begin(), landmark_missions.end(), 0u);
+          observing_mission_indices.clear();
+          for (const vi_map::KeypointIdentifier& observation :
+               vi_map.getLandmark(landmark_ids[landmark_idx])
+                   .getObservations()) {
+            const std::unordered_map<vi_map::MissionId, size_t>::const_iterator
+                it = mission_indices_.find(
+                    vi_map.getVertex(observation.frame_id.vertex_id)
+                        .getMissionId());
+            if (it != mission_indices_.end() &&
+                !isBitSet(it->second, landmark_missions.data())) {
+              setBit(it->second, landmark_missions.data());
+              observing_mission_indices.emplace_back(it->second);
+            }
+          }
+
+          if (observing_mission_indices.size() == 1u) {
+            const size_t mission_idx = observing_mission_indices.front();
+            setBit(
+                mission_idx,
+                block_matrix.data() + mission_idx * num_words_per_row_);
+            continue;
+          }
+          for (const size_t mission_idx : observing_mission_indices) {
+            uint64_t* row =
+                block_matrix.data() + mission_idx * num_words_per_row_;
+            for (size_t word_idx = 0u; word_idx < num_words_per_row_;
+                 ++word_idx) {
+              row[word_idx] |= landmark_missions[word_idx];
+            }
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(m_coobservation_matrix);
+        for (size_t word_idx = 0u; word_idx < block_matrix.size();
+             ++word_idx) {
+          coobservation_matrix_[word_idx] |= block_matrix[word_idx];
+        }
+      },
+      /*always_parallelize=*/false, common::getNumHardwareThreads());
 }
 
 bool MissionCoobservationCachedQuery::hasCommonObservations(
     const vi_map::MissionId& mission_id,
     const vi_map::MissionIdSet& other_mission_ids) const {
   CHECK(mission_id.isValid());
-  const vi_map::LandmarkIdSet& landmarks_of_mission =
-      common::getChecked(mission_landmark_map_, mission_id);
-
+  const uint64_t* row =
+      getRow(common::getChecked(mission_indices_, mission_id));
   for (const vi_map::MissionId& other_mission_id : other_mission_ids) {
-    const vi_map::LandmarkIdSet& landmarks_of_other_mission =
-        common::getChecked(mission_landmark_map_, other_mission_id);
-
-    if (haveCommonElements(landmarks_of_mission, landmarks_of_other_mission)) {
+    if (isBitSet(common::getChecked(mission_indices_, other_mission_id), row)) {
       return true;
     }
   }
   return false;
 }
 
+void MissionCoobservationCachedQuery::getClusters(
+    std::vector<vi_map::MissionIdSet>* clusters) const {
+  CHECK_NOTNULL(clusters)->clear();
+  const int num_missions = missions_.size();
+  std::vector<common::CsrGraph<int>::Edge> edges;
+  for (int mission_idx = 0; mission_idx < num_missions; ++mission_idx) {
+    const uint64_t* row = getRow(mission_idx);
+    // The matrix is symmetric, so the upper triangle is enough.
+    for (int other_idx = mission_idx + 1; other_idx < num_missions;
+         ++other_idx) {
+      if (isBitSet(other_idx, row)) {
+        edges.emplace_back(mission_idx, other_idx, 1);
+      }
+    }
+  }
+
+  std::vector<int> cluster_indices;
+  const int num_clusters = common::getConnectedComponents(
+      common::CsrGraph<int>::fromUndirectedEdges(num_missions, edges),
+      &cluster_indices);
+  clusters->resize(num_clusters);
+  for (int mission_idx = 0; mission_idx < num_missions; ++mission_idx) {
+    (*clusters)[cluster_indices[mission_idx]].emplace(missions_[mission_idx]);
+  }
+}
+
 std::vector<vi_map::MissionIdSet> clusterMissionByLandmarkCoobservations(
     const vi_map::VIMap& vi_map, const vi_map::MissionIdSet& mission_ids) {
   std::vector<vi_map::MissionIdSet> components;
-
   MissionCoobservationCachedQuery coobservations(vi_map, mission_ids);
-
-  for (const vi_map::MissionId& mission_id : mission_ids) {
-    vi_map::MissionIdSet new_component;
-    new_component.emplace(mission_id);
-    for (std::vector<vi_map::MissionIdSet>::iterator it = components.begin();
-         it != components.end();) {
-      if (coobservations.hasCommonObservations(mission_id, *it)) {
-        // Add the existing component items to the new component.
-        new_component.insert(it->begin(), it->end());
-        // Remove the old component from the components list.
-        it = components.erase(it);
-      } else {
-        ++it;
-      }
-    }
-    components.emplace_back(new_component);
-  }
+  coobservations.getClusters(&components);
   return components;
 }
 
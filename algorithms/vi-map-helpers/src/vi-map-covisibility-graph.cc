@@ -0,0 +1,279 @@
+#include "vi-map-helpers/vi-map-covisibility-graph.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace vi_map_helpers {
+
+VIMapCovisibilityGraph::VIMapCovisibilityGraph(const vi_map::VIMap& map)
+    : map_(map) {
+  rebuild();
+}
+
+void VIMapCovisibilityGraph::rebuild() {
+  const size_t num_vertex_indices = map_.numVertexDenseIndices();
+  added_neighbors_.clear();
+
+  // Sorted (neighbor index, common landmark count) pairs of every vertex.
+  typedef std::vector<std::pair<size_t, int>> NeighborList;
+  std::vector<NeighborList> neighbors(num_vertex_indices);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_vertex_indices,
+      [&](const std::vector<size_t>& range) {
+        // Reused for all vertices of the block.
+        vi_map::LandmarkIdList landmark_ids;
+        std::vector<size_t> observer_indices;
+        std::vector<size_t> covisible_indices;
+        for (const size_t vertex_index : range) {
+          const pose_graph::VertexId& vertex_id =
+              map_.getVertexIdFromDenseIndex(vertex_index);
+          if (!vertex_id.isValid()) {
+            continue;
+          }
+          map_.getVertex(vertex_id).getAllObservedLandmarkIds(&landmark_ids);
+          landmark_ids.erase(
+              std::remove_if(
+                  landmark_ids.begin(), landmark_ids.end(),
+                  [](const vi_map::LandmarkId& landmark_id) {
+                    return !landmark_id.isValid();
+                  }),
+              landmark_ids.end());
+          std::sort(landmark_ids.begin(), landmark_ids.end());
+          landmark_ids.erase(
+              std::unique(landmark_ids.begin(), landmark_ids.end()),
+              landmark_ids.end());
+
+          // Every landmark adds one to each of its other observers.
+          covisible_indices.clear();
+          for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+            getObserverVertexIndices(landmark_id, &observer_indices);
+            for (const size_t observer_index : observer_indices) {
+              if (observer_index != vertex_index) {
+                covisible_indices.push_back(observer_index);
+              }
+            }
+          }
+          std::sort(covisible_indices.begin(), covisible_indices.end());
+
+          NeighborList& vertex_neighbors = neighbors[vertex_index];
+          for (const size_t covisible_index : covisible_indices) {
+            if (vertex_neighbors.empty() ||
+                vertex_neighbors.back().first != covisible_index) {
+              vertex_neighbors.emplace_back(covisible_index, 0);
+            }
+            ++vertex_neighbors.back().second;
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+
+  row_begin_.resize(num_vertex_indices + 1u);
+  row_begin_[0] = 0u;
+  for (size_t vertex_index = 0u; vertex_index < num_vertex_indices;
+       ++vertex_index) {
+    row_begin_[vertex_index + 1u] =
+        row_begin_[vertex_index] + neighbors[vertex_index].size();
+  }
+  neighbor_vertex_indices_.resize(row_begin_.back());
+  num_common_landmarks_.resize(row_begin_.back());
+  for (size_t vertex_index = 0u; vertex_index < num_vertex_indices;
+       ++vertex_index) {
+    size_t entry = row_begin_[vertex_index];
+    for (const std::pair<size_t, int>& neighbor : neighbors[vertex_index]) {
+      neighbor_vertex_indices_[entry] = neighbor.first;
+      num_common_landmarks_[entry] = neighbor.second;
+      ++entry;
+    }
+  }
+  VLOG(2) << "Built covisibility graph with " << numEdges() << " edges.";
+}
+
+bool VIMapCovisibilityGraph::hasVertex(
+    const pose_graph::VertexId& vertex_id) const {
+  return map_.hasVertex(vertex_id) &&
+         map_.getVertexDenseIndex(vertex_id) + 1u < row_begin_.size();
+}
+
+size_t VIMapCovisibilityGraph::getCheckedVertexIndex(
+    const pose_graph::VertexId& vertex_id) const {
+  CHECK(hasVertex(vertex_id))
+      << "Vertex " << vertex_id << " is not part of the covisibility graph, "
+      << "it needs to be rebuilt.";
+  return map_.getVertexDenseIndex(vertex_id);
+}
+
+int VIMapCovisibilityGraph::getNumberOfCommonLandmarks(
+    const pose_graph::VertexId& vertex_id_1,
+    const pose_graph::VertexId& vertex_id_2) const {
+  CHECK_NE(vertex_id_1, vertex_id_2);
+  const size_t vertex_index_1 = getCheckedVertexIndex(vertex_id_1);
+  const size_t vertex_index_2 = getCheckedVertexIndex(vertex_id_2);
+
+  const std::vector<size_t>::const_iterator row_begin =
+      neighbor_vertex_indices_.begin() + row_begin_[vertex_index_1];
+  const std::vector<size_t>::const_iterator row_end =
+      neighbor_vertex_indices_.begin() + row_begin_[vertex_index_1 + 1u];
+  const std::vector<size_t>::const_iterator it =
+      std::lower_bound(row_begin, row_end, vertex_index_2);
+  if (it != row_end && *it == vertex_index_2) {
+    return num_common_landmarks_[it - neighbor_vertex_indices_.begin()];
+  }
+
+  const std::unordered_map<size_t, std::unordered_map<size_t, int>>::
+      const_iterator added_it = added_neighbors_.find(vertex_index_1);
+  if (added_it != added_neighbors_.end()) {
+    const std::unordered_map<size_t, int>::const_iterator neighbor_it =
+        added_it->second.find(vertex_index_2);
+    if (neighbor_it != added_it->second.end()) {
+      return neighbor_it->second;
+    }
+  }
+  return 0;
+}
+
+void VIMapCovisibilityGraph::forEachCovisibleVertex(
+    const pose_graph::VertexId& vertex_id,
+    const std::function<void(
+        const pose_graph::VertexId& covisible_vertex_id,
+        int num_common_landmarks)>& action) const {
+  const size_t vertex_index = getCheckedVertexIndex(vertex_id);
+  for (size_t entry = row_begin_[vertex_index];
+       entry < row_begin_[vertex_index + 1u]; ++entry) {
+    // Entries of removed landmarks are kept until the next rebuild.
+    if (num_common_landmarks_[entry] > 0) {
+      action(
+          map_.getVertexIdFromDenseIndex(neighbor_vertex_indices_[entry]),
+          num_common_landmarks_[entry]);
+    }
+  }
+
+  const std::unordered_map<size_t, std::unordered_map<size_t, int>>::
+      const_iterator added_it = added_neighbors_.find(vertex_index);
+  if (added_it != added_neighbors_.end()) {
+    for (const std::pair<const size_t, int>& neighbor : added_it->second) {
+      if (neighbor.second > 0) {
+        action(map_.getVertexIdFromDenseIndex(neighbor.first), neighbor.second);
+      }
+    }
+  }
+}
+
+void VIMapCovisibilityGraph::removeLandmark(
+    const vi_map::LandmarkId& landmark_id) {
+  std::vector<size_t> observer_indices;
+  getObserverVertexIndices(landmark_id, &observer_indices);
+  for (size_t i = 0u; i < observer_indices.size(); ++i) {
+    for (size_t j = i + 1u; j < observer_indices.size(); ++j) {
+      addToCommonLandmarks(observer_indices[i], observer_indices[j], -1);
+    }
+  }
+}
+
+void VIMapCovisibilityGraph::mergeLandmarks(
+    const vi_map::LandmarkId& landmark_id_to_merge,
+    const vi_map::LandmarkId& landmark_id_into) {
+  CHECK_NE(landmark_id_to_merge, landmark_id_into);
+  std::vector<size_t> observers_to_merge, observers_into;
+  getObserverVertexIndices(landmark_id_to_merge, &observers_to_merge);
+  getObserverVertexIndices(landmark_id_into, &observers_into);
+
+  // The merged landmark is counted once for every pair of its observers,
+  // pairs that observed both landmarks lose one.
+  std::vector<size_t> observers_of_both;
+  std::set_intersection(
+      observers_to_merge.begin(), observers_to_merge.end(),
+      observers_into.begin(), observers_into.end(),
+      std::back_inserter(observers_of_both));
+  for (size_t i = 0u; i < observers_of_both.size(); ++i) {
+    for (size_t j = i + 1u; j < observers_of_both.size(); ++j) {
+      addToCommonLandmarks(observers_of_both[i], observers_of_both[j], -1);
+    }
+  }
+  // Pairs that only observed one landmark each gain one.
+  for (const size_t observer_to_merge : observers_to_merge) {
+    if (std::binary_search(
+            observers_into.begin(), observers_into.end(), observer_to_merge)) {
+      continue;
+    }
+    for (const size_t observer_into : observers_into) {
+      if (!std::binary_search(
+              observers_to_merge.begin(), observers_to_merge.end(),
+              observer_into)) {
+        addToCommonLandmarks(observer_to_merge, observer_into, 1);
+      }
+    }
+  }
+}
+
+size_t VIMapCovisibilityGraph::numEdges() const {
+  size_t num_directed_edges = std::count_if(
+      num_common_landmarks_.begin(), num_common_landmarks_.end(),
+      [](const int num_common_landmarks) { return num_common_landmarks > 0; });
+  for (const std::pair<const size_t, std::unordered_map<size_t, int>>&
+           vertex_neighbors : added_neighbors_) {
+    for (const std::pair<const size_t, int>& neighbor :
+         vertex_neighbors.second) {
+      if (neighbor.second > 0) {
+        ++num_directed_edges;
+      }
+    }
+  }
+  CHECK_EQ(num_directed_edges % 2u, 0u);
+  return num_directed_edges / 2u;
+}
+
+void VIMapCovisibilityGraph::getObserverVertexIndices(
+    const vi_map::LandmarkId& landmark_id,
+    std::vector<size_t>* vertex_indices) const {
+  CHECK_NOTNULL(vertex_indices)->clear();
+  map_.getLandmark(landmark_id)
+      .forEachObservation([&](const vi_map::KeypointIdentifier& backlink) {
+        if (map_.hasVertex(backlink.frame_id.vertex_id)) {
+          vertex_indices->push_back(
+              map_.getVertexDenseIndex(backlink.frame_id.vertex_id));
+        }
+      });
+  std::sort(vertex_indices->begin(), vertex_indices->end());
+  vertex_indices->erase(
+      std::unique(vertex_indices->begin(), vertex_indices->end()),
+      vertex_indices->end());
+}
+
+void VIMapCovisibilityGraph::addToCommonLandmarks(
+    const size_t vertex_index_1, const size_t vertex_index_2,
+    const int delta) {
+  CHECK_NE(vertex_index_1, vertex_index_2);
+  addToCommonLandmarksDirected(vertex_index_1, vertex_index_2, delta);
+  addToCommonLandmarksDirected(vertex_index_2, vertex_index_1, delta);
+}
+
+void VIMapCovisibilityGraph::addToCommonLandmarksDirected(
+    const size_t vertex_index_from, const size_t vertex_index_to,
+    const int delta) {
+  CHECK_LT(vertex_index_from + 1u, row_begin_.size())
+      << "The covisibility graph needs to be rebuilt after adding vertices.";
+  const std::vector<size_t>::iterator row_begin =
+      neighbor_vertex_indices_.begin() + row_begin_[vertex_index_from];
+  const std::vector<size_t>::iterator row_end =
+      neighbor_vertex_indices_.begin() + row_begin_[vertex_index_from + 1u];
+  const std::vector<size_t>::iterator it =
+      std::lower_bound(row_begin, row_end, vertex_index_to);
+  int* num_common_landmarks;
+  if (it != row_end && *it == vertex_index_to) {
+    num_common_landmarks =
+        &num_common_landmarks_[it - neighbor_vertex_indices_.begin()];
+  } else {
+    num_common_landmarks =
+        &added_neighbors_[vertex_index_from][vertex_index_to];
+  }
+  *num_common_landmarks += delta;
+  CHECK_GE(*num_common_landmarks, 0);
+}
+
+}  // namespace vi_map_helpers
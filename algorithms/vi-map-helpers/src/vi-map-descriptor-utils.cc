@@ -81,8 +81,8 @@ void getDescriptorClosestToMedian(
       raw_descriptors, &median_descriptor_index);
   CHECK_LT(median_descriptor_index, num_observations);
 
-  getDescriptorFromObservation(
-      observations[median_descriptor_index], map, descriptor);
+  // The descriptors were already gathered, no need to look up the frame again.
+  *descriptor = raw_descriptors.col(median_descriptor_index);
 }
 
 }  // namespace vi_map_helpers
@@ -0,0 +1,197 @@
+#include "vi-map-helpers/vi-map-global-position-cache.h"
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/quaternion-math.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace vi_map_helpers {
+
+VIMapGlobalPositionCache::VIMapGlobalPositionCache(const vi_map::VIMap& map)
+    : map_(map), is_invalidated_completely_(true) {
+  update();
+}
+
+void VIMapGlobalPositionCache::invalidateVertex(
+    const pose_graph::VertexId& vertex_id) {
+  const size_t vertex_index = map_.getVertexDenseIndex(vertex_id);
+  if (vertex_index >= is_vertex_invalidated_.size()) {
+    // The vertex was added after the last update.
+    is_invalidated_completely_ = true;
+    return;
+  }
+  if (!is_vertex_invalidated_[vertex_index]) {
+    is_vertex_invalidated_[vertex_index] = true;
+    invalidated_vertex_indices_.emplace_back(vertex_index);
+  }
+}
+
+void VIMapGlobalPositionCache::invalidateMission(
+    const vi_map::MissionId& mission_id) {
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIdsInMission(mission_id, &vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    invalidateVertex(vertex_id);
+  }
+}
+
+void VIMapGlobalPositionCache::invalidateAll() {
+  is_invalidated_completely_ = true;
+}
+
+bool VIMapGlobalPositionCache::isUpToDate() const {
+  return !is_invalidated_completely_ && invalidated_vertex_indices_.empty() &&
+         vertex_T_G_I_.size() == map_.numVertexDenseIndices() &&
+         static_cast<size_t>(landmark_G_p_fi_.cols()) ==
+             map_.numLandmarkDenseIndices();
+}
+
+size_t VIMapGlobalPositionCache::update() {
+  std::vector<size_t> vertex_indices;
+  if (is_invalidated_completely_ ||
+      vertex_T_G_I_.size() != map_.numVertexDenseIndices() ||
+      static_cast<size_t>(landmark_G_p_fi_.cols()) !=
+          map_.numLandmarkDenseIndices()) {
+    resize();
+    vertex_indices.reserve(vertex_T_G_I_.size());
+    for (size_t vertex_index = 0u; vertex_index < vertex_T_G_I_.size();
+         ++vertex_index) {
+      if (map_.getVertexIdFromDenseIndex(vertex_index).isValid()) {
+        vertex_indices.emplace_back(vertex_index);
+      }
+    }
+  } else {
+    vertex_indices.swap(invalidated_vertex_indices_);
+  }
+
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      vertex_indices.size(),
+      [this, &vertex_indices](const std::vector<size_t>& range) {
+        std::vector<size_t> block_vertex_indices;
+        block_vertex_indices.reserve(range.size());
+        for (const size_t idx : range) {
+          block_vertex_indices.emplace_back(vertex_indices[idx]);
+        }
+        updateVertices(block_vertex_indices);
+      },
+      kAlwaysParallelize, num_threads);
+
+  for (const size_t vertex_index : vertex_indices) {
+    is_vertex_invalidated_[vertex_index] = false;
+  }
+  invalidated_vertex_indices_.clear();
+  is_invalidated_completely_ = false;
+  return vertex_indices.size();
+}
+
+const Eigen::Matrix3Xd& VIMapGlobalPositionCache::getLandmarkPositions_G()
+    const {
+  CHECK(isUpToDate());
+  return landmark_G_p_fi_;
+}
+
+const VIMapGlobalPositionCache::TransformationVector&
+VIMapGlobalPositionCache::getVertexTransformations_T_G_I() const {
+  CHECK(isUpToDate());
+  return vertex_T_G_I_;
+}
+
+Eigen::Vector3d VIMapGlobalPositionCache::getLandmark_G_p_fi(
+    const vi_map::LandmarkId& id) const {
+  CHECK(isUpToDate());
+  const size_t landmark_index = map_.getLandmarkDenseIndex(id);
+  CHECK_LT(landmark_index, static_cast<size_t>(landmark_G_p_fi_.cols()));
+  return landmark_G_p_fi_.col(landmark_index);
+}
+
+const pose::Transformation& VIMapGlobalPositionCache::getVertex_T_G_I(
+    const pose_graph::VertexId& id) const {
+  CHECK(isUpToDate());
+  const size_t vertex_index = map_.getVertexDenseIndex(id);
+  CHECK_LT(vertex_index, vertex_T_G_I_.size());
+  return vertex_T_G_I_[vertex_index];
+}
+
+void VIMapGlobalPositionCache::resize() {
+  const size_t num_vertex_indices = map_.numVertexDenseIndices();
+  vertex_T_G_I_.resize(num_vertex_indices);
+  is_vertex_invalidated_.assign(num_vertex_indices, false);
+  invalidated_vertex_indices_.clear();
+  landmark_G_p_fi_.resize(Eigen::NoChange, map_.numLandmarkDenseIndices());
+}
+
+void VIMapGlobalPositionCache::updateVertices(
+    const std::vector<size_t>& vertex_indices) {
+  std::vector<const vi_map::Vertex*> vertices;
+  vertices.reserve(vertex_indices.size());
+  std::vector<size_t> valid_vertex_indices;
+  valid_vertex_indices.reserve(vertex_indices.size());
+  for (const size_t vertex_index : vertex_indices) {
+    CHECK_LT(vertex_index, vertex_T_G_I_.size());
+    const pose_graph::VertexId& vertex_id =
+        map_.getVertexIdFromDenseIndex(vertex_index);
+    if (!vertex_id.isValid()) {
+      // The vertex was removed.
+      continue;
+    }
+    vertices.emplace_back(&map_.getVertex(vertex_id));
+    valid_vertex_indices.emplace_back(vertex_index);
+  }
+
+  // T_G_I = T_G_M * T_M_I for all vertices at once. The Hamiltonian
+  // quaternions of the vertices and baseframes are multiplied with the JPL
+  // kernels, which is the same product with swapped operands. The Hamiltonian
+  // rotation of q is the JPL rotation of its inverse.
+  const int num_vertices = static_cast<int>(vertices.size());
+  Eigen::Matrix4Xd q_M_I(4, num_vertices);
+  Eigen::Matrix3Xd p_M_I(3, num_vertices);
+  Eigen::Matrix4Xd q_G_M(4, num_vertices);
+  Eigen::Matrix3Xd p_G_M(3, num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    const vi_map::Vertex& vertex = *vertices[i];
+    const pose::Transformation& T_G_M =
+        map_.getMissionBaseFrameForMission(vertex.getMissionId()).get_T_G_M();
+    q_M_I.col(i) = vertex.get_q_M_I().coeffs();
+    p_M_I.col(i) = vertex.get_p_M_I();
+    q_G_M.col(i) = T_G_M.getRotation().toImplementation().coeffs();
+    p_G_M.col(i) = T_G_M.getPosition();
+  }
+  Eigen::Matrix4Xd q_G_I;
+  common::signedQuaternionProductJPLBatched(q_M_I, q_G_M, &q_G_I);
+  q_G_M.topRows<3>() *= -1.0;
+  Eigen::Matrix3Xd p_G_I;
+  common::rotateVectorJPLBatched(q_G_M, p_M_I, &p_G_I);
+  p_G_I += p_G_M;
+  Eigen::Matrix<double, 9, Eigen::Dynamic> R_I_G;
+  common::toRotationMatrixJPLBatched(q_G_I, &R_I_G);
+
+  // Reused for the landmarks of all vertices of the block.
+  Eigen::Matrix3Xd p_I_fi_buffer;
+  for (int i = 0; i < num_vertices; ++i) {
+    vertex_T_G_I_[valid_vertex_indices[i]] = pose::Transformation(
+        Eigen::Quaterniond(q_G_I.col(i).data()), p_G_I.col(i));
+
+    // Transforms all stored landmarks at once, the scattering into the
+    // columns of their dense indices is the only non-contiguous access.
+    const vi_map::LandmarkStore& landmarks = vertices[i]->getLandmarks();
+    p_I_fi_buffer.resize(Eigen::NoChange, landmarks.size());
+    int landmark_idx = 0;
+    for (const vi_map::Landmark& landmark : landmarks) {
+      p_I_fi_buffer.col(landmark_idx++) = landmark.get_p_B();
+    }
+    const Eigen::Map<const Eigen::Matrix3d> R_I_G_i(R_I_G.col(i).data());
+    p_I_fi_buffer =
+        (R_I_G_i.transpose() * p_I_fi_buffer).colwise() + p_G_I.col(i);
+
+    landmark_idx = 0;
+    for (const vi_map::Landmark& landmark : landmarks) {
+      const size_t landmark_index = map_.getLandmarkDenseIndex(landmark.id());
+      CHECK_LT(landmark_index, static_cast<size_t>(landmark_G_p_fi_.cols()));
+      landmark_G_p_fi_.col(landmark_index) = p_I_fi_buffer.col(landmark_idx++);
+    }
+  }
+}
+
+}  // namespace vi_map_helpers
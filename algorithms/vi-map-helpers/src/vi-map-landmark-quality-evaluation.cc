@@ -1,18 +1,81 @@
 #include "vi-map-helpers/vi-map-landmark-quality-evaluation.h"
 
+#include <functional>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
 #include <glog/logging.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/pose_types.h>
 #include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/landmark.h>
 #include <vi-map/vi-map.h>
 
+#include "vi-map-helpers/vi-map-global-position-cache.h"
+
 namespace vi_map_helpers {
+namespace {
+// Computes T_G_C of all cameras of all vertices once, such that landmarks
+// observed by the same frame reuse the camera pose. The cameras of the vertex
+// with dense index i start at first_camera_indices[i].
+void computeCameraPoses(
+    const vi_map::VIMap& map, const VIMapGlobalPositionCache& position_cache,
+    std::vector<size_t>* first_camera_indices,
+    Aligned<std::vector, pose::Transformation>* cameras_T_G_C) {
+  CHECK_NOTNULL(first_camera_indices);
+  CHECK_NOTNULL(cameras_T_G_C);
+  const size_t num_vertex_indices = map.numVertexDenseIndices();
+  first_camera_indices->assign(num_vertex_indices + 1u, 0u);
+  for (size_t vertex_index = 0u; vertex_index < num_vertex_indices;
+       ++vertex_index) {
+    const pose_graph::VertexId& vertex_id =
+        map.getVertexIdFromDenseIndex(vertex_index);
+    const size_t num_frames =
+        vertex_id.isValid() ? map.getVertex(vertex_id).numFrames() : 0u;
+    (*first_camera_indices)[vertex_index + 1u] =
+        (*first_camera_indices)[vertex_index] + num_frames;
+  }
+  cameras_T_G_C->resize(first_camera_indices->back());
+
+  const VIMapGlobalPositionCache::TransformationVector& vertices_T_G_I =
+      position_cache.getVertexTransformations_T_G_I();
+  std::function<void(const std::vector<size_t>&)> camera_pose_computer =
+      [&map, &vertices_T_G_I, first_camera_indices,
+       cameras_T_G_C](const std::vector<size_t>& batch) {
+        for (const size_t vertex_index : batch) {
+          const pose_graph::VertexId& vertex_id =
+              map.getVertexIdFromDenseIndex(vertex_index);
+          if (!vertex_id.isValid()) {
+            continue;
+          }
+          const vi_map::Vertex& vertex = map.getVertex(vertex_id);
+          const aslam::NCamera& ncamera =
+              map.getSensorManager().getNCameraForMission(
+                  vertex.getMissionId());
+          const size_t first_camera_index =
+              (*first_camera_indices)[vertex_index];
+          for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            (*cameras_T_G_C)[first_camera_index + frame_idx] =
+                vertices_T_G_I[vertex_index] *
+                ncamera.get_T_C_B(frame_idx).inverse();
+          }
+        }
+      };
+
+  static constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      num_vertex_indices, camera_pose_computer, kAlwaysParallelize,
+      num_threads);
+}
+}  // namespace
 
 void evaluateLandmarkQuality(vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  constexpr bool kEvaluateLandmarkQuality = true;
 
   vi_map::LandmarkIdList landmark_ids;
   map->getAllLandmarkIds(&landmark_ids);
@@ -21,22 +84,53 @@ void evaluateLandmarkQuality(vi_map::VIMap* map) {
   VLOG(1) << "Evaluating quality of landmarks of " << num_landmarks
           << " landmarks.";
 
+  // The global vertex poses, landmark positions and camera poses are computed
+  // once for the whole map instead of for every observation.
+  const VIMapGlobalPositionCache position_cache(*map);
+  std::vector<size_t> first_camera_indices;
+  Aligned<std::vector, pose::Transformation> cameras_T_G_C;
+  computeCameraPoses(
+      *map, position_cache, &first_camera_indices, &cameras_T_G_C);
+  const vi_map::LandmarkWellConstrainedSettings settings;
+
   common::MultiThreadedProgressBar progress_bar;
 
   std::function<void(const std::vector<size_t>&)> evaluator =
-      [&landmark_ids, map, &progress_bar](const std::vector<size_t>& batch) {
+      [&landmark_ids, map, &position_cache, &first_camera_indices,
+       &cameras_T_G_C, &settings,
+       &progress_bar](const std::vector<size_t>& batch) {
         progress_bar.setNumElements(batch.size());
         size_t num_processed = 0u;
+        Aligned<std::vector, pose::Transformation> observers_T_G_C;
         for (size_t idx : batch) {
           CHECK_LT(idx, landmark_ids.size());
           const vi_map::LandmarkId& landmark_id = landmark_ids[idx];
           CHECK(landmark_id.isValid());
           vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+
+          // Localization landmarks are always good.
+          bool is_well_constrained = true;
+          if (landmark.getQuality() !=
+              vi_map::Landmark::Quality::kLocalizationSummaryLandmark) {
+            observers_T_G_C.clear();
+            for (const vi_map::KeypointIdentifier& backlink :
+                 landmark.getObservations()) {
+              const size_t vertex_index =
+                  map->getVertexDenseIndex(backlink.frame_id.vertex_id);
+              CHECK_LT(vertex_index + 1u, first_camera_indices.size());
+              const size_t camera_index =
+                  first_camera_indices[vertex_index] +
+                  backlink.frame_id.frame_index;
+              CHECK_LT(camera_index, first_camera_indices[vertex_index + 1u]);
+              observers_T_G_C.emplace_back(cameras_T_G_C[camera_index]);
+            }
+            is_well_constrained = vi_map::isLandmarkWellConstrained(
+                position_cache.getLandmark_G_p_fi(landmark_id),
+                observers_T_G_C, settings);
+          }
           landmark.setQuality(
-              vi_map::isLandmarkWellConstrained(
-                  *map, landmark, kEvaluateLandmarkQuality)
-                  ? vi_map::Landmark::Quality::kGood
-                  : vi_map::Landmark::Quality::kBad);
+              is_well_constrained ? vi_map::Landmark::Quality::kGood
+                                  : vi_map::Landmark::Quality::kBad);
           progress_bar.update(++num_processed);
         }
       };
@@ -45,6 +139,7 @@ void evaluateLandmarkQuality(vi_map::VIMap* map) {
   const size_t num_threads = common::getNumHardwareThreads();
   common::ParallelProcess(
       num_landmarks, evaluator, kAlwaysParallelize, num_threads);
+  map->markLandmarksChanged();
 }
 
 void resetLandmarkQualityToUnknown(vi_map::VIMap* map) {
@@ -72,6 +167,7 @@ void resetLandmarkQualityToUnknown(vi_map::VIMap* map) {
   const size_t num_threads = common::getNumHardwareThreads();
   common::ParallelProcess(
       num_landmarks, evaluator, kAlwaysParallelize, num_threads);
+  map->markLandmarksChanged();
 }
 
 }  // namespace vi_map_helpers
@@ -463,9 +463,8 @@ size_t VIMapManipulation::removeBadLandmarks() {
   vi_map::LandmarkIdList bad_landmark_ids;
   queries_.getAllNotWellConstrainedLandmarkIds(&bad_landmark_ids);
 
-  for (const vi_map::LandmarkId& bad_landmark_id : bad_landmark_ids) {
-    map_.removeLandmark(bad_landmark_id);
-  }
+  map_.removeLandmarks(vi_map::LandmarkIdSet(
+      bad_landmark_ids.begin(), bad_landmark_ids.end()));
   return bad_landmark_ids.size();
 }
 
@@ -1,16 +1,23 @@
 #include "vi-map-helpers/vi-map-partitioner.h"
 
 #include <fstream>  // NOLINT
+#include <type_traits>
 #include <vector>
 
 #include <maplab-common/file-logger.h>
 #include <maplab-common/progress-bar.h>
 #include <metis.h>
+#include <vi-map-helpers/vi-map-covisibility-graph.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map_helpers {
 
+// The graph arrays are handed to METIS without a copy.
+static_assert(
+    std::is_same<idx_t, int32_t>::value && std::is_same<idx_t, int>::value,
+    "METIS has to be built with 32 bit indices.");
+
 const std::string VIMapPartitioner::kFileName = "metis_graph";
 
 void VIMapPartitioner::partitionMapWithMetis(
@@ -30,20 +37,19 @@ void VIMapPartitioner::partitionMapWithMetis(
       map, vertex_indices, kMinNumberOfCoobservedLandmarks, &total_num_edges,
       &edges);
 
-  typedef Eigen::Triplet<idx_t> EdgeTriplet;
-  std::vector<EdgeTriplet> edge_triplets;
-  // Triplets will store each edge twice (= in both directions).
-  edge_triplets.reserve(2 * total_num_edges);
+  // The coobserver edges are stored in both directions already.
+  std::vector<Graph::Edge> graph_edges;
+  graph_edges.reserve(2 * total_num_edges);
   for (unsigned int i = 0; i < edges.size(); ++i) {
     for (const GraphEdge& edge : edges[i]) {
-      edge_triplets.push_back(EdgeTriplet(i, edge.vertex_index, edge.score));
+      graph_edges.emplace_back(i, edge.vertex_index, edge.score);
     }
   }
+  const Graph graph(num_vertices, graph_edges);
 
   std::vector<idx_t> part;
   static constexpr bool kRequireContiguous = true;
-  partitionGraphFromTriplets(
-      edge_triplets, num_vertices, num_partitions, kRequireContiguous, &part);
+  partitionGraph(graph, num_partitions, kRequireContiguous, &part);
 
   pose_graph::VertexIdList all_vertex_ids;
   map.getAllVertexIds(&all_vertex_ids);
@@ -56,21 +62,15 @@ void VIMapPartitioner::partitionMapWithMetis(
   }
 }
 
-void VIMapPartitioner::partitionGraphFromTriplets(
-    const std::vector<EdgeTriplet>& edge_triplets,
-    const size_t num_graph_vertices, const size_t num_partitions,
+void VIMapPartitioner::partitionGraph(
+    const Graph& graph, const size_t num_partitions,
     const bool require_contiguous_partitions,
     std::vector<int32_t>* partition_indices) const {
   CHECK_NOTNULL(partition_indices)->clear();
-  partition_indices->resize(num_graph_vertices);
-
-  Eigen::SparseMatrix<idx_t> edge_matrix(
-      num_graph_vertices, num_graph_vertices);
-  edge_matrix.setFromTriplets(edge_triplets.begin(), edge_triplets.end());
-  edge_matrix.makeCompressed();
+  partition_indices->resize(graph.getNumVertices());
 
   // idx_t and real_t are types defined by METIS in metis.h header file.
-  idx_t nvtxs = num_graph_vertices;
+  idx_t nvtxs = graph.getNumVertices();
   // Single constraint per vertex.
   idx_t ncon = 1;
   idx_t* vwgt = NULL;
@@ -110,10 +110,12 @@ void VIMapPartitioner::partitionGraphFromTriplets(
   // Output timing and initial partitioning information.
   options[METIS_OPTION_DBGLVL] = METIS_DBG_TIME | METIS_DBG_IPART;
 
+  // METIS doesn't modify the graph.
   int status = METIS_PartGraphKway(
-      &nvtxs, &ncon, edge_matrix.outerIndexPtr(), edge_matrix.innerIndexPtr(),
-      vwgt, vsize, edge_matrix.valuePtr(), &nparts, tpwgts, ubvec, options,
-      &objval, &partition_indices->front());
+      &nvtxs, &ncon, const_cast<idx_t*>(graph.offsets().data()),
+      const_cast<idx_t*>(graph.neighbors().data()), vwgt, vsize,
+      const_cast<idx_t*>(graph.weights().data()), &nparts, tpwgts, ubvec,
+      options, &objval, &partition_indices->front());
 
   switch (status) {
     case METIS_OK:
@@ -130,9 +132,9 @@ void VIMapPartitioner::partitionGraphFromTriplets(
         LOG(WARNING) << "Experienced a METIS error, will omit the contiguous "
                      << "graph constraint and try again.";
         static constexpr bool kRequireContiguousPartitions = false;
-        partitionGraphFromTriplets(
-            edge_triplets, num_graph_vertices, num_partitions,
-            kRequireContiguousPartitions, partition_indices);
+        partitionGraph(
+            graph, num_partitions, kRequireContiguousPartitions,
+            partition_indices);
       } else {
         LOG(FATAL) << "METIS error.";
       }
@@ -157,7 +159,10 @@ void VIMapPartitioner::getCoobserverEdges(
 
   typedef std::pair<pose_graph::VertexId, size_t> VertexIndexPair;
 
-  vi_map_helpers::VIMapQueries vi_map_queries(map);
+  // All vertices are queried, so build the covisibility of all vertices at
+  // once.
+  const VIMapCovisibilityGraph covisibility_graph(map);
+  vi_map_helpers::VIMapQueries vi_map_queries(map, covisibility_graph);
   unsigned int index = 0u;
   common::ProgressBar progress_bar(num_vertices);
   LOG(INFO) << "Partitioning the graph...";
@@ -8,6 +8,8 @@
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
+#include "vi-map-helpers/vi-map-covisibility-graph.h"
+
 namespace vi_map_helpers {
 
 pose_graph::VertexId getVertexIdWithMostOverlappingLandmarks(
@@ -48,7 +50,12 @@ pose_graph::VertexId getVertexIdWithMostOverlappingLandmarks(
   return largest_overlap_vertex_id;
 }
 
-VIMapQueries::VIMapQueries(const vi_map::VIMap& map) : map_(map) {}
+VIMapQueries::VIMapQueries(const vi_map::VIMap& map)
+    : map_(map), covisibility_graph_(nullptr) {}
+
+VIMapQueries::VIMapQueries(
+    const vi_map::VIMap& map, const VIMapCovisibilityGraph& covisibility_graph)
+    : map_(map), covisibility_graph_(&covisibility_graph) {}
 
 void VIMapQueries::getIdsOfVerticesWithLandmarkObservations(
     pose_graph::VertexIdList* result) {
@@ -378,6 +385,28 @@ int VIMapQueries::getVerticesWithCommonLandmarks(
   CHECK_NOTNULL(coobserver_vertex_ids)->clear();
   CHECK(map_.hasVertex(vertex_id));
 
+  if (covisibility_graph_ != nullptr) {
+    // The vertex itself is part of the result, as below.
+    const int num_own_landmarks =
+        getNumberOfCommonLandmarks(vertex_id, vertex_id);
+    if (num_own_landmarks > 0 &&
+        num_own_landmarks >= min_number_common_landmarks) {
+      coobserver_vertex_ids->emplace_back(num_own_landmarks, vertex_id);
+    }
+    covisibility_graph_->forEachCovisibleVertex(
+        vertex_id, [&](const pose_graph::VertexId& covisible_vertex_id,
+                       const int num_common_landmarks) {
+          if (num_common_landmarks >= min_number_common_landmarks) {
+            coobserver_vertex_ids->emplace_back(
+                num_common_landmarks, covisible_vertex_id);
+          }
+        });
+    std::sort(
+        coobserver_vertex_ids->begin(), coobserver_vertex_ids->end(),
+        VertexCommonLandmarksCountComparator());
+    return coobserver_vertex_ids->size();
+  }
+
   vi_map::LandmarkIdList landmark_ids;
   pose_graph::VertexIdSet visited_vertices;
   map_.getVertexPtr(vertex_id)->getAllObservedLandmarkIds(&landmark_ids);
@@ -410,6 +439,9 @@ int VIMapQueries::getVerticesWithCommonLandmarks(
 int VIMapQueries::getNumberOfCommonLandmarks(
     const pose_graph::VertexId& vertex_1,
     const pose_graph::VertexId& vertex_2) const {
+  if (covisibility_graph_ != nullptr && vertex_1 != vertex_2) {
+    return covisibility_graph_->getNumberOfCommonLandmarks(vertex_1, vertex_2);
+  }
   return getNumberOfCommonLandmarks(vertex_1, vertex_2, nullptr);
 }
 
@@ -462,7 +494,18 @@ int VIMapQueries::getVertexWithMostLandmarksInCommon(
 
   vi_map::LandmarkIdList landmark_ids;
   pose_graph::VertexIdSet visited_vertices;
-  map_.getVertexPtr(vertex_id)->getAllObservedLandmarkIds(&landmark_ids);
+  if (covisibility_graph_ != nullptr) {
+    covisibility_graph_->forEachCovisibleVertex(
+        vertex_id, [&](const pose_graph::VertexId& covisible_vertex_id,
+                       const int num_common_landmarks) {
+          if (num_common_landmarks > max) {
+            max = num_common_landmarks;
+            max_vertex = covisible_vertex_id;
+          }
+        });
+  } else {
+    map_.getVertexPtr(vertex_id)->getAllObservedLandmarkIds(&landmark_ids);
+  }
   for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
     if (landmark_id.isValid()) {
       const vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
@@ -517,6 +560,14 @@ void VIMapQueries::getCoobservingVertices(
 
   pose_graph::VertexIdSet coobserver_candidates;
   for (const pose_graph::VertexId& vertex_id : given_vertices) {
+    if (covisibility_graph_ != nullptr) {
+      covisibility_graph_->forEachCovisibleVertex(
+          vertex_id, [&](const pose_graph::VertexId& covisible_vertex_id,
+                         const int /*num_common_landmarks*/) {
+            coobserver_candidates.insert(covisible_vertex_id);
+          });
+      continue;
+    }
     vi_map::LandmarkIdList landmarks;
     map_.getVertex(vertex_id).getAllObservedLandmarkIds(&landmarks);
     for (const vi_map::LandmarkId& landmark_id : landmarks) {
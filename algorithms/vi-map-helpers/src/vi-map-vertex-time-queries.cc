@@ -1,5 +1,10 @@
 #include "vi-map-helpers/vi-map-vertex-time-queries.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+#include <utility>
+
 #include <glog/logging.h>
 
 namespace vi_map_helpers {
@@ -17,7 +22,6 @@ VIMapVertexTimeQueries::VIMapVertexTimeQueries(
     : map_(map) {
   CHECK(map_);
   CHECK(mission_id.isValid());
-  CHECK(mission_id.isValid());
   pose_graph::VertexIdList vertex_ids;
   map_->getAllVertexIdsInMission(mission_id, &vertex_ids);
   buildVertexIdTimestampIndex(vertex_ids);
@@ -25,20 +29,121 @@ VIMapVertexTimeQueries::VIMapVertexTimeQueries(
 
 void VIMapVertexTimeQueries::buildVertexIdTimestampIndex(
     const pose_graph::VertexIdList& vertex_ids) {
-  vertex_timestamp_index_.clear();
+  std::vector<std::pair<int64_t, pose_graph::VertexId>> timestamped_vertices;
+  timestamped_vertices.reserve(vertex_ids.size());
   for (const pose_graph::VertexIdList::value_type& vertex_id : vertex_ids) {
-    const int64_t vertex_timestamp =
-        map_->getVertex(vertex_id).getMinTimestampNanoseconds();
-    vertex_timestamp_index_.addValue(vertex_timestamp, vertex_id);
+    timestamped_vertices.emplace_back(
+        map_->getVertex(vertex_id).getMinTimestampNanoseconds(), vertex_id);
+  }
+  // Vertices along the graph are usually sorted already.
+  std::stable_sort(
+      timestamped_vertices.begin(), timestamped_vertices.end(),
+      [](const std::pair<int64_t, pose_graph::VertexId>& lhs,
+         const std::pair<int64_t, pose_graph::VertexId>& rhs) {
+        return lhs.first < rhs.first;
+      });
+
+  timestamps_nanoseconds_.clear();
+  timestamps_nanoseconds_.reserve(timestamped_vertices.size());
+  vertex_ids_.clear();
+  vertex_ids_.reserve(timestamped_vertices.size());
+  for (const std::pair<int64_t, pose_graph::VertexId>& timestamped_vertex :
+       timestamped_vertices) {
+    timestamps_nanoseconds_.emplace_back(timestamped_vertex.first);
+    vertex_ids_.emplace_back(timestamped_vertex.second);
   }
 }
 
+size_t VIMapVertexTimeQueries::getClosestIndex(
+    const int64_t timestamp_nanoseconds, const size_t begin_index) const {
+  CHECK(!timestamps_nanoseconds_.empty());
+  CHECK_LT(begin_index, timestamps_nanoseconds_.size());
+  const size_t after_index =
+      std::lower_bound(
+          timestamps_nanoseconds_.begin() + begin_index,
+          timestamps_nanoseconds_.end(), timestamp_nanoseconds) -
+      timestamps_nanoseconds_.begin();
+  if (after_index == timestamps_nanoseconds_.size()) {
+    return after_index - 1u;
+  }
+  if (after_index == begin_index) {
+    return after_index;
+  }
+  // Prefer the later vertex on ties, as common::TemporalBuffer does.
+  const size_t before_index = after_index - 1u;
+  return (timestamp_nanoseconds - timestamps_nanoseconds_[before_index] <
+          timestamps_nanoseconds_[after_index] - timestamp_nanoseconds)
+             ? before_index
+             : after_index;
+}
+
 bool VIMapVertexTimeQueries::getClosestVertexInTime(
     const int64_t timestamp_nanoseconds,
     pose_graph::VertexId* vertex_id) const {
+  return getClosestVertexInTime(
+      timestamp_nanoseconds, std::numeric_limits<int64_t>::max(), vertex_id);
+}
+
+bool VIMapVertexTimeQueries::getClosestVertexInTime(
+    const int64_t timestamp_nanoseconds, const int64_t max_delta_nanoseconds,
+    pose_graph::VertexId* vertex_id) const {
   CHECK_NOTNULL(vertex_id)->setInvalid();
-  return vertex_timestamp_index_.getNearestValueToTime(
-      timestamp_nanoseconds, vertex_id);
+  if (timestamps_nanoseconds_.empty()) {
+    return false;
+  }
+  const size_t index = getClosestIndex(timestamp_nanoseconds, 0u);
+  if (std::abs(timestamps_nanoseconds_[index] - timestamp_nanoseconds) >
+      max_delta_nanoseconds) {
+    return false;
+  }
+  *vertex_id = vertex_ids_[index];
+  return true;
+}
+
+void VIMapVertexTimeQueries::getVerticesInTimeRange(
+    const int64_t begin_timestamp_nanoseconds,
+    const int64_t end_timestamp_nanoseconds,
+    pose_graph::VertexIdList* vertex_ids) const {
+  CHECK_NOTNULL(vertex_ids)->clear();
+  CHECK_LE(begin_timestamp_nanoseconds, end_timestamp_nanoseconds);
+  const std::vector<int64_t>::const_iterator begin = std::lower_bound(
+      timestamps_nanoseconds_.begin(), timestamps_nanoseconds_.end(),
+      begin_timestamp_nanoseconds);
+  const std::vector<int64_t>::const_iterator end = std::upper_bound(
+      begin, timestamps_nanoseconds_.end(), end_timestamp_nanoseconds);
+  vertex_ids->assign(
+      vertex_ids_.begin() + (begin - timestamps_nanoseconds_.begin()),
+      vertex_ids_.begin() + (end - timestamps_nanoseconds_.begin()));
+}
+
+size_t VIMapVertexTimeQueries::getClosestVerticesInTime(
+    const std::vector<int64_t>& sorted_timestamps_nanoseconds,
+    pose_graph::VertexIdList* vertex_ids,
+    const int64_t max_delta_nanoseconds) const {
+  CHECK_NOTNULL(vertex_ids)->clear();
+  vertex_ids->resize(sorted_timestamps_nanoseconds.size());
+  if (timestamps_nanoseconds_.empty()) {
+    return 0u;
+  }
+  CHECK(std::is_sorted(
+      sorted_timestamps_nanoseconds.begin(),
+      sorted_timestamps_nanoseconds.end()));
+
+  size_t num_valid_vertex_ids = 0u;
+  size_t index = 0u;
+  for (size_t query_idx = 0u; query_idx < sorted_timestamps_nanoseconds.size();
+       ++query_idx) {
+    const int64_t timestamp_nanoseconds =
+        sorted_timestamps_nanoseconds[query_idx];
+    // The closest vertex of a later query is never before the previous one.
+    index = getClosestIndex(timestamp_nanoseconds, index);
+    if (std::abs(timestamps_nanoseconds_[index] - timestamp_nanoseconds) <=
+        max_delta_nanoseconds) {
+      (*vertex_ids)[query_idx] = vertex_ids_[index];
+      ++num_valid_vertex_ids;
+    }
+  }
+  return num_valid_vertex_ids;
 }
 
 VIMapMissionsVertexTimeQueries::VIMapMissionsVertexTimeQueries(
@@ -57,8 +162,15 @@ VIMapMissionsVertexTimeQueries::VIMapMissionsVertexTimeQueries(
 bool VIMapMissionsVertexTimeQueries::getClosestVertexInTimeForMission(
     const int64_t timestamp_nanoseconds, const vi_map::MissionId& mission_id,
     pose_graph::VertexId* vertex_id) const {
-  CHECK(mission_id.isValid());
   CHECK_NOTNULL(vertex_id)->setInvalid();
+  return getIndexForMission(mission_id)
+      .getClosestVertexInTime(timestamp_nanoseconds, vertex_id);
+}
+
+const VIMapVertexTimeQueries&
+VIMapMissionsVertexTimeQueries::getIndexForMission(
+    const vi_map::MissionId& mission_id) const {
+  CHECK(mission_id.isValid());
   std::unordered_map<vi_map::MissionId, VIMapVertexTimeQueries>::const_iterator
       vertex_timestamp_index_iterator =
           mission_to_vertex_timestamp_index_map_.find(mission_id);
@@ -66,8 +178,7 @@ bool VIMapMissionsVertexTimeQueries::getClosestVertexInTimeForMission(
         mission_to_vertex_timestamp_index_map_.end())
       << "There is no vertex-timestamp-index available for mission "
       << mission_id.hexString();
-  return vertex_timestamp_index_iterator->second.getClosestVertexInTime(
-      timestamp_nanoseconds, vertex_id);
+  return vertex_timestamp_index_iterator->second;
 }
 
 }  // namespace vi_map_helpers
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-generator.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/adaptive-spatial-database.h"
+#include "vi-map-helpers/vi-map-global-position-cache.h"
+
+namespace vi_map_helpers {
+
+class AdaptiveSpatialDatabaseTest : public ::testing::Test {
+ protected:
+  AdaptiveSpatialDatabaseTest() : generator_(map_, 42), random_engine_(42) {}
+
+  void SetUp() override {
+    // A dense cluster next to a long and sparse traverse.
+    const vi_map::MissionId mission_id = generator_.createMission();
+    std::uniform_real_distribution<double> cluster_distribution(0.0, 2.0);
+    for (int i = 0; i < kNumClusterVertices; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << cluster_distribution(random_engine_),
+          cluster_distribution(random_engine_),
+          cluster_distribution(random_engine_);
+      addVertexWithLandmark(mission_id, T_G_I);
+    }
+    for (int i = 1; i <= kNumTraverseVertices; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << 20.0 * i, 0.0, 1.0;
+      addVertexWithLandmark(mission_id, T_G_I);
+    }
+    generator_.generateMap();
+  }
+
+  void addVertexWithLandmark(
+      const vi_map::MissionId& mission_id, const pose::Transformation& T_G_I) {
+    const pose_graph::VertexId vertex_id =
+        generator_.createVertex(mission_id, T_G_I);
+    const Eigen::Vector3d p_G_fi =
+        T_G_I.getPosition() + Eigen::Vector3d(0.1, -0.2, 0.3);
+    generator_.createLandmark(p_G_fi, vertex_id, {});
+  }
+
+  template <typename ObjectIdType>
+  void getObjectIdsInRadiusBruteForce(
+      const VIMapGlobalPositionCache& cache, const Eigen::Vector3d& p_G_center,
+      const double radius, std::vector<ObjectIdType>* object_ids) const;
+
+  // Query centers in and around the cluster and along the traverse.
+  Eigen::Matrix3Xd getQueryCenters() {
+    constexpr int kNumQueries = 50;
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    Eigen::Matrix3Xd p_G_centers(3, kNumQueries);
+    for (int i = 0; i < kNumQueries; ++i) {
+      const double scale = (i % 2 == 0) ? 2.0 : 20.0 * kNumTraverseVertices;
+      p_G_centers.col(i) << scale * distribution(random_engine_),
+          2.0 * distribution(random_engine_), distribution(random_engine_);
+    }
+    return p_G_centers;
+  }
+
+  static constexpr int kNumClusterVertices = 200;
+  static constexpr int kNumTraverseVertices = 20;
+
+  vi_map::VIMap map_;
+  vi_map::VIMapGenerator generator_;
+  std::mt19937 random_engine_;
+};
+
+template <>
+void AdaptiveSpatialDatabaseTest::getObjectIdsInRadiusBruteForce(
+    const VIMapGlobalPositionCache& cache, const Eigen::Vector3d& p_G_center,
+    const double radius, std::vector<pose_graph::VertexId>* object_ids) const {
+  CHECK_NOTNULL(object_ids)->clear();
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if ((cache.getVertex_T_G_I(vertex_id).getPosition() - p_G_center).norm() <=
+        radius) {
+      object_ids->emplace_back(vertex_id);
+    }
+  }
+}
+
+template <>
+void AdaptiveSpatialDatabaseTest::getObjectIdsInRadiusBruteForce(
+    const VIMapGlobalPositionCache& cache, const Eigen::Vector3d& p_G_center,
+    const double radius, std::vector<vi_map::LandmarkId>* object_ids) const {
+  CHECK_NOTNULL(object_ids)->clear();
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    if ((cache.getLandmark_G_p_fi(landmark_id) - p_G_center).norm() <= radius) {
+      object_ids->emplace_back(landmark_id);
+    }
+  }
+}
+
+TEST_F(AdaptiveSpatialDatabaseTest, RadiusQueriesMatchBruteForce) {
+  const VIMapGlobalPositionCache cache(map_);
+  constexpr double kMinLeafSizeMeters = 0.05;
+  constexpr size_t kMaxObjectsPerLeaf = 4u;
+  const AdaptiveSpatialDatabase<pose_graph::VertexId> vertex_database(
+      map_, cache, kMinLeafSizeMeters, kMaxObjectsPerLeaf);
+  const AdaptiveSpatialDatabase<vi_map::LandmarkId> landmark_database(
+      map_, cache, kMinLeafSizeMeters, kMaxObjectsPerLeaf);
+  ASSERT_EQ(
+      vertex_database.size(),
+      static_cast<size_t>(kNumClusterVertices + kNumTraverseVertices));
+  ASSERT_EQ(landmark_database.size(), vertex_database.size());
+
+  const Eigen::Matrix3Xd p_G_centers = getQueryCenters();
+  for (const double radius : {0.3, 1.0, 25.0, 1000.0}) {
+    for (int i = 0; i < p_G_centers.cols(); ++i) {
+      std::vector<pose_graph::VertexId> vertex_ids, expected_vertex_ids;
+      vertex_database.getObjectIdsInRadius(
+          p_G_centers.col(i), radius, &vertex_ids);
+      getObjectIdsInRadiusBruteForce(
+          cache, p_G_centers.col(i), radius, &expected_vertex_ids);
+      std::sort(vertex_ids.begin(), vertex_ids.end());
+      std::sort(expected_vertex_ids.begin(), expected_vertex_ids.end());
+      EXPECT_EQ(vertex_ids, expected_vertex_ids);
+
+      std::vector<vi_map::LandmarkId> landmark_ids, expected_landmark_ids;
+      landmark_database.getObjectIdsInRadius(
+          p_G_centers.col(i), radius, &landmark_ids);
+      getObjectIdsInRadiusBruteForce(
+          cache, p_G_centers.col(i), radius, &expected_landmark_ids);
+      std::sort(landmark_ids.begin(), landmark_ids.end());
+      std::sort(expected_landmark_ids.begin(), expected_landmark_ids.end());
+      EXPECT_EQ(landmark_ids, expected_landmark_ids);
+    }
+  }
+}
+
+TEST_F(AdaptiveSpatialDatabaseTest, BatchedQueriesMatchSingleQueries) {
+  constexpr double kMinLeafSizeMeters = 0.1;
+  const AdaptiveSpatialDatabase<pose_graph::VertexId> database(
+      map_, kMinLeafSizeMeters);
+  const Eigen::Matrix3Xd p_G_centers = getQueryCenters();
+  constexpr double kRadiusMeters = 1.5;
+
+  std::vector<std::vector<pose_graph::VertexId>> batched_vertex_ids;
+  // Run twice to make sure the reused buffers are cleared.
+  for (int run = 0; run < 2; ++run) {
+    database.getObjectIdsInRadius(
+        p_G_centers, kRadiusMeters, &batched_vertex_ids);
+    ASSERT_EQ(
+        batched_vertex_ids.size(), static_cast<size_t>(p_G_centers.cols()));
+    for (int i = 0; i < p_G_centers.cols(); ++i) {
+      std::vector<pose_graph::VertexId> vertex_ids;
+      database.getObjectIdsInRadius(
+          p_G_centers.col(i), kRadiusMeters, &vertex_ids);
+      EXPECT_EQ(batched_vertex_ids[i], vertex_ids);
+    }
+  }
+}
+
+TEST_F(AdaptiveSpatialDatabaseTest, CellSizeAdaptsToDensity) {
+  constexpr double kMinLeafSizeMeters = 0.05;
+  constexpr size_t kMaxObjectsPerLeaf = 8u;
+  const AdaptiveSpatialDatabase<pose_graph::VertexId> database(
+      map_, kMinLeafSizeMeters, kMaxObjectsPerLeaf);
+
+  // The cluster is split into small cells, but the traverse doesn't allocate
+  // the empty cells between its vertices.
+  EXPECT_GE(database.getSmallestLeafSize(), kMinLeafSizeMeters);
+  EXPECT_LT(database.getSmallestLeafSize(), 2.0);
+  EXPECT_LT(
+      database.numCells(),
+      static_cast<size_t>(kNumClusterVertices + kNumTraverseVertices));
+  EXPECT_LE(database.numLeaves(), database.numCells());
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,83 @@
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/check-map-consistency.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/benchmark-map-generator.h"
+
+namespace vi_map_helpers {
+
+class BenchmarkMapGeneratorTest : public ::testing::Test {
+ protected:
+  BenchmarkMapGeneratorTest() {
+    options_.num_missions = 3u;
+    options_.num_vertices_per_mission = 30u;
+    options_.num_landmarks_per_frame = 20u;
+    options_.num_observations_per_landmark = 4u;
+    options_.cross_mission_overlap = 0.2;
+  }
+
+  BenchmarkMapOptions options_;
+};
+
+TEST_F(BenchmarkMapGeneratorTest, TestMapSizeAndConsistency) {
+  for (const bool use_imu_edges : {true, false}) {
+    options_.use_imu_edges = use_imu_edges;
+    const BenchmarkMapGenerator generator(options_);
+    vi_map::VIMap map;
+    generator.generateMap(&map);
+
+    EXPECT_TRUE(vi_map::checkMapConsistency(map));
+    EXPECT_EQ(options_.num_missions, map.numMissions());
+    EXPECT_EQ(
+        options_.num_missions * options_.num_vertices_per_mission,
+        map.numVertices());
+    EXPECT_EQ(
+        options_.num_missions * (options_.num_vertices_per_mission - 1u),
+        map.numEdges());
+    EXPECT_EQ(generator.numLandmarks(), map.numLandmarks());
+    // 5 landmarks per vertex in the first mission, 4 plus 4 overlapping ones
+    // in the others.
+    EXPECT_EQ(
+        options_.num_vertices_per_mission * (5u + 2u * 4u),
+        generator.numLandmarks());
+  }
+}
+
+TEST_F(BenchmarkMapGeneratorTest, TestObservationsAreNoiseFree) {
+  const BenchmarkMapGenerator generator(options_);
+  vi_map::VIMap map;
+  generator.generateMap(&map);
+
+  constexpr double kPrecisionPixels = 1e-6;
+  size_t num_observations = 0u;
+  map.forEachLandmark([&](const vi_map::Landmark& landmark) {
+    EXPECT_LE(
+        landmark.numberOfObservations(),
+        options_.num_observations_per_landmark + options_.num_missions - 1u);
+    landmark.forEachObservation(
+        [&](const vi_map::KeypointIdentifier& observation) {
+          const vi_map::Vertex& vertex =
+              map.getVertex(observation.frame_id.vertex_id);
+          EXPECT_EQ(
+              landmark.id(), vertex.getObservedLandmarkId(observation));
+          Eigen::Vector2d projection;
+          vertex.getCamera(observation.frame_id.frame_index)
+              ->project3(
+                  map.getLandmark_p_C_fi(
+                      landmark.id(), vertex, observation.frame_id.frame_index),
+                  &projection);
+          const Eigen::Vector2d keypoint =
+              vertex.getVisualFrame(observation.frame_id.frame_index)
+                  .getKeypointMeasurement(observation.keypoint_index);
+          EXPECT_NEAR(0.0, (projection - keypoint).norm(), kPrecisionPixels);
+          ++num_observations;
+        });
+  });
+  EXPECT_GT(num_observations, map.numLandmarks());
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,151 @@
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-covisibility-graph.h"
+#include "vi-map-helpers/vi-map-queries.h"
+
+namespace vi_map_helpers {
+
+class VIMapCovisibilityGraphTest : public ::testing::Test {
+ protected:
+  typedef std::unordered_map<pose_graph::VertexId, int> CovisibilityMap;
+
+  void SetUp() override {
+    vi_map::test::generateMap(&map_);
+    map_.getAllVertexIds(&vertex_ids_);
+    ASSERT_FALSE(vertex_ids_.empty());
+  }
+
+  static CovisibilityMap getCovisibleVertices(
+      const VIMapCovisibilityGraph& graph,
+      const pose_graph::VertexId& vertex_id) {
+    CovisibilityMap covisible_vertices;
+    graph.forEachCovisibleVertex(
+        vertex_id, [&](const pose_graph::VertexId& covisible_vertex_id,
+                       const int num_common_landmarks) {
+          EXPECT_TRUE(
+              covisible_vertices.emplace(covisible_vertex_id,
+                                         num_common_landmarks)
+                  .second);
+        });
+    return covisible_vertices;
+  }
+
+  // Counts the distinct common landmarks by intersecting the landmark sets.
+  CovisibilityMap getCovisibleVerticesFromMap(
+      const pose_graph::VertexId& vertex_id) const {
+    VIMapQueries queries(map_);
+    vi_map::LandmarkIdSet landmark_ids;
+    queries.getIdsOfLandmarksObservedByVertex(vertex_id, &landmark_ids);
+    CovisibilityMap covisible_vertices;
+    for (const pose_graph::VertexId& other_vertex_id : vertex_ids_) {
+      if (other_vertex_id == vertex_id) {
+        continue;
+      }
+      vi_map::LandmarkIdSet other_landmark_ids;
+      queries.getIdsOfLandmarksObservedByVertex(
+          other_vertex_id, &other_landmark_ids);
+      int num_common_landmarks = 0;
+      for (const vi_map::LandmarkId& landmark_id : other_landmark_ids) {
+        num_common_landmarks += landmark_ids.count(landmark_id);
+      }
+      if (num_common_landmarks > 0) {
+        covisible_vertices.emplace(other_vertex_id, num_common_landmarks);
+      }
+    }
+    return covisible_vertices;
+  }
+
+  void expectGraphMatchesMap(const VIMapCovisibilityGraph& graph) const {
+    size_t num_directed_edges = 0u;
+    for (const pose_graph::VertexId& vertex_id : vertex_ids_) {
+      const CovisibilityMap covisible_vertices =
+          getCovisibleVerticesFromMap(vertex_id);
+      EXPECT_EQ(covisible_vertices, getCovisibleVertices(graph, vertex_id));
+      for (const CovisibilityMap::value_type& covisible_vertex :
+           covisible_vertices) {
+        EXPECT_EQ(
+            covisible_vertex.second,
+            graph.getNumberOfCommonLandmarks(
+                vertex_id, covisible_vertex.first));
+      }
+      num_directed_edges += covisible_vertices.size();
+    }
+    EXPECT_EQ(num_directed_edges / 2u, graph.numEdges());
+  }
+
+  vi_map::VIMap map_;
+  pose_graph::VertexIdList vertex_ids_;
+};
+
+TEST_F(VIMapCovisibilityGraphTest, MatchesLandmarkIntersections) {
+  const VIMapCovisibilityGraph graph(map_);
+  EXPECT_GT(graph.numEdges(), 0u);
+  expectGraphMatchesMap(graph);
+}
+
+TEST_F(VIMapCovisibilityGraphTest, IsUpdatedOnLandmarkRemovalAndMerge) {
+  VIMapCovisibilityGraph graph(map_);
+
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_GE(landmark_ids.size(), 4u);
+
+  graph.removeLandmark(landmark_ids[0]);
+  map_.removeLandmark(landmark_ids[0]);
+  expectGraphMatchesMap(graph);
+
+  // Merging landmarks of vertices far apart creates new adjacencies.
+  graph.mergeLandmarks(landmark_ids[1], landmark_ids.back());
+  map_.mergeLandmarks(landmark_ids[1], landmark_ids.back());
+  graph.mergeLandmarks(landmark_ids[2], landmark_ids[3]);
+  map_.mergeLandmarks(landmark_ids[2], landmark_ids[3]);
+  expectGraphMatchesMap(graph);
+
+  graph.rebuild();
+  expectGraphMatchesMap(graph);
+}
+
+TEST_F(VIMapCovisibilityGraphTest, QueriesReadFromTheGraph) {
+  const VIMapCovisibilityGraph graph(map_);
+  const VIMapQueries queries(map_, graph);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids_) {
+    const CovisibilityMap covisible_vertices =
+        getCovisibleVerticesFromMap(vertex_id);
+
+    constexpr int kMinNumCommonLandmarks = 1;
+    VIMapQueries::VertexCommonLandmarksCountVector counts;
+    queries.getVerticesWithCommonLandmarks(
+        vertex_id, kMinNumCommonLandmarks, &counts);
+    CovisibilityMap queried_vertices;
+    for (const VIMapQueries::VertexCommonLandmarksCount& count : counts) {
+      if (count.vertex_id != vertex_id) {
+        queried_vertices.emplace(count.vertex_id, count.in_common);
+      }
+    }
+    EXPECT_EQ(covisible_vertices, queried_vertices);
+
+    if (!covisible_vertices.empty()) {
+      pose_graph::VertexId best_vertex_id;
+      const int max_num_common_landmarks =
+          queries.getVertexWithMostLandmarksInCommon(
+              vertex_id, &best_vertex_id);
+      EXPECT_EQ(
+          max_num_common_landmarks,
+          common::getChecked(covisible_vertices, best_vertex_id));
+      for (const CovisibilityMap::value_type& covisible_vertex :
+           covisible_vertices) {
+        EXPECT_LE(covisible_vertex.second, max_num_common_landmarks);
+      }
+    }
+  }
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
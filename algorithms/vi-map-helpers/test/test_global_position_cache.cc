@@ -0,0 +1,77 @@
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-global-position-cache.h"
+
+namespace vi_map_helpers {
+
+class VIMapGlobalPositionCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    vi_map::test::generateMap(&map_);
+  }
+
+  void expectCacheMatchesMap(const VIMapGlobalPositionCache& cache) const {
+    constexpr double kPrecision = 1e-9;
+    pose_graph::VertexIdList vertex_ids;
+    map_.getAllVertexIds(&vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      EXPECT_NEAR_EIGEN(
+          cache.getVertex_T_G_I(vertex_id).getTransformationMatrix(),
+          map_.getVertex_T_G_I(vertex_id).getTransformationMatrix(),
+          kPrecision);
+    }
+    vi_map::LandmarkIdList landmark_ids;
+    map_.getAllLandmarkIds(&landmark_ids);
+    ASSERT_FALSE(landmark_ids.empty());
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      EXPECT_NEAR_EIGEN(
+          cache.getLandmark_G_p_fi(landmark_id),
+          map_.getLandmark_G_p_fi(landmark_id), kPrecision);
+    }
+  }
+
+  vi_map::VIMap map_;
+};
+
+TEST_F(VIMapGlobalPositionCacheTest, MatchesMapQueries) {
+  VIMapGlobalPositionCache cache(map_);
+  ASSERT_TRUE(cache.isUpToDate());
+  expectCacheMatchesMap(cache);
+  EXPECT_EQ(
+      static_cast<size_t>(cache.getLandmarkPositions_G().cols()),
+      map_.numLandmarkDenseIndices());
+}
+
+TEST_F(VIMapGlobalPositionCacheTest, RecomputesOnlyInvalidatedVertices) {
+  VIMapGlobalPositionCache cache(map_);
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  vi_map::Vertex& vertex = map_.getVertex(vertex_ids.front());
+  pose::Transformation T_delta;
+  T_delta.getPosition() << 1.0, -2.0, 0.5;
+  vertex.set_T_M_I(T_delta * vertex.get_T_M_I());
+  cache.invalidateVertex(vertex.id());
+  cache.invalidateVertex(vertex.id());
+  EXPECT_FALSE(cache.isUpToDate());
+  EXPECT_EQ(cache.update(), 1u);
+  expectCacheMatchesMap(cache);
+
+  const vi_map::MissionId& mission_id = vertex.getMissionId();
+  vi_map::MissionBaseFrame& baseframe =
+      map_.getMissionBaseFrameForMission(mission_id);
+  baseframe.set_T_G_M(T_delta * baseframe.get_T_G_M());
+  cache.invalidateMission(mission_id);
+  EXPECT_EQ(cache.update(), map_.numVerticesInMission(mission_id));
+  expectCacheMatchesMap(cache);
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
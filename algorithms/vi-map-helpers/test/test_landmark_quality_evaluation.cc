@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/landmark-quality-metrics.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-landmark-quality-evaluation.h"
+
+namespace vi_map_helpers {
+
+class LandmarkQualityEvaluationTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    vi_map::test::generateMap(&map_);
+  }
+
+  vi_map::VIMap map_;
+};
+
+TEST_F(LandmarkQualityEvaluationTest, MatchesSingleLandmarkEvaluation) {
+  const uint64_t landmark_revision = map_.getLandmarkRevision();
+  evaluateLandmarkQuality(&map_);
+  EXPECT_NE(map_.getLandmarkRevision(), landmark_revision);
+
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_FALSE(landmark_ids.empty());
+  constexpr bool kReEvaluateQuality = true;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    const vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
+    ASSERT_NE(landmark.getQuality(), vi_map::Landmark::Quality::kUnknown);
+    EXPECT_EQ(
+        landmark.getQuality() == vi_map::Landmark::Quality::kGood,
+        vi_map::isLandmarkWellConstrained(map_, landmark, kReEvaluateQuality));
+  }
+
+  resetLandmarkQualityToUnknown(&map_);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    EXPECT_EQ(
+        map_.getLandmark(landmark_id).getQuality(),
+        vi_map::Landmark::Quality::kUnknown);
+  }
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
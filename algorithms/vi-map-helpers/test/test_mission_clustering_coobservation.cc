@@ -107,6 +107,26 @@ TEST(MissionClusteringCoobservation, ClusterMissionByLandmarkCoobservations) {
   EXPECT_TRUE(clustersEqualWithoutOrdering(expected_clusters, clusters));
 }
 
+TEST(MissionClusteringCoobservation, HasCommonObservations) {
+  vi_map::VIMap map;
+  vi_map::MissionIdList M;
+  createTestMap(&map, &M);
+
+  // Observations of mission 2 are ignored.
+  vi_map::MissionIdSet mission_to_query(M.begin(), M.end());
+  mission_to_query.erase(M[2]);
+  MissionCoobservationCachedQuery query(map, mission_to_query);
+
+  EXPECT_TRUE(query.hasCommonObservations(M[0], {M[1]}));
+  EXPECT_TRUE(query.hasCommonObservations(M[1], {M[3], M[0]}));
+  EXPECT_FALSE(query.hasCommonObservations(M[3], {M[0], M[1], M[4]}));
+  EXPECT_FALSE(query.hasCommonObservations(M[4], {M[6]}));
+  EXPECT_TRUE(query.hasCommonObservations(M[5], {M[4]}));
+  // Missions observing any landmark coobserve with themselves.
+  EXPECT_TRUE(query.hasCommonObservations(M[6], {M[6]}));
+  EXPECT_FALSE(query.hasCommonObservations(M[6], {}));
+}
+
 }  // namespace vi_map_helpers
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <limits>
 #include <random>
+#include <vector>
 
 #include <Eigen/Core>
 #include <gtest/gtest.h>
@@ -505,6 +508,99 @@ TEST(VIMapNearestNeighborLookupTest, MultipleUTMMeasurementsRadiusLookup) {
   }
 }
 
+TEST(VIMapNearestNeighborLookupTest, BatchedQueriesMatchSingleQueries) {
+  vi_map::VIMap map;
+  vi_map::VIMapGenerator generator(map, kSeed);
+  const vi_map::MissionId mission_id = generator.createMission();
+  CHECK(mission_id.isValid());
+
+  srand(kSeed);
+
+  const size_t kNumVertices = 50u;
+  MeasurementsList p_G_Is;
+  VertexIdToMeasurementMap vertex_id_to_data_item_map;
+  for (size_t idx = 0u; idx < kNumVertices; ++idx) {
+    aslam::Transformation T_G_I;
+    T_G_I.getPosition() = 1e3 * Eigen::Vector3d::Random();
+    const pose_graph::VertexId vertex_id =
+        generator.createVertex(mission_id, T_G_I);
+    CHECK(vertex_id.isValid());
+    const Eigen::VectorXd p_G_I = queryTypeToVector(T_G_I.getPosition());
+    p_G_Is.emplace_back(p_G_I);
+    vertex_id_to_data_item_map.emplace(vertex_id, p_G_I);
+  }
+  generator.generateMap();
+
+  VIMapNearestNeighborLookupVertexId nn_query_database(map);
+
+  const size_t kNumQueries = 100u;
+  Aligned<std::vector, aslam::Position3D> p_G_I_queries;
+  for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+    p_G_I_queries.emplace_back(1e3 * Eigen::Vector3d::Random());
+  }
+  const Eigen::MatrixXd queries = queryTypesToMatrix(p_G_I_queries);
+  ASSERT_EQ(queries.cols(), static_cast<int>(kNumQueries));
+
+  pose_graph::VertexIdList closest_vertex_ids;
+  std::vector<bool> has_closest_vertex;
+  nn_query_database.getClosestDataItems(
+      queries, &closest_vertex_ids, &has_closest_vertex);
+  ASSERT_EQ(closest_vertex_ids.size(), kNumQueries);
+  ASSERT_EQ(has_closest_vertex.size(), kNumQueries);
+  for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+    pose_graph::VertexId closest_vertex_id;
+    nn_query_database.getClosestDataItem(
+        p_G_I_queries[query_idx], &closest_vertex_id);
+    EXPECT_TRUE(has_closest_vertex[query_idx]);
+    EXPECT_EQ(closest_vertex_ids[query_idx], closest_vertex_id);
+  }
+
+  // The k-NN distances are sorted and match the brute-force search. The
+  // buffers are reused by the second call.
+  constexpr int kNumNeighbors = 5;
+  Eigen::MatrixXi indices;
+  Eigen::MatrixXd distances_squared;
+  for (const double search_radius :
+       {std::numeric_limits<double>::infinity(), 300.0}) {
+    nn_query_database.getKClosestDataItemIndices(
+        queries, kNumNeighbors, search_radius, &indices, &distances_squared);
+    ASSERT_EQ(indices.rows(), kNumNeighbors);
+    ASSERT_EQ(indices.cols(), static_cast<int>(kNumQueries));
+    for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+      std::vector<double> ground_truth_distances_squared;
+      for (const Eigen::VectorXd& p_G_I : p_G_Is) {
+        const double distance = (queries.col(query_idx) - p_G_I).norm();
+        if (distance <= search_radius) {
+          ground_truth_distances_squared.push_back(distance * distance);
+        }
+      }
+      std::sort(
+          ground_truth_distances_squared.begin(),
+          ground_truth_distances_squared.end());
+      for (int neighbor_idx = 0; neighbor_idx < kNumNeighbors;
+           ++neighbor_idx) {
+        if (neighbor_idx <
+            static_cast<int>(ground_truth_distances_squared.size())) {
+          ASSERT_GE(indices(neighbor_idx, query_idx), 0);
+          EXPECT_NEAR(
+              distances_squared(neighbor_idx, query_idx),
+              ground_truth_distances_squared[neighbor_idx], 1e-6);
+          const pose_graph::VertexId& vertex_id =
+              nn_query_database.getDataItem(indices(neighbor_idx, query_idx));
+          VertexIdToMeasurementMap::const_iterator p_G_I_iterator =
+              vertex_id_to_data_item_map.find(vertex_id);
+          ASSERT_TRUE(p_G_I_iterator != vertex_id_to_data_item_map.end());
+          EXPECT_NEAR(
+              (queries.col(query_idx) - p_G_I_iterator->second).squaredNorm(),
+              distances_squared(neighbor_idx, query_idx), 1e-6);
+        } else {
+          EXPECT_EQ(indices(neighbor_idx, query_idx), -1);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace vi_map_helpers
 
 MAPLAB_UNITTEST_ENTRYPOINT
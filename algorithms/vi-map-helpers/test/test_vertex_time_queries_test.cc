@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <vector>
+
 #include <aslam/common/pose-types.h>
 #include <Eigen/Core>
 #include <gtest/gtest.h>
@@ -134,6 +137,91 @@ TEST(VertexTimeQueriesTest, TestTimeQueriesSingleAndMultiMission) {
   }
 }
 
+TEST(VertexTimeQueriesTest, TestRangeAndBatchQueries) {
+  vi_map::VIMap::Ptr map(new vi_map::VIMap);
+  const int kSeed = 42;
+  vi_map::VIMapGenerator generator(*map, kSeed);
+
+  std::default_random_engine random_number_engine(kSeed);
+  std::uniform_int_distribution<int64_t> timestamp_distribution(0, 1e12);
+
+  const vi_map::MissionId mission_id = generator.createMission();
+  constexpr size_t kNumVertices = 200u;
+  for (size_t vertex_idx = 0u; vertex_idx < kNumVertices; ++vertex_idx) {
+    const aslam::Transformation T_M_I(aslam::Quaternion(),
+                                      aslam::Position3D::Random());
+    generator.createVertex(mission_id, T_M_I,
+                           timestamp_distribution(random_number_engine));
+  }
+  generator.generateMap();
+
+  VIMapVertexTimeQueries vertex_time_index(map, mission_id);
+  ASSERT_EQ(vertex_time_index.size(), kNumVertices);
+
+  const int64_t kBeginTimestampNanoseconds = 2e11;
+  const int64_t kEndTimestampNanoseconds = 5e11;
+  pose_graph::VertexIdList vertex_ids_in_range;
+  vertex_time_index.getVerticesInTimeRange(
+      kBeginTimestampNanoseconds, kEndTimestampNanoseconds,
+      &vertex_ids_in_range);
+  pose_graph::VertexIdList all_vertex_ids;
+  map->getAllVertexIdsInMission(mission_id, &all_vertex_ids);
+  size_t num_expected_vertices_in_range = 0u;
+  for (const pose_graph::VertexId& vertex_id : all_vertex_ids) {
+    const int64_t timestamp_nanoseconds =
+        map->getVertex(vertex_id).getMinTimestampNanoseconds();
+    if (timestamp_nanoseconds >= kBeginTimestampNanoseconds &&
+        timestamp_nanoseconds <= kEndTimestampNanoseconds) {
+      ++num_expected_vertices_in_range;
+    }
+  }
+  EXPECT_EQ(vertex_ids_in_range.size(), num_expected_vertices_in_range);
+  for (size_t idx = 0u; idx < vertex_ids_in_range.size(); ++idx) {
+    const int64_t timestamp_nanoseconds =
+        map->getVertex(vertex_ids_in_range[idx]).getMinTimestampNanoseconds();
+    EXPECT_GE(timestamp_nanoseconds, kBeginTimestampNanoseconds);
+    EXPECT_LE(timestamp_nanoseconds, kEndTimestampNanoseconds);
+    if (idx > 0u) {
+      EXPECT_LE(
+          map->getVertex(vertex_ids_in_range[idx - 1u])
+              .getMinTimestampNanoseconds(),
+          timestamp_nanoseconds);
+    }
+  }
+
+  constexpr size_t kNumQueries = 50u;
+  std::vector<int64_t> query_timestamps_nanoseconds;
+  for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+    query_timestamps_nanoseconds.push_back(
+        timestamp_distribution(random_number_engine));
+  }
+  std::sort(
+      query_timestamps_nanoseconds.begin(),
+      query_timestamps_nanoseconds.end());
+
+  pose_graph::VertexIdList nn_vertex_ids;
+  EXPECT_EQ(
+      vertex_time_index.getClosestVerticesInTime(
+          query_timestamps_nanoseconds, &nn_vertex_ids),
+      kNumQueries);
+  ASSERT_EQ(nn_vertex_ids.size(), kNumQueries);
+  for (size_t query_idx = 0u; query_idx < kNumQueries; ++query_idx) {
+    EXPECT_EQ(
+        nn_vertex_ids[query_idx],
+        getGroundTruthVertexIdClosestInTime(
+            query_timestamps_nanoseconds[query_idx], mission_id, map));
+  }
+
+  // No vertex is within 0ns of a timestamp before the first vertex.
+  const std::vector<int64_t> kEarlyTimestampNanoseconds{-1};
+  EXPECT_EQ(
+      vertex_time_index.getClosestVerticesInTime(
+          kEarlyTimestampNanoseconds, &nn_vertex_ids, 0),
+      0u);
+  ASSERT_EQ(nn_vertex_ids.size(), 1u);
+  EXPECT_FALSE(nn_vertex_ids[0].isValid());
+}
+
 }  // namespace vi_map_helpers
 
 MAPLAB_UNITTEST_ENTRYPOINT
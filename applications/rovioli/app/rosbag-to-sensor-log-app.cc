@@ -0,0 +1,76 @@
+#include <future>
+#include <memory>
+
+#include <aslam/cameras/ncamera.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <ros/ros.h>
+#include <sensors/imu.h>
+#include <sensors/sensor-factory.h>
+
+#include "rovioli/datasource-factory.h"
+#include "rovioli/sensor-log.h"
+
+DEFINE_string(
+    ncamera_calibration, "ncamera.yaml",
+    "Path to the camera calibration yaml, which defines the image topics.");
+DEFINE_string(
+    imu_parameters_maplab, "imu-maplab.yaml",
+    "Path to the imu configuration yaml for MAPLAB, which defines the IMU "
+    "topic.");
+DEFINE_string(sensor_log_output, "", "Path of the sensor log to write.");
+DEFINE_uint64(
+    sensor_log_max_pending_measurements, 256u,
+    "Maximum number of measurements read ahead of the encoding.");
+
+DECLARE_string(datasource_type);
+DECLARE_bool(vio_rosbag_throttle_by_backpressure);
+
+// Converts the camera and IMU messages of a rosbag (--datasource_rosbag) to a
+// sensor log, as fast as the images can be encoded.
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+  ros::Time::init();
+
+  CHECK(!FLAGS_sensor_log_output.empty()) << "Set --sensor_log_output.";
+  CHECK_EQ(FLAGS_datasource_type, "rosbag")
+      << "Only rosbags can be converted.";
+  // The sensor log writer applies the back-pressure.
+  FLAGS_vio_rosbag_throttle_by_backpressure = true;
+
+  aslam::NCamera::Ptr camera_system =
+      aslam::NCamera::loadFromYaml(FLAGS_ncamera_calibration);
+  CHECK(camera_system) << "Could not load the camera calibration from: \'"
+                       << FLAGS_ncamera_calibration << "\'";
+  vi_map::Imu::UniquePtr imu_sensor =
+      vi_map::createFromYaml<vi_map::Imu>(FLAGS_imu_parameters_maplab);
+  CHECK(imu_sensor) << "Could not load IMU parameters for MAPLAB from: \'"
+                    << FLAGS_imu_parameters_maplab << "\'";
+
+  std::unique_ptr<rovioli::DataSource> datasource(
+      rovioli::createAndConfigureDataSourcefromGFlags(
+          *camera_system, *imu_sensor));
+  CHECK(datasource);
+  rovioli::SensorLogWriter writer(
+      FLAGS_sensor_log_output, FLAGS_sensor_log_max_pending_measurements);
+  datasource->registerImageCallback(
+      [&writer](const vio::ImageMeasurement::Ptr& image) {
+        writer.addImage(image);
+      });
+  datasource->registerImuCallback(
+      [&writer](const vio::ImuMeasurement::Ptr& imu) { writer.addImu(imu); });
+
+  std::promise<void> end_of_data;
+  datasource->registerEndOfDataCallback(
+      [&end_of_data]() { end_of_data.set_value(); });
+  datasource->startStreaming();
+  end_of_data.get_future().wait();
+
+  datasource->shutdown();
+  writer.close();
+  return 0;
+}
@@ -1,10 +1,14 @@
 #include <memory>
+#include <string>
 
+#include <Eigen/Core>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiles.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <maplab-common/sigint-breaker.h>
+#include <maplab-common/telemetry.h>
 #include <maplab-common/threading-helpers.h>
 #include <message-flow/message-dispatcher-fifo.h>
 #include <message-flow/message-flow.h>
@@ -15,11 +19,20 @@
 #include <vi-map/vi-map-serialization.h>
 
 #include "rovioli/rovioli-node.h"
+#include "rovioli/tiled-localization-map.h"
 
 DEFINE_string(
     vio_localization_map_folder, "",
-    "Path to a localization summary map or a full VI-map used for "
-    "localization.");
+    "Path to a localization summary map, tiled localization summary map or a "
+    "full VI-map used for localization.");
+DEFINE_double(
+    vio_localization_initial_x_m, 0.0,
+    "Initial x position in the localization map frame around which the "
+    "tiles of a tiled localization summary map are loaded.");
+DEFINE_double(
+    vio_localization_initial_y_m, 0.0,
+    "Initial y position in the localization map frame around which the "
+    "tiles of a tiled localization summary map are loaded.");
 DEFINE_string(
     ncamera_calibration, "ncamera.yaml",
     "Path to the camera calibration yaml.");
@@ -43,8 +56,39 @@ DEFINE_bool(
     "Optimize and process the map into a localization map before "
     "saving it.");
 
+DEFINE_bool(
+    rovioli_async_localization_startup, true,
+    "Load the localization map and build its database in the background. VIO "
+    "and map building start right away and localization is enabled once it "
+    "is ready. Does not apply to tiled localization maps.");
+
 DECLARE_bool(map_builder_save_image_as_resources);
 
+namespace {
+
+std::unique_ptr<summary_map::LocalizationSummaryMap> loadLocalizationSummaryMap(
+    const std::string& map_folder) {
+  std::unique_ptr<summary_map::LocalizationSummaryMap> localization_map(
+      new summary_map::LocalizationSummaryMap);
+  if (!localization_map->loadFromFolder(map_folder)) {
+    LOG(WARNING) << "Could not load a localization summary map from "
+                 << map_folder << ". Will try to load it as a full VI map.";
+    vi_map::VIMap vi_map;
+    CHECK(vi_map::serialization::loadMapFromFolder(map_folder, &vi_map))
+        << "Loading a VI map failed. Either provide a valid localization map "
+        << "or leave the map folder flag empty.";
+
+    localization_map.reset(new summary_map::LocalizationSummaryMap);
+    summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
+        vi_map, localization_map.get());
+    // Make sure the localization map is not empty.
+    CHECK_GT(localization_map->GLandmarkPosition().cols(), 0);
+  }
+  return localization_map;
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
   google::ParseCommandLineFlags(&argc, &argv, true);
@@ -55,27 +99,33 @@ int main(int argc, char** argv) {
   ros::init(argc, argv, "rovioli");
   ros::NodeHandle nh;
 
-  // Optionally load localization map.
+  // Optionally load localization map. Tiled maps are streamed in around the
+  // current position while running. Other maps are loaded in the background
+  // with --rovioli_async_localization_startup.
   std::unique_ptr<summary_map::LocalizationSummaryMap> localization_map;
-  if (!FLAGS_vio_localization_map_folder.empty()) {
-    localization_map.reset(new summary_map::LocalizationSummaryMap);
-    if (!localization_map->loadFromFolder(FLAGS_vio_localization_map_folder)) {
-      LOG(WARNING) << "Could not load a localization summary map from "
-                   << FLAGS_vio_localization_map_folder
-                   << ". Will try to load it as a full VI map.";
-      vi_map::VIMap vi_map;
-      CHECK(
-          vi_map::serialization::loadMapFromFolder(
-              FLAGS_vio_localization_map_folder, &vi_map))
-          << "Loading a VI map failed. Either provide a valid localization map "
-          << "or leave the map folder flag empty.";
-
-      localization_map.reset(new summary_map::LocalizationSummaryMap);
-      summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
-          vi_map, localization_map.get());
-      // Make sure the localization map is not empty.
-      CHECK_GT(localization_map->GLandmarkPosition().cols(), 0);
-    }
+  rovioli::TiledLocalizationMap::UniquePtr tiled_localization_map;
+  rovioli::LocalizerFlow::LocalizationMapLoader load_localization_map;
+  if (!FLAGS_vio_localization_map_folder.empty() &&
+      summary_map::LocalizationSummaryMapTiles::hasTilesOnFileSystem(
+          FLAGS_vio_localization_map_folder)) {
+    tiled_localization_map.reset(
+        new rovioli::TiledLocalizationMap(
+            FLAGS_vio_localization_map_folder,
+            Eigen::Vector3d(
+                FLAGS_vio_localization_initial_x_m,
+                FLAGS_vio_localization_initial_y_m, 0.0)));
+  } else if (
+      !FLAGS_vio_localization_map_folder.empty() &&
+      FLAGS_rovioli_async_localization_startup) {
+    const std::string localization_map_folder =
+        FLAGS_vio_localization_map_folder;
+    load_localization_map = [localization_map_folder]() {
+      return std::shared_ptr<const summary_map::LocalizationSummaryMap>(
+          loadLocalizationSummaryMap(localization_map_folder));
+    };
+  } else if (!FLAGS_vio_localization_map_folder.empty()) {
+    localization_map =
+        loadLocalizationSummaryMap(FLAGS_vio_localization_map_folder);
   }
 
   // Load camera calibration and imu parameters.
@@ -121,28 +171,47 @@ int main(int argc, char** argv) {
     }
   }
 
-  rovioli::RovioliNode rovio_localization_node(
-      camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
-      save_map_folder, localization_map.get(), flow.get());
+  std::unique_ptr<rovioli::RovioliNode> rovio_localization_node;
+  if (tiled_localization_map) {
+    rovio_localization_node.reset(
+        new rovioli::RovioliNode(
+            camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+            save_map_folder, tiled_localization_map.get(), flow.get()));
+  } else if (load_localization_map) {
+    rovio_localization_node.reset(
+        new rovioli::RovioliNode(
+            camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+            save_map_folder, load_localization_map, flow.get()));
+  } else {
+    rovio_localization_node.reset(
+        new rovioli::RovioliNode(
+            camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+            save_map_folder, localization_map.get(), flow.get()));
+  }
+
+  // Exports the telemetry metrics while running if
+  // --maplab_telemetry_export_path is set.
+  std::unique_ptr<common::telemetry::PeriodicExporter> telemetry_exporter =
+      common::telemetry::PeriodicExporter::createFromFlags();
 
   // Start the pipeline. The ROS spinner will handle SIGINT for us and abort
   // the application on CTRL+C.
   ros_spinner.start();
-  rovio_localization_node.start();
+  rovio_localization_node->start();
 
   std::atomic<bool>& end_of_days_signal_received =
-      rovio_localization_node.isDataSourceExhausted();
+      rovio_localization_node->isDataSourceExhausted();
   while (ros::ok() && !end_of_days_signal_received.load()) {
     VLOG_EVERY_N(1, 10) << "\n" << flow->printDeliveryQueueStatistics();
     std::this_thread::sleep_for(std::chrono::seconds(1));
   }
 
-  rovio_localization_node.shutdown();
+  rovio_localization_node->shutdown();
   flow->shutdown();
   flow->waitUntilIdle();
 
   if (!save_map_folder.empty()) {
-    rovio_localization_node.saveMapAndOptionallyOptimize(
+    rovio_localization_node->saveMapAndOptionallyOptimize(
         save_map_folder, FLAGS_overwrite_existing_map,
         FLAGS_optimize_map_to_localization_map);
   }
@@ -1,10 +1,15 @@
 #ifndef ROVIOLI_DATA_PUBLISHER_FLOW_H_
 #define ROVIOLI_DATA_PUBLISHER_FLOW_H_
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <maplab-common/conversions.h>
+#include <maplab-common/file-logger.h>
 #include <maplab-common/timeout-counter.h>
 #include <message-flow/message-flow.h>
 #include <tf/transform_broadcaster.h>
@@ -20,9 +25,18 @@
 #pragma GCC diagnostic pop
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/rovio-estimate.h"
 
 namespace rovioli {
 
+// Publishes the estimates to ROS and exports them to CSV. The subscribers
+// only hand the messages over to a publisher thread with a lower priority,
+// such that converting and publishing does not delay the estimator:
+//  - State updates are coalesced: only the latest one is published, at most
+//    with --rovioli_publish_max_rate_hz.
+//  - Localization results and CSV rows are queued and written in batches on
+//    every wake-up of the publisher thread.
+// The map visualization stays on its subscriber, it is already throttled.
 class DataPublisherFlow {
  public:
   const std::string kRosNamespace = "maplab_rovio";
@@ -35,6 +49,7 @@ class DataPublisherFlow {
   const std::string kTopicBiasGyro = kGeneralTopicPrefix + "bias_gyro";
 
   DataPublisherFlow();
+  ~DataPublisherFlow();
 
   void attachToMessageFlow(message_flow::MessageFlow* flow);
   void visualizeMap(const vi_map::VIMap& vi_map) const;
@@ -49,6 +64,11 @@ class DataPublisherFlow {
       const aslam::Transformation& T_G_M);
   void localizationCallback(const Eigen::Vector3d& p_G_I_lc_pnp);
 
+  void publisherLoop();
+  // Requires m_pending_.
+  bool hasPendingData() const;
+  void writeCsvRows(const std::vector<vio::VioUpdate::ConstPtr>& vio_updates);
+
   std::unique_ptr<visualization::ViwlsGraphRvizPlotter> plotter_;
   ros::NodeHandle node_handle_;
   ros::Publisher pub_pose_T_M_I_;
@@ -65,6 +85,17 @@ class DataPublisherFlow {
   visualization::SphereVector T_G_I_loc_spheres_;
 
   aslam::Transformation latest_T_G_M_;
+  std::unique_ptr<common::FileLogger> csv_logger_;
+
+  // Data handed over to the publisher thread.
+  std::mutex m_pending_;
+  std::condition_variable cv_pending_;
+  RovioEstimate::ConstPtr pending_estimate_;
+  vio::VioUpdate::ConstPtr pending_keyframe_update_;
+  std::vector<vio::LocalizationResult::ConstPtr> pending_localizations_;
+  std::vector<vio::VioUpdate::ConstPtr> pending_csv_rows_;
+  bool shutdown_requested_;
+  std::thread publisher_thread_;
 };
 
 }  //  namespace rovioli
@@ -9,7 +9,7 @@
 #include "rovioli/datasource.h"
 
 namespace rovioli {
-enum class DataSourceType { kRosTopic, kRosBag };
+enum class DataSourceType { kRosTopic, kRosBag, kSensorLog };
 
 DataSourceType stringToDataSource(const std::string& str);
 
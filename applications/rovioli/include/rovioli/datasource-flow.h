@@ -3,6 +3,7 @@
 #include <memory>
 
 #include <aslam/cameras/ncamera.h>
+#include <gflags/gflags.h>
 #include <message-flow/message-flow.h>
 #include <sensors/imu.h>
 #include <vio-common/rostopic-settings.h>
@@ -10,16 +11,34 @@
 
 #include "rovioli/datasource-factory.h"
 #include "rovioli/flow-topics.h"
+#include "rovioli/measurement-completion.h"
+#include "rovioli/sensor-log.h"
+
+DECLARE_string(datasource_record_sensor_log);
 
 namespace rovioli {
 
 class DataSourceFlow {
  public:
   explicit DataSourceFlow(
-      const aslam::NCamera& camera_system, const vi_map::Imu& imu_sensor) {
+      const aslam::NCamera& camera_system, const vi_map::Imu& imu_sensor)
+      : measurement_completion_(nullptr) {
     datasource_.reset(
         createAndConfigureDataSourcefromGFlags(camera_system, imu_sensor));
     CHECK(datasource_);
+
+    if (!FLAGS_datasource_record_sensor_log.empty()) {
+      sensor_log_writer_.reset(
+          new SensorLogWriter(FLAGS_datasource_record_sensor_log));
+      datasource_->registerImageCallback(
+          [this](const vio::ImageMeasurement::Ptr& image) {
+            sensor_log_writer_->addImage(image);
+          });
+      datasource_->registerImuCallback(
+          [this](const vio::ImuMeasurement::Ptr& imu) {
+            sensor_log_writer_->addImu(imu);
+          });
+    }
   }
 
   ~DataSourceFlow() {
@@ -28,10 +47,36 @@ class DataSourceFlow {
 
   void attachToMessageFlow(message_flow::MessageFlow* flow) {
     CHECK_NOTNULL(flow);
-    datasource_->registerImageCallback(
-        flow->registerPublisher<message_flow_topics::IMAGE_MEASUREMENTS>());
-    datasource_->registerImuCallback(
-        flow->registerPublisher<message_flow_topics::IMU_MEASUREMENTS>());
+    message_flow::PublisherFunction<message_flow_topics::IMAGE_MEASUREMENTS>
+        publish_image = flow->registerPublisher<
+            message_flow_topics::IMAGE_MEASUREMENTS>();
+    message_flow::PublisherFunction<message_flow_topics::IMU_MEASUREMENTS>
+        publish_imu =
+            flow->registerPublisher<message_flow_topics::IMU_MEASUREMENTS>();
+    if (measurement_completion_ != nullptr) {
+      publish_image =
+          measurement_completion_
+              ->wrapPublisher<message_flow_topics::IMAGE_MEASUREMENTS>(
+                  publish_image);
+      publish_imu =
+          measurement_completion_
+              ->wrapPublisher<message_flow_topics::IMU_MEASUREMENTS>(
+                  publish_imu);
+      MeasurementCompletion* measurement_completion = measurement_completion_;
+      datasource_->setWaitUntilProcessedFunction(
+          [measurement_completion]() {
+            measurement_completion->waitUntilAllCompleted();
+          });
+    }
+    datasource_->registerImageCallback(publish_image);
+    datasource_->registerImuCallback(publish_imu);
+  }
+
+  // Lets the data source wait until a published measurement is processed.
+  // Must be set before attaching to the message flow; the completion must
+  // outlive the flow.
+  void setMeasurementCompletion(MeasurementCompletion* measurement_completion) {
+    measurement_completion_ = CHECK_NOTNULL(measurement_completion);
   }
 
   void startStreaming() {
@@ -40,6 +85,9 @@ class DataSourceFlow {
 
   void shutdown() {
     datasource_->shutdown();
+    if (sensor_log_writer_) {
+      sensor_log_writer_->close();
+    }
   }
 
   void registerEndOfDataCallback(const std::function<void()>& cb) {
@@ -49,6 +97,8 @@ class DataSourceFlow {
 
  private:
   std::unique_ptr<DataSource> datasource_;
+  std::unique_ptr<SensorLogWriter> sensor_log_writer_;
+  MeasurementCompletion* measurement_completion_;
 };
 
 }  // namespace rovioli
@@ -2,12 +2,15 @@
 #define ROVIOLI_DATASOURCE_ROSBAG_H_
 
 #include <atomic>
+#include <future>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <aslam/common/thread-pool.h>
 #include <aslam/common/time.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <vio-common/rostopic-settings.h>
 #include <vio-common/vio-types.h>
 
@@ -43,9 +46,28 @@ class DataSourceRosbag : public DataSource {
   virtual std::string getDatasetName() const;
 
  private:
+  // A measurement converted from a bag message; only one of them is set.
+  struct DecodedMessage {
+    vio::ImageMeasurement::Ptr image;
+    vio::ImuMeasurement::Ptr imu;
+  };
+  // Invalid futures mark the end of the bag.
+  typedef std::shared_future<DecodedMessage> DecodedMessageFuture;
+
   void streamingWorker();
 
+  // Used with --vio_rosbag_throttle_by_backpressure: the read-ahead thread
+  // deserializes the messages in bag order and hands the image conversion to
+  // the decoder pool. The streaming worker publishes the decoded messages in
+  // bag order as fast as the subscribers accept them.
+  void readAheadWorker();
+  void streamingWorkerThrottledByBackpressure();
+  void publishMeasurement(const DecodedMessage& decoded_message);
+
   std::unique_ptr<std::thread> streaming_thread_;
+  std::unique_ptr<std::thread> read_ahead_thread_;
+  std::unique_ptr<aslam::ThreadPool> decoder_thread_pool_;
+  common::ThreadSafeQueue<DecodedMessageFuture> decoded_messages_;
   std::atomic<bool> shutdown_requested_;
   std::atomic<bool> all_data_streamed_;
   std::string rosbag_path_filename_;
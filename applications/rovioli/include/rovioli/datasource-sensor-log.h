@@ -0,0 +1,73 @@
+#ifndef ROVIOLI_DATASOURCE_SENSOR_LOG_H_
+#define ROVIOLI_DATASOURCE_SENSOR_LOG_H_
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <aslam/common/thread-pool.h>
+#include <maplab-common/threadsafe-queue.h>
+#include <vio-common/vio-types.h>
+
+#include "rovioli/datasource.h"
+#include "rovioli/sensor-log.h"
+
+namespace rovioli {
+
+// Plays back a sensor log written by SensorLogWriter. The images are decoded
+// ahead of the publishing on a thread pool.
+//
+// With --vio_sensor_log_deterministic, the measurements are published as fast
+// as the pipeline processes them: after every measurement, the source waits
+// until the synchronizer, the tracker and ROVIO report it as processed. The
+// images are held back until the first IMU measurement after them is
+// processed. Every run then sees the same interleaving of the measurements and
+// produces the same result, independent of the load of the machine. The
+// localization results are not waited for.
+class DataSourceSensorLog : public DataSource {
+ public:
+  explicit DataSourceSensorLog(const std::string& sensor_log_path);
+  virtual ~DataSourceSensorLog();
+
+  virtual void startStreaming();
+  virtual void shutdown();
+  virtual bool allDataStreamed() const {
+    return all_data_streamed_;
+  }
+  virtual std::string getDatasetName() const;
+
+ private:
+  // Only one of them is set.
+  struct DecodedMeasurement {
+    vio::ImageMeasurement::Ptr image;
+    vio::ImuMeasurement::Ptr imu;
+  };
+  // Invalid futures mark the end of the log.
+  typedef std::shared_future<DecodedMeasurement> DecodedMeasurementFuture;
+
+  void readAheadWorker();
+  void streamingWorker();
+  void publishMeasurement(const DecodedMeasurement& measurement);
+  // Publishes the images and waits until they are processed.
+  void publishHeldBackImages(
+      std::vector<DecodedMeasurement>* held_back_images);
+
+  const std::string sensor_log_path_;
+  SensorLogReader reader_;
+  int64_t start_timestamp_ns_;
+  int64_t end_timestamp_ns_;
+
+  std::unique_ptr<std::thread> streaming_thread_;
+  std::unique_ptr<std::thread> read_ahead_thread_;
+  std::unique_ptr<aslam::ThreadPool> decoder_thread_pool_;
+  common::ThreadSafeQueue<DecodedMeasurementFuture> decoded_measurements_;
+  std::atomic<bool> shutdown_requested_;
+  std::atomic<bool> all_data_streamed_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_DATASOURCE_SENSOR_LOG_H_
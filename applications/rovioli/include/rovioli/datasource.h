@@ -59,6 +59,13 @@ class DataSource : public CallbackManager {
     }
   }
 
+  // Offline sources that play back deterministically call this function after
+  // publishing a measurement to wait until the pipeline processed it.
+  void setWaitUntilProcessedFunction(const std::function<void()>& function) {
+    CHECK(function);
+    wait_until_processed_function_ = function;
+  }
+
   // If this is the first timestamp we receive, we store it and shift all
   // subsequent timestamps. Will return false for any timestamps that are
   // smaller than the first timestamp received.
@@ -94,8 +101,15 @@ class DataSource : public CallbackManager {
  protected:
   DataSource() = default;
 
+  void waitUntilProcessed() const {
+    if (wait_until_processed_function_) {
+      wait_until_processed_function_();
+    }
+  }
+
  private:
   std::vector<std::function<void()>> end_of_data_callbacks_;
+  std::function<void()> wait_until_processed_function_;
 
   std::mutex timestamp_mutex_;
   int64_t timestamp_at_start_ns_ = -1;
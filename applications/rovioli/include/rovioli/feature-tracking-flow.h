@@ -2,12 +2,15 @@
 #define ROVIOLI_FEATURE_TRACKING_FLOW_H_
 
 #include <aslam/cameras/ncamera.h>
+#include <maplab-common/thread-topology.h>
 #include <message-flow/message-flow.h>
 #include <sensors/imu.h>
+#include <vio-common/pipeline-trace.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/feature-tracking.h"
 #include "rovioli/flow-topics.h"
+#include "rovioli/measurement-completion.h"
 
 namespace rovioli {
 
@@ -15,7 +18,8 @@ class FeatureTrackingFlow {
  public:
   FeatureTrackingFlow(
       const aslam::NCamera::Ptr& camera_system, const vi_map::Imu& imu_sensor)
-      : tracking_pipeline_(camera_system, imu_sensor) {
+      : tracking_pipeline_(camera_system, imu_sensor),
+        measurement_completion_(nullptr) {
     CHECK(camera_system);
   }
 
@@ -26,19 +30,36 @@ class FeatureTrackingFlow {
     std::function<void(vio::SynchronizedNFrameImu::ConstPtr)> publish_result =
         flow->registerPublisher<message_flow_topics::TRACKED_NFRAMES_AND_IMU>();
 
+    if (measurement_completion_ != nullptr) {
+      measurement_completion_
+          ->registerConsumer<message_flow_topics::SYNCED_NFRAMES_AND_IMU>();
+      measurement_completion_
+          ->registerConsumer<message_flow_topics::ROVIO_ESTIMATES>();
+    }
+
+    // Pinned to the tracker CPUs of --maplab_stage_cpus while tracking.
+    const common::CpuList tracker_cpus =
+        common::ThreadTopology::instance().getStageCpus("tracker");
+
     // NOTE: the publisher function pointer is copied intentionally; otherwise
     // we would capture a reference to a temporary.
     flow->registerSubscriber<message_flow_topics::SYNCED_NFRAMES_AND_IMU>(
         kSubscriberNodeName, message_flow::DeliveryOptions(),
-        [publish_result,
+        [publish_result, tracker_cpus,
          this](const vio::SynchronizedNFrameImu::Ptr& nframe_imu) {
           CHECK(nframe_imu);
+          ScopedMeasurementCompletion completion(measurement_completion_);
+          common::ScopedThreadAffinity pinning(tracker_cpus);
+          vio::ScopedPipelineTraceStage trace_stage(
+              nframe_imu->trace.get(), "tracking");
+          vio::SynchronizedNFrameImu::Ptr tracked_nframe_imu;
           const bool success =
               this->tracking_pipeline_.trackSynchronizedNFrameImuCallback(
-                  nframe_imu);
+                  nframe_imu, &tracked_nframe_imu);
           if (success) {
-            // This will only fail for the first frame.
-            publish_result(nframe_imu);
+            // This will only fail for the first frame (or the first two in
+            // pipelined mode).
+            publish_result(tracked_nframe_imu);
           }
         });
 
@@ -46,12 +67,20 @@ class FeatureTrackingFlow {
         kSubscriberNodeName, message_flow::DeliveryOptions(),
         [this](const RovioEstimate::ConstPtr& estimate) {
           CHECK(estimate);
+          ScopedMeasurementCompletion completion(measurement_completion_);
           this->tracking_pipeline_.setCurrentImuBias(estimate);
         });
   }
 
+  // Reports when the nframes and estimates are processed. Must be set before
+  // attaching to the message flow; the completion must outlive the flow.
+  void setMeasurementCompletion(MeasurementCompletion* measurement_completion) {
+    measurement_completion_ = CHECK_NOTNULL(measurement_completion);
+  }
+
  private:
   FeatureTracking tracking_pipeline_;
+  MeasurementCompletion* measurement_completion_;
 };
 
 }  // namespace rovioli
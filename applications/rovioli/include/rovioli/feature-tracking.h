@@ -2,10 +2,12 @@
 #define ROVIOLI_FEATURE_TRACKING_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <Eigen/Core>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
 #include <feature-tracking/vo-feature-tracking-pipeline.h>
 #include <sensors/imu.h>
 #include <vio-common/vio-types.h>
@@ -26,11 +28,27 @@ class FeatureTracking {
 
   bool trackSynchronizedNFrameImuCallback(
       const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu);
+  // Returns true and sets tracked_nframe_imu if an nframe was tracked. With
+  // --rovioli_pipelined_feature_tracking this is the nframe received before
+  // synced_nframe_imu, whose detection then overlaps the tracking.
+  bool trackSynchronizedNFrameImuCallback(
+      const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu,
+      vio::SynchronizedNFrameImu::Ptr* tracked_nframe_imu);
 
   void setCurrentImuBias(const RovioEstimate::ConstPtr& rovio_estimate);
 
  private:
-  bool hasUpToDateImuBias(const int64_t current_timestamp_ns) const;
+  // Tracks the features from the previous nframe into synced_nframe_imu,
+  // which becomes the previous nframe.
+  void trackToPreviousNFrame(
+      const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu);
+
+  // Uses the bias of the latest estimate up to the previous nframe. The
+  // estimator publishes it before the current nframe reaches the tracker, which
+  // isn't the case for later estimates.
+  void selectImuBias(
+      const int64_t previous_nframe_timestamp_ns,
+      const int64_t current_nframe_timestamp_ns);
 
   void integrateInterframeImuRotation(
       const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
@@ -40,11 +58,17 @@ class FeatureTracking {
   const aslam::NCamera::Ptr camera_system_;
   const vi_map::Imu imu_sensor_;
 
+  // The bias used for the nframe that is tracked.
   Eigen::Matrix<double, 6, 1> current_imu_bias_;
-  int64_t current_imu_bias_timestamp_nanoseconds_;
+  // The biases of the received estimates by their timestamp.
+  typedef AlignedMap<int64_t, Eigen::Matrix<double, 6, 1>> ImuBiasMap;
+  ImuBiasMap imu_biases_;
   mutable std::mutex m_current_imu_bias_;
 
   vio::SynchronizedNFrameImu::Ptr previous_synced_nframe_imu_;
+  // In pipelined mode, the received nframe that is detected but not yet
+  // tracked.
+  vio::SynchronizedNFrameImu::Ptr pending_synced_nframe_imu_;
   int64_t previous_nframe_timestamp_ns_;
   std::mutex m_previous_synced_nframe_imu_;
 
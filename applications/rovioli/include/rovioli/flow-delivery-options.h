@@ -0,0 +1,20 @@
+#ifndef ROVIOLI_FLOW_DELIVERY_OPTIONS_H_
+#define ROVIOLI_FLOW_DELIVERY_OPTIONS_H_
+
+#include <message-flow/message-flow.h>
+
+namespace rovioli {
+
+// Delivery options of the synchronizer inputs. If
+// --rovioli_backpressure_queue_capacity is set, the queues are bounded and
+// block the publisher once full. Offline data sources are then throttled to
+// the speed of the synchronizer instead of messages piling up in the queues.
+//
+// Only for subscribers whose publishers run on their own thread, such as the
+// data sources. A publisher that runs on a dispatcher thread would block one of
+// the workers that are needed to drain the queue.
+message_flow::DeliveryOptions getBackpressureDeliveryOptions();
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_FLOW_DELIVERY_OPTIONS_H_
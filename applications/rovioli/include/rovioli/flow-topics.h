@@ -5,6 +5,7 @@
 #include <vio-common/vio-types.h>
 #include <vio-common/vio-update.h>
 
+#include "rovioli/localization-scheduler.h"
 #include "rovioli/rovio-estimate.h"
 #include "rovioli/vi-map-with-mutex.h"
 
@@ -25,6 +26,9 @@ MESSAGE_FLOW_TOPIC(
 
 // Output of the localizer.
 MESSAGE_FLOW_TOPIC(LOCALIZATION_RESULT, vio::LocalizationResult::ConstPtr);
+// Every localization of the localizer, including the failed ones.
+MESSAGE_FLOW_TOPIC(
+    LOCALIZATION_ATTEMPTS, rovioli::LocalizationAttempt::ConstPtr);
 
 // Raw estimate of the VINS.
 MESSAGE_FLOW_TOPIC(VIO_UPDATES, vio::VioUpdate::ConstPtr);
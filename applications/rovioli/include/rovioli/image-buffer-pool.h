@@ -0,0 +1,57 @@
+#ifndef ROVIOLI_IMAGE_BUFFER_POOL_H_
+#define ROVIOLI_IMAGE_BUFFER_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace rovioli {
+
+// OpenCV allocator that keeps the memory of released images and hands it out
+// again for images of the same size. An image allocated from the pool returns
+// its buffer once the last cv::Mat referencing it is gone, wherever in the
+// pipeline that happens.
+class ImageBufferPool : public cv::MatAllocator {
+ public:
+  explicit ImageBufferPool(const size_t max_num_free_buffers);
+  virtual ~ImageBufferPool();
+
+  // The process-wide pool of the camera images. It is never destroyed, so
+  // images may outlive every other object.
+  static ImageBufferPool& instance();
+
+  // Returns an image with uninitialized pixels.
+  cv::Mat acquire(const int rows, const int cols, const int type);
+
+  size_t getNumFreeBuffers() const;
+
+  cv::UMatData* allocate(
+      int dims, const int* sizes, int type, void* data, size_t* step,
+      int flags, cv::UMatUsageFlags usage_flags) const override;
+  bool allocate(
+      cv::UMatData* data, int access_flags,
+      cv::UMatUsageFlags usage_flags) const override;
+  void deallocate(cv::UMatData* data) const override;
+
+ private:
+  const size_t max_num_free_buffers_;
+
+  mutable std::mutex m_free_buffers_;
+  // Free buffers by their size in bytes.
+  mutable std::unordered_map<size_t, std::vector<uchar*>> free_buffers_;
+  mutable size_t num_free_buffers_;
+};
+
+// Wraps external image memory into a cv::Mat without copying it. The owner,
+// e.g. the message the pixels belong to, is kept alive until the last
+// cv::Mat referencing the memory is gone.
+cv::Mat wrapExternalImageData(
+    const int rows, const int cols, const int type, void* data,
+    const size_t step, const std::shared_ptr<const void>& owner);
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_IMAGE_BUFFER_POOL_H_
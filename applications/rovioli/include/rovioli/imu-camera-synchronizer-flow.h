@@ -6,15 +6,18 @@
 #include <sensors/imu.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/flow-delivery-options.h"
 #include "rovioli/flow-topics.h"
 #include "rovioli/imu-camera-synchronizer.h"
+#include "rovioli/measurement-completion.h"
 
 namespace rovioli {
 
 class ImuCameraSynchronizerFlow {
  public:
   explicit ImuCameraSynchronizerFlow(const aslam::NCamera::Ptr& camera_system)
-      : synchronizing_pipeline_(camera_system) {
+      : synchronizing_pipeline_(camera_system),
+        measurement_completion_(nullptr) {
     CHECK(camera_system);
   }
 
@@ -25,20 +28,49 @@ class ImuCameraSynchronizerFlow {
   void attachToMessageFlow(message_flow::MessageFlow* flow) {
     CHECK_NOTNULL(flow);
     static constexpr char kSubscriberNodeName[] = "ImuCameraSynchronizerFlow";
+    // The synchronizer only buffers the measurements, so it runs with the
+    // estimator inputs. The measurements are published by the data source
+    // thread, which can be blocked by full queues.
+    message_flow::DeliveryOptions delivery_options =
+        getBackpressureDeliveryOptions();
+    delivery_options.priority = message_flow::DeliveryPriority::kRealTime;
+
+    message_flow::PublisherFunction<message_flow_topics::SYNCED_NFRAMES_AND_IMU>
+        publish_result = flow->registerPublisher<
+            message_flow_topics::SYNCED_NFRAMES_AND_IMU>();
+    if (measurement_completion_ != nullptr) {
+      measurement_completion_
+          ->registerConsumer<message_flow_topics::IMAGE_MEASUREMENTS>();
+      measurement_completion_
+          ->registerConsumer<message_flow_topics::IMU_MEASUREMENTS>();
+      publish_result = measurement_completion_->wrapPublisher<
+          message_flow_topics::SYNCED_NFRAMES_AND_IMU>(publish_result);
+      // An image is processed once the nframe it belongs to is published or
+      // dropped by the synchronizer thread.
+      synchronizing_pipeline_.registerImagesProcessedCallback(
+          [this](const size_t num_images) {
+            measurement_completion_->complete(num_images);
+          });
+    }
 
     // Image input.
     flow->registerSubscriber<message_flow_topics::IMAGE_MEASUREMENTS>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        kSubscriberNodeName, delivery_options,
         [this](const vio::ImageMeasurement::Ptr& image) {
           CHECK(image);
+          ScopedMeasurementCompletion completion(measurement_completion_);
+          if (measurement_completion_ != nullptr) {
+            measurement_completion_->addPending(1u);
+          }
           this->synchronizing_pipeline_.addCameraImage(
               image->camera_index, image->image, image->timestamp);
         });
     // IMU input.
     flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        kSubscriberNodeName, delivery_options,
         [this](const vio::ImuMeasurement::Ptr& imu) {
           CHECK(imu);
+          ScopedMeasurementCompletion completion(measurement_completion_);
           // TODO(schneith): This seems inefficient. Should we batch IMU
           // measurements on the datasource side?
           this->synchronizing_pipeline_.addImuMeasurements(
@@ -48,7 +80,17 @@ class ImuCameraSynchronizerFlow {
 
     // Tracked nframes and IMU output.
     synchronizing_pipeline_.registerSynchronizedNFrameImuCallback(
-        flow->registerPublisher<message_flow_topics::SYNCED_NFRAMES_AND_IMU>());
+        publish_result);
+  }
+
+  // Reports when the measurements are processed. Must be set before attaching
+  // to the message flow; the completion must outlive the flow.
+  void setMeasurementCompletion(MeasurementCompletion* measurement_completion) {
+    measurement_completion_ = CHECK_NOTNULL(measurement_completion);
+  }
+
+  void setPipelineTraceSink(vio::PipelineTraceSink* pipeline_trace_sink) {
+    synchronizing_pipeline_.setPipelineTraceSink(pipeline_trace_sink);
   }
 
   void shutdown() {
@@ -57,6 +99,7 @@ class ImuCameraSynchronizerFlow {
 
  private:
   ImuCameraSynchronizer synchronizing_pipeline_;
+  MeasurementCompletion* measurement_completion_;
 };
 
 }  // namespace rovioli
@@ -2,7 +2,9 @@
 #define ROVIOLI_IMU_CAMERA_SYNCHRONIZER_H_
 
 #include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <Eigen/Core>
@@ -10,6 +12,7 @@
 #include <aslam/pipeline/visual-npipeline.h>
 #include <opencv2/core/core.hpp>
 #include <vio-common/imu-measurements-buffer.h>
+#include <vio-common/pipeline-trace.h>
 #include <vio-common/vio-types.h>
 #include <vio-common/vio-update.h>
 
@@ -34,6 +37,17 @@ class ImuCameraSynchronizer {
   void registerSynchronizedNFrameImuCallback(
       const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>& cb);
 
+  // Called with the number of images after the nframes made of them were
+  // published or dropped.
+  void registerImagesProcessedCallback(
+      const std::function<void(size_t num_images)>& callback);
+
+  // Attaches a latency trace to every published nframe. Must be set before the
+  // first image is added; the sink must outlive the synchronizer.
+  void setPipelineTraceSink(vio::PipelineTraceSink* pipeline_trace_sink) {
+    pipeline_trace_sink_ = CHECK_NOTNULL(pipeline_trace_sink);
+  }
+
   void shutdown();
 
   static constexpr size_t kFramesToSkipAtInit = 1u;
@@ -41,6 +55,18 @@ class ImuCameraSynchronizer {
  private:
   void checkIfMessagesAreIncomingWorker();
   void processDataThreadWorker();
+  // Synchronizes the nframes in order. The IMU data of all nframes that is
+  // already buffered is extracted at once, only an nframe whose data is
+  // missing waits for it. Returns false on shutdown.
+  bool synchronizeNFrames(
+      const std::vector<aslam::VisualNFrame::Ptr>& nframes,
+      const std::vector<int64_t>& nframe_arrival_times_ns);
+  void publishSynchronizedNFrame(
+      const vio::SynchronizedNFrameImu::Ptr& synchronized_nframe,
+      int64_t nframe_arrival_time_ns);
+  // Returns the time the first image of the nframe was added, and forgets
+  // about all images up to the nframe.
+  int64_t popImageArrivalTimeNanoseconds(const aslam::VisualNFrame& nframe);
 
   const aslam::NCamera::Ptr camera_system_;
 
@@ -61,6 +87,8 @@ class ImuCameraSynchronizer {
   std::vector<std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>>
       nframe_callbacks_;
   std::mutex m_nframe_callbacks_;
+  std::vector<std::function<void(size_t)>> images_processed_callbacks_;
+  std::mutex m_images_processed_callbacks_;
   std::atomic<bool> initial_sync_succeeded_;
 
   std::atomic<bool> shutdown_;
@@ -75,6 +103,12 @@ class ImuCameraSynchronizer {
   // happend most recently).
   int64_t time_last_imu_message_received_or_checked_ns_;
   int64_t time_last_camera_message_received_or_checked_ns_;
+
+  vio::PipelineTraceSink* pipeline_trace_sink_;
+  // Image timestamp to the time the image was added, only recorded if tracing
+  // is enabled.
+  std::map<int64_t, int64_t> image_arrival_times_ns_;
+  std::mutex m_image_arrival_times_ns_;
 };
 
 }  // namespace rovioli
@@ -0,0 +1,55 @@
+#ifndef ROVIOLI_LOCALIZATION_DATABASE_H_
+#define ROVIOLI_LOCALIZATION_DATABASE_H_
+
+#include <vector>
+
+#include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/macros.h>
+
+namespace rovioli {
+
+// A localization summary map together with its loop detector database and the
+// projected descriptor columns of every landmark used by map tracking.
+class LocalizationDatabase {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LocalizationDatabase);
+
+  LocalizationDatabase() = delete;
+  // The summary map has to outlive the database.
+  LocalizationDatabase(
+      const summary_map::LocalizationSummaryMap& summary_map,
+      const bool visualize_localization);
+  // Takes ownership of the summary map.
+  LocalizationDatabase(
+      summary_map::LocalizationSummaryMap::UniquePtr summary_map,
+      const bool visualize_localization);
+
+  const summary_map::LocalizationSummaryMap& summaryMap() const {
+    return summary_map_;
+  }
+  const loop_detector_node::LoopDetectorNode& loopDetector() const {
+    CHECK(loop_detector_);
+    return *loop_detector_;
+  }
+  const std::vector<unsigned int>& getLandmarkObservationIndices(
+      const int landmark_index) const {
+    CHECK_GE(landmark_index, 0);
+    CHECK_LT(
+        static_cast<size_t>(landmark_index),
+        landmark_observation_indices_.size());
+    return landmark_observation_indices_[landmark_index];
+  }
+
+ private:
+  void initialize(const bool visualize_localization);
+
+  const summary_map::LocalizationSummaryMap::UniquePtr owned_summary_map_;
+  const summary_map::LocalizationSummaryMap& summary_map_;
+  loop_detector_node::LoopDetectorNode::UniquePtr loop_detector_;
+  std::vector<std::vector<unsigned int>> landmark_observation_indices_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_LOCALIZATION_DATABASE_H_
@@ -0,0 +1,94 @@
+#ifndef ROVIOLI_LOCALIZATION_SCHEDULER_H_
+#define ROVIOLI_LOCALIZATION_SCHEDULER_H_
+
+#include <mutex>
+#include <utility>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <maplab-common/flat-temporal-buffer.h>
+#include <maplab-common/macros.h>
+
+namespace rovioli {
+
+// Outcome of localizing a single nframe, successful or not.
+struct LocalizationAttempt {
+  MAPLAB_POINTER_TYPEDEFS(LocalizationAttempt);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  int64_t timestamp_ns;
+  bool success;
+  // Only valid on success.
+  aslam::Transformation T_G_I;
+  // Wall time spent on the localization.
+  int64_t duration_ns;
+};
+
+// Picks the nframes to localize among the throttled ones. The interval
+// between localizations is:
+//  - reset to the throttler interval after a failed localization or one that
+//    disagrees with the previous one,
+//  - doubled after every localization that agrees with the previous one, up
+//    to the interval of --rovioli_adaptive_localization_min_frequency_hz,
+//  - reset to the throttler interval while the VIO position uncertainty has
+//    grown by more than --rovioli_adaptive_localization_max_vio_drift_m
+//    since the last successful localization,
+//  - never shorter than needed to stay within
+//    --rovioli_localization_cpu_budget, if set.
+class LocalizationScheduler {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LocalizationScheduler);
+
+  LocalizationScheduler();
+
+  // The estimates arrive in time order. p_M_I_covariance is the covariance of
+  // the VIO position.
+  void processVioEstimate(
+      const int64_t timestamp_ns, const aslam::Transformation& T_M_I,
+      const Eigen::Matrix3d& p_M_I_covariance);
+
+  // Attempts may arrive out of order; the interval only adapts to attempts
+  // that are newer than all previous ones.
+  void processLocalizationAttempt(const LocalizationAttempt& attempt);
+
+  bool shouldLocalizeNFrame(const int64_t nframe_timestamp_ns);
+
+  int64_t getCurrentIntervalNs() const;
+
+ private:
+  typedef common::FlatTemporalBuffer<
+      aslam::Transformation,
+      Eigen::aligned_allocator<std::pair<int64_t, aslam::Transformation>>>
+      PoseBuffer;
+
+  // Requires m_state_.
+  int64_t getCurrentIntervalNsLocked() const;
+
+  const int64_t min_interval_ns_;
+  const int64_t max_interval_ns_;
+  const double max_vio_drift_m_;
+  const double max_pose_disagreement_m_;
+  const double max_pose_disagreement_rad_;
+  const double cpu_budget_;
+
+  mutable std::mutex m_state_;
+  int64_t interval_ns_;
+  int64_t last_scheduled_timestamp_ns_;
+  int64_t last_attempt_timestamp_ns_;
+  // Exponential moving average of the localization wall time, negative until
+  // the first attempt.
+  double average_duration_ns_;
+
+  PoseBuffer T_M_I_buffer_;
+  // Trace of the VIO position covariance, latest and at the last successful
+  // localization.
+  double vio_position_variance_m2_;
+  double vio_position_variance_at_localization_m2_;
+
+  aslam::Transformation last_T_G_M_;
+  bool has_last_T_G_M_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_LOCALIZATION_SCHEDULER_H_
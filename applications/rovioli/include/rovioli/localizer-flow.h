@@ -1,49 +1,84 @@
 #ifndef ROVIOLI_LOCALIZER_FLOW_H_
 #define ROVIOLI_LOCALIZER_FLOW_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <localization-summary-map/localization-summary-map.h>
 #include <message-flow/message-flow.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/localization-scheduler.h"
 #include "rovioli/localizer.h"
+#include "rovioli/tiled-localization-map.h"
 
 namespace rovioli {
 
+// With --rovioli_num_localization_workers > 1, the throttled nframes are
+// localized on that many worker threads, which may complete out of order.
+// An nframe that arrives while all workers are busy waits for the next free
+// worker, and is replaced by a newer one in the meantime.
 class LocalizerFlow {
  public:
+  typedef std::function<
+      std::shared_ptr<const summary_map::LocalizationSummaryMap>()>
+      LocalizationMapLoader;
+
   explicit LocalizerFlow(
       const summary_map::LocalizationSummaryMap& localization_map,
-      const bool visualize_localization)
-      : localizer_(localization_map, visualize_localization) {}
-
-  void attachToMessageFlow(message_flow::MessageFlow* flow) {
-    CHECK_NOTNULL(flow);
-    static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
-
-    // Subscribe-publish: nframe to localization.
-    std::function<void(vio::LocalizationResult::ConstPtr)> publish_result =
-        flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
-
-    // NOTE: the publisher function pointer is copied intentionally; otherwise
-    // we would capture a reference to a temporary.
-    flow->registerSubscriber<
-        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
-        [publish_result,
-         this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
-          CHECK(nframe_imu);
-          vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
-          const bool success = this->localizer_.localizeNFrame(
-              nframe_imu->nframe, loc_result.get());
-          if (success) {
-            publish_result(loc_result);
-          }
-        });
+      const bool visualize_localization);
+  explicit LocalizerFlow(TiledLocalizationMap* tiled_localization_map);
+  // Loads the map and builds its localization database on a startup thread,
+  // such that the rest of the pipeline can start right away. The nframes are
+  // not localized until the localizer is ready.
+  LocalizerFlow(
+      const LocalizationMapLoader& load_localization_map,
+      const bool visualize_localization);
+  ~LocalizerFlow();
+
+  bool isLocalizerReady() const {
+    return is_localizer_ready_.load(std::memory_order_acquire);
   }
 
+  void attachToMessageFlow(message_flow::MessageFlow* flow);
+
+  // Joins the workers. Pending nframes are dropped.
+  void shutdown();
+
  private:
-  Localizer localizer_;
+  typedef std::function<void(vio::LocalizationResult::ConstPtr)>
+      PublishResultFunction;
+  typedef std::function<void(LocalizationAttempt::ConstPtr)>
+      PublishAttemptFunction;
+
+  void localizeAndPublish(
+      const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu);
+  void startWorkers();
+  void workerLoop();
+
+  // Only set by the startup thread of an asynchronously loaded map; the
+  // localizer references it.
+  std::shared_ptr<const summary_map::LocalizationSummaryMap> localization_map_;
+  std::unique_ptr<Localizer> localizer_;
+  // Published after localizer_ has been set.
+  std::atomic<bool> is_localizer_ready_;
+  std::thread startup_thread_;
+
+  PublishResultFunction publish_result_;
+  PublishAttemptFunction publish_attempt_;
+
+  std::mutex m_pending_nframe_;
+  std::condition_variable cv_pending_nframe_;
+  vio::SynchronizedNFrameImu::ConstPtr pending_nframe_imu_;
+  bool shutdown_requested_;
+  std::atomic<size_t> num_replaced_nframes_;
+  std::vector<std::thread> workers_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_LOCALIZER_FLOW_H_
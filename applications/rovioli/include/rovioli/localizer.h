@@ -1,11 +1,20 @@
 #ifndef ROVIOLI_LOCALIZER_H_
 #define ROVIOLI_LOCALIZER_H_
 
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
 #include <localization-summary-map/localization-summary-map.h>
-#include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/macros.h>
+#include <maplab-common/flat-temporal-buffer.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/localization-database.h"
+#include "rovioli/tiled-localization-map.h"
+
 namespace rovioli {
 
 class Localizer {
@@ -19,25 +28,72 @@ class Localizer {
   Localizer(
       const summary_map::LocalizationSummaryMap& localization_summary_map,
       const bool visualize_localization);
+  // Localizes against the tiles currently loaded by the tiled map, which has
+  // to outlive the localizer. The localizer moves the tiled map along with
+  // its pose estimates.
+  explicit Localizer(TiledLocalizationMap* tiled_localization_map);
 
   LocalizationMode getCurrentLocalizationMode() const;
 
+  // Adds a VIO pose estimate. Map tracking predicts the pose of an nframe from
+  // the VIO pose at its timestamp and the last successful localization.
+  void processVioEstimate(
+      const int64_t timestamp_ns, const aslam::Transformation& T_M_I);
+
+  // Localizes in global mode until an nframe is found in the map and a VIO
+  // pose is available for it, then switches to map tracking. If tracking
+  // fails, the same nframe is localized globally again, first around the pose
+  // predicted from T_G_M and then in the whole map. If that fails too, T_G_M
+  // is discarded.
+  //
+  // Several nframes may be localized concurrently, as the map is only read.
+  // The mode and T_G_M are only updated by nframes that are newer than the
+  // last nframe that updated them, such that late results don't override
+  // newer ones.
   bool localizeNFrame(
       const aslam::VisualNFrame::ConstPtr& nframe,
-      vio::LocalizationResult* localization_result) const;
+      vio::LocalizationResult* localization_result);
 
  private:
+  // The VIO poses arrive in time order.
+  typedef common::FlatTemporalBuffer<
+      aslam::Transformation,
+      Eigen::aligned_allocator<std::pair<int64_t, aslam::Transformation>>>
+      PoseBuffer;
+
+  // T_G_I_prior is optional and may be NULL. If set, only the map within
+  // --rovioli_localization_prior_search_radius_m around it is searched.
   bool localizeNFrameGlobal(
       const aslam::VisualNFrame::ConstPtr& nframe,
+      const aslam::Transformation* T_G_I_prior,
       aslam::Transformation* T_G_I_lc_pnp) const;
+  // Projects the summary map landmarks into the cameras at the predicted pose
+  // T_G_I_prior, matches them against the keypoints close to their projection
+  // and estimates the pose from these matches.
   bool localizeNFrameMapTracking(
       const aslam::VisualNFrame::ConstPtr& nframe,
+      const aslam::Transformation& T_G_I_prior,
       aslam::Transformation* T_G_I_lc_pnp) const;
 
-  LocalizationMode current_localization_mode_;
-  loop_detector_node::LoopDetectorNode::UniquePtr global_loop_detector_;
+  // Requires m_state_.
+  bool getVioPose(
+      const aslam::VisualNFrame& nframe, aslam::Transformation* T_M_I) const;
+  void getDatabases(
+      std::vector<LocalizationDatabase::ConstPtr>* databases) const;
 
-  const summary_map::LocalizationSummaryMap& localization_summary_map_;
+  // Guards the members below except for the databases, which are read-only.
+  mutable std::mutex m_state_;
+  LocalizationMode current_localization_mode_;
+  // Transformation from the VIO frame to the map frame, updated with every
+  // successful localization and invalidated when localization is lost.
+  aslam::Transformation T_G_M_;
+  bool has_T_G_M_;
+  PoseBuffer T_M_I_buffer_;
+  int64_t last_applied_timestamp_ns_;
+  // Either the database of the single summary map or, if set, the databases
+  // of the loaded tiles of the tiled map.
+  std::vector<LocalizationDatabase::ConstPtr> databases_;
+  TiledLocalizationMap* const tiled_localization_map_;
 };
 
 }  // namespace rovioli
@@ -2,9 +2,13 @@
 #define ROVIOLI_MAP_BUILDER_FLOW_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <aslam/cameras/ncamera.h>
 #include <message-flow/message-flow.h>
@@ -14,6 +18,7 @@
 #include <vio-common/vio-types.h>
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/online-loop-closure.h"
 #include "rovioli/vi-map-with-mutex.h"
 #include "rovioli/vio-update-builder.h"
 
@@ -26,14 +31,37 @@ class MapBuilderFlow {
   MapBuilderFlow(
       const std::shared_ptr<aslam::NCamera>& n_camera,
       vi_map::Imu::UniquePtr imu, const std::string& save_map_folder);
+  ~MapBuilderFlow();
   void attachToMessageFlow(message_flow::MessageFlow* flow);
 
+  // If the map was checkpointed to path, only the proto files that changed
+  // since the last checkpoint are written, and the existing checkpoint is
+  // overwritten regardless of overwrite_existing_map.
   void saveMapAndOptionallyOptimize(
       const std::string& path, const bool overwrite_existing_map,
       const bool process_to_localization_map);
 
  private:
+  // Saves the raw map to the save map folder every
+  // --rovioli_map_checkpoint_period_s while the map is being built.
+  void checkpointWorker();
+  void checkpointMap();
+  void stopCheckpointing();
+
+  // Logs the memory used by the map every --rovioli_map_memory_stats_period_s.
+  // Requires the map mutex.
+  void logMapMemoryUsageIfDue();
+
   VIMapWithMutex::Ptr map_with_mutex_;
+  const std::string save_map_folder_;
+
+  std::thread checkpoint_thread_;
+  std::mutex m_checkpoint_shutdown_;
+  std::condition_variable cv_checkpoint_shutdown_;
+  bool checkpoint_shutdown_requested_;
+  // Guarded by the map mutex.
+  bool has_checkpoint_;
+  std::chrono::steady_clock::time_point last_memory_stats_time_;
 
   // If set then all incoming callbacks that cause operations on the map will be
   // rejected. This is used during shutdown.
@@ -41,6 +69,8 @@ class MapBuilderFlow {
 
   VioUpdateBuilder vio_update_builder_;
   online_map_builders::StreamMapBuilder stream_map_builder_;
+  // Only set with --rovioli_online_loop_closure.
+  std::unique_ptr<OnlineLoopClosure> online_loop_closure_;
 };
 
 }  // namespace rovioli
@@ -0,0 +1,84 @@
+#ifndef ROVIOLI_MEASUREMENT_COMPLETION_H_
+#define ROVIOLI_MEASUREMENT_COMPLETION_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <message-flow/callback-types.h>
+
+namespace rovioli {
+
+// Counts the messages that were published to the synchronizer, the tracker and
+// ROVIO but not yet completely processed by them. The deterministic sensor log
+// playback waits on it after every measurement, so that these stages see the
+// measurements in the same order in every run.
+//
+// A stage registers as a consumer of the topics it subscribes to and completes
+// every message of them once it is processed. Messages published through a
+// wrapped publisher are counted for all consumers of their topic before they
+// are delivered, such that a stage that publishes while processing a message
+// never lets the count drop to zero in between.
+class MeasurementCompletion {
+ public:
+  MeasurementCompletion();
+
+  // Must be called before the first message of the topic is published.
+  template <typename MessageTopicDefinition>
+  void registerConsumer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_consumers_per_topic_[MessageTopicDefinition::kMessageTopic];
+  }
+
+  template <typename MessageTopicDefinition>
+  message_flow::PublisherFunction<MessageTopicDefinition> wrapPublisher(
+      const message_flow::PublisherFunction<MessageTopicDefinition>&
+          publisher) {
+    CHECK(publisher);
+    const std::string topic = MessageTopicDefinition::kMessageTopic;
+    return [this, publisher, topic](
+               const typename MessageTopicDefinition::message_type& message) {
+      addPendingMessagesOfTopic(topic);
+      publisher(message);
+    };
+  }
+
+  // Work that a stage continues outside of its subscriber callback, e.g. on
+  // its own thread. Has to be added before the message it results from is
+  // completed.
+  void addPending(const size_t num_pending);
+  void complete(const size_t num_completed);
+
+  void waitUntilAllCompleted() const;
+
+ private:
+  void addPendingMessagesOfTopic(const std::string& topic);
+
+  mutable std::mutex mutex_;
+  mutable std::condition_variable cv_all_completed_;
+  std::unordered_map<std::string, size_t> num_consumers_per_topic_;
+  size_t num_pending_;
+};
+
+// Completes one message when going out of scope. Does nothing if the
+// completion isn't tracked.
+class ScopedMeasurementCompletion {
+ public:
+  explicit ScopedMeasurementCompletion(
+      MeasurementCompletion* measurement_completion)
+      : measurement_completion_(measurement_completion) {}
+  ~ScopedMeasurementCompletion() {
+    if (measurement_completion_ != nullptr) {
+      measurement_completion_->complete(1u);
+    }
+  }
+
+ private:
+  MeasurementCompletion* const measurement_completion_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_MEASUREMENT_COMPLETION_H_
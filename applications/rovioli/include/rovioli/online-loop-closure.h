@@ -0,0 +1,103 @@
+#ifndef ROVIOLI_ONLINE_LOOP_CLOSURE_H_
+#define ROVIOLI_ONLINE_LOOP_CLOSURE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <aslam/common/pose-types.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <online-map-builders/stream-map-builder.h>
+#include <posegraph/unique-id.h>
+#include <vi-map-helpers/vi-map-manipulation.h>
+#include <vi-map/vi-map.h>
+
+#include "rovioli/vi-map-with-mutex.h"
+
+namespace rovioli {
+
+// Closes loops within the mission that is being built, in the background of
+// the map builder. Every cycle
+//  - initializes and triangulates the landmarks of the vertices that settled
+//    since the last cycle,
+//  - queries these vertices in a loop-closure database that incrementally
+//    grows by the vertices older than --rovioli_online_lc_min_loop_age_s,
+//  - relaxes the pose graph with all loop-closure edges of the mission if new
+//    ones were found. The vertices added afterwards are corrected by the same
+//    transformation as the newest vertex.
+// The landmark initialization and the queries only touch the new vertices and
+// run under the map mutex. The relaxation runs without it, on a copy of the
+// pose graph that holds the vertex states and edges but no visual data.
+// The loop-closure edges stay in the map, so the saved map can be relaxed or
+// optimized offline without running the loop-closure again.
+class OnlineLoopClosure {
+ public:
+  OnlineLoopClosure(
+      VIMapWithMutex* map_with_mutex,
+      online_map_builders::StreamMapBuilder* stream_map_builder);
+  ~OnlineLoopClosure();
+
+  void start();
+  // Waits for a running cycle to finish. Must not be called with the map
+  // mutex held.
+  void stop();
+
+  // Initializes the landmarks of all vertices that weren't processed yet,
+  // continuing the feature tracks of the processed ones. Call with the map
+  // mutex held, once no more vertices are added.
+  void initializeLandmarksOfRemainingVertices();
+
+  // Runs one cycle, locks the map mutex itself. Called periodically by the
+  // worker after start().
+  void processSettledVertices();
+
+ private:
+  void worker();
+  // Appends the vertices after the last processed one up to and including
+  // last_vertex_id.
+  void getUnprocessedVertices(
+      const pose_graph::VertexId& last_vertex_id,
+      pose_graph::VertexIdList* vertex_ids) const;
+  void initializeAndTriangulateLandmarks(
+      const pose_graph::VertexIdList& vertex_ids);
+  // Queues the vertices for the loop-closure database and returns the queued
+  // ones that are old enough to be added now.
+  void getVerticesToAddToDatabase(
+      const pose_graph::VertexIdList& vertex_ids,
+      pose_graph::VertexIdList* database_vertex_ids);
+  // Adds the loop-closure edges of the vertices to the map and returns the
+  // new ones.
+  void detectLoopClosures(
+      const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map,
+      pose_graph::EdgeIdList* new_loop_closure_edge_ids);
+  // Relaxes a pose graph copy, see VIMap::copyPoseGraphFrom().
+  void relaxMission(vi_map::VIMap* pose_graph_copy);
+  // Copies the relaxed vertex states into the map and corrects the vertices
+  // that aren't in the relaxed pose graph. Requires the map mutex.
+  void writeBackRelaxation(
+      const vi_map::VIMap& relaxed_pose_graph,
+      const aslam::Transformation& T_corrected_uncorrected);
+
+  VIMapWithMutex* const map_with_mutex_;
+  online_map_builders::StreamMapBuilder* const stream_map_builder_;
+
+  loop_detector_node::LoopDetectorNode loop_detector_;
+  vi_map_helpers::VIMapManipulation::TrackIndexToLandmarkIdMap
+      track_id_to_landmark_id_;
+  pose_graph::VertexId last_processed_vertex_id_;
+  // Processed vertices that are not yet old enough to be added to the
+  // loop-closure database, in graph order.
+  std::deque<pose_graph::VertexId> vertices_to_add_to_database_;
+  bool database_empty_;
+
+  std::thread worker_thread_;
+  std::mutex m_shutdown_;
+  std::condition_variable cv_shutdown_;
+  bool shutdown_requested_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_ONLINE_LOOP_CLOSURE_H_
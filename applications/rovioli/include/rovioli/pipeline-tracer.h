@@ -0,0 +1,51 @@
+#ifndef ROVIOLI_PIPELINE_TRACER_H_
+#define ROVIOLI_PIPELINE_TRACER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <vio-common/pipeline-trace.h>
+
+namespace rovioli {
+
+// Collects the stages of the nframe traces of the whole pipeline, to break
+// the camera-to-pose latency down into the contributions of the stages.
+class PipelineTracer : public vio::PipelineTraceSink {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(PipelineTracer);
+
+  void addStage(
+      const vio::PipelineTrace& trace,
+      const vio::PipelineTraceStage& stage) override;
+
+  // Writes all stages in the Chrome trace event format, which can be opened in
+  // chrome://tracing or Perfetto. Each stage is shown as a separate thread.
+  bool writeChromeTrace(const std::string& file_path) const;
+
+  // Histograms of the duration of every stage and of the latency from the
+  // nframe entering the pipeline to the end of the stage.
+  std::string printSummary() const;
+
+  size_t getNumRecordedStages() const;
+
+ private:
+  struct Record {
+    int64_t trace_id;
+    int64_t capture_timestamp_ns;
+    int64_t start_ns;
+    vio::PipelineTraceStage stage;
+  };
+
+  // The stage names in the order they were first seen.
+  std::vector<std::string> getStageNames() const;
+
+  mutable std::mutex m_records_;
+  std::vector<Record> records_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_PIPELINE_TRACER_H_
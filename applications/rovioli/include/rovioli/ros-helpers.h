@@ -37,30 +37,10 @@ inline vio::ImuMeasurement::Ptr convertRosImuToMaplabImu(
   return imu_measurement;
 }
 
-inline vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
-    const sensor_msgs::ImageConstPtr& image_message, size_t camera_idx) {
-  CHECK(image_message);
-  cv_bridge::CvImageConstPtr cv_ptr;
-  try {
-    // Convert the image to MONO8 if necessary.
-    cv_ptr = cv_bridge::toCvShare(
-        image_message, sensor_msgs::image_encodings::MONO8);
-  } catch (const cv_bridge::Exception& e) {  // NOLINT
-    LOG(FATAL) << "cv_bridge exception: " << e.what();
-  }
-  CHECK(cv_ptr);
-
-  vio::ImageMeasurement::Ptr image_measurement(new vio::ImageMeasurement);
-  // Unfortunately the clone is necessary as ROS stores the data in an
-  // uint8_t array inside CvImage and not the cv::Mat itself. Keeping the
-  // data alive without holding on to the CvImage is not possible without
-  // letting all the code depend on ROS and boost.
-  image_measurement->image = cv_ptr->image.clone();
-  image_measurement->timestamp =
-      rosTimeToNanoseconds(image_message->header.stamp);
-  image_measurement->camera_index = camera_idx;
-  return image_measurement;
-}
+// Converts the image to MONO8. MONO8 messages are wrapped without copying,
+// other encodings are converted into a buffer of the image buffer pool.
+vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
+    const sensor_msgs::ImageConstPtr& image_message, size_t camera_idx);
 
 }  // namespace rovioli
 
@@ -0,0 +1,33 @@
+#ifndef ROVIOLI_ROVIO_ESTIMATE_POOL_H_
+#define ROVIOLI_ROVIO_ESTIMATE_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rovioli/rovio-estimate.h"
+
+namespace rovioli {
+
+// Recycles the ROVIO estimates, including the memory of their dynamic-size
+// members. An estimate acquired from the pool returns to it once the last
+// pointer to it is gone, wherever in the pipeline that happens, and may
+// outlive the pool.
+class RovioEstimatePool {
+ public:
+  explicit RovioEstimatePool(const size_t max_num_free_estimates);
+
+  // The members of the returned estimate hold the values of a previous use
+  // and have to be overwritten; the trace is reset.
+  RovioEstimate::Ptr acquire();
+
+  size_t getNumFreeEstimates() const;
+
+ private:
+  class FreeList;
+  std::shared_ptr<FreeList> free_list_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_ROVIO_ESTIMATE_POOL_H_
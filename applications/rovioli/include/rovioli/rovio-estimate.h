@@ -4,6 +4,7 @@
 #include <Eigen/Core>
 #include <aslam/common/pose-types.h>
 #include <maplab-common/macros.h>
+#include <vio-common/pipeline-trace.h>
 #include <vio-common/vio-types.h>
 
 namespace rovioli {
@@ -13,9 +14,22 @@ struct RovioEstimate {
 
   double timestamp_s;
   vio::ViNodeState vinode;
+  // Covariance of the position of vinode.
+  Eigen::Matrix3d p_M_I_covariance;
+  // Covariance of [position, orientation] and of [acc bias, gyro bias] in the
+  // parametrization of the ROVIO filter.
+  Eigen::Matrix<double, 6, 6> pose_covariance;
+  Eigen::Matrix<double, 6, 6> imu_bias_covariance;
+  // The full covariance of the ROVIO filter; only set with
+  // --rovio_estimate_copy_full_covariance.
+  Eigen::MatrixXd filter_covariance;
 
   aslam::Transformation T_G_M;
   bool has_T_G_M;
+
+  // Holds the ROVIO update of the image this estimate resulted from; only set
+  // if pipeline tracing is enabled.
+  vio::PipelineTrace::Ptr trace;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_ROVIO_ESTIMATE_H_
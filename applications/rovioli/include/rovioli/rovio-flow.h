@@ -9,6 +9,8 @@
 #include <sensors/imu.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/measurement-completion.h"
+#include "rovioli/rovio-estimate-pool.h"
 #include "rovioli/rovio-estimate.h"
 #include "rovioli/rovio-factory.h"
 
@@ -22,13 +24,33 @@ class RovioFlow {
   void attachToMessageFlow(message_flow::MessageFlow* flow);
   void processRovioUpdate(const rovio::RovioState& state);
 
+  // Reports when the IMU measurements and images are processed. Must be set
+  // before attaching to the message flow; the completion must outlive the
+  // flow.
+  void setMeasurementCompletion(MeasurementCompletion* measurement_completion) {
+    measurement_completion_ = CHECK_NOTNULL(measurement_completion);
+  }
+
+  // Attaches the time spent in the image update to the resulting estimates.
+  void enablePipelineTracing() {
+    pipeline_tracing_enabled_ = true;
+  }
+
  private:
   std::unique_ptr<rovio::RovioInterface> rovio_interface_;
   std::function<void(const RovioEstimate::ConstPtr&)> publish_rovio_estimates_;
+  // The estimates are published at IMU rate.
+  RovioEstimatePool estimate_pool_;
 
   // Indicates if the camera at the corresponding index should be used for
   // motion tracking.
   std::vector<char> is_camera_idx_active_in_motion_tracking_;
+
+  MeasurementCompletion* measurement_completion_;
+
+  bool pipeline_tracing_enabled_;
+  // Start of the image update in progress, or -1 if there is none.
+  int64_t image_update_start_ns_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_ROVIO_FLOW_H_
@@ -3,7 +3,11 @@
 #include <memory>
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <message-flow/message-flow.h>
 #include <sensors/imu.h>
@@ -14,8 +18,11 @@
 #include "rovioli/imu-camera-synchronizer-flow.h"
 #include "rovioli/localizer-flow.h"
 #include "rovioli/map-builder-flow.h"
+#include "rovioli/measurement-completion.h"
+#include "rovioli/pipeline-tracer.h"
 #include "rovioli/rovio-flow.h"
 #include "rovioli/synced-nframe-throttler-flow.h"
+#include "rovioli/tiled-localization-map.h"
 
 namespace rovioli {
 class RovioliNode final {
@@ -27,6 +34,23 @@ class RovioliNode final {
       const std::string& save_map_folder,
       const summary_map::LocalizationSummaryMap* const localization_map,
       message_flow::MessageFlow* flow);
+  // Localizes against the streamed tiles of a tiled localization map instead.
+  RovioliNode(
+      const aslam::NCamera::Ptr& camera_system,
+      vi_map::Imu::UniquePtr maplab_imu_sensor,
+      const vi_map::ImuSigmas& rovio_imu_sigmas,
+      const std::string& save_map_folder,
+      TiledLocalizationMap* const tiled_localization_map,
+      message_flow::MessageFlow* flow);
+  // Loads the localization map in the background. VIO and map building run
+  // from the start, localization is enabled once its database is ready.
+  RovioliNode(
+      const aslam::NCamera::Ptr& camera_system,
+      vi_map::Imu::UniquePtr maplab_imu_sensor,
+      const vi_map::ImuSigmas& rovio_imu_sigmas,
+      const std::string& save_map_folder,
+      const LocalizerFlow::LocalizationMapLoader& load_localization_map,
+      message_flow::MessageFlow* flow);
   ~RovioliNode();
 
   void start();
@@ -40,6 +64,31 @@ class RovioliNode final {
   std::atomic<bool>& isDataSourceExhausted();
 
  private:
+  // Creates the localizer flow, returns nullptr if localization is disabled.
+  typedef std::function<LocalizerFlow*()> LocalizerFlowFactory;
+
+  void initialize(
+      const aslam::NCamera::Ptr& camera_system,
+      vi_map::Imu::UniquePtr maplab_imu_sensor,
+      const vi_map::ImuSigmas& rovio_imu_sigmas,
+      const std::string& save_map_folder,
+      const LocalizerFlowFactory& create_localizer_flow);
+
+  // Periodically exports the message flow delivery statistics if enabled with
+  // --rovioli_message_flow_statistics_export_period_s.
+  void messageFlowStatisticsExportLoop();
+  void exportMessageFlowStatistics() const;
+  // Writes the pipeline trace if enabled with --rovioli_pipeline_trace_file.
+  void exportPipelineTrace() const;
+
+  message_flow::MessageFlow* const flow_;
+
+  // Must outlive the flows, as the in-flight nframes report to it.
+  PipelineTracer::UniquePtr pipeline_tracer_;
+  // Only set with --vio_sensor_log_deterministic; must outlive the flows that
+  // report to it.
+  std::unique_ptr<MeasurementCompletion> measurement_completion_;
+
   std::unique_ptr<DataSourceFlow> datasource_flow_;
   std::unique_ptr<RovioFlow> rovio_flow_;
   std::unique_ptr<LocalizerFlow> localizer_flow_;
@@ -52,6 +101,11 @@ class RovioliNode final {
   // Set to true once the data-source has played back all its data. Will never
   // be true for infinite data-sources (live-data).
   std::atomic<bool> is_datasource_exhausted_;
+
+  std::thread statistics_export_thread_;
+  std::mutex m_statistics_export_;
+  std::condition_variable cv_statistics_export_;
+  bool statistics_export_shutdown_requested_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_ROVIOLI_NODE_H_
@@ -0,0 +1,186 @@
+#ifndef ROVIOLI_SENSOR_LOG_H_
+#define ROVIOLI_SENSOR_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <maplab-common/threadsafe-queue.h>
+#include <vio-common/vio-types.h>
+
+namespace rovioli {
+
+// Native recording of the IMU and image measurements of a data source, as an
+// alternative to rosbags for offline processing. The log is a sequence of
+// chunks of time-sorted records, followed by an index of the chunks:
+//
+//   header:  magic "MLSLOG01"
+//   chunks:  records of [RecordHeader, payload]
+//   index:   one ChunkInfo per chunk
+//   trailer: index offset, number of chunks, magic "MLSLOGIX"
+//
+// The payload of IMU records are the 6 doubles of vio::ImuData, the payload of
+// images an ImageInfo followed by the image as lossless PNG. All values are
+// little endian.
+namespace sensor_log {
+
+enum class RecordType : uint8_t { kImu = 0u, kImage = 1u };
+
+struct RecordHeader {
+  int64_t timestamp_ns;
+  RecordType type;
+  uint8_t reserved[3];
+  int32_t camera_index;
+  uint64_t payload_num_bytes;
+};
+
+struct ImageInfo {
+  int32_t rows;
+  int32_t cols;
+  // OpenCV type of the image, e.g. CV_8UC1.
+  int32_t type;
+  int32_t reserved;
+};
+
+struct ChunkInfo {
+  uint64_t offset;
+  uint64_t num_bytes;
+  uint64_t num_records;
+  int64_t first_timestamp_ns;
+  int64_t last_timestamp_ns;
+};
+
+struct Trailer {
+  uint64_t index_offset;
+  uint64_t num_chunks;
+  char magic[8];
+};
+
+// A record in the memory-mapped log, the payload is valid as long as the
+// reader exists.
+struct Record {
+  RecordHeader header;
+  const char* payload;
+};
+
+vio::ImuMeasurement::Ptr decodeImu(const Record& record);
+vio::ImageMeasurement::Ptr decodeImage(const Record& record);
+
+}  // namespace sensor_log
+
+// Writes measurements to a sensor log on a background thread, which encodes
+// the images. Measurements may arrive out of order by up to
+// --sensor_log_reorder_window_s, e.g. images that are delivered after the IMU
+// measurements of the same time; older measurements are dropped with a
+// warning, such that the log stays sorted.
+//
+// If max_num_pending_measurements is non-zero, adding blocks while as many
+// measurements are waiting for the writer thread, e.g. to convert a recording
+// as fast as it can be encoded. Otherwise, adding never blocks.
+class SensorLogWriter {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(SensorLogWriter);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(SensorLogWriter);
+
+  explicit SensorLogWriter(
+      const std::string& file_path, size_t max_num_pending_measurements = 0u);
+  // Closes the log.
+  ~SensorLogWriter();
+
+  void addImu(const vio::ImuMeasurement::ConstPtr& imu);
+  void addImage(const vio::ImageMeasurement::ConstPtr& image);
+
+  // Writes the pending measurements and the index. Nothing can be added
+  // afterwards.
+  void close();
+
+  size_t getNumDroppedMeasurements() const {
+    return num_dropped_measurements_.load();
+  }
+
+ private:
+  struct Measurement {
+    vio::ImuMeasurement::ConstPtr imu;
+    vio::ImageMeasurement::ConstPtr image;
+  };
+  struct EncodedRecord {
+    sensor_log::RecordHeader header;
+    std::vector<char> payload;
+  };
+
+  void writerWorker();
+  void encodeAndBuffer(const Measurement& measurement);
+  // Writes chunks of the buffered records up to the timestamp. The last
+  // chunk is only written if it is smaller than a full chunk if
+  // write_partial_chunk is set.
+  void writeChunks(int64_t max_timestamp_ns, bool write_partial_chunk);
+  void writeIndex();
+
+  void pushMeasurement(const Measurement& measurement);
+
+  const std::string file_path_;
+  const size_t max_num_pending_measurements_;
+  std::ofstream file_;
+  uint64_t file_offset_;
+
+  common::ThreadSafeQueue<Measurement> measurements_;
+  std::thread writer_thread_;
+  std::atomic<bool> is_closed_;
+
+  // Only accessed by the writer thread.
+  std::multimap<int64_t, EncodedRecord> buffered_records_;
+  uint64_t num_buffered_bytes_;
+  int64_t newest_timestamp_ns_;
+  int64_t last_written_timestamp_ns_;
+  std::vector<sensor_log::ChunkInfo> chunks_;
+
+  std::atomic<size_t> num_dropped_measurements_;
+};
+
+// Memory-maps a sensor log for random access by time.
+class SensorLogReader {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(SensorLogReader);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(SensorLogReader);
+
+  SensorLogReader();
+  ~SensorLogReader();
+
+  // Returns false if the file is not a complete sensor log.
+  bool open(const std::string& file_path);
+
+  size_t getNumChunks() const {
+    return chunks_.size();
+  }
+  size_t getNumRecords() const;
+  // Invalid time if the log is empty.
+  int64_t getFirstTimestampNs() const;
+  int64_t getLastTimestampNs() const;
+
+  // Positions the reader at the first record at or after the timestamp.
+  void seek(int64_t timestamp_ns);
+  // Returns the next record in time order, false at the end of the log.
+  bool readNext(sensor_log::Record* record);
+
+ private:
+  void close();
+  void seekToChunk(size_t chunk_idx);
+
+  const char* data_;
+  size_t num_bytes_;
+  std::vector<sensor_log::ChunkInfo> chunks_;
+
+  size_t chunk_idx_;
+  size_t record_idx_in_chunk_;
+  uint64_t record_offset_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_SENSOR_LOG_H_
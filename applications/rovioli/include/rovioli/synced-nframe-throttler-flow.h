@@ -1,17 +1,32 @@
 #ifndef ROVIOLI_SYNCED_NFRAME_THROTTLER_FLOW_H_
 #define ROVIOLI_SYNCED_NFRAME_THROTTLER_FLOW_H_
 
+#include <memory>
+
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
 #include <message-flow/message-flow.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/localization-scheduler.h"
 #include "rovioli/synced-nframe-throttler.h"
 
+DECLARE_bool(rovioli_adaptive_localization);
+
 namespace rovioli {
 
+// With --rovioli_adaptive_localization, the throttled nframes are further
+// thinned out by the localization scheduler.
 class SyncedNFrameThrottlerFlow {
  public:
+  SyncedNFrameThrottlerFlow() {
+    if (FLAGS_rovioli_adaptive_localization) {
+      scheduler_.reset(new LocalizationScheduler);
+    }
+  }
+
   void attachToMessageFlow(message_flow::MessageFlow* flow) {
     CHECK_NOTNULL(flow);
     static constexpr char kSubscriberNodeName[] = "SyncedNFrameThrottlerFlow";
@@ -27,16 +42,40 @@ class SyncedNFrameThrottlerFlow {
         [publish_result,
          this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
           CHECK(nframe_imu);
-          const bool should_publish =
+          bool should_publish =
               this->throttler_.shouldPublishNFrame(nframe_imu);
+          if (should_publish && this->scheduler_ != nullptr) {
+            should_publish = this->scheduler_->shouldLocalizeNFrame(
+                nframe_imu->nframe->getMinTimestampNanoseconds());
+          }
           if (should_publish) {
             publish_result(nframe_imu);
           }
         });
+
+    if (scheduler_ == nullptr) {
+      return;
+    }
+    flow->registerSubscriber<message_flow_topics::ROVIO_ESTIMATES>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const RovioEstimate::ConstPtr& rovio_estimate) {
+          CHECK(rovio_estimate);
+          this->scheduler_->processVioEstimate(
+              aslam::time::secondsToNanoSeconds(rovio_estimate->timestamp_s),
+              rovio_estimate->vinode.get_T_M_I(),
+              rovio_estimate->p_M_I_covariance);
+        });
+    flow->registerSubscriber<message_flow_topics::LOCALIZATION_ATTEMPTS>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const LocalizationAttempt::ConstPtr& attempt) {
+          CHECK(attempt);
+          this->scheduler_->processLocalizationAttempt(*attempt);
+        });
   }
 
  private:
   SyncedNFrameThrottler throttler_;
+  std::unique_ptr<LocalizationScheduler> scheduler_;
 };
 
 }  // namespace rovioli
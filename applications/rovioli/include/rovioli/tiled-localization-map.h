@@ -0,0 +1,71 @@
+#ifndef ROVIOLI_TILED_LOCALIZATION_MAP_H_
+#define ROVIOLI_TILED_LOCALIZATION_MAP_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <localization-summary-map/localization-summary-map-tiles.h>
+#include <maplab-common/macros.h>
+
+#include "rovioli/localization-database.h"
+
+namespace rovioli {
+
+// Keeps the localization databases of the summary map tiles within
+// --rovioli_tiled_map_load_radius_m of the current position in memory. The
+// tiles are loaded and evicted by a background thread; if the tiles in the
+// radius exceed --rovioli_tiled_map_memory_budget_mb, the furthest ones are
+// left out.
+class TiledLocalizationMap {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(TiledLocalizationMap);
+
+  TiledLocalizationMap() = delete;
+  // Loads the tiles around G_p_initial before returning.
+  TiledLocalizationMap(
+      const std::string& folder_path, const Eigen::Vector3d& G_p_initial);
+  ~TiledLocalizationMap();
+
+  // Updates the tiles in the background if G_p is in a different tile than
+  // the previous position.
+  void setPosition(const Eigen::Vector3d& G_p);
+
+  void getLoadedDatabases(
+      std::vector<LocalizationDatabase::ConstPtr>* databases) const;
+  size_t getNumLoadedTiles() const;
+  // Estimated memory of the loaded tiles.
+  size_t getNumLoadedBytes() const;
+
+  // Blocks until the tiles around the latest position are loaded.
+  void waitUntilIdle() const;
+
+ private:
+  void loaderThread();
+  void updateLoadedTiles(const Eigen::Vector3d& G_p);
+  void loadTile(size_t tile_index);
+
+  summary_map::LocalizationSummaryMapTiles tiles_;
+
+  mutable std::mutex m_loaded_tiles_;
+  // Indexed by the position of the tile in tiles_.tiles().
+  std::unordered_map<size_t, LocalizationDatabase::ConstPtr> loaded_tiles_;
+  size_t num_loaded_bytes_;
+
+  mutable std::mutex m_request_;
+  mutable std::condition_variable cv_request_;
+  Eigen::Vector2i requested_tile_coordinates_;
+  Eigen::Vector3d requested_position_;
+  bool has_request_;
+  bool is_loading_;
+  bool shutdown_requested_;
+  std::thread loader_thread_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_TILED_LOCALIZATION_MAP_H_
@@ -5,10 +5,11 @@
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
+#include <vector>
 
 #include <aslam/common/memory.h>
+#include <glog/logging.h>
 #include <vio-common/vio-types.h>
 #include <vio-common/vio-update.h>
 
@@ -31,30 +32,82 @@ class VioUpdateBuilder {
   void processSynchronizedNFrameImu(
       const vio::SynchronizedNFrameImu::ConstPtr& synced_nframe_imu);
   void processRovioEstimate(const RovioEstimate::ConstPtr& rovio_estimate);
+  // The localizer may complete nframes out of order; results that are not
+  // newer than the last accepted one are dropped.
   void processLocalizationResult(
       const vio::LocalizationResult::ConstPtr& localization_result);
 
   void clearSynchronizedNFrameImuQueue() {
     // For unit tests.
-    SynchronizedNFrameImuQueue empty_queue;
-    synced_nframe_imu_queue_.swap(empty_queue);
+    std::lock_guard<std::mutex> lock(m_synced_nframe_imu_queue_);
+    synced_nframe_imu_queue_.clear();
   }
 
  private:
-  typedef std::queue<vio::SynchronizedNFrameImu::ConstPtr>
+  // The synced nframes with the time they were received, for tracing.
+  typedef std::deque<std::pair<vio::SynchronizedNFrameImu::ConstPtr, int64_t>>
       SynchronizedNFrameImuQueue;
-  typedef Aligned<std::deque, RovioEstimate::ConstPtr> RovioEstimateQueue;
 
-  void findMatchAndPublish();
+  // Fixed-capacity ring buffer of the ROVIO estimates, ordered by their
+  // strictly increasing timestamps. The oldest estimate is overwritten once
+  // the buffer is full.
+  class RovioEstimateBuffer {
+   public:
+    explicit RovioEstimateBuffer(size_t min_capacity);
+
+    void push(const RovioEstimate::ConstPtr& rovio_estimate);
+    // Index of the first estimate that is newer than timestamp_ns, or size()
+    // if there is none.
+    size_t upperBound(const int64_t timestamp_ns) const;
+    // Drops the num_estimates oldest estimates.
+    void popFront(const size_t num_estimates);
+
+    size_t size() const {
+      return size_;
+    }
+    const RovioEstimate::ConstPtr& estimate(const size_t index) const {
+      CHECK_LT(index, size_);
+      return estimates_[(begin_ + index) & index_mask_];
+    }
+    int64_t timestampNs(const size_t index) const {
+      CHECK_LT(index, size_);
+      return timestamps_ns_[(begin_ + index) & index_mask_];
+    }
+
+   private:
+    const size_t index_mask_;
+    std::vector<RovioEstimate::ConstPtr> estimates_;
+    std::vector<int64_t> timestamps_ns_;
+    size_t begin_;
+    size_t size_;
+  };
+
+  // Publishes the VIO updates of all queued synced nframes that can be
+  // matched to the buffered estimates. Requires m_synced_nframe_imu_queue_.
+  void findMatchesAndPublish();
+  bool findMatchAndPublish();
+  // Returns a pooled VioUpdate that is no longer referenced by any
+  // subscriber, or a newly allocated one if all are still in use.
+  vio::VioUpdate::Ptr getVioUpdateStorage();
   void interpolateViNodeState(
       const int64_t timestamp_ns_a, const vio::ViNodeState& vi_node_a,
       const int64_t timestamp_ns_b, const vio::ViNodeState& vi_node_b,
       const int64_t timestamp_ns_interpolated,
       vio::ViNodeState* vi_node_interpolated);
 
-  std::recursive_mutex queue_mutex_;
+  // Lock order: m_synced_nframe_imu_queue_ before m_rovio_estimate_buffer_.
+  // The nframe queue mutex also serializes the matching and publishing, such
+  // that the VIO updates are published in order. The estimate buffer is only
+  // locked for pushing and the lookups, so a publisher of estimates never
+  // waits for the subscribers of the VIO updates while holding it.
+  std::mutex m_synced_nframe_imu_queue_;
   SynchronizedNFrameImuQueue synced_nframe_imu_queue_;
-  RovioEstimateQueue rovio_estimate_queue_;
+  static constexpr size_t kVioUpdatePoolSize = 8u;
+  std::vector<vio::VioUpdate::Ptr> vio_update_pool_;
+
+  std::mutex m_rovio_estimate_buffer_;
+  RovioEstimateBuffer rovio_estimate_buffer_;
+
   // These values indicate the timestamp of the last message in the given topic
   // so that we can enforce that the timestamps are strictly monotonically
   // increasing
@@ -65,6 +118,7 @@ class VioUpdateBuilder {
 
   std::mutex mutex_last_localization_state_;
   vio::LocalizationState last_localization_state_;
+  int64_t last_localization_timestamp_ns_;
 };
 
 }  // namespace rovioli
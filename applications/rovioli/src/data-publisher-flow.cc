@@ -1,6 +1,14 @@
 #include "rovioli/data-publisher-flow.h"
 
-#include <maplab-common/file-logger.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <limits>
+#include <sstream>
+
+#include <maplab-common/thread-topology.h>
 #include <minkindr_conversions/kindr_msg.h>
 
 DEFINE_double(
@@ -26,6 +34,17 @@ DEFINE_bool(
     "Set to false to disable map visualization. Note: map building needs to be "
     "active for the visualization.");
 
+DEFINE_double(
+    rovioli_publish_max_rate_hz, 0.0,
+    "Maximum rate of publishing the state estimates and TFs to ROS [Hz]. "
+    "Updates in between are dropped, only the latest one is published. 0 "
+    "publishes every update the publisher thread keeps up with.");
+
+DEFINE_int32(
+    rovioli_publisher_nice, 10,
+    "Nice value of the publisher thread, higher values give the estimator "
+    "precedence.");
+
 DECLARE_bool(rovioli_run_map_builder);
 
 namespace rovioli {
@@ -33,11 +52,24 @@ namespace rovioli {
 DataPublisherFlow::DataPublisherFlow()
     : map_publisher_timeout_(
           common::TimeoutCounter(
-              FLAGS_map_publish_interval_s * kSecondsToNanoSeconds)) {
+              FLAGS_map_publish_interval_s * kSecondsToNanoSeconds)),
+      shutdown_requested_(false) {
   visualization::RVizVisualizationSink::init();
   plotter_.reset(new visualization::ViwlsGraphRvizPlotter);
 }
 
+DataPublisherFlow::~DataPublisherFlow() {
+  if (publisher_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_pending_);
+      shutdown_requested_ = true;
+    }
+    cv_pending_.notify_all();
+    // Publishes and writes the remaining data.
+    publisher_thread_.join();
+  }
+}
+
 void DataPublisherFlow::registerPublishers() {
   pub_pose_T_M_I_ =
       node_handle_.advertise<geometry_msgs::PoseStamped>(kTopicPoseMission, 1);
@@ -59,8 +91,12 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   static constexpr char kSubscriberNodeName[] = "DataPublisherFlow";
 
   if (FLAGS_rovioli_run_map_builder && FLAGS_rovioli_visualize_map) {
+    // Only the most recent map is of interest for the visualization.
+    message_flow::DeliveryOptions map_visualization_options =
+        message_flow::DeliveryOptions::latestOnly();
+    map_visualization_options.priority = message_flow::DeliveryPriority::kBulk;
     flow->registerSubscriber<message_flow_topics::RAW_VIMAP>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        kSubscriberNodeName, map_visualization_options,
         [this](const VIMapWithMutex::ConstPtr& map_with_mutex) {
           if (map_publisher_timeout_.reached()) {
             std::lock_guard<std::mutex> lock(map_with_mutex->mutex);
@@ -73,71 +109,190 @@ void DataPublisherFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   // Publish localization results.
   flow->registerSubscriber<message_flow_topics::LOCALIZATION_RESULT>(
       kSubscriberNodeName, message_flow::DeliveryOptions(),
-      [&](const vio::LocalizationResult::ConstPtr& localization) {
+      [this](const vio::LocalizationResult::ConstPtr& localization) {
         CHECK(localization != nullptr);
-        localizationCallback(localization->T_G_I_lc_pnp.getPosition());
+        {
+          std::lock_guard<std::mutex> lock(m_pending_);
+          pending_localizations_.emplace_back(localization);
+        }
+        cv_pending_.notify_one();
       });
 
   flow->registerSubscriber<message_flow_topics::ROVIO_ESTIMATES>(
       kSubscriberNodeName, message_flow::DeliveryOptions(),
-      [&](const RovioEstimate::ConstPtr& state) {
+      [this](const RovioEstimate::ConstPtr& state) {
         CHECK(state != nullptr);
         if (!FLAGS_publish_only_on_keyframes) {
-          stateCallback(
-              state->timestamp_s * kSecondsToNanoSeconds, state->vinode,
-              state->has_T_G_M, state->T_G_M);
+          {
+            std::lock_guard<std::mutex> lock(m_pending_);
+            pending_estimate_ = state;
+          }
+          cv_pending_.notify_one();
         }
       });
 
+  // Stale state updates are of no use for the visualization; a lagging
+  // publisher should only ever show the latest state. The callback only hands
+  // the update to the publisher thread, so it can run with the estimator.
+  message_flow::DeliveryOptions vio_update_options =
+      message_flow::DeliveryOptions::latestOnly();
+  vio_update_options.priority = message_flow::DeliveryPriority::kRealTime;
   flow->registerSubscriber<message_flow_topics::VIO_UPDATES>(
-      kSubscriberNodeName, message_flow::DeliveryOptions(),
+      kSubscriberNodeName, vio_update_options,
       [this](const vio::VioUpdate::ConstPtr& vio_update) {
         CHECK(vio_update != nullptr);
         if (FLAGS_publish_only_on_keyframes) {
-          bool has_T_G_M =
-              (vio_update->localization_state ==
-                   vio::LocalizationState::kLocalized ||
-               vio_update->localization_state ==
-                   vio::LocalizationState::kMapTracking);
-
-          stateCallback(
-              vio_update->timestamp_ns, vio_update->vinode, has_T_G_M,
-              vio_update->T_G_M);
+          {
+            std::lock_guard<std::mutex> lock(m_pending_);
+            pending_keyframe_update_ = vio_update;
+          }
+          cv_pending_.notify_one();
         }
       });
 
   // CSV export for end-to-end test.
   if (!FLAGS_export_estimated_poses_to_csv.empty()) {
-    // Lambda function will take ownership.
-    std::shared_ptr<common::FileLogger> file_logger =
-        std::make_shared<common::FileLogger>(
-            FLAGS_export_estimated_poses_to_csv);
+    csv_logger_.reset(
+        new common::FileLogger(FLAGS_export_estimated_poses_to_csv));
     constexpr char kDelimiter[] = ", ";
-    file_logger->writeDataWithDelimiterAndNewLine(
+    csv_logger_->writeDataWithDelimiterAndNewLine(
         kDelimiter, "# Timestamp [s]", "t_G_M x [m]", "t_G_I M [m]",
         "t_G_M z [m]", "q_G_M x", "q_G_M y", "q_G_M z", "q_G_M w",
         "p_M_I x [m]", "t_G_I M [m]", "p_M_I z [m]", "q_M_I x", "q_M_I y",
         "q_M_I z", "q_M_I w", "has T_G_M");
-    CHECK(file_logger != nullptr);
+    // Every update is exported.
     flow->registerSubscriber<message_flow_topics::VIO_UPDATES>(
         kSubscriberNodeName, message_flow::DeliveryOptions(),
-        [file_logger, kDelimiter,
-         this](const vio::VioUpdate::ConstPtr& vio_update) {
+        [this](const vio::VioUpdate::ConstPtr& vio_update) {
           CHECK(vio_update != nullptr);
-          const bool has_T_G_M = vio_update->localization_state ==
-                                 vio::LocalizationState::kLocalized;
-          if (has_T_G_M) {
-            latest_T_G_M_ = vio_update->T_G_M;
+          {
+            std::lock_guard<std::mutex> lock(m_pending_);
+            pending_csv_rows_.emplace_back(vio_update);
           }
-          const aslam::Transformation T_M_I = vio_update->vinode.get_T_M_I();
-
-          file_logger->writeDataWithDelimiterAndNewLine(
-              kDelimiter,
-              aslam::time::nanoSecondsToSeconds(vio_update->timestamp_ns),
-              latest_T_G_M_.getPosition(), latest_T_G_M_.getEigenQuaternion(),
-              T_M_I.getPosition(), T_M_I.getEigenQuaternion(), has_T_G_M);
+          cv_pending_.notify_one();
         });
   }
+
+  CHECK(!publisher_thread_.joinable());
+  publisher_thread_ = std::thread(&DataPublisherFlow::publisherLoop, this);
+}
+
+bool DataPublisherFlow::hasPendingData() const {
+  return pending_estimate_ != nullptr || pending_keyframe_update_ != nullptr ||
+         !pending_localizations_.empty() || !pending_csv_rows_.empty();
+}
+
+void DataPublisherFlow::publisherLoop() {
+  common::setCurrentThreadAffinity(
+      common::ThreadTopology::instance().getStageCpus("publisher"));
+  // The nice value applies to the calling thread only on Linux.
+  if (setpriority(
+          PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+          FLAGS_rovioli_publisher_nice) != 0) {
+    LOG(WARNING) << "Unable to set the nice value of the publisher thread to "
+                 << FLAGS_rovioli_publisher_nice << ".";
+  }
+
+  CHECK_GE(FLAGS_rovioli_publish_max_rate_hz, 0.0);
+  const std::chrono::steady_clock::duration min_publish_period =
+      FLAGS_rovioli_publish_max_rate_hz > 0.0
+          ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(
+                    1.0 / FLAGS_rovioli_publish_max_rate_hz))
+          : std::chrono::steady_clock::duration::zero();
+
+  RovioEstimate::ConstPtr estimate;
+  vio::VioUpdate::ConstPtr keyframe_update;
+  std::vector<vio::LocalizationResult::ConstPtr> localizations;
+  std::vector<vio::VioUpdate::ConstPtr> csv_rows;
+  std::unique_lock<std::mutex> lock(m_pending_);
+  while (true) {
+    cv_pending_.wait(
+        lock, [this]() { return shutdown_requested_ || hasPendingData(); });
+    if (!hasPendingData()) {
+      CHECK(shutdown_requested_);
+      break;
+    }
+    const std::chrono::steady_clock::time_point next_publish_time =
+        std::chrono::steady_clock::now() + min_publish_period;
+    estimate.swap(pending_estimate_);
+    keyframe_update.swap(pending_keyframe_update_);
+    localizations.swap(pending_localizations_);
+    csv_rows.swap(pending_csv_rows_);
+    lock.unlock();
+
+    if (estimate != nullptr) {
+      stateCallback(
+          estimate->timestamp_s * kSecondsToNanoSeconds, estimate->vinode,
+          estimate->has_T_G_M, estimate->T_G_M);
+      estimate.reset();
+    }
+    if (keyframe_update != nullptr) {
+      const bool has_T_G_M =
+          (keyframe_update->localization_state ==
+               vio::LocalizationState::kLocalized ||
+           keyframe_update->localization_state ==
+               vio::LocalizationState::kMapTracking);
+      stateCallback(
+          keyframe_update->timestamp_ns, keyframe_update->vinode, has_T_G_M,
+          keyframe_update->T_G_M);
+      keyframe_update.reset();
+    }
+    if (!localizations.empty()) {
+      for (const vio::LocalizationResult::ConstPtr& localization :
+           localizations) {
+        localizationCallback(localization->T_G_I_lc_pnp.getPosition());
+      }
+      localizations.clear();
+    }
+    if (!csv_rows.empty()) {
+      writeCsvRows(csv_rows);
+      csv_rows.clear();
+    }
+
+    lock.lock();
+    if (min_publish_period > std::chrono::steady_clock::duration::zero()) {
+      // Updates that arrive in the meantime are coalesced.
+      cv_pending_.wait_until(
+          lock, next_publish_time, [this]() { return shutdown_requested_; });
+    }
+  }
+}
+
+void DataPublisherFlow::writeCsvRows(
+    const std::vector<vio::VioUpdate::ConstPtr>& vio_updates) {
+  CHECK(csv_logger_ != nullptr);
+  // Format the whole batch first, the logger flushes on every line.
+  constexpr char kDelimiter[] = ", ";
+  std::ostringstream rows;
+  rows.precision(std::numeric_limits<double>::digits10);
+  for (const vio::VioUpdate::ConstPtr& vio_update : vio_updates) {
+    CHECK(vio_update != nullptr);
+    const bool has_T_G_M =
+        vio_update->localization_state == vio::LocalizationState::kLocalized;
+    if (has_T_G_M) {
+      latest_T_G_M_ = vio_update->T_G_M;
+    }
+    const aslam::Transformation T_M_I = vio_update->vinode.get_T_M_I();
+    const Eigen::Vector3d& t_G_M = latest_T_G_M_.getPosition();
+    const Eigen::Quaterniond& q_G_M = latest_T_G_M_.getEigenQuaternion();
+    const Eigen::Vector3d& p_M_I = T_M_I.getPosition();
+    const Eigen::Quaterniond& q_M_I = T_M_I.getEigenQuaternion();
+    rows << aslam::time::nanoSecondsToSeconds(vio_update->timestamp_ns);
+    for (int i = 0; i < 3; ++i) {
+      rows << kDelimiter << t_G_M[i];
+    }
+    rows << kDelimiter << q_G_M.x() << kDelimiter << q_G_M.y() << kDelimiter
+         << q_G_M.z() << kDelimiter << q_G_M.w();
+    for (int i = 0; i < 3; ++i) {
+      rows << kDelimiter << p_M_I[i];
+    }
+    rows << kDelimiter << q_M_I.x() << kDelimiter << q_M_I.y() << kDelimiter
+         << q_M_I.z() << kDelimiter << q_M_I.w() << kDelimiter << has_T_G_M
+         << '\n';
+  }
+  *csv_logger_ << rows.str();
+  csv_logger_->flushBuffer();
 }
 
 void DataPublisherFlow::visualizeMap(const vi_map::VIMap& vi_map) const {
@@ -10,9 +10,18 @@
 
 #include "rovioli/datasource-rosbag.h"
 #include "rovioli/datasource-rostopic.h"
+#include "rovioli/datasource-sensor-log.h"
 
-DEFINE_string(datasource_type, "rosbag", "Data source type: rosbag / rostopic");
+DEFINE_string(
+    datasource_type, "rosbag",
+    "Data source type: rosbag / rostopic / sensorlog");
 DEFINE_string(datasource_rosbag, "", "Path to rosbag for bag sources.");
+DEFINE_string(
+    datasource_sensor_log, "", "Path to the sensor log for sensorlog sources.");
+DEFINE_string(
+    datasource_record_sensor_log, "",
+    "If set, the measurements of the data source are recorded to a sensor log "
+    "at this path, which can be played back with --datasource_type=sensorlog.");
 
 namespace rovioli {
 
@@ -21,6 +30,8 @@ DataSourceType stringToDataSource(const std::string& str) {
     return DataSourceType::kRosTopic;
   } else if (str == "rosbag") {
     return DataSourceType::kRosBag;
+  } else if (str == "sensorlog") {
+    return DataSourceType::kSensorLog;
   }
   LOG(FATAL) << "Unknown datasource: " << str;
   return DataSourceType::kRosBag;  // Silence warning.
@@ -39,6 +50,11 @@ DataSource* createAndConfigureDataSourcefromGFlags(
     case DataSourceType::kRosTopic:
       return new DataSourceRostopic(topic_settings);
       break;
+    case DataSourceType::kSensorLog:
+      CHECK(!FLAGS_datasource_sensor_log.empty());
+      CHECK(common::fileExists(FLAGS_datasource_sensor_log));
+      return new DataSourceSensorLog(FLAGS_datasource_sensor_log);
+      break;
     default:
       LOG(FATAL);
       break;
@@ -2,11 +2,13 @@
 
 #include <atomic>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <aslam/common/time.h>
+#include <aslam/common/thread-pool.h>
 #include <boost/bind.hpp>
 #include <maplab-common/accessors.h>
 #include <maplab-common/file-system-tools.h>
@@ -30,6 +32,22 @@ DEFINE_double(
     vio_rosbag_realtime_playback_rate, 1.0,
     "Playback rate of the ROSBAG. Real-time corresponds to 1.0. "
     "This only makes sense when using offline data sources.");
+DEFINE_bool(
+    vio_rosbag_throttle_by_backpressure, false,
+    "Play the rosbag back as fast as the subscribers accept the messages "
+    "instead of following the bag timestamps. The messages are read ahead and "
+    "decoded on a thread pool. Use together with "
+    "--rovioli_backpressure_queue_capacity, otherwise the message queues grow "
+    "without bound.");
+DEFINE_uint64(
+    vio_rosbag_read_ahead_size, 64u,
+    "Maximum number of messages read ahead of the publishing when throttling "
+    "by back-pressure.");
+DEFINE_uint64(
+    vio_rosbag_num_decoder_threads, 2u,
+    "Number of threads converting the images when throttling by "
+    "back-pressure.");
+DECLARE_uint64(rovioli_backpressure_queue_capacity);
 DEFINE_bool(
     rovioli_zero_initial_timestamps, false,
     "If set to true, the timestamps outputted by the estimator start with 0. "
@@ -55,15 +73,42 @@ DataSourceRosbag::~DataSourceRosbag() {
 }
 
 void DataSourceRosbag::startStreaming() {
+  if (!FLAGS_vio_rosbag_throttle_by_backpressure) {
+    streaming_thread_.reset(
+        new std::thread(std::bind(&DataSourceRosbag::streamingWorker, this)));
+    return;
+  }
+
+  LOG_IF(WARNING, FLAGS_rovioli_backpressure_queue_capacity == 0u)
+      << "Throttling the rosbag playback by back-pressure without "
+      << "--rovioli_backpressure_queue_capacity. The data is played back "
+      << "without any throttling.";
+  CHECK_GT(FLAGS_vio_rosbag_read_ahead_size, 0u);
+  CHECK_GT(FLAGS_vio_rosbag_num_decoder_threads, 0u);
+  decoder_thread_pool_.reset(
+      new aslam::ThreadPool(FLAGS_vio_rosbag_num_decoder_threads));
+  read_ahead_thread_.reset(
+      new std::thread(std::bind(&DataSourceRosbag::readAheadWorker, this)));
   streaming_thread_.reset(
-      new std::thread(std::bind(&DataSourceRosbag::streamingWorker, this)));
+      new std::thread(
+          std::bind(
+              &DataSourceRosbag::streamingWorkerThrottledByBackpressure,
+              this)));
 }
 
 void DataSourceRosbag::shutdown() {
   shutdown_requested_ = true;
+  // Unblocks the read-ahead and the streaming thread.
+  decoded_messages_.Shutdown();
   if (streaming_thread_ != nullptr && streaming_thread_->joinable()) {
     streaming_thread_->join();
   }
+  if (read_ahead_thread_ != nullptr && read_ahead_thread_->joinable()) {
+    read_ahead_thread_->join();
+  }
+  if (decoder_thread_pool_ != nullptr) {
+    decoder_thread_pool_->stop();
+  }
 }
 
 std::string DataSourceRosbag::getDatasetName() const {
@@ -148,37 +193,19 @@ void DataSourceRosbag::streamingWorker() {
     const rosbag::MessageInstance& message = *it_message;
     const std::string& topic = message.getTopic();
     CHECK(!topic.empty());
-    // Enqueue image messages.
+    DecodedMessage decoded_message;
     sensor_msgs::ImageConstPtr image_message =
         message.instantiate<sensor_msgs::Image>();
     if (image_message) {
       const size_t camera_idx =
           common::getChecked(ros_topics_.camera_topic_cam_index_map, topic);
-      vio::ImageMeasurement::Ptr image_measurement =
+      decoded_message.image =
           convertRosImageToMaplabImage(image_message, camera_idx);
-
-      // Shift timestamps to start at 0.
-      if (!FLAGS_rovioli_zero_initial_timestamps ||
-          shiftByFirstTimestamp(&(image_measurement->timestamp))) {
-        VLOG(3) << "Publish Image measurement...";
-        invokeImageCallbacks(image_measurement);
-      }
-    }
-
-    // Enqueue IMU messages.
-    if (topic == ros_topics_.imu_topic) {
-      sensor_msgs::ImuConstPtr imu_msg =
-          message.instantiate<sensor_msgs::Imu>();
-      vio::ImuMeasurement::Ptr imu_measurement =
-          convertRosImuToMaplabImu(imu_msg);
-
-      // Shift timestamps to start at 0.
-      if (!FLAGS_rovioli_zero_initial_timestamps ||
-          shiftByFirstTimestamp(&(imu_measurement->timestamp))) {
-        VLOG(3) << "Publish IMU measurement...";
-        invokeImuCallbacks(imu_measurement);
-      }
+    } else if (topic == ros_topics_.imu_topic) {
+      decoded_message.imu =
+          convertRosImuToMaplabImu(message.instantiate<sensor_msgs::Imu>());
     }
+    publishMeasurement(decoded_message);
 
     // Wait for the time between messages.
     rosbag::View::iterator it_next_message = it_message;
@@ -197,4 +224,89 @@ void DataSourceRosbag::streamingWorker() {
   return;
 }
 
+void DataSourceRosbag::readAheadWorker() {
+  CHECK(bag_view_);
+  CHECK(decoder_thread_pool_);
+  // NOTE: the messages are deserialized on this thread, as the bag can't be
+  // read from multiple threads.
+  for (const rosbag::MessageInstance& message : *bag_view_) {
+    if (shutdown_requested_) {
+      return;
+    }
+    const std::string& topic = message.getTopic();
+    CHECK(!topic.empty());
+
+    DecodedMessageFuture decoded_message;
+    sensor_msgs::ImageConstPtr image_message =
+        message.instantiate<sensor_msgs::Image>();
+    if (image_message) {
+      const size_t camera_idx =
+          common::getChecked(ros_topics_.camera_topic_cam_index_map, topic);
+      decoded_message =
+          decoder_thread_pool_
+              ->enqueue([image_message, camera_idx]() {
+                DecodedMessage decoded;
+                decoded.image =
+                    convertRosImageToMaplabImage(image_message, camera_idx);
+                return decoded;
+              })
+              .share();
+    } else if (topic == ros_topics_.imu_topic) {
+      std::promise<DecodedMessage> decoded_imu;
+      DecodedMessage decoded;
+      decoded.imu =
+          convertRosImuToMaplabImu(message.instantiate<sensor_msgs::Imu>());
+      decoded_imu.set_value(decoded);
+      decoded_message = decoded_imu.get_future().share();
+    } else {
+      continue;
+    }
+
+    if (!decoded_messages_.PushBlockingIfFull(
+            decoded_message, FLAGS_vio_rosbag_read_ahead_size)) {
+      return;
+    }
+  }
+  // Marks the end of the bag.
+  decoded_messages_.PushBlockingIfFull(
+      DecodedMessageFuture(), FLAGS_vio_rosbag_read_ahead_size);
+}
+
+void DataSourceRosbag::streamingWorkerThrottledByBackpressure() {
+  // The delivery queues of the subscribers block the publishing once they are
+  // full, so there is no need to wait between the messages.
+  DecodedMessageFuture decoded_message;
+  while (decoded_messages_.PopBlocking(&decoded_message)) {
+    if (!decoded_message.valid()) {
+      LOG(INFO) << "Rosbag playback finished!";
+      all_data_streamed_ = true;
+      invokeEndOfDataCallbacks();
+      return;
+    }
+    if (shutdown_requested_) {
+      return;
+    }
+    publishMeasurement(decoded_message.get());
+  }
+}
+
+void DataSourceRosbag::publishMeasurement(
+    const DecodedMessage& decoded_message) {
+  // Shift timestamps to start at 0.
+  if (decoded_message.image) {
+    if (!FLAGS_rovioli_zero_initial_timestamps ||
+        shiftByFirstTimestamp(&(decoded_message.image->timestamp))) {
+      VLOG(3) << "Publish Image measurement...";
+      invokeImageCallbacks(decoded_message.image);
+    }
+  }
+  if (decoded_message.imu) {
+    if (!FLAGS_rovioli_zero_initial_timestamps ||
+        shiftByFirstTimestamp(&(decoded_message.imu->timestamp))) {
+      VLOG(3) << "Publish IMU measurement...";
+      invokeImuCallbacks(decoded_message.imu);
+    }
+  }
+}
+
 }  // namespace rovioli
@@ -0,0 +1,231 @@
+#include "rovioli/datasource-sensor-log.h"
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <aslam/common/thread-pool.h>
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+
+DEFINE_double(
+    vio_sensor_log_start_s, 0.0,
+    "Start of the sensor log playback in seconds after the first measurement.");
+DEFINE_double(
+    vio_sensor_log_end_s, 0.0,
+    "End of the sensor log playback in seconds after the first measurement, 0 "
+    "plays the log to the end.");
+DEFINE_double(
+    vio_sensor_log_playback_rate, 1.0,
+    "Playback rate of the sensor log, real-time corresponds to 1.0. Values <= "
+    "0 play the log back as fast as the subscribers accept the measurements.");
+DEFINE_bool(
+    vio_sensor_log_deterministic, false,
+    "Play the sensor log back as fast as the pipeline processes the "
+    "measurements, waiting until the synchronizer, the tracker and ROVIO "
+    "processed every measurement. The results are identical across runs. "
+    "Overrides --vio_sensor_log_playback_rate.");
+DEFINE_uint64(
+    vio_sensor_log_read_ahead_size, 64u,
+    "Maximum number of measurements decoded ahead of the publishing.");
+DEFINE_uint64(
+    vio_sensor_log_num_decoder_threads, 2u,
+    "Number of threads decoding the images of the sensor log.");
+DECLARE_bool(rovioli_zero_initial_timestamps);
+
+namespace rovioli {
+
+DataSourceSensorLog::DataSourceSensorLog(const std::string& sensor_log_path)
+    : sensor_log_path_(sensor_log_path),
+      start_timestamp_ns_(0),
+      end_timestamp_ns_(0),
+      shutdown_requested_(false),
+      all_data_streamed_(false) {
+  CHECK(reader_.open(sensor_log_path_))
+      << "Could not read the sensor log " << sensor_log_path_ << '.';
+  CHECK_GT(reader_.getNumRecords(), 0u)
+      << "The sensor log " << sensor_log_path_ << " is empty.";
+
+  CHECK_GE(FLAGS_vio_sensor_log_start_s, 0.0);
+  const int64_t first_timestamp_ns = reader_.getFirstTimestampNs();
+  start_timestamp_ns_ =
+      first_timestamp_ns + aslam::time::seconds(FLAGS_vio_sensor_log_start_s);
+  end_timestamp_ns_ = reader_.getLastTimestampNs();
+  if (FLAGS_vio_sensor_log_end_s > 0.0) {
+    CHECK_GT(FLAGS_vio_sensor_log_end_s, FLAGS_vio_sensor_log_start_s);
+    end_timestamp_ns_ =
+        first_timestamp_ns + aslam::time::seconds(FLAGS_vio_sensor_log_end_s);
+  }
+  reader_.seek(start_timestamp_ns_);
+  LOG(INFO) << "Opened the sensor log " << sensor_log_path_ << " with "
+            << reader_.getNumRecords() << " measurements.";
+}
+
+DataSourceSensorLog::~DataSourceSensorLog() {
+  shutdown();
+}
+
+void DataSourceSensorLog::startStreaming() {
+  CHECK_GT(FLAGS_vio_sensor_log_read_ahead_size, 0u);
+  CHECK_GT(FLAGS_vio_sensor_log_num_decoder_threads, 0u);
+  decoder_thread_pool_.reset(
+      new aslam::ThreadPool(FLAGS_vio_sensor_log_num_decoder_threads));
+  read_ahead_thread_.reset(
+      new std::thread(&DataSourceSensorLog::readAheadWorker, this));
+  streaming_thread_.reset(
+      new std::thread(&DataSourceSensorLog::streamingWorker, this));
+}
+
+void DataSourceSensorLog::shutdown() {
+  shutdown_requested_ = true;
+  // Unblocks the read-ahead and the streaming thread.
+  decoded_measurements_.Shutdown();
+  if (streaming_thread_ != nullptr && streaming_thread_->joinable()) {
+    streaming_thread_->join();
+  }
+  if (read_ahead_thread_ != nullptr && read_ahead_thread_->joinable()) {
+    read_ahead_thread_->join();
+  }
+  if (decoder_thread_pool_ != nullptr) {
+    decoder_thread_pool_->stop();
+  }
+}
+
+std::string DataSourceSensorLog::getDatasetName() const {
+  std::string path, filename;
+  common::splitPathAndFilename(sensor_log_path_, &path, &filename);
+  return filename;
+}
+
+void DataSourceSensorLog::readAheadWorker() {
+  CHECK(decoder_thread_pool_);
+  sensor_log::Record record;
+  while (!shutdown_requested_ && reader_.readNext(&record) &&
+         record.header.timestamp_ns <= end_timestamp_ns_) {
+    DecodedMeasurementFuture decoded_measurement;
+    if (record.header.type == sensor_log::RecordType::kImage) {
+      // The payload stays valid while the reader exists.
+      decoded_measurement = decoder_thread_pool_
+                                ->enqueue([record]() {
+                                  DecodedMeasurement decoded;
+                                  decoded.image =
+                                      sensor_log::decodeImage(record);
+                                  return decoded;
+                                })
+                                .share();
+    } else if (record.header.type == sensor_log::RecordType::kImu) {
+      std::promise<DecodedMeasurement> decoded_imu;
+      DecodedMeasurement decoded;
+      decoded.imu = sensor_log::decodeImu(record);
+      decoded_imu.set_value(decoded);
+      decoded_measurement = decoded_imu.get_future().share();
+    } else {
+      LOG(WARNING) << "Skipping a record of unknown type "
+                   << static_cast<int>(record.header.type) << '.';
+      continue;
+    }
+
+    if (!decoded_measurements_.PushBlockingIfFull(
+            decoded_measurement, FLAGS_vio_sensor_log_read_ahead_size)) {
+      return;
+    }
+  }
+  // Marks the end of the log.
+  decoded_measurements_.PushBlockingIfFull(
+      DecodedMeasurementFuture(), FLAGS_vio_sensor_log_read_ahead_size);
+}
+
+void DataSourceSensorLog::streamingWorker() {
+  const bool follow_timestamps = !FLAGS_vio_sensor_log_deterministic &&
+                                 FLAGS_vio_sensor_log_playback_rate > 0.0;
+  const std::chrono::steady_clock::time_point playback_start =
+      std::chrono::steady_clock::now();
+
+  // In the deterministic playback, the images are only published once the
+  // first IMU measurement after them is processed. The synchronizer then never
+  // waits for IMU data, so it completes the images of an nframe right away.
+  std::vector<DecodedMeasurement> held_back_images;
+
+  DecodedMeasurementFuture decoded_measurement;
+  while (decoded_measurements_.PopBlocking(&decoded_measurement)) {
+    if (!decoded_measurement.valid()) {
+      publishHeldBackImages(&held_back_images);
+      LOG(INFO) << "Sensor log playback finished!";
+      all_data_streamed_ = true;
+      invokeEndOfDataCallbacks();
+      return;
+    }
+    if (shutdown_requested_) {
+      return;
+    }
+    const DecodedMeasurement& measurement = decoded_measurement.get();
+    if (follow_timestamps) {
+      // Relative to the start of the playback, such that the waiting doesn't
+      // accumulate delays.
+      const int64_t timestamp_ns = measurement.image
+                                       ? measurement.image->timestamp
+                                       : measurement.imu->timestamp;
+      const std::chrono::duration<double> time_since_start(
+          aslam::time::to_seconds(timestamp_ns - start_timestamp_ns_) /
+          FLAGS_vio_sensor_log_playback_rate);
+      std::this_thread::sleep_until(
+          playback_start +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              time_since_start));
+    }
+    if (!FLAGS_vio_sensor_log_deterministic) {
+      publishMeasurement(measurement);
+      continue;
+    }
+    if (measurement.image) {
+      held_back_images.emplace_back(measurement);
+      continue;
+    }
+    // Publishing may shift the timestamp.
+    const int64_t imu_timestamp_ns = measurement.imu->timestamp;
+    publishMeasurement(measurement);
+    waitUntilProcessed();
+    if (!held_back_images.empty() &&
+        imu_timestamp_ns > held_back_images.back().image->timestamp) {
+      publishHeldBackImages(&held_back_images);
+    }
+  }
+}
+
+void DataSourceSensorLog::publishHeldBackImages(
+    std::vector<DecodedMeasurement>* held_back_images) {
+  CHECK_NOTNULL(held_back_images);
+  if (held_back_images->empty()) {
+    return;
+  }
+  // The images of an nframe are published together, the synchronizer only
+  // completes them once all of them arrived.
+  for (const DecodedMeasurement& image : *held_back_images) {
+    publishMeasurement(image);
+  }
+  held_back_images->clear();
+  waitUntilProcessed();
+}
+
+void DataSourceSensorLog::publishMeasurement(
+    const DecodedMeasurement& measurement) {
+  if (measurement.image) {
+    if (!FLAGS_rovioli_zero_initial_timestamps ||
+        shiftByFirstTimestamp(&(measurement.image->timestamp))) {
+      VLOG(3) << "Publish Image measurement...";
+      invokeImageCallbacks(measurement.image);
+    }
+  }
+  if (measurement.imu) {
+    if (!FLAGS_rovioli_zero_initial_timestamps ||
+        shiftByFirstTimestamp(&(measurement.imu->timestamp))) {
+      VLOG(3) << "Publish IMU measurement...";
+      invokeImuCallbacks(measurement.imu);
+    }
+  }
+}
+
+}  // namespace rovioli
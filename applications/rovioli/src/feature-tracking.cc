@@ -1,15 +1,24 @@
 #include "rovioli/feature-tracking.h"
 
+#include <gflags/gflags.h>
 #include <maplab-common/conversions.h>
 
+DEFINE_bool(
+    rovioli_pipelined_feature_tracking, false,
+    "If true, the keypoint detection on an nframe overlaps the matching and "
+    "outlier rejection of the previous nframe. This delays every tracked "
+    "nframe by one nframe.");
+
 namespace rovioli {
+namespace {
+constexpr int64_t kImuBiasAgeThresholdNs = 10 * kSecondsToNanoSeconds;
+}  // namespace
 
 FeatureTracking::FeatureTracking(
     const aslam::NCamera::Ptr& camera_system, const vi_map::Imu& imu_sensor)
     : camera_system_(camera_system),
       imu_sensor_(imu_sensor),
       current_imu_bias_(Eigen::Matrix<double, 6, 1>::Zero()),
-      current_imu_bias_timestamp_nanoseconds_(aslam::time::getInvalidTime()),
       previous_nframe_timestamp_ns_(-1),
       tracker_(camera_system) {
   CHECK(camera_system_ != nullptr);
@@ -17,9 +26,24 @@ FeatureTracking::FeatureTracking(
 
 bool FeatureTracking::trackSynchronizedNFrameImuCallback(
     const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu) {
+  vio::SynchronizedNFrameImu::Ptr tracked_nframe_imu;
+  return trackSynchronizedNFrameImuCallback(
+      synced_nframe_imu, &tracked_nframe_imu);
+}
+
+bool FeatureTracking::trackSynchronizedNFrameImuCallback(
+    const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu,
+    vio::SynchronizedNFrameImu::Ptr* tracked_nframe_imu) {
   CHECK(synced_nframe_imu != nullptr);
+  CHECK_NOTNULL(tracked_nframe_imu)->reset();
   std::lock_guard<std::mutex> lock(m_previous_synced_nframe_imu_);
 
+  if (FLAGS_rovioli_pipelined_feature_tracking) {
+    // The detection on this nframe runs while the previously received nframe
+    // is tracked below, at the cost of one nframe of latency.
+    tracker_.detectFeaturesNFrameAsync(synced_nframe_imu->nframe);
+  }
+
   // The first frame will not contain any tracking information on the first
   // call, but it will be added in the second call.
   if (previous_synced_nframe_imu_ == nullptr) {
@@ -29,21 +53,37 @@ bool FeatureTracking::trackSynchronizedNFrameImuCallback(
     return false;
   }
 
-  // Check if the IMU bias is up to date, if not - use zero.
-  if (!hasUpToDateImuBias(
-          synced_nframe_imu->nframe->getMinTimestampNanoseconds())) {
-    LOG(WARNING) << "No bias from the estimator available. Assuming zero bias.";
-    std::unique_lock<std::mutex> bias_lock(m_current_imu_bias_);
-    current_imu_bias_.setZero();
+  if (!FLAGS_rovioli_pipelined_feature_tracking) {
+    trackToPreviousNFrame(synced_nframe_imu);
+    *tracked_nframe_imu = synced_nframe_imu;
+    return true;
   }
 
+  if (pending_synced_nframe_imu_ == nullptr) {
+    pending_synced_nframe_imu_ = synced_nframe_imu;
+    return false;
+  }
+  trackToPreviousNFrame(pending_synced_nframe_imu_);
+  *tracked_nframe_imu = pending_synced_nframe_imu_;
+  pending_synced_nframe_imu_ = synced_nframe_imu;
+  return true;
+}
+
+void FeatureTracking::trackToPreviousNFrame(
+    const vio::SynchronizedNFrameImu::Ptr& synced_nframe_imu) {
+  CHECK(synced_nframe_imu != nullptr);
+
+  CHECK(previous_synced_nframe_imu_ != nullptr);
+  selectImuBias(
+      previous_synced_nframe_imu_->nframe->getMinTimestampNanoseconds(),
+      synced_nframe_imu->nframe->getMinTimestampNanoseconds());
+
   // Preintegrate the IMU measurements.
   aslam::Quaternion q_Ikp1_Ik;
   integrateInterframeImuRotation(
       synced_nframe_imu->imu_timestamps, synced_nframe_imu->imu_measurements,
       &q_Ikp1_Ik);
 
-  CHECK(previous_synced_nframe_imu_ != nullptr);
   aslam::FrameToFrameMatchesList inlier_matches_kp1_k;
   aslam::FrameToFrameMatchesList outlier_matches_kp1_k;
   CHECK_GT(
@@ -55,7 +95,6 @@ bool FeatureTracking::trackSynchronizedNFrameImuCallback(
       &outlier_matches_kp1_k);
 
   previous_synced_nframe_imu_ = synced_nframe_imu;
-  return true;
 }
 
 void FeatureTracking::setCurrentImuBias(
@@ -65,35 +104,38 @@ void FeatureTracking::setCurrentImuBias(
   const int64_t bias_timestamp_ns =
       rovio_estimate->timestamp_s * kSecondsToNanoSeconds;
 
-  // Only update the bias if we have a newer measurement.
   std::unique_lock<std::mutex> lock(m_current_imu_bias_);
-  if (bias_timestamp_ns > current_imu_bias_timestamp_nanoseconds_) {
-    current_imu_bias_timestamp_nanoseconds_ =
-        rovio_estimate->timestamp_s * kSecondsToNanoSeconds;
-    current_imu_bias_ = rovio_estimate->vinode.getImuBias();
-    VLOG(5) << "Updated IMU bias in Pipeline node.";
-  } else {
-    LOG(WARNING) << "Received an IMU bias estimate that has an earlier "
-                 << "timestamp than the previous one. Previous timestamp: "
-                 << current_imu_bias_timestamp_nanoseconds_
-                 << "ns, received timestamp: " << bias_timestamp_ns << "ns.";
-  }
+  imu_biases_[bias_timestamp_ns] = rovio_estimate->vinode.getImuBias();
+  // Biases that are too old to be used are forgotten, in case no nframes are
+  // tracked.
+  imu_biases_.erase(
+      imu_biases_.begin(),
+      imu_biases_.lower_bound(
+          imu_biases_.rbegin()->first - kImuBiasAgeThresholdNs));
+  VLOG(5) << "Updated IMU bias in Pipeline node.";
 }
 
-bool FeatureTracking::hasUpToDateImuBias(
-    const int64_t current_timestamp_ns) const {
+void FeatureTracking::selectImuBias(
+    const int64_t previous_nframe_timestamp_ns,
+    const int64_t current_nframe_timestamp_ns) {
   std::unique_lock<std::mutex> lock(m_current_imu_bias_);
-  if (current_imu_bias_timestamp_nanoseconds_ == -1) {
-    // No bias was ever set.
-    return false;
+  ImuBiasMap::iterator it =
+      imu_biases_.upper_bound(previous_nframe_timestamp_ns);
+  if (it == imu_biases_.begin()) {
+    LOG(WARNING) << "No bias from the estimator available. Assuming zero bias.";
+    current_imu_bias_.setZero();
+    return;
   }
-  constexpr int64_t kImuBiasAgeThresholdNs = 10 * kSecondsToNanoSeconds;
-  if (current_timestamp_ns - current_imu_bias_timestamp_nanoseconds_ >
-      kImuBiasAgeThresholdNs) {
+  --it;
+  if (current_nframe_timestamp_ns - it->first > kImuBiasAgeThresholdNs) {
     // The bias estimate is not up to date.
-    return false;
+    LOG(WARNING) << "No bias from the estimator available. Assuming zero bias.";
+    current_imu_bias_.setZero();
+    return;
   }
-  return true;
+  current_imu_bias_ = it->second;
+  // The following nframes use the same or a later bias.
+  imu_biases_.erase(imu_biases_.begin(), it);
 }
 
 void FeatureTracking::integrateInterframeImuRotation(
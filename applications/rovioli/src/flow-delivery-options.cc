@@ -0,0 +1,25 @@
+#include "rovioli/flow-delivery-options.h"
+
+#include <gflags/gflags.h>
+#include <message-flow/message-flow.h>
+
+DEFINE_uint64(
+    rovioli_backpressure_queue_capacity, 0u,
+    "Capacity of the delivery queues between the data source and the "
+    "synchronizer. Full queues block the data source. Zero keeps the queues "
+    "unbounded. Should be set when playing back datasets with "
+    "--vio_rosbag_throttle_by_backpressure.");
+
+namespace rovioli {
+
+message_flow::DeliveryOptions getBackpressureDeliveryOptions() {
+  message_flow::DeliveryOptions delivery_options;
+  if (FLAGS_rovioli_backpressure_queue_capacity > 0u) {
+    delivery_options.queue_capacity = FLAGS_rovioli_backpressure_queue_capacity;
+    delivery_options.overflow_policy =
+        message_flow::QueueOverflowPolicy::kBlockPublisher;
+  }
+  return delivery_options;
+}
+
+}  // namespace rovioli
@@ -0,0 +1,181 @@
+#include "rovioli/image-buffer-pool.h"
+
+#include <algorithm>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_int32(
+    rovioli_image_buffer_pool_max_free_buffers, 64,
+    "Maximum number of released camera image buffers that are kept for "
+    "reuse.");
+
+namespace rovioli {
+namespace {
+
+// Owns nothing but the reference to the owner of the wrapped memory, which is
+// stored in the user data of the cv::UMatData.
+class ExternalDataAllocator : public cv::MatAllocator {
+ public:
+  static ExternalDataAllocator& instance() {
+    // Never destroyed, as wrapped images may be released at any time.
+    static ExternalDataAllocator* const allocator = new ExternalDataAllocator;
+    return *allocator;
+  }
+
+  cv::UMatData* allocate(
+      int /*dims*/, const int* /*sizes*/, int /*type*/, void* /*data*/,
+      size_t* /*step*/, int /*flags*/,
+      cv::UMatUsageFlags /*usage_flags*/) const override {
+    LOG(FATAL) << "Wrapped external images can't be reallocated.";
+    return nullptr;
+  }
+  bool allocate(
+      cv::UMatData* data, int /*access_flags*/,
+      cv::UMatUsageFlags /*usage_flags*/) const override {
+    return data != nullptr;
+  }
+  void deallocate(cv::UMatData* data) const override {
+    if (data == nullptr) {
+      return;
+    }
+    CHECK_EQ(data->urefcount, 0);
+    CHECK_EQ(data->refcount, 0);
+    delete static_cast<std::shared_ptr<const void>*>(data->userdata);
+    delete data;
+  }
+};
+
+size_t getNumBytesAndSetStep(
+    const int dims, const int* sizes, const int type, void* data,
+    size_t* step) {
+  size_t num_bytes = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; --i) {
+    if (step != nullptr) {
+      if (data != nullptr && step[i] != CV_AUTOSTEP) {
+        CHECK_LE(num_bytes, step[i]);
+        num_bytes = step[i];
+      } else {
+        step[i] = num_bytes;
+      }
+    }
+    num_bytes *= sizes[i];
+  }
+  return num_bytes;
+}
+
+}  // namespace
+
+ImageBufferPool::ImageBufferPool(const size_t max_num_free_buffers)
+    : max_num_free_buffers_(max_num_free_buffers), num_free_buffers_(0u) {}
+
+ImageBufferPool::~ImageBufferPool() {
+  std::lock_guard<std::mutex> lock(m_free_buffers_);
+  for (std::unordered_map<size_t, std::vector<uchar*>>::value_type&
+           size_and_buffers : free_buffers_) {
+    for (uchar* buffer : size_and_buffers.second) {
+      cv::fastFree(buffer);
+    }
+  }
+}
+
+ImageBufferPool& ImageBufferPool::instance() {
+  static ImageBufferPool* const pool = new ImageBufferPool(
+      static_cast<size_t>(
+          std::max(FLAGS_rovioli_image_buffer_pool_max_free_buffers, 0)));
+  return *pool;
+}
+
+cv::Mat ImageBufferPool::acquire(
+    const int rows, const int cols, const int type) {
+  cv::Mat image;
+  image.allocator = this;
+  image.create(rows, cols, type);
+  return image;
+}
+
+size_t ImageBufferPool::getNumFreeBuffers() const {
+  std::lock_guard<std::mutex> lock(m_free_buffers_);
+  return num_free_buffers_;
+}
+
+cv::UMatData* ImageBufferPool::allocate(
+    int dims, const int* sizes, int type, void* data, size_t* step,
+    int /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const {
+  const size_t num_bytes =
+      getNumBytesAndSetStep(dims, sizes, type, data, step);
+
+  uchar* buffer = static_cast<uchar*>(data);
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(m_free_buffers_);
+    std::unordered_map<size_t, std::vector<uchar*>>::iterator it =
+        free_buffers_.find(num_bytes);
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      buffer = it->second.back();
+      it->second.pop_back();
+      --num_free_buffers_;
+    }
+  }
+  if (buffer == nullptr) {
+    buffer = static_cast<uchar*>(cv::fastMalloc(num_bytes));
+  }
+
+  cv::UMatData* u = new cv::UMatData(this);
+  u->data = u->origdata = buffer;
+  u->size = num_bytes;
+  if (data != nullptr) {
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  }
+  return u;
+}
+
+bool ImageBufferPool::allocate(
+    cv::UMatData* data, int /*access_flags*/,
+    cv::UMatUsageFlags /*usage_flags*/) const {
+  return data != nullptr;
+}
+
+void ImageBufferPool::deallocate(cv::UMatData* data) const {
+  if (data == nullptr) {
+    return;
+  }
+  CHECK_EQ(data->urefcount, 0);
+  CHECK_EQ(data->refcount, 0);
+  if (!(data->flags & cv::UMatData::USER_ALLOCATED)) {
+    std::unique_lock<std::mutex> lock(m_free_buffers_);
+    if (num_free_buffers_ < max_num_free_buffers_) {
+      free_buffers_[data->size].push_back(data->origdata);
+      ++num_free_buffers_;
+    } else {
+      lock.unlock();
+      cv::fastFree(data->origdata);
+    }
+    data->origdata = nullptr;
+  }
+  delete data;
+}
+
+cv::Mat wrapExternalImageData(
+    const int rows, const int cols, const int type, void* data,
+    const size_t step, const std::shared_ptr<const void>& owner) {
+  CHECK_NOTNULL(data);
+  CHECK(owner);
+  CHECK_GT(rows, 0);
+  CHECK_GT(cols, 0);
+
+  // The header alone doesn't own the memory. Attaching the UMatData makes the
+  // reference counting of cv::Mat release the owner with the last copy.
+  cv::Mat image(rows, cols, type, data, step);
+  ExternalDataAllocator& allocator = ExternalDataAllocator::instance();
+  cv::UMatData* u = new cv::UMatData(&allocator);
+  u->data = u->origdata = static_cast<uchar*>(data);
+  u->size = step * rows;
+  u->flags |= cv::UMatData::USER_ALLOCATED;
+  u->userdata = new std::shared_ptr<const void>(owner);
+  u->refcount = 1;
+  image.allocator = &allocator;
+  image.u = u;
+  return image;
+}
+
+}  // namespace rovioli
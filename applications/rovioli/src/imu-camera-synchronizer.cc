@@ -1,7 +1,12 @@
 #include "rovioli/imu-camera-synchronizer.h"
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 #include <aslam/pipeline/visual-pipeline-null.h>
 #include <maplab-common/conversions.h>
+#include <maplab-common/thread-topology.h>
 
 DEFINE_int64(
     vio_nframe_sync_tolerance_ns, 500000,
@@ -28,7 +33,8 @@ ImuCameraSynchronizer::ImuCameraSynchronizer(
       time_last_imu_message_received_or_checked_ns_(
           aslam::time::nanoSecondsSinceEpoch()),
       time_last_camera_message_received_or_checked_ns_(
-          aslam::time::nanoSecondsSinceEpoch()) {
+          aslam::time::nanoSecondsSinceEpoch()),
+      pipeline_trace_sink_(nullptr) {
   CHECK(camera_system_ != nullptr);
   CHECK_GT(FLAGS_vio_nframe_sync_max_output_frequency_hz, 0.);
 
@@ -68,6 +74,11 @@ void ImuCameraSynchronizer::addCameraImage(
   CHECK(visual_pipeline_ != nullptr);
   time_last_camera_message_received_or_checked_ns_ =
       aslam::time::nanoSecondsSinceEpoch();
+  if (pipeline_trace_sink_ != nullptr) {
+    std::lock_guard<std::mutex> lock(m_image_arrival_times_ns_);
+    image_arrival_times_ns_.emplace(
+        timestamp, vio::PipelineTrace::nowNanoseconds());
+  }
   if (!visual_pipeline_->processImageBlockingIfFull(
           camera_index, image, timestamp, kMaxNFrameQueueSize)) {
     shutdown();
@@ -119,111 +130,218 @@ void ImuCameraSynchronizer::checkIfMessagesAreIncomingWorker() {
 }
 
 void ImuCameraSynchronizer::processDataThreadWorker() {
+  // The thread only synchronizes, pin it for its whole lifetime.
+  common::setCurrentThreadAffinity(
+      common::ThreadTopology::instance().getStageCpus("synchronizer"));
+  std::vector<aslam::VisualNFrame::Ptr> nframes;
+  std::vector<int64_t> nframe_arrival_times_ns;
   while (!shutdown_) {
     aslam::VisualNFrame::Ptr new_nframe;
     if (!visual_pipeline_->getNextBlocking(&new_nframe)) {
       // Shutdown.
       return;
     }
+    // Take all other nframes that are complete as well, so that the IMU data
+    // of all of them is extracted at once.
+    nframes.clear();
+    nframe_arrival_times_ns.clear();
+    while (new_nframe != nullptr) {
+      nframe_arrival_times_ns.emplace_back(
+          pipeline_trace_sink_ != nullptr
+              ? popImageArrivalTimeNanoseconds(*new_nframe)
+              : 0);
+      nframes.emplace_back(new_nframe);
+      new_nframe = visual_pipeline_->getNext();
+    }
+    if (!synchronizeNFrames(nframes, nframe_arrival_times_ns)) {
+      // Shutdown.
+      return;
+    }
+
+    size_t num_images = 0u;
+    for (const aslam::VisualNFrame::Ptr& nframe : nframes) {
+      num_images += nframe->getNumFrames();
+    }
+    std::lock_guard<std::mutex> callback_lock(m_images_processed_callbacks_);
+    for (const std::function<void(size_t)>& callback :
+         images_processed_callbacks_) {
+      callback(num_images);
+    }
+  }
+}
 
+bool ImuCameraSynchronizer::synchronizeNFrames(
+    const std::vector<aslam::VisualNFrame::Ptr>& nframes,
+    const std::vector<int64_t>& nframe_arrival_times_ns) {
+  CHECK_EQ(nframes.size(), nframe_arrival_times_ns.size());
+  typedef vio_common::ImuMeasurementBuffer::QueryResult QueryResult;
+  std::vector<size_t> nframe_indices;
+  std::vector<int64_t> border_timestamps_ns;
+  std::vector<Eigen::Matrix<int64_t, 1, Eigen::Dynamic>> imu_timestamps;
+  std::vector<Eigen::Matrix<double, 6, Eigen::Dynamic>> imu_measurements;
+  std::vector<vio::SynchronizedNFrameImu::Ptr> synchronized_nframes;
+
+  size_t nframe_idx = 0u;
+  while (nframe_idx < nframes.size()) {
     // Block the previous nframe timestamp so that no other thread can use it.
     // It should wait till this iteration is done.
     std::unique_lock<std::mutex> lock(m_previous_nframe_timestamp_ns_);
 
     // Drop few first nframes as there might have incomplete IMU data.
-    const int64_t current_frame_timestamp_ns =
-        new_nframe->getMinTimestampNanoseconds();
     if (frame_skip_counter_ < kFramesToSkipAtInit) {
       ++frame_skip_counter_;
-      previous_nframe_timestamp_ns_ = current_frame_timestamp_ns;
+      previous_nframe_timestamp_ns_ =
+          nframes[nframe_idx]->getMinTimestampNanoseconds();
+      ++nframe_idx;
       continue;
     }
 
     // Throttle the output rate of VisualNFrames to reduce the rate of which
-    // the following nodes are running (e.g. tracker).
+    // the following nodes are running (e.g. tracker). The nframes are
+    // selected as if all of them are published, which holds up to the first
+    // one whose IMU data is missing.
     CHECK_GE(previous_nframe_timestamp_ns_, 0);
-    if (new_nframe->getMinTimestampNanoseconds() -
-            previous_nframe_timestamp_ns_ <
-        min_nframe_timestamp_diff_ns_) {
-      continue;
-    }
-
-    vio::SynchronizedNFrameImu::Ptr new_imu_nframe_measurement(
-        new vio::SynchronizedNFrameImu);
-    new_imu_nframe_measurement->nframe = new_nframe;
-
-    // Wait for the required IMU data.
     CHECK(aslam::time::isValidTime(previous_nframe_timestamp_ns_));
-    const int64_t kWaitTimeoutNanoseconds = aslam::time::milliseconds(50);
-    vio_common::ImuMeasurementBuffer::QueryResult result;
-    bool skip_frame = false;
-    while ((result = imu_buffer_->getImuDataInterpolatedBordersBlocking(
-                previous_nframe_timestamp_ns_, current_frame_timestamp_ns,
-                kWaitTimeoutNanoseconds,
-                &new_imu_nframe_measurement->imu_timestamps,
-                &new_imu_nframe_measurement->imu_measurements)) !=
-           vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable) {
-      if (result ==
-          vio_common::ImuMeasurementBuffer::QueryResult::kQueueShutdown) {
-        // Shutdown.
-        return;
-      }
-      if (result ==
-          vio_common::ImuMeasurementBuffer::QueryResult::kDataNeverAvailable) {
-        LOG(ERROR) << "Camera/IMU data out-of-order. This might be okay during "
-                      "initialization.";
-        CHECK(!initial_sync_succeeded_)
-            << "Some synced IMU-camera frames were"
-            << "already published. This will lead to map inconsistency.";
-
-        // Skip this frame, but also advanced the previous frame timestamp.
-        previous_nframe_timestamp_ns_ = current_frame_timestamp_ns;
-        skip_frame = true;
-        break;
+    nframe_indices.clear();
+    border_timestamps_ns.assign(1u, previous_nframe_timestamp_ns_);
+    for (size_t idx = nframe_idx; idx < nframes.size(); ++idx) {
+      const int64_t timestamp_ns = nframes[idx]->getMinTimestampNanoseconds();
+      if (timestamp_ns - border_timestamps_ns.back() >=
+          min_nframe_timestamp_diff_ns_) {
+        nframe_indices.emplace_back(idx);
+        border_timestamps_ns.emplace_back(timestamp_ns);
       }
+    }
+    if (nframe_indices.empty()) {
+      return true;
+    }
 
-      if (result ==
-          vio_common::ImuMeasurementBuffer::QueryResult::kDataNotYetAvailable) {
-        LOG(WARNING) << "NFrame-IMU synchronization timeout. IMU measurements "
-                     << "lag behind. Dropping this nframe.";
-        // Skip this frame.
-        skip_frame = true;
-        break;
+    // The IMU data of consecutive nframes is extracted in a single pass over
+    // the buffer, up to the first nframe whose data is missing.
+    QueryResult result = imu_buffer_->getImuDataInterpolatedBordersOfIntervals(
+        border_timestamps_ns, &imu_timestamps, &imu_measurements);
+    const size_t num_available = imu_timestamps.size();
+    if (num_available > 0u) {
+      synchronized_nframes.clear();
+      for (size_t idx = 0u; idx < num_available; ++idx) {
+        vio::SynchronizedNFrameImu::Ptr synchronized_nframe(
+            new vio::SynchronizedNFrameImu);
+        synchronized_nframe->nframe = nframes[nframe_indices[idx]];
+        synchronized_nframe->imu_timestamps.swap(imu_timestamps[idx]);
+        synchronized_nframe->imu_measurements.swap(imu_measurements[idx]);
+        synchronized_nframes.emplace_back(synchronized_nframe);
       }
-
-      if (result == vio_common::ImuMeasurementBuffer::QueryResult::
-                        kTooFewMeasurementsAvailable) {
-        LOG(WARNING) << "NFrame-IMU synchronization: Too few IMU measurements "
-                     << "available between the previous and current nframe. "
-                     << "Dropping this nframe.";
-        // Skip this frame.
-        skip_frame = true;
-        break;
+      previous_nframe_timestamp_ns_ = border_timestamps_ns[num_available];
+      nframe_idx = num_available < nframe_indices.size()
+                       ? nframe_indices[num_available]
+                       : nframes.size();
+      // Manually unlock the mutex as the previous nframe timestamp can be
+      // consumed by the next iteration.
+      lock.unlock();
+      for (size_t idx = 0u; idx < num_available; ++idx) {
+        publishSynchronizedNFrame(
+            synchronized_nframes[idx],
+            nframe_arrival_times_ns[nframe_indices[idx]]);
       }
+      continue;
+    }
+
+    // The IMU data of the next nframe is not available, wait for it.
+    const size_t current_nframe_idx = nframe_indices.front();
+    nframe_idx = current_nframe_idx + 1u;
+    const int64_t current_frame_timestamp_ns = border_timestamps_ns[1];
+    vio::SynchronizedNFrameImu::Ptr new_imu_nframe_measurement(
+        new vio::SynchronizedNFrameImu);
+    new_imu_nframe_measurement->nframe = nframes[current_nframe_idx];
+    if (result == QueryResult::kDataNotYetAvailable) {
+      const int64_t kWaitTimeoutNanoseconds = aslam::time::milliseconds(50);
+      result = imu_buffer_->getImuDataInterpolatedBordersBlocking(
+          previous_nframe_timestamp_ns_, current_frame_timestamp_ns,
+          kWaitTimeoutNanoseconds, &new_imu_nframe_measurement->imu_timestamps,
+          &new_imu_nframe_measurement->imu_measurements);
+    }
+    if (result == QueryResult::kQueueShutdown) {
+      // Shutdown.
+      return false;
     }
+    if (result == QueryResult::kDataNeverAvailable) {
+      LOG(ERROR) << "Camera/IMU data out-of-order. This might be okay during "
+                    "initialization.";
+      CHECK(!initial_sync_succeeded_)
+          << "Some synced IMU-camera frames were"
+          << "already published. This will lead to map inconsistency.";
 
-    if (skip_frame) {
+      // Skip this frame, but also advanced the previous frame timestamp.
+      previous_nframe_timestamp_ns_ = current_frame_timestamp_ns;
+      continue;
+    }
+    if (result == QueryResult::kDataNotYetAvailable) {
+      LOG(WARNING) << "NFrame-IMU synchronization timeout. IMU measurements "
+                   << "lag behind. Dropping this nframe.";
+      // Skip this frame.
+      continue;
+    }
+    if (result == QueryResult::kTooFewMeasurementsAvailable) {
+      LOG(WARNING) << "NFrame-IMU synchronization: Too few IMU measurements "
+                   << "available between the previous and current nframe. "
+                   << "Dropping this nframe.";
+      // Skip this frame.
       continue;
     }
+    CHECK(result == QueryResult::kDataAvailable);
 
     previous_nframe_timestamp_ns_ = current_frame_timestamp_ns;
-    // Manually unlock the mutex as the previous nframe timestamp can be
-    // consumed by the next iteration.
     lock.unlock();
+    publishSynchronizedNFrame(
+        new_imu_nframe_measurement,
+        nframe_arrival_times_ns[current_nframe_idx]);
+  }
+  return true;
+}
 
-    // All the synchronization succeeded so let's mark we will publish
-    // the frames now. Any IMU data drops after this point mean that the map
-    // is inconsistent.
-    initial_sync_succeeded_ = true;
+void ImuCameraSynchronizer::publishSynchronizedNFrame(
+    const vio::SynchronizedNFrameImu::Ptr& synchronized_nframe,
+    const int64_t nframe_arrival_time_ns) {
+  CHECK(synchronized_nframe);
+  CHECK(synchronized_nframe->nframe);
+  // All the synchronization succeeded so let's mark we will publish
+  // the frames now. Any IMU data drops after this point mean that the map
+  // is inconsistent.
+  initial_sync_succeeded_ = true;
 
-    std::lock_guard<std::mutex> callback_lock(m_nframe_callbacks_);
-    for (const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>&
-             callback : nframe_callbacks_) {
-      callback(new_imu_nframe_measurement);
-    }
+  if (pipeline_trace_sink_ != nullptr) {
+    synchronized_nframe->trace = std::make_shared<vio::PipelineTrace>(
+        synchronized_nframe->nframe->getMinTimestampNanoseconds(),
+        nframe_arrival_time_ns, pipeline_trace_sink_);
+    synchronized_nframe->trace->addStage(
+        "synchronizer", nframe_arrival_time_ns,
+        vio::PipelineTrace::nowNanoseconds());
+  }
+
+  std::lock_guard<std::mutex> callback_lock(m_nframe_callbacks_);
+  for (const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>&
+           callback : nframe_callbacks_) {
+    callback(synchronized_nframe);
   }
 }
 
+int64_t ImuCameraSynchronizer::popImageArrivalTimeNanoseconds(
+    const aslam::VisualNFrame& nframe) {
+  const int64_t now_ns = vio::PipelineTrace::nowNanoseconds();
+  std::lock_guard<std::mutex> lock(m_image_arrival_times_ns_);
+  const std::map<int64_t, int64_t>::iterator it_end =
+      image_arrival_times_ns_.upper_bound(nframe.getMaxTimestampNanoseconds());
+  int64_t arrival_time_ns = now_ns;
+  for (std::map<int64_t, int64_t>::iterator it =
+           image_arrival_times_ns_.lower_bound(
+               nframe.getMinTimestampNanoseconds());
+       it != it_end; ++it) {
+    arrival_time_ns = std::min(arrival_time_ns, it->second);
+  }
+  image_arrival_times_ns_.erase(image_arrival_times_ns_.begin(), it_end);
+  return arrival_time_ns;
+}
+
 void ImuCameraSynchronizer::registerSynchronizedNFrameImuCallback(
     const std::function<void(const vio::SynchronizedNFrameImu::Ptr&)>&
         callback) {
@@ -232,6 +350,13 @@ void ImuCameraSynchronizer::registerSynchronizedNFrameImuCallback(
   nframe_callbacks_.push_back(callback);
 }
 
+void ImuCameraSynchronizer::registerImagesProcessedCallback(
+    const std::function<void(size_t num_images)>& callback) {
+  std::lock_guard<std::mutex> lock(m_images_processed_callbacks_);
+  CHECK(callback);
+  images_processed_callbacks_.push_back(callback);
+}
+
 void ImuCameraSynchronizer::shutdown() {
   shutdown_ = true;
   visual_pipeline_->shutdown();
@@ -0,0 +1,46 @@
+#include "rovioli/localization-database.h"
+
+#include <glog/logging.h>
+
+namespace rovioli {
+
+LocalizationDatabase::LocalizationDatabase(
+    const summary_map::LocalizationSummaryMap& summary_map,
+    const bool visualize_localization)
+    : summary_map_(summary_map) {
+  initialize(visualize_localization);
+}
+
+LocalizationDatabase::LocalizationDatabase(
+    summary_map::LocalizationSummaryMap::UniquePtr summary_map,
+    const bool visualize_localization)
+    : owned_summary_map_(std::move(summary_map)),
+      summary_map_(*CHECK_NOTNULL(owned_summary_map_.get())) {
+  initialize(visualize_localization);
+}
+
+void LocalizationDatabase::initialize(const bool visualize_localization) {
+  loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
+  CHECK(loop_detector_ != nullptr);
+  if (visualize_localization) {
+    loop_detector_->instantiateVisualizer();
+  }
+
+  VLOG(1) << "Creating localization database...";
+  loop_detector_->addLocalizationSummaryMapToDatabase(summary_map_);
+  loop_detector_->freezeDatabase();
+  VLOG(1) << "Done.";
+
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      observation_to_landmark_index = summary_map_.observationToLandmarkIndex();
+  landmark_observation_indices_.resize(
+      summary_map_.GLandmarkPosition().cols());
+  for (int i = 0; i < observation_to_landmark_index.rows(); ++i) {
+    CHECK_LT(
+        observation_to_landmark_index(i), landmark_observation_indices_.size());
+    landmark_observation_indices_[observation_to_landmark_index(i)].push_back(
+        i);
+  }
+}
+
+}  // namespace rovioli
@@ -0,0 +1,159 @@
+#include "rovioli/localization-scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/conversions.h>
+
+DEFINE_bool(
+    rovioli_adaptive_localization, false,
+    "Adapt the rate of the localization to the VIO uncertainty and the "
+    "agreement of consecutive localizations, within the maximum rate of "
+    "--vio_throttler_max_output_frequency_hz.");
+DEFINE_double(
+    rovioli_adaptive_localization_min_frequency_hz, 0.2,
+    "Minimum localization frequency of the adaptive localization.");
+DEFINE_double(
+    rovioli_adaptive_localization_max_vio_drift_m, 0.5,
+    "Growth of the VIO position standard deviation since the last successful "
+    "localization above which the adaptive localization runs at the maximum "
+    "rate.");
+DEFINE_double(
+    rovioli_adaptive_localization_max_disagreement_m, 0.1,
+    "Maximum position difference of the VIO-to-map transformations of two "
+    "consecutive localizations that are considered to agree.");
+DEFINE_double(
+    rovioli_adaptive_localization_max_disagreement_deg, 2.0,
+    "Maximum rotation difference of the VIO-to-map transformations of two "
+    "consecutive localizations that are considered to agree.");
+DEFINE_double(
+    rovioli_localization_cpu_budget, 0.0,
+    "Average number of cores the adaptive localization may occupy, e.g. 0.25 "
+    "for a quarter of a core. 0 disables the budget.");
+
+DECLARE_double(vio_throttler_max_output_frequency_hz);
+
+namespace rovioli {
+namespace {
+constexpr int64_t kVioPoseBufferLengthNanoseconds = 10 * kSecondsToNanoSeconds;
+// Weight of the latest localization in the average localization time.
+constexpr double kDurationAverageWeight = 0.2;
+}  // namespace
+
+LocalizationScheduler::LocalizationScheduler()
+    : min_interval_ns_(
+          kSecondsToNanoSeconds / FLAGS_vio_throttler_max_output_frequency_hz),
+      max_interval_ns_(
+          kSecondsToNanoSeconds /
+          FLAGS_rovioli_adaptive_localization_min_frequency_hz),
+      max_vio_drift_m_(FLAGS_rovioli_adaptive_localization_max_vio_drift_m),
+      max_pose_disagreement_m_(
+          FLAGS_rovioli_adaptive_localization_max_disagreement_m),
+      max_pose_disagreement_rad_(
+          FLAGS_rovioli_adaptive_localization_max_disagreement_deg *
+          kDegToRad),
+      cpu_budget_(FLAGS_rovioli_localization_cpu_budget),
+      interval_ns_(min_interval_ns_),
+      last_scheduled_timestamp_ns_(aslam::time::getInvalidTime()),
+      last_attempt_timestamp_ns_(aslam::time::getInvalidTime()),
+      average_duration_ns_(-1.0),
+      T_M_I_buffer_(kVioPoseBufferLengthNanoseconds),
+      vio_position_variance_m2_(0.0),
+      vio_position_variance_at_localization_m2_(0.0),
+      has_last_T_G_M_(false) {
+  CHECK_GT(FLAGS_vio_throttler_max_output_frequency_hz, 0.0);
+  CHECK_GT(FLAGS_rovioli_adaptive_localization_min_frequency_hz, 0.0);
+  CHECK_LE(min_interval_ns_, max_interval_ns_);
+  CHECK_GT(max_vio_drift_m_, 0.0);
+  CHECK_GE(max_pose_disagreement_m_, 0.0);
+  CHECK_GE(max_pose_disagreement_rad_, 0.0);
+  CHECK_GE(cpu_budget_, 0.0);
+}
+
+void LocalizationScheduler::processVioEstimate(
+    const int64_t timestamp_ns, const aslam::Transformation& T_M_I,
+    const Eigen::Matrix3d& p_M_I_covariance) {
+  std::lock_guard<std::mutex> lock(m_state_);
+  T_M_I_buffer_.addValue(timestamp_ns, T_M_I);
+  vio_position_variance_m2_ = p_M_I_covariance.trace();
+}
+
+void LocalizationScheduler::processLocalizationAttempt(
+    const LocalizationAttempt& attempt) {
+  CHECK_GE(attempt.duration_ns, 0);
+  std::lock_guard<std::mutex> lock(m_state_);
+  if (average_duration_ns_ < 0.0) {
+    average_duration_ns_ = attempt.duration_ns;
+  } else {
+    average_duration_ns_ += kDurationAverageWeight *
+                            (attempt.duration_ns - average_duration_ns_);
+  }
+
+  if (aslam::time::isValidTime(last_attempt_timestamp_ns_) &&
+      attempt.timestamp_ns <= last_attempt_timestamp_ns_) {
+    return;
+  }
+  last_attempt_timestamp_ns_ = attempt.timestamp_ns;
+
+  aslam::Transformation T_M_I;
+  int64_t timestamp_vio_ns;
+  if (!attempt.success ||
+      !T_M_I_buffer_.getValueAtOrBeforeTime(
+          attempt.timestamp_ns, &timestamp_vio_ns, &T_M_I)) {
+    interval_ns_ = min_interval_ns_;
+    return;
+  }
+  vio_position_variance_at_localization_m2_ = vio_position_variance_m2_;
+
+  const aslam::Transformation T_G_M = attempt.T_G_I * T_M_I.inverse();
+  bool agrees = false;
+  if (has_last_T_G_M_) {
+    const aslam::Transformation T_last_current = last_T_G_M_.inverse() * T_G_M;
+    agrees = T_last_current.getPosition().norm() <= max_pose_disagreement_m_ &&
+             aslam::AngleAxis(T_last_current.getRotation()).angle() <=
+                 max_pose_disagreement_rad_;
+  }
+  last_T_G_M_ = T_G_M;
+  has_last_T_G_M_ = true;
+
+  interval_ns_ =
+      agrees ? std::min(2 * interval_ns_, max_interval_ns_) : min_interval_ns_;
+}
+
+bool LocalizationScheduler::shouldLocalizeNFrame(
+    const int64_t nframe_timestamp_ns) {
+  std::lock_guard<std::mutex> lock(m_state_);
+  if (aslam::time::isValidTime(last_scheduled_timestamp_ns_) &&
+      nframe_timestamp_ns - last_scheduled_timestamp_ns_ <
+          getCurrentIntervalNsLocked()) {
+    return false;
+  }
+  last_scheduled_timestamp_ns_ = nframe_timestamp_ns;
+  return true;
+}
+
+int64_t LocalizationScheduler::getCurrentIntervalNs() const {
+  std::lock_guard<std::mutex> lock(m_state_);
+  return getCurrentIntervalNsLocked();
+}
+
+int64_t LocalizationScheduler::getCurrentIntervalNsLocked() const {
+  int64_t interval_ns = interval_ns_;
+  const double vio_drift_variance_m2 =
+      vio_position_variance_m2_ - vio_position_variance_at_localization_m2_;
+  if (vio_drift_variance_m2 > max_vio_drift_m_ * max_vio_drift_m_) {
+    interval_ns = min_interval_ns_;
+  }
+  // The budget is a hard limit, it overrides the uncertainty.
+  if (cpu_budget_ > 0.0 && average_duration_ns_ > 0.0) {
+    interval_ns = std::max(
+        interval_ns,
+        static_cast<int64_t>(std::ceil(average_duration_ns_ / cpu_budget_)));
+  }
+  return interval_ns;
+}
+
+}  // namespace rovioli
@@ -0,0 +1,199 @@
+#include "rovioli/localizer-flow.h"
+
+#include <chrono>
+
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <vio-common/pipeline-trace.h>
+
+DEFINE_int32(
+    rovioli_num_localization_workers, 1,
+    "Number of nframes that are localized concurrently. With a single "
+    "worker, the nframes are localized in order on the message flow.");
+
+namespace rovioli {
+
+LocalizerFlow::LocalizerFlow(
+    const summary_map::LocalizationSummaryMap& localization_map,
+    const bool visualize_localization)
+    : localizer_(new Localizer(localization_map, visualize_localization)),
+      is_localizer_ready_(true),
+      shutdown_requested_(false),
+      num_replaced_nframes_(0u) {
+  CHECK_GT(FLAGS_rovioli_num_localization_workers, 0);
+}
+
+LocalizerFlow::LocalizerFlow(TiledLocalizationMap* tiled_localization_map)
+    : localizer_(new Localizer(tiled_localization_map)),
+      is_localizer_ready_(true),
+      shutdown_requested_(false),
+      num_replaced_nframes_(0u) {
+  CHECK_GT(FLAGS_rovioli_num_localization_workers, 0);
+}
+
+LocalizerFlow::LocalizerFlow(
+    const LocalizationMapLoader& load_localization_map,
+    const bool visualize_localization)
+    : is_localizer_ready_(false),
+      shutdown_requested_(false),
+      num_replaced_nframes_(0u) {
+  CHECK_GT(FLAGS_rovioli_num_localization_workers, 0);
+  CHECK(load_localization_map);
+  startup_thread_ = std::thread(
+      [this, load_localization_map, visualize_localization]() {
+        const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        localization_map_ = load_localization_map();
+        if (!localization_map_) {
+          LOG(ERROR) << "No localization map was loaded, localization stays "
+                     << "disabled.";
+          return;
+        }
+        localizer_.reset(
+            new Localizer(*localization_map_, visualize_localization));
+        is_localizer_ready_.store(true, std::memory_order_release);
+        LOG(INFO) << "Localization enabled after "
+                  << std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()
+                  << " s of startup.";
+      });
+}
+
+LocalizerFlow::~LocalizerFlow() {
+  shutdown();
+}
+
+void LocalizerFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
+  CHECK_NOTNULL(flow);
+  static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
+
+  // Subscribe-publish: nframe to localization.
+  publish_result_ =
+      flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
+  publish_attempt_ =
+      flow->registerPublisher<message_flow_topics::LOCALIZATION_ATTEMPTS>();
+
+  if (FLAGS_rovioli_num_localization_workers == 1) {
+    flow->registerSubscriber<
+        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+          this->localizeAndPublish(nframe_imu);
+        });
+  } else {
+    startWorkers();
+    // Hands the nframe to the workers without blocking the delivery.
+    flow->registerSubscriber<
+        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
+        kSubscriberNodeName, message_flow::DeliveryOptions(),
+        [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+          CHECK(nframe_imu);
+          {
+            std::lock_guard<std::mutex> lock(m_pending_nframe_);
+            if (pending_nframe_imu_ != nullptr) {
+              ++num_replaced_nframes_;
+              LOG_EVERY_N(WARNING, 100)
+                  << "All localization workers are busy, "
+                  << num_replaced_nframes_ << " nframes were skipped so far.";
+            }
+            pending_nframe_imu_ = nframe_imu;
+          }
+          cv_pending_nframe_.notify_one();
+        });
+  }
+
+  // The VIO poses predict the nframe poses in map tracking mode.
+  flow->registerSubscriber<message_flow_topics::ROVIO_ESTIMATES>(
+      kSubscriberNodeName, message_flow::DeliveryOptions(),
+      [this](const RovioEstimate::ConstPtr& rovio_estimate) {
+        CHECK(rovio_estimate);
+        if (!this->isLocalizerReady()) {
+          return;
+        }
+        this->localizer_->processVioEstimate(
+            aslam::time::secondsToNanoSeconds(rovio_estimate->timestamp_s),
+            rovio_estimate->vinode.get_T_M_I());
+      });
+}
+
+void LocalizerFlow::shutdown() {
+  // Building the database can't be interrupted.
+  if (startup_thread_.joinable()) {
+    startup_thread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_pending_nframe_);
+    shutdown_requested_ = true;
+    pending_nframe_imu_.reset();
+  }
+  cv_pending_nframe_.notify_all();
+  for (std::thread& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers_.clear();
+}
+
+void LocalizerFlow::localizeAndPublish(
+    const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+  CHECK(nframe_imu);
+  if (!isLocalizerReady()) {
+    LOG_EVERY_N(INFO, 100) << "The localizer is still starting up, the nframe "
+                           << "is not localized.";
+    return;
+  }
+  vio::ScopedPipelineTraceStage trace_stage(
+      nframe_imu->trace.get(), "localization");
+  vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const bool success =
+      localizer_->localizeNFrame(nframe_imu->nframe, loc_result.get());
+
+  LocalizationAttempt::Ptr attempt(new LocalizationAttempt);
+  attempt->timestamp_ns = nframe_imu->nframe->getMinTimestampNanoseconds();
+  attempt->success = success;
+  attempt->T_G_I = loc_result->T_G_I_lc_pnp;
+  attempt->duration_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  CHECK(publish_attempt_);
+  publish_attempt_(attempt);
+
+  if (success) {
+    CHECK(publish_result_);
+    publish_result_(loc_result);
+  }
+}
+
+void LocalizerFlow::startWorkers() {
+  CHECK(workers_.empty());
+  const int num_workers = FLAGS_rovioli_num_localization_workers;
+  workers_.reserve(num_workers);
+  for (int worker_idx = 0; worker_idx < num_workers; ++worker_idx) {
+    workers_.emplace_back(&LocalizerFlow::workerLoop, this);
+  }
+}
+
+void LocalizerFlow::workerLoop() {
+  while (true) {
+    vio::SynchronizedNFrameImu::ConstPtr nframe_imu;
+    {
+      std::unique_lock<std::mutex> lock(m_pending_nframe_);
+      cv_pending_nframe_.wait(lock, [this]() {
+        return shutdown_requested_ || pending_nframe_imu_ != nullptr;
+      });
+      if (shutdown_requested_) {
+        return;
+      }
+      nframe_imu.swap(pending_nframe_imu_);
+    }
+    localizeAndPublish(nframe_imu);
+  }
+}
+
+}  // namespace rovioli
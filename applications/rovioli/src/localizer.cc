@@ -1,76 +1,498 @@
 #include "rovioli/localizer.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/time.h>
+#include <aslam/geometric-vision/pnp-pose-estimator.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/conversions.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/localization-database.h"
+#include "rovioli/tiled-localization-map.h"
+
+DEFINE_double(
+    rovioli_map_tracking_search_radius_px, 20.0,
+    "Radius around the predicted projection of a landmark in which keypoints "
+    "are matched against it in map tracking mode.");
+DEFINE_double(
+    rovioli_map_tracking_max_landmark_distance_m, 30.0,
+    "Landmarks further away from the predicted camera position are not "
+    "tracked.");
+DEFINE_double(
+    rovioli_map_tracking_descriptor_ratio, 0.8,
+    "Ratio test threshold between the best and the second best keypoint "
+    "match of a landmark in map tracking mode.");
+DEFINE_int32(
+    rovioli_map_tracking_min_inliers, 15,
+    "Minimum number of PnP inliers of a map tracking localization.");
+DEFINE_double(
+    rovioli_map_tracking_max_position_jump_m, 1.0,
+    "Map tracking localizations further away from the predicted position "
+    "are rejected.");
+DEFINE_double(
+    rovioli_map_tracking_max_vio_delay_s, 0.2,
+    "Maximum time between an nframe and the latest VIO pose before it that is "
+    "used to predict its pose.");
+DEFINE_double(
+    rovioli_localization_prior_search_radius_m, 20.0,
+    "After the first localization, global localization only searches the "
+    "summary map within this radius around the pose predicted from the VIO "
+    "estimate. Set to 0 to always search the whole map.");
+DECLARE_double(lc_ransac_pixel_sigma);
+DECLARE_int32(lc_num_ransac_iters);
+DECLARE_bool(lc_nonlinear_refinement_p3p);
+
 namespace rovioli {
+namespace {
+
+constexpr int64_t kVioPoseBufferLengthNanoseconds = 10 * kSecondsToNanoSeconds;
+
+// Keypoints of a frame sorted into square cells of the search radius, so the
+// keypoints around a projection are found by looking at 3x3 cells.
+class KeypointGrid {
+ public:
+  KeypointGrid(
+      const Eigen::Matrix2Xd& keypoints, const double cell_size_px,
+      const uint32_t image_width, const uint32_t image_height)
+      : cell_size_px_(cell_size_px),
+        num_cols_(static_cast<int>(std::ceil(image_width / cell_size_px)) + 1),
+        num_rows_(
+            static_cast<int>(std::ceil(image_height / cell_size_px)) + 1),
+        cells_(num_cols_ * num_rows_) {
+    CHECK_GT(cell_size_px_, 0.0);
+    for (int i = 0; i < keypoints.cols(); ++i) {
+      const int col = getCellIndex(keypoints(0, i), num_cols_);
+      const int row = getCellIndex(keypoints(1, i), num_rows_);
+      cells_[row * num_cols_ + col].push_back(i);
+    }
+  }
+
+  template <typename Function>
+  void forEachKeypointAround(
+      const Eigen::Vector2d& keypoint, const Function& function) const {
+    const int col = getCellIndex(keypoint(0), num_cols_);
+    const int row = getCellIndex(keypoint(1), num_rows_);
+    for (int r = std::max(row - 1, 0); r <= std::min(row + 1, num_rows_ - 1);
+         ++r) {
+      for (int c = std::max(col - 1, 0);
+           c <= std::min(col + 1, num_cols_ - 1); ++c) {
+        for (const int keypoint_index : cells_[r * num_cols_ + c]) {
+          function(keypoint_index);
+        }
+      }
+    }
+  }
+
+ private:
+  int getCellIndex(const double coordinate, const int num_cells) const {
+    return std::min(
+        std::max(static_cast<int>(coordinate / cell_size_px_), 0),
+        num_cells - 1);
+  }
+
+  const double cell_size_px_;
+  const int num_cols_;
+  const int num_rows_;
+  std::vector<std::vector<int>> cells_;
+};
+
+// Indices of the summary map landmarks within radius_meters of G_p. Uses the
+// spatial index of the summary map if it has one.
+void getLandmarkIndicesInRadius(
+    const summary_map::LocalizationSummaryMap& summary_map,
+    const Eigen::Vector3d& G_p, const double radius_meters,
+    std::vector<unsigned int>* landmark_indices) {
+  CHECK_NOTNULL(landmark_indices);
+  if (summary_map.hasSpatialIndex()) {
+    summary_map.getLandmarkIndicesInRadius(
+        G_p, radius_meters, landmark_indices);
+    return;
+  }
+  landmark_indices->clear();
+  const Eigen::Matrix3Xf& G_landmark_positions =
+      summary_map.GLandmarkPosition();
+  const double radius_squared = radius_meters * radius_meters;
+  for (int landmark_idx = 0; landmark_idx < G_landmark_positions.cols();
+       ++landmark_idx) {
+    if ((G_landmark_positions.col(landmark_idx).cast<double>() - G_p)
+            .squaredNorm() <= radius_squared) {
+      landmark_indices->push_back(landmark_idx);
+    }
+  }
+}
+
+struct LandmarkMatch {
+  size_t database_index;
+  int landmark_index;
+  float descriptor_distance;
+};
+
+}  // namespace
 
 Localizer::Localizer(
     const summary_map::LocalizationSummaryMap& localization_summary_map,
     const bool visualize_localization)
-    : localization_summary_map_(localization_summary_map) {
+    : has_T_G_M_(false),
+      T_M_I_buffer_(kVioPoseBufferLengthNanoseconds),
+      last_applied_timestamp_ns_(aslam::time::getInvalidTime()),
+      tiled_localization_map_(nullptr) {
+  CHECK_GT(FLAGS_rovioli_map_tracking_search_radius_px, 0.0);
+  CHECK_GT(FLAGS_rovioli_map_tracking_descriptor_ratio, 0.0);
+  CHECK_GT(FLAGS_rovioli_map_tracking_min_inliers, 0);
   current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
 
-  global_loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
-
-  CHECK(global_loop_detector_ != nullptr);
-  if (visualize_localization) {
-    global_loop_detector_->instantiateVisualizer();
-  }
-
   LOG(INFO) << "Creating localization database...";
-  global_loop_detector_->addLocalizationSummaryMapToDatabase(
-      localization_summary_map_);
+  databases_.emplace_back(
+      std::make_shared<const LocalizationDatabase>(
+          localization_summary_map, visualize_localization));
   LOG(INFO) << "Done.";
 }
 
+Localizer::Localizer(TiledLocalizationMap* tiled_localization_map)
+    : has_T_G_M_(false),
+      T_M_I_buffer_(kVioPoseBufferLengthNanoseconds),
+      last_applied_timestamp_ns_(aslam::time::getInvalidTime()),
+      tiled_localization_map_(CHECK_NOTNULL(tiled_localization_map)) {
+  CHECK_GT(FLAGS_rovioli_map_tracking_search_radius_px, 0.0);
+  CHECK_GT(FLAGS_rovioli_map_tracking_descriptor_ratio, 0.0);
+  CHECK_GT(FLAGS_rovioli_map_tracking_min_inliers, 0);
+  current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
+}
+
 Localizer::LocalizationMode Localizer::getCurrentLocalizationMode() const {
+  std::lock_guard<std::mutex> lock(m_state_);
   return current_localization_mode_;
 }
 
+void Localizer::processVioEstimate(
+    const int64_t timestamp_ns, const aslam::Transformation& T_M_I) {
+  std::lock_guard<std::mutex> lock(m_state_);
+  T_M_I_buffer_.addValue(timestamp_ns, T_M_I);
+}
+
 bool Localizer::localizeNFrame(
     const aslam::VisualNFrame::ConstPtr& nframe,
-    vio::LocalizationResult* localization_result) const {
+    vio::LocalizationResult* localization_result) {
   CHECK(nframe);
   CHECK_NOTNULL(localization_result);
 
+  const int64_t timestamp_ns = nframe->getMinTimestampNanoseconds();
+
+  // The localization itself runs on a snapshot of the state.
+  aslam::Transformation T_M_I;
+  bool has_vio_pose;
+  LocalizationMode localization_mode;
+  aslam::Transformation T_G_M;
+  bool has_T_G_M;
+  {
+    std::lock_guard<std::mutex> lock(m_state_);
+    has_vio_pose = getVioPose(*nframe, &T_M_I);
+    localization_mode = current_localization_mode_;
+    T_G_M = T_G_M_;
+    has_T_G_M = has_T_G_M_;
+  }
+
   bool result = false;
-  switch (current_localization_mode_) {
-    case Localizer::LocalizationMode::kGlobal:
-      result = localizeNFrameGlobal(nframe, &localization_result->T_G_I_lc_pnp);
-      break;
-    case Localizer::LocalizationMode::kMapTracking:
-      result =
-          localizeNFrameMapTracking(nframe, &localization_result->T_G_I_lc_pnp);
-      break;
-    default:
-      LOG(FATAL) << "Unknown localization mode.";
-      break;
-  }
-
-  localization_result->timestamp = nframe->getMinTimestampNanoseconds();
+  if (localization_mode == LocalizationMode::kMapTracking) {
+    if (has_vio_pose) {
+      result = localizeNFrameMapTracking(
+          nframe, T_G_M * T_M_I, &localization_result->T_G_I_lc_pnp);
+    }
+    if (!result) {
+      VLOG(1) << "Lost map tracking, falling back to global localization.";
+      localization_mode = LocalizationMode::kGlobal;
+    }
+  }
+  localization_result->localization_type = localization_mode;
+
+  if (localization_mode == LocalizationMode::kGlobal) {
+    aslam::Transformation T_G_I_prior;
+    const bool has_prior =
+        has_vio_pose && has_T_G_M &&
+        FLAGS_rovioli_localization_prior_search_radius_m > 0.0;
+    if (has_prior) {
+      T_G_I_prior = T_G_M * T_M_I;
+    }
+    result = localizeNFrameGlobal(
+        nframe, has_prior ? &T_G_I_prior : nullptr,
+        &localization_result->T_G_I_lc_pnp);
+    if (!result && has_prior) {
+      // The VIO may have drifted away from the last localization or jumped.
+      VLOG(1) << "Localization around the VIO prior failed, searching the "
+              << "whole map.";
+      result = localizeNFrameGlobal(
+          nframe, nullptr, &localization_result->T_G_I_lc_pnp);
+    }
+    if (result && has_vio_pose) {
+      localization_mode = LocalizationMode::kMapTracking;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_state_);
+  if (timestamp_ns > last_applied_timestamp_ns_) {
+    last_applied_timestamp_ns_ = timestamp_ns;
+    current_localization_mode_ = localization_mode;
+    if (result && has_vio_pose) {
+      T_G_M_ = localization_result->T_G_I_lc_pnp * T_M_I.inverse();
+      has_T_G_M_ = true;
+    }
+
+    if (tiled_localization_map_ != nullptr) {
+      if (result) {
+        tiled_localization_map_->setPosition(
+            localization_result->T_G_I_lc_pnp.getPosition());
+      } else if (has_vio_pose && has_T_G_M_) {
+        tiled_localization_map_->setPosition((T_G_M_ * T_M_I).getPosition());
+      }
+    }
+
+    // Localization is lost, so T_G_M can't be trusted anymore to restrict the
+    // search of the next nframes.
+    if (!result) {
+      has_T_G_M_ = false;
+    }
+  }
+
+  localization_result->timestamp = timestamp_ns;
   localization_result->nframe_id = nframe->getId();
-  localization_result->localization_type = current_localization_mode_;
   return result;
 }
 
+bool Localizer::getVioPose(
+    const aslam::VisualNFrame& nframe, aslam::Transformation* T_M_I) const {
+  CHECK_NOTNULL(T_M_I);
+  const int64_t timestamp_nframe_ns = nframe.getMinTimestampNanoseconds();
+  int64_t timestamp_vio_ns;
+  if (!T_M_I_buffer_.getValueAtOrBeforeTime(
+          timestamp_nframe_ns, &timestamp_vio_ns, T_M_I)) {
+    return false;
+  }
+  return timestamp_nframe_ns - timestamp_vio_ns <=
+         aslam::time::secondsToNanoSeconds(
+             FLAGS_rovioli_map_tracking_max_vio_delay_s);
+}
+
+void Localizer::getDatabases(
+    std::vector<LocalizationDatabase::ConstPtr>* databases) const {
+  CHECK_NOTNULL(databases);
+  if (tiled_localization_map_ != nullptr) {
+    tiled_localization_map_->getLoadedDatabases(databases);
+  } else {
+    *databases = databases_;
+  }
+}
+
 bool Localizer::localizeNFrameGlobal(
     const aslam::VisualNFrame::ConstPtr& nframe,
+    const aslam::Transformation* T_G_I_prior,
     aslam::Transformation* T_G_I_lc_pnp) const {
+  // Note: T_G_I_prior is optional and may be NULL.
+  CHECK(nframe);
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  std::vector<LocalizationDatabase::ConstPtr> databases;
+  getDatabases(&databases);
+
+  // With several databases, the localization with the most inliers wins.
   constexpr bool kSkipUntrackedKeypoints = false;
-  unsigned int num_lc_matches;
-  vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
-  return global_loop_detector_->findNFrameInSummaryMapDatabase(
-      *nframe, kSkipUntrackedKeypoints, localization_summary_map_, T_G_I_lc_pnp,
-      &num_lc_matches, &inlier_structure_matches);
+  bool result = false;
+  size_t best_num_inliers = 0u;
+  for (const LocalizationDatabase::ConstPtr& database : databases) {
+    CHECK(database);
+    aslam::Transformation T_G_I;
+    unsigned int num_lc_matches;
+    vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+    bool database_result;
+    if (T_G_I_prior != nullptr) {
+      database_result = database->loopDetector().findNFrameInSummaryMapDatabase(
+          *nframe, kSkipUntrackedKeypoints, database->summaryMap(),
+          T_G_I_prior->getPosition(),
+          FLAGS_rovioli_localization_prior_search_radius_m, &T_G_I,
+          &num_lc_matches, &inlier_structure_matches);
+    } else {
+      database_result = database->loopDetector().findNFrameInSummaryMapDatabase(
+          *nframe, kSkipUntrackedKeypoints, database->summaryMap(), &T_G_I,
+          &num_lc_matches, &inlier_structure_matches);
+    }
+    if (database_result &&
+        (!result || inlier_structure_matches.size() > best_num_inliers)) {
+      result = true;
+      best_num_inliers = inlier_structure_matches.size();
+      *T_G_I_lc_pnp = T_G_I;
+    }
+  }
+  return result;
 }
 
 bool Localizer::localizeNFrameMapTracking(
-    const aslam::VisualNFrame::ConstPtr& /*nframe*/,
-    aslam::Transformation* /*T_G_I_lc_pnp*/) const {
-  LOG(FATAL) << "Not implemented yet.";
-  return false;
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    const aslam::Transformation& T_G_I_prior,
+    aslam::Transformation* T_G_I_lc_pnp) const {
+  CHECK(nframe);
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  std::vector<LocalizationDatabase::ConstPtr> databases;
+  getDatabases(&databases);
+  if (databases.empty()) {
+    return false;
+  }
+
+  const aslam::NCamera& ncamera = nframe->getNCamera();
+  const aslam::Transformation T_I_G = T_G_I_prior.inverse();
+  const double search_radius_squared =
+      FLAGS_rovioli_map_tracking_search_radius_px *
+      FLAGS_rovioli_map_tracking_search_radius_px;
+  const double ratio_squared = FLAGS_rovioli_map_tracking_descriptor_ratio *
+                               FLAGS_rovioli_map_tracking_descriptor_ratio;
+
+  std::vector<Eigen::Vector2d> measurements;
+  std::vector<int> measurement_camera_indices;
+  std::vector<Eigen::Vector3d> G_matched_landmark_positions;
+  for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames(); ++frame_idx) {
+    if (!nframe->isFrameSet(frame_idx)) {
+      continue;
+    }
+    const aslam::VisualFrame& frame = nframe->getFrame(frame_idx);
+    const Eigen::Matrix2Xd& keypoints = frame.getKeypointMeasurements();
+    if (keypoints.cols() == 0) {
+      continue;
+    }
+    // All databases share the same descriptor projection.
+    Eigen::MatrixXf projected_descriptors;
+    databases.front()->loopDetector().projectDescriptors(
+        frame.getDescriptors(), &projected_descriptors);
+    CHECK_EQ(projected_descriptors.cols(), keypoints.cols());
+
+    const aslam::Camera& camera = ncamera.getCamera(frame_idx);
+    const KeypointGrid grid(
+        keypoints, FLAGS_rovioli_map_tracking_search_radius_px,
+        camera.imageWidth(), camera.imageHeight());
+    const aslam::Transformation T_C_G = ncamera.get_T_C_B(frame_idx) * T_I_G;
+    const Eigen::Vector3d G_p_C = T_C_G.inverse().getPosition();
+
+    // The best landmark of every keypoint over all databases.
+    std::unordered_map<int, LandmarkMatch> keypoint_matches;
+    for (size_t database_idx = 0u; database_idx < databases.size();
+         ++database_idx) {
+      const LocalizationDatabase& database = *databases[database_idx];
+      const Eigen::Matrix3Xf& G_landmark_positions =
+          database.summaryMap().GLandmarkPosition();
+      const summary_map::LocalizationSummaryMap& database_summary_map =
+          database.summaryMap();
+      CHECK_EQ(
+          projected_descriptors.rows(),
+          database_summary_map.projectedDescriptorDimensionality());
+      std::vector<unsigned int> landmark_indices;
+      getLandmarkIndicesInRadius(
+          database_summary_map, G_p_C,
+          FLAGS_rovioli_map_tracking_max_landmark_distance_m,
+          &landmark_indices);
+      for (const unsigned int landmark_index : landmark_indices) {
+        const int landmark_idx = static_cast<int>(landmark_index);
+        const Eigen::Vector3d G_p_fi =
+            G_landmark_positions.col(landmark_idx).cast<double>();
+        Eigen::Vector2d projected_keypoint;
+        const aslam::ProjectionResult projection_result =
+            camera.project3(T_C_G * G_p_fi, &projected_keypoint);
+        if (!projection_result.isKeypointVisible()) {
+          continue;
+        }
+
+        float best_distance = std::numeric_limits<float>::max();
+        float second_best_distance = std::numeric_limits<float>::max();
+        int best_keypoint_idx = -1;
+        grid.forEachKeypointAround(
+            projected_keypoint, [&](const int keypoint_idx) {
+              if ((keypoints.col(keypoint_idx) - projected_keypoint)
+                      .squaredNorm() > search_radius_squared) {
+                return;
+              }
+              float distance = std::numeric_limits<float>::max();
+              for (const unsigned int observation_idx :
+                   database.getLandmarkObservationIndices(landmark_idx)) {
+                distance = std::min(
+                    distance, database_summary_map
+                                  .getSquaredDistanceToProjectedDescriptor(
+                                      observation_idx,
+                                      projected_descriptors.col(keypoint_idx)));
+              }
+              if (distance < best_distance) {
+                second_best_distance = best_distance;
+                best_distance = distance;
+                best_keypoint_idx = keypoint_idx;
+              } else if (distance < second_best_distance) {
+                second_best_distance = distance;
+              }
+            });
+        if (best_keypoint_idx < 0 ||
+            best_distance > ratio_squared * second_best_distance) {
+          continue;
+        }
+        const LandmarkMatch match = {database_idx, landmark_idx, best_distance};
+        const std::unordered_map<int, LandmarkMatch>::iterator it =
+            keypoint_matches.find(best_keypoint_idx);
+        if (it == keypoint_matches.end()) {
+          keypoint_matches.emplace(best_keypoint_idx, match);
+        } else if (best_distance < it->second.descriptor_distance) {
+          it->second = match;
+        }
+      }
+    }
+
+    for (const std::unordered_map<int, LandmarkMatch>::value_type&
+             keypoint_match : keypoint_matches) {
+      const LandmarkMatch& match = keypoint_match.second;
+      measurements.emplace_back(keypoints.col(keypoint_match.first));
+      measurement_camera_indices.push_back(frame_idx);
+      G_matched_landmark_positions.emplace_back(
+          databases[match.database_index]
+              ->summaryMap()
+              .GLandmarkPosition()
+              .col(match.landmark_index)
+              .cast<double>());
+    }
+  }
+
+  const int num_matches = measurements.size();
+  VLOG(3) << "Map tracking found " << num_matches << " matches.";
+  if (num_matches < FLAGS_rovioli_map_tracking_min_inliers) {
+    return false;
+  }
+
+  Eigen::Matrix2Xd measurement_matrix(2, num_matches);
+  Eigen::Matrix3Xd G_landmark_position_matrix(3, num_matches);
+  for (int i = 0; i < num_matches; ++i) {
+    measurement_matrix.col(i) = measurements[i];
+    G_landmark_position_matrix.col(i) = G_matched_landmark_positions[i];
+  }
+
+  constexpr bool kUseRandomPnpSeed = true;
+  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
+      FLAGS_lc_nonlinear_refinement_p3p, kUseRandomPnpSeed);
+  std::vector<int> inliers;
+  std::vector<double> inlier_distances_to_model;
+  int num_iters;
+  pose_estimator.absoluteMultiPoseRansacPinholeCam(
+      measurement_matrix, measurement_camera_indices,
+      G_landmark_position_matrix, FLAGS_lc_ransac_pixel_sigma,
+      FLAGS_lc_num_ransac_iters, nframe->getNCameraShared(), T_G_I_lc_pnp,
+      &inliers, &inlier_distances_to_model, &num_iters);
+  VLOG(3) << "Map tracking PnP with " << inliers.size() << " inliers.";
+  if (static_cast<int>(inliers.size()) <
+      FLAGS_rovioli_map_tracking_min_inliers) {
+    return false;
+  }
+  return (T_G_I_lc_pnp->getPosition() - T_G_I_prior.getPosition()).norm() <=
+         FLAGS_rovioli_map_tracking_max_position_jump_m;
 }
 
 }  // namespace rovioli
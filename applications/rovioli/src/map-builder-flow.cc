@@ -1,7 +1,9 @@
 #include "rovioli/map-builder-flow.h"
 
+#include <chrono>
 #include <functional>
 
+#include <aslam/common/timer.h>
 #include <landmark-triangulation/landmark-triangulation.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
@@ -12,12 +14,24 @@
 #include <vi-map-helpers/vi-map-manipulation.h>
 #include <vi-map/vi-map-serialization.h>
 #include <vi-map/vi-map.h>
+#include <vio-common/pipeline-trace.h>
 #include <visualization/viwls-graph-plotter.h>
 
 DEFINE_double(
     localization_map_keep_landmark_fraction, 0.0,
     "Fraction of landmarks to keep when creating a localization summary map.");
+DEFINE_double(
+    rovioli_map_checkpoint_period_s, 0.0,
+    "If larger than zero, the raw map is saved to the save map folder with "
+    "this period while it is being built. Every checkpoint and the final save "
+    "only rewrite the map files that changed since the previous save.");
+DEFINE_double(
+    rovioli_map_memory_stats_period_s, 0.0,
+    "If larger than zero, the estimated memory used by the map is logged with "
+    "this period while it is being built.");
+DECLARE_bool(rovioli_online_loop_closure);
 DECLARE_bool(rovioli_visualize_map);
+DECLARE_bool(vi_map_incremental_save);
 
 namespace rovioli {
 
@@ -25,12 +39,40 @@ MapBuilderFlow::MapBuilderFlow(
     const std::shared_ptr<aslam::NCamera>& n_camera, vi_map::Imu::UniquePtr imu,
     const std::string& save_map_folder)
     : map_with_mutex_(aligned_shared<VIMapWithMutex>()),
+      save_map_folder_(save_map_folder),
+      checkpoint_shutdown_requested_(false),
+      has_checkpoint_(false),
+      last_memory_stats_time_(std::chrono::steady_clock::now()),
       mapping_terminated_(false),
       stream_map_builder_(n_camera, std::move(imu), &map_with_mutex_->vi_map) {
   if (!save_map_folder.empty()) {
     VLOG(1) << "Set VIMap folder to: " << save_map_folder;
     map_with_mutex_->vi_map.setMapFolder(save_map_folder);
   }
+
+  if (FLAGS_rovioli_map_checkpoint_period_s > 0.0) {
+    if (save_map_folder_.empty()) {
+      LOG(WARNING) << "No save map folder is set, the map is not checkpointed.";
+    } else {
+      // The checkpoints are only cheap if unchanged files are skipped.
+      FLAGS_vi_map_incremental_save = true;
+      checkpoint_thread_ =
+          std::thread(&MapBuilderFlow::checkpointWorker, this);
+    }
+  }
+
+  if (FLAGS_rovioli_online_loop_closure) {
+    online_loop_closure_.reset(
+        new OnlineLoopClosure(map_with_mutex_.get(), &stream_map_builder_));
+    online_loop_closure_->start();
+  }
+}
+
+MapBuilderFlow::~MapBuilderFlow() {
+  stopCheckpointing();
+  if (online_loop_closure_) {
+    online_loop_closure_->stop();
+  }
 }
 
 void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
@@ -39,10 +81,16 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   std::function<void(const VIMapWithMutex::ConstPtr&)> map_publish_function =
       flow->registerPublisher<message_flow_topics::RAW_VIMAP>();
   CHECK(map_publish_function);
+  // Growing the map is not latency critical and must not hold up the
+  // estimator.
+  message_flow::DeliveryOptions map_building_options;
+  map_building_options.priority = message_flow::DeliveryPriority::kBulk;
   flow->registerSubscriber<message_flow_topics::VIO_UPDATES>(
-      kSubscriberNodeName, message_flow::DeliveryOptions(),
+      kSubscriberNodeName, map_building_options,
       [this, map_publish_function](const vio::VioUpdate::ConstPtr& vio_update) {
         CHECK(vio_update != nullptr);
+        vio::ScopedPipelineTraceStage trace_stage(
+            vio_update->trace.get(), "map_builder");
         {
           std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
           if (mapping_terminated_) {
@@ -53,6 +101,7 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           // added to the map might still be modified.
           constexpr bool kDeepCopyNFrame = false;
           stream_map_builder_.apply(*vio_update, kDeepCopyNFrame);
+          logMapMemoryUsageIfDue();
         }
         map_publish_function(map_with_mutex_);
       });
@@ -87,11 +136,82 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           std::placeholders::_1));
 }
 
+void MapBuilderFlow::logMapMemoryUsageIfDue() {
+  if (FLAGS_rovioli_map_memory_stats_period_s <= 0.0) {
+    return;
+  }
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (std::chrono::duration<double>(now - last_memory_stats_time_).count() <
+      FLAGS_rovioli_map_memory_stats_period_s) {
+    return;
+  }
+  last_memory_stats_time_ = now;
+  vi_map::MapMemoryUsage usage;
+  map_with_mutex_->vi_map.getMemoryUsage(&usage);
+  LOG(INFO) << "Map memory usage with "
+            << map_with_mutex_->vi_map.numVertices() << " vertices:\n"
+            << usage.print();
+}
+
+void MapBuilderFlow::checkpointWorker() {
+  const std::chrono::milliseconds checkpoint_period(
+      static_cast<int64_t>(FLAGS_rovioli_map_checkpoint_period_s * 1e3));
+  std::unique_lock<std::mutex> lock(m_checkpoint_shutdown_);
+  while (!cv_checkpoint_shutdown_.wait_for(
+      lock, checkpoint_period,
+      [this]() { return checkpoint_shutdown_requested_; })) {
+    // Don't hold up the shutdown while checkpointing.
+    lock.unlock();
+    checkpointMap();
+    lock.lock();
+  }
+}
+
+void MapBuilderFlow::checkpointMap() {
+  CHECK(!save_map_folder_.empty());
+  std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
+  if (mapping_terminated_ || map_with_mutex_->vi_map.numVertices() < 3u) {
+    return;
+  }
+
+  timing::Timer timer("MapBuilderFlow: checkpoint map");
+  stream_map_builder_.waitForPendingResourceWrites();
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  if (!vi_map::serialization::saveMapToFolder(
+          save_map_folder_, save_config, &map_with_mutex_->vi_map)) {
+    LOG(ERROR) << "Checkpointing the map to " << save_map_folder_
+               << " failed.";
+    return;
+  }
+  has_checkpoint_ = true;
+  VLOG(1) << "Checkpointed the map with "
+          << map_with_mutex_->vi_map.numVertices() << " vertices to "
+          << save_map_folder_ << " in " << timer.Stop() << " s.";
+}
+
+void MapBuilderFlow::stopCheckpointing() {
+  if (!checkpoint_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_checkpoint_shutdown_);
+    checkpoint_shutdown_requested_ = true;
+  }
+  cv_checkpoint_shutdown_.notify_all();
+  checkpoint_thread_.join();
+}
+
 void MapBuilderFlow::saveMapAndOptionallyOptimize(
     const std::string& path, const bool overwrite_existing_map,
     const bool process_to_localization_map) {
   CHECK(!path.empty());
   CHECK(map_with_mutex_);
+  stopCheckpointing();
+  if (online_loop_closure_) {
+    online_loop_closure_->stop();
+  }
 
   std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
   mapping_terminated_ = true;
@@ -101,6 +221,22 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
     LOG(WARNING) << "Map is empty; nothing will be saved.";
     return;
   }
+  stream_map_builder_.finishOnlineKeyframing();
+  stream_map_builder_.waitForPendingResourceWrites();
+
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = overwrite_existing_map;
+  if (has_checkpoint_ && path == save_map_folder_) {
+    // Persist the raw map first, which only writes the vertices added since
+    // the last checkpoint. If the process is killed while finishing the map,
+    // the landmarks can still be initialized from this map offline.
+    save_config.overwrite_existing_files = true;
+    timing::Timer timer("MapBuilderFlow: save delta since checkpoint");
+    vi_map::serialization::saveMapToFolder(
+        path, save_config, &map_with_mutex_->vi_map);
+    LOG(INFO) << "Saved the delta of the raw VI-map since the last checkpoint "
+              << "in " << timer.Stop() << " s.";
+  }
 
   visualization::ViwlsGraphRvizPlotter::UniquePtr plotter;
   if (FLAGS_rovioli_visualize_map) {
@@ -115,6 +251,10 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
     CHECK_EQ(mission_ids.size(), 1u);
     const vi_map::MissionId& id_of_first_mission = mission_ids.front();
 
+    if (online_loop_closure_) {
+      // Continues the tracks of the landmarks that were initialized online.
+      online_loop_closure_->initializeLandmarksOfRemainingVertices();
+    }
     vi_map_helpers::VIMapManipulation manipulation(&map_with_mutex_->vi_map);
     manipulation.initializeLandmarksFromUnusedFeatureTracksOfMission(
         id_of_first_mission);
@@ -123,8 +263,6 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
         id_of_first_mission, &map_with_mutex_->vi_map);
   }
 
-  backend::SaveConfig save_config;
-  save_config.overwrite_existing_files = overwrite_existing_map;
   vi_map::serialization::saveMapToFolder(
       path, save_config, &map_with_mutex_->vi_map);
   LOG(INFO) << "Raw VI-map saved to: " << path;
@@ -0,0 +1,39 @@
+#include "rovioli/measurement-completion.h"
+
+namespace rovioli {
+
+MeasurementCompletion::MeasurementCompletion() : num_pending_(0u) {}
+
+void MeasurementCompletion::addPending(const size_t num_pending) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  num_pending_ += num_pending;
+}
+
+void MeasurementCompletion::complete(const size_t num_completed) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_GE(num_pending_, num_completed);
+    num_pending_ -= num_completed;
+    if (num_pending_ > 0u) {
+      return;
+    }
+  }
+  cv_all_completed_.notify_all();
+}
+
+void MeasurementCompletion::waitUntilAllCompleted() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_all_completed_.wait(lock, [this]() { return num_pending_ == 0u; });
+}
+
+void MeasurementCompletion::addPendingMessagesOfTopic(
+    const std::string& topic) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::unordered_map<std::string, size_t>::const_iterator it =
+      num_consumers_per_topic_.find(topic);
+  if (it != num_consumers_per_topic_.end()) {
+    num_pending_ += it->second;
+  }
+}
+
+}  // namespace rovioli
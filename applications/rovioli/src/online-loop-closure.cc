@@ -0,0 +1,337 @@
+#include "rovioli/online-loop-closure.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <aslam/common/timer.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <landmark-triangulation/landmark-triangulation.h>
+#include <map-optimization/augment-loopclosure.h>
+#include <map-optimization/optimization-problem.h>
+#include <map-optimization/solver-options.h>
+#include <map-optimization/solver.h>
+#include <map-optimization/vi-map-relaxation.h>
+#include <map-optimization/vi-optimization-builder.h>
+#include <vi-map/vi-map.h>
+
+DEFINE_bool(
+    rovioli_online_loop_closure, false,
+    "Close loops within the mission and relax the pose graph in the "
+    "background while the map is built.");
+DEFINE_double(
+    rovioli_online_lc_period_s, 5.0,
+    "Minimum time between two cycles of the online loop-closure.");
+DEFINE_double(
+    rovioli_online_lc_max_cpu_share, 0.25,
+    "Maximum share of the wall time the online loop-closure is busy. The "
+    "time between two cycles is extended accordingly.");
+DEFINE_int32(
+    rovioli_online_lc_num_threads, 1,
+    "Number of threads of the online loop-closure queries and relaxation.");
+DEFINE_double(
+    rovioli_online_lc_min_loop_age_s, 30.0,
+    "Vertices are only added to the online loop-closure database once they "
+    "are this much older than the newest settled vertex.");
+DEFINE_double(
+    rovioli_online_lc_max_relaxation_time_s, 1.0,
+    "Maximum solver time of an online relaxation.");
+
+namespace rovioli {
+
+OnlineLoopClosure::OnlineLoopClosure(
+    VIMapWithMutex* map_with_mutex,
+    online_map_builders::StreamMapBuilder* stream_map_builder)
+    : map_with_mutex_(CHECK_NOTNULL(map_with_mutex)),
+      stream_map_builder_(CHECK_NOTNULL(stream_map_builder)),
+      database_empty_(true),
+      shutdown_requested_(false) {
+  CHECK_GT(FLAGS_rovioli_online_lc_max_cpu_share, 0.0);
+  CHECK_LE(FLAGS_rovioli_online_lc_max_cpu_share, 1.0);
+  CHECK_GT(FLAGS_rovioli_online_lc_num_threads, 0);
+  loop_detector_.setMaxNumQueryThreads(FLAGS_rovioli_online_lc_num_threads);
+}
+
+OnlineLoopClosure::~OnlineLoopClosure() {
+  stop();
+}
+
+void OnlineLoopClosure::start() {
+  CHECK(!worker_thread_.joinable());
+  shutdown_requested_ = false;
+  worker_thread_ = std::thread(&OnlineLoopClosure::worker, this);
+}
+
+void OnlineLoopClosure::stop() {
+  if (!worker_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_shutdown_);
+    shutdown_requested_ = true;
+  }
+  cv_shutdown_.notify_all();
+  worker_thread_.join();
+}
+
+void OnlineLoopClosure::worker() {
+  std::chrono::duration<double> wait_time(FLAGS_rovioli_online_lc_period_s);
+  std::unique_lock<std::mutex> lock(m_shutdown_);
+  while (!cv_shutdown_.wait_for(
+      lock, wait_time, [this]() { return shutdown_requested_; })) {
+    lock.unlock();
+    const std::chrono::steady_clock::time_point cycle_start =
+        std::chrono::steady_clock::now();
+    processSettledVertices();
+    // Idle long enough that the busy time stays within the CPU share.
+    const double cycle_time_s = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() -
+                                    cycle_start)
+                                    .count();
+    wait_time = std::chrono::duration<double>(std::max(
+        FLAGS_rovioli_online_lc_period_s,
+        cycle_time_s * (1.0 / FLAGS_rovioli_online_lc_max_cpu_share - 1.0)));
+    lock.lock();
+  }
+}
+
+void OnlineLoopClosure::processSettledVertices() {
+  pose_graph::VertexIdList vertex_ids;
+  // Only the relaxation runs without the map mutex, on a copy of the pose
+  // graph, so the map builder isn't blocked by it.
+  vi_map::VIMap pose_graph_copy;
+  pose_graph::VertexId last_vertex_id;
+  {
+    std::lock_guard<std::mutex> map_lock(map_with_mutex_->mutex);
+    const pose_graph::VertexId last_settled_vertex_id =
+        stream_map_builder_->getLastSettledVertexId();
+    if (!last_settled_vertex_id.isValid()) {
+      return;
+    }
+    getUnprocessedVertices(last_settled_vertex_id, &vertex_ids);
+    if (vertex_ids.empty()) {
+      return;
+    }
+    last_processed_vertex_id_ = vertex_ids.back();
+
+    initializeAndTriangulateLandmarks(vertex_ids);
+    pose_graph::VertexIdList database_vertex_ids;
+    getVerticesToAddToDatabase(vertex_ids, &database_vertex_ids);
+    if (database_empty_ && database_vertex_ids.empty()) {
+      return;
+    }
+
+    timing::Timer timer("OnlineLoopClosure: detection");
+    vi_map::VIMap* map = &map_with_mutex_->vi_map;
+    if (!database_vertex_ids.empty()) {
+      loop_detector_.addVerticesToDatabase(database_vertex_ids, *map);
+      database_empty_ = false;
+    }
+    pose_graph::EdgeIdList new_loop_closure_edge_ids;
+    detectLoopClosures(vertex_ids, map, &new_loop_closure_edge_ids);
+    VLOG(1) << "Online loop-closure processed " << vertex_ids.size()
+            << " vertices in " << timer.Stop() << " s.";
+    if (new_loop_closure_edge_ids.empty()) {
+      return;
+    }
+    pose_graph_copy.copyPoseGraphFrom(*map);
+    last_vertex_id = stream_map_builder_->getLastVertexId();
+  }
+
+  const aslam::Transformation T_M_I_before =
+      pose_graph_copy.getVertex(last_vertex_id).get_T_M_I();
+  relaxMission(&pose_graph_copy);
+  const aslam::Transformation T_corrected_uncorrected =
+      pose_graph_copy.getVertex(last_vertex_id).get_T_M_I() *
+      T_M_I_before.inverse();
+
+  std::lock_guard<std::mutex> map_lock(map_with_mutex_->mutex);
+  writeBackRelaxation(pose_graph_copy, T_corrected_uncorrected);
+}
+
+void OnlineLoopClosure::getUnprocessedVertices(
+    const pose_graph::VertexId& last_vertex_id,
+    pose_graph::VertexIdList* vertex_ids) const {
+  CHECK(last_vertex_id.isValid());
+  CHECK_NOTNULL(vertex_ids)->clear();
+  if (last_vertex_id == last_processed_vertex_id_) {
+    return;
+  }
+  const vi_map::VIMap& map = map_with_mutex_->vi_map;
+  pose_graph::VertexId vertex_id = last_processed_vertex_id_;
+  if (!vertex_id.isValid()) {
+    vertex_id = stream_map_builder_->getRootVertexId();
+    vertex_ids->emplace_back(vertex_id);
+  }
+  const pose_graph::Edge::EdgeType backbone_type =
+      map.getGraphTraversalEdgeType(stream_map_builder_->getMissionId());
+  while (vertex_id != last_vertex_id &&
+         map.getNextVertex(vertex_id, backbone_type, &vertex_id)) {
+    vertex_ids->emplace_back(vertex_id);
+  }
+}
+
+void OnlineLoopClosure::initializeAndTriangulateLandmarks(
+    const pose_graph::VertexIdList& vertex_ids) {
+  vi_map::VIMap* map = &map_with_mutex_->vi_map;
+  vi_map_helpers::VIMapManipulation manipulation(map);
+  manipulation.initializeLandmarksFromUnusedFeatureTracksOfOrderedVertices(
+      vertex_ids, &track_id_to_landmark_id_);
+
+  // The tracks that continue from older vertices added observations to
+  // landmarks stored there, so these are triangulated again as well.
+  pose_graph::VertexIdSet storing_vertex_ids;
+  vi_map::LandmarkIdList landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    map->getVertex(vertex_id).getAllObservedLandmarkIds(&landmark_ids);
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+      if (landmark_id.isValid()) {
+        storing_vertex_ids.emplace(map->getLandmarkStoreVertexId(landmark_id));
+      }
+    }
+  }
+  for (const pose_graph::VertexId& storing_vertex_id : storing_vertex_ids) {
+    landmark_triangulation::retriangulateLandmarksOfVertex(
+        storing_vertex_id, map);
+  }
+}
+
+void OnlineLoopClosure::getVerticesToAddToDatabase(
+    const pose_graph::VertexIdList& vertex_ids,
+    pose_graph::VertexIdList* database_vertex_ids) {
+  CHECK(!vertex_ids.empty());
+  CHECK_NOTNULL(database_vertex_ids)->clear();
+  const vi_map::VIMap& map = map_with_mutex_->vi_map;
+
+  // The queries would mostly match the vertices they share feature tracks
+  // with, so only vertices that are old enough are in the database.
+  vertices_to_add_to_database_.insert(
+      vertices_to_add_to_database_.end(), vertex_ids.begin(),
+      vertex_ids.end());
+  const int64_t newest_timestamp_ns =
+      map.getVertex(vertex_ids.back()).getMinTimestampNanoseconds();
+  const int64_t min_loop_age_ns =
+      static_cast<int64_t>(FLAGS_rovioli_online_lc_min_loop_age_s * 1e9);
+  while (!vertices_to_add_to_database_.empty() &&
+         newest_timestamp_ns -
+                 map.getVertex(vertices_to_add_to_database_.front())
+                     .getMinTimestampNanoseconds() >=
+             min_loop_age_ns) {
+    database_vertex_ids->emplace_back(vertices_to_add_to_database_.front());
+    vertices_to_add_to_database_.pop_front();
+  }
+}
+
+void OnlineLoopClosure::detectLoopClosures(
+    const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map,
+    pose_graph::EdgeIdList* new_loop_closure_edge_ids) {
+  CHECK(!vertex_ids.empty());
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(new_loop_closure_edge_ids)->clear();
+
+  const vi_map::MissionIdSet mission_ids = {
+      stream_map_builder_->getMissionId()};
+  pose_graph::EdgeIdList loop_closure_edges;
+  map_optimization::getLoopclosureEdgesOfMissions(
+      *map, mission_ids, &loop_closure_edges);
+  const pose_graph::EdgeIdSet loop_closure_edges_before(
+      loop_closure_edges.begin(), loop_closure_edges.end());
+
+  constexpr bool kMergeLandmarks = false;
+  constexpr bool kAddLoopclosureEdges = true;
+  int num_vertex_candidate_links;
+  double summary_landmark_match_inlier_ratio;
+  pose::Transformation T_G_M_estimate;
+  vi_map::LoopClosureConstraintVector inlier_constraints;
+  loop_detector_.detectLoopClosuresVerticesToDatabase(
+      vertex_ids, kMergeLandmarks, kAddLoopclosureEdges,
+      &num_vertex_candidate_links, &summary_landmark_match_inlier_ratio, map,
+      &T_G_M_estimate, &inlier_constraints);
+
+  map_optimization::getLoopclosureEdgesOfMissions(
+      *map, mission_ids, &loop_closure_edges);
+  for (const pose_graph::EdgeId& edge_id : loop_closure_edges) {
+    if (loop_closure_edges_before.count(edge_id) == 0u) {
+      new_loop_closure_edge_ids->emplace_back(edge_id);
+    }
+  }
+  VLOG(1) << "Online loop-closure added " << new_loop_closure_edge_ids->size()
+          << " loop-closure edges.";
+}
+
+void OnlineLoopClosure::relaxMission(vi_map::VIMap* pose_graph_copy) {
+  CHECK_NOTNULL(pose_graph_copy);
+  timing::Timer timer("OnlineLoopClosure: relaxation");
+  const vi_map::MissionIdSet mission_ids = {
+      stream_map_builder_->getMissionId()};
+
+  // The pose graph copy has neither visual frames nor landmarks.
+  map_optimization::ViProblemOptions problem_options =
+      map_optimization::initRelaxationProblemOptionsFromGFlags();
+  problem_options.add_visual_constraints = false;
+  problem_options.add_inertial_constraints = true;
+  map_optimization::OptimizationProblem::UniquePtr optimization_problem(
+      map_optimization::constructViProblem(
+          mission_ids, problem_options, pose_graph_copy));
+  CHECK(optimization_problem != nullptr);
+  map_optimization::augmentViProblemWithLoopclosureEdges(
+      optimization_problem.get());
+
+  ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  solver_options.minimizer_progress_to_stdout = false;
+  solver_options.num_threads = FLAGS_rovioli_online_lc_num_threads;
+  solver_options.num_linear_solver_threads =
+      FLAGS_rovioli_online_lc_num_threads;
+  solver_options.max_solver_time_in_seconds =
+      FLAGS_rovioli_online_lc_max_relaxation_time_s;
+  map_optimization::solve(solver_options, optimization_problem.get());
+  optimization_problem->getOptimizationStateBufferMutable()
+      ->copyAllStatesBackToMap(pose_graph_copy);
+  VLOG(1) << "Online relaxation took " << timer.Stop() << " s.";
+}
+
+void OnlineLoopClosure::writeBackRelaxation(
+    const vi_map::VIMap& relaxed_pose_graph,
+    const aslam::Transformation& T_corrected_uncorrected) {
+  vi_map::VIMap* map = &map_with_mutex_->vi_map;
+  // The vertices that were added after the copy, and the ones that are still
+  // to come, continue from the VIO estimate, which is unaware of the
+  // relaxation.
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIdsInMission(
+      stream_map_builder_->getMissionId(), &vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    vi_map::Vertex& vertex = map->getVertex(vertex_id);
+    if (relaxed_pose_graph.hasVertex(vertex_id)) {
+      const vi_map::Vertex& relaxed_vertex =
+          relaxed_pose_graph.getVertex(vertex_id);
+      vertex.set_T_M_I(relaxed_vertex.get_T_M_I());
+      vertex.set_v_M(relaxed_vertex.get_v_M());
+      vertex.setAccelBias(relaxed_vertex.getAccelBias());
+      vertex.setGyroBias(relaxed_vertex.getGyroBias());
+    } else {
+      vertex.set_T_M_I(T_corrected_uncorrected * vertex.get_T_M_I());
+      vertex.set_v_M(
+          T_corrected_uncorrected.getRotation().rotate(vertex.get_v_M()));
+    }
+  }
+  stream_map_builder_->applyPoseCorrectionToNewVertices(
+      T_corrected_uncorrected);
+}
+
+void OnlineLoopClosure::initializeLandmarksOfRemainingVertices() {
+  const pose_graph::VertexId last_vertex_id =
+      stream_map_builder_->getLastVertexId();
+  pose_graph::VertexIdList vertex_ids;
+  getUnprocessedVertices(last_vertex_id, &vertex_ids);
+  if (vertex_ids.empty()) {
+    return;
+  }
+  last_processed_vertex_id_ = vertex_ids.back();
+  vi_map_helpers::VIMapManipulation manipulation(&map_with_mutex_->vi_map);
+  manipulation.initializeLandmarksFromUnusedFeatureTracksOfOrderedVertices(
+      vertex_ids, &track_id_to_landmark_id_);
+}
+
+}  // namespace rovioli
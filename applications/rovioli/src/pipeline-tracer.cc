@@ -0,0 +1,185 @@
+#include "rovioli/pipeline-tracer.h"
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace rovioli {
+namespace {
+constexpr double kNanosecondsToMilliseconds = 1e-6;
+constexpr double kNanosecondsToMicroseconds = 1e-3;
+
+// Powers of two in milliseconds, the last bucket holds everything above.
+constexpr size_t kNumHistogramBuckets = 12u;
+constexpr size_t kMaxHistogramBarLength = 40u;
+
+void printStatistics(
+    const std::string& label, std::vector<double>* values_ms,
+    std::ostream* out) {
+  CHECK_NOTNULL(values_ms);
+  CHECK_NOTNULL(out);
+  CHECK(!values_ms->empty());
+  std::sort(values_ms->begin(), values_ms->end());
+  double sum = 0.0;
+  for (const double value : *values_ms) {
+    sum += value;
+  }
+  const auto percentile = [values_ms](const double fraction) {
+    const size_t index = std::min(
+        values_ms->size() - 1u,
+        static_cast<size_t>(fraction * values_ms->size()));
+    return (*values_ms)[index];
+  };
+  *out << "  " << label << " [ms]: mean " << sum / values_ms->size()
+       << ", p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+       << ", p99 " << percentile(0.99) << ", max " << values_ms->back()
+       << std::endl;
+
+  std::vector<size_t> bucket_counts(kNumHistogramBuckets, 0u);
+  for (const double value : *values_ms) {
+    size_t bucket = 0u;
+    double bucket_upper_bound_ms = 1.0;
+    while (bucket + 1u < kNumHistogramBuckets &&
+           value >= bucket_upper_bound_ms) {
+      ++bucket;
+      bucket_upper_bound_ms *= 2.0;
+    }
+    ++bucket_counts[bucket];
+  }
+  const size_t max_count =
+      *std::max_element(bucket_counts.begin(), bucket_counts.end());
+  double bucket_lower_bound_ms = 0.0;
+  double bucket_upper_bound_ms = 1.0;
+  for (size_t bucket = 0u; bucket < kNumHistogramBuckets; ++bucket) {
+    std::stringstream range;
+    if (bucket + 1u < kNumHistogramBuckets) {
+      range << "[" << bucket_lower_bound_ms << ", " << bucket_upper_bound_ms
+            << ")";
+    } else {
+      range << ">= " << bucket_lower_bound_ms;
+    }
+    if (bucket_counts[bucket] > 0u) {
+      const size_t bar_length =
+          (bucket_counts[bucket] * kMaxHistogramBarLength + max_count - 1u) /
+          max_count;
+      *out << "    " << std::setw(14) << std::left << range.str()
+           << std::right << std::setw(8) << bucket_counts[bucket] << " "
+           << std::string(bar_length, '#') << std::endl;
+    }
+    bucket_lower_bound_ms = bucket_upper_bound_ms;
+    bucket_upper_bound_ms *= 2.0;
+  }
+}
+}  // namespace
+
+void PipelineTracer::addStage(
+    const vio::PipelineTrace& trace, const vio::PipelineTraceStage& stage) {
+  const Record record{trace.id(), trace.captureTimestampNanoseconds(),
+                      trace.startNanoseconds(), stage};
+  std::lock_guard<std::mutex> lock(m_records_);
+  records_.push_back(record);
+}
+
+size_t PipelineTracer::getNumRecordedStages() const {
+  std::lock_guard<std::mutex> lock(m_records_);
+  return records_.size();
+}
+
+std::vector<std::string> PipelineTracer::getStageNames() const {
+  std::vector<std::string> stage_names;
+  for (const Record& record : records_) {
+    if (std::find(
+            stage_names.begin(), stage_names.end(), record.stage.name) ==
+        stage_names.end()) {
+      stage_names.emplace_back(record.stage.name);
+    }
+  }
+  return stage_names;
+}
+
+bool PipelineTracer::writeChromeTrace(const std::string& file_path) const {
+  CHECK(!file_path.empty());
+  std::ofstream output_file(file_path);
+  if (!output_file.is_open()) {
+    LOG(ERROR) << "Could not open " << file_path
+               << " to write the pipeline trace.";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_records_);
+  const std::vector<std::string> stage_names = getStageNames();
+  int64_t first_time_ns = std::numeric_limits<int64_t>::max();
+  for (const Record& record : records_) {
+    first_time_ns = std::min(first_time_ns, record.stage.enter_ns);
+  }
+
+  constexpr int kProcessId = 1;
+  output_file << std::fixed << std::setprecision(3);
+  output_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool is_first_event = true;
+  for (size_t stage_idx = 0u; stage_idx < stage_names.size(); ++stage_idx) {
+    output_file << (is_first_event ? "" : ",")
+                << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+                << kProcessId << ",\"tid\":" << stage_idx
+                << ",\"args\":{\"name\":\"" << stage_names[stage_idx]
+                << "\"}}";
+    is_first_event = false;
+  }
+  for (const Record& record : records_) {
+    const size_t stage_idx =
+        std::find(stage_names.begin(), stage_names.end(), record.stage.name) -
+        stage_names.begin();
+    output_file
+        << (is_first_event ? "" : ",") << "\n{\"name\":\"" << record.stage.name
+        << "\",\"cat\":\"rovioli\",\"ph\":\"X\",\"pid\":" << kProcessId
+        << ",\"tid\":" << stage_idx << ",\"ts\":"
+        << (record.stage.enter_ns - first_time_ns) * kNanosecondsToMicroseconds
+        << ",\"dur\":"
+        << (record.stage.exit_ns - record.stage.enter_ns) *
+               kNanosecondsToMicroseconds
+        << ",\"args\":{\"frame\":" << record.trace_id
+        << ",\"capture_timestamp_ns\":" << record.capture_timestamp_ns
+        << ",\"latency_ms\":"
+        << (record.stage.exit_ns - record.start_ns) *
+               kNanosecondsToMilliseconds
+        << "}}";
+    is_first_event = false;
+  }
+  output_file << "\n]}\n";
+  return true;
+}
+
+std::string PipelineTracer::printSummary() const {
+  std::lock_guard<std::mutex> lock(m_records_);
+  std::stringstream summary;
+  summary << std::fixed << std::setprecision(2);
+  summary << "Pipeline latency of " << records_.size() << " recorded stages:"
+          << std::endl;
+  for (const std::string& stage_name : getStageNames()) {
+    std::vector<double> durations_ms;
+    std::vector<double> latencies_ms;
+    for (const Record& record : records_) {
+      if (stage_name == record.stage.name) {
+        durations_ms.push_back(
+            (record.stage.exit_ns - record.stage.enter_ns) *
+            kNanosecondsToMilliseconds);
+        latencies_ms.push_back(
+            (record.stage.exit_ns - record.start_ns) *
+            kNanosecondsToMilliseconds);
+      }
+    }
+    summary << stage_name << " (" << durations_ms.size() << " nframes)"
+            << std::endl;
+    printStatistics("duration", &durations_ms, &summary);
+    printStatistics("latency at exit", &latencies_ms, &summary);
+  }
+  return summary.str();
+}
+
+}  // namespace rovioli
@@ -0,0 +1,79 @@
+#include "rovioli/ros-helpers.h"
+
+#include <memory>
+#include <string>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "rovioli/image-buffer-pool.h"
+
+DEFINE_bool(
+    rovioli_zero_copy_ros_images, true,
+    "If true, MONO8 images are used directly from the ROS message memory, "
+    "which is kept alive as long as the image is used.");
+
+namespace rovioli {
+
+vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
+    const sensor_msgs::ImageConstPtr& image_message, size_t camera_idx) {
+  CHECK(image_message);
+  const std::string& encoding = image_message->encoding;
+  const int rows = image_message->height;
+  const int cols = image_message->width;
+
+  vio::ImageMeasurement::Ptr image_measurement(new vio::ImageMeasurement);
+  if (FLAGS_rovioli_zero_copy_ros_images &&
+      encoding == sensor_msgs::image_encodings::MONO8 && rows > 0 &&
+      cols > 0) {
+    // The deleter holds a reference to the message, so the cv::Mat keeps the
+    // message alive without any downstream code depending on ROS or boost.
+    const sensor_msgs::ImageConstPtr message = image_message;
+    const std::shared_ptr<const void> owner(
+        message.get(), [message](const void* /*message*/) {});
+    image_measurement->image = wrapExternalImageData(
+        rows, cols, CV_8UC1, const_cast<uint8_t*>(message->data.data()),
+        message->step, owner);
+  } else {
+    cv_bridge::CvImageConstPtr cv_ptr;
+    try {
+      // Shares the message memory, the conversion writes into the pool buffer.
+      cv_ptr = cv_bridge::toCvShare(image_message);
+    } catch (const cv_bridge::Exception& e) {  // NOLINT
+      LOG(FATAL) << "cv_bridge exception: " << e.what();
+    }
+    CHECK(cv_ptr);
+
+    cv::Mat image = ImageBufferPool::instance().acquire(rows, cols, CV_8UC1);
+    if (encoding == sensor_msgs::image_encodings::MONO8) {
+      cv_ptr->image.copyTo(image);
+    } else if (encoding == sensor_msgs::image_encodings::BGR8) {
+      cv::cvtColor(cv_ptr->image, image, cv::COLOR_BGR2GRAY);
+    } else if (encoding == sensor_msgs::image_encodings::RGB8) {
+      cv::cvtColor(cv_ptr->image, image, cv::COLOR_RGB2GRAY);
+    } else if (encoding == sensor_msgs::image_encodings::BGRA8) {
+      cv::cvtColor(cv_ptr->image, image, cv::COLOR_BGRA2GRAY);
+    } else if (encoding == sensor_msgs::image_encodings::RGBA8) {
+      cv::cvtColor(cv_ptr->image, image, cv::COLOR_RGBA2GRAY);
+    } else {
+      // Any other encoding goes through cv_bridge, e.g. bit depth conversions.
+      cv_bridge::CvImageConstPtr mono_ptr;
+      try {
+        mono_ptr = cv_bridge::toCvShare(
+            image_message, sensor_msgs::image_encodings::MONO8);
+      } catch (const cv_bridge::Exception& e) {  // NOLINT
+        LOG(FATAL) << "cv_bridge exception: " << e.what();
+      }
+      CHECK(mono_ptr);
+      mono_ptr->image.copyTo(image);
+    }
+    image_measurement->image = image;
+  }
+  image_measurement->timestamp =
+      rosTimeToNanoseconds(image_message->header.stamp);
+  image_measurement->camera_index = camera_idx;
+  return image_measurement;
+}
+
+}  // namespace rovioli
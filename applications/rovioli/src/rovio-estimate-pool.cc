@@ -0,0 +1,76 @@
+#include "rovioli/rovio-estimate-pool.h"
+
+#include <glog/logging.h>
+
+namespace rovioli {
+
+// Shared with the deleters of the acquired estimates, such that they can be
+// released after the pool is gone.
+class RovioEstimatePool::FreeList {
+ public:
+  explicit FreeList(const size_t max_num_free_estimates)
+      : max_num_free_estimates_(max_num_free_estimates) {
+    free_estimates_.reserve(max_num_free_estimates_);
+  }
+
+  ~FreeList() {
+    for (RovioEstimate* estimate : free_estimates_) {
+      delete estimate;
+    }
+  }
+
+  RovioEstimate* pop() {
+    std::lock_guard<std::mutex> lock(m_free_estimates_);
+    if (free_estimates_.empty()) {
+      return nullptr;
+    }
+    RovioEstimate* estimate = free_estimates_.back();
+    free_estimates_.pop_back();
+    return estimate;
+  }
+
+  void push(RovioEstimate* estimate) {
+    CHECK_NOTNULL(estimate);
+    // Released outside of the lock, the trace may be the last reference to
+    // its stages.
+    estimate->trace.reset();
+    {
+      std::lock_guard<std::mutex> lock(m_free_estimates_);
+      if (free_estimates_.size() < max_num_free_estimates_) {
+        free_estimates_.emplace_back(estimate);
+        return;
+      }
+    }
+    delete estimate;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(m_free_estimates_);
+    return free_estimates_.size();
+  }
+
+ private:
+  const size_t max_num_free_estimates_;
+  mutable std::mutex m_free_estimates_;
+  std::vector<RovioEstimate*> free_estimates_;
+};
+
+RovioEstimatePool::RovioEstimatePool(const size_t max_num_free_estimates)
+    : free_list_(std::make_shared<FreeList>(max_num_free_estimates)) {}
+
+RovioEstimate::Ptr RovioEstimatePool::acquire() {
+  RovioEstimate* estimate = free_list_->pop();
+  if (estimate == nullptr) {
+    estimate = new RovioEstimate;
+  }
+  const std::shared_ptr<FreeList> free_list = free_list_;
+  return RovioEstimate::Ptr(estimate, [free_list](RovioEstimate* released) {
+    free_list->push(released);
+  });
+}
+
+size_t RovioEstimatePool::getNumFreeEstimates() const {
+  return free_list_->size();
+}
+
+}  // namespace rovioli
@@ -1,5 +1,6 @@
 #include "rovioli/rovio-flow.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,8 +11,10 @@
 #include <aslam/common/time.h>
 #include <gflags/gflags.h>
 #include <maplab-common/string-tools.h>
+#include <maplab-common/thread-topology.h>
 #include <maplab-common/unique-id.h>
 #include <message-flow/message-flow.h>
+#include <vio-common/pipeline-trace.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/flow-topics.h"
@@ -25,9 +28,22 @@ DEFINE_bool(
 DEFINE_string(
     rovio_active_camera_indices, "0",
     "Comma separated indices of cameras to use for motion tracking.");
+DEFINE_bool(
+    rovio_estimate_copy_full_covariance, false,
+    "Copy the full filter covariance into the ROVIO estimates, in addition to "
+    "the pose and IMU bias blocks.");
+DEFINE_int32(
+    rovioli_rovio_estimate_pool_max_free_estimates, 256,
+    "Maximum number of released ROVIO estimates that are kept for reuse.");
 
 namespace rovioli {
 namespace {
+// Offsets of the IMU states in the ROVIO filter covariance.
+constexpr int kRovioPositionIndex = 0;
+constexpr int kRovioAccBiasIndex = 6;
+constexpr int kRovioGyroBiasIndex = 9;
+constexpr int kRovioOrientationIndex = 12;
+
 void ensurePositiveQuaternion(aslam::Quaternion* quat) {
   CHECK_NOTNULL(quat);
   if (quat->toImplementation().w() < 0.0) {
@@ -38,7 +54,12 @@ void ensurePositiveQuaternion(aslam::Quaternion* quat) {
 
 RovioFlow::RovioFlow(
     const aslam::NCamera& camera_calibration,
-    const vi_map::ImuSigmas& imu_sigmas) {
+    const vi_map::ImuSigmas& imu_sigmas)
+    : estimate_pool_(static_cast<size_t>(
+          std::max(FLAGS_rovioli_rovio_estimate_pool_max_free_estimates, 0))),
+      measurement_completion_(nullptr),
+      pipeline_tracing_enabled_(false),
+      image_update_start_ns_(-1) {
   // Multi-camera support in ROVIO is still experimental. Therefore, only a
   // single camera will be used for motion tracking per default.
   const size_t num_cameras = camera_calibration.getNumCameras();
@@ -99,13 +120,29 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   // delivery ordering for all messages (cam, imu, localization) are
   // corresponding to the publishing order and no sensor can be left behind.
   message_flow::DeliveryOptions rovio_subscriber_options;
+  rovio_subscriber_options.priority =
+      message_flow::DeliveryPriority::kRealTime;
   rovio_subscriber_options.exclusivity_group_id =
       kExclusivityGroupIdRovioSensorSubscribers;
 
+  if (measurement_completion_ != nullptr) {
+    measurement_completion_
+        ->registerConsumer<message_flow_topics::IMU_MEASUREMENTS>();
+    measurement_completion_
+        ->registerConsumer<message_flow_topics::IMAGE_MEASUREMENTS>();
+  }
+
+  // The sensor subscribers run on the dispatcher threads, they are pinned to
+  // the estimator CPUs of --maplab_stage_cpus while processing.
+  const common::CpuList estimator_cpus =
+      common::ThreadTopology::instance().getStageCpus("estimator");
+
   // Input IMU.
   flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
       kSubscriberNodeName, rovio_subscriber_options,
-      [this](const vio::ImuMeasurement::ConstPtr& imu) {
+      [this, estimator_cpus](const vio::ImuMeasurement::ConstPtr& imu) {
+        ScopedMeasurementCompletion completion(measurement_completion_);
+        common::ScopedThreadAffinity pinning(estimator_cpus);
         // Do not apply the predictions but only queue them. They will be
         // applied before the next update.
         const bool measurement_accepted =
@@ -120,7 +157,8 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
   // Input camera.
   flow->registerSubscriber<message_flow_topics::IMAGE_MEASUREMENTS>(
       kSubscriberNodeName, rovio_subscriber_options,
-      [this](const vio::ImageMeasurement::ConstPtr& image) {
+      [this, estimator_cpus](const vio::ImageMeasurement::ConstPtr& image) {
+        ScopedMeasurementCompletion completion(measurement_completion_);
         const size_t cam_idx = image->camera_index;
         CHECK_LT(cam_idx, is_camera_idx_active_in_motion_tracking_.size());
         if (is_camera_idx_active_in_motion_tracking_[cam_idx] == false) {
@@ -128,10 +166,15 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           return;
         }
 
+        common::ScopedThreadAffinity pinning(estimator_cpus);
+        if (pipeline_tracing_enabled_) {
+          image_update_start_ns_ = vio::PipelineTrace::nowNanoseconds();
+        }
         const bool measurement_accepted =
             this->rovio_interface_->processImageUpdate(
                 image->camera_index, image->image,
                 aslam::time::to_seconds(image->timestamp));
+        image_update_start_ns_ = -1;
         LOG_IF(
             WARNING, !measurement_accepted && rovio_interface_->isInitialized())
             << "ROVIO rejected image measurement. Latency is too large.";
@@ -160,8 +203,15 @@ void RovioFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
       });
 
   // Output ROVIO estimates.
+  // The estimates are published while processing the sensor measurements.
   publish_rovio_estimates_ =
       flow->registerPublisher<message_flow_topics::ROVIO_ESTIMATES>();
+  if (measurement_completion_ != nullptr) {
+    publish_rovio_estimates_ =
+        measurement_completion_
+            ->wrapPublisher<message_flow_topics::ROVIO_ESTIMATES>(
+                publish_rovio_estimates_);
+  }
   CHECK(rovio_interface_);
   rovio_interface_->registerStateUpdateCallback(
       std::bind(&RovioFlow::processRovioUpdate, this, std::placeholders::_1));
@@ -185,7 +235,7 @@ void RovioFlow::processRovioUpdate(const rovio::RovioState& state) {
   ensurePositiveQuaternion(&T_M_I.getRotation());
   const Eigen::Vector3d v_M = T_M_I.getRotation().rotate(state.get_BvB());
 
-  RovioEstimate::Ptr rovio_estimate(new RovioEstimate);
+  RovioEstimate::Ptr rovio_estimate = estimate_pool_.acquire();
   // VIO states.
   rovio_estimate->timestamp_s = state.getTimestamp();
   rovio_estimate->vinode.set_T_M_I(T_M_I);
@@ -193,6 +243,31 @@ void RovioFlow::processRovioUpdate(const rovio::RovioState& state) {
   rovio_estimate->vinode.setAccBias(state.getAcb());
   rovio_estimate->vinode.setGyroBias(state.getGyb());
 
+  // Only the blocks of the IMU states are copied, the full covariance also
+  // spans the camera extrinsics and features.
+  const Eigen::MatrixXd& filter_covariance = state.getFilterCovariance();
+  CHECK_GE(filter_covariance.rows(), kRovioOrientationIndex + 3);
+  rovio_estimate->p_M_I_covariance = filter_covariance.block<3, 3>(
+      kRovioPositionIndex, kRovioPositionIndex);
+  Eigen::Matrix<double, 6, 6>& pose_covariance =
+      rovio_estimate->pose_covariance;
+  pose_covariance.topLeftCorner<3, 3>() = rovio_estimate->p_M_I_covariance;
+  pose_covariance.topRightCorner<3, 3>() = filter_covariance.block<3, 3>(
+      kRovioPositionIndex, kRovioOrientationIndex);
+  pose_covariance.bottomLeftCorner<3, 3>() =
+      pose_covariance.topRightCorner<3, 3>().transpose();
+  pose_covariance.bottomRightCorner<3, 3>() = filter_covariance.block<3, 3>(
+      kRovioOrientationIndex, kRovioOrientationIndex);
+  static_assert(
+      kRovioGyroBiasIndex == kRovioAccBiasIndex + 3,
+      "The bias block has to be contiguous.");
+  rovio_estimate->imu_bias_covariance = filter_covariance.block<6, 6>(
+      kRovioAccBiasIndex, kRovioAccBiasIndex);
+  if (FLAGS_rovio_estimate_copy_full_covariance) {
+    // Reuses the memory of the pooled estimate if the size didn't change.
+    rovio_estimate->filter_covariance = filter_covariance;
+  }
+
   // Optional localization state.
   rovio_estimate->has_T_G_M = state.getHasInertialPose();
   if (state.getHasInertialPose()) {
@@ -201,6 +276,15 @@ void RovioFlow::processRovioUpdate(const rovio::RovioState& state) {
     ensurePositiveQuaternion(&T_G_M.getRotation());
     rovio_estimate->T_G_M = T_G_M;
   }
+
+  // Only estimates resulting from an image update are traced.
+  if (pipeline_tracing_enabled_ && image_update_start_ns_ >= 0) {
+    rovio_estimate->trace = std::make_shared<vio::PipelineTrace>(
+        aslam::time::secondsToNanoSeconds(rovio_estimate->timestamp_s),
+        image_update_start_ns_, nullptr);
+    rovio_estimate->trace->addStage(
+        "rovio", image_update_start_ns_, vio::PipelineTrace::nowNanoseconds());
+  }
   publish_rovio_estimates_(rovio_estimate);
 }
 }  // namespace rovioli
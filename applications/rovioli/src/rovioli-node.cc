@@ -1,8 +1,14 @@
 #include "rovioli/rovioli-node.h"
 
+#include <chrono>
+#include <fstream>  // NOLINT
+#include <future>
+#include <sstream>
 #include <string>
 
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/statistics/statistics.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <message-flow/message-flow.h>
 #include <message-flow/message-topic-registration.h>
@@ -12,6 +18,7 @@
 #include "rovioli/feature-tracking-flow.h"
 #include "rovioli/imu-camera-synchronizer-flow.h"
 #include "rovioli/localizer-flow.h"
+#include "rovioli/pipeline-tracer.h"
 #include "rovioli/rovio-flow.h"
 #include "rovioli/synced-nframe-throttler-flow.h"
 
@@ -19,6 +26,25 @@ DEFINE_bool(
     rovioli_run_map_builder, true,
     "When set to false, the map builder will be deactivated and no map will be "
     "built. Rovio+Localization will still run as usual.");
+DEFINE_double(
+    rovioli_message_flow_statistics_export_period_s, 0.0,
+    "If larger than zero, the message flow delivery statistics (latency, "
+    "callback time and queue depth per topic and subscriber) are collected "
+    "and exported with this period.");
+DEFINE_string(
+    rovioli_message_flow_statistics_file, "",
+    "If set, the periodic message flow statistics are written to this file "
+    "instead of the log.");
+
+DEFINE_string(
+    rovioli_pipeline_trace_file, "",
+    "If set, the latency of every nframe through the synchronizer, tracking, "
+    "ROVIO, localization, the VIO update builder and the map builder is "
+    "traced. The trace is written to this file in the Chrome trace event "
+    "format and summarized in the log at shutdown.");
+
+DECLARE_bool(message_flow_collect_statistics);
+DECLARE_bool(vio_sensor_log_deterministic);
 
 namespace rovioli {
 RovioliNode::RovioliNode(
@@ -28,55 +54,145 @@ RovioliNode::RovioliNode(
     const std::string& save_map_folder,
     const summary_map::LocalizationSummaryMap* const localization_map,
     message_flow::MessageFlow* flow)
-    : is_datasource_exhausted_(false) {
+    : flow_(CHECK_NOTNULL(flow)),
+      is_datasource_exhausted_(false),
+      statistics_export_shutdown_requested_(false) {
   // localization_summary_map is optional and can be a nullptr.
+  initialize(
+      camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+      save_map_folder, [localization_map]() -> LocalizerFlow* {
+        if (localization_map == nullptr) {
+          return nullptr;
+        }
+        constexpr bool kVisualizeLocalization = true;
+        return new LocalizerFlow(*localization_map, kVisualizeLocalization);
+      });
+}
+
+RovioliNode::RovioliNode(
+    const aslam::NCamera::Ptr& camera_system,
+    vi_map::Imu::UniquePtr maplab_imu_sensor,
+    const vi_map::ImuSigmas& rovio_imu_sigmas,
+    const std::string& save_map_folder,
+    TiledLocalizationMap* const tiled_localization_map,
+    message_flow::MessageFlow* flow)
+    : flow_(CHECK_NOTNULL(flow)),
+      is_datasource_exhausted_(false),
+      statistics_export_shutdown_requested_(false) {
+  CHECK_NOTNULL(tiled_localization_map);
+  initialize(
+      camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+      save_map_folder, [tiled_localization_map]() {
+        return new LocalizerFlow(tiled_localization_map);
+      });
+}
+
+RovioliNode::RovioliNode(
+    const aslam::NCamera::Ptr& camera_system,
+    vi_map::Imu::UniquePtr maplab_imu_sensor,
+    const vi_map::ImuSigmas& rovio_imu_sigmas,
+    const std::string& save_map_folder,
+    const LocalizerFlow::LocalizationMapLoader& load_localization_map,
+    message_flow::MessageFlow* flow)
+    : flow_(CHECK_NOTNULL(flow)),
+      is_datasource_exhausted_(false),
+      statistics_export_shutdown_requested_(false) {
+  CHECK(load_localization_map);
+  initialize(
+      camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
+      save_map_folder, [load_localization_map]() {
+        constexpr bool kVisualizeLocalization = true;
+        return new LocalizerFlow(load_localization_map, kVisualizeLocalization);
+      });
+}
+
+void RovioliNode::initialize(
+    const aslam::NCamera::Ptr& camera_system,
+    vi_map::Imu::UniquePtr maplab_imu_sensor,
+    const vi_map::ImuSigmas& rovio_imu_sigmas,
+    const std::string& save_map_folder,
+    const LocalizerFlowFactory& create_localizer_flow) {
   CHECK(camera_system);
   CHECK(maplab_imu_sensor);
-  CHECK_NOTNULL(flow);
+
+  // The statistics collection has to be enabled before the subscribers are
+  // registered.
+  if (FLAGS_rovioli_message_flow_statistics_export_period_s > 0.0) {
+    FLAGS_message_flow_collect_statistics = true;
+  }
+  if (!FLAGS_rovioli_pipeline_trace_file.empty()) {
+    pipeline_tracer_ = aligned_unique<PipelineTracer>();
+  }
+
+  // Setting up ROVIO takes a while, so it is constructed while the other
+  // flows are set up. The flows are attached in a fixed order afterwards.
+  std::future<RovioFlow*> rovio_flow_future = std::async(
+      std::launch::async, [&camera_system, &rovio_imu_sigmas]() {
+        return new RovioFlow(*camera_system, rovio_imu_sigmas);
+      });
 
   // TODO(schneith): At the moment we need to provide two noise sigmas; one for
   // maplab and one for ROVIO. Unify this.
   datasource_flow_.reset(
       new DataSourceFlow(*camera_system, *maplab_imu_sensor));
-  datasource_flow_->attachToMessageFlow(flow);
 
-  rovio_flow_.reset(new RovioFlow(*camera_system, rovio_imu_sigmas));
-  rovio_flow_->attachToMessageFlow(flow);
-
-  const bool localization_enabled = localization_map != nullptr;
+  localizer_flow_.reset(create_localizer_flow());
+  const bool localization_enabled = localizer_flow_ != nullptr;
   if (FLAGS_rovioli_run_map_builder || localization_enabled) {
     // If there's no localization and no map should be built, no maplab feature
     // tracking is needed.
-    if (localization_enabled) {
-      constexpr bool kVisualizeLocalization = true;
-      localizer_flow_.reset(
-          new LocalizerFlow(*localization_map, kVisualizeLocalization));
-      localizer_flow_->attachToMessageFlow(flow);
-    }
-
-    // Launch the synchronizer after the localizer because creating the
-    // localization database can take some time. This can cause the
-    // synchronizer's detection of missing image or IMU measurements to fire
-    // early.
     synchronizer_flow_.reset(new ImuCameraSynchronizerFlow(camera_system));
-    synchronizer_flow_->attachToMessageFlow(flow);
-
+    if (pipeline_tracer_) {
+      synchronizer_flow_->setPipelineTraceSink(pipeline_tracer_.get());
+    }
     tracker_flow_.reset(
         new FeatureTrackingFlow(camera_system, *maplab_imu_sensor));
-    tracker_flow_->attachToMessageFlow(flow);
-
     throttler_flow_.reset(new SyncedNFrameThrottlerFlow);
-    throttler_flow_->attachToMessageFlow(flow);
   }
 
   data_publisher_flow_.reset(new DataPublisherFlow);
-  data_publisher_flow_->attachToMessageFlow(flow);
 
   if (FLAGS_rovioli_run_map_builder) {
     map_builder_flow_.reset(
         new MapBuilderFlow(
             camera_system, std::move(maplab_imu_sensor), save_map_folder));
-    map_builder_flow_->attachToMessageFlow(flow);
+  }
+
+  rovio_flow_.reset(rovio_flow_future.get());
+  if (pipeline_tracer_) {
+    rovio_flow_->enablePipelineTracing();
+  }
+
+  // The deterministic playback waits until the synchronizer, the tracker and
+  // ROVIO have processed a measurement before it publishes the next one.
+  if (FLAGS_vio_sensor_log_deterministic) {
+    measurement_completion_.reset(new MeasurementCompletion);
+    datasource_flow_->setMeasurementCompletion(measurement_completion_.get());
+    rovio_flow_->setMeasurementCompletion(measurement_completion_.get());
+    if (synchronizer_flow_) {
+      synchronizer_flow_->setMeasurementCompletion(
+          measurement_completion_.get());
+      tracker_flow_->setMeasurementCompletion(measurement_completion_.get());
+    }
+  }
+
+  datasource_flow_->attachToMessageFlow(flow_);
+  rovio_flow_->attachToMessageFlow(flow_);
+  if (localizer_flow_) {
+    localizer_flow_->attachToMessageFlow(flow_);
+  }
+  // Attached after the localizer, because creating a synchronous
+  // localization database can take some time. This can cause the
+  // synchronizer's detection of missing image or IMU measurements to fire
+  // early.
+  if (synchronizer_flow_) {
+    synchronizer_flow_->attachToMessageFlow(flow_);
+    tracker_flow_->attachToMessageFlow(flow_);
+    throttler_flow_->attachToMessageFlow(flow_);
+  }
+  data_publisher_flow_->attachToMessageFlow(flow_);
+  if (map_builder_flow_) {
+    map_builder_flow_->attachToMessageFlow(flow_);
   }
 
   // Subscribe to end of days signal from the datasource.
@@ -86,6 +202,8 @@ RovioliNode::RovioliNode(
 
 RovioliNode::~RovioliNode() {
   shutdown();
+  // The pipeline has been drained by now, so all stages are recorded.
+  exportPipelineTrace();
 }
 
 void RovioliNode::saveMapAndOptionallyOptimize(
@@ -103,11 +221,79 @@ void RovioliNode::start() {
       << "end-of-days signal was received!";
   datasource_flow_->startStreaming();
   VLOG(1) << "Starting data source...";
+
+  if (FLAGS_rovioli_message_flow_statistics_export_period_s > 0.0 &&
+      !statistics_export_thread_.joinable()) {
+    statistics_export_thread_ =
+        std::thread(&RovioliNode::messageFlowStatisticsExportLoop, this);
+  }
 }
 
 void RovioliNode::shutdown() {
   datasource_flow_->shutdown();
   VLOG(1) << "Closing data source...";
+
+  if (localizer_flow_) {
+    // The localization workers publish outside of the message flow.
+    localizer_flow_->shutdown();
+  }
+
+  if (statistics_export_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_statistics_export_);
+      statistics_export_shutdown_requested_ = true;
+    }
+    cv_statistics_export_.notify_all();
+    statistics_export_thread_.join();
+    // Export the final state.
+    exportMessageFlowStatistics();
+  }
+}
+
+void RovioliNode::messageFlowStatisticsExportLoop() {
+  const std::chrono::milliseconds export_period(
+      static_cast<int64_t>(
+          FLAGS_rovioli_message_flow_statistics_export_period_s * 1e3));
+  std::unique_lock<std::mutex> lock(m_statistics_export_);
+  while (true) {
+    const bool shutdown_requested = cv_statistics_export_.wait_for(
+        lock, export_period,
+        [this]() { return statistics_export_shutdown_requested_; });
+    if (shutdown_requested) {
+      break;
+    }
+    exportMessageFlowStatistics();
+  }
+}
+
+void RovioliNode::exportMessageFlowStatistics() const {
+  std::stringstream statistics;
+  statistics << flow_->printDeliveryQueueStatistics() << std::endl;
+  statistics::Statistics::Print(statistics);
+
+  if (FLAGS_rovioli_message_flow_statistics_file.empty()) {
+    LOG(INFO) << "Message flow statistics:\n" << statistics.str();
+    return;
+  }
+  std::ofstream output_file(FLAGS_rovioli_message_flow_statistics_file);
+  if (!output_file.is_open()) {
+    LOG(ERROR) << "Could not open "
+               << FLAGS_rovioli_message_flow_statistics_file
+               << " to export the message flow statistics.";
+    return;
+  }
+  output_file << statistics.str();
+}
+
+void RovioliNode::exportPipelineTrace() const {
+  if (!pipeline_tracer_) {
+    return;
+  }
+  LOG(INFO) << pipeline_tracer_->printSummary();
+  if (pipeline_tracer_->writeChromeTrace(FLAGS_rovioli_pipeline_trace_file)) {
+    LOG(INFO) << "Wrote the pipeline trace to "
+              << FLAGS_rovioli_pipeline_trace_file << ".";
+  }
 }
 
 std::atomic<bool>& RovioliNode::isDataSourceExhausted() {
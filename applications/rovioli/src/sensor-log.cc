@@ -0,0 +1,441 @@
+#include "rovioli/sensor-log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "rovioli/image-buffer-pool.h"
+
+DEFINE_double(
+    sensor_log_reorder_window_s, 0.5,
+    "Measurements that arrive up to this duration after newer measurements are "
+    "still written in time order to the sensor log.");
+DEFINE_uint64(
+    sensor_log_chunk_size_kb, 8u * 1024u,
+    "Approximate size of the chunks of the sensor log.");
+DEFINE_int32(
+    sensor_log_png_compression, 1,
+    "PNG compression level [0, 9] of the images in the sensor log.");
+
+namespace rovioli {
+namespace sensor_log {
+namespace {
+constexpr char kFileMagic[8] = {'M', 'L', 'S', 'L', 'O', 'G', '0', '1'};
+constexpr char kIndexMagic[8] = {'M', 'L', 'S', 'L', 'O', 'G', 'I', 'X'};
+constexpr size_t kImuPayloadNumBytes = 6u * sizeof(double);
+
+// The structs are written as they are, without padding.
+static_assert(sizeof(RecordHeader) == 24u, "Unexpected padding.");
+static_assert(sizeof(ImageInfo) == 16u, "Unexpected padding.");
+static_assert(sizeof(ChunkInfo) == 40u, "Unexpected padding.");
+static_assert(sizeof(Trailer) == 24u, "Unexpected padding.");
+
+inline bool isLittleEndianHost() {
+  const uint16_t value = 1u;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &value, sizeof(first_byte));
+  return first_byte == 1u;
+}
+}  // namespace
+
+vio::ImuMeasurement::Ptr decodeImu(const Record& record) {
+  CHECK(record.header.type == RecordType::kImu);
+  CHECK_EQ(record.header.payload_num_bytes, kImuPayloadNumBytes);
+  CHECK_NOTNULL(record.payload);
+  vio::ImuMeasurement::Ptr imu(new vio::ImuMeasurement);
+  imu->timestamp = record.header.timestamp_ns;
+  std::memcpy(imu->imu_data.data(), record.payload, kImuPayloadNumBytes);
+  return imu;
+}
+
+vio::ImageMeasurement::Ptr decodeImage(const Record& record) {
+  CHECK(record.header.type == RecordType::kImage);
+  CHECK_GT(record.header.payload_num_bytes, sizeof(ImageInfo));
+  CHECK_NOTNULL(record.payload);
+  ImageInfo info;
+  std::memcpy(&info, record.payload, sizeof(info));
+
+  vio::ImageMeasurement::Ptr image(new vio::ImageMeasurement);
+  image->timestamp = record.header.timestamp_ns;
+  image->camera_index = record.header.camera_index;
+  // Decode into a pooled buffer, imdecode keeps it as it has the right size
+  // and type.
+  image->image = ImageBufferPool::instance().acquire(
+      info.rows, info.cols, info.type);
+  const cv::Mat encoded_image(
+      1, record.header.payload_num_bytes - sizeof(ImageInfo), CV_8UC1,
+      const_cast<char*>(record.payload + sizeof(ImageInfo)));
+  cv::imdecode(encoded_image, cv::IMREAD_UNCHANGED, &image->image);
+  CHECK_EQ(image->image.rows, info.rows);
+  CHECK_EQ(image->image.cols, info.cols);
+  CHECK_EQ(image->image.type(), info.type);
+  return image;
+}
+
+}  // namespace sensor_log
+
+SensorLogWriter::SensorLogWriter(
+    const std::string& file_path, const size_t max_num_pending_measurements)
+    : file_path_(file_path),
+      max_num_pending_measurements_(max_num_pending_measurements),
+      file_offset_(0u),
+      is_closed_(false),
+      num_buffered_bytes_(0u),
+      newest_timestamp_ns_(std::numeric_limits<int64_t>::min()),
+      last_written_timestamp_ns_(std::numeric_limits<int64_t>::min()),
+      num_dropped_measurements_(0u) {
+  CHECK(!file_path_.empty());
+  CHECK(sensor_log::isLittleEndianHost())
+      << "Only little endian hosts are supported.";
+  CHECK_GE(FLAGS_sensor_log_reorder_window_s, 0.0);
+  CHECK_GT(FLAGS_sensor_log_chunk_size_kb, 0u);
+  file_.open(file_path_, std::ios::binary | std::ios::trunc);
+  CHECK(file_.is_open()) << "Could not open the sensor log " << file_path_
+                         << " for writing.";
+  file_.write(sensor_log::kFileMagic, sizeof(sensor_log::kFileMagic));
+  file_offset_ = sizeof(sensor_log::kFileMagic);
+  writer_thread_ = std::thread(&SensorLogWriter::writerWorker, this);
+}
+
+SensorLogWriter::~SensorLogWriter() {
+  close();
+}
+
+void SensorLogWriter::addImu(const vio::ImuMeasurement::ConstPtr& imu) {
+  CHECK(imu);
+  CHECK(!is_closed_);
+  Measurement measurement;
+  measurement.imu = imu;
+  pushMeasurement(measurement);
+}
+
+void SensorLogWriter::addImage(const vio::ImageMeasurement::ConstPtr& image) {
+  CHECK(image);
+  CHECK(!is_closed_);
+  Measurement measurement;
+  measurement.image = image;
+  pushMeasurement(measurement);
+}
+
+void SensorLogWriter::pushMeasurement(const Measurement& measurement) {
+  if (max_num_pending_measurements_ > 0u) {
+    measurements_.PushBlockingIfFull(
+        measurement, max_num_pending_measurements_);
+  } else {
+    measurements_.Push(measurement);
+  }
+}
+
+void SensorLogWriter::close() {
+  if (is_closed_.exchange(true)) {
+    return;
+  }
+  // An empty measurement marks the end of the log.
+  pushMeasurement(Measurement());
+  writer_thread_.join();
+
+  writeChunks(std::numeric_limits<int64_t>::max(), true);
+  writeIndex();
+  file_.close();
+  LOG_IF(ERROR, file_.fail()) << "Writing the sensor log " << file_path_
+                              << " failed.";
+  LOG(INFO) << "Wrote " << chunks_.size() << " chunks to the sensor log "
+            << file_path_ << '.';
+  LOG_IF(WARNING, num_dropped_measurements_ > 0u)
+      << "Dropped " << num_dropped_measurements_ << " measurements that "
+      << "arrived later than --sensor_log_reorder_window_s.";
+}
+
+void SensorLogWriter::writerWorker() {
+  Measurement measurement;
+  while (measurements_.PopBlocking(&measurement)) {
+    if (!measurement.imu && !measurement.image) {
+      return;
+    }
+    encodeAndBuffer(measurement);
+  }
+}
+
+void SensorLogWriter::encodeAndBuffer(const Measurement& measurement) {
+  EncodedRecord record;
+  std::memset(&record.header, 0, sizeof(record.header));
+  if (measurement.imu) {
+    record.header.timestamp_ns = measurement.imu->timestamp;
+    record.header.type = sensor_log::RecordType::kImu;
+    record.payload.resize(sensor_log::kImuPayloadNumBytes);
+    std::memcpy(
+        record.payload.data(), measurement.imu->imu_data.data(),
+        sensor_log::kImuPayloadNumBytes);
+  } else {
+    CHECK(measurement.image);
+    record.header.timestamp_ns = measurement.image->timestamp;
+    record.header.type = sensor_log::RecordType::kImage;
+    record.header.camera_index = measurement.image->camera_index;
+  }
+
+  if (record.header.timestamp_ns < last_written_timestamp_ns_) {
+    ++num_dropped_measurements_;
+    LOG_EVERY_N(WARNING, 100)
+        << "Dropping a measurement that is older than the written part of the "
+        << "sensor log.";
+    return;
+  }
+
+  if (measurement.image) {
+    const cv::Mat& image = measurement.image->image;
+    sensor_log::ImageInfo info;
+    info.rows = image.rows;
+    info.cols = image.cols;
+    info.type = image.type();
+    info.reserved = 0;
+    std::vector<uchar> encoded_image;
+    CHECK(
+        cv::imencode(
+            ".png", image, encoded_image,
+            {cv::IMWRITE_PNG_COMPRESSION, FLAGS_sensor_log_png_compression}));
+    record.payload.resize(sizeof(info) + encoded_image.size());
+    std::memcpy(record.payload.data(), &info, sizeof(info));
+    std::memcpy(
+        record.payload.data() + sizeof(info), encoded_image.data(),
+        encoded_image.size());
+  }
+  record.header.payload_num_bytes = record.payload.size();
+
+  const int64_t timestamp_ns = record.header.timestamp_ns;
+  num_buffered_bytes_ += sizeof(record.header) + record.payload.size();
+  buffered_records_.emplace(timestamp_ns, std::move(record));
+  newest_timestamp_ns_ = std::max(newest_timestamp_ns_, timestamp_ns);
+
+  if (num_buffered_bytes_ >= 1024u * FLAGS_sensor_log_chunk_size_kb) {
+    writeChunks(
+        newest_timestamp_ns_ -
+            aslam::time::seconds(FLAGS_sensor_log_reorder_window_s),
+        false);
+  }
+}
+
+void SensorLogWriter::writeChunks(
+    const int64_t max_timestamp_ns, const bool write_partial_chunk) {
+  const uint64_t chunk_num_bytes = 1024u * FLAGS_sensor_log_chunk_size_kb;
+  while (!buffered_records_.empty()) {
+    // Find the records of the next chunk.
+    std::multimap<int64_t, EncodedRecord>::iterator chunk_end =
+        buffered_records_.begin();
+    uint64_t num_bytes = 0u;
+    while (chunk_end != buffered_records_.end() &&
+           chunk_end->first <= max_timestamp_ns &&
+           num_bytes < chunk_num_bytes) {
+      num_bytes +=
+          sizeof(chunk_end->second.header) + chunk_end->second.payload.size();
+      ++chunk_end;
+    }
+    if (num_bytes == 0u ||
+        (num_bytes < chunk_num_bytes && !write_partial_chunk)) {
+      return;
+    }
+
+    sensor_log::ChunkInfo chunk;
+    chunk.offset = file_offset_;
+    chunk.num_bytes = num_bytes;
+    chunk.num_records = 0u;
+    chunk.first_timestamp_ns = buffered_records_.begin()->first;
+    for (std::multimap<int64_t, EncodedRecord>::iterator it =
+             buffered_records_.begin();
+         it != chunk_end; ++it) {
+      file_.write(
+          reinterpret_cast<const char*>(&it->second.header),
+          sizeof(it->second.header));
+      file_.write(it->second.payload.data(), it->second.payload.size());
+      chunk.last_timestamp_ns = it->first;
+      ++chunk.num_records;
+    }
+    buffered_records_.erase(buffered_records_.begin(), chunk_end);
+    num_buffered_bytes_ -= num_bytes;
+    file_offset_ += num_bytes;
+    last_written_timestamp_ns_ = chunk.last_timestamp_ns;
+    chunks_.emplace_back(chunk);
+  }
+}
+
+void SensorLogWriter::writeIndex() {
+  sensor_log::Trailer trailer;
+  trailer.index_offset = file_offset_;
+  trailer.num_chunks = chunks_.size();
+  std::memcpy(
+      trailer.magic, sensor_log::kIndexMagic, sizeof(sensor_log::kIndexMagic));
+  file_.write(
+      reinterpret_cast<const char*>(chunks_.data()),
+      chunks_.size() * sizeof(sensor_log::ChunkInfo));
+  file_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+}
+
+SensorLogReader::SensorLogReader()
+    : data_(nullptr),
+      num_bytes_(0u),
+      chunk_idx_(0u),
+      record_idx_in_chunk_(0u),
+      record_offset_(0u) {}
+
+SensorLogReader::~SensorLogReader() {
+  close();
+}
+
+bool SensorLogReader::open(const std::string& file_path) {
+  CHECK(!file_path.empty());
+  close();
+  if (!sensor_log::isLittleEndianHost()) {
+    return false;
+  }
+  const int file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    LOG(ERROR) << "Could not open the sensor log " << file_path << '.';
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor, &file_stat) != 0 ||
+      static_cast<size_t>(file_stat.st_size) <
+          sizeof(sensor_log::kFileMagic) + sizeof(sensor_log::Trailer)) {
+    ::close(file_descriptor);
+    LOG(ERROR) << "The sensor log " << file_path << " is incomplete.";
+    return false;
+  }
+  const size_t num_bytes = static_cast<size_t>(file_stat.st_size);
+  void* data =
+      mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  ::close(file_descriptor);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Could not map the sensor log " << file_path << '.';
+    return false;
+  }
+  // The records are mostly played back in order.
+  madvise(data, num_bytes, MADV_SEQUENTIAL);
+  data_ = static_cast<const char*>(data);
+  num_bytes_ = num_bytes;
+
+  sensor_log::Trailer trailer;
+  std::memcpy(
+      &trailer, data_ + num_bytes_ - sizeof(trailer), sizeof(trailer));
+  const uint64_t index_num_bytes =
+      trailer.num_chunks * sizeof(sensor_log::ChunkInfo);
+  if (std::memcmp(
+          data_, sensor_log::kFileMagic, sizeof(sensor_log::kFileMagic)) !=
+          0 ||
+      std::memcmp(
+          trailer.magic, sensor_log::kIndexMagic,
+          sizeof(sensor_log::kIndexMagic)) != 0 ||
+      trailer.index_offset < sizeof(sensor_log::kFileMagic) ||
+      trailer.index_offset + index_num_bytes + sizeof(trailer) != num_bytes_) {
+    LOG(ERROR) << "The sensor log " << file_path << " is incomplete or "
+               << "corrupted.";
+    close();
+    return false;
+  }
+  chunks_.resize(trailer.num_chunks);
+  std::memcpy(chunks_.data(), data_ + trailer.index_offset, index_num_bytes);
+  for (const sensor_log::ChunkInfo& chunk : chunks_) {
+    if (chunk.offset < sizeof(sensor_log::kFileMagic) ||
+        chunk.offset + chunk.num_bytes > trailer.index_offset) {
+      LOG(ERROR) << "The index of the sensor log " << file_path
+                 << " is corrupted.";
+      close();
+      return false;
+    }
+  }
+  seekToChunk(0u);
+  return true;
+}
+
+void SensorLogReader::close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), num_bytes_);
+  }
+  data_ = nullptr;
+  num_bytes_ = 0u;
+  chunks_.clear();
+  seekToChunk(0u);
+}
+
+size_t SensorLogReader::getNumRecords() const {
+  size_t num_records = 0u;
+  for (const sensor_log::ChunkInfo& chunk : chunks_) {
+    num_records += chunk.num_records;
+  }
+  return num_records;
+}
+
+int64_t SensorLogReader::getFirstTimestampNs() const {
+  return chunks_.empty() ? aslam::time::getInvalidTime()
+                         : chunks_.front().first_timestamp_ns;
+}
+
+int64_t SensorLogReader::getLastTimestampNs() const {
+  return chunks_.empty() ? aslam::time::getInvalidTime()
+                         : chunks_.back().last_timestamp_ns;
+}
+
+void SensorLogReader::seek(const int64_t timestamp_ns) {
+  const std::vector<sensor_log::ChunkInfo>::const_iterator it =
+      std::lower_bound(
+          chunks_.begin(), chunks_.end(), timestamp_ns,
+          [](const sensor_log::ChunkInfo& chunk, int64_t value_ns) {
+            return chunk.last_timestamp_ns < value_ns;
+          });
+  seekToChunk(it - chunks_.begin());
+
+  // Skip the records of the chunk that are older.
+  while (chunk_idx_ < chunks_.size()) {
+    const size_t record_idx_in_chunk = record_idx_in_chunk_;
+    const uint64_t record_offset = record_offset_;
+    sensor_log::Record record;
+    CHECK(readNext(&record));
+    if (record.header.timestamp_ns >= timestamp_ns) {
+      record_idx_in_chunk_ = record_idx_in_chunk;
+      record_offset_ = record_offset;
+      return;
+    }
+  }
+}
+
+bool SensorLogReader::readNext(sensor_log::Record* record) {
+  CHECK_NOTNULL(record);
+  while (chunk_idx_ < chunks_.size()) {
+    const sensor_log::ChunkInfo& chunk = chunks_[chunk_idx_];
+    if (record_idx_in_chunk_ >= chunk.num_records) {
+      seekToChunk(chunk_idx_ + 1u);
+      continue;
+    }
+    const uint64_t chunk_end = chunk.offset + chunk.num_bytes;
+    CHECK_LE(record_offset_ + sizeof(record->header), chunk_end);
+    std::memcpy(
+        &record->header, data_ + record_offset_, sizeof(record->header));
+    record->payload = data_ + record_offset_ + sizeof(record->header);
+    record_offset_ +=
+        sizeof(record->header) + record->header.payload_num_bytes;
+    CHECK_LE(record_offset_, chunk_end) << "Corrupted chunk " << chunk_idx_;
+    ++record_idx_in_chunk_;
+    return true;
+  }
+  return false;
+}
+
+void SensorLogReader::seekToChunk(const size_t chunk_idx) {
+  CHECK_LE(chunk_idx, chunks_.size());
+  chunk_idx_ = chunk_idx;
+  record_idx_in_chunk_ = 0u;
+  record_offset_ = chunk_idx < chunks_.size() ? chunks_[chunk_idx].offset : 0u;
+}
+
+}  // namespace rovioli
@@ -0,0 +1,229 @@
+#include "rovioli/tiled-localization-map.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <localization-summary-map/localization-summary-map.h>
+
+DEFINE_double(
+    rovioli_tiled_map_load_radius_m, 200.0,
+    "Summary map tiles within this distance of the current position are kept "
+    "in memory.");
+DEFINE_double(
+    rovioli_tiled_map_memory_budget_mb, 1024.0,
+    "Maximum estimated memory of the loaded summary map tiles and their "
+    "localization databases. The closest tile is always loaded.");
+DECLARE_string(lc_database_snapshot_file);
+
+namespace rovioli {
+namespace {
+// The loop detector database keeps its own copy of the projected descriptors
+// next to the ones of the summary map.
+constexpr size_t kDatabaseMemoryFactor = 2u;
+constexpr size_t kBytesPerMegabyte = 1024u * 1024u;
+}  // namespace
+
+TiledLocalizationMap::TiledLocalizationMap(
+    const std::string& folder_path, const Eigen::Vector3d& G_p_initial)
+    : num_loaded_bytes_(0u),
+      has_request_(false),
+      is_loading_(false),
+      shutdown_requested_(false) {
+  CHECK(tiles_.loadFromFolder(folder_path))
+      << "Loading the summary map tiles from \"" << folder_path
+      << "\" failed.";
+  CHECK_GT(FLAGS_rovioli_tiled_map_load_radius_m, 0.0);
+  CHECK_GT(FLAGS_rovioli_tiled_map_memory_budget_mb, 0.0);
+  if (!FLAGS_lc_database_snapshot_file.empty()) {
+    LOG(WARNING) << "The loop-closure database snapshot can only hold a "
+                 << "single summary map and is disabled for tiled maps.";
+    FLAGS_lc_database_snapshot_file.clear();
+  }
+  LOG(INFO) << "Loaded the index of " << tiles_.tiles().size()
+            << " summary map tiles of " << tiles_.tileSizeMeters() << " m.";
+
+  requested_position_ = G_p_initial;
+  requested_tile_coordinates_ = tiles_.getTileCoordinates(G_p_initial);
+  updateLoadedTiles(G_p_initial);
+
+  loader_thread_ = std::thread(&TiledLocalizationMap::loaderThread, this);
+}
+
+TiledLocalizationMap::~TiledLocalizationMap() {
+  {
+    std::lock_guard<std::mutex> lock(m_request_);
+    shutdown_requested_ = true;
+  }
+  cv_request_.notify_all();
+  if (loader_thread_.joinable()) {
+    loader_thread_.join();
+  }
+}
+
+void TiledLocalizationMap::setPosition(const Eigen::Vector3d& G_p) {
+  const Eigen::Vector2i tile_coordinates = tiles_.getTileCoordinates(G_p);
+  {
+    std::lock_guard<std::mutex> lock(m_request_);
+    if (tile_coordinates == requested_tile_coordinates_) {
+      return;
+    }
+    requested_tile_coordinates_ = tile_coordinates;
+    requested_position_ = G_p;
+    has_request_ = true;
+  }
+  cv_request_.notify_all();
+}
+
+void TiledLocalizationMap::getLoadedDatabases(
+    std::vector<LocalizationDatabase::ConstPtr>* databases) const {
+  CHECK_NOTNULL(databases)->clear();
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  databases->reserve(loaded_tiles_.size());
+  for (const std::unordered_map<size_t, LocalizationDatabase::ConstPtr>::
+           value_type& loaded_tile : loaded_tiles_) {
+    databases->push_back(loaded_tile.second);
+  }
+}
+
+size_t TiledLocalizationMap::getNumLoadedTiles() const {
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  return loaded_tiles_.size();
+}
+
+size_t TiledLocalizationMap::getNumLoadedBytes() const {
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  return num_loaded_bytes_;
+}
+
+void TiledLocalizationMap::waitUntilIdle() const {
+  std::unique_lock<std::mutex> lock(m_request_);
+  cv_request_.wait(lock, [this]() {
+    return (!has_request_ && !is_loading_) || shutdown_requested_;
+  });
+}
+
+void TiledLocalizationMap::loaderThread() {
+  while (true) {
+    Eigen::Vector3d G_p;
+    {
+      std::unique_lock<std::mutex> lock(m_request_);
+      cv_request_.wait(
+          lock, [this]() { return has_request_ || shutdown_requested_; });
+      if (shutdown_requested_) {
+        break;
+      }
+      G_p = requested_position_;
+      has_request_ = false;
+      is_loading_ = true;
+    }
+
+    updateLoadedTiles(G_p);
+
+    {
+      std::lock_guard<std::mutex> lock(m_request_);
+      is_loading_ = false;
+    }
+    cv_request_.notify_all();
+  }
+}
+
+void TiledLocalizationMap::updateLoadedTiles(const Eigen::Vector3d& G_p) {
+  const std::vector<summary_map::LocalizationSummaryMapTile>& tiles =
+      tiles_.tiles();
+
+  std::vector<std::pair<double, size_t>> distances_and_tile_indices;
+  for (size_t tile_index = 0u; tile_index < tiles.size(); ++tile_index) {
+    const double distance = tiles_.getDistanceToTile(G_p, tile_index);
+    if (distance <= FLAGS_rovioli_tiled_map_load_radius_m) {
+      distances_and_tile_indices.emplace_back(distance, tile_index);
+    }
+  }
+  std::sort(
+      distances_and_tile_indices.begin(), distances_and_tile_indices.end());
+
+  const size_t memory_budget_bytes = static_cast<size_t>(
+      FLAGS_rovioli_tiled_map_memory_budget_mb * kBytesPerMegabyte);
+  std::vector<size_t> tiles_to_keep;
+  std::unordered_set<size_t> tiles_to_keep_set;
+  size_t num_bytes_to_keep = 0u;
+  for (const std::pair<double, size_t>& distance_and_tile_index :
+       distances_and_tile_indices) {
+    const size_t tile_index = distance_and_tile_index.second;
+    const size_t num_bytes =
+        kDatabaseMemoryFactor * tiles[tile_index].num_bytes;
+    if (!tiles_to_keep.empty() &&
+        num_bytes_to_keep + num_bytes > memory_budget_bytes) {
+      VLOG(2) << "The memory budget leaves out "
+              << distances_and_tile_indices.size() - tiles_to_keep.size()
+              << " summary map tiles within the load radius.";
+      break;
+    }
+    tiles_to_keep.push_back(tile_index);
+    tiles_to_keep_set.insert(tile_index);
+    num_bytes_to_keep += num_bytes;
+  }
+
+  // Evict first, so the budget also holds while the new tiles are loaded.
+  {
+    std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+    for (std::unordered_map<size_t, LocalizationDatabase::ConstPtr>::iterator
+             it = loaded_tiles_.begin();
+         it != loaded_tiles_.end();) {
+      if (tiles_to_keep_set.count(it->first) == 0u) {
+        VLOG(1) << "Evicting summary map tile " << tiles[it->first].folder;
+        num_loaded_bytes_ -=
+            kDatabaseMemoryFactor * tiles[it->first].num_bytes;
+        it = loaded_tiles_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Load the closest tiles first. Stop early if the position changed again.
+  for (const size_t tile_index : tiles_to_keep) {
+    {
+      std::lock_guard<std::mutex> lock(m_request_);
+      if (has_request_ || shutdown_requested_) {
+        return;
+      }
+    }
+    bool is_loaded;
+    {
+      std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+      is_loaded = loaded_tiles_.count(tile_index) > 0u;
+    }
+    if (!is_loaded) {
+      loadTile(tile_index);
+    }
+  }
+}
+
+void TiledLocalizationMap::loadTile(const size_t tile_index) {
+  const summary_map::LocalizationSummaryMapTile& tile =
+      tiles_.tiles()[tile_index];
+  VLOG(1) << "Loading summary map tile " << tile.folder;
+
+  summary_map::LocalizationSummaryMap::UniquePtr tile_map =
+      aligned_unique<summary_map::LocalizationSummaryMap>();
+  if (!tiles_.loadTile(tile_index, tile_map.get())) {
+    LOG(ERROR) << "Loading the summary map tile " << tile.folder
+               << " failed.";
+    return;
+  }
+
+  // Building the database is the expensive part and happens without holding
+  // the lock, so the localizer can keep using the loaded tiles.
+  constexpr bool kVisualizeLocalization = false;
+  LocalizationDatabase::ConstPtr database = std::make_shared<
+      const LocalizationDatabase>(std::move(tile_map), kVisualizeLocalization);
+
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  loaded_tiles_.emplace(tile_index, database);
+  num_loaded_bytes_ += kDatabaseMemoryFactor * tile.num_bytes;
+}
+
+}  // namespace rovioli
@@ -1,45 +1,140 @@
 #include "rovioli/vio-update-builder.h"
 
+#include <atomic>
+
+#include <gflags/gflags.h>
 #include <maplab-common/interpolation-helpers.h>
+#include <vio-common/pipeline-trace.h>
+
+DEFINE_uint64(
+    rovioli_vio_update_builder_estimate_buffer_size, 1024u,
+    "Number of ROVIO estimates buffered for matching them to the synced "
+    "nframes. Rounded up to the next power of two.");
 
 namespace rovioli {
+namespace {
+size_t roundUpToPowerOfTwo(const size_t value) {
+  size_t power_of_two = 1u;
+  while (power_of_two < value) {
+    power_of_two <<= 1u;
+  }
+  return power_of_two;
+}
+}  // namespace
+
+VioUpdateBuilder::RovioEstimateBuffer::RovioEstimateBuffer(
+    size_t min_capacity)
+    : index_mask_(roundUpToPowerOfTwo(min_capacity) - 1u),
+      estimates_(index_mask_ + 1u),
+      timestamps_ns_(index_mask_ + 1u),
+      begin_(0u),
+      size_(0u) {
+  CHECK_GT(min_capacity, 0u);
+}
+
+void VioUpdateBuilder::RovioEstimateBuffer::push(
+    const RovioEstimate::ConstPtr& rovio_estimate) {
+  CHECK(rovio_estimate);
+  if (size_ == estimates_.size()) {
+    LOG_EVERY_N(WARNING, 100)
+        << "The ROVIO estimate buffer is full, dropping the oldest estimate. "
+        << "Increase --rovioli_vio_update_builder_estimate_buffer_size if the "
+        << "synced nframes lag behind the estimates by more than the buffer.";
+    popFront(1u);
+  }
+  const size_t index = (begin_ + size_) & index_mask_;
+  estimates_[index] = rovio_estimate;
+  timestamps_ns_[index] =
+      aslam::time::secondsToNanoSeconds(rovio_estimate->timestamp_s);
+  ++size_;
+}
+
+size_t VioUpdateBuilder::RovioEstimateBuffer::upperBound(
+    const int64_t timestamp_ns) const {
+  // Binary search over the ordered timestamps.
+  size_t first = 0u;
+  size_t count = size_;
+  while (count > 0u) {
+    const size_t step = count / 2u;
+    const size_t index = first + step;
+    if (timestampNs(index) <= timestamp_ns) {
+      first = index + 1u;
+      count -= step + 1u;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+void VioUpdateBuilder::RovioEstimateBuffer::popFront(
+    const size_t num_estimates) {
+  CHECK_LE(num_estimates, size_);
+  for (size_t i = 0u; i < num_estimates; ++i) {
+    estimates_[(begin_ + i) & index_mask_].reset();
+  }
+  begin_ = (begin_ + num_estimates) & index_mask_;
+  size_ -= num_estimates;
+}
 
 VioUpdateBuilder::VioUpdateBuilder()
-    : last_received_timestamp_synced_nframe_queue_(
+    : rovio_estimate_buffer_(
+          FLAGS_rovioli_vio_update_builder_estimate_buffer_size),
+      last_received_timestamp_synced_nframe_queue_(
           aslam::time::getInvalidTime()),
       last_received_timestamp_rovio_estimate_queue(
-          aslam::time::nanoSecondsToSeconds(aslam::time::getInvalidTime())) {}
+          aslam::time::nanoSecondsToSeconds(aslam::time::getInvalidTime())),
+      last_localization_timestamp_ns_(aslam::time::getInvalidTime()) {
+  vio_update_pool_.reserve(kVioUpdatePoolSize);
+  for (size_t i = 0u; i < kVioUpdatePoolSize; ++i) {
+    vio_update_pool_.emplace_back(aligned_shared<vio::VioUpdate>());
+  }
+}
 
 void VioUpdateBuilder::processSynchronizedNFrameImu(
     const vio::SynchronizedNFrameImu::ConstPtr& synced_nframe_imu) {
   CHECK(synced_nframe_imu != nullptr);
   const int64_t timestamp_nframe_ns =
       synced_nframe_imu->nframe->getMaxTimestampNanoseconds();
+
+  std::lock_guard<std::mutex> lock(m_synced_nframe_imu_queue_);
   CHECK_GT(timestamp_nframe_ns, last_received_timestamp_synced_nframe_queue_);
   last_received_timestamp_synced_nframe_queue_ = timestamp_nframe_ns;
-
-  std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-  synced_nframe_imu_queue_.push(synced_nframe_imu);
-  findMatchAndPublish();
+  const int64_t receive_time_ns =
+      synced_nframe_imu->trace != nullptr ? vio::PipelineTrace::nowNanoseconds()
+                                          : 0;
+  synced_nframe_imu_queue_.emplace_back(synced_nframe_imu, receive_time_ns);
+  findMatchesAndPublish();
 }
 
 void VioUpdateBuilder::processRovioEstimate(
     const RovioEstimate::ConstPtr& rovio_estimate) {
   CHECK(rovio_estimate != nullptr);
   const double timestamp_rovio_estimate_s = rovio_estimate->timestamp_s;
-  CHECK_GT(
-      timestamp_rovio_estimate_s, last_received_timestamp_rovio_estimate_queue);
-  last_received_timestamp_rovio_estimate_queue = timestamp_rovio_estimate_s;
+  {
+    std::lock_guard<std::mutex> lock(m_rovio_estimate_buffer_);
+    CHECK_GT(
+        timestamp_rovio_estimate_s,
+        last_received_timestamp_rovio_estimate_queue);
+    last_received_timestamp_rovio_estimate_queue = timestamp_rovio_estimate_s;
+    rovio_estimate_buffer_.push(rovio_estimate);
+  }
 
-  std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-  rovio_estimate_queue_.push_back(rovio_estimate);
-  findMatchAndPublish();
+  std::lock_guard<std::mutex> lock(m_synced_nframe_imu_queue_);
+  findMatchesAndPublish();
 }
 
 void VioUpdateBuilder::processLocalizationResult(
     const vio::LocalizationResult::ConstPtr& localization_result) {
   CHECK(localization_result);
   std::lock_guard<std::mutex> lock(mutex_last_localization_state_);
+  if (localization_result->timestamp <= last_localization_timestamp_ns_) {
+    VLOG(3) << "Dropping the localization result at time "
+            << localization_result->timestamp
+            << " as a newer one was already accepted.";
+    return;
+  }
+  last_localization_timestamp_ns_ = localization_result->timestamp;
   switch (localization_result->localization_type) {
     case vio::LocalizationResult::LocalizationMode::kGlobal:
       last_localization_state_ = vio::LocalizationState::kLocalized;
@@ -50,70 +145,56 @@ void VioUpdateBuilder::processLocalizationResult(
   }
 }
 
-void VioUpdateBuilder::findMatchAndPublish() {
-  std::lock_guard<std::recursive_mutex> lock(queue_mutex_);
-
-  if (synced_nframe_imu_queue_.empty() || rovio_estimate_queue_.empty()) {
-    // Nothing to do.
-    return;
+void VioUpdateBuilder::findMatchesAndPublish() {
+  while (!synced_nframe_imu_queue_.empty() && findMatchAndPublish()) {
   }
-  const vio::SynchronizedNFrameImu::ConstPtr& oldest_unmatched_synced_nframe =
-      synced_nframe_imu_queue_.front();
+}
+
+bool VioUpdateBuilder::findMatchAndPublish() {
+  CHECK(!synced_nframe_imu_queue_.empty());
+  const vio::SynchronizedNFrameImu::ConstPtr oldest_unmatched_synced_nframe =
+      synced_nframe_imu_queue_.front().first;
+  const int64_t receive_time_ns = synced_nframe_imu_queue_.front().second;
   const int64_t timestamp_nframe_ns =
       oldest_unmatched_synced_nframe->nframe->getMinTimestampNanoseconds();
 
-  // We need to use iterator instead of const_iterator because erase isn't
-  // defined for const_iterators in g++ 4.8.
-  RovioEstimateQueue::iterator it_rovio_estimate_before_nframe =
-      rovio_estimate_queue_.end();
-  RovioEstimateQueue::iterator it_rovio_estimate_after_nframe =
-      rovio_estimate_queue_.end();
-
-  bool found_exact_match = false;
-  bool found_matches_to_interpolate = false;
-  // Need at least two values for interpolation.
-  for (it_rovio_estimate_before_nframe = rovio_estimate_queue_.begin();
-       it_rovio_estimate_before_nframe != rovio_estimate_queue_.end();
-       ++it_rovio_estimate_before_nframe) {
-    it_rovio_estimate_after_nframe = it_rovio_estimate_before_nframe + 1;
-    // Check if exact match.
-    if (aslam::time::secondsToNanoSeconds(
-            (*it_rovio_estimate_before_nframe)->timestamp_s) ==
-        timestamp_nframe_ns) {
-      found_exact_match = true;
-      break;
+  RovioEstimate::ConstPtr rovio_estimate_before_nframe;
+  RovioEstimate::ConstPtr rovio_estimate_after_nframe;
+  int64_t t_before = aslam::time::getInvalidTime();
+  int64_t t_after = aslam::time::getInvalidTime();
+  {
+    std::lock_guard<std::mutex> lock(m_rovio_estimate_buffer_);
+    // The estimate before the nframe is the last one that isn't newer.
+    const size_t index_after_nframe =
+        rovio_estimate_buffer_.upperBound(timestamp_nframe_ns);
+    if (index_after_nframe == 0u) {
+      return false;
     }
-    if (it_rovio_estimate_after_nframe != rovio_estimate_queue_.end() &&
-        aslam::time::secondsToNanoSeconds(
-            (*it_rovio_estimate_before_nframe)->timestamp_s) <=
-            timestamp_nframe_ns &&
-        aslam::time::secondsToNanoSeconds(
-            (*it_rovio_estimate_after_nframe)->timestamp_s) >
-            timestamp_nframe_ns) {
-      // Found matching vi nodes.
-      found_matches_to_interpolate = true;
-      break;
+    const size_t index_before_nframe = index_after_nframe - 1u;
+    rovio_estimate_before_nframe =
+        rovio_estimate_buffer_.estimate(index_before_nframe);
+    t_before = rovio_estimate_buffer_.timestampNs(index_before_nframe);
+    if (t_before != timestamp_nframe_ns) {
+      // Need two values for interpolation.
+      if (index_after_nframe == rovio_estimate_buffer_.size()) {
+        return false;
+      }
+      rovio_estimate_after_nframe =
+          rovio_estimate_buffer_.estimate(index_after_nframe);
+      t_after = rovio_estimate_buffer_.timestampNs(index_after_nframe);
     }
-  }
 
-  if (!found_exact_match && !found_matches_to_interpolate) {
-    return;
+    // Keep the estimate before the nframe, as the subsequent nframe may need
+    // to be interpolated from it again.
+    rovio_estimate_buffer_.popFront(index_before_nframe);
   }
+  const bool found_exact_match = rovio_estimate_after_nframe == nullptr;
 
-  CHECK(it_rovio_estimate_before_nframe != rovio_estimate_queue_.end());
-  CHECK(
-      found_exact_match ||
-      it_rovio_estimate_after_nframe != rovio_estimate_queue_.end());
-  CHECK(it_rovio_estimate_before_nframe != it_rovio_estimate_after_nframe);
-  const RovioEstimate::ConstPtr& rovio_estimate_before_nframe =
-      *it_rovio_estimate_before_nframe;
-  const RovioEstimate::ConstPtr& rovio_estimate_after_nframe =
-      *it_rovio_estimate_after_nframe;
-
-  // Build VioUpdate.
-  vio::VioUpdate::Ptr vio_update = aligned_shared<vio::VioUpdate>();
+  // Build VioUpdate. All fields are set as the storage may be reused.
+  vio::VioUpdate::Ptr vio_update = getVioUpdateStorage();
   vio_update->timestamp_ns = timestamp_nframe_ns;
   vio_update->keyframe_and_imudata = oldest_unmatched_synced_nframe;
+  vio_update->T_G_M.setIdentity();
   if (found_exact_match) {
     vio_update->vinode = rovio_estimate_before_nframe->vinode;
 
@@ -122,17 +203,11 @@ void VioUpdateBuilder::findMatchAndPublish() {
     }
   } else {
     // Need to interpolate ViNode.
-    const int64_t t_before = aslam::time::secondsToNanoSeconds(
-        rovio_estimate_before_nframe->timestamp_s);
-    const int64_t t_after = aslam::time::secondsToNanoSeconds(
-        rovio_estimate_after_nframe->timestamp_s);
-
-    vio::ViNodeState interpolated_vi_node;
+    vio_update->vinode = vio::ViNodeState();
     interpolateViNodeState(
         t_before, rovio_estimate_before_nframe->vinode, t_after,
         rovio_estimate_after_nframe->vinode, timestamp_nframe_ns,
-        &interpolated_vi_node);
-    vio_update->vinode = interpolated_vi_node;
+        &vio_update->vinode);
 
     if (rovio_estimate_before_nframe->has_T_G_M &&
         rovio_estimate_after_nframe->has_T_G_M) {
@@ -149,25 +224,37 @@ void VioUpdateBuilder::findMatchAndPublish() {
     vio_update->localization_state = last_localization_state_;
     last_localization_state_ = vio::LocalizationState::kUninitialized;
   }
+  synced_nframe_imu_queue_.pop_front();
+
+  vio_update->trace = oldest_unmatched_synced_nframe->trace;
+  if (vio_update->trace != nullptr) {
+    // The estimate at or after the nframe was updated with its image.
+    const RovioEstimate::ConstPtr& rovio_estimate_of_nframe =
+        found_exact_match ? rovio_estimate_before_nframe
+                          : rovio_estimate_after_nframe;
+    if (rovio_estimate_of_nframe->trace != nullptr) {
+      vio_update->trace->addStagesOf(*rovio_estimate_of_nframe->trace);
+    }
+    vio_update->trace->addStage(
+        "vio_update_builder", receive_time_ns,
+        vio::PipelineTrace::nowNanoseconds());
+  }
 
   // Publish VIO update.
   CHECK(vio_update_publish_function_);
   vio_update_publish_function_(vio_update);
+  return true;
+}
 
-  // Clean up queues.
-  if (it_rovio_estimate_before_nframe != rovio_estimate_queue_.begin()) {
-    if (found_exact_match) {
-      rovio_estimate_queue_.erase(
-          rovio_estimate_queue_.begin(), it_rovio_estimate_before_nframe);
-    } else {
-      // Keep the two ViNodeStates that were used for interpolation as a
-      // subsequent SynchronizedNFrameImu may need to be interpolated between
-      // those two points again.
-      rovio_estimate_queue_.erase(
-          rovio_estimate_queue_.begin(), it_rovio_estimate_before_nframe - 1);
+vio::VioUpdate::Ptr VioUpdateBuilder::getVioUpdateStorage() {
+  for (const vio::VioUpdate::Ptr& vio_update : vio_update_pool_) {
+    if (vio_update.use_count() == 1) {
+      // Synchronizes with the release of the last subscriber reference.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return vio_update;
     }
   }
-  synced_nframe_imu_queue_.pop();
+  return aligned_shared<vio::VioUpdate>();
 }
 
 void VioUpdateBuilder::interpolateViNodeState(
@@ -1,6 +1,7 @@
 #include <chrono>
 #include <thread>
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
@@ -8,6 +9,8 @@
 #include "rovioli/feature-tracking.h"
 #include "rovioli/imu-camera-synchronizer.h"
 
+DECLARE_bool(rovioli_pipelined_feature_tracking);
+
 namespace rovioli {
 
 class VioPipelineTest : public ::testing::Test {
@@ -27,6 +30,47 @@ class VioPipelineTest : public ::testing::Test {
     num_output_frames_ = 0;
   }
 
+  // Feeds nframes of random images with random IMU measurements and returns
+  // the number of fed nframes.
+  int feedRandomFrames() {
+    std::function<void(const vio::SynchronizedNFrameImu::Ptr&)> callback =
+        std::bind(&VioPipelineTest::dataCallback, this, std::placeholders::_1);
+    synchronizer_->registerSynchronizedNFrameImuCallback(callback);
+
+    constexpr int64_t kTimestepNs = 1e9;
+    constexpr int64_t kNumFrames = 20;
+
+    int feeded_frames = 0;
+    for (int64_t t = 0; t < kNumFrames * kTimestepNs; t += kTimestepNs) {
+      for (size_t i = 0; i < kNumCameras; ++i) {
+        cv::Mat image = cv::Mat(
+            ncamera_->getCamera(i).imageHeight(),
+            ncamera_->getCamera(i).imageWidth(), CV_8UC1);
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+        synchronizer_->addCameraImage(i, image, t);
+      }
+
+      Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_nanoseconds(1, 4);
+      timestamps_nanoseconds << t, t + 0.5 * kTimestepNs, t + kTimestepNs - 5,
+          t + kTimestepNs - 1;
+
+      Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements;
+      imu_measurements.resize(Eigen::NoChange, 4);
+      imu_measurements.setRandom();
+
+      synchronizer_->addImuMeasurements(
+          timestamps_nanoseconds, imu_measurements);
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+      ++feeded_frames;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    return feeded_frames;
+  }
+
   ImuCameraSynchronizer::Ptr synchronizer_;
   FeatureTracking::Ptr pipeline_;
   aslam::NCamera::Ptr ncamera_;
@@ -40,48 +84,31 @@ class VioPipelineTest : public ::testing::Test {
 };
 
 TEST_F(VioPipelineTest, PipelineWorks) {
-  std::function<void(const vio::SynchronizedNFrameImu::Ptr&)> callback =
-      std::bind(&VioPipelineTest::dataCallback, this, std::placeholders::_1);
-  synchronizer_->registerSynchronizedNFrameImuCallback(callback);
-
-  constexpr int64_t kTimestepNs = 1e9;
-  constexpr int64_t kNumFrames = 20;
-
-  int feeded_frames = 0;
-  for (int64_t t = 0; t < kNumFrames * kTimestepNs; t += kTimestepNs) {
-    for (size_t i = 0; i < kNumCameras; ++i) {
-      cv::Mat image = cv::Mat(
-          ncamera_->getCamera(i).imageHeight(),
-          ncamera_->getCamera(i).imageWidth(), CV_8UC1);
-      cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
-
-      synchronizer_->addCameraImage(i, image, t);
-    }
-
-    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_nanoseconds(1, 4);
-    timestamps_nanoseconds << t, t + 0.5 * kTimestepNs, t + kTimestepNs - 5,
-        t + kTimestepNs - 1;
-
-    Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements;
-    imu_measurements.resize(Eigen::NoChange, 4);
-    imu_measurements.setRandom();
-
-    synchronizer_->addImuMeasurements(timestamps_nanoseconds, imu_measurements);
+  const int feeded_frames = feedRandomFrames();
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-    ++feeded_frames;
+  // Decrease the counter by frames skipped at the beginning + one to populate
+  // the previous frame.
+  {
+    std::lock_guard<std::mutex> lock(m_num_output_frames_);
+    EXPECT_EQ(
+        num_output_frames_,
+        feeded_frames - ImuCameraSynchronizer::kFramesToSkipAtInit - 1);
   }
 
-  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  synchronizer_->shutdown();
+}
 
-  // Decrease the counter by frames skipped at the beginning + one to populate
-  // the previous frame.
-  feeded_frames -= ImuCameraSynchronizer::kFramesToSkipAtInit + 1;
+TEST_F(VioPipelineTest, PipelinedTrackingWorks) {
+  FLAGS_rovioli_pipelined_feature_tracking = true;
+  const int feeded_frames = feedRandomFrames();
+  FLAGS_rovioli_pipelined_feature_tracking = false;
 
+  // The last received nframe is still waiting to be tracked.
   {
     std::lock_guard<std::mutex> lock(m_num_output_frames_);
-    EXPECT_EQ(num_output_frames_, feeded_frames);
+    EXPECT_EQ(
+        num_output_frames_,
+        feeded_frames - ImuCameraSynchronizer::kFramesToSkipAtInit - 2);
   }
 
   synchronizer_->shutdown();
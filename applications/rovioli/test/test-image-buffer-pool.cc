@@ -0,0 +1,70 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core/core.hpp>
+
+#include "rovioli/image-buffer-pool.h"
+
+namespace rovioli {
+
+TEST(ImageBufferPoolTest, ReleasedBuffersAreReused) {
+  constexpr size_t kMaxNumFreeBuffers = 2u;
+  ImageBufferPool pool(kMaxNumFreeBuffers);
+  constexpr int kRows = 480;
+  constexpr int kCols = 752;
+
+  const uchar* data;
+  {
+    cv::Mat image = pool.acquire(kRows, kCols, CV_8UC1);
+    data = image.data;
+    // Copies of the header share the buffer.
+    cv::Mat image_copy = image;
+    image.release();
+    EXPECT_EQ(pool.getNumFreeBuffers(), 0u);
+  }
+  EXPECT_EQ(pool.getNumFreeBuffers(), 1u);
+
+  cv::Mat image = pool.acquire(kRows, kCols, CV_8UC1);
+  EXPECT_EQ(image.data, data);
+  EXPECT_EQ(pool.getNumFreeBuffers(), 0u);
+
+  // A different size doesn't get the buffer of another size.
+  cv::Mat other_image = pool.acquire(kRows / 2, kCols, CV_8UC1);
+  EXPECT_NE(other_image.data, image.data);
+
+  // Only kMaxNumFreeBuffers buffers are kept.
+  {
+    cv::Mat image_1 = pool.acquire(kRows, kCols, CV_8UC1);
+    cv::Mat image_2 = pool.acquire(kRows, kCols, CV_8UC1);
+    cv::Mat image_3 = pool.acquire(kRows, kCols, CV_8UC1);
+  }
+  EXPECT_EQ(pool.getNumFreeBuffers(), kMaxNumFreeBuffers);
+}
+
+TEST(ImageBufferPoolTest, WrappedDataKeepsOwnerAlive) {
+  constexpr int kRows = 4;
+  constexpr int kCols = 6;
+  std::shared_ptr<std::vector<uchar>> pixels =
+      std::make_shared<std::vector<uchar>>(kRows * kCols, 7u);
+  std::weak_ptr<std::vector<uchar>> weak_pixels = pixels;
+
+  cv::Mat image_copy;
+  {
+    cv::Mat image = wrapExternalImageData(
+        kRows, kCols, CV_8UC1, pixels->data(), kCols, pixels);
+    EXPECT_EQ(image.data, pixels->data());
+    image_copy = image;
+  }
+  pixels.reset();
+  EXPECT_FALSE(weak_pixels.expired());
+  EXPECT_EQ(image_copy.at<uchar>(kRows - 1, kCols - 1), 7u);
+
+  image_copy.release();
+  EXPECT_TRUE(weak_pixels.expired());
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,125 @@
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/time.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "rovioli/localization-scheduler.h"
+
+DECLARE_double(vio_throttler_max_output_frequency_hz);
+DECLARE_double(rovioli_adaptive_localization_min_frequency_hz);
+DECLARE_double(rovioli_adaptive_localization_max_vio_drift_m);
+DECLARE_double(rovioli_localization_cpu_budget);
+
+namespace rovioli {
+
+class LocalizationSchedulerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    FLAGS_vio_throttler_max_output_frequency_hz = 10.0;
+    FLAGS_rovioli_adaptive_localization_min_frequency_hz = 1.0;
+    FLAGS_rovioli_adaptive_localization_max_vio_drift_m = 0.5;
+    FLAGS_rovioli_localization_cpu_budget = 0.0;
+    min_interval_ns_ = aslam::time::milliseconds(100);
+    max_interval_ns_ = aslam::time::seconds(1);
+  }
+
+  // Adds a VIO estimate at the origin with the given position variance per
+  // axis.
+  void addVioEstimate(
+      const int64_t timestamp_ns, const double position_variance_m2,
+      LocalizationScheduler* scheduler) {
+    CHECK_NOTNULL(scheduler)->processVioEstimate(
+        timestamp_ns, aslam::Transformation(),
+        Eigen::Matrix3d::Identity() * position_variance_m2);
+  }
+
+  static LocalizationAttempt createAttempt(
+      const int64_t timestamp_ns, const bool success,
+      const Eigen::Vector3d& p_G_I) {
+    LocalizationAttempt attempt;
+    attempt.timestamp_ns = timestamp_ns;
+    attempt.success = success;
+    attempt.T_G_I = aslam::Transformation(
+        Eigen::Quaterniond::Identity(), p_G_I);
+    attempt.duration_ns = aslam::time::milliseconds(10);
+    return attempt;
+  }
+
+  int64_t min_interval_ns_;
+  int64_t max_interval_ns_;
+};
+
+TEST_F(LocalizationSchedulerTest, AgreeingLocalizationsLowerTheRate) {
+  LocalizationScheduler scheduler;
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), min_interval_ns_);
+
+  const Eigen::Vector3d p_G_I(1.0, 2.0, 3.0);
+  int64_t timestamp_ns = 0;
+  for (int attempt_idx = 0; attempt_idx < 6; ++attempt_idx) {
+    addVioEstimate(timestamp_ns, 0.0, &scheduler);
+    scheduler.processLocalizationAttempt(
+        createAttempt(timestamp_ns, true, p_G_I));
+    timestamp_ns += aslam::time::milliseconds(100);
+  }
+  // The first localization has nothing to agree with.
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), max_interval_ns_);
+
+  // A jump of the VIO-to-map transformation resets the interval.
+  scheduler.processLocalizationAttempt(
+      createAttempt(timestamp_ns, true, p_G_I + Eigen::Vector3d(1, 0, 0)));
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), min_interval_ns_);
+  timestamp_ns += aslam::time::milliseconds(100);
+  scheduler.processLocalizationAttempt(
+      createAttempt(timestamp_ns, true, p_G_I + Eigen::Vector3d(1, 0, 0)));
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), 2 * min_interval_ns_);
+
+  // Late attempts are ignored.
+  scheduler.processLocalizationAttempt(
+      createAttempt(0, false, Eigen::Vector3d::Zero()));
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), 2 * min_interval_ns_);
+
+  timestamp_ns += aslam::time::milliseconds(100);
+  scheduler.processLocalizationAttempt(
+      createAttempt(timestamp_ns, false, Eigen::Vector3d::Zero()));
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), min_interval_ns_);
+}
+
+TEST_F(LocalizationSchedulerTest, VioDriftRaisesTheRate) {
+  LocalizationScheduler scheduler;
+  int64_t timestamp_ns = 0;
+  for (int attempt_idx = 0; attempt_idx < 3; ++attempt_idx) {
+    addVioEstimate(timestamp_ns, 1.0, &scheduler);
+    scheduler.processLocalizationAttempt(
+        createAttempt(timestamp_ns, true, Eigen::Vector3d::Zero()));
+    timestamp_ns += aslam::time::milliseconds(100);
+  }
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), 4 * min_interval_ns_);
+
+  // A standard deviation growth of sqrt(3 * 0.05) m is within the limit.
+  addVioEstimate(timestamp_ns, 1.05, &scheduler);
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), 4 * min_interval_ns_);
+  addVioEstimate(timestamp_ns, 1.1, &scheduler);
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), min_interval_ns_);
+}
+
+TEST_F(LocalizationSchedulerTest, NFramesAreScheduledWithTheInterval) {
+  FLAGS_rovioli_localization_cpu_budget = 0.05;
+  LocalizationScheduler scheduler;
+  EXPECT_TRUE(scheduler.shouldLocalizeNFrame(0));
+  EXPECT_FALSE(scheduler.shouldLocalizeNFrame(aslam::time::milliseconds(50)));
+  EXPECT_TRUE(scheduler.shouldLocalizeNFrame(aslam::time::milliseconds(100)));
+
+  // 10 ms per localization on a budget of 5% of a core.
+  addVioEstimate(aslam::time::milliseconds(100), 0.0, &scheduler);
+  scheduler.processLocalizationAttempt(createAttempt(
+      aslam::time::milliseconds(100), false, Eigen::Vector3d::Zero()));
+  EXPECT_EQ(scheduler.getCurrentIntervalNs(), aslam::time::milliseconds(200));
+  EXPECT_FALSE(scheduler.shouldLocalizeNFrame(aslam::time::milliseconds(200)));
+  EXPECT_TRUE(scheduler.shouldLocalizeNFrame(aslam::time::milliseconds(300)));
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
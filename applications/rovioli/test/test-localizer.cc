@@ -1,12 +1,18 @@
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiles.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <maplab-common/map-manager-config.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/localizer.h"
+#include "rovioli/tiled-localization-map.h"
+
+DECLARE_double(rovioli_tiled_map_load_radius_m);
 
 namespace rovioli {
 
@@ -32,6 +38,34 @@ class ViMappingTest : public ::testing::Test {
     localizer_.reset(new Localizer(summary_map_, kVisualizeLocalization));
   }
 
+  // Splits the summary map into tiles and localizes against all of them.
+  void createTiledSummaryMapAndInitLocalizer(const double tile_size_meters) {
+    const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
+
+    vi_map::LandmarkIdList landmark_ids;
+    vi_map.getAllLandmarkIds(&landmark_ids);
+    summary_map::createLocalizationSummaryMapFromLandmarkList(
+        vi_map, landmark_ids, &summary_map_);
+
+    backend::SaveConfig save_config;
+    save_config.overwrite_existing_files = true;
+    ASSERT_TRUE(
+        summary_map::LocalizationSummaryMapTiles::saveToFolder(
+            summary_map_, tile_size_meters, kTiledMapFolder, save_config));
+
+    pose_graph::VertexIdList vertex_ids;
+    vi_map.getAllVertexIdsAlongGraphsSortedByTimestamp(&vertex_ids);
+    CHECK(!vertex_ids.empty());
+
+    FLAGS_rovioli_tiled_map_load_radius_m = 1e3;
+    tiled_map_.reset(
+        new TiledLocalizationMap(
+            kTiledMapFolder, vi_map.getVertex_G_p_I(vertex_ids.front())));
+    tiled_map_->waitUntilIdle();
+    EXPECT_GT(tiled_map_->getNumLoadedTiles(), 1u);
+    localizer_.reset(new Localizer(tiled_map_.get()));
+  }
+
   double evaluateRecall() {
     const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
 
@@ -58,14 +92,69 @@ class ViMappingTest : public ::testing::Test {
     return recall;
   }
 
+  // Feeds the map poses as VIO poses, so the localizer can switch to map
+  // tracking after the first global localization. From the middle of the
+  // dataset on, the VIO poses are shifted by M_p_jump to simulate a jump of
+  // the VIO.
+  double evaluateRecallWithVioPoses(
+      const Eigen::Vector3d& M_p_jump, size_t* num_tracking_localizations) {
+    CHECK_NOTNULL(num_tracking_localizations);
+    *num_tracking_localizations = 0u;
+    const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
+
+    pose_graph::VertexIdList vertex_ids;
+    vi_map.getAllVertexIdsAlongGraphsSortedByTimestamp(&vertex_ids);
+    CHECK(!vertex_ids.empty());
+
+    const aslam::Transformation T_M_G_jump(
+        M_p_jump, aslam::Quaternion(Eigen::Matrix3d::Identity()));
+    double recall = 0.;
+    for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size();
+         ++vertex_idx) {
+      const pose_graph::VertexId& vertex_id = vertex_ids[vertex_idx];
+      const aslam::VisualNFrame::ConstPtr nframe =
+          vi_map.getVertex(vertex_id).getVisualNFrameShared();
+      if (vertex_idx < vertex_ids.size() / 2u) {
+        localizer_->processVioEstimate(
+            nframe->getMinTimestampNanoseconds(),
+            vi_map.getVertex_T_G_I(vertex_id));
+      } else {
+        localizer_->processVioEstimate(
+            nframe->getMinTimestampNanoseconds(),
+            T_M_G_jump * vi_map.getVertex_T_G_I(vertex_id));
+      }
+
+      vio::LocalizationResult result;
+      if (localizer_->localizeNFrame(nframe, &result)) {
+        if (result.localization_type ==
+            Localizer::LocalizationMode::kMapTracking) {
+          ++(*num_tracking_localizations);
+        }
+        const double localization_error = (result.T_G_I_lc_pnp.getPosition() -
+                                           vi_map.getVertex_G_p_I(vertex_id))
+                                              .norm();
+        if (localization_error < kLocalizationPositionThresholdMeters) {
+          ++recall;
+        }
+      }
+    }
+
+    recall /= vertex_ids.size();
+    return recall;
+  }
+
  private:
   Localizer::UniquePtr localizer_;
+  TiledLocalizationMap::UniquePtr tiled_map_;
   summary_map::LocalizationSummaryMap summary_map_;
   visual_inertial_mapping::VIMappingTestApp test_app_;
 
   static constexpr double kLocalizationPositionThresholdMeters = 0.01;
+  static constexpr char kTiledMapFolder[] = "./tiled_summary_map";
 };
 
+constexpr char ViMappingTest::kTiledMapFolder[];
+
 TEST_F(ViMappingTest, LocalizerWithSummaryMapWorks) {
   createSummaryMapAndInitLocalizer();
   const double recall = evaluateRecall();
@@ -74,6 +163,43 @@ TEST_F(ViMappingTest, LocalizerWithSummaryMapWorks) {
   EXPECT_GT(recall, kRecallThreshold);
 }
 
+TEST_F(ViMappingTest, LocalizerWithMapTrackingWorks) {
+  createSummaryMapAndInitLocalizer();
+  size_t num_tracking_localizations;
+  const double recall = evaluateRecallWithVioPoses(
+      Eigen::Vector3d::Zero(), &num_tracking_localizations);
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+  EXPECT_GT(num_tracking_localizations, 0u);
+}
+
+TEST_F(ViMappingTest, LocalizerRecoversFromVioJump) {
+  createSummaryMapAndInitLocalizer();
+  // Far outside --rovioli_localization_prior_search_radius_m, so the nframes
+  // after the jump are only found by searching the whole map.
+  const Eigen::Vector3d M_p_jump(100.0, 0.0, 0.0);
+  size_t num_tracking_localizations;
+  const double recall =
+      evaluateRecallWithVioPoses(M_p_jump, &num_tracking_localizations);
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+  EXPECT_GT(num_tracking_localizations, 0u);
+}
+
+TEST_F(ViMappingTest, LocalizerWithTiledSummaryMapWorks) {
+  constexpr double kTileSizeMeters = 5.0;
+  createTiledSummaryMapAndInitLocalizer(kTileSizeMeters);
+  size_t num_tracking_localizations;
+  const double recall = evaluateRecallWithVioPoses(
+      Eigen::Vector3d::Zero(), &num_tracking_localizations);
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+  EXPECT_GT(num_tracking_localizations, 0u);
+}
+
 }  // namespace rovioli
 
 MAPLAB_UNITTEST_ENTRYPOINT
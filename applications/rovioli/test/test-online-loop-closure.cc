@@ -0,0 +1,176 @@
+#include <memory>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <online-map-builders/stream-map-builder.h>
+#include <vi-map/vi-map.h>
+#include <vio-common/vio-types.h>
+#include <vio-common/vio-update.h>
+
+#include "rovioli/online-loop-closure.h"
+#include "rovioli/vi-map-with-mutex.h"
+
+namespace rovioli {
+
+class OnlineLoopClosureTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    constexpr size_t kNumCameras = 1u;
+    ncamera_ = aslam::NCamera::createTestNCamera(kNumCameras);
+    map_with_mutex_ = aligned_shared<VIMapWithMutex>();
+    map_builder_.reset(
+        new online_map_builders::StreamMapBuilder(
+            ncamera_, &map_with_mutex_->vi_map));
+    online_loop_closure_.reset(
+        new OnlineLoopClosure(map_with_mutex_.get(), map_builder_.get()));
+  }
+
+  // All updates observe the same feature track, the vertices are far too
+  // close in time to be added to the loop-closure database.
+  void applyUpdate(const size_t update_idx) {
+    const int64_t timestamp_ns =
+        static_cast<int64_t>(update_idx) * kTimeBetweenUpdatesNs;
+    vio::SynchronizedNFrameImu::Ptr nframe_imu =
+        aligned_shared<vio::SynchronizedNFrameImu>();
+    nframe_imu->nframe = aslam::VisualNFrame::createEmptyTestVisualNFrame(
+        ncamera_, timestamp_ns);
+    aslam::VisualFrame& frame = *nframe_imu->nframe->getFrameShared(0u);
+    frame.setKeypointMeasurements(Eigen::Matrix2Xd::Ones(2, 1));
+    frame.setTrackIds(Eigen::VectorXi::Zero(1));
+    // The last IMU measurement of the previous edge is repeated.
+    if (update_idx == 0u) {
+      nframe_imu->imu_timestamps.resize(1, 1);
+      nframe_imu->imu_timestamps << timestamp_ns;
+    } else {
+      nframe_imu->imu_timestamps.resize(1, 2);
+      nframe_imu->imu_timestamps << timestamp_ns - kTimeBetweenUpdatesNs,
+          timestamp_ns;
+    }
+    nframe_imu->imu_measurements.setZero(
+        6, nframe_imu->imu_timestamps.cols());
+
+    vio::VioUpdate update;
+    update.timestamp_ns = timestamp_ns;
+    update.vio_state = vio::EstimatorState::kRunning;
+    update.vio_update_type = vio::UpdateType::kNormalUpdate;
+    update.keyframe_and_imudata = nframe_imu;
+    update.vinode.set_T_M_I(
+        aslam::Transformation(
+            aslam::Position3D(0.1 * update_idx, 0.0, 0.0),
+            aslam::Quaternion()));
+    update.localization_state = vio::LocalizationState::kUninitialized;
+    std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
+    map_builder_->apply(update);
+  }
+
+  // Returns the number of vertices along the graph that observe a landmark,
+  // all of them have to come before the ones that don't.
+  size_t getNumVerticesWithLandmarks(vi_map::LandmarkIdSet* landmark_ids) {
+    CHECK_NOTNULL(landmark_ids)->clear();
+    const vi_map::VIMap& map = map_with_mutex_->vi_map;
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMissionAlongGraph(
+        map_builder_->getMissionId(), &vertex_ids);
+    size_t num_vertices_with_landmarks = 0u;
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      vi_map::LandmarkIdList observed_landmark_ids;
+      map.getVertex(vertex_id).getAllObservedLandmarkIds(
+          &observed_landmark_ids);
+      if (observed_landmark_ids.empty() ||
+          !observed_landmark_ids.front().isValid()) {
+        break;
+      }
+      landmark_ids->insert(observed_landmark_ids.front());
+      ++num_vertices_with_landmarks;
+    }
+    return num_vertices_with_landmarks;
+  }
+
+  static constexpr int64_t kTimeBetweenUpdatesNs = 100000000;
+  static constexpr size_t kNumHeldBackVertices = 2u;
+
+  aslam::NCamera::Ptr ncamera_;
+  VIMapWithMutex::Ptr map_with_mutex_;
+  std::unique_ptr<online_map_builders::StreamMapBuilder> map_builder_;
+  std::unique_ptr<OnlineLoopClosure> online_loop_closure_;
+};
+
+constexpr int64_t OnlineLoopClosureTest::kTimeBetweenUpdatesNs;
+constexpr size_t OnlineLoopClosureTest::kNumHeldBackVertices;
+
+TEST_F(OnlineLoopClosureTest, ProcessesOnlySettledVertices) {
+  // Nothing has settled yet.
+  for (size_t update_idx = 0u; update_idx < kNumHeldBackVertices;
+       ++update_idx) {
+    applyUpdate(update_idx);
+  }
+  online_loop_closure_->processSettledVertices();
+  vi_map::LandmarkIdSet landmark_ids;
+  EXPECT_EQ(getNumVerticesWithLandmarks(&landmark_ids), 0u);
+  EXPECT_EQ(map_with_mutex_->vi_map.numLandmarks(), 0u);
+
+  constexpr size_t kNumUpdates = 6u;
+  for (size_t update_idx = kNumHeldBackVertices; update_idx < kNumUpdates;
+       ++update_idx) {
+    applyUpdate(update_idx);
+  }
+  online_loop_closure_->processSettledVertices();
+  EXPECT_EQ(
+      getNumVerticesWithLandmarks(&landmark_ids),
+      kNumUpdates - kNumHeldBackVertices);
+  EXPECT_EQ(landmark_ids.size(), 1u);
+  EXPECT_EQ(map_with_mutex_->vi_map.numLandmarks(), 1u);
+
+  // Processing again without new vertices changes nothing.
+  online_loop_closure_->processSettledVertices();
+  EXPECT_EQ(
+      getNumVerticesWithLandmarks(&landmark_ids),
+      kNumUpdates - kNumHeldBackVertices);
+  EXPECT_EQ(map_with_mutex_->vi_map.numLandmarks(), 1u);
+}
+
+TEST_F(OnlineLoopClosureTest, ContinuesFeatureTracksOfProcessedVertices) {
+  constexpr size_t kNumUpdates = 5u;
+  for (size_t update_idx = 0u; update_idx < kNumUpdates; ++update_idx) {
+    applyUpdate(update_idx);
+  }
+  online_loop_closure_->processSettledVertices();
+  vi_map::LandmarkIdSet landmark_ids;
+  EXPECT_EQ(
+      getNumVerticesWithLandmarks(&landmark_ids),
+      kNumUpdates - kNumHeldBackVertices);
+
+  // The track continues in the new vertices, so they observe the landmark
+  // that was created in the previous cycle.
+  constexpr size_t kNumMoreUpdates = 4u;
+  for (size_t update_idx = kNumUpdates;
+       update_idx < kNumUpdates + kNumMoreUpdates; ++update_idx) {
+    applyUpdate(update_idx);
+  }
+  online_loop_closure_->processSettledVertices();
+  vi_map::LandmarkIdSet landmark_ids_after;
+  EXPECT_EQ(
+      getNumVerticesWithLandmarks(&landmark_ids_after),
+      kNumUpdates + kNumMoreUpdates - kNumHeldBackVertices);
+  EXPECT_EQ(landmark_ids_after, landmark_ids);
+  EXPECT_EQ(map_with_mutex_->vi_map.numLandmarks(), 1u);
+
+  // The remaining vertices are processed once the map is finished.
+  {
+    std::lock_guard<std::mutex> lock(map_with_mutex_->mutex);
+    online_loop_closure_->initializeLandmarksOfRemainingVertices();
+  }
+  EXPECT_EQ(
+      getNumVerticesWithLandmarks(&landmark_ids_after),
+      kNumUpdates + kNumMoreUpdates);
+  EXPECT_EQ(landmark_ids_after, landmark_ids);
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
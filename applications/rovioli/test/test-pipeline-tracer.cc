@@ -0,0 +1,42 @@
+#include <fstream>  // NOLINT
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vio-common/pipeline-trace.h>
+
+#include "rovioli/pipeline-tracer.h"
+
+namespace rovioli {
+
+TEST(PipelineTracerTest, RecordsStagesOfAllTraces) {
+  PipelineTracer tracer;
+  constexpr int64_t kStartNs = 1000000;
+  vio::PipelineTrace trace_a(10, kStartNs, &tracer);
+  vio::PipelineTrace trace_b(20, kStartNs, &tracer);
+  trace_a.addStage("synchronizer", kStartNs, kStartNs + 1000000);
+  trace_a.addStage("tracking", kStartNs + 2000000, kStartNs + 5000000);
+  trace_b.addStage("synchronizer", kStartNs, kStartNs + 3000000);
+  EXPECT_EQ(3u, tracer.getNumRecordedStages());
+
+  const std::string summary = tracer.printSummary();
+  EXPECT_NE(std::string::npos, summary.find("synchronizer (2 nframes)"));
+  EXPECT_NE(std::string::npos, summary.find("tracking (1 nframes)"));
+
+  const std::string kTraceFile = "pipeline_trace.json";
+  ASSERT_TRUE(tracer.writeChromeTrace(kTraceFile));
+  std::ifstream trace_file(kTraceFile);
+  std::stringstream trace_json;
+  trace_json << trace_file.rdbuf();
+  const std::string json = trace_json.str();
+  EXPECT_EQ(0u, json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"tracking\""));
+  EXPECT_NE(std::string::npos, json.find("\"capture_timestamp_ns\":20"));
+  // The tracking stage ends 5 ms after the nframe entered the pipeline.
+  EXPECT_NE(std::string::npos, json.find("\"latency_ms\":5.000"));
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,69 @@
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "rovioli/rovio-estimate-pool.h"
+
+namespace rovioli {
+
+TEST(RovioEstimatePoolTest, ReleasedEstimatesAreReused) {
+  constexpr size_t kMaxNumFreeEstimates = 2u;
+  RovioEstimatePool pool(kMaxNumFreeEstimates);
+
+  const RovioEstimate* estimate_address;
+  const double* covariance_data;
+  {
+    RovioEstimate::Ptr estimate = pool.acquire();
+    estimate->filter_covariance.setIdentity(30, 30);
+    estimate_address = estimate.get();
+    covariance_data = estimate->filter_covariance.data();
+    RovioEstimate::ConstPtr estimate_copy = estimate;
+    estimate.reset();
+    EXPECT_EQ(pool.getNumFreeEstimates(), 0u);
+  }
+  EXPECT_EQ(pool.getNumFreeEstimates(), 1u);
+
+  RovioEstimate::Ptr estimate = pool.acquire();
+  EXPECT_EQ(estimate.get(), estimate_address);
+  EXPECT_EQ(pool.getNumFreeEstimates(), 0u);
+  // Assigning a covariance of the same size doesn't reallocate.
+  estimate->filter_covariance = Eigen::MatrixXd::Zero(30, 30);
+  EXPECT_EQ(estimate->filter_covariance.data(), covariance_data);
+
+  // Only kMaxNumFreeEstimates estimates are kept.
+  {
+    std::vector<RovioEstimate::Ptr> estimates;
+    for (int estimate_idx = 0; estimate_idx < 3; ++estimate_idx) {
+      estimates.emplace_back(pool.acquire());
+    }
+  }
+  EXPECT_EQ(pool.getNumFreeEstimates(), kMaxNumFreeEstimates);
+}
+
+TEST(RovioEstimatePoolTest, TracesAreReleased) {
+  RovioEstimatePool pool(1u);
+  RovioEstimate::Ptr estimate = pool.acquire();
+  const vio::PipelineTrace::Ptr trace =
+      std::make_shared<vio::PipelineTrace>(0, 0, nullptr);
+  estimate->trace = trace;
+  estimate.reset();
+  EXPECT_EQ(trace.use_count(), 1);
+  EXPECT_TRUE(pool.acquire()->trace == nullptr);
+}
+
+TEST(RovioEstimatePoolTest, EstimatesMayOutliveThePool) {
+  RovioEstimate::Ptr estimate;
+  {
+    RovioEstimatePool pool(1u);
+    estimate = pool.acquire();
+  }
+  estimate->timestamp_s = 1.0;
+  estimate.reset();
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
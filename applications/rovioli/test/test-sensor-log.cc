@@ -0,0 +1,328 @@
+#include <cstdlib>
+#include <fstream>  // NOLINT
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/time.h>
+#include <aslam/frames/visual-frame.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <message-flow/message-dispatcher-fifo.h>
+#include <message-flow/message-flow.h>
+#include <opencv2/core/core.hpp>
+#include <sensors/imu.h>
+#include <vio-common/vio-types.h>
+
+#include "rovioli/datasource-sensor-log.h"
+#include "rovioli/feature-tracking-flow.h"
+#include "rovioli/flow-topics.h"
+#include "rovioli/imu-camera-synchronizer-flow.h"
+#include "rovioli/measurement-completion.h"
+#include "rovioli/sensor-log.h"
+
+DECLARE_uint64(sensor_log_chunk_size_kb);
+DECLARE_double(sensor_log_reorder_window_s);
+DECLARE_bool(vio_sensor_log_deterministic);
+
+namespace rovioli {
+
+class SensorLogTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    file_path_ = "/tmp/test_sensor_log.mlsl";
+    // Many small chunks.
+    FLAGS_sensor_log_chunk_size_kb = 1u;
+    FLAGS_sensor_log_reorder_window_s = 0.1;
+  }
+
+  static vio::ImuMeasurement::Ptr createImu(const int64_t timestamp_ns) {
+    vio::ImuData imu_data;
+    imu_data << 1.0, 2.0, 3.0, 4.0, 5.0, static_cast<double>(timestamp_ns);
+    return vio::ImuMeasurement::Ptr(
+        new vio::ImuMeasurement(timestamp_ns, imu_data));
+  }
+
+  std::string file_path_;
+};
+
+TEST_F(SensorLogTest, RecordsAreReadInTimeOrder) {
+  constexpr size_t kNumImus = 1000u;
+  const int64_t kImuPeriodNs = aslam::time::milliseconds(5);
+  const int64_t kImageDelayNs = aslam::time::milliseconds(50);
+  std::vector<int64_t> image_timestamps_ns;
+  {
+    SensorLogWriter writer(file_path_);
+    for (size_t imu_idx = 0u; imu_idx < kNumImus; ++imu_idx) {
+      const int64_t timestamp_ns = imu_idx * kImuPeriodNs;
+      writer.addImu(createImu(timestamp_ns));
+      // The images arrive later than the IMU measurements of the same time.
+      if (imu_idx % 10u == 0u && timestamp_ns >= kImageDelayNs) {
+        vio::ImageMeasurement::Ptr image(new vio::ImageMeasurement);
+        image->timestamp = timestamp_ns - kImageDelayNs;
+        image->camera_index = 1;
+        image->image = cv::Mat(24, 32, CV_8UC1);
+        cv::randu(image->image, 0, 255);
+        image_timestamps_ns.emplace_back(image->timestamp);
+        writer.addImage(image);
+      }
+    }
+    writer.close();
+    EXPECT_EQ(writer.getNumDroppedMeasurements(), 0u);
+  }
+
+  SensorLogReader reader;
+  ASSERT_TRUE(reader.open(file_path_));
+  EXPECT_GT(reader.getNumChunks(), 1u);
+  EXPECT_EQ(reader.getNumRecords(), kNumImus + image_timestamps_ns.size());
+  EXPECT_EQ(reader.getFirstTimestampNs(), 0);
+  EXPECT_EQ(
+      reader.getLastTimestampNs(),
+      static_cast<int64_t>((kNumImus - 1u) * kImuPeriodNs));
+
+  sensor_log::Record record;
+  int64_t previous_timestamp_ns = -1;
+  size_t num_imus = 0u;
+  size_t num_images = 0u;
+  while (reader.readNext(&record)) {
+    EXPECT_GE(record.header.timestamp_ns, previous_timestamp_ns);
+    previous_timestamp_ns = record.header.timestamp_ns;
+    if (record.header.type == sensor_log::RecordType::kImu) {
+      const vio::ImuMeasurement::Ptr imu = sensor_log::decodeImu(record);
+      EXPECT_EQ(imu->timestamp, record.header.timestamp_ns);
+      EXPECT_EQ(imu->imu_data(5), static_cast<double>(imu->timestamp));
+      ++num_imus;
+    } else {
+      const vio::ImageMeasurement::Ptr image = sensor_log::decodeImage(record);
+      EXPECT_EQ(image->timestamp, image_timestamps_ns[num_images]);
+      EXPECT_EQ(image->camera_index, 1);
+      EXPECT_EQ(image->image.rows, 24);
+      EXPECT_EQ(image->image.cols, 32);
+      EXPECT_EQ(image->image.type(), CV_8UC1);
+      ++num_images;
+    }
+  }
+  EXPECT_EQ(num_imus, kNumImus);
+  EXPECT_EQ(num_images, image_timestamps_ns.size());
+}
+
+TEST_F(SensorLogTest, SeekFindsFirstRecordAtOrAfterTime) {
+  constexpr size_t kNumImus = 500u;
+  const int64_t kImuPeriodNs = aslam::time::milliseconds(5);
+  {
+    SensorLogWriter writer(file_path_);
+    for (size_t imu_idx = 0u; imu_idx < kNumImus; ++imu_idx) {
+      writer.addImu(createImu(imu_idx * kImuPeriodNs));
+    }
+  }
+
+  SensorLogReader reader;
+  ASSERT_TRUE(reader.open(file_path_));
+  sensor_log::Record record;
+  reader.seek(123 * kImuPeriodNs + 1);
+  ASSERT_TRUE(reader.readNext(&record));
+  EXPECT_EQ(record.header.timestamp_ns, 124 * kImuPeriodNs);
+
+  reader.seek(0);
+  ASSERT_TRUE(reader.readNext(&record));
+  EXPECT_EQ(record.header.timestamp_ns, 0);
+
+  reader.seek(kNumImus * kImuPeriodNs);
+  EXPECT_FALSE(reader.readNext(&record));
+}
+
+TEST_F(SensorLogTest, IncompleteLogIsRejected) {
+  {
+    SensorLogWriter writer(file_path_);
+    writer.addImu(createImu(0));
+  }
+  // Drop the trailer.
+  std::string content;
+  {
+    std::ifstream file(file_path_, std::ios::binary);
+    content.assign(
+        std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(file_path_, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size() - 1u);
+  }
+  SensorLogReader reader;
+  EXPECT_FALSE(reader.open(file_path_));
+}
+
+namespace {
+// The output of the tracker for one nframe. The track ids are numbered in the
+// order they first appear, as the ids themselves are unique across runs.
+struct TrackedNFrame {
+  int64_t timestamp_ns;
+  Eigen::Matrix2Xd keypoints;
+  std::vector<int> track_indices;
+};
+
+// Replays the sensor log through the synchronizer and the tracker. A fake
+// estimator publishes an IMU bias for every IMU measurement, which the tracker
+// uses.
+void replayDeterministically(
+    const std::string& file_path, const aslam::NCamera::Ptr& ncamera,
+    std::vector<TrackedNFrame>* tracked_nframes) {
+  CHECK_NOTNULL(tracked_nframes)->clear();
+  constexpr size_t kNumThreads = 4u;
+  std::unique_ptr<message_flow::MessageFlow> flow(
+      message_flow::MessageFlow::create<message_flow::MessageDispatcherFifo>(
+          kNumThreads));
+  MeasurementCompletion measurement_completion;
+
+  ImuCameraSynchronizerFlow synchronizer_flow(ncamera);
+  synchronizer_flow.setMeasurementCompletion(&measurement_completion);
+  synchronizer_flow.attachToMessageFlow(flow.get());
+  FeatureTrackingFlow tracker_flow(ncamera, vi_map::Imu());
+  tracker_flow.setMeasurementCompletion(&measurement_completion);
+  tracker_flow.attachToMessageFlow(flow.get());
+
+  measurement_completion
+      .registerConsumer<message_flow_topics::IMU_MEASUREMENTS>();
+  const std::function<void(const RovioEstimate::ConstPtr&)> publish_estimate =
+      measurement_completion
+          .wrapPublisher<message_flow_topics::ROVIO_ESTIMATES>(
+              flow->registerPublisher<message_flow_topics::ROVIO_ESTIMATES>());
+  flow->registerSubscriber<message_flow_topics::IMU_MEASUREMENTS>(
+      "FakeEstimator", message_flow::DeliveryOptions(),
+      [&](const vio::ImuMeasurement::ConstPtr& imu) {
+        ScopedMeasurementCompletion completion(&measurement_completion);
+        RovioEstimate::Ptr estimate(new RovioEstimate);
+        estimate->timestamp_s = aslam::time::to_seconds(imu->timestamp);
+        estimate->vinode.setAccBias(Eigen::Vector3d::Zero());
+        estimate->vinode.setGyroBias(
+            Eigen::Vector3d(0.0, 0.0, 1e-3 * estimate->timestamp_s));
+        publish_estimate(estimate);
+      });
+
+  std::mutex m_tracked_nframes;
+  std::unordered_map<int, int> track_indices;
+  flow->registerSubscriber<message_flow_topics::TRACKED_NFRAMES_AND_IMU>(
+      "Test", message_flow::DeliveryOptions(),
+      [&](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+        const aslam::VisualFrame& frame = nframe_imu->nframe->getFrame(0u);
+        TrackedNFrame tracked_nframe;
+        tracked_nframe.timestamp_ns =
+            nframe_imu->nframe->getMinTimestampNanoseconds();
+        tracked_nframe.keypoints = frame.getKeypointMeasurements();
+        std::lock_guard<std::mutex> lock(m_tracked_nframes);
+        const Eigen::VectorXi& track_ids = frame.getTrackIds();
+        for (int idx = 0; idx < track_ids.size(); ++idx) {
+          if (track_ids(idx) < 0) {
+            tracked_nframe.track_indices.emplace_back(-1);
+            continue;
+          }
+          tracked_nframe.track_indices.emplace_back(
+              track_indices.emplace(track_ids(idx), track_indices.size())
+                  .first->second);
+        }
+        tracked_nframes->emplace_back(tracked_nframe);
+      });
+
+  DataSourceSensorLog data_source(file_path);
+  data_source.registerImageCallback(
+      measurement_completion
+          .wrapPublisher<message_flow_topics::IMAGE_MEASUREMENTS>(
+              flow->registerPublisher<
+                  message_flow_topics::IMAGE_MEASUREMENTS>()));
+  data_source.registerImuCallback(
+      measurement_completion
+          .wrapPublisher<message_flow_topics::IMU_MEASUREMENTS>(
+              flow->registerPublisher<
+                  message_flow_topics::IMU_MEASUREMENTS>()));
+  data_source.setWaitUntilProcessedFunction([&measurement_completion]() {
+    measurement_completion.waitUntilAllCompleted();
+  });
+  std::promise<void> end_of_data;
+  data_source.registerEndOfDataCallback(
+      [&end_of_data]() { end_of_data.set_value(); });
+
+  data_source.startStreaming();
+  end_of_data.get_future().wait();
+  data_source.shutdown();
+  synchronizer_flow.shutdown();
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+}  // namespace
+
+TEST_F(SensorLogTest, DeterministicPlaybackIsReproducible) {
+  FLAGS_vio_sensor_log_deterministic = true;
+  const aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(1u);
+  const aslam::Camera& camera = ncamera->getCamera(0u);
+
+  // The camera moves over a random texture.
+  constexpr size_t kNumImages = 30u;
+  constexpr int kShiftPerImagePx = 2;
+  cv::theRNG().state = 42u;
+  cv::Mat texture(
+      camera.imageHeight(),
+      camera.imageWidth() + kNumImages * kShiftPerImagePx, CV_8UC1);
+  cv::randu(texture, 0, 255);
+  const int64_t kImagePeriodNs = aslam::time::milliseconds(100);
+  const int64_t kImuPeriodNs = aslam::time::milliseconds(5);
+  {
+    SensorLogWriter writer(file_path_);
+    for (int64_t timestamp_ns = 0;
+         timestamp_ns <= static_cast<int64_t>(kNumImages) * kImagePeriodNs;
+         timestamp_ns += kImuPeriodNs) {
+      // A camera that doesn't rotate.
+      vio::ImuData imu_data;
+      imu_data << 0.0, 0.0, 9.81, 0.0, 0.0, 0.0;
+      writer.addImu(
+          vio::ImuMeasurement::Ptr(
+              new vio::ImuMeasurement(timestamp_ns, imu_data)));
+      if (timestamp_ns % kImagePeriodNs == 0 &&
+          timestamp_ns < static_cast<int64_t>(kNumImages) * kImagePeriodNs) {
+        const int image_idx = static_cast<int>(timestamp_ns / kImagePeriodNs);
+        vio::ImageMeasurement::Ptr image(new vio::ImageMeasurement);
+        image->timestamp = timestamp_ns;
+        image->camera_index = 0;
+        image->image =
+            texture(
+                cv::Rect(
+                    image_idx * kShiftPerImagePx, 0, camera.imageWidth(),
+                    camera.imageHeight()))
+                .clone();
+        writer.addImage(image);
+      }
+    }
+    writer.close();
+    ASSERT_EQ(writer.getNumDroppedMeasurements(), 0u);
+  }
+
+  // The outlier rejection of the tracker draws random samples.
+  constexpr unsigned int kSeed = 5u;
+  std::srand(kSeed);
+  std::vector<TrackedNFrame> first_run;
+  replayDeterministically(file_path_, ncamera, &first_run);
+  std::srand(kSeed);
+  std::vector<TrackedNFrame> second_run;
+  replayDeterministically(file_path_, ncamera, &second_run);
+  FLAGS_vio_sensor_log_deterministic = false;
+
+  // No nframe is dropped, apart from the skipped first one and the first one
+  // of the tracker.
+  ASSERT_EQ(first_run.size(), kNumImages - 2u);
+  ASSERT_EQ(second_run.size(), first_run.size());
+  for (size_t idx = 0u; idx < first_run.size(); ++idx) {
+    EXPECT_EQ(first_run[idx].timestamp_ns, second_run[idx].timestamp_ns);
+    ASSERT_EQ(
+        first_run[idx].keypoints.cols(), second_run[idx].keypoints.cols());
+    EXPECT_TRUE(first_run[idx].keypoints == second_run[idx].keypoints);
+    EXPECT_EQ(first_run[idx].track_indices, second_run[idx].track_indices);
+  }
+}
+
+}  // namespace rovioli
+
+MAPLAB_UNITTEST_ENTRYPOINT
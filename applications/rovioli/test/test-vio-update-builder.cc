@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <aslam/cameras/ncamera.h>
 #include <aslam/frames/visual-nframe.h>
 #include <gtest/gtest.h>
@@ -13,6 +15,7 @@ class VioUpdateBuilderTest : public ::testing::Test {
     vio_update_builder_.registerVioUpdatePublishFunction(
         [this](const vio::VioUpdate::ConstPtr& update) {
           received_vio_update_ = update;
+          received_timestamps_ns_.push_back(update->timestamp_ns);
         });
 
     // Send dummy ViNodeStates.
@@ -23,6 +26,7 @@ class VioUpdateBuilderTest : public ::testing::Test {
     }
 
     ASSERT_TRUE(received_vio_update_ == nullptr);
+    ASSERT_TRUE(received_timestamps_ns_.empty());
 
     constexpr size_t kNumCameras = 1u;
     n_camera_ = aslam::NCamera::createTestNCamera(kNumCameras);
@@ -48,8 +52,18 @@ class VioUpdateBuilderTest : public ::testing::Test {
     vio_update_builder_.processRovioEstimate(rovio_estimate);
   }
 
+  void addSyncedNFrameToVioUpdateBuilder(const int64_t timestamp_ns) {
+    vio::SynchronizedNFrameImu::Ptr synced_nframe_imu =
+        aligned_shared<vio::SynchronizedNFrameImu>();
+    synced_nframe_imu->nframe =
+        aslam::VisualNFrame::createEmptyTestVisualNFrame(
+            n_camera_, timestamp_ns);
+    vio_update_builder_.processSynchronizedNFrameImu(synced_nframe_imu);
+  }
+
   VioUpdateBuilder vio_update_builder_;
   vio::VioUpdate::ConstPtr received_vio_update_;
+  std::vector<int64_t> received_timestamps_ns_;
   aslam::NCamera::Ptr n_camera_;
 };
 
@@ -114,6 +128,53 @@ TEST_F(VioUpdateBuilderTest, VioUpdateBuilderTest) {
   }
 }
 
+TEST_F(VioUpdateBuilderTest, QueuedNFramesArePublishedInOrder) {
+  // The nframes arrive before the estimates they need for interpolation.
+  const std::vector<int64_t> nframe_timestamps_ns = {
+      static_cast<int64_t>(505e6), static_cast<int64_t>(515e6),
+      static_cast<int64_t>(520e6)};
+  for (const int64_t timestamp_ns : nframe_timestamps_ns) {
+    addSyncedNFrameToVioUpdateBuilder(timestamp_ns);
+  }
+  EXPECT_TRUE(received_timestamps_ns_.empty());
+
+  // A single estimate may complete the matches of several queued nframes.
+  addViNodeToVioUpdateBuilder(520e6);
+  EXPECT_EQ(nframe_timestamps_ns, received_timestamps_ns_);
+  ASSERT_TRUE(received_vio_update_ != nullptr);
+  EXPECT_EQ(
+      nframe_timestamps_ns.back(),
+      received_vio_update_->vinode.get_T_M_I().getPosition()[0]);
+}
+
+TEST_F(VioUpdateBuilderTest, OutdatedLocalizationResultsAreDropped) {
+  vio::LocalizationResult::Ptr tracking_result(new vio::LocalizationResult);
+  tracking_result->timestamp = 100e6;
+  tracking_result->localization_type =
+      vio::LocalizationResult::LocalizationMode::kMapTracking;
+  vio_update_builder_.processLocalizationResult(tracking_result);
+
+  // Completed after the newer result.
+  vio::LocalizationResult::Ptr global_result(new vio::LocalizationResult);
+  global_result->timestamp = 50e6;
+  global_result->localization_type =
+      vio::LocalizationResult::LocalizationMode::kGlobal;
+  vio_update_builder_.processLocalizationResult(global_result);
+
+  addSyncedNFrameToVioUpdateBuilder(110e6);
+  ASSERT_TRUE(received_vio_update_ != nullptr);
+  EXPECT_EQ(
+      vio::LocalizationState::kMapTracking,
+      received_vio_update_->localization_state);
+
+  vio_update_builder_.processLocalizationResult(global_result);
+  addSyncedNFrameToVioUpdateBuilder(120e6);
+  ASSERT_TRUE(received_vio_update_ != nullptr);
+  EXPECT_EQ(
+      vio::LocalizationState::kUninitialized,
+      received_vio_update_->localization_state);
+}
+
 }  // namespace rovioli
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,28 +1,39 @@
 #ifndef MAP_MANAGER_MAP_MANAGER_INL_H_
 #define MAP_MANAGER_MAP_MANAGER_INL_H_
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>    // NOLINT
 #include <iostream>  // NOLINT
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>  // NOLINT
+#include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <aslam/common/reader-writer-lock.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <maplab-common/accessors.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/map-traits.h>
+#include <maplab-common/multi-threaded-progress-bar.h>
+#include <maplab-common/parallel-process.h>
 #include <maplab-common/proto-serialization-helper.h>
 #include <maplab-common/text-formatting.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "map-manager/map-manager.h"
 #include "map-manager/map-storage.h"
 
+DECLARE_int32(map_manager_memory_budget_mb);
+DECLARE_string(map_manager_scratch_folder);
+
 namespace backend {
 
 template <typename MapType>
@@ -30,28 +41,40 @@ MapManager<MapType>::MapManager()
     : map_storage_(CHECK_NOTNULL(MapStorage<MapType>::getInstance())) {}
 
 template <typename MapType>
-MapType* MapManager<MapType>::getMapMutable(const std::string& key) {
-  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
-  return map_storage_->getMapMutable(key);
+typename MapManager<MapType>::MutablePinnedMap
+MapManager<MapType>::getMapMutable(const std::string& key) {
+  ResidentMapsReadLock lock(this, {key});
+  MapType* map = map_storage_->getMapMutable(key);
+  // Maps are only paged out while the storage is write locked, so the map
+  // stays resident from here on.
+  return MutablePinnedMap(map, &map_storage_->findMapAndMutex(key)->num_pins);
 }
 
 template <typename MapType>
-const MapType& MapManager<MapType>::getMap(const std::string& key) const {
-  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
-  return map_storage_->getMap(key);
+typename MapManager<MapType>::ConstPinnedMap MapManager<MapType>::getMap(
+    const std::string& key) const {
+  ResidentMapsReadLock lock(this, {key});
+  const MapType& map = map_storage_->getMap(key);
+  return ConstPinnedMap(&map, &map_storage_->findMapAndMutex(key)->num_pins);
 }
 
 template <typename MapType>
 typename MapManager<MapType>::MapWriteAccess
 MapManager<MapType>::getMapWriteAccess(const std::string& key) {
-  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
-  return map_storage_->getMapWriteAccess(key);
+  ResidentMapsReadLock lock(this, {key});
+  MapWriteAccess map = map_storage_->getMapWriteAccess(key);
+  // No other access exists while the write access is held, except for the
+  // unlocked handles of getMap() and getMapMutable().
+  if (map_storage_->findMapAndMutex(key)->num_pins == 0u) {
+    traits<MapType>::releaseUnreferencedMemory(map.get());
+  }
+  return map;
 }
 
 template <typename MapType>
 typename MapManager<MapType>::MapReadAccess
 MapManager<MapType>::getMapReadAccess(const std::string& key) const {
-  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
+  ResidentMapsReadLock lock(this, {key});
   return map_storage_->getMapReadAccess(key);
 }
 
@@ -95,8 +118,11 @@ size_t MapManager<MapType>::numberOfMaps() const {
 template <typename MapType>
 void MapManager<MapType>::addMap(
     const std::string& key, AlignedUniquePtr<MapType>& map) {  // NOLINT
-  aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
-  map_storage_->addMap(key, map);
+  {
+    aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+    map_storage_->addMap(key, map);
+  }
+  pageOutMapsOverBudget({key});
 }
 
 template <typename MapType>
@@ -108,17 +134,32 @@ AlignedUniquePtr<MapType> MapManager<MapType>::releaseMap(
     map_and_mutex = map_storage_->releaseMapAndMutex(key);
   }
 
-  // Wait until map mutex is no longer in use anywhere.
-  while (map_and_mutex->map_mutex.isInUse()) {
+  // Wait until map mutex and handles are no longer in use anywhere.
+  while (map_and_mutex->map_mutex.isInUse() || map_and_mutex->num_pins > 0u) {
     constexpr size_t kSleepTimeMs = 50u;
     std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
   }
+  // The scratch folder is removed with the map handle.
+  if (map_and_mutex->map == nullptr) {
+    map_and_mutex->map = loadMapFromScratchFolder(key, *map_and_mutex);
+  }
   return std::move(map_and_mutex->map);
 }
 
 template <typename MapType>
 void MapManager<MapType>::deleteMap(const std::string& key) {
-  releaseMap(key);
+  std::unique_ptr<MapAndMutex> map_and_mutex;
+  {
+    aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+    map_and_mutex = map_storage_->releaseMapAndMutex(key);
+  }
+
+  // Wait until map mutex and handles are no longer in use anywhere. A paged
+  // out map is removed from the scratch folder without loading it.
+  while (map_and_mutex->map_mutex.isInUse() || map_and_mutex->num_pins > 0u) {
+    constexpr size_t kSleepTimeMs = 50u;
+    std::this_thread::sleep_for(std::chrono::milliseconds(kSleepTimeMs));
+  }
 }
 
 template <typename MapType>
@@ -131,7 +172,7 @@ void MapManager<MapType>::renameMap(
 template <typename MapType>
 void MapManager<MapType>::copyMap(
     const std::string& source_key, const std::string& target_key) {
-  map_storage_->getContainerMutex()->acquireReadLock();
+  acquireReadLockWithResidentMaps({source_key});
   CHECK(map_storage_->hasMap(source_key)) << "Source map key \"" << source_key
                                           << "\" doesn't exist.";
   MapReadAccess source_map = map_storage_->getMapReadAccess(source_key);
@@ -141,10 +182,13 @@ void MapManager<MapType>::copyMap(
   traits<MapType>::deepCopy(*source_map, target_map.get());
 
   // Add copied map to storage.
-  aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
-  CHECK(!map_storage_->hasMap(target_key)) << "Target map key \"" << target_key
-                                           << "\" already exists.";
-  map_storage_->addMap(target_key, target_map);
+  {
+    aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+    CHECK(!map_storage_->hasMap(target_key))
+        << "Target map key \"" << target_key << "\" already exists.";
+    map_storage_->addMap(target_key, target_map);
+  }
+  pageOutMapsOverBudget({target_key});
 }
 
 template <typename MapType>
@@ -154,7 +198,8 @@ void MapManager<MapType>::mergeMaps(
   CHECK(source_key_merge_base != source_key_merge_from)
       << "Cannot merge maps because the two map keys are identical (\""
       << source_key_merge_base << "\").";
-  map_storage_->getContainerMutex()->acquireReadLock();
+  acquireReadLockWithResidentMaps(
+      {source_key_merge_base, source_key_merge_from});
   for (const std::string& source_key :
        {std::ref(source_key_merge_base), std::ref(source_key_merge_from)}) {
     CHECK(map_storage_->hasMap(source_key)) << "Source map key \"" << source_key
@@ -198,13 +243,16 @@ bool MapManager<MapType>::loadMapFromFolder(
     return false;
   }
 
-  aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
-  if (map_storage_->hasMap(key_in)) {
-    LOG(ERROR) << "Map with the key \"" << key_in
-               << "\" already exists in the storage!";
-    return false;
+  {
+    aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+    if (map_storage_->hasMap(key_in)) {
+      LOG(ERROR) << "Map with the key \"" << key_in
+                 << "\" already exists in the storage!";
+      return false;
+    }
+    map_storage_->addMap(key_in, map);
   }
-  map_storage_->addMap(key_in, map);
+  pageOutMapsOverBudget({key_in});
 
   return true;
 }
@@ -306,7 +354,6 @@ bool MapManager<MapType>::loadAllMapsFromFolder(
   }
   VLOG(1) << maps_to_load_ss.str() << "\n";
 
-  aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
   std::unordered_set<std::string> key_set;
   for (const std::string& map_key : key_list) {
     if (!key_set.emplace(map_key).second) {
@@ -314,32 +361,82 @@ bool MapManager<MapType>::loadAllMapsFromFolder(
                  << folder_path << ". No maps will be loaded.";
       return false;
     }
-    if (map_storage_->hasMap(map_key)) {
+    CHECK(isKeyValid(map_key));
+    if (hasMap(map_key)) {
       LOG(ERROR) << "No maps will be loaded because a map with key \""
                  << map_key << "\" already exists in the storage.";
       return false;
     }
   }
 
-  if (new_keys != nullptr) {
-    new_keys->insert(key_list.cbegin(), key_list.cend());
+  // Load all maps in parallel. The storage isn't locked meanwhile, so the
+  // other maps stay accessible. With a memory budget, every map is added as
+  // soon as it's loaded, such that the others can be paged out.
+  CHECK_EQ(map_list.size(), key_list.size());
+  const bool add_while_loading = FLAGS_map_manager_memory_budget_mb > 0;
+  std::vector<AlignedUniquePtr<MapType>> maps(map_list.size());
+  std::atomic<bool> all_maps_added(true);
+  common::MultiThreadedProgressBar progress_bar;
+  auto load_maps = [&](const std::vector<size_t>& range) {
+    size_t num_loaded = 0u;
+    for (const size_t map_idx : range) {
+      const std::string& map_folder = map_list[map_idx];
+      CHECK(!map_folder.empty());
+      maps[map_idx] = aligned_unique<MapType>();
+      CHECK(traits<MapType>::loadFromFolder(map_folder, maps[map_idx].get()))
+          << "Loading map " << map_folder << " failed.";
+      VLOG(1) << "Loaded map " << key_list[map_idx];
+      if (add_while_loading) {
+        const std::string& map_key = key_list[map_idx];
+        bool map_added = false;
+        {
+          aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+          if (map_storage_->hasMap(map_key)) {
+            LOG(ERROR) << "Map \"" << map_key << "\" won't be added because "
+                       << "a map with this key was added while loading.";
+            all_maps_added = false;
+          } else {
+            map_storage_->addMap(map_key, maps[map_idx]);
+            map_added = true;
+          }
+        }
+        if (map_added) {
+          pageOutMapsOverBudget({map_key});
+        }
+      }
+      progress_bar.update(++num_loaded, range.size());
+    }
+  };
+  constexpr bool kAlwaysParallelize = true;
+  const size_t num_threads =
+      std::min(map_list.size(), common::getNumHardwareThreads());
+  common::ParallelProcess(
+      map_list.size(), load_maps, kAlwaysParallelize, num_threads);
+
+  if (add_while_loading) {
+    for (size_t i = 0u; i < map_list.size(); ++i) {
+      if (new_keys != nullptr && maps[i] == nullptr) {
+        new_keys->emplace(key_list[i]);
+      }
+    }
+    return all_maps_added;
   }
 
-  // Load and insert all maps.
-  CHECK_EQ(map_list.size(), key_list.size());
+  // Another command may have added a map with one of the keys in the
+  // meantime.
+  aslam::ScopedWriteLock lock(map_storage_->getContainerMutex());
+  for (const std::string& map_key : key_list) {
+    if (map_storage_->hasMap(map_key)) {
+      LOG(ERROR) << "No maps will be added because a map with key \""
+                 << map_key << "\" was added to the storage while loading.";
+      return false;
+    }
+  }
   for (size_t i = 0u; i < map_list.size(); ++i) {
-    const std::string& map_folder = map_list[i];
-    const std::string& key_name = key_list[i];
-    CHECK(!map_folder.empty());
-    CHECK(!key_name.empty());
-    CHECK(isKeyValid(key_name));
-    CHECK(!map_storage_->hasMap(key_name));
-
-    AlignedUniquePtr<MapType> map = aligned_unique<MapType>();
-    CHECK(traits<MapType>::loadFromFolder(map_folder, map.get()))
-        << "Loading map " << map_folder << " failed.";
-    map_storage_->addMap(key_name, map);
-    VLOG(1) << "Loaded map " << key_name;
+    map_storage_->addMap(key_list[i], maps[i]);
+  }
+  if (new_keys != nullptr) {
+    new_keys->insert(key_list.cbegin(), key_list.cend());
   }
   return true;
 }
@@ -358,7 +455,7 @@ bool MapManager<MapType>::saveMapToFolder(
   CHECK(!key.empty());
   CHECK(!folder_path.empty());
 
-  map_storage_->getContainerMutex()->acquireReadLock();
+  acquireReadLockWithResidentMaps({key});
   if (!map_storage_->hasMap(key)) {
     map_storage_->getContainerMutex()->releaseReadLock();
     LOG(ERROR) << "Map with key \"" << key << "\" doesn't exist.";
@@ -403,11 +500,12 @@ bool MapManager<MapType>::saveAllMapsToFolder(
   }
 
   // Get all map keys.
-  aslam::ScopedReadLock lock(map_storage_->getContainerMutex());
+  map_storage_->getContainerMutex()->acquireReadLock();
   std::unordered_set<std::string> all_map_keys_list;
   map_storage_->getAllMapKeys(&all_map_keys_list);
 
   if (all_map_keys_list.empty()) {
+    map_storage_->getContainerMutex()->releaseReadLock();
     LOG(ERROR) << "No maps stored that could be saved.";
     return false;
   }
@@ -419,16 +517,23 @@ bool MapManager<MapType>::saveAllMapsToFolder(
     std::string complete_folder_path;
     if (folder_path.empty()) {
       // If the map gets saved into the map folder, there is no need to append
-      // the key.
-      typename common::Monitor<MapType>::ReadAccess map =
-          map_storage_->getMapReadAccess(key);
-      if (!traits<MapType>::hasMapFolder(*map)) {
-        LOG(ERROR) << "Can't save map \"" << key
-                   << "\" to map folder because it doesn't have a map folder "
-                      "associated with it.";
-        return false;
+      // the key. Paged out maps always have a map folder. Maps in transit
+      // are locked until the transit finished.
+      const MapAndMutex* map_handle = map_storage_->findMapAndMutex(key);
+      if (map_handle->map == nullptr || map_handle->in_transit) {
+        complete_folder_path = map_handle->map_folder;
+      } else {
+        typename common::Monitor<MapType>::ReadAccess map =
+            map_storage_->getMapReadAccess(key);
+        if (!traits<MapType>::hasMapFolder(*map)) {
+          map_storage_->getContainerMutex()->releaseReadLock();
+          LOG(ERROR) << "Can't save map \"" << key
+                     << "\" to map folder because it doesn't have a map "
+                        "folder associated with it.";
+          return false;
+        }
+        traits<MapType>::getMapFolder(*map, &complete_folder_path);
       }
-      traits<MapType>::getMapFolder(*map, &complete_folder_path);
     } else {
       common::concatenateFolderAndFileName(
           folder_path, key, &complete_folder_path);
@@ -442,19 +547,43 @@ bool MapManager<MapType>::saveAllMapsToFolder(
     if (!config.overwrite_existing_files &&
         (common::pathExists(complete_folder_path) ||
          common::fileExists(complete_folder_path))) {
+      map_storage_->getContainerMutex()->releaseReadLock();
       LOG(ERROR) << "No maps will be saved because this folder \""
                  << complete_folder_path << "\" already contains a map!";
       return false;
     }
   }
+  map_storage_->getContainerMutex()->releaseReadLock();
 
-  // Save all maps.
-  for (const std::string& key : all_map_keys_list) {
-    MapWriteAccess map = map_storage_->getMapWriteAccess(key);
-    CHECK(
-        traits<MapType>::saveToFolder(
-            key_to_folder_map[key], config, map.get()));
-  }
+  // Save all maps in parallel, every map is only locked while it's saved.
+  // Paged out maps are loaded one after the other within the memory budget.
+  const std::vector<std::string> map_keys(
+      all_map_keys_list.cbegin(), all_map_keys_list.cend());
+  common::MultiThreadedProgressBar progress_bar;
+  auto save_maps = [&](const std::vector<size_t>& range) {
+    size_t num_saved = 0u;
+    for (const size_t map_idx : range) {
+      const std::string& key = map_keys[map_idx];
+      acquireReadLockWithResidentMaps({key});
+      if (!map_storage_->hasMap(key)) {
+        map_storage_->getContainerMutex()->releaseReadLock();
+        LOG(WARNING) << "Map \"" << key
+                     << "\" was deleted before it was saved.";
+        continue;
+      }
+      MapWriteAccess map = map_storage_->getMapWriteAccess(key);
+      map_storage_->getContainerMutex()->releaseReadLock();
+      CHECK(
+          traits<MapType>::saveToFolder(
+              common::getChecked(key_to_folder_map, key), config, map.get()));
+      progress_bar.update(++num_saved, range.size());
+    }
+  };
+  constexpr bool kAlwaysParallelize = true;
+  const size_t num_threads =
+      std::min(map_keys.size(), common::getNumHardwareThreads());
+  common::ParallelProcess(
+      map_keys.size(), save_maps, kAlwaysParallelize, num_threads);
 
   return true;
 }
@@ -519,6 +648,233 @@ void MapManager<MapType>::getDefaultMapKeys(
   CHECK_EQ(map_list.size(), key_list->size());
 }
 
+template <typename MapType>
+void MapManager<MapType>::acquireReadLockWithResidentMaps(
+    const std::vector<std::string>& keys) const {
+  aslam::ReaderWriterMutex* container_mutex =
+      map_storage_->getContainerMutex();
+  while (true) {
+    container_mutex->acquireReadLock();
+    bool any_map_in_transit = false;
+    bool all_maps_resident = true;
+    for (const std::string& key : keys) {
+      MapAndMutex* map_handle = map_storage_->findMapAndMutex(key);
+      if (map_handle == nullptr) {
+        // Missing maps are reported by the caller.
+        continue;
+      }
+      if (map_handle->in_transit) {
+        any_map_in_transit = true;
+        break;
+      }
+      if (map_handle->map == nullptr) {
+        all_maps_resident = false;
+        break;
+      }
+      map_handle->last_access_tick = map_storage_->nextAccessTick();
+    }
+    if (!any_map_in_transit && all_maps_resident) {
+      return;
+    }
+    // A transit only finishes with the write lock of the storage.
+    const uint64_t num_finished_transits =
+        map_storage_->getNumFinishedTransits();
+    container_mutex->releaseReadLock();
+
+    // Another thread may page the maps out again before the read lock is
+    // acquired, but they were just accessed and are the last to go.
+    if (any_map_in_transit) {
+      map_storage_->waitForTransit(num_finished_transits);
+    } else {
+      pageInMapsWithinBudget(keys);
+    }
+  }
+}
+
+template <typename MapType>
+void MapManager<MapType>::pageInMapsWithinBudget(
+    const std::vector<std::string>& keys) const {
+  aslam::ReaderWriterMutex* container_mutex =
+      map_storage_->getContainerMutex();
+  std::vector<std::pair<std::string, MapAndMutex*>> maps_to_page_in;
+  {
+    aslam::ScopedWriteLock lock(container_mutex);
+    for (const std::string& key : keys) {
+      MapAndMutex* map_handle = map_storage_->findMapAndMutex(key);
+      if (map_handle != nullptr && map_handle->map == nullptr &&
+          !map_handle->in_transit) {
+        // Nobody else can lock a paged out map.
+        map_handle->in_transit = true;
+        map_handle->map_mutex.acquireWriteLock();
+        maps_to_page_in.emplace_back(key, map_handle);
+      }
+    }
+  }
+
+  for (const std::pair<std::string, MapAndMutex*>& key_and_handle :
+       maps_to_page_in) {
+    MapAndMutex* map_handle = key_and_handle.second;
+    AlignedUniquePtr<MapType> map =
+        loadMapFromScratchFolder(key_and_handle.first, *map_handle);
+    std::string scratch_folder;
+    {
+      aslam::ScopedWriteLock lock(container_mutex);
+      map_handle->map = std::move(map);
+      map_handle->last_access_tick = map_storage_->nextAccessTick();
+      scratch_folder.swap(map_handle->scratch_folder);
+      map_handle->in_transit = false;
+    }
+    common::removePath(scratch_folder);
+    // The map handle may be deleted as soon as the lock is released.
+    map_handle->map_mutex.releaseWriteLock();
+    map_storage_->notifyTransitFinished();
+  }
+  pageOutMapsOverBudget(
+      std::unordered_set<std::string>(keys.begin(), keys.end()));
+}
+
+template <typename MapType>
+void MapManager<MapType>::pageOutMapsOverBudget(
+    const std::unordered_set<std::string>& keys_to_keep) const {
+  if (FLAGS_map_manager_memory_budget_mb <= 0) {
+    return;
+  }
+  aslam::ReaderWriterMutex* container_mutex =
+      map_storage_->getContainerMutex();
+  std::vector<std::pair<std::string, MapAndMutex*>> maps_to_page_out;
+  {
+    aslam::ScopedWriteLock lock(container_mutex);
+    selectMapsToPageOut(keys_to_keep, &maps_to_page_out);
+  }
+
+  for (const std::pair<std::string, MapAndMutex*>& key_and_handle :
+       maps_to_page_out) {
+    MapAndMutex* map_handle = key_and_handle.second;
+    std::string scratch_folder;
+    const bool saved = saveMapToScratchFolder(
+        key_and_handle.first, map_handle, &scratch_folder);
+    // Freed after the locks are released.
+    AlignedUniquePtr<MapType> paged_out_map;
+    {
+      aslam::ScopedWriteLock lock(container_mutex);
+      if (saved) {
+        map_handle->scratch_folder = scratch_folder;
+        paged_out_map = std::move(map_handle->map);
+      }
+      map_handle->in_transit = false;
+    }
+    // The map handle may be deleted as soon as the lock is released.
+    map_handle->map_mutex.releaseWriteLock();
+    map_storage_->notifyTransitFinished();
+  }
+}
+
+template <typename MapType>
+void MapManager<MapType>::selectMapsToPageOut(
+    const std::unordered_set<std::string>& keys_to_keep,
+    std::vector<std::pair<std::string, MapAndMutex*>>* maps_to_page_out)
+    const {
+  CHECK_NOTNULL(maps_to_page_out)->clear();
+  const size_t memory_budget_bytes =
+      static_cast<size_t>(FLAGS_map_manager_memory_budget_mb) * 1024u * 1024u;
+
+  // The memory usage of maps that are in use can't be updated, as they might
+  // be written to. Maps in transit are left to the thread moving them.
+  size_t memory_usage_bytes = 0u;
+  std::vector<std::pair<uint64_t, std::string>> candidates;
+  for (const typename MapStorage<MapType>::MapStorageContainerValueType&
+           key_and_handle : map_storage_->map_storage_container_) {
+    MapAndMutex* map_handle = key_and_handle.second.get();
+    if (map_handle->map == nullptr || map_handle->in_transit) {
+      continue;
+    }
+    const bool is_in_use = map_handle->map_mutex.isInUse();
+    if (!is_in_use) {
+      map_handle->memory_usage_bytes =
+          traits<MapType>::getMemoryUsageBytes(*map_handle->map);
+    }
+    memory_usage_bytes += map_handle->memory_usage_bytes;
+    if (!is_in_use && map_handle->num_pins == 0u &&
+        keys_to_keep.count(key_and_handle.first) == 0u &&
+        traits<MapType>::hasMapFolder(*map_handle->map)) {
+      candidates.emplace_back(
+          map_handle->last_access_tick, key_and_handle.first);
+    }
+  }
+  if (memory_usage_bytes <= memory_budget_bytes) {
+    return;
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  for (const std::pair<uint64_t, std::string>& tick_and_key : candidates) {
+    if (memory_usage_bytes <= memory_budget_bytes) {
+      break;
+    }
+    MapAndMutex* map_handle =
+        CHECK_NOTNULL(map_storage_->findMapAndMutex(tick_and_key.second));
+    // Accesses are only created while the storage is locked, so the lock is
+    // free.
+    map_handle->in_transit = true;
+    map_handle->map_mutex.acquireWriteLock();
+    traits<MapType>::getMapFolder(*map_handle->map, &map_handle->map_folder);
+    maps_to_page_out->emplace_back(tick_and_key.second, map_handle);
+    memory_usage_bytes -= map_handle->memory_usage_bytes;
+  }
+  LOG_IF(WARNING, memory_usage_bytes > memory_budget_bytes)
+      << "The maps in use need " << memory_usage_bytes / (1024u * 1024u)
+      << " MiB, which exceeds the memory budget of "
+      << FLAGS_map_manager_memory_budget_mb << " MiB.";
+}
+
+template <typename MapType>
+bool MapManager<MapType>::saveMapToScratchFolder(
+    const std::string& key, MapAndMutex* map_handle,
+    std::string* scratch_folder) const {
+  CHECK_NOTNULL(map_handle);
+  CHECK_NOTNULL(scratch_folder);
+  CHECK(map_handle->map != nullptr);
+
+  // The key isn't unique over time and other processes may use the same
+  // scratch folder.
+  *scratch_folder = common::concatenateFolderAndFileName(
+      FLAGS_map_manager_scratch_folder,
+      key + "_" + std::to_string(getpid()) + "_" +
+          std::to_string(map_storage_->nextAccessTick()));
+
+  SaveConfig config;
+  config.overwrite_existing_files = true;
+  // Loading from the columnar snapshot is faster, which is what the command
+  // accessing the map waits for.
+  config.save_columnar_snapshot = true;
+  if (!traits<MapType>::saveToFolder(
+          *scratch_folder, config, map_handle->map.get())) {
+    LOG(ERROR) << "Paging out map \"" << key << "\" to " << *scratch_folder
+               << " failed, it stays in memory.";
+    traits<MapType>::resetMapFolder(
+        map_handle->map_folder, map_handle->map.get());
+    common::removePath(*scratch_folder);
+    return false;
+  }
+  VLOG(1) << "Paged out map \"" << key << "\" to " << *scratch_folder << ".";
+  return true;
+}
+
+template <typename MapType>
+AlignedUniquePtr<MapType> MapManager<MapType>::loadMapFromScratchFolder(
+    const std::string& key, const MapAndMutex& map_handle) const {
+  CHECK(map_handle.map == nullptr);
+  CHECK(!map_handle.scratch_folder.empty());
+
+  AlignedUniquePtr<MapType> map = aligned_unique<MapType>();
+  CHECK(traits<MapType>::loadFromFolder(map_handle.scratch_folder, map.get()))
+      << "Paging in map \"" << key << "\" from " << map_handle.scratch_folder
+      << " failed.";
+  // The resources were never moved to the scratch folder.
+  traits<MapType>::resetMapFolder(map_handle.map_folder, map.get());
+  VLOG(1) << "Paged in map \"" << key << "\".";
+  return map;
+}
+
 }  // namespace backend
 
 #endif  // MAP_MANAGER_MAP_MANAGER_INL_H_
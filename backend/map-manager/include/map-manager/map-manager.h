@@ -1,11 +1,15 @@
 #ifndef MAP_MANAGER_MAP_MANAGER_H_
 #define MAP_MANAGER_MAP_MANAGER_H_
 
+#include <atomic>
 #include <string>
 #include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include <aslam/common/reader-writer-lock.h>
+#include <glog/logging.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/monitor.h>
 
@@ -29,14 +33,15 @@ namespace backend {
 /// `vi_map::VIMap`.
 ///
 /// // Get a map.
-/// MapType& map = map_manager.getMap("key_of_map");
+/// backend::MapManager<MapType>::MutablePinnedMap map =
+///     map_manager.getMapMutable("key_of_map");
 ///
 /// // Do work on map.
 /// // ...
 /// \endcode
 ///
 /// When you are done with the changes to the map, you can simply let the
-/// reference to the map and
+/// handle of the map and
 /// the MapManager go out of scope. There is no need to commit the changes.
 ///
 /// If you want to access the map in a threadsafe way, use:
@@ -54,6 +59,15 @@ namespace backend {
 /// // ...
 /// \endcode
 ///
+/// If --map_manager_memory_budget_mb is set, the maps that weren't accessed
+/// recently are paged out to --map_manager_scratch_folder whenever the
+/// estimated memory usage of all maps exceeds the budget, see
+/// traits<MapType>::getMemoryUsageBytes(). A paged out map is loaded again
+/// when it's accessed through the MapManager. Maps that are in use, that
+/// don't have a map folder or that have a handle of getMap() or
+/// getMapMutable() are never paged out. The maps are saved and loaded while
+/// only their own lock is held, the other maps stay accessible meanwhile.
+///
 /// \tparam MapType Type of the map.
 template <typename MapType>
 class MapManager {
@@ -66,16 +80,57 @@ class MapManager {
   typedef typename common::Monitor<MapType>::WriteAccess MapWriteAccess;
   typedef typename common::Monitor<MapType>::ReadAccess MapReadAccess;
 
+  /// \brief Handle of a map that isn't locked, but keeps the map from being
+  /// paged out while it exists.
+  template <typename PinnedMapType>
+  class PinnedMap {
+   public:
+    PinnedMap(PinnedMapType* map, std::atomic<size_t>* num_pins)
+        : map_(CHECK_NOTNULL(map)), num_pins_(CHECK_NOTNULL(num_pins)) {
+      ++*num_pins_;
+    }
+    PinnedMap(PinnedMap&& other)
+        : map_(other.map_), num_pins_(other.num_pins_) {
+      other.num_pins_ = nullptr;
+    }
+    ~PinnedMap() {
+      if (num_pins_ != nullptr) {
+        --*num_pins_;
+      }
+    }
+
+    PinnedMapType* get() const {
+      return map_;
+    }
+    PinnedMapType& operator*() const {
+      return *map_;
+    }
+    PinnedMapType* operator->() const {
+      return map_;
+    }
+
+   private:
+    PinnedMap(const PinnedMap&) = delete;
+    PinnedMap& operator=(const PinnedMap&) = delete;
+
+    PinnedMapType* map_;
+    std::atomic<size_t>* num_pins_;
+  };
+  typedef PinnedMap<MapType> MutablePinnedMap;
+  typedef PinnedMap<const MapType> ConstPinnedMap;
+
   MapManager();
   ~MapManager() {}
 
-  /// \brief Gets a map from the storage.
+  /// \brief Gets a map from the storage without locking it.
   ///
-  /// Calls MapStorage::getMap().
+  /// Calls MapStorage::getMap(). The map isn't paged out as long as the
+  /// returned handle exists. Deleting or releasing the map waits until all
+  /// of its handles are gone.
   /// \param[in] key Key of the map to be returned.
-  /// \return Reference to the map.
-  MapType* getMapMutable(const std::string& key);
-  const MapType& getMap(const std::string& key) const;
+  /// \return Handle of the map.
+  MutablePinnedMap getMapMutable(const std::string& key);
+  ConstPinnedMap getMap(const std::string& key) const;
 
   /// \brief Returns a map for write access to use in a thread safe context. The
   /// map is
@@ -90,6 +145,10 @@ class MapManager {
   /// context. The map is
   /// automatically locked when using this function.
   ///
+  /// Any number of read accesses to a map can be held at the same time, e.g.
+  /// by read-only console commands running in the background. A write
+  /// access waits until all of them are released.
+  ///
   /// Crashes when no map can be found under the given key.
   /// \param key Key of the map to be returned.
   /// \returns Thread safe read access of the map.
@@ -321,6 +380,59 @@ class MapManager {
 
  protected:
   MapStorage<MapType>* map_storage_;
+
+ private:
+  typedef typename MapStorage<MapType>::MapAndMutex MapAndMutex;
+
+  /// \brief Holds a read lock of the storage while the given maps are
+  /// resident, see acquireReadLockWithResidentMaps().
+  class ResidentMapsReadLock {
+   public:
+    ResidentMapsReadLock(
+        const MapManager<MapType>* map_manager,
+        const std::vector<std::string>& keys)
+        : container_mutex_(
+              map_manager->map_storage_->getContainerMutex()) {
+      map_manager->acquireReadLockWithResidentMaps(keys);
+    }
+    ~ResidentMapsReadLock() {
+      container_mutex_->releaseReadLock();
+    }
+
+   private:
+    aslam::ReaderWriterMutex* container_mutex_;
+  };
+
+  /// \brief Acquires a read lock of the storage once all of the given maps
+  /// that exist are resident and marks them as accessed.
+  void acquireReadLockWithResidentMaps(
+      const std::vector<std::string>& keys) const;
+
+  /// \brief Pages in the given maps and pages out the least recently accessed
+  /// other maps while the memory budget is exceeded. Must be called without
+  /// holding the lock of the storage, which is only held to pick the maps and
+  /// to publish the result. The maps are saved and loaded while they are in
+  /// transit.
+  void pageInMapsWithinBudget(const std::vector<std::string>& keys) const;
+  void pageOutMapsOverBudget(
+      const std::unordered_set<std::string>& keys_to_keep) const;
+
+  /// \brief Marks the least recently accessed maps as in transit and write
+  /// locks them, until the memory usage of the others is within the budget.
+  /// Requires the write lock of the storage.
+  void selectMapsToPageOut(
+      const std::unordered_set<std::string>& keys_to_keep,
+      std::vector<std::pair<std::string, MapAndMutex*>>* maps_to_page_out)
+      const;
+  /// \brief Saves the map to a new scratch folder. Requires the write lock of
+  /// the map.
+  bool saveMapToScratchFolder(
+      const std::string& key, MapAndMutex* map_handle,
+      std::string* scratch_folder) const;
+  /// \brief Loads the map from its scratch folder. Requires the write lock of
+  /// the map or exclusive access to it.
+  AlignedUniquePtr<MapType> loadMapFromScratchFolder(
+      const std::string& key, const MapAndMutex& map_handle) const;
 };
 
 }  // namespace backend
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -58,6 +59,24 @@ MapStorage<MapType>::getMapReadAccess(const std::string& key) const {
       map_handle.map.get(), &map_handle.map_mutex);
 }
 
+template <typename MapType>
+void MapStorage<MapType>::waitForTransit(
+    const uint64_t num_finished_transits) const {
+  std::unique_lock<std::mutex> lock(m_transit_);
+  cv_transit_finished_.wait(lock, [this, num_finished_transits]() {
+    return num_finished_transits_ != num_finished_transits;
+  });
+}
+
+template <typename MapType>
+void MapStorage<MapType>::notifyTransitFinished() const {
+  {
+    std::lock_guard<std::mutex> lock(m_transit_);
+    ++num_finished_transits_;
+  }
+  cv_transit_finished_.notify_all();
+}
+
 template <typename MapType>
 bool MapStorage<MapType>::isKeyValid(const std::string& key) const {
   if (key.empty()) {
@@ -141,6 +160,7 @@ void MapStorage<MapType>::addMap(
   CHECK(isKeyValid(key)) << "Key \"" << key << "\" is not a valid key.";
   CHECK(!hasMap(key)) << "Map with key \"" << key << "\" already exists!";
 
+  map_handle->last_access_tick = nextAccessTick();
   CHECK(map_storage_container_.emplace(key, std::move(map_handle)).second)
       << "Failure inserting map.";
   CHECK(hasMap(key) && map_handle == nullptr) << "Failure inserting map.";
@@ -184,6 +204,13 @@ void MapStorage<MapType>::renameMap(
   addMap(new_key, map_handle);
 }
 
+template <typename MapType>
+typename MapStorage<MapType>::MapAndMutex*
+MapStorage<MapType>::findMapAndMutex(const std::string& key) const {
+  const MapStorageContainerConstIterator it = map_storage_container_.find(key);
+  return it == map_storage_container_.end() ? nullptr : it->second.get();
+}
+
 template <typename MapType>
 aslam::ReaderWriterMutex* MapStorage<MapType>::getContainerMutex() const {
   return &container_mutex_;
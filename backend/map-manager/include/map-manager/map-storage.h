@@ -1,7 +1,11 @@
 #ifndef MAP_MANAGER_MAP_STORAGE_H_
 #define MAP_MANAGER_MAP_STORAGE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -9,6 +13,7 @@
 
 #include <aslam/common/memory.h>
 #include <aslam/common/reader-writer-lock.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/macros.h>
 #include <maplab-common/monitor.h>
 
@@ -46,8 +51,42 @@ class MapStorage {
     /// \brief Mutex to lock access to the map in this handle.
     mutable aslam::ReaderWriterMutex map_mutex;
 
+    /// \brief Folder the map is paged out to by the MapManager. Empty while
+    /// the map is resident, otherwise map is nullptr.
+    std::string scratch_folder;
+
+    /// \brief Map folder of the map while it's paged out or in transit.
+    std::string map_folder;
+
+    /// \brief Set while the MapManager pages the map out or in. The thread
+    /// doing so holds the write lock of map_mutex, other threads must not
+    /// access the map until the transit finished.
+    bool in_transit;
+
+    /// \brief Estimated memory usage of the map when it was last checked.
+    size_t memory_usage_bytes;
+
+    /// \brief Access tick of the storage when the map was last accessed.
+    std::atomic<uint64_t> last_access_tick;
+
+    /// \brief Number of unlocked references to the map that are handed out,
+    /// see MapManager::getMap(). The map isn't paged out while there are any.
+    std::atomic<size_t> num_pins;
+
     explicit MapAndMutex(AlignedUniquePtr<MapType>& map_)  // NOLINT
-        : map(std::move(map_)) {}
+        : map(std::move(map_)),
+          in_transit(false),
+          memory_usage_bytes(0u),
+          last_access_tick(0u),
+          num_pins(0u) {}
+
+   public:
+    // Owned by std::unique_ptr.
+    ~MapAndMutex() {
+      if (!scratch_folder.empty()) {
+        common::removePath(scratch_folder);
+      }
+    }
   };
 
   /// \brief Get an instance of this map storage.
@@ -163,6 +202,24 @@ class MapStorage {
   /// \returns Pointer to the MapStorage's ReaderWriterMutex.
   aslam::ReaderWriterMutex* getContainerMutex() const;
 
+  /// \brief Returns a new tick of the clock that orders the map accesses.
+  uint64_t nextAccessTick() const {
+    return ++access_tick_;
+  }
+
+  /// \brief Returns the number of finished transits of maps. Read it while
+  /// holding the container lock and pass it to waitForTransit() after
+  /// releasing the lock.
+  uint64_t getNumFinishedTransits() const {
+    return num_finished_transits_;
+  }
+
+  /// \brief Blocks until another transit finished after the given number.
+  void waitForTransit(uint64_t num_finished_transits) const;
+
+  /// \brief Call after the in_transit flag of a map was cleared.
+  void notifyTransitFinished() const;
+
  private:
   /// \brief Container which stores all the maps.
   typedef typename std::unordered_map<std::string, std::unique_ptr<MapAndMutex>>
@@ -172,7 +229,7 @@ class MapStorage {
   typedef typename MapStorageContainer::const_iterator
       MapStorageContainerConstIterator;
 
-  MapStorage() {}
+  MapStorage() : access_tick_(0u), num_finished_transits_(0u) {}
 
   MapStorage(const MapStorage&) = delete;
   MapStorage& operator=(const MapStorage&) = delete;
@@ -188,9 +245,19 @@ class MapStorage {
 
   void addMap(const std::string& key, std::unique_ptr<MapAndMutex>& map_handle);
 
+  /// \brief Returns the map and mutex stored under the given key, or nullptr
+  /// if there is none.
+  MapAndMutex* findMapAndMutex(const std::string& key) const;
+
   MapStorageContainer map_storage_container_;
 
   mutable aslam::ReaderWriterMutex container_mutex_;
+
+  mutable std::atomic<uint64_t> access_tick_;
+
+  mutable std::mutex m_transit_;
+  mutable std::condition_variable cv_transit_finished_;
+  mutable std::atomic<uint64_t> num_finished_transits_;
 };
 
 }  // namespace backend
@@ -1,8 +1,10 @@
 #ifndef MAP_MANAGER_TEST_TEST_MAP_TYPE_H_
 #define MAP_MANAGER_TEST_TEST_MAP_TYPE_H_
 
+#include <fstream>  // NOLINT
 #include <string>
 
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-traits.h>
 
 namespace backend {
@@ -10,13 +12,21 @@ namespace backend {
 // Test class to unit test basic map manager functionality.
 class TestMapType : public MapInterface<TestMapType> {
  public:
-  TestMapType() : counter_(0u) {}
+  TestMapType() : counter_(0u), memory_usage_bytes_(0u) {}
 
-  bool hasMapFolder() {
-    return false;
+  bool hasMapFolder() const {
+    return !map_folder_.empty();
+  }
+  void getMapFolder(std::string* map_folder) const {
+    *map_folder = map_folder_;
+  }
+  void setMapFolder(const std::string& map_folder) {
+    map_folder_ = map_folder;
+  }
+  void setMapFolder(
+      const std::string& map_folder, const bool /*adapt_resource_refs*/) {
+    map_folder_ = map_folder;
   }
-  void getMapFolder(std::string* /*map_folder*/) {}
-  void setMapFolder(const std::string& /*map_folder*/) {}
 
   virtual void deepCopy(const TestMapType& /*other*/) {}
   virtual void mergeAllMissionsFromMap(
@@ -28,12 +38,25 @@ class TestMapType : public MapInterface<TestMapType> {
   static bool hasMapOnFilSytem(const std::string /*folder_path*/) {
     return false;
   }
-  virtual bool loadFromFolder(const std::string& /*folder_path*/) {
-    return false;
+  // Only the counter and the memory usage are saved, which is enough to test
+  // paging.
+  virtual bool loadFromFolder(const std::string& folder_path) {
+    std::ifstream file(getFilePath(folder_path));
+    if (!(file >> counter_ >> memory_usage_bytes_)) {
+      return false;
+    }
+    map_folder_ = folder_path;
+    return true;
   }
   virtual bool saveToFolder(
-      const std::string& /*folder_path*/, const SaveConfig& /*config*/) {
-    return false;
+      const std::string& folder_path, const SaveConfig& /*config*/) {
+    if (!common::createPath(folder_path)) {
+      return false;
+    }
+    std::ofstream file(getFilePath(folder_path));
+    file << counter_ << " " << memory_usage_bytes_;
+    map_folder_ = folder_path;
+    return static_cast<bool>(file);
   }
 
   void incrementCounter() {
@@ -43,12 +66,29 @@ class TestMapType : public MapInterface<TestMapType> {
     return counter_;
   }
 
+  void setMemoryUsageBytes(const size_t memory_usage_bytes) {
+    memory_usage_bytes_ = memory_usage_bytes;
+  }
+  size_t getMemoryUsageBytes() const {
+    return memory_usage_bytes_;
+  }
+
  private:
+  static std::string getFilePath(const std::string& folder_path) {
+    return common::concatenateFolderAndFileName(folder_path, "test_map");
+  }
+
   size_t counter_;
+  size_t memory_usage_bytes_;
+  std::string map_folder_;
 };
 
 template <>
-struct traits<TestMapType> : public MapTraits<TestMapType> {};
+struct traits<TestMapType> : public MapTraits<TestMapType> {
+  static size_t getMemoryUsageBytes(const TestMapType& map) {
+    return map.getMemoryUsageBytes();
+  }
+};
 
 }  // namespace backend
 
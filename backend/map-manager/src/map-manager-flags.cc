@@ -0,0 +1,10 @@
+#include <gflags/gflags.h>
+
+DEFINE_int32(
+    map_manager_memory_budget_mb, 0,
+    "Memory budget of all maps in the map manager. Maps that weren't accessed "
+    "recently are paged out to --map_manager_scratch_folder when it's "
+    "exceeded and loaded again when they are accessed. 0 disables paging.");
+DEFINE_string(
+    map_manager_scratch_folder, "/tmp/maplab_map_manager",
+    "Folder that maps are paged out to, see --map_manager_memory_budget_mb.");
@@ -2,9 +2,11 @@
 #include <string>
 #include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include <aslam/common/memory.h>
 #include <gtest/gtest.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-traits.h>
 #include <maplab-common/test/testing-entrypoint.h>
 
@@ -312,4 +314,111 @@ TEST_F(MapManagerBasicTest, ReleaseMapWhileInUse) {
   }
 }
 
+TEST_F(MapManagerBasicTest, PageOutMapsOverMemoryBudget) {
+  FLAGS_map_manager_memory_budget_mb = 2;
+  FLAGS_map_manager_scratch_folder = "./map_manager_scratch_test";
+  constexpr size_t kMapMemoryUsageBytes = 1024u * 1024u;
+  const std::string kThirdMapKey = "third_test_map";
+  const std::vector<std::string> keys = {
+      TestStrings::kFirstMapKey, TestStrings::kSecondMapKey, kThirdMapKey};
+  for (size_t i = 0u; i < keys.size(); ++i) {
+    map_.reset(new backend::TestMapType());
+    map_->setMapFolder("map_folder_" + keys[i]);
+    map_->setMemoryUsageBytes(kMapMemoryUsageBytes);
+    for (size_t j = 0u; j < i; ++j) {
+      map_->incrementCounter();
+    }
+    map_manager_.addMap(keys[i], map_);
+  }
+
+  // Every paged out test map is a single file.
+  auto num_paged_out_maps = []() {
+    std::vector<std::string> files;
+    common::getAllFilesInFolder(FLAGS_map_manager_scratch_folder, &files);
+    return files.size();
+  };
+
+  // Only the least recently added map is paged out.
+  EXPECT_EQ(1u, num_paged_out_maps());
+  EXPECT_EQ(3u, map_manager_.numberOfMaps());
+
+  // Accessing it pages in the map and pages out the second one instead.
+  {
+    backend::MapManager<backend::TestMapType>::MapReadAccess map =
+        map_manager_.getMapReadAccess(TestStrings::kFirstMapKey);
+    EXPECT_EQ(0u, map->getCounter());
+    std::string map_folder;
+    map->getMapFolder(&map_folder);
+    EXPECT_EQ("map_folder_" + TestStrings::kFirstMapKey, map_folder);
+  }
+  EXPECT_EQ(
+      1u, map_manager_.getMapReadAccess(TestStrings::kSecondMapKey)
+              ->getCounter());
+  EXPECT_EQ(2u, map_manager_.getMapReadAccess(kThirdMapKey)->getCounter());
+  EXPECT_EQ(1u, num_paged_out_maps());
+
+  // Released maps are paged in, deleted ones are removed from the scratch
+  // folder.
+  AlignedUniquePtr<backend::TestMapType> released_map =
+      map_manager_.releaseMap(TestStrings::kFirstMapKey);
+  ASSERT_NE(released_map, nullptr);
+  EXPECT_EQ(0u, released_map->getCounter());
+  map_manager_.deleteMap(TestStrings::kSecondMapKey);
+  map_manager_.deleteMap(kThirdMapKey);
+  EXPECT_EQ(0u, num_paged_out_maps());
+
+  FLAGS_map_manager_memory_budget_mb = 0;
+  common::removePath(FLAGS_map_manager_scratch_folder);
+}
+
+TEST_F(MapManagerBasicTest, PinnedMapsArePagedOutOnceUnpinned) {
+  FLAGS_map_manager_memory_budget_mb = 2;
+  FLAGS_map_manager_scratch_folder = "./map_manager_scratch_pin_test";
+  constexpr size_t kMapMemoryUsageBytes = 1024u * 1024u;
+  auto add_map = [this](const std::string& key) {
+    map_.reset(new backend::TestMapType());
+    map_->setMapFolder("map_folder_" + key);
+    map_->setMemoryUsageBytes(kMapMemoryUsageBytes);
+    map_manager_.addMap(key, map_);
+  };
+  auto is_paged_out = [](const std::string& key) {
+    std::vector<std::string> files;
+    common::getAllFilesInFolder(FLAGS_map_manager_scratch_folder, &files);
+    for (const std::string& file : files) {
+      if (file.find("/" + key + "_") != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  };
+  const std::string kThirdMapKey = "third_test_map";
+  const std::string kFourthMapKey = "fourth_test_map";
+
+  add_map(TestStrings::kFirstMapKey);
+  {
+    backend::MapManager<backend::TestMapType>::ConstPinnedMap first_map =
+        map_manager_.getMap(TestStrings::kFirstMapKey);
+    add_map(TestStrings::kSecondMapKey);
+    add_map(kThirdMapKey);
+    // The handle keeps the first map resident.
+    EXPECT_FALSE(is_paged_out(TestStrings::kFirstMapKey));
+    EXPECT_TRUE(is_paged_out(TestStrings::kSecondMapKey));
+    EXPECT_EQ(0u, first_map->getCounter());
+  }
+
+  // Once the handle is gone, the first map is the least recently accessed.
+  map_manager_.getMapReadAccess(kThirdMapKey);
+  add_map(kFourthMapKey);
+  EXPECT_TRUE(is_paged_out(TestStrings::kFirstMapKey));
+  EXPECT_FALSE(is_paged_out(kThirdMapKey));
+
+  FLAGS_map_manager_memory_budget_mb = 0;
+  for (const std::string& key :
+       {TestStrings::kFirstMapKey, TestStrings::kSecondMapKey, kThirdMapKey,
+        kFourthMapKey}) {
+    map_manager_.deleteMap(key);
+  }
+  common::removePath(FLAGS_map_manager_scratch_folder);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,32 @@
+#ifndef MAP_RESOURCES_IMAGE_CODEC_H_
+#define MAP_RESOURCES_IMAGE_CODEC_H_
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+namespace backend {
+
+// Encoding of image and depth map resource files, selected with
+// --resource_image_codec. The encoding of a file is detected from its
+// content when it is loaded, so resource folders may contain files of both
+// encodings.
+enum class ImageCodec {
+  // Binary PNM written by OpenCV, as given by the resource file suffix.
+  kPnm,
+  // The raw pixels, split into blocks of rows that are deflate compressed
+  // (and decompressed) in parallel.
+  kDeflate
+};
+
+ImageCodec getImageCodecFromGflags();
+
+// Returns true if the file starts with the header of the deflate codec.
+bool isDeflateImageFile(const std::string& file_path);
+
+bool saveDeflateImage(const cv::Mat& image, const std::string& file_path);
+bool loadDeflateImage(const std::string& file_path, cv::Mat* image);
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_IMAGE_CODEC_H_
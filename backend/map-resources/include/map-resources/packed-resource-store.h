@@ -0,0 +1,99 @@
+#ifndef MAP_RESOURCES_PACKED_RESOURCE_STORE_H_
+#define MAP_RESOURCES_PACKED_RESOURCE_STORE_H_
+
+#include <array>
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Container for the resources of one resource folder that replaces the one
+// file per resource layout. Resources are appended to large segment files
+// and located through an append-only text index, so a mission only needs a
+// handful of files. The payload is stored as raw bytes, which lets images and
+// depth maps be read straight from a memory mapping of the segment without
+// decoding. Deleting a resource only removes it from the index, the space in
+// the segment is not reclaimed.
+//
+// Layout:
+//   <resource_folder>/packed/index           "add"/"del" records, one per line
+//   <resource_folder>/packed/segment_<N>.bin concatenated payloads
+//
+// All methods are thread-safe.
+class PackedResourceStore {
+ public:
+  // Type specific description of the payload, e.g. rows, cols and OpenCV type
+  // of an image.
+  typedef std::array<int64_t, 3> Layout;
+
+  struct Entry {
+    size_t segment_index = 0u;
+    size_t offset = 0u;
+    size_t num_bytes = 0u;
+    Layout layout = Layout{{0, 0, 0}};
+  };
+
+  // A payload is written as the concatenation of these memory ranges.
+  typedef std::pair<const void*, size_t> DataChunk;
+
+  // Opens the store of the folder, or creates it on the first write.
+  explicit PackedResourceStore(const std::string& resource_folder);
+  ~PackedResourceStore();
+
+  static bool existsInFolder(const std::string& resource_folder);
+
+  bool hasResource(const ResourceId& id, const ResourceType& type) const;
+  bool getEntry(
+      const ResourceId& id, const ResourceType& type, Entry* entry) const;
+
+  void addResource(
+      const ResourceId& id, const ResourceType& type, const Layout& layout,
+      const std::vector<DataChunk>& data_chunks);
+
+  // Copies the payload of the entry into destination, which must hold
+  // entry.num_bytes bytes.
+  bool readData(const Entry& entry, void* destination) const;
+  // Copies num_bytes of the payload, starting at offset.
+  bool readData(
+      const Entry& entry, size_t offset, size_t num_bytes,
+      void* destination) const;
+
+  // Returns false if the resource was not part of the store.
+  bool deleteResource(const ResourceId& id, const ResourceType& type);
+
+  size_t numResources() const;
+
+ private:
+  class MappedSegment;
+
+  void loadIndex();
+  void appendIndexLine(const std::string& line);
+  std::string getSegmentPath(size_t segment_index) const;
+  // Returns the memory mapping of the segment, which is (re-)created if it
+  // does not cover the given size yet. Must be called with m_store_ held.
+  std::shared_ptr<const MappedSegment> getMappedSegment(
+      size_t segment_index, size_t min_num_bytes) const;
+
+  const std::string store_folder_;
+
+  mutable std::mutex m_store_;
+  std::vector<std::unordered_map<ResourceId, Entry>> index_;
+  std::ofstream index_stream_;
+  std::ofstream segment_stream_;
+  size_t current_segment_index_;
+  size_t current_segment_size_;
+  mutable std::unordered_map<size_t, std::shared_ptr<const MappedSegment>>
+      mapped_segments_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_PACKED_RESOURCE_STORE_H_
@@ -0,0 +1,29 @@
+#ifndef MAP_RESOURCES_POINT_CLOUD_PLY_H_
+#define MAP_RESOURCES_POINT_CLOUD_PLY_H_
+
+#include <string>
+
+#include "map-resources/resource-typedefs.h"
+
+namespace backend {
+
+// Reads and writes point cloud resources as binary little endian PLY files
+// without going through tinyply: the vertices are written from and read
+// into the arrays of the point cloud in one pass, reading maps the file into
+// memory. The files are regular PLY files that tinyply can read as well.
+
+// Writes x, y, z and, if present, nx, ny, nz and red, green, blue as one
+// vertex element. Returns false if the file cannot be written.
+bool savePointCloudToBinaryPly(
+    const resources::PointCloud& point_cloud, const std::string& file_path);
+
+// Returns false if the file cannot be read or uses features of the format
+// that are not supported, e.g. ASCII or big endian encoding, list properties
+// of the vertices or colors that are not stored as uchar. Such files have to
+// be read with tinyply.
+bool loadPointCloudFromBinaryPly(
+    const std::string& file_path, resources::PointCloud* point_cloud);
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_POINT_CLOUD_PLY_H_
@@ -1,6 +1,10 @@
 #ifndef MAP_RESOURCES_RESOURCE_CACHE_INL_H_
 #define MAP_RESOURCES_RESOURCE_CACHE_INL_H_
 
+#include <iterator>
+#include <mutex>
+#include <string>
+
 #include "map-resources/resource-common.h"
 
 namespace backend {
@@ -9,20 +13,19 @@ template <typename DataType>
 bool ResourceCache::getResource(
     const ResourceId& id, const ResourceType& type, DataType* resource) {
   CHECK_NOTNULL(resource);
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  std::lock_guard<std::mutex> lock(getTypeMutex(type));
+  typename Cache<DataType>::ResourceTypeCache* cache = getCache<DataType>(type);
 
   bool found = false;
   if (cache != nullptr) {
-    typename Cache<DataType>::ConstIterator it = std::find_if(
-        cache->begin(), cache->end(),
-        [id](const typename Cache<DataType>::Element& element) {
-          return element.first == id;
-        });
-    if (it != cache->end()) {
-      *resource = it->second;
+    typename std::unordered_map<
+        ResourceId, typename Cache<DataType>::EntryIterator>::const_iterator
+        it = cache->index.find(id);
+    if (it != cache->index.end()) {
+      *resource = it->second->resource;
       found = true;
 
-      // TODO(mfehr): Do something to the cache depending on the strategy.
+      touchEntry<DataType>(it->second, cache);
     }
   }
 
@@ -37,24 +40,60 @@ bool ResourceCache::getResource(
 template <typename DataType>
 void ResourceCache::putResource(
     const ResourceId& id, const ResourceType& type, const DataType& resource) {
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  std::lock_guard<std::mutex> lock(getTypeMutex(type));
+  typename Cache<DataType>::ResourceTypeCache* cache = getCache<DataType>(type);
   if (cache == nullptr) {
     cache = initCache<DataType>(type);
   }
 
   // Check if it is already in the cache.
-  typename Cache<DataType>::ConstIterator it = std::find_if(
-      cache->begin(), cache->end(),
-      [id](const typename Cache<DataType>::Element& element) {
-        return element.first == id;
-      });
-  CHECK(it == cache->end())
+  CHECK(cache->index.count(id) == 0u)
       << "Cannot put same resource in the cache twice! Id: " << id.hexString();
+  putResourceLocked<DataType>(id, type, resource, cache);
+}
 
-  cache->emplace_back(id, resource);
-  if (cache->size() > config_.max_cache_size) {
-    cache->pop_front();
+template <typename DataType>
+bool ResourceCache::putResourceIfMissing(
+    const ResourceId& id, const ResourceType& type, const DataType& resource) {
+  std::lock_guard<std::mutex> lock(getTypeMutex(type));
+  typename Cache<DataType>::ResourceTypeCache* cache = getCache<DataType>(type);
+  if (cache == nullptr) {
+    cache = initCache<DataType>(type);
+  }
+  if (cache->index.count(id) > 0u) {
+    return false;
   }
+  putResourceLocked<DataType>(id, type, resource, cache);
+  return true;
+}
+
+template <typename DataType>
+void ResourceCache::putResourceLocked(
+    const ResourceId& id, const ResourceType& type, const DataType& resource,
+    typename Cache<DataType>::ResourceTypeCache* cache) {
+  CHECK_NOTNULL(cache);
+  if (config_.max_cache_size == 0u) {
+    return;
+  }
+  const size_t num_bytes = getResourceSizeBytes<DataType>(resource);
+  if (config_.max_cache_size_bytes > 0u &&
+      num_bytes > config_.max_cache_size_bytes) {
+    VLOG(3) << "Not caching " << ResourceTypeNames[static_cast<size_t>(type)]
+            << " resource " << id.hexString() << " of " << num_bytes
+            << " bytes, as it exceeds the cache budget of "
+            << config_.max_cache_size_bytes << " bytes.";
+    return;
+  }
+
+  // Make room first, such that the new entry cannot be evicted right away.
+  evictEntries<DataType>(type, num_bytes, cache);
+
+  const typename Cache<DataType>::Entry entry(id, resource, num_bytes);
+  typename Cache<DataType>::EntryList& bucket =
+      cache->buckets[getBucketKey<DataType>(entry)];
+  bucket.emplace_back(entry);
+  cache->index.emplace(id, std::prev(bucket.end()));
+  cache->num_bytes += num_bytes;
 
   updateCacheSizeStatistic<DataType>(type, *cache, &statistic_);
 }
@@ -62,15 +101,14 @@ void ResourceCache::putResource(
 template <typename DataType>
 bool ResourceCache::deleteResource(
     const ResourceId& id, const ResourceType& type) {
-  typename Cache<DataType>::ResourceDeque* cache = getCache<DataType>(type);
+  std::lock_guard<std::mutex> lock(getTypeMutex(type));
+  typename Cache<DataType>::ResourceTypeCache* cache = getCache<DataType>(type);
   if (cache != nullptr) {
-    typename Cache<DataType>::Iterator it = std::find_if(
-        cache->begin(), cache->end(),
-        [id](const typename Cache<DataType>::Element& element) {
-          return element.first == id;
-        });
-    if (it != cache->end()) {
-      cache->erase(it);
+    typename std::unordered_map<
+        ResourceId, typename Cache<DataType>::EntryIterator>::iterator it =
+        cache->index.find(id);
+    if (it != cache->index.end()) {
+      eraseEntry<DataType>(it->second, cache);
 
       updateCacheSizeStatistic<DataType>(type, *cache, &statistic_);
       return true;
@@ -80,35 +118,133 @@ bool ResourceCache::deleteResource(
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDequePtr&
-ResourceCache::getCachePtr(const ResourceType& /*type*/) {
-  LOG(FATAL) << "Implement ResourceCache::getCachePtr for your DataType!";
+bool ResourceCache::hasResource(
+    const ResourceId& id, const ResourceType& type) {
+  std::lock_guard<std::mutex> lock(getTypeMutex(type));
+  const typename Cache<DataType>::ResourceTypeCache* cache =
+      getCache<DataType>(type);
+  return cache != nullptr && cache->index.count(id) > 0u;
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDeque* ResourceCache::getCache(
-    const ResourceType& type) {
-  return getCachePtr<DataType>(type).get();
+size_t ResourceCache::getBucketKey(
+    const typename Cache<DataType>::Entry& entry) const {
+  return config_.strategy == Strategy::kLFU ? entry.num_hits : 0u;
 }
 
 template <typename DataType>
-typename ResourceCache::Cache<DataType>::ResourceDeque*
+void ResourceCache::touchEntry(
+    typename Cache<DataType>::EntryIterator entry_it,
+    typename Cache<DataType>::ResourceTypeCache* cache) {
+  CHECK_NOTNULL(cache);
+  const size_t old_bucket_key = getBucketKey<DataType>(*entry_it);
+  ++entry_it->num_hits;
+
+  switch (config_.strategy) {
+    case Strategy::kFIFO:
+      break;
+    case Strategy::kLRU:
+    case Strategy::kLFU: {
+      // Splicing keeps the iterator stored in the index valid.
+      typename Cache<DataType>::EntryList& old_bucket =
+          cache->buckets[old_bucket_key];
+      typename Cache<DataType>::EntryList& new_bucket =
+          cache->buckets[getBucketKey<DataType>(*entry_it)];
+      new_bucket.splice(new_bucket.end(), old_bucket, entry_it);
+      if (old_bucket.empty()) {
+        cache->buckets.erase(old_bucket_key);
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown cache strategy: "
+                 << static_cast<int>(config_.strategy);
+  }
+}
+
+template <typename DataType>
+void ResourceCache::eraseEntry(
+    typename Cache<DataType>::EntryIterator entry_it,
+    typename Cache<DataType>::ResourceTypeCache* cache) {
+  CHECK_NOTNULL(cache);
+  const size_t bucket_key = getBucketKey<DataType>(*entry_it);
+  typename std::map<size_t, typename Cache<DataType>::EntryList>::iterator
+      bucket_it = cache->buckets.find(bucket_key);
+  CHECK(bucket_it != cache->buckets.end());
+
+  CHECK_GE(cache->num_bytes, entry_it->num_bytes);
+  cache->num_bytes -= entry_it->num_bytes;
+  CHECK_EQ(cache->index.erase(entry_it->id), 1u);
+  bucket_it->second.erase(entry_it);
+  if (bucket_it->second.empty()) {
+    cache->buckets.erase(bucket_it);
+  }
+}
+
+template <typename DataType>
+void ResourceCache::evictEntries(
+    const ResourceType& type, size_t num_bytes_to_insert,
+    typename Cache<DataType>::ResourceTypeCache* cache) {
+  CHECK_NOTNULL(cache);
+  const bool has_memory_budget = config_.max_cache_size_bytes > 0u;
+  while (!cache->index.empty() &&
+         (cache->index.size() >= config_.max_cache_size ||
+          (has_memory_budget &&
+           cache->num_bytes + num_bytes_to_insert >
+               config_.max_cache_size_bytes))) {
+    CHECK(!cache->buckets.empty());
+    typename Cache<DataType>::EntryList& first_bucket =
+        cache->buckets.begin()->second;
+    CHECK(!first_bucket.empty());
+    eraseEntry<DataType>(first_bucket.begin(), cache);
+    ++(statistic_.eviction[static_cast<size_t>(type)]);
+  }
+}
+
+template <typename DataType>
+typename ResourceCache::Cache<DataType>::ResourceTypeMap&
+ResourceCache::getCacheMap() {
+  LOG(FATAL) << "Implement ResourceCache::getCacheMap for your DataType!";
+}
+
+template <typename DataType>
+typename ResourceCache::Cache<DataType>::ResourceTypeCache*
+ResourceCache::getCache(const ResourceType& type) {
+  // Lookups must not insert into the map, only initCache() does.
+  std::lock_guard<std::mutex> lock(m_cache_maps_);
+  const typename Cache<DataType>::ResourceTypeMap& cache_map =
+      getCacheMap<DataType>();
+  const typename Cache<DataType>::ResourceTypeMap::const_iterator it =
+      cache_map.find(type);
+  return it == cache_map.end() ? nullptr : it->second.get();
+}
+
+template <typename DataType>
+typename ResourceCache::Cache<DataType>::ResourceTypeCache*
 ResourceCache::initCache(const ResourceType& type) {
-  typename ResourceCache::Cache<DataType>::ResourceDequePtr& cache_ptr =
-      getCachePtr<DataType>(type);
-  cache_ptr.reset(new typename ResourceCache::Cache<DataType>::ResourceDeque);
+  std::lock_guard<std::mutex> lock(m_cache_maps_);
+  typename ResourceCache::Cache<DataType>::ResourceTypeCachePtr& cache_ptr =
+      getCacheMap<DataType>()[type];
+  cache_ptr.reset(
+      new typename ResourceCache::Cache<DataType>::ResourceTypeCache);
   return CHECK_NOTNULL(cache_ptr.get());
 }
 
+template <typename DataType>
+size_t getResourceSizeBytes(const DataType& /*resource*/) {
+  return sizeof(DataType);
+}
+
 template <typename DataType>
 void updateCacheSizeStatistic(
     const ResourceType& type,
-    const typename ResourceCache::Cache<DataType>::ResourceDeque& cache,
+    const typename ResourceCache::Cache<DataType>::ResourceTypeCache& cache,
     CacheStatistic* statistic) {
   CHECK_NOTNULL(statistic);
   const size_t type_idx = static_cast<size_t>(type);
   CHECK_LT(type_idx, statistic->cache_size.size());
-  statistic->cache_size[type_idx] = cache.size();
+  statistic->cache_size[type_idx] = cache.index.size();
+  statistic->cache_size_bytes[type_idx] = cache.num_bytes;
 }
 
 }  // namespace backend
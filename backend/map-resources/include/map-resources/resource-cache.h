@@ -1,8 +1,11 @@
 #ifndef MAP_RESOURCES_RESOURCE_CACHE_H_
 #define MAP_RESOURCES_RESOURCE_CACHE_H_
 
-#include <deque>
+#include <array>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -19,7 +22,10 @@ namespace backend {
 struct CacheStatistic {
   std::vector<size_t> hit = std::vector<size_t>(kNumResourceTypes, 0u);
   std::vector<size_t> miss = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> eviction = std::vector<size_t>(kNumResourceTypes, 0u);
   std::vector<size_t> cache_size = std::vector<size_t>(kNumResourceTypes, 0u);
+  std::vector<size_t> cache_size_bytes =
+      std::vector<size_t>(kNumResourceTypes, 0u);
 
   void reset();
   void printToLog(int verbosity) const;
@@ -27,23 +33,43 @@ struct CacheStatistic {
 
   size_t getNumHits(const ResourceType& type) const;
   size_t getNumMiss(const ResourceType& type) const;
+  size_t getNumEvictions(const ResourceType& type) const;
 };
 
+// Caches resources per resource type. Lookups, insertions and deletions are
+// hash-indexed by the resource id. Once a resource type exceeds either the
+// maximum number of entries or its memory budget, entries are evicted
+// according to the configured strategy.
+//
+// Thread-safe. Every resource type has its own lock, which is only held to
+// copy resources in and out of the cache.
 class ResourceCache {
   friend struct CacheStatistic;
 
  public:
-  ResourceCache() {}
-
-  enum class Strategy { kFIFO = 0u };
+  enum class Strategy {
+    // Evicts the entry that was inserted first.
+    kFIFO = 0u,
+    // Evicts the entry that was accessed least recently.
+    kLRU = 1u,
+    // Evicts the entry with the fewest cache hits, the least recently
+    // inserted or accessed one among equals.
+    kLFU = 2u
+  };
 
   struct Config {
-    size_t allocated_cache_size = 0u;
+    // Maximum number of entries per resource type.
     size_t max_cache_size = 100u;
+    // Maximum memory used by the resources of one resource type, 0 disables
+    // the limit. Resources that exceed the budget on their own are not cached.
+    size_t max_cache_size_bytes = 0u;
     bool cache_newest_resource = false;
-    Strategy strategy = Strategy::kFIFO;
+    Strategy strategy = Strategy::kLRU;
+
+    static Config getFromGflags();
   };
 
+  ResourceCache() {}
   explicit ResourceCache(const Config& cache_config) : config_(cache_config) {}
 
   template <typename DataType>
@@ -54,38 +80,102 @@ class ResourceCache {
   void putResource(
       const ResourceId& id, const ResourceType& type, const DataType& resource);
 
+  // Returns false if the resource is cached already.
+  template <typename DataType>
+  bool putResourceIfMissing(
+      const ResourceId& id, const ResourceType& type, const DataType& resource);
+
   template <typename DataType>
   bool deleteResource(const ResourceId& id, const ResourceType& type);
 
+  // Does not affect the statistic or the eviction order.
+  template <typename DataType>
+  bool hasResource(const ResourceId& id, const ResourceType& type);
+
   void resetStatistic();
 
-  const CacheStatistic& getStatistic() const;
+  CacheStatistic getStatistic() const;
+
+  // Memory used by the cached resources of all types, as estimated by
+  // getResourceSizeBytes().
+  size_t memoryUsageBytes() const;
 
   const Config& getConfig() const;
 
   template <typename DataType>
   struct Cache {
-    typedef std::pair<ResourceId, DataType> Element;
-    typedef std::deque<std::pair<ResourceId, DataType>> ResourceDeque;
-    typedef std::unique_ptr<ResourceDeque> ResourceDequePtr;
-    typedef std::unique_ptr<const ResourceDeque> ResourceDequeConstPtr;
-    typedef std::unordered_map<ResourceType, ResourceDequePtr, ResourceTypeHash>
+    struct Entry {
+      Entry(const ResourceId& _id, const DataType& _resource, size_t _num_bytes)
+          : id(_id), resource(_resource), num_bytes(_num_bytes),
+            num_hits(0u) {}
+      ResourceId id;
+      DataType resource;
+      size_t num_bytes;
+      size_t num_hits;
+    };
+    typedef std::list<Entry> EntryList;
+    typedef typename EntryList::iterator EntryIterator;
+
+    // The entries are grouped into buckets of equal eviction priority, each
+    // ordered from the next entry to evict to the last. FIFO and LRU only use
+    // a single bucket, LFU uses one bucket per number of hits.
+    struct ResourceTypeCache {
+      std::map<size_t, EntryList> buckets;
+      std::unordered_map<ResourceId, EntryIterator> index;
+      size_t num_bytes = 0u;
+    };
+    typedef std::unique_ptr<ResourceTypeCache> ResourceTypeCachePtr;
+    typedef std::unordered_map<
+        ResourceType, ResourceTypeCachePtr, ResourceTypeHash>
         ResourceTypeMap;
-    typedef typename ResourceDeque::const_iterator ConstIterator;
-    typedef typename ResourceDeque::iterator Iterator;
   };
 
  private:
+  std::mutex& getTypeMutex(const ResourceType& type) const {
+    const size_t type_idx = static_cast<size_t>(type);
+    CHECK_LT(type_idx, kNumResourceTypes);
+    return m_resource_types_[type_idx];
+  }
+
+  // Both require the lock of the resource type.
+  template <typename DataType>
+  typename Cache<DataType>::ResourceTypeCache* getCache(
+      const ResourceType& type);
+
+  template <typename DataType>
+  typename Cache<DataType>::ResourceTypeCache* initCache(
+      const ResourceType& type);
+
+  // Requires the lock of the resource type.
+  template <typename DataType>
+  void putResourceLocked(
+      const ResourceId& id, const ResourceType& type, const DataType& resource,
+      typename Cache<DataType>::ResourceTypeCache* cache);
+
   template <typename DataType>
-  typename Cache<DataType>::ResourceDeque* getCache(const ResourceType& type);
+  size_t getBucketKey(const typename Cache<DataType>::Entry& entry) const;
 
+  // Updates the eviction order after a cache hit.
   template <typename DataType>
-  typename Cache<DataType>::ResourceDeque* initCache(const ResourceType& type);
+  void touchEntry(
+      typename Cache<DataType>::EntryIterator entry_it,
+      typename Cache<DataType>::ResourceTypeCache* cache);
+
+  template <typename DataType>
+  void eraseEntry(
+      typename Cache<DataType>::EntryIterator entry_it,
+      typename Cache<DataType>::ResourceTypeCache* cache);
+
+  // Evicts entries until a resource of num_bytes_to_insert fits into the
+  // cache.
+  template <typename DataType>
+  void evictEntries(
+      const ResourceType& type, size_t num_bytes_to_insert,
+      typename Cache<DataType>::ResourceTypeCache* cache);
 
   // NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
   template <typename DataType>
-  typename Cache<DataType>::ResourceDequePtr& getCachePtr(
-      const ResourceType& type);
+  typename Cache<DataType>::ResourceTypeMap& getCacheMap();
 
   // NOTE: [ADD_RESOURCE_DATA_TYPE] Add member.
   Cache<cv::Mat>::ResourceTypeMap image_cache_;
@@ -94,6 +184,11 @@ class ResourceCache {
   Cache<voxblox::TsdfMap>::ResourceTypeMap voxblox_tsdf_map_cache_;
   Cache<voxblox::EsdfMap>::ResourceTypeMap voxblox_esdf_map_cache_;
   Cache<voxblox::OccupancyMap>::ResourceTypeMap voxblox_occupancy_map_cache_;
+  // Guards the maps above, but not the caches they point to.
+  std::mutex m_cache_maps_;
+
+  // Guard the caches and the statistic entries of the resource types.
+  mutable std::array<std::mutex, kNumResourceTypes> m_resource_types_;
 
   CacheStatistic statistic_;
 
@@ -101,33 +196,59 @@ class ResourceCache {
 };
 
 template <>
-typename ResourceCache::Cache<cv::Mat>::ResourceDequePtr&
-ResourceCache::getCachePtr<cv::Mat>(const ResourceType& type);
+typename ResourceCache::Cache<cv::Mat>::ResourceTypeMap&
+ResourceCache::getCacheMap<cv::Mat>();
+
+template <>
+typename ResourceCache::Cache<std::string>::ResourceTypeMap&
+ResourceCache::getCacheMap<std::string>();
+
+template <>
+typename ResourceCache::Cache<resources::PointCloud>::ResourceTypeMap&
+ResourceCache::getCacheMap<resources::PointCloud>();
+
+template <>
+typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::TsdfMap>();
+
+template <>
+typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::EsdfMap>();
+
+template <>
+typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::OccupancyMap>();
+
+// Memory used by a cached resource, which is counted against the memory budget
+// of the cache.
+// NOTE: [ADD_RESOURCE_DATA_TYPE] Implement and add declaration below.
+template <typename DataType>
+size_t getResourceSizeBytes(const DataType& resource);
+
+template <>
+size_t getResourceSizeBytes<cv::Mat>(const cv::Mat& resource);
 
 template <>
-typename ResourceCache::Cache<std::string>::ResourceDequePtr&
-ResourceCache::getCachePtr<std::string>(const ResourceType& type);
+size_t getResourceSizeBytes<std::string>(const std::string& resource);
 
 template <>
-typename ResourceCache::Cache<resources::PointCloud>::ResourceDequePtr&
-ResourceCache::getCachePtr<resources::PointCloud>(const ResourceType& type);
+size_t getResourceSizeBytes<resources::PointCloud>(
+    const resources::PointCloud& resource);
 
 template <>
-typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::TsdfMap>(const ResourceType& type);
+size_t getResourceSizeBytes<voxblox::TsdfMap>(const voxblox::TsdfMap& resource);
 
 template <>
-typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::EsdfMap>(const ResourceType& type);
+size_t getResourceSizeBytes<voxblox::EsdfMap>(const voxblox::EsdfMap& resource);
 
 template <>
-typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::OccupancyMap>(const ResourceType& type);
+size_t getResourceSizeBytes<voxblox::OccupancyMap>(
+    const voxblox::OccupancyMap& resource);
 
 template <typename DataType>
 void updateCacheSizeStatistic(
     const ResourceType& type,
-    const typename ResourceCache::Cache<DataType>::ResourceDeque& cache,
+    const typename ResourceCache::Cache<DataType>::ResourceTypeCache& cache,
     CacheStatistic* statistic);
 
 }  // namespace backend
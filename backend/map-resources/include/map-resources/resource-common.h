@@ -49,6 +49,7 @@ enum class ResourceType {
   kVoxbloxTsdfMap,
   kVoxbloxEsdfMap,
   kVoxbloxOccupancyMap,
+  kProjectedDescriptors,
   kCount
 };
 
@@ -77,7 +78,8 @@ const std::array<std::string, kNumResourceTypes> ResourceTypeNames = {
      /*kPointCloudXYZRGBN*/ "color_point_cloud_type",
      /*kVoxbloxTsdfMap*/ "voxblox_tsdf_map",
      /*kVoxbloxEsdfMap*/ "voxblox_esdf_map",
-     /*kVoxbloxOccupancyMap*/ "voxblox_occupancy_map"}};
+     /*kVoxbloxOccupancyMap*/ "voxblox_occupancy_map",
+     /*kProjectedDescriptors*/ "projected_descriptors"}};
 
 // NOTE: [ADD_RESOURCE_TYPE] Add suffix.
 const std::array<std::string, kNumResourceTypes> ResourceTypeFileSuffix = {
@@ -101,7 +103,8 @@ const std::array<std::string, kNumResourceTypes> ResourceTypeFileSuffix = {
      /*kPointCloudXYZRGBN*/ ".ply",
      /*kVoxbloxTsdfMap*/ ".tsdf.voxblox",
      /*kVoxbloxEsdfMap*/ ".esdf.voxblox",
-     /*kVoxbloxOccupancyMap*/ ".occupancy.voxblox"}};
+     /*kVoxbloxOccupancyMap*/ ".occupancy.voxblox",
+     /*kProjectedDescriptors*/ ".pgm"}};
 
 struct ResourceTypeHash {
   template <typename T>
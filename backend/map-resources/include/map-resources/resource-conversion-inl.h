@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include <Eigen/Core>
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/distortion.h>
 #include <glog/logging.h>
@@ -119,6 +120,26 @@ void getPointFromPointCloud(
     const resources::PointCloud& point_cloud, const size_t index,
     Eigen::Vector3d* point_C, resources::RgbaColor* color);
 
+namespace internal {
+inline void getPixelColor(
+    const cv::Mat& image, const bool has_three_channels, const int u,
+    const int v, resources::RgbaColor* color) {
+  CHECK_NOTNULL(color);
+  if (has_three_channels) {
+    const cv::Vec3b& cv_color = image.at<cv::Vec3b>(v, u);
+    // NOTE: Assumes the image are stored as BGR.
+    (*color)[0] = cv_color[2];
+    (*color)[1] = cv_color[1];
+    (*color)[2] = cv_color[0];
+  } else {
+    (*color)[0] = image.at<uint8_t>(v, u);
+    (*color)[1] = (*color)[0];
+    (*color)[2] = (*color)[0];
+  }
+  (*color)[3] = 255u;
+}
+}  // namespace internal
+
 template <typename PointCloudType>
 bool convertDepthMapToPointCloud(
     const cv::Mat& depth_map, const cv::Mat& image, const aslam::Camera& camera,
@@ -176,18 +197,7 @@ bool convertDepthMapToPointCloud(
       point_C = depth_in_meters * point_C;
 
       if (has_image) {
-        if (has_three_channels) {
-          const cv::Vec3b& cv_color = image.at<cv::Vec3b>(v, u);
-          // NOTE: Assumes the image are stored as BGR.
-          color[0] = cv_color[2];
-          color[1] = cv_color[1];
-          color[2] = cv_color[0];
-        } else {
-          color[0] = image.at<uint8_t>(v, u);
-          color[1] = color[0];
-          color[2] = color[0];
-        }
-        color[3] = 255u;
+        internal::getPixelColor(image, has_three_channels, u, v, &color);
       }
 
       addPointToPointCloud(point_C, color, num_points, point_cloud);
@@ -205,6 +215,83 @@ bool convertDepthMapToPointCloud(
   return true;
 }
 
+template <typename PointCloudType>
+bool DepthMapBackProjector::convertDepthMapToPointCloud(
+    const cv::Mat& depth_map, const cv::Mat& image,
+    PointCloudType* point_cloud) const {
+  CHECK_NOTNULL(point_cloud);
+  CHECK(!depth_map.empty());
+  CHECK_EQ(depth_map.rows, image_height_);
+  CHECK_EQ(depth_map.cols, image_width_);
+  CHECK_EQ(CV_MAT_TYPE(depth_map.type()), CV_16U);
+  // Image should either be grayscale 8bit image or color 3x8bit.
+  CHECK(
+      CV_MAT_TYPE(image.type()) == CV_8UC1 ||
+      CV_MAT_TYPE(image.type()) == CV_8UC3);
+
+  const bool has_image =
+      (depth_map.rows == image.rows) && (depth_map.cols == image.cols);
+
+  const bool has_three_channels = CV_MAT_TYPE(image.type()) == CV_8UC3;
+
+  const size_t valid_depth_entries = cv::countNonZero(depth_map);
+
+  if (valid_depth_entries == 0u) {
+    VLOG(3) << "Depth map has no valid depth measurements!";
+    return false;
+  }
+
+  resizePointCloud(valid_depth_entries, point_cloud);
+
+  constexpr double kMillimetersToMeters = 1e-3;
+
+  resources::RgbaColor color(255u, 255u, 255u, 255u);
+  Eigen::ArrayXd depths_in_meters(image_width_);
+  Eigen::ArrayXd points_x(image_width_);
+  Eigen::ArrayXd points_y(image_width_);
+  size_t num_points = 0u;
+  for (int v = 0; v < depth_map.rows; ++v) {
+    const uint16_t* depth_map_ptr = depth_map.ptr<uint16_t>(v);
+    const size_t row_begin = static_cast<size_t>(v) * image_width_;
+    // The whole row is scaled at once, so these vectorize.
+    depths_in_meters =
+        Eigen::Map<const Eigen::Array<uint16_t, Eigen::Dynamic, 1>>(
+            depth_map_ptr, image_width_)
+            .cast<double>() *
+        kMillimetersToMeters;
+    points_x = depths_in_meters * rays_x_.segment(row_begin, image_width_);
+    points_y = depths_in_meters * rays_y_.segment(row_begin, image_width_);
+
+    for (int u = 0; u < depth_map.cols; ++u) {
+      if (depth_map_ptr[u] == 0u || has_ray_[row_begin + u] == 0u) {
+        continue;
+      }
+
+      if (has_image) {
+        internal::getPixelColor(image, has_three_channels, u, v, &color);
+      }
+
+      addPointToPointCloud(
+          Eigen::Vector3d(points_x[u], points_y[u], depths_in_meters[u]),
+          color, num_points, point_cloud);
+      ++num_points;
+    }
+  }
+  VLOG(3) << "Converted depth map to a point cloud of size " << num_points
+          << ".";
+
+  if (num_points == 0u) {
+    VLOG(3) << "Depth map has no valid depth measurements!";
+    return false;
+  }
+  // Drop the entries of the depths without a ray.
+  if (num_points < valid_depth_entries) {
+    resizePointCloud(num_points, point_cloud);
+  }
+
+  return true;
+}
+
 template <typename InputPointCloud, typename OutputPointCloud>
 bool convertPointCloudType(
     const InputPointCloud& input_cloud, OutputPointCloud* output_cloud) {
@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include <Eigen/Core>
 #include <aslam/cameras/camera.h>
 #include <maplab-common/pose_types.h>
 #include <opencv2/core.hpp>
@@ -40,6 +41,31 @@ bool convertDepthMapWithImageToPointCloud(
     const cv::Mat& depth_map, const cv::Mat& image, const aslam::Camera& camera,
     pose::Position3DVector* points_C, voxblox::Colors* colors);
 
+// Converts the depth maps of a camera to point clouds like
+// convertDepthMapToPointCloud(), but the rays of all pixels are back-projected
+// once when constructing it. Converting a depth map then only scales the
+// precomputed rays of every image row by the depths, instead of calling the
+// camera model for every pixel. Create one per camera and reuse it for all its
+// depth maps, which need to have the size of the camera image.
+class DepthMapBackProjector {
+ public:
+  explicit DepthMapBackProjector(const aslam::Camera& camera);
+
+  template <typename PointCloudType>
+  bool convertDepthMapToPointCloud(
+      const cv::Mat& depth_map, const cv::Mat& image,
+      PointCloudType* point_cloud) const;
+
+ private:
+  const int image_width_;
+  const int image_height_;
+  // Ray of every pixel in row-major order, scaled to a depth of 1.
+  Eigen::ArrayXd rays_x_;
+  Eigen::ArrayXd rays_y_;
+  // Pixels whose ray doesn't point in front of the camera get no point.
+  std::vector<unsigned char> has_ray_;
+};
+
 // In maplab we usually store the camera with the full distortion model, however
 // the images that correspond to the depth maps are usually computed from
 // undistorted images, therefore we need to be able to obtain a version of the
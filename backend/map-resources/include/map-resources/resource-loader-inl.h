@@ -1,7 +1,10 @@
 #ifndef MAP_RESOURCES_RESOURCE_LOADER_INL_H_
 #define MAP_RESOURCES_RESOURCE_LOADER_INL_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
@@ -20,6 +23,16 @@ void ResourceLoader::addResource(
     cache_.putResource<DataType>(id, type, resource);
   }
 
+  if (use_packed_format_) {
+    constexpr bool kCreateIfMissing = true;
+    PackedResourceStore* store =
+        getPackedResourceStore(folder, kCreateIfMissing);
+    if (savePackedResource<DataType>(
+            id, type, resource, CHECK_NOTNULL(store))) {
+      return;
+    }
+  }
+
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   saveResourceToFile(file_path, type, resource);
@@ -34,14 +47,109 @@ void ResourceLoader::getResource(
   if (cache_.getResource<DataType>(id, type, resource)) {
     return;
   } else {
-    std::string file_path;
-    getResourceFilePath(id, type, folder, &file_path);
-    CHECK(loadResourceFromFile(file_path, type, resource))
+    CHECK(loadResource(id, type, folder, resource))
         << "Failed to load " << ResourceTypeNames[static_cast<size_t>(type)]
         << " resource with id " << id.hexString()
-        << " from file: " << file_path;
-    cache_.putResource<DataType>(id, type, *resource);
+        << " from folder: " << folder;
+    cache_.putResourceIfMissing<DataType>(id, type, *resource);
+  }
+}
+
+template <typename DataType>
+bool ResourceLoader::getCachedResource(
+    const ResourceId& id, const ResourceType& type, DataType* resource) const {
+  CHECK_NOTNULL(resource);
+  return cache_.getResource<DataType>(id, type, resource);
+}
+
+template <typename DataType>
+bool ResourceLoader::loadResource(
+    const ResourceId& id, const ResourceType& type, const std::string& folder,
+    DataType* resource) const {
+  CHECK(!folder.empty());
+  CHECK_NOTNULL(resource);
+  constexpr bool kCreateIfMissing = false;
+  const PackedResourceStore* store =
+      getPackedResourceStore(folder, kCreateIfMissing);
+  PackedResourceStore::Entry entry;
+  if (store != nullptr && store->getEntry(id, type, &entry)) {
+    return loadPackedResource(*store, entry, type, resource);
+  }
+
+  std::string file_path;
+  getResourceFilePath(id, type, folder, &file_path);
+  return loadResourceFromFile(file_path, type, resource);
+}
+
+template <typename DataType>
+bool ResourceLoader::loadResourceCoalesced(
+    const ResourceId& id, const ResourceType& type, const std::string& folder,
+    const size_t generation, DataType* resource) const {
+  CHECK_NOTNULL(resource);
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, kNumResourceTypes);
+
+  std::shared_ptr<PendingLoad> pending_load;
+  {
+    std::unique_lock<std::mutex> lock(m_pending_loads_);
+    PendingLoadMap& pending_loads = pending_loads_[type_idx];
+    const PendingLoadMap::iterator it = pending_loads.find(id);
+    if (it == pending_loads.end()) {
+      pending_load = std::make_shared<PendingLoad>(generation);
+      pending_loads.emplace(id, pending_load);
+    } else if (it->second->generation == generation) {
+      const std::shared_ptr<PendingLoad> other_load = it->second;
+      ++other_load->num_waiters;
+      cv_pending_loads_.wait(
+          lock, [&other_load]() { return other_load->is_done; });
+      lock.unlock();
+      if (other_load->success) {
+        *resource = *std::static_pointer_cast<DataType>(other_load->resource);
+      }
+      return other_load->success;
+    }
+    // Otherwise, a load of an outdated generation is in progress and this
+    // one goes ahead on its own.
   }
+
+  if (pending_load == nullptr) {
+    return loadResource(id, type, folder, resource);
+  }
+
+  std::shared_ptr<DataType> loaded_resource = std::make_shared<DataType>();
+  const bool success = loadResource(id, type, folder, loaded_resource.get());
+  bool has_waiters;
+  {
+    std::lock_guard<std::mutex> lock(m_pending_loads_);
+    pending_load->success = success;
+    pending_load->resource = loaded_resource;
+    pending_load->is_done = true;
+    has_waiters = pending_load->num_waiters > 0u;
+    pending_loads_[type_idx].erase(id);
+  }
+  cv_pending_loads_.notify_all();
+
+  if (success) {
+    if (has_waiters) {
+      *resource = *loaded_resource;
+    } else {
+      *resource = std::move(*loaded_resource);
+    }
+  }
+  return success;
+}
+
+template <typename DataType>
+void ResourceLoader::addResourceToCache(
+    const ResourceId& id, const ResourceType& type,
+    const DataType& resource) const {
+  cache_.putResourceIfMissing<DataType>(id, type, resource);
+}
+
+template <typename DataType>
+bool ResourceLoader::isResourceCached(
+    const ResourceId& id, const ResourceType& type) const {
+  return cache_.hasResource<DataType>(id, type);
 }
 
 template <typename DataType>
@@ -50,9 +158,7 @@ bool ResourceLoader::checkResourceFile(
     const std::string& folder) const {
   CHECK(!folder.empty());
   DataType resource;
-  std::string file_path;
-  getResourceFilePath(id, type, folder, &file_path);
-  return loadResourceFromFile(file_path, type, &resource);
+  return loadResource(id, type, folder, &resource);
 }
 
 template <typename DataType>
@@ -94,6 +200,24 @@ bool ResourceLoader::loadResourceFromFile(
   return false;
 }
 
+template <typename DataType>
+bool ResourceLoader::savePackedResource(
+    const ResourceId& /*id*/, const ResourceType& /*type*/,
+    const DataType& /*resource*/, PackedResourceStore* /*store*/) const {
+  return false;
+}
+
+template <typename DataType>
+bool ResourceLoader::loadPackedResource(
+    const PackedResourceStore& /*store*/,
+    const PackedResourceStore::Entry& /*entry*/, const ResourceType& type,
+    DataType* /*resource*/) const {
+  LOG(FATAL) << "ResourceLoader::loadPackedResource() is not implemented for "
+             << "resource type " << ResourceTypeNames[static_cast<size_t>(type)]
+             << ".";
+  return false;
+}
+
 }  // namespace backend
 
 #endif  // MAP_RESOURCES_RESOURCE_LOADER_INL_H_
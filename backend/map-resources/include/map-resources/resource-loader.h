@@ -1,8 +1,15 @@
 #ifndef MAP_RESOURCES_RESOURCE_LOADER_H_
 #define MAP_RESOURCES_RESOURCE_LOADER_H_
 
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
+#include "map-resources/image-codec.h"
+#include "map-resources/packed-resource-store.h"
 #include "map-resources/resource-cache.h"
 #include "map-resources/resource-common.h"
 
@@ -10,8 +17,11 @@ namespace backend {
 
 class ResourceLoader {
  public:
-  ResourceLoader() {}
+  ResourceLoader();
 
+  // Copies or moves the resource file without decoding it. Safe to call
+  // concurrently for different resources. Resources that were already
+  // migrated by an interrupted previous migration are skipped.
   void migrateResource(
       const ResourceId& id, const ResourceType& type,
       const std::string& old_folder, const std::string& new_folder,
@@ -32,6 +42,28 @@ class ResourceLoader {
       const ResourceId& id, const ResourceType& type, const std::string& folder,
       DataType* resource) const;
 
+  // Returns false if the resource is not cached.
+  template <typename DataType>
+  bool getCachedResource(
+      const ResourceId& id, const ResourceType& type, DataType* resource) const;
+
+  // Loads the resource from the packed container of the folder if it is part
+  // of it and from its own file otherwise. Bypasses the cache, hence it is safe
+  // to call concurrently with other const methods.
+  template <typename DataType>
+  bool loadResource(
+      const ResourceId& id, const ResourceType& type, const std::string& folder,
+      DataType* resource) const;
+
+  // Same as loadResource(), but concurrent calls for the same resource and
+  // generation share a single load: the first caller reads and decodes the
+  // resource and the others wait for a copy of it. The generation has to
+  // change whenever the resource file is modified.
+  template <typename DataType>
+  bool loadResourceCoalesced(
+      const ResourceId& id, const ResourceType& type, const std::string& folder,
+      const size_t generation, DataType* resource) const;
+
   template <typename DataType>
   bool checkResourceFile(
       const ResourceId& id, const ResourceType& type,
@@ -42,7 +74,18 @@ class ResourceLoader {
       const ResourceId& id, const ResourceType& type, const std::string& folder,
       const DataType& resource);
 
-  const CacheStatistic& getCacheStatistic() const;
+  // Adds an already loaded resource to the cache, unless it is cached
+  // already. Used to prefetch resources.
+  template <typename DataType>
+  void addResourceToCache(
+      const ResourceId& id, const ResourceType& type,
+      const DataType& resource) const;
+
+  template <typename DataType>
+  bool isResourceCached(const ResourceId& id, const ResourceType& type) const;
+
+  CacheStatistic getCacheStatistic() const;
+  size_t getCacheMemoryUsageBytes() const;
 
   const ResourceCache::Config& getCacheConfig() const;
 
@@ -70,8 +113,60 @@ class ResourceLoader {
       const std::string& file_path, const ResourceType& type,
       DataType* resource) const;
 
+  // Stores the resource in the packed container, returns false if the data
+  // type does not support the packed format.
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Optionally implement and add declaration
+  // below.
+  template <typename DataType>
+  bool savePackedResource(
+      const ResourceId& id, const ResourceType& type, const DataType& resource,
+      PackedResourceStore* store) const;
+
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Optionally implement and add declaration
+  // below.
+  template <typename DataType>
+  bool loadPackedResource(
+      const PackedResourceStore& store,
+      const PackedResourceStore::Entry& entry, const ResourceType& type,
+      DataType* resource) const;
+
  private:
+  // Returns nullptr if the folder has no packed container and
+  // create_if_missing is false.
+  PackedResourceStore* getPackedResourceStore(
+      const std::string& folder, const bool create_if_missing) const;
+
   mutable ResourceCache cache_;
+
+  struct PendingLoad {
+    explicit PendingLoad(const size_t _generation) : generation(_generation) {}
+    const size_t generation;
+    size_t num_waiters = 0u;
+    bool is_done = false;
+    bool success = false;
+    // Points to the loaded DataType.
+    std::shared_ptr<void> resource;
+  };
+  typedef std::unordered_map<ResourceId, std::shared_ptr<PendingLoad>>
+      PendingLoadMap;
+
+  // Loads in progress by resource type.
+  mutable std::mutex m_pending_loads_;
+  mutable std::condition_variable cv_pending_loads_;
+  mutable std::array<PendingLoadMap, kNumResourceTypes> pending_loads_;
+
+  // Store new resources in the packed container of their folder, if their
+  // data type supports it.
+  const bool use_packed_format_;
+
+  // Encoding of new image and depth map files. Existing files are decoded
+  // according to their content.
+  const ImageCodec image_codec_;
+
+  // Packed containers by resource folder, nullptr for folders without one.
+  mutable std::mutex m_packed_stores_;
+  mutable std::unordered_map<std::string, std::unique_ptr<PackedResourceStore>>
+      packed_stores_;
 };
 
 // Implementation for cv::Mat resources.
@@ -84,6 +179,15 @@ bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     cv::Mat* resource) const;
 
+template <>
+bool ResourceLoader::savePackedResource(
+    const ResourceId& id, const ResourceType& type, const cv::Mat& resource,
+    PackedResourceStore* store) const;
+template <>
+bool ResourceLoader::loadPackedResource(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, cv::Mat* resource) const;
+
 // Implementation for std::string resources.
 template <>
 void ResourceLoader::saveResourceToFile(
@@ -93,6 +197,14 @@ template <>
 bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     std::string* resource) const;
+template <>
+bool ResourceLoader::savePackedResource(
+    const ResourceId& id, const ResourceType& type,
+    const std::string& resource, PackedResourceStore* store) const;
+template <>
+bool ResourceLoader::loadPackedResource(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, std::string* resource) const;
 
 // Implementation for voxblox::TsdfMap resources.
 template <>
@@ -133,6 +245,14 @@ template <>
 bool ResourceLoader::loadResourceFromFile(
     const std::string& file_path, const ResourceType& type,
     resources::PointCloud* resource) const;
+template <>
+bool ResourceLoader::savePackedResource(
+    const ResourceId& id, const ResourceType& type,
+    const resources::PointCloud& resource, PackedResourceStore* store) const;
+template <>
+bool ResourceLoader::loadPackedResource(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, resources::PointCloud* resource) const;
 
 }  // namespace backend
 
@@ -14,18 +14,92 @@ template <typename DataType>
 bool ResourceMap::getResource(
     const ResourceId& id, const ResourceType& type, DataType* resource) const {
   CHECK_NOTNULL(resource);
-  aslam::ScopedWriteLock lock(&resource_mutex_);
-  const ResourceInfoMap& info_map =
-      resource_info_map_[static_cast<size_t>(type)];
-  const ResourceInfoMap::const_iterator it = info_map.find(id);
-  if (it == info_map.cend()) {
-    return false;
-  } else {
+  const size_t type_idx = static_cast<size_t>(type);
+  notifyPrefetcherOfAccess(id, type);
+  while (true) {
     std::string folder;
+    size_t modification_count;
+    {
+      aslam::ScopedReadLock lock(&resource_mutex_);
+      const ResourceInfoMap& info_map = resource_info_map_[type_idx];
+      const ResourceInfoMap::const_iterator it = info_map.find(id);
+      if (it == info_map.cend()) {
+        return false;
+      }
+      getFolderFromIndex(it->second.folder_idx, &folder);
+      modification_count = resource_modification_count_[type_idx];
+    }
+
+    // Reading and decoding happens without holding the lock, such that
+    // concurrent readers of other resources are not serialized.
+    if (resource_loader_.getCachedResource<DataType>(id, type, resource)) {
+      return true;
+    }
+    const bool success = resource_loader_.loadResourceCoalesced<DataType>(
+        id, type, folder, modification_count, resource);
+
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    if (modification_count == resource_modification_count_[type_idx]) {
+      CHECK(success) << "Failed to load " << ResourceTypeNames[type_idx]
+                     << " resource with id " << id.hexString()
+                     << " from folder: " << folder;
+      resource_loader_.addResourceToCache<DataType>(id, type, *resource);
+      return true;
+    }
+    // The resource files were modified in the meantime, don't put a possibly
+    // stale copy into the cache.
+    if (success) {
+      return true;
+    }
+  }
+}
+
+template <typename DataType>
+void ResourceMap::prefetchResources(
+    const ResourceIdList& ids, const ResourceType& type) const {
+  ResourcePrefetcher* prefetcher = getPrefetcher();
+  if (prefetcher == nullptr || ids.empty()) {
+    return;
+  }
+  prefetcher->prefetch(type, ids, [this, type](const ResourceId& id) {
+    prefetchResourceIntoCache<DataType>(id, type);
+  });
+}
+
+template <typename DataType>
+void ResourceMap::prefetchResourceIntoCache(
+    const ResourceId& id, const ResourceType& type) const {
+  std::string folder;
+  size_t modification_count;
+  {
+    aslam::ScopedReadLock lock(&resource_mutex_);
+    const ResourceInfoMap& info_map =
+        resource_info_map_[static_cast<size_t>(type)];
+    const ResourceInfoMap::const_iterator it = info_map.find(id);
+    if (it == info_map.cend() ||
+        resource_loader_.isResourceCached<DataType>(id, type)) {
+      return;
+    }
     getFolderFromIndex(it->second.folder_idx, &folder);
+    modification_count =
+        resource_modification_count_[static_cast<size_t>(type)];
+  }
 
-    resource_loader_.getResource<DataType>(id, type, folder, resource);
-    return true;
+  DataType resource;
+  if (!resource_loader_.loadResourceCoalesced(
+          id, type, folder, modification_count, &resource)) {
+    LOG(WARNING) << "Failed to prefetch "
+                 << ResourceTypeNames[static_cast<size_t>(type)]
+                 << " resource with id " << id.hexString()
+                 << " from folder: " << folder;
+    return;
+  }
+
+  // Inserting into the cache modifies it, so it requires the write lock.
+  aslam::ScopedWriteLock lock(&resource_mutex_);
+  if (modification_count ==
+      resource_modification_count_[static_cast<size_t>(type)]) {
+    resource_loader_.addResourceToCache<DataType>(id, type, resource);
   }
 }
 
@@ -110,6 +184,7 @@ bool ResourceMap::deleteResource(
     return false;
   }
 
+  ++resource_modification_count_[static_cast<size_t>(type)];
   if (!keep_resource_file) {
     std::string folder;
     getFolderFromIndex(it->second.folder_idx, &folder);
@@ -129,6 +204,7 @@ bool ResourceMap::replaceResource(
 
   // Check if resource exists, if not we just add it.
   if (it != info_map.cend()) {
+    ++resource_modification_count_[static_cast<size_t>(type)];
     std::string folder;
     getFolderFromIndex(it->second.folder_idx, &folder);
     resource_loader_.replaceResource<DataType>(id, type, folder, resource);
@@ -1,6 +1,8 @@
 #ifndef MAP_RESOURCES_RESOURCE_MAP_H_
 #define MAP_RESOURCES_RESOURCE_MAP_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,6 +11,7 @@
 
 #include "map-resources/resource-common.h"
 #include "map-resources/resource-loader.h"
+#include "map-resources/resource-prefetcher.h"
 
 #include "map-resources/resource_metadata.pb.h"
 
@@ -75,6 +78,9 @@ class ResourceMap {
     std::vector<std::string> external_resource_folders;
   };
 
+  // Resources are migrated in parallel with
+  // --resource_migration_num_threads. An interrupted migration can be
+  // resumed by migrating to the same folder again.
   void migrateAllResourcesToFolder(
       const std::string& resource_folder, const bool move_resources);
   void migrateAllResourcesToMapResourceFolder(const bool move_resources);
@@ -137,6 +143,9 @@ class ResourceMap {
   // Get a copy of the current cache statistic state.
   CacheStatistic getResourceCacheStatisticCopy() const;
 
+  // Memory used by the resources in the cache.
+  size_t getResourceCacheMemoryUsageBytes() const;
+
   size_t getNumResourceCacheMiss(const ResourceType& type) const;
   size_t getNumResourceCacheHits(const ResourceType& type) const;
 
@@ -168,6 +177,9 @@ class ResourceMap {
   // resource files.
   bool checkResourceFileSystem() const;
 
+  // Stops all background prefetching, see prefetchResources().
+  void cancelPrefetching() const;
+
  protected:
   // Check if the resource file is present and attempt to load it to verify its
   // content.
@@ -192,10 +204,23 @@ class ResourceMap {
   void addResource(
       const ResourceType& type, const DataType& resource, const ResourceId& id);
 
+  // Reads and decodes the resource without holding the resource lock, hence
+  // concurrent calls don't block each other and calls for the same resource
+  // share a single load. A call that runs concurrently with a replacement of
+  // the resource returns either version, but stale versions are never cached.
   template <typename DataType>
   bool getResource(
       const ResourceId& id, const ResourceType& type, DataType* resource) const;
 
+  // Loads the resources into the resource cache on background threads, such
+  // that a consumer that calls getResource() in the same order finds them in
+  // the cache instead of waiting for the disk. The prefetcher stays at most
+  // --resource_prefetch_lookahead resources (limited by the cache size) ahead
+  // of the consumer. Replaces a previous prefetch of the same resource type.
+  template <typename DataType>
+  void prefetchResources(
+      const ResourceIdList& ids, const ResourceType& type) const;
+
   // Returns true if the resource was successfully deleted, false if it didn't
   // exist in the first place. By default it also deletes the file on the
   // file-system.
@@ -235,6 +260,19 @@ class ResourceMap {
 
   bool resourceFileExists(const ResourceId& id, const ResourceType& type) const;
 
+  // Loads a single resource into the cache on a prefetcher thread. Only holds
+  // the resource lock for the lookup and the cache insertion, not while the
+  // file is loaded.
+  template <typename DataType>
+  void prefetchResourceIntoCache(
+      const ResourceId& id, const ResourceType& type) const;
+
+  // Returns nullptr if the cache is disabled, in which case prefetching is
+  // pointless. The prefetcher is created on first use.
+  ResourcePrefetcher* getPrefetcher() const;
+  void notifyPrefetcherOfAccess(
+      const ResourceId& id, const ResourceType& type) const;
+
   MetaData meta_data_;
 
   typedef std::unordered_map<ResourceId, ResourceInfo> ResourceInfoMap;
@@ -244,6 +282,16 @@ class ResourceMap {
   ResourceLoader resource_loader_;
 
   mutable aslam::ReaderWriterMutex resource_mutex_;
+
+  // Per resource type, incremented whenever resource files are deleted,
+  // replaced or moved, such that prefetched copies loaded concurrently are not
+  // put into the cache. Guarded by resource_mutex_.
+  std::vector<size_t> resource_modification_count_;
+
+  // Declared last, such that the prefetcher threads are joined before any of
+  // the members above are destroyed.
+  mutable std::mutex m_prefetcher_;
+  mutable std::unique_ptr<ResourcePrefetcher> prefetcher_;
 };
 
 }  // namespace backend
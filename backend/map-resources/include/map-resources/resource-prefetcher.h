@@ -0,0 +1,80 @@
+#ifndef MAP_RESOURCES_RESOURCE_PREFETCHER_H_
+#define MAP_RESOURCES_RESOURCE_PREFETCHER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+// Loads sequences of resources on a pool of background I/O threads, ahead of
+// a consumer that accesses them in the same order. There is one sequence per
+// resource type, such that e.g. depth maps and images can be prefetched at
+// the same time. At most lookahead_window resources of a sequence are loaded
+// ahead of the last resource of that sequence the consumer has accessed.
+class ResourcePrefetcher {
+ public:
+  // Loads the resource, e.g. into a resource cache.
+  typedef std::function<void(const ResourceId&)> LoadFunction;
+
+  ResourcePrefetcher(size_t num_threads, size_t lookahead_window);
+  ~ResourcePrefetcher();
+
+  // Replaces the current sequence of this resource type. Resources that are
+  // already being loaded are not interrupted.
+  void prefetch(
+      const ResourceType& type, const ResourceIdList& ids,
+      const LoadFunction& load_function);
+
+  void cancel(const ResourceType& type);
+  void cancelAll();
+
+  // Must be called by the consumer before it accesses a resource. Moves the
+  // lookahead window past the resource if it is part of the sequence and
+  // waits until it is loaded if it currently is in flight.
+  void notifyAccessAndWaitIfLoading(
+      const ResourceId& id, const ResourceType& type);
+
+  // True if no resource is being loaded and all sequences are either done or
+  // waiting for the consumer to catch up.
+  bool isIdle() const;
+
+ private:
+  struct Sequence {
+    ResourceIdList ids;
+    std::unordered_map<ResourceId, size_t> id_to_position;
+    LoadFunction load_function;
+    // Position of the next resource to load.
+    size_t next_position = 0u;
+    // Position after the last resource accessed by the consumer.
+    size_t consumer_position = 0u;
+  };
+
+  // Whether the next resource of the sequence is within the lookahead window.
+  bool hasResourceToLoad(const Sequence& sequence) const;
+  // Returns true and the next resource to load if there is one within the
+  // lookahead window of any sequence. Must be called with m_state_ held.
+  bool getNextResourceToLoad(ResourceId* id, LoadFunction* load_function);
+  void workerLoop();
+
+  const size_t lookahead_window_;
+
+  mutable std::mutex m_state_;
+  std::condition_variable cv_work_available_;
+  std::condition_variable cv_resource_loaded_;
+  std::unordered_map<ResourceType, Sequence, ResourceTypeHash> sequences_;
+  std::unordered_set<ResourceId> resources_in_flight_;
+  bool shutdown_requested_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace backend
+
+#endif  // MAP_RESOURCES_RESOURCE_PREFETCHER_H_
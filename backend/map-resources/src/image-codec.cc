@@ -0,0 +1,272 @@
+#include "map-resources/image-codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <sstream>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+DEFINE_string(
+    resource_image_codec, "pnm",
+    "Encoding of new image and depth map resource files: 'pnm' or 'deflate'. "
+    "'deflate' stores the raw pixels compressed in parallel. Files in either "
+    "encoding can always be read.");
+DEFINE_int32(
+    resource_image_codec_compression_level, 1,
+    "Compression level of the 'deflate' image codec, from 1 (fastest) to 9 "
+    "(smallest).");
+
+namespace backend {
+namespace {
+constexpr char kDeflateMagic[] = {'M', 'L', 'I', 'M', 'G', 'Z', '0', '1'};
+// Smaller images are compressed in fewer blocks, such that the compression
+// ratio does not suffer.
+constexpr size_t kMinNumBytesPerBlock = 64u * 1024u;
+
+struct DeflateImageHeader {
+  char magic[sizeof(kDeflateMagic)];
+  int32_t rows;
+  int32_t cols;
+  int32_t cv_type;
+  uint32_t num_blocks;
+};
+
+bool compressBlock(
+    const unsigned char* data, const size_t num_bytes,
+    std::string* compressed) {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(compressed)->clear();
+  google::protobuf::io::StringOutputStream string_output_stream(compressed);
+  google::protobuf::io::GzipOutputStream::Options options;
+  options.format = google::protobuf::io::GzipOutputStream::ZLIB;
+  options.compression_level = FLAGS_resource_image_codec_compression_level;
+  google::protobuf::io::GzipOutputStream gzip_output_stream(
+      &string_output_stream, options);
+
+  size_t num_bytes_written = 0u;
+  while (num_bytes_written < num_bytes) {
+    void* buffer;
+    int buffer_size;
+    if (!gzip_output_stream.Next(&buffer, &buffer_size)) {
+      return false;
+    }
+    const size_t num_bytes_to_copy = std::min<size_t>(
+        static_cast<size_t>(buffer_size), num_bytes - num_bytes_written);
+    std::memcpy(buffer, data + num_bytes_written, num_bytes_to_copy);
+    num_bytes_written += num_bytes_to_copy;
+    if (num_bytes_to_copy < static_cast<size_t>(buffer_size)) {
+      gzip_output_stream.BackUp(buffer_size - num_bytes_to_copy);
+    }
+  }
+  return gzip_output_stream.Close();
+}
+
+bool decompressBlock(
+    const char* compressed, const size_t compressed_num_bytes,
+    const size_t num_bytes, unsigned char* data) {
+  CHECK_NOTNULL(compressed);
+  CHECK_NOTNULL(data);
+  google::protobuf::io::ArrayInputStream array_input_stream(
+      compressed, compressed_num_bytes);
+  google::protobuf::io::GzipInputStream gzip_input_stream(
+      &array_input_stream, google::protobuf::io::GzipInputStream::ZLIB);
+
+  size_t num_bytes_read = 0u;
+  const void* buffer;
+  int buffer_size;
+  while (gzip_input_stream.Next(&buffer, &buffer_size)) {
+    if (num_bytes_read + buffer_size > num_bytes) {
+      return false;
+    }
+    std::memcpy(data + num_bytes_read, buffer, buffer_size);
+    num_bytes_read += buffer_size;
+  }
+  return num_bytes_read == num_bytes;
+}
+
+// Row ranges of the blocks are [block_idx * rows_per_block, ...).
+int getNumRowsPerBlock(const int rows, const uint32_t num_blocks) {
+  CHECK_GT(num_blocks, 0u);
+  return (rows + num_blocks - 1) / num_blocks;
+}
+}  // namespace
+
+ImageCodec getImageCodecFromGflags() {
+  if (FLAGS_resource_image_codec == "pnm") {
+    return ImageCodec::kPnm;
+  } else if (FLAGS_resource_image_codec == "deflate") {
+    return ImageCodec::kDeflate;
+  }
+  LOG(FATAL) << "Unknown image codec: " << FLAGS_resource_image_codec
+             << ". Valid options are 'pnm' and 'deflate'.";
+  return ImageCodec::kPnm;
+}
+
+bool isDeflateImageFile(const std::string& file_path) {
+  CHECK(!file_path.empty());
+  std::ifstream file(file_path, std::ios::binary);
+  char magic[sizeof(kDeflateMagic)];
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, kDeflateMagic, sizeof(magic)) == 0;
+}
+
+bool saveDeflateImage(const cv::Mat& image, const std::string& file_path) {
+  CHECK(!file_path.empty());
+  if (image.empty() || image.dims != 2) {
+    LOG(ERROR) << "Only non-empty 2D images can be deflate compressed.";
+    return false;
+  }
+  const cv::Mat continuous_image =
+      image.isContinuous() ? image : image.clone();
+  const size_t row_num_bytes = image.cols * image.elemSize();
+
+  const size_t num_threads = common::getNumHardwareThreads();
+  const size_t num_blocks = std::max<size_t>(
+      1u, std::min<size_t>(
+              std::min<size_t>(num_threads, image.rows),
+              row_num_bytes * image.rows / kMinNumBytesPerBlock));
+  const int rows_per_block = getNumRowsPerBlock(image.rows, num_blocks);
+
+  std::vector<std::string> compressed_blocks(num_blocks);
+  std::atomic<bool> success(true);
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      num_blocks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t block_idx : range) {
+          const int start_row = block_idx * rows_per_block;
+          const int end_row = std::min(start_row + rows_per_block, image.rows);
+          if (start_row < end_row &&
+              !compressBlock(
+                  continuous_image.ptr(start_row),
+                  (end_row - start_row) * row_num_bytes,
+                  &compressed_blocks[block_idx])) {
+            success = false;
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+  if (!success) {
+    LOG(ERROR) << "Failed to compress image for " << file_path << ".";
+    return false;
+  }
+
+  DeflateImageHeader header;
+  std::memcpy(header.magic, kDeflateMagic, sizeof(kDeflateMagic));
+  header.rows = image.rows;
+  header.cols = image.cols;
+  header.cv_type = image.type();
+  header.num_blocks = num_blocks;
+  std::vector<uint64_t> compressed_block_sizes;
+  compressed_block_sizes.reserve(num_blocks);
+  for (const std::string& compressed_block : compressed_blocks) {
+    compressed_block_sizes.push_back(compressed_block.size());
+  }
+
+  std::ofstream file(file_path, std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << file_path << " for writing.";
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(
+      reinterpret_cast<const char*>(compressed_block_sizes.data()),
+      compressed_block_sizes.size() * sizeof(uint64_t));
+  for (const std::string& compressed_block : compressed_blocks) {
+    file.write(compressed_block.data(), compressed_block.size());
+  }
+  file.close();
+  return !file.fail();
+}
+
+bool loadDeflateImage(const std::string& file_path, cv::Mat* image) {
+  CHECK(!file_path.empty());
+  CHECK_NOTNULL(image)->release();
+  std::ifstream file(file_path, std::ios::binary);
+  if (!file.is_open()) {
+    VLOG(1) << "Could not open image resource file " << file_path;
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string content = buffer.str();
+
+  DeflateImageHeader header;
+  if (content.size() < sizeof(header)) {
+    VLOG(1) << "Image resource file " << file_path << " is truncated.";
+    return false;
+  }
+  std::memcpy(&header, content.data(), sizeof(header));
+  if (std::memcmp(header.magic, kDeflateMagic, sizeof(kDeflateMagic)) != 0 ||
+      header.rows <= 0 || header.cols <= 0 || header.num_blocks == 0u ||
+      header.num_blocks > static_cast<uint32_t>(header.rows)) {
+    VLOG(1) << "Image resource file " << file_path << " has an invalid "
+            << "header.";
+    return false;
+  }
+  const size_t blocks_offset =
+      sizeof(header) + header.num_blocks * sizeof(uint64_t);
+  if (content.size() < blocks_offset) {
+    VLOG(1) << "Image resource file " << file_path << " is truncated.";
+    return false;
+  }
+  std::vector<uint64_t> compressed_block_sizes(header.num_blocks);
+  std::memcpy(
+      compressed_block_sizes.data(), content.data() + sizeof(header),
+      header.num_blocks * sizeof(uint64_t));
+  std::vector<size_t> compressed_block_offsets(header.num_blocks);
+  size_t offset = blocks_offset;
+  for (uint32_t block_idx = 0u; block_idx < header.num_blocks; ++block_idx) {
+    compressed_block_offsets[block_idx] = offset;
+    offset += compressed_block_sizes[block_idx];
+  }
+  if (offset != content.size()) {
+    VLOG(1) << "Image resource file " << file_path << " has an inconsistent "
+            << "size.";
+    return false;
+  }
+
+  image->create(header.rows, header.cols, header.cv_type);
+  const size_t row_num_bytes = image->cols * image->elemSize();
+  const int rows_per_block = getNumRowsPerBlock(header.rows, header.num_blocks);
+
+  std::atomic<bool> success(true);
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      header.num_blocks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t block_idx : range) {
+          const int start_row = block_idx * rows_per_block;
+          const int end_row = std::min(start_row + rows_per_block, image->rows);
+          if (start_row >= end_row) {
+            continue;
+          }
+          if (!decompressBlock(
+                  content.data() + compressed_block_offsets[block_idx],
+                  compressed_block_sizes[block_idx],
+                  (end_row - start_row) * row_num_bytes,
+                  image->ptr(start_row))) {
+            success = false;
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+  if (!success) {
+    VLOG(1) << "Failed to decompress image resource file " << file_path;
+    image->release();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace backend
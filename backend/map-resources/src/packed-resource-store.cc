@@ -0,0 +1,332 @@
+#include "map-resources/packed-resource-store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+
+DEFINE_int32(
+    resource_packed_segment_size_mb, 1024,
+    "Size in MB after which the packed resource container starts a new "
+    "segment file.");
+
+namespace backend {
+namespace {
+const std::string kPackedFolderName = "packed";
+const std::string kIndexFileName = "index";
+const std::string kAddRecord = "add";
+const std::string kDeleteRecord = "del";
+
+std::string getStoreFolder(const std::string& resource_folder) {
+  std::string store_folder;
+  common::concatenateFolderAndFileName(
+      resource_folder, kPackedFolderName, &store_folder);
+  return store_folder;
+}
+
+std::string getIndexPath(const std::string& store_folder) {
+  std::string index_path;
+  common::concatenateFolderAndFileName(
+      store_folder, kIndexFileName, &index_path);
+  return index_path;
+}
+
+size_t getFileSizeBytes(const std::string& file_path) {
+  struct stat file_stat;
+  if (stat(file_path.c_str(), &file_stat) != 0) {
+    return 0u;
+  }
+  return static_cast<size_t>(file_stat.st_size);
+}
+}  // namespace
+
+// Read-only memory mapping of a whole segment file.
+class PackedResourceStore::MappedSegment {
+ public:
+  explicit MappedSegment(const std::string& segment_path)
+      : data_(nullptr), num_bytes_(0u) {
+    const int file_descriptor = open(segment_path.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+      LOG(ERROR) << "Unable to open resource segment " << segment_path;
+      return;
+    }
+    const size_t num_bytes = getFileSizeBytes(segment_path);
+    if (num_bytes > 0u) {
+      void* data = mmap(
+          nullptr, num_bytes, PROT_READ, MAP_SHARED, file_descriptor, 0);
+      if (data == MAP_FAILED) {
+        LOG(ERROR) << "Unable to map resource segment " << segment_path;
+      } else {
+        data_ = static_cast<const char*>(data);
+        num_bytes_ = num_bytes;
+      }
+    }
+    close(file_descriptor);
+  }
+
+  ~MappedSegment() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), num_bytes_);
+    }
+  }
+
+  const char* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return num_bytes_;
+  }
+
+ private:
+  const char* data_;
+  size_t num_bytes_;
+};
+
+PackedResourceStore::PackedResourceStore(const std::string& resource_folder)
+    : store_folder_(getStoreFolder(resource_folder)),
+      index_(kNumResourceTypes),
+      current_segment_index_(0u),
+      current_segment_size_(0u) {
+  CHECK(!resource_folder.empty());
+  if (common::fileExists(getIndexPath(store_folder_))) {
+    loadIndex();
+  }
+}
+
+PackedResourceStore::~PackedResourceStore() {}
+
+bool PackedResourceStore::existsInFolder(const std::string& resource_folder) {
+  return common::fileExists(getIndexPath(getStoreFolder(resource_folder)));
+}
+
+bool PackedResourceStore::hasResource(
+    const ResourceId& id, const ResourceType& type) const {
+  std::lock_guard<std::mutex> lock(m_store_);
+  return index_[static_cast<size_t>(type)].count(id) > 0u;
+}
+
+bool PackedResourceStore::getEntry(
+    const ResourceId& id, const ResourceType& type, Entry* entry) const {
+  CHECK_NOTNULL(entry);
+  std::lock_guard<std::mutex> lock(m_store_);
+  const std::unordered_map<ResourceId, Entry>& type_index =
+      index_[static_cast<size_t>(type)];
+  const std::unordered_map<ResourceId, Entry>::const_iterator it =
+      type_index.find(id);
+  if (it == type_index.end()) {
+    return false;
+  }
+  *entry = it->second;
+  return true;
+}
+
+void PackedResourceStore::addResource(
+    const ResourceId& id, const ResourceType& type, const Layout& layout,
+    const std::vector<DataChunk>& data_chunks) {
+  CHECK(id.isValid());
+  const size_t type_idx = static_cast<size_t>(type);
+  size_t num_bytes = 0u;
+  for (const DataChunk& data_chunk : data_chunks) {
+    CHECK(data_chunk.first != nullptr || data_chunk.second == 0u);
+    num_bytes += data_chunk.second;
+  }
+
+  std::lock_guard<std::mutex> lock(m_store_);
+  CHECK_EQ(index_[type_idx].count(id), 0u)
+      << "Cannot add the same resource to the packed container twice! Id: "
+      << id.hexString();
+
+  if (!index_stream_.is_open()) {
+    CHECK(common::createPath(store_folder_))
+        << "Unable to create packed resource folder " << store_folder_;
+    index_stream_.open(getIndexPath(store_folder_), std::ios::app);
+    CHECK(index_stream_.is_open());
+  }
+
+  CHECK_GT(FLAGS_resource_packed_segment_size_mb, 0);
+  const size_t max_segment_size_bytes =
+      static_cast<size_t>(FLAGS_resource_packed_segment_size_mb) * 1024u *
+      1024u;
+  if (segment_stream_.is_open() && current_segment_size_ > 0u &&
+      current_segment_size_ + num_bytes > max_segment_size_bytes) {
+    segment_stream_.close();
+    ++current_segment_index_;
+    current_segment_size_ = 0u;
+  }
+  if (!segment_stream_.is_open()) {
+    const std::string segment_path = getSegmentPath(current_segment_index_);
+    current_segment_size_ = getFileSizeBytes(segment_path);
+    segment_stream_.open(segment_path, std::ios::app | std::ios::binary);
+    CHECK(segment_stream_.is_open())
+        << "Unable to open resource segment " << segment_path;
+  }
+
+  Entry entry;
+  entry.segment_index = current_segment_index_;
+  entry.offset = current_segment_size_;
+  entry.num_bytes = num_bytes;
+  entry.layout = layout;
+
+  // The payload has to be on disk before the index references it.
+  for (const DataChunk& data_chunk : data_chunks) {
+    segment_stream_.write(
+        static_cast<const char*>(data_chunk.first), data_chunk.second);
+  }
+  segment_stream_.flush();
+  CHECK(segment_stream_.good())
+      << "Failed to write resource " << id.hexString() << " to segment "
+      << getSegmentPath(current_segment_index_);
+  current_segment_size_ += num_bytes;
+
+  std::stringstream line;
+  line << kAddRecord << ' ' << id.hexString() << ' ' << type_idx << ' '
+       << entry.segment_index << ' ' << entry.offset << ' ' << entry.num_bytes
+       << ' ' << layout[0] << ' ' << layout[1] << ' ' << layout[2];
+  appendIndexLine(line.str());
+  index_[type_idx].emplace(id, entry);
+}
+
+bool PackedResourceStore::readData(
+    const Entry& entry, void* destination) const {
+  return readData(entry, 0u, entry.num_bytes, destination);
+}
+
+bool PackedResourceStore::readData(
+    const Entry& entry, size_t offset, size_t num_bytes,
+    void* destination) const {
+  CHECK_LE(offset + num_bytes, entry.num_bytes);
+  if (num_bytes == 0u) {
+    return true;
+  }
+  CHECK_NOTNULL(destination);
+  std::shared_ptr<const MappedSegment> segment;
+  {
+    std::lock_guard<std::mutex> lock(m_store_);
+    segment = getMappedSegment(
+        entry.segment_index, entry.offset + entry.num_bytes);
+  }
+  if (!segment) {
+    return false;
+  }
+  // The mapping stays valid while we hold the reference, even if the segment
+  // is remapped concurrently.
+  std::memcpy(destination, segment->data() + entry.offset + offset, num_bytes);
+  return true;
+}
+
+bool PackedResourceStore::deleteResource(
+    const ResourceId& id, const ResourceType& type) {
+  const size_t type_idx = static_cast<size_t>(type);
+  std::lock_guard<std::mutex> lock(m_store_);
+  if (index_[type_idx].erase(id) == 0u) {
+    return false;
+  }
+  if (!index_stream_.is_open()) {
+    index_stream_.open(getIndexPath(store_folder_), std::ios::app);
+    CHECK(index_stream_.is_open());
+  }
+  std::stringstream line;
+  line << kDeleteRecord << ' ' << id.hexString() << ' ' << type_idx;
+  appendIndexLine(line.str());
+  return true;
+}
+
+size_t PackedResourceStore::numResources() const {
+  std::lock_guard<std::mutex> lock(m_store_);
+  size_t num_resources = 0u;
+  for (const std::unordered_map<ResourceId, Entry>& type_index : index_) {
+    num_resources += type_index.size();
+  }
+  return num_resources;
+}
+
+void PackedResourceStore::loadIndex() {
+  const std::string index_path = getIndexPath(store_folder_);
+  std::ifstream index_file(index_path);
+  CHECK(index_file.is_open()) << "Unable to open " << index_path;
+
+  size_t num_invalid_lines = 0u;
+  std::string line;
+  while (std::getline(index_file, line)) {
+    std::istringstream line_stream(line);
+    std::string record_type, id_string;
+    size_t type_idx;
+    if (!(line_stream >> record_type >> id_string >> type_idx) ||
+        type_idx >= kNumResourceTypes) {
+      ++num_invalid_lines;
+      continue;
+    }
+    ResourceId id;
+    if (!id.fromHexString(id_string)) {
+      ++num_invalid_lines;
+      continue;
+    }
+
+    if (record_type == kAddRecord) {
+      Entry entry;
+      if (!(line_stream >> entry.segment_index >> entry.offset >>
+            entry.num_bytes >> entry.layout[0] >> entry.layout[1] >>
+            entry.layout[2])) {
+        ++num_invalid_lines;
+        continue;
+      }
+      index_[type_idx][id] = entry;
+      current_segment_index_ =
+          std::max(current_segment_index_, entry.segment_index);
+    } else if (record_type == kDeleteRecord) {
+      index_[type_idx].erase(id);
+    } else {
+      ++num_invalid_lines;
+    }
+  }
+  // Truncated lines are expected if a write was interrupted.
+  LOG_IF(WARNING, num_invalid_lines > 0u)
+      << "Skipped " << num_invalid_lines << " invalid lines in the packed "
+      << "resource index " << index_path;
+}
+
+void PackedResourceStore::appendIndexLine(const std::string& line) {
+  CHECK(index_stream_.is_open());
+  index_stream_ << line << '\n';
+  index_stream_.flush();
+  CHECK(index_stream_.good())
+      << "Failed to write to the packed resource index in " << store_folder_;
+}
+
+std::string PackedResourceStore::getSegmentPath(size_t segment_index) const {
+  std::stringstream segment_name;
+  segment_name << "segment_" << std::setw(6) << std::setfill('0')
+               << segment_index << ".bin";
+  std::string segment_path;
+  common::concatenateFolderAndFileName(
+      store_folder_, segment_name.str(), &segment_path);
+  return segment_path;
+}
+
+std::shared_ptr<const PackedResourceStore::MappedSegment>
+PackedResourceStore::getMappedSegment(
+    size_t segment_index, size_t min_num_bytes) const {
+  std::shared_ptr<const MappedSegment>& segment =
+      mapped_segments_[segment_index];
+  if (!segment || segment->size() < min_num_bytes) {
+    // Segments only grow, so a mapping that is too small is replaced.
+    segment.reset(new MappedSegment(getSegmentPath(segment_index)));
+    if (segment->size() < min_num_bytes) {
+      LOG(ERROR) << "Resource segment " << getSegmentPath(segment_index)
+                 << " is truncated.";
+      segment.reset();
+    }
+  }
+  return segment;
+}
+
+}  // namespace backend
@@ -0,0 +1,346 @@
+#include "map-resources/point-cloud-ply.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <sstream>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace backend {
+namespace {
+constexpr char kEndHeader[] = "end_header\n";
+constexpr size_t kNumVerticesPerWriteChunk = 64u * 1024u;
+
+inline bool isLittleEndianHost() {
+  const uint16_t value = 1u;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &value, sizeof(first_byte));
+  return first_byte == 1u;
+}
+
+// Returns 0 for unknown types.
+size_t getPropertyTypeSize(const std::string& type) {
+  if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") {
+    return 1u;
+  } else if (
+      type == "short" || type == "ushort" || type == "int16" ||
+      type == "uint16") {
+    return 2u;
+  } else if (
+      type == "int" || type == "uint" || type == "int32" || type == "uint32" ||
+      type == "float" || type == "float32") {
+    return 4u;
+  } else if (type == "double" || type == "float64") {
+    return 8u;
+  }
+  return 0u;
+}
+
+enum class ScalarType { kUnsupported, kFloat, kDouble, kUchar };
+
+ScalarType getScalarType(const std::string& type) {
+  if (type == "float" || type == "float32") {
+    return ScalarType::kFloat;
+  } else if (type == "double" || type == "float64") {
+    return ScalarType::kDouble;
+  } else if (type == "uchar" || type == "uint8") {
+    return ScalarType::kUchar;
+  }
+  return ScalarType::kUnsupported;
+}
+
+// Location of a property of the vertex element that is read.
+struct PropertyLayout {
+  PropertyLayout() : offset(0u), type(ScalarType::kUnsupported) {}
+  size_t offset;
+  ScalarType type;
+  bool isSet() const {
+    return type != ScalarType::kUnsupported;
+  }
+};
+
+// Properties x, y, z, nx, ny, nz, red, green, blue.
+constexpr size_t kNumProperties = 9u;
+constexpr size_t kNormalsOffset = 3u;
+constexpr size_t kColorsOffset = 6u;
+const char* const kPropertyNames[kNumProperties] = {
+    "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"};
+
+struct VertexLayout {
+  VertexLayout() : num_vertices(0u), data_offset(0u), stride(0u) {}
+  size_t num_vertices;
+  // Offset of the vertex element from the start of the file.
+  size_t data_offset;
+  size_t stride;
+  std::array<PropertyLayout, kNumProperties> properties;
+};
+
+// Parses the header up to and including the vertex element. Elements before
+// the vertex element are skipped and may not have list properties.
+bool parseHeader(
+    const char* data, const size_t num_bytes, VertexLayout* layout) {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(layout);
+  const char* const end_header = std::search(
+      data, data + num_bytes, kEndHeader, kEndHeader + sizeof(kEndHeader) - 1);
+  if (end_header == data + num_bytes) {
+    return false;
+  }
+  std::istringstream header(std::string(data, end_header));
+  size_t elements_offset = (end_header - data) + sizeof(kEndHeader) - 1;
+
+  std::string line;
+  if (!std::getline(header, line) || line != "ply" ||
+      !std::getline(header, line) ||
+      line != "format binary_little_endian 1.0") {
+    return false;
+  }
+
+  // Name, count and stride of the element whose properties are parsed.
+  std::string element;
+  size_t element_count = 0u;
+  size_t element_stride = 0u;
+  bool has_vertex_element = false;
+  while (std::getline(header, line)) {
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "element") {
+      if (element == "vertex") {
+        break;
+      }
+      elements_offset += element_count * element_stride;
+      element_stride = 0u;
+      if (!(tokens >> element >> element_count)) {
+        return false;
+      }
+      if (element == "vertex") {
+        has_vertex_element = true;
+      }
+    } else if (keyword == "property") {
+      std::string type;
+      std::string name;
+      if (!(tokens >> type >> name) || element.empty() || type == "list") {
+        // List properties have a variable size.
+        return false;
+      }
+      const size_t type_size = getPropertyTypeSize(type);
+      if (type_size == 0u) {
+        return false;
+      }
+      if (element == "vertex") {
+        for (size_t property_idx = 0u; property_idx < kNumProperties;
+             ++property_idx) {
+          if (name == kPropertyNames[property_idx]) {
+            layout->properties[property_idx].offset = element_stride;
+            layout->properties[property_idx].type = getScalarType(type);
+          }
+        }
+      }
+      element_stride += type_size;
+    }
+    // Comments and obj_info are skipped.
+  }
+  if (!has_vertex_element) {
+    return false;
+  }
+
+  layout->num_vertices = element_count;
+  layout->data_offset = elements_offset;
+  layout->stride = element_stride;
+  return layout->data_offset + layout->num_vertices * layout->stride <=
+         num_bytes;
+}
+
+// Returns true if the properties [begin, begin + 3) are set and have one of
+// the given types.
+bool hasPropertyTriplet(
+    const VertexLayout& layout, const size_t begin, const ScalarType type_a,
+    const ScalarType type_b) {
+  for (size_t property_idx = begin; property_idx < begin + 3u;
+       ++property_idx) {
+    const ScalarType type = layout.properties[property_idx].type;
+    if (type != type_a && type != type_b) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline float readFloat(const char* data, const PropertyLayout& property) {
+  if (property.type == ScalarType::kFloat) {
+    float value;
+    std::memcpy(&value, data + property.offset, sizeof(value));
+    return value;
+  }
+  double value;
+  std::memcpy(&value, data + property.offset, sizeof(value));
+  return static_cast<float>(value);
+}
+
+bool fillPointCloud(
+    const char* data, const size_t num_bytes,
+    resources::PointCloud* point_cloud) {
+  CHECK_NOTNULL(point_cloud);
+  VertexLayout layout;
+  if (!parseHeader(data, num_bytes, &layout)) {
+    return false;
+  }
+  if (!hasPropertyTriplet(
+          layout, 0u, ScalarType::kFloat, ScalarType::kDouble)) {
+    return false;
+  }
+  const bool has_normals = hasPropertyTriplet(
+      layout, kNormalsOffset, ScalarType::kFloat, ScalarType::kDouble);
+  const bool has_colors = hasPropertyTriplet(
+      layout, kColorsOffset, ScalarType::kUchar, ScalarType::kUchar);
+  for (size_t property_idx = kNormalsOffset; property_idx < kNumProperties;
+       ++property_idx) {
+    const bool is_read = property_idx < kColorsOffset ? has_normals
+                                                      : has_colors;
+    if (layout.properties[property_idx].isSet() && !is_read) {
+      // Incomplete normals or colors of a different type.
+      return false;
+    }
+  }
+
+  const size_t num_vertices = layout.num_vertices;
+  point_cloud->xyz.resize(3u * num_vertices);
+  point_cloud->normals.resize(has_normals ? 3u * num_vertices : 0u);
+  point_cloud->colors.resize(has_colors ? 3u * num_vertices : 0u);
+
+  const char* vertex = data + layout.data_offset;
+  for (size_t vertex_idx = 0u; vertex_idx < num_vertices;
+       ++vertex_idx, vertex += layout.stride) {
+    const size_t value_idx = 3u * vertex_idx;
+    for (size_t dim = 0u; dim < 3u; ++dim) {
+      point_cloud->xyz[value_idx + dim] =
+          readFloat(vertex, layout.properties[dim]);
+    }
+    if (has_normals) {
+      for (size_t dim = 0u; dim < 3u; ++dim) {
+        point_cloud->normals[value_idx + dim] =
+            readFloat(vertex, layout.properties[kNormalsOffset + dim]);
+      }
+    }
+    if (has_colors) {
+      for (size_t dim = 0u; dim < 3u; ++dim) {
+        point_cloud->colors[value_idx + dim] = static_cast<unsigned char>(
+            vertex[layout.properties[kColorsOffset + dim].offset]);
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool savePointCloudToBinaryPly(
+    const resources::PointCloud& point_cloud, const std::string& file_path) {
+  CHECK(!file_path.empty());
+  CHECK(isLittleEndianHost()) << "Only little endian hosts are supported.";
+  const size_t num_vertices = point_cloud.size();
+  const bool has_normals = !point_cloud.normals.empty();
+  const bool has_colors = !point_cloud.colors.empty();
+  if (has_normals) {
+    CHECK_EQ(point_cloud.normals.size(), point_cloud.xyz.size());
+  }
+  if (has_colors) {
+    CHECK_EQ(point_cloud.colors.size(), point_cloud.xyz.size());
+  }
+
+  std::ofstream file(file_path, std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << file_path << " for writing.";
+    return false;
+  }
+  file << "ply\nformat binary_little_endian 1.0\n"
+       << "comment generated by maplab\n"
+       << "element vertex " << num_vertices << '\n'
+       << "property float x\nproperty float y\nproperty float z\n";
+  if (has_normals) {
+    file << "property float nx\nproperty float ny\nproperty float nz\n";
+  }
+  if (has_colors) {
+    file << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  }
+  file << kEndHeader;
+
+  // Interleave the arrays in chunks of vertices.
+  const size_t stride = 3u * sizeof(float) +
+                        (has_normals ? 3u * sizeof(float) : 0u) +
+                        (has_colors ? 3u * sizeof(unsigned char) : 0u);
+  std::vector<char> buffer(
+      std::min(num_vertices, kNumVerticesPerWriteChunk) * stride);
+  for (size_t chunk_start = 0u; chunk_start < num_vertices;
+       chunk_start += kNumVerticesPerWriteChunk) {
+    const size_t chunk_end =
+        std::min(chunk_start + kNumVerticesPerWriteChunk, num_vertices);
+    char* vertex = buffer.data();
+    for (size_t vertex_idx = chunk_start; vertex_idx < chunk_end;
+         ++vertex_idx) {
+      const size_t value_idx = 3u * vertex_idx;
+      std::memcpy(vertex, &point_cloud.xyz[value_idx], 3u * sizeof(float));
+      vertex += 3u * sizeof(float);
+      if (has_normals) {
+        std::memcpy(
+            vertex, &point_cloud.normals[value_idx], 3u * sizeof(float));
+        vertex += 3u * sizeof(float);
+      }
+      if (has_colors) {
+        std::memcpy(vertex, &point_cloud.colors[value_idx], 3u);
+        vertex += 3u;
+      }
+    }
+    file.write(buffer.data(), vertex - buffer.data());
+  }
+  file.close();
+  return !file.fail();
+}
+
+bool loadPointCloudFromBinaryPly(
+    const std::string& file_path, resources::PointCloud* point_cloud) {
+  CHECK(!file_path.empty());
+  CHECK_NOTNULL(point_cloud);
+  if (!isLittleEndianHost()) {
+    return false;
+  }
+  const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size <= 0) {
+    close(file_descriptor);
+    return false;
+  }
+  const size_t num_bytes = static_cast<size_t>(file_stat.st_size);
+  void* data =
+      mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  // The vertices are read in order.
+  madvise(data, num_bytes, MADV_SEQUENTIAL);
+
+  const bool success =
+      fillPointCloud(static_cast<const char*>(data), num_bytes, point_cloud);
+  munmap(data, num_bytes);
+  if (!success) {
+    point_cloud->xyz.clear();
+    point_cloud->normals.clear();
+    point_cloud->colors.clear();
+  }
+  return success;
+}
+
+}  // namespace backend
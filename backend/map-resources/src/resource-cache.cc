@@ -1,51 +1,148 @@
 #include "map-resources/resource-cache.h"
 
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+DEFINE_string(
+    resource_cache_strategy, "lru",
+    "Eviction strategy of the resource cache: fifo, lru or lfu.");
+DEFINE_int32(
+    resource_cache_max_num_entries, 100,
+    "Maximum number of cached resources per resource type.");
+DEFINE_double(
+    resource_cache_max_size_mb, 0.0,
+    "Maximum memory used by the cached resources of one resource type in MB. "
+    "0 disables the limit.");
+
 namespace backend {
 
+ResourceCache::Config ResourceCache::Config::getFromGflags() {
+  Config config;
+  if (FLAGS_resource_cache_strategy == "fifo") {
+    config.strategy = Strategy::kFIFO;
+  } else if (FLAGS_resource_cache_strategy == "lru") {
+    config.strategy = Strategy::kLRU;
+  } else if (FLAGS_resource_cache_strategy == "lfu") {
+    config.strategy = Strategy::kLFU;
+  } else {
+    LOG(FATAL) << "Unknown resource cache strategy: "
+               << FLAGS_resource_cache_strategy;
+  }
+  CHECK_GE(FLAGS_resource_cache_max_num_entries, 0);
+  config.max_cache_size =
+      static_cast<size_t>(FLAGS_resource_cache_max_num_entries);
+  CHECK_GE(FLAGS_resource_cache_max_size_mb, 0.0);
+  constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+  config.max_cache_size_bytes =
+      static_cast<size_t>(FLAGS_resource_cache_max_size_mb * kBytesPerMegabyte);
+  return config;
+}
+
+template <>
+typename ResourceCache::Cache<cv::Mat>::ResourceTypeMap&
+ResourceCache::getCacheMap<cv::Mat>() {
+  return image_cache_;
+}
+
+template <>
+typename ResourceCache::Cache<std::string>::ResourceTypeMap&
+ResourceCache::getCacheMap<std::string>() {
+  return text_cache_;
+}
+
+template <>
+typename ResourceCache::Cache<resources::PointCloud>::ResourceTypeMap&
+ResourceCache::getCacheMap<resources::PointCloud>() {
+  return pointcloud_cache_;
+}
+
+template <>
+typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::TsdfMap>() {
+  return voxblox_tsdf_map_cache_;
+}
+
+template <>
+typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::EsdfMap>() {
+  return voxblox_esdf_map_cache_;
+}
+
 template <>
-typename ResourceCache::Cache<cv::Mat>::ResourceDequePtr&
-ResourceCache::getCachePtr<cv::Mat>(const ResourceType& type) {
-  return image_cache_[type];
+typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceTypeMap&
+ResourceCache::getCacheMap<voxblox::OccupancyMap>() {
+  return voxblox_occupancy_map_cache_;
 }
 
 template <>
-typename ResourceCache::Cache<std::string>::ResourceDequePtr&
-ResourceCache::getCachePtr<std::string>(const ResourceType& type) {
-  return text_cache_[type];
+size_t getResourceSizeBytes<cv::Mat>(const cv::Mat& resource) {
+  return resource.total() * resource.elemSize();
 }
 
 template <>
-typename ResourceCache::Cache<resources::PointCloud>::ResourceDequePtr&
-ResourceCache::getCachePtr<resources::PointCloud>(const ResourceType& type) {
-  return pointcloud_cache_[type];
+size_t getResourceSizeBytes<std::string>(const std::string& resource) {
+  return resource.size();
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::TsdfMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::TsdfMap>(const ResourceType& type) {
-  return voxblox_tsdf_map_cache_[type];
+size_t getResourceSizeBytes<resources::PointCloud>(
+    const resources::PointCloud& resource) {
+  return resource.xyz.size() * sizeof(float) +
+         resource.normals.size() * sizeof(float) +
+         resource.colors.size() * sizeof(unsigned char);
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::EsdfMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::EsdfMap>(const ResourceType& type) {
-  return voxblox_esdf_map_cache_[type];
+size_t getResourceSizeBytes<voxblox::TsdfMap>(
+    const voxblox::TsdfMap& resource) {
+  return resource.getTsdfLayer().getMemorySize();
 }
 
 template <>
-typename ResourceCache::Cache<voxblox::OccupancyMap>::ResourceDequePtr&
-ResourceCache::getCachePtr<voxblox::OccupancyMap>(const ResourceType& type) {
-  return voxblox_occupancy_map_cache_[type];
+size_t getResourceSizeBytes<voxblox::EsdfMap>(
+    const voxblox::EsdfMap& resource) {
+  return resource.getEsdfLayer().getMemorySize();
+}
+
+template <>
+size_t getResourceSizeBytes<voxblox::OccupancyMap>(
+    const voxblox::OccupancyMap& resource) {
+  return resource.getOccupancyLayer().getMemorySize();
 }
 
 void ResourceCache::resetStatistic() {
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(kNumResourceTypes);
+  for (std::mutex& m_resource_type : m_resource_types_) {
+    locks.emplace_back(m_resource_type);
+  }
   statistic_.reset();
 }
 
-const CacheStatistic& ResourceCache::getStatistic() const {
+CacheStatistic ResourceCache::getStatistic() const {
+  // The resource types are always locked in this order, or one at a time.
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(kNumResourceTypes);
+  for (std::mutex& m_resource_type : m_resource_types_) {
+    locks.emplace_back(m_resource_type);
+  }
   return statistic_;
 }
 
+size_t ResourceCache::memoryUsageBytes() const {
+  size_t num_bytes = 0u;
+  for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
+    std::lock_guard<std::mutex> lock(m_resource_types_[type_idx]);
+    num_bytes += statistic_.cache_size_bytes[type_idx];
+  }
+  return num_bytes;
+}
+
 size_t CacheStatistic::getNumHits(const ResourceType& type) const {
   return hit[static_cast<size_t>(type)];
 }
@@ -54,10 +151,15 @@ size_t CacheStatistic::getNumMiss(const ResourceType& type) const {
   return miss[static_cast<size_t>(type)];
 }
 
+size_t CacheStatistic::getNumEvictions(const ResourceType& type) const {
+  return eviction[static_cast<size_t>(type)];
+}
+
 void CacheStatistic::reset() {
   for (size_t idx = 0u; idx < kNumResourceTypes; ++idx) {
     hit[idx] = 0u;
     miss[idx] = 0u;
+    eviction[idx] = 0u;
   }
 }
 
@@ -67,6 +169,7 @@ void CacheStatistic::printToLog(int verbosity) const {
 
 std::string CacheStatistic::print() const {
   CHECK_EQ(hit.size(), miss.size());
+  CHECK_EQ(hit.size(), eviction.size());
 
   std::stringstream ss;
   ss << "Resource Cache Statistics:\n";
@@ -77,8 +180,10 @@ std::string CacheStatistic::print() const {
     const std::string& padded_name = ss_name.str();
 
     ss << "  " << padded_name << "\t"
-       << " entries: " << cache_size[type_idx] << " hits: " << hit[type_idx]
-       << " miss: " << miss[type_idx] << std::endl;
+       << " entries: " << cache_size[type_idx]
+       << " bytes: " << cache_size_bytes[type_idx] << " hits: " << hit[type_idx]
+       << " miss: " << miss[type_idx] << " evictions: " << eviction[type_idx]
+       << std::endl;
   }
   return ss.str();
 }
@@ -50,6 +50,38 @@ bool convertDepthMapWithImageToPointCloud(
       depth_map, image, camera, &voxblox_point_cloud);
 }
 
+DepthMapBackProjector::DepthMapBackProjector(const aslam::Camera& camera)
+    : image_width_(camera.imageWidth()), image_height_(camera.imageHeight()) {
+  CHECK_GT(image_width_, 0);
+  CHECK_GT(image_height_, 0);
+  const size_t num_pixels = static_cast<size_t>(image_width_) * image_height_;
+  rays_x_.resize(num_pixels);
+  rays_y_.resize(num_pixels);
+  has_ray_.resize(num_pixels);
+
+  // Same rays as in convertDepthMapToPointCloud(), so both give the same
+  // points.
+  constexpr double kEpsilon = 1e-6;
+  size_t pixel_idx = 0u;
+  for (int v = 0; v < image_height_; ++v) {
+    for (int u = 0; u < image_width_; ++u, ++pixel_idx) {
+      Eigen::Vector3d point_C;
+      Eigen::Vector2d image_point;
+      image_point << u, v;
+      camera.backProject3(image_point, &point_C);
+      has_ray_[pixel_idx] = point_C.z() >= kEpsilon;
+      if (has_ray_[pixel_idx] == 0u) {
+        rays_x_[pixel_idx] = 0.0;
+        rays_y_[pixel_idx] = 0.0;
+        continue;
+      }
+      point_C /= point_C.z();
+      rays_x_[pixel_idx] = point_C.x();
+      rays_y_[pixel_idx] = point_C.y();
+    }
+  }
+}
+
 template <>
 void addPointToPointCloud(
     const Eigen::Vector3d& point_C, const size_t index,
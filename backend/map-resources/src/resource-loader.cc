@@ -2,15 +2,84 @@
 
 #include <cstdio>
 #include <fstream>  // NOLINT
+#include <vector>
 
+#include <gflags/gflags.h>
 #include <maplab-common/file-system-tools.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <voxblox/io/layer_io.h>
 
+#include "map-resources/image-codec.h"
+#include "map-resources/point-cloud-ply.h"
 #include "map-resources/tinyply/tinyply.h"
 
+DEFINE_bool(
+    resource_use_packed_format, false,
+    "Store new image and text resources in a packed container per resource "
+    "folder instead of one file per resource. Resources in either layout can "
+    "always be read.");
+DEFINE_bool(
+    resource_migration_use_hardlinks, false,
+    "Create hard links instead of copies when resources are copied to another "
+    "folder on the same file system. The resource files are then shared by "
+    "both folders.");
+
 namespace backend {
+namespace {
+// NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new cv::Mat resource type.
+// Returns false if the resource type is not a cv::Mat resource.
+bool getExpectedCvMatType(const ResourceType& type, int* cv_type) {
+  CHECK_NOTNULL(cv_type);
+  switch (type) {
+    case ResourceType::kRawDepthMap:
+    case ResourceType::kOptimizedDepthMap:
+    case ResourceType::kDisparityMap:
+      *cv_type = CV_16U;
+      return true;
+    case ResourceType::kUndistortedImage:
+    case ResourceType::kRectifiedImage:
+    case ResourceType::kImageForDepthMap:
+    case ResourceType::kRawImage:
+    case ResourceType::kProjectedDescriptors:
+      *cv_type = CV_8U;
+      return true;
+    case ResourceType::kUndistortedColorImage:
+    case ResourceType::kRectifiedColorImage:
+    case ResourceType::kColorImageForDepthMap:
+    case ResourceType::kRawColorImage:
+      *cv_type = CV_8UC3;
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+ResourceLoader::ResourceLoader()
+    : cache_(ResourceCache::Config::getFromGflags()),
+      use_packed_format_(FLAGS_resource_use_packed_format),
+      image_codec_(getImageCodecFromGflags()) {}
+
+PackedResourceStore* ResourceLoader::getPackedResourceStore(
+    const std::string& folder, const bool create_if_missing) const {
+  CHECK(!folder.empty());
+  std::lock_guard<std::mutex> lock(m_packed_stores_);
+  // Folders are only checked for a container once, afterwards only this
+  // loader can create one.
+  std::unordered_map<std::string, std::unique_ptr<PackedResourceStore>>::
+      iterator it = packed_stores_.find(folder);
+  if (it == packed_stores_.end()) {
+    it = packed_stores_.emplace(folder, nullptr).first;
+    if (PackedResourceStore::existsInFolder(folder)) {
+      it->second.reset(new PackedResourceStore(folder));
+    }
+  }
+  if (!it->second && create_if_missing) {
+    it->second.reset(new PackedResourceStore(folder));
+  }
+  return it->second.get();
+}
 
 void ResourceLoader::migrateResource(
     const ResourceId& id, const ResourceType& type,
@@ -18,32 +87,77 @@ void ResourceLoader::migrateResource(
     const bool move_resource) {
   CHECK(!old_folder.empty());
   CHECK(!new_folder.empty());
+
+  constexpr bool kCreateIfMissing = true;
+  PackedResourceStore* old_store =
+      getPackedResourceStore(old_folder, !kCreateIfMissing);
+  PackedResourceStore::Entry entry;
+  if (old_store != nullptr && old_store->getEntry(id, type, &entry)) {
+    PackedResourceStore* new_store =
+        getPackedResourceStore(new_folder, kCreateIfMissing);
+    CHECK_NOTNULL(new_store);
+    CHECK_NE(old_store, new_store);
+
+    // The resource is already in the new store if a previous migration was
+    // interrupted.
+    if (!new_store->hasResource(id, type)) {
+      // Copy the raw payload, no need to decode the resource.
+      std::vector<char> data(entry.num_bytes);
+      CHECK(old_store->readData(entry, data.data()));
+      new_store->addResource(
+          id, type, entry.layout, {{data.data(), data.size()}});
+    }
+
+    if (move_resource) {
+      CHECK(old_store->deleteResource(id, type));
+    }
+    return;
+  }
+
   std::string old_file_path;
   getResourceFilePath(id, type, old_folder, &old_file_path);
-  CHECK(common::fileExists(old_file_path))
-      << "path: \'" << old_file_path << "\'";
-
   std::string new_file_path;
   getResourceFilePath(id, type, new_folder, &new_file_path);
-  CHECK(!common::fileExists(new_file_path));
-  CHECK(common::createPathToFile(new_file_path));
 
-  std::ifstream source_file(old_file_path, std::ios::binary);
-  std::ofstream destination_file(new_file_path, std::ios::binary);
-  CHECK(source_file.is_open());
-  CHECK(destination_file.is_open());
-
-  // Copy the file.
-  destination_file << source_file.rdbuf();
+  // Resume an interrupted migration: a moved resource is only in the new
+  // folder, and a complete copy has the size of the original. Incomplete
+  // copies are replaced.
+  const int64_t old_file_size = common::getFileSize(old_file_path);
+  const int64_t new_file_size = common::getFileSize(new_file_path);
+  if (old_file_size < 0 && new_file_size >= 0 && move_resource) {
+    return;
+  }
+  CHECK_GE(old_file_size, 0) << "path: \'" << old_file_path << "\'";
+  if (new_file_size >= 0) {
+    if (new_file_size == old_file_size) {
+      if (move_resource) {
+        CHECK(common::deleteFile(old_file_path));
+      }
+      return;
+    }
+    LOG(WARNING) << "Replacing incomplete resource file " << new_file_path;
+    CHECK(common::deleteFile(new_file_path));
+  }
+  CHECK(common::createPathToFile(new_file_path));
 
   if (move_resource) {
-    common::deleteFile(old_file_path);
+    CHECK(common::moveFile(old_file_path, new_file_path))
+        << "path: \'" << old_file_path << "\'";
+  } else {
+    CHECK(common::transferFile(
+        old_file_path, new_file_path, FLAGS_resource_migration_use_hardlinks))
+        << "path: \'" << old_file_path << "\'";
   }
 }
 
 void ResourceLoader::deleteResourceFile(
     const ResourceId& id, const ResourceType& type, const std::string& folder) {
   CHECK(!folder.empty());
+  constexpr bool kCreateIfMissing = false;
+  PackedResourceStore* store = getPackedResourceStore(folder, kCreateIfMissing);
+  if (store != nullptr && store->deleteResource(id, type)) {
+    return;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   CHECK_EQ(std::remove(file_path.c_str()), 0);
@@ -67,6 +181,12 @@ bool ResourceLoader::resourceFileExists(
     const ResourceId& id, const ResourceType& type,
     const std::string& folder) const {
   CHECK(!folder.empty());
+  constexpr bool kCreateIfMissing = false;
+  const PackedResourceStore* store =
+      getPackedResourceStore(folder, kCreateIfMissing);
+  if (store != nullptr && store->hasResource(id, type)) {
+    return true;
+  }
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   return common::fileExists(file_path);
@@ -74,13 +194,30 @@ bool ResourceLoader::resourceFileExists(
 
 template <>
 void ResourceLoader::saveResourceToFile<cv::Mat>(
-    const std::string& file_path, const ResourceType& /*type*/,
+    const std::string& file_path, const ResourceType& type,
     const cv::Mat& resource) const {
   CHECK(!file_path.empty());
   CHECK(!common::fileExists(file_path));
   CHECK(common::createPathToFile(file_path));
-  CHECK(cv::imwrite(file_path, resource))
-      << "Failed to store cv::Mat to " << file_path << ".";
+  // Images that would be converted when loaded from an image file are stored
+  // as image files to keep the behavior of both codecs identical.
+  int expected_cv_type;
+  const bool use_image_file =
+      resource.empty() || resource.dims != 2 ||
+      !getExpectedCvMatType(type, &expected_cv_type) ||
+      CV_MAT_TYPE(resource.type()) != expected_cv_type;
+  switch (use_image_file ? ImageCodec::kPnm : image_codec_) {
+    case ImageCodec::kPnm:
+      CHECK(cv::imwrite(file_path, resource))
+          << "Failed to store cv::Mat to " << file_path << ".";
+      break;
+    case ImageCodec::kDeflate:
+      CHECK(saveDeflateImage(resource, file_path))
+          << "Failed to store cv::Mat to " << file_path << ".";
+      break;
+    default:
+      LOG(FATAL) << "Unknown image codec: " << static_cast<int>(image_codec_);
+  }
 }
 
 // NOTE: [ADD_RESOURCE_TYPE] Add case if you add a new cv::Mat resource type.
@@ -95,6 +232,22 @@ bool ResourceLoader::loadResourceFromFile<cv::Mat>(
     return false;
   }
 
+  if (isDeflateImageFile(file_path)) {
+    if (!loadDeflateImage(file_path, resource)) {
+      return false;
+    }
+    int expected_cv_type;
+    CHECK(getExpectedCvMatType(type, &expected_cv_type))
+        << "Unknown cv::Mat resource type: "
+        << ResourceTypeNames[static_cast<size_t>(type)];
+    if (CV_MAT_TYPE(resource->type()) != expected_cv_type) {
+      VLOG(1) << "cv::Mat Resource at: " << file_path
+              << " has wrong image type!";
+      return false;
+    }
+    return true;
+  }
+
   bool wrong_type = false;
   switch (type) {
     case ResourceType::kRawDepthMap:
@@ -106,6 +259,7 @@ bool ResourceLoader::loadResourceFromFile<cv::Mat>(
     case ResourceType::kRectifiedImage:
     case ResourceType::kImageForDepthMap:
     case ResourceType::kRawImage:
+    case ResourceType::kProjectedDescriptors:
       *resource = cv::imread(file_path, CV_LOAD_IMAGE_GRAYSCALE);
       wrong_type = CV_MAT_TYPE(resource->type()) != CV_8U;
       break;
@@ -139,6 +293,70 @@ bool ResourceLoader::loadResourceFromFile<cv::Mat>(
   return true;
 }
 
+template <>
+bool ResourceLoader::savePackedResource<cv::Mat>(
+    const ResourceId& id, const ResourceType& type, const cv::Mat& resource,
+    PackedResourceStore* store) const {
+  CHECK_NOTNULL(store);
+  int expected_cv_type;
+  CHECK(getExpectedCvMatType(type, &expected_cv_type))
+      << "Unknown cv::Mat resource type: "
+      << ResourceTypeNames[static_cast<size_t>(type)];
+  // Images that would be converted when loaded from an image file are stored
+  // as files to keep the behavior of both formats identical.
+  if (resource.empty() || resource.dims != 2 ||
+      CV_MAT_TYPE(resource.type()) != expected_cv_type) {
+    return false;
+  }
+
+  const PackedResourceStore::Layout layout{
+      {resource.rows, resource.cols, resource.type()}};
+  const size_t row_num_bytes = resource.cols * resource.elemSize();
+  std::vector<PackedResourceStore::DataChunk> data_chunks;
+  if (resource.isContinuous()) {
+    data_chunks.emplace_back(resource.data, row_num_bytes * resource.rows);
+  } else {
+    data_chunks.reserve(resource.rows);
+    for (int row_idx = 0; row_idx < resource.rows; ++row_idx) {
+      data_chunks.emplace_back(resource.ptr(row_idx), row_num_bytes);
+    }
+  }
+  store->addResource(id, type, layout, data_chunks);
+  return true;
+}
+
+template <>
+bool ResourceLoader::loadPackedResource<cv::Mat>(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, cv::Mat* resource) const {
+  CHECK_NOTNULL(resource);
+  const int rows = static_cast<int>(entry.layout[0]);
+  const int cols = static_cast<int>(entry.layout[1]);
+  const int cv_type = static_cast<int>(entry.layout[2]);
+  int expected_cv_type;
+  CHECK(getExpectedCvMatType(type, &expected_cv_type))
+      << "Unknown cv::Mat resource type: "
+      << ResourceTypeNames[static_cast<size_t>(type)];
+  if (rows <= 0 || cols <= 0 || CV_MAT_TYPE(cv_type) != expected_cv_type) {
+    VLOG(1) << "Packed cv::Mat resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)]
+            << " has an invalid layout!";
+    return false;
+  }
+
+  // The data is copied out of the mapping, such that the resource owns its
+  // memory and stays valid in the cache.
+  resource->create(rows, cols, cv_type);
+  if (resource->total() * resource->elemSize() != entry.num_bytes) {
+    VLOG(1) << "Packed cv::Mat resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)]
+            << " has an inconsistent size!";
+    resource->release();
+    return false;
+  }
+  return store.readData(entry, resource->data);
+}
+
 template <>
 void ResourceLoader::saveResourceToFile<std::string>(
     const std::string& file_path, const ResourceType& /*type*/,
@@ -197,6 +415,34 @@ bool ResourceLoader::loadResourceFromFile<std::string>(
   return true;
 }
 
+template <>
+bool ResourceLoader::savePackedResource<std::string>(
+    const ResourceId& id, const ResourceType& type,
+    const std::string& resource, PackedResourceStore* store) const {
+  CHECK_NOTNULL(store);
+  if (resource.empty()) {
+    return false;
+  }
+  const PackedResourceStore::Layout layout{
+      {static_cast<int64_t>(resource.size()), 0, 0}};
+  store->addResource(id, type, layout, {{resource.data(), resource.size()}});
+  return true;
+}
+
+template <>
+bool ResourceLoader::loadPackedResource<std::string>(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, std::string* resource) const {
+  CHECK_NOTNULL(resource);
+  if (entry.num_bytes == 0u) {
+    VLOG(1) << "The packed std::string resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)] << " is empty!";
+    return false;
+  }
+  resource->resize(entry.num_bytes);
+  return store.readData(entry, &(*resource)[0]);
+}
+
 template <>
 void ResourceLoader::saveResourceToFile<voxblox::TsdfMap>(
     const std::string& file_path, const ResourceType& /*type*/,
@@ -300,31 +546,8 @@ void ResourceLoader::saveResourceToFile(
   CHECK(!common::fileExists(file_path)) << "path: " << file_path;
   CHECK(common::createPathToFile(file_path));
 
-  std::filebuf filebuf;
-  filebuf.open(file_path, std::ios::out | std::ios::binary);
-  CHECK(filebuf.is_open());
-
-  std::ostream output_stream(&filebuf);
-  tinyply::PlyFile ply_file;
-
-  // Const-casting is necessary as tinyply requires non-const access to the
-  // vectors for reading.
-  ply_file.add_properties_to_element(
-      "vertex", {"x", "y", "z"}, const_cast<std::vector<float>&>(resource.xyz));
-  if (!resource.normals.empty()) {
-    ply_file.add_properties_to_element(
-        "vertex", {"nx", "ny", "nz"},
-        const_cast<std::vector<float>&>(resource.normals));
-  }
-  if (!resource.colors.empty()) {
-    ply_file.add_properties_to_element(
-        "vertex", {"red", "green", "blue"},
-        const_cast<std::vector<unsigned char>&>(resource.colors));
-  }
-
-  ply_file.comments.push_back("generated by tinyply from maplab");
-  ply_file.write(output_stream, true);
-  filebuf.close();
+  CHECK(savePointCloudToBinaryPly(resource, file_path))
+      << "path: " << file_path;
 }
 
 template <>
@@ -337,6 +560,11 @@ bool ResourceLoader::loadResourceFromFile(
     return false;
   }
 
+  if (loadPointCloudFromBinaryPly(file_path, resource)) {
+    return true;
+  }
+
+  // Other PLY files, e.g. in ASCII format.
   std::ifstream stream_ply(file_path);
   if (stream_ply.is_open()) {
     tinyply::PlyFile ply_file(stream_ply);
@@ -364,10 +592,66 @@ bool ResourceLoader::loadResourceFromFile(
   return false;
 }
 
-const CacheStatistic& ResourceLoader::getCacheStatistic() const {
+template <>
+bool ResourceLoader::savePackedResource(
+    const ResourceId& id, const ResourceType& type,
+    const resources::PointCloud& resource, PackedResourceStore* store) const {
+  CHECK_NOTNULL(store);
+  const PackedResourceStore::Layout layout{
+      {static_cast<int64_t>(resource.xyz.size()),
+       static_cast<int64_t>(resource.normals.size()),
+       static_cast<int64_t>(resource.colors.size())}};
+  store->addResource(
+      id, type, layout,
+      {{resource.xyz.data(), resource.xyz.size() * sizeof(float)},
+       {resource.normals.data(), resource.normals.size() * sizeof(float)},
+       {resource.colors.data(),
+        resource.colors.size() * sizeof(unsigned char)}});
+  return true;
+}
+
+template <>
+bool ResourceLoader::loadPackedResource(
+    const PackedResourceStore& store, const PackedResourceStore::Entry& entry,
+    const ResourceType& type, resources::PointCloud* resource) const {
+  CHECK_NOTNULL(resource);
+  if (entry.layout[0] < 0 || entry.layout[1] < 0 || entry.layout[2] < 0) {
+    VLOG(1) << "Packed point cloud resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)]
+            << " has an invalid layout!";
+    return false;
+  }
+  const size_t xyz_num_bytes = entry.layout[0] * sizeof(float);
+  const size_t normals_num_bytes = entry.layout[1] * sizeof(float);
+  const size_t colors_num_bytes = entry.layout[2] * sizeof(unsigned char);
+  if (xyz_num_bytes + normals_num_bytes + colors_num_bytes !=
+      entry.num_bytes) {
+    VLOG(1) << "Packed point cloud resource of type "
+            << ResourceTypeNames[static_cast<size_t>(type)]
+            << " has an inconsistent size!";
+    return false;
+  }
+
+  resource->xyz.resize(entry.layout[0]);
+  resource->normals.resize(entry.layout[1]);
+  resource->colors.resize(entry.layout[2]);
+  return store.readData(entry, 0u, xyz_num_bytes, resource->xyz.data()) &&
+         store.readData(
+             entry, xyz_num_bytes, normals_num_bytes,
+             resource->normals.data()) &&
+         store.readData(
+             entry, xyz_num_bytes + normals_num_bytes, colors_num_bytes,
+             resource->colors.data());
+}
+
+CacheStatistic ResourceLoader::getCacheStatistic() const {
   return cache_.getStatistic();
 }
 
+size_t ResourceLoader::getCacheMemoryUsageBytes() const {
+  return cache_.memoryUsageBytes();
+}
+
 const ResourceCache::Config& ResourceLoader::getCacheConfig() const {
   return cache_.getConfig();
 }
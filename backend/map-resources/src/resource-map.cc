@@ -1,19 +1,44 @@
 #include "map-resources/resource-map.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <aslam/common/reader-writer-lock.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/multi-threaded-progress-bar.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "map-resources/resource_info_map.pb.h"
 #include "map-resources/resource_metadata.pb.h"
 
+DEFINE_int32(
+    resource_prefetch_num_threads, 2,
+    "Number of background threads that load prefetched resources.");
+DEFINE_int32(
+    resource_prefetch_lookahead, 16,
+    "Maximum number of resources of one type that are prefetched ahead of "
+    "the consumer. Limited by the resource cache size.");
+DEFINE_int32(
+    resource_migration_num_threads, 8,
+    "Number of threads that copy or move resource files when resources are "
+    "migrated to another folder.");
+
 namespace backend {
 
 ResourceMap::ResourceMap()
-    : meta_data_(""), resource_info_map_(kNumResourceTypes) {}
+    : meta_data_(""),
+      resource_info_map_(kNumResourceTypes),
+      resource_modification_count_(kNumResourceTypes, 0u) {}
 
 ResourceMap::ResourceMap(const std::string& map_folder)
-    : meta_data_(map_folder), resource_info_map_(kNumResourceTypes) {
+    : meta_data_(map_folder),
+      resource_info_map_(kNumResourceTypes),
+      resource_modification_count_(kNumResourceTypes, 0u) {
   // Create map and resource folder.
   if (!common::pathExists(meta_data_.map_resource_folder)) {
     common::createPath(meta_data_.map_resource_folder);
@@ -21,7 +46,9 @@ ResourceMap::ResourceMap(const std::string& map_folder)
 }
 
 ResourceMap::ResourceMap(const metadata::proto::MetaData& metadata_proto)
-    : meta_data_(metadata_proto), resource_info_map_(kNumResourceTypes) {
+    : meta_data_(metadata_proto),
+      resource_info_map_(kNumResourceTypes),
+      resource_modification_count_(kNumResourceTypes, 0u) {
   // Create map and resource folder.
   if (!common::pathExists(meta_data_.map_resource_folder)) {
     common::createPath(meta_data_.map_resource_folder);
@@ -59,29 +86,37 @@ void ResourceMap::mergeFromMap(const ResourceMap& source_map) {
       source_map.meta_data_.external_resource_folders.begin(),
       source_map.meta_data_.external_resource_folders.end());
 
-  // Loop through resource info and adjust folder index.
-  for (size_t resource_type = 0u; resource_type < kNumResourceTypes;
-       ++resource_type) {
-    const size_t size_before = resource_info_map_[resource_type].size();
-    for (const ResourceInfoMap::value_type& resource_info_map_value :
-         source_map.resource_info_map_[resource_type]) {
-      ResourceInfo resource_info = resource_info_map_value.second;
-      // Resource folders from source map are in the back of the list.
-      // - map folder        was:  -1     is now: num_external_folders_before
-      // - external folder   was: >=0     is now: num_external_folders_before +
-      // 1 + old value
-      resource_info.folder_idx +=
-          num_external_folders_before + static_cast<ResourceFolderIndex>(1);
-
-      CHECK(
-          resource_info_map_[resource_type]
-              .emplace(resource_info_map_value.first, resource_info)
-              .second);
+  // Loop through resource info and adjust folder index. The resource types
+  // are independent, so they are merged in parallel.
+  auto merge_resource_types = [&](const std::vector<size_t>& range) {
+    for (const size_t resource_type : range) {
+      ResourceInfoMap& resource_infos = resource_info_map_[resource_type];
+      const ResourceInfoMap& source_resource_infos =
+          source_map.resource_info_map_[resource_type];
+      const size_t size_before = resource_infos.size();
+      resource_infos.reserve(size_before + source_resource_infos.size());
+      for (const ResourceInfoMap::value_type& resource_info_map_value :
+           source_resource_infos) {
+        ResourceInfo resource_info = resource_info_map_value.second;
+        // Resource folders from source map are in the back of the list.
+        // - map folder        was:  -1     is now: num_external_folders_before
+        // - external folder   was: >=0     is now: num_external_folders_before
+        //                                          + 1 + old value
+        resource_info.folder_idx +=
+            num_external_folders_before + static_cast<ResourceFolderIndex>(1);
+
+        CHECK(
+            resource_infos.emplace(resource_info_map_value.first, resource_info)
+                .second);
+      }
+      CHECK_EQ(
+          resource_infos.size(), size_before + source_resource_infos.size());
     }
-    CHECK_EQ(
-        resource_info_map_[resource_type].size(),
-        size_before + source_map.resource_info_map_[resource_type].size());
-  }
+  };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      kNumResourceTypes, merge_resource_types, kAlwaysParallelize,
+      common::getNumHardwareThreads());
 }
 
 ResourceMap::MetaData& ResourceMap::MetaData::operator=(
@@ -352,6 +387,9 @@ void ResourceMap::migrateAllResourcesToFolder(
       << "Unable to create resource folder at " << target_resource_folder;
 
   VLOG(1) << "Migrating all resources to folder: " << target_resource_folder;
+  for (size_t& modification_count : resource_modification_count_) {
+    ++modification_count;
+  }
 
   // Check if we already know this folder.
   bool is_known_folder = false;
@@ -365,33 +403,68 @@ void ResourceMap::migrateAllResourcesToFolder(
     }
   }
 
-  // Loop over all resources in the resource maps and move them to the new
-  // folder if necessary.
+  // Collect the resources that are not in the new folder yet.
+  struct ResourceToMigrate {
+    ResourceId id;
+    ResourceType type;
+    const std::string* old_folder;
+  };
+  std::vector<ResourceToMigrate> resources_to_migrate;
+  std::unordered_map<ResourceFolderIndex, std::string> old_folders;
   for (size_t type_idx = 0u; type_idx < kNumResourceTypes; ++type_idx) {
-    ResourceInfoMap& info_map = resource_info_map_.at(type_idx);
-
-    ResourceInfoMap::iterator it = info_map.begin();
-    for (; it != info_map.end(); ++it) {
-      ResourceFolderIndex& folder_idx = it->second.folder_idx;
+    for (const ResourceInfoMap::value_type& id_and_info :
+         resource_info_map_.at(type_idx)) {
+      const ResourceFolderIndex folder_idx = id_and_info.second.folder_idx;
       const bool resource_already_in_target_folder =
           is_known_folder && folder_idx == target_folder_idx;
-      if (!resource_already_in_target_folder) {
+      if (resource_already_in_target_folder) {
+        continue;
+      }
+      std::unordered_map<ResourceFolderIndex, std::string>::iterator it =
+          old_folders.find(folder_idx);
+      if (it == old_folders.end()) {
         // Find previous folder for this resource.
-        std::string old_folder;
-        getFolderFromIndex(folder_idx, &old_folder);
-        CHECK(common::pathExists(old_folder))
+        it = old_folders.emplace(folder_idx, std::string()).first;
+        getFolderFromIndex(folder_idx, &it->second);
+        CHECK(common::pathExists(it->second))
             << "Cannot migrate resources, previous resource folder doesn't "
-            << "exist (anmore)! Folder: " << old_folder;
-
-        // Move/copy the resource and update the folder index.
-        resource_loader_.migrateResource(
-            it->first, static_cast<ResourceType>(type_idx), old_folder,
-            target_resource_folder, move_resources);
+            << "exist (anmore)! Folder: " << it->second;
       }
+      resources_to_migrate.push_back(
+          {id_and_info.first, static_cast<ResourceType>(type_idx),
+           &it->second});
+    }
+  }
 
-      // If the new folder is the default folder, we need to set the appropriate
-      // folder idx.
-      folder_idx = is_map_folder ? kMapResourceFolder : 0u;
+  // Move/copy the resource files, the loader is safe to use concurrently.
+  VLOG(1) << "Migrating " << resources_to_migrate.size() << " resources.";
+  if (!resources_to_migrate.empty()) {
+    common::MultiThreadedProgressBar progress_bar;
+    constexpr bool kAlwaysParallelize = true;
+    CHECK_GT(FLAGS_resource_migration_num_threads, 0);
+    common::ParallelProcess(
+        resources_to_migrate.size(),
+        [&](const std::vector<size_t>& range) {
+          progress_bar.setNumElements(range.size());
+          size_t num_processed = 0u;
+          for (const size_t idx : range) {
+            const ResourceToMigrate& resource = resources_to_migrate[idx];
+            resource_loader_.migrateResource(
+                resource.id, resource.type, *resource.old_folder,
+                target_resource_folder, move_resources);
+            progress_bar.update(++num_processed);
+          }
+        },
+        kAlwaysParallelize, FLAGS_resource_migration_num_threads);
+  }
+
+  // If the new folder is the default folder, we need to set the appropriate
+  // folder idx.
+  const ResourceFolderIndex new_folder_idx =
+      is_map_folder ? kMapResourceFolder : 0u;
+  for (ResourceInfoMap& info_map : resource_info_map_) {
+    for (ResourceInfoMap::value_type& id_and_info : info_map) {
+      id_and_info.second.folder_idx = new_folder_idx;
     }
   }
 
@@ -489,6 +562,11 @@ CacheStatistic ResourceMap::getResourceCacheStatisticCopy() const {
   return resource_loader_.getCacheStatistic();
 }
 
+size_t ResourceMap::getResourceCacheMemoryUsageBytes() const {
+  // The cache has its own locks.
+  return resource_loader_.getCacheMemoryUsageBytes();
+}
+
 size_t ResourceMap::getNumResourceCacheMiss(const ResourceType& type) const {
   aslam::ScopedReadLock lock(&resource_mutex_);
   return resource_loader_.getCacheStatistic().getNumMiss(type);
@@ -660,6 +738,48 @@ bool ResourceMap::resourceFileExists(
   }
 }
 
+ResourcePrefetcher* ResourceMap::getPrefetcher() const {
+  std::lock_guard<std::mutex> lock(m_prefetcher_);
+  if (!prefetcher_) {
+    const size_t max_cache_size =
+        resource_loader_.getCacheConfig().max_cache_size;
+    if (max_cache_size == 0u) {
+      VLOG(1) << "The resource cache is disabled, not prefetching.";
+      return nullptr;
+    }
+    CHECK_GT(FLAGS_resource_prefetch_num_threads, 0);
+    CHECK_GT(FLAGS_resource_prefetch_lookahead, 0);
+    const size_t lookahead_window = std::min(
+        static_cast<size_t>(FLAGS_resource_prefetch_lookahead),
+        max_cache_size);
+    prefetcher_.reset(new ResourcePrefetcher(
+        static_cast<size_t>(FLAGS_resource_prefetch_num_threads),
+        lookahead_window));
+  }
+  return prefetcher_.get();
+}
+
+void ResourceMap::notifyPrefetcherOfAccess(
+    const ResourceId& id, const ResourceType& type) const {
+  // The prefetcher is never destroyed before the resource map, so it is safe
+  // to use it without holding the lock.
+  ResourcePrefetcher* prefetcher;
+  {
+    std::lock_guard<std::mutex> lock(m_prefetcher_);
+    prefetcher = prefetcher_.get();
+  }
+  if (prefetcher != nullptr) {
+    prefetcher->notifyAccessAndWaitIfLoading(id, type);
+  }
+}
+
+void ResourceMap::cancelPrefetching() const {
+  std::lock_guard<std::mutex> lock(m_prefetcher_);
+  if (prefetcher_) {
+    prefetcher_->cancelAll();
+  }
+}
+
 bool ResourceMap::checkResourceFileSystem() const {
   aslam::ScopedReadLock lock(&resource_mutex_);
   bool all_files_exist = true;
@@ -0,0 +1,143 @@
+#include "map-resources/resource-prefetcher.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace backend {
+
+ResourcePrefetcher::ResourcePrefetcher(
+    size_t num_threads, size_t lookahead_window)
+    : lookahead_window_(lookahead_window), shutdown_requested_(false) {
+  CHECK_GT(num_threads, 0u);
+  CHECK_GT(lookahead_window, 0u);
+  workers_.reserve(num_threads);
+  for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+    workers_.emplace_back(&ResourcePrefetcher::workerLoop, this);
+  }
+}
+
+ResourcePrefetcher::~ResourcePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(m_state_);
+    sequences_.clear();
+    shutdown_requested_ = true;
+  }
+  cv_work_available_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ResourcePrefetcher::prefetch(
+    const ResourceType& type, const ResourceIdList& ids,
+    const LoadFunction& load_function) {
+  CHECK(load_function);
+  {
+    std::lock_guard<std::mutex> lock(m_state_);
+    Sequence& sequence = sequences_[type];
+    sequence = Sequence();
+    sequence.ids = ids;
+    sequence.load_function = load_function;
+    sequence.id_to_position.reserve(ids.size());
+    for (size_t position = 0u; position < ids.size(); ++position) {
+      sequence.id_to_position.emplace(ids[position], position);
+    }
+  }
+  cv_work_available_.notify_all();
+}
+
+void ResourcePrefetcher::cancel(const ResourceType& type) {
+  std::lock_guard<std::mutex> lock(m_state_);
+  sequences_.erase(type);
+}
+
+void ResourcePrefetcher::cancelAll() {
+  std::lock_guard<std::mutex> lock(m_state_);
+  sequences_.clear();
+}
+
+void ResourcePrefetcher::notifyAccessAndWaitIfLoading(
+    const ResourceId& id, const ResourceType& type) {
+  std::unique_lock<std::mutex> lock(m_state_);
+  const auto sequence_it = sequences_.find(type);
+  if (sequence_it != sequences_.end()) {
+    Sequence& sequence = sequence_it->second;
+    const auto position_it = sequence.id_to_position.find(id);
+    if (position_it != sequence.id_to_position.end() &&
+        position_it->second >= sequence.consumer_position) {
+      sequence.consumer_position = position_it->second + 1u;
+      // Resources the consumer has skipped are not loaded anymore.
+      sequence.next_position =
+          std::max(sequence.next_position, sequence.consumer_position);
+      lock.unlock();
+      cv_work_available_.notify_all();
+      lock.lock();
+    }
+  }
+  cv_resource_loaded_.wait(
+      lock, [this, &id]() { return resources_in_flight_.count(id) == 0u; });
+}
+
+bool ResourcePrefetcher::isIdle() const {
+  std::lock_guard<std::mutex> lock(m_state_);
+  if (!resources_in_flight_.empty()) {
+    return false;
+  }
+  for (const auto& type_and_sequence : sequences_) {
+    if (hasResourceToLoad(type_and_sequence.second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ResourcePrefetcher::hasResourceToLoad(const Sequence& sequence) const {
+  return sequence.next_position < sequence.ids.size() &&
+         sequence.next_position <
+             sequence.consumer_position + lookahead_window_;
+}
+
+bool ResourcePrefetcher::getNextResourceToLoad(
+    ResourceId* id, LoadFunction* load_function) {
+  CHECK_NOTNULL(id);
+  CHECK_NOTNULL(load_function);
+  for (auto& type_and_sequence : sequences_) {
+    Sequence& sequence = type_and_sequence.second;
+    if (hasResourceToLoad(sequence)) {
+      *id = sequence.ids[sequence.next_position];
+      *load_function = sequence.load_function;
+      ++sequence.next_position;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ResourcePrefetcher::workerLoop() {
+  while (true) {
+    ResourceId id;
+    LoadFunction load_function;
+    {
+      std::unique_lock<std::mutex> lock(m_state_);
+      cv_work_available_.wait(lock, [&]() {
+        return shutdown_requested_ ||
+               getNextResourceToLoad(&id, &load_function);
+      });
+      if (shutdown_requested_) {
+        return;
+      }
+      resources_in_flight_.insert(id);
+    }
+
+    load_function(id);
+
+    {
+      std::lock_guard<std::mutex> lock(m_state_);
+      resources_in_flight_.erase(id);
+    }
+    cv_resource_loaded_.notify_all();
+  }
+}
+
+}  // namespace backend
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/packed-resource-store.h"
+#include "map-resources/resource-common.h"
+
+DECLARE_int32(resource_packed_segment_size_mb);
+
+namespace backend {
+
+const std::string kTestResourceFolder =  // NOLINT
+    "./packed_resource_store_test";
+
+class PackedResourceStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(common::removePath(kTestResourceFolder));
+    ASSERT_TRUE(common::createPath(kTestResourceFolder));
+  }
+
+  void TearDown() override {
+    common::removePath(kTestResourceFolder);
+  }
+
+  static std::vector<uint8_t> createData(size_t num_bytes, uint8_t seed) {
+    std::vector<uint8_t> data(num_bytes);
+    for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+      data[byte_idx] = static_cast<uint8_t>(seed + byte_idx * 7u);
+    }
+    return data;
+  }
+
+  static void expectResourceData(
+      const PackedResourceStore& store, const ResourceId& id,
+      const ResourceType& type, const std::vector<uint8_t>& expected_data) {
+    PackedResourceStore::Entry entry;
+    ASSERT_TRUE(store.getEntry(id, type, &entry));
+    ASSERT_EQ(entry.num_bytes, expected_data.size());
+    std::vector<uint8_t> data(entry.num_bytes);
+    ASSERT_TRUE(store.readData(entry, data.data()));
+    EXPECT_EQ(data, expected_data);
+  }
+};
+
+TEST_F(PackedResourceStoreTest, AddReadAndReopen) {
+  EXPECT_FALSE(PackedResourceStore::existsInFolder(kTestResourceFolder));
+
+  ResourceId image_id, text_id;
+  common::generateId(&image_id);
+  common::generateId(&text_id);
+  const std::vector<uint8_t> image_data = createData(640u * 480u, 3u);
+  const std::vector<uint8_t> text_data = createData(100u, 11u);
+  const PackedResourceStore::Layout image_layout{{480, 640, 0}};
+
+  {
+    PackedResourceStore store(kTestResourceFolder);
+    EXPECT_EQ(store.numResources(), 0u);
+    // Payloads are concatenated from their chunks.
+    const size_t half_num_bytes = image_data.size() / 2u;
+    store.addResource(
+        image_id, ResourceType::kRawImage, image_layout,
+        {{image_data.data(), half_num_bytes},
+         {image_data.data() + half_num_bytes,
+          image_data.size() - half_num_bytes}});
+    store.addResource(
+        text_id, ResourceType::kText, PackedResourceStore::Layout{{0, 0, 0}},
+        {{text_data.data(), text_data.size()}});
+    EXPECT_EQ(store.numResources(), 2u);
+
+    EXPECT_TRUE(store.hasResource(image_id, ResourceType::kRawImage));
+    EXPECT_FALSE(store.hasResource(image_id, ResourceType::kText));
+    expectResourceData(store, image_id, ResourceType::kRawImage, image_data);
+    expectResourceData(store, text_id, ResourceType::kText, text_data);
+
+    PackedResourceStore::Entry entry;
+    ASSERT_TRUE(store.getEntry(image_id, ResourceType::kRawImage, &entry));
+    EXPECT_EQ(entry.layout, image_layout);
+    std::vector<uint8_t> partial_data(10u);
+    ASSERT_TRUE(
+        store.readData(entry, 1000u, partial_data.size(), partial_data.data()));
+    EXPECT_TRUE(std::equal(
+        partial_data.begin(), partial_data.end(), image_data.begin() + 1000u));
+  }
+
+  EXPECT_TRUE(PackedResourceStore::existsInFolder(kTestResourceFolder));
+  PackedResourceStore reopened_store(kTestResourceFolder);
+  EXPECT_EQ(reopened_store.numResources(), 2u);
+  expectResourceData(
+      reopened_store, image_id, ResourceType::kRawImage, image_data);
+  expectResourceData(reopened_store, text_id, ResourceType::kText, text_data);
+}
+
+TEST_F(PackedResourceStoreTest, DeleteResource) {
+  ResourceId id_a, id_b;
+  common::generateId(&id_a);
+  common::generateId(&id_b);
+  const std::vector<uint8_t> data_a = createData(1000u, 1u);
+  const std::vector<uint8_t> data_b = createData(2000u, 2u);
+
+  {
+    PackedResourceStore store(kTestResourceFolder);
+    store.addResource(
+        id_a, ResourceType::kRawDepthMap, PackedResourceStore::Layout(),
+        {{data_a.data(), data_a.size()}});
+    store.addResource(
+        id_b, ResourceType::kRawDepthMap, PackedResourceStore::Layout(),
+        {{data_b.data(), data_b.size()}});
+    EXPECT_TRUE(store.deleteResource(id_a, ResourceType::kRawDepthMap));
+    EXPECT_FALSE(store.deleteResource(id_a, ResourceType::kRawDepthMap));
+    EXPECT_FALSE(store.hasResource(id_a, ResourceType::kRawDepthMap));
+    expectResourceData(store, id_b, ResourceType::kRawDepthMap, data_b);
+
+    // A deleted resource can be added again.
+    store.addResource(
+        id_a, ResourceType::kRawDepthMap, PackedResourceStore::Layout(),
+        {{data_b.data(), data_b.size()}});
+    EXPECT_TRUE(store.deleteResource(id_a, ResourceType::kRawDepthMap));
+  }
+
+  PackedResourceStore reopened_store(kTestResourceFolder);
+  EXPECT_EQ(reopened_store.numResources(), 1u);
+  EXPECT_FALSE(reopened_store.hasResource(id_a, ResourceType::kRawDepthMap));
+  expectResourceData(reopened_store, id_b, ResourceType::kRawDepthMap, data_b);
+}
+
+TEST_F(PackedResourceStoreTest, StartsNewSegmentWhenFull) {
+  const int32_t original_segment_size_mb =
+      FLAGS_resource_packed_segment_size_mb;
+  FLAGS_resource_packed_segment_size_mb = 1;
+
+  constexpr size_t kNumResources = 5u;
+  const std::vector<uint8_t> data = createData(400u * 1024u, 5u);
+  std::vector<ResourceId> ids(kNumResources);
+  {
+    PackedResourceStore store(kTestResourceFolder);
+    for (ResourceId& id : ids) {
+      common::generateId(&id);
+      store.addResource(
+          id, ResourceType::kRawImage, PackedResourceStore::Layout(),
+          {{data.data(), data.size()}});
+    }
+    PackedResourceStore::Entry first_entry, last_entry;
+    ASSERT_TRUE(
+        store.getEntry(ids.front(), ResourceType::kRawImage, &first_entry));
+    ASSERT_TRUE(
+        store.getEntry(ids.back(), ResourceType::kRawImage, &last_entry));
+    EXPECT_EQ(first_entry.segment_index, 0u);
+    // Two resources fit into each segment.
+    EXPECT_EQ(last_entry.segment_index, 2u);
+    EXPECT_EQ(last_entry.offset, 0u);
+  }
+
+  // New resources are appended to the last segment after reopening.
+  PackedResourceStore reopened_store(kTestResourceFolder);
+  ResourceId new_id;
+  common::generateId(&new_id);
+  reopened_store.addResource(
+      new_id, ResourceType::kRawImage, PackedResourceStore::Layout(),
+      {{data.data(), data.size()}});
+  PackedResourceStore::Entry new_entry;
+  ASSERT_TRUE(
+      reopened_store.getEntry(new_id, ResourceType::kRawImage, &new_entry));
+  EXPECT_EQ(new_entry.segment_index, 2u);
+  EXPECT_EQ(new_entry.offset, data.size());
+  for (const ResourceId& id : ids) {
+    expectResourceData(reopened_store, id, ResourceType::kRawImage, data);
+  }
+  expectResourceData(reopened_store, new_id, ResourceType::kRawImage, data);
+
+  FLAGS_resource_packed_segment_size_mb = original_segment_size_mb;
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
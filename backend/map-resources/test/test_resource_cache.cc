@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core.hpp>
+
+#include "map-resources/resource-cache.h"
+#include "map-resources/resource-common.h"
+
+namespace backend {
+
+class ResourceCacheTest : public ::testing::Test {
+ protected:
+  void putTextResources(size_t num_resources, ResourceCache* cache) {
+    CHECK_NOTNULL(cache);
+    for (size_t idx = 0u; idx < num_resources; ++idx) {
+      ResourceId id;
+      common::generateId(&id);
+      ids_.push_back(id);
+      cache->putResource<std::string>(
+          id, ResourceType::kText, "resource_" + id.hexString());
+    }
+  }
+
+  bool isCached(const ResourceId& id, ResourceCache* cache) {
+    CHECK_NOTNULL(cache);
+    std::string resource;
+    return cache->getResource<std::string>(id, ResourceType::kText, &resource);
+  }
+
+  std::vector<ResourceId> ids_;
+};
+
+TEST_F(ResourceCacheTest, FifoEvictsOldestInsertion) {
+  ResourceCache::Config config;
+  config.max_cache_size = 3u;
+  config.strategy = ResourceCache::Strategy::kFIFO;
+  ResourceCache cache(config);
+
+  putTextResources(3u, &cache);
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  putTextResources(1u, &cache);
+
+  EXPECT_FALSE(isCached(ids_[0], &cache));
+  EXPECT_TRUE(isCached(ids_[1], &cache));
+  EXPECT_TRUE(isCached(ids_[3], &cache));
+  EXPECT_EQ(cache.getStatistic().getNumEvictions(ResourceType::kText), 1u);
+  EXPECT_EQ(cache.getStatistic().getNumHits(ResourceType::kText), 3u);
+  EXPECT_EQ(cache.getStatistic().getNumMiss(ResourceType::kText), 1u);
+}
+
+TEST_F(ResourceCacheTest, LruEvictsLeastRecentlyUsed) {
+  ResourceCache::Config config;
+  config.max_cache_size = 3u;
+  config.strategy = ResourceCache::Strategy::kLRU;
+  ResourceCache cache(config);
+
+  putTextResources(3u, &cache);
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  putTextResources(1u, &cache);
+
+  EXPECT_FALSE(isCached(ids_[1], &cache));
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  EXPECT_TRUE(isCached(ids_[2], &cache));
+  EXPECT_TRUE(isCached(ids_[3], &cache));
+  EXPECT_EQ(cache.getStatistic().getNumEvictions(ResourceType::kText), 1u);
+  EXPECT_EQ(
+      cache.getStatistic().cache_size[static_cast<size_t>(ResourceType::kText)],
+      3u);
+}
+
+TEST_F(ResourceCacheTest, LfuEvictsLeastFrequentlyUsed) {
+  ResourceCache::Config config;
+  config.max_cache_size = 3u;
+  config.strategy = ResourceCache::Strategy::kLFU;
+  ResourceCache cache(config);
+
+  putTextResources(3u, &cache);
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  EXPECT_TRUE(isCached(ids_[1], &cache));
+  EXPECT_TRUE(isCached(ids_[2], &cache));
+  EXPECT_TRUE(isCached(ids_[2], &cache));
+
+  // Resource 1 has the fewest hits.
+  putTextResources(1u, &cache);
+  EXPECT_FALSE(isCached(ids_[1], &cache));
+
+  // The new resource is evicted next, as it has only been hit once.
+  EXPECT_TRUE(isCached(ids_[3], &cache));
+  putTextResources(1u, &cache);
+  EXPECT_FALSE(isCached(ids_[3], &cache));
+  EXPECT_TRUE(isCached(ids_[0], &cache));
+  EXPECT_TRUE(isCached(ids_[2], &cache));
+  EXPECT_EQ(cache.getStatistic().getNumEvictions(ResourceType::kText), 2u);
+}
+
+TEST_F(ResourceCacheTest, MemoryBudgetIsMeasuredInBytes) {
+  constexpr int kImageSize = 100;
+  const size_t kImageSizeBytes = kImageSize * kImageSize * sizeof(uint16_t);
+
+  ResourceCache::Config config;
+  config.max_cache_size = 100u;
+  config.max_cache_size_bytes = 2u * kImageSizeBytes + kImageSizeBytes / 2u;
+  ResourceCache cache(config);
+
+  std::vector<ResourceId> image_ids(3u);
+  for (ResourceId& id : image_ids) {
+    common::generateId(&id);
+    cache.putResource<cv::Mat>(
+        id, ResourceType::kRawDepthMap,
+        cv::Mat(kImageSize, kImageSize, CV_16UC1));
+  }
+  const size_t type_idx = static_cast<size_t>(ResourceType::kRawDepthMap);
+  EXPECT_EQ(cache.getStatistic().cache_size[type_idx], 2u);
+  EXPECT_EQ(
+      cache.getStatistic().cache_size_bytes[type_idx], 2u * kImageSizeBytes);
+  EXPECT_EQ(cache.memoryUsageBytes(), 2u * kImageSizeBytes);
+  EXPECT_EQ(
+      cache.getStatistic().getNumEvictions(ResourceType::kRawDepthMap), 1u);
+
+  cv::Mat image;
+  EXPECT_FALSE(cache.getResource<cv::Mat>(
+      image_ids[0], ResourceType::kRawDepthMap, &image));
+  EXPECT_TRUE(cache.getResource<cv::Mat>(
+      image_ids[2], ResourceType::kRawDepthMap, &image));
+
+  // Images that exceed the budget on their own are not cached.
+  ResourceId large_image_id;
+  common::generateId(&large_image_id);
+  cache.putResource<cv::Mat>(
+      large_image_id, ResourceType::kRawDepthMap,
+      cv::Mat(3 * kImageSize, kImageSize, CV_16UC1));
+  EXPECT_FALSE(cache.getResource<cv::Mat>(
+      large_image_id, ResourceType::kRawDepthMap, &image));
+  EXPECT_EQ(cache.getStatistic().cache_size[type_idx], 2u);
+
+  EXPECT_TRUE(
+      cache.deleteResource<cv::Mat>(image_ids[2], ResourceType::kRawDepthMap));
+  EXPECT_EQ(cache.getStatistic().cache_size_bytes[type_idx], kImageSizeBytes);
+  EXPECT_EQ(cache.memoryUsageBytes(), kImageSizeBytes);
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
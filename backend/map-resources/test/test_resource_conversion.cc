@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>  // NOLINT
 #include <string>
 
@@ -127,6 +128,34 @@ TEST_F(ResourceConversionTest, TestVoxbloxWithRgbImageConversion) {
   EXPECT_EQ(colors.size(), kNumValidDepthEntries);
 }
 
+TEST_F(ResourceConversionTest, TestBackProjectorMatchesPerPixelConversion) {
+  for (const aslam::Camera::Ptr& camera :
+       {camera_without_distortion_, camera_with_distortion_}) {
+    const DepthMapBackProjector back_projector(*camera);
+    for (const cv::Mat& image : {image_, fake_rgb_}) {
+      resources::PointCloud expected_point_cloud;
+      ASSERT_TRUE(
+          convertDepthMapWithImageToPointCloud(
+              depth_map_openni_, image, *camera, &expected_point_cloud));
+      resources::PointCloud point_cloud;
+      ASSERT_TRUE(
+          back_projector.convertDepthMapToPointCloud(
+              depth_map_openni_, image, &point_cloud));
+      // The per-pixel conversion keeps empty points at the end for the
+      // depths without a ray.
+      ASSERT_LE(point_cloud.size(), expected_point_cloud.size());
+      EXPECT_TRUE(
+          std::equal(
+              point_cloud.xyz.begin(), point_cloud.xyz.end(),
+              expected_point_cloud.xyz.begin()));
+      EXPECT_TRUE(
+          std::equal(
+              point_cloud.colors.begin(), point_cloud.colors.end(),
+              expected_point_cloud.colors.begin()));
+    }
+  }
+}
+
 }  // namespace backend
 
 MAPLAB_UNITTEST_ENTRYPOINT
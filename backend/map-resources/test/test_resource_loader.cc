@@ -1,12 +1,21 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <opencv2/core.hpp>
 
+#include "map-resources/image-codec.h"
+#include "map-resources/point-cloud-ply.h"
 #include "map-resources/resource-common.h"
 #include "map-resources/resource-loader.h"
 #include "map-resources/test/resources-test.h"
 
+DECLARE_string(resource_image_codec);
+
 namespace backend {
 
 class ResourceLoaderTest : public ResourceTest {
@@ -988,6 +997,77 @@ TEST_F(ResourceLoaderTest, TestReplaceResource) {
   getAndCheckTemplatesFromResourceLoader(&loader, &templates_);
 }
 
+TEST_F(ResourceLoaderTest, TestDeflateImageCodec) {
+  constexpr bool kIsMapFolder = true;
+  createResourceTemplates(
+      "TestDeflateImageCodec", kTestMapFolderA, kIsMapFolder, &templates_);
+
+  FLAGS_resource_image_codec = "deflate";
+  {
+    ResourceLoader loader;
+    addTemplatesToResourceLoader(&loader, &templates_);
+  }
+  FLAGS_resource_image_codec = "pnm";
+
+  // The codec of the files is detected when they are loaded.
+  ResourceLoader loader;
+  size_t num_images = 0u;
+  for (ResourceTemplateBase::Ptr& template_base : templates_) {
+    if (template_base->data_type != DataTypes::kCvMat) {
+      continue;
+    }
+    ResourceTemplate<cv::Mat>& resource_template =
+        template_base->getAs<ResourceTemplate<cv::Mat>>();
+    std::string file_path;
+    loader.getResourceFilePath(
+        resource_template.id, resource_template.type, resource_template.folder,
+        &file_path);
+    EXPECT_TRUE(isDeflateImageFile(file_path));
+
+    cv::Mat resource;
+    ASSERT_TRUE(loader.loadResource(
+        resource_template.id, resource_template.type, resource_template.folder,
+        &resource));
+    EXPECT_TRUE(isSameResource(resource_template.resource(), resource));
+    ++num_images;
+  }
+  EXPECT_GT(num_images, 0u);
+}
+
+TEST_F(ResourceLoaderTest, TestBinaryPlyPointCloud) {
+  loadTestResources();
+  const std::string folder = kTestDataBaseFolder + "/TestBinaryPlyPointCloud/";
+  ASSERT_TRUE(common::createPath(folder));
+
+  const resources::PointCloud* point_clouds[] = {
+      &pointcloud_xyz_resource_, &pointcloud_xyzrgbn_resource_};
+  for (size_t idx = 0u; idx < 2u; ++idx) {
+    const resources::PointCloud& point_cloud = *point_clouds[idx];
+    const std::string file_path =
+        folder + "point_cloud_" + std::to_string(idx) + ".ply";
+    ASSERT_TRUE(savePointCloudToBinaryPly(point_cloud, file_path));
+
+    resources::PointCloud loaded_point_cloud;
+    ASSERT_TRUE(loadPointCloudFromBinaryPly(file_path, &loaded_point_cloud));
+    EXPECT_TRUE(isSameResource(point_cloud, loaded_point_cloud));
+
+    // The files can still be read with tinyply.
+    resources::PointCloud tinyply_point_cloud;
+    loadPointcloud(file_path, &tinyply_point_cloud);
+    EXPECT_TRUE(isSameResource(point_cloud, tinyply_point_cloud));
+  }
+
+  const std::string ascii_file_path = folder + "ascii.ply";
+  std::ofstream ascii_file(ascii_file_path);
+  ascii_file << "ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\n"
+             << "property float y\nproperty float z\nend_header\n1 2 3\n";
+  ascii_file.close();
+  resources::PointCloud ascii_point_cloud;
+  EXPECT_FALSE(
+      loadPointCloudFromBinaryPly(ascii_file_path, &ascii_point_cloud));
+  EXPECT_TRUE(ascii_point_cloud.empty());
+}
+
 TEST_F(ResourceLoaderTest, TestResourceCache) {
   const std::string resource_folder =
       kTestDataBaseFolder + "/TestResourceCache/" + kTestExternalFolderX;
@@ -1080,6 +1160,53 @@ TEST_F(ResourceLoaderTest, TestResourceCache) {
       2u + max_num_cache_entries_per_type + 2u);
 }
 
+TEST_F(ResourceLoaderTest, TestConcurrentCoalescedLoads) {
+  const std::string resource_folder =
+      kTestDataBaseFolder + "/TestConcurrentCoalescedLoads/" +
+      kTestExternalFolderX;
+
+  ResourceLoader loader;
+  constexpr size_t kNumResources = 4u;
+  std::vector<ResourceId> resource_ids(kNumResources);
+  for (size_t resource_idx = 0u; resource_idx < kNumResources;
+       ++resource_idx) {
+    common::generateId(&resource_ids[resource_idx]);
+    loader.addResource<std::string>(
+        resource_ids[resource_idx], ResourceType::kText, resource_folder,
+        "resource_" + std::to_string(resource_idx));
+  }
+
+  constexpr size_t kNumThreads = 16u;
+  constexpr size_t kGeneration = 0u;
+  std::vector<std::string> loaded_resources(kNumThreads);
+  std::vector<char> successes(kNumThreads, false);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      successes[thread_idx] = loader.loadResourceCoalesced<std::string>(
+          resource_ids[thread_idx % kNumResources], ResourceType::kText,
+          resource_folder, kGeneration, &loaded_resources[thread_idx]);
+      loader.addResourceToCache<std::string>(
+          resource_ids[thread_idx % kNumResources], ResourceType::kText,
+          loaded_resources[thread_idx]);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    EXPECT_TRUE(successes[thread_idx]);
+    EXPECT_EQ(
+        loaded_resources[thread_idx],
+        "resource_" + std::to_string(thread_idx % kNumResources));
+  }
+  for (const ResourceId& resource_id : resource_ids) {
+    EXPECT_TRUE(
+        loader.isResourceCached<std::string>(resource_id, ResourceType::kText));
+  }
+}
+
 }  // namespace backend
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "map-resources/resource-common.h"
+#include "map-resources/resource-prefetcher.h"
+
+namespace backend {
+
+constexpr size_t kNumResources = 20u;
+
+class ResourcePrefetcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ids_.resize(kNumResources);
+    for (ResourceId& id : ids_) {
+      common::generateId(&id);
+    }
+  }
+
+  ResourcePrefetcher::LoadFunction getLoadFunction() {
+    return [this](const ResourceId& id) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      std::lock_guard<std::mutex> lock(m_loaded_ids_);
+      EXPECT_TRUE(loaded_ids_.insert(id).second);
+    };
+  }
+
+  size_t getNumLoaded() {
+    std::lock_guard<std::mutex> lock(m_loaded_ids_);
+    return loaded_ids_.size();
+  }
+
+  bool isLoaded(const ResourceId& id) {
+    std::lock_guard<std::mutex> lock(m_loaded_ids_);
+    return loaded_ids_.count(id) > 0u;
+  }
+
+  void waitUntilIdle(const ResourcePrefetcher& prefetcher) {
+    while (!prefetcher.isIdle()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::vector<ResourceId> ids_;
+  std::mutex m_loaded_ids_;
+  std::unordered_set<ResourceId> loaded_ids_;
+};
+
+TEST_F(ResourcePrefetcherTest, StaysWithinLookaheadWindow) {
+  constexpr size_t kNumThreads = 3u;
+  constexpr size_t kLookaheadWindow = 4u;
+  ResourcePrefetcher prefetcher(kNumThreads, kLookaheadWindow);
+  prefetcher.prefetch(ResourceType::kRawImage, ids_, getLoadFunction());
+  waitUntilIdle(prefetcher);
+  EXPECT_EQ(getNumLoaded(), kLookaheadWindow);
+
+  for (size_t idx = 0u; idx < kNumResources; ++idx) {
+    prefetcher.notifyAccessAndWaitIfLoading(
+        ids_[idx], ResourceType::kRawImage);
+    // Resources are available once accessed, as an in-flight load is waited
+    // for.
+    EXPECT_TRUE(isLoaded(ids_[idx]));
+    waitUntilIdle(prefetcher);
+    EXPECT_EQ(
+        getNumLoaded(),
+        std::min(kNumResources, idx + 1u + kLookaheadWindow));
+  }
+}
+
+TEST_F(ResourcePrefetcherTest, SkippedResourcesAreNotLoaded) {
+  constexpr size_t kNumThreads = 2u;
+  constexpr size_t kLookaheadWindow = 2u;
+  ResourcePrefetcher prefetcher(kNumThreads, kLookaheadWindow);
+  prefetcher.prefetch(ResourceType::kRawImage, ids_, getLoadFunction());
+
+  // Accessing a later resource moves the window past all earlier ones.
+  prefetcher.notifyAccessAndWaitIfLoading(ids_[10], ResourceType::kRawImage);
+  waitUntilIdle(prefetcher);
+  EXPECT_FALSE(isLoaded(ids_[5]));
+  EXPECT_TRUE(isLoaded(ids_[11]));
+  EXPECT_TRUE(isLoaded(ids_[12]));
+  EXPECT_FALSE(isLoaded(ids_[13]));
+
+  // Accesses to other resource types or unknown resources are ignored.
+  prefetcher.notifyAccessAndWaitIfLoading(
+      ids_[19], ResourceType::kRawDepthMap);
+  ResourceId unknown_id;
+  common::generateId(&unknown_id);
+  prefetcher.notifyAccessAndWaitIfLoading(unknown_id, ResourceType::kRawImage);
+  waitUntilIdle(prefetcher);
+  EXPECT_FALSE(isLoaded(ids_[13]));
+
+  prefetcher.cancelAll();
+  prefetcher.notifyAccessAndWaitIfLoading(ids_[12], ResourceType::kRawImage);
+  waitUntilIdle(prefetcher);
+  EXPECT_FALSE(isLoaded(ids_[13]));
+}
+
+}  // namespace backend
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,5 +1,8 @@
 #include "aslam-serialization/visual-frame-serialization.h"
 
+#include <cstring>
+#include <string>
+
 #include <glog/logging.h>
 
 #include <aslam/cameras/camera.h>
@@ -11,6 +14,27 @@
 
 namespace aslam {
 namespace serialization {
+namespace {
+
+// Copies a packed proto array into the matrix in one block. The matrix is
+// only allocated once, such that it can then be swapped into the frame.
+template <typename ProtoScalar, typename MatrixType>
+void copyToMatrix(
+    const google::protobuf::RepeatedField<ProtoScalar>& proto, int rows,
+    int cols, MatrixType* matrix) {
+  static_assert(
+      sizeof(ProtoScalar) == sizeof(typename MatrixType::Scalar),
+      "The proto and the matrix scalars must have the same layout.");
+  CHECK_NOTNULL(matrix);
+  CHECK_EQ(rows * cols, proto.size());
+  matrix->resize(rows, cols);
+  if (proto.size() > 0) {
+    std::memcpy(
+        matrix->data(), proto.data(), proto.size() * sizeof(ProtoScalar));
+  }
+}
+
+}  // namespace
 
 void serializeVisualFrame(
     const aslam::VisualFrame& frame, aslam::proto::VisualFrame* proto) {
@@ -84,16 +108,21 @@ void deserializeVisualFrame(
 
     CHECK(success) << "Inconsistent landmark Visual Frame field sizes.";
 
-    Eigen::Map<const Eigen::Matrix2Xd> img_points_distorted(
-        proto.keypoint_measurements().data(), 2,
-        proto.keypoint_measurements_size() / 2);
-    Eigen::Map<const Eigen::VectorXd> uncertainties(
-        proto.keypoint_measurement_sigmas().data(),
-        proto.keypoint_measurement_sigmas_size());
-    Eigen::Map<const Eigen::VectorXd> scales(
-        proto.descriptor_scales().data(), proto.descriptor_scales_size());
-    Eigen::Map<const Eigen::VectorXi> track_ids(
-        proto.track_ids().data(), proto.track_ids_size());
+    // Every array is copied once from the proto and then swapped into the
+    // frame, instead of being converted into a temporary first.
+    const int num_keypoints = proto.keypoint_measurement_sigmas_size();
+    Eigen::Matrix2Xd img_points_distorted;
+    copyToMatrix(
+        proto.keypoint_measurements(), 2, num_keypoints,
+        &img_points_distorted);
+    Eigen::VectorXd uncertainties;
+    copyToMatrix(
+        proto.keypoint_measurement_sigmas(), num_keypoints, 1, &uncertainties);
+    Eigen::VectorXd scales;
+    copyToMatrix(
+        proto.descriptor_scales(), proto.descriptor_scales_size(), 1, &scales);
+    Eigen::VectorXi track_ids;
+    copyToMatrix(proto.track_ids(), proto.track_ids_size(), 1, &track_ids);
 
     *frame = aligned_shared<aslam::VisualFrame>();
     aslam::VisualFrame& frame_ref = **frame;
@@ -104,20 +133,20 @@ void deserializeVisualFrame(
 
     frame_ref.setId(frame_id);
     frame_ref.setTimestampNanoseconds(proto.timestamp());
-    frame_ref.setKeypointMeasurements(img_points_distorted);
-    frame_ref.setKeypointMeasurementUncertainties(uncertainties);
+    frame_ref.swapKeypointMeasurements(&img_points_distorted);
+    frame_ref.swapKeypointMeasurementUncertainties(&uncertainties);
     if (scales.rows() != 0) {
-      CHECK_EQ(scales.rows(), uncertainties.rows());
-      frame_ref.setKeypointScales(scales);
+      CHECK_EQ(scales.rows(), num_keypoints);
+      frame_ref.swapKeypointScales(&scales);
     }
     if (track_ids.rows() != 0) {
-      CHECK_EQ(track_ids.rows(), uncertainties.rows());
-      frame_ref.setTrackIds(track_ids);
+      CHECK_EQ(track_ids.rows(), num_keypoints);
+      frame_ref.swapTrackIds(&track_ids);
     }
 
-    // Need to set empty descriptors, otherwise getMutable call below fails.
-    frame_ref.setDescriptors(aslam::VisualFrame::DescriptorsT());
-    internal::deserializeDescriptors(proto, frame_ref.getDescriptorsMutable());
+    aslam::VisualFrame::DescriptorsT descriptors;
+    internal::deserializeDescriptors(proto, &descriptors);
+    frame_ref.swapDescriptors(&descriptors);
 
     CHECK(frame_ref.hasKeypointMeasurements());
     CHECK(frame_ref.hasKeypointMeasurementUncertainties());
@@ -216,26 +245,27 @@ void serializeDescriptors(
   proto->set_keypoint_descriptor_size(
       descriptors.rows() * sizeof(aslam::VisualFrame::DescriptorsT::Scalar));
 
-  std::string* descriptors_string = proto->mutable_keypoint_descriptors();
-  descriptors_string->resize(
+  // The descriptors are column major without padding, hence the block can be
+  // assigned as is without zero-initializing the bytes first.
+  proto->mutable_keypoint_descriptors()->assign(
+      reinterpret_cast<const char*>(descriptors.data()),
       descriptors.size() * sizeof(aslam::VisualFrame::DescriptorsT::Scalar));
-  Eigen::Map<aslam::VisualFrame::DescriptorsT> descriptors_map(
-      reinterpret_cast<unsigned char*>(&descriptors_string->front()),
-      descriptors.rows(), descriptors.cols());
-  descriptors_map = descriptors;
 }
 
 void deserializeDescriptors(
     const aslam::proto::VisualFrame& proto,
     aslam::VisualFrame::DescriptorsT* descriptors) {
   CHECK_NOTNULL(descriptors);
+  const std::string& bytes = proto.keypoint_descriptors();
   if (proto.keypoint_descriptor_size() != 0) {
-    Eigen::Map<const aslam::VisualFrame::DescriptorsT> descriptor_map(
-        reinterpret_cast<const unsigned char*>(
-            &proto.keypoint_descriptors().front()),
-        proto.keypoint_descriptor_size(),
-        proto.keypoint_descriptors().size() / proto.keypoint_descriptor_size());
-    *descriptors = descriptor_map;
+    CHECK_EQ(bytes.size() % proto.keypoint_descriptor_size(), 0u);
+    descriptors->resize(
+        proto.keypoint_descriptor_size() /
+            sizeof(aslam::VisualFrame::DescriptorsT::Scalar),
+        bytes.size() / proto.keypoint_descriptor_size());
+    if (!bytes.empty()) {
+      std::memcpy(descriptors->data(), bytes.data(), bytes.size());
+    }
   } else {
     descriptors->resize(0, 0);
   }
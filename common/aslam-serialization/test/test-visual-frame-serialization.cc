@@ -32,6 +32,41 @@ TEST(VisualFrameSerialization, SerializeDeserializeFrame) {
   EXPECT_EQ(*frame, *frame_deserialized);
 }
 
+TEST(VisualFrameSerialization, SerializeDeserializeFrameWithKeypoints) {
+  const Camera::ConstPtr camera =
+      PinholeCamera::createTestCamera<RadTanDistortion>();
+  constexpr int64_t kTimestampNs = 10;
+  const VisualFrame::Ptr frame =
+      VisualFrame::createEmptyTestVisualFrame(camera, kTimestampNs);
+
+  constexpr int kNumKeypoints = 100;
+  constexpr int kDescriptorBytes = 48;
+  frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, kNumKeypoints));
+  frame->setKeypointMeasurementUncertainties(
+      Eigen::VectorXd::Random(kNumKeypoints));
+  frame->setKeypointScales(Eigen::VectorXd::Random(kNumKeypoints));
+  frame->setTrackIds(Eigen::VectorXi::LinSpaced(kNumKeypoints, 0, 99));
+  VisualFrame::DescriptorsT descriptors(kDescriptorBytes, kNumKeypoints);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = static_cast<unsigned char>(i % 256);
+  }
+  frame->setDescriptors(descriptors);
+
+  proto::VisualFrame frame_proto;
+  serialization::serializeVisualFrame(*frame, &frame_proto);
+  EXPECT_EQ(frame_proto.keypoint_measurements_size(), 2 * kNumKeypoints);
+  EXPECT_EQ(
+      frame_proto.keypoint_descriptors().size(),
+      static_cast<size_t>(kDescriptorBytes * kNumKeypoints));
+
+  VisualFrame::Ptr frame_deserialized;
+  serialization::deserializeVisualFrame(
+      frame_proto, camera, &frame_deserialized);
+  ASSERT_TRUE(frame_deserialized != nullptr);
+  EXPECT_EQ(*frame, *frame_deserialized);
+  EXPECT_EQ(frame_deserialized->getDescriptors(), descriptors);
+}
+
 TEST(VisualFrameSerialization, SerializeDeserializeNFrame) {
   constexpr size_t kNumCameras = 2u;
   const NCamera::Ptr n_camera = NCamera::createTestNCamera(kNumCameras);
@@ -0,0 +1,72 @@
+#ifndef CONSOLE_COMMON_COMMAND_PROFILER_H_
+#define CONSOLE_COMMON_COMMAND_PROFILER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Measures the resources a console command used, see
+// --console_profile_commands. The CPU time and the memory are measured for
+// the whole process, so commands running in the background at the same time
+// are counted as well.
+class CommandProfiler {
+ public:
+  struct TimerDelta {
+    size_t num_samples;
+    double total_seconds;
+  };
+  struct StatisticDelta {
+    size_t num_samples;
+    double sum;
+  };
+
+  struct Profile {
+    std::string command;
+    int status;
+    int64_t start_time_unix_ms;
+    double wall_time_seconds;
+    double cpu_time_seconds;
+    // Increase of the peak resident set size of the process.
+    int64_t peak_rss_delta_kb;
+    // Only the timers and statistics that got new samples during the command.
+    std::unordered_map<std::string, TimerDelta> timers;
+    std::unordered_map<std::string, StatisticDelta> statistics;
+  };
+
+  CommandProfiler() = default;
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(CommandProfiler);
+
+  // Takes a snapshot of the process resources and of all timers and
+  // statistics.
+  void start(const std::string& command);
+  void stop(const int status, Profile* profile) const;
+
+  static void print(const Profile& profile, std::ostream* out);
+  // Appends the profile as one line of JSON.
+  static bool appendToLog(const Profile& profile, const std::string& filename);
+
+ private:
+  static double getCpuTimeSeconds();
+  static int64_t getPeakRssKb();
+  void snapshotTimersAndStatistics(
+      std::unordered_map<std::string, TimerDelta>* timers,
+      std::unordered_map<std::string, StatisticDelta>* statistics) const;
+
+  std::string command_;
+  std::chrono::steady_clock::time_point start_wall_time_;
+  std::chrono::system_clock::time_point start_system_time_;
+  double start_cpu_time_seconds_;
+  int64_t start_peak_rss_kb_;
+  std::unordered_map<std::string, TimerDelta> start_timers_;
+  std::unordered_map<std::string, StatisticDelta> start_statistics_;
+};
+
+}  // namespace common
+
+#endif  // CONSOLE_COMMON_COMMAND_PROFILER_H_
@@ -12,9 +12,15 @@
 
 #include <maplab-common/macros.h>
 
+#include "console-common/command-scheduler.h"
+
 namespace common {
 class Job;
 enum class Processing { Sync, Async };
+// Synchronous commands that only read the maps can run in the background,
+// concurrently to each other. See
+// --console_run_read_only_commands_in_background.
+enum class MapAccess { ReadWrite, ReadOnly };
 
 enum CommandStatus {
   kSuccess,
@@ -33,7 +39,7 @@ class CommandRegisterer {
   void getAllCommands(std::vector<std::string>* all_cmds) const;
 
   void listJobs() const;
-  void waitForJobsToFinish() const;
+  void waitForJobsToFinish();
 
   void clear();
 
@@ -41,18 +47,21 @@ class CommandRegisterer {
     Command(
         const std::initializer_list<std::string>& _commands,
         const std::function<int()>& _callback, const std::string& _help_text,
-        const Processing _processing_model, const std::string& _plugin_name)
+        const Processing _processing_model, const std::string& _plugin_name,
+        const MapAccess _map_access = MapAccess::ReadWrite)
         : commands(_commands),
           callback(_callback),
           help_text(_help_text),
           processing_model(_processing_model),
-          plugin_name(_plugin_name) {}
+          plugin_name(_plugin_name),
+          map_access(_map_access) {}
 
     std::vector<std::string> commands;
     std::function<int()> callback;
     std::string help_text;
     Processing processing_model;
     std::string plugin_name;
+    MapAccess map_access;
   };
 
   typedef std::vector<Command> Commands;
@@ -69,6 +78,8 @@ class CommandRegisterer {
   CommandIndexMap command_map_;
 
   std::unordered_map<int, std::shared_ptr<Job> > jobs_;
+
+  CommandScheduler command_scheduler_;
 };
 }  // namespace common
 #endif  // CONSOLE_COMMON_COMMAND_REGISTERER_H_
@@ -0,0 +1,46 @@
+#ifndef CONSOLE_COMMON_COMMAND_SCHEDULER_H_
+#define CONSOLE_COMMON_COMMAND_SCHEDULER_H_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Runs console commands that only read the maps in the background, such that
+// they can run concurrently to each other. The maps are protected by
+// reader-writer locks, hence the background commands only block each other
+// where they need write access anyway.
+// All other commands are exclusive: the console waits for all background
+// commands before running them, such that they can't modify the maps, flags
+// or the console state while a background command accesses them.
+class CommandScheduler {
+ public:
+  CommandScheduler();
+  // Waits for all background commands.
+  ~CommandScheduler();
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(CommandScheduler);
+
+  // Starts the command in a new thread and returns immediately.
+  void runInBackground(
+      const std::function<int()>& command, const std::string& command_name);
+
+  // Blocks until all background commands have finished.
+  void waitForBackgroundCommands();
+
+  size_t numRunningBackgroundCommands() const;
+
+ private:
+  std::mutex m_threads_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> num_running_commands_;
+};
+
+}  // namespace common
+
+#endif  // CONSOLE_COMMON_COMMAND_SCHEDULER_H_
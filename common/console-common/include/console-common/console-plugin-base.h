@@ -42,6 +42,14 @@ class ConsolePluginBase {
     commands_.emplace_back(
         commands, callback, help_text, processing_model, getPluginId());
   }
+  void addCommand(
+      const std::initializer_list<std::string>& commands,
+      const std::function<int()>& callback, const std::string& help_text,
+      const Processing processing_model, const MapAccess map_access) {
+    commands_.emplace_back(
+        commands, callback, help_text, processing_model, getPluginId(),
+        map_access);
+  }
 
   Console* console_;
 
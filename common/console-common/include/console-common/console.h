@@ -3,6 +3,7 @@
 
 #include <list>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -41,6 +42,7 @@ class Console {
   int RunCommand(const std::string& command);
   void addCommand(const CommandRegisterer::Command& command);
   void setConsoleName(const std::string& name);
+  // Thread-safe, e.g. for commands that load maps in the background.
   void addMapKeyToAutoCompletion(const std::string& map_key);
   void removeMapKeyFromAutoCompletion(const std::string& map_key);
   void addAllGFlagsToCompletion();
@@ -98,6 +100,9 @@ class Console {
     size_t getCompletionCandidates(
         const std::string& word_to_complete, const CompletionIndex& word_index,
         std::string* common_prefix, std::vector<std::string>* candidates) const;
+    // Guards both indices, which background commands can modify while
+    // readline is completing.
+    mutable std::mutex m_indices_;
     CompletionIndex command_index_;
     CompletionIndex flag_index_;
   };
@@ -0,0 +1,208 @@
+#include "console-common/command-profiler.h"
+
+#include <sys/resource.h>
+
+#include <fstream>  // NOLINT
+#include <iomanip>
+#include <sstream>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+
+namespace common {
+namespace {
+
+// Escapes the characters that may appear in command names and tags.
+std::string escapeJson(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (const char character : value) {
+    switch (character) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      case '\t':
+        escaped += "\\t";
+        break;
+      default:
+        escaped += character;
+    }
+  }
+  return escaped;
+}
+
+}  // namespace
+
+void CommandProfiler::start(const std::string& command) {
+  command_ = command;
+  snapshotTimersAndStatistics(&start_timers_, &start_statistics_);
+  start_peak_rss_kb_ = getPeakRssKb();
+  start_cpu_time_seconds_ = getCpuTimeSeconds();
+  start_system_time_ = std::chrono::system_clock::now();
+  start_wall_time_ = std::chrono::steady_clock::now();
+}
+
+void CommandProfiler::stop(const int status, Profile* profile) const {
+  CHECK_NOTNULL(profile);
+  const std::chrono::steady_clock::time_point end_wall_time =
+      std::chrono::steady_clock::now();
+  const double end_cpu_time_seconds = getCpuTimeSeconds();
+
+  profile->command = command_;
+  profile->status = status;
+  profile->start_time_unix_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          start_system_time_.time_since_epoch())
+          .count();
+  profile->wall_time_seconds =
+      std::chrono::duration<double>(end_wall_time - start_wall_time_).count();
+  profile->cpu_time_seconds = end_cpu_time_seconds - start_cpu_time_seconds_;
+  profile->peak_rss_delta_kb = getPeakRssKb() - start_peak_rss_kb_;
+
+  std::unordered_map<std::string, TimerDelta> end_timers;
+  std::unordered_map<std::string, StatisticDelta> end_statistics;
+  snapshotTimersAndStatistics(&end_timers, &end_statistics);
+  profile->timers.clear();
+  for (const std::pair<const std::string, TimerDelta>& timer : end_timers) {
+    TimerDelta delta = timer.second;
+    const auto start_it = start_timers_.find(timer.first);
+    // The timers might have been reset by the command.
+    if (start_it != start_timers_.end() &&
+        start_it->second.num_samples <= delta.num_samples) {
+      delta.num_samples -= start_it->second.num_samples;
+      delta.total_seconds -= start_it->second.total_seconds;
+    }
+    if (delta.num_samples > 0u) {
+      profile->timers.emplace(timer.first, delta);
+    }
+  }
+  profile->statistics.clear();
+  for (const std::pair<const std::string, StatisticDelta>& statistic :
+       end_statistics) {
+    StatisticDelta delta = statistic.second;
+    const auto start_it = start_statistics_.find(statistic.first);
+    if (start_it != start_statistics_.end() &&
+        start_it->second.num_samples <= delta.num_samples) {
+      delta.num_samples -= start_it->second.num_samples;
+      delta.sum -= start_it->second.sum;
+    }
+    if (delta.num_samples > 0u) {
+      profile->statistics.emplace(statistic.first, delta);
+    }
+  }
+}
+
+void CommandProfiler::print(const Profile& profile, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "Profile of " << profile.command << " (status " << profile.status
+       << "): " << std::fixed << std::setprecision(3) << "wall time "
+       << profile.wall_time_seconds << " s, CPU time "
+       << profile.cpu_time_seconds << " s, peak RSS +"
+       << profile.peak_rss_delta_kb << " kB." << std::endl;
+  for (const std::pair<const std::string, TimerDelta>& timer :
+       profile.timers) {
+    *out << "  timer " << timer.first << ": " << timer.second.num_samples
+         << " samples, " << timer.second.total_seconds << " s" << std::endl;
+  }
+  for (const std::pair<const std::string, StatisticDelta>& statistic :
+       profile.statistics) {
+    *out << "  statistic " << statistic.first << ": "
+         << statistic.second.num_samples << " samples, mean "
+         << statistic.second.sum / statistic.second.num_samples << std::endl;
+  }
+  out->unsetf(std::ios_base::floatfield);
+}
+
+bool CommandProfiler::appendToLog(
+    const Profile& profile, const std::string& filename) {
+  CHECK(!filename.empty());
+  std::ostringstream line;
+  line << std::setprecision(9) << "{\"command\": \""
+       << escapeJson(profile.command) << "\", \"status\": " << profile.status
+       << ", \"start_time_unix_ms\": " << profile.start_time_unix_ms
+       << ", \"wall_time_s\": " << profile.wall_time_seconds
+       << ", \"cpu_time_s\": " << profile.cpu_time_seconds
+       << ", \"peak_rss_delta_kb\": " << profile.peak_rss_delta_kb
+       << ", \"timers\": {";
+  bool is_first = true;
+  for (const std::pair<const std::string, TimerDelta>& timer :
+       profile.timers) {
+    line << (is_first ? "" : ", ") << '"' << escapeJson(timer.first)
+         << "\": {\"num_samples\": " << timer.second.num_samples
+         << ", \"total_s\": " << timer.second.total_seconds << '}';
+    is_first = false;
+  }
+  line << "}, \"statistics\": {";
+  is_first = true;
+  for (const std::pair<const std::string, StatisticDelta>& statistic :
+       profile.statistics) {
+    line << (is_first ? "" : ", ") << '"' << escapeJson(statistic.first)
+         << "\": {\"num_samples\": " << statistic.second.num_samples
+         << ", \"sum\": " << statistic.second.sum << '}';
+    is_first = false;
+  }
+  line << "}}\n";
+
+  std::ofstream log_file(filename, std::ofstream::out | std::ofstream::app);
+  if (!log_file.is_open()) {
+    LOG(ERROR) << "Could not open the command profile log " << filename
+               << '.';
+    return false;
+  }
+  log_file << line.str();
+  return log_file.good();
+}
+
+double CommandProfiler::getCpuTimeSeconds() {
+  rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  constexpr double kSecondsPerMicrosecond = 1e-6;
+  const double seconds =
+      static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec);
+  const double microseconds =
+      static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+  return seconds + kSecondsPerMicrosecond * microseconds;
+}
+
+int64_t CommandProfiler::getPeakRssKb() {
+  rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  // Kilobytes on Linux.
+  return static_cast<int64_t>(usage.ru_maxrss);
+}
+
+void CommandProfiler::snapshotTimersAndStatistics(
+    std::unordered_map<std::string, TimerDelta>* timers,
+    std::unordered_map<std::string, StatisticDelta>* statistics) const {
+  CHECK_NOTNULL(timers)->clear();
+  CHECK_NOTNULL(statistics)->clear();
+  for (const timing::Timing::map_t::value_type& tag_handle :
+       timing::Timing::GetTimers()) {
+    const size_t handle = tag_handle.second;
+    timers->emplace(
+        tag_handle.first,
+        TimerDelta{timing::Timing::GetNumSamples(handle),
+                   timing::Timing::GetTotalSeconds(handle)});
+  }
+  for (const statistics::Statistics::map_t::value_type& tag_handle :
+       statistics::Statistics::GetStatsCollectors()) {
+    const size_t handle = tag_handle.second;
+    const size_t num_samples = statistics::Statistics::GetNumSamples(handle);
+    statistics->emplace(
+        tag_handle.first,
+        StatisticDelta{
+            num_samples,
+            statistics::Statistics::GetMean(handle) * num_samples});
+  }
+}
+
+}  // namespace common
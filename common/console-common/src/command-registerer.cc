@@ -12,9 +12,27 @@
 #include <wordexp.h>
 
 #include <aslam/common/timer.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
 
+#include "console-common/command-profiler.h"
+
+DEFINE_bool(
+    console_run_read_only_commands_in_background, false,
+    "If true, commands that only read the maps run in the background, "
+    "concurrently to each other, as long as they don't set any flags. All "
+    "other commands wait until the background commands have finished.");
+DEFINE_bool(
+    console_profile_commands, false,
+    "If true, the wall time, CPU time, peak memory increase and the new "
+    "timer and statistics samples of every synchronous command are printed "
+    "after the command.");
+DEFINE_string(
+    console_profile_log_file, "",
+    "If set and --console_profile_commands is true, the command profiles are "
+    "appended to this file, one JSON object per line.");
+
 namespace common {
 class Job {
  public:
@@ -132,6 +150,7 @@ int CommandRegisterer::processCommand(const std::string& command) {
     // Go through all commands and check that the flags exist so we don't exit
     // in case we have a typo.
     int argc = result.we_wordc;
+    const bool sets_flags = argc > 1;
     for (int i = 1; i < argc; ++i) {
       std::string raw_command = result.we_wordv[i];
       // Process help here since gflags will shutdown the app otherwise.
@@ -162,10 +181,25 @@ int CommandRegisterer::processCommand(const std::string& command) {
       }
     }
 
-    google::ParseCommandLineFlags(&argc, &result.we_wordv, false);
-
     CHECK_LT(command_index_it->second, commands_.size());
     const Command& command = commands_[command_index_it->second];
+    // The flags are global, hence only commands that run with the current flag
+    // configuration can run in the background. Restoring the unchanged flags
+    // after this command doesn't write to them.
+    if (FLAGS_console_run_read_only_commands_in_background &&
+        command.map_access == MapAccess::ReadOnly &&
+        command.processing_model == Processing::Sync && !sets_flags) {
+      wordfree(&result);
+      command_scheduler_.runInBackground(
+          command.callback, command_without_flags);
+      return kSuccess;
+    }
+    // All other commands might modify the maps or flags the background
+    // commands are accessing.
+    command_scheduler_.waitForBackgroundCommands();
+
+    google::ParseCommandLineFlags(&argc, &result.we_wordv, false);
+
     if (command.processing_model == Processing::Async) {
       std::shared_ptr<Job> job(
           new Job(command.callback, command_without_flags));
@@ -176,9 +210,24 @@ int CommandRegisterer::processCommand(const std::string& command) {
     } else {
       try {
         wordfree(&result);
+        // Read the flag after parsing, so it can be set for a single command.
+        const bool profile_command = FLAGS_console_profile_commands;
+        CommandProfiler profiler;
+        if (profile_command) {
+          profiler.start(command_without_flags);
+        }
         timing::Timer timer("exec - " + std::string(command_without_flags));
         int status = command.callback();
         timer.Stop();
+        if (profile_command) {
+          CommandProfiler::Profile profile;
+          profiler.stop(status, &profile);
+          CommandProfiler::print(profile, &std::cout);
+          if (!FLAGS_console_profile_log_file.empty()) {
+            CommandProfiler::appendToLog(
+                profile, FLAGS_console_profile_log_file);
+          }
+        }
         return status;
       } catch (const std::exception& e) {  // NOLINT
         LOG(ERROR) << "Caught exception while processing command "
@@ -203,7 +252,8 @@ void CommandRegisterer::listJobs() const {
   }
 }
 
-void CommandRegisterer::waitForJobsToFinish() const {
+void CommandRegisterer::waitForJobsToFinish() {
+  command_scheduler_.waitForBackgroundCommands();
   if (jobs_.empty()) {
     std::cout << "No jobs started so far." << std::endl;
     return;
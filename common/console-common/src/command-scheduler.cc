@@ -0,0 +1,63 @@
+#include "console-common/command-scheduler.h"
+
+#include <exception>
+#include <iostream>  // NOLINT
+
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+
+#include "console-common/command-registerer.h"
+
+namespace common {
+
+CommandScheduler::CommandScheduler() : num_running_commands_(0u) {}
+
+CommandScheduler::~CommandScheduler() {
+  waitForBackgroundCommands();
+}
+
+void CommandScheduler::runInBackground(
+    const std::function<int()>& command, const std::string& command_name) {
+  CHECK(command);
+  ++num_running_commands_;
+  std::cout << "Running " << command_name << " in the background."
+            << std::endl;
+  std::lock_guard<std::mutex> lock(m_threads_);
+  threads_.emplace_back([this, command, command_name]() {
+    int status = kUnknownError;
+    try {
+      timing::Timer timer("exec - " + command_name);
+      status = command();
+      timer.Stop();
+    } catch (const std::exception& e) {  // NOLINT
+      LOG(ERROR) << "Caught exception while processing command "
+                 << command_name << ": " << e.what();
+    }
+    if (status != kSuccess) {
+      LOG(ERROR) << "Background command " << command_name
+                 << " failed with status " << status << ".";
+    }
+    --num_running_commands_;
+  });
+}
+
+void CommandScheduler::waitForBackgroundCommands() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(m_threads_);
+    threads.swap(threads_);
+  }
+  if (num_running_commands_ > 0u) {
+    std::cout << "Waiting for " << num_running_commands_
+              << " background command(s) to finish." << std::endl;
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+size_t CommandScheduler::numRunningBackgroundCommands() const {
+  return num_running_commands_;
+}
+
+}  // namespace common
@@ -181,14 +181,17 @@ Console::AutoCompletion::~AutoCompletion() {
 }
 
 void Console::AutoCompletion::addCommandToIndex(const std::string& command) {
+  std::lock_guard<std::mutex> lock(m_indices_);
   command_index_.insert(command);
 }
 
 void Console::AutoCompletion::addFlagToIndex(const std::string& flag) {
+  std::lock_guard<std::mutex> lock(m_indices_);
   flag_index_.insert(flag);
 }
 
 void Console::AutoCompletion::removeFlagFromIndex(const std::string& flag) {
+  std::lock_guard<std::mutex> lock(m_indices_);
   const CompletionIndex::const_iterator it = flag_index_.find(flag);
   if (it != flag_index_.end()) {
     flag_index_.erase(it);
@@ -240,6 +243,7 @@ char** Console::AutoCompletion::readlineCompletionCallback(
   AutoCompletion& that = *CHECK_NOTNULL(backlink_this_);
   std::string common_prefix_on_all_candidates;
   std::vector<std::string> candidates;
+  std::unique_lock<std::mutex> lock(that.m_indices_);
   if (start == 0) {
     // If the completed word starts at the beginning of the command line we look
     // for commands to
@@ -253,6 +257,7 @@ char** Console::AutoCompletion::readlineCompletionCallback(
         word_to_complete, that.flag_index_, &common_prefix_on_all_candidates,
         &candidates);
   }
+  lock.unlock();
   rl_completion_append_character = ' ';
 
   if (candidates.empty()) {
@@ -1,10 +1,16 @@
 #include "dense-reconstruction/conversion-tools.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glog/logging.h>
 #include <map-resources/resource-conversion.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 namespace dense_reconstruction {
 
@@ -12,54 +18,96 @@ bool convertAllDepthMapsToPointClouds(vi_map::VIMap* vi_map) {
   CHECK_NOTNULL(vi_map);
 
   VLOG(1) << "Converting all depth maps to point clouds...";
-  size_t num_conversions = 0u;
-  vi_map->forEachVertex([&](vi_map::Vertex* vertex) {
-    CHECK_NOTNULL(vertex);
-    const vi_map::MissionId& mission_id = vertex->getMissionId();
+
+  // The rays of every camera are back-projected once and shared by all its
+  // depth maps.
+  std::unordered_map<
+      aslam::CameraId, std::unique_ptr<const backend::DepthMapBackProjector>>
+      back_projectors;
+  vi_map::MissionIdList mission_ids;
+  vi_map->getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
     const aslam::NCamera& n_camera =
         vi_map->getSensorManager().getNCameraForMission(mission_id);
+    for (size_t camera_idx = 0u; camera_idx < n_camera.getNumCameras();
+         ++camera_idx) {
+      const aslam::Camera& camera = n_camera.getCamera(camera_idx);
+      if (back_projectors.count(camera.getId()) == 0u) {
+        back_projectors.emplace(
+            camera.getId(),
+            std::unique_ptr<const backend::DepthMapBackProjector>(
+                new backend::DepthMapBackProjector(camera)));
+      }
+    }
+  }
 
-    const pose_graph::VertexId& vertex_id = vertex->id();
-    const size_t num_frames = vertex->numFrames();
-    const aslam::VisualNFrame& nframe = vertex->getVisualNFrame();
+  pose_graph::VertexIdList vertex_ids;
+  vi_map->getAllVertexIds(&vertex_ids);
 
-    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-      if (nframe.isFrameSet(frame_idx)) {
-        cv::Mat depth_map;
-        if (vi_map->getOptimizedDepthMap(*vertex, frame_idx, &depth_map)) {
-          // Nothing to do here.
-        } else if (vi_map->getRawDepthMap(*vertex, frame_idx, &depth_map)) {
-          // Nothing to do here.
-        } else {
-          continue;
-        }
-        CHECK(!depth_map.empty()) << "Vertex " << vertex_id << " frame "
-                                  << frame_idx << " has an empty depth map!";
+  // The vertices are converted in parallel, loading and storing the resources
+  // is synchronized by the map.
+  std::atomic<size_t> num_conversions(0u);
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          vi_map::Vertex* vertex =
+              CHECK_NOTNULL(vi_map->getVertexPtr(vertex_ids[vertex_idx]));
+          const vi_map::MissionId& mission_id = vertex->getMissionId();
+          const aslam::NCamera& n_camera =
+              vi_map->getSensorManager().getNCameraForMission(mission_id);
 
-        const aslam::Camera& camera = n_camera.getCamera(frame_idx);
+          const pose_graph::VertexId& vertex_id = vertex->id();
+          const size_t num_frames = vertex->numFrames();
+          const aslam::VisualNFrame& nframe = vertex->getVisualNFrame();
 
-        resources::PointCloud point_cloud;
-        cv::Mat image_for_depth_map;
-        if (vi_map->getImageForDepthMap(
-                *vertex, frame_idx, &image_for_depth_map)) {
-          CHECK(!image_for_depth_map.empty())
-              << "Vertex " << vertex_id << " frame " << frame_idx
-              << " has an empty image for the depth map!";
-          if (backend::convertDepthMapWithImageToPointCloud(
-                  depth_map, image_for_depth_map, camera, &point_cloud)) {
-            vi_map->storePointCloudXYZRGBN(point_cloud, frame_idx, vertex);
-            ++num_conversions;
-          }
-        } else {
-          if (backend::convertDepthMapToPointCloud(
-                  depth_map, camera, &point_cloud)) {
-            vi_map->storePointCloudXYZ(point_cloud, frame_idx, vertex);
-            ++num_conversions;
+          for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+            if (!nframe.isFrameSet(frame_idx)) {
+              continue;
+            }
+            cv::Mat depth_map;
+            if (vi_map->getOptimizedDepthMap(*vertex, frame_idx, &depth_map)) {
+              // Nothing to do here.
+            } else if (vi_map->getRawDepthMap(
+                           *vertex, frame_idx, &depth_map)) {
+              // Nothing to do here.
+            } else {
+              continue;
+            }
+            CHECK(!depth_map.empty())
+                << "Vertex " << vertex_id << " frame " << frame_idx
+                << " has an empty depth map!";
+
+            const backend::DepthMapBackProjector& back_projector =
+                *common::getChecked(
+                    back_projectors, n_camera.getCamera(frame_idx).getId());
+
+            resources::PointCloud point_cloud;
+            cv::Mat image_for_depth_map;
+            if (vi_map->getImageForDepthMap(
+                    *vertex, frame_idx, &image_for_depth_map)) {
+              CHECK(!image_for_depth_map.empty())
+                  << "Vertex " << vertex_id << " frame " << frame_idx
+                  << " has an empty image for the depth map!";
+              if (back_projector.convertDepthMapToPointCloud(
+                      depth_map, image_for_depth_map, &point_cloud)) {
+                vi_map->storePointCloudXYZRGBN(point_cloud, frame_idx, vertex);
+                ++num_conversions;
+              }
+            } else {
+              // Without a matching image, no colors are assigned.
+              const cv::Mat no_image(1, 1, CV_8UC1);
+              if (back_projector.convertDepthMapToPointCloud(
+                      depth_map, no_image, &point_cloud)) {
+                vi_map->storePointCloudXYZ(point_cloud, frame_idx, vertex);
+                ++num_conversions;
+              }
+            }
           }
         }
-      }
-    }
-  });
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
   VLOG(1) << "Done. Converted " << num_conversions << " depth maps.";
   return true;
 }
@@ -0,0 +1,382 @@
+#ifndef MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_INL_H_
+#define MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_INL_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace common {
+
+template <typename ValueType, typename AllocatorType>
+constexpr int ColumnarTemporalBuffer<ValueType, AllocatorType>::kInvalidIndex;
+
+template <typename ValueType, typename AllocatorType>
+ColumnarTemporalBuffer<ValueType, AllocatorType>::ColumnarTemporalBuffer()
+    : buffer_length_nanoseconds_(-1) {}
+
+template <typename ValueType, typename AllocatorType>
+ColumnarTemporalBuffer<ValueType, AllocatorType>::ColumnarTemporalBuffer(
+    int64_t buffer_length_nanoseconds)
+    : buffer_length_nanoseconds_(buffer_length_nanoseconds) {}
+
+template <typename ValueType, typename AllocatorType>
+ColumnarTemporalBuffer<ValueType, AllocatorType>::ColumnarTemporalBuffer(
+    const ColumnarTemporalBuffer<ValueType, AllocatorType>& other) {
+  // Lock both mutexes without deadlock.
+  std::lock(mutex_, other.mutex_);
+
+  timestamps_ = other.timestamps_;
+  values_ = other.values_;
+  buffer_length_nanoseconds_ = other.buffer_length_nanoseconds_;
+
+  mutex_.unlock();
+  other.mutex_.unlock();
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value) {
+  constexpr bool kEmitWarningOnValueOverwrite = false;
+  addValue(timestamp, value, kEmitWarningOnValueOverwrite);
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value,
+    const bool emit_warning_on_value_overwrite) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  const bool value_inserted = insertSorted(timestamp, value);
+  LOG_IF(WARNING, !value_inserted && emit_warning_on_value_overwrite)
+      << "A value in temporal buffer at time " << timestamp
+      << " already exists!";
+  removeOutdatedItems();
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::insertSorted(
+    const int64_t timestamp, const ValueType& value) {
+  // Fast path for values arriving in order.
+  if (timestamps_.empty() || timestamps_.back() < timestamp) {
+    timestamps_.push_back(timestamp);
+    values_.push_back(value);
+    return true;
+  }
+  const size_t index = lowerBound(timestamp);
+  if (index < timestamps_.size() && timestamps_[index] == timestamp) {
+    return false;
+  }
+  timestamps_.insert(timestamps_.begin() + index, timestamp);
+  values_.insert(values_.begin() + index, value);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+size_t ColumnarTemporalBuffer<ValueType, AllocatorType>::lowerBound(
+    int64_t timestamp) const {
+  return std::lower_bound(timestamps_.begin(), timestamps_.end(), timestamp) -
+         timestamps_.begin();
+}
+
+template <typename ValueType, typename AllocatorType>
+size_t ColumnarTemporalBuffer<ValueType, AllocatorType>::nearestIndex(
+    int64_t timestamp, size_t lower_bound_index) const {
+  CHECK(!timestamps_.empty());
+  if (lower_bound_index == timestamps_.size()) {
+    return lower_bound_index - 1u;
+  }
+  if (lower_bound_index == 0u || timestamps_[lower_bound_index] == timestamp) {
+    return lower_bound_index;
+  }
+  // Both neighbors are within range, take the closer one and the later one on
+  // a tie.
+  return (timestamp - timestamps_[lower_bound_index - 1u] <
+          timestamps_[lower_bound_index] - timestamp)
+             ? lower_bound_index - 1u
+             : lower_bound_index;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::deleteValueAtTime(
+    int64_t timestamp_ns) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  const size_t index = lowerBound(timestamp_ns);
+  if (index == timestamps_.size() || timestamps_[index] != timestamp_ns) {
+    return false;
+  }
+  timestamps_.erase(timestamps_.begin() + index);
+  values_.erase(values_.begin() + index);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getOldestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (values_.empty()) {
+    return false;
+  }
+  *value = values_.front();
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getNewestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (values_.empty()) {
+    return false;
+  }
+  *value = values_.back();
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getValueAtTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  const size_t index = lowerBound(timestamp);
+  if (index < timestamps_.size() && timestamps_[index] == timestamp) {
+    *value = values_[index];
+    return true;
+  }
+  return false;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  return getNearestValueToTime(
+      timestamp, std::numeric_limits<int64_t>::max(), value);
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getValueAtOrBeforeTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // First value after the timestamp.
+  const size_t index =
+      std::upper_bound(timestamps_.begin(), timestamps_.end(), timestamp) -
+      timestamps_.begin();
+  if (index == 0u) {
+    return false;
+  }
+  *timestamp_of_value = timestamps_[index - 1u];
+  *value = values_[index - 1u];
+
+  CHECK_LE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getValueAtOrAfterTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  const size_t index = lowerBound(timestamp);
+  if (index == timestamps_.size()) {
+    return false;
+  }
+  *timestamp_of_value = timestamps_[index];
+  *value = values_[index];
+
+  CHECK_GE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+template <typename ValueContainerType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getValuesBetweenTimes(
+    int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+    ValueContainerType* values) const {
+  CHECK_NOTNULL(values)->clear();
+  CHECK_GT(timestamp_higher_ns, timestamp_lower_ns);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  // Early exit if there are too few items.
+  if (timestamps_.size() < 3u) {
+    return false;
+  }
+
+  if (timestamps_.front() > timestamp_lower_ns ||
+      timestamp_higher_ns > timestamps_.back()) {
+    return false;
+  }
+
+  // Exclude the borders.
+  const size_t begin_index =
+      std::upper_bound(
+          timestamps_.begin(), timestamps_.end(), timestamp_lower_ns) -
+      timestamps_.begin();
+  const size_t end_index = lowerBound(timestamp_higher_ns);
+  if (begin_index < end_index) {
+    values->insert(
+        values->end(), values_.begin() + begin_index,
+        values_.begin() + end_index);
+  }
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+size_t
+ColumnarTemporalBuffer<ValueType, AllocatorType>::getIndexRangeInTimeInterval(
+    int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+    size_t* begin_index, size_t* end_index) const {
+  CHECK_NOTNULL(begin_index);
+  CHECK_NOTNULL(end_index);
+  CHECK_LE(timestamp_lower_ns, timestamp_higher_ns);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  *begin_index = lowerBound(timestamp_lower_ns);
+  *end_index = std::upper_bound(
+                   timestamps_.begin() + *begin_index, timestamps_.end(),
+                   timestamp_higher_ns) -
+               timestamps_.begin();
+  return *end_index - *begin_index;
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::getNearestIndicesToTimes(
+    const std::vector<int64_t>& timestamps_ns, int64_t maximum_delta_ns,
+    std::vector<int>* indices) const {
+  CHECK_NOTNULL(indices)->assign(timestamps_ns.size(), kInvalidIndex);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (timestamps_.empty()) {
+    return;
+  }
+  CHECK_LE(
+      timestamps_.size(),
+      static_cast<size_t>(std::numeric_limits<int>::max()));
+
+  const bool are_queries_sorted =
+      std::is_sorted(timestamps_ns.begin(), timestamps_ns.end());
+  size_t lower_bound_index = 0u;
+  for (size_t query_idx = 0u; query_idx < timestamps_ns.size(); ++query_idx) {
+    const int64_t timestamp = timestamps_ns[query_idx];
+    if (are_queries_sorted) {
+      // Merge the two sorted sequences, the cursor only moves forward.
+      while (lower_bound_index < timestamps_.size() &&
+             timestamps_[lower_bound_index] < timestamp) {
+        ++lower_bound_index;
+      }
+    } else {
+      lower_bound_index = lowerBound(timestamp);
+    }
+    const size_t index = nearestIndex(timestamp, lower_bound_index);
+    if (std::abs(timestamps_[index] - timestamp) <= maximum_delta_ns) {
+      (*indices)[query_idx] = static_cast<int>(index);
+    }
+  }
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::
+    getIndicesAtOrBeforeTimes(
+        const std::vector<int64_t>& timestamps_ns,
+        std::vector<int>* indices) const {
+  CHECK_NOTNULL(indices)->assign(timestamps_ns.size(), kInvalidIndex);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  CHECK_LE(
+      timestamps_.size(),
+      static_cast<size_t>(std::numeric_limits<int>::max()));
+
+  const bool are_queries_sorted =
+      std::is_sorted(timestamps_ns.begin(), timestamps_ns.end());
+  // Number of values at or before the current query timestamp.
+  size_t num_values_at_or_before = 0u;
+  for (size_t query_idx = 0u; query_idx < timestamps_ns.size(); ++query_idx) {
+    const int64_t timestamp = timestamps_ns[query_idx];
+    if (are_queries_sorted) {
+      while (num_values_at_or_before < timestamps_.size() &&
+             timestamps_[num_values_at_or_before] <= timestamp) {
+        ++num_values_at_or_before;
+      }
+    } else {
+      num_values_at_or_before =
+          std::upper_bound(timestamps_.begin(), timestamps_.end(), timestamp) -
+          timestamps_.begin();
+    }
+    if (num_values_at_or_before > 0u) {
+      (*indices)[query_idx] = static_cast<int>(num_values_at_or_before - 1u);
+    }
+  }
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value,
+    int64_t* timestamp_at_value_ns) const {
+  CHECK_NOTNULL(timestamp_at_value_ns);
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  if (timestamps_.empty()) {
+    return false;
+  }
+
+  const size_t index = nearestIndex(timestamp, lowerBound(timestamp));
+  if (std::abs(timestamps_[index] - timestamp) > maximum_delta_ns) {
+    return false;
+  }
+  *value = values_[index];
+  *timestamp_at_value_ns = timestamps_[index];
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool ColumnarTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value) const {
+  int64_t timestamp_at_value_ns;
+  return getNearestValueToTime(
+      timestamp, maximum_delta_ns, value, &timestamp_at_value_ns);
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::removeOutdatedItems() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (timestamps_.empty() || buffer_length_nanoseconds_ <= 0) {
+    return;
+  }
+
+  const int64_t buffer_threshold_ns =
+      timestamps_.back() - buffer_length_nanoseconds_;
+  const size_t num_outdated = lowerBound(buffer_threshold_ns);
+  if (num_outdated > 0u) {
+    timestamps_.erase(timestamps_.begin(), timestamps_.begin() + num_outdated);
+    values_.erase(values_.begin(), values_.begin() + num_outdated);
+  }
+}
+
+template <typename ValueType, typename AllocatorType>
+void ColumnarTemporalBuffer<ValueType, AllocatorType>::insert(
+    const ColumnarTemporalBuffer& other) {
+  std::lock(mutex_, other.mutex_);
+  if (timestamps_.empty() ||
+      (!other.timestamps_.empty() &&
+       timestamps_.back() < other.timestamps_.front())) {
+    // Appending a newer buffer doesn't need any search.
+    timestamps_.insert(
+        timestamps_.end(), other.timestamps_.begin(), other.timestamps_.end());
+    values_.insert(values_.end(), other.values_.begin(), other.values_.end());
+  } else {
+    for (size_t i = 0u; i < other.timestamps_.size(); ++i) {
+      insertSorted(other.timestamps_[i], other.values_[i]);
+    }
+  }
+  mutex_.unlock();
+  other.mutex_.unlock();
+}
+
+}  // namespace common
+#endif  // MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_INL_H_
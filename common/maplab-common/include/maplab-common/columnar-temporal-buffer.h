@@ -0,0 +1,239 @@
+#ifndef MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_H_
+#define MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_H_
+
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace common {
+
+// Same interface as TemporalBuffer, but the timestamps and the values are
+// stored in two separate vectors sorted by time. Compared to the std::map of
+// TemporalBuffer there is no allocation per value, the timestamps of a time
+// range are contiguous and the values can be copied or serialized in one
+// pass. Appending a value newer than all others is amortized O(1), inserting
+// an older value and dropping outdated values are linear in the number of
+// values. Hence use this buffer for measurements that arrive (mostly) in
+// increasing time order and are rarely removed, e.g. the optional sensor data
+// of a map.
+//
+// On top of the TemporalBuffer interface, the buffer answers queries for many
+// timestamps at once with a single pass over the timestamps if the query
+// timestamps are sorted.
+//
+// As with TemporalBuffer, adding a value at an existing timestamp keeps the
+// existing value.
+template <typename ValueType,
+          typename AllocatorType =
+              std::allocator<std::pair<int64_t, ValueType> > >
+class ColumnarTemporalBuffer {
+ public:
+  // The allocator may be given for std::pair<const int64_t, ValueType>, as is
+  // required by the std::map of TemporalBuffer.
+  typedef typename std::allocator_traits<
+      AllocatorType>::template rebind_alloc<ValueType>
+      ValueAllocatorType;
+  typedef std::vector<int64_t> TimestampVectorType;
+  typedef std::vector<ValueType, ValueAllocatorType> ValueVectorType;
+  MAPLAB_POINTER_TYPEDEFS(ColumnarTemporalBuffer);
+
+  // Read-only view of the buffer as (timestamp, value) pairs in time order,
+  // so code iterating over buffered_values() of a TemporalBuffer works
+  // unchanged.
+  class BufferType {
+   public:
+    typedef std::pair<int64_t, const ValueType&> value_type;
+
+    class const_iterator
+        : public std::iterator<std::forward_iterator_tag, value_type> {
+     public:
+      const_iterator(const ColumnarTemporalBuffer* buffer, size_t index)
+          : buffer_(buffer), index_(index) {}
+      value_type operator*() const {
+        return value_type(
+            buffer_->timestamps_[index_], buffer_->values_[index_]);
+      }
+      const_iterator& operator++() {
+        ++index_;
+        return *this;
+      }
+      bool operator==(const const_iterator& other) const {
+        return index_ == other.index_ && buffer_ == other.buffer_;
+      }
+      bool operator!=(const const_iterator& other) const {
+        return !(*this == other);
+      }
+
+     private:
+      const ColumnarTemporalBuffer* buffer_;
+      size_t index_;
+    };
+
+    explicit BufferType(const ColumnarTemporalBuffer* buffer)
+        : buffer_(CHECK_NOTNULL(buffer)) {}
+    const_iterator begin() const {
+      return const_iterator(buffer_, 0u);
+    }
+    const_iterator end() const {
+      return const_iterator(buffer_, buffer_->timestamps_.size());
+    }
+    size_t size() const {
+      return buffer_->timestamps_.size();
+    }
+    bool empty() const {
+      return buffer_->timestamps_.empty();
+    }
+
+   private:
+    const ColumnarTemporalBuffer* buffer_;
+  };
+
+  // Index returned by the batch queries if there is no matching value.
+  static constexpr int kInvalidIndex = -1;
+
+  // Create buffer of infinite length (buffer_length_nanoseconds = -1)
+  ColumnarTemporalBuffer();
+
+  // Buffer length in nanoseconds defines after which time old entries get
+  // dropped. (buffer_length_nanoseconds == -1: infinite length.)
+  explicit ColumnarTemporalBuffer(int64_t buffer_length_nanoseconds);
+
+  ColumnarTemporalBuffer(const ColumnarTemporalBuffer& other);
+
+  void addValue(int64_t timestamp, const ValueType& value);
+  void addValue(
+      const int64_t timestamp, const ValueType& value,
+      const bool emit_warning_on_value_overwrite);
+  void insert(const ColumnarTemporalBuffer& other);
+
+  inline void reserve(const size_t num_values) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    timestamps_.reserve(num_values);
+    values_.reserve(num_values);
+  }
+  inline size_t size() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return timestamps_.size();
+  }
+  inline bool empty() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return timestamps_.empty();
+  }
+  // Memory of the columns, without any memory owned by the values.
+  inline size_t memoryUsageBytes() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return timestamps_.capacity() * sizeof(int64_t) +
+           values_.capacity() * sizeof(ValueType);
+  }
+  void clear() {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    timestamps_.clear();
+    values_.clear();
+  }
+
+  // Returns false if no value at a given timestamp present.
+  bool getValueAtTime(int64_t timestamp_ns, ValueType* value) const;
+
+  bool deleteValueAtTime(int64_t timestamp_ns);
+
+  bool getNearestValueToTime(int64_t timestamp_ns, ValueType* value) const;
+  bool getNearestValueToTime(
+      int64_t timestamp_ns, int64_t maximum_delta_ns, ValueType* value) const;
+  bool getNearestValueToTime(
+      int64_t timestamp, int64_t maximum_delta_ns, ValueType* value,
+      int64_t* timestamp_at_value_ns) const;
+
+  bool getOldestValue(ValueType* value) const;
+  bool getNewestValue(ValueType* value) const;
+
+  bool getValueAtOrBeforeTime(
+      int64_t timestamp_ns, int64_t* timestamp_ns_of_value,
+      ValueType* value) const;
+  bool getValueAtOrAfterTime(
+      int64_t timestamp_ns, int64_t* timestamp_ns_of_value,
+      ValueType* value) const;
+
+  // Get all values between the two specified timestamps excluding the border
+  // values.
+  // Example: content: 2 3 4 5
+  //          getValuesBetweenTimes(2, 5, ...) returns elements at 3, 4.
+  template <typename ValueContainerType>
+  bool getValuesBetweenTimes(
+      int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+      ValueContainerType* values) const;
+
+  // Indices [begin_index, end_index) of the values with a timestamp in
+  // [timestamp_lower_ns, timestamp_higher_ns], including the borders. Returns
+  // the number of values in the range.
+  size_t getIndexRangeInTimeInterval(
+      int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+      size_t* begin_index, size_t* end_index) const;
+
+  // For every query timestamp, the index of the nearest value within
+  // maximum_delta_ns, or kInvalidIndex. Ties are resolved as by
+  // getNearestValueToTime.
+  void getNearestIndicesToTimes(
+      const std::vector<int64_t>& timestamps_ns, int64_t maximum_delta_ns,
+      std::vector<int>* indices) const;
+  // For every query timestamp, the index of the newest value at or before the
+  // timestamp, or kInvalidIndex. Together with the next index this brackets
+  // the query timestamp, e.g. to interpolate between the values.
+  void getIndicesAtOrBeforeTimes(
+      const std::vector<int64_t>& timestamps_ns,
+      std::vector<int>* indices) const;
+
+  inline void lockContainer() const {
+    mutex_.lock();
+  }
+  inline void unlockContainer() const {
+    mutex_.unlock();
+  }
+
+  // The containers are exposed so we can iterate over the values in a linear
+  // fashion. The containers are not locked inside these methods so call
+  // lockContainer()/unlockContainer() when accessing them.
+  BufferType buffered_values() const {
+    return BufferType(this);
+  }
+  const TimestampVectorType& timestamps() const {
+    return timestamps_;
+  }
+  const ValueVectorType& values() const {
+    return values_;
+  }
+
+  inline bool operator==(const ColumnarTemporalBuffer& other) const {
+    return timestamps_ == other.timestamps_ && values_ == other.values_ &&
+           buffer_length_nanoseconds_ == other.buffer_length_nanoseconds_;
+  }
+
+ protected:
+  // Remove items that are older than the buffer length.
+  void removeOutdatedItems();
+
+  // Inserts the value at its place in time. Returns false and keeps the
+  // existing value if there is already a value at the timestamp.
+  bool insertSorted(const int64_t timestamp, const ValueType& value);
+
+  // Index of the first value at or after the timestamp.
+  size_t lowerBound(int64_t timestamp) const;
+
+  // Index of the nearest value to the timestamp given the index of the first
+  // value at or after it. The buffer must not be empty.
+  size_t nearestIndex(int64_t timestamp, size_t lower_bound_index) const;
+
+  TimestampVectorType timestamps_;
+  ValueVectorType values_;
+  int64_t buffer_length_nanoseconds_;
+  mutable std::recursive_mutex mutex_;
+};
+}  // namespace common
+
+#include "./columnar-temporal-buffer-inl.h"
+
+#endif  // MAPLAB_COMMON_COLUMNAR_TEMPORAL_BUFFER_H_
@@ -0,0 +1,233 @@
+#ifndef MAPLAB_COMMON_CSR_GRAPH_INL_H_
+#define MAPLAB_COMMON_CSR_GRAPH_INL_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "maplab-common/parallel-process.h"
+#include "maplab-common/union-find.h"
+
+namespace common {
+
+template <typename Weight>
+CsrGraph<Weight>::CsrGraph(
+    const int num_vertices, const std::vector<Edge>& edges)
+    : offsets_(num_vertices + 1, 0) {
+  CHECK_GE(num_vertices, 0);
+  // Counting sort of the edges by their source.
+  for (const Edge& edge : edges) {
+    CHECK_GE(edge.from, 0);
+    CHECK_LT(edge.from, num_vertices);
+    CHECK_GE(edge.to, 0);
+    CHECK_LT(edge.to, num_vertices);
+    ++offsets_[edge.from + 1];
+  }
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    offsets_[vertex + 1] += offsets_[vertex];
+  }
+  std::vector<int> insert_positions(offsets_.begin(), offsets_.end() - 1);
+  neighbors_.resize(edges.size());
+  weights_.resize(edges.size());
+  for (const Edge& edge : edges) {
+    const int position = insert_positions[edge.from]++;
+    neighbors_[position] = edge.to;
+    weights_[position] = edge.weight;
+  }
+
+  // Sorts the neighbors of every vertex and merges the duplicates in place.
+  std::vector<std::pair<int, Weight>> row;
+  int num_merged_edges = 0;
+  int row_begin = 0;
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    const int row_end = offsets_[vertex + 1];
+    row.clear();
+    for (int position = row_begin; position < row_end; ++position) {
+      row.emplace_back(neighbors_[position], weights_[position]);
+    }
+    std::sort(
+        row.begin(), row.end(),
+        [](const std::pair<int, Weight>& lhs,
+           const std::pair<int, Weight>& rhs) {
+          return lhs.first < rhs.first;
+        });
+
+    offsets_[vertex] = num_merged_edges;
+    for (const std::pair<int, Weight>& neighbor : row) {
+      if (num_merged_edges > offsets_[vertex] &&
+          neighbors_[num_merged_edges - 1] == neighbor.first) {
+        weights_[num_merged_edges - 1] += neighbor.second;
+      } else {
+        neighbors_[num_merged_edges] = neighbor.first;
+        weights_[num_merged_edges] = neighbor.second;
+        ++num_merged_edges;
+      }
+    }
+    row_begin = row_end;
+  }
+  offsets_[num_vertices] = num_merged_edges;
+  neighbors_.resize(num_merged_edges);
+  weights_.resize(num_merged_edges);
+}
+
+template <typename Weight>
+CsrGraph<Weight> CsrGraph<Weight>::fromUndirectedEdges(
+    const int num_vertices, const std::vector<Edge>& edges) {
+  std::vector<Edge> directed_edges;
+  directed_edges.reserve(2u * edges.size());
+  for (const Edge& edge : edges) {
+    directed_edges.emplace_back(edge);
+    directed_edges.emplace_back(edge.to, edge.from, edge.weight);
+  }
+  return CsrGraph(num_vertices, directed_edges);
+}
+
+template <typename Weight>
+template <typename EdgeFunction>
+void CsrGraph<Weight>::forEachEdge(const EdgeFunction& function) const {
+  const int num_vertices = getNumVertices();
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    for (int position = offsets_[vertex]; position < offsets_[vertex + 1];
+         ++position) {
+      function(vertex, neighbors_[position], weights_[position]);
+    }
+  }
+}
+
+template <typename Weight>
+template <typename WeightFunction>
+void CsrGraph<Weight>::computeEdgeWeights(
+    const WeightFunction& weight_function, const size_t num_threads) {
+  ParallelProcess(
+      getNumVertices(),
+      [&](const std::vector<size_t>& vertices) {
+        for (const size_t vertex : vertices) {
+          for (int position = offsets_[vertex];
+               position < offsets_[vertex + 1]; ++position) {
+            weights_[position] = weight_function(
+                static_cast<int>(vertex), neighbors_[position]);
+          }
+        }
+      },
+      /*always_parallelize=*/false, num_threads);
+}
+
+template <typename Weight>
+bool kruskalMaxSpanningForest(
+    const CsrGraph<Weight>& graph,
+    std::vector<typename CsrGraph<Weight>::Edge>* tree_edges) {
+  typedef typename CsrGraph<Weight>::Edge Edge;
+  CHECK_NOTNULL(tree_edges)->clear();
+
+  std::vector<Edge> edges;
+  edges.reserve(graph.getNumEdges() / 2);
+  graph.forEachEdge(
+      [&edges](const int from, const int to, const Weight& weight) {
+        if (from < to) {
+          edges.emplace_back(from, to, weight);
+        }
+      });
+  // Stable, such that ties are broken by the vertex order.
+  std::stable_sort(
+      edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs) {
+        return lhs.weight > rhs.weight;
+      });
+
+  const int num_vertices = graph.getNumVertices();
+  UnionFind components(num_vertices);
+  for (const Edge& edge : edges) {
+    if (static_cast<int>(tree_edges->size()) + 1 >= num_vertices) {
+      break;
+    }
+    if (components.unite(edge.from, edge.to)) {
+      tree_edges->emplace_back(edge);
+    }
+  }
+  return static_cast<int>(tree_edges->size()) + 1 == num_vertices;
+}
+
+template <typename Weight>
+void getVerticesBreadthFirst(
+    const CsrGraph<Weight>& graph, const int source,
+    std::vector<int>* vertices) {
+  CHECK_NOTNULL(vertices)->clear();
+  CHECK_GE(source, 0);
+  CHECK_LT(source, graph.getNumVertices());
+  std::vector<char> is_visited(graph.getNumVertices(), false);
+  is_visited[source] = true;
+  vertices->emplace_back(source);
+  // The output doubles as the queue.
+  for (size_t queue_idx = 0u; queue_idx < vertices->size(); ++queue_idx) {
+    const int vertex = (*vertices)[queue_idx];
+    for (int position = graph.offsets()[vertex];
+         position < graph.offsets()[vertex + 1]; ++position) {
+      const int neighbor = graph.neighbors()[position];
+      if (!is_visited[neighbor]) {
+        is_visited[neighbor] = true;
+        vertices->emplace_back(neighbor);
+      }
+    }
+  }
+}
+
+template <typename Weight>
+void getVerticesDepthFirst(
+    const CsrGraph<Weight>& graph, const int source,
+    std::vector<int>* vertices) {
+  CHECK_NOTNULL(vertices)->clear();
+  CHECK_GE(source, 0);
+  CHECK_LT(source, graph.getNumVertices());
+  std::vector<char> is_visited(graph.getNumVertices(), false);
+  std::vector<int> stack(1u, source);
+  while (!stack.empty()) {
+    const int vertex = stack.back();
+    stack.pop_back();
+    if (is_visited[vertex]) {
+      continue;
+    }
+    is_visited[vertex] = true;
+    vertices->emplace_back(vertex);
+    // Reversed, such that the neighbors are visited in increasing order.
+    for (int position = graph.offsets()[vertex + 1] - 1;
+         position >= graph.offsets()[vertex]; --position) {
+      const int neighbor = graph.neighbors()[position];
+      if (!is_visited[neighbor]) {
+        stack.emplace_back(neighbor);
+      }
+    }
+  }
+}
+
+template <typename Weight>
+int getConnectedComponents(
+    const CsrGraph<Weight>& graph, std::vector<int>* component_indices) {
+  CHECK_NOTNULL(component_indices)->assign(graph.getNumVertices(), -1);
+  int num_components = 0;
+  std::vector<int> queue;
+  for (int root = 0; root < graph.getNumVertices(); ++root) {
+    if ((*component_indices)[root] >= 0) {
+      continue;
+    }
+    (*component_indices)[root] = num_components;
+    queue.assign(1u, root);
+    for (size_t queue_idx = 0u; queue_idx < queue.size(); ++queue_idx) {
+      const int vertex = queue[queue_idx];
+      for (int position = graph.offsets()[vertex];
+           position < graph.offsets()[vertex + 1]; ++position) {
+        const int neighbor = graph.neighbors()[position];
+        if ((*component_indices)[neighbor] < 0) {
+          (*component_indices)[neighbor] = num_components;
+          queue.emplace_back(neighbor);
+        }
+      }
+    }
+    ++num_components;
+  }
+  return num_components;
+}
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_CSR_GRAPH_INL_H_
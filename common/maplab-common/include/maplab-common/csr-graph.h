@@ -0,0 +1,105 @@
+#ifndef MAPLAB_COMMON_CSR_GRAPH_H_
+#define MAPLAB_COMMON_CSR_GRAPH_H_
+
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace common {
+
+// Directed graph with weighted edges in compressed sparse row format: the
+// neighbors of vertex v are neighbors()[offsets()[v], offsets()[v + 1]), in
+// increasing order, with the edge weights at the same positions in weights().
+// The arrays can be handed to METIS as they are, as long as its idx_t is int.
+//
+// Undirected graphs store every edge in both directions, which the algorithms
+// below expect.
+template <typename Weight>
+class CsrGraph {
+ public:
+  struct Edge {
+    Edge() = default;
+    Edge(const int _from, const int _to, const Weight& _weight)
+        : from(_from), to(_to), weight(_weight) {}
+    int from;
+    int to;
+    Weight weight;
+  };
+
+  CsrGraph() : offsets_(1u, 0) {}
+
+  // Duplicate edges are merged by summing their weights.
+  CsrGraph(const int num_vertices, const std::vector<Edge>& edges);
+
+  // Adds every edge in both directions.
+  static CsrGraph fromUndirectedEdges(
+      const int num_vertices, const std::vector<Edge>& edges);
+
+  int getNumVertices() const {
+    return static_cast<int>(offsets_.size()) - 1;
+  }
+  // Counts the edges of undirected graphs twice.
+  int getNumEdges() const {
+    return static_cast<int>(neighbors_.size());
+  }
+  int getDegree(const int vertex) const {
+    return offsets_[vertex + 1] - offsets_[vertex];
+  }
+
+  const std::vector<int>& offsets() const {
+    return offsets_;
+  }
+  const std::vector<int>& neighbors() const {
+    return neighbors_;
+  }
+  const std::vector<Weight>& weights() const {
+    return weights_;
+  }
+
+  // Calls function(from, to, weight) for every edge.
+  template <typename EdgeFunction>
+  void forEachEdge(const EdgeFunction& function) const;
+
+  // Sets the weight of every edge to weight_function(from, to). The vertices
+  // are split among num_threads threads, so the function has to be safe to
+  // call concurrently.
+  template <typename WeightFunction>
+  void computeEdgeWeights(
+      const WeightFunction& weight_function, const size_t num_threads);
+
+ private:
+  std::vector<int> offsets_;
+  std::vector<int> neighbors_;
+  std::vector<Weight> weights_;
+};
+
+// Computes the maximum spanning forest of an undirected graph with Kruskal's
+// algorithm. Every tree edge is returned once, with from < to, in decreasing
+// order of the weights. Returns true if the forest is a single tree.
+template <typename Weight>
+bool kruskalMaxSpanningForest(
+    const CsrGraph<Weight>& graph,
+    std::vector<typename CsrGraph<Weight>::Edge>* tree_edges);
+
+// The vertices that are reachable from the source, in the order they are
+// visited with a breadth-first or depth-first (pre-order) search.
+template <typename Weight>
+void getVerticesBreadthFirst(
+    const CsrGraph<Weight>& graph, const int source,
+    std::vector<int>* vertices);
+template <typename Weight>
+void getVerticesDepthFirst(
+    const CsrGraph<Weight>& graph, const int source,
+    std::vector<int>* vertices);
+
+// Labels the connected components of an undirected graph, numbered in the
+// order of their smallest vertex. Returns the number of components.
+template <typename Weight>
+int getConnectedComponents(
+    const CsrGraph<Weight>& graph, std::vector<int>* component_indices);
+
+}  // namespace common
+
+#include "maplab-common/csr-graph-inl.h"
+
+#endif  // MAPLAB_COMMON_CSR_GRAPH_H_
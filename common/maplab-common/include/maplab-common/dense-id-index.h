@@ -0,0 +1,114 @@
+#ifndef MAPLAB_COMMON_DENSE_ID_INDEX_H_
+#define MAPLAB_COMMON_DENSE_ID_INDEX_H_
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "maplab-common/flat-hash-map.h"
+
+namespace common {
+
+// Assigns a small integer index to each id of a container, such that data
+// per id can be kept in flat arrays instead of hash maps. The index of an id
+// doesn't change as long as the id is part of the container. The indices of
+// removed ids are handed out again to ids that are added later, hence the
+// indices stay dense, but an index only refers to the same id as long as the
+// id is not removed. Unused indices below getNumIndices() refer to an invalid
+// id.
+template <typename IdType>
+class DenseIdIndex {
+ public:
+  static constexpr size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+  size_t add(const IdType& id) {
+    CHECK(id.isValid());
+    size_t index;
+    if (free_indices_.empty()) {
+      index = index_to_id_.size();
+      index_to_id_.emplace_back(id);
+    } else {
+      index = free_indices_.back();
+      free_indices_.pop_back();
+      index_to_id_[index] = id;
+    }
+    CHECK(id_to_index_.emplace(id, index).second)
+        << "Id " << id << " has an index already.";
+    return index;
+  }
+
+  void remove(const IdType& id) {
+    typename IndexMap::const_iterator it = id_to_index_.find(id);
+    CHECK(it != id_to_index_.end()) << "Id " << id << " has no index.";
+    const size_t index = it->second;
+    id_to_index_.erase(it);
+    index_to_id_[index].setInvalid();
+    free_indices_.emplace_back(index);
+  }
+
+  bool hasId(const IdType& id) const {
+    return id_to_index_.count(id) > 0u;
+  }
+
+  size_t getIndex(const IdType& id) const {
+    typename IndexMap::const_iterator it = id_to_index_.find(id);
+    CHECK(it != id_to_index_.end()) << "Id " << id << " has no index.";
+    return it->second;
+  }
+
+  // Returns kInvalidIndex if the id has no index.
+  size_t getIndexOrInvalid(const IdType& id) const {
+    typename IndexMap::const_iterator it = id_to_index_.find(id);
+    return it == id_to_index_.end() ? kInvalidIndex : it->second;
+  }
+
+  // Returns an invalid id if the index is unused.
+  const IdType& getId(size_t index) const {
+    CHECK_LT(index, index_to_id_.size());
+    return index_to_id_[index];
+  }
+
+  // Upper bound of all indices, i.e. the size of a flat array that can hold
+  // data for all ids.
+  size_t getNumIndices() const {
+    return index_to_id_.size();
+  }
+
+  size_t size() const {
+    return id_to_index_.size();
+  }
+
+  void reserve(size_t num_ids) {
+    id_to_index_.reserve(num_ids);
+    index_to_id_.reserve(num_ids);
+  }
+
+  void clear() {
+    id_to_index_.clear();
+    index_to_id_.clear();
+    free_indices_.clear();
+  }
+
+  void swap(DenseIdIndex* other) {
+    CHECK_NOTNULL(other);
+    id_to_index_.swap(other->id_to_index_);
+    index_to_id_.swap(other->index_to_id_);
+    free_indices_.swap(other->free_indices_);
+  }
+
+ private:
+  typedef FlatHashMap<IdType, size_t> IndexMap;
+
+  IndexMap id_to_index_;
+  std::vector<IdType> index_to_id_;
+  std::vector<size_t> free_indices_;
+};
+
+template <typename IdType>
+constexpr size_t DenseIdIndex<IdType>::kInvalidIndex;
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_DENSE_ID_INDEX_H_
@@ -13,13 +13,38 @@ namespace common {
 
 class FileLogger {
  public:
+  // Asynchronous mode: records passed to appendRecord() are copied to a
+  // lock-free buffer of the calling thread, and a background thread batches
+  // the buffers of all threads to disk. The records of one thread keep their
+  // order, while the records of different threads are interleaved as a
+  // whole. A record that doesn't fit into the buffer of its thread is dropped,
+  // such that the memory is bounded by buffer_size_bytes per thread.
+  struct AsyncOptions {
+    AsyncOptions() : buffer_size_bytes(1u << 20), write_period_ms(10) {}
+    // Rounded up to a power of two.
+    size_t buffer_size_bytes;
+    // The buffers are written at least this often, and earlier when one of
+    // them is half full.
+    int write_period_ms;
+  };
+
   explicit FileLogger(const std::string& filename);
+  FileLogger(const std::string& filename, const AsyncOptions& options);
   ~FileLogger();
 
   bool isOpen() const;
   void closeFile() const;
+  // In asynchronous mode, also waits until all records appended before the
+  // call are written.
   void flushBuffer();
 
+  // Appends a preformatted record, e.g. a line including its newline. In
+  // synchronous mode it is written directly. Fails once the file is closed.
+  void appendRecord(const char* data, const size_t size) const;
+  void appendRecord(const std::string& record) const;
+  // Records dropped in asynchronous mode because the buffer was full.
+  size_t getNumDroppedRecords() const;
+
   template <typename DataType>
   const FileLogger& operator<<(const DataType& object) const;
   const FileLogger& operator<<(std::ostream& (*object)(std::ostream&)) const;
@@ -75,8 +100,15 @@ class FileLogger {
       DataTypes... objects);
 
  private:
+  class AsyncWriter;
+
+  void openFile(const std::string& filename);
+
   mutable std::recursive_mutex mutex_;
   std::unique_ptr<std::ofstream> file_handle_;
+  // Only set in asynchronous mode. Writes to file_handle_, so it needs to be
+  // destroyed first.
+  std::unique_ptr<AsyncWriter> async_writer_;
 };
 
 }  // namespace common
@@ -1,6 +1,7 @@
 #ifndef MAPLAB_COMMON_FILE_SYSTEM_TOOLS_H_
 #define MAPLAB_COMMON_FILE_SYSTEM_TOOLS_H_
 
+#include <cstdint>
 #include <ctime>
 #include <string>
 #include <vector>
@@ -40,6 +41,23 @@ bool copyFile(
     const std::string& source, const std::string& destination, mode_t mode,
     bool overwrite);
 
+// Copies the content of source to the new file destination within the
+// kernel: with copy_file_range, which lets file systems that support it
+// share the data (reflink), or with sendfile. Falls back to a read/write
+// loop on other platforms and file systems. If try_hardlink is set, the
+// destination is created as a hard link of the source if both are on the
+// same file system. The destination must not exist.
+bool transferFile(
+    const std::string& source, const std::string& destination,
+    bool try_hardlink);
+
+// Renames source to destination if both are on the same file system, and
+// copies and deletes the source otherwise. The destination must not exist.
+bool moveFile(const std::string& source, const std::string& destination);
+
+// Returns -1 if the file does not exist.
+int64_t getFileSize(const std::string& file_path);
+
 // Traverse folder and subfolder and list all files and directories.
 // Sources:
 // https://stackoverflow.com/questions/612097/how-can-i-get-the-list-of-files-in-a-directory-using-c-or-c
@@ -0,0 +1,361 @@
+#ifndef MAPLAB_COMMON_FLAT_HASH_MAP_H_
+#define MAPLAB_COMMON_FLAT_HASH_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace common {
+
+// Hash map with open addressing and linear probing that stores its elements
+// in a single contiguous array, such that a lookup usually touches one or two
+// cache lines instead of following the bucket and node pointers of
+// std::unordered_map. It is meant for the id-keyed containers of the map,
+// whose ids are cheap to compare and whose hashes are spread over all bits;
+// the hash is scrambled with a Fibonacci multiplication, so the low bits of
+// the hash don't have to be random.
+//
+// The interface is the subset of std::unordered_map used by these containers,
+// with two differences:
+//  - Inserting an element may move all elements, which invalidates all
+//    iterators, pointers and references to elements. Erasing only invalidates
+//    the iterators, pointers and references to the erased element.
+//  - The elements are std::pair<Key, Value>, i.e. the key is not const, and
+//    the key and value types have to be default constructible.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap {
+ private:
+  enum class SlotState : uint8_t { kEmpty, kFull, kErased };
+
+  template <bool kIsConst>
+  class Iterator;
+
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<Key, Value> value_type;
+  typedef size_t size_type;
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  FlatHashMap() : num_elements_(0u), num_erased_(0u), capacity_shift_(0u) {}
+
+  iterator begin() {
+    return iterator(states_.data(), slots_.data(), states_.size()).skipEmpty();
+  }
+  iterator end() {
+    return iterator(
+        states_.data() + states_.size(), slots_.data() + slots_.size(), 0u);
+  }
+  const_iterator begin() const {
+    return const_iterator(states_.data(), slots_.data(), states_.size())
+        .skipEmpty();
+  }
+  const_iterator end() const {
+    return const_iterator(
+        states_.data() + states_.size(), slots_.data() + slots_.size(), 0u);
+  }
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+
+  size_t size() const {
+    return num_elements_;
+  }
+  bool empty() const {
+    return num_elements_ == 0u;
+  }
+  size_t capacity() const {
+    return slots_.size();
+  }
+  // Memory of the slots, without any memory owned by the elements.
+  size_t memoryUsageBytes() const {
+    return states_.capacity() * sizeof(SlotState) +
+           slots_.capacity() * sizeof(value_type);
+  }
+
+  iterator find(const Key& key) {
+    const size_t slot_idx = findSlot(key);
+    return slot_idx == kNotFound ? end() : iteratorAt(slot_idx);
+  }
+  const_iterator find(const Key& key) const {
+    const size_t slot_idx = findSlot(key);
+    return slot_idx == kNotFound ? end() : constIteratorAt(slot_idx);
+  }
+  size_t count(const Key& key) const {
+    return findSlot(key) == kNotFound ? 0u : 1u;
+  }
+
+  // Like std::unordered_map::emplace, the element is constructed before the
+  // key is looked up and discarded if the key is already present.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    value_type value(std::forward<Args>(args)...);
+    return insertUnique(std::move(value));
+  }
+  template <typename Pair>
+  std::pair<iterator, bool> insert(Pair&& value) {
+    return emplace(std::forward<Pair>(value));
+  }
+
+  Value& operator[](const Key& key) {
+    const size_t slot_idx = findSlot(key);
+    if (slot_idx != kNotFound) {
+      return slots_[slot_idx].second;
+    }
+    return insertUnique(value_type(key, Value())).first->second;
+  }
+
+  size_t erase(const Key& key) {
+    const size_t slot_idx = findSlot(key);
+    if (slot_idx == kNotFound) {
+      return 0u;
+    }
+    eraseSlot(slot_idx);
+    return 1u;
+  }
+  // Returns the iterator to the element following the erased one.
+  iterator erase(const_iterator it) {
+    CHECK(it != end());
+    const size_t slot_idx = it.state_ - states_.data();
+    eraseSlot(slot_idx);
+    return iteratorAt(slot_idx).skipEmpty();
+  }
+
+  void clear() {
+    states_.clear();
+    slots_.clear();
+    num_elements_ = 0u;
+    num_erased_ = 0u;
+    capacity_shift_ = 0u;
+  }
+
+  void reserve(size_t num_elements) {
+    const size_t capacity = capacityFor(num_elements);
+    if (capacity > slots_.size()) {
+      rehash(capacity);
+    }
+  }
+
+  void swap(FlatHashMap& other) {  // NOLINT
+    states_.swap(other.states_);
+    slots_.swap(other.slots_);
+    std::swap(num_elements_, other.num_elements_);
+    std::swap(num_erased_, other.num_erased_);
+    std::swap(capacity_shift_, other.capacity_shift_);
+  }
+
+  bool operator==(const FlatHashMap& other) const {
+    if (num_elements_ != other.num_elements_) {
+      return false;
+    }
+    for (const value_type& element : *this) {
+      const_iterator it = other.find(element.first);
+      if (it == other.end() || !(it->second == element.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const FlatHashMap& other) const {
+    return !operator==(other);
+  }
+
+ private:
+  template <bool kIsConst>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<Key, Value> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<
+        kIsConst, const value_type*, value_type*>::type pointer;
+    typedef typename std::conditional<
+        kIsConst, const value_type&, value_type&>::type reference;
+
+    Iterator() : state_(nullptr), slot_(nullptr), num_remaining_slots_(0u) {}
+    // Allows the conversion from iterator to const_iterator.
+    Iterator(const Iterator<false>& other)  // NOLINT
+        : state_(other.state_),
+          slot_(other.slot_),
+          num_remaining_slots_(other.num_remaining_slots_) {}
+
+    reference operator*() const {
+      return *slot_;
+    }
+    pointer operator->() const {
+      return slot_;
+    }
+    Iterator& operator++() {
+      advance();
+      return skipEmpty();
+    }
+    Iterator operator++(int) {
+      Iterator previous = *this;
+      ++(*this);
+      return previous;
+    }
+    bool operator==(const Iterator& other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return slot_ != other.slot_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    friend class Iterator<!kIsConst>;
+    typedef typename std::conditional<
+        kIsConst, const value_type*, value_type*>::type SlotPointer;
+
+    Iterator(
+        const SlotState* state, SlotPointer slot, size_t num_remaining_slots)
+        : state_(state),
+          slot_(slot),
+          num_remaining_slots_(num_remaining_slots) {}
+
+    void advance() {
+      ++state_;
+      ++slot_;
+      --num_remaining_slots_;
+    }
+    Iterator& skipEmpty() {
+      while (num_remaining_slots_ > 0u && *state_ != SlotState::kFull) {
+        advance();
+      }
+      return *this;
+    }
+
+    const SlotState* state_;
+    SlotPointer slot_;
+    size_t num_remaining_slots_;
+  };
+
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+  static constexpr size_t kMinCapacity = 16u;
+  // The slots are rehashed if more than 3/4 of them are full or erased.
+  static constexpr size_t kMaxLoadNumerator = 3u;
+  static constexpr size_t kMaxLoadDenominator = 4u;
+
+  static size_t capacityFor(size_t num_elements) {
+    size_t capacity = kMinCapacity;
+    while (capacity * kMaxLoadNumerator < num_elements * kMaxLoadDenominator) {
+      capacity *= 2u;
+    }
+    return capacity;
+  }
+
+  size_t homeSlot(const Key& key) const {
+    constexpr uint64_t kFibonacciMultiplier = 11400714819323198485ull;
+    return static_cast<size_t>(
+        (static_cast<uint64_t>(Hash()(key)) * kFibonacciMultiplier) >>
+        capacity_shift_);
+  }
+
+  size_t findSlot(const Key& key) const {
+    if (num_elements_ == 0u) {
+      return kNotFound;
+    }
+    // There is always at least one empty slot that ends the probing.
+    const size_t mask = slots_.size() - 1u;
+    for (size_t slot_idx = homeSlot(key);; slot_idx = (slot_idx + 1u) & mask) {
+      if (states_[slot_idx] == SlotState::kEmpty) {
+        return kNotFound;
+      }
+      if (states_[slot_idx] == SlotState::kFull &&
+          slots_[slot_idx].first == key) {
+        return slot_idx;
+      }
+    }
+  }
+
+  std::pair<iterator, bool> insertUnique(value_type&& value) {
+    const size_t existing_slot_idx = findSlot(value.first);
+    if (existing_slot_idx != kNotFound) {
+      return std::make_pair(iteratorAt(existing_slot_idx), false);
+    }
+    if ((num_elements_ + num_erased_ + 1u) * kMaxLoadDenominator >
+        slots_.size() * kMaxLoadNumerator) {
+      // Grows the slots or only drops the erased ones.
+      rehash(capacityFor(num_elements_ + 1u));
+    }
+    const size_t slot_idx = insertIntoFreeSlot(std::move(value));
+    return std::make_pair(iteratorAt(slot_idx), true);
+  }
+
+  // The key must not be present.
+  size_t insertIntoFreeSlot(value_type&& value) {
+    const size_t mask = slots_.size() - 1u;
+    size_t slot_idx = homeSlot(value.first);
+    while (states_[slot_idx] == SlotState::kFull) {
+      slot_idx = (slot_idx + 1u) & mask;
+    }
+    if (states_[slot_idx] == SlotState::kErased) {
+      --num_erased_;
+    }
+    states_[slot_idx] = SlotState::kFull;
+    slots_[slot_idx] = std::move(value);
+    ++num_elements_;
+    return slot_idx;
+  }
+
+  void eraseSlot(size_t slot_idx) {
+    CHECK(states_[slot_idx] == SlotState::kFull);
+    // Releases the resources held by the element right away.
+    slots_[slot_idx] = value_type();
+    states_[slot_idx] = SlotState::kErased;
+    --num_elements_;
+    ++num_erased_;
+  }
+
+  void rehash(size_t capacity) {
+    CHECK(capacity >= kMinCapacity);
+    CHECK_EQ(capacity & (capacity - 1u), 0u);
+    std::vector<SlotState> states(capacity, SlotState::kEmpty);
+    std::vector<value_type> slots(capacity);
+    states_.swap(states);
+    slots_.swap(slots);
+    capacity_shift_ = 64u;
+    for (size_t remaining = capacity; remaining > 1u; remaining /= 2u) {
+      --capacity_shift_;
+    }
+    num_elements_ = 0u;
+    num_erased_ = 0u;
+    for (size_t slot_idx = 0u; slot_idx < states.size(); ++slot_idx) {
+      if (states[slot_idx] == SlotState::kFull) {
+        insertIntoFreeSlot(std::move(slots[slot_idx]));
+      }
+    }
+  }
+
+  iterator iteratorAt(size_t slot_idx) {
+    return iterator(
+        states_.data() + slot_idx, slots_.data() + slot_idx,
+        states_.size() - slot_idx);
+  }
+  const_iterator constIteratorAt(size_t slot_idx) const {
+    return const_iterator(
+        states_.data() + slot_idx, slots_.data() + slot_idx,
+        states_.size() - slot_idx);
+  }
+
+  std::vector<SlotState> states_;
+  std::vector<value_type> slots_;
+  size_t num_elements_;
+  size_t num_erased_;
+  // Number of bits the scrambled 64 bit hash is shifted by to get the index
+  // of its home slot.
+  unsigned int capacity_shift_;
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_FLAT_HASH_MAP_H_
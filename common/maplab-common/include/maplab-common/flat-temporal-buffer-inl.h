@@ -0,0 +1,298 @@
+#ifndef MAPLAB_COMMON_FLAT_TEMPORAL_BUFFER_INL_H_
+#define MAPLAB_COMMON_FLAT_TEMPORAL_BUFFER_INL_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
+#include <glog/logging.h>
+
+namespace common {
+
+namespace internal {
+template <typename BufferValueType>
+inline bool isTimestampLess(
+    const BufferValueType& buffer_value, const int64_t timestamp) {
+  return buffer_value.first < timestamp;
+}
+}  // namespace internal
+
+template <typename ValueType, typename AllocatorType>
+FlatTemporalBuffer<ValueType, AllocatorType>::FlatTemporalBuffer()
+    : buffer_length_nanoseconds_(-1) {}
+
+template <typename ValueType, typename AllocatorType>
+FlatTemporalBuffer<ValueType, AllocatorType>::FlatTemporalBuffer(
+    int64_t buffer_length_nanoseconds)
+    : buffer_length_nanoseconds_(buffer_length_nanoseconds) {}
+
+template <typename ValueType, typename AllocatorType>
+FlatTemporalBuffer<ValueType, AllocatorType>::FlatTemporalBuffer(
+    const FlatTemporalBuffer<ValueType, AllocatorType>& other) {
+  // Lock both mutexes without deadlock.
+  std::lock(mutex_, other.mutex_);
+
+  values_ = other.values_;
+  buffer_length_nanoseconds_ = other.buffer_length_nanoseconds_;
+
+  mutex_.unlock();
+  other.mutex_.unlock();
+}
+
+template <typename ValueType, typename AllocatorType>
+void FlatTemporalBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value) {
+  constexpr bool kEmitWarningOnValueOverwrite = false;
+  addValue(timestamp, value, kEmitWarningOnValueOverwrite);
+}
+
+template <typename ValueType, typename AllocatorType>
+void FlatTemporalBuffer<ValueType, AllocatorType>::addValue(
+    const int64_t timestamp, const ValueType& value,
+    const bool emit_warning_on_value_overwrite) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  const bool value_inserted = insertSorted(timestamp, value);
+  LOG_IF(WARNING, !value_inserted && emit_warning_on_value_overwrite)
+      << "A value in temporal buffer at time " << timestamp
+      << " already exists!";
+  removeOutdatedItems();
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::insertSorted(
+    const int64_t timestamp, const ValueType& value) {
+  // Fast path for values arriving in order.
+  if (values_.empty() || values_.back().first < timestamp) {
+    values_.emplace_back(timestamp, value);
+    return true;
+  }
+  typename BufferType::iterator it = std::lower_bound(
+      values_.begin(), values_.end(), timestamp,
+      internal::isTimestampLess<BufferValueType>);
+  if (it != values_.end() && it->first == timestamp) {
+    return false;
+  }
+  values_.emplace(it, timestamp, value);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+typename FlatTemporalBuffer<ValueType, AllocatorType>::BufferType::
+    const_iterator
+    FlatTemporalBuffer<ValueType, AllocatorType>::lowerBound(
+        int64_t timestamp) const {
+  return std::lower_bound(
+      values_.begin(), values_.end(), timestamp,
+      internal::isTimestampLess<BufferValueType>);
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::deleteValueAtTime(
+    int64_t timestamp_ns) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  typename BufferType::iterator it = std::lower_bound(
+      values_.begin(), values_.end(), timestamp_ns,
+      internal::isTimestampLess<BufferValueType>);
+  if (it == values_.end() || it->first != timestamp_ns) {
+    return false;
+  }
+  values_.erase(it);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getOldestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (values_.empty()) {
+    return false;
+  }
+  *value = values_.front().second;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getNewestValue(
+    ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (values_.empty()) {
+    return false;
+  }
+  *value = values_.back().second;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getValueAtTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  typename BufferType::const_iterator it = lowerBound(timestamp);
+  if (it != values_.end() && it->first == timestamp) {
+    *value = it->second;
+    return true;
+  }
+  return false;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, ValueType* value) const {
+  CHECK_NOTNULL(value);
+  return getNearestValueToTime(
+      timestamp, std::numeric_limits<int64_t>::max(), value);
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getValueAtOrBeforeTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // First value after the timestamp.
+  typename BufferType::const_iterator it = std::upper_bound(
+      values_.begin(), values_.end(), timestamp,
+      [](const int64_t timestamp, const BufferValueType& buffer_value) {
+        return timestamp < buffer_value.first;
+      });
+  if (it == values_.begin()) {
+    return false;
+  }
+  --it;
+  *timestamp_of_value = it->first;
+  *value = it->second;
+
+  CHECK_LE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getValueAtOrAfterTime(
+    int64_t timestamp, int64_t* timestamp_of_value, ValueType* value) const {
+  CHECK_NOTNULL(timestamp_of_value);
+  CHECK_NOTNULL(value);
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  typename BufferType::const_iterator it = lowerBound(timestamp);
+  if (it == values_.end()) {
+    return false;
+  }
+  *timestamp_of_value = it->first;
+  *value = it->second;
+
+  CHECK_GE(*timestamp_of_value, timestamp);
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+template <typename ValueContainerType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getValuesBetweenTimes(
+    int64_t timestamp_lower_ns, int64_t timestamp_higher_ns,
+    ValueContainerType* values) const {
+  CHECK_NOTNULL(values)->clear();
+  CHECK_GT(timestamp_higher_ns, timestamp_lower_ns);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  // Early exit if there are too few items.
+  if (values_.size() < 3u) {
+    return false;
+  }
+
+  const int64_t oldest_timestamp = values_.front().first;
+  const int64_t latest_timestamp = values_.back().first;
+  if (oldest_timestamp > timestamp_lower_ns ||
+      timestamp_higher_ns > latest_timestamp) {
+    return false;
+  }
+
+  typename BufferType::const_iterator it = lowerBound(timestamp_lower_ns);
+  // lower_bound includes the border so we need to skip it when there is a
+  // perfect match.
+  if (it != values_.end() && it->first == timestamp_lower_ns) {
+    ++it;
+  }
+  const typename BufferType::const_iterator it_end =
+      std::lower_bound(
+          it, values_.end(), timestamp_higher_ns,
+          internal::isTimestampLess<BufferValueType>);
+  for (; it != it_end; ++it) {
+    values->emplace_back(it->second);
+  }
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value,
+    int64_t* timestamp_at_value_ns) const {
+  CHECK_NOTNULL(timestamp_at_value_ns);
+  CHECK_NOTNULL(value);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+  if (values_.empty()) {
+    return false;
+  }
+
+  const typename BufferType::const_iterator it_after = lowerBound(timestamp);
+  typename BufferType::const_iterator it_nearest;
+  if (it_after == values_.end()) {
+    it_nearest = std::prev(it_after);
+  } else if (it_after == values_.begin() || it_after->first == timestamp) {
+    it_nearest = it_after;
+  } else {
+    // Both neighbors are within range, take the closer one and the later one
+    // on a tie.
+    const typename BufferType::const_iterator it_before = std::prev(it_after);
+    it_nearest = (timestamp - it_before->first < it_after->first - timestamp)
+                     ? it_before
+                     : it_after;
+  }
+
+  if (std::abs(it_nearest->first - timestamp) > maximum_delta_ns) {
+    return false;
+  }
+  *value = it_nearest->second;
+  *timestamp_at_value_ns = it_nearest->first;
+  return true;
+}
+
+template <typename ValueType, typename AllocatorType>
+bool FlatTemporalBuffer<ValueType, AllocatorType>::getNearestValueToTime(
+    int64_t timestamp, int64_t maximum_delta_ns, ValueType* value) const {
+  int64_t timestamp_at_value_ns;
+  return getNearestValueToTime(
+      timestamp, maximum_delta_ns, value, &timestamp_at_value_ns);
+}
+
+template <typename ValueType, typename AllocatorType>
+void FlatTemporalBuffer<ValueType, AllocatorType>::removeOutdatedItems() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (values_.empty() || buffer_length_nanoseconds_ <= 0) {
+    return;
+  }
+
+  const int64_t buffer_threshold_ns =
+      values_.back().first - buffer_length_nanoseconds_;
+  while (values_.front().first < buffer_threshold_ns) {
+    values_.pop_front();
+  }
+}
+
+template <typename ValueType, typename AllocatorType>
+void FlatTemporalBuffer<ValueType, AllocatorType>::insert(
+    const FlatTemporalBuffer& other) {
+  std::lock(mutex_, other.mutex_);
+  for (const BufferValueType& value : other.values_) {
+    insertSorted(value.first, value.second);
+  }
+  mutex_.unlock();
+  other.mutex_.unlock();
+}
+
+}  // namespace common
+#endif  // MAPLAB_COMMON_FLAT_TEMPORAL_BUFFER_INL_H_
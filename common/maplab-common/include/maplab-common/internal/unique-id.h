@@ -32,7 +32,10 @@ class UniqueIdHashSeed {
   std::atomic<size_t> seed_;
 };
 
+// Thread-safe without synchronization between the calling threads.
 void generateUnique128BitHash(uint64_t hash[2]);
+// Writes num_hashes consecutive hashes of two words each.
+void generateUnique128BitHashes(const size_t num_hashes, uint64_t* hashes);
 }  // namespace internal
 }  // namespace common
 
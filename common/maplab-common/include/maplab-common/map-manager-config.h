@@ -41,6 +41,10 @@ struct SaveConfig {
   /// there is a maximum
   /// file size above which protobuf doesn't read the data anymore.
   size_t vertices_per_proto_file = 200u;
+
+  /// If set to true, a columnar snapshot of the dense vertex data is saved
+  /// next to the proto files, which makes loading the map faster.
+  bool save_columnar_snapshot = false;
 };
 
 }  // namespace backend
@@ -1,6 +1,7 @@
 #ifndef MAPLAB_COMMON_MAP_TRAITS_H_
 #define MAPLAB_COMMON_MAP_TRAITS_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -43,6 +44,21 @@ struct MapTraits {
   static void setMapFolder(const std::string& map_folder, MapType* map) {
     CHECK_NOTNULL(map)->setMapFolder(map_folder);
   }
+  // Moves the map back to a folder it was stored in before, without turning
+  // the current map folder into an external resource folder.
+  static void resetMapFolder(const std::string& map_folder, MapType* map) {
+    constexpr bool kAdaptResourceReferences = false;
+    CHECK_NOTNULL(map)->setMapFolder(map_folder, kAdaptResourceReferences);
+  }
+
+  // Estimated memory usage, which the map manager compares to its memory
+  // budget. Maps that don't provide an estimate don't count towards it.
+  static size_t getMemoryUsageBytes(const MapType& /*map*/) {
+    return 0u;
+  }
+  // Called by the map manager while no other access to the map exists, such
+  // that the map can free memory that accesses might reference.
+  static void releaseUnreferencedMemory(MapType* /*map*/) {}
 
   // Copy/merge.
   static void deepCopy(const MapType& source_map, MapType* target_map) {
@@ -0,0 +1,40 @@
+#ifndef MAPLAB_COMMON_MEMORY_USAGE_H_
+#define MAPLAB_COMMON_MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace common {
+
+// Estimates of the memory that containers allocate on the heap, i.e. without
+// the size of the container object itself, which is part of its owner. The
+// elements are not followed, owners add the memory of their elements if they
+// own any. Allocator overhead is not included.
+
+template <typename Derived>
+size_t getHeapMemoryUsageBytes(const Eigen::PlainObjectBase<Derived>& matrix) {
+  if (Derived::MaxSizeAtCompileTime != Eigen::Dynamic) {
+    return 0u;
+  }
+  return static_cast<size_t>(matrix.size()) * sizeof(typename Derived::Scalar);
+}
+
+template <typename Type, typename Allocator>
+size_t getHeapMemoryUsageBytes(const std::vector<Type, Allocator>& vector) {
+  return vector.capacity() * sizeof(Type);
+}
+
+// For node-based hash containers, e.g. std::unordered_map: one node with a
+// next pointer and the cached hash per element plus the buckets.
+template <typename HashContainer>
+size_t getHashContainerMemoryUsageBytes(const HashContainer& container) {
+  return container.size() *
+             (sizeof(typename HashContainer::value_type) + 2u * sizeof(void*)) +
+         container.bucket_count() * sizeof(void*);
+}
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_MEMORY_USAGE_H_
@@ -1,10 +1,11 @@
 #ifndef MAPLAB_COMMON_PARALLEL_PROCESS_H_
 #define MAPLAB_COMMON_PARALLEL_PROCESS_H_
 #include <cmath>
-#include <thread>  // NOLINT
+#include <functional>
 #include <vector>
 
 #include <glog/logging.h>
+#include <maplab-common/task-scheduler.h>
 #include <maplab-common/threading-helpers.h>
 
 // This is a helper to call a user provided functor or lamda with block indices
@@ -32,6 +33,10 @@
 //
 // Squarer squarer(data, &results);
 // ParallelProcess(data.size(), squarer, true, 16);
+//
+// The blocks are executed as tasks on the process-wide common::TaskScheduler,
+// i.e. no threads are created per call and the calling thread processes blocks
+// as well. num_threads defines the number of blocks the data is split into.
 
 namespace common {
 
@@ -62,7 +67,6 @@ void ParallelProcess(
   }
 
   size_t data_index = start_index;
-  std::vector<std::thread> threads;
   for (size_t block_idx = 0u; block_idx < blocks.size(); ++block_idx) {
     std::vector<size_t>& block = blocks[block_idx];
     for (size_t item_idx = 0u;
@@ -73,14 +77,19 @@ void ParallelProcess(
       block.push_back(data_index);
       ++data_index;
     }
-    threads.push_back(
-        std::thread([&functor, &block]() -> void { functor(block); }));
   }
 
-  CHECK_EQ(threads.size(), blocks.size());
-  for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
-    threads[block_idx].join();
+  if (blocks.size() == 1u) {
+    functor(blocks.front());
+    return;
+  }
+
+  std::vector<TaskScheduler::Task> tasks;
+  tasks.reserve(blocks.size());
+  for (const std::vector<size_t>& block : blocks) {
+    tasks.emplace_back([&functor, &block]() -> void { functor(block); });
   }
+  TaskScheduler::instance().runAndWait(tasks);
 }
 
 // Usually batches which are too small are not threaded. Set
@@ -1,8 +1,12 @@
 #ifndef MAPLAB_COMMON_PROTO_SERIALIZATION_HELPER_H_
 #define MAPLAB_COMMON_PROTO_SERIALIZATION_HELPER_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
+#include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/message.h>
 
 namespace common {
@@ -17,6 +21,30 @@ bool parseProtoFromFile(
     const std::string& folder_path, const std::string& file_name,
     google::protobuf::Message* proto, const bool is_text_format);
 
+/// Parses a proto from the binary content of a proto file as written by
+/// serializeProtoToFile, e.g. from a memory mapping of the file.
+bool parseProtoFromFileContent(
+    const void* data, const size_t num_bytes,
+    google::protobuf::Message* proto);
+
+/// Reads the files named \p file_names in \p folder_path on a pool of
+/// --proto_num_io_threads I/O threads and calls \p function with the index and
+/// the binary content of every file from up to \p num_parse_threads threads
+/// concurrently. Fetching the next files thus overlaps with processing the
+/// current ones, which hides the per-file latency of network storage. At most
+/// --proto_read_ahead_files files are held in memory ahead of the processed
+/// ones. Returns false if a file could not be read or \p function failed.
+bool processFilesWithReadAhead(
+    const std::string& folder_path, const std::vector<std::string>& file_names,
+    const std::function<bool(const size_t, const std::string&)>& function,
+    const size_t num_parse_threads);
+
+/// Batched version of parseProtoFromFile for binary proto files, which reads
+/// the files ahead as processFilesWithReadAhead and parses them in parallel.
+bool parseProtosFromFiles(
+    const std::string& folder_path, const std::vector<std::string>& file_names,
+    const std::vector<google::protobuf::Message*>& protos);
+
 /// Serializes the protobuf object given by \p proto and saves it in a file
 /// named \p file_name in \p folder_path.
 bool serializeProtoToFile(
@@ -26,6 +54,26 @@ bool serializeProtoToFile(
     const std::string& folder_path, const std::string& file_name,
     const google::protobuf::Message& proto, const bool use_text_format);
 
+/// Opens a file named \p file_name in \p folder_path and lets
+/// \p write_function serialize into it, compressed with the given zlib
+/// \p compression_level if compression is enabled (-1 selects the default
+/// level). Several messages of the same type serialized one after the other
+/// parse as a single message with all repeated fields concatenated, which
+/// allows to write large protos in chunks.
+bool serializeToFile(
+    const std::string& folder_path, const std::string& file_name,
+    const std::function<bool(google::protobuf::io::ZeroCopyOutputStream*)>&
+        write_function,
+    const int compression_level);
+
+/// Computes a 64 bit fingerprint of the uncompressed output of
+/// \p write_function without holding it in memory. Returns false if the
+/// write function fails.
+bool computeFingerprint(
+    const std::function<bool(google::protobuf::io::ZeroCopyOutputStream*)>&
+        write_function,
+    uint64_t* fingerprint);
+
 // Note: raw_data needs to be manually deleted afterwards, the caller takes
 // ownership of the data!
 void serializeToArray(
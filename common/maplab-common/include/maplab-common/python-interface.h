@@ -1,13 +1,113 @@
 #ifndef MAPLAB_COMMON_PYTHON_INTERFACE_H_
 #define MAPLAB_COMMON_PYTHON_INTERFACE_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <Eigen/Core>
+#include <glog/logging.h>
+
 namespace common {
 struct ScopedPyObject;
+struct PythonThreadState;
+
+// Buffer protocol format character of the supported scalar types.
+template <typename Scalar>
+struct PythonBufferFormat;
+template <>
+struct PythonBufferFormat<double> {
+  static constexpr const char* kFormat = "d";
+};
+template <>
+struct PythonBufferFormat<float> {
+  static constexpr const char* kFormat = "f";
+};
+template <>
+struct PythonBufferFormat<int32_t> {
+  static constexpr const char* kFormat = "i";
+};
+template <>
+struct PythonBufferFormat<uint8_t> {
+  static constexpr const char* kFormat = "B";
+};
+
+// Non-owning view of an Eigen matrix or map, e.g. landmark positions, vertex
+// poses or descriptors. It is passed to Python as a memoryview of shape
+// (rows, cols), or (rows,) for vectors, that numpy.asarray() wraps without a
+// copy. Views are only valid during the call, scripts have to copy any data
+// they keep.
+class PythonArrayView {
+ public:
+  template <typename Derived>
+  static PythonArrayView fromMatrix(const Eigen::DenseBase<Derived>& matrix) {
+    return PythonArrayView(matrix, /*is_writable=*/false);
+  }
+
+  // The script can write its results into the matrix.
+  template <typename Derived>
+  static PythonArrayView fromMutableMatrix(Eigen::DenseBase<Derived>* matrix) {
+    return PythonArrayView(*CHECK_NOTNULL(matrix), /*is_writable=*/true);
+  }
 
+  void* data() const {
+    return data_;
+  }
+  const char* format() const {
+    return format_;
+  }
+  size_t itemSize() const {
+    return item_size_;
+  }
+  size_t rows() const {
+    return rows_;
+  }
+  size_t cols() const {
+    return cols_;
+  }
+  // In elements.
+  size_t rowStride() const {
+    return row_stride_;
+  }
+  size_t colStride() const {
+    return col_stride_;
+  }
+  bool isWritable() const {
+    return is_writable_;
+  }
+
+ private:
+  template <typename Derived>
+  PythonArrayView(
+      const Eigen::DenseBase<Derived>& matrix, const bool is_writable)
+      : data_(const_cast<typename Derived::Scalar*>(matrix.derived().data())),
+        format_(PythonBufferFormat<typename Derived::Scalar>::kFormat),
+        item_size_(sizeof(typename Derived::Scalar)),
+        rows_(matrix.rows()),
+        cols_(matrix.cols()),
+        row_stride_(matrix.derived().rowStride()),
+        col_stride_(matrix.derived().colStride()),
+        is_writable_(is_writable) {
+    static_assert(
+        (Eigen::internal::traits<Derived>::Flags & Eigen::DirectAccessBit) !=
+            0,
+        "Only matrices with direct access to their data can be viewed.");
+  }
+
+  void* data_;
+  const char* format_;
+  size_t item_size_;
+  size_t rows_;
+  size_t cols_;
+  size_t row_stride_;
+  size_t col_stride_;
+  bool is_writable_;
+};
+
+// Python is only entered to run the module and its functions, the global
+// interpreter lock is released in between, such that other threads can call
+// functions as well.
 class PythonInterface {
  public:
   explicit PythonInterface(const std::string& python_script);
@@ -17,6 +117,19 @@ class PythonInterface {
       const std::string& function_name, const std::vector<double>& input,
       std::vector<double>* output);
 
+  // Calls the function with the views as positional arguments, without
+  // copying the data. Results are returned through writable views. Returns
+  // false if the call raised an exception.
+  bool callFunction(
+      const std::string& function_name,
+      const std::vector<PythonArrayView>& arguments);
+
+  // Calls the function once per set of arguments, but only looks it up and
+  // acquires the interpreter lock once. Stops at the first failing call.
+  bool callFunctionBatch(
+      const std::string& function_name,
+      const std::vector<std::vector<PythonArrayView>>& argument_batches);
+
  private:
   bool loadModule(const std::string& python_script);
   void unloadModule();
@@ -24,6 +137,7 @@ class PythonInterface {
 
  private:
   std::unique_ptr<ScopedPyObject> python_module_;
+  std::unique_ptr<PythonThreadState> main_thread_state_;
 };
 
 }  // namespace common
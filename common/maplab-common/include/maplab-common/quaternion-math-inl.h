@@ -162,6 +162,169 @@ Eigen::Matrix<typename Derived::Scalar, 4, 1> quaternionInverseJPL(
   return inverse_q;
 }
 
+namespace internal {
+
+typedef Eigen::Array<double, 1, Eigen::Dynamic> BatchRow;
+
+template <typename Derived>
+void normalizeColumns(const Eigen::MatrixBase<Derived>& matrix_const) {
+  Eigen::MatrixBase<Derived>& matrix =
+      const_cast<Eigen::MatrixBase<Derived>&>(matrix_const);
+  const BatchRow inverse_norms =
+      matrix.colwise().squaredNorm().array().sqrt().inverse();
+  matrix.array().rowwise() *= inverse_norms;
+}
+
+}  // namespace internal
+
+template <typename Derived>
+void toRotationMatrixJPLBatched(
+    const Eigen::MatrixBase<Derived>& q,
+    Eigen::Matrix<double, 9, Eigen::Dynamic>* rot_matrices) {
+  CHECK_NOTNULL(rot_matrices);
+  static_assert(Derived::RowsAtCompileTime == 4, "Expected a 4xN matrix.");
+  typedef internal::BatchRow BatchRow;
+
+  const BatchRow x = q.row(0).array();
+  const BatchRow y = q.row(1).array();
+  const BatchRow z = q.row(2).array();
+  const BatchRow w = q.row(3).array();
+
+  // Same coefficients as in toRotationMatrixJPL, entry (r, c) is row r + 3c.
+  rot_matrices->resize(Eigen::NoChange, q.cols());
+  rot_matrices->row(0).array() = 1.0 - 2.0 * (y * y + z * z);
+  rot_matrices->row(1).array() = 2.0 * (x * y - z * w);
+  rot_matrices->row(2).array() = 2.0 * (x * z + y * w);
+  rot_matrices->row(3).array() = 2.0 * (x * y + z * w);
+  rot_matrices->row(4).array() = 1.0 - 2.0 * (x * x + z * z);
+  rot_matrices->row(5).array() = 2.0 * (y * z - x * w);
+  rot_matrices->row(6).array() = 2.0 * (x * z - y * w);
+  rot_matrices->row(7).array() = 2.0 * (y * z + x * w);
+  rot_matrices->row(8).array() = 1.0 - 2.0 * (x * x + y * y);
+}
+
+template <typename Derived>
+void fromRotationMatrixJPLBatched(
+    const Eigen::MatrixBase<Derived>& rot_matrices, Eigen::Matrix4Xd* q_JPL) {
+  CHECK_NOTNULL(q_JPL);
+  static_assert(Derived::RowsAtCompileTime == 9, "Expected a 9xN matrix.");
+  typedef internal::BatchRow BatchRow;
+
+  const BatchRow r00 = rot_matrices.row(0).array();
+  const BatchRow r11 = rot_matrices.row(4).array();
+  const BatchRow r22 = rot_matrices.row(8).array();
+  const BatchRow trace = r00 + r11 + r22;
+
+  // fromRotationMatrixJPL picks the branch by the largest diagonal element.
+  // The branch of a dominant trace is evaluated for all columns at once, the
+  // few columns of rotations close to 180deg are redone with the scalar
+  // version.
+  const BatchRow w = ((1.0 + trace) / 4.0).sqrt();
+  const BatchRow inverse_4w = (4.0 * w).inverse();
+  q_JPL->resize(Eigen::NoChange, rot_matrices.cols());
+  q_JPL->row(0).array() =
+      inverse_4w * (rot_matrices.row(7).array() - rot_matrices.row(5).array());
+  q_JPL->row(1).array() =
+      inverse_4w * (rot_matrices.row(2).array() - rot_matrices.row(6).array());
+  q_JPL->row(2).array() =
+      inverse_4w * (rot_matrices.row(3).array() - rot_matrices.row(1).array());
+  q_JPL->row(3).array() = w;
+  internal::normalizeColumns(*q_JPL);
+
+  for (int i = 0; i < rot_matrices.cols(); ++i) {
+    if (r00(i) > trace(i) || r11(i) > trace(i) || r22(i) > trace(i)) {
+      Eigen::Matrix3d rot;
+      Eigen::Map<Eigen::Matrix<double, 9, 1>>(rot.data()) =
+          rot_matrices.col(i);
+      Eigen::Vector4d q_JPL_i;
+      fromRotationMatrixJPL(rot, &q_JPL_i);
+      q_JPL->col(i) = q_JPL_i;
+    }
+  }
+}
+
+template <typename Derived1, typename Derived2>
+void signedQuaternionProductJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q1,
+    const Eigen::MatrixBase<Derived2>& q2, Eigen::Matrix4Xd* product) {
+  CHECK_NOTNULL(product);
+  static_assert(Derived1::RowsAtCompileTime == 4, "Expected a 4xN matrix.");
+  static_assert(Derived2::RowsAtCompileTime == 4, "Expected a 4xN matrix.");
+  CHECK_EQ(q1.cols(), q2.cols());
+  typedef internal::BatchRow BatchRow;
+
+  const BatchRow x1 = q1.row(0).array();
+  const BatchRow y1 = q1.row(1).array();
+  const BatchRow z1 = q1.row(2).array();
+  const BatchRow w1 = q1.row(3).array();
+  const BatchRow x2 = q2.row(0).array();
+  const BatchRow y2 = q2.row(1).array();
+  const BatchRow z2 = q2.row(2).array();
+  const BatchRow w2 = q2.row(3).array();
+
+  // Expanded left multiplication matrix of signedQuaternionProductJPL:
+  // [w1 * v2 + w2 * v1 - v1 x v2, w1 * w2 - v1^T * v2].
+  product->resize(Eigen::NoChange, q1.cols());
+  product->row(0).array() = w1 * x2 + w2 * x1 - (y1 * z2 - z1 * y2);
+  product->row(1).array() = w1 * y2 + w2 * y1 - (z1 * x2 - x1 * z2);
+  product->row(2).array() = w1 * z2 + w2 * z1 - (x1 * y2 - y1 * x2);
+  product->row(3).array() = w1 * w2 - (x1 * x2 + y1 * y2 + z1 * z2);
+  internal::normalizeColumns(*product);
+}
+
+template <typename Derived1, typename Derived2>
+void positiveQuaternionProductJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q1,
+    const Eigen::MatrixBase<Derived2>& q2, Eigen::Matrix4Xd* product) {
+  CHECK_NOTNULL(product);
+  signedQuaternionProductJPLBatched(q1, q2, product);
+  ensurePositiveQuaternionBatched(*product);
+}
+
+template <typename Derived1, typename Derived2>
+void rotateVectorJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q, const Eigen::MatrixBase<Derived2>& v,
+    Eigen::Matrix3Xd* rotated_v) {
+  CHECK_NOTNULL(rotated_v);
+  static_assert(Derived1::RowsAtCompileTime == 4, "Expected a 4xN matrix.");
+  static_assert(Derived2::RowsAtCompileTime == 3, "Expected a 3xN matrix.");
+  CHECK_EQ(q.cols(), v.cols());
+  typedef internal::BatchRow BatchRow;
+
+  const BatchRow x = q.row(0).array();
+  const BatchRow y = q.row(1).array();
+  const BatchRow z = q.row(2).array();
+  const BatchRow w = q.row(3).array();
+  const BatchRow vx = v.row(0).array();
+  const BatchRow vy = v.row(1).array();
+  const BatchRow vz = v.row(2).array();
+
+  // R(q) = (2 * w^2 - 1) * I - 2 * w * [q_xyz]x + 2 * q_xyz * q_xyz^T.
+  const BatchRow scale_v = 2.0 * w * w - 1.0;
+  const BatchRow scale_q_xyz = 2.0 * (x * vx + y * vy + z * vz);
+  const BatchRow two_w = 2.0 * w;
+  rotated_v->resize(Eigen::NoChange, q.cols());
+  rotated_v->row(0).array() =
+      scale_v * vx - two_w * (y * vz - z * vy) + scale_q_xyz * x;
+  rotated_v->row(1).array() =
+      scale_v * vy - two_w * (z * vx - x * vz) + scale_q_xyz * y;
+  rotated_v->row(2).array() =
+      scale_v * vz - two_w * (x * vy - y * vx) + scale_q_xyz * z;
+}
+
+template <typename Derived>
+void ensurePositiveQuaternionBatched(
+    const Eigen::MatrixBase<Derived>& q_const) {
+  static_assert(Derived::RowsAtCompileTime == 4, "Expected a 4xN matrix.");
+  Eigen::MatrixBase<Derived>& q =
+      const_cast<Eigen::MatrixBase<Derived>&>(q_const);
+  const internal::BatchRow signs = (q.row(3).array() < 0.0)
+                                       .select(
+                                           -internal::BatchRow::Ones(q.cols()),
+                                           internal::BatchRow::Ones(q.cols()));
+  q.array().rowwise() *= signs;
+}
+
 template <typename Scalar>
 kindr::minimal::RotationQuaternionTemplate<Scalar>
 signedQuaternionProductHamilton(
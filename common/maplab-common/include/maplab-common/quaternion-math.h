@@ -40,6 +40,44 @@ template <typename Derived>
 Eigen::Matrix<typename Derived::Scalar, 4, 1> quaternionInverseJPL(
     const Eigen::MatrixBase<Derived>& q);
 
+// Batched versions of the JPL helpers above, operating on 4xN arrays of
+// quaternions [x, y, z, w] and 3xN arrays of vectors, one element per column.
+// The kernels are written as row-wise array expressions, s.t. Eigen
+// vectorizes them over the columns instead of evaluating one small fixed-size
+// product per element. The outputs may alias the inputs.
+
+// Column i of rot_matrices holds the 3x3 rotation matrix of column i of q in
+// column-major order, i.e. Eigen::Map<const Eigen::Matrix3d>(col(i).data()).
+template <typename Derived>
+void toRotationMatrixJPLBatched(
+    const Eigen::MatrixBase<Derived>& q,
+    Eigen::Matrix<double, 9, Eigen::Dynamic>* rot_matrices);
+
+template <typename Derived>
+void fromRotationMatrixJPLBatched(
+    const Eigen::MatrixBase<Derived>& rot_matrices, Eigen::Matrix4Xd* q_JPL);
+
+template <typename Derived1, typename Derived2>
+void signedQuaternionProductJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q1,
+    const Eigen::MatrixBase<Derived2>& q2, Eigen::Matrix4Xd* product);
+
+template <typename Derived1, typename Derived2>
+void positiveQuaternionProductJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q1,
+    const Eigen::MatrixBase<Derived2>& q2, Eigen::Matrix4Xd* product);
+
+// Computes R(q_i) * v_i with R(q) as returned by toRotationMatrixJPL, without
+// forming the rotation matrices.
+template <typename Derived1, typename Derived2>
+void rotateVectorJPLBatched(
+    const Eigen::MatrixBase<Derived1>& q, const Eigen::MatrixBase<Derived2>& v,
+    Eigen::Matrix3Xd* rotated_v);
+
+// Flips the sign of all quaternions with a negative scalar part in place.
+template <typename Derived>
+void ensurePositiveQuaternionBatched(const Eigen::MatrixBase<Derived>& q_const);
+
 template <typename Scalar>
 kindr::minimal::RotationQuaternionTemplate<Scalar>
 signedQuaternionProductHamilton(
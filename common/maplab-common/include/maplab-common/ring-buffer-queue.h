@@ -0,0 +1,314 @@
+#ifndef MAPLAB_COMMON_RING_BUFFER_QUEUE_H_
+#define MAPLAB_COMMON_RING_BUFFER_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+#include <maplab-common/threadsafe-queue.h>
+
+namespace common {
+
+// Fixed-capacity multi-producer/multi-consumer queue on a ring buffer, based on
+// the bounded queue design of D. Vyukov. Push and pop are lock-free; threads
+// only sleep on a mutex/condition variable if the queue is empty (consumers)
+// or full (producers), and are only notified if somebody is actually waiting.
+// The blocking, timeout and shutdown semantics follow common::ThreadSafeQueue.
+// The capacity is rounded up to the next power of two, and is at least two
+// since the sequence numbers of a single cell could not tell full from empty.
+template <typename QueueType>
+class RingBufferQueue final : public ThreadSafeQueueBase {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(RingBufferQueue);
+
+  explicit RingBufferQueue(size_t min_capacity)
+      : capacity_(roundUpToPowerOfTwo(min_capacity)),
+        index_mask_(capacity_ - 1u),
+        cells_(new Cell[capacity_]),
+        enqueue_position_(0u),
+        dequeue_position_(0u),
+        num_waiting_consumers_(0),
+        num_waiting_producers_(0),
+        shutdown_(false) {
+    CHECK_GT(min_capacity, 0u);
+    for (size_t cell_idx = 0u; cell_idx < capacity_; ++cell_idx) {
+      cells_[cell_idx].sequence.store(cell_idx, std::memory_order_relaxed);
+    }
+  }
+
+  ~RingBufferQueue() override {
+    Shutdown();
+  }
+
+  void NotifyAll() const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_empty_.notify_all();
+    condition_full_.notify_all();
+  }
+
+  void Shutdown() override {
+    shutdown_ = true;
+    NotifyAll();
+  }
+
+  void Resume() override {
+    shutdown_ = false;
+    NotifyAll();
+  }
+
+  // Approximate if pushes or pops are in flight.
+  size_t Size() const override {
+    const size_t dequeue_position =
+        dequeue_position_.load(std::memory_order_acquire);
+    const size_t enqueue_position =
+        enqueue_position_.load(std::memory_order_acquire);
+    return enqueue_position >= dequeue_position
+               ? enqueue_position - dequeue_position
+               : 0u;
+  }
+
+  bool Empty() const override {
+    return Size() == 0u;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // Push to the queue, blocking while the queue is full. Returns false if the
+  // queue was shut down.
+  bool Push(const QueueType& value) {
+    return PushBlockingIfFull(value);
+  }
+
+  bool PushBlockingIfFull(const QueueType& value) {
+    while (!shutdown_) {
+      if (tryPush(value)) {
+        notifyWaitingConsumers();
+        return true;
+      }
+      bool success = false;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_waiting_producers_.fetch_add(1);
+        // Pairs with the fence after a pop: either we see the free slot or
+        // the consumer sees us waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        success = !shutdown_ && tryPush(value);
+        if (!success && !shutdown_) {
+          condition_full_.wait(lock);
+        }
+        num_waiting_producers_.fetch_sub(1);
+      }
+      if (success) {
+        notifyWaitingConsumers();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns false if the queue is full.
+  bool PushNonBlocking(const QueueType& value) {
+    if (!tryPush(value)) {
+      return false;
+    }
+    notifyWaitingConsumers();
+    return true;
+  }
+
+  // Returns true if the oldest element was dropped because the queue was full.
+  bool PushNonBlockingDroppingOldestElementIfFull(const QueueType& value) {
+    bool dropped_oldest = false;
+    while (!tryPush(value)) {
+      QueueType oldest_value;
+      if (tryPop(&oldest_value)) {
+        dropped_oldest = true;
+      }
+    }
+    notifyWaitingConsumers();
+    return dropped_oldest;
+  }
+
+  // Pops from the queue blocking if queue is empty. Returns false if the queue
+  // was shut down.
+  bool Pop(QueueType* value) {
+    return PopBlocking(value);
+  }
+
+  bool PopBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    while (!shutdown_) {
+      if (tryPop(value)) {
+        notifyWaitingProducers();
+        return true;
+      }
+      bool success = false;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_waiting_consumers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        success = !shutdown_ && tryPop(value);
+        if (!success && !shutdown_) {
+          condition_empty_.wait(lock);
+        }
+        num_waiting_consumers_.fetch_sub(1);
+      }
+      if (success) {
+        notifyWaitingProducers();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns false if the queue is empty, without altering value.
+  bool PopNonBlocking(QueueType* value) {
+    CHECK_NOTNULL(value);
+    if (!tryPop(value)) {
+      return false;
+    }
+    notifyWaitingProducers();
+    return true;
+  }
+
+  // Waits at most timeout_nanoseconds for an element. Returns false if the
+  // queue stayed empty.
+  bool PopTimeout(QueueType* value, int64_t timeout_nanoseconds) {
+    CHECK_NOTNULL(value);
+    bool success = tryPop(value);
+    if (!success) {
+      const std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now() +
+          std::chrono::nanoseconds(timeout_nanoseconds);
+      std::unique_lock<std::mutex> lock(mutex_);
+      num_waiting_consumers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      success = tryPop(value);
+      while (!success && !shutdown_ &&
+             condition_empty_.wait_until(lock, deadline) !=
+                 std::cv_status::timeout) {
+        success = tryPop(value);
+      }
+      if (!success) {
+        success = tryPop(value);
+      }
+      num_waiting_consumers_.fetch_sub(1);
+    }
+    if (success) {
+      notifyWaitingProducers();
+    }
+    return success;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    QueueType value;
+  };
+
+  static size_t roundUpToPowerOfTwo(size_t value) {
+    size_t power_of_two = 2u;
+    while (power_of_two < value) {
+      power_of_two <<= 1u;
+    }
+    return power_of_two;
+  }
+
+  bool tryPush(const QueueType& value) {
+    Cell* cell;
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & index_mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The queue is full.
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(position + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(QueueType* value) {
+    Cell* cell;
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & index_mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) -
+                                  static_cast<intptr_t>(position + 1u);
+      if (difference == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The queue is empty.
+        return false;
+      } else {
+        position = dequeue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    *value = std::move(cell->value);
+    cell->sequence.store(position + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  // Must not be called with mutex_ held. Taking the mutex ensures that a
+  // waiter that has registered itself is already sleeping on the condition.
+  void notifyWaitingConsumers() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_waiting_consumers_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_empty_.notify_one();
+    }
+  }
+  void notifyWaitingProducers() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_waiting_producers_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_full_.notify_one();
+    }
+  }
+
+  const size_t capacity_;
+  const size_t index_mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // Producer and consumer positions are padded to separate cache lines to
+  // avoid false sharing.
+  static constexpr size_t kCacheLineSize = 64u;
+  char padding_0_[kCacheLineSize];
+  std::atomic<size_t> enqueue_position_;
+  char padding_1_[kCacheLineSize];
+  std::atomic<size_t> dequeue_position_;
+  char padding_2_[kCacheLineSize];
+
+  // Slow path for sleeping on an empty or full queue.
+  mutable std::mutex mutex_;
+  mutable std::condition_variable condition_empty_;
+  mutable std::condition_variable condition_full_;
+  std::atomic<int> num_waiting_consumers_;
+  std::atomic<int> num_waiting_producers_;
+  std::atomic_bool shutdown_;
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_RING_BUFFER_QUEUE_H_
@@ -0,0 +1,180 @@
+#ifndef MAPLAB_COMMON_TASK_SCHEDULER_H_
+#define MAPLAB_COMMON_TASK_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/thread-topology.h>
+
+namespace common {
+
+// Process-wide pool of persistent worker threads with one task deque per
+// worker. Workers execute their own tasks in LIFO order and steal the oldest
+// tasks of other workers when they run out of work.
+// A thread that waits for its tasks to finish executes its own pending tasks
+// in the meantime, which makes nested parallel calls from within tasks safe.
+// It never picks up the tasks of other callers, which might need a lock that
+// the waiting thread holds.
+//
+// Example:
+//   std::vector<double> values(kNumValues);
+//   common::TaskScheduler::instance().parallelFor(
+//       0u, values.size(), common::TaskScheduler::kAutomaticGrainSize,
+//       [&values](size_t begin, size_t end) {
+//         for (size_t i = begin; i < end; ++i) {
+//           values[i] = std::sqrt(i);
+//         }
+//       });
+class TaskScheduler {
+ public:
+  typedef std::function<void()> Task;
+
+  // Picks a grain size that gives every thread several chunks for load
+  // balancing.
+  static constexpr size_t kAutomaticGrainSize = 0u;
+
+  explicit TaskScheduler(size_t num_workers);
+  // The workers are restricted to the CPUs, e.g. those of a NUMA node.
+  TaskScheduler(size_t num_workers, const CpuList& worker_cpus);
+  ~TaskScheduler();
+
+  // Shared scheduler with common::getNumHardwareThreads() workers.
+  static TaskScheduler& instance();
+  // Shared scheduler with one worker per worker CPU of the NUMA node of the
+  // common::ThreadTopology, the workers only run on that node. Keeps the
+  // memory traffic of tasks on data allocated with common::runOnNumaNode()
+  // local to the node. Note that the calling thread executes tasks as well,
+  // e.g. run it within common::runOnNumaNode().
+  static TaskScheduler& instanceForNumaNode(size_t numa_node_index);
+
+  size_t getNumWorkers() const {
+    return workers_.size();
+  }
+
+  // Executes all tasks and blocks until they have finished. The calling
+  // thread executes tasks of this call as well.
+  void runAndWait(const std::vector<Task>& tasks);
+
+  // Calls range_functor(chunk_begin, chunk_end) for consecutive chunks of at
+  // most grain_size items that cover [begin, end). Chunks are handed out
+  // dynamically, so uneven work per item is balanced across the threads.
+  template <typename RangeFunctor>
+  void parallelFor(
+      size_t begin, size_t end, size_t grain_size,
+      const RangeFunctor& range_functor);
+
+  // Computes range_functor(chunk_begin, chunk_end) for all chunks of
+  // [begin, end) in parallel and combines the partial results with
+  // reduce_functor(a, b). The partial results are combined in order of the
+  // chunks, which makes the result deterministic for a given grain size.
+  template <typename ValueType, typename RangeFunctor, typename ReduceFunctor>
+  ValueType parallelReduce(
+      size_t begin, size_t end, size_t grain_size, const ValueType& identity,
+      const RangeFunctor& range_functor, const ReduceFunctor& reduce_functor);
+
+ private:
+  // Identifies the tasks of one runAndWait() call.
+  typedef const void* TaskGroup;
+  static constexpr TaskGroup kAnyTaskGroup = nullptr;
+
+  struct QueuedTask {
+    Task task;
+    TaskGroup group;
+  };
+
+  struct WorkerDeque {
+    std::mutex m_tasks;
+    std::deque<QueuedTask> tasks;
+  };
+
+  size_t getGrainSize(size_t num_items, size_t requested_grain_size) const;
+
+  void submit(const Task& task, TaskGroup group);
+  // Executes one pending task of the group, or of any group for
+  // kAnyTaskGroup, from the deque of any worker. Returns false if no such
+  // task was found.
+  bool tryRunPendingTask(TaskGroup group);
+  void workerLoop(size_t worker_index, const CpuList& worker_cpus);
+
+  std::vector<std::unique_ptr<WorkerDeque>> deques_;
+  std::atomic<size_t> next_round_robin_deque_;
+
+  std::mutex m_worker_state_;
+  std::condition_variable cv_tasks_available_;
+  std::atomic<size_t> num_pending_tasks_;
+  bool shutdown_requested_;
+
+  std::vector<std::thread> workers_;
+};
+
+template <typename RangeFunctor>
+void TaskScheduler::parallelFor(
+    size_t begin, size_t end, size_t grain_size,
+    const RangeFunctor& range_functor) {
+  if (end <= begin) {
+    return;
+  }
+  const size_t num_items = end - begin;
+  const size_t chunk_size = getGrainSize(num_items, grain_size);
+  const size_t num_chunks = (num_items + chunk_size - 1u) / chunk_size;
+  if (num_chunks == 1u) {
+    range_functor(begin, end);
+    return;
+  }
+
+  std::atomic<size_t> next_chunk(0u);
+  const Task chunk_runner = [&]() {
+    while (true) {
+      const size_t chunk_idx = next_chunk.fetch_add(1u);
+      if (chunk_idx >= num_chunks) {
+        return;
+      }
+      const size_t chunk_begin = begin + chunk_idx * chunk_size;
+      range_functor(chunk_begin, std::min(end, chunk_begin + chunk_size));
+    }
+  };
+  const size_t num_runners = std::min(num_chunks, getNumWorkers() + 1u);
+  runAndWait(std::vector<Task>(num_runners, chunk_runner));
+}
+
+template <typename ValueType, typename RangeFunctor, typename ReduceFunctor>
+ValueType TaskScheduler::parallelReduce(
+    size_t begin, size_t end, size_t grain_size, const ValueType& identity,
+    const RangeFunctor& range_functor, const ReduceFunctor& reduce_functor) {
+  if (end <= begin) {
+    return identity;
+  }
+  const size_t num_items = end - begin;
+  const size_t chunk_size = getGrainSize(num_items, grain_size);
+  const size_t num_chunks = (num_items + chunk_size - 1u) / chunk_size;
+
+  std::vector<ValueType> partial_results(num_chunks, identity);
+  constexpr size_t kOneChunkPerItem = 1u;
+  parallelFor(
+      0u, num_chunks, kOneChunkPerItem,
+      [&](size_t chunk_begin_idx, size_t chunk_end_idx) {
+        for (size_t chunk_idx = chunk_begin_idx; chunk_idx < chunk_end_idx;
+             ++chunk_idx) {
+          const size_t chunk_begin = begin + chunk_idx * chunk_size;
+          partial_results[chunk_idx] = range_functor(
+              chunk_begin, std::min(end, chunk_begin + chunk_size));
+        }
+      });
+
+  ValueType result = identity;
+  for (const ValueType& partial_result : partial_results) {
+    result = reduce_functor(result, partial_result);
+  }
+  return result;
+}
+
+}  // namespace common
+#endif  // MAPLAB_COMMON_TASK_SCHEDULER_H_
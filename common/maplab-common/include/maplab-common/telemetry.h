@@ -0,0 +1,144 @@
+#ifndef MAPLAB_COMMON_TELEMETRY_H_
+#define MAPLAB_COMMON_TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+namespace telemetry {
+
+// Timing and statistics for hot paths that are collected continuously, as an
+// alternative to timing::Timer and statistics::StatsCollector of aslam, which
+// report every sample to a mutex-protected global. Samples are accumulated in
+// per-thread buffers that only their thread writes to. Readers sum up the
+// buffers of all threads without stopping the writers, hence a summary may
+// miss the samples that are added while it is taken.
+//
+// Metrics are registered once, typically as function-local statics:
+//   static const common::telemetry::TimerMetric kTrackingTimer(
+//       "Feature tracking");
+//   common::telemetry::ScopedTimer timer(kTrackingTimer);
+
+// Nanoseconds of the monotonic clock, for measuring durations.
+inline int64_t getMonotonicTimeNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+class Metric {
+ public:
+  enum class Type { kStatistic, kTimer };
+
+  // Registers the metric, or looks it up if a metric of the same name and
+  // type exists already. Takes a global lock, so it should not be called in
+  // hot paths.
+  explicit Metric(const std::string& name, Type type = Type::kStatistic);
+
+  void addSample(double value) const;
+  // For counters, the number of samples is the count.
+  void increment() const {
+    addSample(1.0);
+  }
+
+  size_t getIndex() const {
+    return index_;
+  }
+
+ private:
+  size_t index_;
+};
+
+class TimerMetric : public Metric {
+ public:
+  explicit TimerMetric(const std::string& name) : Metric(name, Type::kTimer) {}
+};
+
+// Adds the elapsed time in seconds to a timer metric on stop() or
+// destruction, whichever comes first.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const Metric& metric);
+  ~ScopedTimer() {
+    stop();
+  }
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ScopedTimer);
+
+  // Returns the elapsed nanoseconds.
+  int64_t stop();
+
+ private:
+  const Metric& metric_;
+  const int64_t start_time_ns_;
+  bool is_stopped_;
+};
+
+struct MetricSummary {
+  std::string name;
+  Metric::Type type = Metric::Type::kStatistic;
+  uint64_t num_samples = 0u;
+  // Seconds for timers.
+  double sum = 0.0;
+  double min = 0.0;
+  double max = 0.0;
+
+  double getMean() const {
+    return num_samples > 0u ? sum / num_samples : 0.0;
+  }
+};
+
+// Includes the samples of threads that have exited. Ordered by registration.
+void getMetricSummaries(std::vector<MetricSummary>* summaries);
+
+// Prometheus text exposition format, one summary with count and sum per
+// metric plus gauges for the minimum and the maximum. Names are prefixed with
+// "maplab_" and reduced to lower case letters, digits and underscores, timers
+// get the suffix "_seconds".
+std::string exportPrometheus();
+
+// {"metrics": [{"name": ..., "type": "timer", "count": ..., "sum": ...,
+// "min": ..., "max": ..., "mean": ...}, ...]}
+std::string exportJson();
+
+// Periodically writes the metrics to a file, e.g. for the textfile collector
+// of the Prometheus node exporter. Files ending in ".json" are written as
+// JSON, everything else in the Prometheus text format. The file is replaced
+// atomically by renaming a temporary file.
+class PeriodicExporter {
+ public:
+  PeriodicExporter(const std::string& filepath, double period_s);
+  // Writes the file a final time.
+  ~PeriodicExporter();
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(PeriodicExporter);
+
+  bool exportNow() const;
+
+  // Configured by --maplab_telemetry_export_path and
+  // --maplab_telemetry_export_period_s, nullptr if no path is set.
+  static std::unique_ptr<PeriodicExporter> createFromFlags();
+
+ private:
+  void threadWorker();
+
+  const std::string filepath_;
+  const std::chrono::nanoseconds period_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_shutdown_;
+  bool shutdown_requested_;
+  std::thread thread_;
+};
+
+}  // namespace telemetry
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_TELEMETRY_H_
@@ -0,0 +1,84 @@
+#ifndef MAPLAB_COMMON_THREAD_TOPOLOGY_H_
+#define MAPLAB_COMMON_THREAD_TOPOLOGY_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace common {
+
+typedef std::vector<int> CpuList;
+
+// Parses lists like "0-3,8,10-11", as used by the kernel for cpusets and in
+// /sys/devices/system/node/node*/cpulist. The result is sorted and unique.
+bool parseCpuList(const std::string& cpu_list_string, CpuList* cpus);
+
+// Central configuration of the CPUs maplab threads run on:
+//  - The worker CPUs are the CPUs in the affinity mask of the process, e.g.
+//    set by taskset or a cpuset for CPU isolation, optionally restricted by
+//    --maplab_worker_cpus. common::getNumHardwareThreads() is their number.
+//  - The worker CPUs are grouped by NUMA node, see getNumaNodeCpus(), for
+//    thread pools per node such as TaskScheduler::instanceForNumaNode().
+//  - Real-time pipeline stages can be pinned to dedicated CPUs with
+//    --maplab_stage_cpus, e.g. "synchronizer=2;tracker=3;estimator=4-5".
+// On systems without NUMA information all worker CPUs form a single node.
+class ThreadTopology {
+ public:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ThreadTopology);
+
+  // Detected once, on first use.
+  static const ThreadTopology& instance();
+
+  const CpuList& getWorkerCpus() const {
+    return worker_cpus_;
+  }
+  size_t getNumNumaNodes() const {
+    return numa_node_cpus_.size();
+  }
+  // The worker CPUs of the node, nodes without worker CPUs are skipped.
+  const CpuList& getNumaNodeCpus(size_t numa_node_index) const;
+
+  // Empty if the stage is not pinned.
+  const CpuList& getStageCpus(const std::string& stage_name) const;
+
+ private:
+  ThreadTopology();
+
+  CpuList worker_cpus_;
+  std::vector<CpuList> numa_node_cpus_;
+  std::unordered_map<std::string, CpuList> stage_cpus_;
+};
+
+// Restricts the calling thread to the CPUs. Does nothing and returns true for
+// an empty list.
+bool setCurrentThreadAffinity(const CpuList& cpus);
+bool getCurrentThreadAffinity(CpuList* cpus);
+
+// Pins the calling thread to the CPUs for the lifetime of the object and
+// restores the previous affinity afterwards. Used by the stages of the
+// real-time pipeline that are executed on shared dispatcher threads.
+class ScopedThreadAffinity {
+ public:
+  explicit ScopedThreadAffinity(const CpuList& cpus);
+  ~ScopedThreadAffinity();
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ScopedThreadAffinity);
+
+ private:
+  bool is_pinned_;
+  CpuList previous_cpus_;
+};
+
+// Executes the function on the calling thread while it is pinned to the CPUs
+// of the NUMA node. With the first-touch policy of Linux, memory that is
+// first written inside the function, e.g. by resizing a large array, is
+// allocated on that node.
+void runOnNumaNode(
+    size_t numa_node_index, const std::function<void()>& function);
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_THREAD_TOPOLOGY_H_
@@ -5,7 +5,8 @@
 
 namespace common {
 
-// Return the number of concurrent threads supported by the hardware.
+// Return the number of concurrent threads supported by the hardware, i.e. the
+// number of worker CPUs of the common::ThreadTopology.
 size_t getNumHardwareThreads();
 
 }  // namespace common
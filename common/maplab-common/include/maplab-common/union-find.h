@@ -0,0 +1,56 @@
+#ifndef MAPLAB_COMMON_UNION_FIND_H_
+#define MAPLAB_COMMON_UNION_FIND_H_
+
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace common {
+
+// Disjoint sets of the elements [0, num_elements) with path halving and union
+// by size.
+class UnionFind {
+ public:
+  explicit UnionFind(const size_t num_elements)
+      : parents_(num_elements), sizes_(num_elements, 1u) {
+    std::iota(parents_.begin(), parents_.end(), 0u);
+  }
+
+  size_t find(size_t element) {
+    CHECK_LT(element, parents_.size());
+    while (parents_[element] != element) {
+      parents_[element] = parents_[parents_[element]];
+      element = parents_[element];
+    }
+    return element;
+  }
+
+  // Returns false if the elements were in the same set already.
+  bool unite(const size_t element_a, const size_t element_b) {
+    size_t root_a = find(element_a);
+    size_t root_b = find(element_b);
+    if (root_a == root_b) {
+      return false;
+    }
+    if (sizes_[root_a] < sizes_[root_b]) {
+      std::swap(root_a, root_b);
+    }
+    parents_[root_b] = root_a;
+    sizes_[root_a] += sizes_[root_b];
+    return true;
+  }
+
+  size_t getSetSize(const size_t element) {
+    return sizes_[find(element)];
+  }
+
+ private:
+  std::vector<size_t> parents_;
+  std::vector<size_t> sizes_;
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_UNION_FIND_H_
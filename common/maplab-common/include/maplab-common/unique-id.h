@@ -79,6 +79,17 @@ void generateId(IdType* id) {
   id->fromUint64(hash);
 }
 
+// Cheaper than calling generateId() num_ids times.
+template <typename IdType>
+void generateIds(const size_t num_ids, std::vector<IdType>* ids) {
+  CHECK_NOTNULL(ids)->resize(num_ids);
+  std::vector<uint64_t> hashes(2u * num_ids);
+  internal::generateUnique128BitHashes(num_ids, hashes.data());
+  for (size_t id_idx = 0u; id_idx < num_ids; ++id_idx) {
+    (*ids)[id_idx].fromUint64(hashes.data() + 2u * id_idx);
+  }
+}
+
 template <typename IdType>
 IdType createRandomId() {
   IdType id;
@@ -94,6 +105,15 @@ void generateIdFromInt(unsigned int idx, IdType* id) {
   id->fromHexString(ss.str());
 }
 
+// Ids in packed arrays are stored as consecutive 64 bit words.
+static constexpr int kNumWordsPerPackedId = 2;
+
+inline int getNumPackedIds(
+    const google::protobuf::RepeatedField<google::protobuf::uint64>& words) {
+  CHECK_EQ(words.size() % kNumWordsPerPackedId, 0);
+  return words.size() / kNumWordsPerPackedId;
+}
+
 // For internal use only.
 class Id : public aslam::HashId {
  public:
@@ -114,6 +134,23 @@ class Id : public aslam::HashId {
     uint_field->Add();
     toUint64(uint_field->mutable_data());
   }
+  // Appends the id to an array of packed ids, see getNumPackedIds().
+  inline void serialize(
+      google::protobuf::RepeatedField<google::protobuf::uint64>* words) const {
+    CHECK_NOTNULL(words);
+    for (int i = 0; i < kNumWordsPerPackedId; ++i) {
+      words->Add();
+    }
+    toUint64(words->mutable_data() + words->size() - kNumWordsPerPackedId);
+  }
+  // Reads the index-th id of an array of packed ids.
+  inline void deserialize(
+      const google::protobuf::RepeatedField<google::protobuf::uint64>& words,
+      const int index) {
+    CHECK_GE(index, 0);
+    CHECK_LE(kNumWordsPerPackedId * (index + 1), words.size());
+    fromUint64(words.data() + kNumWordsPerPackedId * index);
+  }
 
   inline void fromHashId(const aslam::HashId& id) {
     static_cast<aslam::HashId&>(*this) = id;
@@ -138,6 +175,9 @@ class Id : public aslam::HashId {
   }
   template <typename GenerateIdType>
   friend void generateId(GenerateIdType* id);
+  template <typename GenerateIdType>
+  friend void generateIds(
+      const size_t num_ids, std::vector<GenerateIdType>* ids);
 
   bool correspondsTo(const common::proto::Id& proto_id) const {
     Id corresponding(proto_id);
@@ -210,6 +250,9 @@ class UniqueId : private Id {
 
   template <typename GenerateIdType>
   friend void generateId(GenerateIdType* id);
+  template <typename GenerateIdType>
+  friend void generateIds(
+      const size_t num_ids, std::vector<GenerateIdType>* ids);
 };
 }  // namespace common
 
@@ -1,22 +1,287 @@
 #include "maplab-common/file-logger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>  // NOLINT
 #include <iomanip>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace common {
+namespace {
+// Single-producer single-consumer byte ring. The producer is the thread that
+// owns the buffer, the consumer the writer thread.
+class RecordBuffer {
+ public:
+  explicit RecordBuffer(const size_t capacity)
+      : capacity_(capacity), data_(new char[capacity]), head_(0u), tail_(0u) {
+    CHECK_EQ(capacity_ & (capacity_ - 1u), 0u);
+  }
+
+  // Returns false if the record doesn't fit, sets is_half_full if the buffer
+  // became at least half full with this record.
+  bool push(const char* data, const size_t size, bool* is_half_full) {
+    CHECK_NOTNULL(is_half_full);
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t num_used = head - tail_.load(std::memory_order_acquire);
+    if (size > capacity_ - num_used) {
+      return false;
+    }
+    const size_t begin = head & (capacity_ - 1u);
+    const size_t size_until_end = std::min(size, capacity_ - begin);
+    std::memcpy(data_.get() + begin, data, size_until_end);
+    std::memcpy(data_.get(), data + size_until_end, size - size_until_end);
+    head_.store(head + size, std::memory_order_release);
+    *is_half_full =
+        num_used < capacity_ / 2u && num_used + size >= capacity_ / 2u;
+    return true;
+  }
+
+  // Appends all complete records to output.
+  void popAll(std::string* output) {
+    CHECK_NOTNULL(output);
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t size = head_.load(std::memory_order_acquire) - tail;
+    const size_t begin = tail & (capacity_ - 1u);
+    const size_t size_until_end = std::min(size, capacity_ - begin);
+    output->append(data_.get() + begin, size_until_end);
+    output->append(data_.get(), size - size_until_end);
+    tail_.store(tail + size, std::memory_order_release);
+  }
+
+ private:
+  const size_t capacity_;
+  const std::unique_ptr<char[]> data_;
+  // Monotonic byte counts, padded to avoid false sharing between the
+  // producer and the consumer.
+  std::atomic<size_t> head_;
+  char padding_[64u - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;
+};
+
+size_t roundUpToPowerOfTwo(const size_t value) {
+  size_t power_of_two = 1u;
+  while (power_of_two < value) {
+    power_of_two <<= 1u;
+  }
+  return power_of_two;
+}
+
+// The buffers of the calling thread, by the serial number of their writer.
+// Serial numbers are never reused, so entries of destroyed writers are never
+// accessed again. They are erased the next time the thread gets a buffer of a
+// new writer.
+thread_local std::unordered_map<uint64_t, RecordBuffer*> tls_record_buffers;
+
+// The serial numbers of the writers that are alive.
+struct LiveWriters {
+  std::mutex mutex;
+  std::unordered_set<uint64_t> serial_numbers;
+};
+
+LiveWriters& getLiveWriters() {
+  static LiveWriters live_writers;
+  return live_writers;
+}
+}  // namespace
+
+class FileLogger::AsyncWriter {
+ public:
+  AsyncWriter(FileLogger* logger, const AsyncOptions& options)
+      : logger_(CHECK_NOTNULL(logger)),
+        serial_number_(getNextSerialNumber()),
+        buffer_size_bytes_(roundUpToPowerOfTwo(options.buffer_size_bytes)),
+        write_period_(options.write_period_ms),
+        num_dropped_records_(0u),
+        is_stopped_(false),
+        is_write_requested_(false),
+        is_stop_requested_(false),
+        num_flushes_requested_(0u),
+        num_flushes_completed_(0u) {
+    CHECK_GT(options.buffer_size_bytes, 0u);
+    CHECK_GT(options.write_period_ms, 0);
+    {
+      LiveWriters& live_writers = getLiveWriters();
+      std::lock_guard<std::mutex> lock(live_writers.mutex);
+      CHECK(live_writers.serial_numbers.emplace(serial_number_).second);
+    }
+    thread_ = std::thread(&AsyncWriter::run, this);
+  }
+
+  ~AsyncWriter() {
+    stop();
+    LiveWriters& live_writers = getLiveWriters();
+    std::lock_guard<std::mutex> lock(live_writers.mutex);
+    CHECK_EQ(live_writers.serial_numbers.erase(serial_number_), 1u);
+  }
+
+  // Appending concurrently with stop() is not supported, the record may be
+  // lost.
+  void append(const char* data, const size_t size) {
+    // Records appended after the file was closed are rejected, as in
+    // synchronous mode.
+    CHECK(!is_stopped_.load(std::memory_order_acquire))
+        << "Appending a record after the file was closed.";
+    bool is_half_full = false;
+    if (!getThreadBuffer()->push(data, size, &is_half_full)) {
+      num_dropped_records_.fetch_add(1u, std::memory_order_relaxed);
+      is_half_full = true;
+    }
+    if (is_half_full) {
+      // A wakeup that is missed by the writer thread only delays the write
+      // until the next period.
+      is_write_requested_.store(true, std::memory_order_relaxed);
+      cv_state_.notify_one();
+    }
+  }
+
+  void flush() {
+    std::unique_lock<std::mutex> lock(m_state_);
+    if (is_stop_requested_) {
+      return;
+    }
+    const uint64_t flush_request = ++num_flushes_requested_;
+    cv_state_.notify_one();
+    cv_flushed_.wait(lock, [this, flush_request]() {
+      return num_flushes_completed_ >= flush_request;
+    });
+  }
+
+  // Writes all pending records and joins the writer thread.
+  void stop() {
+    is_stopped_.store(true, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(m_state_);
+      is_stop_requested_ = true;
+    }
+    cv_state_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  size_t getNumDroppedRecords() const {
+    return num_dropped_records_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static uint64_t getNextSerialNumber() {
+    static std::atomic<uint64_t> next_serial_number(0u);
+    return next_serial_number++;
+  }
+
+  RecordBuffer* getThreadBuffer() {
+    const std::unordered_map<uint64_t, RecordBuffer*>::const_iterator it =
+        tls_record_buffers.find(serial_number_);
+    if (it != tls_record_buffers.end()) {
+      return it->second;
+    }
+    eraseBuffersOfDestroyedWriters();
+    std::lock_guard<std::mutex> lock(m_buffers_);
+    buffers_.emplace_back(new RecordBuffer(buffer_size_bytes_));
+    RecordBuffer* buffer = buffers_.back().get();
+    tls_record_buffers.emplace(serial_number_, buffer);
+    return buffer;
+  }
+
+  // Erases the entries of the calling thread that belong to destroyed writers.
+  static void eraseBuffersOfDestroyedWriters() {
+    LiveWriters& live_writers = getLiveWriters();
+    std::lock_guard<std::mutex> lock(live_writers.mutex);
+    std::unordered_map<uint64_t, RecordBuffer*>::iterator it =
+        tls_record_buffers.begin();
+    while (it != tls_record_buffers.end()) {
+      if (live_writers.serial_numbers.count(it->first) == 0u) {
+        it = tls_record_buffers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void run() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(m_state_);
+    while (true) {
+      cv_state_.wait_for(lock, write_period_, [this]() {
+        return is_stop_requested_ ||
+               num_flushes_requested_ > num_flushes_completed_ ||
+               is_write_requested_.load(std::memory_order_relaxed);
+      });
+      is_write_requested_.store(false, std::memory_order_relaxed);
+      const bool is_stop_requested = is_stop_requested_;
+      const uint64_t num_flushes_requested = num_flushes_requested_;
+      const bool is_flush_requested =
+          is_stop_requested ||
+          num_flushes_requested > num_flushes_completed_;
+      lock.unlock();
+
+      batch.clear();
+      {
+        std::lock_guard<std::mutex> buffers_lock(m_buffers_);
+        for (const std::unique_ptr<RecordBuffer>& buffer : buffers_) {
+          buffer->popAll(&batch);
+        }
+      }
+      {
+        std::lock_guard<std::recursive_mutex> file_lock(logger_->mutex_);
+        if (logger_->isOpen()) {
+          logger_->file_handle_->write(batch.data(), batch.size());
+          if (is_flush_requested) {
+            logger_->file_handle_->flush();
+          }
+        }
+      }
+
+      lock.lock();
+      num_flushes_completed_ = num_flushes_requested;
+      cv_flushed_.notify_all();
+      if (is_stop_requested) {
+        return;
+      }
+    }
+  }
+
+  FileLogger* const logger_;
+  const uint64_t serial_number_;
+  const size_t buffer_size_bytes_;
+  const std::chrono::milliseconds write_period_;
+  std::atomic<size_t> num_dropped_records_;
+  std::atomic<bool> is_stopped_;
+
+  std::mutex m_buffers_;
+  std::vector<std::unique_ptr<RecordBuffer>> buffers_;
+
+  std::mutex m_state_;
+  std::condition_variable cv_state_;
+  std::condition_variable cv_flushed_;
+  std::atomic<bool> is_write_requested_;
+  bool is_stop_requested_;
+  uint64_t num_flushes_requested_;
+  uint64_t num_flushes_completed_;
+
+  std::thread thread_;
+};
+
 FileLogger::FileLogger(std::string const& filename) {
-  file_handle_.reset(new std::ofstream);
-  file_handle_->open(filename, std::ofstream::out | std::ofstream::trunc);
+  openFile(filename);
+}
 
-  if (!file_handle_->is_open()) {
-    LOG(ERROR) << "Could not open: " << filename;
-    file_handle_.reset();
-    return;
+FileLogger::FileLogger(
+    const std::string& filename, const AsyncOptions& options) {
+  openFile(filename);
+  if (file_handle_ != nullptr) {
+    async_writer_.reset(new AsyncWriter(this, options));
   }
-  file_handle_->precision(std::numeric_limits<double>::digits10);
 }
 
 FileLogger::~FileLogger() {
@@ -26,7 +291,22 @@ FileLogger::~FileLogger() {
   }
 }
 
+void FileLogger::openFile(const std::string& filename) {
+  file_handle_.reset(new std::ofstream);
+  file_handle_->open(filename, std::ofstream::out | std::ofstream::trunc);
+
+  if (!file_handle_->is_open()) {
+    LOG(ERROR) << "Could not open: " << filename;
+    file_handle_.reset();
+    return;
+  }
+  file_handle_->precision(std::numeric_limits<double>::digits10);
+}
+
 void FileLogger::closeFile() const {
+  if (async_writer_ != nullptr) {
+    async_writer_->stop();
+  }
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   CHECK(isOpen());
   file_handle_->flush();
@@ -34,6 +314,10 @@ void FileLogger::closeFile() const {
 }
 
 void FileLogger::flushBuffer() {
+  if (async_writer_ != nullptr) {
+    // Must not hold the lock, the writer thread needs it.
+    async_writer_->flush();
+  }
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   CHECK(isOpen());
   file_handle_->flush();
@@ -47,6 +331,24 @@ bool FileLogger::isOpen() const {
   return file_handle_->is_open() && file_handle_->good();
 }
 
+void FileLogger::appendRecord(const char* data, const size_t size) const {
+  CHECK(size == 0u || data != nullptr);
+  if (async_writer_ != nullptr) {
+    async_writer_->append(data, size);
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  CHECK(isOpen());
+  file_handle_->write(data, size);
+}
+
+void FileLogger::appendRecord(const std::string& record) const {
+  appendRecord(record.data(), record.size());
+}
+
+size_t FileLogger::getNumDroppedRecords() const {
+  return async_writer_ != nullptr ? async_writer_->getNumDroppedRecords() : 0u;
+}
 
 const FileLogger& FileLogger::operator<<(
     std::ostream& (*object)(std::ostream&)) const {
@@ -6,6 +6,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 
 #include <algorithm>
 #include <cstring>
@@ -551,6 +555,142 @@ bool copyFile(
   return true;
 }
 
+namespace {
+// Returns the number of bytes copied, -1 if the copy failed and the fallbacks
+// should be tried.
+int64_t copyFileContentInKernel(
+    const int source_filedescriptor, const int destination_filedescriptor,
+    const int64_t num_bytes) {
+#ifdef __linux__
+  int64_t num_bytes_copied = 0;
+#ifdef SYS_copy_file_range
+  while (num_bytes_copied < num_bytes) {
+    const ssize_t result = syscall(
+        SYS_copy_file_range, source_filedescriptor, nullptr,
+        destination_filedescriptor, nullptr,
+        static_cast<size_t>(num_bytes - num_bytes_copied), 0u);
+    if (result <= 0) {
+      break;
+    }
+    num_bytes_copied += result;
+  }
+  if (num_bytes_copied == num_bytes) {
+    return num_bytes_copied;
+  }
+#endif
+  // E.g. copy_file_range is not supported across file systems by older
+  // kernels, continue where it stopped.
+  while (num_bytes_copied < num_bytes) {
+    const ssize_t result = sendfile(
+        destination_filedescriptor, source_filedescriptor, nullptr,
+        static_cast<size_t>(num_bytes - num_bytes_copied));
+    if (result <= 0) {
+      return num_bytes_copied == 0 ? -1 : num_bytes_copied;
+    }
+    num_bytes_copied += result;
+  }
+  return num_bytes_copied;
+#else
+  static_cast<void>(source_filedescriptor);
+  static_cast<void>(destination_filedescriptor);
+  static_cast<void>(num_bytes);
+  return -1;
+#endif
+}
+}  // namespace
+
+bool transferFile(
+    const std::string& source, const std::string& destination,
+    bool try_hardlink) {
+  CHECK(!source.empty());
+  CHECK(!destination.empty());
+  if (try_hardlink && link(source.c_str(), destination.c_str()) == 0) {
+    VLOG(3) << "Linked file " << source << " to " << destination << '.';
+    return true;
+  }
+
+  const int source_filedescriptor = open(source.c_str(), O_RDONLY, 0);
+  if (source_filedescriptor < 0) {
+    LOG(ERROR) << "Unable to open source file " << source;
+    return false;
+  }
+  struct stat source_status;
+  if (fstat(source_filedescriptor, &source_status) != 0) {
+    LOG(ERROR) << "Unable to read the size of source file " << source;
+    close(source_filedescriptor);
+    return false;
+  }
+  const int destination_filedescriptor = open(
+      destination.c_str(), O_WRONLY | O_CREAT | O_EXCL,
+      source_status.st_mode & 0777);
+  if (destination_filedescriptor < 0) {
+    LOG(ERROR) << "Unable to create destination file " << destination << ": "
+               << strerror(errno);
+    close(source_filedescriptor);
+    return false;
+  }
+
+  const int64_t num_bytes = source_status.st_size;
+  int64_t num_bytes_copied = copyFileContentInKernel(
+      source_filedescriptor, destination_filedescriptor, num_bytes);
+  if (num_bytes_copied < 0) {
+    num_bytes_copied = 0;
+  }
+  if (num_bytes_copied < num_bytes) {
+    // Not supported by the platform or the file systems.
+    char buffer[BUFSIZ];
+    ssize_t size;
+    while ((size = read(source_filedescriptor, buffer, BUFSIZ)) > 0) {
+      if (write(destination_filedescriptor, buffer, size) != size) {
+        break;
+      }
+      num_bytes_copied += size;
+    }
+  }
+
+  close(source_filedescriptor);
+  const bool success =
+      close(destination_filedescriptor) == 0 && num_bytes_copied == num_bytes;
+  if (!success) {
+    LOG(ERROR) << "Failed to copy file " << source << " to " << destination
+               << '.';
+    remove(destination.c_str());
+    return false;
+  }
+  VLOG(3) << "Successfully copied file " << source << " to " << destination
+          << '.';
+  return true;
+}
+
+bool moveFile(const std::string& source, const std::string& destination) {
+  CHECK(!source.empty());
+  CHECK(!destination.empty());
+  if (fileExists(destination)) {
+    LOG(ERROR) << "Cannot move " << source << ", the destination file "
+               << destination << " already exists.";
+    return false;
+  }
+  if (rename(source.c_str(), destination.c_str()) == 0) {
+    return true;
+  }
+  if (errno != EXDEV) {
+    LOG(ERROR) << "Unable to move file " << source << " to " << destination
+               << ": " << strerror(errno);
+    return false;
+  }
+  constexpr bool kTryHardlink = false;
+  return transferFile(source, destination, kTryHardlink) &&
+         deleteFile(source);
+}
+
+int64_t getFileSize(const std::string& file_path) {
+  struct stat file_status;
+  if (stat(file_path.c_str(), &file_status) != 0) {
+    return -1;
+  }
+  return file_status.st_size;
+}
+
 bool isSameRealPath(
     const std::string& real_path_A, const std::string& real_path_B) {
   CHECK(!real_path_A.empty());
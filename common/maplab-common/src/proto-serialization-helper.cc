@@ -1,8 +1,22 @@
 #include "maplab-common/proto-serialization-helper.h"
 
-#include <fstream>  // NOLINT
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>  // NOLINT
+#include <fstream>             // NOLINT
+#include <limits>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/gzip_stream.h>
@@ -11,6 +25,8 @@
 #include <google/protobuf/text_format.h>
 
 #include "maplab-common/file-system-tools.h"
+#include "maplab-common/parallel-process.h"
+#include "maplab-common/threading-helpers.h"
 
 DEFINE_int32(
     proto_max_size_megabytes, 256,
@@ -22,8 +38,152 @@ DEFINE_bool(
     "If enabled, the protobufs will be compressed when storing and "
     "decompressed when loading.");
 
+DEFINE_bool(
+    proto_parse_with_mmap, false,
+    "Map binary proto files into memory as a whole and parse them from the "
+    "mapping instead of reading them through a file stream.");
+
+DEFINE_int32(
+    proto_num_io_threads, 8,
+    "Number of I/O threads that fetch the files for the batched proto "
+    "parsing. Files are fetched concurrently to hide the latency of network "
+    "storage.");
+
+DEFINE_int32(
+    proto_read_ahead_files, 16,
+    "Maximum number of files the batched proto parsing reads ahead of the "
+    "files that are being parsed.");
+
 namespace common {
 namespace proto_serialization_helper {
+namespace {
+
+int getMaxProtoSizeBytes() {
+  CHECK_GT(FLAGS_proto_max_size_megabytes, 0);
+  constexpr int kProtobufHardLimitMegabytes = 2000;
+  CHECK_LT(FLAGS_proto_max_size_megabytes, kProtobufHardLimitMegabytes);
+  constexpr int kMegabytesToBytes = 1e6;
+  return kMegabytesToBytes * FLAGS_proto_max_size_megabytes;
+}
+
+// Reads the whole file into memory.
+bool readFile(const std::string& file_path, std::string* content) {
+  CHECK_NOTNULL(content)->clear();
+  const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor, &file_stat) != 0) {
+    close(file_descriptor);
+    return false;
+  }
+  posix_fadvise(file_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+  content->resize(static_cast<size_t>(file_stat.st_size));
+  size_t offset = 0u;
+  while (offset < content->size()) {
+    const ssize_t num_bytes_read = read(
+        file_descriptor, &(*content)[offset], content->size() - offset);
+    if (num_bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_bytes_read <= 0) {
+      close(file_descriptor);
+      return false;
+    }
+    offset += static_cast<size_t>(num_bytes_read);
+  }
+  close(file_descriptor);
+  return true;
+}
+
+// Parses the whole file through a read-only memory mapping.
+bool parseProtoFromMappedFile(
+    const std::string& file_path, google::protobuf::Message* proto) {
+  CHECK_NOTNULL(proto);
+  const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    LOG(ERROR) << "Could not open file \"" << file_path << "\"!";
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor, &file_stat) != 0) {
+    close(file_descriptor);
+    return false;
+  }
+  const size_t num_bytes = static_cast<size_t>(file_stat.st_size);
+  if (num_bytes == 0u) {
+    close(file_descriptor);
+    return parseProtoFromFileContent(nullptr, 0u, proto);
+  }
+  void* data =
+      mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map " << file_path;
+    return false;
+  }
+  madvise(data, num_bytes, MADV_SEQUENTIAL);
+  const bool success = parseProtoFromFileContent(data, num_bytes, proto);
+  munmap(data, num_bytes);
+  return success;
+}
+
+// Folds all bytes written to it into a 64 bit FNV-1a hash.
+class FingerprintOutputStream
+    : public google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  FingerprintOutputStream()
+      : fingerprint_(kFnvOffsetBasis),
+        num_pending_bytes_(0),
+        num_consumed_bytes_(0) {}
+
+  bool Next(void** data, int* size) override {
+    CHECK_NOTNULL(data);
+    CHECK_NOTNULL(size);
+    consumePendingBytes();
+    *data = buffer_;
+    *size = kBufferSize;
+    num_pending_bytes_ = kBufferSize;
+    return true;
+  }
+
+  void BackUp(int count) override {
+    CHECK_GE(count, 0);
+    CHECK_LE(count, num_pending_bytes_);
+    num_pending_bytes_ -= count;
+  }
+
+  google::protobuf::int64 ByteCount() const override {
+    return num_consumed_bytes_ + num_pending_bytes_;
+  }
+
+  uint64_t getFingerprint() {
+    consumePendingBytes();
+    return fingerprint_;
+  }
+
+ private:
+  void consumePendingBytes() {
+    for (int i = 0; i < num_pending_bytes_; ++i) {
+      fingerprint_ ^= buffer_[i];
+      fingerprint_ *= kFnvPrime;
+    }
+    num_consumed_bytes_ += num_pending_bytes_;
+    num_pending_bytes_ = 0;
+  }
+
+  static constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+  static constexpr uint64_t kFnvPrime = 1099511628211ull;
+  static constexpr int kBufferSize = 64 * 1024;
+
+  uint8_t buffer_[kBufferSize];
+  uint64_t fingerprint_;
+  int num_pending_bytes_;
+  google::protobuf::int64 num_consumed_bytes_;
+};
+
+}  // namespace
 
 bool parseProtoFromFile(
     const std::string& folder_path, const std::string& file_name,
@@ -43,6 +203,15 @@ bool parseProtoFromFile(
   common::concatenateFolderAndFileName(
       folder_path, file_name, &complete_file_path);
 
+  if (FLAGS_proto_parse_with_mmap && !is_text_format) {
+    if (!parseProtoFromMappedFile(complete_file_path, proto)) {
+      LOG(ERROR) << "Error parsing file \"" << complete_file_path
+                 << "\" in protobuf.";
+      return false;
+    }
+    return true;
+  }
+
   std::ifstream file_stream(complete_file_path);
   if (!file_stream.is_open()) {
     LOG(ERROR) << "Could not open file \"" << complete_file_path << "\"!";
@@ -56,12 +225,7 @@ bool parseProtoFromFile(
     proto_parse_successful =
         google::protobuf::TextFormat::Parse(&proto_istream_input_stream, proto);
   } else {
-    CHECK_GT(FLAGS_proto_max_size_megabytes, 0);
-    constexpr int kProtobufHardLimitMegabytes = 2000;
-    CHECK_LT(FLAGS_proto_max_size_megabytes, kProtobufHardLimitMegabytes);
-    constexpr int kMegabytesToBytes = 1e6;
-    const int max_proto_size_bytes =
-        kMegabytesToBytes * FLAGS_proto_max_size_megabytes;
+    const int max_proto_size_bytes = getMaxProtoSizeBytes();
     if (FLAGS_proto_use_compression) {
       google::protobuf::io::IstreamInputStream proto_istream_input_stream(
           &file_stream);
@@ -88,6 +252,160 @@ bool parseProtoFromFile(
   return true;
 }
 
+bool parseProtoFromFileContent(
+    const void* data, const size_t num_bytes,
+    google::protobuf::Message* proto) {
+  CHECK_NOTNULL(proto);
+  CHECK(data != nullptr || num_bytes == 0u);
+  CHECK_LE(num_bytes, static_cast<size_t>(std::numeric_limits<int>::max()));
+  const int max_proto_size_bytes = getMaxProtoSizeBytes();
+  google::protobuf::io::ArrayInputStream array_input_stream(
+      data, static_cast<int>(num_bytes));
+  if (FLAGS_proto_use_compression) {
+    google::protobuf::io::GzipInputStream gzip_input_stream(
+        &array_input_stream);
+    google::protobuf::io::CodedInputStream coded_input_stream(
+        &gzip_input_stream);
+    coded_input_stream.SetTotalBytesLimit(
+        max_proto_size_bytes, max_proto_size_bytes);
+    return proto->ParseFromCodedStream(&coded_input_stream);
+  }
+  google::protobuf::io::CodedInputStream coded_input_stream(
+      &array_input_stream);
+  coded_input_stream.SetTotalBytesLimit(
+      max_proto_size_bytes, max_proto_size_bytes);
+  return proto->ParseFromCodedStream(&coded_input_stream);
+}
+
+bool processFilesWithReadAhead(
+    const std::string& folder_path, const std::vector<std::string>& file_names,
+    const std::function<bool(const size_t, const std::string&)>& function,
+    const size_t num_parse_threads) {
+  CHECK(!folder_path.empty());
+  CHECK(function);
+  CHECK_GT(num_parse_threads, 0u);
+  CHECK_GT(FLAGS_proto_num_io_threads, 0);
+  CHECK_GT(FLAGS_proto_read_ahead_files, 0);
+  const size_t num_files = file_names.size();
+  if (num_files == 0u) {
+    return true;
+  }
+  const size_t max_files_ahead =
+      static_cast<size_t>(FLAGS_proto_read_ahead_files);
+
+  // The files are read and processed in the order of their indices. A file
+  // is only read if it is at most max_files_ahead files ahead of the next
+  // file to process, which bounds the memory held by files read in advance.
+  std::mutex mutex;
+  std::condition_variable file_read_condition;
+  std::condition_variable read_window_condition;
+  std::vector<std::string> contents(num_files);
+  std::vector<bool> is_read(num_files, false);
+  size_t next_file_to_read = 0u;
+  size_t next_file_to_process = 0u;
+  bool success = true;
+
+  auto read_files = [&]() {
+    while (true) {
+      size_t file_index;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        read_window_condition.wait(lock, [&]() {
+          return !success || next_file_to_read >= num_files ||
+                 next_file_to_read < next_file_to_process + max_files_ahead;
+        });
+        if (!success || next_file_to_read >= num_files) {
+          return;
+        }
+        file_index = next_file_to_read++;
+      }
+      std::string content;
+      const std::string file_path = common::concatenateFolderAndFileName(
+          folder_path, file_names[file_index]);
+      const bool is_read_successful = readFile(file_path, &content);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!is_read_successful) {
+          LOG(ERROR) << "Could not read file \"" << file_path << "\"!";
+          success = false;
+        }
+        contents[file_index].swap(content);
+        is_read[file_index] = true;
+      }
+      file_read_condition.notify_all();
+      read_window_condition.notify_all();
+    }
+  };
+
+  // The parse threads claim the files in order, such that every claimed file
+  // is within the read window.
+  auto process_files = [&](const std::vector<size_t>& /*range*/) {
+    while (true) {
+      size_t file_index;
+      std::string content;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!success || next_file_to_process >= num_files) {
+          return;
+        }
+        file_index = next_file_to_process++;
+        read_window_condition.notify_all();
+        file_read_condition.wait(
+            lock, [&]() { return !success || is_read[file_index]; });
+        if (!success) {
+          return;
+        }
+        content.swap(contents[file_index]);
+      }
+      if (!function(file_index, content)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        success = false;
+        file_read_condition.notify_all();
+        read_window_condition.notify_all();
+        return;
+      }
+    }
+  };
+
+  const size_t num_io_threads = std::min(
+      num_files, static_cast<size_t>(FLAGS_proto_num_io_threads));
+  std::vector<std::thread> io_threads;
+  io_threads.reserve(num_io_threads);
+  for (size_t i = 0u; i < num_io_threads; ++i) {
+    io_threads.emplace_back(read_files);
+  }
+  constexpr bool kAlwaysParallelize = true;
+  const size_t num_parse_tasks = std::min(num_files, num_parse_threads);
+  common::ParallelProcess(
+      num_parse_tasks, process_files, kAlwaysParallelize, num_parse_tasks);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    read_window_condition.notify_all();
+  }
+  for (std::thread& io_thread : io_threads) {
+    io_thread.join();
+  }
+  return success;
+}
+
+bool parseProtosFromFiles(
+    const std::string& folder_path, const std::vector<std::string>& file_names,
+    const std::vector<google::protobuf::Message*>& protos) {
+  CHECK_EQ(file_names.size(), protos.size());
+  return processFilesWithReadAhead(
+      folder_path, file_names,
+      [&](const size_t file_index, const std::string& content) -> bool {
+        google::protobuf::Message* proto = CHECK_NOTNULL(protos[file_index]);
+        if (!parseProtoFromFileContent(content.data(), content.size(), proto)) {
+          LOG(ERROR) << "Error parsing file \"" << file_names[file_index]
+                     << "\" in \"" << folder_path << "\" in protobuf.";
+          return false;
+        }
+        return true;
+      },
+      common::getNumHardwareThreads());
+}
+
 bool serializeProtoToFile(
     const std::string& folder_path, const std::string& file_name,
     const google::protobuf::Message& proto) {
@@ -138,6 +456,63 @@ bool serializeProtoToFile(
   return true;
 }
 
+bool serializeToFile(
+    const std::string& folder_path, const std::string& file_name,
+    const std::function<bool(google::protobuf::io::ZeroCopyOutputStream*)>&
+        write_function,
+    const int compression_level) {
+  CHECK(!folder_path.empty());
+  CHECK(!file_name.empty());
+  CHECK(write_function);
+  std::string complete_file_path;
+  common::concatenateFolderAndFileName(
+      folder_path, file_name, &complete_file_path);
+
+  std::ofstream file_stream(
+      complete_file_path, std::ofstream::out | std::ofstream::binary);
+  if (!file_stream.is_open()) {
+    LOG(ERROR) << "Error writing to file\"" << complete_file_path << "\".";
+    return false;
+  }
+
+  bool serialization_successful = false;
+  {
+    google::protobuf::io::OstreamOutputStream proto_ostream_output_stream(
+        &file_stream);
+    if (FLAGS_proto_use_compression) {
+      google::protobuf::io::GzipOutputStream::Options options;
+      options.compression_level = compression_level;
+      google::protobuf::io::GzipOutputStream proto_gzip_output_stream(
+          &proto_ostream_output_stream, options);
+      serialization_successful = write_function(&proto_gzip_output_stream) &&
+                                 proto_gzip_output_stream.Close();
+    } else {
+      serialization_successful = write_function(&proto_ostream_output_stream);
+    }
+  }
+  file_stream.close();
+  if (!serialization_successful || file_stream.fail()) {
+    LOG(ERROR) << "Error writing to file\"" << complete_file_path << "\".";
+    return false;
+  }
+  return true;
+}
+
+bool computeFingerprint(
+    const std::function<bool(google::protobuf::io::ZeroCopyOutputStream*)>&
+        write_function,
+    uint64_t* fingerprint) {
+  CHECK(write_function);
+  CHECK_NOTNULL(fingerprint);
+  std::unique_ptr<FingerprintOutputStream> fingerprint_stream(
+      new FingerprintOutputStream);
+  if (!write_function(fingerprint_stream.get())) {
+    return false;
+  }
+  *fingerprint = fingerprint_stream->getFingerprint();
+  return true;
+}
+
 void serializeToArray(
     const google::protobuf::Message& proto, void** raw_data,
     size_t* data_length_bytes) {
@@ -2,6 +2,7 @@
 
 #include "maplab-common/file-system-tools.h"
 
+#include <cstring>
 #include <vector>
 #include <glog/logging.h>
 #include <Python.h>
@@ -29,6 +30,7 @@ struct ScopedPyObject {
     CHECK(this != &other);
     obj = other.obj;
     Py_INCREF(obj);
+    return *this;
   }
 
   operator bool() const {
@@ -43,16 +45,110 @@ struct ScopedPyObject {
   PyObject* obj;
 };
 
+struct PythonThreadState {
+  PyThreadState* state = nullptr;
+};
+
+namespace {
+// Holds the global interpreter lock during its lifetime.
+class ScopedGilLock {
+ public:
+  ScopedGilLock() : state_(PyGILState_Ensure()) {}
+  ~ScopedGilLock() {
+    PyGILState_Release(state_);
+  }
+
+ private:
+  PyGILState_STATE state_;
+};
+
+// Python 2 memoryviews point to the shape and strides of the buffer instead
+// of copying them, hence they have to outlive the call.
+struct PythonBufferLayout {
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+};
+
+PyObject* createMemoryView(
+    const PythonArrayView& view, PythonBufferLayout* layout) {
+  CHECK_NOTNULL(layout);
+  CHECK_NOTNULL(view.data());
+  layout->shape[0] = view.rows();
+  layout->shape[1] = view.cols();
+  layout->strides[0] = view.rowStride() * view.itemSize();
+  layout->strides[1] = view.colStride() * view.itemSize();
+
+  Py_buffer buffer;
+  std::memset(&buffer, 0, sizeof(buffer));
+  buffer.buf = view.data();
+  buffer.itemsize = view.itemSize();
+  buffer.len = view.rows() * view.cols() * view.itemSize();
+  buffer.readonly = view.isWritable() ? 0 : 1;
+  buffer.format = const_cast<char*>(view.format());
+  buffer.ndim = view.cols() == 1u ? 1 : 2;
+  buffer.shape = layout->shape;
+  buffer.strides = layout->strides;
+  return PyMemoryView_FromBuffer(&buffer);
+}
+
+// Requires the interpreter lock.
+bool callWithArrayViews(
+    const std::string& function_name, PyObject* function,
+    const std::vector<PythonArrayView>& arguments) {
+  CHECK_NOTNULL(function);
+  std::vector<PythonBufferLayout> layouts(arguments.size());
+  std::vector<PyObject*> views(arguments.size());
+  ScopedPyObject args(PyTuple_New(arguments.size()));
+  for (size_t i = 0u; i < arguments.size(); ++i) {
+    views[i] = CHECK_NOTNULL(createMemoryView(arguments[i], &layouts[i]));
+    // The tuple steals one reference, the other one is released below.
+    Py_INCREF(views[i]);
+    PyTuple_SetItem(args.obj, i, views[i]);
+  }
+
+  ScopedPyObject retval;
+  retval.obj = PyObject_CallObject(function, args.obj);
+  const bool success = retval;
+  if (!success) {
+    PyErr_Print();
+    LOG(WARNING) << "Call to function failed: " << function_name;
+  }
+
+  for (PyObject* view : views) {
+#if PY_MAJOR_VERSION >= 3
+    // Invalidates the views that the script may have kept.
+    PyObject* result = PyObject_CallMethod(view, "release", nullptr);
+    if (result == nullptr) {
+      PyErr_Clear();
+      LOG(ERROR) << "Function " << function_name << " keeps a reference to "
+                 << "one of its array arguments, which is only valid during "
+                 << "the call.";
+    }
+    Py_XDECREF(result);
+#endif
+    Py_DECREF(view);
+  }
+  return success;
+}
+}  // namespace
+
 PythonInterface::PythonInterface(const std::string& python_script)
-    : python_module_(new ScopedPyObject) {
+    : python_module_(new ScopedPyObject),
+      main_thread_state_(new PythonThreadState) {
   CHECK(!python_script.empty());
 
   Py_Initialize();
+#if PY_VERSION_HEX < 0x03070000
+  PyEval_InitThreads();
+#endif
   CHECK(loadModule(python_script)) << "Could not load python module from: "
                                    << python_script;
+  // Only hold the interpreter lock while running Python code.
+  main_thread_state_->state = PyEval_SaveThread();
 }
 
 PythonInterface::~PythonInterface() {
+  PyEval_RestoreThread(main_thread_state_->state);
   unloadModule();
   Py_Finalize();
 }
@@ -103,6 +199,7 @@ bool PythonInterface::callFunction(
   CHECK_NOTNULL(output)->clear();
   CHECK(!function_name.empty());
 
+  ScopedGilLock gil_lock;
   // Get the function handle.
   std::unique_ptr<ScopedPyObject> function_handle(
       getFunctionHandle(function_name));
@@ -118,6 +215,8 @@ bool PythonInterface::callFunction(
   }
   ScopedPyObject args(PyTuple_New(1));
   CHECK(args);
+  // The tuple steals the reference, py_list releases its own.
+  Py_INCREF(py_list.obj);
   PyTuple_SetItem(args.obj, 0, py_list.obj);
 
   // Call the function.
@@ -141,4 +240,27 @@ bool PythonInterface::callFunction(
   return true;
 }
 
+bool PythonInterface::callFunction(
+    const std::string& function_name,
+    const std::vector<PythonArrayView>& arguments) {
+  return callFunctionBatch(
+      function_name, std::vector<std::vector<PythonArrayView>>(1u, arguments));
+}
+
+bool PythonInterface::callFunctionBatch(
+    const std::string& function_name,
+    const std::vector<std::vector<PythonArrayView>>& argument_batches) {
+  CHECK(!function_name.empty());
+  ScopedGilLock gil_lock;
+  std::unique_ptr<ScopedPyObject> function_handle(
+      getFunctionHandle(function_name));
+  CHECK(function_handle && *function_handle);
+  for (const std::vector<PythonArrayView>& arguments : argument_batches) {
+    if (!callWithArrayViews(function_name, function_handle->obj, arguments)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace common
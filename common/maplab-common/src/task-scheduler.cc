@@ -0,0 +1,214 @@
+#include "maplab-common/task-scheduler.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "maplab-common/thread-topology.h"
+#include "maplab-common/threading-helpers.h"
+
+namespace common {
+namespace {
+// Identifies the scheduler and deque of the current worker thread.
+thread_local const TaskScheduler* tls_scheduler = nullptr;
+thread_local size_t tls_worker_index = 0u;
+
+// Number of chunks per thread targeted by the automatic grain size.
+constexpr size_t kNumChunksPerThread = 4u;
+}  // namespace
+
+constexpr TaskScheduler::TaskGroup TaskScheduler::kAnyTaskGroup;
+
+TaskScheduler::TaskScheduler(size_t num_workers)
+    : TaskScheduler(num_workers, CpuList()) {}
+
+TaskScheduler::TaskScheduler(size_t num_workers, const CpuList& worker_cpus)
+    : next_round_robin_deque_(0u),
+      num_pending_tasks_(0u),
+      shutdown_requested_(false) {
+  CHECK_GT(num_workers, 0u);
+  deques_.reserve(num_workers);
+  for (size_t worker_idx = 0u; worker_idx < num_workers; ++worker_idx) {
+    deques_.emplace_back(new WorkerDeque);
+  }
+  workers_.reserve(num_workers);
+  for (size_t worker_idx = 0u; worker_idx < num_workers; ++worker_idx) {
+    workers_.emplace_back(
+        &TaskScheduler::workerLoop, this, worker_idx, worker_cpus);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+    shutdown_requested_ = true;
+  }
+  cv_tasks_available_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+TaskScheduler& TaskScheduler::instance() {
+  static TaskScheduler scheduler(getNumHardwareThreads());
+  return scheduler;
+}
+
+TaskScheduler& TaskScheduler::instanceForNumaNode(size_t numa_node_index) {
+  static std::vector<std::unique_ptr<TaskScheduler>> schedulers;
+  static std::once_flag schedulers_created;
+  std::call_once(schedulers_created, []() {
+    const ThreadTopology& topology = ThreadTopology::instance();
+    for (size_t node_idx = 0u; node_idx < topology.getNumNumaNodes();
+         ++node_idx) {
+      const CpuList& node_cpus = topology.getNumaNodeCpus(node_idx);
+      schedulers.emplace_back(new TaskScheduler(
+          std::max<size_t>(1u, node_cpus.size()), node_cpus));
+    }
+  });
+  CHECK_LT(numa_node_index, schedulers.size());
+  return *schedulers[numa_node_index];
+}
+
+void TaskScheduler::runAndWait(const std::vector<Task>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  struct CompletionState {
+    explicit CompletionState(size_t num_tasks) : num_remaining(num_tasks) {}
+    std::mutex m_completion;
+    std::condition_variable cv_completion;
+    size_t num_remaining;
+  };
+  CompletionState completion_state(tasks.size());
+  const auto run_and_signal = [&completion_state](const Task& task) {
+    task();
+    std::lock_guard<std::mutex> lock(completion_state.m_completion);
+    CHECK_GT(completion_state.num_remaining, 0u);
+    if (--completion_state.num_remaining == 0u) {
+      completion_state.cv_completion.notify_all();
+    }
+  };
+
+  // Keep the first task for the calling thread.
+  const TaskGroup group = &completion_state;
+  for (size_t task_idx = 1u; task_idx < tasks.size(); ++task_idx) {
+    const Task& task = tasks[task_idx];
+    CHECK(task);
+    submit([&run_and_signal, &task]() { run_and_signal(task); }, group);
+  }
+  CHECK(tasks.front());
+  run_and_signal(tasks.front());
+
+  // Run our tasks that no worker has picked up yet. Tasks of other callers
+  // are left to the workers: they might block on a lock we hold, and waiting
+  // callers that only run their own tasks always make progress, even if all
+  // workers are waiting on nested calls.
+  while (tryRunPendingTask(group)) {
+  }
+  // None of our tasks is queued anymore, the remaining ones are running.
+  std::unique_lock<std::mutex> lock(completion_state.m_completion);
+  completion_state.cv_completion.wait(
+      lock,
+      [&completion_state]() { return completion_state.num_remaining == 0u; });
+}
+
+size_t TaskScheduler::getGrainSize(
+    size_t num_items, size_t requested_grain_size) const {
+  if (requested_grain_size != kAutomaticGrainSize) {
+    return requested_grain_size;
+  }
+  const size_t num_target_chunks = kNumChunksPerThread * (getNumWorkers() + 1u);
+  return std::max<size_t>(1u, num_items / num_target_chunks);
+}
+
+void TaskScheduler::submit(const Task& task, TaskGroup group) {
+  // Tasks submitted by a worker go to its own deque to keep the data hot in
+  // its cache; other threads distribute the tasks round-robin.
+  const size_t deque_index =
+      (tls_scheduler == this)
+          ? tls_worker_index
+          : next_round_robin_deque_.fetch_add(1u) % deques_.size();
+  {
+    WorkerDeque& worker_deque = *deques_[deque_index];
+    std::lock_guard<std::mutex> lock(worker_deque.m_tasks);
+    worker_deque.tasks.emplace_back(QueuedTask{task, group});
+    ++num_pending_tasks_;
+  }
+  {
+    // Synchronize with the predicate check of sleeping workers.
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+  }
+  cv_tasks_available_.notify_one();
+}
+
+bool TaskScheduler::tryRunPendingTask(TaskGroup group) {
+  if (num_pending_tasks_.load() == 0u) {
+    return false;
+  }
+  const bool is_worker = tls_scheduler == this;
+  const size_t first_index = is_worker ? tls_worker_index : 0u;
+  const size_t num_deques = deques_.size();
+
+  Task task;
+  for (size_t offset = 0u; offset < num_deques && !task; ++offset) {
+    const size_t deque_index = (first_index + offset) % num_deques;
+    WorkerDeque& worker_deque = *deques_[deque_index];
+    std::lock_guard<std::mutex> lock(worker_deque.m_tasks);
+    if (worker_deque.tasks.empty()) {
+      continue;
+    }
+    if (group != kAnyTaskGroup) {
+      // Our tasks are mostly at the back of our own deque, but might have
+      // been distributed to any deque.
+      for (std::deque<QueuedTask>::iterator it = worker_deque.tasks.begin();
+           it != worker_deque.tasks.end(); ++it) {
+        if (it->group == group) {
+          task = std::move(it->task);
+          worker_deque.tasks.erase(it);
+          break;
+        }
+      }
+      if (!task) {
+        continue;
+      }
+    } else if (is_worker && offset == 0u) {
+      task = std::move(worker_deque.tasks.back().task);
+      worker_deque.tasks.pop_back();
+    } else {
+      task = std::move(worker_deque.tasks.front().task);
+      worker_deque.tasks.pop_front();
+    }
+    --num_pending_tasks_;
+  }
+  if (!task) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+void TaskScheduler::workerLoop(
+    size_t worker_index, const CpuList& worker_cpus) {
+  setCurrentThreadAffinity(worker_cpus);
+  tls_scheduler = this;
+  tls_worker_index = worker_index;
+  while (true) {
+    if (tryRunPendingTask(kAnyTaskGroup)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_worker_state_);
+    cv_tasks_available_.wait(lock, [this]() {
+      return shutdown_requested_ || num_pending_tasks_.load() > 0u;
+    });
+    if (shutdown_requested_ && num_pending_tasks_.load() == 0u) {
+      return;
+    }
+  }
+}
+
+}  // namespace common
@@ -0,0 +1,379 @@
+#include "maplab-common/telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <fstream>  // NOLINT
+#include <iomanip>
+#include <limits>
+#include <sstream>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_string(
+    maplab_telemetry_export_path, "",
+    "File the telemetry metrics are periodically written to, as JSON if it "
+    "ends in \".json\" and in the Prometheus text format otherwise. Empty to "
+    "disable the export.");
+DEFINE_double(
+    maplab_telemetry_export_period_s, 10.0,
+    "Period of the telemetry export in seconds.");
+
+namespace common {
+namespace telemetry {
+namespace {
+
+// Bounds the size of the per-thread buffers.
+constexpr size_t kMaxNumMetrics = 1024u;
+
+struct Accumulator {
+  std::atomic<uint64_t> num_samples{0u};
+  std::atomic<double> sum{0.0};
+  std::atomic<double> min{std::numeric_limits<double>::infinity()};
+  std::atomic<double> max{-std::numeric_limits<double>::infinity()};
+};
+
+// Only written by its thread, so updates are plain loads and stores instead
+// of read-modify-write operations on contended cache lines.
+struct ThreadBuffer {
+  std::array<Accumulator, kMaxNumMetrics> accumulators;
+};
+
+struct Totals {
+  uint64_t num_samples = 0u;
+  double sum = 0.0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+
+  void add(const Accumulator& accumulator) {
+    const uint64_t accumulator_num_samples =
+        accumulator.num_samples.load(std::memory_order_acquire);
+    if (accumulator_num_samples == 0u) {
+      return;
+    }
+    num_samples += accumulator_num_samples;
+    sum += accumulator.sum.load(std::memory_order_relaxed);
+    min = std::min(min, accumulator.min.load(std::memory_order_relaxed));
+    max = std::max(max, accumulator.max.load(std::memory_order_relaxed));
+  }
+};
+
+class Registry {
+ public:
+  // Never destroyed, such that threads exiting after main() can still
+  // retire their buffers.
+  static Registry& instance() {
+    static Registry* registry = new Registry;
+    return *registry;
+  }
+
+  size_t registerMetric(const std::string& name, const Metric::Type type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::unordered_map<std::string, size_t>::const_iterator it =
+        indices_.find(name);
+    if (it != indices_.end()) {
+      CHECK(types_[it->second] == type)
+          << "The metric \"" << name << "\" is registered with another type.";
+      return it->second;
+    }
+    const size_t index = names_.size();
+    CHECK_LT(index, kMaxNumMetrics) << "Too many telemetry metrics.";
+    indices_.emplace(name, index);
+    names_.emplace_back(name);
+    types_.emplace_back(type);
+    return index;
+  }
+
+  ThreadBuffer* addThreadBuffer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_buffers_.emplace_back(new ThreadBuffer);
+    return thread_buffers_.back().get();
+  }
+
+  // Keeps the samples of an exiting thread.
+  void retireThreadBuffer(const ThreadBuffer* thread_buffer) {
+    CHECK_NOTNULL(thread_buffer);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t index = 0u; index < names_.size(); ++index) {
+      retired_totals_[index].add(thread_buffer->accumulators[index]);
+    }
+    thread_buffers_.erase(
+        std::find_if(
+            thread_buffers_.begin(), thread_buffers_.end(),
+            [thread_buffer](const std::unique_ptr<ThreadBuffer>& buffer) {
+              return buffer.get() == thread_buffer;
+            }));
+  }
+
+  void getSummaries(std::vector<MetricSummary>* summaries) const {
+    CHECK_NOTNULL(summaries)->clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    summaries->resize(names_.size());
+    for (size_t index = 0u; index < names_.size(); ++index) {
+      Totals totals = retired_totals_[index];
+      for (const std::unique_ptr<ThreadBuffer>& thread_buffer :
+           thread_buffers_) {
+        totals.add(thread_buffer->accumulators[index]);
+      }
+      MetricSummary& summary = (*summaries)[index];
+      summary.name = names_[index];
+      summary.type = types_[index];
+      summary.num_samples = totals.num_samples;
+      if (totals.num_samples > 0u) {
+        summary.sum = totals.sum;
+        summary.min = totals.min;
+        summary.max = totals.max;
+      }
+    }
+  }
+
+ private:
+  Registry() = default;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, size_t> indices_;
+  std::vector<std::string> names_;
+  std::vector<Metric::Type> types_;
+  std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers_;
+  std::array<Totals, kMaxNumMetrics> retired_totals_;
+};
+
+// Registers the buffer of a thread on its first sample and retires it when
+// the thread exits.
+class ThreadBufferRegistration {
+ public:
+  ThreadBufferRegistration()
+      : thread_buffer_(Registry::instance().addThreadBuffer()) {}
+  ~ThreadBufferRegistration() {
+    Registry::instance().retireThreadBuffer(thread_buffer_);
+  }
+
+  ThreadBuffer* get() const {
+    return thread_buffer_;
+  }
+
+ private:
+  ThreadBuffer* const thread_buffer_;
+};
+
+ThreadBuffer* getThreadBuffer() {
+  thread_local ThreadBufferRegistration registration;
+  return registration.get();
+}
+
+std::string getPrometheusName(const MetricSummary& summary) {
+  std::string name = "maplab_";
+  bool previous_is_underscore = true;
+  for (const char character : summary.name) {
+    if (std::isalnum(static_cast<unsigned char>(character))) {
+      name.push_back(std::tolower(static_cast<unsigned char>(character)));
+      previous_is_underscore = false;
+    } else if (!previous_is_underscore) {
+      name.push_back('_');
+      previous_is_underscore = true;
+    }
+  }
+  if (name.back() == '_') {
+    name.pop_back();
+  }
+  if (summary.type == Metric::Type::kTimer) {
+    name += "_seconds";
+  }
+  return name;
+}
+
+std::string escapeJsonString(const std::string& string) {
+  std::stringstream ss;
+  for (const char character : string) {
+    switch (character) {
+      case '"':
+        ss << "\\\"";
+        break;
+      case '\\':
+        ss << "\\\\";
+        break;
+      case '\n':
+        ss << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20) {
+          ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+             << static_cast<int>(character) << std::dec << std::setfill(' ');
+        } else {
+          ss << character;
+        }
+    }
+  }
+  return ss.str();
+}
+
+}  // namespace
+
+Metric::Metric(const std::string& name, const Type type)
+    : index_(Registry::instance().registerMetric(name, type)) {}
+
+void Metric::addSample(const double value) const {
+  Accumulator& accumulator = getThreadBuffer()->accumulators[index_];
+  accumulator.sum.store(
+      accumulator.sum.load(std::memory_order_relaxed) + value,
+      std::memory_order_relaxed);
+  if (value < accumulator.min.load(std::memory_order_relaxed)) {
+    accumulator.min.store(value, std::memory_order_relaxed);
+  }
+  if (value > accumulator.max.load(std::memory_order_relaxed)) {
+    accumulator.max.store(value, std::memory_order_relaxed);
+  }
+  accumulator.num_samples.store(
+      accumulator.num_samples.load(std::memory_order_relaxed) + 1u,
+      std::memory_order_release);
+}
+
+ScopedTimer::ScopedTimer(const Metric& metric)
+    : metric_(metric),
+      start_time_ns_(getMonotonicTimeNanoseconds()),
+      is_stopped_(false) {}
+
+int64_t ScopedTimer::stop() {
+  const int64_t elapsed_ns = getMonotonicTimeNanoseconds() - start_time_ns_;
+  if (!is_stopped_) {
+    metric_.addSample(elapsed_ns * 1e-9);
+    is_stopped_ = true;
+  }
+  return elapsed_ns;
+}
+
+void getMetricSummaries(std::vector<MetricSummary>* summaries) {
+  Registry::instance().getSummaries(summaries);
+}
+
+std::string exportPrometheus() {
+  std::vector<MetricSummary> summaries;
+  getMetricSummaries(&summaries);
+
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<double>::max_digits10);
+  std::unordered_set<std::string> exported_names;
+  for (size_t index = 0u; index < summaries.size(); ++index) {
+    const MetricSummary& summary = summaries[index];
+    std::string name = getPrometheusName(summary);
+    // Different metric names can map to the same Prometheus name.
+    if (!exported_names.insert(name).second) {
+      name += "_" + std::to_string(index);
+      exported_names.insert(name);
+    }
+    ss << "# HELP " << name << " " << summary.name << "\n";
+    ss << "# TYPE " << name << " summary\n";
+    ss << name << "_count " << summary.num_samples << "\n";
+    ss << name << "_sum " << summary.sum << "\n";
+    ss << "# TYPE " << name << "_min gauge\n";
+    ss << name << "_min " << summary.min << "\n";
+    ss << "# TYPE " << name << "_max gauge\n";
+    ss << name << "_max " << summary.max << "\n";
+  }
+  return ss.str();
+}
+
+std::string exportJson() {
+  std::vector<MetricSummary> summaries;
+  getMetricSummaries(&summaries);
+
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<double>::max_digits10);
+  ss << "{\"metrics\": [";
+  for (size_t index = 0u; index < summaries.size(); ++index) {
+    const MetricSummary& summary = summaries[index];
+    if (index > 0u) {
+      ss << ", ";
+    }
+    ss << "{\"name\": \"" << escapeJsonString(summary.name) << "\", "
+       << "\"type\": \""
+       << (summary.type == Metric::Type::kTimer ? "timer" : "statistic")
+       << "\", \"count\": " << summary.num_samples
+       << ", \"sum\": " << summary.sum << ", \"min\": " << summary.min
+       << ", \"max\": " << summary.max << ", \"mean\": " << summary.getMean()
+       << "}";
+  }
+  ss << "]}\n";
+  return ss.str();
+}
+
+PeriodicExporter::PeriodicExporter(
+    const std::string& filepath, const double period_s)
+    : filepath_(filepath),
+      period_(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::duration<double>(period_s))),
+      shutdown_requested_(false) {
+  CHECK(!filepath_.empty());
+  CHECK_GT(period_s, 0.0);
+  thread_ = std::thread(&PeriodicExporter::threadWorker, this);
+}
+
+PeriodicExporter::~PeriodicExporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_requested_ = true;
+  }
+  cv_shutdown_.notify_all();
+  thread_.join();
+  exportNow();
+}
+
+bool PeriodicExporter::exportNow() const {
+  const std::string json_extension = ".json";
+  const bool is_json =
+      filepath_.size() >= json_extension.size() &&
+      filepath_.compare(
+          filepath_.size() - json_extension.size(), json_extension.size(),
+          json_extension) == 0;
+
+  const std::string temporary_filepath = filepath_ + ".tmp";
+  {
+    std::ofstream file(temporary_filepath);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Could not open " << temporary_filepath
+                 << " for the telemetry export.";
+      return false;
+    }
+    file << (is_json ? exportJson() : exportPrometheus());
+    if (!file.good()) {
+      LOG(ERROR) << "Writing the telemetry to " << temporary_filepath
+                 << " failed.";
+      return false;
+    }
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath_.c_str()) != 0) {
+    LOG(ERROR) << "Could not move the telemetry export to " << filepath_
+               << ".";
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<PeriodicExporter> PeriodicExporter::createFromFlags() {
+  if (FLAGS_maplab_telemetry_export_path.empty()) {
+    return nullptr;
+  }
+  return std::unique_ptr<PeriodicExporter>(
+      new PeriodicExporter(
+          FLAGS_maplab_telemetry_export_path,
+          FLAGS_maplab_telemetry_export_period_s));
+}
+
+void PeriodicExporter::threadWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cv_shutdown_.wait_for(
+      lock, period_, [this]() { return shutdown_requested_; })) {
+    lock.unlock();
+    exportNow();
+    lock.lock();
+  }
+}
+
+}  // namespace telemetry
+}  // namespace common
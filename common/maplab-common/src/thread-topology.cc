@@ -0,0 +1,230 @@
+#include "maplab-common/thread-topology.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <iterator>
+#include <sstream>  // NOLINT
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "maplab-common/string-tools.h"
+
+DEFINE_string(
+    maplab_worker_cpus, "",
+    "CPUs the worker threads are restricted to, e.g. \"0-7,16-23\". Empty to "
+    "use all CPUs in the affinity mask of the process.");
+DEFINE_string(
+    maplab_stage_cpus, "",
+    "Semicolon separated CPUs of the pinned real-time pipeline stages, e.g. "
+    "\"synchronizer=2;tracker=3;estimator=4-5\".");
+
+namespace common {
+namespace {
+
+constexpr char kNumaNodeSysfsFolder[] = "/sys/devices/system/node/node";
+// Upper bound of the NUMA node ids that are probed.
+constexpr int kMaxNumNumaNodes = 64;
+
+bool readFirstLine(const std::string& filename, std::string* line) {
+  CHECK_NOTNULL(line);
+  std::ifstream file(filename);
+  return file.is_open() && std::getline(file, *line);
+}
+
+CpuList getProcessAffinity() {
+  CpuList cpus;
+  if (!getCurrentThreadAffinity(&cpus) || cpus.empty()) {
+    // Stays empty if the number of CPUs is unknown as well.
+    const int num_cpus = static_cast<int>(std::thread::hardware_concurrency());
+    cpus.resize(num_cpus);
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      cpus[cpu] = cpu;
+    }
+  }
+  return cpus;
+}
+
+CpuList intersect(const CpuList& a, const CpuList& b) {
+  CpuList result;
+  std::set_intersection(
+      a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+  return result;
+}
+
+}  // namespace
+
+bool parseCpuList(const std::string& cpu_list_string, CpuList* cpus) {
+  CHECK_NOTNULL(cpus)->clear();
+  constexpr bool kRemoveEmpty = true;
+  std::vector<std::string> ranges;
+  tokenizeString(cpu_list_string, ',', kRemoveEmpty, &ranges);
+  for (const std::string& range : ranges) {
+    std::istringstream stream(range);
+    int first_cpu = -1;
+    int last_cpu = -1;
+    char separator = '\0';
+    stream >> first_cpu;
+    if (stream.fail() || first_cpu < 0) {
+      LOG(ERROR) << "Invalid CPU list \"" << cpu_list_string << "\".";
+      return false;
+    }
+    last_cpu = first_cpu;
+    if (stream >> separator) {
+      if (separator != '-' || !(stream >> last_cpu) || last_cpu < first_cpu) {
+        LOG(ERROR) << "Invalid CPU list \"" << cpu_list_string << "\".";
+        return false;
+      }
+    }
+    for (int cpu = first_cpu; cpu <= last_cpu; ++cpu) {
+      cpus->push_back(cpu);
+    }
+  }
+  std::sort(cpus->begin(), cpus->end());
+  cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+  return true;
+}
+
+ThreadTopology::ThreadTopology() {
+  worker_cpus_ = getProcessAffinity();
+  if (!FLAGS_maplab_worker_cpus.empty()) {
+    CpuList requested_cpus;
+    CHECK(parseCpuList(FLAGS_maplab_worker_cpus, &requested_cpus));
+    worker_cpus_ = worker_cpus_.empty()
+                       ? requested_cpus
+                       : intersect(worker_cpus_, requested_cpus);
+    CHECK(!worker_cpus_.empty())
+        << "None of the CPUs of --maplab_worker_cpus="
+        << FLAGS_maplab_worker_cpus << " are available to the process.";
+  }
+
+  for (int node = 0; node < kMaxNumNumaNodes; ++node) {
+    std::string node_cpu_list;
+    if (!readFirstLine(
+            kNumaNodeSysfsFolder + std::to_string(node) + "/cpulist",
+            &node_cpu_list)) {
+      continue;
+    }
+    CpuList node_cpus;
+    if (parseCpuList(node_cpu_list, &node_cpus)) {
+      node_cpus = intersect(node_cpus, worker_cpus_);
+      if (!node_cpus.empty()) {
+        numa_node_cpus_.emplace_back(node_cpus);
+      }
+    }
+  }
+  if (numa_node_cpus_.empty()) {
+    numa_node_cpus_.emplace_back(worker_cpus_);
+  }
+
+  constexpr bool kRemoveEmpty = true;
+  std::vector<std::string> stages;
+  tokenizeString(FLAGS_maplab_stage_cpus, ';', kRemoveEmpty, &stages);
+  for (const std::string& stage : stages) {
+    const size_t separator_position = stage.find('=');
+    CHECK_NE(separator_position, std::string::npos)
+        << "Invalid stage \"" << stage << "\" in --maplab_stage_cpus.";
+    CpuList stage_cpus;
+    CHECK(parseCpuList(stage.substr(separator_position + 1u), &stage_cpus));
+    stage_cpus_[stage.substr(0u, separator_position)] = stage_cpus;
+  }
+
+  VLOG(1) << "Thread topology: " << worker_cpus_.size() << " worker CPUs on "
+          << numa_node_cpus_.size() << " NUMA nodes, " << stage_cpus_.size()
+          << " pinned stages.";
+}
+
+const ThreadTopology& ThreadTopology::instance() {
+  static const ThreadTopology topology;
+  return topology;
+}
+
+const CpuList& ThreadTopology::getNumaNodeCpus(size_t numa_node_index) const {
+  CHECK_LT(numa_node_index, numa_node_cpus_.size());
+  return numa_node_cpus_[numa_node_index];
+}
+
+const CpuList& ThreadTopology::getStageCpus(
+    const std::string& stage_name) const {
+  static const CpuList kNoCpus;
+  const std::unordered_map<std::string, CpuList>::const_iterator it =
+      stage_cpus_.find(stage_name);
+  return it == stage_cpus_.end() ? kNoCpus : it->second;
+}
+
+#if defined(__linux__)
+bool setCurrentThreadAffinity(const CpuList& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    CHECK_GE(cpu, 0);
+    CHECK_LT(cpu, CPU_SETSIZE);
+    CPU_SET(cpu, &cpu_set);
+  }
+  const int error =
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  LOG_IF(WARNING, error != 0) << "Setting the thread affinity failed with "
+                              << "error " << error << '.';
+  return error == 0;
+}
+
+bool getCurrentThreadAffinity(CpuList* cpus) {
+  CHECK_NOTNULL(cpus)->clear();
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+    return false;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus->push_back(cpu);
+    }
+  }
+  return true;
+}
+#else
+bool setCurrentThreadAffinity(const CpuList& cpus) {
+  LOG_IF(WARNING, !cpus.empty())
+      << "Thread affinity is not supported on this platform.";
+  return cpus.empty();
+}
+
+bool getCurrentThreadAffinity(CpuList* cpus) {
+  CHECK_NOTNULL(cpus)->clear();
+  return false;
+}
+#endif
+
+ScopedThreadAffinity::ScopedThreadAffinity(const CpuList& cpus)
+    : is_pinned_(false) {
+  if (!cpus.empty() && getCurrentThreadAffinity(&previous_cpus_)) {
+    is_pinned_ = setCurrentThreadAffinity(cpus);
+  }
+}
+
+ScopedThreadAffinity::~ScopedThreadAffinity() {
+  if (is_pinned_) {
+    setCurrentThreadAffinity(previous_cpus_);
+  }
+}
+
+void runOnNumaNode(
+    size_t numa_node_index, const std::function<void()>& function) {
+  CHECK(function);
+  ScopedThreadAffinity pinning(
+      ThreadTopology::instance().getNumaNodeCpus(numa_node_index));
+  function();
+}
+
+}  // namespace common
@@ -1,10 +1,10 @@
 #include "maplab-common/threading-helpers.h"
 
-#include <thread>
-
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "maplab-common/thread-topology.h"
+
 DEFINE_uint64(
     num_hardware_threads, 0u,
     "Number of hardware threads to announce. (0: autodetect)");
@@ -20,7 +20,9 @@ size_t getNumHardwareThreadsImpl() {
     return FLAGS_num_hardware_threads;
   }
 
-  const size_t num_detected_threads = std::thread::hardware_concurrency();
+  // Only the CPUs the process may run on, e.g. with CPU isolation.
+  const size_t num_detected_threads =
+      ThreadTopology::instance().getWorkerCpus().size();
 
   // Fallback to default or user-provided value if the detection failed.
   if (num_detected_threads == 0) {
@@ -2,21 +2,74 @@
 
 #include <atomic>
 #include <chrono>
+#include <random>
+
+#include <glog/logging.h>
 
 namespace common {
 namespace internal {
+namespace {
+// Finalizer of splitmix64. It is a bijection, so distinct inputs result in
+// distinct, well distributed outputs.
+inline uint64_t mix64(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+// Differs between processes, such that ids of maps built in separate runs
+// don't collide.
+uint64_t getProcessSalt() {
+  static const uint64_t kProcessSalt = []() {
+    std::random_device random_device;
+    uint64_t salt = (static_cast<uint64_t>(random_device()) << 32) ^
+                    static_cast<uint64_t>(random_device());
+    // The random device may be deterministic on some platforms.
+    salt ^= mix64(
+        std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    return salt;
+  }();
+  return kProcessSalt;
+}
+
+// The first word of an id is a prefix drawn once per thread and the second
+// word a mixed per-thread counter. The prefixes of all threads of a process
+// are distinct, which makes the ids unique within the process without any
+// shared state after the first id of a thread.
+class ThreadLocalIdGenerator {
+ public:
+  ThreadLocalIdGenerator() : counter_(0u) {
+    static std::atomic<uint64_t> num_generators(0u);
+    prefix_ = mix64(getProcessSalt() ^ ++num_generators);
+  }
+
+  inline void generate(uint64_t hash[2]) {
+    hash[0] = prefix_ ^ UniqueIdHashSeed::instance().seed();
+    // The counter starts at one, so the second word is never zero.
+    hash[1] = mix64(++counter_);
+  }
+
+ private:
+  uint64_t prefix_;
+  uint64_t counter_;
+};
+
+thread_local ThreadLocalIdGenerator tls_id_generator;
+}  // namespace
+
 void generateUnique128BitHash(uint64_t hash[2]) {
   static_assert(
       sizeof(size_t) == sizeof(uint64_t),
       "Please adapt the below to your non-64-bit system.");
+  tls_id_generator.generate(hash);
+}
 
-  static std::atomic<int> counter;
-  hash[0] =
-      common::internal::UniqueIdHashSeed::instance().seed() ^
-      std::hash<int>()(
-          std::chrono::high_resolution_clock::now().time_since_epoch().count());
-  // Increment must happen here, otherwise the sampling is not atomic.
-  hash[1] = std::hash<int>()(++counter);
+void generateUnique128BitHashes(const size_t num_hashes, uint64_t* hashes) {
+  CHECK(num_hashes == 0u || hashes != nullptr);
+  ThreadLocalIdGenerator& generator = tls_id_generator;
+  for (size_t hash_idx = 0u; hash_idx < num_hashes; ++hash_idx) {
+    generator.generate(hashes + 2u * hash_idx);
+  }
 }
 }  // namespace internal
 }  // namespace common
@@ -47,6 +47,81 @@ TEST(QuaternionMath, toFromChainJPL) {
   EXPECT_NEAR_EIGEN(rotation_matrix_expected, rotation_matrix, 1e-8);
 }
 
+namespace {
+constexpr int kNumBatchElements = 100;
+
+Eigen::Matrix4Xd getRandomQuaternions() {
+  Eigen::Matrix4Xd q(4, kNumBatchElements);
+  for (int i = 0; i < kNumBatchElements; ++i) {
+    aslam::Quaternion random_rotation;
+    random_rotation.setRandom();
+    q.col(i) = random_rotation.toImplementation().coeffs();
+  }
+  // Rotations close to 180deg take the non-trace branches of
+  // fromRotationMatrixJPL.
+  q.col(0) << 1.0, 0.0, 0.0, 0.0;
+  q.col(1) << 0.0, 0.7071, 0.7071, 1e-3;
+  q.col(1).normalize();
+  return q;
+}
+}  // namespace
+
+TEST(QuaternionMath, rotationMatrixJPLBatchedSameAsScalar) {
+  const Eigen::Matrix4Xd q = getRandomQuaternions();
+  Eigen::Matrix<double, 9, Eigen::Dynamic> rotation_matrices;
+  common::toRotationMatrixJPLBatched(q, &rotation_matrices);
+  Eigen::Matrix4Xd q_from_rotation_matrices;
+  common::fromRotationMatrixJPLBatched(
+      rotation_matrices, &q_from_rotation_matrices);
+  ASSERT_EQ(q_from_rotation_matrices.cols(), q.cols());
+
+  for (int i = 0; i < q.cols(); ++i) {
+    Eigen::Matrix3d expected_rotation_matrix;
+    common::toRotationMatrixJPL(q.col(i), &expected_rotation_matrix);
+    const Eigen::Map<const Eigen::Matrix3d> rotation_matrix(
+        rotation_matrices.col(i).data());
+    EXPECT_NEAR_EIGEN(expected_rotation_matrix, rotation_matrix, 1e-12);
+
+    Eigen::Vector4d expected_quat_coeffs;
+    common::fromRotationMatrixJPL(
+        expected_rotation_matrix, &expected_quat_coeffs);
+    EXPECT_NEAR_EIGEN(
+        expected_quat_coeffs, q_from_rotation_matrices.col(i), 1e-12);
+  }
+}
+
+TEST(QuaternionMath, quaternionProductJPLBatchedSameAsScalar) {
+  const Eigen::Matrix4Xd q1 = getRandomQuaternions();
+  const Eigen::Matrix4Xd q2 = getRandomQuaternions();
+  const Eigen::Matrix3Xd v = Eigen::Matrix3Xd::Random(3, q1.cols());
+
+  Eigen::Matrix4Xd signed_product, positive_product;
+  common::signedQuaternionProductJPLBatched(q1, q2, &signed_product);
+  common::positiveQuaternionProductJPLBatched(q1, q2, &positive_product);
+  Eigen::Matrix3Xd rotated_v;
+  common::rotateVectorJPLBatched(q1, v, &rotated_v);
+
+  for (int i = 0; i < q1.cols(); ++i) {
+    Eigen::Vector4d expected_signed_product, expected_positive_product;
+    common::signedQuaternionProductJPL(
+        q1.col(i), q2.col(i), expected_signed_product);
+    common::positiveQuaternionProductJPL(
+        q1.col(i), q2.col(i), expected_positive_product);
+    EXPECT_NEAR_EIGEN(expected_signed_product, signed_product.col(i), 1e-12);
+    EXPECT_NEAR_EIGEN(
+        expected_positive_product, positive_product.col(i), 1e-12);
+
+    Eigen::Matrix3d rotation_matrix;
+    common::toRotationMatrixJPL(q1.col(i), &rotation_matrix);
+    EXPECT_NEAR_EIGEN(rotation_matrix * v.col(i), rotated_v.col(i), 1e-12);
+  }
+
+  // The outputs may alias the inputs.
+  Eigen::Matrix4Xd q1_aliased = q1;
+  common::positiveQuaternionProductJPLBatched(q1_aliased, q2, &q1_aliased);
+  EXPECT_NEAR_EIGEN(positive_product, q1_aliased, 1e-15);
+}
+
 }  // namespace common
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,99 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <maplab-common/csr-graph.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+namespace common {
+
+typedef CsrGraph<double> Graph;
+
+TEST(CsrGraphTest, EdgesAreSortedAndMerged) {
+  std::vector<Graph::Edge> edges;
+  edges.emplace_back(1, 3, 1.0);
+  edges.emplace_back(1, 0, 2.0);
+  edges.emplace_back(2, 1, 3.0);
+  edges.emplace_back(1, 3, 4.0);
+  const Graph graph(4, edges);
+
+  ASSERT_EQ(graph.getNumVertices(), 4);
+  EXPECT_EQ(graph.getNumEdges(), 3);
+  EXPECT_EQ(graph.getDegree(0), 0);
+  EXPECT_EQ(graph.getDegree(1), 2);
+  EXPECT_EQ(graph.offsets(), std::vector<int>({0, 0, 2, 3, 3}));
+  EXPECT_EQ(graph.neighbors(), std::vector<int>({0, 3, 1}));
+  EXPECT_EQ(graph.weights(), std::vector<double>({2.0, 5.0, 3.0}));
+
+  const Graph undirected_graph = Graph::fromUndirectedEdges(4, edges);
+  EXPECT_EQ(undirected_graph.offsets(), std::vector<int>({0, 1, 4, 5, 6}));
+  EXPECT_EQ(undirected_graph.neighbors(), std::vector<int>({1, 0, 2, 3, 1, 1}));
+}
+
+TEST(CsrGraphTest, KruskalMaxSpanningForest) {
+  std::vector<Graph::Edge> edges;
+  edges.emplace_back(0, 1, 5.0);
+  edges.emplace_back(2, 1, 2.0);
+  edges.emplace_back(3, 0, 7.0);
+  edges.emplace_back(1, 3, 3.0);
+  edges.emplace_back(3, 2, 4.0);
+  std::vector<Graph::Edge> tree_edges;
+  EXPECT_TRUE(
+      kruskalMaxSpanningForest(
+          Graph::fromUndirectedEdges(4, edges), &tree_edges));
+  ASSERT_EQ(tree_edges.size(), 3u);
+  EXPECT_EQ(tree_edges[0].from, 0);
+  EXPECT_EQ(tree_edges[0].to, 3);
+  EXPECT_EQ(tree_edges[1].from, 0);
+  EXPECT_EQ(tree_edges[1].to, 1);
+  EXPECT_EQ(tree_edges[2].from, 2);
+  EXPECT_EQ(tree_edges[2].to, 3);
+
+  // A fifth, isolated vertex.
+  EXPECT_FALSE(
+      kruskalMaxSpanningForest(
+          Graph::fromUndirectedEdges(5, edges), &tree_edges));
+  EXPECT_EQ(tree_edges.size(), 3u);
+}
+
+TEST(CsrGraphTest, SearchesAndComponents) {
+  // Two components: 0 - {1, 2}, 1 - 3 and 4 - 5.
+  std::vector<Graph::Edge> edges;
+  edges.emplace_back(0, 2, 1.0);
+  edges.emplace_back(0, 1, 1.0);
+  edges.emplace_back(1, 3, 1.0);
+  edges.emplace_back(5, 4, 1.0);
+  const Graph graph = Graph::fromUndirectedEdges(7, edges);
+
+  std::vector<int> vertices;
+  getVerticesBreadthFirst(graph, 0, &vertices);
+  EXPECT_EQ(vertices, std::vector<int>({0, 1, 2, 3}));
+  getVerticesDepthFirst(graph, 0, &vertices);
+  EXPECT_EQ(vertices, std::vector<int>({0, 1, 3, 2}));
+  getVerticesBreadthFirst(graph, 6, &vertices);
+  EXPECT_EQ(vertices, std::vector<int>({6}));
+
+  std::vector<int> component_indices;
+  EXPECT_EQ(getConnectedComponents(graph, &component_indices), 3);
+  EXPECT_EQ(component_indices, std::vector<int>({0, 0, 0, 0, 1, 1, 2}));
+}
+
+TEST(CsrGraphTest, ComputeEdgeWeights) {
+  constexpr int kNumVertices = 1000;
+  std::vector<CsrGraph<int>::Edge> edges;
+  for (int vertex = 1; vertex < kNumVertices; ++vertex) {
+    edges.emplace_back(vertex - 1, vertex, 0);
+  }
+  CsrGraph<int> graph = CsrGraph<int>::fromUndirectedEdges(kNumVertices, edges);
+  constexpr size_t kNumThreads = 8u;
+  graph.computeEdgeWeights(
+      [](const int from, const int to) { return from * kNumVertices + to; },
+      kNumThreads);
+  graph.forEachEdge([](const int from, const int to, const int weight) {
+    EXPECT_EQ(weight, from * kNumVertices + to);
+  });
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
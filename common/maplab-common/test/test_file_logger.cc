@@ -1,3 +1,8 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "maplab-common/test/testing-entrypoint.h"
 
 #include "maplab-common/file-logger.h"
@@ -35,6 +40,83 @@ TEST(FileLogger, WriteString) {
   reader.close();
 }
 
+TEST(FileLogger, AsyncRecordsOfAllThreadsAreWritten) {
+  const std::string kTestFile = "testfile_async.txt";
+  constexpr int kNumThreads = 4;
+  constexpr int kNumRecordsPerThread = 10000;
+  FileLogger::AsyncOptions options;
+  // Large enough to not drop any record.
+  options.buffer_size_bytes = 1u << 20;
+  {
+    FileLogger logger(kTestFile, options);
+    ASSERT_TRUE(logger.isOpen());
+    std::vector<std::thread> threads;
+    for (int thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+      threads.emplace_back([&logger, thread_idx]() {
+        for (int record_idx = 0; record_idx < kNumRecordsPerThread;
+             ++record_idx) {
+          logger.appendRecord(
+              std::to_string(thread_idx) + " " + std::to_string(record_idx) +
+              "\n");
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    logger.flushBuffer();
+    EXPECT_EQ(logger.getNumDroppedRecords(), 0u);
+
+    // All records are on disk after the flush.
+    std::ifstream reader(kTestFile);
+    ASSERT_TRUE(reader.good());
+    std::vector<int> next_record_indices(kNumThreads, 0);
+    std::string line_buffer;
+    while (std::getline(reader, line_buffer)) {
+      std::istringstream line(line_buffer);
+      int thread_idx = -1;
+      int record_idx = -1;
+      line >> thread_idx >> record_idx;
+      ASSERT_GE(thread_idx, 0);
+      ASSERT_LT(thread_idx, kNumThreads);
+      // The records of each thread are in order.
+      EXPECT_EQ(record_idx, next_record_indices[thread_idx]);
+      ++next_record_indices[thread_idx];
+    }
+    for (int thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+      EXPECT_EQ(next_record_indices[thread_idx], kNumRecordsPerThread);
+    }
+  }
+}
+
+TEST(FileLogger, AsyncRecordsExceedingTheBufferAreDropped) {
+  const std::string kTestFile = "testfile_async_dropped.txt";
+  FileLogger::AsyncOptions options;
+  options.buffer_size_bytes = 16u;
+  {
+    FileLogger logger(kTestFile, options);
+    ASSERT_TRUE(logger.isOpen());
+    logger.appendRecord("short\n");
+    logger.appendRecord(std::string(17u, 'x'));
+    EXPECT_EQ(logger.getNumDroppedRecords(), 1u);
+  }
+
+  std::ifstream reader(kTestFile);
+  ASSERT_TRUE(reader.good());
+  std::string line_buffer;
+  ASSERT_TRUE(static_cast<bool>(std::getline(reader, line_buffer)));
+  EXPECT_EQ("short", line_buffer);
+  EXPECT_FALSE(static_cast<bool>(std::getline(reader, line_buffer)));
+}
+
+TEST(FileLogger, AsyncAppendAfterCloseFails) {
+  FileLogger logger("testfile_async_closed.txt", FileLogger::AsyncOptions());
+  ASSERT_TRUE(logger.isOpen());
+  logger.appendRecord("record\n");
+  logger.closeFile();
+  EXPECT_DEATH(logger.appendRecord("record\n"), "closed");
+}
+
 }  // namespace common
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -113,6 +113,33 @@ TEST(MaplabCommon, copyFileTest) {
   EXPECT_TRUE(deleteFile(kTargetFile));
 }
 
+TEST(MaplabCommon, transferAndMoveFileTest) {
+  const std::string kSourceFile = "maplab_test_data/testfile.txt";
+  const std::string kCopiedFile = "maplab_test_data/testfile.txt-transfer";
+  const std::string kLinkedFile = "maplab_test_data/testfile.txt-link";
+  const std::string kMovedFile = "maplab_test_data/testfile.txt-move";
+  constexpr bool kTryHardlink = true;
+
+  const int64_t source_size = getFileSize(kSourceFile);
+  EXPECT_GT(source_size, 0);
+  EXPECT_EQ(getFileSize("maplab_test_data/inexistentfile.foo"), -1);
+
+  EXPECT_TRUE(transferFile(kSourceFile, kCopiedFile, !kTryHardlink));
+  EXPECT_EQ(getFileSize(kCopiedFile), source_size);
+  // The destination must not exist.
+  EXPECT_FALSE(transferFile(kSourceFile, kCopiedFile, !kTryHardlink));
+  EXPECT_TRUE(transferFile(kSourceFile, kLinkedFile, kTryHardlink));
+  EXPECT_EQ(getFileSize(kLinkedFile), source_size);
+
+  EXPECT_TRUE(moveFile(kCopiedFile, kMovedFile));
+  EXPECT_FALSE(fileExists(kCopiedFile));
+  EXPECT_EQ(getFileSize(kMovedFile), source_size);
+  EXPECT_FALSE(moveFile(kLinkedFile, kMovedFile));
+
+  EXPECT_TRUE(deleteFile(kLinkedFile));
+  EXPECT_TRUE(deleteFile(kMovedFile));
+}
+
 TEST(MaplabCommon, getCurrentWorkingDirectoryTest) {
   const std::string current_working_directory = getCurrentWorkingDirectory();
   EXPECT_FALSE(current_working_directory.empty());
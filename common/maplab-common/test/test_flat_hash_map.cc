@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/common/hash-id.h>
+#include <glog/logging.h>
+
+#include "maplab-common/flat-hash-map.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+TEST(MaplabCommon, FlatHashMapInsertFindErase) {
+  FlatHashMap<aslam::HashId, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+
+  std::vector<aslam::HashId> ids(100);
+  for (size_t i = 0u; i < ids.size(); ++i) {
+    ids[i].randomize();
+    EXPECT_TRUE(map.emplace(ids[i], static_cast<int>(i)).second);
+  }
+  EXPECT_FALSE(map.emplace(ids[0], -1).second);
+  EXPECT_EQ(map.size(), ids.size());
+  EXPECT_EQ(map.find(ids[0])->second, 0);
+
+  for (size_t i = 0u; i < ids.size(); i += 2u) {
+    EXPECT_EQ(map.erase(ids[i]), 1u);
+  }
+  EXPECT_EQ(map.erase(ids[0]), 0u);
+  EXPECT_EQ(map.size(), ids.size() / 2u);
+  for (size_t i = 0u; i < ids.size(); ++i) {
+    EXPECT_EQ(map.count(ids[i]), i % 2u);
+  }
+
+  size_t num_iterated = 0u;
+  for (const FlatHashMap<aslam::HashId, int>::value_type& element : map) {
+    EXPECT_EQ(ids[element.second], element.first);
+    ++num_iterated;
+  }
+  EXPECT_EQ(num_iterated, map.size());
+
+  map[ids[0]] = 5;
+  EXPECT_EQ(map.find(ids[0])->second, 5);
+}
+
+TEST(MaplabCommon, FlatHashMapEraseWhileIterating) {
+  FlatHashMap<aslam::HashId, std::unique_ptr<int>> map;
+  for (int i = 0; i < 1000; ++i) {
+    aslam::HashId id;
+    id.randomize();
+    map.emplace(id, std::unique_ptr<int>(new int(i)));
+  }
+
+  typedef FlatHashMap<aslam::HashId, std::unique_ptr<int>>::iterator Iterator;
+  Iterator it = map.begin();
+  while (it != map.end()) {
+    if (*it->second % 3 == 0) {
+      it = map.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  EXPECT_EQ(map.size(), 666u);
+  for (const FlatHashMap<aslam::HashId, std::unique_ptr<int>>::value_type&
+           element : map) {
+    EXPECT_NE(*element.second % 3, 0);
+  }
+
+  // Inserting after erasing reuses the erased slots.
+  const size_t capacity = map.capacity();
+  for (int i = 0; i < 300; ++i) {
+    aslam::HashId id;
+    id.randomize();
+    map.emplace(id, std::unique_ptr<int>(new int(i)));
+  }
+  EXPECT_EQ(map.size(), 966u);
+  EXPECT_EQ(map.capacity(), capacity);
+}
+
+TEST(MaplabCommon, FlatHashMapEqualityIgnoresOrder) {
+  std::vector<aslam::HashId> ids(50);
+  FlatHashMap<aslam::HashId, int> map_a;
+  for (size_t i = 0u; i < ids.size(); ++i) {
+    ids[i].randomize();
+    map_a.emplace(ids[i], static_cast<int>(i));
+  }
+  FlatHashMap<aslam::HashId, int> map_b;
+  map_b.reserve(1000u);
+  for (size_t i = ids.size(); i > 0u; --i) {
+    map_b.emplace(ids[i - 1u], static_cast<int>(i - 1u));
+  }
+  EXPECT_TRUE(map_a == map_b);
+  map_b[ids[0]] = -1;
+  EXPECT_TRUE(map_a != map_b);
+
+  FlatHashMap<aslam::HashId, int> map_c;
+  map_c.swap(map_a);
+  EXPECT_TRUE(map_a.empty());
+  EXPECT_EQ(map_c.size(), ids.size());
+}
+
+// Compares the lookup time against std::unordered_map on a map with as many
+// entries as the landmark index of a medium sized map.
+TEST(MaplabCommon, FlatHashMapLookupBenchmark) {
+  constexpr size_t kNumElements = 200000u;
+  constexpr size_t kNumLookups = 2000000u;
+
+  std::vector<aslam::HashId> ids(kNumElements);
+  std::unordered_map<aslam::HashId, aslam::HashId> unordered_map;
+  FlatHashMap<aslam::HashId, aslam::HashId> flat_map;
+  for (aslam::HashId& id : ids) {
+    id.randomize();
+    unordered_map.emplace(id, id);
+    flat_map.emplace(id, id);
+  }
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<size_t> distribution(0u, kNumElements - 1u);
+  std::vector<size_t> lookup_indices(kNumLookups);
+  for (size_t& index : lookup_indices) {
+    index = distribution(generator);
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  size_t num_found_unordered = 0u;
+  const Clock::time_point unordered_start = Clock::now();
+  for (size_t index : lookup_indices) {
+    num_found_unordered += unordered_map.find(ids[index])->second == ids[index];
+  }
+  const Clock::time_point flat_start = Clock::now();
+  size_t num_found_flat = 0u;
+  for (size_t index : lookup_indices) {
+    num_found_flat += flat_map.find(ids[index])->second == ids[index];
+  }
+  const Clock::time_point flat_end = Clock::now();
+
+  EXPECT_EQ(num_found_unordered, kNumLookups);
+  EXPECT_EQ(num_found_flat, kNumLookups);
+  LOG(INFO) << kNumLookups << " lookups in " << kNumElements << " elements: "
+            << "std::unordered_map "
+            << std::chrono::duration<double, std::milli>(
+                   flat_start - unordered_start)
+                   .count()
+            << " ms, common::FlatHashMap "
+            << std::chrono::duration<double, std::milli>(flat_end - flat_start)
+                   .count()
+            << " ms.";
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
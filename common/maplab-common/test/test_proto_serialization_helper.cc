@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/id.pb.h>
+#include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+DECLARE_bool(proto_parse_with_mmap);
+DECLARE_int32(proto_num_io_threads);
+DECLARE_int32(proto_read_ahead_files);
+
+namespace common {
+namespace proto_serialization_helper {
+
+class ProtoSerializationHelperTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumFiles = 40;
+  static constexpr char kTestFolder[] = "proto_serialization_helper_test";
+
+  void SetUp() override {
+    ASSERT_TRUE(removePath(kTestFolder));
+    ASSERT_TRUE(createPath(kTestFolder));
+    for (int file_idx = 0; file_idx < kNumFiles; ++file_idx) {
+      proto::Id proto;
+      for (int i = 0; i <= file_idx; ++i) {
+        proto.add_uint(file_idx * i);
+      }
+      file_names_.push_back("file" + std::to_string(file_idx));
+      ASSERT_TRUE(serializeProtoToFile(kTestFolder, file_names_.back(), proto));
+    }
+  }
+
+  void TearDown() override {
+    removePath(kTestFolder);
+  }
+
+  static void expectFileContent(const int file_idx, const proto::Id& proto) {
+    ASSERT_EQ(proto.uint_size(), file_idx + 1);
+    for (int i = 0; i <= file_idx; ++i) {
+      EXPECT_EQ(proto.uint(i), static_cast<uint64_t>(file_idx * i));
+    }
+  }
+
+  std::vector<std::string> file_names_;
+};
+
+constexpr int ProtoSerializationHelperTest::kNumFiles;
+constexpr char ProtoSerializationHelperTest::kTestFolder[];
+
+TEST_F(ProtoSerializationHelperTest, ParseWithMmap) {
+  FLAGS_proto_parse_with_mmap = true;
+  proto::Id proto;
+  EXPECT_TRUE(parseProtoFromFile(kTestFolder, file_names_[7], &proto));
+  expectFileContent(7, proto);
+  EXPECT_FALSE(parseProtoFromFile(kTestFolder, "missing_file", &proto));
+  FLAGS_proto_parse_with_mmap = false;
+}
+
+TEST_F(ProtoSerializationHelperTest, ParseBatchWithReadAhead) {
+  for (const int num_files_ahead : {1, 16}) {
+    for (const int num_io_threads : {1, 4}) {
+      FLAGS_proto_read_ahead_files = num_files_ahead;
+      FLAGS_proto_num_io_threads = num_io_threads;
+      std::vector<proto::Id> protos(kNumFiles);
+      std::vector<google::protobuf::Message*> proto_ptrs;
+      for (proto::Id& proto : protos) {
+        proto_ptrs.push_back(&proto);
+      }
+      ASSERT_TRUE(parseProtosFromFiles(kTestFolder, file_names_, proto_ptrs));
+      for (int file_idx = 0; file_idx < kNumFiles; ++file_idx) {
+        expectFileContent(file_idx, protos[file_idx]);
+      }
+    }
+  }
+}
+
+TEST_F(ProtoSerializationHelperTest, BatchFailsOnMissingFile) {
+  file_names_[kNumFiles / 2] = "missing_file";
+  std::vector<proto::Id> protos(kNumFiles);
+  std::vector<google::protobuf::Message*> proto_ptrs;
+  for (proto::Id& proto : protos) {
+    proto_ptrs.push_back(&proto);
+  }
+  EXPECT_FALSE(parseProtosFromFiles(kTestFolder, file_names_, proto_ptrs));
+
+  // A failing function stops the processing as well.
+  EXPECT_FALSE(processFilesWithReadAhead(
+      kTestFolder, file_names_,
+      [](const size_t file_index, const std::string& /*content*/) {
+        return file_index < 3u;
+      },
+      2u));
+}
+
+}  // namespace proto_serialization_helper
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
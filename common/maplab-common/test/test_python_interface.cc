@@ -1,6 +1,9 @@
 #include <limits.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
+
+#include <Eigen/Core>
 
 #include "maplab-common/file-logger.h"
 #include "maplab-common/python-interface.h"
@@ -36,6 +39,64 @@ TEST(TestPythonInterface, SimpleTest) {
   }
 }
 
+void createArrayTestScript(const std::string& filename) {
+  const std::string kTestScript(
+      "import struct                                                  \n"
+      "def column_sums(matrix, sums):                                 \n"
+      "    rows, cols = matrix.shape                                  \n"
+      "    values = struct.unpack('%dd' % (rows * cols),              \n"
+      "                           matrix.tobytes())                   \n"
+      "    for col in range(cols):                                    \n"
+      "        total = sum(values[row * cols + col]                   \n"
+      "                    for row in range(rows))                    \n"
+      "        struct.pack_into('d', sums, 8 * col, total)            \n"
+      "def double_in_place(values):                                   \n"
+      "    for i in range(values.shape[0]):                           \n"
+      "        value = struct.unpack_from('d', values, 8 * i)[0]      \n"
+      "        struct.pack_into('d', values, 8 * i, 2 * value)        \n"
+      "def read_only_flags(matrix, flags):                            \n"
+      "    struct.pack_into('dd', flags, 0, matrix.readonly,          \n"
+      "                     flags.readonly)                           \n");
+
+  FileLogger python_script(filename);
+  python_script << kTestScript;
+}
+
+TEST(TestPythonInterface, ArrayViews) {
+  const std::string kTestScriptFilename("/tmp/test_array_module.py");
+  createArrayTestScript(kTestScriptFilename);
+  PythonInterface interface(kTestScriptFilename);
+
+  Eigen::Matrix3Xd positions(3, 4);
+  positions << 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12;
+  Eigen::VectorXd sums = Eigen::VectorXd::Zero(4);
+  EXPECT_TRUE(
+      interface.callFunction(
+          "column_sums", {PythonArrayView::fromMatrix(positions),
+                          PythonArrayView::fromMutableMatrix(&sums)}));
+  for (int col = 0; col < positions.cols(); ++col) {
+    EXPECT_EQ(sums(col), positions.col(col).sum());
+  }
+
+  Eigen::Vector2d flags = Eigen::Vector2d::Constant(-1.0);
+  EXPECT_TRUE(
+      interface.callFunction(
+          "read_only_flags", {PythonArrayView::fromMatrix(positions),
+                              PythonArrayView::fromMutableMatrix(&flags)}));
+  EXPECT_EQ(flags, Eigen::Vector2d(1.0, 0.0));
+
+  std::vector<Eigen::VectorXd> batch(3u, Eigen::VectorXd::Ones(5));
+  std::vector<std::vector<PythonArrayView>> argument_batches;
+  for (Eigen::VectorXd& values : batch) {
+    argument_batches.emplace_back(
+        1u, PythonArrayView::fromMutableMatrix(&values));
+  }
+  EXPECT_TRUE(interface.callFunctionBatch("double_in_place", argument_batches));
+  for (const Eigen::VectorXd& values : batch) {
+    EXPECT_EQ(values, Eigen::VectorXd::Constant(5, 2.0));
+  }
+}
+
 }  // namespace common
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "maplab-common/ring-buffer-queue.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+TEST(MaplabCommon, RingBufferQueueFifoAndCapacity) {
+  RingBufferQueue<int> queue(3u);
+  EXPECT_EQ(queue.capacity(), 4u);
+  EXPECT_TRUE(queue.Empty());
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.PushNonBlocking(i));
+  }
+  EXPECT_FALSE(queue.PushNonBlocking(4));
+  EXPECT_EQ(queue.Size(), 4u);
+
+  EXPECT_TRUE(queue.PushNonBlockingDroppingOldestElementIfFull(4));
+  for (int expected = 1; expected <= 4; ++expected) {
+    int value;
+    ASSERT_TRUE(queue.PopNonBlocking(&value));
+    EXPECT_EQ(value, expected);
+  }
+  int value;
+  EXPECT_FALSE(queue.PopNonBlocking(&value));
+}
+
+TEST(MaplabCommon, RingBufferQueueMultiProducerMultiConsumer) {
+  constexpr size_t kNumProducers = 4u;
+  constexpr size_t kNumConsumers = 4u;
+  constexpr int kNumValuesPerProducer = 20000;
+  RingBufferQueue<int> queue(16u);
+
+  std::atomic<int64_t> sum(0);
+  std::atomic<int> num_popped(0);
+  std::vector<std::thread> consumers;
+  for (size_t consumer_idx = 0u; consumer_idx < kNumConsumers;
+       ++consumer_idx) {
+    consumers.emplace_back([&]() {
+      int value;
+      while (queue.PopBlocking(&value)) {
+        sum += value;
+        ++num_popped;
+      }
+    });
+  }
+
+  std::vector<std::thread> producers;
+  for (size_t producer_idx = 0u; producer_idx < kNumProducers;
+       ++producer_idx) {
+    producers.emplace_back([&]() {
+      for (int i = 1; i <= kNumValuesPerProducer; ++i) {
+        ASSERT_TRUE(queue.PushBlockingIfFull(i));
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  while (!queue.Empty()) {
+    std::this_thread::yield();
+  }
+  queue.Shutdown();
+  for (std::thread& consumer : consumers) {
+    consumer.join();
+  }
+
+  EXPECT_EQ(
+      num_popped, static_cast<int>(kNumProducers) * kNumValuesPerProducer);
+  const int64_t expected_sum_per_producer =
+      static_cast<int64_t>(kNumValuesPerProducer) *
+      (kNumValuesPerProducer + 1) / 2;
+  EXPECT_EQ(
+      sum, static_cast<int64_t>(kNumProducers) * expected_sum_per_producer);
+}
+
+TEST(MaplabCommon, RingBufferQueuePopTimeout) {
+  RingBufferQueue<int> queue(2u);
+  int value;
+  constexpr int64_t kTimeoutNanoseconds = 1000000;
+  EXPECT_FALSE(queue.PopTimeout(&value, kTimeoutNanoseconds));
+
+  std::thread producer([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    queue.Push(42);
+  });
+  constexpr int64_t kLongTimeoutNanoseconds = 5000000000;
+  EXPECT_TRUE(queue.PopTimeout(&value, kLongTimeoutNanoseconds));
+  EXPECT_EQ(value, 42);
+  producer.join();
+}
+
+TEST(MaplabCommon, RingBufferQueueShutdownUnblocks) {
+  RingBufferQueue<int> queue(1u);
+  EXPECT_EQ(queue.capacity(), 2u);
+  std::thread consumer([&queue]() {
+    int value;
+    EXPECT_FALSE(queue.PopBlocking(&value));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  queue.Shutdown();
+  consumer.join();
+
+  queue.Resume();
+  ASSERT_TRUE(queue.PushNonBlocking(1));
+  ASSERT_TRUE(queue.PushNonBlocking(2));
+  std::thread producer(
+      [&queue]() { EXPECT_FALSE(queue.PushBlockingIfFull(3)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  queue.Shutdown();
+  producer.join();
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
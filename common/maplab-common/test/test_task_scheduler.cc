@@ -0,0 +1,155 @@
+#include <atomic>
+#include <numeric>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/task-scheduler.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+namespace common {
+
+TEST(MaplabCommon, TaskSchedulerParallelForVisitsEveryIndexOnce) {
+  constexpr size_t kNumItems = 10007u;
+  std::vector<std::atomic<int>> visit_counts(kNumItems);
+  for (std::atomic<int>& visit_count : visit_counts) {
+    visit_count = 0;
+  }
+
+  TaskScheduler::instance().parallelFor(
+      0u, kNumItems, TaskScheduler::kAutomaticGrainSize,
+      [&visit_counts](size_t begin, size_t end) {
+        ASSERT_LT(begin, end);
+        for (size_t i = begin; i < end; ++i) {
+          ++visit_counts[i];
+        }
+      });
+  for (const std::atomic<int>& visit_count : visit_counts) {
+    EXPECT_EQ(visit_count, 1);
+  }
+}
+
+TEST(MaplabCommon, TaskSchedulerParallelForRespectsGrainSize) {
+  constexpr size_t kBegin = 5u;
+  constexpr size_t kEnd = 105u;
+  constexpr size_t kGrainSize = 7u;
+  std::atomic<size_t> num_chunks(0u);
+  std::atomic<size_t> num_items(0u);
+  TaskScheduler::instance().parallelFor(
+      kBegin, kEnd, kGrainSize, [&](size_t begin, size_t end) {
+        EXPECT_GE(begin, kBegin);
+        EXPECT_LE(end, kEnd);
+        EXPECT_LE(end - begin, kGrainSize);
+        EXPECT_EQ((begin - kBegin) % kGrainSize, 0u);
+        ++num_chunks;
+        num_items += end - begin;
+      });
+  EXPECT_EQ(num_chunks, (kEnd - kBegin + kGrainSize - 1u) / kGrainSize);
+  EXPECT_EQ(num_items, kEnd - kBegin);
+}
+
+TEST(MaplabCommon, TaskSchedulerParallelReduce) {
+  constexpr size_t kNumItems = 100000u;
+  const size_t sum = TaskScheduler::instance().parallelReduce(
+      0u, kNumItems, TaskScheduler::kAutomaticGrainSize, size_t(0u),
+      [](size_t begin, size_t end) {
+        size_t partial_sum = 0u;
+        for (size_t i = begin; i < end; ++i) {
+          partial_sum += i;
+        }
+        return partial_sum;
+      },
+      [](size_t a, size_t b) { return a + b; });
+  EXPECT_EQ(sum, kNumItems * (kNumItems - 1u) / 2u);
+}
+
+TEST(MaplabCommon, TaskSchedulerNestedParallelism) {
+  // Nested calls must not deadlock even if there are more outer tasks than
+  // workers.
+  TaskScheduler scheduler(2u);
+  constexpr size_t kNumOuter = 16u;
+  constexpr size_t kNumInner = 100u;
+  std::atomic<size_t> num_visits(0u);
+  scheduler.parallelFor(0u, kNumOuter, 1u, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      scheduler.parallelFor(
+          0u, kNumInner, 1u,
+          [&](size_t inner_begin, size_t inner_end) {
+            num_visits += inner_end - inner_begin;
+          });
+    }
+  });
+  EXPECT_EQ(num_visits, kNumOuter * kNumInner);
+}
+
+TEST(MaplabCommon, TaskSchedulerNestedParallelProcess) {
+  constexpr size_t kNumOuter = 32u;
+  constexpr size_t kNumInner = 64u;
+  std::atomic<size_t> num_visits(0u);
+  constexpr bool kAlwaysParallelize = true;
+  ParallelProcess(
+      kNumOuter,
+      [&](const std::vector<size_t>& outer_range) {
+        for (size_t i = 0u; i < outer_range.size(); ++i) {
+          ParallelProcess(
+              kNumInner,
+              [&](const std::vector<size_t>& inner_range) {
+                num_visits += inner_range.size();
+              },
+              kAlwaysParallelize, 8u);
+        }
+      },
+      kAlwaysParallelize, 16u);
+  EXPECT_EQ(num_visits, kNumOuter * kNumInner);
+}
+
+TEST(MaplabCommon, TaskSchedulerWaitingCallerRunsOnlyItsOwnTasks) {
+  TaskScheduler scheduler(1u);
+  std::atomic<bool> worker_blocked(false);
+  std::atomic<bool> foreign_task_queued(false);
+  std::atomic<bool> release(false);
+  const auto wait_for = [](const std::atomic<bool>& flag) {
+    while (!flag) {
+      std::this_thread::yield();
+    }
+  };
+
+  // Keeps the only worker busy. The first task of a call always runs on the
+  // calling thread, so the second one has to be picked up by the worker.
+  std::thread blocking_caller([&]() {
+    scheduler.runAndWait(
+        {[&]() { wait_for(worker_blocked); },
+         [&]() {
+           worker_blocked = true;
+           wait_for(release);
+         }});
+  });
+  wait_for(worker_blocked);
+
+  // Queues a task of another caller, which might e.g. need a lock that the
+  // caller below holds.
+  std::thread::id foreign_task_thread_id;
+  std::thread foreign_caller([&]() {
+    scheduler.runAndWait(
+        {[&]() {
+           foreign_task_queued = true;
+           wait_for(release);
+         },
+         [&]() { foreign_task_thread_id = std::this_thread::get_id(); }});
+  });
+  wait_for(foreign_task_queued);
+
+  size_t num_own_tasks_run = 0u;
+  scheduler.runAndWait(
+      {[&]() { ++num_own_tasks_run; }, [&]() { ++num_own_tasks_run; }});
+  EXPECT_EQ(num_own_tasks_run, 2u);
+
+  release = true;
+  blocking_caller.join();
+  foreign_caller.join();
+  EXPECT_NE(foreign_task_thread_id, std::this_thread::get_id());
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
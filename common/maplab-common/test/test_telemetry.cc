@@ -0,0 +1,125 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "maplab-common/telemetry.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+namespace telemetry {
+
+namespace {
+bool getSummary(const std::string& name, MetricSummary* summary) {
+  CHECK_NOTNULL(summary);
+  std::vector<MetricSummary> summaries;
+  getMetricSummaries(&summaries);
+  for (const MetricSummary& candidate : summaries) {
+    if (candidate.name == name) {
+      *summary = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+TEST(TelemetryTest, AccumulatesSamples) {
+  const Metric metric("Test samples");
+  metric.addSample(2.0);
+  metric.addSample(-1.0);
+  metric.addSample(5.0);
+
+  MetricSummary summary;
+  ASSERT_TRUE(getSummary("Test samples", &summary));
+  EXPECT_EQ(summary.num_samples, 3u);
+  EXPECT_DOUBLE_EQ(summary.sum, 6.0);
+  EXPECT_DOUBLE_EQ(summary.min, -1.0);
+  EXPECT_DOUBLE_EQ(summary.max, 5.0);
+  EXPECT_DOUBLE_EQ(summary.getMean(), 2.0);
+
+  // Registering the name again refers to the same metric.
+  EXPECT_EQ(Metric("Test samples").getIndex(), metric.getIndex());
+}
+
+TEST(TelemetryTest, MergesThreads) {
+  const Metric metric("Test threads");
+  constexpr size_t kNumThreads = 8u;
+  constexpr size_t kNumSamplesPerThread = 10000u;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&metric, thread_idx]() {
+      for (size_t sample_idx = 0u; sample_idx < kNumSamplesPerThread;
+           ++sample_idx) {
+        metric.addSample(static_cast<double>(thread_idx));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // The samples of the exited threads are kept.
+  MetricSummary summary;
+  ASSERT_TRUE(getSummary("Test threads", &summary));
+  EXPECT_EQ(summary.num_samples, kNumThreads * kNumSamplesPerThread);
+  EXPECT_DOUBLE_EQ(
+      summary.sum, kNumSamplesPerThread * kNumThreads * (kNumThreads - 1) / 2);
+  EXPECT_DOUBLE_EQ(summary.min, 0.0);
+  EXPECT_DOUBLE_EQ(summary.max, kNumThreads - 1.0);
+}
+
+TEST(TelemetryTest, Timer) {
+  const Metric metric("Test timer", Metric::Type::kTimer);
+  int64_t elapsed_ns;
+  {
+    ScopedTimer timer(metric);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    elapsed_ns = timer.stop();
+  }
+  EXPECT_GE(elapsed_ns, 2000000);
+
+  MetricSummary summary;
+  ASSERT_TRUE(getSummary("Test timer", &summary));
+  EXPECT_EQ(summary.num_samples, 1u);
+  EXPECT_DOUBLE_EQ(summary.sum, elapsed_ns * 1e-9);
+}
+
+TEST(TelemetryTest, Export) {
+  const Metric metric("Test export: \"quoted\" [ms]");
+  metric.addSample(4.0);
+  const Metric timer_metric("Test export timer", Metric::Type::kTimer);
+  timer_metric.addSample(0.5);
+
+  const std::string prometheus = exportPrometheus();
+  EXPECT_NE(
+      prometheus.find("# TYPE maplab_test_export_quoted_ms summary\n"),
+      std::string::npos);
+  EXPECT_NE(
+      prometheus.find("maplab_test_export_quoted_ms_count 1\n"),
+      std::string::npos);
+  EXPECT_NE(
+      prometheus.find("maplab_test_export_quoted_ms_max 4\n"),
+      std::string::npos);
+  EXPECT_NE(
+      prometheus.find("maplab_test_export_timer_seconds_sum 0.5\n"),
+      std::string::npos);
+
+  const std::string json = exportJson();
+  EXPECT_NE(
+      json.find(
+          "{\"name\": \"Test export: \\\"quoted\\\" [ms]\", \"type\": "
+          "\"statistic\", \"count\": 1, \"sum\": 4, \"min\": 4, \"max\": 4, "
+          "\"mean\": 4}"),
+      std::string::npos);
+  EXPECT_NE(
+      json.find("\"name\": \"Test export timer\", \"type\": \"timer\""),
+      std::string::npos);
+}
+
+}  // namespace telemetry
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <thread>
+#include <vector>
 
 #include <aslam/common/time.h>
+#include <maplab-common/columnar-temporal-buffer.h>
+#include <maplab-common/flat-temporal-buffer.h>
 #include <maplab-common/temporal-buffer.h>
 
 #include "maplab-common/test/testing-entrypoint.h"
@@ -14,6 +18,8 @@ struct TestData {
   int64_t timestamp;
 };
 
+// Runs all tests for all buffer implementations.
+template <typename BufferType>
 class TemporalBufferFixture : public ::testing::Test {
  public:
   TemporalBufferFixture() : buffer_(kBufferLengthNs) {}
@@ -27,212 +33,242 @@ class TemporalBufferFixture : public ::testing::Test {
   }
 
   static constexpr int64_t kBufferLengthNs = 100;
-  TemporalBuffer<TestData> buffer_;
+  BufferType buffer_;
 };
 
-TEST_F(TemporalBufferFixture, SizeEmptyClearWork) {
-  EXPECT_TRUE(buffer_.empty());
-  EXPECT_EQ(buffer_.size(), 0u);
+typedef ::testing::Types<
+    TemporalBuffer<TestData>, FlatTemporalBuffer<TestData>,
+    ColumnarTemporalBuffer<TestData>>
+    TemporalBufferTypes;
+TYPED_TEST_CASE(TemporalBufferFixture, TemporalBufferTypes);
 
-  addValue(TestData(10));
-  addValue(TestData(20));
-  EXPECT_FALSE(buffer_.empty());
-  EXPECT_EQ(buffer_.size(), 2u);
+TYPED_TEST(TemporalBufferFixture, SizeEmptyClearWork) {
+  EXPECT_TRUE(this->buffer_.empty());
+  EXPECT_EQ(this->buffer_.size(), 0u);
 
-  buffer_.clear();
-  EXPECT_TRUE(buffer_.empty());
-  EXPECT_EQ(buffer_.size(), 0u);
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  EXPECT_FALSE(this->buffer_.empty());
+  EXPECT_EQ(this->buffer_.size(), 2u);
+
+  this->buffer_.clear();
+  EXPECT_TRUE(this->buffer_.empty());
+  EXPECT_EQ(this->buffer_.size(), 0u);
 }
 
-TEST_F(TemporalBufferFixture, GetValueAtTimeWorks) {
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
-  addValue(TestData(40));
+TYPED_TEST(TemporalBufferFixture, GetValueAtTimeWorks) {
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  this->addValue(TestData(40));
 
   TestData retrieved_item;
-  EXPECT_TRUE(buffer_.getValueAtTime(10, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getValueAtTime(10, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getValueAtTime(20, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getValueAtTime(20, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 20);
 
-  EXPECT_FALSE(buffer_.getValueAtTime(15, &retrieved_item));
+  EXPECT_FALSE(this->buffer_.getValueAtTime(15, &retrieved_item));
 
-  EXPECT_TRUE(buffer_.getValueAtTime(30, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getValueAtTime(30, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 }
 
-TEST_F(TemporalBufferFixture, GetNearestValueToTimeWorks) {
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
+TYPED_TEST(TemporalBufferFixture, GetNearestValueToTimeWorks) {
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
 
   TestData retrieved_item;
-  EXPECT_TRUE(buffer_.getNearestValueToTime(10, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(10, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(0, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(0, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(16, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(16, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 20);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(26, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(26, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(32, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(32, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(1232, &retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNearestValueToTime(1232, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 }
 
-TEST_F(TemporalBufferFixture, GetNearestValueToTimeMaxDeltaWorks) {
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
+TYPED_TEST(TemporalBufferFixture, GetNearestValueToTimeMaxDeltaWorks) {
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
 
   const int kMaxDelta = 5;
 
   TestData retrieved_item;
-  EXPECT_TRUE(buffer_.getNearestValueToTime(10, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(10, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_FALSE(buffer_.getNearestValueToTime(0, kMaxDelta, &retrieved_item));
+  EXPECT_FALSE(
+      this->buffer_.getNearestValueToTime(0, kMaxDelta, &retrieved_item));
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(9, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(9, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 20);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(26, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(26, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(32, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(32, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 30);
 
-  EXPECT_FALSE(buffer_.getNearestValueToTime(36, kMaxDelta, &retrieved_item));
+  EXPECT_FALSE(
+      this->buffer_.getNearestValueToTime(36, kMaxDelta, &retrieved_item));
 
-  buffer_.clear();
-  addValue(TestData(10));
-  addValue(TestData(20));
+  this->buffer_.clear();
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(9, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(9, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(12, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(12, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 20);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(22, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(22, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 20);
 
-  buffer_.clear();
-  addValue(TestData(10));
+  this->buffer_.clear();
+  this->addValue(TestData(10));
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(6, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(6, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNearestValueToTime(14, kMaxDelta, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getNearestValueToTime(14, kMaxDelta, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_FALSE(buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
+  EXPECT_FALSE(
+      this->buffer_.getNearestValueToTime(16, kMaxDelta, &retrieved_item));
 }
 
-TEST_F(TemporalBufferFixture, GetValueAtOrBeforeTimeWorks) {
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
-  addValue(TestData(40));
+TYPED_TEST(TemporalBufferFixture, GetValueAtOrBeforeTimeWorks) {
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  this->addValue(TestData(40));
 
   TestData retrieved_item;
   int64_t timestamp;
 
-  EXPECT_TRUE(buffer_.getValueAtOrBeforeTime(40, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrBeforeTime(40, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 40);
   EXPECT_EQ(timestamp, 40);
 
-  EXPECT_TRUE(buffer_.getValueAtOrBeforeTime(50, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrBeforeTime(50, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 40);
   EXPECT_EQ(timestamp, 40);
 
-  EXPECT_TRUE(buffer_.getValueAtOrBeforeTime(15, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrBeforeTime(15, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
   EXPECT_EQ(timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getValueAtOrBeforeTime(10, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrBeforeTime(10, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
   EXPECT_EQ(timestamp, 10);
 
-  EXPECT_FALSE(buffer_.getValueAtOrBeforeTime(5, &timestamp, &retrieved_item));
+  EXPECT_FALSE(
+      this->buffer_.getValueAtOrBeforeTime(5, &timestamp, &retrieved_item));
 }
 
-TEST_F(TemporalBufferFixture, GetValueAtOrAfterTimeWorks) {
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
-  addValue(TestData(40));
+TYPED_TEST(TemporalBufferFixture, GetValueAtOrAfterTimeWorks) {
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  this->addValue(TestData(40));
 
   TestData retrieved_item;
   int64_t timestamp;
 
-  EXPECT_TRUE(buffer_.getValueAtOrAfterTime(10, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrAfterTime(10, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
   EXPECT_EQ(timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getValueAtOrAfterTime(5, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrAfterTime(5, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
   EXPECT_EQ(timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getValueAtOrAfterTime(35, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrAfterTime(35, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 40);
   EXPECT_EQ(timestamp, 40);
 
-  EXPECT_TRUE(buffer_.getValueAtOrAfterTime(40, &timestamp, &retrieved_item));
+  EXPECT_TRUE(
+      this->buffer_.getValueAtOrAfterTime(40, &timestamp, &retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 40);
   EXPECT_EQ(timestamp, 40);
 
-  EXPECT_FALSE(buffer_.getValueAtOrAfterTime(45, &timestamp, &retrieved_item));
+  EXPECT_FALSE(
+      this->buffer_.getValueAtOrAfterTime(45, &timestamp, &retrieved_item));
 }
 
-TEST_F(TemporalBufferFixture, GetOldestNewestValueWork) {
+TYPED_TEST(TemporalBufferFixture, GetOldestNewestValueWork) {
   TestData retrieved_item;
-  EXPECT_FALSE(buffer_.getOldestValue(&retrieved_item));
-  EXPECT_FALSE(buffer_.getNewestValue(&retrieved_item));
+  EXPECT_FALSE(this->buffer_.getOldestValue(&retrieved_item));
+  EXPECT_FALSE(this->buffer_.getNewestValue(&retrieved_item));
 
-  addValue(TestData(30));
-  addValue(TestData(10));
-  addValue(TestData(20));
-  addValue(TestData(40));
+  this->addValue(TestData(30));
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  this->addValue(TestData(40));
 
-  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_TRUE(this->buffer_.getOldestValue(&retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 10);
 
-  EXPECT_TRUE(buffer_.getNewestValue(&retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNewestValue(&retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 40);
 }
 
-TEST_F(TemporalBufferFixture, GetValuesBetweenTimesWorks) {
-  addValue(TestData(10));
-  addValue(TestData(20));
-  addValue(TestData(30));
-  addValue(TestData(40));
-  addValue(TestData(50));
+TYPED_TEST(TemporalBufferFixture, GetValuesBetweenTimesWorks) {
+  this->addValue(TestData(10));
+  this->addValue(TestData(20));
+  this->addValue(TestData(30));
+  this->addValue(TestData(40));
+  this->addValue(TestData(50));
 
   // Test aligned borders.
   std::vector<TestData> values;
-  ASSERT_TRUE(buffer_.getValuesBetweenTimes(10, 50, &values));
+  ASSERT_TRUE(this->buffer_.getValuesBetweenTimes(10, 50, &values));
   ASSERT_EQ(values.size(), 3u);
   EXPECT_EQ(values[0].timestamp, 20);
   EXPECT_EQ(values[1].timestamp, 30);
   EXPECT_EQ(values[2].timestamp, 40);
 
   // Test unaligned borders.
-  ASSERT_TRUE(buffer_.getValuesBetweenTimes(15, 45, &values));
+  ASSERT_TRUE(this->buffer_.getValuesBetweenTimes(15, 45, &values));
   ASSERT_EQ(values.size(), 3u);
   EXPECT_EQ(values[0].timestamp, 20);
   EXPECT_EQ(values[1].timestamp, 30);
@@ -240,33 +276,138 @@ TEST_F(TemporalBufferFixture, GetValuesBetweenTimesWorks) {
 
   // Test unsuccessful queries.
   // Lower border oob.
-  ASSERT_FALSE(buffer_.getValuesBetweenTimes(5, 45, &values));
+  ASSERT_FALSE(this->buffer_.getValuesBetweenTimes(5, 45, &values));
   // Higher border oob.
-  ASSERT_FALSE(buffer_.getValuesBetweenTimes(30, 55, &values));
+  ASSERT_FALSE(this->buffer_.getValuesBetweenTimes(30, 55, &values));
   EXPECT_TRUE(values.empty());
 
   // The method should check-fail when the buffer is empty.
-  buffer_.clear();
-  ASSERT_FALSE(buffer_.getValuesBetweenTimes(10, 50, &values));
-  EXPECT_DEATH(buffer_.getValuesBetweenTimes(40, 30, &values), "^");
+  this->buffer_.clear();
+  ASSERT_FALSE(this->buffer_.getValuesBetweenTimes(10, 50, &values));
+  EXPECT_DEATH(this->buffer_.getValuesBetweenTimes(40, 30, &values), "^");
 }
 
-TEST_F(TemporalBufferFixture, MaintaingBufferLengthWorks) {
-  addValue(TestData(0));
-  addValue(TestData(50));
-  addValue(TestData(100));
-  EXPECT_EQ(buffer_.size(), 3u);
+TYPED_TEST(TemporalBufferFixture, MaintaingBufferLengthWorks) {
+  this->addValue(TestData(0));
+  this->addValue(TestData(50));
+  this->addValue(TestData(100));
+  EXPECT_EQ(this->buffer_.size(), 3u);
 
-  addValue(TestData(150));
-  EXPECT_EQ(buffer_.size(), 3u);
+  this->addValue(TestData(150));
+  EXPECT_EQ(this->buffer_.size(), 3u);
 
   TestData retrieved_item;
-  EXPECT_TRUE(buffer_.getOldestValue(&retrieved_item));
+  EXPECT_TRUE(this->buffer_.getOldestValue(&retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 50);
 
-  EXPECT_TRUE(buffer_.getNewestValue(&retrieved_item));
+  EXPECT_TRUE(this->buffer_.getNewestValue(&retrieved_item));
   EXPECT_EQ(retrieved_item.timestamp, 150);
 }
 
+TYPED_TEST(TemporalBufferFixture, OutOfOrderAndDuplicateValuesWork) {
+  this->buffer_.addValue(20, TestData(20));
+  this->buffer_.addValue(40, TestData(40));
+  this->buffer_.addValue(10, TestData(10));
+  this->buffer_.addValue(30, TestData(30));
+  // Adding at an existing timestamp keeps the existing value.
+  this->buffer_.addValue(30, TestData(31));
+  EXPECT_EQ(this->buffer_.size(), 4u);
+
+  TestData retrieved_item;
+  EXPECT_TRUE(this->buffer_.getValueAtTime(30, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 30);
+
+  int64_t previous_timestamp = -1;
+  this->buffer_.lockContainer();
+  for (const typename TypeParam::BufferType::value_type& value :
+       this->buffer_.buffered_values()) {
+    EXPECT_LT(previous_timestamp, value.first);
+    previous_timestamp = value.first;
+  }
+  this->buffer_.unlockContainer();
+
+  EXPECT_TRUE(this->buffer_.deleteValueAtTime(20));
+  EXPECT_FALSE(this->buffer_.deleteValueAtTime(20));
+  EXPECT_EQ(this->buffer_.size(), 3u);
+
+  std::vector<TestData> values;
+  ASSERT_TRUE(this->buffer_.getValuesBetweenTimes(10, 40, &values));
+  ASSERT_EQ(values.size(), 1u);
+  EXPECT_EQ(values[0].timestamp, 30);
+}
+
+TYPED_TEST(TemporalBufferFixture, InsertMergesBuffers) {
+  this->addValue(TestData(10));
+  this->addValue(TestData(30));
+
+  TypeParam other_buffer;
+  other_buffer.addValue(20, TestData(20));
+  other_buffer.addValue(30, TestData(31));
+  other_buffer.addValue(40, TestData(40));
+  this->buffer_.insert(other_buffer);
+  EXPECT_EQ(this->buffer_.size(), 4u);
+
+  TestData retrieved_item;
+  EXPECT_TRUE(this->buffer_.getValueAtTime(20, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 20);
+  EXPECT_TRUE(this->buffer_.getValueAtTime(30, &retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 30);
+  EXPECT_TRUE(this->buffer_.getNewestValue(&retrieved_item));
+  EXPECT_EQ(retrieved_item.timestamp, 40);
+}
+
+TEST(ColumnarTemporalBufferTest, BatchQueriesMatchSingleQueries) {
+  ColumnarTemporalBuffer<TestData> buffer;
+  for (int64_t timestamp = 10; timestamp <= 100; timestamp += 10) {
+    buffer.addValue(timestamp, TestData(timestamp));
+  }
+  ASSERT_EQ(buffer.timestamps().size(), buffer.values().size());
+
+  constexpr int64_t kMaximumDeltaNs = 3;
+  const std::vector<int64_t> sorted_queries = {0, 9, 15, 20, 54, 56, 101, 200};
+  std::vector<int64_t> unsorted_queries = sorted_queries;
+  std::reverse(unsorted_queries.begin(), unsorted_queries.end());
+  for (const std::vector<int64_t>& queries :
+       {sorted_queries, unsorted_queries}) {
+    std::vector<int> nearest_indices;
+    buffer.getNearestIndicesToTimes(queries, kMaximumDeltaNs, &nearest_indices);
+    std::vector<int> at_or_before_indices;
+    buffer.getIndicesAtOrBeforeTimes(queries, &at_or_before_indices);
+    ASSERT_EQ(nearest_indices.size(), queries.size());
+    ASSERT_EQ(at_or_before_indices.size(), queries.size());
+
+    for (size_t i = 0u; i < queries.size(); ++i) {
+      TestData value;
+      if (buffer.getNearestValueToTime(queries[i], kMaximumDeltaNs, &value)) {
+        ASSERT_NE(nearest_indices[i], buffer.kInvalidIndex);
+        EXPECT_EQ(buffer.timestamps()[nearest_indices[i]], value.timestamp);
+      } else {
+        EXPECT_EQ(nearest_indices[i], buffer.kInvalidIndex);
+      }
+
+      int64_t timestamp_of_value;
+      if (buffer.getValueAtOrBeforeTime(
+              queries[i], &timestamp_of_value, &value)) {
+        ASSERT_NE(at_or_before_indices[i], buffer.kInvalidIndex);
+        EXPECT_EQ(
+            buffer.timestamps()[at_or_before_indices[i]], timestamp_of_value);
+      } else {
+        EXPECT_EQ(at_or_before_indices[i], buffer.kInvalidIndex);
+      }
+    }
+  }
+
+  size_t begin_index, end_index;
+  EXPECT_EQ(
+      buffer.getIndexRangeInTimeInterval(20, 50, &begin_index, &end_index), 4u);
+  EXPECT_EQ(begin_index, 1u);
+  EXPECT_EQ(end_index, 5u);
+  EXPECT_EQ(
+      buffer.getIndexRangeInTimeInterval(21, 29, &begin_index, &end_index), 0u);
+  EXPECT_EQ(
+      buffer.getIndexRangeInTimeInterval(0, 1000, &begin_index, &end_index),
+      buffer.size());
+}
+
 }  // namespace common
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <maplab-common/task-scheduler.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/thread-topology.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace common {
+
+TEST(MaplabCommon, ThreadTopologyParseCpuList) {
+  CpuList cpus;
+  ASSERT_TRUE(parseCpuList("8,0-3,10-11,2", &cpus));
+  EXPECT_EQ(CpuList({0, 1, 2, 3, 8, 10, 11}), cpus);
+  ASSERT_TRUE(parseCpuList("", &cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_FALSE(parseCpuList("3-1", &cpus));
+  EXPECT_FALSE(parseCpuList("a", &cpus));
+  EXPECT_FALSE(parseCpuList("1:2", &cpus));
+}
+
+TEST(MaplabCommon, ThreadTopologyNumaNodesPartitionWorkerCpus) {
+  const ThreadTopology& topology = ThreadTopology::instance();
+  ASSERT_FALSE(topology.getWorkerCpus().empty());
+  EXPECT_EQ(topology.getWorkerCpus().size(), getNumHardwareThreads());
+  ASSERT_GT(topology.getNumNumaNodes(), 0u);
+
+  CpuList node_cpus;
+  for (size_t node_idx = 0u; node_idx < topology.getNumNumaNodes();
+       ++node_idx) {
+    const CpuList& cpus = topology.getNumaNodeCpus(node_idx);
+    EXPECT_FALSE(cpus.empty());
+    node_cpus.insert(node_cpus.end(), cpus.begin(), cpus.end());
+  }
+  std::sort(node_cpus.begin(), node_cpus.end());
+  EXPECT_EQ(topology.getWorkerCpus(), node_cpus);
+  EXPECT_TRUE(topology.getStageCpus("unknown_stage").empty());
+}
+
+TEST(MaplabCommon, ThreadTopologyScopedAffinityIsRestored) {
+  CpuList initial_cpus;
+  if (!getCurrentThreadAffinity(&initial_cpus)) {
+    return;
+  }
+  const CpuList single_cpu(1u, initial_cpus.front());
+  {
+    ScopedThreadAffinity pinning(single_cpu);
+    CpuList cpus;
+    ASSERT_TRUE(getCurrentThreadAffinity(&cpus));
+    EXPECT_EQ(single_cpu, cpus);
+  }
+  CpuList cpus;
+  ASSERT_TRUE(getCurrentThreadAffinity(&cpus));
+  EXPECT_EQ(initial_cpus, cpus);
+}
+
+TEST(MaplabCommon, ThreadTopologyNumaNodeSchedulerRunsOnNode) {
+  const CpuList& node_cpus = ThreadTopology::instance().getNumaNodeCpus(0u);
+  TaskScheduler& scheduler = TaskScheduler::instanceForNumaNode(0u);
+  EXPECT_EQ(node_cpus.size(), scheduler.getNumWorkers());
+
+  constexpr size_t kNumItems = 1000u;
+  std::atomic<size_t> num_items_off_node(0u);
+  runOnNumaNode(0u, [&]() {
+    constexpr size_t kGrainSize = 10u;
+    scheduler.parallelFor(
+        0u, kNumItems, kGrainSize, [&](size_t begin, size_t end) {
+          CpuList cpus;
+          if (getCurrentThreadAffinity(&cpus) &&
+              !std::includes(
+                  node_cpus.begin(), node_cpus.end(), cpus.begin(),
+                  cpus.end())) {
+            num_items_off_node += end - begin;
+          }
+        });
+  });
+  EXPECT_EQ(0u, num_items_off_node);
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,59 @@
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "maplab-common/test/testing-entrypoint.h"
+#include "maplab-common/unique-id.h"
+
+namespace common {
+UNIQUE_ID_DEFINE_ID(TestId);
+}  // namespace common
+UNIQUE_ID_DEFINE_ID_HASH(common::TestId);
+
+namespace common {
+
+TEST(UniqueIdTest, IdsOfConcurrentThreadsAreUnique) {
+  constexpr size_t kNumThreads = 8u;
+  constexpr size_t kNumIdsPerThread = 20000u;
+  TestIdSet ids;
+  std::mutex m_ids;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&ids, &m_ids, thread_idx]() {
+      TestIdList thread_ids(kNumIdsPerThread);
+      // Half of the threads generate the ids in bulk.
+      if (thread_idx % 2u == 0u) {
+        for (TestId& id : thread_ids) {
+          generateId(&id);
+        }
+      } else {
+        generateIds(kNumIdsPerThread, &thread_ids);
+      }
+      std::lock_guard<std::mutex> lock(m_ids);
+      ids.insert(thread_ids.begin(), thread_ids.end());
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(ids.size(), kNumThreads * kNumIdsPerThread);
+  for (const TestId& id : ids) {
+    EXPECT_TRUE(id.isValid());
+  }
+}
+
+TEST(UniqueIdTest, GenerateIdsResizesList) {
+  TestIdList ids(3u);
+  generateIds(5u, &ids);
+  ASSERT_EQ(ids.size(), 5u);
+  EXPECT_NE(ids[0], ids[1]);
+  generateIds(0u, &ids);
+  EXPECT_TRUE(ids.empty());
+}
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
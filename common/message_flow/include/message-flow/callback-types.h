@@ -11,5 +11,9 @@ template <typename MessageTopicDefinition>
 using PublisherFunction = MessageCallback<MessageTopicDefinition>;
 template <typename MessageTopicDefinition>
 using SubscriberCallback = MessageCallback<MessageTopicDefinition>;
+// Publisher that takes ownership of the message instead of copying it.
+template <typename MessageTopicDefinition>
+using MovingPublisherFunction =
+    std::function<void(typename MessageTopicDefinition::message_type&&)>;
 }  // namespace message_flow
 #endif  // MESSAGE_FLOW_CALLBACK_TYPES_H_
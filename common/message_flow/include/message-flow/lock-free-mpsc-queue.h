@@ -0,0 +1,98 @@
+#ifndef MESSAGE_FLOW_LOCK_FREE_MPSC_QUEUE_H_
+#define MESSAGE_FLOW_LOCK_FREE_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace message_flow {
+// Unbounded multi-producer/single-consumer queue based on the intrusive
+// node-based design of D. Vyukov. Producers never block and never wait on each
+// other: a push consists of one atomic exchange and one atomic store.
+// Only a single thread may pop at any time; the caller has to guarantee the
+// single-consumer property.
+template <typename ValueType>
+class LockFreeMpscQueue {
+ public:
+  LockFreeMpscQueue() : head_(new Node), tail_(head_.load()), size_(0u) {}
+
+  ~LockFreeMpscQueue() {
+    ValueType value;
+    while (popNonBlocking(&value)) {
+    }
+    CHECK_NOTNULL(tail_);
+    delete tail_;
+  }
+
+  LockFreeMpscQueue(const LockFreeMpscQueue&) = delete;
+  LockFreeMpscQueue& operator=(const LockFreeMpscQueue&) = delete;
+
+  // Can be called concurrently from any number of threads.
+  void push(const ValueType& value) {
+    pushNode(new Node(value));
+  }
+  void push(ValueType&& value) {
+    pushNode(new Node(std::move(value)));
+  }
+
+  // Must only be called from a single thread at a time. Returns false if the
+  // queue is empty.
+  bool popNonBlocking(ValueType* value) {
+    CHECK_NOTNULL(value);
+    Node* const tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      if (size_.load(std::memory_order_acquire) == 0u) {
+        return false;
+      }
+      // A producer has claimed its slot but not linked its node yet. This
+      // window only spans two instructions on the producer side.
+      while ((next = tail->next.load(std::memory_order_acquire)) == nullptr) {
+        std::this_thread::yield();
+      }
+    }
+    *value = std::move(next->value);
+    tail_ = next;
+    delete tail;
+    size_.fetch_sub(1u, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate number of elements; exact if no push/pop is in flight.
+  size_t size() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  bool empty() const {
+    return size() == 0u;
+  }
+
+ private:
+  struct Node {
+    Node() : next(nullptr) {}
+    explicit Node(const ValueType& _value) : value(_value), next(nullptr) {}
+    explicit Node(ValueType&& _value)
+        : value(std::move(_value)), next(nullptr) {}
+    ValueType value;
+    std::atomic<Node*> next;
+  };
+
+  void pushNode(Node* node) {
+    CHECK_NOTNULL(node);
+    // Count the element before it becomes visible such that the counter never
+    // underflows on the consumer side.
+    size_.fetch_add(1u, std::memory_order_release);
+    Node* const previous_head = head_.exchange(node, std::memory_order_acq_rel);
+    previous_head->next.store(node, std::memory_order_release);
+  }
+
+  // Producers append at the head, the consumer removes at the tail. The tail
+  // always points to a stub node whose value has already been consumed.
+  std::atomic<Node*> head_;
+  Node* tail_;
+  std::atomic<size_t> size_;
+};
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_LOCK_FREE_MPSC_QUEUE_H_
@@ -1,20 +1,72 @@
 #ifndef MESSAGE_FLOW_MESSAGE_DELIVERY_QUEUE_H_
 #define MESSAGE_FLOW_MESSAGE_DELIVERY_QUEUE_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <aslam/common/statistics/statistics.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/unique-id.h>
 
+#include "message-flow/lock-free-mpsc-queue.h"
+#include "message-flow/message-envelope.h"
+
+DECLARE_bool(message_flow_collect_statistics);
+
 namespace message_flow {
 UNIQUE_ID_DEFINE_ID(MessageDeliveryQueueId);
 
+// Storage backend of the per-subscriber delivery queue.
+//  - kMutexDeque: std::deque protected by a mutex.
+//  - kLockFreeMpsc: lock-free multi-producer/single-consumer queue. Publishers
+//    never block on the queue, which avoids contention and jitter on
+//    high-rate topics such as IMU measurements.
+enum class DeliveryQueueType { kMutexDeque, kLockFreeMpsc };
+
+// Defines what happens if a message is published to a full bounded queue.
+//  - kDropOldest: the oldest undelivered message is discarded.
+//  - kDropNewest: the newly published message is discarded.
+//  - kBlockPublisher: the publisher blocks until the subscriber has consumed a
+//    message. Note that this can deadlock if the publishing thread is needed
+//    to drain the queue, e.g. if all dispatcher threads are blocked.
+enum class QueueOverflowPolicy { kDropOldest, kDropNewest, kBlockPublisher };
+
+// Scheduling class of a subscriber. The FIFO dispatcher runs the deliveries of
+// each class on its own workers, so real-time subscribers such as the IMU
+// input of the estimator never wait behind bulk work such as map building or
+// visualization.
+//  - kRealTime: short callbacks on the latency critical estimator path.
+//  - kNormal: everything else.
+//  - kBulk: long running or latency tolerant callbacks.
+enum class DeliveryPriority : size_t { kRealTime = 0, kNormal, kBulk };
+constexpr size_t kNumDeliveryPriorities = 3u;
+
 struct DeliveryOptions {
-  DeliveryOptions() : exclusivity_group_id(-1) {}
+  DeliveryOptions()
+      : exclusivity_group_id(-1),
+        queue_type(DeliveryQueueType::kMutexDeque),
+        queue_capacity(0u),
+        overflow_policy(QueueOverflowPolicy::kDropOldest),
+        priority(DeliveryPriority::kNormal) {}
+
+  // Only the most recent message is kept for delivery. Suited for subscribers
+  // such as visualizations where stale messages have no value.
+  static DeliveryOptions latestOnly() {
+    DeliveryOptions delivery_options;
+    delivery_options.queue_capacity = 1u;
+    delivery_options.overflow_policy = QueueOverflowPolicy::kDropOldest;
+    return delivery_options;
+  }
+
   // Ensures the exclusive execution of deliveries across all subscribers with
   // the same group id. With a FIFO message dispatcher, this will expand the
   // delivery order guarantees across multiple subscribers. I.e. not only all
@@ -22,7 +74,19 @@ struct DeliveryOptions {
   // but also all messages to subscribers with the same exclusivity id will be
   // delivered in the publishing order.
   // A negative value means no exclusivity is enforced.
+  // All subscribers of a group must have the same priority, as the classes
+  // are dispatched independently.
   int exclusivity_group_id;
+
+  DeliveryQueueType queue_type;
+
+  // Maximum number of undelivered messages; zero means unbounded. The lock-free
+  // queue type only supports the kDropNewest policy and enforces the capacity
+  // approximately under concurrent publishing.
+  size_t queue_capacity;
+  QueueOverflowPolicy overflow_policy;
+
+  DeliveryPriority priority;
 };
 
 class MessageDeliveryQueueBase {
@@ -32,43 +96,169 @@ class MessageDeliveryQueueBase {
   virtual std::string getTopicName() const = 0;
   virtual const DeliveryOptions& getDeliveryOptions() const = 0;
   virtual size_t size() const = 0;
+  virtual size_t getNumDroppedMessages() const = 0;
 };
 typedef std::shared_ptr<MessageDeliveryQueueBase> MessageDeliveryQueueBasePtr;
 
+// Collects the publish-to-delivery latency, the callback execution time and
+// the queue depth of a delivery queue. The samples are accumulated in
+// statistics::Statistics under the name of the subscriber and topic.
+class DeliveryQueueStatistics {
+ public:
+  DeliveryQueueStatistics(
+      const std::string& subscriber_node_name, const std::string& topic_name)
+      : delivery_latency_ms_(
+            "message_flow/" + subscriber_node_name + "/" + topic_name +
+            " publish-to-delivery latency [ms]"),
+        callback_time_ms_(
+            "message_flow/" + subscriber_node_name + "/" + topic_name +
+            " callback execution time [ms]"),
+        queue_depth_(
+            "message_flow/" + subscriber_node_name + "/" + topic_name +
+            " queue depth") {}
+
+  static int64_t getCurrentTimestampNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void addQueueDepthSample(size_t queue_depth) {
+    queue_depth_.AddSample(static_cast<double>(queue_depth));
+  }
+  void addDeliverySample(
+      int64_t publish_timestamp_ns, int64_t delivery_start_ns,
+      int64_t delivery_end_ns) {
+    constexpr double kNanosecondsToMilliseconds = 1e-6;
+    delivery_latency_ms_.AddSample(
+        (delivery_start_ns - publish_timestamp_ns) *
+        kNanosecondsToMilliseconds);
+    callback_time_ms_.AddSample(
+        (delivery_end_ns - delivery_start_ns) * kNanosecondsToMilliseconds);
+  }
+
+ private:
+  statistics::StatsCollector delivery_latency_ms_;
+  statistics::StatsCollector callback_time_ms_;
+  statistics::StatsCollector queue_depth_;
+};
+
 // Maintains a list of messages scheduled for delivery to a specific subscriber.
+// The queue only holds the message envelopes; value type messages are shared
+// with all other subscribers of the topic.
 template <typename MessageTopicDefinition>
 class MessageDeliveryQueue : public MessageDeliveryQueueBase {
  public:
   typedef typename MessageTopicDefinition::message_type MessageType;
+  typedef MessageEnvelopeType<MessageType> EnvelopeType;
   typedef std::function<void(const MessageType&)> SubscriberCallback;
 
   MessageDeliveryQueue(
+      const std::string& subscriber_node_name,
       const SubscriberCallback& subscriber_callback,
       const DeliveryOptions& delivery_options)
       : delivery_options_(delivery_options),
+        num_dropped_messages_(0u),
         subscriber_callback_(subscriber_callback) {
     CHECK(subscriber_callback);
+    if (delivery_options_.queue_type == DeliveryQueueType::kLockFreeMpsc &&
+        delivery_options_.queue_capacity > 0u) {
+      CHECK(
+          delivery_options_.overflow_policy ==
+          QueueOverflowPolicy::kDropNewest)
+          << "Bounded lock-free delivery queues only support the drop-newest "
+          << "overflow policy.";
+    }
+    if (FLAGS_message_flow_collect_statistics) {
+      statistics_.reset(
+          new DeliveryQueueStatistics(
+              subscriber_node_name, MessageTopicDefinition::kMessageTopic));
+    }
   }
   virtual ~MessageDeliveryQueue() {}
 
-  void queueMessageForDelivery(const MessageType& message) {
-    std::lock_guard<std::mutex> lock(m_message_queue_);
-    message_queue_.emplace_back(message);
+  // Returns false if the message was rejected because the queue is full; in
+  // that case the dispatcher must not be signaled.
+  bool queueMessageForDelivery(const EnvelopeType& envelope) {
+    QueuedMessage queued_message;
+    queued_message.envelope = envelope;
+    if (statistics_) {
+      queued_message.publish_timestamp_ns =
+          DeliveryQueueStatistics::getCurrentTimestampNanoseconds();
+    }
+
+    const size_t capacity = delivery_options_.queue_capacity;
+    size_t queue_depth;
+    if (delivery_options_.queue_type == DeliveryQueueType::kLockFreeMpsc) {
+      if (capacity > 0u && lock_free_message_queue_.size() >= capacity) {
+        ++num_dropped_messages_;
+        return false;
+      }
+      lock_free_message_queue_.push(std::move(queued_message));
+      queue_depth = lock_free_message_queue_.size();
+    } else {
+      std::unique_lock<std::mutex> lock(m_message_queue_);
+      if (capacity > 0u && message_queue_.size() >= capacity) {
+        switch (delivery_options_.overflow_policy) {
+          case QueueOverflowPolicy::kDropOldest:
+            while (message_queue_.size() >= capacity) {
+              message_queue_.pop_front();
+              ++num_dropped_messages_;
+            }
+            break;
+          case QueueOverflowPolicy::kDropNewest:
+            ++num_dropped_messages_;
+            return false;
+          case QueueOverflowPolicy::kBlockPublisher:
+            cv_queue_not_full_.wait(lock, [this, capacity]() {
+              return message_queue_.size() < capacity;
+            });
+            break;
+          default:
+            LOG(FATAL) << "Unknown overflow policy.";
+        }
+      }
+      message_queue_.emplace_back(std::move(queued_message));
+      queue_depth = message_queue_.size();
+    }
+    if (statistics_) {
+      statistics_->addQueueDepthSample(queue_depth);
+    }
+    return true;
   }
 
+  // Delivers the oldest message if there is any. With the drop-oldest policy
+  // the dispatcher can be signaled for messages that have been dropped in the
+  // meantime; such calls simply return.
   void deliverOldestMessage() final {
-    MessageType message;
+    QueuedMessage message;
+    if (delivery_options_.queue_type == DeliveryQueueType::kLockFreeMpsc) {
+      // The subscriber lock is taken before popping, which makes this thread
+      // the single consumer of the lock-free queue.
+      std::lock_guard<std::mutex> lock_subscriber(m_subscriber_execution_);
+      if (lock_free_message_queue_.popNonBlocking(&message)) {
+        runSubscriberCallback(message);
+      }
+      return;
+    }
+
     {
       std::lock_guard<std::mutex> lock(m_message_queue_);
-      CHECK(!message_queue_.empty());
-      message = message_queue_.front();
+      if (message_queue_.empty()) {
+        return;
+      }
+      message = std::move(message_queue_.front());
       message_queue_.pop_front();
     }
+    if (delivery_options_.overflow_policy ==
+        QueueOverflowPolicy::kBlockPublisher) {
+      cv_queue_not_full_.notify_one();
+    }
 
     // Run the subscriber callback; the lock ensures only one callback can be
     // run simultaneously.
     std::lock_guard<std::mutex> lock_subscriber(m_subscriber_execution_);
-    subscriber_callback_(message);
+    runSubscriberCallback(message);
   }
 
   std::string getTopicName() const final {
@@ -80,17 +270,54 @@ class MessageDeliveryQueue : public MessageDeliveryQueueBase {
   }
 
   bool empty() const {
+    if (delivery_options_.queue_type == DeliveryQueueType::kLockFreeMpsc) {
+      return lock_free_message_queue_.empty();
+    }
     std::lock_guard<std::mutex> lock(m_message_queue_);
     return message_queue_.empty();
   }
 
   virtual size_t size() const {
+    if (delivery_options_.queue_type == DeliveryQueueType::kLockFreeMpsc) {
+      return lock_free_message_queue_.size();
+    }
     std::lock_guard<std::mutex> lock(m_message_queue_);
     return message_queue_.size();
   }
 
+  virtual size_t getNumDroppedMessages() const {
+    return num_dropped_messages_.load();
+  }
+
  private:
+  struct QueuedMessage {
+    QueuedMessage() : publish_timestamp_ns(0) {}
+    EnvelopeType envelope;
+    // Only set if statistics are collected.
+    int64_t publish_timestamp_ns;
+  };
+
+  // Must be called with m_subscriber_execution_ locked.
+  void runSubscriberCallback(const QueuedMessage& message) {
+    const MessageType& payload =
+        MessageEnvelope<MessageType>::unwrap(message.envelope);
+    if (!statistics_) {
+      subscriber_callback_(payload);
+      return;
+    }
+    const int64_t delivery_start_ns =
+        DeliveryQueueStatistics::getCurrentTimestampNanoseconds();
+    subscriber_callback_(payload);
+    statistics_->addDeliverySample(
+        message.publish_timestamp_ns, delivery_start_ns,
+        DeliveryQueueStatistics::getCurrentTimestampNanoseconds());
+  }
+
   const DeliveryOptions delivery_options_;
+  std::atomic<size_t> num_dropped_messages_;
+
+  // Only allocated if --message_flow_collect_statistics is enabled.
+  std::unique_ptr<DeliveryQueueStatistics> statistics_;
 
   // Protects the callback to prevent concurrent calls to the subscriber
   // callback.
@@ -98,7 +325,11 @@ class MessageDeliveryQueue : public MessageDeliveryQueueBase {
   const SubscriberCallback subscriber_callback_;
 
   mutable std::mutex m_message_queue_;
-  std::deque<MessageType> message_queue_;
+  std::condition_variable cv_queue_not_full_;
+  std::deque<QueuedMessage> message_queue_;
+
+  // Only used if the queue type is kLockFreeMpsc.
+  LockFreeMpscQueue<QueuedMessage> lock_free_message_queue_;
 };
 }  // namespace message_flow
 UNIQUE_ID_DEFINE_ID_HASH(message_flow::MessageDeliveryQueueId);
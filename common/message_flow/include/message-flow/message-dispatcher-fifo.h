@@ -1,20 +1,44 @@
 #ifndef MESSAGE_FLOW_MESSAGE_DISPATCHER_FIFO_H_
 #define MESSAGE_FLOW_MESSAGE_DISPATCHER_FIFO_H_
 
+#include <array>
 #include <deque>
+#include <memory>
 
 #include <aslam/common/thread-pool.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "message-flow/message-delivery-queue.h"
 #include "message-flow/message-dispatcher.h"
 
+DECLARE_uint64(message_flow_fifo_realtime_num_threads);
+DECLARE_uint64(message_flow_fifo_bulk_num_threads);
+
 namespace message_flow {
-// A thread pool delivers the published messages in incoming order.
+// A thread pool delivers the published messages in incoming order. Each
+// delivery priority can get its own pool; messages of a priority without own
+// workers go to the pool of the normal priority.
 class MessageDispatcherFifo : public MessageDispatcher {
  public:
+  // The number of threads is the budget of the normal priority; the other
+  // priorities get the number of threads set by the flags.
   explicit MessageDispatcherFifo(size_t num_threads)
-      : thread_pool_(num_threads) {}
+      : MessageDispatcherFifo(
+            num_threads, FLAGS_message_flow_fifo_realtime_num_threads,
+            FLAGS_message_flow_fifo_bulk_num_threads) {}
+
+  // Zero threads for the real-time or bulk priority makes it share the pool of
+  // the normal priority.
+  MessageDispatcherFifo(
+      size_t num_normal_threads, size_t num_realtime_threads,
+      size_t num_bulk_threads) {
+    CHECK_GT(num_normal_threads, 0u);
+    const size_t kNormal = static_cast<size_t>(DeliveryPriority::kNormal);
+    thread_pools_[kNormal].reset(new aslam::ThreadPool(num_normal_threads));
+    createPoolOrShareNormal(DeliveryPriority::kRealTime, num_realtime_threads);
+    createPoolOrShareNormal(DeliveryPriority::kBulk, num_bulk_threads);
+  }
 
   virtual ~MessageDispatcherFifo() {
     shutdown();
@@ -22,35 +46,51 @@ class MessageDispatcherFifo : public MessageDispatcher {
 
   virtual void newMessageInQueue(const MessageDeliveryQueueBasePtr& queue) {
     CHECK(queue);
-    const DeliveryOptions& delivery_options = queue->getDeliveryOptions();
-    size_t exclusivity_group_id;
-    if (delivery_options.exclusivity_group_id < 0) {
-      // If no external exclusivity is specified, we derive it from the queue.
-      // This means that the messages for each subscriber are delivered in the
-      // same order as published i.e. only a single thread can work on a queue
-      // at the same time.
-      // Theoretically, we could collide with manually specified IDs, the
-      // chances are pretty low though.
-      exclusivity_group_id = reinterpret_cast<size_t>(queue.get());
-    } else {
-      exclusivity_group_id = delivery_options.exclusivity_group_id;
-    }
-    thread_pool_.enqueueOrdered(
-        exclusivity_group_id,
-        std::bind(
-            &MessageDeliveryQueueBase::deliverOldestMessage, queue.get()));
+    const size_t exclusivity_group_id = getExclusivityGroupId(queue);
+    getThreadPool(queue->getDeliveryOptions().priority)
+        .enqueueOrdered(
+            exclusivity_group_id,
+            std::bind(
+                &MessageDeliveryQueueBase::deliverOldestMessage, queue.get()));
   }
 
   virtual void shutdown() {
-    thread_pool_.stop();
+    for (const std::shared_ptr<aslam::ThreadPool>& thread_pool :
+         thread_pools_) {
+      thread_pool->stop();
+    }
   }
 
   virtual void waitUntilIdle() const {
-    thread_pool_.waitForEmptyQueue();
+    for (const std::shared_ptr<aslam::ThreadPool>& thread_pool :
+         thread_pools_) {
+      thread_pool->waitForEmptyQueue();
+    }
   }
 
  private:
-  aslam::ThreadPool thread_pool_;
+  void createPoolOrShareNormal(
+      const DeliveryPriority priority, const size_t num_threads) {
+    const size_t kNormal = static_cast<size_t>(DeliveryPriority::kNormal);
+    std::shared_ptr<aslam::ThreadPool>& thread_pool =
+        thread_pools_[static_cast<size_t>(priority)];
+    if (num_threads > 0u) {
+      thread_pool.reset(new aslam::ThreadPool(num_threads));
+    } else {
+      thread_pool = thread_pools_[kNormal];
+    }
+  }
+
+  aslam::ThreadPool& getThreadPool(const DeliveryPriority priority) {
+    const size_t priority_idx = static_cast<size_t>(priority);
+    CHECK_LT(priority_idx, kNumDeliveryPriorities);
+    return *thread_pools_[priority_idx];
+  }
+
+  // Indexed by the priority. Pools are shared by priorities without own
+  // workers.
+  std::array<std::shared_ptr<aslam::ThreadPool>, kNumDeliveryPriorities>
+      thread_pools_;
 };
 }  // namespace message_flow
 #endif  // MESSAGE_FLOW_MESSAGE_DISPATCHER_FIFO_H_
@@ -0,0 +1,72 @@
+#ifndef MESSAGE_FLOW_MESSAGE_DISPATCHER_WORK_STEALING_H_
+#define MESSAGE_FLOW_MESSAGE_DISPATCHER_WORK_STEALING_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "message-flow/message-delivery-queue.h"
+#include "message-flow/message-dispatcher.h"
+
+namespace message_flow {
+// Delivers the published messages using a pool of workers with one local run
+// queue each. The unit of scheduling is an exclusivity group: a group is
+// present in at most one run queue at any time and is only executed by a
+// single worker at once, which preserves the per-group delivery order of the
+// FIFO dispatcher. Workers that run out of local work steal groups from the
+// other workers, so a slow subscriber only holds up its own group.
+class MessageDispatcherWorkStealing : public MessageDispatcher {
+ public:
+  explicit MessageDispatcherWorkStealing(size_t num_threads);
+  virtual ~MessageDispatcherWorkStealing();
+
+  virtual void newMessageInQueue(const MessageDeliveryQueueBasePtr& queue);
+  virtual void shutdown();
+  virtual void waitUntilIdle() const;
+
+ private:
+  struct ExclusivityGroup {
+    ExclusivityGroup() : is_scheduled(false) {}
+    // Queues with a pending delivery in publishing order.
+    std::deque<MessageDeliveryQueueBasePtr> pending_deliveries;
+    // True if the group is in a run queue or being executed by a worker.
+    bool is_scheduled;
+  };
+
+  struct WorkerRunQueue {
+    std::mutex m_group_ids;
+    std::deque<size_t> group_ids;
+  };
+
+  void workerLoop(size_t worker_index);
+  bool popOrStealGroup(size_t worker_index, size_t* group_id);
+  void runOneDeliveryOfGroup(size_t worker_index, size_t group_id);
+  void scheduleGroup(size_t worker_index, size_t group_id);
+
+  // Returns the index of the calling worker or the next worker in round-robin
+  // order if called from a thread outside of this dispatcher.
+  size_t getWorkerIndexForScheduling();
+
+  std::mutex m_exclusivity_groups_;
+  std::unordered_map<size_t, ExclusivityGroup> exclusivity_groups_;
+
+  std::vector<std::unique_ptr<WorkerRunQueue>> run_queues_;
+  std::atomic<size_t> next_round_robin_worker_;
+
+  // Protects the counters below and is used to park idle workers.
+  mutable std::mutex m_worker_state_;
+  std::condition_variable cv_work_available_;
+  mutable std::condition_variable cv_idle_;
+  size_t num_scheduled_groups_;
+  size_t num_outstanding_deliveries_;
+  bool shutdown_requested_;
+
+  std::vector<std::thread> workers_;
+};
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_MESSAGE_DISPATCHER_WORK_STEALING_H_
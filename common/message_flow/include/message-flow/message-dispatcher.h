@@ -2,6 +2,9 @@
 #define MESSAGE_FLOW_MESSAGE_DISPATCHER_H_
 
 #include <atomic>
+#include <memory>
+
+#include <glog/logging.h>
 
 #include "message-flow/message-delivery-queue.h"
 
@@ -20,5 +23,22 @@ class MessageDispatcher {
   virtual void waitUntilIdle() const = 0;
 };
 typedef std::shared_ptr<MessageDispatcher> MessageDispatcherPtr;
+
+// Returns the id of the group whose deliveries must be executed exclusively
+// and in publishing order.
+inline size_t getExclusivityGroupId(const MessageDeliveryQueueBasePtr& queue) {
+  CHECK(queue);
+  const DeliveryOptions& delivery_options = queue->getDeliveryOptions();
+  if (delivery_options.exclusivity_group_id < 0) {
+    // If no external exclusivity is specified, we derive it from the queue.
+    // This means that the messages for each subscriber are delivered in the
+    // same order as published i.e. only a single thread can work on a queue
+    // at the same time.
+    // Theoretically, we could collide with manually specified IDs, the
+    // chances are pretty low though.
+    return reinterpret_cast<size_t>(queue.get());
+  }
+  return static_cast<size_t>(delivery_options.exclusivity_group_id);
+}
 }  // namespace message_flow
 #endif  // MESSAGE_FLOW_MESSAGE_DISPATCHER_H_
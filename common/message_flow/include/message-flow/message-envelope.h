@@ -0,0 +1,66 @@
+#ifndef MESSAGE_FLOW_MESSAGE_ENVELOPE_H_
+#define MESSAGE_FLOW_MESSAGE_ENVELOPE_H_
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace message_flow {
+template <typename MessageType>
+struct IsSharedPtr : std::false_type {};
+template <typename ValueType>
+struct IsSharedPtr<std::shared_ptr<ValueType>> : std::true_type {};
+
+// Defines how a published message is stored in the delivery queues. Messages
+// of shared pointer type are already cheap to copy and are stored as-is. All
+// other messages are wrapped exactly once per publish into an immutable,
+// reference-counted envelope that is shared by all subscribers of the topic.
+template <
+    typename MessageType, bool kIsSharedPtr = IsSharedPtr<MessageType>::value>
+struct MessageEnvelope {
+  typedef std::shared_ptr<const MessageType> type;
+
+  static type wrap(const MessageType& message) {
+    return std::make_shared<const MessageType>(message);
+  }
+  static type wrap(MessageType&& message) {
+    return std::make_shared<const MessageType>(std::move(message));
+  }
+  static const MessageType& unwrap(const type& envelope) {
+    CHECK(envelope);
+    return *envelope;
+  }
+};
+
+template <typename MessageType>
+struct MessageEnvelope<MessageType, true> {
+  typedef MessageType type;
+
+  static type wrap(const MessageType& message) {
+    return message;
+  }
+  static type wrap(MessageType&& message) {
+    return std::move(message);
+  }
+  static const MessageType& unwrap(const type& envelope) {
+    return envelope;
+  }
+};
+
+template <typename MessageType>
+using MessageEnvelopeType = typename MessageEnvelope<MessageType>::type;
+
+// Messages that do not satisfy this check must be registered with
+// MESSAGE_FLOW_VALUE_TOPIC to explicitly opt into value semantics.
+constexpr size_t kMaxTriviallyCopyableMessageSizeBytes = 64u;
+template <typename MessageType>
+struct IsCheapToCopyMessage
+    : std::integral_constant<
+          bool, IsSharedPtr<MessageType>::value ||
+                    (std::is_trivially_copyable<MessageType>::value &&
+                     sizeof(MessageType) <=
+                         kMaxTriviallyCopyableMessageSizeBytes)> {};
+}  // namespace message_flow
+#endif  // MESSAGE_FLOW_MESSAGE_ENVELOPE_H_
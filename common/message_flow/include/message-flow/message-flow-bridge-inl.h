@@ -0,0 +1,121 @@
+#ifndef MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_INL_H_
+#define MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_INL_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <glog/logging.h>
+#include <maplab-common/ring-buffer-queue.h>
+
+#include "message-flow/callback-types.h"
+#include "message-flow/message-delivery-queue.h"
+
+namespace message_flow {
+
+template <typename MessageTopicDefinition>
+class MessageFlowBridge::BridgedTopic final
+    : public MessageFlowBridge::BridgedTopicBase {
+ public:
+  typedef typename MessageTopicDefinition::message_type MessageType;
+
+  BridgedTopic(MessageFlow* target_flow, const Options& options)
+      : drop_oldest_if_full_(options.drop_oldest_if_full),
+        buffer_(options.buffer_capacity),
+        publish_(
+            CHECK_NOTNULL(target_flow)
+                ->registerPublisher<MessageTopicDefinition>()),
+        is_shutdown_(false),
+        forwarding_thread_(&BridgedTopic::forwardingLoop, this) {}
+
+  ~BridgedTopic() override {
+    shutdown();
+  }
+
+  // Called by the subscriber of the source flow.
+  void push(const MessageType& message) {
+    if (is_shutdown_.load()) {
+      return;
+    }
+    if (drop_oldest_if_full_) {
+      if (buffer_.PushNonBlockingDroppingOldestElementIfFull(message)) {
+        ++num_dropped_messages;
+      }
+    } else {
+      buffer_.PushBlockingIfFull(message);
+    }
+  }
+
+  void shutdown() override {
+    std::lock_guard<std::mutex> lock(m_shutdown_);
+    is_shutdown_.store(true);
+    buffer_.Shutdown();
+    if (forwarding_thread_.joinable()) {
+      forwarding_thread_.join();
+    }
+  }
+
+ private:
+  void forwardingLoop() {
+    MessageType message;
+    while (buffer_.PopBlocking(&message)) {
+      publish_(message);
+      ++num_forwarded_messages;
+    }
+    // Deliver what is left after the shutdown.
+    while (buffer_.PopNonBlocking(&message)) {
+      publish_(message);
+      ++num_forwarded_messages;
+    }
+  }
+
+  const bool drop_oldest_if_full_;
+  common::RingBufferQueue<MessageType> buffer_;
+  const PublisherFunction<MessageTopicDefinition> publish_;
+  std::mutex m_shutdown_;
+  std::atomic<bool> is_shutdown_;
+  std::thread forwarding_thread_;
+};
+
+template <typename MessageTopicDefinition>
+void MessageFlowBridge::bridgeTopic(
+    MessageFlow* source_flow, MessageFlow* target_flow,
+    const Options& options) {
+  CHECK_NOTNULL(source_flow);
+  CHECK_NOTNULL(target_flow);
+  CHECK_NE(source_flow, target_flow);
+  CHECK_GT(options.buffer_capacity, 0u);
+  const std::string topic = MessageTopicDefinition::kMessageTopic;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(!is_shutdown_) << "The bridge was shut down.";
+  for (const BridgedTopicKey& key : bridged_topic_keys_) {
+    if (key.topic != topic) {
+      continue;
+    }
+    CHECK(key.source_flow != source_flow || key.target_flow != target_flow)
+        << "Topic " << topic << " is already bridged between the flows.";
+    CHECK(key.source_flow != target_flow || key.target_flow != source_flow)
+        << "Topic " << topic << " would be forwarded in a loop.";
+  }
+
+  std::shared_ptr<BridgedTopic<MessageTopicDefinition>> bridged_topic =
+      std::make_shared<BridgedTopic<MessageTopicDefinition>>(
+          target_flow, options);
+  bridged_topic_keys_.push_back({topic, source_flow, target_flow});
+  bridged_topics_.push_back(bridged_topic);
+
+  const std::string kSubscriberNodeName = "MessageFlowBridge";
+  source_flow->registerSubscriber<MessageTopicDefinition>(
+      kSubscriberNodeName, DeliveryOptions(),
+      [bridged_topic](
+          const typename MessageTopicDefinition::message_type& message) {
+        bridged_topic->push(message);
+      });
+}
+
+}  // namespace message_flow
+
+#endif  // MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_INL_H_
@@ -0,0 +1,90 @@
+#ifndef MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_H_
+#define MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+#include "message-flow/message-flow.h"
+
+namespace message_flow {
+
+// Forwards the messages of selected topics from one MessageFlow to other
+// MessageFlows of the same process, e.g. to share the IMU data or the
+// localization results between several pipelines. Topics carry shared
+// pointers or cheap to copy values, so the messages are handed over without
+// serialization.
+//
+// Every bridged topic has a ring buffer and a forwarding thread, such that the
+// source flow never waits for the subscribers of the target flow. If the
+// buffer is full, the oldest message is dropped, or, with
+// Options::drop_oldest_if_full unset, the source subscriber waits.
+//
+// A topic must not be bridged in both directions between two flows, the
+// messages would be forwarded in a loop.
+class MessageFlowBridge {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MessageFlowBridge);
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(MessageFlowBridge);
+
+  struct Options {
+    Options() : buffer_capacity(64u), drop_oldest_if_full(true) {}
+    // Rounded up to the next power of two.
+    size_t buffer_capacity;
+    bool drop_oldest_if_full;
+  };
+
+  MessageFlowBridge();
+  // Shuts the bridge down.
+  ~MessageFlowBridge();
+
+  // The flows must outlive the bridge.
+  template <typename MessageTopicDefinition>
+  void bridgeTopic(
+      MessageFlow* source_flow, MessageFlow* target_flow,
+      const Options& options = Options());
+
+  // Stops forwarding. The messages that are in the buffers are still
+  // published to the target flows, later messages are ignored.
+  void shutdown();
+
+  // Summed over all bridged topics.
+  size_t getNumForwardedMessages() const;
+  size_t getNumDroppedMessages() const;
+
+ private:
+  class BridgedTopicBase {
+   public:
+    BridgedTopicBase() : num_forwarded_messages(0u), num_dropped_messages(0u) {}
+    virtual ~BridgedTopicBase() {}
+    virtual void shutdown() = 0;
+
+    std::atomic<size_t> num_forwarded_messages;
+    std::atomic<size_t> num_dropped_messages;
+  };
+  template <typename MessageTopicDefinition>
+  class BridgedTopic;
+
+  struct BridgedTopicKey {
+    std::string topic;
+    const MessageFlow* source_flow;
+    const MessageFlow* target_flow;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<BridgedTopicKey> bridged_topic_keys_;
+  // Shared with the subscriber callbacks of the source flows, which may
+  // outlive the bridge.
+  std::vector<std::shared_ptr<BridgedTopicBase>> bridged_topics_;
+  bool is_shutdown_;
+};
+
+}  // namespace message_flow
+
+#include "message-flow/message-flow-bridge-inl.h"
+
+#endif  // MESSAGE_FLOW_MESSAGE_FLOW_BRIDGE_H_
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include <glog/logging.h>
 
@@ -30,9 +31,31 @@ PublisherFunction<MessageTopicDefinition> MessageFlow::registerPublisher() {
   }
 
   // Wrap the publisher function such that the publisher is kept alive.
-  std::function<void(const MessageType&)> publisher_fct = std::bind(
-      &Publisher<MessageType>::publish, publisher_to_queue,
-      std::placeholders::_1);
+  std::function<void(const MessageType&)> publisher_fct =
+      [publisher_to_queue](const MessageType& message) {
+        publisher_to_queue->publish(message);
+      };
+  return publisher_fct;
+}
+
+template <typename MessageTopicDefinition>
+MovingPublisherFunction<MessageTopicDefinition>
+MessageFlow::registerMovingPublisher() {
+  typedef typename MessageTopicDefinition::message_type MessageType;
+  std::shared_ptr<Publisher<MessageType>> publisher_to_queue;
+  {
+    std::lock_guard<std::mutex> lock(mutex_network_and_maps_);
+    SubscriberListPtr<MessageType> subscriber_list =
+        subscriber_network_
+            .getSubscriberListAndAllocateIfNecessary<MessageTopicDefinition>();
+    publisher_to_queue =
+        std::make_shared<Publisher<MessageType>>(subscriber_list);
+  }
+
+  std::function<void(MessageType&&)> publisher_fct =
+      [publisher_to_queue](MessageType&& message) {
+        publisher_to_queue->publishMoving(std::move(message));
+      };
   return publisher_fct;
 }
 
@@ -58,7 +81,9 @@ void MessageFlow::registerSubscriber(
                                  << " already registered.";
 
     typedef MessageDeliveryQueue<MessageTopicDefinition> MessageQueueDerived;
-    node_queue.reset(new MessageQueueDerived(callback, delivery_options));
+    node_queue.reset(
+        new MessageQueueDerived(
+            subscriber_node_name, callback, delivery_options));
     CHECK(
         subscriber_node_names_.emplace(queue_id, subscriber_node_name).second);
 
@@ -67,11 +92,14 @@ void MessageFlow::registerSubscriber(
     // case we add it to the delivery queue and the dispatcher sends the message
     // according to its policy later.
     const auto add_message_to_queue_fct = [&node_queue, this](
-        const typename MessageTopicDefinition::message_type& message) -> void {
-      std::static_pointer_cast<MessageQueueDerived>(node_queue)
-          ->queueMessageForDelivery(message);
+        const typename MessageQueueDerived::EnvelopeType& envelope) -> void {
+      const bool is_queued =
+          std::static_pointer_cast<MessageQueueDerived>(node_queue)
+              ->queueMessageForDelivery(envelope);
       // Signal the dispatcher that a new message has been put into the queues.
-      this->message_dispatcher_->newMessageInQueue(node_queue);
+      if (is_queued) {
+        this->message_dispatcher_->newMessageInQueue(node_queue);
+      }
     };
 
     subscriber_network_.addSubscriber<MessageTopicDefinition>(
@@ -26,6 +26,12 @@ class MessageFlow {
   template <typename MessageTopicDefinition>
   PublisherFunction<MessageTopicDefinition> registerPublisher();
 
+  // Same as registerPublisher() but the returned function takes ownership of
+  // the message. Value type messages are moved into an envelope that is shared
+  // by all subscribers instead of being copied.
+  template <typename MessageTopicDefinition>
+  MovingPublisherFunction<MessageTopicDefinition> registerMovingPublisher();
+
   // The node name is just used to print human-readable queue statistics. It
   // has no meaning as an identifier internally.
   template <typename MessageTopicDefinition>
@@ -1,11 +1,28 @@
 #ifndef MESSAGE_FLOW_MESSAGE_TOPIC_REGISTRATION_H_
 #define MESSAGE_FLOW_MESSAGE_TOPIC_REGISTRATION_H_
 
-#define MESSAGE_FLOW_TOPIC(NAME, MESSAGE_TYPE)          \
+#include "message-flow/message-envelope.h"
+
+#define MESSAGE_FLOW_TOPIC_IMPL(NAME, MESSAGE_TYPE)     \
   namespace message_flow_topics {                       \
   struct NAME {                                         \
     static constexpr const char* kMessageTopic = #NAME; \
     typedef MESSAGE_TYPE message_type;                  \
   };                                                    \
   }
+
+// Topics should carry shared pointers or small trivially copyable types.
+#define MESSAGE_FLOW_TOPIC(NAME, MESSAGE_TYPE)                             \
+  static_assert(                                                           \
+      message_flow::IsCheapToCopyMessage<MESSAGE_TYPE>::value,             \
+      "The message type of topic " #NAME                                   \
+      " is expensive to copy. Publish a shared pointer or register the "   \
+      "topic using MESSAGE_FLOW_VALUE_TOPIC.");                            \
+  MESSAGE_FLOW_TOPIC_IMPL(NAME, MESSAGE_TYPE)
+
+// Opt-in for topics with large value types. Each message is copied (or moved
+// when using a moving publisher) once into an envelope that is shared by all
+// subscribers.
+#define MESSAGE_FLOW_VALUE_TOPIC(NAME, MESSAGE_TYPE) \
+  MESSAGE_FLOW_TOPIC_IMPL(NAME, MESSAGE_TYPE)
 #endif  // MESSAGE_FLOW_MESSAGE_TOPIC_REGISTRATION_H_
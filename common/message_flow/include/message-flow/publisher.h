@@ -3,7 +3,9 @@
 
 #include <memory>
 #include <mutex>
+#include <utility>
 
+#include "message-flow/message-envelope.h"
 #include "message-flow/subscriber-list.h"
 
 namespace message_flow {
@@ -15,12 +17,24 @@ class Publisher {
       const std::weak_ptr<SubscriberList<MessageType>>& topic_subscribers)
       : topic_subscribers_(topic_subscribers) {}
 
-  // Publish the message to all subscribers.
+  // Publish the message to all subscribers. Value type messages are copied
+  // once into an envelope that is shared among all subscribers.
   void publish(const MessageType& message) {
     SubscriberListPtr<MessageType> topic_subscribers =
         topic_subscribers_.lock();
     if (topic_subscribers) {
-      topic_subscribers->publishToAllSubscribersBlocking(message);
+      topic_subscribers->publishToAllSubscribersBlocking(
+          MessageEnvelope<MessageType>::wrap(message));
+    }
+  }
+
+  // Same as above but moves the message into the envelope.
+  void publishMoving(MessageType&& message) {
+    SubscriberListPtr<MessageType> topic_subscribers =
+        topic_subscribers_.lock();
+    if (topic_subscribers) {
+      topic_subscribers->publishToAllSubscribersBlocking(
+          MessageEnvelope<MessageType>::wrap(std::move(message)));
     }
   }
 
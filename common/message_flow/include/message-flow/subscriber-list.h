@@ -1,12 +1,16 @@
 #ifndef MESSAGE_FLOW_SUBSCRIBER_LIST_H_
 #define MESSAGE_FLOW_SUBSCRIBER_LIST_H_
 
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
 
 #include <glog/logging.h>
 
+#include "message-flow/message-envelope.h"
+
 namespace message_flow {
 // An abstract interface to an ordered subscriber list.
 class SubscriberListBase {
@@ -18,11 +22,13 @@ class SubscriberListBase {
 typedef std::shared_ptr<SubscriberListBase> SubscriberListBasePtr;
 
 // Implementation of a subscriber list with an ordering equal to the
-// registration order.
+// registration order. The subscribers receive the message envelope such that
+// a published message is shared among all subscribers without copies.
 template <typename MessageType>
 class SubscriberList : public SubscriberListBase {
  public:
-  typedef std::function<void(const MessageType&)> SubscriberCallback;
+  typedef MessageEnvelopeType<MessageType> EnvelopeType;
+  typedef std::function<void(const EnvelopeType&)> SubscriberCallback;
 
   SubscriberList() {}
 
@@ -43,11 +49,11 @@ class SubscriberList : public SubscriberListBase {
     subscriber_list_.emplace_back(subscriber);
   }
 
-  void publishToAllSubscribersBlocking(const MessageType& message) const {
+  void publishToAllSubscribersBlocking(const EnvelopeType& envelope) const {
     std::lock_guard<std::mutex> lock(m_subscriber_list_);
     for (const SubscriberCallback& subscriber_callback : subscriber_list_) {
       CHECK(subscriber_callback);
-      subscriber_callback(message);
+      subscriber_callback(envelope);
     }
   }
 
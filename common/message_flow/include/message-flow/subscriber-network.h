@@ -16,7 +16,9 @@ class SubscriberNetwork {
  public:
   template <typename MessageTopicDefinition>
   void addSubscriber(
-      const SubscriberCallback<MessageTopicDefinition>& callback) {
+      const typename SubscriberList<
+          typename MessageTopicDefinition::message_type>::SubscriberCallback&
+          callback) {
     CHECK(callback);
     typedef typename MessageTopicDefinition::message_type MessageType;
     SubscriberListPtr<MessageType> subscriber_list =
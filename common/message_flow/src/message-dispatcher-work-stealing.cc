@@ -0,0 +1,195 @@
+#include "message-flow/message-dispatcher-work-stealing.h"
+
+#include <glog/logging.h>
+
+namespace message_flow {
+namespace {
+// Identifies the dispatcher and worker the current thread belongs to.
+thread_local const MessageDispatcherWorkStealing* tls_dispatcher = nullptr;
+thread_local size_t tls_worker_index = 0u;
+}  // namespace
+
+MessageDispatcherWorkStealing::MessageDispatcherWorkStealing(
+    size_t num_threads)
+    : next_round_robin_worker_(0u),
+      num_scheduled_groups_(0u),
+      num_outstanding_deliveries_(0u),
+      shutdown_requested_(false) {
+  CHECK_GT(num_threads, 0u);
+  run_queues_.reserve(num_threads);
+  for (size_t worker_idx = 0u; worker_idx < num_threads; ++worker_idx) {
+    run_queues_.emplace_back(new WorkerRunQueue);
+  }
+  workers_.reserve(num_threads);
+  for (size_t worker_idx = 0u; worker_idx < num_threads; ++worker_idx) {
+    workers_.emplace_back(
+        &MessageDispatcherWorkStealing::workerLoop, this, worker_idx);
+  }
+}
+
+MessageDispatcherWorkStealing::~MessageDispatcherWorkStealing() {
+  shutdown();
+  for (std::thread& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+void MessageDispatcherWorkStealing::newMessageInQueue(
+    const MessageDeliveryQueueBasePtr& queue) {
+  CHECK(queue);
+  const size_t group_id = getExclusivityGroupId(queue);
+  {
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+    if (shutdown_requested_) {
+      LOG(WARNING) << "Dropping message on topic " << queue->getTopicName()
+                   << " as the dispatcher is shut down.";
+      return;
+    }
+    ++num_outstanding_deliveries_;
+  }
+
+  bool needs_scheduling;
+  {
+    std::lock_guard<std::mutex> lock(m_exclusivity_groups_);
+    ExclusivityGroup& group = exclusivity_groups_[group_id];
+    group.pending_deliveries.emplace_back(queue);
+    needs_scheduling = !group.is_scheduled;
+    group.is_scheduled = true;
+  }
+  if (needs_scheduling) {
+    scheduleGroup(getWorkerIndexForScheduling(), group_id);
+  }
+}
+
+void MessageDispatcherWorkStealing::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+    shutdown_requested_ = true;
+  }
+  cv_work_available_.notify_all();
+}
+
+void MessageDispatcherWorkStealing::waitUntilIdle() const {
+  std::unique_lock<std::mutex> lock(m_worker_state_);
+  cv_idle_.wait(lock, [this]() { return num_outstanding_deliveries_ == 0u; });
+}
+
+void MessageDispatcherWorkStealing::workerLoop(size_t worker_index) {
+  tls_dispatcher = this;
+  tls_worker_index = worker_index;
+
+  while (true) {
+    size_t group_id;
+    if (popOrStealGroup(worker_index, &group_id)) {
+      runOneDeliveryOfGroup(worker_index, group_id);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_worker_state_);
+    if (shutdown_requested_ && num_outstanding_deliveries_ == 0u) {
+      break;
+    }
+    // A group may be counted but not yet pushed to a run queue; in that case
+    // the wait returns immediately and we retry.
+    cv_work_available_.wait(lock, [this]() {
+      return num_scheduled_groups_ > 0u ||
+             (shutdown_requested_ && num_outstanding_deliveries_ == 0u);
+    });
+  }
+}
+
+bool MessageDispatcherWorkStealing::popOrStealGroup(
+    size_t worker_index, size_t* group_id) {
+  CHECK_NOTNULL(group_id);
+  CHECK_LT(worker_index, run_queues_.size());
+  const size_t num_workers = run_queues_.size();
+
+  // Take the oldest group from the local run queue first, then steal the
+  // newest group of the other workers.
+  for (size_t offset = 0u; offset < num_workers; ++offset) {
+    const size_t victim_index = (worker_index + offset) % num_workers;
+    WorkerRunQueue& run_queue = *run_queues_[victim_index];
+    std::lock_guard<std::mutex> lock(run_queue.m_group_ids);
+    if (run_queue.group_ids.empty()) {
+      continue;
+    }
+    if (offset == 0u) {
+      *group_id = run_queue.group_ids.front();
+      run_queue.group_ids.pop_front();
+    } else {
+      *group_id = run_queue.group_ids.back();
+      run_queue.group_ids.pop_back();
+    }
+    std::lock_guard<std::mutex> lock_state(m_worker_state_);
+    CHECK_GT(num_scheduled_groups_, 0u);
+    --num_scheduled_groups_;
+    return true;
+  }
+  return false;
+}
+
+void MessageDispatcherWorkStealing::runOneDeliveryOfGroup(
+    size_t worker_index, size_t group_id) {
+  MessageDeliveryQueueBasePtr queue;
+  {
+    std::lock_guard<std::mutex> lock(m_exclusivity_groups_);
+    ExclusivityGroup& group = exclusivity_groups_[group_id];
+    CHECK(group.is_scheduled);
+    CHECK(!group.pending_deliveries.empty());
+    queue = group.pending_deliveries.front();
+    group.pending_deliveries.pop_front();
+  }
+
+  CHECK(queue);
+  queue->deliverOldestMessage();
+
+  // Only one delivery is executed per scheduling of a group to keep the
+  // workers fair across groups.
+  bool needs_rescheduling;
+  {
+    std::lock_guard<std::mutex> lock(m_exclusivity_groups_);
+    ExclusivityGroup& group = exclusivity_groups_[group_id];
+    needs_rescheduling = !group.pending_deliveries.empty();
+    group.is_scheduled = needs_rescheduling;
+  }
+  if (needs_rescheduling) {
+    scheduleGroup(worker_index, group_id);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+    CHECK_GT(num_outstanding_deliveries_, 0u);
+    --num_outstanding_deliveries_;
+    if (num_outstanding_deliveries_ == 0u) {
+      cv_idle_.notify_all();
+      if (shutdown_requested_) {
+        cv_work_available_.notify_all();
+      }
+    }
+  }
+}
+
+void MessageDispatcherWorkStealing::scheduleGroup(
+    size_t worker_index, size_t group_id) {
+  CHECK_LT(worker_index, run_queues_.size());
+  {
+    std::lock_guard<std::mutex> lock(m_worker_state_);
+    ++num_scheduled_groups_;
+  }
+  {
+    WorkerRunQueue& run_queue = *run_queues_[worker_index];
+    std::lock_guard<std::mutex> lock(run_queue.m_group_ids);
+    run_queue.group_ids.emplace_back(group_id);
+  }
+  cv_work_available_.notify_one();
+}
+
+size_t MessageDispatcherWorkStealing::getWorkerIndexForScheduling() {
+  if (tls_dispatcher == this) {
+    return tls_worker_index;
+  }
+  return next_round_robin_worker_.fetch_add(1u) % run_queues_.size();
+}
+}  // namespace message_flow
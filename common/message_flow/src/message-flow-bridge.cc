@@ -0,0 +1,40 @@
+#include "message-flow/message-flow-bridge.h"
+
+namespace message_flow {
+
+MessageFlowBridge::MessageFlowBridge() : is_shutdown_(false) {}
+
+MessageFlowBridge::~MessageFlowBridge() {
+  shutdown();
+}
+
+void MessageFlowBridge::shutdown() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  is_shutdown_ = true;
+  for (const std::shared_ptr<BridgedTopicBase>& bridged_topic :
+       bridged_topics_) {
+    bridged_topic->shutdown();
+  }
+}
+
+size_t MessageFlowBridge::getNumForwardedMessages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_messages = 0u;
+  for (const std::shared_ptr<BridgedTopicBase>& bridged_topic :
+       bridged_topics_) {
+    num_messages += bridged_topic->num_forwarded_messages.load();
+  }
+  return num_messages;
+}
+
+size_t MessageFlowBridge::getNumDroppedMessages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_messages = 0u;
+  for (const std::shared_ptr<BridgedTopicBase>& bridged_topic :
+       bridged_topics_) {
+    num_messages += bridged_topic->num_dropped_messages.load();
+  }
+  return num_messages;
+}
+
+}  // namespace message_flow
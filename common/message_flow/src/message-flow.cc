@@ -5,12 +5,28 @@
 #include <sstream>
 #include <string>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
 
 #include "message-flow/message-dispatcher.h"
 #include "message-flow/subscriber-network.h"
 
+DEFINE_bool(
+    message_flow_collect_statistics, false,
+    "If enabled, the publish-to-delivery latency, the callback execution time "
+    "and the queue depth of all delivery queues are collected in "
+    "statistics::Statistics.");
+DEFINE_uint64(
+    message_flow_fifo_realtime_num_threads, 1u,
+    "Number of FIFO dispatcher threads reserved for real-time subscribers. "
+    "Zero makes them share the threads of the normal subscribers.");
+DEFINE_uint64(
+    message_flow_fifo_bulk_num_threads, 1u,
+    "Number of FIFO dispatcher threads of the bulk subscribers, which can then "
+    "never occupy the threads of the normal subscribers. Zero makes them "
+    "share the threads of the normal subscribers.");
+
 namespace message_flow {
 MessageFlow::MessageFlow(const MessageDispatcherPtr& dispatcher)
     : message_dispatcher_(dispatcher) {
@@ -44,7 +60,8 @@ std::string MessageFlow::printDeliveryQueueStatistics() const {
   output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
          << "subscriber-node" << std::setw(kNumAlignment) << "queue-topic"
          << std::setw(kNumAlignment) << "queue-id" << std::setw(kNumAlignment)
-         << "num elements" << std::endl;
+         << "num elements" << std::setw(kNumAlignment) << "num dropped"
+         << std::endl;
 
   for (const MessageDeliveryQueueMap::value_type& value :
        subscriber_message_queues_) {
@@ -56,7 +73,9 @@ std::string MessageFlow::printDeliveryQueueStatistics() const {
     output << std::setiosflags(std::ios::left) << std::setw(kNumAlignment)
            << subscriber_node_name << std::setw(kNumAlignment)
            << queue->getTopicName() << std::setw(kNumAlignment) << queue_id
-           << std::setw(kNumAlignment) << queue->size() << std::endl;
+           << std::setw(kNumAlignment) << queue->size()
+           << std::setw(kNumAlignment) << queue->getNumDroppedMessages()
+           << std::endl;
   }
   return output.str();
 }
@@ -0,0 +1,86 @@
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "message-flow/message-dispatcher-fifo.h"
+#include "message-flow/message-flow-bridge.h"
+#include "message-flow/message-flow.h"
+#include "message-flow/message-topic-registration.h"
+
+MESSAGE_FLOW_TOPIC(BridgedTopic, double);
+
+namespace message_flow {
+
+TEST(MessageFlowBridge, ForwardsAllMessagesInOrder) {
+  constexpr size_t kNumThreads = 4u;
+  std::unique_ptr<MessageFlow> source_flow(
+      MessageFlow::create<MessageDispatcherFifo>(kNumThreads));
+  std::unique_ptr<MessageFlow> target_flow(
+      MessageFlow::create<MessageDispatcherFifo>(kNumThreads));
+
+  std::mutex m_received;
+  std::vector<double> received;
+  target_flow->registerSubscriber<message_flow_topics::BridgedTopic>(
+      "Receiver", DeliveryOptions(), [&](double value) {
+        std::lock_guard<std::mutex> lock(m_received);
+        received.push_back(value);
+      });
+
+  MessageFlowBridge bridge;
+  MessageFlowBridge::Options options;
+  options.buffer_capacity = 8u;
+  options.drop_oldest_if_full = false;
+  bridge.bridgeTopic<message_flow_topics::BridgedTopic>(
+      source_flow.get(), target_flow.get(), options);
+
+  std::function<void(const double&)> publish =
+      source_flow->registerPublisher<message_flow_topics::BridgedTopic>();
+  constexpr size_t kNumMessages = 1000u;
+  for (size_t idx = 0u; idx < kNumMessages; ++idx) {
+    publish(static_cast<double>(idx));
+  }
+  source_flow->waitUntilIdle();
+  // Delivers the messages that are still buffered.
+  bridge.shutdown();
+  target_flow->waitUntilIdle();
+
+  EXPECT_EQ(bridge.getNumForwardedMessages(), kNumMessages);
+  EXPECT_EQ(bridge.getNumDroppedMessages(), 0u);
+  ASSERT_EQ(received.size(), kNumMessages);
+  for (size_t idx = 0u; idx < kNumMessages; ++idx) {
+    EXPECT_EQ(received[idx], static_cast<double>(idx));
+  }
+
+  source_flow->shutdown();
+  source_flow->waitUntilIdle();
+  target_flow->shutdown();
+  target_flow->waitUntilIdle();
+}
+
+TEST(MessageFlowBridge, RejectsLoops) {
+  constexpr size_t kNumThreads = 1u;
+  std::unique_ptr<MessageFlow> flow_a(
+      MessageFlow::create<MessageDispatcherFifo>(kNumThreads));
+  std::unique_ptr<MessageFlow> flow_b(
+      MessageFlow::create<MessageDispatcherFifo>(kNumThreads));
+
+  MessageFlowBridge bridge;
+  bridge.bridgeTopic<message_flow_topics::BridgedTopic>(
+      flow_a.get(), flow_b.get());
+  EXPECT_DEATH(
+      bridge.bridgeTopic<message_flow_topics::BridgedTopic>(
+          flow_b.get(), flow_a.get()),
+      "loop");
+  bridge.shutdown();
+
+  flow_a->shutdown();
+  flow_a->waitUntilIdle();
+  flow_b->shutdown();
+  flow_b->waitUntilIdle();
+}
+
+}  // namespace message_flow
+
+MAPLAB_UNITTEST_ENTRYPOINT
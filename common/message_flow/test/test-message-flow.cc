@@ -1,10 +1,21 @@
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include <aslam/common/statistics/statistics.h>
+#include <gflags/gflags.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/threadsafe-queue.h>
 
+#include "message-flow/lock-free-mpsc-queue.h"
 #include "message-flow/message-dispatcher-fifo.h"
+#include "message-flow/message-dispatcher-work-stealing.h"
 #include "message-flow/message-flow.h"
 #include "message-flow/message-topic-registration.h"
 
@@ -12,6 +23,28 @@ MESSAGE_FLOW_TOPIC(TopicA, double);
 MESSAGE_FLOW_TOPIC(TopicB, double);
 MESSAGE_FLOW_TOPIC(TopicX, double);
 
+namespace message_flow {
+// Counts the copies of a message to verify the payload sharing.
+struct CopyCountingMessage {
+  CopyCountingMessage() : payload(0u) {}
+  explicit CopyCountingMessage(size_t _payload) : payload(_payload) {}
+  CopyCountingMessage(const CopyCountingMessage& other)
+      : payload(other.payload) {
+    ++num_copies;
+  }
+  CopyCountingMessage(CopyCountingMessage&& other) : payload(other.payload) {}
+  CopyCountingMessage& operator=(const CopyCountingMessage& other) {
+    payload = other.payload;
+    ++num_copies;
+    return *this;
+  }
+  size_t payload;
+  static std::atomic<size_t> num_copies;
+};
+std::atomic<size_t> CopyCountingMessage::num_copies(0u);
+}  // namespace message_flow
+MESSAGE_FLOW_VALUE_TOPIC(TopicValue, message_flow::CopyCountingMessage);
+
 namespace message_flow {
 const std::string kSubscriberNode("SubNode");
 
@@ -194,5 +227,433 @@ TEST(
   flow->shutdown();
   flow->waitUntilIdle();
 }
+TEST(MessageFlow, LockFreeMpscQueue_MultiProducer) {
+  // Push from multiple threads concurrently and check that every element
+  // arrives exactly once and in per-producer order.
+  constexpr size_t kNumProducers = 8u;
+  constexpr size_t kNumValuesPerProducer = 10000u;
+  LockFreeMpscQueue<size_t> queue;
+
+  std::vector<std::thread> producers;
+  for (size_t producer_idx = 0u; producer_idx < kNumProducers;
+       ++producer_idx) {
+    producers.emplace_back([&queue, producer_idx]() {
+      for (size_t i = 0u; i < kNumValuesPerProducer; ++i) {
+        queue.push(producer_idx * kNumValuesPerProducer + i);
+      }
+    });
+  }
+
+  std::vector<size_t> last_value_per_producer(kNumProducers, 0u);
+  std::vector<size_t> num_values_per_producer(kNumProducers, 0u);
+  size_t num_popped = 0u;
+  while (num_popped < kNumProducers * kNumValuesPerProducer) {
+    size_t value;
+    if (!queue.popNonBlocking(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    const size_t producer_idx = value / kNumValuesPerProducer;
+    ASSERT_LT(producer_idx, kNumProducers);
+    if (num_values_per_producer[producer_idx] > 0u) {
+      EXPECT_GT(value, last_value_per_producer[producer_idx]);
+    }
+    last_value_per_producer[producer_idx] = value;
+    ++num_values_per_producer[producer_idx];
+    ++num_popped;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_TRUE(queue.empty());
+  for (size_t num_values : num_values_per_producer) {
+    EXPECT_EQ(num_values, kNumValuesPerProducer);
+  }
+}
+
+TEST(MessageFlow, MessageDispatcherThreadedFifo_LockFreeQueueDeliveryOrder) {
+  // Same as the FIFO delivery order test but with a lock-free delivery queue.
+  constexpr size_t kNumThreads = 32u;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(kNumThreads));
+
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  common::ThreadSafeQueue<double> receive_queue;
+
+  DeliveryOptions delivery_options;
+  delivery_options.queue_type = DeliveryQueueType::kLockFreeMpsc;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, delivery_options, [&receive_queue](double value) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(rand() % 10));  // NOLINT
+        receive_queue.Push(value);
+      });
+
+  size_t kNumNumbers = 1000u;
+  for (size_t number = 0; number < kNumNumbers; ++number) {
+    publish_on_topic_a(number);
+  }
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), kNumNumbers);
+  size_t counter = 0u;
+  double value;
+  while (receive_queue.PopNonBlocking(&value)) {
+    EXPECT_EQ(static_cast<double>(counter), value);
+    ++counter;
+  }
+  EXPECT_EQ(counter, kNumNumbers);
+
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+TEST(MessageFlow, MessageDispatcherWorkStealing_MessageDeliveryOrder) {
+  // Each subscriber must receive its messages in publishing order even if the
+  // exclusivity groups are stolen by different workers.
+  constexpr size_t kNumThreads = 8u;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherWorkStealing>(kNumThreads));
+
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+
+  constexpr size_t kNumSubscribers = 4u;
+  std::vector<std::unique_ptr<common::ThreadSafeQueue<double>>> receive_queues;
+  for (size_t subscriber_idx = 0u; subscriber_idx < kNumSubscribers;
+       ++subscriber_idx) {
+    receive_queues.emplace_back(new common::ThreadSafeQueue<double>);
+    common::ThreadSafeQueue<double>* receive_queue =
+        receive_queues.back().get();
+    flow->registerSubscriber<message_flow_topics::TopicA>(
+        kSubscriberNode, DeliveryOptions(), [receive_queue](double value) {
+          std::this_thread::sleep_for(
+              std::chrono::microseconds(rand() % 10));  // NOLINT
+          receive_queue->Push(value);
+        });
+  }
+
+  size_t kNumNumbers = 1000u;
+  for (size_t number = 0; number < kNumNumbers; ++number) {
+    publish_on_topic_a(number);
+  }
+  flow->waitUntilIdle();
+
+  for (const std::unique_ptr<common::ThreadSafeQueue<double>>& receive_queue :
+       receive_queues) {
+    ASSERT_EQ(receive_queue->Size(), kNumNumbers);
+    size_t counter = 0u;
+    double value;
+    while (receive_queue->PopNonBlocking(&value)) {
+      EXPECT_EQ(static_cast<double>(counter), value);
+      ++counter;
+    }
+    EXPECT_EQ(counter, kNumNumbers);
+  }
+
+  LOG(INFO) << flow->printDeliveryQueueStatistics();
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+
+TEST(
+    MessageFlow,
+    MessageDispatcherWorkStealing_MessageDeliveryOrderExclusivity) {
+  constexpr size_t kNumThreads = 8u;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherWorkStealing>(kNumThreads));
+
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  std::function<void(const double&)> publish_on_topic_b =
+      flow->registerPublisher<message_flow_topics::TopicB>();
+  common::ThreadSafeQueue<double> receive_queue;
+
+  const auto receive_callback = [&receive_queue](double value) {
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(rand() % 10));  // NOLINT
+    receive_queue.Push(value);
+  };
+
+  DeliveryOptions delivery_options;
+  delivery_options.exclusivity_group_id = 0;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, delivery_options, receive_callback);
+  flow->registerSubscriber<message_flow_topics::TopicB>(
+      kSubscriberNode, delivery_options, receive_callback);
+
+  size_t kNumNumbers = 1000u;
+  for (size_t number = 0; number < kNumNumbers; ++number) {
+    if (rand() % 2 == 0) {  // NOLINT
+      publish_on_topic_a(number);
+    } else {
+      publish_on_topic_b(number);
+    }
+  }
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), kNumNumbers);
+  size_t counter = 0u;
+  double value;
+  while (receive_queue.PopNonBlocking(&value)) {
+    EXPECT_EQ(static_cast<double>(counter), value);
+    ++counter;
+  }
+  EXPECT_EQ(counter, kNumNumbers);
+
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+TEST(MessageFlow, MessageDispatcherFifo_RealTimeIsNotBlockedByBulk) {
+  constexpr size_t kNumNormalThreads = 1u;
+  constexpr size_t kNumRealTimeThreads = 1u;
+  constexpr size_t kNumBulkThreads = 1u;
+  std::unique_ptr<MessageFlow> flow(
+      new MessageFlow(
+          std::make_shared<MessageDispatcherFifo>(
+              kNumNormalThreads, kNumRealTimeThreads, kNumBulkThreads)));
+
+  // The bulk subscriber blocks its only worker until it is released.
+  std::promise<void> release_bulk;
+  std::shared_future<void> bulk_released(release_bulk.get_future());
+  DeliveryOptions bulk_options;
+  bulk_options.priority = DeliveryPriority::kBulk;
+  flow->registerSubscriber<message_flow_topics::TopicB>(
+      kSubscriberNode, bulk_options,
+      [bulk_released](double) { bulk_released.wait(); });
+
+  std::promise<double> realtime_value;
+  DeliveryOptions realtime_options;
+  realtime_options.priority = DeliveryPriority::kRealTime;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, realtime_options,
+      [&realtime_value](double value) { realtime_value.set_value(value); });
+
+  std::promise<double> normal_value;
+  flow->registerSubscriber<message_flow_topics::TopicX>(
+      kSubscriberNode, DeliveryOptions(),
+      [&normal_value](double value) { normal_value.set_value(value); });
+
+  std::function<void(const double&)> publish_b =
+      flow->registerPublisher<message_flow_topics::TopicB>();
+  std::function<void(const double&)> publish_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+  std::function<void(const double&)> publish_x =
+      flow->registerPublisher<message_flow_topics::TopicX>();
+  constexpr size_t kNumBulkMessages = 10u;
+  for (size_t i = 0u; i < kNumBulkMessages; ++i) {
+    publish_b(static_cast<double>(i));
+  }
+  publish_a(1.0);
+  publish_x(2.0);
+
+  // Both are delivered while the bulk worker is still blocked.
+  std::future<double> realtime_future = realtime_value.get_future();
+  std::future<double> normal_future = normal_value.get_future();
+  ASSERT_EQ(
+      realtime_future.wait_for(std::chrono::seconds(10)),
+      std::future_status::ready);
+  ASSERT_EQ(
+      normal_future.wait_for(std::chrono::seconds(10)),
+      std::future_status::ready);
+  EXPECT_EQ(realtime_future.get(), 1.0);
+  EXPECT_EQ(normal_future.get(), 2.0);
+
+  release_bulk.set_value();
+  flow->waitUntilIdle();
+  flow->shutdown();
+}
+
+TEST(MessageFlow, CheapToCopyMessageCheck) {
+  static_assert(IsCheapToCopyMessage<double>::value, "");
+  static_assert(IsCheapToCopyMessage<std::shared_ptr<std::string>>::value, "");
+  static_assert(!IsCheapToCopyMessage<std::vector<double>>::value, "");
+  static_assert(!IsCheapToCopyMessage<CopyCountingMessage>::value, "");
+}
+
+TEST(MessageFlow, ValueTopicPayloadIsSharedAmongSubscribers) {
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+
+  constexpr size_t kNumSubscribers = 5u;
+  std::atomic<size_t> payload_sum(0u);
+  for (size_t subscriber_idx = 0u; subscriber_idx < kNumSubscribers;
+       ++subscriber_idx) {
+    flow->registerSubscriber<message_flow_topics::TopicValue>(
+        kSubscriberNode, DeliveryOptions(),
+        [&payload_sum](const CopyCountingMessage& message) {
+          payload_sum += message.payload;
+        });
+  }
+
+  std::function<void(const CopyCountingMessage&)> publish_copying =
+      flow->registerPublisher<message_flow_topics::TopicValue>();
+  MovingPublisherFunction<message_flow_topics::TopicValue> publish_moving =
+      flow->registerMovingPublisher<message_flow_topics::TopicValue>();
+
+  constexpr size_t kPayload = 3u;
+  CopyCountingMessage::num_copies = 0u;
+  publish_copying(CopyCountingMessage(kPayload));
+  flow->waitUntilIdle();
+  // A single copy into the shared envelope, independent of the number of
+  // subscribers.
+  EXPECT_EQ(CopyCountingMessage::num_copies, 1u);
+  EXPECT_EQ(payload_sum, kNumSubscribers * kPayload);
+
+  CopyCountingMessage::num_copies = 0u;
+  publish_moving(CopyCountingMessage(kPayload));
+  flow->waitUntilIdle();
+  EXPECT_EQ(CopyCountingMessage::num_copies, 0u);
+  EXPECT_EQ(payload_sum, 2u * kNumSubscribers * kPayload);
+
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+TEST(MessageFlow, DeliveryQueueStatistics) {
+  FLAGS_message_flow_collect_statistics = true;
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+
+  const std::string kStatisticsNode = "StatisticsNode";
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kStatisticsNode, DeliveryOptions(), [](double) {});
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+
+  constexpr size_t kNumMessages = 100u;
+  for (size_t i = 0u; i < kNumMessages; ++i) {
+    publish_on_topic_a(i);
+  }
+  flow->waitUntilIdle();
+  FLAGS_message_flow_collect_statistics = false;
+
+  const std::string kPrefix = "message_flow/" + kStatisticsNode + "/TopicA";
+  EXPECT_EQ(
+      statistics::Statistics::GetNumSamples(
+          kPrefix + " publish-to-delivery latency [ms]"),
+      kNumMessages);
+  EXPECT_EQ(
+      statistics::Statistics::GetNumSamples(
+          kPrefix + " callback execution time [ms]"),
+      kNumMessages);
+  EXPECT_EQ(
+      statistics::Statistics::GetNumSamples(kPrefix + " queue depth"),
+      kNumMessages);
+
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
+namespace {
+// Publishes one message that blocks the subscriber, then kNumQueuedMessages
+// messages that pile up in the delivery queue. Returns the received values
+// after the subscriber is released.
+std::vector<double> publishWithBlockedSubscriber(
+    const DeliveryOptions& delivery_options, size_t num_queued_messages) {
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+
+  std::promise<void> callback_entered;
+  std::promise<void> release_callback;
+  std::shared_future<void> release_future =
+      release_callback.get_future().share();
+  std::mutex m_received_values;
+  std::vector<double> received_values;
+  bool is_first_message = true;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, delivery_options, [&](double value) {
+        if (is_first_message) {
+          is_first_message = false;
+          callback_entered.set_value();
+          release_future.wait();
+        }
+        std::lock_guard<std::mutex> lock(m_received_values);
+        received_values.push_back(value);
+      });
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+
+  publish_on_topic_a(0.0);
+  callback_entered.get_future().wait();
+  for (size_t i = 1u; i <= num_queued_messages; ++i) {
+    publish_on_topic_a(static_cast<double>(i));
+  }
+  release_callback.set_value();
+  flow->waitUntilIdle();
+  flow->shutdown();
+  flow->waitUntilIdle();
+
+  std::lock_guard<std::mutex> lock(m_received_values);
+  return received_values;
+}
+}  // namespace
+
+TEST(MessageFlow, BoundedQueueDropNewest) {
+  DeliveryOptions delivery_options;
+  delivery_options.queue_capacity = 2u;
+  delivery_options.overflow_policy = QueueOverflowPolicy::kDropNewest;
+  const std::vector<double> received_values =
+      publishWithBlockedSubscriber(delivery_options, 5u);
+  EXPECT_EQ(received_values, std::vector<double>({0.0, 1.0, 2.0}));
+}
+
+TEST(MessageFlow, BoundedQueueDropOldest) {
+  DeliveryOptions delivery_options;
+  delivery_options.queue_capacity = 2u;
+  delivery_options.overflow_policy = QueueOverflowPolicy::kDropOldest;
+  const std::vector<double> received_values =
+      publishWithBlockedSubscriber(delivery_options, 5u);
+  EXPECT_EQ(received_values, std::vector<double>({0.0, 4.0, 5.0}));
+}
+
+TEST(MessageFlow, BoundedQueueLatestOnly) {
+  const std::vector<double> received_values =
+      publishWithBlockedSubscriber(DeliveryOptions::latestOnly(), 5u);
+  EXPECT_EQ(received_values, std::vector<double>({0.0, 5.0}));
+}
+
+TEST(MessageFlow, BoundedLockFreeQueueDropNewest) {
+  DeliveryOptions delivery_options;
+  delivery_options.queue_type = DeliveryQueueType::kLockFreeMpsc;
+  delivery_options.queue_capacity = 2u;
+  delivery_options.overflow_policy = QueueOverflowPolicy::kDropNewest;
+  const std::vector<double> received_values =
+      publishWithBlockedSubscriber(delivery_options, 5u);
+  EXPECT_EQ(received_values, std::vector<double>({0.0, 1.0, 2.0}));
+}
+
+TEST(MessageFlow, BoundedQueueBlockPublisher) {
+  std::unique_ptr<MessageFlow> flow(
+      MessageFlow::create<MessageDispatcherFifo>(4u));
+
+  DeliveryOptions delivery_options;
+  delivery_options.queue_capacity = 1u;
+  delivery_options.overflow_policy = QueueOverflowPolicy::kBlockPublisher;
+  common::ThreadSafeQueue<double> receive_queue;
+  flow->registerSubscriber<message_flow_topics::TopicA>(
+      kSubscriberNode, delivery_options, [&receive_queue](double value) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        receive_queue.Push(value);
+      });
+  std::function<void(const double&)> publish_on_topic_a =
+      flow->registerPublisher<message_flow_topics::TopicA>();
+
+  // No message may be lost even though the queue can only hold one message.
+  constexpr size_t kNumNumbers = 100u;
+  for (size_t number = 0u; number < kNumNumbers; ++number) {
+    publish_on_topic_a(number);
+  }
+  flow->waitUntilIdle();
+
+  ASSERT_EQ(receive_queue.Size(), kNumNumbers);
+  size_t counter = 0u;
+  double value;
+  while (receive_queue.PopNonBlocking(&value)) {
+    EXPECT_EQ(static_cast<double>(counter), value);
+    ++counter;
+  }
+  flow->shutdown();
+  flow->waitUntilIdle();
+}
 }  // namespace message_flow
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -7,11 +7,12 @@
 #include <memory>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <glog/logging.h>
 #include <maplab-common/macros.h>
-#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/flat-temporal-buffer.h>
 
 #include "vio-common/vio-types.h"
 
@@ -77,6 +78,8 @@ class ImuMeasurementBuffer {
   /// @param[out] imu_measurements List of IMU measurements. (Order: [acc,
   /// gyro])
   /// @return Was data removed from the buffer?
+  /// The output matrices are only reallocated if the number of measurements
+  /// changes, so they can be reused across queries.
   QueryResult getImuDataInterpolatedBorders(
       int64_t timestamp_from, int64_t timestamp_to,
       Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
@@ -93,6 +96,18 @@ class ImuMeasurementBuffer {
       Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
       Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements);
 
+  /// Same as getImuDataInterpolatedBorders() for the consecutive intervals
+  /// between the given strictly increasing timestamps, where interval i spans
+  /// border_timestamps_ns[i] to border_timestamps_ns[i + 1]. All intervals
+  /// are extracted under a single lock in one pass over the buffer. The
+  /// intervals are extracted in order up to the first one that fails, whose
+  /// result is returned, so the outputs contain the leading intervals that
+  /// are available. Does not block.
+  QueryResult getImuDataInterpolatedBordersOfIntervals(
+      const std::vector<int64_t>& border_timestamps_ns,
+      std::vector<Eigen::Matrix<int64_t, 1, Eigen::Dynamic>>* imu_timestamps,
+      std::vector<Eigen::Matrix<double, 6, Eigen::Dynamic>>* imu_measurements);
+
   /// Linear interpolation between two imu measurements.
   static void linearInterpolate(
       int64_t x0, const vio::ImuData& y0, int64_t x1, const vio::ImuData& y1,
@@ -107,7 +122,19 @@ class ImuMeasurementBuffer {
 
   typedef std::pair<int64_t, vio::ImuMeasurement> BufferElement;
   typedef Eigen::aligned_allocator<BufferElement> BufferAllocator;
-  typedef common::TemporalBuffer<vio::ImuMeasurement, BufferAllocator> Buffer;
+  // The measurements are strictly ordered in time, see addMeasurement().
+  typedef common::FlatTemporalBuffer<vio::ImuMeasurement, BufferAllocator>
+      Buffer;
+
+  /// Writes the measurements of an available interval to the outputs. The
+  /// search for the interval starts at search_begin, which is set to the
+  /// first measurement at or after timestamp_ns_to. The caller must hold the
+  /// container lock.
+  QueryResult getImuDataInterpolatedBordersImpl(
+      int64_t timestamp_ns_from, int64_t timestamp_ns_to,
+      Buffer::BufferType::const_iterator* search_begin,
+      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) const;
 
   Buffer buffer_;
   mutable std::mutex m_buffer_;
@@ -0,0 +1,91 @@
+#ifndef VIO_COMMON_PIPELINE_TRACE_H_
+#define VIO_COMMON_PIPELINE_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <maplab-common/macros.h>
+
+namespace vio {
+
+struct PipelineTraceStage {
+  // Must point to a string literal.
+  const char* name;
+  int64_t enter_ns;
+  int64_t exit_ns;
+};
+
+class PipelineTrace;
+
+// Receives the stages of all traces as soon as they are added.
+class PipelineTraceSink {
+ public:
+  virtual ~PipelineTraceSink() = default;
+  virtual void addStage(
+      const PipelineTrace& trace, const PipelineTraceStage& stage) = 0;
+};
+
+// Trace context of a single frame on its way through the pipeline. The stage
+// times are taken from a monotonic clock. The capture timestamp is the sensor
+// time of the frame and only identifies it.
+class PipelineTrace {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(PipelineTrace);
+
+  // The sink is optional and must outlive the trace.
+  PipelineTrace(
+      const int64_t capture_timestamp_ns, const int64_t start_ns,
+      PipelineTraceSink* sink);
+
+  static int64_t nowNanoseconds();
+
+  // Thread-safe, as parallel branches of the pipeline add their stages to the
+  // same trace.
+  void addStage(
+      const char* name, const int64_t enter_ns, const int64_t exit_ns);
+  // Adds the stages of a trace that was recorded separately, e.g. the state
+  // estimate that was matched to this frame.
+  void addStagesOf(const PipelineTrace& other);
+  std::vector<PipelineTraceStage> getStages() const;
+
+  int64_t id() const {
+    return id_;
+  }
+  int64_t captureTimestampNanoseconds() const {
+    return capture_timestamp_ns_;
+  }
+  // Time the frame entered the pipeline.
+  int64_t startNanoseconds() const {
+    return start_ns_;
+  }
+
+ private:
+  static std::atomic<int64_t> next_id_;
+
+  const int64_t id_;
+  const int64_t capture_timestamp_ns_;
+  const int64_t start_ns_;
+  PipelineTraceSink* const sink_;
+
+  mutable std::mutex m_stages_;
+  std::vector<PipelineTraceStage> stages_;
+};
+
+// Adds a stage spanning the lifetime of this object to the trace. Does nothing
+// if the trace is a nullptr, i.e. if tracing is disabled.
+class ScopedPipelineTraceStage {
+ public:
+  ScopedPipelineTraceStage(PipelineTrace* trace, const char* name);
+  ~ScopedPipelineTraceStage();
+
+ private:
+  PipelineTrace* const trace_;
+  const char* const name_;
+  const int64_t enter_ns_;
+};
+
+}  // namespace vio
+
+#endif  // VIO_COMMON_PIPELINE_TRACE_H_
@@ -12,6 +12,8 @@
 #include <maplab-common/macros.h>
 #include <opencv2/core/core.hpp>
 
+#include "vio-common/pipeline-trace.h"
+
 namespace vio {
 
 enum class EstimatorState : int { kUninitialized, kStartup, kRunning };
@@ -106,6 +108,9 @@ struct SynchronizedNFrameImu {
 
   /// Additional information obtained during feature tracking.
   MotionType motion_wrt_last_nframe;
+
+  /// Latency trace of this nframe; only set if pipeline tracing is enabled.
+  PipelineTrace::Ptr trace;
 };
 
 /// The state of a ViNode (pose, velocity and bias).
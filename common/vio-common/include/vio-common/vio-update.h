@@ -4,6 +4,7 @@
 #include <aslam/common/pose-types.h>
 #include <maplab-common/macros.h>
 
+#include "vio-common/pipeline-trace.h"
 #include "vio-common/vio-types.h"
 
 namespace pose_graph {
@@ -39,6 +40,9 @@ struct VioUpdate {
   LocalizationState localization_state;
   aslam::Transformation T_G_M;
 
+  // Latency trace of the nframe; only set if pipeline tracing is enabled.
+  PipelineTrace::Ptr trace;
+
   inline bool check() const {
     return static_cast<bool>(keyframe_and_imudata);
   }
@@ -2,14 +2,14 @@
 
 #include <algorithm>
 #include <condition_variable>
+#include <iterator>
 #include <memory>
 #include <mutex>
 
 #include <Eigen/Dense>
-#include <aslam/common/memory.h>
-#include <aslam/common/statistics/statistics.h>
 #include <aslam/common/time.h>
 #include <glog/logging.h>
+#include <maplab-common/telemetry.h>
 
 #include "vio-common/vio-types.h"
 
@@ -50,28 +50,32 @@ void ImuMeasurementBuffer::linearInterpolate(
 }
 
 ImuMeasurementBuffer::QueryResult
-ImuMeasurementBuffer::getImuDataInterpolatedBorders(
+ImuMeasurementBuffer::getImuDataInterpolatedBordersImpl(
     int64_t timestamp_ns_from, int64_t timestamp_ns_to,
+    Buffer::BufferType::const_iterator* search_begin,
     Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
-    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) {
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) const {
+  CHECK_NOTNULL(search_begin);
   CHECK_NOTNULL(imu_timestamps);
   CHECK_NOTNULL(imu_measurements);
-
-  QueryResult query_result =
-      isDataAvailableUpToImpl(timestamp_ns_from, timestamp_ns_to);
-  if (query_result != QueryResult::kDataAvailable) {
-    imu_timestamps->resize(Eigen::NoChange, 0);
-    imu_measurements->resize(Eigen::NoChange, 0);
-    return query_result;
-  }
-
-  // Copy the data with timestamp_up_to <= timestamps_buffer from the buffer.
-  Aligned<std::vector, vio::ImuMeasurement> between_values;
-  CHECK(
-      buffer_.getValuesBetweenTimes(
-          timestamp_ns_from, timestamp_ns_to, &between_values));
-
-  if (between_values.empty()) {
+  const Buffer::BufferType& values = buffer_.buffered_values();
+  // First measurement after timestamp_ns_from and first measurement at or
+  // after timestamp_ns_to. Both exist as the data is available.
+  const Buffer::BufferType::const_iterator it_begin = std::upper_bound(
+      *search_begin, values.end(), timestamp_ns_from,
+      [](const int64_t timestamp_ns, const BufferElement& value) {
+        return timestamp_ns < value.first;
+      });
+  const Buffer::BufferType::const_iterator it_end = std::lower_bound(
+      it_begin, values.end(), timestamp_ns_to,
+      [](const BufferElement& value, const int64_t timestamp_ns) {
+        return value.first < timestamp_ns;
+      });
+  CHECK(it_begin != values.begin());
+  CHECK(it_end != values.end());
+  *search_begin = it_end;
+
+  if (it_begin == it_end) {
     LOG(WARNING) << "Too few IMU measurements available between time "
                  << timestamp_ns_from << "[ns] and " << timestamp_ns_to
                  << "[ns].";
@@ -81,49 +85,68 @@ ImuMeasurementBuffer::getImuDataInterpolatedBorders(
   }
 
   // The first and last index will be replaced with the interpolated values.
-  const size_t num_measurements = between_values.size() + 2u;
+  const size_t num_measurements = std::distance(it_begin, it_end) + 2u;
   imu_timestamps->resize(Eigen::NoChange, num_measurements);
   imu_measurements->resize(Eigen::NoChange, num_measurements);
 
-  for (size_t idx = 1u; idx < num_measurements - 1u; ++idx) {
-    (*imu_timestamps)(idx) = between_values[idx - 1u].timestamp;
-    (*imu_measurements).col(idx) = between_values[idx - 1u].imu_data;
+  size_t idx = 1u;
+  for (Buffer::BufferType::const_iterator it = it_begin; it != it_end;
+       ++it, ++idx) {
+    (*imu_timestamps)(idx) = it->second.timestamp;
+    imu_measurements->col(idx) = it->second.imu_data;
   }
 
-  // Interpolate border values.
-  int64_t pre_border_timestamp, post_border_timestamp;
-  vio::ImuMeasurement pre_border_value, post_border_value;
+  // Interpolate border values from the measurements around them.
   vio::ImuData interpolated_measurement;
-
-  // Interpolate lower border.
-  CHECK(
-      buffer_.getValueAtOrBeforeTime(
-          timestamp_ns_from, &pre_border_timestamp, &pre_border_value));
-  CHECK_EQ(pre_border_timestamp, pre_border_value.timestamp);
-  CHECK(
-      buffer_.getValueAtOrAfterTime(
-          timestamp_ns_from, &post_border_timestamp, &post_border_value));
-  CHECK_EQ(post_border_timestamp, post_border_value.timestamp);
-  linearInterpolate(pre_border_value.timestamp, pre_border_value.imu_data,
-                    post_border_value.timestamp, post_border_value.imu_data,
+  const vio::ImuMeasurement& pre_lower_border = std::prev(it_begin)->second;
+  const vio::ImuMeasurement& post_lower_border =
+      pre_lower_border.timestamp == timestamp_ns_from ? pre_lower_border
+                                                      : it_begin->second;
+  linearInterpolate(pre_lower_border.timestamp, pre_lower_border.imu_data,
+                    post_lower_border.timestamp, post_lower_border.imu_data,
                     timestamp_ns_from, &interpolated_measurement);
   (*imu_timestamps).leftCols<1>()(0) = timestamp_ns_from;
   (*imu_measurements).leftCols<1>() = interpolated_measurement;
 
-  // Interpolate upper border.
-  CHECK(
-      buffer_.getValueAtOrBeforeTime(
-          timestamp_ns_to, &pre_border_timestamp, &pre_border_value));
-  CHECK_EQ(pre_border_timestamp, pre_border_value.timestamp);
-  CHECK(
-      buffer_.getValueAtOrAfterTime(
-          timestamp_ns_to, &post_border_timestamp, &post_border_value));
-  CHECK_EQ(post_border_timestamp, post_border_value.timestamp);
-  linearInterpolate(pre_border_value.timestamp, pre_border_value.imu_data,
-                    post_border_value.timestamp, post_border_value.imu_data,
+  const vio::ImuMeasurement& post_upper_border = it_end->second;
+  const vio::ImuMeasurement& pre_upper_border =
+      post_upper_border.timestamp == timestamp_ns_to
+          ? post_upper_border
+          : std::prev(it_end)->second;
+  linearInterpolate(pre_upper_border.timestamp, pre_upper_border.imu_data,
+                    post_upper_border.timestamp, post_upper_border.imu_data,
                     timestamp_ns_to, &interpolated_measurement);
   (*imu_timestamps).rightCols<1>()(0) = timestamp_ns_to;
   (*imu_measurements).rightCols<1>() = interpolated_measurement;
+  return QueryResult::kDataAvailable;
+}
+
+ImuMeasurementBuffer::QueryResult
+ImuMeasurementBuffer::getImuDataInterpolatedBorders(
+    int64_t timestamp_ns_from, int64_t timestamp_ns_to,
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_measurements) {
+  CHECK_NOTNULL(imu_timestamps);
+  CHECK_NOTNULL(imu_measurements);
+
+  QueryResult query_result =
+      isDataAvailableUpToImpl(timestamp_ns_from, timestamp_ns_to);
+  if (query_result != QueryResult::kDataAvailable) {
+    imu_timestamps->resize(Eigen::NoChange, 0);
+    imu_measurements->resize(Eigen::NoChange, 0);
+    return query_result;
+  }
+
+  // The measurements are read in place from the time-sorted buffer and
+  // written straight to the output, so the output matrices are the only
+  // storage and they are only reallocated if their size changes.
+  buffer_.lockContainer();
+  Buffer::BufferType::const_iterator search_begin =
+      buffer_.buffered_values().begin();
+  query_result = getImuDataInterpolatedBordersImpl(
+      timestamp_ns_from, timestamp_ns_to, &search_begin, imu_timestamps,
+      imu_measurements);
+  buffer_.unlockContainer();
 
   return query_result;
 }
@@ -178,11 +201,52 @@ ImuMeasurementBuffer::getImuDataInterpolatedBordersBlocking(
       }
     }
   }
-  statistics::StatsCollector imu_pop_time("Wait time for IMU data [ms]");
-  imu_pop_time.AddSample(
+  static const common::telemetry::Metric kImuPopTime(
+      "Wait time for IMU data [ms]");
+  kImuPopTime.addSample(
       aslam::time::to_milliseconds(total_elapsed_time_nanoseconds));
   return getImuDataInterpolatedBorders(
       timestamp_ns_from, timestamp_ns_to, imu_timestamps, imu_measurements);
 }
 
+ImuMeasurementBuffer::QueryResult
+ImuMeasurementBuffer::getImuDataInterpolatedBordersOfIntervals(
+    const std::vector<int64_t>& border_timestamps_ns,
+    std::vector<Eigen::Matrix<int64_t, 1, Eigen::Dynamic>>* imu_timestamps,
+    std::vector<Eigen::Matrix<double, 6, Eigen::Dynamic>>* imu_measurements) {
+  CHECK_NOTNULL(imu_timestamps);
+  CHECK_NOTNULL(imu_measurements);
+  CHECK_GE(border_timestamps_ns.size(), 2u);
+  const size_t num_intervals = border_timestamps_ns.size() - 1u;
+  imu_timestamps->resize(num_intervals);
+  imu_measurements->resize(num_intervals);
+
+  // The intervals are consecutive, so every search continues where the
+  // previous interval ended.
+  QueryResult query_result = QueryResult::kDataAvailable;
+  size_t interval_idx = 0u;
+  buffer_.lockContainer();
+  Buffer::BufferType::const_iterator search_begin =
+      buffer_.buffered_values().begin();
+  for (; interval_idx < num_intervals; ++interval_idx) {
+    const int64_t timestamp_ns_from = border_timestamps_ns[interval_idx];
+    const int64_t timestamp_ns_to = border_timestamps_ns[interval_idx + 1u];
+    query_result = isDataAvailableUpToImpl(timestamp_ns_from, timestamp_ns_to);
+    if (query_result == QueryResult::kDataAvailable) {
+      query_result = getImuDataInterpolatedBordersImpl(
+          timestamp_ns_from, timestamp_ns_to, &search_begin,
+          &(*imu_timestamps)[interval_idx],
+          &(*imu_measurements)[interval_idx]);
+    }
+    if (query_result != QueryResult::kDataAvailable) {
+      break;
+    }
+  }
+  buffer_.unlockContainer();
+
+  imu_timestamps->resize(interval_idx);
+  imu_measurements->resize(interval_idx);
+  return query_result;
+}
+
 }  // namespace vio_common
@@ -0,0 +1,64 @@
+#include "vio-common/pipeline-trace.h"
+
+#include <chrono>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace vio {
+
+std::atomic<int64_t> PipelineTrace::next_id_(0);
+
+PipelineTrace::PipelineTrace(
+    const int64_t capture_timestamp_ns, const int64_t start_ns,
+    PipelineTraceSink* sink)
+    : id_(next_id_.fetch_add(1)),
+      capture_timestamp_ns_(capture_timestamp_ns),
+      start_ns_(start_ns),
+      sink_(sink) {}
+
+int64_t PipelineTrace::nowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void PipelineTrace::addStage(
+    const char* name, const int64_t enter_ns, const int64_t exit_ns) {
+  CHECK_NOTNULL(name);
+  CHECK_LE(enter_ns, exit_ns);
+  const PipelineTraceStage stage{name, enter_ns, exit_ns};
+  {
+    std::lock_guard<std::mutex> lock(m_stages_);
+    stages_.push_back(stage);
+  }
+  if (sink_ != nullptr) {
+    sink_->addStage(*this, stage);
+  }
+}
+
+void PipelineTrace::addStagesOf(const PipelineTrace& other) {
+  CHECK_NE(&other, this);
+  for (const PipelineTraceStage& stage : other.getStages()) {
+    addStage(stage.name, stage.enter_ns, stage.exit_ns);
+  }
+}
+
+std::vector<PipelineTraceStage> PipelineTrace::getStages() const {
+  std::lock_guard<std::mutex> lock(m_stages_);
+  return stages_;
+}
+
+ScopedPipelineTraceStage::ScopedPipelineTraceStage(
+    PipelineTrace* trace, const char* name)
+    : trace_(trace),
+      name_(name),
+      enter_ns_(trace != nullptr ? PipelineTrace::nowNanoseconds() : 0) {}
+
+ScopedPipelineTraceStage::~ScopedPipelineTraceStage() {
+  if (trace_ != nullptr) {
+    trace_->addStage(name_, enter_ns_, PipelineTrace::nowNanoseconds());
+  }
+}
+
+}  // namespace vio
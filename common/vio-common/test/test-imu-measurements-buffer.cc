@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <Eigen/Dense>
 
 #include <eigen-checks/gtest.h>
@@ -128,6 +130,87 @@ TEST(ImuMeasurementBuffer, getImuDataInterpolatedBorders) {
   EXPECT_EQ(imu_measurements.col(2)(0), 29.0);
 }
 
+TEST(ImuMeasurementBuffer, TooFewMeasurementsBetweenBorders) {
+  vio_common::ImuMeasurementBuffer buffer(-1);
+  buffer.addMeasurement(10, vio::ImuData::Constant(10.0));
+  buffer.addMeasurement(20, vio::ImuData::Constant(20.0));
+
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> imu_measurements;
+  vio_common::ImuMeasurementBuffer::QueryResult result =
+      buffer.getImuDataInterpolatedBorders(
+          10, 20, &imu_timestamps, &imu_measurements);
+  ASSERT_EQ(
+      result,
+      vio_common::ImuMeasurementBuffer::QueryResult::
+          kTooFewMeasurementsAvailable);
+  EXPECT_EQ(0u, imu_timestamps.size());
+  EXPECT_EQ(0u, imu_measurements.size());
+
+  buffer.addMeasurement(30, vio::ImuData::Constant(30.0));
+  result = buffer.getImuDataInterpolatedBorders(
+      12, 28, &imu_timestamps, &imu_measurements);
+  ASSERT_EQ(
+      result, vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+  ASSERT_EQ(imu_timestamps.cols(), 3);
+  EXPECT_EQ(imu_timestamps(0), 12);
+  EXPECT_EQ(imu_timestamps(1), 20);
+  EXPECT_EQ(imu_timestamps(2), 28);
+  EXPECT_EQ(imu_measurements.col(0)(0), 12.0);
+  EXPECT_EQ(imu_measurements.col(1)(0), 20.0);
+  EXPECT_EQ(imu_measurements.col(2)(0), 28.0);
+}
+
+TEST(ImuMeasurementBuffer, getImuDataInterpolatedBordersOfIntervals) {
+  vio_common::ImuMeasurementBuffer buffer(-1);
+  for (int64_t timestamp = 10; timestamp <= 50; timestamp += 5) {
+    buffer.addMeasurement(
+        timestamp, vio::ImuData::Constant(static_cast<double>(timestamp)));
+  }
+
+  // The intervals match the single interval queries.
+  const std::vector<int64_t> border_timestamps_ns = {12, 20, 33, 48};
+  std::vector<Eigen::Matrix<int64_t, 1, Eigen::Dynamic>> imu_timestamps;
+  std::vector<Eigen::Matrix<double, 6, Eigen::Dynamic>> imu_measurements;
+  vio_common::ImuMeasurementBuffer::QueryResult result =
+      buffer.getImuDataInterpolatedBordersOfIntervals(
+          border_timestamps_ns, &imu_timestamps, &imu_measurements);
+  ASSERT_EQ(
+      result, vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+  ASSERT_EQ(imu_timestamps.size(), 3u);
+  ASSERT_EQ(imu_measurements.size(), 3u);
+  for (size_t idx = 0u; idx < imu_timestamps.size(); ++idx) {
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> expected_imu_timestamps;
+    Eigen::Matrix<double, 6, Eigen::Dynamic> expected_imu_measurements;
+    ASSERT_EQ(
+        buffer.getImuDataInterpolatedBorders(
+            border_timestamps_ns[idx], border_timestamps_ns[idx + 1u],
+            &expected_imu_timestamps, &expected_imu_measurements),
+        vio_common::ImuMeasurementBuffer::QueryResult::kDataAvailable);
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+        imu_timestamps[idx], expected_imu_timestamps));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+        imu_measurements[idx], expected_imu_measurements));
+  }
+
+  // Only the leading intervals that are covered are returned.
+  result = buffer.getImuDataInterpolatedBordersOfIntervals(
+      {12, 20, 33, 60}, &imu_timestamps, &imu_measurements);
+  EXPECT_EQ(
+      result,
+      vio_common::ImuMeasurementBuffer::QueryResult::kDataNotYetAvailable);
+  EXPECT_EQ(imu_timestamps.size(), 2u);
+  EXPECT_EQ(imu_measurements.size(), 2u);
+
+  result = buffer.getImuDataInterpolatedBordersOfIntervals(
+      {12, 20, 22, 33}, &imu_timestamps, &imu_measurements);
+  EXPECT_EQ(
+      result, vio_common::ImuMeasurementBuffer::QueryResult::
+                  kTooFewMeasurementsAvailable);
+  EXPECT_EQ(imu_timestamps.size(), 1u);
+  EXPECT_EQ(imu_measurements.size(), 1u);
+}
+
 TEST(ImuMeasurementBuffer, DeathOnAddDataNotIncreasingTimestamp) {
   vio_common::ImuMeasurementBuffer buffer(-1);
 
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include <vio-common/pipeline-trace.h>
+
+namespace vio {
+
+class RecordingPipelineTraceSink : public PipelineTraceSink {
+ public:
+  void addStage(
+      const PipelineTrace& trace, const PipelineTraceStage& stage) override {
+    trace_ids.push_back(trace.id());
+    stages.push_back(stage);
+  }
+
+  std::vector<int64_t> trace_ids;
+  std::vector<PipelineTraceStage> stages;
+};
+
+TEST(PipelineTrace, StagesAreForwardedToTheSink) {
+  RecordingPipelineTraceSink sink;
+  constexpr int64_t kCaptureTimestampNs = 1234;
+  PipelineTrace trace(
+      kCaptureTimestampNs, PipelineTrace::nowNanoseconds(), &sink);
+  EXPECT_EQ(kCaptureTimestampNs, trace.captureTimestampNanoseconds());
+
+  trace.addStage("first", 10, 20);
+  { ScopedPipelineTraceStage stage(&trace, "second"); }
+
+  const std::vector<PipelineTraceStage> stages = trace.getStages();
+  ASSERT_EQ(2u, stages.size());
+  EXPECT_STREQ("first", stages[0].name);
+  EXPECT_EQ(10, stages[0].enter_ns);
+  EXPECT_EQ(20, stages[0].exit_ns);
+  EXPECT_STREQ("second", stages[1].name);
+  EXPECT_LE(stages[1].enter_ns, stages[1].exit_ns);
+
+  ASSERT_EQ(2u, sink.stages.size());
+  EXPECT_EQ(trace.id(), sink.trace_ids[0]);
+  EXPECT_EQ(trace.id(), sink.trace_ids[1]);
+}
+
+TEST(PipelineTrace, StagesOfOtherTracesCanBeAdded) {
+  RecordingPipelineTraceSink sink;
+  PipelineTrace trace(0, 0, &sink);
+  // A trace without a sink, e.g. from a separately published estimate.
+  PipelineTrace other_trace(0, 0, nullptr);
+  other_trace.addStage("estimator", 5, 15);
+  EXPECT_NE(trace.id(), other_trace.id());
+  EXPECT_TRUE(sink.stages.empty());
+
+  trace.addStagesOf(other_trace);
+  ASSERT_EQ(1u, trace.getStages().size());
+  ASSERT_EQ(1u, sink.stages.size());
+  EXPECT_STREQ("estimator", sink.stages[0].name);
+  EXPECT_EQ(5, sink.stages[0].enter_ns);
+  EXPECT_EQ(15, sink.stages[0].exit_ns);
+}
+
+TEST(PipelineTrace, ScopedStageWithoutTraceDoesNothing) {
+  ScopedPipelineTraceStage stage(nullptr, "disabled");
+}
+
+}  // namespace vio
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -64,6 +64,22 @@ DEFINE_double(
     dense_tsdf_max_ray_length_m, 20.,
     "Maximum ray length integrated into the TSDF grid.");
 
+DEFINE_uint64(
+    dense_tsdf_integrator_threads, 0u,
+    "Number of threads that integrate a depth frame into the TSDF grid. 0 uses "
+    "all hardware threads.");
+
+DEFINE_double(
+    dense_tsdf_tile_size_m, 0.0,
+    "If larger than 0, create_tsdf_from_depth_resource integrates the TSDF "
+    "grid in tiles of this size [m] and streams the finished tiles and their "
+    "meshes to --dense_tsdf_tile_output_folder, instead of keeping the whole "
+    "grid in memory and storing it as a map resource.");
+
+DEFINE_string(
+    dense_tsdf_tile_output_folder, "",
+    "Folder for the TSDF and mesh tiles of the tiled TSDF integration.");
+
 DEFINE_string(
     dense_image_export_path, "",
     "Export folder for image export function. console command: "
@@ -314,6 +330,10 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
         tsdf_integrator_config.max_ray_length_m =
             static_cast<voxblox::FloatingPoint>(
                 FLAGS_dense_tsdf_max_ray_length_m);
+        if (FLAGS_dense_tsdf_integrator_threads > 0u) {
+          tsdf_integrator_config.integrator_threads =
+              FLAGS_dense_tsdf_integrator_threads;
+        }
 
         voxblox::TsdfMap::Config tsdf_map_config;
         tsdf_map_config.tsdf_voxel_size =
@@ -326,6 +346,23 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
             static_cast<backend::ResourceType>(
                 FLAGS_dense_depth_resource_input_type);
 
+        if (FLAGS_dense_tsdf_tile_size_m > 0.0) {
+          if (FLAGS_dense_tsdf_tile_output_folder.empty()) {
+            LOG(ERROR) << "No tile output folder specified, please set "
+                          "--dense_tsdf_tile_output_folder .";
+            return common::kStupidUserError;
+          }
+          if (!voxblox_interface::integrateAllDepthResourcesOfTypeTiled(
+                  mission_ids, input_resource_type,
+                  FLAGS_dense_use_distorted_camera, tsdf_integrator_config,
+                  FLAGS_dense_tsdf_tile_size_m,
+                  FLAGS_dense_tsdf_tile_output_folder, map.get(), &tsdf_map)) {
+            LOG(ERROR) << "Unable to compute the tiled Voxblox TSDF grid.";
+            return common::kStupidUserError;
+          }
+          return common::kSuccess;
+        }
+
         if (!voxblox_interface::integrateAllDepthResourcesOfType(
                 mission_ids, input_resource_type,
                 FLAGS_dense_use_distorted_camera, tsdf_integrator_config,
@@ -364,7 +401,9 @@ DenseReconstructionPlugin::DenseReconstructionPlugin(
       "and integrate them into a Voxblox TSDF map. The map is then stored as "
       "resource associated with the selected set of missions. This command "
       "will use the resource type specified by "
-      "--dense_depth_resource_input_type if available.",
+      "--dense_depth_resource_input_type if available. With "
+      "--dense_tsdf_tile_size_m the grid and its mesh are written to disk "
+      "tile by tile instead.",
       common::Processing::Sync);
 
   addCommand(
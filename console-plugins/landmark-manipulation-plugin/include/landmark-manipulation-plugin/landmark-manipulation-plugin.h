@@ -2,9 +2,11 @@
 #define LANDMARK_MANIPULATION_PLUGIN_LANDMARK_MANIPULATION_PLUGIN_H_
 
 #include <string>
+#include <unordered_map>
 
 #include <console-common/console-plugin-base-with-plotter.h>
 #include <console-common/console.h>
+#include <landmark-triangulation/landmark-triangulation.h>
 #include <visualization/viwls-graph-plotter.h>
 
 namespace landmark_manipulation_plugin {
@@ -24,6 +26,10 @@ class LandmarkManipulationPlugin : public common::ConsolePluginBaseWithPlotter {
   int resetLandmarkQualityToUnknown();
   int initTrackLandmarks();
   int removeBadLandmarks();
+
+  // The state of each map at its last retriangulation, by map key.
+  std::unordered_map<std::string, landmark_triangulation::TriangulationRecord>
+      triangulation_records_;
 };
 
 }  // namespace landmark_manipulation_plugin
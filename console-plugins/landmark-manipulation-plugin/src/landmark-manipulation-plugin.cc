@@ -1,5 +1,7 @@
 #include "landmark-manipulation-plugin/landmark-manipulation-plugin.h"
 
+#include <cmath>
+
 #include <console-common/basic-console-plugin.h>
 #include <console-common/console.h>
 #include <landmark-triangulation/landmark-triangulation.h>
@@ -9,6 +11,19 @@
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 
+DEFINE_bool(
+    rtl_only_changed_landmarks, false,
+    "Only retriangulate the landmarks observed by vertices that moved since "
+    "the last retriangulation of the selected map in this console, and the "
+    "landmarks whose observations changed.");
+DEFINE_double(
+    rtl_min_vertex_translation_m, 0.01,
+    "Minimum translation of a vertex for its landmarks to be retriangulated "
+    "with --rtl_only_changed_landmarks.");
+DEFINE_double(
+    rtl_min_vertex_rotation_deg, 0.1,
+    "Minimum rotation of a vertex for its landmarks to be retriangulated "
+    "with --rtl_only_changed_landmarks.");
 DECLARE_string(map_mission);
 
 namespace landmark_manipulation_plugin {
@@ -19,7 +34,9 @@ LandmarkManipulationPlugin::LandmarkManipulationPlugin(
   addCommand(
       {"retriangulate_landmarks", "rtl"},
       [this]() -> int { return retriangulateLandmarks(); },
-      "Retriangulate all landmarks.", common::Processing::Sync);
+      "Retriangulate all landmarks, or only the ones that changed with "
+      "--rtl_only_changed_landmarks.",
+      common::Processing::Sync);
   addCommand(
       {"evaluate_landmark_quality", "elq"},
       [this]() -> int { return evaluateLandmarkQuality(); },
@@ -50,8 +67,20 @@ int LandmarkManipulationPlugin::retriangulateLandmarks() {
   vi_map::VIMapManager map_manager;
   vi_map::VIMapManager::MapWriteAccess map =
       map_manager.getMapWriteAccess(selected_map_key);
+  landmark_triangulation::TriangulationRecord& record =
+      triangulation_records_[selected_map_key];
+  if (FLAGS_rtl_only_changed_landmarks) {
+    const size_t num_retriangulated_landmarks =
+        landmark_triangulation::retriangulateChangedLandmarks(
+            FLAGS_rtl_min_vertex_translation_m,
+            FLAGS_rtl_min_vertex_rotation_deg * M_PI / 180.0, &record,
+            map.get());
+    VLOG(1) << "Retriangulated " << num_retriangulated_landmarks << " of "
+            << map->numLandmarks() << " landmarks.";
+    return common::kSuccess;
+  }
   const bool success =
-      landmark_triangulation::retriangulateLandmarks(map.get());
+      landmark_triangulation::retriangulateLandmarks(map.get(), &record);
   return (success ? common::kSuccess : common::kUnknownError);
 }
 
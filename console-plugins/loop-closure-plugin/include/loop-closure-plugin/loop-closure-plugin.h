@@ -30,6 +30,8 @@ class LoopClosurePlugin : public common::ConsolePluginBaseWithPlotter {
   int serializeLoopDetector() const;
   int alignMissionsForEvaluation() const;
   int evaluateLocalization() const;
+  int benchmarkLocalization() const;
+  int storeProjectedDescriptors() const;
 };
 }  // namespace loop_closure_plugin
 
@@ -26,6 +26,9 @@ class VILocalizationEvaluator {
   void alignMissionsForEvaluation(const vi_map::MissionId& query_mission_id);
   void evaluateLocalizationPerformance(
       const vi_map::MissionId& query_mission_id);
+  // Runs the localization benchmark over the configurations given by the
+  // --lc_benchmark_* flags and writes the results as JSON.
+  bool benchmarkLocalization(const vi_map::MissionId& query_mission_id);
 
  private:
   vi_map::VIMap* map_;
@@ -1,6 +1,7 @@
 #include "loop-closure-plugin/loop-closure-plugin.h"
 
 #include <console-common/console.h>
+#include <loop-closure-handler/loop-detector-node.h>
 #include <map-manager/map-manager.h>
 #include <posegraph/pose-graph.h>
 #include <posegraph/unique-id.h>
@@ -54,6 +55,24 @@ LoopClosurePlugin::LoopClosurePlugin(
       "Evaluation localization between a query and database missions. "
       "Please align the missions first.",
       common::Processing::Sync);
+
+  addCommand(
+      {"bloc", "benchmark_localization"},
+      [this]() -> int { return benchmarkLocalization(); },
+      "Benchmark the localization of a query mission against the database "
+      "missions for every loop-detector configuration given by the "
+      "--lc_benchmark_* flags and write the latencies, throughput, memory and "
+      "recall as JSON to --lc_benchmark_out. Please align the missions first.",
+      common::Processing::Sync);
+
+  addCommand(
+      {"spd", "store_projected_descriptors"},
+      [this]() -> int { return storeProjectedDescriptors(); },
+      "Project the descriptors of all frames of all missions and store them "
+      "in the map, such that loop-closure, anchoring, localization evaluation "
+      "and summary map creation don't project them again. Needs to be rerun "
+      "if the projection changes.",
+      common::Processing::Sync);
 }
 
 bool areQualitiesOfAllLandmarksSet(const vi_map::VIMap& map) {
@@ -196,6 +215,50 @@ int LoopClosurePlugin::evaluateLocalization() const {
   return common::kSuccess;
 }
 
+int LoopClosurePlugin::benchmarkLocalization() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionId query_mission_id;
+  map->ensureMissionIdValid(FLAGS_map_mission, &query_mission_id);
+
+  if (!query_mission_id.isValid()) {
+    LOG(ERROR) << "The given mission \"" << FLAGS_map_mission
+               << "\" is not valid.";
+    return common::kUnknownError;
+  }
+
+  VILocalizationEvaluator evaluator(map.get(), plotter_);
+  if (!evaluator.benchmarkLocalization(query_mission_id)) {
+    return common::kUnknownError;
+  }
+  return common::kSuccess;
+}
+
+int LoopClosurePlugin::storeProjectedDescriptors() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdList mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  const loop_detector_node::LoopDetectorNode loop_detector;
+  const size_t num_stored_frames =
+      loop_detector.storeProjectedDescriptorsInMap(mission_ids, map.get());
+  LOG(INFO) << "Stored the projected descriptors of " << num_stored_frames
+            << " frames.";
+  return common::kSuccess;
+}
+
 }  // namespace loop_closure_plugin
 
 MAPLAB_CREATE_CONSOLE_PLUGIN_WITH_PLOTTER(
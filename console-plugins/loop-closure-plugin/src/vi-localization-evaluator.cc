@@ -1,5 +1,8 @@
 #include "loop-closure-plugin/vi-localization-evaluator.h"
 
+#include <vector>
+
+#include <localization-evaluator/localization-benchmark.h>
 #include <localization-evaluator/localization-evaluator.h>
 #include <localization-evaluator/mission-aligner.h>
 #include <maplab-common/file-system-tools.h>
@@ -68,4 +71,22 @@ void VILocalizationEvaluator::evaluateLocalizationPerformance(
   }
 }
 
+bool VILocalizationEvaluator::benchmarkLocalization(
+    const vi_map::MissionId& query_mission_id) {
+  CHECK(map_->hasMission(query_mission_id));
+  if (map_->numMissions() < 2u) {
+    LOG(ERROR) << "The map needs at least one database mission besides the "
+               << "query mission.";
+    return false;
+  }
+
+  std::vector<localization_evaluator::LocalizationBenchmarkConfig> configs;
+  localization_evaluator::getLocalizationBenchmarkConfigsFromFlags(&configs);
+  std::vector<localization_evaluator::LocalizationBenchmarkResult> results;
+  localization_evaluator::runLocalizationBenchmarks(
+      configs, query_mission_id, map_, &results);
+  return localization_evaluator::writeLocalizationBenchmarkResultsAsJson(
+      results);
+}
+
 }  // namespace loop_closure_plugin
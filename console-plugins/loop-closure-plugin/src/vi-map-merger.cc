@@ -1,5 +1,6 @@
 #include "loop-closure-plugin/vi-map-merger.h"
 
+#include <loop-closure-handler/loop-detector-cache.h>
 #include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/file-system-tools.h>
 #include <vi-map/vi-map.h>
@@ -72,20 +73,30 @@ int VIMapMerger::findLoopClosuresBetweenMissions(
     // We want to match all missions to all, so we do the full upper triangle
     // including the matching of every mission to itself to find loop-closures
     // within the mission.
+    // Without visualization the databases come from the process-wide cache,
+    // so they are reused if the missions are queried again before the map
+    // changes.
     for (vi_map::MissionIdList::const_iterator it = mission_ids.begin();
          it != mission_ids.end(); ++it) {
       CHECK(it->isValid());
-      loop_detector_node::LoopDetectorNode loop_detector;
+      loop_detector_node::LoopDetectorNode::ConstPtr loop_detector;
       if (plotter_ != nullptr) {
-        loop_detector.instantiateVisualizer();
+        loop_detector_node::LoopDetectorNode::Ptr visualizing_loop_detector(
+            new loop_detector_node::LoopDetectorNode);
+        visualizing_loop_detector->instantiateVisualizer();
+        visualizing_loop_detector->addMissionToDatabase(*it, *map_);
+        loop_detector = visualizing_loop_detector;
+      } else {
+        loop_detector =
+            loop_detector_node::LoopDetectorCache::getInstance().getDatabase(
+                vi_map::MissionIdSet{*it}, *map_);
       }
-      loop_detector.addMissionToDatabase(*it, *map_);
       for (vi_map::MissionIdList::const_iterator jt = it;
            jt != mission_ids.end(); ++jt) {
         if (FLAGS_lc_only_against_other_missions && *jt == *it) {
           continue;
         }
-        loop_detector.detectLoopClosuresAndMergeLandmarks(*jt, map_);
+        loop_detector->detectLoopClosuresAndMergeLandmarks(*jt, map_);
       }
     }
   }
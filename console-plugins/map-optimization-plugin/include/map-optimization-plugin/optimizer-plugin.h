@@ -25,6 +25,8 @@ class OptimizerPlugin : public common::ConsolePluginBaseWithPlotter {
 
  private:
   int optimizeVisualInertial(bool visual_only, bool outlier_rejection);
+  int optimizeLocalVisualInertial(bool outlier_rejection);
+  int optimizePartitionedVisualInertial(bool outlier_rejection);
 
   int relaxMap();
   int relaxMapMissionsSeparately();
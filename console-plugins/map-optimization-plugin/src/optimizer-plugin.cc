@@ -4,7 +4,9 @@
 #include <console-common/basic-console-plugin.h>
 #include <console-common/console.h>
 #include <map-manager/map-manager.h>
+#include <map-optimization/local-optimization-window.h>
 #include <map-optimization/outlier-rejection-solver.h>
+#include <map-optimization/partitioned-optimization.h>
 #include <map-optimization/vi-optimization-builder.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
@@ -42,6 +44,26 @@ OptimizerPlugin::OptimizerPlugin(
       "Visual-inertial optimization over the selected missions "
       "(per default all).",
       common::Processing::Sync);
+  addCommand(
+      {"optimize_visual_inertial_local", "optvi_local"},
+      [this]() -> int {
+        return optimizeLocalVisualInertial(
+            FLAGS_ba_use_outlier_rejection_solver);
+      },
+      "Local visual-inertial optimization around the latest vertices of the "
+      "selected mission (per default all missions). The window size is set "
+      "with the --ba_local_* flags.",
+      common::Processing::Sync);
+  addCommand(
+      {"optimize_visual_inertial_partitioned", "optvi_partitioned"},
+      [this]() -> int {
+        return optimizePartitionedVisualInertial(
+            FLAGS_ba_use_outlier_rejection_solver);
+      },
+      "Partitioned visual-inertial optimization of the selected mission (per "
+      "default all missions). The partitioning is set with the "
+      "--ba_partitioned_* flags.",
+      common::Processing::Sync);
   addCommand(
       {"relax"}, [this]() -> int { return relaxMap(); }, "nRelax posegraph.",
       common::Processing::Sync);
@@ -111,6 +133,90 @@ int OptimizerPlugin::optimizeVisualInertial(
   return common::kSuccess;
 }
 
+int OptimizerPlugin::optimizeLocalVisualInertial(bool outlier_rejection) {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdList mission_ids;
+  if (!FLAGS_map_mission.empty()) {
+    vi_map::MissionId mission_id;
+    if (!map->hexStringToMissionIdIfValid(FLAGS_map_mission, &mission_id)) {
+      LOG(ERROR) << "The given mission id \"" << FLAGS_map_mission
+                 << "\" is not valid.";
+      return common::kStupidUserError;
+    }
+    mission_ids.emplace_back(mission_id);
+  } else {
+    map->getAllMissionIds(&mission_ids);
+  }
+
+  const map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  const map_optimization::LocalOptimizationWindowOptions window_options =
+      map_optimization::LocalOptimizationWindowOptions::initFromGFlags();
+  map_optimization::OutlierRejectionSolverOptions outlier_rejection_options =
+      map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+
+  map_optimization::VIMapOptimizer optimizer(plotter_, kSignalHandlerEnabled);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    map_optimization::LocalOptimizationWindow window;
+    map_optimization::selectLocalOptimizationWindowOfLatestVertices(
+        *map, mission_id, window_options, &window);
+    const bool success = optimizer.optimizeLocalVisualInertial(
+        options, window,
+        outlier_rejection ? &outlier_rejection_options : nullptr, map.get());
+    if (!success) {
+      return common::kUnknownError;
+    }
+  }
+  return common::kSuccess;
+}
+
+int OptimizerPlugin::optimizePartitionedVisualInertial(
+    bool outlier_rejection) {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map::MissionIdSet missions_to_optimize;
+  if (!FLAGS_map_mission.empty()) {
+    vi_map::MissionId mission_id;
+    if (!map->hexStringToMissionIdIfValid(FLAGS_map_mission, &mission_id)) {
+      LOG(ERROR) << "The given mission id \"" << FLAGS_map_mission
+                 << "\" is not valid.";
+      return common::kStupidUserError;
+    }
+    missions_to_optimize.insert(mission_id);
+  } else {
+    map->getAllMissionIds(&missions_to_optimize);
+  }
+
+  const map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  const map_optimization::PartitionedOptimizationOptions partitioned_options =
+      map_optimization::PartitionedOptimizationOptions::initFromGFlags();
+  map_optimization::OutlierRejectionSolverOptions outlier_rejection_options =
+      map_optimization::OutlierRejectionSolverOptions::initFromFlags();
+
+  map_optimization::VIMapOptimizer optimizer(plotter_, kSignalHandlerEnabled);
+  const bool success = optimizer.optimizePartitionedVisualInertial(
+      options, partitioned_options, missions_to_optimize,
+      outlier_rejection ? &outlier_rejection_options : nullptr, map.get());
+  if (!success) {
+    return common::kUnknownError;
+  }
+  return common::kSuccess;
+}
+
 int OptimizerPlugin::relaxMap() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
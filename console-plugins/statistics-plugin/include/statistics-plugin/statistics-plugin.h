@@ -15,6 +15,9 @@ class StatisticsPlugin : public common::ConsolePluginBase {
   virtual std::string getPluginId() const override {
     return "statistics";
   }
+
+ private:
+  int printMapMemoryStats() const;
 };
 
 }  // namespace statistics_plugin
@@ -1,10 +1,21 @@
 #include "statistics-plugin/statistics-plugin.h"
 
 #include <iostream>  //NOLINT
+#include <string>
 
 #include <aslam/common/statistics/statistics.h>
 #include <aslam/common/timer.h>
 #include <console-common/console.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <map-manager/map-manager.h>
+#include <maplab-common/telemetry.h>
+#include <vi-map/map-memory-usage.h>
+#include <vi-map/vi-map.h>
+
+DEFINE_string(
+    telemetry_format, "prometheus",
+    "Format of the telemetry command, \"prometheus\" or \"json\".");
 
 namespace statistics_plugin {
 
@@ -25,6 +36,53 @@ StatisticsPlugin::StatisticsPlugin(common::Console* console)
         return common::kSuccess;
       },
       "Print statistics.", common::Processing::Sync);
+
+  addCommand(
+      {"telemetry"},
+      []() -> int {
+        if (FLAGS_telemetry_format == "prometheus") {
+          std::cout << common::telemetry::exportPrometheus();
+        } else if (FLAGS_telemetry_format == "json") {
+          std::cout << common::telemetry::exportJson();
+        } else {
+          LOG(ERROR) << "Unknown telemetry format \"" << FLAGS_telemetry_format
+                     << "\".";
+          return common::kStupidUserError;
+        }
+        return common::kSuccess;
+      },
+      "Print the telemetry metrics in the format given by --telemetry_format.",
+      common::Processing::Sync);
+
+  addCommand(
+      {"map_memory_stats"}, [this]() -> int { return printMapMemoryStats(); },
+      "Print the estimated memory used by the selected map, per mission and "
+      "per component.",
+      common::Processing::Sync);
+}
+
+int StatisticsPlugin::printMapMemoryStats() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  const vi_map::VIMapManager::MapReadAccess map =
+      map_manager.getMapReadAccess(selected_map_key);
+
+  vi_map::MissionIdList mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  vi_map::MapMemoryUsage total_usage;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    vi_map::MapMemoryUsage mission_usage;
+    map->getMissionMemoryUsage(mission_id, &mission_usage);
+    std::cout << "Mission " << mission_id.hexString() << ":\n"
+              << mission_usage.print();
+    total_usage.accumulate(mission_usage);
+  }
+  total_usage.resource_cache_bytes = map->getResourceCacheMemoryUsageBytes();
+  std::cout << "Map " << selected_map_key << ":\n" << total_usage.print();
+  return common::kSuccess;
 }
 
 }  // namespace statistics_plugin
@@ -1,6 +1,8 @@
 #ifndef VI_MAP_BASIC_PLUGIN_VI_MAP_BASIC_PLUGIN_H_
 #define VI_MAP_BASIC_PLUGIN_VI_MAP_BASIC_PLUGIN_H_
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include <console-common/console-plugin-base-with-plotter.h>
@@ -8,6 +10,10 @@
 #include <console-common/console.h>
 #include <maplab-common/map-manager-config.h>
 
+namespace aslam {
+class ThreadPool;
+}  // namespace aslam
+
 namespace visualization {
 class ViwlsGraphRvizPlotter;
 }  // namespace visualization
@@ -20,6 +26,8 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
  public:
   VIMapBasicPlugin(
       common::Console* console, visualization::ViwlsGraphRvizPlotter* plotter);
+  // Waits for the maps that are loaded or saved in the background.
+  ~VIMapBasicPlugin();
 
   std::string getPluginId() const override {
     return "vi_map_basic";
@@ -33,6 +41,7 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int listMaps();
 
   int createNewMap();
+  int generateBenchmarkMap();
   int deleteMap();
   int clearStorage();
   int renameMap();
@@ -46,6 +55,12 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int saveMap();
   int saveAllMaps();
 
+  int loadMapInBackground();
+  int loadAllMapsInBackground();
+  int saveMapInBackground();
+  int saveAllMapsInBackground();
+  int waitForBackgroundMapIo();
+
   int loadMergeMap();
   int loadMergeAllMaps();
 
@@ -76,6 +91,16 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
   int spatiallyDistributeMissions();
 
   int convertMapToNewFormat();
+  // Rewrites the map in --map_folder in the current map format.
+  int migrateMap();
+
+  // Queues the map I/O on the background thread pool and returns. The
+  // function must only use the values it captured and not read any flags,
+  // because the next commands can change them.
+  void runMapIoInBackground(
+      const std::string& description, const std::function<bool()>& map_io);
+
+  std::unique_ptr<aslam::ThreadPool> map_io_thread_pool_;
 };
 
 }  // namespace vi_map
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include <aslam/common/memory.h>
+#include <aslam/common/thread-pool.h>
 #include <aslam/common/time.h>
 #include <console-common/console-plugin-base-with-plotter.h>
 #include <console-common/console.h>
@@ -18,8 +19,10 @@
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/ui-utility.h>
+#include <vi-map-helpers/benchmark-map-generator.h>
 #include <vi-map-helpers/mission-clustering-coobservation.h>
 #include <vi-map/check-map-consistency.h>
+#include <vi-map/map-format-version.h>
 #include <vi-map/semantics-manager.h>
 #include <vi-map/vi-map.h>
 #include <visualization/sequential-plotter.h>
@@ -53,15 +56,27 @@ DEFINE_string(
     "Set this to true to migrate the resources to an extneral folder (by "
     "moving the resources) before saving the map. This flag will be reset "
     "after every use.");
+DEFINE_bool(
+    check_map_structure_only, false,
+    "Only check the missions, sensors and the pose-graph structure in "
+    "check_map_consistency and skip the landmark and resource checks.");
 DEFINE_string(
     resource_folder, "", "Specifies the resource folder for certain commands.");
 DEFINE_uint64(
     vertices_per_proto_file, 200u,
     "Determines the number of vertices that are stored in one proto file. "
     "NOTE: If this is set too large, the map can't be read anymore.");
+DEFINE_bool(
+    save_columnar_snapshot, false,
+    "Also save a columnar snapshot of the vertex data next to the map protos, "
+    "which is loaded instead of the vertex protos if present.");
 DEFINE_string(
     maps_folder, ".",
     "Folder which contains one or more maps on the filesystem.");
+DEFINE_int32(
+    map_io_num_threads, 2,
+    "Number of threads that load and save maps in the background, see e.g. "
+    "load_in_background.");
 
 DEFINE_double(
     spatially_distribute_missions_meters, 20,
@@ -74,6 +89,28 @@ DEFINE_bool(
     "Should sdm distribute the missions around a circle.");
 
 namespace vi_map {
+namespace {
+
+// Reserves the space for all maps that will be merged into the base map, so
+// the containers of the base map are only grown once.
+template <typename KeyIterator>
+void reserveForMergingMaps(
+    const VIMapManager& map_manager, KeyIterator keys_begin,
+    KeyIterator keys_end, VIMap* base_map) {
+  CHECK_NOTNULL(base_map);
+  size_t num_vertices = base_map->numVertices();
+  size_t num_edges = base_map->numEdges();
+  size_t num_landmarks = base_map->numLandmarksInIndex();
+  for (KeyIterator it = keys_begin; it != keys_end; ++it) {
+    const VIMapManager::MapReadAccess map = map_manager.getMapReadAccess(*it);
+    num_vertices += map->numVertices();
+    num_edges += map->numEdges();
+    num_landmarks += map->numLandmarksInIndex();
+  }
+  base_map->reserveForMerge(num_vertices, num_edges, num_landmarks);
+}
+
+}  // namespace
 
 backend::SaveConfig parseSaveConfigFromGFlags() {
   backend::SaveConfig config;
@@ -116,12 +153,18 @@ backend::SaveConfig parseSaveConfigFromGFlags() {
   static constexpr size_t kMaxVerticesPerProtoFile = 300u;
   CHECK_LE(config.vertices_per_proto_file, kMaxVerticesPerProtoFile);
 
+  config.save_columnar_snapshot = FLAGS_save_columnar_snapshot;
+
   return config;
 }
 
 VIMapBasicPlugin::VIMapBasicPlugin(
     common::Console* console, visualization::ViwlsGraphRvizPlotter* plotter)
     : common::ConsolePluginBaseWithPlotter(CHECK_NOTNULL(console), plotter) {
+  CHECK_GT(FLAGS_map_io_num_threads, 0);
+  map_io_thread_pool_.reset(
+      new aslam::ThreadPool(static_cast<size_t>(FLAGS_map_io_num_threads)));
+
   // General commands.
   addCommand(
       {"select_map", "select"}, [this]() -> int { return selectMap(); },
@@ -142,6 +185,13 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       {"create_new_map"}, [this]() -> int { return createNewMap(); },
       "Creates a new, empty map. Usage: create_new_map --map_key=<new_map_key>",
       common::Processing::Sync);
+  addCommand(
+      {"generate_benchmark_map"},
+      [this]() -> int { return generateBenchmarkMap(); },
+      "Generates a large synthetic map configured by the "
+      "--benchmark_map_* flags. Usage: generate_benchmark_map "
+      "--map_key=<new_map_key>",
+      common::Processing::Sync);
   addCommand(
       {"delete_map", "delete"}, [this]() -> int { return deleteMap(); },
       "Deletes a map from the storage.", common::Processing::Sync);
@@ -207,6 +257,36 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       "map will be saved in the map folder (defined by the map metadata).",
       common::Processing::Sync);
 
+  addCommand(
+      {"load_in_background"}, [this]() -> int { return loadMapInBackground(); },
+      "Like load, but loads the map in the background, such that other "
+      "commands can run meanwhile. The map isn't selected after loading. "
+      "Usage: load_in_background --map_folder=<map_path> [--map_key=<key>]",
+      common::Processing::Sync);
+  addCommand(
+      {"load_all_in_background"},
+      [this]() -> int { return loadAllMapsInBackground(); },
+      "Like load_all, but loads the maps in the background. Usage: "
+      "load_all_in_background [--maps_folder=<map_path>]",
+      common::Processing::Sync);
+  addCommand(
+      {"save_in_background"}, [this]() -> int { return saveMapInBackground(); },
+      "Like save, but saves the selected map in the background. Commands that "
+      "access the map wait until it is saved. Takes the same flags as save.",
+      common::Processing::Sync);
+  addCommand(
+      {"save_all_in_background"},
+      [this]() -> int { return saveAllMapsInBackground(); },
+      "Like save_all, but saves the maps in the background. Takes the same "
+      "flags as save_all.",
+      common::Processing::Sync);
+  addCommand(
+      {"wait_for_background_map_io"},
+      [this]() -> int { return waitForBackgroundMapIo(); },
+      "Waits until all maps that are loaded or saved in the background are "
+      "done.",
+      common::Processing::Sync);
+
   addCommand(
       {"load_merge_map"}, [this]() -> int { return loadMergeMap(); },
       "Loads the map from the given path and merges the map with the currently "
@@ -274,26 +354,29 @@ VIMapBasicPlugin::VIMapBasicPlugin(
   addCommand(
       {"check_map_consistency"},
       [this]() -> int { return checkMapConsistency(); },
-      "Checks if the map is consistent.", common::Processing::Sync);
+      "Checks if the map is consistent.", common::Processing::Sync,
+      common::MapAccess::ReadOnly);
 
   // Map statistics, visualization.
   addCommand(
       {"ms", "map_stats"}, [this]() -> int { return mapStatistics(); },
-      "Print map statistics.", common::Processing::Sync);
+      "Print map statistics.", common::Processing::Sync,
+      common::MapAccess::ReadOnly);
   addCommand(
       {"mcs", "mission_coobservability_stats"},
       [this]() -> int { return printMissionCoobservabilityStatistics(); },
-      "Print mission co-observability statistics.", common::Processing::Sync);
+      "Print mission co-observability statistics.", common::Processing::Sync,
+      common::MapAccess::ReadOnly);
   addCommand(
       {"print_baseframes"},
       [this]() -> int { return printBaseframeTransformations(); },
       "Print baseframe transfromations for all missions.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
   addCommand(
       {"print_camera_calibrations"},
       [this]() -> int { return printCameraCalibrations(); },
       "Print the camera calibrations of all missions.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
   addCommand(
       {"spatially_distribute_missions"},
       [this]() -> int { return spatiallyDistributeMissions(); },
@@ -301,7 +384,8 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       common::Processing::Sync);
   addCommand(
       {"v", "visualize"}, [this]() -> int { return visualizeMap(); },
-      "Visualizes the selected map.", common::Processing::Sync);
+      "Visualizes the selected map.", common::Processing::Sync,
+      common::MapAccess::ReadOnly);
   addCommand(
       {"vs", "visualize_sequentially"},
       [this]() -> int { return visualizeMapSequentially(); },
@@ -326,6 +410,20 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       "Loads a map using deprecated deserialization and then stores it again "
       "using the latest serialization.",
       common::Processing::Sync);
+  addCommand(
+      {"migrate_map"}, [this]() -> int { return migrateMap(); },
+      "Loads the map in --map_folder and saves it again in the same folder in "
+      "the map format version given by "
+      "--vi_map_serialization_format_version. Usage: migrate_map "
+      "--map_folder=<path>",
+      common::Processing::Sync);
+}
+
+VIMapBasicPlugin::~VIMapBasicPlugin() {
+  if (map_io_thread_pool_) {
+    map_io_thread_pool_->waitForEmptyQueue();
+    map_io_thread_pool_->stop();
+  }
 }
 
 int VIMapBasicPlugin::selectMap() {
@@ -413,6 +511,28 @@ int VIMapBasicPlugin::createNewMap() {
   return common::kSuccess;
 }
 
+int VIMapBasicPlugin::generateBenchmarkMap() {
+  if (FLAGS_map_key.empty()) {
+    LOG(ERROR) << "No map key specified, please set flag \"map_key\" when "
+                  "calling this command.";
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  if (map_manager.hasMap(FLAGS_map_key)) {
+    LOG(ERROR) << "Key \"" << FLAGS_map_key << "\" already exists.";
+    return common::kUnknownError;
+  }
+
+  const vi_map_helpers::BenchmarkMapGenerator generator(
+      vi_map_helpers::BenchmarkMapOptions::fromGflags());
+  vi_map::VIMap::UniquePtr vi_map = aligned_unique<vi_map::VIMap>();
+  generator.generateMap(vi_map.get());
+  map_manager.addMap(FLAGS_map_key, vi_map);
+  console_->setSelectedMapKey(FLAGS_map_key);
+  console_->addMapKeyToAutoCompletion(FLAGS_map_key);
+  return common::kSuccess;
+}
+
 int VIMapBasicPlugin::deleteMap() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -560,15 +680,19 @@ int VIMapBasicPlugin::joinAllMaps() {
 
   vi_map::VIMapManager::MapWriteAccess base_map =
       map_manager.getMapWriteAccess(base_map_key);
+  reserveForMergingMaps(
+      map_manager, all_current_map_keys.cbegin() + 1,
+      all_current_map_keys.cend(), base_map.get());
 
-  // Merge all other maps into base maps and delete them.
+  // Merge all other maps into base maps and delete them. The maps are deleted
+  // anyways, so their vertices and edges are moved instead of copied.
   for (std::vector<std::string>::const_iterator it_map_keys =
            all_current_map_keys.cbegin() + 1;
        it_map_keys != all_current_map_keys.cend(); ++it_map_keys) {
     {
-      vi_map::VIMapManager::MapReadAccess map_to_be_merged =
-          map_manager.getMapReadAccess(*it_map_keys);
-      base_map->mergeAllMissionsFromMap(*map_to_be_merged);
+      vi_map::VIMapManager::MapWriteAccess map_to_be_merged =
+          map_manager.getMapWriteAccess(*it_map_keys);
+      base_map->moveAllMissionsFromMap(map_to_be_merged.get());
     }
     map_manager.deleteMap(*it_map_keys);
     console_->removeMapKeyFromAutoCompletion(*it_map_keys);
@@ -747,11 +871,13 @@ int VIMapBasicPlugin::loadMergeAllMaps() {
 
   vi_map::VIMapManager::MapWriteAccess base_map =
       map_manager.getMapWriteAccess(selected_map_key);
+  reserveForMergingMaps(
+      map_manager, loaded_keys.cbegin(), loaded_keys.cend(), base_map.get());
   for (const std::string& loaded_key : loaded_keys) {
     {
-      vi_map::VIMapManager::MapReadAccess map_to_be_merged =
-          map_manager.getMapReadAccess(loaded_key);
-      base_map->mergeAllMissionsFromMap(*map_to_be_merged);
+      vi_map::VIMapManager::MapWriteAccess map_to_be_merged =
+          map_manager.getMapWriteAccess(loaded_key);
+      base_map->moveAllMissionsFromMap(map_to_be_merged.get());
     }
     map_manager.deleteMap(loaded_key);
     VLOG(1) << "Merging \"" << loaded_key << "\" into \"" << selected_map_key
@@ -835,6 +961,123 @@ int VIMapBasicPlugin::saveAllMaps() {
   return common::kSuccess;
 }
 
+int VIMapBasicPlugin::loadMapInBackground() {
+  if (FLAGS_map_folder.empty()) {
+    LOG(ERROR) << "No path specified, please set the flag \"map_folder\".";
+    return common::kStupidUserError;
+  }
+  const std::string map_folder = FLAGS_map_folder;
+  const std::string map_key = FLAGS_map_key;
+  if (!map_key.empty()) {
+    vi_map::VIMapManager map_manager;
+    if (!map_manager.isKeyValid(map_key)) {
+      LOG(ERROR) << "The key \"" << map_key << "\" is not a valid key.";
+      return common::kStupidUserError;
+    }
+  }
+
+  runMapIoInBackground(
+      "load " + map_folder, [this, map_folder, map_key]() -> bool {
+        vi_map::VIMapManager map_manager;
+        std::string loaded_map_key = map_key;
+        const bool success =
+            map_key.empty()
+                ? map_manager.loadMapFromFolder(map_folder, &loaded_map_key)
+                : map_manager.loadMapFromFolder(map_folder, map_key);
+        if (success) {
+          console_->addMapKeyToAutoCompletion(loaded_map_key);
+        }
+        return success;
+      });
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::loadAllMapsInBackground() {
+  const std::string maps_folder = FLAGS_maps_folder;
+  if (maps_folder.empty()) {
+    LOG(ERROR) << "Invalid maps folder. Specify a valid maps folder with "
+               << "--maps_folder";
+    return common::kStupidUserError;
+  }
+
+  runMapIoInBackground("load_all " + maps_folder, [this, maps_folder]() {
+    vi_map::VIMapManager map_manager;
+    std::unordered_set<std::string> new_keys;
+    if (!map_manager.loadAllMapsFromFolder(maps_folder, &new_keys)) {
+      return false;
+    }
+    for (const std::string& key : new_keys) {
+      console_->addMapKeyToAutoCompletion(key);
+    }
+    return true;
+  });
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::saveMapInBackground() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  const std::string map_folder = FLAGS_map_folder;
+  if (map_folder.empty()) {
+    vi_map::VIMapManager map_manager;
+    if (!map_manager.getMapReadAccess(selected_map_key)->hasMapFolder()) {
+      LOG(ERROR) << "Selected map doesn't have a map folder. Please use "
+                    "\"set_map_folder --map_folder=<path>\" or "
+                    "\"save_in_background --map_folder=<path>\".";
+      return common::kStupidUserError;
+    }
+  }
+  const backend::SaveConfig config = parseSaveConfigFromGFlags();
+
+  runMapIoInBackground(
+      "save " + selected_map_key, [selected_map_key, map_folder, config]() {
+        vi_map::VIMapManager map_manager;
+        if (map_folder.empty()) {
+          return map_manager.saveMapToMapFolder(selected_map_key, config);
+        }
+        return map_manager.saveMapToFolder(
+            selected_map_key, map_folder, config);
+      });
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::saveAllMapsInBackground() {
+  const std::string maps_folder = FLAGS_maps_folder;
+  const backend::SaveConfig config = parseSaveConfigFromGFlags();
+
+  runMapIoInBackground("save_all", [maps_folder, config]() {
+    vi_map::VIMapManager map_manager;
+    if (maps_folder.empty()) {
+      return map_manager.saveAllMapsToMapFolder(config);
+    }
+    return map_manager.saveAllMapsToFolder(maps_folder, config);
+  });
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::waitForBackgroundMapIo() {
+  CHECK(map_io_thread_pool_);
+  map_io_thread_pool_->waitForEmptyQueue();
+  return common::kSuccess;
+}
+
+void VIMapBasicPlugin::runMapIoInBackground(
+    const std::string& description, const std::function<bool()>& map_io) {
+  CHECK(map_io);
+  CHECK(map_io_thread_pool_);
+  std::cout << "Running " << description << " in the background." << std::endl;
+  map_io_thread_pool_->enqueue([description, map_io]() {
+    const bool success = map_io();
+    if (success) {
+      std::cout << "Finished " << description << '.' << std::endl;
+    } else {
+      LOG(ERROR) << "Background " << description << " failed.";
+    }
+  });
+}
+
 int VIMapBasicPlugin::getMapFolder() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -1036,7 +1279,10 @@ int VIMapBasicPlugin::checkMapConsistency() {
   const vi_map::VIMapManager map_manager;
   vi_map::VIMapManager::MapReadAccess map =
       map_manager.getMapReadAccess(selected_map_key);
-  vi_map::checkMapConsistency(*map);
+  vi_map::checkMapConsistency(
+      *map, FLAGS_check_map_structure_only
+                ? vi_map::MapConsistencyCheckLevel::kStructuralOnly
+                : vi_map::MapConsistencyCheckLevel::kFull);
 
   return common::kSuccess;
 }
@@ -1446,6 +1692,34 @@ int VIMapBasicPlugin::convertMapToNewFormat() {
   return map->saveToFolder(map_folder_out, parseSaveConfigFromGFlags());
 }
 
+int VIMapBasicPlugin::migrateMap() {
+  if (FLAGS_map_folder.empty()) {
+    LOG(ERROR) << "No path specified, please set the flag \"map_folder\".";
+    return common::kStupidUserError;
+  }
+
+  // The map is loaded outside of the map manager, such that migrating does
+  // not change the maps of the console.
+  vi_map::VIMap::UniquePtr map = aligned_unique<vi_map::VIMap>();
+  if (!map->loadFromFolder(FLAGS_map_folder)) {
+    LOG(ERROR) << "Unable to load the map from \"" << FLAGS_map_folder
+               << "\".";
+    return common::kUnknownError;
+  }
+
+  backend::SaveConfig config = parseSaveConfigFromGFlags();
+  config.overwrite_existing_files = true;
+  if (!map->saveToFolder(FLAGS_map_folder, config)) {
+    LOG(ERROR) << "Unable to save the migrated map to \"" << FLAGS_map_folder
+               << "\".";
+    return common::kUnknownError;
+  }
+  LOG(INFO) << "Migrated the map in \"" << FLAGS_map_folder
+            << "\" to format version "
+            << vi_map::serialization::getFormatVersionToWrite() << '.';
+  return common::kSuccess;
+}
+
 }  // namespace vi_map
 
 MAPLAB_CREATE_CONSOLE_PLUGIN_WITH_PLOTTER(vi_map::VIMapBasicPlugin);
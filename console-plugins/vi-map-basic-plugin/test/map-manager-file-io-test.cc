@@ -519,13 +519,13 @@ TEST_F(MapManagerFileIOTest, SaveLoadMapWithActualData) {
           kPathWithDefaultFileNameFirstEntry, TestStrings::kSecondMapKey));
   ASSERT_TRUE(map_manager_.hasMap(TestStrings::kSecondMapKey));
 
-  const vi_map::VIMap& original_map =
+  const vi_map::VIMapManager::ConstPinnedMap original_map =
       map_manager_.getMap(TestStrings::kFirstMapKey);
-  const vi_map::VIMap& loaded_map =
+  const vi_map::VIMapManager::ConstPinnedMap loaded_map =
       map_manager_.getMap(TestStrings::kSecondMapKey);
 
   // Compare original and loaded map.
-  EXPECT_TRUE(vi_map::test::compareVIMap(original_map, loaded_map));
+  EXPECT_TRUE(vi_map::test::compareVIMap(*original_map, *loaded_map));
 }
 
 // Save and load map with many vertices to test vertices splitting.
@@ -540,13 +540,13 @@ TEST_F(MapManagerFileIOTest, SaveLoadMapWithManyVertices) {
       kPathWithDefaultFileNameFirstEntry, TestStrings::kSecondMapKey);
   ASSERT_TRUE(map_manager_.hasMap(TestStrings::kSecondMapKey));
 
-  const vi_map::VIMap& original_map =
+  const vi_map::VIMapManager::ConstPinnedMap original_map =
       map_manager_.getMap(TestStrings::kFirstMapKey);
-  const vi_map::VIMap& loaded_map =
+  const vi_map::VIMapManager::ConstPinnedMap loaded_map =
       map_manager_.getMap(TestStrings::kSecondMapKey);
 
   // Compare original and loaded map.
-  EXPECT_TRUE(vi_map::test::compareVIMap(original_map, loaded_map));
+  EXPECT_TRUE(vi_map::test::compareVIMap(*original_map, *loaded_map));
 }
 
 // Loads a map that contains prohibited characters in its filename and would
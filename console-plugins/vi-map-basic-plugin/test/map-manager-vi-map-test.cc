@@ -139,7 +139,7 @@ TEST_F(MapManagerVIMapTest, CopyMapWithData) {
   map_manager_.copyMap(TestStrings::kFirstMapKey, TestStrings::kSecondMapKey);
   std::string second_map_folder;
   map_manager_.getMap(TestStrings::kSecondMapKey)
-      .getMapFolder(&second_map_folder);
+      ->getMapFolder(&second_map_folder);
   EXPECT_EQ(common::getRealPath(kBasePath), second_map_folder);
 }
 
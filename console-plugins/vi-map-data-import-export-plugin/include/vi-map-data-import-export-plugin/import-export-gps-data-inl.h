@@ -2,6 +2,7 @@
 #define VI_MAP_DATA_IMPORT_EXPORT_PLUGIN_IMPORT_EXPORT_GPS_DATA_INL_H_
 
 #include <string>
+#include <vector>
 
 #include <aslam/common/time.h>
 #include <glog/logging.h>
@@ -79,33 +80,39 @@ void exportGpsDataMatchedToVerticesToCsv(
     pose_graph::VertexIdList vertex_ids;
     map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
 
+    // The vertices along the graph are sorted in time, so all of them are
+    // matched to their nearest measurement in a single merge with the
+    // measurement timestamps.
+    std::vector<int64_t> vertex_timestamps_ns;
+    vertex_timestamps_ns.reserve(vertex_ids.size());
     for (const pose_graph::VertexId& vertex_id : vertex_ids) {
       CHECK(vertex_id.isValid());
-      const int64_t timestamp_nanosecond =
-          map.getVertex(vertex_id).getMinTimestampNanoseconds();
-
-      GpsMeasurement gps_measurement;
-      if (gps_utm_measurements.getNearestValueToTime(
-              timestamp_nanosecond, &gps_measurement)) {
-        if (std::abs(
-                gps_measurement.getTimestampNanoseconds() -
-                timestamp_nanosecond) > kTimestampToleranceNanoseconds) {
-          LOG(WARNING)
-              << "Unable to find a matching UTM measurement for vertex "
-              << vertex_id.hexString() << " of mission "
-              << mission_id.hexString() << " within "
-              << kTimestampToleranceNanoseconds << "ns timestamp tolerance.";
-          continue;
-        }
-        std::string csv_line;
-        convertGpsMeasurementToCsvLine(gps_measurement, &csv_line);
-        file << std::to_string(timestamp_nanosecond) << kDelimiter
-             << vertex_id.hexString() << kDelimiter << csv_line << std::endl;
-      } else {
+      vertex_timestamps_ns.emplace_back(
+          map.getVertex(vertex_id).getMinTimestampNanoseconds());
+    }
+    std::vector<int> nearest_measurement_indices;
+    gps_utm_measurements.getNearestIndicesToTimes(
+        vertex_timestamps_ns, kTimestampToleranceNanoseconds,
+        &nearest_measurement_indices);
+    CHECK_EQ(nearest_measurement_indices.size(), vertex_ids.size());
+
+    for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+      const pose_graph::VertexId& vertex_id = vertex_ids[i];
+      if (nearest_measurement_indices[i] ==
+          gps_utm_measurements.kInvalidIndex) {
         LOG(WARNING)
-            << "Unable to find matching GPS UTM measurement for vertex "
-            << vertex_id.hexString();
+            << "Unable to find a matching UTM measurement for vertex "
+            << vertex_id.hexString() << " of mission "
+            << mission_id.hexString() << " within "
+            << kTimestampToleranceNanoseconds << "ns timestamp tolerance.";
+        continue;
       }
+      const GpsMeasurement& gps_measurement =
+          gps_utm_measurements.values()[nearest_measurement_indices[i]];
+      std::string csv_line;
+      convertGpsMeasurementToCsvLine(gps_measurement, &csv_line);
+      file << std::to_string(vertex_timestamps_ns[i]) << kDelimiter
+           << vertex_id.hexString() << kDelimiter << csv_line << std::endl;
     }
   }
 }
@@ -59,27 +59,27 @@ DataImportExportPlugin::DataImportExportPlugin(common::Console* console)
       "Exports keyframe, keypoint and track, landmark and IMU data to CSV "
       "files in a folder specified by --csv_export_path. Check the "
       "documentation for information on the CSV format.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
   addCommand(
       {"export_trajectory_to_csv", "ettc"},
       [this]() -> int { return exportPosesVelocitiesAndBiasesToCsv(); },
       "Export poses, velocities and biases to a CSV file specified with "
       "--pose_export_file.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
 
   addCommand(
       {"export_ncamera_calibration", "encc"},
       [this]() -> int { return exportNCameraCalibration(); },
       "Exports the ncamera calibration to the folder specified with "
       "--ncamera_calibration_export_folder.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
 
   addCommand(
       {"export_optional_sensor_extrinsics", "eose"},
       [this]() -> int { return exportOptionalSensorExtrinsics(); },
       "Exports the optional sensor extrinsics to the folder specified with "
       "--optional_sensor_extrinsics_export_folder.",
-      common::Processing::Sync);
+      common::Processing::Sync, common::MapAccess::ReadOnly);
 
   addCommand(
       {"import_gps_data_from_rosbag"},
@@ -2,12 +2,17 @@
 
 #include <console-common/console.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiles.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <map-manager/map-manager.h>
 #include <maplab-common/file-system-tools.h>
 #include <vi-map/vi-map.h>
 
 DEFINE_string(summary_map_save_path, "", "Save path of the summary map.");
+DEFINE_double(
+    summary_map_tile_size_m, 0.0,
+    "If positive, the summary map is saved as square tiles of this size that "
+    "can be streamed in during localization.");
 DECLARE_bool(overwrite);
 
 namespace summarization_plugin {
@@ -18,7 +23,8 @@ SummarizationPlugin::SummarizationPlugin(common::Console* console)
       {"generate_summary_map_and_save_to_disk", "summary_map"},
       [this]() -> int { return saveSummaryMapToDisk(); },
       "Generate a summary map of the selected map and save it to the path "
-      "given by --summary_map_save_path.",
+      "given by --summary_map_save_path. Set --summary_map_tile_size_m to "
+      "save it as tiles.",
       common::Processing::Sync);
 }
 
@@ -43,7 +49,15 @@ int SummarizationPlugin::saveSummaryMapToDisk() const {
 
   backend::SaveConfig save_config;
   save_config.overwrite_existing_files = FLAGS_overwrite;
-  if (!summary_map.saveToFolder(FLAGS_summary_map_save_path, save_config)) {
+  if (FLAGS_summary_map_tile_size_m > 0.0) {
+    if (!summary_map::LocalizationSummaryMapTiles::saveToFolder(
+            summary_map, FLAGS_summary_map_tile_size_m,
+            FLAGS_summary_map_save_path, save_config)) {
+      LOG(ERROR) << "Saving summary map tiles failed.";
+      return common::kUnknownError;
+    }
+  } else if (!summary_map.saveToFolder(
+                 FLAGS_summary_map_save_path, save_config)) {
     LOG(ERROR) << "Saving summary map failed.";
     return common::kUnknownError;
   }
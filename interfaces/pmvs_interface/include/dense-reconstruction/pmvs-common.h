@@ -9,6 +9,7 @@
 #include <Eigen/Core>
 #include <aslam/pipeline/undistorter-mapped.h>
 #include <glog/logging.h>
+#include <landmark-triangulation/pose-interpolator.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
 #include <vi-map/vi-mission.h>
@@ -65,7 +66,8 @@ struct ObserverPose {
       const vi_map::MissionId& _mission_id,
       const pose_graph::VertexId& _vertex_id, const int64_t _timestamp_ns,
       const ObserverCamera& observer_camera,
-      const backend::ResourceType& _image_type);
+      const backend::ResourceType& _image_type,
+      const landmark_triangulation::PoseInterpolator& pose_interpolator);
 
   void loadImage(const vi_map::VIMap& vi_map, cv::Mat* image) const;
 
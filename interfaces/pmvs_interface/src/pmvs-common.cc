@@ -121,7 +121,8 @@ ObserverPose::ObserverPose(
     const vi_map::MissionId& _mission_id,
     const pose_graph::VertexId& _vertex_id, const int64_t _timestamp_ns,
     const ObserverCamera& observer_camera,
-    const backend::ResourceType& _image_type)
+    const backend::ResourceType& _image_type,
+    const landmark_triangulation::PoseInterpolator& pose_interpolator)
     : camera_number(_camera_number),
       mission_id(_mission_id),
       vertex_id(_vertex_id),
@@ -136,7 +137,6 @@ ObserverPose::ObserverPose(
     pose_timestamps.resize(1);
     pose_timestamps(0, 0) = timestamp_ns;
     aslam::TransformationVector poses_M_I;
-    landmark_triangulation::PoseInterpolator pose_interpolator;
     pose_interpolator.getPosesAtTime(
         vi_map, mission_id, pose_timestamps, &poses_M_I);
     T_M_I = poses_M_I.at(0u);
@@ -1,5 +1,6 @@
 #include "dense-reconstruction/pmvs-file-utils.h"
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -7,6 +8,8 @@
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
@@ -62,54 +65,74 @@ void writeObserverPosesAndImagesToFileSystem(
     const std::string& image_folder, const std::string& txt_folder,
     const ObserverCameraMap& observer_cameras,
     const ObserverPosesMap& observer_poses) {
+  std::vector<const ObserverPose*> all_observer_poses;
   for (const ObserverPosesMap::value_type& observer_pose_w_vertex_id :
        observer_poses) {
     const ObserverPoseSet& observer_pose_set = observer_pose_w_vertex_id.second;
     for (const ObserverPose& observer_pose : observer_pose_set) {
-      const size_t observer_number = observer_pose.camera_number;
-      char image_name[1024];
-      snprintf(
-          image_name, sizeof(image_name), config.kImageFileNameString_.c_str(),
-          image_folder.c_str(), observer_number);
-
-      cv::Mat image;
-      observer_pose.loadImage(vi_map, &image);
-
-      if (observer_pose.needsUndistortion()) {
-        const ObserverCamera& observer_camera =
-            common::getChecked(observer_cameras, observer_pose.camera_id);
-        cv::Mat undistorted_image;
-        observer_camera.undistortImage(image, &undistorted_image);
-        image = undistorted_image;
-      }
-
-      cv::Mat color_image;
-      if (image.channels() == 3 && image.type() == CV_8UC3) {
-        color_image = image;
-      } else {
-        // PMVS expects color images, therefore we convert the grayscale image
-        // to a pseudo color image.
-        VLOG(2) << "Convert grayscale image to pseudo color image.";
-        cv::cvtColor(image, color_image, CV_GRAY2RGB);
-      }
-      // Save to visualize folder.
-      cv::imwrite(std::string(image_name), color_image);
-
-      // Write camera projection matrix to txt folder.
-      char camera_file_name_buffer[1024];
-      snprintf(
-          camera_file_name_buffer, sizeof(camera_file_name_buffer),
-          config.kCameraFileNameString_.c_str(), txt_folder.c_str(),
-          observer_number);
-      std::string camera_file_name(camera_file_name_buffer);
-      common::FileLogger camera_file(camera_file_name);
-      CHECK(camera_file.isOpen())
-          << "Could not write to camera projection matrix file: "
-          << camera_file_name;
-      camera_file << "CONTOUR" << std::endl;
-      camera_file << observer_pose.P_undistorted;
+      all_observer_poses.push_back(&observer_pose);
     }
   }
+
+  // Undistorting, converting and encoding the images dominates the export,
+  // so the observers are written in parallel. Only loading the images from
+  // the map is serialized.
+  std::mutex image_loading_mutex;
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      all_observer_poses.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t observer_idx : range) {
+          const ObserverPose& observer_pose = *all_observer_poses[observer_idx];
+          const size_t observer_number = observer_pose.camera_number;
+          char image_name[1024];
+          snprintf(
+              image_name, sizeof(image_name),
+              config.kImageFileNameString_.c_str(), image_folder.c_str(),
+              observer_number);
+
+          cv::Mat image;
+          {
+            std::lock_guard<std::mutex> lock(image_loading_mutex);
+            observer_pose.loadImage(vi_map, &image);
+          }
+
+          if (observer_pose.needsUndistortion()) {
+            const ObserverCamera& observer_camera =
+                common::getChecked(observer_cameras, observer_pose.camera_id);
+            cv::Mat undistorted_image;
+            observer_camera.undistortImage(image, &undistorted_image);
+            image = undistorted_image;
+          }
+
+          cv::Mat color_image;
+          if (image.channels() == 3 && image.type() == CV_8UC3) {
+            color_image = image;
+          } else {
+            // PMVS expects color images, therefore we convert the grayscale
+            // image to a pseudo color image.
+            VLOG(2) << "Convert grayscale image to pseudo color image.";
+            cv::cvtColor(image, color_image, CV_GRAY2RGB);
+          }
+          // Save to visualize folder.
+          cv::imwrite(std::string(image_name), color_image);
+
+          // Write camera projection matrix to txt folder.
+          char camera_file_name_buffer[1024];
+          snprintf(
+              camera_file_name_buffer, sizeof(camera_file_name_buffer),
+              config.kCameraFileNameString_.c_str(), txt_folder.c_str(),
+              observer_number);
+          std::string camera_file_name(camera_file_name_buffer);
+          common::FileLogger camera_file(camera_file_name);
+          CHECK(camera_file.isOpen())
+              << "Could not write to camera projection matrix file: "
+              << camera_file_name;
+          camera_file << "CONTOUR" << std::endl;
+          camera_file << observer_pose.P_undistorted;
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
 }
 
 void createReconstructionFolders(
@@ -173,6 +196,7 @@ bool exportAllImagesForCalibration(
 
       bool created_path = false;
 
+      vi_map->prefetchFrameResources<cv::Mat>(vertex_ids, resource_type);
       for (const pose_graph::VertexId& vertex_id : vertex_ids) {
         const vi_map::Vertex& vertex = vi_map->getVertex(vertex_id);
         const size_t num_frames = vertex.numFrames();
@@ -1,7 +1,12 @@
 #include "dense-reconstruction/pmvs-interface.h"
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <stdlib.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/cameras/camera-factory.h>
@@ -16,6 +21,8 @@
 #include <landmark-triangulation/pose-interpolator.h>
 #include <maplab-common/accessors.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <maplab-common/vector-window-operations.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -89,6 +96,9 @@ void getObserverPosesFromOptionalCameras(
         std::end(pmvs_settings.supported_grayscale_image_types));
   }
 
+  // Shared by all observers, so the poses of a mission are only integrated
+  // once.
+  landmark_triangulation::PoseInterpolator pose_interpolator;
   for (const vi_map::MissionId& mission_id : mission_ids) {
     const vi_map::VIMission& mission = vi_map.getMission(mission_id);
     pose_graph::VertexIdList vertex_ids;
@@ -128,7 +138,8 @@ void getObserverPosesFromOptionalCameras(
 
           observer_pose_set.emplace(
               vi_map, observer_number, mission_id, vertex_id,
-              observer_timestamp_ns, observer_camera, resource_type);
+              observer_timestamp_ns, observer_camera, resource_type,
+              pose_interpolator);
 
           optional_cameras.insert(optional_camera_id);
         }
@@ -158,6 +169,9 @@ void getObserverPosesFromNCamera(
         std::end(pmvs_settings.supported_grayscale_image_types));
   }
 
+  // Shared by all observers, so the poses of a mission are only integrated
+  // once.
+  landmark_triangulation::PoseInterpolator pose_interpolator;
   for (const vi_map::MissionId& mission_id : mission_ids) {
     pose_graph::VertexIdList vertex_ids;
     vi_map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
@@ -197,7 +211,8 @@ void getObserverPosesFromNCamera(
 
           observer_pose_set.emplace(
               vi_map, observer_number, mission_id, vertex_id,
-              frame_timestamp_ns, observer_camera, resource_type);
+              frame_timestamp_ns, observer_camera, resource_type,
+              pose_interpolator);
 
           nframe_cameras.insert(nframe_camera_id);
         }
@@ -206,6 +221,119 @@ void getObserverPosesFromNCamera(
   }
 }
 
+namespace {
+const aslam::Camera* getObserverCameraModel(
+    const vi_map::VIMap& vi_map, const vi_map::Vertex& vertex,
+    const ObserverCamera& observer_camera) {
+  // Retrieve aslam::Camera from either optional cameras or NCamera.
+  const aslam::Camera* camera = nullptr;
+  if (observer_camera.is_optional_camera) {
+    const vi_map::VIMission& mission =
+        vi_map.getMission(observer_camera.mission_id);
+    const backend::CameraWithExtrinsics& cam_with_extrinsics =
+        mission.getOptionalCameraWithExtrinsics(observer_camera.camera_id);
+    camera = cam_with_extrinsics.second.get();
+  } else {
+    CHECK_LT(observer_camera.frame_idx, vertex.numFrames());
+    camera = vertex.getCamera(observer_camera.frame_idx).get();
+  }
+  return CHECK_NOTNULL(camera);
+}
+
+// Cosine of the largest angle between the optical axis and the ray of a pixel
+// on the image border. Points that project into the image can't be further
+// off the axis, as long as the field of view grows towards the border, which
+// holds for the radial distortion models. Returns -1, i.e. every direction, if
+// a border pixel can't be back-projected.
+double getMinCosineOfVisibleRays(const aslam::Camera& camera) {
+  constexpr int kNumSamplesPerSide = 32;
+  // Covers the border between the samples and numerical errors.
+  constexpr double kAngleMarginRad = 2.0 * M_PI / 180.0;
+  const double max_u = camera.imageWidth() - 1.0;
+  const double max_v = camera.imageHeight() - 1.0;
+  double max_angle_rad = 0.0;
+  for (int sample_idx = 0; sample_idx <= kNumSamplesPerSide; ++sample_idx) {
+    const double t = static_cast<double>(sample_idx) / kNumSamplesPerSide;
+    const Eigen::Vector2d border_keypoints[] = {
+        Eigen::Vector2d(t * max_u, 0.0), Eigen::Vector2d(t * max_u, max_v),
+        Eigen::Vector2d(0.0, t * max_v), Eigen::Vector2d(max_u, t * max_v)};
+    for (const Eigen::Vector2d& keypoint : border_keypoints) {
+      Eigen::Vector3d ray_C;
+      if (!camera.backProject3(keypoint, &ray_C)) {
+        return -1.0;
+      }
+      max_angle_rad = std::max(
+          max_angle_rad, std::atan2(ray_C.head<2>().norm(), ray_C.z()));
+    }
+  }
+  return std::cos(std::min(max_angle_rad + kAngleMarginRad, M_PI));
+}
+
+// Everything the visibility test of a landmark needs from an observer pose,
+// gathered once per observer instead of once per landmark.
+struct ObserverVisibilityTest {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+  // Same result as isLandmarkVisibleForObserverCamera(), but the landmarks
+  // outside the cone around the field of view are culled before the more
+  // expensive projection.
+  bool isVisible(const Eigen::Vector3d& p_G) const {
+    const Eigen::Vector3d p_C = T_C_G * p_G;
+    if (p_C.z() < 0.0 || p_C.z() < min_cosine_of_visible_rays * p_C.norm()) {
+      return false;
+    }
+    Eigen::Vector2d keypoint;
+    return static_cast<bool>(camera->project3(p_C, &keypoint));
+  }
+
+  aslam::Transformation T_C_G;
+  const aslam::Camera* camera;
+  double min_cosine_of_visible_rays;
+  size_t camera_number;
+};
+typedef std::vector<
+    ObserverVisibilityTest, Eigen::aligned_allocator<ObserverVisibilityTest>>
+    ObserverVisibilityTests;
+
+// Appends a (landmark, observer number) pair for every landmark of the vertex
+// that is visible by one of the observers of the vertex.
+void getLandmarkObserversOfVertex(
+    const vi_map::VIMap& vi_map, const PmvsConfig& config,
+    const vi_map::Vertex& vertex, const ObserverVisibilityTests& observers,
+    std::vector<std::pair<vi_map::LandmarkId, size_t>>* landmark_observers) {
+  CHECK_NOTNULL(landmark_observers);
+  vi_map::LandmarkIdList observed_landmark_ids;
+  vertex.getAllObservedLandmarkIds(&observed_landmark_ids);
+  // Landmarks seen by several frames of the vertex only need to be tested
+  // once.
+  std::sort(observed_landmark_ids.begin(), observed_landmark_ids.end());
+  observed_landmark_ids.erase(
+      std::unique(observed_landmark_ids.begin(), observed_landmark_ids.end()),
+      observed_landmark_ids.end());
+
+  for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
+    if (!landmark_id.isValid()) {
+      VLOG(3) << "Discard invalid landmark!";
+      continue;
+    }
+
+    if (config.cmvs_use_only_good_landmarks) {
+      if (vi_map.getLandmark(landmark_id).getQuality() !=
+          vi_map::Landmark::Quality::kGood) {
+        continue;
+      }
+    }
+
+    const Eigen::Vector3d p_G = vi_map.getLandmark_G_p_fi(landmark_id);
+    for (const ObserverVisibilityTest& observer : observers) {
+      if (observer.isVisible(p_G)) {
+        landmark_observers->emplace_back(landmark_id, observer.camera_number);
+      }
+    }
+  }
+}
+}  // namespace
+
 void getObservedLandmarksAndCovisibilityInformation(
     const vi_map::VIMap& vi_map, const PmvsConfig& config,
     const vi_map::MissionIdList& mission_ids,
@@ -215,118 +343,144 @@ void getObservedLandmarksAndCovisibilityInformation(
   CHECK_NOTNULL(observed_landmarks);
   CHECK(!mission_ids.empty());
 
-  size_t landmark_number = 0u;
-  vi_map::LandmarkIdSet actually_observed_landmarks_ids;
+  // The visibility cone only depends on the camera model.
+  std::unordered_map<aslam::CameraId, double> min_cosine_of_visible_rays;
+  for (const ObserverCameraMap::value_type& camera_with_id : observer_cameras) {
+    const ObserverCamera& observer_camera = camera_with_id.second;
+    const aslam::Camera* camera = nullptr;
+    if (observer_camera.is_optional_camera) {
+      camera = vi_map.getMission(observer_camera.mission_id)
+                   .getOptionalCameraWithExtrinsics(observer_camera.camera_id)
+                   .second.get();
+    } else {
+      camera = &vi_map.getSensorManager()
+                    .getNCameraForMission(observer_camera.mission_id)
+                    .getCamera(observer_camera.frame_idx);
+    }
+    min_cosine_of_visible_rays.emplace(
+        camera_with_id.first,
+        getMinCosineOfVisibleRays(*CHECK_NOTNULL(camera)));
+  }
 
+  // Only the vertices with observers contribute.
+  std::vector<const vi_map::Vertex*> vertices;
+  std::vector<const ObserverPoseSet*> observer_poses_of_vertices;
   vi_map.forEachVertex([&](const vi_map::Vertex& vertex) {
-    const vi_map::MissionId& mission_id = vertex.getMissionId();
-    if (std::find(mission_ids.begin(), mission_ids.end(), mission_id) ==
+    if (std::find(
+            mission_ids.begin(), mission_ids.end(), vertex.getMissionId()) ==
         mission_ids.end()) {
       return;
     }
-    const pose_graph::VertexId& vertex_id = vertex.id();
-
-    vi_map::LandmarkIdList observed_landmark_ids;
-    vertex.getAllObservedLandmarkIds(&observed_landmark_ids);
-
-    const ObserverPosesMap::const_iterator it = observer_poses.find(vertex_id);
+    const ObserverPosesMap::const_iterator it =
+        observer_poses.find(vertex.id());
     if (it == observer_poses.cend()) {
-      VLOG(3) << "No observer poses found for vertex " << vertex_id;
+      VLOG(3) << "No observer poses found for vertex " << vertex.id();
       return;
     }
-    const ObserverPoseSet& observer_poses_for_vertex = it->second;
-    CHECK(!observer_poses_for_vertex.empty());
-
-    VLOG(3) << "Found " << observer_poses_for_vertex.size()
-            << " observers for vertex " << vertex_id;
-
-    for (const vi_map::LandmarkId& landmark_id : observed_landmark_ids) {
-      if (!landmark_id.isValid()) {
-        VLOG(3) << "Discard invalid landmark!";
-        continue;
-      }
-
-      if (config.cmvs_use_only_good_landmarks) {
-        if (vi_map.getLandmark(landmark_id).getQuality() !=
-            vi_map::Landmark::Quality::kGood) {
-          continue;
-        }
-      }
+    CHECK(!it->second.empty());
+    vertices.push_back(&vertex);
+    observer_poses_of_vertices.push_back(&it->second);
+  });
 
-      const Eigen::Vector3d p_G = vi_map.getLandmark_G_p_fi(landmark_id);
-
-      // Find out which observer poses see this landmark.
-      std::unordered_set<size_t> observer_camera_numbers;
-      for (const ObserverPose& observer_pose : observer_poses_for_vertex) {
-        const ObserverCamera& observer_camera =
-            common::getChecked(observer_cameras, observer_pose.camera_id);
-        if (isLandmarkVisibleForObserverCamera(
-                vi_map, vertex, landmark_id, p_G, observer_camera,
-                observer_pose)) {
-          observer_camera_numbers.insert(observer_pose.camera_number);
-          VLOG(4) << "Landmark: " << landmark_id
-                  << " is visible from observer number "
-                  << observer_pose.camera_number;
-        } else {
-          VLOG(4) << "Landmark: " << landmark_id
-                  << " is NOT visible from observer number "
-                  << observer_pose.camera_number;
+  // The visibility tests of the vertices are independent, so they run in
+  // parallel and every vertex collects its (landmark, observer) pairs.
+  std::vector<std::vector<std::pair<vi_map::LandmarkId, size_t>>>
+      landmark_observers_of_vertices(vertices.size());
+  constexpr bool kAlwaysParallelize = true;
+  common::ParallelProcess(
+      vertices.size(),
+      [&](const std::vector<size_t>& range) {
+        ObserverVisibilityTests observers;
+        for (const size_t vertex_idx : range) {
+          const vi_map::Vertex& vertex = *vertices[vertex_idx];
+          observers.clear();
+          for (const ObserverPose& observer_pose :
+               *observer_poses_of_vertices[vertex_idx]) {
+            const ObserverCamera& observer_camera =
+                common::getChecked(observer_cameras, observer_pose.camera_id);
+            ObserverVisibilityTest observer;
+            observer.T_C_G = observer_pose.T_G_C.inverse();
+            observer.camera =
+                getObserverCameraModel(vi_map, vertex, observer_camera);
+            observer.min_cosine_of_visible_rays = common::getChecked(
+                min_cosine_of_visible_rays, observer_pose.camera_id);
+            observer.camera_number = observer_pose.camera_number;
+            observers.push_back(observer);
+          }
+          getLandmarkObserversOfVertex(
+              vi_map, config, vertex, observers,
+              &landmark_observers_of_vertices[vertex_idx]);
         }
-      }
-
-      if (observer_camera_numbers.empty()) {
-        VLOG(3) << "Landmark " << landmark_id << " has no observers!";
-        continue;
-      }
-
-      ObservedLandmarks::iterator it = observed_landmarks->find(landmark_id);
-      // Initialize the observed landmark if it doesnt exists already.
-      ObservedLandmark* observed_landmark = nullptr;
-      if (it == observed_landmarks->end()) {
-        observed_landmark = &((*observed_landmarks)[landmark_id]);
-        CHECK_NOTNULL(observed_landmark);
-
-        observed_landmark->p_G = vi_map.getLandmark_G_p_fi(landmark_id);
-        observed_landmark->landmark_id = landmark_id;
-        observed_landmark->landmark_number = landmark_number++;
-        VLOG(4) << "New observed landmark created: " << landmark_id;
-      } else {
-        observed_landmark = &(it->second);
-        CHECK_NOTNULL(observed_landmark);
-        CHECK_EQ(observed_landmark->landmark_id, landmark_id);
-
-        VLOG(4) << "Retrieved observed landmark: " << landmark_id;
-      }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+
+  // Sorting all pairs by landmark gives the sparse landmark-observer
+  // covisibility matrix row by row, without a set per landmark and vertex.
+  size_t num_landmark_observers = 0u;
+  for (const std::vector<std::pair<vi_map::LandmarkId, size_t>>&
+           landmark_observers : landmark_observers_of_vertices) {
+    num_landmark_observers += landmark_observers.size();
+  }
+  std::vector<std::pair<vi_map::LandmarkId, size_t>> landmark_observers;
+  landmark_observers.reserve(num_landmark_observers);
+  for (std::vector<std::pair<vi_map::LandmarkId, size_t>>&
+           landmark_observers_of_vertex : landmark_observers_of_vertices) {
+    landmark_observers.insert(
+        landmark_observers.end(), landmark_observers_of_vertex.begin(),
+        landmark_observers_of_vertex.end());
+    landmark_observers_of_vertex.clear();
+    landmark_observers_of_vertex.shrink_to_fit();
+  }
+  std::sort(landmark_observers.begin(), landmark_observers.end());
+  landmark_observers.erase(
+      std::unique(landmark_observers.begin(), landmark_observers.end()),
+      landmark_observers.end());
+
+  size_t landmark_number = observed_landmarks->size();
+  std::vector<std::pair<vi_map::LandmarkId, size_t>>::const_iterator
+      row_begin = landmark_observers.begin();
+  while (row_begin != landmark_observers.end()) {
+    const vi_map::LandmarkId& landmark_id = row_begin->first;
+    std::vector<std::pair<vi_map::LandmarkId, size_t>>::const_iterator
+        row_end = row_begin;
+    while (row_end != landmark_observers.end() &&
+           row_end->first == landmark_id) {
+      ++row_end;
+    }
 
-      observed_landmark->observer_pose_numbers.insert(
-          observer_camera_numbers.cbegin(), observer_camera_numbers.cend());
+    ObservedLandmarks::iterator it = observed_landmarks->find(landmark_id);
+    // Initialize the observed landmark if it doesnt exists already.
+    ObservedLandmark* observed_landmark = nullptr;
+    if (it == observed_landmarks->end()) {
+      observed_landmark = &((*observed_landmarks)[landmark_id]);
+      observed_landmark->p_G = vi_map.getLandmark_G_p_fi(landmark_id);
+      observed_landmark->landmark_id = landmark_id;
+      observed_landmark->landmark_number = landmark_number++;
+      VLOG(4) << "New observed landmark created: " << landmark_id;
+    } else {
+      observed_landmark = &(it->second);
+      CHECK_EQ(observed_landmark->landmark_id, landmark_id);
+      VLOG(4) << "Retrieved observed landmark: " << landmark_id;
+    }
 
-      VLOG(3) << "Added " << observer_camera_numbers.size()
-              << " observers for landmark " << landmark_id
-              << ". Total number of observers are now "
-              << observed_landmark->observer_pose_numbers.size();
+    observed_landmark->observer_pose_numbers.reserve(
+        observed_landmark->observer_pose_numbers.size() +
+        std::distance(row_begin, row_end));
+    for (; row_begin != row_end; ++row_begin) {
+      observed_landmark->observer_pose_numbers.insert(row_begin->second);
     }
-  });
+    VLOG(3) << "Landmark " << landmark_id << " has "
+            << observed_landmark->observer_pose_numbers.size()
+            << " observers.";
+  }
 }
 
 bool isLandmarkVisibleForObserverCamera(
     const vi_map::VIMap& vi_map, const vi_map::Vertex& vertex,
     const vi_map::LandmarkId& landmark_id, const Eigen::Vector3d& p_G,
     const ObserverCamera& observer_camera, const ObserverPose& observer_pose) {
-  const vi_map::VIMission& mission =
-      vi_map.getMission(observer_camera.mission_id);
-
-  // Retrieve aslam::Camera from either optional cameras or NCamera.
-  const aslam::Camera* camera = nullptr;
-  if (observer_camera.is_optional_camera) {
-    const backend::CameraWithExtrinsics& cam_with_extrinsics =
-        mission.getOptionalCameraWithExtrinsics(observer_camera.camera_id);
-    camera = cam_with_extrinsics.second.get();
-  } else {
-    CHECK_LT(observer_camera.frame_idx, vertex.numFrames());
-    camera = vertex.getCamera(observer_camera.frame_idx).get();
-  }
-  CHECK_NOTNULL(camera);
+  const aslam::Camera* camera =
+      getObserverCameraModel(vi_map, vertex, observer_camera);
 
   Eigen::Vector3d p_C = observer_pose.T_G_C.inverse() * p_G;
 
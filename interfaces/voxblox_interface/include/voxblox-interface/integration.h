@@ -1,6 +1,8 @@
 #ifndef VOXBLOX_INTERFACE_INTEGRATION_H_
 #define VOXBLOX_INTERFACE_INTEGRATION_H_
 
+#include <string>
+
 #include <vi-map/vi-map.h>
 #include <voxblox/core/common.h>
 #include <voxblox/core/tsdf_map.h>
@@ -26,6 +28,22 @@ bool integrateAllDepthResourcesOfType(
     const voxblox::TsdfIntegratorBase::Config& integrator_config,
     vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map);
 
+// Same as integrateAllDepthResourcesOfType, but for environments whose TSDF
+// grid doesn't fit into memory. The grid is split into cubic tiles of about
+// tile_size_m (rounded to whole blocks). Once no later frame can reach a tile
+// and its neighbors, the tile is meshed to
+// <output_folder>/mesh_tile_<x>_<y>_<z>.ply, its blocks are saved to
+// <output_folder>/tsdf_tile_<x>_<y>_<z>.tsdf and removed from the map. Only the
+// tiles near the part of the trajectory that is being integrated stay in
+// memory, so the map is empty again when this returns.
+bool integrateAllDepthResourcesOfTypeTiled(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    const double tile_size_m, const std::string& output_folder,
+    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map);
+
 // Integrates a 3D point cloud into a TSDF map.
 void integratePointCloud(
     const pose::Transformation& T_G_C, const pose::Position3DVector& points_C,
@@ -1,17 +1,30 @@
 #include "voxblox-interface/integration.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/pose-types.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <map-resources/resource-conversion.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/progress-bar.h>
+#include <maplab-common/threadsafe-queue.h>
 #include <posegraph/unique-id.h>
 #include <vi-map/landmark.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vertex.h>
+#include <voxblox/core/block_hash.h>
+#include <voxblox/core/layer.h>
+#include <voxblox/io/mesh_ply.h>
+#include <voxblox/mesh/mesh_integrator.h>
 
 namespace voxblox_interface {
 
@@ -151,23 +164,108 @@ static std::unordered_set<backend::ResourceType, backend::ResourceTypeHash>
                               backend::ResourceType::kOptimizedDepthMap,
                               backend::ResourceType::kPointCloudXYZRGBN};
 
-bool integrateAllDepthResourcesOfType(
+namespace {
+// A frame whose depth resource is converted to a point cloud, ready to be
+// integrated. Holds no fixed-size Eigen types, as the queue doesn't align its
+// elements.
+struct FrameToIntegrate {
+  bool is_end_marker = false;
+  // Index among all frames of the integrated missions, including the frames
+  // without a depth resource.
+  size_t sequence_index = 0u;
+  size_t vertex_index = 0u;
+  size_t frame_index = 0u;
+  voxblox::Pointcloud points_C;
+  voxblox::Colors colors;
+};
+
+// Number of frames that are loaded ahead of the integration.
+constexpr size_t kFrameQueueSize = 8u;
+
+// Loads the depth resource of the frame and converts it to a point cloud in
+// the camera frame. Returns false if the frame has no such resource.
+bool loadFrameToIntegrate(
+    const vi_map::VIMap& vi_map, const vi_map::Vertex& vertex,
+    const size_t frame_idx, const backend::ResourceType& input_resource_type,
+    const std::vector<aslam::Camera::ConstPtr>& cameras,
+    FrameToIntegrate* frame) {
+  CHECK_NOTNULL(frame);
+  switch (input_resource_type) {
+    case backend::ResourceType::kRawDepthMap:
+    // Fall through intended.
+    case backend::ResourceType::kOptimizedDepthMap: {
+      // Check if a depth map resource is available.
+      CHECK_LT(frame_idx, cameras.size());
+      CHECK(cameras[frame_idx]);
+      cv::Mat depth_map;
+      if (!vi_map.getFrameResource(
+              vertex, frame_idx, input_resource_type, &depth_map)) {
+        return false;
+      }
+      // Check if there is a dedicated image for this depth map. If not,
+      // use the normal grayscale image.
+      cv::Mat image;
+      bool has_image = false;
+      if (vi_map.getImageForDepthMap(vertex, frame_idx, &image)) {
+        VLOG(3) << "Found depth map with intensity information "
+                   "from the dedicated grayscale image.";
+        has_image = true;
+      } else if (vi_map.getRawImage(vertex, frame_idx, &image)) {
+        VLOG(3) << "Found depth map with intensity information "
+                   "from the raw grayscale image.";
+        has_image = true;
+      } else {
+        VLOG(3) << "Found depth map without intensity information.";
+      }
+
+      // Convert with or without intensity information.
+      if (has_image) {
+        backend::convertDepthMapWithImageToPointCloud(
+            depth_map, image, *cameras[frame_idx], &frame->points_C,
+            &frame->colors);
+      } else {
+        backend::convertDepthMapToPointCloud(
+            depth_map, *cameras[frame_idx], &frame->points_C);
+        frame->colors.resize(frame->points_C.size());
+      }
+      return true;
+    }
+    case backend::ResourceType::kPointCloudXYZRGBN: {
+      // Check if a point cloud is available.
+      resources::PointCloud point_cloud;
+      if (!vi_map.getFrameResource(
+              vertex, frame_idx, input_resource_type, &point_cloud)) {
+        return false;
+      }
+      VLOG(3) << "Found point cloud.";
+      resources::VoxbloxColorPointCloud voxblox_point_cloud;
+      voxblox_point_cloud.points_C = &frame->points_C;
+      voxblox_point_cloud.colors = &frame->colors;
+      CHECK(backend::convertPointCloudType(point_cloud, &voxblox_point_cloud));
+      return true;
+    }
+    default:
+      LOG(FATAL) << "This depth type is not supported! type: "
+                 << backend::ResourceTypeNames[static_cast<int>(
+                        input_resource_type)];
+  }
+  return false;
+}
+
+// Passes the depth frames of all missions, converted to point clouds, to
+// integrate_frame. The frames arrive in the order of the missions and of the
+// vertices along their graphs. Loading the resources and converting them runs
+// on a separate thread, ahead of the integration. A single thread keeps the
+// integration order, and with it the resulting TSDF, unchanged.
+void forEachDepthFrameOfMissions(
     const vi_map::MissionIdList& mission_ids,
     const backend::ResourceType& input_resource_type,
-    const bool use_distorted_camera,
-    const voxblox::TsdfIntegratorBase::Config& integrator_config,
-    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map) {
+    const bool use_distorted_camera, vi_map::VIMap* vi_map,
+    const std::function<void(
+        const aslam::Transformation& T_G_C, const FrameToIntegrate& frame)>&
+        integrate_frame) {
   CHECK_NOTNULL(vi_map);
-  CHECK_NOTNULL(tsdf_map);
-  CHECK_GT(kSupportedDepthInputTypes.count(input_resource_type), 0)
-      << "This depth type is not supported! type: "
-      << backend::ResourceTypeNames[static_cast<int>(input_resource_type)];
-
-  // Init Voxblox map and integrator.
-  voxblox::MergedTsdfIntegrator tsdf_integrator(
-      integrator_config, tsdf_map->getTsdfLayerPtr());
-
-  // Start integration.
+  size_t num_frames_of_previous_missions = 0u;
   for (const vi_map::MissionId& mission_id : mission_ids) {
     VLOG(1) << "Integrating mission " << mission_id;
 
@@ -198,90 +296,408 @@ bool integrateAllDepthResourcesOfType(
     pose_graph::VertexIdList vertex_ids;
     vi_map->getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
 
+    // Load the resources from disk in the background while integrating.
+    if (input_resource_type == backend::ResourceType::kPointCloudXYZRGBN) {
+      vi_map->prefetchFrameResources<resources::PointCloud>(
+          vertex_ids, input_resource_type);
+    } else {
+      vi_map->prefetchFrameResources<cv::Mat>(vertex_ids, input_resource_type);
+      vi_map->prefetchFrameResources<cv::Mat>(
+          vertex_ids, backend::ResourceType::kImageForDepthMap);
+      vi_map->prefetchFrameResources<cv::Mat>(
+          vertex_ids, backend::ResourceType::kRawImage);
+    }
+
+    size_t sequence_index = num_frames_of_previous_missions;
+    common::ThreadSafeQueue<FrameToIntegrate> frame_queue;
+    std::thread load_thread([&]() {
+      for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size();
+           ++vertex_idx) {
+        const vi_map::Vertex& vertex =
+            vi_map->getVertex(vertex_ids[vertex_idx]);
+
+        // Get number of frames for this vertex
+        const size_t num_frames = vertex.numFrames();
+        for (size_t frame_idx = 0u; frame_idx < num_frames;
+             ++frame_idx, ++sequence_index) {
+          VLOG(3) << "Vertex " << vertex.id() << " / Frame " << frame_idx;
+          FrameToIntegrate frame;
+          frame.sequence_index = sequence_index;
+          frame.vertex_index = vertex_idx;
+          frame.frame_index = frame_idx;
+          if (!loadFrameToIntegrate(
+                  *vi_map, vertex, frame_idx, input_resource_type, cameras,
+                  &frame)) {
+            VLOG(3) << "Nothing to integrate.";
+            continue;
+          }
+          CHECK(frame_queue.PushBlockingIfFull(frame, kFrameQueueSize));
+        }
+      }
+      FrameToIntegrate end_marker;
+      end_marker.is_end_marker = true;
+      CHECK(frame_queue.PushBlockingIfFull(end_marker, kFrameQueueSize));
+    });
+
     common::ProgressBar tsdf_progress_bar(vertex_ids.size());
-    size_t vertex_counter = 0u;
     constexpr size_t kUpdateEveryNthVertex = 20u;
-    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-      if (vertex_counter % kUpdateEveryNthVertex == 0u) {
-        tsdf_progress_bar.update(vertex_counter);
+    size_t next_progress_update = 0u;
+    FrameToIntegrate frame;
+    while (frame_queue.PopBlocking(&frame) && !frame.is_end_marker) {
+      if (frame.vertex_index >= next_progress_update) {
+        tsdf_progress_bar.update(frame.vertex_index);
+        next_progress_update = frame.vertex_index + kUpdateEveryNthVertex;
       }
-      ++vertex_counter;
+      // Compute complete transformation.
+      const vi_map::Vertex& vertex =
+          vi_map->getVertex(vertex_ids[frame.vertex_index]);
+      const aslam::Transformation T_G_I = T_G_M * vertex.get_T_M_I();
+      const aslam::Transformation T_I_C =
+          n_camera.get_T_C_B(frame.frame_index).inverse();
+      integrate_frame(T_G_I * T_I_C, frame);
+    }
+    load_thread.join();
+    vi_map->cancelPrefetching();
+    // The loader thread has counted all frames of the mission.
+    num_frames_of_previous_missions = sequence_index;
+  }
+}
 
-      vi_map::Vertex& vertex = vi_map->getVertex(vertex_id);
+// Keeps track of the cubic tiles of a TSDF layer in the tiled integration.
+// A tile is finished once no later frame can change its voxels. It is meshed
+// once all its neighbors are finished too, so the mesh at its border sees the
+// final voxels of the neighbors. Its blocks are saved to disk and removed
+// from the layer once all its neighbors are meshed, as the mesh of a neighbor
+// reads the border voxels of the tile.
+class TsdfTileSpiller {
+ public:
+  typedef voxblox::BlockIndex TileIndex;
+
+  TsdfTileSpiller(
+      const voxblox::IndexElement blocks_per_tile_side,
+      const std::string& output_folder,
+      voxblox::Layer<voxblox::TsdfVoxel>* tsdf_layer)
+      : blocks_per_tile_side_(blocks_per_tile_side),
+        output_folder_(output_folder),
+        tsdf_layer_(CHECK_NOTNULL(tsdf_layer)),
+        num_meshed_tiles_(0u),
+        num_saved_tiles_(0u) {
+    CHECK_GT(blocks_per_tile_side_, 0);
+  }
 
-      const aslam::Transformation T_G_I = T_G_M * vertex.get_T_M_I();
+  // Registers a tile that frames are integrated into.
+  void addTile(const TileIndex& tile_index) {
+    tile_states_.emplace(tile_index, TileState::kActive);
+  }
 
-      // Get number of frames for this vertex
-      const size_t num_frames = vertex.numFrames();
-      for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-        VLOG(3) << "Vertex " << vertex_id << " / Frame " << frame_idx;
-
-        // Compute complete transformation.
-        const aslam::Transformation T_I_C =
-            n_camera.get_T_C_B(frame_idx).inverse();
-        const aslam::Transformation T_G_C = T_G_I * T_I_C;
-
-        switch (input_resource_type) {
-          case backend::ResourceType::kRawDepthMap:
-          // Fall through intended.
-          case backend::ResourceType::kOptimizedDepthMap: {
-            // Check if a depth map resource is available.
-            CHECK_LT(frame_idx, num_cameras);
-            CHECK(cameras[frame_idx]);
-            cv::Mat depth_map;
-            if (!vi_map->getFrameResource(
-                    vertex, frame_idx, input_resource_type, &depth_map)) {
-              VLOG(3) << "Nothing to integrate.";
-              continue;
-            }
-            // Check if there is a dedicated image for this depth map. If not,
-            // use the normal grayscale image.
-            cv::Mat image;
-            bool has_image = false;
-            if (vi_map->getImageForDepthMap(vertex, frame_idx, &image)) {
-              VLOG(3) << "Found depth map with intensity information "
-                         "from the dedicated grayscale image.";
-              has_image = true;
-            } else if (vi_map->getRawImage(vertex, frame_idx, &image)) {
-              VLOG(3) << "Found depth map with intensity information "
-                         "from the raw grayscale image.";
-              has_image = true;
-            } else {
-              VLOG(3) << "Found depth map without intensity information.";
-            }
+  void finishTile(const TileIndex& tile_index) {
+    TileStateMap::iterator it = tile_states_.find(tile_index);
+    CHECK(it != tile_states_.end());
+    CHECK(it->second == TileState::kActive);
+    it->second = TileState::kFinished;
+    forEachTileInNeighborhood(
+        tile_index, [this](const TileIndex& neighbor_index) {
+          meshTileIfReady(neighbor_index);
+        });
+  }
 
-            // Integrate with or without intensity information.
-            if (has_image) {
-              integrateDepthMap(
-                  T_G_C, depth_map, image, *cameras[frame_idx],
-                  &tsdf_integrator);
-            } else {
-              integrateDepthMap(
-                  T_G_C, depth_map, *cameras[frame_idx], &tsdf_integrator);
-            }
-            continue;
+  size_t numMeshedTiles() const {
+    return num_meshed_tiles_;
+  }
+  size_t numSavedTiles() const {
+    return num_saved_tiles_;
+  }
+
+ private:
+  enum class TileState { kActive, kFinished, kMeshed };
+  typedef voxblox::AnyIndexHashMapType<TileState>::type TileStateMap;
+
+  // Tiles that were never integrated into have no blocks, so they count as
+  // meshed.
+  TileState getTileState(const TileIndex& tile_index) const {
+    TileStateMap::const_iterator it = tile_states_.find(tile_index);
+    return (it == tile_states_.end()) ? TileState::kMeshed : it->second;
+  }
+
+  // Calls the function for the tile and its 26 neighbors.
+  void forEachTileInNeighborhood(
+      const TileIndex& tile_index,
+      const std::function<void(const TileIndex&)>& function) const {
+    for (voxblox::IndexElement dx = -1; dx <= 1; ++dx) {
+      for (voxblox::IndexElement dy = -1; dy <= 1; ++dy) {
+        for (voxblox::IndexElement dz = -1; dz <= 1; ++dz) {
+          function(tile_index + TileIndex(dx, dy, dz));
+        }
+      }
+    }
+  }
+
+  bool isNeighborhoodAtLeast(
+      const TileIndex& tile_index, const TileState min_state) const {
+    bool result = true;
+    forEachTileInNeighborhood(
+        tile_index, [&](const TileIndex& neighbor_index) {
+          result &= getTileState(neighbor_index) >= min_state;
+        });
+    return result;
+  }
+
+  // Allocated blocks with block indices in [begin, end) per axis.
+  void getAllocatedBlocksInRange(
+      const voxblox::BlockIndex& begin, const voxblox::BlockIndex& end,
+      voxblox::BlockIndexList* block_indices) const {
+    CHECK_NOTNULL(block_indices)->clear();
+    voxblox::BlockIndex block_index;
+    for (block_index.x() = begin.x(); block_index.x() < end.x();
+         ++block_index.x()) {
+      for (block_index.y() = begin.y(); block_index.y() < end.y();
+           ++block_index.y()) {
+        for (block_index.z() = begin.z(); block_index.z() < end.z();
+             ++block_index.z()) {
+          if (tsdf_layer_->hasBlock(block_index)) {
+            block_indices->push_back(block_index);
           }
-          case backend::ResourceType::kPointCloudXYZRGBN: {
-            // Check if a point cloud is available.
-            resources::PointCloud point_cloud;
-            if (!vi_map->getFrameResource(
-                    vertex, frame_idx, input_resource_type, &point_cloud)) {
-              VLOG(3) << "Nothing to integrate.";
-              continue;
-            }
+        }
+      }
+    }
+  }
 
-            VLOG(3) << "Found point cloud.";
-            integratePointCloud(T_G_C, point_cloud, &tsdf_integrator);
-            continue;
+  std::string getTileFilePath(
+      const std::string& prefix, const TileIndex& tile_index,
+      const std::string& extension) const {
+    return output_folder_ + "/" + prefix + std::to_string(tile_index.x()) +
+           "_" + std::to_string(tile_index.y()) + "_" +
+           std::to_string(tile_index.z()) + extension;
+  }
+
+  void meshTileIfReady(const TileIndex& tile_index) {
+    if (getTileState(tile_index) != TileState::kFinished ||
+        !isNeighborhoodAtLeast(tile_index, TileState::kFinished)) {
+      return;
+    }
+    meshTile(tile_index);
+    tile_states_[tile_index] = TileState::kMeshed;
+    forEachTileInNeighborhood(
+        tile_index, [this](const TileIndex& neighbor_index) {
+          saveTileIfReady(neighbor_index);
+        });
+  }
+
+  void saveTileIfReady(const TileIndex& tile_index) {
+    if (getTileState(tile_index) != TileState::kMeshed ||
+        !isNeighborhoodAtLeast(tile_index, TileState::kMeshed)) {
+      return;
+    }
+    const voxblox::BlockIndex begin = tile_index * blocks_per_tile_side_;
+    voxblox::BlockIndexList block_indices;
+    getAllocatedBlocksInRange(
+        begin, begin + voxblox::BlockIndex::Constant(blocks_per_tile_side_),
+        &block_indices);
+    if (!block_indices.empty()) {
+      constexpr bool kIncludeAllBlocks = false;
+      CHECK(tsdf_layer_->saveSubsetToFile(
+          getTileFilePath("tsdf_tile_", tile_index, ".tsdf"), block_indices,
+          kIncludeAllBlocks));
+      for (const voxblox::BlockIndex& block_index : block_indices) {
+        tsdf_layer_->removeBlock(block_index);
+      }
+      ++num_saved_tiles_;
+    }
+    tile_states_.erase(tile_index);
+  }
+
+  void meshTile(const TileIndex& tile_index) {
+    // The marching cubes at the upper border of a block read the voxels of
+    // the next blocks, so the layer that is meshed also holds the blocks just
+    // past the tile. They share the voxels with the full layer.
+    const voxblox::BlockIndex begin = tile_index * blocks_per_tile_side_;
+    const voxblox::BlockIndex end =
+        begin + voxblox::BlockIndex::Constant(blocks_per_tile_side_);
+    voxblox::BlockIndexList block_indices;
+    getAllocatedBlocksInRange(
+        begin, end + voxblox::BlockIndex::Ones(), &block_indices);
+    if (block_indices.empty()) {
+      return;
+    }
+    voxblox::Layer<voxblox::TsdfVoxel> tile_layer(
+        tsdf_layer_->voxel_size(), tsdf_layer_->voxels_per_side());
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      tile_layer.insertBlock(
+          std::make_pair(
+              block_index, tsdf_layer_->getBlockPtrByIndex(block_index)));
+    }
+
+    voxblox::MeshLayer mesh_layer(tsdf_layer_->block_size());
+    voxblox::MeshIntegrator<voxblox::TsdfVoxel>::Config mesh_config;
+    voxblox::MeshIntegrator<voxblox::TsdfVoxel> mesh_integrator(
+        mesh_config, &tile_layer, &mesh_layer);
+    // The updated flags belong to the blocks of the full layer, leave them.
+    constexpr bool kMeshOnlyUpdatedBlocks = false;
+    constexpr bool kResetUpdatedFlag = false;
+    mesh_integrator.generateMesh(kMeshOnlyUpdatedBlocks, kResetUpdatedFlag);
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      if ((block_index.array() >= end.array()).any()) {
+        mesh_layer.removeMesh(block_index);
+      }
+    }
+    if (mesh_layer.getNumberOfAllocatedMeshes() > 0u) {
+      CHECK(voxblox::outputMeshLayerAsPly(
+          getTileFilePath("mesh_tile_", tile_index, ".ply"), mesh_layer));
+      ++num_meshed_tiles_;
+    }
+  }
+
+  const voxblox::IndexElement blocks_per_tile_side_;
+  const std::string output_folder_;
+  voxblox::Layer<voxblox::TsdfVoxel>* const tsdf_layer_;
+  TileStateMap tile_states_;
+  size_t num_meshed_tiles_;
+  size_t num_saved_tiles_;
+};
+}  // namespace
+
+bool integrateAllDepthResourcesOfType(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map) {
+  CHECK_NOTNULL(vi_map);
+  CHECK_NOTNULL(tsdf_map);
+  CHECK_GT(kSupportedDepthInputTypes.count(input_resource_type), 0)
+      << "This depth type is not supported! type: "
+      << backend::ResourceTypeNames[static_cast<int>(input_resource_type)];
+
+  // Init Voxblox map and integrator.
+  voxblox::MergedTsdfIntegrator tsdf_integrator(
+      integrator_config, tsdf_map->getTsdfLayerPtr());
+
+  forEachDepthFrameOfMissions(
+      mission_ids, input_resource_type, use_distorted_camera, vi_map,
+      [&](const aslam::Transformation& T_G_C, const FrameToIntegrate& frame) {
+        tsdf_integrator.integratePointCloud(
+            static_cast<voxblox::Transformation>(T_G_C), frame.points_C,
+            frame.colors);
+      });
+  return true;
+}
+
+bool integrateAllDepthResourcesOfTypeTiled(
+    const vi_map::MissionIdList& mission_ids,
+    const backend::ResourceType& input_resource_type,
+    const bool use_distorted_camera,
+    const voxblox::TsdfIntegratorBase::Config& integrator_config,
+    const double tile_size_m, const std::string& output_folder,
+    vi_map::VIMap* vi_map, voxblox::TsdfMap* tsdf_map) {
+  CHECK_NOTNULL(vi_map);
+  CHECK_NOTNULL(tsdf_map);
+  CHECK_GT(tile_size_m, 0.0);
+  CHECK_GT(kSupportedDepthInputTypes.count(input_resource_type), 0)
+      << "This depth type is not supported! type: "
+      << backend::ResourceTypeNames[static_cast<int>(input_resource_type)];
+  if (!common::createPath(output_folder)) {
+    LOG(ERROR) << "Unable to create the tile output folder: " << output_folder;
+    return false;
+  }
+
+  voxblox::Layer<voxblox::TsdfVoxel>* tsdf_layer = tsdf_map->getTsdfLayerPtr();
+  const double block_size_m = tsdf_layer->block_size();
+  const voxblox::IndexElement blocks_per_tile_side = std::max<
+      voxblox::IndexElement>(std::round(tile_size_m / block_size_m), 1);
+  const double tile_side_m = blocks_per_tile_side * block_size_m;
+  VLOG(1) << "Tiles of " << blocks_per_tile_side << "^3 blocks, "
+          << tile_side_m << "m per side.";
+
+  // Integrating a frame changes voxels up to the maximum ray length plus the
+  // truncation distance away from the camera. Find the last frame that can
+  // reach every tile, frames without resources included. A voxel of margin
+  // covers the rounding to the voxel grid.
+  const double reach_m = integrator_config.max_ray_length_m +
+                         integrator_config.default_truncation_distance +
+                         tsdf_layer->voxel_size();
+  TsdfTileSpiller tile_spiller(blocks_per_tile_side, output_folder, tsdf_layer);
+  voxblox::AnyIndexHashMapType<size_t>::type last_frame_of_tile;
+  size_t sequence_index = 0u;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    const aslam::NCamera& n_camera =
+        vi_map->getSensorManager().getNCameraForMission(mission_id);
+    const aslam::Transformation& T_G_M =
+        vi_map->getMissionBaseFrameForMission(mission_id).get_T_G_M();
+    pose_graph::VertexIdList vertex_ids;
+    vi_map->getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const vi_map::Vertex& vertex = vi_map->getVertex(vertex_id);
+      const aslam::Transformation T_G_I = T_G_M * vertex.get_T_M_I();
+      for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+           ++frame_idx, ++sequence_index) {
+        const Eigen::Vector3d p_G_C =
+            T_G_I * n_camera.get_T_C_B(frame_idx).inverse().getPosition();
+        const TsdfTileSpiller::TileIndex tile_begin =
+            ((p_G_C.array() - reach_m) / tile_side_m)
+                .floor()
+                .cast<voxblox::IndexElement>();
+        const TsdfTileSpiller::TileIndex tile_end =
+            ((p_G_C.array() + reach_m) / tile_side_m)
+                .floor()
+                .cast<voxblox::IndexElement>();
+        TsdfTileSpiller::TileIndex tile_index;
+        for (tile_index.x() = tile_begin.x(); tile_index.x() <= tile_end.x();
+             ++tile_index.x()) {
+          for (tile_index.y() = tile_begin.y();
+               tile_index.y() <= tile_end.y(); ++tile_index.y()) {
+            for (tile_index.z() = tile_begin.z();
+                 tile_index.z() <= tile_end.z(); ++tile_index.z()) {
+              last_frame_of_tile[tile_index] = sequence_index;
+            }
           }
-          default:
-            LOG(FATAL) << "This depth type is not supported! type: "
-                       << backend::ResourceTypeNames[static_cast<int>(
-                              input_resource_type)];
         }
       }
     }
   }
+
+  // Tiles in the order they are finished.
+  std::vector<std::pair<size_t, TsdfTileSpiller::TileIndex>> tiles_to_finish;
+  tiles_to_finish.reserve(last_frame_of_tile.size());
+  for (const std::pair<const TsdfTileSpiller::TileIndex, size_t>& tile :
+       last_frame_of_tile) {
+    tiles_to_finish.emplace_back(tile.second, tile.first);
+    tile_spiller.addTile(tile.first);
+  }
+  last_frame_of_tile.clear();
+  std::sort(
+      tiles_to_finish.begin(), tiles_to_finish.end(),
+      [](const std::pair<size_t, TsdfTileSpiller::TileIndex>& lhs,
+         const std::pair<size_t, TsdfTileSpiller::TileIndex>& rhs) {
+        return lhs.first < rhs.first;
+      });
+
+  voxblox::MergedTsdfIntegrator tsdf_integrator(integrator_config, tsdf_layer);
+  size_t num_finished_tiles = 0u;
+  size_t max_num_allocated_blocks = 0u;
+  forEachDepthFrameOfMissions(
+      mission_ids, input_resource_type, use_distorted_camera, vi_map,
+      [&](const aslam::Transformation& T_G_C, const FrameToIntegrate& frame) {
+        tsdf_integrator.integratePointCloud(
+            static_cast<voxblox::Transformation>(T_G_C), frame.points_C,
+            frame.colors);
+        max_num_allocated_blocks = std::max(
+            max_num_allocated_blocks, tsdf_layer->getNumberOfAllocatedBlocks());
+        while (num_finished_tiles < tiles_to_finish.size() &&
+               tiles_to_finish[num_finished_tiles].first <=
+                   frame.sequence_index) {
+          tile_spiller.finishTile(tiles_to_finish[num_finished_tiles].second);
+          ++num_finished_tiles;
+        }
+      });
+  for (; num_finished_tiles < tiles_to_finish.size(); ++num_finished_tiles) {
+    tile_spiller.finishTile(tiles_to_finish[num_finished_tiles].second);
+  }
+  CHECK_EQ(tsdf_layer->getNumberOfAllocatedBlocks(), 0u);
+
+  LOG(INFO) << "Saved " << tile_spiller.numSavedTiles() << " TSDF tiles and "
+            << tile_spiller.numMeshedTiles() << " mesh tiles to "
+            << output_folder << ", at most " << max_num_allocated_blocks
+            << " blocks were in memory.";
   return true;
 }
 
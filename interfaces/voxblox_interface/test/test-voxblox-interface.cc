@@ -31,7 +31,7 @@ class VoxbloxInterfaceTest : public ::testing::Test {
         map_manager.loadMapFromFolder("./test_maps/vi_app_test", &vi_map_key_));
     CHECK(
         landmark_triangulation::retriangulateLandmarks(
-            map_manager.getMapMutable(vi_map_key_)));
+            map_manager.getMapMutable(vi_map_key_).get()));
 
     depth_map_openni_ = cv::imread(
         kTestDataBaseFolder + "/depth_map_OpenNI.pgm", CV_LOAD_IMAGE_UNCHANGED);
@@ -86,7 +86,8 @@ class VoxbloxInterfaceTest : public ::testing::Test {
   const vi_map::VIMap& getViMap() const {
     vi_map::VIMapManager map_manager;
     CHECK(map_manager.hasMap(vi_map_key_));
-    return map_manager.getMap(vi_map_key_);
+    // There is no memory budget, so the map stays resident.
+    return *map_manager.getMap(vi_map_key_);
   }
 
   cv::Mat depth_map_openni_;
@@ -9,7 +9,6 @@ class VIMap;
 
 namespace summary_map {
 class LocalizationSummaryMap;
-class LocalizationSummaryMapCache;
 
 void createLocalizationSummaryMapForWellConstrainedLandmarks(
     const vi_map::VIMap& map, summary_map::LocalizationSummaryMap* summary_map);
@@ -18,14 +17,11 @@ void createLocalizationSummaryMapForSummarizedLandmarks(
     const vi_map::VIMap& map, const double landmark_keep_fraction,
     summary_map::LocalizationSummaryMap* summary_map);
 
+// Builds the summary map in parallel passes over a flat table of the
+// observations of all landmarks.
 void createLocalizationSummaryMapFromLandmarkList(
     const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
     summary_map::LocalizationSummaryMap* summary_map);
 
-void createLocalizationSummaryMapFromLandmarkList(
-    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
-    LocalizationSummaryMapCache* summary_map_cache,
-    summary_map::LocalizationSummaryMap* summary_map);
-
 }  // namespace summary_map
 #endif  // LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_CREATION_H_
@@ -0,0 +1,70 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILES_H_
+#define LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILES_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/macros.h>
+#include <maplab-common/map-manager-config.h>
+
+#include "localization-summary-map/localization-summary-map.h"
+
+namespace summary_map {
+
+struct LocalizationSummaryMapTile {
+  // Index of the tile along the x and y axis of the global frame.
+  Eigen::Vector2i coordinates;
+  std::string folder;
+  // Memory of the matrices of the tile summary map.
+  size_t num_bytes;
+};
+
+// Splits the summary map into square tiles in the x-y plane of the global
+// frame. A landmark belongs to the tile it lies in, every tile keeps the
+// observations and observers of its landmarks.
+void splitLocalizationSummaryMapIntoTiles(
+    const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+    std::vector<std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>>*
+        tiles);
+
+size_t getLocalizationSummaryMapNumBytes(
+    const LocalizationSummaryMap& summary_map);
+
+// A summary map stored as one summary map per tile next to an index of the
+// tiles, so only the tiles around the current position need to be in memory.
+class LocalizationSummaryMapTiles {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LocalizationSummaryMapTiles);
+
+  static bool saveToFolder(
+      const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+      const std::string& folder_path, const backend::SaveConfig& config);
+  static bool hasTilesOnFileSystem(const std::string& folder_path);
+
+  // Only loads the tile index, the tiles are loaded with loadTile.
+  bool loadFromFolder(const std::string& folder_path);
+  bool loadTile(size_t tile_index, LocalizationSummaryMap* tile_map) const;
+
+  Eigen::Vector2i getTileCoordinates(const Eigen::Vector3d& G_p) const;
+  // Distance in the x-y plane from G_p to the closest point of the tile.
+  double getDistanceToTile(
+      const Eigen::Vector3d& G_p, const size_t tile_index) const;
+
+  double tileSizeMeters() const {
+    return tile_size_meters_;
+  }
+  const std::vector<LocalizationSummaryMapTile>& tiles() const {
+    return tiles_;
+  }
+
+ private:
+  static constexpr char kFileName[] = "localization_summary_map_tiles";
+
+  double tile_size_meters_ = 0.0;
+  std::vector<LocalizationSummaryMapTile> tiles_;
+};
+
+}  // namespace summary_map
+#endif  // LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILES_H_
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <Eigen/Core>
 
@@ -12,6 +13,7 @@
 #include <vi-map/landmark.h>
 #include <vi-map/unique-id.h>
 
+#include "localization-summary-map/quantized-descriptors.h"
 #include "localization-summary-map/unique-id.h"
 
 namespace summary_map {
@@ -22,6 +24,7 @@ namespace summary_map {
 
 namespace proto {
 class LocalizationSummaryMap;
+class SpatialIndex;
 }  // namespace proto
 
 class LocalizationSummaryMap {
@@ -64,11 +67,33 @@ class LocalizationSummaryMap {
 
   const Eigen::Matrix3Xf& GLandmarkPosition() const;
   const Eigen::Matrix3Xf& GObserverPosition() const;
+  // Only available if the descriptors are not quantized, use
+  // getProjectedDescriptors() or getSquaredDistanceToProjectedDescriptor()
+  // to access quantized descriptors.
   const Eigen::MatrixXf& projectedDescriptors() const;
   const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& observerIndices() const;
   const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
   observationToLandmarkIndex() const;
 
+  // Replaces the float projected descriptors by int8 or fp16 codes to save
+  // memory and disk space, kNone converts them back to float.
+  void quantizeProjectedDescriptors(
+      const DescriptorQuantization quantization);
+  DescriptorQuantization projectedDescriptorQuantization() const;
+  int numProjectedDescriptors() const;
+  int projectedDescriptorDimensionality() const;
+  size_t getProjectedDescriptorsMemoryBytes() const;
+  // The (dequantized) descriptors [first_descriptor, first_descriptor +
+  // num_descriptors), respectively all of them.
+  void getProjectedDescriptors(
+      const int first_descriptor, const int num_descriptors,
+      Eigen::MatrixXf* projected_descriptors) const;
+  void getProjectedDescriptors(Eigen::MatrixXf* projected_descriptors) const;
+  template <typename Derived>
+  float getSquaredDistanceToProjectedDescriptor(
+      const int descriptor_index,
+      const Eigen::MatrixBase<Derived>& query_descriptor) const;
+
   bool hasLandmark(const vi_map::LandmarkId& landmark_id) const;
   Eigen::Vector3d getGLandmarkPosition(
       const vi_map::LandmarkId& landmark_id) const;
@@ -76,12 +101,35 @@ class LocalizationSummaryMap {
   void getAllObserverIds(pose_graph::VertexIdList* observer_ids) const;
   void getAllLandmarkIds(vi_map::LandmarkIdList* landmark_ids) const;
 
+  // Sorts the landmarks and observers into a voxel grid for the radius
+  // queries below. Needs to be called again if the positions change.
+  void buildSpatialIndex(const double voxel_size_meters);
+  bool hasSpatialIndex() const;
+  // Indices of the landmarks (columns of GLandmarkPosition) respectively the
+  // observers (columns of GObserverPosition) within radius_meters of G_p.
+  void getLandmarkIndicesInRadius(
+      const Eigen::Vector3d& G_p, const double radius_meters,
+      std::vector<unsigned int>* landmark_indices) const;
+  void getObserverIndicesInRadius(
+      const Eigen::Vector3d& G_p, const double radius_meters,
+      std::vector<unsigned int>* observer_indices) const;
+
   bool operator==(const LocalizationSummaryMap& other) const;
   bool operator!=(const LocalizationSummaryMap& other) const;
 
  private:
   static constexpr char kFileName[] = "localization_summary_map";
 
+  typedef std::unordered_map<int64_t, std::vector<unsigned int>> VoxelGrid;
+
+  int64_t getVoxelKey(const Eigen::Vector3i& voxel) const;
+  void getPointIndicesInRadius(
+      const VoxelGrid& voxel_grid, const Eigen::Matrix3Xf& G_points,
+      const Eigen::Vector3d& G_p, const double radius_meters,
+      std::vector<unsigned int>* point_indices) const;
+  void serializeSpatialIndex(proto::SpatialIndex* proto) const;
+  void deserializeSpatialIndex(const proto::SpatialIndex& proto);
+
   // The goal here is to get the most compact representation (memory).
   // So instead of storing for every descriptor a vertex+frame id pair, we just
   // store an arbitrary integer id that tells us which landmarks are seen from
@@ -99,12 +147,32 @@ class LocalizationSummaryMap {
   Eigen::Matrix3Xf G_observer_position_;
   /// A set of projected_descriptors from observations of landmarks.
   Eigen::MatrixXf projected_descriptors_;
+  /// Replaces projected_descriptors_ if the descriptors are quantized.
+  QuantizedDescriptors quantized_projected_descriptors_;
   /// An index of a key-frame for every observation (descriptor).
   Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices_;
   /// A mapping from observation (descriptor) to index in G_landmark_position.
   Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index_;
+  /// Edge length of the voxels of the spatial index, 0 if there is no index.
+  double spatial_index_voxel_size_meters_ = 0.0;
+  /// Mapping of voxel keys to the landmark and observer indices inside.
+  VoxelGrid landmark_voxel_grid_;
+  VoxelGrid observer_voxel_grid_;
 };
 
+template <typename Derived>
+float LocalizationSummaryMap::getSquaredDistanceToProjectedDescriptor(
+    const int descriptor_index,
+    const Eigen::MatrixBase<Derived>& query_descriptor) const {
+  if (projectedDescriptorQuantization() != DescriptorQuantization::kNone) {
+    return quantized_projected_descriptors_.squaredDistance(
+        descriptor_index, query_descriptor);
+  }
+  CHECK_LT(descriptor_index, projected_descriptors_.cols());
+  return (query_descriptor - projected_descriptors_.col(descriptor_index))
+      .squaredNorm();
+}
+
 typedef std::unordered_map<LocalizationSummaryMapId,
                            LocalizationSummaryMap::Ptr>
     LocalizationSummaryMapMap;
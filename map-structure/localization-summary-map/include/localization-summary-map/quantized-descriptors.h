@@ -0,0 +1,108 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_QUANTIZED_DESCRIPTORS_H_
+#define LOCALIZATION_SUMMARY_MAP_QUANTIZED_DESCRIPTORS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace summary_map {
+
+namespace proto {
+class QuantizedDescriptors;
+}  // namespace proto
+
+enum class DescriptorQuantization : int { kNone = 0, kInt8 = 1, kFloat16 = 2 };
+
+// Parses "none", "int8" and "fp16".
+bool parseDescriptorQuantization(
+    const std::string& name, DescriptorQuantization* quantization);
+std::string getDescriptorQuantizationName(
+    const DescriptorQuantization quantization);
+
+uint16_t floatToHalf(const float value);
+float halfToFloat(const uint16_t half);
+
+// Compact column-major storage of the projected descriptors of a summary map.
+//  - kInt8 maps every dimension linearly to [-128, 127], the value of row r
+//    is scales[r] * (code - zero_points[r]). 4x smaller than float.
+//  - kFloat16 stores IEEE half-precision floats. 2x smaller than float.
+class QuantizedDescriptors {
+ public:
+  QuantizedDescriptors();
+
+  void quantize(
+      const Eigen::MatrixXf& descriptors,
+      const DescriptorQuantization quantization);
+  void clear();
+
+  DescriptorQuantization quantization() const {
+    return quantization_;
+  }
+  int rows() const {
+    return rows_;
+  }
+  int cols() const {
+    return cols_;
+  }
+
+  void dequantize(Eigen::MatrixXf* descriptors) const;
+  // Dequantizes the columns [first_col, first_col + num_cols).
+  void dequantizeColumns(
+      const int first_col, const int num_cols,
+      Eigen::MatrixXf* descriptors) const;
+
+  // Squared L2 distance between the float query and a stored descriptor,
+  // computed on the codes without dequantizing the column first.
+  template <typename Derived>
+  float squaredDistance(
+      const int col, const Eigen::MatrixBase<Derived>& query) const;
+
+  size_t getMemoryUsageBytes() const;
+
+  void serialize(proto::QuantizedDescriptors* proto) const;
+  void deserialize(const proto::QuantizedDescriptors& proto);
+
+  bool operator==(const QuantizedDescriptors& other) const;
+
+ private:
+  DescriptorQuantization quantization_;
+  int rows_;
+  int cols_;
+  std::vector<int8_t> int8_codes_;
+  std::vector<uint16_t> float16_codes_;
+  Eigen::VectorXf scales_;
+  Eigen::VectorXf zero_points_;
+};
+
+template <typename Derived>
+float QuantizedDescriptors::squaredDistance(
+    const int col, const Eigen::MatrixBase<Derived>& query) const {
+  CHECK_GE(col, 0);
+  CHECK_LT(col, cols_);
+  CHECK_EQ(query.rows(), rows_);
+  float squared_distance = 0.f;
+  const size_t offset = static_cast<size_t>(col) * rows_;
+  if (quantization_ == DescriptorQuantization::kInt8) {
+    for (int row = 0; row < rows_; ++row) {
+      const float difference =
+          query(row) -
+          scales_(row) * (int8_codes_[offset + row] - zero_points_(row));
+      squared_distance += difference * difference;
+    }
+  } else {
+    CHECK(quantization_ == DescriptorQuantization::kFloat16);
+    for (int row = 0; row < rows_; ++row) {
+      const float difference =
+          query(row) - halfToFloat(float16_codes_[offset + row]);
+      squared_distance += difference * difference;
+    }
+  }
+  return squared_distance;
+}
+
+}  // namespace summary_map
+
+#endif  // LOCALIZATION_SUMMARY_MAP_QUANTIZED_DESCRIPTORS_H_
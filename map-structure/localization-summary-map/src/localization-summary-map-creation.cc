@@ -1,20 +1,32 @@
 #include "localization-summary-map/localization-summary-map-creation.h"
 
+#include <algorithm>
 #include <fstream>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 #include <descriptor-projection/descriptor-projection.h>
+#include <descriptor-projection/flags.h>
+#include <descriptor-projection/projected-descriptor-storage.h>
+#include <gflags/gflags.h>
 #include <loopclosure-common/flags.h>
 #include <loopclosure-common/types.h>
 #include <map-sparsification/sampler-base.h>
 #include <map-sparsification/sampler-factory.h>
 #include <maplab-common/binary-serialization.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
 
-#include "localization-summary-map/localization-summary-map-cache.h"
 #include "localization-summary-map/localization-summary-map.h"
+#include "localization-summary-map/quantized-descriptors.h"
+
+DECLARE_string(summary_map_descriptor_quantization);
+DECLARE_double(summary_map_spatial_index_voxel_size_m);
 
 namespace summary_map {
 
@@ -26,7 +38,7 @@ void createLocalizationSummaryMapForWellConstrainedLandmarks(
   queries.getAllWellConstrainedLandmarkIds(&landmark_ids);
 
   createLocalizationSummaryMapFromLandmarkList(
-      map, landmark_ids, nullptr, summary_map);
+      map, landmark_ids, summary_map);
 }
 
 void createLocalizationSummaryMapForSummarizedLandmarks(
@@ -55,18 +67,14 @@ void createLocalizationSummaryMapForSummarizedLandmarks(
 void createLocalizationSummaryMapFromLandmarkList(
     const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
     summary_map::LocalizationSummaryMap* summary_map) {
-  createLocalizationSummaryMapFromLandmarkList(
-      map, landmark_ids, nullptr, summary_map);
-}
-
-void createLocalizationSummaryMapFromLandmarkList(
-    const vi_map::VIMap& map,
-    const vi_map::LandmarkIdList& landmark_ids,
-    LocalizationSummaryMapCache* summary_map_cache,
-    summary_map::LocalizationSummaryMap* summary_map) {
   CHECK_NOTNULL(summary_map);
+  CHECK(!landmark_ids.empty());
+  const size_t num_landmarks = landmark_ids.size();
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+
   /// The position of the landmarks in the global frame of reference.
-  Eigen::Matrix3Xd G_landmark_position;
+  Eigen::Matrix3Xd G_landmark_position(3, num_landmarks);
   /// The position of the observers in the global frame of reference.
   Eigen::Matrix3Xd G_observer_position;
   /// A set of projected_descriptors from observations of landmarks.
@@ -76,41 +84,83 @@ void createLocalizationSummaryMapFromLandmarkList(
   /// A mapping from observation (descriptor) to index in G_landmark_position.
   Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index;
 
-  CHECK(!landmark_ids.empty());
-  G_landmark_position.resize(Eigen::NoChange, landmark_ids.size());
-
-  std::vector<vi_map::KeypointIdentifier> observations;
-  // Best guess reserve.
-  observations.reserve(landmark_ids.size() * 4);
+  // The observations of all landmarks form a flat table in which the
+  // observations of landmark i start at landmark_observation_offsets[i].
+  std::vector<size_t> landmark_observation_offsets(num_landmarks + 1u, 0u);
+  common::ParallelProcess(
+      num_landmarks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_index : range) {
+          const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_index];
+          G_landmark_position.col(landmark_index) =
+              map.getLandmark_G_p_fi(landmark_id);
+          landmark_observation_offsets[landmark_index + 1u] =
+              map.getLandmark(landmark_id).numberOfObservations();
+        }
+      },
+      kAlwaysParallelize, num_threads);
+  for (size_t landmark_index = 0u; landmark_index < num_landmarks;
+       ++landmark_index) {
+    landmark_observation_offsets[landmark_index + 1u] +=
+        landmark_observation_offsets[landmark_index];
+  }
+  const size_t num_observations = landmark_observation_offsets.back();
+  CHECK_GT(num_observations, 0u)
+      << "No landmark observations for summary map.";
 
-  std::vector<unsigned int> observation_to_landmark;
-  observation_to_landmark.reserve(landmark_ids.size() * 4);
+  std::vector<vi_map::KeypointIdentifier> observations(num_observations);
+  observation_to_landmark_index.resize(num_observations);
+  common::ParallelProcess(
+      num_landmarks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_index : range) {
+          const std::vector<vi_map::KeypointIdentifier>&
+              landmark_observations =
+                  map.getLandmark(landmark_ids[landmark_index])
+                      .getObservations();
+          const size_t offset = landmark_observation_offsets[landmark_index];
+          CHECK_EQ(
+              offset + landmark_observations.size(),
+              landmark_observation_offsets[landmark_index + 1u]);
+          for (size_t i = 0u; i < landmark_observations.size(); ++i) {
+            observations[offset + i] = landmark_observations[i];
+            observation_to_landmark_index(offset + i) = landmark_index;
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
 
-  // We first collect all observations to the landmarks in question.
-  for (size_t landmark_index = 0; landmark_index < landmark_ids.size();
-       ++landmark_index) {
-    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_index];
-    const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-    G_landmark_position.col(landmark_index) =
-        map.getLandmark_G_p_fi(landmark_id);
-
-    const std::vector<vi_map::KeypointIdentifier>& landmark_observations =
-        landmark.getObservations();
-    observations.insert(
-        observations.end(), landmark_observations.begin(),
-        landmark_observations.end());
-
-    // Push the index of the landmark for all the observations.
-    for (size_t i = 0; i < landmark_observations.size(); ++i) {
-      observation_to_landmark.push_back(landmark_index);
+  // The observers are numbered in the order of their first observation, which
+  // needs a serial pass, but their positions are looked up in parallel.
+  observer_indices.resize(num_observations);
+  std::vector<vi_map::VisualFrameIdentifier> observer_frame_ids;
+  std::unordered_map<vi_map::VisualFrameIdentifier, unsigned int>
+      frame_id_to_index;
+  for (size_t observation_index = 0u; observation_index < num_observations;
+       ++observation_index) {
+    const vi_map::VisualFrameIdentifier& frame_id =
+        observations[observation_index].frame_id;
+    const std::pair<
+        std::unordered_map<vi_map::VisualFrameIdentifier,
+                           unsigned int>::const_iterator,
+        bool>
+        insertion =
+            frame_id_to_index.emplace(frame_id, observer_frame_ids.size());
+    if (insertion.second) {
+      observer_frame_ids.emplace_back(frame_id);
     }
+    observer_indices(observation_index) = insertion.first->second;
   }
-  CHECK(!observations.empty()) << "No landmark observations for summary map.";
-
-  // Copy all the observation to landmark indices into the summary-map format.
-  observation_to_landmark_index =
-      Eigen::Map<const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> >(
-          observation_to_landmark.data(), observation_to_landmark.size(), 1);
+  G_observer_position.resize(Eigen::NoChange, observer_frame_ids.size());
+  common::ParallelProcess(
+      observer_frame_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t observer_index : range) {
+          G_observer_position.col(observer_index) =
+              map.getVertex_G_p_I(observer_frame_ids[observer_index].vertex_id);
+        }
+      },
+      kAlwaysParallelize, num_threads);
 
   const char* loop_closure_files_path = getenv("MAPLAB_LOOPCLOSURE_DIR");
   CHECK_NE(loop_closure_files_path, static_cast<char*>(NULL))
@@ -135,70 +185,98 @@ void createLocalizationSummaryMapFromLandmarkList(
                                 << FLAGS_lc_projection_matrix_filename;
   common::Deserialize(&projection_matrix, &deserializer);
 
-  projected_descriptors.resize(
-      FLAGS_lc_target_dimensionality, observations.size());
-  observer_indices.resize(observations.size());
-  Aligned<std::vector, Eigen::Vector3d> G_observer_positions;
-
-  std::unordered_map<vi_map::VisualFrameIdentifier, int> frame_id_to_index;
-  int observer_index = 0;
-  for (size_t observation_index = 0; observation_index < observations.size();
-       ++observation_index) {
-    // We store the observer index for covisibility graph based filtering.
-    const vi_map::KeypointIdentifier& observation =
-        observations[observation_index];
-    std::unordered_map<vi_map::VisualFrameIdentifier, int>::const_iterator it =
-        frame_id_to_index.find(observation.frame_id);
-    if (it == frame_id_to_index.end()) {
-      it = frame_id_to_index
-               .insert(std::make_pair(observation.frame_id, observer_index))
-               .first;
-      Eigen::Vector3d G_observer_position =
-          map.getVertex_G_p_I(observation.frame_id.vertex_id);
-      G_observer_positions.push_back(G_observer_position);
-      ++observer_index;
-    }
-    observer_indices(observation_index, 0) = it->second;
-
-    CHECK_LT(observation_index, observation_to_landmark.size());
-    const size_t landmark_index = observation_to_landmark[observation_index];
-    CHECK_LT(landmark_index, landmark_ids.size());
-    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_index];
-    if (summary_map_cache == nullptr ||
-        !summary_map_cache->getProjectedDescriptorForLandmark(
-            observation, landmark_id,
-            projected_descriptors.col(observation_index))) {
-      // No projected descriptor is stored yet, need to compute first.
-      const aslam::VisualFrame& frame =
-          map.getVertex(observation.frame_id.vertex_id)
-              .getVisualFrame(observation.frame_id.frame_index);
-
-      Eigen::Map<const Eigen::Matrix<unsigned char, Eigen::Dynamic, 1> >
-          raw_descriptor(
-              frame.getDescriptor(observation.keypoint_index),
-              frame.getDescriptorSizeBytes(), 1);
-
-      // Project the descriptors directly into the descriptor storage.
-      descriptor_projection::ProjectDescriptor(
-          raw_descriptor, projection_matrix, FLAGS_lc_target_dimensionality,
-          projected_descriptors.col(observation_index));
-
-      if (summary_map_cache != nullptr) {
-        summary_map_cache->addProjectedDescriptor(
-            observation, landmark_id,
-            projected_descriptors.col(observation_index));
-      }
-    }
-  }
-  G_observer_position.resize(Eigen::NoChange, G_observer_positions.size());
-  for (size_t i = 0; i < G_observer_positions.size(); ++i) {
-    G_observer_position.col(i) = G_observer_positions[i];
+  // Observers whose projected descriptors are stored in the map with this
+  // projection don't need to be projected again.
+  std::vector<Eigen::MatrixXf> stored_projected_descriptors(
+      observer_frame_ids.size());
+  std::vector<unsigned char> has_stored_projected_descriptors(
+      observer_frame_ids.size(), 0u);
+  if (FLAGS_lc_use_stored_projected_descriptors) {
+    const uint64_t projection_fingerprint =
+        descriptor_projection::ComputeProjectionFingerprint(
+            projection_matrix, FLAGS_lc_target_dimensionality);
+    common::ParallelProcess(
+        observer_frame_ids.size(),
+        [&](const std::vector<size_t>& range) {
+          for (const size_t observer_index : range) {
+            has_stored_projected_descriptors[observer_index] =
+                descriptor_projection::GetStoredProjectedDescriptors(
+                    map, observer_frame_ids[observer_index],
+                    projection_fingerprint,
+                    &stored_projected_descriptors[observer_index]);
+          }
+        },
+        kAlwaysParallelize, num_threads);
   }
 
+  // The descriptors are projected in batches that are written directly into
+  // their columns of the descriptor storage.
+  constexpr size_t kProjectionBatchSize = 4096u;
+  const size_t num_batches =
+      (num_observations + kProjectionBatchSize - 1u) / kProjectionBatchSize;
+  projected_descriptors.resize(
+      FLAGS_lc_target_dimensionality, num_observations);
+  common::ParallelProcess(
+      num_batches,
+      [&](const std::vector<size_t>& range) {
+        std::vector<aslam::common::FeatureDescriptorConstRef> raw_descriptors;
+        raw_descriptors.reserve(kProjectionBatchSize);
+        std::vector<size_t> raw_observation_indices;
+        raw_observation_indices.reserve(kProjectionBatchSize);
+        Eigen::MatrixXf projected_batch;
+        for (const size_t batch_index : range) {
+          const size_t begin = batch_index * kProjectionBatchSize;
+          const size_t end =
+              std::min(begin + kProjectionBatchSize, num_observations);
+          raw_descriptors.clear();
+          raw_observation_indices.clear();
+          for (size_t observation_index = begin; observation_index < end;
+               ++observation_index) {
+            const vi_map::KeypointIdentifier& observation =
+                observations[observation_index];
+            const unsigned int observer_index =
+                observer_indices(observation_index);
+            if (has_stored_projected_descriptors[observer_index]) {
+              projected_descriptors.col(observation_index) =
+                  stored_projected_descriptors[observer_index].col(
+                      observation.keypoint_index);
+              continue;
+            }
+            const aslam::VisualFrame& frame =
+                map.getVertex(observation.frame_id.vertex_id)
+                    .getVisualFrame(observation.frame_id.frame_index);
+            raw_descriptors.emplace_back(
+                frame.getDescriptor(observation.keypoint_index),
+                frame.getDescriptorSizeBytes());
+            raw_observation_indices.emplace_back(observation_index);
+          }
+          if (raw_descriptors.empty()) {
+            continue;
+          }
+          descriptor_projection::ProjectDescriptorBlock(
+              raw_descriptors, projection_matrix,
+              FLAGS_lc_target_dimensionality, &projected_batch);
+          for (size_t i = 0u; i < raw_observation_indices.size(); ++i) {
+            projected_descriptors.col(raw_observation_indices[i]) =
+                projected_batch.col(i);
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
   summary_map->setGLandmarkPosition(G_landmark_position);
   summary_map->setGObserverPosition(G_observer_position);
   summary_map->setProjectedDescriptors(projected_descriptors);
+  DescriptorQuantization descriptor_quantization;
+  CHECK(parseDescriptorQuantization(
+      FLAGS_summary_map_descriptor_quantization, &descriptor_quantization));
+  if (descriptor_quantization != DescriptorQuantization::kNone) {
+    // Release the float copy before quantizing.
+    Eigen::MatrixXf().swap(projected_descriptors);
+    summary_map->quantizeProjectedDescriptors(descriptor_quantization);
+  }
   summary_map->setObserverIndices(observer_indices);
   summary_map->setObservationToLandmarkIndex(observation_to_landmark_index);
+  summary_map->buildSpatialIndex(FLAGS_summary_map_spatial_index_voxel_size_m);
 }
 }  // namespace summary_map
@@ -0,0 +1,266 @@
+#include "localization-summary-map/localization-summary-map-tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/unique-id.h>
+
+#include "localization-summary-map/localization-summary-map.pb.h"
+
+DECLARE_double(summary_map_spatial_index_voxel_size_m);
+
+namespace summary_map {
+
+constexpr char LocalizationSummaryMapTiles::kFileName[];
+
+namespace {
+
+Eigen::Vector2i getTileCoordinatesForPosition(
+    const Eigen::Vector3d& G_p, const double tile_size_meters) {
+  CHECK_GT(tile_size_meters, 0.0);
+  return (G_p.head<2>() / tile_size_meters).array().floor().cast<int>();
+}
+
+std::string getTileFolderName(const Eigen::Vector2i& coordinates) {
+  return "tile_" + std::to_string(coordinates.x()) + "_" +
+         std::to_string(coordinates.y());
+}
+
+}  // namespace
+
+void splitLocalizationSummaryMapIntoTiles(
+    const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+    std::vector<std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>>*
+        tiles) {
+  CHECK_NOTNULL(tiles)->clear();
+  CHECK_GT(tile_size_meters, 0.0);
+
+  const Eigen::Matrix3Xf& G_landmark_position =
+      summary_map.GLandmarkPosition();
+  const Eigen::Matrix3Xf& G_observer_position =
+      summary_map.GObserverPosition();
+  // Tiles are quantized like the map they are split from.
+  Eigen::MatrixXf projected_descriptors;
+  summary_map.getProjectedDescriptors(&projected_descriptors);
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& observer_indices =
+      summary_map.observerIndices();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      observation_to_landmark_index = summary_map.observationToLandmarkIndex();
+  CHECK_EQ(observer_indices.rows(), observation_to_landmark_index.rows());
+  CHECK_EQ(projected_descriptors.cols(), observation_to_landmark_index.rows());
+
+  std::vector<std::vector<unsigned int>> landmark_observations(
+      G_landmark_position.cols());
+  for (int i = 0; i < observation_to_landmark_index.rows(); ++i) {
+    CHECK_LT(
+        observation_to_landmark_index(i, 0), landmark_observations.size());
+    landmark_observations[observation_to_landmark_index(i, 0)].push_back(i);
+  }
+
+  // Ordered by the tile coordinates, so the tiles come out deterministically.
+  std::map<std::pair<int, int>, std::vector<unsigned int>> tile_landmarks;
+  for (int i = 0; i < G_landmark_position.cols(); ++i) {
+    const Eigen::Vector2i coordinates = getTileCoordinatesForPosition(
+        G_landmark_position.col(i).cast<double>(), tile_size_meters);
+    tile_landmarks[std::make_pair(coordinates.x(), coordinates.y())]
+        .push_back(i);
+  }
+
+  for (const std::map<std::pair<int, int>, std::vector<unsigned int>>::
+           value_type& tile : tile_landmarks) {
+    const std::vector<unsigned int>& landmark_indices = tile.second;
+    size_t num_observations = 0u;
+    for (const unsigned int landmark_index : landmark_indices) {
+      num_observations += landmark_observations[landmark_index].size();
+    }
+
+    Eigen::Matrix3Xd tile_G_landmark_position(3, landmark_indices.size());
+    Eigen::MatrixXf tile_projected_descriptors(
+        projected_descriptors.rows(), num_observations);
+    Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> tile_observer_indices(
+        num_observations);
+    Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>
+        tile_observation_to_landmark_index(num_observations);
+    std::unordered_map<unsigned int, unsigned int> observer_to_tile_observer;
+    std::vector<unsigned int> tile_observers;
+
+    size_t tile_observation_index = 0u;
+    for (size_t i = 0u; i < landmark_indices.size(); ++i) {
+      const unsigned int landmark_index = landmark_indices[i];
+      tile_G_landmark_position.col(i) =
+          G_landmark_position.col(landmark_index).cast<double>();
+      for (const unsigned int observation_index :
+           landmark_observations[landmark_index]) {
+        const unsigned int observer_index = observer_indices(observation_index);
+        typedef std::unordered_map<unsigned int, unsigned int>::iterator
+            ObserverIterator;
+        const std::pair<ObserverIterator, bool> result =
+            observer_to_tile_observer.emplace(
+                observer_index, tile_observers.size());
+        if (result.second) {
+          tile_observers.push_back(observer_index);
+        }
+        tile_projected_descriptors.col(tile_observation_index) =
+            projected_descriptors.col(observation_index);
+        tile_observer_indices(tile_observation_index) = result.first->second;
+        tile_observation_to_landmark_index(tile_observation_index) = i;
+        ++tile_observation_index;
+      }
+    }
+    CHECK_EQ(tile_observation_index, num_observations);
+
+    Eigen::Matrix3Xd tile_G_observer_position(3, tile_observers.size());
+    for (size_t i = 0u; i < tile_observers.size(); ++i) {
+      CHECK_LT(
+          tile_observers[i],
+          static_cast<unsigned int>(G_observer_position.cols()));
+      tile_G_observer_position.col(i) =
+          G_observer_position.col(tile_observers[i]).cast<double>();
+    }
+
+    LocalizationSummaryMap::UniquePtr tile_map =
+        aligned_unique<LocalizationSummaryMap>();
+    LocalizationSummaryMapId tile_map_id;
+    common::generateId(&tile_map_id);
+    tile_map->setId(tile_map_id);
+    tile_map->setGLandmarkPosition(tile_G_landmark_position);
+    tile_map->setGObserverPosition(tile_G_observer_position);
+    tile_map->setProjectedDescriptors(tile_projected_descriptors);
+    tile_map->quantizeProjectedDescriptors(
+        summary_map.projectedDescriptorQuantization());
+    tile_map->setObserverIndices(tile_observer_indices);
+    tile_map->setObservationToLandmarkIndex(
+        tile_observation_to_landmark_index);
+    tile_map->buildSpatialIndex(FLAGS_summary_map_spatial_index_voxel_size_m);
+
+    tiles->emplace_back(
+        Eigen::Vector2i(tile.first.first, tile.first.second),
+        std::move(tile_map));
+  }
+}
+
+size_t getLocalizationSummaryMapNumBytes(
+    const LocalizationSummaryMap& summary_map) {
+  const size_t num_floats = summary_map.GLandmarkPosition().size() +
+                            summary_map.GObserverPosition().size();
+  const size_t num_indices = summary_map.observerIndices().size() +
+                             summary_map.observationToLandmarkIndex().size();
+  return sizeof(float) * num_floats + sizeof(unsigned int) * num_indices +
+         summary_map.getProjectedDescriptorsMemoryBytes();
+}
+
+bool LocalizationSummaryMapTiles::saveToFolder(
+    const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+    const std::string& folder_path, const backend::SaveConfig& config) {
+  CHECK(!folder_path.empty());
+  CHECK_GT(tile_size_meters, 0.0);
+  if (!config.overwrite_existing_files && hasTilesOnFileSystem(folder_path)) {
+    LOG(ERROR) << "Summary map tiles already exist under \"" << folder_path
+               << "\".";
+    return false;
+  }
+  if (!common::createPath(folder_path)) {
+    LOG(ERROR) << "Creating path to \"" << folder_path << "\" failed.";
+    return false;
+  }
+
+  std::vector<std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>>
+      tiles;
+  splitLocalizationSummaryMapIntoTiles(summary_map, tile_size_meters, &tiles);
+
+  proto::LocalizationSummaryMapTileIndex proto;
+  proto.set_tile_size_meters(tile_size_meters);
+  for (const std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>&
+           tile : tiles) {
+    const std::string tile_folder_name = getTileFolderName(tile.first);
+    if (!tile.second->saveToFolder(
+            common::concatenateFolderAndFileName(
+                folder_path, tile_folder_name),
+            config)) {
+      LOG(ERROR) << "Saving the summary map tile " << tile_folder_name
+                 << " failed.";
+      return false;
+    }
+    proto::LocalizationSummaryMapTile* tile_proto = proto.add_tiles();
+    tile_proto->set_x(tile.first.x());
+    tile_proto->set_y(tile.first.y());
+    tile_proto->set_folder(tile_folder_name);
+    tile_proto->set_num_bytes(getLocalizationSummaryMapNumBytes(*tile.second));
+  }
+  VLOG(1) << "Saved the summary map as " << tiles.size() << " tiles of "
+          << tile_size_meters << " m.";
+  return common::proto_serialization_helper::serializeProtoToFile(
+      folder_path, kFileName, proto);
+}
+
+bool LocalizationSummaryMapTiles::hasTilesOnFileSystem(
+    const std::string& folder_path) {
+  CHECK(!folder_path.empty());
+  if (!common::pathExists(folder_path)) {
+    return false;
+  }
+  return common::fileExists(common::concatenateFolderAndFileName(
+      common::getRealPath(folder_path), kFileName));
+}
+
+bool LocalizationSummaryMapTiles::loadFromFolder(
+    const std::string& folder_path) {
+  CHECK(!folder_path.empty());
+  if (!hasTilesOnFileSystem(folder_path)) {
+    LOG(ERROR) << "No summary map tiles could be found under \""
+               << folder_path << "\".";
+    return false;
+  }
+  proto::LocalizationSummaryMapTileIndex proto;
+  if (!common::proto_serialization_helper::parseProtoFromFile(
+          folder_path, kFileName, &proto)) {
+    LOG(ERROR) << "The summary map tile index under \"" << folder_path
+               << "\" couldn't be parsed by protobuf.";
+    return false;
+  }
+
+  CHECK_GT(proto.tile_size_meters(), 0.0);
+  tile_size_meters_ = proto.tile_size_meters();
+  tiles_.clear();
+  tiles_.reserve(proto.tiles_size());
+  for (const proto::LocalizationSummaryMapTile& tile_proto : proto.tiles()) {
+    LocalizationSummaryMapTile tile;
+    tile.coordinates = Eigen::Vector2i(tile_proto.x(), tile_proto.y());
+    tile.folder = common::concatenateFolderAndFileName(
+        folder_path, tile_proto.folder());
+    tile.num_bytes = tile_proto.num_bytes();
+    tiles_.push_back(tile);
+  }
+  return true;
+}
+
+bool LocalizationSummaryMapTiles::loadTile(
+    size_t tile_index, LocalizationSummaryMap* tile_map) const {
+  CHECK_NOTNULL(tile_map);
+  CHECK_LT(tile_index, tiles_.size());
+  return tile_map->loadFromFolder(tiles_[tile_index].folder);
+}
+
+Eigen::Vector2i LocalizationSummaryMapTiles::getTileCoordinates(
+    const Eigen::Vector3d& G_p) const {
+  return getTileCoordinatesForPosition(G_p, tile_size_meters_);
+}
+
+double LocalizationSummaryMapTiles::getDistanceToTile(
+    const Eigen::Vector3d& G_p, const size_t tile_index) const {
+  CHECK_LT(tile_index, tiles_.size());
+  const Eigen::Array2d tile_min =
+      tiles_[tile_index].coordinates.cast<double>().array() *
+      tile_size_meters_;
+  const Eigen::Array2d tile_max = tile_min + tile_size_meters_;
+  const Eigen::Array2d p = G_p.head<2>().array();
+  return (tile_min - p).max(p - tile_max).max(0.0).matrix().norm();
+}
+
+}  // namespace summary_map
@@ -1,5 +1,9 @@
 #include "localization-summary-map/localization-summary-map.h"
 
+#include <cmath>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 #include <maplab-common/eigen-proto.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/proto-serialization-helper.h>
@@ -7,6 +11,15 @@
 
 #include "localization-summary-map/localization-summary-map.pb.h"
 
+DEFINE_double(
+    summary_map_spatial_index_voxel_size_m, 10.0,
+    "Voxel size of the spatial index of localization summary maps. Used when "
+    "creating summary maps and when loading maps saved without an index.");
+DEFINE_string(
+    summary_map_descriptor_quantization, "none",
+    "Storage of the projected descriptors of newly created localization "
+    "summary maps: none (float), int8 or fp16.");
+
 namespace summary_map {
 
 constexpr char LocalizationSummaryMap::kFileName[];
@@ -19,7 +32,13 @@ bool LocalizationSummaryMap::operator==(
       landmark_id_to_landmark_index_ == other.landmark_id_to_landmark_index_;
   is_same &= G_landmark_position_ == other.G_landmark_position_;
   is_same &= G_observer_position_ == other.G_observer_position_;
-  is_same &= projected_descriptors_ == other.projected_descriptors_;
+  is_same &= projected_descriptors_.rows() ==
+                 other.projected_descriptors_.rows() &&
+             projected_descriptors_.cols() ==
+                 other.projected_descriptors_.cols() &&
+             projected_descriptors_ == other.projected_descriptors_;
+  is_same &= quantized_projected_descriptors_ ==
+             other.quantized_projected_descriptors_;
   is_same &= observer_indices_ == other.observer_indices_;
   is_same &=
       observation_to_landmark_index_ == other.observation_to_landmark_index_;
@@ -42,13 +61,22 @@ void LocalizationSummaryMap::serialize(
       proto->mutable_uncompressed_map();
   common::eigen_proto::serialize(
       G_observer_position_, uncompressed_map->mutable_g_observer_position());
-  common::eigen_proto::serialize(
-      projected_descriptors_, uncompressed_map->mutable_descriptors());
+  if (projectedDescriptorQuantization() == DescriptorQuantization::kNone) {
+    common::eigen_proto::serialize(
+        projected_descriptors_, uncompressed_map->mutable_descriptors());
+  } else {
+    quantized_projected_descriptors_.serialize(
+        uncompressed_map->mutable_quantized_descriptors());
+  }
   common::eigen_proto::serialize(
       observer_indices_, uncompressed_map->mutable_observer_indices());
   common::eigen_proto::serialize(
       observation_to_landmark_index_,
       uncompressed_map->mutable_observation_to_landmark_index());
+
+  if (hasSpatialIndex()) {
+    serializeSpatialIndex(proto->mutable_spatial_index());
+  }
 }
 void LocalizationSummaryMap::deserialize(
     const LocalizationSummaryMapId& localization_summary_map_id,
@@ -77,8 +105,15 @@ void LocalizationSummaryMap::deserialize(
           << "VertexId collision.";
     }
 
-    common::eigen_proto::deserialize(
-        uncompressed_map.descriptors(), &projected_descriptors_);
+    if (uncompressed_map.has_quantized_descriptors()) {
+      projected_descriptors_.resize(0, 0);
+      quantized_projected_descriptors_.deserialize(
+          uncompressed_map.quantized_descriptors());
+    } else {
+      quantized_projected_descriptors_.clear();
+      common::eigen_proto::deserialize(
+          uncompressed_map.descriptors(), &projected_descriptors_);
+    }
     common::eigen_proto::deserialize(
         uncompressed_map.observer_indices(), &observer_indices_);
     common::eigen_proto::deserialize(
@@ -87,6 +122,14 @@ void LocalizationSummaryMap::deserialize(
   } else {
     LOG(FATAL) << "Unsupported localization summary map format.";
   }
+
+  // The spatial index only depends on the positions, so it is built on load
+  // for maps that were saved without one.
+  if (proto.has_spatial_index()) {
+    deserializeSpatialIndex(proto.spatial_index());
+  } else {
+    buildSpatialIndex(FLAGS_summary_map_spatial_index_voxel_size_m);
+  }
 }
 
 bool LocalizationSummaryMap::loadFromFolder(const std::string& folder_path) {
@@ -187,6 +230,154 @@ void LocalizationSummaryMap::getAllLandmarkIds(
   }
 }
 
+void LocalizationSummaryMap::buildSpatialIndex(
+    const double voxel_size_meters) {
+  CHECK_GT(voxel_size_meters, 0.0);
+  spatial_index_voxel_size_meters_ = voxel_size_meters;
+
+  auto build_voxel_grid = [this](
+      const Eigen::Matrix3Xf& G_points, VoxelGrid* voxel_grid) {
+    CHECK_NOTNULL(voxel_grid)->clear();
+    for (int i = 0; i < G_points.cols(); ++i) {
+      const Eigen::Vector3i voxel =
+          (G_points.col(i).cast<double>() / spatial_index_voxel_size_meters_)
+              .array()
+              .floor()
+              .cast<int>();
+      (*voxel_grid)[getVoxelKey(voxel)].push_back(i);
+    }
+  };
+  build_voxel_grid(G_landmark_position_, &landmark_voxel_grid_);
+  build_voxel_grid(G_observer_position_, &observer_voxel_grid_);
+}
+
+bool LocalizationSummaryMap::hasSpatialIndex() const {
+  return spatial_index_voxel_size_meters_ > 0.0;
+}
+
+void LocalizationSummaryMap::getLandmarkIndicesInRadius(
+    const Eigen::Vector3d& G_p, const double radius_meters,
+    std::vector<unsigned int>* landmark_indices) const {
+  getPointIndicesInRadius(
+      landmark_voxel_grid_, G_landmark_position_, G_p, radius_meters,
+      landmark_indices);
+}
+
+void LocalizationSummaryMap::getObserverIndicesInRadius(
+    const Eigen::Vector3d& G_p, const double radius_meters,
+    std::vector<unsigned int>* observer_indices) const {
+  getPointIndicesInRadius(
+      observer_voxel_grid_, G_observer_position_, G_p, radius_meters,
+      observer_indices);
+}
+
+int64_t LocalizationSummaryMap::getVoxelKey(
+    const Eigen::Vector3i& voxel) const {
+  // 21 bits per axis cover +-10000 km at a voxel size of 10 m.
+  constexpr int64_t kAxisMask = (1 << 21) - 1;
+  return ((voxel.x() & kAxisMask) << 42) | ((voxel.y() & kAxisMask) << 21) |
+         (voxel.z() & kAxisMask);
+}
+
+void LocalizationSummaryMap::getPointIndicesInRadius(
+    const VoxelGrid& voxel_grid, const Eigen::Matrix3Xf& G_points,
+    const Eigen::Vector3d& G_p, const double radius_meters,
+    std::vector<unsigned int>* point_indices) const {
+  CHECK_NOTNULL(point_indices)->clear();
+  CHECK(hasSpatialIndex()) << "The summary map has no spatial index.";
+  CHECK_GE(radius_meters, 0.0);
+
+  const Eigen::Vector3i min_voxel =
+      ((G_p.array() - radius_meters) / spatial_index_voxel_size_meters_)
+          .floor()
+          .cast<int>();
+  const Eigen::Vector3i max_voxel =
+      ((G_p.array() + radius_meters) / spatial_index_voxel_size_meters_)
+          .floor()
+          .cast<int>();
+  const double radius_squared = radius_meters * radius_meters;
+  Eigen::Vector3i voxel;
+  for (voxel.x() = min_voxel.x(); voxel.x() <= max_voxel.x(); ++voxel.x()) {
+    for (voxel.y() = min_voxel.y(); voxel.y() <= max_voxel.y(); ++voxel.y()) {
+      for (voxel.z() = min_voxel.z(); voxel.z() <= max_voxel.z();
+           ++voxel.z()) {
+        const VoxelGrid::const_iterator it =
+            voxel_grid.find(getVoxelKey(voxel));
+        if (it == voxel_grid.end()) {
+          continue;
+        }
+        for (const unsigned int point_index : it->second) {
+          if ((G_points.col(point_index).cast<double>() - G_p)
+                  .squaredNorm() <= radius_squared) {
+            point_indices->push_back(point_index);
+          }
+        }
+      }
+    }
+  }
+}
+
+void LocalizationSummaryMap::serializeSpatialIndex(
+    proto::SpatialIndex* proto) const {
+  CHECK_NOTNULL(proto);
+  CHECK(hasSpatialIndex());
+  proto->set_voxel_size_meters(spatial_index_voxel_size_meters_);
+  for (const VoxelGrid::value_type& voxel : landmark_voxel_grid_) {
+    proto->add_landmark_voxel_keys(voxel.first);
+    proto->add_landmark_voxel_offsets(proto->landmark_indices_size());
+    for (const unsigned int landmark_index : voxel.second) {
+      proto->add_landmark_indices(landmark_index);
+    }
+  }
+  proto->add_landmark_voxel_offsets(proto->landmark_indices_size());
+  for (const VoxelGrid::value_type& voxel : observer_voxel_grid_) {
+    proto->add_observer_voxel_keys(voxel.first);
+    proto->add_observer_voxel_offsets(proto->observer_indices_size());
+    for (const unsigned int observer_index : voxel.second) {
+      proto->add_observer_indices(observer_index);
+    }
+  }
+  proto->add_observer_voxel_offsets(proto->observer_indices_size());
+}
+
+void LocalizationSummaryMap::deserializeSpatialIndex(
+    const proto::SpatialIndex& proto) {
+  CHECK_GT(proto.voxel_size_meters(), 0.0f);
+  spatial_index_voxel_size_meters_ = proto.voxel_size_meters();
+
+  CHECK_EQ(
+      proto.landmark_voxel_offsets_size(),
+      proto.landmark_voxel_keys_size() + 1);
+  landmark_voxel_grid_.clear();
+  for (int i = 0; i < proto.landmark_voxel_keys_size(); ++i) {
+    std::vector<unsigned int>& landmark_indices =
+        landmark_voxel_grid_[proto.landmark_voxel_keys(i)];
+    for (unsigned int j = proto.landmark_voxel_offsets(i);
+         j < proto.landmark_voxel_offsets(i + 1); ++j) {
+      CHECK_LT(
+          proto.landmark_indices(j),
+          static_cast<unsigned int>(G_landmark_position_.cols()));
+      landmark_indices.push_back(proto.landmark_indices(j));
+    }
+  }
+
+  CHECK_EQ(
+      proto.observer_voxel_offsets_size(),
+      proto.observer_voxel_keys_size() + 1);
+  observer_voxel_grid_.clear();
+  for (int i = 0; i < proto.observer_voxel_keys_size(); ++i) {
+    std::vector<unsigned int>& observer_indices =
+        observer_voxel_grid_[proto.observer_voxel_keys(i)];
+    for (unsigned int j = proto.observer_voxel_offsets(i);
+         j < proto.observer_voxel_offsets(i + 1); ++j) {
+      CHECK_LT(
+          proto.observer_indices(j),
+          static_cast<unsigned int>(G_observer_position_.cols()));
+      observer_indices.push_back(proto.observer_indices(j));
+    }
+  }
+}
+
 const Eigen::Matrix3Xf& LocalizationSummaryMap::GLandmarkPosition() const {
   return G_landmark_position_;
 }
@@ -194,8 +385,71 @@ const Eigen::Matrix3Xf& LocalizationSummaryMap::GObserverPosition() const {
   return G_observer_position_;
 }
 const Eigen::MatrixXf& LocalizationSummaryMap::projectedDescriptors() const {
+  CHECK(projectedDescriptorQuantization() == DescriptorQuantization::kNone)
+      << "The projected descriptors are quantized, use "
+      << "getProjectedDescriptors() instead.";
   return projected_descriptors_;
 }
+
+void LocalizationSummaryMap::quantizeProjectedDescriptors(
+    const DescriptorQuantization quantization) {
+  if (quantization == projectedDescriptorQuantization()) {
+    return;
+  }
+  if (projectedDescriptorQuantization() != DescriptorQuantization::kNone) {
+    quantized_projected_descriptors_.dequantize(&projected_descriptors_);
+    quantized_projected_descriptors_.clear();
+  }
+  if (quantization != DescriptorQuantization::kNone) {
+    quantized_projected_descriptors_.quantize(
+        projected_descriptors_, quantization);
+    // Swap to actually release the memory.
+    Eigen::MatrixXf().swap(projected_descriptors_);
+  }
+}
+
+DescriptorQuantization
+LocalizationSummaryMap::projectedDescriptorQuantization() const {
+  return quantized_projected_descriptors_.quantization();
+}
+
+int LocalizationSummaryMap::numProjectedDescriptors() const {
+  return projectedDescriptorQuantization() == DescriptorQuantization::kNone
+             ? projected_descriptors_.cols()
+             : quantized_projected_descriptors_.cols();
+}
+
+int LocalizationSummaryMap::projectedDescriptorDimensionality() const {
+  return projectedDescriptorQuantization() == DescriptorQuantization::kNone
+             ? projected_descriptors_.rows()
+             : quantized_projected_descriptors_.rows();
+}
+
+size_t LocalizationSummaryMap::getProjectedDescriptorsMemoryBytes() const {
+  return sizeof(float) * projected_descriptors_.size() +
+         quantized_projected_descriptors_.getMemoryUsageBytes();
+}
+
+void LocalizationSummaryMap::getProjectedDescriptors(
+    const int first_descriptor, const int num_descriptors,
+    Eigen::MatrixXf* projected_descriptors) const {
+  CHECK_NOTNULL(projected_descriptors);
+  if (projectedDescriptorQuantization() != DescriptorQuantization::kNone) {
+    quantized_projected_descriptors_.dequantizeColumns(
+        first_descriptor, num_descriptors, projected_descriptors);
+    return;
+  }
+  CHECK_GE(first_descriptor, 0);
+  CHECK_GE(num_descriptors, 0);
+  CHECK_LE(first_descriptor + num_descriptors, projected_descriptors_.cols());
+  *projected_descriptors =
+      projected_descriptors_.middleCols(first_descriptor, num_descriptors);
+}
+
+void LocalizationSummaryMap::getProjectedDescriptors(
+    Eigen::MatrixXf* projected_descriptors) const {
+  getProjectedDescriptors(0, numProjectedDescriptors(), projected_descriptors);
+}
 const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
 LocalizationSummaryMap::observerIndices() const {
   return observer_indices_;
@@ -237,6 +491,7 @@ void LocalizationSummaryMap::setGObserverPosition(
 }
 void LocalizationSummaryMap::setProjectedDescriptors(
     const Eigen::MatrixXf& descriptors) {
+  quantized_projected_descriptors_.clear();
   projected_descriptors_ = descriptors;
 }
 void LocalizationSummaryMap::setObserverIndices(
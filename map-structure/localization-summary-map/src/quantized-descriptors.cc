@@ -0,0 +1,254 @@
+#include "localization-summary-map/quantized-descriptors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "localization-summary-map/localization-summary-map.pb.h"
+
+namespace summary_map {
+
+bool parseDescriptorQuantization(
+    const std::string& name, DescriptorQuantization* quantization) {
+  CHECK_NOTNULL(quantization);
+  if (name == "none") {
+    *quantization = DescriptorQuantization::kNone;
+  } else if (name == "int8") {
+    *quantization = DescriptorQuantization::kInt8;
+  } else if (name == "fp16") {
+    *quantization = DescriptorQuantization::kFloat16;
+  } else {
+    LOG(ERROR) << "Unknown descriptor quantization \"" << name
+               << "\", valid are none, int8 and fp16.";
+    return false;
+  }
+  return true;
+}
+
+std::string getDescriptorQuantizationName(
+    const DescriptorQuantization quantization) {
+  switch (quantization) {
+    case DescriptorQuantization::kNone:
+      return "none";
+    case DescriptorQuantization::kInt8:
+      return "int8";
+    case DescriptorQuantization::kFloat16:
+      return "fp16";
+  }
+  LOG(FATAL) << "Unknown descriptor quantization "
+             << static_cast<int>(quantization) << '.';
+  return "";
+}
+
+uint16_t floatToHalf(const float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const uint32_t magnitude = bits & 0x7fffffffu;
+
+  if (magnitude >= 0x7f800000u) {
+    // Infinity stays infinity, NaN stays a quiet NaN.
+    return sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u);
+  }
+  if (magnitude >= 0x477ff000u) {
+    // Rounds to a value above the largest half, 65504.
+    return sign | 0x7c00u;
+  }
+  if (magnitude < 0x38800000u) {
+    // Below the smallest normal half 2^-14, in units of 2^-24.
+    if (magnitude < 0x33000000u) {
+      return sign;
+    }
+    const uint32_t exponent = magnitude >> 23;
+    const uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+    const uint32_t shift = 126u - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1u);
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+      ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+  }
+
+  // Rebias the exponent from 127 to 15 and round to nearest even.
+  uint32_t half = (magnitude - 0x38000000u) >> 13;
+  const uint32_t remainder = magnitude & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+    ++half;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(const uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0u) {
+    const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign != 0u ? -magnitude : magnitude;
+  } else if (exponent == 0x1fu) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+QuantizedDescriptors::QuantizedDescriptors()
+    : quantization_(DescriptorQuantization::kNone), rows_(0), cols_(0) {}
+
+void QuantizedDescriptors::clear() {
+  quantization_ = DescriptorQuantization::kNone;
+  rows_ = 0;
+  cols_ = 0;
+  std::vector<int8_t>().swap(int8_codes_);
+  std::vector<uint16_t>().swap(float16_codes_);
+  scales_.resize(0);
+  zero_points_.resize(0);
+}
+
+void QuantizedDescriptors::quantize(
+    const Eigen::MatrixXf& descriptors,
+    const DescriptorQuantization quantization) {
+  CHECK(quantization != DescriptorQuantization::kNone);
+  clear();
+  quantization_ = quantization;
+  rows_ = descriptors.rows();
+  cols_ = descriptors.cols();
+  const size_t num_values = descriptors.size();
+
+  if (quantization_ == DescriptorQuantization::kFloat16) {
+    float16_codes_.resize(num_values);
+    const float* values = descriptors.data();
+    for (size_t i = 0u; i < num_values; ++i) {
+      float16_codes_[i] = floatToHalf(values[i]);
+    }
+    return;
+  }
+
+  CHECK(quantization_ == DescriptorQuantization::kInt8);
+  scales_.resize(rows_);
+  zero_points_.resize(rows_);
+  for (int row = 0; row < rows_; ++row) {
+    const float min_value = cols_ > 0 ? descriptors.row(row).minCoeff() : 0.f;
+    const float max_value = cols_ > 0 ? descriptors.row(row).maxCoeff() : 0.f;
+    // Constant dimensions are stored exactly with an arbitrary scale.
+    scales_(row) =
+        max_value > min_value ? (max_value - min_value) / 255.f : 1.f;
+    zero_points_(row) = -128.f - min_value / scales_(row);
+  }
+  int8_codes_.resize(num_values);
+  for (int col = 0; col < cols_; ++col) {
+    for (int row = 0; row < rows_; ++row) {
+      const float code = std::round(
+          descriptors(row, col) / scales_(row) + zero_points_(row));
+      int8_codes_[static_cast<size_t>(col) * rows_ + row] =
+          static_cast<int8_t>(std::min(std::max(code, -128.f), 127.f));
+    }
+  }
+}
+
+void QuantizedDescriptors::dequantize(Eigen::MatrixXf* descriptors) const {
+  dequantizeColumns(0, cols_, descriptors);
+}
+
+void QuantizedDescriptors::dequantizeColumns(
+    const int first_col, const int num_cols,
+    Eigen::MatrixXf* descriptors) const {
+  CHECK_NOTNULL(descriptors);
+  CHECK(quantization_ != DescriptorQuantization::kNone);
+  CHECK_GE(first_col, 0);
+  CHECK_GE(num_cols, 0);
+  CHECK_LE(first_col + num_cols, cols_);
+  descriptors->resize(rows_, num_cols);
+  const size_t offset = static_cast<size_t>(first_col) * rows_;
+  const size_t num_values = static_cast<size_t>(num_cols) * rows_;
+  float* values = descriptors->data();
+  if (quantization_ == DescriptorQuantization::kFloat16) {
+    for (size_t i = 0u; i < num_values; ++i) {
+      values[i] = halfToFloat(float16_codes_[offset + i]);
+    }
+    return;
+  }
+  for (size_t i = 0u; i < num_values; ++i) {
+    const int row = i % rows_;
+    values[i] = scales_(row) * (int8_codes_[offset + i] - zero_points_(row));
+  }
+}
+
+size_t QuantizedDescriptors::getMemoryUsageBytes() const {
+  return sizeof(int8_t) * int8_codes_.size() +
+         sizeof(uint16_t) * float16_codes_.size() +
+         sizeof(float) * (scales_.size() + zero_points_.size());
+}
+
+void QuantizedDescriptors::serialize(
+    proto::QuantizedDescriptors* proto) const {
+  CHECK_NOTNULL(proto);
+  proto->set_quantization(static_cast<int>(quantization_));
+  proto->set_rows(rows_);
+  proto->set_cols(cols_);
+  // The codes are stored as raw bytes in the byte order of the host.
+  if (quantization_ == DescriptorQuantization::kInt8) {
+    proto->set_codes(
+        reinterpret_cast<const char*>(int8_codes_.data()),
+        int8_codes_.size() * sizeof(int8_t));
+    for (int row = 0; row < rows_; ++row) {
+      proto->add_scales(scales_(row));
+      proto->add_zero_points(zero_points_(row));
+    }
+  } else {
+    proto->set_codes(
+        reinterpret_cast<const char*>(float16_codes_.data()),
+        float16_codes_.size() * sizeof(uint16_t));
+  }
+}
+
+void QuantizedDescriptors::deserialize(
+    const proto::QuantizedDescriptors& proto) {
+  clear();
+  quantization_ = static_cast<DescriptorQuantization>(proto.quantization());
+  CHECK(quantization_ != DescriptorQuantization::kNone);
+  rows_ = proto.rows();
+  cols_ = proto.cols();
+  CHECK_GE(rows_, 0);
+  CHECK_GE(cols_, 0);
+  const size_t num_values = static_cast<size_t>(rows_) * cols_;
+  const std::string& codes = proto.codes();
+  if (quantization_ == DescriptorQuantization::kInt8) {
+    CHECK_EQ(codes.size(), num_values * sizeof(int8_t));
+    CHECK_EQ(proto.scales_size(), rows_);
+    CHECK_EQ(proto.zero_points_size(), rows_);
+    int8_codes_.resize(num_values);
+    memcpy(int8_codes_.data(), codes.data(), codes.size());
+    scales_.resize(rows_);
+    zero_points_.resize(rows_);
+    for (int row = 0; row < rows_; ++row) {
+      scales_(row) = proto.scales(row);
+      zero_points_(row) = proto.zero_points(row);
+    }
+  } else {
+    CHECK(quantization_ == DescriptorQuantization::kFloat16)
+        << "Unknown descriptor quantization " << proto.quantization() << '.';
+    CHECK_EQ(codes.size(), num_values * sizeof(uint16_t));
+    float16_codes_.resize(num_values);
+    memcpy(float16_codes_.data(), codes.data(), codes.size());
+  }
+}
+
+bool QuantizedDescriptors::operator==(
+    const QuantizedDescriptors& other) const {
+  return quantization_ == other.quantization_ && rows_ == other.rows_ &&
+         cols_ == other.cols_ && int8_codes_ == other.int8_codes_ &&
+         float16_codes_ == other.float16_codes_ &&
+         scales_ == other.scales_ && zero_points_ == other.zero_points_;
+}
+
+}  // namespace summary_map
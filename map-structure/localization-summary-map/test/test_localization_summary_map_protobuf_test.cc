@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/hash-id.h>
@@ -12,8 +17,10 @@
 #include <vi-map/unique-id.h>
 #include <vi-map/vi_map.pb.h>
 
+#include "localization-summary-map/localization-summary-map-tiles.h"
 #include "localization-summary-map/localization-summary-map.h"
 #include "localization-summary-map/localization-summary-map.pb.h"
+#include "localization-summary-map/quantized-descriptors.h"
 
 namespace summary_map {
 
@@ -123,6 +130,181 @@ TEST_F(
   EXPECT_NE(*initial_summary_map_, *summary_map_from_msg_);
 }
 
+TEST_F(
+    LocalizationSummaryMapTest,
+    LocalizationSummaryMapSpatialIndexSerializeAndDeserializeTest) {
+  constructLocalizationSummaryMap();
+  constexpr double kVoxelSizeMeters = 0.3;
+  initial_summary_map_->buildSpatialIndex(kVoxelSizeMeters);
+  serializeAndDeserialize();
+  ASSERT_TRUE(summary_map_from_msg_->hasSpatialIndex());
+
+  const Eigen::Vector3d G_p(0.1, -0.2, 0.3);
+  constexpr double kRadiusMeters = 0.7;
+  std::vector<unsigned int> landmark_indices;
+  summary_map_from_msg_->getLandmarkIndicesInRadius(
+      G_p, kRadiusMeters, &landmark_indices);
+  std::sort(landmark_indices.begin(), landmark_indices.end());
+
+  const Eigen::Matrix3Xf& G_landmark_position =
+      initial_summary_map_->GLandmarkPosition();
+  std::vector<unsigned int> expected_landmark_indices;
+  for (int i = 0; i < G_landmark_position.cols(); ++i) {
+    if ((G_landmark_position.col(i).cast<double>() - G_p).norm() <=
+        kRadiusMeters) {
+      expected_landmark_indices.push_back(i);
+    }
+  }
+  EXPECT_FALSE(expected_landmark_indices.empty());
+  EXPECT_EQ(expected_landmark_indices, landmark_indices);
+
+  std::vector<unsigned int> observer_indices;
+  summary_map_from_msg_->getObserverIndicesInRadius(
+      G_p, kRadiusMeters, &observer_indices);
+  const Eigen::Matrix3Xf& G_observer_position =
+      initial_summary_map_->GObserverPosition();
+  for (const unsigned int observer_index : observer_indices) {
+    EXPECT_LE(
+        (G_observer_position.col(observer_index).cast<double>() - G_p).norm(),
+        kRadiusMeters);
+  }
+}
+
+TEST_F(LocalizationSummaryMapTest, LocalizationSummaryMapSplitIntoTilesTest) {
+  constructLocalizationSummaryMap();
+
+  constexpr double kTileSizeMeters = 0.5;
+  std::vector<std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>>
+      tiles;
+  splitLocalizationSummaryMapIntoTiles(
+      *initial_summary_map_, kTileSizeMeters, &tiles);
+  ASSERT_GT(tiles.size(), 1u);
+
+  int num_landmarks = 0;
+  int num_observations = 0;
+  for (const std::pair<Eigen::Vector2i, LocalizationSummaryMap::UniquePtr>&
+           tile : tiles) {
+    const LocalizationSummaryMap& tile_map = *tile.second;
+    EXPECT_TRUE(tile_map.hasSpatialIndex());
+    num_landmarks += tile_map.GLandmarkPosition().cols();
+    num_observations += tile_map.projectedDescriptors().cols();
+    EXPECT_EQ(
+        tile_map.observerIndices().rows(),
+        tile_map.observationToLandmarkIndex().rows());
+
+    const Eigen::Array2d tile_min =
+        tile.first.cast<double>().array() * kTileSizeMeters;
+    for (int i = 0; i < tile_map.GLandmarkPosition().cols(); ++i) {
+      const Eigen::Array2d G_p_xy =
+          tile_map.GLandmarkPosition().col(i).head<2>().cast<double>().array();
+      EXPECT_TRUE((G_p_xy >= tile_min).all());
+      EXPECT_TRUE((G_p_xy < tile_min + kTileSizeMeters).all());
+    }
+    for (int i = 0; i < tile_map.observerIndices().rows(); ++i) {
+      EXPECT_LT(
+          tile_map.observerIndices()(i),
+          static_cast<unsigned int>(tile_map.GObserverPosition().cols()));
+    }
+  }
+  EXPECT_EQ(initial_summary_map_->GLandmarkPosition().cols(), num_landmarks);
+  EXPECT_EQ(
+      initial_summary_map_->projectedDescriptors().cols(), num_observations);
+}
+
+TEST(QuantizedDescriptorsTest, HalfPrecisionConversion) {
+  EXPECT_EQ(0x0000u, floatToHalf(0.f));
+  EXPECT_EQ(0x3c00u, floatToHalf(1.f));
+  EXPECT_EQ(0xc000u, floatToHalf(-2.f));
+  EXPECT_EQ(0x7bffu, floatToHalf(65504.f));
+  EXPECT_EQ(0x7c00u, floatToHalf(1e6f));
+  EXPECT_EQ(0x0001u, floatToHalf(std::ldexp(1.f, -24)));
+  for (const float value : {0.f, 1.f, -2.f, 0.5f, 65504.f}) {
+    EXPECT_EQ(value, halfToFloat(floatToHalf(value)));
+  }
+  EXPECT_NEAR(0.1f, halfToFloat(floatToHalf(0.1f)), 1e-4);
+}
+
+TEST_F(
+    LocalizationSummaryMapTest,
+    LocalizationSummaryMapQuantizedSerializeAndDeserializeTest) {
+  for (const DescriptorQuantization quantization :
+       {DescriptorQuantization::kInt8, DescriptorQuantization::kFloat16}) {
+    constructLocalizationSummaryMap();
+    const Eigen::MatrixXf descriptors =
+        initial_summary_map_->projectedDescriptors();
+    initial_summary_map_->quantizeProjectedDescriptors(quantization);
+    EXPECT_TRUE(
+        quantization ==
+        initial_summary_map_->projectedDescriptorQuantization());
+    EXPECT_LT(
+        initial_summary_map_->getProjectedDescriptorsMemoryBytes(),
+        descriptors.size() * sizeof(float) / 1.9);
+    serializeAndDeserialize();
+    EXPECT_EQ(*initial_summary_map_, *summary_map_from_msg_);
+
+    // The range of the random descriptors is [-1, 1], i.e. the int8 step is
+    // 2 / 255.
+    Eigen::MatrixXf dequantized_descriptors;
+    summary_map_from_msg_->getProjectedDescriptors(&dequantized_descriptors);
+    EXPECT_NEAR_EIGEN(descriptors, dequantized_descriptors, 1.1 / 255.0);
+    for (int i = 0; i < descriptors.cols(); ++i) {
+      EXPECT_NEAR(
+          (descriptors.col(i) - dequantized_descriptors.col(0)).squaredNorm(),
+          summary_map_from_msg_->getSquaredDistanceToProjectedDescriptor(
+              i, dequantized_descriptors.col(0)),
+          1e-1);
+    }
+
+    summary_map_from_msg_->quantizeProjectedDescriptors(
+        DescriptorQuantization::kNone);
+    EXPECT_NEAR_EIGEN(
+        dequantized_descriptors, summary_map_from_msg_->projectedDescriptors(),
+        1e-10);
+  }
+}
+
+TEST(QuantizedDescriptorsTest, NearestNeighborRecall) {
+  constexpr int kNumDimensions = 10;
+  constexpr int kNumDescriptors = 1000;
+  constexpr int kNumQueries = 200;
+  Eigen::MatrixXf descriptors;
+  descriptors.setRandom(kNumDimensions, kNumDescriptors);
+  Eigen::MatrixXf queries = descriptors.leftCols(kNumQueries);
+  queries += 0.05 * Eigen::MatrixXf::Random(kNumDimensions, kNumQueries);
+
+  for (const DescriptorQuantization quantization :
+       {DescriptorQuantization::kInt8, DescriptorQuantization::kFloat16}) {
+    QuantizedDescriptors quantized_descriptors;
+    quantized_descriptors.quantize(descriptors, quantization);
+    int num_same_neighbors = 0;
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      int nearest_neighbor = -1;
+      int quantized_nearest_neighbor = -1;
+      float min_distance = std::numeric_limits<float>::max();
+      float min_quantized_distance = std::numeric_limits<float>::max();
+      for (int i = 0; i < kNumDescriptors; ++i) {
+        const float distance =
+            (descriptors.col(i) - queries.col(query_idx)).squaredNorm();
+        if (distance < min_distance) {
+          min_distance = distance;
+          nearest_neighbor = i;
+        }
+        const float quantized_distance =
+            quantized_descriptors.squaredDistance(i, queries.col(query_idx));
+        if (quantized_distance < min_quantized_distance) {
+          min_quantized_distance = quantized_distance;
+          quantized_nearest_neighbor = i;
+        }
+      }
+      if (nearest_neighbor == quantized_nearest_neighbor) {
+        ++num_same_neighbors;
+      }
+    }
+    EXPECT_GE(num_same_neighbors, 0.95 * kNumQueries)
+        << getDescriptorQuantizationName(quantization);
+  }
+}
+
 }  // namespace summary_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,81 @@
+#ifndef POSEGRAPH_OBJECT_POOL_INL_H_
+#define POSEGRAPH_OBJECT_POOL_INL_H_
+
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace pose_graph {
+
+template <typename Type, size_t kChunkSize>
+AlignedObjectPool<Type, kChunkSize>::~AlignedObjectPool() {
+  for (Chunk& chunk : chunks_) {
+    for (size_t slot_idx = 0u; slot_idx < kChunkSize; ++slot_idx) {
+      if (chunk.is_used[slot_idx]) {
+        chunk.slots[slot_idx].~Type();
+      }
+    }
+    allocator_.deallocate(chunk.slots, kChunkSize);
+  }
+}
+
+template <typename Type, size_t kChunkSize>
+template <typename... Args>
+Type* AlignedObjectPool<Type, kChunkSize>::construct(Args&&... args) {
+  static_assert(kChunkSize > 0u, "Chunks need at least one slot.");
+  if (free_slots_.empty()) {
+    Chunk chunk;
+    chunk.slots = allocator_.allocate(kChunkSize);
+    chunk.is_used.resize(kChunkSize, false);
+    chunk_indices_.emplace(chunk.slots, chunks_.size());
+    chunks_.emplace_back(std::move(chunk));
+    // Reversed, such that the slots are handed out in the order of their
+    // addresses.
+    free_slots_.reserve(kChunkSize);
+    for (size_t slot_idx = kChunkSize; slot_idx > 0u; --slot_idx) {
+      free_slots_.emplace_back(chunks_.back().slots + slot_idx - 1u);
+    }
+  }
+  Type* slot = free_slots_.back();
+  free_slots_.pop_back();
+  Chunk& chunk = chunks_[getChunkIndex(slot)];
+  chunk.is_used[slot - chunk.slots] = true;
+  ++num_objects_;
+  return ::new (static_cast<void*>(slot)) Type(std::forward<Args>(args)...);
+}
+
+template <typename Type, size_t kChunkSize>
+void AlignedObjectPool<Type, kChunkSize>::destroy(Type* object) {
+  CHECK_NOTNULL(object)->~Type();
+  deallocate(object);
+}
+
+template <typename Type, size_t kChunkSize>
+void AlignedObjectPool<Type, kChunkSize>::deallocate(void* slot) {
+  Type* typed_slot = static_cast<Type*>(CHECK_NOTNULL(slot));
+  Chunk& chunk = chunks_[getChunkIndex(typed_slot)];
+  const size_t slot_idx = typed_slot - chunk.slots;
+  CHECK(chunk.is_used[slot_idx]) << "The slot is not in use.";
+  chunk.is_used[slot_idx] = false;
+  free_slots_.emplace_back(typed_slot);
+  CHECK_GT(num_objects_, 0u);
+  --num_objects_;
+}
+
+template <typename Type, size_t kChunkSize>
+size_t AlignedObjectPool<Type, kChunkSize>::getChunkIndex(
+    const Type* slot) const {
+  typename std::map<const Type*, size_t>::const_iterator it =
+      chunk_indices_.upper_bound(slot);
+  CHECK(it != chunk_indices_.begin()) << "The slot is not part of the pool.";
+  --it;
+  CHECK_LT(slot, it->first + kChunkSize) << "The slot is not part of the pool.";
+  return it->second;
+}
+
+}  // namespace pose_graph
+
+#endif  // POSEGRAPH_OBJECT_POOL_INL_H_
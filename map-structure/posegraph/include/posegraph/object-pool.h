@@ -0,0 +1,150 @@
+#ifndef POSEGRAPH_OBJECT_POOL_H_
+#define POSEGRAPH_OBJECT_POOL_H_
+
+#include <map>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace pose_graph {
+
+// Type-erased interface of the object pools, such that a graph can own the
+// pools of the vertex and edge types of its derived classes.
+class ObjectPoolBase {
+ public:
+  virtual ~ObjectPoolBase() {}
+
+  // Releases the slot of an object whose destructor was called already.
+  virtual void deallocate(void* slot) = 0;
+
+  virtual size_t size() const = 0;
+};
+
+// Constructs objects in aligned chunks of kChunkSize slots, such that objects
+// constructed in a row are next to each other in memory and destroying the
+// pool frees a few chunks instead of every single object. The slots of
+// destroyed objects are reused. Not thread-safe.
+template <typename Type, size_t kChunkSize = 256u>
+class AlignedObjectPool : public ObjectPoolBase {
+ public:
+  AlignedObjectPool() = default;
+  ~AlignedObjectPool();
+
+  template <typename... Args>
+  Type* construct(Args&&... args);
+
+  void destroy(Type* object);
+
+  void deallocate(void* slot) override;
+
+  size_t size() const override {
+    return num_objects_;
+  }
+  size_t numChunks() const {
+    return chunks_.size();
+  }
+
+ private:
+  struct Chunk {
+    Type* slots;
+    std::vector<bool> is_used;
+  };
+
+  size_t getChunkIndex(const Type* slot) const;
+
+  std::vector<Chunk> chunks_;
+  // Chunk indices by the address of their first slot.
+  std::map<const Type*, size_t> chunk_indices_;
+  std::vector<Type*> free_slots_;
+  size_t num_objects_ = 0u;
+  Eigen::aligned_allocator<Type> allocator_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(AlignedObjectPool);
+};
+
+// Unique ownership of a vertex or an edge, which is either allocated on its
+// own or lives in an object pool. The pool has to outlive the pointer.
+template <typename Type>
+class ObjectPtr {
+ public:
+  ObjectPtr() = default;
+  explicit ObjectPtr(AlignedUniquePtr<Type> object)
+      : object_(object.release()) {}
+  // The slot is the address of the object as it was constructed in the pool,
+  // which may differ from the address of its base class.
+  ObjectPtr(Type* object, void* slot, ObjectPoolBase* pool)
+      : object_(CHECK_NOTNULL(object)),
+        slot_(CHECK_NOTNULL(slot)),
+        pool_(CHECK_NOTNULL(pool)) {}
+
+  ObjectPtr(ObjectPtr&& other) {
+    *this = std::move(other);
+  }
+  ObjectPtr& operator=(ObjectPtr&& other) {
+    if (this != &other) {
+      reset();
+      object_ = other.object_;
+      slot_ = other.slot_;
+      pool_ = other.pool_;
+      other.object_ = nullptr;
+      other.slot_ = nullptr;
+      other.pool_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~ObjectPtr() {
+    reset();
+  }
+
+  void reset() {
+    if (object_ == nullptr) {
+      return;
+    }
+    if (pool_ == nullptr) {
+      AlignedUniquePtr<Type> object_to_delete(object_);
+    } else {
+      object_->~Type();
+      pool_->deallocate(slot_);
+    }
+    object_ = nullptr;
+    slot_ = nullptr;
+    pool_ = nullptr;
+  }
+
+  Type* get() const {
+    return object_;
+  }
+  Type& operator*() const {
+    return *CHECK_NOTNULL(object_);
+  }
+  Type* operator->() const {
+    return CHECK_NOTNULL(object_);
+  }
+  explicit operator bool() const {
+    return object_ != nullptr;
+  }
+
+  bool isPooled() const {
+    return pool_ != nullptr;
+  }
+
+ private:
+  Type* object_ = nullptr;
+  void* slot_ = nullptr;
+  ObjectPoolBase* pool_ = nullptr;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ObjectPtr);
+};
+
+}  // namespace pose_graph
+
+#include "posegraph/object-pool-inl.h"
+
+#endif  // POSEGRAPH_OBJECT_POOL_H_
@@ -1,10 +1,48 @@
 #ifndef POSEGRAPH_POSE_GRAPH_INL_H_
 #define POSEGRAPH_POSE_GRAPH_INL_H_
 
+#include <type_traits>
+#include <typeindex>
+#include <utility>
+
 #include "posegraph/pose-graph.h"
 
 namespace pose_graph {
 
+template <typename VertexType, typename... Args>
+VertexType* PoseGraph::emplaceVertex(const size_t arena, Args&&... args) {
+  static_assert(
+      std::is_base_of<Vertex, VertexType>::value,
+      "Only vertices can be emplaced as vertices.");
+  AlignedObjectPool<VertexType>* pool = getObjectPool<VertexType>(arena);
+  VertexType* vertex = pool->construct(std::forward<Args>(args)...);
+  insertVertex(ObjectPtr<Vertex>(vertex, vertex, pool));
+  return vertex;
+}
+
+template <typename EdgeType, typename... Args>
+EdgeType* PoseGraph::emplaceEdge(const size_t arena, Args&&... args) {
+  static_assert(
+      std::is_base_of<Edge, EdgeType>::value,
+      "Only edges can be emplaced as edges.");
+  AlignedObjectPool<EdgeType>* pool = getObjectPool<EdgeType>(arena);
+  EdgeType* edge = pool->construct(std::forward<Args>(args)...);
+  insertEdge(ObjectPtr<Edge>(edge, edge, pool));
+  return edge;
+}
+
+template <typename Type>
+AlignedObjectPool<Type>* PoseGraph::getObjectPool(const size_t arena) {
+  const ObjectPoolKey key(arena, std::type_index(typeid(Type)));
+  std::map<ObjectPoolKey, ObjectPoolBase*>::const_iterator it =
+      object_pool_lookup_.find(key);
+  if (it == object_pool_lookup_.end()) {
+    object_pools_.emplace_back(new AlignedObjectPool<Type>());
+    it = object_pool_lookup_.emplace(key, object_pools_.back().get()).first;
+  }
+  return static_cast<AlignedObjectPool<Type>*>(it->second);
+}
+
 template <pose_graph::Edge::EdgeType edge_type>
 size_t PoseGraph::removeEdgesOfType() {
   static_assert(
@@ -28,6 +66,10 @@ size_t PoseGraph::removeEdgesOfType() {
 void PoseGraph::clear() {
   vertices_.clear();
   edges_.clear();
+  object_pool_lookup_.clear();
+  object_pools_.clear();
+  vertex_dense_indices_.clear();
+  updateTopologyRevision();
 }
 
 }  // namespace pose_graph
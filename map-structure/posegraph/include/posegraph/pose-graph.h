@@ -1,22 +1,39 @@
 #ifndef POSEGRAPH_POSE_GRAPH_H_
 #define POSEGRAPH_POSE_GRAPH_H_
 
+#include <cstdint>
+#include <map>
 #include <memory>
-#include <unordered_map>
+#include <typeindex>
+#include <utility>
 #include <vector>
 
+#include <maplab-common/dense-id-index.h>
+#include <maplab-common/flat-hash-map.h>
+
 #include "posegraph/edge.h"
+#include "posegraph/object-pool.h"
 #include "posegraph/unique-id.h"
 #include "posegraph/vertex.h"
 
 namespace pose_graph {
 
 class PoseGraph {
+ private:
+  // Declared before the vertices and edges, such that the pools outlive them.
+  std::vector<std::unique_ptr<ObjectPoolBase>> object_pools_;
+  // Pools that new objects are constructed in, by arena and type. Pools moved
+  // over from other graphs are owned but not reused.
+  typedef std::pair<size_t, std::type_index> ObjectPoolKey;
+  std::map<ObjectPoolKey, ObjectPoolBase*> object_pool_lookup_;
+
  protected:
   // Accessible by derived classes for more flexible extension.
-  typedef std::unordered_map<VertexId, AlignedUniquePtr<Vertex>> VertexMap;
+  // Adding a vertex or an edge may move the elements of its map, the vertices
+  // and edges themselves stay in place.
+  typedef common::FlatHashMap<VertexId, ObjectPtr<Vertex>> VertexMap;
   VertexMap vertices_;
-  typedef std::unordered_map<EdgeId, AlignedUniquePtr<Edge>> EdgeMap;
+  typedef common::FlatHashMap<EdgeId, ObjectPtr<Edge>> EdgeMap;
   EdgeMap edges_;
 
  public:
@@ -34,6 +51,33 @@ class PoseGraph {
 
   void addEdge(AlignedUniquePtr<Edge> edge);
 
+  // Construct the vertex or edge in a pool of the graph instead of allocating
+  // it on its own, which keeps the objects of an arena, e.g. of a mission,
+  // close to each other in memory and makes clearing the graph cheap.
+  template <typename VertexType, typename... Args>
+  VertexType* emplaceVertex(size_t arena, Args&&... args);
+  template <typename EdgeType, typename... Args>
+  EdgeType* emplaceEdge(size_t arena, Args&&... args);
+
+  // Frees the pools without any objects left, e.g. after removing a mission.
+  void releaseEmptyObjectPools();
+
+  // Avoids rehashing while many vertices are added, e.g. when loading a map.
+  void reserveVertices(size_t num_vertices);
+  void reserveEdges(size_t num_edges);
+
+  // Adds vertices and edges that already reference each other, e.g. copies of
+  // all vertices and edges of another graph. Unlike addEdge(), this doesn't
+  // touch the vertices of the edges. Clears the given lists.
+  void addSubgraph(
+      std::vector<AlignedUniquePtr<Vertex>>* vertices,
+      std::vector<AlignedUniquePtr<Edge>>* edges);
+
+  // Moves all vertices and edges of the other graph into this graph without
+  // copying them, along with the pools they live in. The other graph is empty
+  // afterwards.
+  void moveAllFrom(PoseGraph* other);
+
   /****************************************
    * Const ops
    ****************************************/
@@ -88,7 +132,40 @@ class PoseGraph {
     return edges_.size();
   }
 
+  // Dense integer index of each vertex, which doesn't change as long as the
+  // vertex is part of the graph. Data per vertex can be kept in flat arrays
+  // of size numVertexDenseIndices(); see common::DenseIdIndex.
+  size_t getVertexDenseIndex(const VertexId& id) const {
+    return vertex_dense_indices_.getIndex(id);
+  }
+  // Returns an invalid id if no vertex has the index.
+  const VertexId& getVertexIdFromDenseIndex(size_t index) const {
+    return vertex_dense_indices_.getId(index);
+  }
+  size_t numVertexDenseIndices() const {
+    return vertex_dense_indices_.getNumIndices();
+  }
+
+  // Changes whenever vertices or edges are added or removed. Revisions are
+  // unique across all graphs, such that data derived from the topology, e.g.
+  // the vertex order of a mission, can be cached along with the revision.
+  uint64_t getTopologyRevision() const {
+    return topology_revision_;
+  }
+
   inline void clear();
+
+ private:
+  void insertVertex(ObjectPtr<Vertex> vertex);
+  void insertEdge(ObjectPtr<Edge> edge);
+
+  template <typename Type>
+  AlignedObjectPool<Type>* getObjectPool(size_t arena);
+
+  void updateTopologyRevision();
+
+  common::DenseIdIndex<VertexId> vertex_dense_indices_;
+  uint64_t topology_revision_ = 0u;
 };
 
 }  // namespace pose_graph
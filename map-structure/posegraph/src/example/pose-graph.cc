@@ -12,15 +12,14 @@ void PoseGraph::addEdge(
 }
 
 void PoseGraph::addVertex(const VertexId& id) {
-  Vertex* vertex_ptr(new Vertex(id));
-  CHECK(vertices_.emplace(id, Vertex::UniquePtr(vertex_ptr)).second)
-      << "Vertex with ID " << id.hexString() << " already exists.";
+  addVertex(Vertex::UniquePtr(new Vertex(id)));
 }
 
 void PoseGraph::addVertex(Vertex::UniquePtr vertex) {
   CHECK(vertex != nullptr);
-  CHECK(vertices_.emplace(vertex->id(), std::move(vertex)).second)
+  CHECK(!vertexExists(vertex->id()))
       << "Vertex with ID " << vertex->id().hexString() << " already exists.";
+  ::pose_graph::PoseGraph::addVertex(std::move(vertex));
 }
 
 }  // namespace example
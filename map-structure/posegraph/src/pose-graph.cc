@@ -1,6 +1,11 @@
 #include "posegraph/pose-graph.h"
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 
 #include <aslam/common/memory.h>
 #include <glog/logging.h>
@@ -11,22 +16,129 @@
 
 namespace pose_graph {
 
+namespace {
+std::atomic<uint64_t> next_topology_revision(1u);
+}  // namespace
+
+void PoseGraph::updateTopologyRevision() {
+  topology_revision_ = next_topology_revision++;
+}
+
 void PoseGraph::swap(PoseGraph* other) {
   CHECK_NOTNULL(other);
   vertices_.swap(other->vertices_);
   edges_.swap(other->edges_);
+  object_pools_.swap(other->object_pools_);
+  object_pool_lookup_.swap(other->object_pool_lookup_);
+  vertex_dense_indices_.swap(&other->vertex_dense_indices_);
+  updateTopologyRevision();
+  other->updateTopologyRevision();
 }
 
 void PoseGraph::addVertex(Vertex::UniquePtr vertex) {
   CHECK(vertex != nullptr);
+  insertVertex(ObjectPtr<Vertex>(std::move(vertex)));
+}
+
+void PoseGraph::insertVertex(ObjectPtr<Vertex> vertex) {
+  CHECK(vertex);
   const VertexId& vertex_id = vertex->id();
+  vertex_dense_indices_.add(vertex_id);
   CHECK(vertices_.emplace(vertex_id, std::move(vertex)).second)
       << "Vertex already exists.";
+  updateTopologyRevision();
+}
+
+void PoseGraph::reserveVertices(size_t num_vertices) {
+  vertices_.reserve(num_vertices);
+  vertex_dense_indices_.reserve(num_vertices);
+}
+
+void PoseGraph::reserveEdges(size_t num_edges) {
+  edges_.reserve(num_edges);
+}
+
+void PoseGraph::addSubgraph(
+    std::vector<Vertex::UniquePtr>* vertices,
+    std::vector<Edge::UniquePtr>* edges) {
+  CHECK_NOTNULL(vertices);
+  CHECK_NOTNULL(edges);
+  reserveVertices(vertices_.size() + vertices->size());
+  reserveEdges(edges_.size() + edges->size());
+  for (Vertex::UniquePtr& vertex : *vertices) {
+    addVertex(std::move(vertex));
+  }
+  for (Edge::UniquePtr& edge : *edges) {
+    CHECK(edge != nullptr);
+    const EdgeId edge_id = edge->id();
+    DCHECK(vertexExists(edge->from()));
+    DCHECK(vertexExists(edge->to()));
+    CHECK(edges_.emplace(edge_id, ObjectPtr<Edge>(std::move(edge))).second)
+        << "Edge already exists.";
+  }
+  vertices->clear();
+  edges->clear();
+  updateTopologyRevision();
+}
+
+void PoseGraph::moveAllFrom(PoseGraph* other) {
+  CHECK_NOTNULL(other);
+  CHECK_NE(other, this);
+  // The pools are moved first, such that they outlive their objects if any of
+  // the checks below fails.
+  object_pools_.reserve(object_pools_.size() + other->object_pools_.size());
+  for (std::unique_ptr<ObjectPoolBase>& object_pool : other->object_pools_) {
+    object_pools_.emplace_back(std::move(object_pool));
+  }
+  other->object_pools_.clear();
+  other->object_pool_lookup_.clear();
+
+  reserveVertices(vertices_.size() + other->vertices_.size());
+  reserveEdges(edges_.size() + other->edges_.size());
+  for (VertexMap::value_type& vertex_id_pair : other->vertices_) {
+    const VertexId& vertex_id = vertex_id_pair.first;
+    vertex_dense_indices_.add(vertex_id);
+    const bool inserted =
+        vertices_.emplace(vertex_id, std::move(vertex_id_pair.second)).second;
+    CHECK(inserted) << "Vertex already exists.";
+  }
+  for (EdgeMap::value_type& edge_id_pair : other->edges_) {
+    const bool inserted =
+        edges_.emplace(edge_id_pair.first, std::move(edge_id_pair.second))
+            .second;
+    CHECK(inserted) << "Edge already exists.";
+  }
+  other->clear();
+  updateTopologyRevision();
+}
+
+void PoseGraph::releaseEmptyObjectPools() {
+  std::map<ObjectPoolKey, ObjectPoolBase*>::iterator it =
+      object_pool_lookup_.begin();
+  while (it != object_pool_lookup_.end()) {
+    if (it->second->size() == 0u) {
+      it = object_pool_lookup_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  object_pools_.erase(
+      std::remove_if(
+          object_pools_.begin(), object_pools_.end(),
+          [](const std::unique_ptr<ObjectPoolBase>& object_pool) {
+            return object_pool->size() == 0u;
+          }),
+      object_pools_.end());
 }
 
 void PoseGraph::addEdge(Edge::UniquePtr edge) {
-  // Insert new edge and do necessary book-keeping in vertices.
   CHECK(edge != nullptr);
+  insertEdge(ObjectPtr<Edge>(std::move(edge)));
+}
+
+void PoseGraph::insertEdge(ObjectPtr<Edge> edge) {
+  // Insert new edge and do necessary book-keeping in vertices.
+  CHECK(edge);
   const Edge* const edge_raw = edge.get();
   CHECK(edges_.emplace(edge_raw->id(), std::move(edge)).second)
       << "Edge already exists.";
@@ -35,6 +147,7 @@ void PoseGraph::addEdge(Edge::UniquePtr edge) {
   CHECK(
       vertex_from.addOutgoingEdge(edge_raw->id()) &&
       vertex_to.addIncomingEdge(edge_raw->id()));
+  updateTopologyRevision();
 }
 
 const Vertex& PoseGraph::getVertex(const VertexId& id) const {
@@ -121,6 +234,7 @@ typename PoseGraph::EdgeMap::iterator PoseGraph::removeEdge(
                                        << " does not exist.";
   getVertexPtrMutable(edge_iterator->second->from())->removeOutgoingEdge(id);
   getVertexPtrMutable(edge_iterator->second->to())->removeIncomingEdge(id);
+  updateTopologyRevision();
   return edges_.erase(edge_iterator);
 }
 
@@ -131,7 +245,9 @@ void PoseGraph::removeVertex(const pose_graph::VertexId& id) {
       << "Vertex can't be linked with edges if you want to remove it.";
   CHECK(!it->second->hasOutgoingEdges())
       << "Vertex can't be linked with edges if you want to remove it.";
+  vertex_dense_indices_.remove(id);
   vertices_.erase(it);
+  updateTopologyRevision();
 }
 
 }  // namespace pose_graph
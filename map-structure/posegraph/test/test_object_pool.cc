@@ -0,0 +1,106 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <gtest/gtest.h>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <posegraph/object-pool.h>
+
+namespace pose_graph {
+
+namespace {
+class Base {
+ public:
+  virtual ~Base() {}
+};
+
+class Derived : public Base {
+ public:
+  Derived(const int value, int* num_alive)
+      : value_(value), num_alive_(CHECK_NOTNULL(num_alive)) {
+    ++*num_alive_;
+  }
+  virtual ~Derived() {
+    --*num_alive_;
+  }
+
+  int value() const {
+    return value_;
+  }
+  const Eigen::Vector4d& vector() const {
+    return vector_;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  Eigen::Vector4d vector_ = Eigen::Vector4d::Ones();
+  int value_;
+  int* num_alive_;
+};
+
+constexpr size_t kChunkSize = 4u;
+typedef AlignedObjectPool<Derived, kChunkSize> DerivedPool;
+}  // namespace
+
+TEST(ObjectPoolTest, ConstructAndDestroy) {
+  int num_alive = 0;
+  {
+    DerivedPool pool;
+    std::vector<Derived*> objects;
+    for (int value = 0; value < 10; ++value) {
+      objects.emplace_back(pool.construct(value, &num_alive));
+    }
+    EXPECT_EQ(num_alive, 10);
+    EXPECT_EQ(pool.size(), 10u);
+    EXPECT_EQ(pool.numChunks(), 3u);
+    for (int value = 0; value < 10; ++value) {
+      EXPECT_EQ(objects[value]->value(), value);
+      EXPECT_EQ(
+          reinterpret_cast<uintptr_t>(&objects[value]->vector()) % 16u, 0u);
+    }
+    // Consecutive objects are next to each other within a chunk.
+    EXPECT_EQ(objects[1], objects[0] + 1);
+
+    pool.destroy(objects[5]);
+    EXPECT_EQ(num_alive, 9);
+    EXPECT_EQ(pool.size(), 9u);
+    // The slot is reused.
+    EXPECT_EQ(pool.construct(10, &num_alive), objects[5]);
+    EXPECT_EQ(pool.numChunks(), 3u);
+  }
+  // The pool destroys the remaining objects.
+  EXPECT_EQ(num_alive, 0);
+}
+
+TEST(ObjectPoolTest, ObjectPtr) {
+  int num_alive = 0;
+  DerivedPool pool;
+  {
+    Derived* derived = pool.construct(1, &num_alive);
+    ObjectPtr<Base> pooled(derived, derived, &pool);
+    EXPECT_TRUE(pooled.isPooled());
+    EXPECT_EQ(pooled.get(), derived);
+
+    ObjectPtr<Base> allocated(
+        AlignedUniquePtr<Base>(aligned_unique<Derived>(2, &num_alive)));
+    EXPECT_TRUE(static_cast<bool>(allocated));
+    EXPECT_FALSE(allocated.isPooled());
+    EXPECT_EQ(num_alive, 2);
+
+    ObjectPtr<Base> moved(std::move(pooled));
+    EXPECT_FALSE(static_cast<bool>(pooled));
+    EXPECT_EQ(moved.get(), derived);
+    EXPECT_EQ(pool.size(), 1u);
+
+    moved = std::move(allocated);
+    EXPECT_EQ(num_alive, 1);
+    EXPECT_EQ(pool.size(), 0u);
+  }
+  EXPECT_EQ(num_alive, 0);
+}
+
+}  // namespace pose_graph
+
+MAPLAB_UNITTEST_ENTRYPOINT
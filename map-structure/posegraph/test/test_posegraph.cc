@@ -51,6 +51,42 @@ TEST(AslamPosegraph, DataStructureSizes) {
   EXPECT_EQ(2u, vertex_ids.size());
 }
 
+TEST(AslamPosegraph, DenseVertexIndices) {
+  PoseGraph pose_graph;
+  EXPECT_EQ(pose_graph.numVertexDenseIndices(), 0u);
+
+  VertexIdList vertex_ids(3);
+  for (VertexId& vertex_id : vertex_ids) {
+    common::generateId(&vertex_id);
+    pose_graph.addVertex(vertex_id);
+  }
+  ASSERT_EQ(pose_graph.numVertexDenseIndices(), 3u);
+  for (size_t i = 0u; i < vertex_ids.size(); ++i) {
+    EXPECT_EQ(pose_graph.getVertexDenseIndex(vertex_ids[i]), i);
+    EXPECT_EQ(pose_graph.getVertexIdFromDenseIndex(i), vertex_ids[i]);
+  }
+
+  // The other vertices keep their index, the index of the removed vertex is
+  // unused until the next vertex is added.
+  pose_graph.removeVertex(vertex_ids[1]);
+  EXPECT_EQ(pose_graph.numVertexDenseIndices(), 3u);
+  EXPECT_FALSE(pose_graph.getVertexIdFromDenseIndex(1u).isValid());
+  EXPECT_EQ(pose_graph.getVertexDenseIndex(vertex_ids[2]), 2u);
+
+  VertexId new_vertex_id;
+  common::generateId(&new_vertex_id);
+  pose_graph.addVertex(new_vertex_id);
+  EXPECT_EQ(pose_graph.numVertexDenseIndices(), 3u);
+  EXPECT_EQ(pose_graph.getVertexDenseIndex(new_vertex_id), 1u);
+
+  PoseGraph other_pose_graph;
+  other_pose_graph.swap(&pose_graph);
+  EXPECT_EQ(pose_graph.numVertexDenseIndices(), 0u);
+  EXPECT_EQ(other_pose_graph.getVertexDenseIndex(vertex_ids[0]), 0u);
+  other_pose_graph.clear();
+  EXPECT_EQ(other_pose_graph.numVertexDenseIndices(), 0u);
+}
+
 TEST(AslamPosegraph, StaticOperators) {
   PoseGraph pose_graph;
 
@@ -188,6 +224,46 @@ TEST(AslamPosegraph, ElementPointers) {
   EXPECT_EQ(edge1_ptr, &pose_graph.getEdge(edge1));
 }
 
+TEST(AslamPosegraph, PooledElements) {
+  constexpr size_t kArena = 1u;
+  constexpr size_t kOtherArena = 2u;
+  PoseGraph pose_graph;
+  VertexIdList vertex_ids(3);
+  for (VertexId& vertex_id : vertex_ids) {
+    common::generateId(&vertex_id);
+  }
+  const Vertex* vertex0 =
+      pose_graph.emplaceVertex<Vertex>(kArena, vertex_ids[0]);
+  pose_graph.emplaceVertex<Vertex>(kArena, vertex_ids[1]);
+  pose_graph.emplaceVertex<Vertex>(kOtherArena, vertex_ids[2]);
+  EXPECT_EQ(vertex0, pose_graph.getVertexPtr(vertex_ids[0]));
+  EXPECT_EQ(pose_graph.numVertices(), 3u);
+
+  EdgeId edge_id;
+  common::generateId(&edge_id);
+  pose_graph.emplaceEdge<Edge>(kArena, vertex_ids[0], vertex_ids[1], edge_id);
+  EXPECT_TRUE(pose_graph.edgeExists(vertex_ids[0], vertex_ids[1]));
+
+  // Pooled elements are removed like any other.
+  pose_graph.removeEdge(edge_id);
+  pose_graph.removeVertex(vertex_ids[2]);
+  pose_graph.releaseEmptyObjectPools();
+  EXPECT_EQ(pose_graph.numVertices(), 2u);
+  EXPECT_EQ(pose_graph.numEdges(), 0u);
+
+  // The pools move along with their elements.
+  PoseGraph other_pose_graph;
+  other_pose_graph.moveAllFrom(&pose_graph);
+  EXPECT_EQ(pose_graph.numVertices(), 0u);
+  EXPECT_EQ(other_pose_graph.numVertices(), 2u);
+  EXPECT_EQ(vertex0, other_pose_graph.getVertexPtr(vertex_ids[0]));
+  other_pose_graph.emplaceVertex<Vertex>(kArena, vertex_ids[2]);
+  EXPECT_EQ(other_pose_graph.numVertices(), 3u);
+
+  other_pose_graph.clear();
+  EXPECT_EQ(other_pose_graph.numVertices(), 0u);
+}
+
 }  // namespace example
 }  // namespace pose_graph
 
@@ -5,7 +5,7 @@
 
 #include <Eigen/Core>
 #include <aslam/common/time.h>
-#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/columnar-temporal-buffer.h>
 
 #include "sensors/measurements.pb.h"
 #include "sensors/sensor.h"
@@ -98,8 +98,10 @@ class Measurement {
   SensorId sensor_id_;
   int64_t timestamp_nanoseconds_;
 };
+// Measurements of a sensor are mostly appended in time order and rarely
+// removed, so they are kept in contiguous, time-sorted columns.
 template <class MeasurementType>
-using MeasurementBuffer = common::TemporalBuffer<
+using MeasurementBuffer = common::ColumnarTemporalBuffer<
     MeasurementType,
     Eigen::aligned_allocator<std::pair<const int64_t, MeasurementType>>>;
 
@@ -1,17 +1,61 @@
 #ifndef VI_MAP_CHECK_MAP_CONSISTENCY_H_
 #define VI_MAP_CHECK_MAP_CONSISTENCY_H_
 
+#include <posegraph/unique-id.h>
 #include <posegraph/vertex.h>
 #include <vi-map/mission.h>
+#include <vi-map/unique-id.h>
 
 namespace vi_map {
 class VIMap;
+
+enum class MapConsistencyCheckLevel {
+  // Missions, base frames, sensors and the pose-graph structure of every
+  // mission, including orphaned vertices and edges.
+  kStructuralOnly,
+  // Additionally the landmark index, the landmark stores, the landmark
+  // back-references of all vertices and the resources.
+  kFull
+};
+
 bool isGpsReferenceVertex(
     const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id);
+// Runs the full check. The landmark and vertex passes are sharded and run in
+// parallel.
 bool checkMapConsistency(const vi_map::VIMap& vi_map);
+bool checkMapConsistency(
+    const vi_map::VIMap& vi_map, const MapConsistencyCheckLevel level);
 bool checkPosegraphConsistency(
     const vi_map::VIMap& vi_map, const vi_map::MissionId& mission_id);
 bool checkForOrphanedPosegraphItems(const vi_map::VIMap& vi_map);
 bool checkSensorConsistency(const vi_map::VIMap& vi_map);
+
+// Checks a map repeatedly while it is being edited. The first check and every
+// check after reset() cover the whole map. Once a full check succeeded, the
+// landmark passes of later checks only cover the vertices and landmarks marked
+// as touched since the last successful check, as well as the observers of
+// these landmarks. The structural checks always cover the whole map.
+// Every added or changed vertex and landmark needs to be marked. For removed
+// items, the items that referenced them need to be marked instead.
+class IncrementalMapConsistencyChecker {
+ public:
+  explicit IncrementalMapConsistencyChecker(const vi_map::VIMap& vi_map);
+
+  void markVertexTouched(const pose_graph::VertexId& vertex_id);
+  void markLandmarkTouched(const vi_map::LandmarkId& landmark_id);
+
+  // The next check covers the whole map again.
+  void reset();
+
+  // The touched items are only cleared if the check succeeds, so they are
+  // checked again after the map was fixed.
+  bool check(const MapConsistencyCheckLevel level);
+
+ private:
+  const vi_map::VIMap& vi_map_;
+  bool needs_full_check_;
+  pose_graph::VertexIdSet touched_vertex_ids_;
+  vi_map::LandmarkIdSet touched_landmark_ids_;
+};
 }  // namespace vi_map
 #endif  // VI_MAP_CHECK_MAP_CONSISTENCY_H_
@@ -43,6 +43,11 @@ class Edge : public pose_graph::Edge {
     return static_cast<const pose_graph::Edge&>(*this) == other;
   }
 
+  // Estimated memory used by the edge, including the edge object itself.
+  virtual size_t memoryUsageBytes() const {
+    return sizeof(Edge);
+  }
+
   void serialize(vi_map::proto::Edge* proto) const;
   static Edge::UniquePtr deserialize(
       const pose_graph::EdgeId& edge_id, const vi_map::proto::Edge& proto);
@@ -0,0 +1,54 @@
+#ifndef VI_MAP_LANDMARK_COVARIANCE_H_
+#define VI_MAP_LANDMARK_COVARIANCE_H_
+
+#include <array>
+#include <cstddef>
+
+#include <Eigen/Core>
+
+namespace vi_map {
+
+// Optional position covariance of a landmark. The symmetric matrix is kept as
+// the six floats of its upper triangle in a process-wide pool, such that maps
+// with covariances for millions of landmarks need a few large allocations
+// instead of one per landmark. Copies clone the covariance. Handles can be
+// created and destroyed concurrently.
+class LandmarkCovariance {
+ public:
+  typedef std::array<float, 6> PackedCovariance;
+
+  LandmarkCovariance() : packed_(nullptr) {}
+  explicit LandmarkCovariance(const Eigen::Matrix3d& covariance);
+  LandmarkCovariance(const LandmarkCovariance& other);
+  LandmarkCovariance(LandmarkCovariance&& other);
+  LandmarkCovariance& operator=(const LandmarkCovariance& other);
+  LandmarkCovariance& operator=(LandmarkCovariance&& other);
+  ~LandmarkCovariance();
+
+  inline bool isSet() const {
+    return packed_ != nullptr;
+  }
+
+  // The matrix is symmetrized from its upper triangle.
+  void set(const Eigen::Matrix3d& covariance);
+  // CHECK-fails if not set.
+  void get(Eigen::Matrix3d* covariance) const;
+  void reset();
+
+  bool operator==(const LandmarkCovariance& other) const;
+  inline bool operator!=(const LandmarkCovariance& other) const {
+    return !operator==(other);
+  }
+
+  // Pool memory taken by a set covariance.
+  static constexpr size_t kMemoryUsageBytes = sizeof(PackedCovariance);
+  // Number of covariances currently set across all landmarks.
+  static size_t numPooledCovariances();
+
+ private:
+  PackedCovariance* packed_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_LANDMARK_COVARIANCE_H_
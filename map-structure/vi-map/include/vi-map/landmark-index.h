@@ -2,14 +2,17 @@
 #define VI_MAP_LANDMARK_INDEX_H_
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
-#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/dense-id-index.h>
+#include <maplab-common/flat-hash-map.h>
 #include <vi-map/unique-id.h>
 
 class LoopClosureHandlerTest;
@@ -22,7 +25,7 @@ class SixDofVIMapGenerator;
 namespace vi_map {
 class VIMap;
 
-typedef std::unordered_map<LandmarkId, pose_graph::VertexId>
+typedef common::FlatHashMap<LandmarkId, pose_graph::VertexId>
     LandmarkToVertexMap;
 
 class LandmarkIndex {
@@ -37,11 +40,16 @@ class LandmarkIndex {
   void shallowCopyFrom(const LandmarkIndex& other) {
     std::lock_guard<std::mutex> lock(access_mutex_);
     index_ = other.index_;
+    dense_indices_ = other.dense_indices_;
+    updateRevision();
   }
 
   void swap(LandmarkIndex* other) {
     std::lock_guard<std::mutex> lock(access_mutex_);
     index_.swap(other->index_);
+    dense_indices_.swap(&other->dense_indices_);
+    updateRevision();
+    other->updateRevision();
   }
 
   inline pose_graph::VertexId getStoringVertexId(
@@ -62,6 +70,30 @@ class LandmarkIndex {
     CHECK(!hasLandmarkInternal(landmark_id)) << "Landmark " << landmark_id
                                              << " is already in the index!";
     index_.emplace(landmark_id, vertex_id);
+    dense_indices_.add(landmark_id);
+    updateRevision();
+  }
+
+  inline void reserve(size_t num_landmarks) {
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    index_.reserve(num_landmarks);
+    dense_indices_.reserve(num_landmarks);
+  }
+
+  // Adds all landmarks of the other index, which must not be in this index.
+  inline void addAllLandmarksFrom(const LandmarkIndex& other) {
+    CHECK_NE(&other, this);
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    std::lock_guard<std::mutex> other_lock(other.access_mutex_);
+    index_.reserve(index_.size() + other.index_.size());
+    dense_indices_.reserve(index_.size() + other.index_.size());
+    for (const LandmarkToVertexMap::value_type& item : other.index_) {
+      CHECK(item.first.isValid());
+      CHECK(index_.emplace(item.first, item.second).second)
+          << "Landmark " << item.first << " is already in the index!";
+      dense_indices_.add(item.first);
+    }
+    updateRevision();
   }
 
   inline void getAllLandmarkIds(
@@ -103,6 +135,7 @@ class LandmarkIndex {
     LandmarkToVertexMap::iterator it = index_.find(landmark_id);
     CHECK(it != index_.end());
     it->second = vertex_id;
+    updateRevision();
   }
 
   inline void removeLandmark(
@@ -111,24 +144,73 @@ class LandmarkIndex {
     CHECK(hasLandmarkInternal(landmark_id)) << "Tried to remove a landmark "
         << "that does not exist!";
     index_.erase(landmark_id);
+    dense_indices_.remove(landmark_id);
+    updateRevision();
+  }
+
+  inline void removeLandmarks(const LandmarkIdSet& landmark_ids) {
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    for (const LandmarkId& landmark_id : landmark_ids) {
+      CHECK(hasLandmarkInternal(landmark_id)) << "Tried to remove a landmark "
+          << "that does not exist!";
+      index_.erase(landmark_id);
+      dense_indices_.remove(landmark_id);
+    }
+    updateRevision();
   }
 
   void setLandmarkToVertexMap(
       const LandmarkToVertexMap& landmark_to_vertex) {
     std::lock_guard<std::mutex> lock(access_mutex_);
     index_ = landmark_to_vertex;
+    dense_indices_.clear();
+    dense_indices_.reserve(index_.size());
+    for (const LandmarkToVertexMap::value_type& item : index_) {
+      dense_indices_.add(item.first);
+    }
+    updateRevision();
+  }
+
+  // Dense integer index of each landmark, see common::DenseIdIndex.
+  inline size_t getDenseIndex(const LandmarkId& landmark_id) const {
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    return dense_indices_.getIndex(landmark_id);
+  }
+
+  inline LandmarkId getLandmarkIdFromDenseIndex(size_t index) const {
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    return dense_indices_.getId(index);
+  }
+
+  inline size_t numDenseIndices() const {
+    std::lock_guard<std::mutex> lock(access_mutex_);
+    return dense_indices_.getNumIndices();
   }
 
   inline void clear() {
     index_.clear();
+    dense_indices_.clear();
+    updateRevision();
   }
 
+  // Changes whenever landmarks are added, removed or moved to another vertex
+  // and whenever VIMap::markLandmarksChanged() is called. Revisions are unique
+  // across all indices, see PoseGraph::getTopologyRevision().
+  inline uint64_t getRevision() const {
+    return revision_.load();
+  }
+
+  // Assigns a new revision.
+  void updateRevision();
+
  private:
   inline bool hasLandmarkInternal(const LandmarkId& landmark_id) const {
     return index_.count(landmark_id) > 0u;
   }
 
   LandmarkToVertexMap index_;
+  common::DenseIdIndex<LandmarkId> dense_indices_;
+  std::atomic<uint64_t> revision_{0u};
   mutable std::mutex access_mutex_;
 };
 
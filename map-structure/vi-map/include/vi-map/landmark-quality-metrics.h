@@ -5,6 +5,7 @@
 
 #include <Eigen/Core>
 #include <aslam/common/memory.h>
+#include <maplab-common/pose_types.h>
 
 namespace vi_map {
 class VIMap;
@@ -47,6 +48,13 @@ bool isLandmarkWellConstrained(
     const vi_map::VIMap& map, const vi_map::Landmark& landmark,
     bool re_evaluate_quality);
 
+// Evaluates the quality from the global landmark position and the poses of all
+// cameras observing it, e.g. to reuse the camera poses for many landmarks.
+bool isLandmarkWellConstrained(
+    const Eigen::Vector3d& p_G_fi,
+    const Aligned<std::vector, pose::Transformation>& observers_T_G_C,
+    const LandmarkWellConstrainedSettings& settings);
+
 }  // namespace vi_map
 #include "./landmark-quality-metrics-inl.h"
 #endif  // VI_MAP_LANDMARK_QUALITY_METRICS_H_
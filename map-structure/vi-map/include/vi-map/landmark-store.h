@@ -1,10 +1,11 @@
 #ifndef VI_MAP_LANDMARK_STORE_H_
 #define VI_MAP_LANDMARK_STORE_H_
 
-#include <unordered_map>
+#include <memory>
 #include <vector>
 
 #include <aslam/common/memory.h>
+#include <maplab-common/flat-hash-map.h>
 
 #include "vi-map/landmark.h"
 #include "vi-map/unique-id.h"
@@ -12,10 +13,20 @@
 
 namespace vi_map {
 
+// Copies of a landmark store share the landmarks until one of the copies is
+// modified, i.e. until a non-const method is called on it. Hence, copying the
+// store of a vertex is cheap. Non-const methods must not be called
+// concurrently on a store that shares its landmarks with another copy.
 class LandmarkStore {
  public:
   typedef Aligned<std::vector, Landmark> LandmarkVector;
 
+  LandmarkStore();
+  // Declared such that copies are used instead of moves, which would leave a
+  // store without storage behind. Copies are cheap anyway.
+  LandmarkStore(const LandmarkStore&) = default;
+  LandmarkStore& operator=(const LandmarkStore&) = default;
+
   double* get_p_B_Mutable(const LandmarkId& landmark_id);
 
   Landmark& getLandmark(const LandmarkId& landmark_id);
@@ -23,58 +34,69 @@ class LandmarkStore {
 
   void addLandmark(const Landmark& landmark);
   void removeLandmark(const LandmarkId& landmark_id);
+  // Removes all landmarks of the store that are in the set in a single pass
+  // and returns how many were removed.
+  size_t removeLandmarks(const LandmarkIdSet& landmark_ids);
   bool hasLandmark(const LandmarkId& landmark_id) const;
 
   unsigned int size() const;
 
+  // Memory of the landmarks, without sizeof(LandmarkStore). Landmarks shared
+  // with copies of the store are counted for every copy.
+  size_t memoryUsageBytes() const;
+
   void serialize(vi_map::proto::LandmarkStore* proto) const;
   void deserialize(const vi_map::proto::LandmarkStore& proto);
 
   inline LandmarkVector::iterator begin() {
-    return landmarks_.begin();
+    return getMutableStorage().landmarks.begin();
   }
 
   inline LandmarkVector::iterator end() {
-    return landmarks_.end();
+    return getMutableStorage().landmarks.end();
   }
 
   inline LandmarkVector::reverse_iterator rbegin() {
-    return landmarks_.rbegin();
+    return getMutableStorage().landmarks.rbegin();
   }
 
   inline LandmarkVector::reverse_iterator rend() {
-    return landmarks_.rend();
+    return getMutableStorage().landmarks.rend();
   }
 
   inline LandmarkVector::const_iterator begin() const {
-    return landmarks_.cbegin();
+    return storage_->landmarks.cbegin();
   }
 
   inline LandmarkVector::const_iterator end() const {
-    return landmarks_.cend();
+    return storage_->landmarks.cend();
   }
 
   inline LandmarkVector::const_reverse_iterator rbegin() const {
-    return landmarks_.crbegin();
+    return storage_->landmarks.crbegin();
   }
 
   inline LandmarkVector::const_reverse_iterator rend() const {
-    return landmarks_.crend();
+    return storage_->landmarks.crend();
   }
 
   inline Landmark& operator[](const size_t index) {
-    CHECK_LT(index, landmarks_.size());
-    return landmarks_[index];
+    LandmarkVector& landmarks = getMutableStorage().landmarks;
+    CHECK_LT(index, landmarks.size());
+    return landmarks[index];
   }
   inline const Landmark& operator[](const size_t index) const {
-    CHECK_LT(index, landmarks_.size());
-    return landmarks_[index];
+    CHECK_LT(index, storage_->landmarks.size());
+    return storage_->landmarks[index];
   }
 
   inline bool operator==(const LandmarkStore& lhs) const {
+    if (storage_ == lhs.storage_) {
+      return true;
+    }
     bool is_same = true;
-    is_same &= landmark_id_map_ == lhs.landmark_id_map_;
-    is_same &= landmarks_ == lhs.landmarks_;
+    is_same &= storage_->landmark_id_map == lhs.storage_->landmark_id_map;
+    is_same &= storage_->landmarks == lhs.storage_->landmarks;
     return is_same;
   }
   inline bool operator!=(const LandmarkStore& lhs) const {
@@ -84,10 +106,17 @@ class LandmarkStore {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
-  typedef std::unordered_map<LandmarkId, int> LandmarkIdToIdxMap;
+  typedef common::FlatHashMap<LandmarkId, int> LandmarkIdToIdxMap;
+
+  struct Storage {
+    LandmarkIdToIdxMap landmark_id_map;
+    LandmarkVector landmarks;
+  };
+
+  // Copies the landmarks first if they are shared with another store.
+  Storage& getMutableStorage();
 
-  LandmarkIdToIdxMap landmark_id_map_;
-  LandmarkVector landmarks_;
+  std::shared_ptr<Storage> storage_;
 };
 
 }  // namespace vi_map
@@ -10,6 +10,7 @@
 #include <maplab-common/pose_types.h>
 #include <posegraph/vertex.h>
 
+#include "vi-map/landmark-covariance.h"
 #include "vi-map/unique-id.h"
 #include "vi-map/vi_map.pb.h"
 
@@ -39,11 +40,7 @@ class Landmark {
     quality_ = lhs.quality_;
     B_position_ = lhs.B_position_;
     appearances_ = lhs.appearances_;
-
-    // Clone covariance if set.
-    if (lhs.B_covariance_ != nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>(*lhs.B_covariance_);
-    }
+    B_covariance_ = lhs.B_covariance_;
     return *this;
   }
 
@@ -65,19 +62,17 @@ class Landmark {
 
   inline bool get_p_B_Covariance(Eigen::Matrix3d* covariance) const {
     CHECK_NOTNULL(covariance);
-    if (B_covariance_ == nullptr) {
+    if (!B_covariance_.isSet()) {
       covariance->setZero();
       return false;
     }
-    *covariance = *B_covariance_;
+    B_covariance_.get(covariance);
     return true;
   }
 
+  // The covariance is stored in single precision.
   inline void set_p_B_Covariance(const Eigen::Matrix3d& covariance) {
-    if (B_covariance_ == nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>();
-    }
-    *B_covariance_ = covariance;
+    B_covariance_.set(covariance);
   }
 
   inline void unsetCovariance() {
@@ -131,7 +126,6 @@ class Landmark {
   unsigned int numberOfObserverVertices() const;
 
   double* get_p_B_Mutable();
-  double* get_p_B_CovarianceMutable();
 
   const KeypointIdentifierList& getObservations() const;
 
@@ -181,17 +175,15 @@ class Landmark {
   void serialize(vi_map::proto::Landmark* proto) const;
   void deserialize(const vi_map::proto::Landmark& proto);
 
+  // Memory of the observations, appearances and covariance, without
+  // sizeof(Landmark).
+  size_t memoryUsageBytes() const;
+
   inline bool operator==(const Landmark& lhs) const {
     bool is_same = true;
     is_same &= quality_ == lhs.quality_;
     is_same &= B_position_ == lhs.B_position_;
-
-    if (B_covariance_.get() != nullptr && lhs.B_covariance_.get() != nullptr) {
-      is_same &= (*B_covariance_ == *lhs.B_covariance_);
-    } else {
-      is_same &=
-          B_covariance_.get() == nullptr && lhs.B_covariance_.get() == nullptr;
-    }
+    is_same &= B_covariance_ == lhs.B_covariance_;
     return is_same;
   }
   inline bool operator!=(const Landmark& lhs) const {
@@ -209,9 +201,10 @@ class Landmark {
   std::vector<int> appearances_;
 
   // Position and covariance w.r.t. landmark baseframe. The covariance is
-  // optional to reduce the memory usage.
+  // optional to reduce the memory usage. The position stays in double
+  // precision, as the optimization uses it as parameter block in place.
   pose::Position3D B_position_;
-  AlignedUniquePtr<Eigen::Matrix3d> B_covariance_;
+  LandmarkCovariance B_covariance_;
 };
 }  // namespace vi_map
 
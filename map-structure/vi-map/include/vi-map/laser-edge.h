@@ -2,6 +2,7 @@
 #define VI_MAP_LASER_EDGE_H_
 #include <string>
 
+#include <maplab-common/memory-usage.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/traits.h>
 
@@ -34,6 +35,12 @@ class LaserEdge : public vi_map::Edge {
 
   virtual ~LaserEdge() {}
 
+  size_t memoryUsageBytes() const override {
+    return sizeof(LaserEdge) +
+           common::getHeapMemoryUsageBytes(laser_timestamps_ns_) +
+           common::getHeapMemoryUsageBytes(laser_data_xyzi_);
+  }
+
   void serialize(vi_map::proto::LaserEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::LaserEdge& proto);
@@ -0,0 +1,54 @@
+#ifndef VI_MAP_MAP_FORMAT_VERSION_H_
+#define VI_MAP_MAP_FORMAT_VERSION_H_
+
+#include <cstdint>
+
+#include <maplab-common/unique-id.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+namespace serialization {
+
+// Version 1 stores every id as a nested common.proto.Id message. Version 2
+// stores the ids of the vertices, edges, landmark observations and the
+// landmark index as packed arrays of fixed64 words, see
+// common::getNumPackedIds(). Both versions are read, the version that is
+// written is selected by --vi_map_serialization_format_version.
+constexpr uint32_t kFormatVersionIdMessages = 1u;
+constexpr uint32_t kFormatVersionPackedIds = 2u;
+constexpr uint32_t kCurrentFormatVersion = kFormatVersionPackedIds;
+
+uint32_t getFormatVersionToWrite();
+
+inline bool shouldWritePackedIds() {
+  return getFormatVersionToWrite() >= kFormatVersionPackedIds;
+}
+
+// Proto files written before the version was introduced have no version.
+inline uint32_t getFormatVersion(const proto::VIMap& proto) {
+  return proto.has_format_version() ? proto.format_version()
+                                    : kFormatVersionIdMessages;
+}
+
+// The vertices of a proto in either version.
+inline int getNumVertexIds(const proto::VIMap& proto) {
+  return proto.vertex_ids_packed_size() > 0
+             ? common::getNumPackedIds(proto.vertex_ids_packed())
+             : proto.vertex_ids_size();
+}
+inline void getVertexId(
+    const proto::VIMap& proto, const int index, pose_graph::VertexId* id) {
+  CHECK_NOTNULL(id);
+  if (proto.vertex_ids_packed_size() > 0) {
+    id->deserialize(proto.vertex_ids_packed(), index);
+  } else {
+    id->deserialize(proto.vertex_ids(index));
+  }
+}
+
+}  // namespace serialization
+}  // namespace vi_map
+
+#endif  // VI_MAP_MAP_FORMAT_VERSION_H_
@@ -0,0 +1,38 @@
+#ifndef VI_MAP_MAP_MEMORY_USAGE_H_
+#define VI_MAP_MAP_MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace vi_map {
+
+// Estimated memory used by the parts of a map, as computed by
+// VIMap::getMissionMemoryUsage and VIMap::getMemoryUsage.
+struct MapMemoryUsage {
+  // The vertex objects with their edge ids and resource ids.
+  size_t vertex_bytes = 0u;
+  size_t descriptor_bytes = 0u;
+  // Keypoint measurements, uncertainties, scales, orientations and track ids.
+  size_t keypoint_bytes = 0u;
+  size_t image_bytes = 0u;
+  // Landmark ids observed by the keypoints.
+  size_t observation_bytes = 0u;
+  // Landmark stores, including the observations of the landmarks.
+  size_t landmark_bytes = 0u;
+  size_t imu_edge_bytes = 0u;
+  size_t other_edge_bytes = 0u;
+  size_t optional_sensor_data_bytes = 0u;
+  // Only set for the whole map.
+  size_t resource_cache_bytes = 0u;
+
+  size_t getTotalBytes() const;
+
+  void accumulate(const MapMemoryUsage& other);
+
+  // One line per component, in MiB.
+  std::string print() const;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_MAP_MEMORY_USAGE_H_
@@ -0,0 +1,49 @@
+#ifndef VI_MAP_MISSION_STATISTICS_H_
+#define VI_MAP_MISSION_STATISTICS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vi_map {
+
+// Statistics of one mission, as computed by VIMap::getMissionStatistics.
+struct MissionStatistics {
+  size_t num_vertices = 0u;
+  size_t num_landmarks = 0u;
+  // Keypoints of all valid visual frames.
+  size_t num_observations = 0u;
+
+  // Landmarks with observations, counted for the camera of their first
+  // observation.
+  std::vector<size_t> num_good_landmarks_per_camera;
+  std::vector<size_t> num_bad_landmarks_per_camera;
+  std::vector<size_t> num_unknown_landmarks_per_camera;
+  std::vector<size_t> total_num_landmarks_per_camera;
+
+  // Outgoing edges of the vertices of the mission.
+  size_t num_imu_edges = 0u;
+  size_t num_wheel_odometry_edges = 0u;
+  size_t num_loop_closure_edges = 0u;
+
+  double distance_travelled_m = 0.0;
+  // Timestamps of the first frames of the first and last vertex, zero if not
+  // available.
+  int64_t start_time_ns = 0;
+  int64_t end_time_ns = 0;
+  double duration_s = 0.0;
+
+  void resizeCameras(size_t num_cameras);
+
+  // Adds all counts and the distance of the other statistics, the times are
+  // not touched.
+  void accumulateCounts(const MissionStatistics& other);
+
+  size_t getNumGoodLandmarks() const;
+  size_t getNumBadLandmarks() const;
+  size_t getNumUnknownLandmarks() const;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_MISSION_STATISTICS_H_
@@ -6,7 +6,7 @@
 #include <Eigen/Core>
 #include <aslam/common/pose-types.h>
 #include <maplab-common/macros.h>
-#include <maplab-common/temporal-buffer.h>
+#include <maplab-common/columnar-temporal-buffer.h>
 #include <sensors/gps-utm.h>
 #include <sensors/gps-wgs.h>
 #include <sensors/measurement.h>
@@ -38,6 +38,9 @@ class OptionalSensorData final {
 
   void getAllSensorIds(SensorIdSet* sensor_ids) const;
 
+  // Memory of the measurements, without sizeof(OptionalSensorData).
+  size_t memoryUsageBytes() const;
+
   template<class MeasurementType>
   void clear(const SensorId& sensor_id) {
     getMeasurementsMutable<MeasurementType>(sensor_id).clear();
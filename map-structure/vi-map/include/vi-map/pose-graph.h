@@ -1,6 +1,7 @@
 #ifndef VI_MAP_POSE_GRAPH_H_
 #define VI_MAP_POSE_GRAPH_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -26,6 +27,12 @@ class PoseGraph : public pose_graph::PoseGraph {
 
   virtual ~PoseGraph() {}
 
+  // Vertices are pooled per mission, edges with the mission of their
+  // from-vertex.
+  static size_t getObjectArena(const vi_map::MissionId& mission_id) {
+    return std::hash<vi_map::MissionId>()(mission_id);
+  }
+
   void addVIVertex(
       const pose_graph::VertexId& id,
       const Eigen::Matrix<double, 6, 1>& imu_ba_bw,
@@ -47,6 +54,24 @@ class PoseGraph : public pose_graph::PoseGraph {
       const ViwlsEdge& edge_between_vertices,
       const ViwlsEdge& edge_after_next_vertex);
 
+  // Replaces the chain of consecutive edges, which has to start at
+  // merge_into_vertex_id, by a single edge with all IMU measurements.
+  void mergeViwlsEdgeChain(
+      const pose_graph::VertexId& merge_into_vertex_id,
+      const std::vector<const ViwlsEdge*>& edge_chain);
+
+  // The two steps of mergeViwlsEdgeChain. The concatenation only reads the
+  // edges, such that it can run in parallel for disjoint chains.
+  static void concatenateViwlsEdgeChain(
+      const std::vector<const ViwlsEdge*>& edge_chain,
+      Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data);
+  void replaceViwlsEdgeChain(
+      const pose_graph::VertexId& merge_into_vertex_id,
+      const std::vector<const ViwlsEdge*>& edge_chain,
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+      const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data);
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
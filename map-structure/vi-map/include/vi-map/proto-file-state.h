@@ -0,0 +1,39 @@
+#ifndef VI_MAP_PROTO_FILE_STATE_H_
+#define VI_MAP_PROTO_FILE_STATE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <posegraph/unique-id.h>
+
+namespace vi_map {
+
+// Layout and content of the proto files of a map folder, recorded when the map
+// is loaded from or saved to the folder. Saving the map to the same folder
+// again keeps the vertices in their files and only rewrites the files whose
+// content changed.
+struct ProtoFileState {
+  // Vertices of each vertex proto file, in the order of the files.
+  typedef std::vector<pose_graph::VertexIdList> VertexFileList;
+
+  void clear() {
+    map_folder.clear();
+    vertex_files.clear();
+    fingerprints.clear();
+  }
+
+  bool isValidForFolder(const std::string& folder) const {
+    return !map_folder.empty() && map_folder == folder;
+  }
+
+  std::string map_folder;
+  VertexFileList vertex_files;
+  // Fingerprint of the uncompressed content of each proto file, in the order
+  // of the proto files of the map folder.
+  std::vector<uint64_t> fingerprints;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_PROTO_FILE_STATE_H_
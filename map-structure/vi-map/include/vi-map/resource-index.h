@@ -0,0 +1,138 @@
+#ifndef VI_MAP_RESOURCE_INDEX_H_
+#define VI_MAP_RESOURCE_INDEX_H_
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/common/unique-id.h>
+#include <glog/logging.h>
+#include <map-resources/resource-common.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/unique-id.h"
+
+namespace vi_map {
+
+class VIMap;
+
+// Flat, read-only copy of all resource references of a map, such that
+// resources can be found without walking the pose graph and the missions.
+// Every reference is a row, stored in one array per column:
+//  - the resource id and type,
+//  - the owner: a frame of a vertex, a mission or an optional camera of a
+//    mission,
+//  - the timestamp of the frame or of the optional camera resource.
+// Rows of the same resource id are chained, which finds mission resources
+// that are shared by multiple missions. The rows of every resource type are
+// sorted by timestamp for temporal queries.
+//
+// Only the frame resources of frames that are set are indexed. The index is
+// not updated when the map changes and has to be rebuilt.
+class ResourceIndex {
+ public:
+  enum class OwnerType : uint8_t { kFrame, kMission, kOptionalCamera };
+
+  static constexpr uint32_t kInvalidRow = std::numeric_limits<uint32_t>::max();
+  // Timestamp of the rows of mission resources.
+  static constexpr int64_t kNoTimestamp = -1;
+
+  explicit ResourceIndex(const VIMap& map);
+
+  inline size_t numRows() const {
+    return resource_ids_.size();
+  }
+
+  // Columns.
+  inline const backend::ResourceId& getResourceId(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return resource_ids_[row];
+  }
+  inline backend::ResourceType getResourceType(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return types_[row];
+  }
+  inline OwnerType getOwnerType(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return owner_types_[row];
+  }
+  inline const MissionId& getMissionId(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return mission_ids_[row];
+  }
+  // Invalid for rows that are not owned by a frame.
+  inline const pose_graph::VertexId& getVertexId(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return vertex_ids_[row];
+  }
+  // Frame index of the rows owned by a frame, 0 otherwise.
+  inline unsigned int getFrameIndex(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return frame_indices_[row];
+  }
+  // Invalid for rows that are not owned by an optional camera.
+  inline const aslam::CameraId& getCameraId(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return camera_ids_[row];
+  }
+  inline int64_t getTimestampNanoseconds(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return timestamps_ns_[row];
+  }
+
+  // Returns the first row of the resource id, kInvalidRow if it is not
+  // referenced by the map.
+  uint32_t findRow(const backend::ResourceId& resource_id) const;
+  // Returns the next row with the same resource id, kInvalidRow if there is
+  // none.
+  inline uint32_t getNextRowWithSameResourceId(const uint32_t row) const {
+    CHECK_LT(row, numRows());
+    return next_row_with_same_id_[row];
+  }
+  size_t numRowsWithResourceId(const backend::ResourceId& resource_id) const;
+
+  // Rows of the type, sorted by timestamp. Rows without timestamp come first.
+  const std::vector<uint32_t>& getRowsOfType(
+      const backend::ResourceType& type) const;
+  // Rows of the type with a timestamp in [min_timestamp_ns, max_timestamp_ns],
+  // sorted by timestamp.
+  void getRowsOfTypeInTimeRange(
+      const backend::ResourceType& type, const int64_t min_timestamp_ns,
+      const int64_t max_timestamp_ns, std::vector<uint32_t>* rows) const;
+  // Returns the row of the type with the timestamp closest to timestamp_ns,
+  // kInvalidRow if there is none within the tolerance.
+  uint32_t findClosestRowOfType(
+      const backend::ResourceType& type, const int64_t timestamp_ns,
+      const int64_t tolerance_ns) const;
+
+  size_t getMemoryUsageBytes() const;
+
+ private:
+  void addRow(
+      const backend::ResourceId& resource_id, const backend::ResourceType& type,
+      const OwnerType owner_type, const MissionId& mission_id,
+      const pose_graph::VertexId& vertex_id, const unsigned int frame_index,
+      const aslam::CameraId& camera_id, const int64_t timestamp_ns);
+
+  std::vector<backend::ResourceId> resource_ids_;
+  std::vector<backend::ResourceType> types_;
+  std::vector<OwnerType> owner_types_;
+  std::vector<MissionId> mission_ids_;
+  std::vector<pose_graph::VertexId> vertex_ids_;
+  std::vector<unsigned int> frame_indices_;
+  std::vector<aslam::CameraId> camera_ids_;
+  std::vector<int64_t> timestamps_ns_;
+
+  // First row of every resource id, the other rows are chained through
+  // next_row_with_same_id_.
+  std::unordered_map<backend::ResourceId, uint32_t> first_row_of_id_;
+  std::vector<uint32_t> next_row_with_same_id_;
+
+  // Indexed by resource type.
+  std::vector<std::vector<uint32_t>> rows_of_type_sorted_by_time_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_RESOURCE_INDEX_H_
@@ -2,6 +2,7 @@
 #define VI_MAP_SENSOR_MANAGER_INL_H_
 
 #include <type_traits>
+#include <vector>
 
 namespace vi_map {
 
@@ -22,12 +23,13 @@ template <class DerivedSensor>
 const DerivedSensor& SensorManager::getSensorForMission(
     const MissionId& mission_id) const {
   ASSERT_DERIVED(DerivedSensor, Sensor);
-  CHECK(mission_id.isValid());
-  SensorIdSet mission_sensors;
-  getAllSensorIdsOfTypeAssociatedWithMission(
-      sensorToType<DerivedSensor>(), mission_id, &mission_sensors);
+  const std::vector<const Sensor*>& mission_sensors =
+      getMissionSensorsOfType(sensorToType<DerivedSensor>(), mission_id);
   CHECK_EQ(mission_sensors.size(), 1u);
-  return getSensor<DerivedSensor>(*mission_sensors.begin());
+  // The sensor type determines the derived type.
+  DCHECK(dynamic_cast<const DerivedSensor*>(mission_sensors.front()) !=
+         nullptr);
+  return static_cast<const DerivedSensor&>(*mission_sensors.front());
 }
 
 template <class DerivedSensor>
@@ -69,11 +71,8 @@ template <class DerivedSensor>
 size_t SensorManager::getNumSensorsOfTypeAssociatedWithMission(
     const MissionId& mission_id) const {
   ASSERT_DERIVED(DerivedSensor, Sensor);
-  CHECK(mission_id.isValid());
-  SensorIdSet sensor_ids;
-  getAllSensorIdsOfTypeAssociatedWithMission(
-      sensorToType<DerivedSensor>(), mission_id, &sensor_ids);
-  return sensor_ids.size();
+  return getMissionSensorsOfType(sensorToType<DerivedSensor>(), mission_id)
+      .size();
 }
 
 }  // namespace vi_map
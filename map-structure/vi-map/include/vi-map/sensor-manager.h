@@ -62,6 +62,8 @@ class SensorManager : public common::YamlFileSerializable {
 
   // Convenience function to retrieve the sensor if only a single one is
   // associated with a mission. Check fails if more than one sensor is present.
+  // The sensors of a mission are resolved by type when they are associated,
+  // so this is cheap enough to be called per vertex.
   template<class SensorType>
   const SensorType& getSensor(const SensorId& sensor_id) const;
   template <class SensorType>
@@ -148,7 +150,25 @@ class SensorManager : public common::YamlFileSerializable {
   SensorSystem::UniquePtr sensor_system_;
 
  private:
+  // Sensors and NCamera of a mission, resolved by sensor type.
+  struct MissionSensors {
+    MissionSensors() : ncamera(nullptr) {}
+    std::vector<const Sensor*>
+        sensors_of_type[static_cast<size_t>(SensorType::kInvalidSensor)];
+    const aslam::NCamera* ncamera;
+  };
+
+  // Returns nullptr if nothing is associated with the mission.
+  const MissionSensors* getMissionSensors(const MissionId& mission_id) const;
+  const std::vector<const Sensor*>& getMissionSensorsOfType(
+      SensorType sensor_type, const MissionId& mission_id) const;
+  // Has to be called whenever sensors are associated with missions.
+  void rebuildMissionSensors();
+
   void checkIsConsistent() const;
+
+  // Points into sensors_ and ncameras_, which own the sensors.
+  AlignedUnorderedMap<MissionId, MissionSensors> mission_sensors_;
 };
 
 }  // namespace vi_map
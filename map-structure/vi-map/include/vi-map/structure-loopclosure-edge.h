@@ -3,6 +3,7 @@
 
 #include <string>
 
+#include <maplab-common/memory-usage.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/traits.h>
 #include <vector>
@@ -67,6 +68,12 @@ class StructureLoopclosureEdge : public vi_map::Edge {
       const pose_graph::VertexId& to, const double switch_variable);
   virtual ~StructureLoopclosureEdge() {}
 
+  size_t memoryUsageBytes() const override {
+    return sizeof(StructureLoopclosureEdge) +
+           common::getHeapMemoryUsageBytes(
+               landmark_observations_.keypoint_vertex_observation_list);
+  }
+
   inline void setSwitchVariable(double switch_variable) {
     switch_variable_ = switch_variable;
   }
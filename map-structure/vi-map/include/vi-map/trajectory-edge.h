@@ -2,6 +2,8 @@
 #define VI_MAP_TRAJECTORY_EDGE_H_
 #include <string>
 
+#include <aslam/common/pose-types.h>
+#include <maplab-common/memory-usage.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/traits.h>
 
@@ -35,6 +37,12 @@ class TrajectoryEdge : public vi_map::Edge {
 
   virtual ~TrajectoryEdge() {}
 
+  size_t memoryUsageBytes() const override {
+    return sizeof(TrajectoryEdge) +
+           common::getHeapMemoryUsageBytes(trajectory_timestamps_ns_) +
+           common::getHeapMemoryUsageBytes(trajectory_G_T_I_pq_);
+  }
+
   void serialize(vi_map::proto::TrajectoryEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::TrajectoryEdge& proto);
@@ -44,11 +52,32 @@ class TrajectoryEdge : public vi_map::Edge {
   const Eigen::Matrix<double, 7, Eigen::Dynamic>& getTrajectoryData() const;
   uint32_t getIdentifier() const;
 
+  // The queries below assume the samples to be sorted by time. Positions are
+  // interpolated linearly and rotations by SLERP between the neighboring
+  // samples. Returns false if the timestamp lies outside of the trajectory.
+  bool getPoseAtTime(
+      const int64_t timestamp_ns, aslam::Transformation* T_G_I) const;
+
+  // Resamples the trajectory at the given timestamps, which need to be sorted,
+  // in a single pass. Returns false if any timestamp lies outside of the
+  // trajectory, in which case T_G_I is left empty.
+  bool getPosesAtTimes(
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+      aslam::TransformationVector* T_G_I) const;
+
+  // Converts all samples, normalizing the quaternions at once.
+  void getTransformations(aslam::TransformationVector* T_G_I) const;
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
   TrajectoryEdge& operator=(const TrajectoryEdge&) = delete;
 
+  // Interpolates between the samples sample_idx and sample_idx + 1, where
+  // timestamp_ns must lie in between.
+  aslam::Transformation interpolate(
+      const int sample_idx, const int64_t timestamp_ns) const;
+
   Eigen::Matrix<int64_t, 1, Eigen::Dynamic> trajectory_timestamps_ns_;
 
   // For now, x, y, z, q_w, q_x, q_y and q_z will be stored here, where q_w,
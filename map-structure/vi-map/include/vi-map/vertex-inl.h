@@ -4,8 +4,31 @@
 #include <string>
 #include <vector>
 
+#include "vi-map/vertex-payload-pager.h"
+
 namespace vi_map {
 
+inline bool Vertex::isPayloadResident() const {
+  return payload_residency_.is_resident.load(std::memory_order_acquire);
+}
+
+inline void Vertex::loadPayloadIfNecessary() const {
+  if (!isPayloadResident()) {
+    CHECK(payload_pager_);
+    payload_pager_->loadPayload(
+        payload_proto_file_index_, const_cast<Vertex*>(this));
+  }
+}
+
+inline void Vertex::loadPayloadForModification() {
+  if (payload_pager_) {
+    pinPayload();
+  }
+  if (n_frame_sharing_.isShared()) {
+    detachSharedNFrame();
+  }
+}
+
 inline const vi_map::MissionId& Vertex::getMissionId() const {
   return mission_id_;
 }
@@ -15,43 +38,52 @@ inline void Vertex::setMissionId(const vi_map::MissionId& mission_id) {
 }
 
 inline aslam::VisualNFrame& Vertex::getVisualNFrame() {
+  loadPayloadForModification();
   CHECK(n_frame_ != nullptr);
   return *n_frame_;
 }
 inline const aslam::VisualNFrame& Vertex::getVisualNFrame() const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   return *n_frame_;
 }
 inline aslam::VisualNFrame::Ptr& Vertex::getVisualNFrameShared() {
+  loadPayloadForModification();
   return n_frame_;
 }
 inline aslam::VisualNFrame::ConstPtr Vertex::getVisualNFrameShared() const {
+  loadPayloadIfNecessary();
   return n_frame_;
 }
 
 inline aslam::VisualFrame& Vertex::getVisualFrame(unsigned int frame_idx) {
+  loadPayloadForModification();
   CHECK(n_frame_ != nullptr);
   CHECK(n_frame_->getFrameShared(frame_idx) != nullptr);
   return *(n_frame_->getFrameShared(frame_idx));
 }
 
 inline bool Vertex::isVisualFrameSet(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   return n_frame_->isFrameSet(frame_idx);
 }
 
 inline bool Vertex::isVisualFrameValid(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   return n_frame_->isFrameValid(frame_idx);
 }
 
 inline aslam::VisualFrame::Ptr Vertex::getVisualFrameShared(
     unsigned int frame_idx) {
+  loadPayloadForModification();
   return n_frame_->getFrameShared(frame_idx);
 }
 
 inline aslam::VisualFrame::Ptr Vertex::getVisualFrameShared(
     aslam::FrameId frame_id) {
+  loadPayloadForModification();
   for (unsigned int i = 0; i < n_frame_->getNumCameras(); ++i) {
     aslam::VisualFrame::Ptr frame = n_frame_->getFrameShared(i);
     if (frame != nullptr && frame->getId() == frame_id) {
@@ -63,6 +95,7 @@ inline aslam::VisualFrame::Ptr Vertex::getVisualFrameShared(
 }
 
 inline unsigned int Vertex::getVisualFrameIndex(aslam::FrameId frame_id) const {
+  loadPayloadIfNecessary();
   for (unsigned int i = 0; i < n_frame_->getNumCameras(); ++i) {
     aslam::VisualFrame::ConstPtr frame = n_frame_->getFrameShared(i);
     if (frame != nullptr && frame->getId() == frame_id) {
@@ -75,6 +108,7 @@ inline unsigned int Vertex::getVisualFrameIndex(aslam::FrameId frame_id) const {
 
 inline const aslam::VisualFrame& Vertex::getVisualFrame(
     unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   CHECK(n_frame_->isFrameSet(frame_idx));
   return n_frame_->getFrame(frame_idx);
@@ -82,21 +116,27 @@ inline const aslam::VisualFrame& Vertex::getVisualFrame(
 
 inline const aslam::VisualFrame::ConstPtr Vertex::getVisualFrameShared(
     unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   return n_frame_->getFrameShared(frame_idx);
 }
 
 inline aslam::NCamera::ConstPtr Vertex::getNCameras() const {
+  if (!isPayloadResident()) {
+    return payload_n_cameras_;
+  }
   CHECK(n_frame_ != nullptr);
   return n_frame_->getNCameraShared();
 }
 
 inline aslam::Camera::ConstPtr Vertex::getCamera(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   CHECK(n_frame_->getNCameraShared() != nullptr);
   return n_frame_->getNCameraShared()->getCameraShared(frame_idx);
 }
 
 inline aslam::Camera::Ptr Vertex::getCamera(unsigned int frame_idx) {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   CHECK(n_frame_->getNCameraShared() != nullptr);
   return n_frame_->getNCameraShared()->getCameraShared(frame_idx);
@@ -104,30 +144,46 @@ inline aslam::Camera::Ptr Vertex::getCamera(unsigned int frame_idx) {
 
 inline void Vertex::setCamera(
     unsigned int frame_idx, const aslam::Camera::Ptr& camera) {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   CHECK(n_frame_->getNCameraShared() != nullptr);
   n_frame_->getNCameraShared()->setCamera(frame_idx, camera);
 }
 
 inline void Vertex::setNCameras(const aslam::NCamera::Ptr& n_cameras) {
+  if (!isPayloadResident()) {
+    // Applied once the payload is paged in.
+    payload_n_cameras_ = n_cameras;
+    return;
+  }
+  if (n_frame_sharing_.isShared()) {
+    detachSharedNFrame();
+  }
   CHECK(n_frame_ != nullptr);
   n_frame_->setNCameras(n_cameras);
 }
 
 inline size_t Vertex::numFrames() const {
+  if (!isPayloadResident()) {
+    // The frame resource map has one entry per frame.
+    return resource_map_.size();
+  }
   CHECK(n_frame_ != nullptr);
   return n_frame_->getNumFrames();
 }
 
 inline LandmarkStore& Vertex::getLandmarks() {
+  loadPayloadForModification();
   return landmarks_;
 }
 
 inline const LandmarkStore& Vertex::getLandmarks() const {
+  loadPayloadIfNecessary();
   return landmarks_;
 }
 
 inline void Vertex::setLandmarks(const LandmarkStore& landmark_store) {
+  loadPayloadForModification();
   landmarks_ = landmark_store;
 }
 
@@ -157,6 +213,9 @@ inline void Vertex::getUnassociatedKeypoints(
 }
 
 int64_t Vertex::getMinTimestampNanoseconds() const {
+  if (!isPayloadResident()) {
+    return payload_min_timestamp_nanoseconds_;
+  }
   CHECK(n_frame_);
   return n_frame_->getMinTimestampNanoseconds();
 }
@@ -171,6 +230,8 @@ inline bool Vertex::operator!=(const Vertex& lhs) const {
 }
 
 inline bool Vertex::isSameApartFromOutgoingEdges(const Vertex& lhs) const {
+  loadPayloadIfNecessary();
+  lhs.loadPayloadIfNecessary();
   bool is_same = true;
   is_same &= T_M_I_ == lhs.T_M_I_;
   is_same &= v_M_ == lhs.v_M_;
@@ -0,0 +1,79 @@
+#ifndef VI_MAP_VERTEX_PAYLOAD_PAGER_H_
+#define VI_MAP_VERTEX_PAYLOAD_PAGER_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
+
+namespace vi_map {
+
+class Vertex;
+
+// Pages in the visual frames, observed landmark ids and landmark stores of
+// lazily deserialized vertices from the vertex proto files of the map folder.
+// The payload of all vertices of a proto file is loaded together on the first
+// access to one of them. If a budget is given, releasePayloadsOverBudget()
+// releases the payloads of the proto files that were paged in the longest time
+// ago, unless one of their vertices was accessed for modification, which pins
+// the whole file in memory.
+//
+// Payloads are never released while they are paged in, as other threads might
+// hold references to the payloads of other vertices. The map manager releases
+// them when a write access to the map is acquired, as no other access exists
+// then.
+class VertexPayloadPager {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(VertexPayloadPager);
+
+  // A budget of 0 keeps all payloads in memory once they were paged in.
+  VertexPayloadPager(
+      const std::string& proto_folder, size_t max_num_resident_bytes);
+
+  // Returns the index to pass to the vertices of this proto file.
+  size_t addProtoFile(const std::string& proto_file_name);
+
+  // Registers the vertex to have its payload paged in and out together with
+  // the other vertices of the proto file. Copies of a vertex are not
+  // registered, they page in their payload on their own and keep it.
+  void registerVertex(size_t proto_file_index, Vertex* vertex);
+  void unregisterVertex(size_t proto_file_index, Vertex* vertex);
+
+  void loadPayload(size_t proto_file_index, Vertex* vertex);
+  void pinPayload(size_t proto_file_index);
+
+  // Releases the payloads that were paged in the longest time ago until the
+  // budget is met. No references to the visual frames, observed landmark ids
+  // or landmarks of the vertices of this pager may be held by any thread.
+  void releasePayloadsOverBudget();
+
+  size_t getNumResidentBytes() const;
+
+ private:
+  struct ProtoFile {
+    std::string file_name;
+    std::unordered_map<pose_graph::VertexId, Vertex*> vertices;
+    bool is_resident = false;
+    bool is_pinned = false;
+    size_t num_bytes = 0u;
+    // Position in resident_proto_files_, if resident and not pinned.
+    std::list<size_t>::iterator resident_it;
+  };
+
+  const std::string proto_folder_;
+  const size_t max_num_resident_bytes_;
+
+  mutable std::mutex m_proto_files_;
+  std::vector<ProtoFile> proto_files_;
+  // Resident proto files that can be released, oldest first.
+  std::list<size_t> resident_proto_files_;
+  size_t num_resident_bytes_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_VERTEX_PAYLOAD_PAGER_H_
@@ -3,7 +3,10 @@
 
 #include <posegraph/vertex.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -21,6 +24,7 @@
 
 #include "vi-map/landmark-store.h"
 #include "vi-map/landmark.h"
+#include "vi-map/map-memory-usage.h"
 #include "vi-map/mission.h"
 #include "vi-map/unique-id.h"
 #include "vi-map/vi_map.pb.h"
@@ -31,12 +35,15 @@ class ViwlsGraph;  // Used for testing.
 
 namespace vi_map {
 
+class VertexPayloadPager;
+
 class Vertex : public pose_graph::Vertex {
   friend class map_optimization_legacy::ViwlsGraph;  // Test.
   friend class MapConsistencyCheckTest;      // Test.
   friend class VertexResourcesTest;          // Test.
   FRIEND_TEST(MapConsistencyCheckTest, mapInconsistentMissingBackLink);
   friend class VIMap;
+  friend class VertexPayloadPager;
 
  public:
   MAPLAB_POINTER_TYPEDEFS(Vertex);
@@ -82,7 +89,9 @@ class Vertex : public pose_graph::Vertex {
   // Default constructor for methods which take a Vertex* as argument and
   // populate it.
   Vertex();
-  virtual ~Vertex() {}
+  virtual ~Vertex();
+  // Copies share the visual frames and landmarks with the copied vertex until
+  // either of them accesses them for modification.
   Vertex(const Vertex&) = default;
   Vertex& operator=(const Vertex&) = delete;
 
@@ -206,6 +215,12 @@ class Vertex : public pose_graph::Vertex {
       unsigned int frame_idx, int keypoint_idx) const;
   void checkConsistencyOfVisualObservationContainers() const;
 
+  // Adds the estimated memory used by the vertex and its visual frames,
+  // observations and landmarks. Does not load a paged-out payload, hence
+  // must not run concurrently with calls that load payloads.
+  void accumulateMemoryUsage(MapMemoryUsage* usage) const;
+  size_t memoryUsageBytes() const;
+
   typedef std::vector<backend::ResourceTypeToIdsMap> FrameResourceMap;
   const FrameResourceMap& getFrameResourceMap() const;
   void setFrameResourceMap(const FrameResourceMap& frame_resource_map);
@@ -233,6 +248,24 @@ class Vertex : public pose_graph::Vertex {
   void deserialize(
       const pose_graph::VertexId& vertex_id,
       const vi_map::proto::ViwlsVertex& proto);
+  // Deserializes everything but the visual frames, observed landmark ids and
+  // landmarks, which are paged in by the pager on first access.
+  void deserializeWithLazyPayload(
+      const pose_graph::VertexId& vertex_id,
+      const vi_map::proto::ViwlsVertex& proto,
+      const std::shared_ptr<VertexPayloadPager>& payload_pager,
+      size_t proto_file_index);
+
+  // False if the visual frames and landmarks of a lazily deserialized vertex
+  // are not in memory.
+  inline bool isPayloadResident() const;
+  // Pages in the payload of a lazily deserialized vertex and keeps it in
+  // memory. Mutable access to the payload does this implicitly.
+  void pinPayload();
+  // Null if the vertex wasn't deserialized lazily.
+  VertexPayloadPager* getPayloadPager() const {
+    return payload_pager_.get();
+  }
 
   inline bool operator==(const Vertex& lhs) const;
   inline bool operator!=(const Vertex& lhs) const;
@@ -258,6 +291,11 @@ class Vertex : public pose_graph::Vertex {
   // replace it with the new id.
   void updateIdInObservedLandmarkIdList(
       const LandmarkId& old_landmark_id, const LandmarkId& new_landmark_id);
+  // Same for many merged landmarks at once, in a single pass over the
+  // observed landmark ids. Returns the number of replaced ids.
+  size_t updateIdsInObservedLandmarkIdList(
+      const std::unordered_map<LandmarkId, LandmarkId>&
+          old_to_new_landmark_ids);
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -277,6 +315,21 @@ class Vertex : public pose_graph::Vertex {
   int determineNewObservedLandmarkIdVectorSize(
       int previous_new_size, int current_new_size, int old_size) const;
 
+  void deserializeWithoutPayload(
+      const pose_graph::VertexId& vertex_id,
+      const vi_map::proto::ViwlsVertex& proto);
+  void deserializePayload(const vi_map::proto::ViwlsVertex& proto);
+  // Called by the pager if the payload exceeds its budget.
+  void releasePayload();
+
+  // Must be called by all methods accessing n_frame_, observed_landmark_ids_ or
+  // landmarks_. The payload is pinned in memory and the visual frames are
+  // detached from copies of this vertex before mutable access.
+  inline void loadPayloadIfNecessary() const;
+  inline void loadPayloadForModification();
+  // Replaces the visual frames shared with copies of this vertex by a copy.
+  void detachSharedNFrame();
+
   pose_graph::VertexId id_;
   vi_map::MissionId mission_id_;
 
@@ -291,6 +344,17 @@ class Vertex : public pose_graph::Vertex {
   pose_graph::EdgeIdSet outgoing_edges_;
 
   aslam::VisualNFrame::Ptr n_frame_;
+  // Copies of a vertex hold the same token as the copied vertex, which tells
+  // if n_frame_ is shared with a copy. The visual frames can also be shared
+  // intentionally, e.g. with the tracker, which doesn't hold a token.
+  struct NFrameSharing {
+    NFrameSharing() : token(std::make_shared<char>()) {}
+    bool isShared() const {
+      return token.use_count() > 1;
+    }
+    std::shared_ptr<char> token;
+  };
+  NFrameSharing n_frame_sharing_;
   std::vector<LandmarkIdList> observed_landmark_ids_;
 
   // Landmark storage.
@@ -298,6 +362,21 @@ class Vertex : public pose_graph::Vertex {
 
   // VisualFrame resources;
   FrameResourceMap resource_map_;
+
+  // Lazy loading of the payload, see VertexPayloadPager.
+  struct PayloadResidency {
+    PayloadResidency() : is_resident(true) {}
+    // Copies take over the current state.
+    PayloadResidency(const PayloadResidency& other)
+        : is_resident(other.is_resident.load()) {}
+    std::atomic<bool> is_resident;
+  };
+  PayloadResidency payload_residency_;
+  std::shared_ptr<VertexPayloadPager> payload_pager_;
+  size_t payload_proto_file_index_ = 0u;
+  // Kept while the payload is not resident.
+  aslam::NCamera::Ptr payload_n_cameras_;
+  int64_t payload_min_timestamp_nanoseconds_ = 0;
 };
 
 }  // namespace vi_map
@@ -82,6 +82,19 @@ const vi_map::Vertex* VIMap::getVertexPtr(
   return vertex_ptr;
 }
 
+size_t VIMap::getVertexDenseIndex(const pose_graph::VertexId& id) const {
+  return posegraph.getVertexDenseIndex(id);
+}
+
+const pose_graph::VertexId& VIMap::getVertexIdFromDenseIndex(
+    size_t index) const {
+  return posegraph.getVertexIdFromDenseIndex(index);
+}
+
+size_t VIMap::numVertexDenseIndices() const {
+  return posegraph.numVertexDenseIndices();
+}
+
 size_t VIMap::numEdges() const {
   if (selected_missions_.empty()) {
     return posegraph.numEdges();
@@ -227,6 +240,30 @@ size_t VIMap::numLandmarksInIndex() const {
   return landmark_index.numLandmarks();
 }
 
+size_t VIMap::getLandmarkDenseIndex(const vi_map::LandmarkId& id) const {
+  return landmark_index.getDenseIndex(id);
+}
+
+vi_map::LandmarkId VIMap::getLandmarkIdFromDenseIndex(size_t index) const {
+  return landmark_index.getLandmarkIdFromDenseIndex(index);
+}
+
+size_t VIMap::numLandmarkDenseIndices() const {
+  return landmark_index.numDenseIndices();
+}
+
+uint64_t VIMap::getLandmarkRevision() const {
+  return landmark_index.getRevision();
+}
+
+void VIMap::markLandmarksChanged() {
+  landmark_index.updateRevision();
+}
+
+uint64_t VIMap::getTopologyRevision() const {
+  return posegraph.getTopologyRevision();
+}
+
 bool VIMap::hasLandmark(const vi_map::LandmarkId& id) const {
   CHECK(id.isValid());
   return landmark_index.hasLandmark(id);
@@ -787,6 +824,19 @@ void VIMap::addVertex(vi_map::Vertex::UniquePtr vertex_ptr) {
   posegraph.addVertex(std::move(vertex_ptr));
 }
 
+void VIMap::addVertices(std::vector<vi_map::Vertex::UniquePtr>* vertices) {
+  CHECK_NOTNULL(vertices);
+  for (vi_map::Vertex::UniquePtr& vertex_ptr : *vertices) {
+    CHECK(vertex_ptr);
+    addVertex(std::move(vertex_ptr));
+  }
+  vertices->clear();
+}
+
+void VIMap::reserveVertices(size_t num_vertices) {
+  posegraph.reserveVertices(num_vertices);
+}
+
 void VIMap::addEdge(vi_map::Edge::UniquePtr edge_ptr) {
   CHECK(edge_ptr);
   CHECK(hasMission(getMissionIdForVertex(edge_ptr->to())));
@@ -796,6 +846,29 @@ void VIMap::addEdge(vi_map::Edge::UniquePtr edge_ptr) {
   posegraph.addEdge(std::move(edge_ptr));
 }
 
+template <typename... Args>
+vi_map::Vertex* VIMap::emplaceVertex(
+    const vi_map::MissionId& mission_id, Args&&... args) {
+  CHECK(hasMission(mission_id));
+  vi_map::Vertex* vertex = posegraph.emplaceVertex<vi_map::Vertex>(
+      PoseGraph::getObjectArena(mission_id), std::forward<Args>(args)...);
+  CHECK_EQ(vertex->getMissionId(), mission_id);
+  return vertex;
+}
+
+template <typename EdgeType, typename... Args>
+EdgeType* VIMap::emplaceEdge(
+    const vi_map::MissionId& mission_id, Args&&... args) {
+  CHECK(hasMission(mission_id));
+  // Adding the edge already fails if it exists or if one of its vertices
+  // doesn't.
+  EdgeType* edge = posegraph.emplaceEdge<EdgeType>(
+      PoseGraph::getObjectArena(mission_id), std::forward<Args>(args)...);
+  CHECK_EQ(getMissionIdForVertex(edge->from()), mission_id);
+  CHECK(hasMission(getMissionIdForVertex(edge->to())));
+  return edge;
+}
+
 pose_graph::Edge::EdgeType VIMap::getEdgeType(
     pose_graph::EdgeId edge_id) const {
   return posegraph.getEdgePtr(edge_id)->getType();
@@ -997,6 +1070,15 @@ void VIMap::storeFrameResource(
       resource, kUseDefaultResourceFolder, frame_idx, type, vertex_ptr);
 }
 
+template <typename DataType>
+void VIMap::storeReservedFrameResource(
+    const DataType& resource, const backend::ResourceType& type,
+    const backend::ResourceId& resource_id) {
+  CHECK(resource_id.isValid());
+  std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+  addResource(type, resource, resource_id);
+}
+
 template <typename DataType>
 bool VIMap::getFrameResource(
     const Vertex& vertex, const unsigned int frame_idx,
@@ -1024,6 +1106,29 @@ bool VIMap::hasFrameResource(
   return vertex.hasFrameResourceOfType(frame_idx, resource_type);
 }
 
+template <typename DataType>
+void VIMap::prefetchFrameResources(
+    const pose_graph::VertexIdList& vertex_ids,
+    const backend::ResourceType& resource_type) const {
+  backend::ResourceIdList resource_ids;
+  {
+    std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const Vertex& vertex = getVertex(vertex_id);
+      const unsigned int num_frames = vertex.numFrames();
+      for (unsigned int frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+        backend::ResourceIdSet frame_resource_ids;
+        vertex.getFrameResourceIdsOfType(
+            frame_idx, resource_type, &frame_resource_ids);
+        resource_ids.insert(
+            resource_ids.end(), frame_resource_ids.begin(),
+            frame_resource_ids.end());
+      }
+    }
+  }
+  prefetchResources<DataType>(resource_ids, resource_type);
+}
+
 template <typename DataType>
 void VIMap::replaceFrameResource(
     const DataType& resource, const unsigned int frame_idx,
@@ -1059,6 +1164,9 @@ void VIMap::clear() {
   mission_base_frames.clear();
   landmark_index.clear();
   selected_missions_.clear();
+  proto_file_state_.clear();
+  std::lock_guard<std::mutex> lock(mission_traversals_mutex_);
+  mission_traversals_.clear();
 }
 
 template <typename DataType>
@@ -1180,6 +1288,14 @@ SensorManager& VIMap::getSensorManager() {
   return sensor_manager_;
 }
 
+const ProtoFileState& VIMap::getProtoFileState() const {
+  return proto_file_state_;
+}
+
+ProtoFileState& VIMap::getProtoFileState() {
+  return proto_file_state_;
+}
+
 template<class MeasurementType>
 const MeasurementBuffer<MeasurementType>& VIMap::getOptionalSensorMeasurements(
     const SensorId& sensor_id, const MissionId& mission_id) const {
@@ -1,12 +1,16 @@
 #ifndef VI_MAP_VI_MAP_SERIALIZATION_H_
 #define VI_MAP_VI_MAP_SERIALIZATION_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
+#include <google/protobuf/io/zero_copy_stream.h>
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/network-common.h>
 
+#include "vi-map/vertex-payload-pager.h"
+#include "vi-map/vertex.h"
 #include "vi-map/vi_map.pb.h"
 
 namespace vi_map {
@@ -55,6 +59,13 @@ void serializeVertices(const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
 size_t serializeVertices(
     const vi_map::VIMap& map, const size_t start_index,
     const size_t vertices_per_proto, vi_map::proto::VIMap* proto);
+// Same as above for the given vertex ids, but writes the proto to the stream in
+// chunks of --vi_map_serialization_vertices_per_chunk vertices instead of
+// building it in memory.
+size_t serializeVerticesToStream(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    const size_t start_index, const size_t vertices_per_proto,
+    google::protobuf::io::ZeroCopyOutputStream* stream);
 void serializeEdges(const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
 void serializeMissionsAndBaseframes(
     const vi_map::VIMap& map, vi_map::proto::VIMap* proto);
@@ -68,6 +79,18 @@ void serializeSensorManagerToArray(
 
 // Note: Missions have to be deserialized before vertices.
 void deserializeVertices(const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
+// Builds the vertices of the proto without modifying the map, such that
+// several protos can be deserialized concurrently. The vertices can then be
+// added in bulk using VIMap::addVertices.
+void deserializeVerticesWithoutAddingToMap(
+    const vi_map::proto::VIMap& proto, vi_map::VIMap* map,
+    std::vector<vi_map::Vertex::UniquePtr>* vertices);
+// Only deserializes the poses and the topology of the vertices if a payload
+// pager is given, the rest is paged in from the given proto file on demand.
+void deserializeVerticesWithoutAddingToMap(
+    const vi_map::proto::VIMap& proto, vi_map::VIMap* map,
+    const VertexPayloadPager::Ptr& payload_pager, size_t proto_file_index,
+    std::vector<vi_map::Vertex::UniquePtr>* vertices);
 void deserializeEdges(const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
 void deserializeMissionsAndBaseframes(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map);
@@ -96,6 +119,18 @@ size_t serializeToFunction(
     const std::function<bool(const size_t, const proto::VIMap&)>&  // NOLINT
     function);
 
+// Writes a proto to the given stream, returns false on failure.
+typedef std::function<bool(google::protobuf::io::ZeroCopyOutputStream*)>
+    ProtoStreamWriter;
+// Same as serializeToFunction, but passes a writer for each proto to the
+// function instead of the proto itself. The vertex protos are never built in
+// memory but serialized in chunks when the writer is called, hence at most one
+// chunk per thread is held in memory.
+size_t serializeToStreamFunction(
+    const vi_map::VIMap& map, const backend::SaveConfig& save_config,
+    const std::function<bool(const size_t, const ProtoStreamWriter&)>&
+        function);
+
 // ============================
 // INTERACTION WITH FILE SYSTEM
 // ============================
@@ -0,0 +1,48 @@
+#ifndef VI_MAP_VI_MAP_SNAPSHOT_H_
+#define VI_MAP_VI_MAP_SNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+namespace serialization {
+
+// The columnar snapshot is an optional copy of the vertex proto files of a map
+// that stores the dense numeric arrays of the vertices, i.e. the vertex poses,
+// the keypoint measurements, sigmas, scales and descriptors of the visual
+// frames and the landmark positions, contiguously in a separate column file
+// per proto file. These arrays are read back from a memory mapping of the
+// column file instead of being parsed from the wire format, the remaining
+// fields are stored in a residual proto file.
+namespace snapshot {
+
+constexpr char kFolderName[] = "vi_map_snapshot";
+constexpr char kColumnFileSuffix[] = ".columns";
+constexpr uint32_t kVersion = 1u;
+// Alignment of the start of each column in the column file.
+constexpr size_t kColumnAlignmentBytes = 64u;
+
+std::string getSnapshotFolder(const std::string& map_folder);
+
+// Moves the dense arrays of the vertices of the proto into the column file and
+// stores the remainder of the proto as residual proto file, both named after
+// the given file name.
+bool saveVertices(
+    const std::string& snapshot_folder, const std::string& file_name,
+    vi_map::proto::VIMap* proto);
+
+// Parses the residual proto file and restores the dense arrays from the
+// column file. Returns false if the snapshot does not contain the file, e.g.
+// because it was written by an incompatible version, in which case the
+// regular proto file has to be used.
+bool loadVertices(
+    const std::string& snapshot_folder, const std::string& file_name,
+    vi_map::proto::VIMap* proto);
+
+}  // namespace snapshot
+}  // namespace serialization
+}  // namespace vi_map
+
+#endif  // VI_MAP_VI_MAP_SNAPSHOT_H_
@@ -30,9 +30,12 @@
 #include "vi-map/laser-edge.h"
 #include "vi-map/loopclosure-edge.h"
 #include "vi-map/macros.h"
+#include "vi-map/map-memory-usage.h"
 #include "vi-map/mission-baseframe.h"
+#include "vi-map/mission-statistics.h"
 #include "vi-map/mission.h"
 #include "vi-map/pose-graph.h"
+#include "vi-map/proto-file-state.h"
 #include "vi-map/sensor-manager.h"
 #include "vi-map/structure-loopclosure-edge.h"
 #include "vi-map/trajectory-edge.h"
@@ -103,7 +106,13 @@ class VIMap : public backend::ResourceMap,
   virtual ~VIMap();
 
   // Discards any data that is not stored in MappedContainerBase-s.
+  // The visual frames and landmarks of the vertices are shared with the other
+  // map until they are accessed for modification in either map.
   void deepCopy(const VIMap& other) override;
+  // Copies the missions, sensors, vertex states and edges of the other map,
+  // without the visual frames, landmarks and resources. Sufficient for
+  // optimizations without visual constraints, e.g. a relaxation.
+  void copyPoseGraphFrom(const VIMap& other);
   void swap(VIMap* other);  // NOLINT
 
   bool hexStringToMissionIdIfValid(
@@ -139,6 +148,11 @@ class VIMap : public backend::ResourceMap,
   inline const SensorManager& getSensorManager() const;
   inline SensorManager& getSensorManager();
 
+  // State of the proto files the map was last loaded from or saved to, if it
+  // was recorded (see --vi_map_incremental_save).
+  inline const ProtoFileState& getProtoFileState() const;
+  inline ProtoFileState& getProtoFileState();
+
   template<class MeasurementType>
   const MeasurementBuffer<MeasurementType>& getOptionalSensorMeasurements(
       const SensorId& sensor_id, const MissionId& mission_id) const;
@@ -170,6 +184,16 @@ class VIMap : public backend::ResourceMap,
   inline const vi_map::Vertex* getVertexPtr(
       const pose_graph::VertexId& id) const;
 
+  // Dense integer index of each vertex of the map, regardless of the selected
+  // missions. The index doesn't change as long as the vertex is part of the
+  // map, such that data per vertex can be kept in flat arrays of size
+  // numVertexDenseIndices(). The indices of removed vertices are reused by
+  // vertices added later, until then they refer to an invalid id.
+  inline size_t getVertexDenseIndex(const pose_graph::VertexId& id) const;
+  inline const pose_graph::VertexId& getVertexIdFromDenseIndex(
+      size_t index) const;
+  inline size_t numVertexDenseIndices() const;
+
   inline size_t numEdges() const;
   inline bool hasEdge(const pose_graph::EdgeId& id) const;
   template <typename EdgeType>
@@ -217,6 +241,21 @@ class VIMap : public backend::ResourceMap,
   inline const vi_map::Landmark& getLandmark(
       const vi_map::LandmarkId& id) const;
 
+  // Dense integer index of each landmark of the landmark index, with the same
+  // guarantees as the dense vertex indices.
+  inline size_t getLandmarkDenseIndex(const vi_map::LandmarkId& id) const;
+  inline vi_map::LandmarkId getLandmarkIdFromDenseIndex(size_t index) const;
+  inline size_t numLandmarkDenseIndices() const;
+
+  // Changes whenever landmarks are added, removed or moved and whenever
+  // markLandmarksChanged() is called, such that data derived from the
+  // landmarks, e.g. a loop closure database, can be cached along with it.
+  inline uint64_t getLandmarkRevision() const;
+  // See PoseGraph::getTopologyRevision().
+  inline uint64_t getTopologyRevision() const;
+  // Call after changing the landmarks in place, e.g. their quality.
+  inline void markLandmarksChanged();
+
   // Add a new reference from the provided global landmark to the store landmark
   // stored in the storing_vertex_id.
   void addLandmarkIndexReference(
@@ -398,7 +437,8 @@ class VIMap : public backend::ResourceMap,
       const vi_map::MissionId& mission_id) const;
 
   /// Get all the vertex ids in the order that they appear when traversing the
-  /// pose-graph of the provided mission.
+  /// pose-graph of the provided mission. The order of the vertices and edges
+  /// is cached per mission until vertices or edges are added or removed.
   void getAllVertexIdsInMissionAlongGraph(
       const vi_map::MissionId& mission_id,
       pose_graph::VertexIdList* vertices) const;
@@ -436,9 +476,28 @@ class VIMap : public backend::ResourceMap,
       vi_map::LandmarkIdSet* observed_landmarks) const;
 
   inline void removeLandmark(const LandmarkId landmark_id);
+  // Removes all the landmarks at once. Every vertex storing or observing one of
+  // them is only updated once and the vertices are updated in parallel, which
+  // is much faster than calling removeLandmark for many landmarks.
+  void removeLandmarks(const LandmarkIdSet& landmark_ids);
+  // Removes all landmarks stored in the vertices of the missions.
+  void removeAllLandmarksOfMissions(const vi_map::MissionIdSet& mission_ids);
 
   inline void addVertex(vi_map::Vertex::UniquePtr vertex_ptr);
+  // Moves all vertices into the map and clears the given list.
+  inline void addVertices(std::vector<vi_map::Vertex::UniquePtr>* vertices);
+  // Reserves space for the given total number of vertices, e.g. before
+  // bulk-inserting a deserialized map.
+  inline void reserveVertices(size_t num_vertices);
   inline void addEdge(vi_map::Edge::UniquePtr edge_ptr);
+  // Constructs the vertex or edge in the object pools of the mission, see
+  // pose_graph::PoseGraph::emplaceVertex(). Edges belong to the mission of
+  // their from-vertex.
+  template <typename... Args>
+  vi_map::Vertex* emplaceVertex(
+      const vi_map::MissionId& mission_id, Args&&... args);
+  template <typename EdgeType, typename... Args>
+  EdgeType* emplaceEdge(const vi_map::MissionId& mission_id, Args&&... args);
   inline pose_graph::Edge::EdgeType getEdgeType(
       pose_graph::EdgeId edge_id) const;
 
@@ -473,6 +532,17 @@ class VIMap : public backend::ResourceMap,
       const vi_map::LandmarkId landmark_id_to_merge,
       const vi_map::LandmarkId& landmark_id_into);
 
+  /// Batched version for a list of [to-merge, into] pairs. Chains of merges,
+  /// e.g. a into b and b into c, are resolved with a union-find first, such
+  /// that every connected set of landmarks is merged into the "into" landmark
+  /// of the last pair joining the set, and every affected observer vertex is
+  /// rewritten exactly once, in parallel. Pairs of landmarks that are merged
+  /// already through earlier pairs are skipped. Returns the number of removed
+  /// landmarks.
+  size_t mergeLandmarks(
+      const std::vector<std::pair<vi_map::LandmarkId, vi_map::LandmarkId>>&
+          landmark_id_pairs_to_merge_into);
+
   /// Moves a given landmark to be stored in the "to" vertex
   /// and updating all the references to it.
   void moveLandmarkToOtherVertex(
@@ -491,6 +561,25 @@ class VIMap : public backend::ResourceMap,
   void getDistanceTravelledPerMission(
       const vi_map::MissionId& id, double* distance) const;
 
+  /// Computes all statistics of the mission in a single pass over its
+  /// vertices, which runs in parallel.
+  void getMissionStatistics(
+      const vi_map::MissionId& mission_id,
+      MissionStatistics* statistics) const;
+
+  /// Estimates the memory used by the vertices of the mission, their outgoing
+  /// edges and the optional sensor data of the mission, in parallel over the
+  /// vertices. Cheap enough to be called periodically, e.g. while building a
+  /// map online.
+  void getMissionMemoryUsage(
+      const vi_map::MissionId& mission_id, MapMemoryUsage* usage) const;
+  /// Sum over all missions plus the resource cache.
+  void getMemoryUsage(MapMemoryUsage* usage) const;
+  /// Releases lazily loaded vertex payloads over the budget of
+  /// --vi_map_lazy_load_max_resident_mb, see VertexPayloadPager. No thread may
+  /// hold references to the visual frames or landmarks of any vertex.
+  void releaseVertexPayloadsOverBudget();
+
   void getStatisticsOfMission(
       const vi_map::MissionId& mission_id,
       std::vector<size_t>* num_good_landmarks_per_camera,
@@ -514,6 +603,26 @@ class VIMap : public backend::ResourceMap,
       const pose_graph::VertexId& vertex_id_from,
       const pose_graph::VertexId& vertex_id_to);
 
+  /// Same as calling mergeNeighboringVertices for all vertices of the list,
+  /// which have to follow merge_into_vertex_id along the backbone, but the
+  /// IMU edges are concatenated only once.
+  void mergeVerticesIntoVertex(
+      const pose_graph::VertexId& merge_into_vertex_id,
+      const pose_graph::VertexIdList& next_vertex_ids);
+
+  /// Bulk version of mergeVerticesIntoVertex for disjoint segments, each given
+  /// as the vertex to keep and the vertices following it to merge into it.
+  /// All merges are planned first, then the landmarks are moved and the IMU
+  /// edges concatenated in parallel over the segments.
+  void mergeVertexSegments(
+      const std::vector<std::pair<pose_graph::VertexId,
+                                  pose_graph::VertexIdList>>& segments);
+
+  /// Adds a copy of the mission with new ids. Landmarks that are only observed
+  /// by the source mission are duplicated, all other landmarks get the
+  /// observations of the copied vertices. The ids are remapped up front and
+  /// the vertices and edges copied in parallel. The copied vertices share the
+  /// frame resources of the source mission, no resources are copied on disk.
   void duplicateMission(const vi_map::MissionId& source_mission_id);
 
   // Removes references to the mission object - assumes mission is empty.
@@ -621,6 +730,16 @@ class VIMap : public backend::ResourceMap,
   void storeFrameResource(
       const DataType& resource, const unsigned int frame_idx,
       const backend::ResourceType& type, Vertex* vertex_ptr);
+  // Splits storeFrameResource in two, so the resource can be written to the
+  // default resource folder on another thread while the map is in use. The
+  // map is only consistent again once all reserved resources are stored.
+  backend::ResourceId reserveFrameResource(
+      const unsigned int frame_idx, const backend::ResourceType& type,
+      Vertex* vertex_ptr);
+  template <typename DataType>
+  void storeReservedFrameResource(
+      const DataType& resource, const backend::ResourceType& type,
+      const backend::ResourceId& resource_id);
   template <typename DataType>
   bool getFrameResource(
       const Vertex& vertex, const unsigned int frame_idx,
@@ -630,6 +749,14 @@ class VIMap : public backend::ResourceMap,
       const Vertex& vertex, const unsigned int frame_idx,
       const backend::ResourceType& type) const;
 
+  // Loads the resources of this type of all frames of the vertices into the
+  // resource cache in the background. Pass the vertices in the order they will
+  // be processed, see backend::ResourceMap::prefetchResources().
+  template <typename DataType>
+  void prefetchFrameResources(
+      const pose_graph::VertexIdList& vertex_ids,
+      const backend::ResourceType& type) const;
+
   template <typename DataType>
   void replaceFrameResource(
       const DataType& resource, const unsigned int frame_idx,
@@ -674,6 +801,10 @@ class VIMap : public backend::ResourceMap,
   VISUAL_FRAME_RESOURCE_CONVENIENCE_FUNCTIONS(
       PointCloudXYZRGBN, backend::ResourceType::kPointCloudXYZRGBN,
       resources::PointCloud);
+  // See descriptor_projection::StoreProjectedDescriptors().
+  VISUAL_FRAME_RESOURCE_CONVENIENCE_FUNCTIONS(
+      ProjectedDescriptors, backend::ResourceType::kProjectedDescriptors,
+      cv::Mat);
 
   // Optional camera resources
   // ===========================
@@ -739,6 +870,14 @@ class VIMap : public backend::ResourceMap,
   // MAP INTERFACE (for map manager)
   // ===============================
   void mergeAllMissionsFromMap(const vi_map::VIMap& other) override;
+  // Like mergeAllMissionsFromMap, but moves the vertices, edges and optional
+  // sensor data instead of copying them. Meant for maps that are deleted
+  // after the merge, the other map holds no missions afterwards.
+  void moveAllMissionsFromMap(vi_map::VIMap* other);
+  // Reserves space for the given total number of vertices, edges and
+  // landmarks, e.g. before merging many maps into this one.
+  void reserveForMerge(
+      size_t num_vertices, size_t num_edges, size_t num_landmarks);
   static std::string getSubFolderName();
 
   /// \brief Returns the list of all existing map files in the given map folder.
@@ -795,9 +934,49 @@ class VIMap : public backend::ResourceMap,
 
   inline void clear();
 
+  // Removes the observations of the vertex from the landmarks it observes and
+  // removes the landmarks only observed by this vertex.
+  void removeVertexFromObservedLandmarks(const pose_graph::VertexId& vertex_id);
+  // Same for a set of vertices, every landmark is only visited once and the
+  // landmarks of different storing vertices are processed in parallel.
+  void removeVerticesFromObservedLandmarks(
+      const pose_graph::VertexIdSet& vertex_ids);
+
+  // The edges to rewrite for merging a segment of vertices.
+  struct VertexMergePlan {
+    // The IMU edges from the kept vertex up to the vertex after the merged
+    // ones, or the last merged vertex if there is none.
+    std::vector<const vi_map::ViwlsEdge*> edge_chain;
+    bool has_vertex_after_merged_vertices = false;
+    // All other edges of the merged vertices.
+    std::unordered_set<pose_graph::EdgeId> other_edges;
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps;
+    Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data;
+  };
+  void planVertexMerge(
+      const pose_graph::VertexId& merge_into_vertex_id,
+      const pose_graph::VertexIdList& next_vertex_ids,
+      VertexMergePlan* plan) const;
+
+  // The vertices of a mission along the graph and their outgoing edges, valid
+  // as long as the topology revision, the root vertex and the backbone of the
+  // mission don't change.
+  struct MissionTraversal {
+    uint64_t topology_revision;
+    pose_graph::VertexId root_vertex_id;
+    pose_graph::Edge::EdgeType traversal_edge_type;
+    pose_graph::VertexIdList vertex_ids;
+    pose_graph::EdgeIdList edge_ids;
+  };
+  // Returns the cached traversal, rebuilds it if the graph has changed.
+  std::shared_ptr<const MissionTraversal> getMissionTraversal(
+      const vi_map::MissionId& mission_id) const;
+
   // Merges only the part inside the VIMap, not the objects related to the
   // ResourceMap.
   void mergeAllMissionsFromMapWithoutResources(const vi_map::VIMap& source_map);
+  // Copies the missions, their base frames and sensors.
+  void mergeMissionsAndSensorsFromMap(const vi_map::VIMap& source_map);
 
   // To force const accessors in non-const methods.
   const VIMap* const const_this;
@@ -807,6 +986,7 @@ class VIMap : public backend::ResourceMap,
   LandmarkIndex landmark_index;
   SensorManager sensor_manager_;
   OptionalSensorDataMap optional_sensor_data_map_;
+  ProtoFileState proto_file_state_;
   // Adding new data? Don't forget to add it to deepCopy() and swap()!
 
   // Used for mission-selective VIMap.
@@ -814,6 +994,11 @@ class VIMap : public backend::ResourceMap,
   mutable std::default_random_engine generator_;
 
   mutable std::recursive_mutex resource_mutex_;
+
+  mutable std::unordered_map<
+      vi_map::MissionId, std::shared_ptr<const MissionTraversal>>
+      mission_traversals_;
+  mutable std::mutex mission_traversals_mutex_;
 };
 
 }  // namespace vi_map
@@ -824,7 +1009,16 @@ template <typename MapType>
 class MapManager;
 
 template <>
-struct traits<vi_map::VIMap> : public MapTraits<vi_map::VIMap> {};
+struct traits<vi_map::VIMap> : public MapTraits<vi_map::VIMap> {
+  static size_t getMemoryUsageBytes(const vi_map::VIMap& map) {
+    vi_map::MapMemoryUsage usage;
+    map.getMemoryUsage(&usage);
+    return usage.getTotalBytes();
+  }
+  static void releaseUnreferencedMemory(vi_map::VIMap* map) {
+    CHECK_NOTNULL(map)->releaseVertexPayloadsOverBudget();
+  }
+};
 
 }  // namespace backend
 
@@ -2,6 +2,7 @@
 #define VI_MAP_VIWLS_EDGE_H_
 #include <string>
 
+#include <maplab-common/memory-usage.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/traits.h>
 
@@ -34,6 +35,12 @@ class ViwlsEdge : public vi_map::Edge {
 
   virtual ~ViwlsEdge() {}
 
+  size_t memoryUsageBytes() const override {
+    return sizeof(ViwlsEdge) +
+           common::getHeapMemoryUsageBytes(imu_timestamps_) +
+           common::getHeapMemoryUsageBytes(imu_data_);
+  }
+
   void serialize(vi_map::proto::ViwlsEdge* proto) const;
   void deserialize(
       const pose_graph::EdgeId& id, const vi_map::proto::ViwlsEdge& proto);
@@ -1,38 +1,20 @@
 #include <vi-map/check-map-consistency.h>
 
+#include <atomic>
+#include <functional>
 #include <unordered_map>
+#include <vector>
 
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map {
 
-/// Checks whether a given vertex is a GPS reference vertex.
-/// GPS reference vertices have no incoming edges and only GPS outgoing edges,
-/// of which at least one.
-bool isGpsReferenceVertex(
-    const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id) {
-  pose_graph::EdgeIdSet incoming_edges;
-  pose_graph::EdgeIdSet outgoing_edges;
-  vi_map.getVertex(vertex_id).getIncomingEdges(&incoming_edges);
-  vi_map.getVertex(vertex_id).getOutgoingEdges(&outgoing_edges);
-
-  if ((!incoming_edges.empty()) || (outgoing_edges.empty())) {
-    return false;
-  }
-
-  for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
-    if (vi_map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::k6DoFGps) {
-      return false;
-    }
-  }
-  return true;
-}
+namespace {
 
-bool checkMapConsistency(const vi_map::VIMap& vi_map) {
+bool checkMissions(const vi_map::VIMap& vi_map) {
   bool is_consistent = true;
-  // Verify that every mission has a valid base-frame.
-  LOG(INFO) << "Verifying mission base-frames...";
-
   const SensorManager& sensor_manager = vi_map.getSensorManager();
 
   vi_map::MissionIdList mission_ids;
@@ -82,9 +64,11 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
       continue;
     }
   }
-  LOG_IF(INFO, is_consistent) << "OK.";
+  return is_consistent;
+}
 
-  LOG(INFO) << "Verifying  map vertices and edges...";
+bool checkVerticesAndEdgesExist(const vi_map::VIMap& vi_map) {
+  bool is_consistent = true;
   pose_graph::VertexIdList all_vertices;
   vi_map.getAllVertexIds(&all_vertices);
   for (const pose_graph::VertexId& vertex_id : all_vertices) {
@@ -105,342 +89,314 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
       continue;
     }
   }
-  LOG_IF(INFO, is_consistent) << "OK.";
+  return is_consistent;
+}
 
-  // Verify that all landmark IDs in the map are valid.
-  LOG(INFO) << "Verifying landmark validity...";
-  vi_map::LandmarkIdList all_landmark_ids;
-  vi_map.getAllLandmarkIds(&all_landmark_ids);
+// Returns nullptr if the landmark index or the store of the landmark is
+// broken, this is reported by checkLandmark.
+const vi_map::Landmark* findLandmark(
+    const vi_map::VIMap& vi_map, const vi_map::LandmarkId& landmark_id) {
+  if (!vi_map.hasLandmark(landmark_id)) {
+    return nullptr;
+  }
+  const pose_graph::VertexId& storing_vertex_id =
+      vi_map.getLandmarkStoreVertexId(landmark_id);
+  if (!vi_map.hasVertex(storing_vertex_id)) {
+    return nullptr;
+  }
+  const vi_map::LandmarkStore& landmark_store =
+      vi_map.getVertex(storing_vertex_id).getLandmarks();
+  if (!landmark_store.hasLandmark(landmark_id)) {
+    return nullptr;
+  }
+  return &landmark_store.getLandmark(landmark_id);
+}
 
-  // Build a list of landmarks that we expect to find in every vertex, so
-  // we can then check every vertex in batch for its landmarks which is more
-  // cache efficient.
-  typedef std::unordered_map<pose_graph::VertexId,
-                             std::vector<vi_map::LandmarkId> >
-      ExpectedVertexLandmarks;
-  ExpectedVertexLandmarks vertex_expected_landmarks;
-
-  for (const vi_map::LandmarkId& landmark_id : all_landmark_ids) {
-    if (!vi_map.hasLandmark(landmark_id)) {
-      LOG(ERROR) << "Vi map claims to have global landmark " << landmark_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
+// Verifies the landmark index entry of the landmark, its store and that every
+// observation it lists is an observation of this landmark in the observer
+// vertex.
+bool checkLandmark(
+    const vi_map::VIMap& vi_map, const vi_map::LandmarkId& landmark_id) {
+  if (!vi_map.hasLandmark(landmark_id)) {
+    LOG(ERROR) << "Vi map claims to have global landmark " << landmark_id
+               << " but then returns false when retrieving it.";
+    return false;
+  }
 
-    const pose_graph::VertexId& storing_vertex_id =
-        vi_map.getLandmarkStoreVertexId(landmark_id);
+  const pose_graph::VertexId& storing_vertex_id =
+      vi_map.getLandmarkStoreVertexId(landmark_id);
+  if (!vi_map.hasVertex(storing_vertex_id)) {
+    LOG(ERROR) << "Landmark: " << landmark_id << " points to vertex "
+               << storing_vertex_id << " but this vertex is not in the map.";
+    return false;
+  }
 
-    if (!vi_map.hasVertex(storing_vertex_id)) {
-      LOG(ERROR) << "Landmark: " << landmark_id
-                 << " points to vertex " << storing_vertex_id
-                 << " but this vertex is not in the map.";
+  const vi_map::LandmarkStore& landmark_store =
+      vi_map.getVertex(storing_vertex_id).getLandmarks();
+  if (!landmark_store.hasLandmark(landmark_id)) {
+    LOG(ERROR) << "Landmark to vertex table claims that landmark: "
+               << landmark_id.hexString() << " resides in vertex "
+               << storing_vertex_id.hexString() << " which is not the case.";
+    return false;
+  }
+
+  bool is_consistent = true;
+  const KeypointIdentifierList& observations =
+      landmark_store.getLandmark(landmark_id).getObservations();
+  for (const KeypointIdentifier& observation : observations) {
+    const pose_graph::VertexId& observer_vertex_id =
+        observation.frame_id.vertex_id;
+    if (!vi_map.hasVertex(observer_vertex_id)) {
+      LOG(ERROR) << "Landmark " << landmark_id.hexString()
+                 << " stored in vertex " << storing_vertex_id
+                 << " lists the vertex " << observer_vertex_id
+                 << " as observer, but that vertex does not exist.";
       is_consistent = false;
       continue;
     }
 
-    vertex_expected_landmarks[storing_vertex_id].push_back(landmark_id);
-  }
-
-  // Now check all landmarks for every vertex in batch. Iterate through vertices
-  // in cache friendly order too.
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    ExpectedVertexLandmarks::const_iterator it =
-        vertex_expected_landmarks.find(vertex_id);
-    if (it == vertex_expected_landmarks.end()) {
-      LOG(WARNING) << "Skip vertex " << vertex_id << " since no landmarks.";
+    const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
+    const size_t frame_index = observation.frame_id.frame_index;
+    if (frame_index >= observer_vertex.numFrames() ||
+        observation.keypoint_index >=
+            observer_vertex.observedLandmarkIdsSize(frame_index)) {
+      LOG(ERROR) << "Keypoint index " << observation.keypoint_index
+                 << " of frame " << frame_index << " to retrieve landmark ID "
+                 << landmark_id << " in vertex " << observer_vertex_id
+                 << " is out of bounds.";
+      is_consistent = false;
       continue;
     }
-    CHECK(vi_map.hasVertex(vertex_id)) << "No vertex with id "
-                                       << vertex_id.hexString();
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-    for (const vi_map::LandmarkId& landmark_id : it->second) {
-      if (!landmark_store.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark to vertex table claims that landmark: "
-                   << landmark_id.hexString() << " resides in vertex "
-                   << vertex_id.hexString() << " which is not the case.";
-        is_consistent = false;
-      }
-    }
 
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      if (!landmark.id().isValid()) {
-        LOG(ERROR) << "Landmark stored in vertex " << vertex_id.hexString()
-                   << " has an invalid ID.";
-        is_consistent = false;
-      } else if (!vi_map.hasLandmark(landmark.id())) {
-        LOG(ERROR) << "Landmark " << landmark.id().hexString() << " stored in "
-                   << "vertex " << vertex_id.hexString() << " has no entry in "
-                   << "landmark index.";
-        is_consistent = false;
-      }
+    const vi_map::LandmarkId& observer_landmark_id =
+        observer_vertex.getObservedLandmarkId(
+            frame_index, observation.keypoint_index);
+    if (!observer_landmark_id.isValid()) {
+      LOG(ERROR) << "The store landmark id " << landmark_id.hexString()
+                 << " has a backlink to an observer that has an invalid"
+                 << " landmark ID.";
+      is_consistent = false;
+    } else if (observer_landmark_id != landmark_id) {
+      LOG(ERROR) << "The store vertex of landmark id "
+                 << landmark_id.hexString()
+                 << " and landmark id in the observer table "
+                 << observer_landmark_id.hexString() << " are inconsistent";
+      is_consistent = false;
     }
   }
+  return is_consistent;
+}
 
-  LOG_IF(INFO, is_consistent) << "OK.";
-
-  // Create a map of all vertices that have a reference to a given landmark
-  // in order to check the back-reference from landmark to vertices.
-  typedef std::unordered_multimap<vi_map::LandmarkId, pose_graph::VertexId>
-      LandmarkToVertexMap;
-  LandmarkToVertexMap landmark_observing_vertices;
-  LOG(INFO) << "Building landmark observers list...";
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (!vi_map.hasVertex(vertex_id)) {
-      LOG(ERROR) << "Vi map claims to have vertex " << vertex_id
-                 << " but then returns false when retrieving it.";
+// Verifies the visual frames and the landmark store of the vertex and that
+// every landmark observed by the vertex lists each of these observations
+// exactly once. Together with checkLandmark for all landmarks this covers
+// both directions of the landmark back-references.
+bool checkVertexLandmarks(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id) {
+  if (!vi_map.hasVertex(vertex_id)) {
+    LOG(ERROR) << "Vi map claims to have vertex " << vertex_id
+               << " but then returns false when retrieving it.";
+    return false;
+  }
+  bool is_consistent = true;
+  const Vertex& vertex = vi_map.getVertex(vertex_id);
+
+  // Verify that the Landmark IDs in the visual frame are sane:
+  // These tests look for errors that have a soft bound, the thresholds
+  // here are rather arbitrary.
+  // If we find two times the same landmark ID, how far are they allowed to
+  // be apart in image space before we warn or fail.
+  static constexpr double kImageDisparitySameLandmarkWarn = 10.;
+  static constexpr double kImageDisparitySameLandmarkError = 75;
+  // How often can the same landmark ID occur before we declare a map
+  // inconsistent.
+  static constexpr int kMaxNumSameLandmarkId = 5;
+  std::unordered_map<LandmarkId, int> appearance_count;
+  const int num_frames = vertex.numFrames();
+  for (int i = 0; i < num_frames; ++i) {
+    if (!vertex.isVisualFrameSet(i)) {
+      continue;
+    }
+    if (!vertex.getVisualFrame(i).getId().isValid()) {
+      LOG(ERROR) << "Visual frame id for frame " << i << " in vertex "
+                 << vertex_id << " is invalid.";
       is_consistent = false;
       continue;
     }
-
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-
-    for (unsigned int i = 0; i < vertex.numFrames(); ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        for (size_t j = 0; j < vertex.observedLandmarkIdsSize(i); ++j) {
-          vi_map::LandmarkId landmark_id =
-              vertex.getObservedLandmarkId(i, j);
-          if (landmark_id.isValid()) {
-            landmark_observing_vertices.emplace(landmark_id, vertex_id);
-          }
-        }
+    const int num_observed_landmarks = vertex.observedLandmarkIdsSize(i);
+    for (int j = 0; j < num_observed_landmarks; ++j) {
+      LandmarkId observed_landmark_j = vertex.getObservedLandmarkId(i, j);
+      if (!observed_landmark_j.isValid()) {
+        continue;
+      }
+      ++appearance_count[observed_landmark_j];
+      if (appearance_count[observed_landmark_j] > kMaxNumSameLandmarkId) {
+        LOG(ERROR) << "Landmark " << observed_landmark_j << " is observed "
+                   << appearance_count[observed_landmark_j]
+                   << "times in the same frame (" << vertex_id
+                   << ") which is considered an "
+                   << "error (threshold evaluates to "
+                   << kMaxNumSameLandmarkId << ").";
       }
-    }
-  }
-  LOG_IF(INFO, is_consistent) << "OK.";
 
-  LOG(INFO) << "Verifying landmark references...";
-  int num_checked = 0;
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    // Existence in map verified above.
-    const Vertex& vertex = vi_map.getVertex(vertex_id);
-
-    LOG_EVERY_N(INFO, static_cast<int>(all_vertices.size()) / 10)
-        << "Verifying vertices... "
-        << std::round(
-               static_cast<double>(num_checked + 1) / all_vertices.size() *
-               100.)
-        << "%";
-
-    // Verify that the Landmark IDs in the visual frame are sane:
-    // These tests look for errors that have a soft bound, the thresholds
-    // here are rather arbitrary.
-    // If we find two times the same landmark ID, how far are they allowed to
-    // be apart in image space before we warn or fail.
-    static constexpr double kImageDisparitySameLandmarkWarn = 10.;
-    static constexpr double kImageDisparitySameLandmarkError = 75;
-    // How often can the same landmark ID occur before we declare a map
-    // inconsistent.
-    static constexpr int kMaxNumSameLandmarkId = 5;
-    std::unordered_map<LandmarkId, int> appearance_count;
-    const int num_frames = vertex.numFrames();
-    for (int i = 0; i < num_frames; ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        if (!vertex.getVisualFrame(i).getId().isValid()) {
-          LOG(ERROR) << "Visual frame id for frame " << i << " in vertex "
-                     << vertex_id << " is invalid.";
-          is_consistent = false;
+      for (int k = j + 1; k < num_observed_landmarks; ++k) {
+        LandmarkId observed_landmark_k = vertex.getObservedLandmarkId(i, k);
+        if (!observed_landmark_k.isValid()) {
           continue;
         }
-        const int num_observed_landmarks = vertex.observedLandmarkIdsSize(i);
-        for (int j = 0; j < num_observed_landmarks; ++j) {
-          LandmarkId observed_landmark_j = vertex.getObservedLandmarkId(i, j);
-          if (!observed_landmark_j.isValid()) {
-            continue;
-          }
-          ++appearance_count[observed_landmark_j];
-          if (appearance_count[observed_landmark_j] > kMaxNumSameLandmarkId) {
-            LOG(ERROR) << "Landmark " << observed_landmark_j << " is observed "
-                       << appearance_count[observed_landmark_j]
-                       << "times in the same frame (" << vertex_id
-                       << ") which is considered an "
-                       << "error (threshold evaluates to "
-                       << kMaxNumSameLandmarkId << ").";
-          }
-
-          for (int k = j + 1; k < num_observed_landmarks; ++k) {
-            LandmarkId observed_landmark_k =
-                vertex.getObservedLandmarkId(i, k);
-            if (!observed_landmark_k.isValid()) {
-              continue;
-            }
-            if (observed_landmark_j != observed_landmark_k) {
-              continue;
-            }
-            // Same landmark id, check the distance in image space.
-            if (vertex.getVisualFrame(i).hasKeypointMeasurements()) {
-              Eigen::Matrix<double, 2, 1> measurement_i =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(j);
-              Eigen::Matrix<double, 2, 1> measurement_j =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(k);
-              double distance = (measurement_i - measurement_j).norm();
-              if (distance > kImageDisparitySameLandmarkError) {
-                LOG(ERROR) << "Landmark " << observed_landmark_j
-                           << " is observed "
-                           << " twice from the same frame (" << vertex_id
-                           << "), but the "
-                           << "observations evaluate to ["
-                           << measurement_i.transpose() << "] and ["
-                           << measurement_j.transpose() << "] (distance of "
-                           << distance << ") and threshold evaluates to "
-                           << kImageDisparitySameLandmarkError;
-                is_consistent = false;
-              } else if (distance > kImageDisparitySameLandmarkWarn) {
-                LOG(WARNING)
-                    << "Landmark " << observed_landmark_j << " is observed "
-                    << " twice from the same frame (" << vertex_id
-                    << "), but the "
-                    << "observations evaluate to [" << measurement_i.transpose()
-                    << "] and [" << measurement_j.transpose()
-                    << "] (distance of " << distance
-                    << ") and threshold evaluates to "
-                    << kImageDisparitySameLandmarkWarn;
-              }
-            }
+        if (observed_landmark_j != observed_landmark_k) {
+          continue;
+        }
+        // Same landmark id, check the distance in image space.
+        if (vertex.getVisualFrame(i).hasKeypointMeasurements()) {
+          Eigen::Matrix<double, 2, 1> measurement_i =
+              vertex.getVisualFrame(i).getKeypointMeasurement(j);
+          Eigen::Matrix<double, 2, 1> measurement_j =
+              vertex.getVisualFrame(i).getKeypointMeasurement(k);
+          double distance = (measurement_i - measurement_j).norm();
+          if (distance > kImageDisparitySameLandmarkError) {
+            LOG(ERROR) << "Landmark " << observed_landmark_j
+                       << " is observed "
+                       << " twice from the same frame (" << vertex_id
+                       << "), but the "
+                       << "observations evaluate to ["
+                       << measurement_i.transpose() << "] and ["
+                       << measurement_j.transpose() << "] (distance of "
+                       << distance << ") and threshold evaluates to "
+                       << kImageDisparitySameLandmarkError;
+            is_consistent = false;
+          } else if (distance > kImageDisparitySameLandmarkWarn) {
+            LOG(WARNING)
+                << "Landmark " << observed_landmark_j << " is observed "
+                << " twice from the same frame (" << vertex_id
+                << "), but the "
+                << "observations evaluate to [" << measurement_i.transpose()
+                << "] and [" << measurement_j.transpose()
+                << "] (distance of " << distance
+                << ") and threshold evaluates to "
+                << kImageDisparitySameLandmarkWarn;
           }
         }
       }
     }
+  }
 
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      const vi_map::LandmarkId& landmark_id = landmark.id();
-
-      // If this landmark id is non valid, it should not be in the global map.
-      if (!landmark_id.isValid()) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is invalid. Only valid landmarks should be in the "
-                      "store.";
-        is_consistent = false;
-      }
+  for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+    const vi_map::LandmarkId& landmark_id = landmark.id();
+    // If this landmark id is non valid, it should not be in the global map.
+    if (!landmark_id.isValid()) {
+      LOG(ERROR) << "Landmark stored in vertex " << vertex_id.hexString()
+                 << " has an invalid ID.";
+      is_consistent = false;
+    } else if (!vi_map.hasLandmark(landmark_id)) {
       // Every landmark in the store should be in the global map.
-      if (!vi_map.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is not found in the global map.";
-        is_consistent = false;
-      }
-
-      const KeypointIdentifierList& vertex_id_frame_idx_kp_idx =
-          landmark_store.getLandmark(landmark_id).getObservations();
-
-      // Count how often we expect to find every vertex in the backwards
-      // reference list of the current landmark.
-      std::pair<LandmarkToVertexMap::iterator,
-                LandmarkToVertexMap::iterator>
-          range = landmark_observing_vertices.equal_range(landmark_id);
-      std::unordered_map<pose_graph::VertexId, int> refound_map;
-      for (LandmarkToVertexMap::iterator it_vertex = range.first;
-           it_vertex != range.second; ++it_vertex) {
-        // Increment the number of times we expect to find this to be
-        // back-referenced from the landmarks.
-        if (refound_map.count(it_vertex->second) == 0) {
-          refound_map[it_vertex->second] = 1;
-        } else {
-          ++refound_map[it_vertex->second];
-        }
-      }
+      LOG(ERROR) << "Landmark " << landmark_id.hexString() << " stored in "
+                 << "vertex " << vertex_id.hexString() << " has no entry in "
+                 << "landmark index.";
+      is_consistent = false;
+    }
+  }
 
-      VLOG(5) << "refound map:";
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        VLOG(5) << "Back-references to vertex "
-                << observation_counts.first.hexString() << " from landmark "
-                << landmark_id.hexString() << "  " << observation_counts.second;
+  // Every observation of a landmark in this vertex needs to be listed exactly
+  // once by the landmark. That the listed observations point back to the
+  // landmark is verified by checkLandmark.
+  for (const std::pair<const LandmarkId, int>& landmark_and_count :
+       appearance_count) {
+    const vi_map::Landmark* landmark =
+        findLandmark(vi_map, landmark_and_count.first);
+    if (landmark == nullptr) {
+      continue;
+    }
+    int num_back_references = 0;
+    for (const KeypointIdentifier& observation : landmark->getObservations()) {
+      if (observation.frame_id.vertex_id == vertex_id) {
+        ++num_back_references;
       }
+    }
+    if (num_back_references != landmark_and_count.second) {
+      LOG(ERROR) << "Vertex " << vertex_id.hexString() << " observes landmark "
+                 << landmark_and_count.first.hexString() << " "
+                 << landmark_and_count.second << " times, but the landmark "
+                 << "has " << num_back_references << " back-references to "
+                 << "this vertex.";
+      is_consistent = false;
+    }
+  }
+  return is_consistent;
+}
 
-      // Check that all other observing vertices of this landmark have
-      // set the ID to the same state.
-      for (unsigned int j = 0; j < vertex_id_frame_idx_kp_idx.size(); ++j) {
-        const pose_graph::VertexId& observer_vertex_id =
-            vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id;
-        if (!vi_map.hasVertex(observer_vertex_id)) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " stored in vertex " << vertex_id
-                     << " lists the vertex " << observer_vertex_id
-                     << " as observer, but that vertex does not exist.";
-          is_consistent = false;
+bool checkLandmarksInParallel(
+    const vi_map::VIMap& vi_map, const vi_map::LandmarkIdList& landmark_ids) {
+  std::atomic<bool> is_consistent(true);
+  std::function<void(const std::vector<size_t>&)> check_shard =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          if (!checkLandmark(vi_map, landmark_ids[idx])) {
+            is_consistent = false;
+          }
         }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      landmark_ids.size(), check_shard, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+  return is_consistent;
+}
 
-        const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
-
-        // Check that we have seen this vertex before.
-        if (refound_map.count(observer_vertex_id) == 0u) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " has an unknown vertex listed as observer: "
-                     << observer_vertex_id.hexString();
-          is_consistent = false;
-        }
-        // Check that there is still an unmatched observation for this vertex.
-        if (refound_map[observer_vertex_id] <= 0) {
-          LOG(ERROR)
-              << "The landmark " << landmark_id.hexString()
-              << " has the vertex " << observer_vertex_id.hexString()
-              << " in the list of back-references, but all back-references to"
-              << " this vertex have already been matched.";
-          is_consistent = false;
-        }
-        // Mark as found.
-        --refound_map[observer_vertex_id];
-
-        if (vertex_id_frame_idx_kp_idx[j].keypoint_index >=
-            observer_vertex.observedLandmarkIdsSize(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index)) {
-          LOG(ERROR) << "Keypoint index "
-                     << vertex_id_frame_idx_kp_idx[j].keypoint_index
-                     << " to retrieve landmark ID "
-                     << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id
-                     << " is out of bounds.";
-          is_consistent = false;
-          continue;
+bool checkVerticesInParallel(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexIdList& vertex_ids) {
+  std::atomic<bool> is_consistent(true);
+  std::function<void(const std::vector<size_t>&)> check_shard =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          if (!checkVertexLandmarks(vi_map, vertex_ids[idx])) {
+            is_consistent = false;
+          }
         }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(), check_shard, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+  return is_consistent;
+}
 
-        const vi_map::LandmarkId& observer_landmark_id =
-            observer_vertex.getObservedLandmarkId(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index,
-                vertex_id_frame_idx_kp_idx[j].keypoint_index);
-        if (!observer_landmark_id.isValid()) {
-          LOG(ERROR) << "The store landmark id " << landmark_id.hexString()
-                     << " has a backlink to an observer that has an invalid"
-                     << " landmark ID.";
-          is_consistent = false;
-        } else if (
-            observer_landmark_id != landmark_id) {
-          LOG(ERROR) << "The store vertex of landmark id "
-                     << landmark_id.hexString()
-                     << " and landmark id in the observer table "
-                     << observer_landmark_id.hexString()
-                     << " are inconsistent";
-          is_consistent = false;
+bool checkPosegraphsInParallel(const vi_map::VIMap& vi_map) {
+  vi_map::MissionIdList mission_ids;
+  vi_map.getAllMissionIds(&mission_ids);
+  std::atomic<bool> is_consistent(true);
+  std::function<void(const std::vector<size_t>&)> check_missions =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          if (!checkPosegraphConsistency(vi_map, mission_ids[idx])) {
+            LOG(ERROR) << "Posegraph of mission " << mission_ids[idx]
+                       << " inconsistent.";
+            is_consistent = false;
+          }
         }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      mission_ids.size(), check_missions, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+  return is_consistent;
+}
 
-        if (landmark_id.isValid() != observer_landmark_id.isValid()) {
-          LOG(ERROR)
-              << "The valid state of corresponding landmarks stored in vertex "
-              << vertex_id.hexString() << " and "
-              << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id.hexString()
-              << " are inconsistent";
-          is_consistent = false;
-        }
-      }
+bool checkStructure(const vi_map::VIMap& vi_map) {
+  bool is_consistent = true;
+  LOG(INFO) << "Verifying mission base-frames...";
+  if (!checkMissions(vi_map)) {
+    is_consistent = false;
+  } else {
+    LOG(INFO) << "OK.";
+  }
 
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        if (observation_counts.second != 0) {
-          LOG(ERROR) << "Back-references to vertex "
-                     << observation_counts.first.hexString()
-                     << " missing in the list of back-references of landmark "
-                     << landmark_id.hexString();
-          is_consistent = false;
-        }
-      }
-    }
-    ++num_checked;
+  LOG(INFO) << "Verifying  map vertices and edges...";
+  if (!checkVerticesAndEdgesExist(vi_map)) {
+    is_consistent = false;
+  } else {
+    LOG(INFO) << "OK.";
   }
-  LOG_IF(INFO, is_consistent) << "OK.";
 
   LOG(INFO) << "Verifying sensor consistency...";
   if (!checkSensorConsistency(vi_map)) {
@@ -451,21 +407,10 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   }
 
   LOG(INFO) << "Verifying posegraph consistency for each mission...";
-  for (const vi_map::MissionId& mission_id : mission_ids) {
-    LOG(INFO) << "Verifying mission: " << mission_id << "...";
-    if (!vi_map.hasMission(mission_id)) {
-      LOG(ERROR) << "Vi map claims to have mission " << mission_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-
-    if (!checkPosegraphConsistency(vi_map, mission_id)) {
-      LOG(ERROR) << "Posegraph inconsistent.";
-      is_consistent = false;
-    } else {
-      LOG(INFO) << "OK.";
-    }
+  if (!checkPosegraphsInParallel(vi_map)) {
+    is_consistent = false;
+  } else {
+    LOG(INFO) << "OK.";
   }
 
   LOG(INFO) << "Looking for orphaned posegraph items...";
@@ -475,6 +420,27 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   } else {
     LOG(INFO) << "OK.";
   }
+  return is_consistent;
+}
+
+bool checkLandmarksAndResources(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexIdList& vertex_ids,
+    const vi_map::LandmarkIdList& landmark_ids) {
+  bool is_consistent = true;
+  LOG(INFO) << "Verifying " << landmark_ids.size() << " landmarks...";
+  if (!checkLandmarksInParallel(vi_map, landmark_ids)) {
+    is_consistent = false;
+  } else {
+    LOG(INFO) << "OK.";
+  }
+
+  LOG(INFO) << "Verifying landmark references of " << vertex_ids.size()
+            << " vertices...";
+  if (!checkVerticesInParallel(vi_map, vertex_ids)) {
+    is_consistent = false;
+  } else {
+    LOG(INFO) << "OK.";
+  }
 
   LOG(INFO) << "Verifying resource consistency...";
   if (!vi_map.checkResourceConsistency()) {
@@ -483,7 +449,129 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   } else {
     LOG(INFO) << "OK.";
   }
+  return is_consistent;
+}
+
+}  // namespace
 
+/// Checks whether a given vertex is a GPS reference vertex.
+/// GPS reference vertices have no incoming edges and only GPS outgoing edges,
+/// of which at least one.
+bool isGpsReferenceVertex(
+    const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id) {
+  pose_graph::EdgeIdSet incoming_edges;
+  pose_graph::EdgeIdSet outgoing_edges;
+  vi_map.getVertex(vertex_id).getIncomingEdges(&incoming_edges);
+  vi_map.getVertex(vertex_id).getOutgoingEdges(&outgoing_edges);
+
+  if ((!incoming_edges.empty()) || (outgoing_edges.empty())) {
+    return false;
+  }
+
+  for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+    if (vi_map.getEdgeType(edge_id) != pose_graph::Edge::EdgeType::k6DoFGps) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool checkMapConsistency(const vi_map::VIMap& vi_map) {
+  return checkMapConsistency(vi_map, MapConsistencyCheckLevel::kFull);
+}
+
+bool checkMapConsistency(
+    const vi_map::VIMap& vi_map, const MapConsistencyCheckLevel level) {
+  bool is_consistent = checkStructure(vi_map);
+  if (level == MapConsistencyCheckLevel::kStructuralOnly) {
+    return is_consistent;
+  }
+
+  pose_graph::VertexIdList all_vertex_ids;
+  vi_map.getAllVertexIds(&all_vertex_ids);
+  vi_map::LandmarkIdList all_landmark_ids;
+  vi_map.getAllLandmarkIds(&all_landmark_ids);
+  if (!checkLandmarksAndResources(vi_map, all_vertex_ids, all_landmark_ids)) {
+    is_consistent = false;
+  }
+  return is_consistent;
+}
+
+IncrementalMapConsistencyChecker::IncrementalMapConsistencyChecker(
+    const vi_map::VIMap& vi_map)
+    : vi_map_(vi_map), needs_full_check_(true) {}
+
+void IncrementalMapConsistencyChecker::markVertexTouched(
+    const pose_graph::VertexId& vertex_id) {
+  CHECK(vertex_id.isValid());
+  touched_vertex_ids_.emplace(vertex_id);
+}
+
+void IncrementalMapConsistencyChecker::markLandmarkTouched(
+    const vi_map::LandmarkId& landmark_id) {
+  CHECK(landmark_id.isValid());
+  touched_landmark_ids_.emplace(landmark_id);
+}
+
+void IncrementalMapConsistencyChecker::reset() {
+  needs_full_check_ = true;
+  touched_vertex_ids_.clear();
+  touched_landmark_ids_.clear();
+}
+
+bool IncrementalMapConsistencyChecker::check(
+    const MapConsistencyCheckLevel level) {
+  if (needs_full_check_) {
+    const bool is_consistent = checkMapConsistency(vi_map_, level);
+    if (is_consistent && level == MapConsistencyCheckLevel::kFull) {
+      needs_full_check_ = false;
+      touched_vertex_ids_.clear();
+      touched_landmark_ids_.clear();
+    }
+    return is_consistent;
+  }
+
+  bool is_consistent = checkStructure(vi_map_);
+  if (level == MapConsistencyCheckLevel::kStructuralOnly) {
+    return is_consistent;
+  }
+
+  // Removed items can't be checked anymore, the items that referenced them
+  // need to be marked as touched instead.
+  vi_map::LandmarkIdList landmark_ids;
+  pose_graph::VertexIdSet vertex_ids_to_check;
+  for (const vi_map::LandmarkId& landmark_id : touched_landmark_ids_) {
+    const vi_map::Landmark* landmark = findLandmark(vi_map_, landmark_id);
+    if (landmark == nullptr && !vi_map_.hasLandmark(landmark_id)) {
+      continue;
+    }
+    landmark_ids.emplace_back(landmark_id);
+    // A changed observation list needs to be verified against the observation
+    // counts of the observers.
+    if (landmark != nullptr) {
+      for (const KeypointIdentifier& observation :
+           landmark->getObservations()) {
+        if (vi_map_.hasVertex(observation.frame_id.vertex_id)) {
+          vertex_ids_to_check.emplace(observation.frame_id.vertex_id);
+        }
+      }
+    }
+  }
+  for (const pose_graph::VertexId& vertex_id : touched_vertex_ids_) {
+    if (vi_map_.hasVertex(vertex_id)) {
+      vertex_ids_to_check.emplace(vertex_id);
+    }
+  }
+  const pose_graph::VertexIdList vertex_ids(
+      vertex_ids_to_check.begin(), vertex_ids_to_check.end());
+
+  if (!checkLandmarksAndResources(vi_map_, vertex_ids, landmark_ids)) {
+    is_consistent = false;
+  }
+  if (is_consistent) {
+    touched_vertex_ids_.clear();
+    touched_landmark_ids_.clear();
+  }
   return is_consistent;
 }
 
@@ -0,0 +1,132 @@
+#include "vi-map/landmark-covariance.h"
+
+#include <mutex>
+
+#include <glog/logging.h>
+#include <posegraph/object-pool-inl.h>
+#include <posegraph/object-pool.h>
+
+namespace vi_map {
+namespace {
+
+// Chunks of 64k covariances, i.e. 1.5 MB each.
+constexpr size_t kNumCovariancesPerChunk = 1u << 16;
+typedef pose_graph::AlignedObjectPool<
+    LandmarkCovariance::PackedCovariance, kNumCovariancesPerChunk>
+    CovariancePool;
+
+// Intentionally leaked, such that landmarks in static storage can still
+// release their covariance on exit.
+CovariancePool& getPool() {
+  static CovariancePool* pool = new CovariancePool;
+  return *pool;
+}
+
+std::mutex& getPoolMutex() {
+  static std::mutex* mutex = new std::mutex;
+  return *mutex;
+}
+
+LandmarkCovariance::PackedCovariance* allocatePacked() {
+  std::lock_guard<std::mutex> lock(getPoolMutex());
+  return getPool().construct();
+}
+
+void releasePacked(LandmarkCovariance::PackedCovariance* packed) {
+  std::lock_guard<std::mutex> lock(getPoolMutex());
+  getPool().destroy(packed);
+}
+
+}  // namespace
+
+LandmarkCovariance::LandmarkCovariance(const Eigen::Matrix3d& covariance)
+    : packed_(nullptr) {
+  set(covariance);
+}
+
+LandmarkCovariance::LandmarkCovariance(const LandmarkCovariance& other)
+    : packed_(nullptr) {
+  *this = other;
+}
+
+LandmarkCovariance::LandmarkCovariance(LandmarkCovariance&& other)
+    : packed_(other.packed_) {
+  other.packed_ = nullptr;
+}
+
+LandmarkCovariance& LandmarkCovariance::operator=(
+    const LandmarkCovariance& other) {
+  if (this == &other) {
+    return *this;
+  }
+  if (other.packed_ == nullptr) {
+    reset();
+    return *this;
+  }
+  if (packed_ == nullptr) {
+    packed_ = allocatePacked();
+  }
+  *packed_ = *other.packed_;
+  return *this;
+}
+
+LandmarkCovariance& LandmarkCovariance::operator=(LandmarkCovariance&& other) {
+  if (this != &other) {
+    reset();
+    packed_ = other.packed_;
+    other.packed_ = nullptr;
+  }
+  return *this;
+}
+
+LandmarkCovariance::~LandmarkCovariance() {
+  reset();
+}
+
+void LandmarkCovariance::set(const Eigen::Matrix3d& covariance) {
+  if (packed_ == nullptr) {
+    packed_ = allocatePacked();
+  }
+  size_t idx = 0u;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = row; col < 3; ++col) {
+      (*packed_)[idx++] = static_cast<float>(covariance(row, col));
+    }
+  }
+}
+
+void LandmarkCovariance::get(Eigen::Matrix3d* covariance) const {
+  CHECK_NOTNULL(covariance);
+  CHECK(packed_ != nullptr);
+  size_t idx = 0u;
+  for (int row = 0; row < 3; ++row) {
+    for (int col = row; col < 3; ++col) {
+      (*covariance)(row, col) = (*packed_)[idx];
+      (*covariance)(col, row) = (*packed_)[idx];
+      ++idx;
+    }
+  }
+}
+
+void LandmarkCovariance::reset() {
+  if (packed_ != nullptr) {
+    releasePacked(packed_);
+    packed_ = nullptr;
+  }
+}
+
+bool LandmarkCovariance::operator==(const LandmarkCovariance& other) const {
+  if (packed_ == nullptr || other.packed_ == nullptr) {
+    return packed_ == other.packed_;
+  }
+  return *packed_ == *other.packed_;
+}
+
+size_t LandmarkCovariance::numPooledCovariances() {
+  std::lock_guard<std::mutex> lock(getPoolMutex());
+  return getPool().size();
+}
+
+constexpr size_t LandmarkCovariance::kMemoryUsageBytes;
+
+}  // namespace vi_map
@@ -0,0 +1,15 @@
+#include "vi-map/landmark-index.h"
+
+#include <atomic>
+
+namespace vi_map {
+
+namespace {
+std::atomic<uint64_t> next_landmark_revision(1u);
+}  // namespace
+
+void LandmarkIndex::updateRevision() {
+  revision_ = next_landmark_revision++;
+}
+
+}  // namespace vi_map
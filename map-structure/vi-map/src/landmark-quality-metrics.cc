@@ -71,27 +71,44 @@ bool isLandmarkWellConstrained(
     return false;
   }
 
-  const Eigen::Vector3d& p_G_fi = map.getLandmark_G_p_fi(landmark.id());
-  Aligned<std::vector, Eigen::Vector3d> G_normalized_incidence_rays;
-  G_normalized_incidence_rays.reserve(backlinks.size());
-  double signed_distance_to_closest_observer =
-      std::numeric_limits<double>::max();
+  Aligned<std::vector, pose::Transformation> observers_T_G_C;
+  observers_T_G_C.reserve(backlinks.size());
   for (const vi_map::KeypointIdentifier& backlink : backlinks) {
     const vi_map::Vertex& vertex = map.getVertex(backlink.frame_id.vertex_id);
-
-    const pose::Transformation T_G_C =
+    observers_T_G_C.emplace_back(
         map.getVertex_T_G_I(backlink.frame_id.vertex_id) *
         map.getSensorManager()
             .getNCameraForMission(vertex.getMissionId())
             .get_T_C_B(backlink.frame_id.frame_index)
-            .inverse();
+            .inverse());
+  }
 
-    const Eigen::Vector3d p_C_fi = map.getLandmark_p_C_fi(
-        landmark.id(), vertex, backlink.frame_id.frame_index);
+  return isLandmarkWellConstrained(
+      map.getLandmark_G_p_fi(landmark.id()), observers_T_G_C, settings);
+}
+
+bool isLandmarkWellConstrained(
+    const Eigen::Vector3d& p_G_fi,
+    const Aligned<std::vector, pose::Transformation>& observers_T_G_C,
+    const LandmarkWellConstrainedSettings& settings) {
+  if (observers_T_G_C.size() < settings.min_observers) {
+    statistics::StatsCollector stats("Landmark has too few backlinks");
+    stats.IncrementOne();
+    return false;
+  }
+
+  Aligned<std::vector, Eigen::Vector3d> G_normalized_incidence_rays;
+  G_normalized_incidence_rays.reserve(observers_T_G_C.size());
+  double signed_distance_to_closest_observer =
+      std::numeric_limits<double>::max();
+  for (const pose::Transformation& T_G_C : observers_T_G_C) {
     const Eigen::Vector3d G_incidence_ray = T_G_C.getPosition() - p_G_fi;
 
+    // The landmark is behind the camera if the depth of p_C_fi is negative.
+    const double depth =
+        -T_G_C.getRotationMatrix().col(2).dot(G_incidence_ray);
     const double distance = G_incidence_ray.norm();
-    const double signed_distance = distance * (p_C_fi(2) < 0.0 ? -1.0 : 1.0);
+    const double signed_distance = distance * (depth < 0.0 ? -1.0 : 1.0);
     signed_distance_to_closest_observer =
         std::min(signed_distance_to_closest_observer, signed_distance);
 
@@ -1,92 +1,149 @@
 #include <vi-map/landmark-store.h>
 
+#include <algorithm>
+
 #include <glog/logging.h>
+#include <maplab-common/memory-usage.h>
 
 namespace vi_map {
 
-double* LandmarkStore::get_p_B_Mutable(const LandmarkId& landmark_id) {
-  LandmarkIdToIdxMap::const_iterator it;
-  it = landmark_id_map_.find(landmark_id);
-  CHECK(it != landmark_id_map_.end());
+LandmarkStore::LandmarkStore() : storage_(std::make_shared<Storage>()) {}
 
-  return landmarks_[it->second].get_p_B_Mutable();
+LandmarkStore::Storage& LandmarkStore::getMutableStorage() {
+  CHECK(storage_);
+  if (storage_.use_count() > 1) {
+    storage_ = std::make_shared<Storage>(*storage_);
+  }
+  return *storage_;
+}
+
+double* LandmarkStore::get_p_B_Mutable(const LandmarkId& landmark_id) {
+  return getLandmark(landmark_id).get_p_B_Mutable();
 }
 
 Landmark& LandmarkStore::getLandmark(const LandmarkId& landmark_id) {
+  Storage& storage = getMutableStorage();
   LandmarkIdToIdxMap::const_iterator it;
-  it = landmark_id_map_.find(landmark_id);
-  CHECK(it != landmark_id_map_.end());
+  it = storage.landmark_id_map.find(landmark_id);
+  CHECK(it != storage.landmark_id_map.end());
 
-  return landmarks_[it->second];
+  return storage.landmarks[it->second];
 }
 
 const Landmark& LandmarkStore::getLandmark(
     const LandmarkId& landmark_id) const {
   LandmarkIdToIdxMap::const_iterator it;
-  it = landmark_id_map_.find(landmark_id);
-  CHECK(it != landmark_id_map_.end());
-  CHECK_LT(static_cast<unsigned int>(it->second), landmarks_.size());
-  return landmarks_[it->second];
+  it = storage_->landmark_id_map.find(landmark_id);
+  CHECK(it != storage_->landmark_id_map.end());
+  CHECK_LT(
+      static_cast<unsigned int>(it->second), storage_->landmarks.size());
+  return storage_->landmarks[it->second];
 }
 
 void LandmarkStore::addLandmark(const Landmark& landmark) {
-  const unsigned int idx = landmarks_.size();
-  landmarks_.push_back(landmark);
-  landmark_id_map_.insert(std::make_pair(landmark.id(), idx));
-  CHECK_EQ(landmarks_.size(), landmark_id_map_.size());
+  Storage& storage = getMutableStorage();
+  const unsigned int idx = storage.landmarks.size();
+  storage.landmarks.push_back(landmark);
+  storage.landmark_id_map.insert(std::make_pair(landmark.id(), idx));
+  CHECK_EQ(storage.landmarks.size(), storage.landmark_id_map.size());
 }
 
 bool LandmarkStore::hasLandmark(const LandmarkId& landmark_id) const {
-  return landmark_id_map_.count(landmark_id);
+  return storage_->landmark_id_map.count(landmark_id);
 }
 
 unsigned int LandmarkStore::size() const {
-  return landmarks_.size();
+  return storage_->landmarks.size();
+}
+
+size_t LandmarkStore::memoryUsageBytes() const {
+  size_t num_bytes = sizeof(Storage) +
+                     storage_->landmark_id_map.memoryUsageBytes() +
+                     common::getHeapMemoryUsageBytes(storage_->landmarks);
+  for (const Landmark& landmark : storage_->landmarks) {
+    num_bytes += landmark.memoryUsageBytes();
+  }
+  return num_bytes;
 }
 
 void LandmarkStore::removeLandmark(const LandmarkId& landmark_id) {
+  Storage& storage = getMutableStorage();
+  LandmarkIdToIdxMap& landmark_id_map = storage.landmark_id_map;
+  LandmarkVector& landmarks = storage.landmarks;
   LandmarkIdToIdxMap::const_iterator it;
-  it = landmark_id_map_.find(landmark_id);
-  CHECK(it != landmark_id_map_.end());
+  it = landmark_id_map.find(landmark_id);
+  CHECK(it != landmark_id_map.end());
   const unsigned int erased_landmark_index = it->second;
-  landmark_id_map_.erase(landmark_id);
-  landmarks_.erase(landmarks_.begin() + erased_landmark_index);
+  landmark_id_map.erase(landmark_id);
+  landmarks.erase(landmarks.begin() + erased_landmark_index);
 
   // Update all the subsequent landmark index entries on the map (only if
   // it was not a last entry).
   if (static_cast<unsigned int>(erased_landmark_index) <=
-      (landmarks_.size() - 1)) {
-    for (unsigned int i = erased_landmark_index; i < landmarks_.size(); ++i) {
+      (landmarks.size() - 1)) {
+    for (unsigned int i = erased_landmark_index; i < landmarks.size(); ++i) {
       LandmarkIdToIdxMap::iterator it;
-      it = landmark_id_map_.find(landmarks_[i].id());
-      CHECK(it != landmark_id_map_.end());
+      it = landmark_id_map.find(landmarks[i].id());
+      CHECK(it != landmark_id_map.end());
       it->second = i;
     }
   }
-  CHECK_EQ(landmarks_.size(), landmark_id_map_.size());
+  CHECK_EQ(landmarks.size(), landmark_id_map.size());
+}
+
+size_t LandmarkStore::removeLandmarks(const LandmarkIdSet& landmark_ids) {
+  // Don't copy shared landmarks if there is nothing to remove.
+  const bool has_landmark_to_remove = std::any_of(
+      storage_->landmarks.cbegin(), storage_->landmarks.cend(),
+      [&landmark_ids](const Landmark& landmark) {
+        return landmark_ids.count(landmark.id()) > 0u;
+      });
+  if (!has_landmark_to_remove) {
+    return 0u;
+  }
+  Storage& storage = getMutableStorage();
+  LandmarkIdToIdxMap& landmark_id_map = storage.landmark_id_map;
+  LandmarkVector& landmarks = storage.landmarks;
+
+  // Compact the remaining landmarks and only then rebuild their indices.
+  const size_t num_landmarks_before = landmarks.size();
+  landmarks.erase(
+      std::remove_if(
+          landmarks.begin(), landmarks.end(),
+          [&landmark_ids](const Landmark& landmark) {
+            return landmark_ids.count(landmark.id()) > 0u;
+          }),
+      landmarks.end());
+  landmark_id_map.clear();
+  for (size_t i = 0u; i < landmarks.size(); ++i) {
+    landmark_id_map.emplace(landmarks[i].id(), static_cast<int>(i));
+  }
+  CHECK_EQ(landmarks.size(), landmark_id_map.size());
+  return num_landmarks_before - landmarks.size();
 }
 
 void LandmarkStore::serialize(vi_map::proto::LandmarkStore* proto) const {
   CHECK_NOTNULL(proto);
 
-  const size_t landmarks_size = landmarks_.size();
+  const size_t landmarks_size = storage_->landmarks.size();
   google::protobuf::RepeatedPtrField<vi_map::proto::Landmark>* proto_landmarks =
       proto->mutable_landmarks();
   proto_landmarks->Reserve(landmarks_size);
-  for (const Landmark& landmark : landmarks_) {
+  for (const Landmark& landmark : storage_->landmarks) {
     landmark.serialize(proto_landmarks->Add());
   }
   CHECK_EQ(static_cast<unsigned int>(proto->landmarks_size()), landmarks_size);
 }
 
 void LandmarkStore::deserialize(const vi_map::proto::LandmarkStore& proto) {
-  landmarks_.resize(proto.landmarks_size());
+  Storage& storage = getMutableStorage();
+  storage.landmarks.resize(proto.landmarks_size());
   for (int i = 0; i < proto.landmarks_size(); ++i) {
     Landmark landmark;
     landmark.deserialize(proto.landmarks(i));
 
-    landmarks_[i] = landmark;
-    landmark_id_map_.emplace(landmark.id(), i);
+    storage.landmarks[i] = landmark;
+    storage.landmark_id_map.emplace(landmark.id(), i);
   }
 }
 
@@ -4,6 +4,9 @@
 #include <utility>
 
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/memory-usage.h>
+
+#include "vi-map/map-format-version.h"
 
 namespace vi_map {
 
@@ -13,15 +16,6 @@ double* Landmark::get_p_B_Mutable() {
   return B_position_.data();
 }
 
-double* Landmark::get_p_B_CovarianceMutable() {
-  // Allocate memory for the covariance if it wasn't yet set.
-  if (B_covariance_ == nullptr) {
-    B_covariance_ = aligned_unique<Eigen::Matrix3d>();
-    B_covariance_->setIdentity();
-  }
-  return B_covariance_->data();
-}
-
 void Landmark::addObservation(
     const pose_graph::VertexId& vertex_id, unsigned int frame_idx,
     unsigned int keypoint_index) {
@@ -248,18 +242,30 @@ void Landmark::serialize(vi_map::proto::Landmark* proto) const {
 
   {
     const size_t num_observations = observations_.size();
+    const bool write_packed_ids = serialization::shouldWritePackedIds();
     google::protobuf::RepeatedPtrField<common::proto::Id>* vertex_ids_proto =
         proto->mutable_vertex_ids();
+    google::protobuf::RepeatedField<google::protobuf::uint64>*
+        packed_vertex_ids_proto = proto->mutable_vertex_ids_packed();
     google::protobuf::RepeatedField<google::protobuf::uint32>*
         frame_indices_proto = proto->mutable_frame_indices();
     google::protobuf::RepeatedField<google::protobuf::uint32>*
         keypoint_indices_proto = proto->mutable_keypoint_indices();
-    vertex_ids_proto->Reserve(num_observations);
+    if (write_packed_ids) {
+      packed_vertex_ids_proto->Reserve(
+          common::kNumWordsPerPackedId * num_observations);
+    } else {
+      vertex_ids_proto->Reserve(num_observations);
+    }
     frame_indices_proto->Reserve(num_observations);
     keypoint_indices_proto->Reserve(num_observations);
     for (unsigned int i = 0u; i < num_observations; ++i) {
       const KeypointIdentifier& observation = observations_[i];
-      observation.frame_id.vertex_id.serialize(vertex_ids_proto->Add());
+      if (write_packed_ids) {
+        observation.frame_id.vertex_id.serialize(packed_vertex_ids_proto);
+      } else {
+        observation.frame_id.vertex_id.serialize(vertex_ids_proto->Add());
+      }
       frame_indices_proto->Add(observation.frame_id.frame_index);
       keypoint_indices_proto->Add(observation.keypoint_index);
     }
@@ -278,8 +284,10 @@ void Landmark::serialize(vi_map::proto::Landmark* proto) const {
 
   common::eigen_proto::serialize(B_position_, proto->mutable_position());
   // Serialize the covariance if it is set.
-  if (B_covariance_ != nullptr) {
-    common::eigen_proto::serialize(*B_covariance_, proto->mutable_covariance());
+  if (B_covariance_.isSet()) {
+    Eigen::Matrix3d covariance;
+    B_covariance_.get(&covariance);
+    common::eigen_proto::serialize(covariance, proto->mutable_covariance());
   }
 
   switch (quality_) {
@@ -318,12 +326,20 @@ const std::vector<int>& Landmark::getAppearances() const {
 void Landmark::deserialize(const vi_map::proto::Landmark& proto) {
   id_.deserialize(proto.id());
 
-  CHECK_EQ(proto.vertex_ids_size(), proto.keypoint_indices_size());
+  const bool has_packed_vertex_ids = proto.vertex_ids_packed_size() > 0;
+  CHECK_EQ(
+      has_packed_vertex_ids ? common::getNumPackedIds(proto.vertex_ids_packed())
+                            : proto.vertex_ids_size(),
+      proto.keypoint_indices_size());
 
   observations_.resize(proto.keypoint_indices_size());
   for (int i = 0; i < proto.keypoint_indices_size(); ++i) {
     KeypointIdentifier backlink;
-    backlink.frame_id.vertex_id.deserialize(proto.vertex_ids(i));
+    if (has_packed_vertex_ids) {
+      backlink.frame_id.vertex_id.deserialize(proto.vertex_ids_packed(), i);
+    } else {
+      backlink.frame_id.vertex_id.deserialize(proto.vertex_ids(i));
+    }
     backlink.keypoint_index = proto.keypoint_indices(i);
 
     CHECK_GT(proto.frame_indices_size(), 0)
@@ -366,12 +382,18 @@ void Landmark::deserialize(const vi_map::proto::Landmark& proto) {
 
   // Deserialize the covariance if it is set.
   if (proto.covariance_size() > 0) {
-    // Allocate the covariance memory if needed.
-    if (B_covariance_ == nullptr) {
-      B_covariance_ = aligned_unique<Eigen::Matrix3d>();
-    }
-    common::eigen_proto::deserialize(
-        proto.covariance(), CHECK_NOTNULL(B_covariance_.get()));
+    Eigen::Matrix3d covariance;
+    common::eigen_proto::deserialize(proto.covariance(), &covariance);
+    B_covariance_.set(covariance);
+  }
+}
+
+size_t Landmark::memoryUsageBytes() const {
+  size_t num_bytes = common::getHeapMemoryUsageBytes(observations_) +
+                     common::getHeapMemoryUsageBytes(appearances_);
+  if (B_covariance_.isSet()) {
+    num_bytes += LandmarkCovariance::kMemoryUsageBytes;
   }
+  return num_bytes;
 }
 }  // namespace vi_map
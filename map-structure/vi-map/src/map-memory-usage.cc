@@ -0,0 +1,54 @@
+#include "vi-map/map-memory-usage.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace vi_map {
+namespace {
+
+void printComponent(
+    const std::string& name, const size_t num_bytes, std::stringstream* ss) {
+  constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+  *ss << "  " << std::left << std::setw(24) << (name + ":") << std::right
+      << std::fixed << std::setprecision(2) << std::setw(12)
+      << num_bytes / kBytesPerMegabyte << " MiB\n";
+}
+
+}  // namespace
+
+size_t MapMemoryUsage::getTotalBytes() const {
+  return vertex_bytes + descriptor_bytes + keypoint_bytes + image_bytes +
+         observation_bytes + landmark_bytes + imu_edge_bytes +
+         other_edge_bytes + optional_sensor_data_bytes + resource_cache_bytes;
+}
+
+void MapMemoryUsage::accumulate(const MapMemoryUsage& other) {
+  vertex_bytes += other.vertex_bytes;
+  descriptor_bytes += other.descriptor_bytes;
+  keypoint_bytes += other.keypoint_bytes;
+  image_bytes += other.image_bytes;
+  observation_bytes += other.observation_bytes;
+  landmark_bytes += other.landmark_bytes;
+  imu_edge_bytes += other.imu_edge_bytes;
+  other_edge_bytes += other.other_edge_bytes;
+  optional_sensor_data_bytes += other.optional_sensor_data_bytes;
+  resource_cache_bytes += other.resource_cache_bytes;
+}
+
+std::string MapMemoryUsage::print() const {
+  std::stringstream ss;
+  printComponent("Vertices", vertex_bytes, &ss);
+  printComponent("Descriptors", descriptor_bytes, &ss);
+  printComponent("Keypoints", keypoint_bytes, &ss);
+  printComponent("Images", image_bytes, &ss);
+  printComponent("Observations", observation_bytes, &ss);
+  printComponent("Landmarks", landmark_bytes, &ss);
+  printComponent("IMU edges", imu_edge_bytes, &ss);
+  printComponent("Other edges", other_edge_bytes, &ss);
+  printComponent("Optional sensor data", optional_sensor_data_bytes, &ss);
+  printComponent("Resource cache", resource_cache_bytes, &ss);
+  printComponent("Total", getTotalBytes(), &ss);
+  return ss.str();
+}
+
+}  // namespace vi_map
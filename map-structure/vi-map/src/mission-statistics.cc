@@ -0,0 +1,68 @@
+#include "vi-map/mission-statistics.h"
+
+#include <numeric>
+
+#include <glog/logging.h>
+
+namespace vi_map {
+namespace {
+
+void addPerCameraCounts(
+    const std::vector<size_t>& other_counts, std::vector<size_t>* counts) {
+  CHECK_NOTNULL(counts);
+  if (counts->size() < other_counts.size()) {
+    counts->resize(other_counts.size(), 0u);
+  }
+  for (size_t camera_idx = 0u; camera_idx < other_counts.size();
+       ++camera_idx) {
+    (*counts)[camera_idx] += other_counts[camera_idx];
+  }
+}
+
+}  // namespace
+
+void MissionStatistics::resizeCameras(size_t num_cameras) {
+  num_good_landmarks_per_camera.resize(num_cameras, 0u);
+  num_bad_landmarks_per_camera.resize(num_cameras, 0u);
+  num_unknown_landmarks_per_camera.resize(num_cameras, 0u);
+  total_num_landmarks_per_camera.resize(num_cameras, 0u);
+}
+
+void MissionStatistics::accumulateCounts(const MissionStatistics& other) {
+  num_vertices += other.num_vertices;
+  num_landmarks += other.num_landmarks;
+  num_observations += other.num_observations;
+  addPerCameraCounts(
+      other.num_good_landmarks_per_camera, &num_good_landmarks_per_camera);
+  addPerCameraCounts(
+      other.num_bad_landmarks_per_camera, &num_bad_landmarks_per_camera);
+  addPerCameraCounts(
+      other.num_unknown_landmarks_per_camera,
+      &num_unknown_landmarks_per_camera);
+  addPerCameraCounts(
+      other.total_num_landmarks_per_camera, &total_num_landmarks_per_camera);
+  num_imu_edges += other.num_imu_edges;
+  num_wheel_odometry_edges += other.num_wheel_odometry_edges;
+  num_loop_closure_edges += other.num_loop_closure_edges;
+  distance_travelled_m += other.distance_travelled_m;
+}
+
+size_t MissionStatistics::getNumGoodLandmarks() const {
+  return std::accumulate(
+      num_good_landmarks_per_camera.begin(),
+      num_good_landmarks_per_camera.end(), static_cast<size_t>(0u));
+}
+
+size_t MissionStatistics::getNumBadLandmarks() const {
+  return std::accumulate(
+      num_bad_landmarks_per_camera.begin(), num_bad_landmarks_per_camera.end(),
+      static_cast<size_t>(0u));
+}
+
+size_t MissionStatistics::getNumUnknownLandmarks() const {
+  return std::accumulate(
+      num_unknown_landmarks_per_camera.begin(),
+      num_unknown_landmarks_per_camera.end(), static_cast<size_t>(0u));
+}
+
+}  // namespace vi_map
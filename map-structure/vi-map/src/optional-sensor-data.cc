@@ -2,6 +2,7 @@
 
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/memory-usage.h>
 
 namespace vi_map {
 
@@ -135,11 +136,49 @@ void OptionalSensorData::getAllSensorIds(SensorIdSet* sensor_ids) const {
   }
 }
 
+size_t OptionalSensorData::memoryUsageBytes() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  size_t num_bytes =
+      common::getHashContainerMemoryUsageBytes(
+          sensor_id_to_gps_utm_measurements_) +
+      common::getHashContainerMemoryUsageBytes(
+          sensor_id_to_gps_wgs_measurements_);
+  for (const SensorIdToMeasurementsMap<GpsUtmMeasurement>::value_type&
+      sensor_id_with_measurement : sensor_id_to_gps_utm_measurements_) {
+    num_bytes += sensor_id_with_measurement.second.memoryUsageBytes();
+  }
+  for (const SensorIdToMeasurementsMap<GpsWgsMeasurement>::value_type&
+      sensor_id_with_measurement : sensor_id_to_gps_wgs_measurements_) {
+    num_bytes += sensor_id_with_measurement.second.memoryUsageBytes();
+  }
+  return num_bytes;
+}
+
 void OptionalSensorData::serialize(
     proto::OptionalSensorData* proto_optional_sensor_data) const {
   CHECK_NOTNULL(proto_optional_sensor_data);
   std::lock_guard<std::recursive_mutex> lock(mutex_);
 
+  // The measurements are stored in contiguous buffers, so the number of
+  // measurements is known up front and the repeated fields can be allocated
+  // at once.
+  int num_gps_utm_measurements = 0;
+  for (const SensorIdToMeasurementsMap<GpsUtmMeasurement>::value_type&
+      sensor_id_with_measurement : sensor_id_to_gps_utm_measurements_) {
+    num_gps_utm_measurements += sensor_id_with_measurement.second.size();
+  }
+  proto_optional_sensor_data->mutable_gps_utm_measurements()->Reserve(
+      proto_optional_sensor_data->gps_utm_measurements_size() +
+      num_gps_utm_measurements);
+  int num_gps_wgs_measurements = 0;
+  for (const SensorIdToMeasurementsMap<GpsWgsMeasurement>::value_type&
+      sensor_id_with_measurement : sensor_id_to_gps_wgs_measurements_) {
+    num_gps_wgs_measurements += sensor_id_with_measurement.second.size();
+  }
+  proto_optional_sensor_data->mutable_gps_wgs_measurements()->Reserve(
+      proto_optional_sensor_data->gps_wgs_measurements_size() +
+      num_gps_wgs_measurements);
+
   for (const SensorIdToMeasurementsMap<GpsUtmMeasurement>::value_type&
       sensor_id_with_measurement : sensor_id_to_gps_utm_measurements_) {
     const SensorId& sensor_id = sensor_id_with_measurement.first;
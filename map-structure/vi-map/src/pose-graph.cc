@@ -17,12 +17,10 @@ void PoseGraph::addVIVertex(
     const std::vector<LandmarkId>& observed_landmark_ids,
     const vi_map::MissionId& mission_id, const aslam::FrameId& frame_id,
     int64_t frame_timestamp, const aslam::NCamera::Ptr cameras) {
-  pose_graph::Vertex* vertex(
-      new vi_map::Vertex(
-          id, imu_ba_bw, img_points, uncertainties, descriptors,
-          observed_landmark_ids, mission_id, frame_id, frame_timestamp,
-          cameras));
-  this->addVertex(pose_graph::Vertex::UniquePtr(vertex));
+  emplaceVertex<vi_map::Vertex>(
+      getObjectArena(mission_id), id, imu_ba_bw, img_points, uncertainties,
+      descriptors, observed_landmark_ids, mission_id, frame_id,
+      frame_timestamp, cameras);
 }
 
 void PoseGraph::addVIEdge(
@@ -30,9 +28,11 @@ void PoseGraph::addVIEdge(
     const pose_graph::VertexId& to,
     const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
     const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data) {
-  pose_graph::Edge* edge(
-      new vi_map::ViwlsEdge(id, from, to, imu_timestamps, imu_data));
-  this->addEdge(pose_graph::Edge::UniquePtr(edge));
+  const vi_map::Vertex& from_vertex =
+      static_cast<const vi_map::Vertex&>(getVertex(from));
+  emplaceEdge<vi_map::ViwlsEdge>(
+      getObjectArena(from_vertex.getMissionId()), id, from, to, imu_timestamps,
+      imu_data);
 }
 
 void PoseGraph::mergeNeighboringViwlsEdges(
@@ -82,4 +82,75 @@ void PoseGraph::mergeNeighboringViwlsEdges(
   CHECK(edgeExists(new_edge_id));
 }
 
+void PoseGraph::mergeViwlsEdgeChain(
+    const pose_graph::VertexId& merge_into_vertex_id,
+    const std::vector<const ViwlsEdge*>& edge_chain) {
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> new_imu_timestamps;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> new_imu_data;
+  concatenateViwlsEdgeChain(edge_chain, &new_imu_timestamps, &new_imu_data);
+  replaceViwlsEdgeChain(
+      merge_into_vertex_id, edge_chain, new_imu_timestamps, new_imu_data);
+}
+
+void PoseGraph::concatenateViwlsEdgeChain(
+    const std::vector<const ViwlsEdge*>& edge_chain,
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic>* imu_timestamps,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* imu_data) {
+  CHECK(!edge_chain.empty());
+  CHECK_NOTNULL(imu_timestamps);
+  CHECK_NOTNULL(imu_data);
+
+  // Consecutive edges share one measurement, which is only kept once.
+  int total_imu_measurements = 1;
+  for (size_t edge_idx = 0u; edge_idx < edge_chain.size(); ++edge_idx) {
+    const ViwlsEdge& edge = *CHECK_NOTNULL(edge_chain[edge_idx]);
+    if (edge_idx > 0u) {
+      CHECK_EQ(edge_chain[edge_idx - 1u]->to(), edge.from());
+    }
+    CHECK_EQ(edge.getImuTimestamps().cols(), edge.getImuData().cols());
+    CHECK_GT(edge.getImuTimestamps().cols(), 0);
+    total_imu_measurements += edge.getImuTimestamps().cols() - 1;
+  }
+
+  imu_timestamps->resize(Eigen::NoChange, total_imu_measurements);
+  imu_data->resize(Eigen::NoChange, total_imu_measurements);
+  int num_copied_measurements = 0;
+  for (size_t edge_idx = 0u; edge_idx < edge_chain.size(); ++edge_idx) {
+    const ViwlsEdge& edge = *edge_chain[edge_idx];
+    const bool is_last_edge = edge_idx + 1u == edge_chain.size();
+    const int num_measurements =
+        edge.getImuTimestamps().cols() - (is_last_edge ? 0 : 1);
+    imu_timestamps->middleCols(num_copied_measurements, num_measurements) =
+        edge.getImuTimestamps().leftCols(num_measurements);
+    imu_data->middleCols(num_copied_measurements, num_measurements) =
+        edge.getImuData().leftCols(num_measurements);
+    num_copied_measurements += num_measurements;
+  }
+  CHECK_EQ(num_copied_measurements, total_imu_measurements);
+}
+
+void PoseGraph::replaceViwlsEdgeChain(
+    const pose_graph::VertexId& merge_into_vertex_id,
+    const std::vector<const ViwlsEdge*>& edge_chain,
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& imu_timestamps,
+    const Eigen::Matrix<double, 6, Eigen::Dynamic>& imu_data) {
+  CHECK(!edge_chain.empty());
+  CHECK_EQ(merge_into_vertex_id, CHECK_NOTNULL(edge_chain.front())->from());
+
+  pose_graph::EdgeId new_edge_id;
+  common::generateId(&new_edge_id);
+
+  const pose_graph::VertexId new_edge_to_vertex = edge_chain.back()->to();
+
+  // Delete old edges, create and add the new one.
+  for (const ViwlsEdge* edge : edge_chain) {
+    removeEdge(edge->id());
+  }
+
+  addVIEdge(
+      new_edge_id, merge_into_vertex_id, new_edge_to_vertex, imu_timestamps,
+      imu_data);
+  CHECK(edgeExists(new_edge_id));
+}
+
 }  // namespace vi_map
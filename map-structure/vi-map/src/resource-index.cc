@@ -0,0 +1,207 @@
+#include "vi-map/resource-index.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <map-resources/optional-sensor-resources.h>
+
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+constexpr uint32_t ResourceIndex::kInvalidRow;
+constexpr int64_t ResourceIndex::kNoTimestamp;
+
+ResourceIndex::ResourceIndex(const VIMap& map)
+    : rows_of_type_sorted_by_time_(backend::kNumResourceTypes) {
+  const pose_graph::VertexId kInvalidVertexId;
+  const aslam::CameraId kInvalidCameraId;
+
+  MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  for (const MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMission(mission_id, &vertex_ids);
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const Vertex& vertex = map.getVertex(vertex_id);
+      const Vertex::FrameResourceMap& frame_resource_map =
+          vertex.getFrameResourceMap();
+      for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+           ++frame_idx) {
+        if (!vertex.isVisualFrameSet(frame_idx)) {
+          continue;
+        }
+        const int64_t timestamp_ns =
+            vertex.getVisualFrame(frame_idx).getTimestampNanoseconds();
+        for (const backend::ResourceTypeToIdsMap::value_type& type_to_ids :
+             frame_resource_map[frame_idx]) {
+          for (const backend::ResourceId& resource_id : type_to_ids.second) {
+            addRow(
+                resource_id, type_to_ids.first, OwnerType::kFrame, mission_id,
+                vertex_id, frame_idx, kInvalidCameraId, timestamp_ns);
+          }
+        }
+      }
+    }
+
+    const VIMission& mission = map.getMission(mission_id);
+    for (size_t type_idx = 0u; type_idx < backend::kNumResourceTypes;
+         ++type_idx) {
+      const backend::ResourceType type =
+          static_cast<backend::ResourceType>(type_idx);
+      backend::ResourceIdSet resource_ids;
+      mission.getAllResourceIds(type, &resource_ids);
+      for (const backend::ResourceId& resource_id : resource_ids) {
+        addRow(
+            resource_id, type, OwnerType::kMission, mission_id,
+            kInvalidVertexId, 0u, kInvalidCameraId, kNoTimestamp);
+      }
+    }
+
+    for (const backend::ResourceTypeToOptionalCameraResourcesMap::value_type&
+             type_to_cameras : mission.getAllOptionalCameraResourceIds()) {
+      for (const backend::OptionalCameraResourcesMap::value_type&
+               camera_to_resources : type_to_cameras.second) {
+        for (const backend::StampedResourceIds::value_type& stamped_id :
+             camera_to_resources.second.resource_id_map()) {
+          addRow(
+              stamped_id.second, type_to_cameras.first,
+              OwnerType::kOptionalCamera, mission_id, kInvalidVertexId, 0u,
+              camera_to_resources.first, stamped_id.first);
+        }
+      }
+    }
+  }
+
+  for (std::vector<uint32_t>& rows : rows_of_type_sorted_by_time_) {
+    std::stable_sort(
+        rows.begin(), rows.end(), [this](uint32_t lhs, uint32_t rhs) {
+          return timestamps_ns_[lhs] < timestamps_ns_[rhs];
+        });
+    rows.shrink_to_fit();
+  }
+}
+
+void ResourceIndex::addRow(
+    const backend::ResourceId& resource_id, const backend::ResourceType& type,
+    const OwnerType owner_type, const MissionId& mission_id,
+    const pose_graph::VertexId& vertex_id, const unsigned int frame_index,
+    const aslam::CameraId& camera_id, const int64_t timestamp_ns) {
+  CHECK_LT(numRows(), static_cast<size_t>(kInvalidRow));
+  const uint32_t row = static_cast<uint32_t>(numRows());
+  resource_ids_.emplace_back(resource_id);
+  types_.emplace_back(type);
+  owner_types_.emplace_back(owner_type);
+  mission_ids_.emplace_back(mission_id);
+  vertex_ids_.emplace_back(vertex_id);
+  frame_indices_.emplace_back(frame_index);
+  camera_ids_.emplace_back(camera_id);
+  timestamps_ns_.emplace_back(timestamp_ns);
+
+  // Append to the end of the chain, such that the rows of an id are visited in
+  // the order they were added.
+  next_row_with_same_id_.emplace_back(kInvalidRow);
+  const std::pair<std::unordered_map<backend::ResourceId, uint32_t>::iterator,
+                  bool>
+      insertion = first_row_of_id_.emplace(resource_id, row);
+  if (!insertion.second) {
+    uint32_t last_row = insertion.first->second;
+    while (next_row_with_same_id_[last_row] != kInvalidRow) {
+      last_row = next_row_with_same_id_[last_row];
+    }
+    next_row_with_same_id_[last_row] = row;
+  }
+
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, rows_of_type_sorted_by_time_.size());
+  rows_of_type_sorted_by_time_[type_idx].emplace_back(row);
+}
+
+uint32_t ResourceIndex::findRow(const backend::ResourceId& resource_id) const {
+  const std::unordered_map<backend::ResourceId, uint32_t>::const_iterator it =
+      first_row_of_id_.find(resource_id);
+  return it == first_row_of_id_.end() ? kInvalidRow : it->second;
+}
+
+size_t ResourceIndex::numRowsWithResourceId(
+    const backend::ResourceId& resource_id) const {
+  size_t num_rows = 0u;
+  for (uint32_t row = findRow(resource_id); row != kInvalidRow;
+       row = next_row_with_same_id_[row]) {
+    ++num_rows;
+  }
+  return num_rows;
+}
+
+const std::vector<uint32_t>& ResourceIndex::getRowsOfType(
+    const backend::ResourceType& type) const {
+  const size_t type_idx = static_cast<size_t>(type);
+  CHECK_LT(type_idx, rows_of_type_sorted_by_time_.size());
+  return rows_of_type_sorted_by_time_[type_idx];
+}
+
+void ResourceIndex::getRowsOfTypeInTimeRange(
+    const backend::ResourceType& type, const int64_t min_timestamp_ns,
+    const int64_t max_timestamp_ns, std::vector<uint32_t>* rows) const {
+  CHECK_NOTNULL(rows)->clear();
+  CHECK_GE(min_timestamp_ns, 0);
+  CHECK_LE(min_timestamp_ns, max_timestamp_ns);
+  const std::vector<uint32_t>& rows_of_type = getRowsOfType(type);
+  std::vector<uint32_t>::const_iterator it = std::lower_bound(
+      rows_of_type.begin(), rows_of_type.end(), min_timestamp_ns,
+      [this](uint32_t row, int64_t value_ns) {
+        return timestamps_ns_[row] < value_ns;
+      });
+  for (; it != rows_of_type.end() && timestamps_ns_[*it] <= max_timestamp_ns;
+       ++it) {
+    rows->emplace_back(*it);
+  }
+}
+
+uint32_t ResourceIndex::findClosestRowOfType(
+    const backend::ResourceType& type, const int64_t timestamp_ns,
+    const int64_t tolerance_ns) const {
+  CHECK_GE(timestamp_ns, 0);
+  CHECK_GE(tolerance_ns, 0);
+  const std::vector<uint32_t>& rows_of_type = getRowsOfType(type);
+  const std::vector<uint32_t>::const_iterator it = std::lower_bound(
+      rows_of_type.begin(), rows_of_type.end(), timestamp_ns,
+      [this](uint32_t row, int64_t value_ns) {
+        return timestamps_ns_[row] < value_ns;
+      });
+
+  uint32_t closest_row = kInvalidRow;
+  int64_t closest_distance_ns = std::numeric_limits<int64_t>::max();
+  if (it != rows_of_type.end()) {
+    closest_row = *it;
+    closest_distance_ns = timestamps_ns_[*it] - timestamp_ns;
+  }
+  // Rows without timestamp come first and are never returned.
+  if (it != rows_of_type.begin() &&
+      timestamps_ns_[*(it - 1)] != kNoTimestamp &&
+      timestamp_ns - timestamps_ns_[*(it - 1)] < closest_distance_ns) {
+    closest_row = *(it - 1);
+    closest_distance_ns = timestamp_ns - timestamps_ns_[*(it - 1)];
+  }
+  if (closest_distance_ns > tolerance_ns) {
+    return kInvalidRow;
+  }
+  return closest_row;
+}
+
+size_t ResourceIndex::getMemoryUsageBytes() const {
+  return sizeof(backend::ResourceId) * resource_ids_.capacity() +
+         sizeof(backend::ResourceType) * types_.capacity() +
+         sizeof(OwnerType) * owner_types_.capacity() +
+         sizeof(MissionId) * mission_ids_.capacity() +
+         sizeof(pose_graph::VertexId) * vertex_ids_.capacity() +
+         sizeof(unsigned int) * frame_indices_.capacity() +
+         sizeof(aslam::CameraId) * camera_ids_.capacity() +
+         sizeof(int64_t) * timestamps_ns_.capacity() +
+         sizeof(uint32_t) * next_row_with_same_id_.capacity() +
+         (sizeof(backend::ResourceId) + sizeof(uint32_t) + sizeof(void*)) *
+             first_row_of_id_.size();
+}
+
+}  // namespace vi_map
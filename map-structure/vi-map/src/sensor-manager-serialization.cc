@@ -248,6 +248,7 @@ bool SensorManager::deserialize(const YAML::Node& sensors_with_systems_node) {
     sensor_system_ = std::move(sensor_system);
   }
 
+  rebuildMissionSensors();
   checkIsConsistent();
   return true;
 }
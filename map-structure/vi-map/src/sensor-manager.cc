@@ -48,6 +48,7 @@ void SensorManager::associateExistingSensorWithMission(
         << " is already associated with mission " << mission_id.hexString()
         << '.';
   }
+  rebuildMissionSensors();
 }
 
 void SensorManager::associateExistingNCameraWithMission(
@@ -59,6 +60,7 @@ void SensorManager::associateExistingNCameraWithMission(
       << "NCamera with id " << ncamera_id.hexString()
       << " is already associated with mission " << mission_id.hexString()
       << '.';
+  rebuildMissionSensors();
 }
 
 void SensorManager::swap(SensorManager* other) {
@@ -67,6 +69,8 @@ void SensorManager::swap(SensorManager* other) {
   sensors_.swap(other->sensors_);
   mission_id_to_ncamera_map_.swap(other->mission_id_to_ncamera_map_);
   mission_id_to_sensors_map_.swap(other->mission_id_to_sensors_map_);
+  // The sensors don't move, so the resolved pointers stay valid.
+  mission_sensors_.swap(other->mission_sensors_);
   CHECK(sensor_system_);
   sensor_system_.swap(other->sensor_system_);
 }
@@ -111,6 +115,7 @@ void SensorManager::addNCamera(
       << "NCamera with id " << ncamera_id.hexString()
       << " is already associated with mission " << mission_id.hexString()
       << '.';
+  rebuildMissionSensors();
 }
 
 aslam::NCamera::Ptr SensorManager::getNCameraShared(
@@ -195,11 +200,11 @@ aslam::NCamera::ConstPtr SensorManager::getNCameraSharedForMission(
 
 const aslam::NCamera& SensorManager::getNCameraForMission(
     const MissionId& mission_id) const {
-  CHECK(mission_id.isValid());
-  AlignedUnorderedMap<MissionId, aslam::NCameraId>::const_iterator
-  ncamera_id_iterator = mission_id_to_ncamera_map_.find(mission_id);
-  CHECK(ncamera_id_iterator != mission_id_to_ncamera_map_.end());
-  return getNCamera(ncamera_id_iterator->second);
+  const MissionSensors* mission_sensors = getMissionSensors(mission_id);
+  CHECK(mission_sensors != nullptr && mission_sensors->ncamera != nullptr)
+      << "No NCamera is associated with mission " << mission_id.hexString()
+      << '.';
+  return *mission_sensors->ncamera;
 }
 
 bool SensorManager::hasNCamera(const MissionId& mission_id) const {
@@ -248,20 +253,10 @@ void SensorManager::getAllSensorIdsOfType(
 void SensorManager::getAllSensorIdsOfTypeAssociatedWithMission(
     SensorType sensor_type, const MissionId& mission_id,
     SensorIdSet* sensor_ids) const {
-  CHECK_NOTNULL(sensor_ids);
-  CHECK(mission_id.isValid());
-  getAllSensorIdsOfType(sensor_type, sensor_ids);
-
-  SensorIdSet mission_sensor_ids;
-  getAllSensorIdsAssociatedWithMission(mission_id, &mission_sensor_ids);
-
-  SensorIdSet::iterator sensor_id_iterator = sensor_ids->begin();
-  while (sensor_id_iterator != sensor_ids->end()) {
-    if (mission_sensor_ids.count(*sensor_id_iterator) > 0u) {
-      ++sensor_id_iterator;
-    } else {
-      sensor_id_iterator = sensor_ids->erase(sensor_id_iterator);
-    }
+  CHECK_NOTNULL(sensor_ids)->clear();
+  for (const Sensor* sensor :
+       getMissionSensorsOfType(sensor_type, mission_id)) {
+    sensor_ids->emplace(sensor->getId());
   }
 }
 
@@ -381,6 +376,49 @@ bool SensorManager::operator==(const SensorManager& other) const {
          mission_id_to_ncamera_map_ == other.mission_id_to_ncamera_map_;
 }
 
+const SensorManager::MissionSensors* SensorManager::getMissionSensors(
+    const MissionId& mission_id) const {
+  CHECK(mission_id.isValid());
+  AlignedUnorderedMap<MissionId, MissionSensors>::const_iterator
+      mission_sensors_iterator = mission_sensors_.find(mission_id);
+  if (mission_sensors_iterator == mission_sensors_.end()) {
+    return nullptr;
+  }
+  return &mission_sensors_iterator->second;
+}
+
+const std::vector<const Sensor*>& SensorManager::getMissionSensorsOfType(
+    SensorType sensor_type, const MissionId& mission_id) const {
+  static const std::vector<const Sensor*> kNoSensors;
+  const size_t type_index = static_cast<size_t>(sensor_type);
+  CHECK_LT(type_index, static_cast<size_t>(SensorType::kInvalidSensor));
+  const MissionSensors* mission_sensors = getMissionSensors(mission_id);
+  if (mission_sensors == nullptr) {
+    return kNoSensors;
+  }
+  return mission_sensors->sensors_of_type[type_index];
+}
+
+void SensorManager::rebuildMissionSensors() {
+  mission_sensors_.clear();
+  for (const AlignedUnorderedMap<MissionId, SensorIdSet>::value_type&
+           mission_id_sensor_ids : mission_id_to_sensors_map_) {
+    MissionSensors& mission_sensors =
+        mission_sensors_[mission_id_sensor_ids.first];
+    for (const SensorId& sensor_id : mission_id_sensor_ids.second) {
+      const Sensor& sensor = getSensor(sensor_id);
+      const size_t type_index = static_cast<size_t>(sensor.getSensorType());
+      CHECK_LT(type_index, static_cast<size_t>(SensorType::kInvalidSensor));
+      mission_sensors.sensors_of_type[type_index].emplace_back(&sensor);
+    }
+  }
+  for (const AlignedUnorderedMap<MissionId, aslam::NCameraId>::value_type&
+           mission_id_ncamera_id : mission_id_to_ncamera_map_) {
+    mission_sensors_[mission_id_ncamera_id.first].ncamera =
+        &getNCamera(mission_id_ncamera_id.second);
+  }
+}
+
 void SensorManager::checkIsConsistent() const {
   SensorIdSet sensor_ids_associcated_with_missions;
   for (const AlignedUnorderedMap<MissionId, SensorIdSet>::value_type&
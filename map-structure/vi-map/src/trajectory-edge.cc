@@ -1,3 +1,6 @@
+#include <algorithm>
+
+#include <Eigen/Geometry>
 #include <glog/logging.h>
 #include <maplab-common/eigen-proto.h>
 #include <vi-map/trajectory-edge.h>
@@ -88,4 +91,103 @@ uint32_t TrajectoryEdge::getIdentifier() const {
   return trajectory_identifier_;
 }
 
+bool TrajectoryEdge::getPoseAtTime(
+    const int64_t timestamp_ns, aslam::Transformation* T_G_I) const {
+  CHECK_NOTNULL(T_G_I);
+  const int num_samples = trajectory_timestamps_ns_.cols();
+  if (num_samples == 0 || timestamp_ns < trajectory_timestamps_ns_(0) ||
+      timestamp_ns > trajectory_timestamps_ns_(num_samples - 1)) {
+    return false;
+  }
+  const int64_t* timestamps_begin = trajectory_timestamps_ns_.data();
+  const int64_t* timestamps_end = timestamps_begin + num_samples;
+  // The last sample at or before the timestamp.
+  const int sample_idx =
+      std::upper_bound(timestamps_begin, timestamps_end, timestamp_ns) -
+      timestamps_begin - 1;
+  *T_G_I = interpolate(sample_idx, timestamp_ns);
+  return true;
+}
+
+bool TrajectoryEdge::getPosesAtTimes(
+    const Eigen::Matrix<int64_t, 1, Eigen::Dynamic>& timestamps_ns,
+    aslam::TransformationVector* T_G_I) const {
+  CHECK_NOTNULL(T_G_I)->clear();
+  const int num_queries = timestamps_ns.cols();
+  if (num_queries == 0) {
+    return true;
+  }
+  const int num_samples = trajectory_timestamps_ns_.cols();
+  if (num_samples == 0 || timestamps_ns(0) < trajectory_timestamps_ns_(0) ||
+      timestamps_ns(num_queries - 1) >
+          trajectory_timestamps_ns_(num_samples - 1)) {
+    return false;
+  }
+
+  T_G_I->reserve(num_queries);
+  int sample_idx = 0;
+  for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+    const int64_t timestamp_ns = timestamps_ns(query_idx);
+    CHECK(query_idx == 0 || timestamps_ns(query_idx - 1) <= timestamp_ns)
+        << "The timestamps need to be sorted.";
+    while (sample_idx + 1 < num_samples &&
+           trajectory_timestamps_ns_(sample_idx + 1) <= timestamp_ns) {
+      ++sample_idx;
+    }
+    T_G_I->emplace_back(interpolate(sample_idx, timestamp_ns));
+  }
+  return true;
+}
+
+void TrajectoryEdge::getTransformations(
+    aslam::TransformationVector* T_G_I) const {
+  CHECK_NOTNULL(T_G_I)->clear();
+  const int num_samples = trajectory_G_T_I_pq_.cols();
+  const Eigen::Matrix<double, 4, Eigen::Dynamic> q_G_I_wxyz =
+      trajectory_G_T_I_pq_.bottomRows<4>().colwise().normalized();
+  T_G_I->reserve(num_samples);
+  for (int sample_idx = 0; sample_idx < num_samples; ++sample_idx) {
+    const Eigen::Quaterniond q_G_I(
+        q_G_I_wxyz(0, sample_idx), q_G_I_wxyz(1, sample_idx),
+        q_G_I_wxyz(2, sample_idx), q_G_I_wxyz(3, sample_idx));
+    T_G_I->emplace_back(
+        pose::Quaternion(q_G_I),
+        trajectory_G_T_I_pq_.block<3, 1>(0, sample_idx).eval());
+  }
+}
+
+aslam::Transformation TrajectoryEdge::interpolate(
+    const int sample_idx, const int64_t timestamp_ns) const {
+  CHECK_GE(sample_idx, 0);
+  CHECK_LT(sample_idx, trajectory_timestamps_ns_.cols());
+  const Eigen::Matrix<double, 7, 1>& pq_before =
+      trajectory_G_T_I_pq_.col(sample_idx);
+  const Eigen::Quaterniond q_before =
+      Eigen::Quaterniond(pq_before(3), pq_before(4), pq_before(5), pq_before(6))
+          .normalized();
+  const int64_t timestamp_before_ns = trajectory_timestamps_ns_(sample_idx);
+  if (timestamp_ns == timestamp_before_ns) {
+    return aslam::Transformation(
+        pose::Quaternion(q_before), pq_before.head<3>().eval());
+  }
+
+  CHECK_LT(sample_idx + 1, trajectory_timestamps_ns_.cols());
+  const int64_t timestamp_after_ns = trajectory_timestamps_ns_(sample_idx + 1);
+  CHECK_GT(timestamp_ns, timestamp_before_ns);
+  CHECK_LE(timestamp_ns, timestamp_after_ns);
+  const Eigen::Matrix<double, 7, 1>& pq_after =
+      trajectory_G_T_I_pq_.col(sample_idx + 1);
+  const Eigen::Quaterniond q_after =
+      Eigen::Quaterniond(pq_after(3), pq_after(4), pq_after(5), pq_after(6))
+          .normalized();
+  const double alpha =
+      static_cast<double>(timestamp_ns - timestamp_before_ns) /
+      static_cast<double>(timestamp_after_ns - timestamp_before_ns);
+  // Eigen's slerp takes the shorter path.
+  const Eigen::Vector3d p_G_I =
+      (1.0 - alpha) * pq_before.head<3>() + alpha * pq_after.head<3>();
+  return aslam::Transformation(
+      pose::Quaternion(q_before.slerp(alpha, q_after)), p_G_I);
+}
+
 }  // namespace vi_map
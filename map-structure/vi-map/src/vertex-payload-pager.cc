@@ -0,0 +1,146 @@
+#include "vi-map/vertex-payload-pager.h"
+
+#include <glog/logging.h>
+#include <maplab-common/proto-serialization-helper.h>
+
+#include "vi-map/map-format-version.h"
+#include "vi-map/vertex.h"
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+
+VertexPayloadPager::VertexPayloadPager(
+    const std::string& proto_folder, size_t max_num_resident_bytes)
+    : proto_folder_(proto_folder),
+      max_num_resident_bytes_(max_num_resident_bytes),
+      num_resident_bytes_(0u) {
+  CHECK(!proto_folder_.empty());
+}
+
+size_t VertexPayloadPager::addProtoFile(const std::string& proto_file_name) {
+  CHECK(!proto_file_name.empty());
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  proto_files_.emplace_back();
+  proto_files_.back().file_name = proto_file_name;
+  return proto_files_.size() - 1u;
+}
+
+void VertexPayloadPager::registerVertex(
+    size_t proto_file_index, Vertex* vertex) {
+  CHECK_NOTNULL(vertex);
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  CHECK_LT(proto_file_index, proto_files_.size());
+  CHECK(proto_files_[proto_file_index]
+            .vertices.emplace(vertex->id(), vertex)
+            .second)
+      << "Vertex " << vertex->id() << " is registered twice.";
+}
+
+void VertexPayloadPager::unregisterVertex(
+    size_t proto_file_index, Vertex* vertex) {
+  CHECK_NOTNULL(vertex);
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  CHECK_LT(proto_file_index, proto_files_.size());
+  ProtoFile& proto_file = proto_files_[proto_file_index];
+  std::unordered_map<pose_graph::VertexId, Vertex*>::iterator it =
+      proto_file.vertices.find(vertex->id());
+  // Copies of a vertex share its id but are not registered.
+  if (it != proto_file.vertices.end() && it->second == vertex) {
+    proto_file.vertices.erase(it);
+  }
+}
+
+void VertexPayloadPager::loadPayload(size_t proto_file_index, Vertex* vertex) {
+  CHECK_NOTNULL(vertex);
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  if (vertex->isPayloadResident()) {
+    // Paged in by another thread in the meantime.
+    return;
+  }
+  CHECK_LT(proto_file_index, proto_files_.size());
+  ProtoFile& proto_file = proto_files_[proto_file_index];
+
+  VLOG(3) << "Paging in the vertex payloads of " << proto_file.file_name;
+  proto::VIMap proto;
+  CHECK(
+      common::proto_serialization_helper::parseProtoFromFile(
+          proto_folder_, proto_file.file_name, &proto))
+      << "Failed to page in the vertex payloads of " << proto_file.file_name
+      << " in " << proto_folder_;
+  const int num_vertices = serialization::getNumVertexIds(proto);
+  CHECK_EQ(num_vertices, proto.vertices_size());
+
+  for (int i = 0; i < num_vertices; ++i) {
+    pose_graph::VertexId vertex_id;
+    serialization::getVertexId(proto, i, &vertex_id);
+    Vertex* vertex_to_load = nullptr;
+    if (vertex_id == vertex->id()) {
+      vertex_to_load = vertex;
+    } else {
+      std::unordered_map<pose_graph::VertexId, Vertex*>::const_iterator it =
+          proto_file.vertices.find(vertex_id);
+      if (it != proto_file.vertices.end()) {
+        vertex_to_load = it->second;
+      }
+    }
+    if (vertex_to_load != nullptr && !vertex_to_load->isPayloadResident()) {
+      vertex_to_load->deserializePayload(proto.vertices(i));
+    }
+  }
+  CHECK(vertex->isPayloadResident())
+      << "Vertex " << vertex->id() << " is not part of "
+      << proto_file.file_name;
+
+  if (!proto_file.is_resident) {
+    proto_file.is_resident = true;
+    // The serialized size is a lower bound of the size in memory, which is
+    // good enough to enforce the budget.
+    proto_file.num_bytes = static_cast<size_t>(proto.ByteSize());
+    num_resident_bytes_ += proto_file.num_bytes;
+    if (!proto_file.is_pinned) {
+      proto_file.resident_it = resident_proto_files_.insert(
+          resident_proto_files_.end(), proto_file_index);
+    }
+  }
+}
+
+void VertexPayloadPager::pinPayload(size_t proto_file_index) {
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  CHECK_LT(proto_file_index, proto_files_.size());
+  ProtoFile& proto_file = proto_files_[proto_file_index];
+  if (proto_file.is_pinned) {
+    return;
+  }
+  proto_file.is_pinned = true;
+  if (proto_file.is_resident) {
+    resident_proto_files_.erase(proto_file.resident_it);
+  }
+}
+
+size_t VertexPayloadPager::getNumResidentBytes() const {
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  return num_resident_bytes_;
+}
+
+void VertexPayloadPager::releasePayloadsOverBudget() {
+  std::lock_guard<std::mutex> lock(m_proto_files_);
+  if (max_num_resident_bytes_ == 0u) {
+    return;
+  }
+  std::list<size_t>::iterator it = resident_proto_files_.begin();
+  while (num_resident_bytes_ > max_num_resident_bytes_ &&
+         it != resident_proto_files_.end()) {
+    ProtoFile& proto_file = proto_files_[*it];
+    VLOG(3) << "Releasing the vertex payloads of " << proto_file.file_name;
+    for (const std::unordered_map<pose_graph::VertexId, Vertex*>::value_type&
+             id_and_vertex : proto_file.vertices) {
+      id_and_vertex.second->releasePayload();
+    }
+    proto_file.is_resident = false;
+    CHECK_GE(num_resident_bytes_, proto_file.num_bytes);
+    num_resident_bytes_ -= proto_file.num_bytes;
+    it = resident_proto_files_.erase(it);
+  }
+}
+
+}  // namespace vi_map
@@ -1,5 +1,7 @@
 #include "vi-map/vertex.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <unordered_set>
 
@@ -10,8 +12,11 @@
 #include <aslam/common/stl-helpers.h>
 #include <maplab-common/aslam-id-proto.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/memory-usage.h>
 #include <maplab-common/quaternion-math.h>
 
+#include "vi-map/map-format-version.h"
+#include "vi-map/vertex-payload-pager.h"
 #include "vi-map/vi_map.pb.h"
 
 namespace vi_map {
@@ -182,6 +187,12 @@ Vertex::Vertex() {
   gyro_bias_.setZero();
 }
 
+Vertex::~Vertex() {
+  if (payload_pager_) {
+    payload_pager_->unregisterVertex(payload_proto_file_index_, this);
+  }
+}
+
 const pose_graph::VertexId& Vertex::id() const {
   return id_;
 }
@@ -243,24 +254,39 @@ void Vertex::serialize(vi_map::proto::ViwlsVertex* proto) const {
   CHECK(mission_id_.isValid());
   mission_id_.serialize(proto->mutable_mission_id());
 
-  for (const pose_graph::EdgeId& incoming_edge_id : incoming_edges_) {
-    incoming_edge_id.serialize(proto->add_incoming());
-  }
-  CHECK_EQ(
-      incoming_edges_.size(),
-      static_cast<unsigned int>(proto->incoming_size()));
-  for (const pose_graph::EdgeId& outgoing_edge_id : outgoing_edges_) {
-    outgoing_edge_id.serialize(proto->add_outgoing());
+  const bool write_packed_ids = serialization::shouldWritePackedIds();
+  if (write_packed_ids) {
+    proto->mutable_incoming_packed()->Reserve(
+        common::kNumWordsPerPackedId * incoming_edges_.size());
+    for (const pose_graph::EdgeId& incoming_edge_id : incoming_edges_) {
+      incoming_edge_id.serialize(proto->mutable_incoming_packed());
+    }
+    proto->mutable_outgoing_packed()->Reserve(
+        common::kNumWordsPerPackedId * outgoing_edges_.size());
+    for (const pose_graph::EdgeId& outgoing_edge_id : outgoing_edges_) {
+      outgoing_edge_id.serialize(proto->mutable_outgoing_packed());
+    }
+  } else {
+    for (const pose_graph::EdgeId& incoming_edge_id : incoming_edges_) {
+      incoming_edge_id.serialize(proto->add_incoming());
+    }
+    CHECK_EQ(
+        incoming_edges_.size(),
+        static_cast<unsigned int>(proto->incoming_size()));
+    for (const pose_graph::EdgeId& outgoing_edge_id : outgoing_edges_) {
+      outgoing_edge_id.serialize(proto->add_outgoing());
+    }
+    CHECK_EQ(
+        outgoing_edges_.size(),
+        static_cast<unsigned int>(proto->outgoing_size()));
   }
-  CHECK_EQ(
-      outgoing_edges_.size(),
-      static_cast<unsigned int>(proto->outgoing_size()));
 
   common::eigen_proto::serialize(T_M_I_, proto->mutable_t_m_i());
   common::eigen_proto::serialize(v_M_, proto->mutable_v_m());
   common::eigen_proto::serialize(accel_bias_, proto->mutable_accel_bias());
   common::eigen_proto::serialize(gyro_bias_, proto->mutable_gyro_bias());
 
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
   aslam::serialization::serializeVisualNFrame(
       *n_frame_, proto->mutable_n_visual_frame());
@@ -270,11 +296,22 @@ void Vertex::serialize(vi_map::proto::ViwlsVertex* proto) const {
   aslam::proto::VisualNFrame* proto_n_frame = proto->mutable_n_visual_frame();
   CHECK_EQ(static_cast<int>(num_frames), proto_n_frame->frames_size());
   for (unsigned int i = 0u; i < num_frames; ++i) {
-    google::protobuf::RepeatedPtrField<common::proto::Id>* proto_landmark_ids =
-        proto_n_frame->mutable_frames(i)->mutable_landmark_ids();
-    proto_landmark_ids->Reserve(observed_landmark_ids_[i].size());
-    for (const LandmarkId& landmark_id : observed_landmark_ids_[i]) {
-      landmark_id.serialize(proto_landmark_ids->Add());
+    aslam::proto::VisualFrame* proto_frame = proto_n_frame->mutable_frames(i);
+    if (write_packed_ids) {
+      google::protobuf::RepeatedField<google::protobuf::uint64>*
+          proto_landmark_ids = proto_frame->mutable_landmark_ids_packed();
+      proto_landmark_ids->Reserve(
+          common::kNumWordsPerPackedId * observed_landmark_ids_[i].size());
+      for (const LandmarkId& landmark_id : observed_landmark_ids_[i]) {
+        landmark_id.serialize(proto_landmark_ids);
+      }
+    } else {
+      google::protobuf::RepeatedPtrField<common::proto::Id>*
+          proto_landmark_ids = proto_frame->mutable_landmark_ids();
+      proto_landmark_ids->Reserve(observed_landmark_ids_[i].size());
+      for (const LandmarkId& landmark_id : observed_landmark_ids_[i]) {
+        landmark_id.serialize(proto_landmark_ids->Add());
+      }
     }
   }
 
@@ -299,31 +336,47 @@ void Vertex::serialize(vi_map::proto::ViwlsVertex* proto) const {
 void Vertex::deserialize(
     const pose_graph::VertexId& vertex_id,
     const vi_map::proto::ViwlsVertex& proto) {
-  CHECK(vertex_id.isValid());
-  id_ = vertex_id;
-
-  CHECK(proto.has_mission_id());
-  mission_id_.deserialize(proto.mission_id());
+  deserializeWithoutPayload(vertex_id, proto);
+  deserializePayload(proto);
+}
 
+void Vertex::deserializeWithLazyPayload(
+    const pose_graph::VertexId& vertex_id,
+    const vi_map::proto::ViwlsVertex& proto,
+    const std::shared_ptr<VertexPayloadPager>& payload_pager,
+    size_t proto_file_index) {
+  CHECK(payload_pager);
+  deserializeWithoutPayload(vertex_id, proto);
+
+  // Keep the timestamp available without paging in the visual frames, it is
+  // needed to order the vertices of the map.
   CHECK(proto.has_n_visual_frame());
-  aslam::serialization::deserializeVisualNFrame(
-      proto.n_visual_frame(), &n_frame_);
-
-  const int num_frames = proto.n_visual_frame().frames_size();
-  observed_landmark_ids_.resize(num_frames);
-  for (int i = 0; i < num_frames; ++i) {
-    if (n_frame_->isFrameSet(static_cast<size_t>(i))) {
-      aslam::proto::VisualFrame visual_frame = proto.n_visual_frame().frames(i);
-      observed_landmark_ids_[i].resize(visual_frame.landmark_ids_size());
-      for (int j = 0; j < visual_frame.landmark_ids_size(); ++j) {
-        observed_landmark_ids_[i][j].deserialize(visual_frame.landmark_ids(j));
-      }
+  payload_min_timestamp_nanoseconds_ = std::numeric_limits<int64_t>::max();
+  for (const aslam::proto::VisualFrame& frame :
+       proto.n_visual_frame().frames()) {
+    aslam::FrameId frame_id;
+    common::aslam_id_proto::deserialize(frame.id(), &frame_id);
+    if (frame_id.isValid()) {
+      payload_min_timestamp_nanoseconds_ = std::min(
+          payload_min_timestamp_nanoseconds_,
+          static_cast<int64_t>(frame.timestamp()));
     }
   }
 
-  // Deserialize landmark store.
-  CHECK(proto.has_landmark_store());
-  getLandmarks().deserialize(proto.landmark_store());
+  payload_pager_ = payload_pager;
+  payload_proto_file_index_ = proto_file_index;
+  payload_residency_.is_resident.store(false, std::memory_order_release);
+  payload_pager_->registerVertex(payload_proto_file_index_, this);
+}
+
+void Vertex::deserializeWithoutPayload(
+    const pose_graph::VertexId& vertex_id,
+    const vi_map::proto::ViwlsVertex& proto) {
+  CHECK(vertex_id.isValid());
+  id_ = vertex_id;
+
+  CHECK(proto.has_mission_id());
+  mission_id_.deserialize(proto.mission_id());
 
   // Deserialize transformation.
   common::eigen_proto::deserialize(proto.t_m_i(), &T_M_I_);
@@ -334,18 +387,33 @@ void Vertex::deserialize(
   common::eigen_proto::deserialize(proto.gyro_bias(), &gyro_bias_);
 
   // Deserialize incoming edges.
+  const int num_packed_incoming = common::getNumPackedIds(
+      proto.incoming_packed());
+  for (int i = 0; i < num_packed_incoming; ++i) {
+    pose_graph::EdgeId incoming_edge_id;
+    incoming_edge_id.deserialize(proto.incoming_packed(), i);
+    incoming_edges_.insert(incoming_edge_id);
+  }
   for (int i = 0; i < proto.incoming_size(); ++i) {
     incoming_edges_.insert(pose_graph::EdgeId(proto.incoming(i)));
   }
 
   // Deserialize outgoing edges.
+  const int num_packed_outgoing = common::getNumPackedIds(
+      proto.outgoing_packed());
+  for (int i = 0; i < num_packed_outgoing; ++i) {
+    pose_graph::EdgeId outgoing_edge_id;
+    outgoing_edge_id.deserialize(proto.outgoing_packed(), i);
+    outgoing_edges_.insert(outgoing_edge_id);
+  }
   for (int i = 0; i < proto.outgoing_size(); ++i) {
     pose_graph::EdgeId outgoing_edge_id;
     outgoing_edges_.insert(pose_graph::EdgeId(proto.outgoing(i)));
   }
 
   // Deserialize resource map.
-  resource_map_.resize(num_frames);
+  CHECK(proto.has_n_visual_frame());
+  resource_map_.resize(proto.n_visual_frame().frames_size());
   for (int i = 0; i < proto.resource_map_size(); ++i) {
     const vi_map::proto::FrameResourceMap& resource_map = proto.resource_map(i);
     for (int j = 0; j < resource_map.resource_type_map_size(); ++j) {
@@ -362,6 +430,159 @@ void Vertex::deserialize(
   }
 }
 
+void Vertex::deserializePayload(const vi_map::proto::ViwlsVertex& proto) {
+  CHECK(proto.has_n_visual_frame());
+  aslam::serialization::deserializeVisualNFrame(
+      proto.n_visual_frame(), &n_frame_);
+  if (payload_n_cameras_) {
+    // The cameras were set while the payload was not resident.
+    n_frame_->setNCameras(payload_n_cameras_);
+  }
+
+  const int num_frames = proto.n_visual_frame().frames_size();
+  observed_landmark_ids_.resize(num_frames);
+  for (int i = 0; i < num_frames; ++i) {
+    if (n_frame_->isFrameSet(static_cast<size_t>(i))) {
+      const aslam::proto::VisualFrame& visual_frame =
+          proto.n_visual_frame().frames(i);
+      if (visual_frame.landmark_ids_packed_size() > 0) {
+        observed_landmark_ids_[i].resize(
+            common::getNumPackedIds(visual_frame.landmark_ids_packed()));
+        for (size_t j = 0u; j < observed_landmark_ids_[i].size(); ++j) {
+          observed_landmark_ids_[i][j].deserialize(
+              visual_frame.landmark_ids_packed(), j);
+        }
+      } else {
+        observed_landmark_ids_[i].resize(visual_frame.landmark_ids_size());
+        for (int j = 0; j < visual_frame.landmark_ids_size(); ++j) {
+          observed_landmark_ids_[i][j].deserialize(
+              visual_frame.landmark_ids(j));
+        }
+      }
+    }
+  }
+
+  // Deserialize landmark store.
+  CHECK(proto.has_landmark_store());
+  landmarks_.deserialize(proto.landmark_store());
+  // The payload of a copy is paged in on its own.
+  n_frame_sharing_ = NFrameSharing();
+
+  payload_residency_.is_resident.store(true, std::memory_order_release);
+}
+
+void Vertex::accumulateMemoryUsage(MapMemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  usage->vertex_bytes +=
+      sizeof(Vertex) +
+      common::getHashContainerMemoryUsageBytes(incoming_edges_) +
+      common::getHashContainerMemoryUsageBytes(outgoing_edges_) +
+      common::getHeapMemoryUsageBytes(resource_map_);
+  for (const backend::ResourceTypeToIdsMap& frame_resources : resource_map_) {
+    usage->vertex_bytes +=
+        common::getHashContainerMemoryUsageBytes(frame_resources);
+    for (const backend::ResourceTypeToIdsMap::value_type& type_and_ids :
+         frame_resources) {
+      usage->vertex_bytes +=
+          common::getHashContainerMemoryUsageBytes(type_and_ids.second);
+    }
+  }
+
+  // The members are accessed directly, they are empty if the payload is not
+  // resident.
+  if (n_frame_ != nullptr) {
+    for (size_t frame_idx = 0u; frame_idx < n_frame_->getNumFrames();
+         ++frame_idx) {
+      if (!n_frame_->isFrameSet(frame_idx)) {
+        continue;
+      }
+      const aslam::VisualFrame& frame = n_frame_->getFrame(frame_idx);
+      if (frame.hasDescriptors()) {
+        usage->descriptor_bytes +=
+            common::getHeapMemoryUsageBytes(frame.getDescriptors());
+      }
+      if (frame.hasKeypointMeasurements()) {
+        usage->keypoint_bytes +=
+            common::getHeapMemoryUsageBytes(frame.getKeypointMeasurements());
+      }
+      if (frame.hasKeypointMeasurementUncertainties()) {
+        usage->keypoint_bytes += common::getHeapMemoryUsageBytes(
+            frame.getKeypointMeasurementUncertainties());
+      }
+      if (frame.hasKeypointScales()) {
+        usage->keypoint_bytes +=
+            common::getHeapMemoryUsageBytes(frame.getKeypointScales());
+      }
+      if (frame.hasKeypointOrientations()) {
+        usage->keypoint_bytes +=
+            common::getHeapMemoryUsageBytes(frame.getKeypointOrientations());
+      }
+      if (frame.hasTrackIds()) {
+        usage->keypoint_bytes +=
+            common::getHeapMemoryUsageBytes(frame.getTrackIds());
+      }
+      if (frame.hasRawImage()) {
+        const cv::Mat& image = frame.getRawImage();
+        usage->image_bytes += image.total() * image.elemSize();
+      }
+    }
+  }
+
+  usage->observation_bytes +=
+      common::getHeapMemoryUsageBytes(observed_landmark_ids_);
+  for (const LandmarkIdList& frame_landmark_ids : observed_landmark_ids_) {
+    usage->observation_bytes +=
+        common::getHeapMemoryUsageBytes(frame_landmark_ids);
+  }
+  usage->landmark_bytes += landmarks_.memoryUsageBytes();
+}
+
+size_t Vertex::memoryUsageBytes() const {
+  MapMemoryUsage usage;
+  accumulateMemoryUsage(&usage);
+  return usage.getTotalBytes();
+}
+
+void Vertex::releasePayload() {
+  CHECK(payload_pager_);
+  if (n_frame_ != nullptr) {
+    payload_n_cameras_ = n_frame_->getNCameraShared();
+  }
+  payload_residency_.is_resident.store(false, std::memory_order_release);
+  n_frame_.reset();
+  std::vector<LandmarkIdList>().swap(observed_landmark_ids_);
+  landmarks_ = LandmarkStore();
+}
+
+void Vertex::pinPayload() {
+  if (payload_pager_) {
+    // Pin before paging in such that the payload is never released.
+    payload_pager_->pinPayload(payload_proto_file_index_);
+  }
+  loadPayloadIfNecessary();
+}
+
+void Vertex::detachSharedNFrame() {
+  n_frame_sharing_ = NFrameSharing();
+  if (n_frame_ == nullptr) {
+    return;
+  }
+  const size_t num_frames = n_frame_->getNumFrames();
+  aslam::VisualNFrame::Ptr n_frame(
+      new aslam::VisualNFrame(n_frame_->getId(), num_frames));
+  if (n_frame_->getNCameraShared() != nullptr) {
+    n_frame->setNCameras(n_frame_->getNCameraShared());
+  }
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    if (n_frame_->isFrameSet(frame_idx)) {
+      n_frame->setFrame(
+          frame_idx, aslam::VisualFrame::Ptr(new aslam::VisualFrame(
+                         n_frame_->getFrame(frame_idx))));
+    }
+  }
+  n_frame_ = n_frame;
+}
+
 double* Vertex::get_q_M_I_Mutable() {
   return T_M_I_.getRotation().toImplementation().coeffs().data();
 }
@@ -433,6 +654,7 @@ void Vertex::setGyroBias(const Eigen::Vector3d& gyro_bias) {
 }
 
 bool Vertex::isFrameIndexValid(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
 
   bool is_valid = true;
@@ -444,6 +666,7 @@ bool Vertex::isFrameIndexValid(unsigned int frame_idx) const {
 
 bool Vertex::areFrameAndKeypointIndicesValid(
     unsigned int frame_idx, int keypoint_idx) const {
+  loadPayloadIfNecessary();
   CHECK(n_frame_ != nullptr);
 
   const bool is_frame_idx_valid = isFrameIndexValid(frame_idx);
@@ -471,6 +694,7 @@ bool Vertex::areFrameAndKeypointIndicesValid(
 
 const LandmarkId& Vertex::getObservedLandmarkId(
     unsigned int frame_idx, int keypoint_idx) const {
+  loadPayloadIfNecessary();
   return observed_landmark_ids_[frame_idx][keypoint_idx];
 }
 
@@ -489,22 +713,26 @@ void Vertex::setObservedLandmarkId(
 
 void Vertex::setObservedLandmarkId(
     unsigned int frame_idx, int keypoint_idx, const LandmarkId& landmark_id) {
+  loadPayloadForModification();
   CHECK(areFrameAndKeypointIndicesValid(frame_idx, keypoint_idx));
   observed_landmark_ids_[frame_idx][keypoint_idx] = landmark_id;
 }
 
 void Vertex::addObservedLandmarkId(
     unsigned int frame_idx, const LandmarkId& landmark_id) {
+  loadPayloadForModification();
   CHECK(isFrameIndexValid(frame_idx));
   observed_landmark_ids_[frame_idx].push_back(landmark_id);
 }
 
 size_t Vertex::observedLandmarkIdsSize(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(isFrameIndexValid(frame_idx));
   return observed_landmark_ids_[frame_idx].size();
 }
 
 int Vertex::numValidObservedLandmarkIds(unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK(isFrameIndexValid(frame_idx));
 
   vi_map::LandmarkIdSet landmark_ids;
@@ -533,6 +761,7 @@ int Vertex::determineNewObservedLandmarkIdVectorSize(
 }
 
 void Vertex::expandVisualObservationContainersIfNecessary() {
+  loadPayloadForModification();
   CHECK_EQ(n_frame_->getNumFrames(), observed_landmark_ids_.size());
   CHECK_EQ(n_frame_->getNumFrames(), n_frame_->getNumCameras());
 
@@ -578,6 +807,7 @@ void Vertex::expandVisualObservationContainersIfNecessary() {
 }
 
 size_t Vertex::discardUntrackedObservations() {
+  loadPayloadForModification();
   size_t num_removed = 0u;
   const size_t num_frames = numFrames();
   for (size_t i = 0u; i < num_frames; ++i) {
@@ -594,6 +824,7 @@ size_t Vertex::discardUntrackedObservations() {
 
 void Vertex::updateIdInObservedLandmarkIdList(
     const LandmarkId& old_landmark_id, const LandmarkId& new_landmark_id) {
+  loadPayloadForModification();
   for (LandmarkIdList& landmark_ids : observed_landmark_ids_) {
     LandmarkIdList::iterator it_to_landmark =
         std::find(landmark_ids.begin(), landmark_ids.end(), old_landmark_id);
@@ -605,7 +836,29 @@ void Vertex::updateIdInObservedLandmarkIdList(
   }
 }
 
+size_t Vertex::updateIdsInObservedLandmarkIdList(
+    const std::unordered_map<LandmarkId, LandmarkId>& old_to_new_landmark_ids) {
+  loadPayloadForModification();
+  size_t num_replaced = 0u;
+  for (LandmarkIdList& landmark_ids : observed_landmark_ids_) {
+    for (LandmarkId& landmark_id : landmark_ids) {
+      if (!landmark_id.isValid()) {
+        continue;
+      }
+      const std::unordered_map<LandmarkId, LandmarkId>::const_iterator it =
+          old_to_new_landmark_ids.find(landmark_id);
+      if (it != old_to_new_landmark_ids.end()) {
+        landmark_id = it->second;
+        ++num_replaced;
+      }
+    }
+  }
+  return num_replaced;
+}
+
 std::string Vertex::getComparisonString(const Vertex& other) const {
+  loadPayloadIfNecessary();
+  other.loadPayloadIfNecessary();
   if (operator==(other)) {
     return "There is no difference between the given vertices!\n";
   }
@@ -648,6 +901,7 @@ std::string Vertex::getComparisonString(const Vertex& other) const {
 }
 
 void Vertex::checkConsistencyOfVisualObservationContainers() const {
+  loadPayloadIfNecessary();
   CHECK_EQ(n_frame_->getNumFrames(), observed_landmark_ids_.size());
   CHECK_EQ(n_frame_->getNumFrames(), n_frame_->getNumCameras());
   for (unsigned int frame_idx = 0; frame_idx < n_frame_->getNumFrames();
@@ -691,6 +945,7 @@ void Vertex::checkConsistencyOfVisualObservationContainers() const {
 void Vertex::setFrameAndLandmarkObservations(
     aslam::VisualNFrame::Ptr visual_n_frame,
     const std::vector<std::vector<LandmarkId>>& img_landmarks) {
+  loadPayloadForModification();
   CHECK(visual_n_frame != nullptr);
   n_frame_ = visual_n_frame;
   for (unsigned int frame_idx = 0u; frame_idx < observed_landmark_ids_.size();
@@ -709,6 +964,7 @@ void Vertex::setFrameAndLandmarkObservations(
 }
 
 void Vertex::resetObservedLandmarkIdsToInvalid() {
+  loadPayloadForModification();
   CHECK(n_frame_);
   CHECK_EQ(observed_landmark_ids_.size(), n_frame_->getNumFrames());
   LandmarkId invalid_landmark_id;
@@ -732,6 +988,7 @@ int Vertex::numValidObservedLandmarkIdsInAllFrames() const {
 
 void Vertex::getFrameObservedLandmarkIds(
     unsigned int frame_idx, LandmarkIdList* landmark_ids) const {
+  loadPayloadIfNecessary();
   CHECK_NOTNULL(landmark_ids);
   landmark_ids->clear();
   *landmark_ids = observed_landmark_ids_[frame_idx];
@@ -739,12 +996,14 @@ void Vertex::getFrameObservedLandmarkIds(
 
 const LandmarkIdList& Vertex::getFrameObservedLandmarkIds(
     unsigned int frame_idx) const {
+  loadPayloadIfNecessary();
   CHECK_LT(frame_idx, numFrames());
   CHECK_LT(frame_idx, observed_landmark_ids_.size());
   return observed_landmark_ids_[frame_idx];
 }
 
 void Vertex::getAllObservedLandmarkIds(LandmarkIdList* landmark_ids) const {
+  loadPayloadIfNecessary();
   CHECK_NOTNULL(landmark_ids)->clear();
   for (unsigned int frame_idx = 0u; frame_idx < numFrames(); ++frame_idx) {
     landmark_ids->insert(
@@ -755,6 +1014,7 @@ void Vertex::getAllObservedLandmarkIds(LandmarkIdList* landmark_ids) const {
 
 void Vertex::getAllObservedLandmarkIds(
     std::vector<LandmarkIdList>* landmark_ids) const {
+  loadPayloadIfNecessary();
   CHECK_NOTNULL(landmark_ids)->clear();
   *landmark_ids = observed_landmark_ids_;
 }
@@ -794,6 +1054,7 @@ pose::Position3D Vertex::getLandmark_p_LM_fi(
 }
 
 void Vertex::getStoredLandmarkIdList(LandmarkIdList* landmark_id_list) const {
+  loadPayloadIfNecessary();
   CHECK_NOTNULL(landmark_id_list)->clear();
   landmark_id_list->reserve(landmarks_.size());
   for (const Landmark& landmark : landmarks_) {
@@ -808,14 +1069,15 @@ void Vertex::setLandmark_LM_p_fi(
 }
 
 bool Vertex::hasStoredLandmark(const LandmarkId& landmark_id) const {
+  loadPayloadIfNecessary();
   return landmarks_.hasLandmark(landmark_id);
 }
 
 bool Vertex::hasFrameResourceOfType(
     const unsigned int frame_idx,
     const backend::ResourceType& resource_type) const {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   const backend::ResourceTypeToIdsMap::const_iterator it =
       resource_map_.at(frame_idx).find(resource_type);
   return it != resource_map_.at(frame_idx).end() && !it->second.empty();
@@ -825,8 +1087,8 @@ bool Vertex::hasFrameResourceWithId(
     const unsigned int frame_idx,
     const backend::ResourceId& resource_id) const {
   CHECK(resource_id.isValid());
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   for (const backend::ResourceTypeToIdsMap::value_type& resource_type_vector :
        resource_map_[frame_idx]) {
     for (const backend::ResourceId& res_id : resource_type_vector.second) {
@@ -841,9 +1103,8 @@ bool Vertex::hasFrameResourceWithId(
 void Vertex::getFrameResourceIdsOfType(
     const unsigned int frame_idx, const backend::ResourceType& resource_type,
     backend::ResourceIdSet* resource_ids) const {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK(n_frame_);
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   backend::ResourceTypeToIdsMap::const_iterator res_it =
       resource_map_[frame_idx].find(resource_type);
   if (res_it != resource_map_[frame_idx].end()) {
@@ -854,8 +1115,8 @@ void Vertex::getFrameResourceIdsOfType(
 size_t Vertex::getNumFrameResourcesOfType(
     const unsigned int frame_idx,
     const backend::ResourceType& resource_type) const {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   backend::ResourceTypeToIdsMap::const_iterator res_it =
       resource_map_[frame_idx].find(resource_type);
   if (res_it != resource_map_[frame_idx].end()) {
@@ -867,31 +1128,31 @@ size_t Vertex::getNumFrameResourcesOfType(
 void Vertex::addFrameResourceIdOfType(
     const unsigned int frame_idx, const backend::ResourceType& resource_type,
     const backend::ResourceId& resource_id) {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   resource_map_[frame_idx][resource_type].insert(resource_id);
 }
 
 void Vertex::deleteAllFrameResourceInfo() {
   resource_map_.clear();
-  resource_map_.resize(n_frame_->getNumFrames());
+  resource_map_.resize(numFrames());
 }
 
 void Vertex::deleteAllFrameResourceInfo(const unsigned int frame_idx) {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   resource_map_[frame_idx].clear();
 }
 
 void Vertex::deleteFrameResourceIdsOfType(
     const unsigned int frame_idx, const backend::ResourceType& resource_type) {
-  CHECK_LT(frame_idx, getVisualNFrame().getNumFrames());
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_LT(frame_idx, numFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   resource_map_[frame_idx][resource_type].clear();
 }
 
 const Vertex::FrameResourceMap& Vertex::getFrameResourceMap() const {
-  CHECK_EQ(resource_map_.size(), n_frame_->getNumFrames());
+  CHECK_EQ(resource_map_.size(), numFrames());
   return resource_map_;
 }
 
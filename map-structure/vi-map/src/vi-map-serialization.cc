@@ -1,12 +1,19 @@
 #include "vi-map/vi-map-serialization.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <functional>
+#include <memory>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_set>
+#include <vector>
 
 #include <aslam/common/timer.h>
 #include <aslam/common/yaml-serialization.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <map-resources/resource-map-serialization.h>
 #include <maplab-common/eigen-proto.h>
@@ -14,14 +21,66 @@
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/progress-bar.h>
 #include <maplab-common/proto-serialization-helper.h>
 
+#include "vi-map/map-format-version.h"
+#include "vi-map/vertex-payload-pager.h"
+#include "vi-map/vi-map-snapshot.h"
 #include "vi-map/vi-map.h"
 #include "vi-map/vi_map.pb.h"
 
+DECLARE_bool(show_progress_bar);
+
+DEFINE_bool(
+    vi_map_lazy_load_vertex_payloads, false,
+    "Only load the poses and the topology of the vertices when loading a map. "
+    "The visual frames, observed landmark ids and landmarks of a vertex are "
+    "paged in from the map folder on the first access.");
+
+DEFINE_int32(
+    vi_map_serialization_vertices_per_chunk, 10,
+    "Number of vertices that are serialized at once when streaming a vertex "
+    "proto file to disk.");
+
+DEFINE_bool(
+    vi_map_fast_vertex_compression, false,
+    "Compress the descriptor-heavy vertex proto files with the fastest "
+    "compression level instead of the default one when saving a map.");
+
+DEFINE_double(
+    vi_map_lazy_load_max_resident_mb, 0.0,
+    "Memory budget for the lazily loaded vertex payloads [MB]. The payloads "
+    "that were paged in the longest time ago are released again if the budget "
+    "is exceeded, unless they were modified. This happens when the map "
+    "manager hands out a write access to the map. 0 keeps all of them in "
+    "memory.");
+
+DEFINE_bool(
+    vi_map_incremental_save, false,
+    "Record the content of the proto files when loading or saving a map and "
+    "only rewrite the proto files whose content changed when the map is saved "
+    "to the same folder again.");
+
+DEFINE_int32(
+    vi_map_serialization_format_version, 2,
+    "Format version of the saved maps. Version 2 stores the ids in packed "
+    "arrays and parses considerably faster, version 1 can still be read by "
+    "binaries that predate version 2.");
+
 namespace vi_map {
 namespace serialization {
 
+uint32_t getFormatVersionToWrite() {
+  CHECK_GE(
+      FLAGS_vi_map_serialization_format_version,
+      static_cast<int>(kFormatVersionIdMessages));
+  CHECK_LE(
+      FLAGS_vi_map_serialization_format_version,
+      static_cast<int>(kCurrentFormatVersion));
+  return static_cast<uint32_t>(FLAGS_vi_map_serialization_format_version);
+}
+
 void serializeVertices(const vi_map::VIMap& map, vi_map::proto::VIMap* proto) {
   constexpr size_t kStartIndex = 0u;
   // Serialize all vertices.
@@ -38,25 +97,86 @@ size_t serializeVertices(
   const size_t end_index =
       std::min(vertex_ids.size(), start_index + vertices_per_proto);
   size_t counter = start_index;
-  proto->mutable_vertex_ids()->Reserve(end_index - counter);
+  proto->set_format_version(getFormatVersionToWrite());
+  const bool write_packed_ids = shouldWritePackedIds();
+  if (write_packed_ids) {
+    proto->mutable_vertex_ids_packed()->Reserve(
+        common::kNumWordsPerPackedId * (end_index - counter));
+  } else {
+    proto->mutable_vertex_ids()->Reserve(end_index - counter);
+  }
   proto->mutable_vertices()->Reserve(end_index - counter);
   for (; counter < end_index; ++counter) {
     const pose_graph::VertexId& id = vertex_ids[counter];
-    id.serialize(proto->add_vertex_ids());
+    if (write_packed_ids) {
+      id.serialize(proto->mutable_vertex_ids_packed());
+    } else {
+      id.serialize(proto->add_vertex_ids());
+    }
     map.getVertex(id).serialize(proto->add_vertices());
   }
 
   return counter;
 }
 
+size_t serializeVerticesToStream(
+    const vi_map::VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    const size_t start_index, const size_t vertices_per_proto,
+    google::protobuf::io::ZeroCopyOutputStream* stream) {
+  CHECK_NOTNULL(stream);
+  CHECK_GT(FLAGS_vi_map_serialization_vertices_per_chunk, 0);
+  const size_t vertices_per_chunk =
+      static_cast<size_t>(FLAGS_vi_map_serialization_vertices_per_chunk);
+  const size_t end_index =
+      std::min(vertex_ids.size(), start_index + vertices_per_proto);
+
+  // The chunks are concatenated in the stream, which is equivalent to a
+  // single proto holding all their vertices.
+  vi_map::proto::VIMap chunk;
+  const bool write_packed_ids = shouldWritePackedIds();
+  size_t counter = start_index;
+  while (counter < end_index) {
+    chunk.Clear();
+    chunk.set_format_version(getFormatVersionToWrite());
+    const size_t chunk_end_index =
+        std::min(end_index, counter + vertices_per_chunk);
+    for (; counter < chunk_end_index; ++counter) {
+      const pose_graph::VertexId& id = vertex_ids[counter];
+      if (write_packed_ids) {
+        id.serialize(chunk.mutable_vertex_ids_packed());
+      } else {
+        id.serialize(chunk.add_vertex_ids());
+      }
+      map.getVertex(id).serialize(chunk.add_vertices());
+    }
+    if (!chunk.SerializeToZeroCopyStream(stream)) {
+      LOG(ERROR) << "Failed to write the vertices up to index " << counter
+                 << " to the stream.";
+      return start_index;
+    }
+  }
+  return counter;
+}
+
 void serializeEdges(const vi_map::VIMap& map, vi_map::proto::VIMap* proto) {
   CHECK_NOTNULL(proto);
   pose_graph::EdgeIdList edge_ids;
   map.getAllEdgeIds(&edge_ids);
-  proto->mutable_edge_ids()->Reserve(edge_ids.size());
+  proto->set_format_version(getFormatVersionToWrite());
+  const bool write_packed_ids = shouldWritePackedIds();
+  if (write_packed_ids) {
+    proto->mutable_edge_ids_packed()->Reserve(
+        common::kNumWordsPerPackedId * edge_ids.size());
+  } else {
+    proto->mutable_edge_ids()->Reserve(edge_ids.size());
+  }
   proto->mutable_edges()->Reserve(edge_ids.size());
   for (const pose_graph::EdgeId& id : edge_ids) {
-    id.serialize(proto->add_edge_ids());
+    if (write_packed_ids) {
+      id.serialize(proto->mutable_edge_ids_packed());
+    } else {
+      id.serialize(proto->add_edge_ids());
+    }
     map.getEdgeAs<vi_map::Edge>(id).serialize(proto->add_edges());
   }
 }
@@ -64,6 +184,7 @@ void serializeEdges(const vi_map::VIMap& map, vi_map::proto::VIMap* proto) {
 void serializeMissionsAndBaseframes(
     const vi_map::VIMap& map, vi_map::proto::VIMap* proto) {
   CHECK_NOTNULL(proto);
+  proto->set_format_version(getFormatVersionToWrite());
   MissionIdList mission_ids;
   map.getAllMissionIds(&mission_ids);
   for (const MissionId& id : mission_ids) {
@@ -85,6 +206,21 @@ void serializeLandmarkIndex(
   LandmarkIdList landmark_ids;
   map.getAllLandmarkIds(&landmark_ids);
   const size_t num_landmarks = landmark_ids.size();
+  proto->set_format_version(getFormatVersionToWrite());
+  if (shouldWritePackedIds()) {
+    // The landmark id followed by the id of its storing vertex.
+    google::protobuf::RepeatedField<google::protobuf::uint64>* index_proto =
+        proto->mutable_landmark_index_packed();
+    index_proto->Reserve(2 * common::kNumWordsPerPackedId * num_landmarks);
+    for (const LandmarkId& id : landmark_ids) {
+      id.serialize(index_proto);
+      map.getLandmarkStoreVertexId(id).serialize(index_proto);
+    }
+    CHECK_EQ(
+        2 * num_landmarks,
+        static_cast<size_t>(common::getNumPackedIds(*index_proto)));
+    return;
+  }
   proto->mutable_landmark_index()->Reserve(num_landmarks);
   for (const LandmarkId& id : landmark_ids) {
     vi_map::proto::LandmarkToVertexReference* reference =
@@ -98,6 +234,7 @@ void serializeLandmarkIndex(
 
 void serializeOptionalSensorData(const VIMap& map, proto::VIMap* proto) {
   CHECK_NOTNULL(proto);
+  proto->set_format_version(getFormatVersionToWrite());
   MissionIdList mission_ids;
   map.getAllMissionIds(&mission_ids);
   for (const MissionId& mission_id : mission_ids) {
@@ -120,12 +257,38 @@ void serializeOptionalSensorData(const VIMap& map, proto::VIMap* proto) {
 void deserializeVertices(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  CHECK_EQ(proto.vertex_ids_size(), proto.vertices_size());
-  for (int i = 0; i < proto.vertex_ids_size(); ++i) {
+  std::vector<vi_map::Vertex::UniquePtr> vertices;
+  deserializeVerticesWithoutAddingToMap(proto, map, &vertices);
+  map->addVertices(&vertices);
+}
+
+void deserializeVerticesWithoutAddingToMap(
+    const vi_map::proto::VIMap& proto, vi_map::VIMap* map,
+    std::vector<vi_map::Vertex::UniquePtr>* vertices) {
+  constexpr size_t kProtoFileIndex = 0u;
+  deserializeVerticesWithoutAddingToMap(
+      proto, map, nullptr, kProtoFileIndex, vertices);
+}
+
+void deserializeVerticesWithoutAddingToMap(
+    const vi_map::proto::VIMap& proto, vi_map::VIMap* map,
+    const VertexPayloadPager::Ptr& payload_pager, size_t proto_file_index,
+    std::vector<vi_map::Vertex::UniquePtr>* vertices) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(vertices);
+  const int num_vertices = getNumVertexIds(proto);
+  CHECK_EQ(num_vertices, proto.vertices_size());
+  vertices->reserve(vertices->size() + num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
     pose_graph::VertexId id;
-    id.deserialize(proto.vertex_ids(i));
+    getVertexId(proto, i, &id);
     vi_map::Vertex* vertex(new vi_map::Vertex);
-    vertex->deserialize(id, proto.vertices(i));
+    if (payload_pager) {
+      vertex->deserializeWithLazyPayload(
+          id, proto.vertices(i), payload_pager, proto_file_index);
+    } else {
+      vertex->deserialize(id, proto.vertices(i));
+    }
 
     const vi_map::MissionId& mission_id = vertex->getMissionId();
     CHECK(map->hasMission(mission_id));
@@ -134,16 +297,24 @@ void deserializeVertices(
     CHECK(ncamera);
     vertex->setNCameras(ncamera);
 
-    map->addVertex(vi_map::Vertex::UniquePtr(vertex));
+    vertices->emplace_back(vertex);
   }
 }
 
 void deserializeEdges(const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  CHECK_EQ(proto.edge_ids_size(), proto.edges_size());
-  for (int i = 0; i < proto.edge_ids_size(); ++i) {
+  const bool has_packed_ids = proto.edge_ids_packed_size() > 0;
+  const int num_edges = has_packed_ids
+                            ? common::getNumPackedIds(proto.edge_ids_packed())
+                            : proto.edge_ids_size();
+  CHECK_EQ(num_edges, proto.edges_size());
+  for (int i = 0; i < num_edges; ++i) {
     pose_graph::EdgeId id;
-    id.deserialize(proto.edge_ids(i));
+    if (has_packed_ids) {
+      id.deserialize(proto.edge_ids_packed(), i);
+    } else {
+      id.deserialize(proto.edge_ids(i));
+    }
     map->addEdge(vi_map::Edge::deserialize(id, proto.edges(i)));
   }
 }
@@ -193,11 +364,22 @@ void deserializeMissionsAndBaseframes(
 void deserializeLandmarkIndex(
     const vi_map::proto::VIMap& proto, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  for (int i = 0; i < proto.landmark_index_size(); ++i) {
+  const int num_packed_ids =
+      common::getNumPackedIds(proto.landmark_index_packed());
+  CHECK_EQ(num_packed_ids % 2, 0);
+  CHECK(num_packed_ids == 0 || proto.landmark_index_size() == 0);
+  const int num_landmarks = num_packed_ids > 0 ? num_packed_ids / 2
+                                               : proto.landmark_index_size();
+  for (int i = 0; i < num_landmarks; ++i) {
     LandmarkId landmark_id;
-    landmark_id.deserialize(proto.landmark_index(i).landmark_id());
     pose_graph::VertexId storing_vertex_id;
-    storing_vertex_id.deserialize(proto.landmark_index(i).vertex_id());
+    if (num_packed_ids > 0) {
+      landmark_id.deserialize(proto.landmark_index_packed(), 2 * i);
+      storing_vertex_id.deserialize(proto.landmark_index_packed(), 2 * i + 1);
+    } else {
+      landmark_id.deserialize(proto.landmark_index(i).landmark_id());
+      storing_vertex_id.deserialize(proto.landmark_index(i).vertex_id());
+    }
 
     if (map->hasLandmark(landmark_id)) {
       CHECK_EQ(storing_vertex_id, map->getLandmarkStoreVertexId(landmark_id));
@@ -324,6 +506,229 @@ size_t serializeToFunction(
   return num_protos;
 }
 
+namespace {
+
+void splitIntoVertexFiles(
+    const pose_graph::VertexIdList& vertex_ids, const size_t vertices_per_file,
+    ProtoFileState::VertexFileList* vertex_files) {
+  CHECK_NOTNULL(vertex_files);
+  CHECK_GT(vertices_per_file, 0u);
+  for (size_t start_index = 0u; start_index < vertex_ids.size();
+       start_index += vertices_per_file) {
+    const size_t end_index =
+        std::min(vertex_ids.size(), start_index + vertices_per_file);
+    vertex_files->emplace_back(
+        vertex_ids.begin() + start_index, vertex_ids.begin() + end_index);
+  }
+}
+
+// Runs the function on the writers of the proto files of the map, using the
+// given assignment of the vertices to the vertex proto files. Returns the
+// number of proto files.
+size_t serializeProtoFilesToStreamFunction(
+    const vi_map::VIMap& map,
+    const ProtoFileState::VertexFileList& vertex_files,
+    const std::function<bool(const size_t, const ProtoStreamWriter&)>&
+        function) {
+  CHECK(function);
+  const size_t num_protos = internal::kMinNumProtos + vertex_files.size();
+
+  common::MultiThreadedProgressBar progress_bar;
+  std::function<void(const std::vector<size_t>)> serialize_function =
+      [&](const std::vector<size_t>& range) {
+        size_t num_processed_tasks = 0u;
+        progress_bar.setNumElements(range.size());
+        proto::VIMap proto;
+        for (size_t task_idx : range) {
+          if (task_idx >= internal::kProtoListVerticesStartIndex) {
+            const pose_graph::VertexIdList& vertex_ids =
+                vertex_files[task_idx - internal::kProtoListVerticesStartIndex];
+            constexpr size_t kStartIndex = 0u;
+            CHECK(function(
+                task_idx,
+                [&](google::protobuf::io::ZeroCopyOutputStream* stream) {
+                  return serializeVerticesToStream(
+                             map, vertex_ids, kStartIndex, vertex_ids.size(),
+                             stream) == vertex_ids.size();
+                }));
+          } else {
+            proto.Clear();
+            switch (task_idx) {
+              case internal::kProtoListMissionsIndex:
+                serializeMissionsAndBaseframes(map, &proto);
+                break;
+              case internal::kProtoListEdgesIndex:
+                serializeEdges(map, &proto);
+                break;
+              case internal::kProtoListLandmarkIndexIndex:
+                serializeLandmarkIndex(map, &proto);
+                break;
+              case internal::kProtoListOptionalSensorData:
+                serializeOptionalSensorData(map, &proto);
+                break;
+              default:
+                LOG(FATAL) << "Unknown proto index " << task_idx;
+            }
+            CHECK(function(
+                task_idx,
+                [&proto](google::protobuf::io::ZeroCopyOutputStream* stream) {
+                  return proto.SerializeToZeroCopyStream(stream);
+                }));
+          }
+          progress_bar.update(++num_processed_tasks);
+        }
+      };
+
+  constexpr bool kAlwaysParallelize = true;
+  constexpr size_t kMaxNumberOfThreads = 8;
+  const size_t num_threads =
+      std::min(common::getNumHardwareThreads(), kMaxNumberOfThreads);
+  common::ParallelProcess(
+      num_protos, serialize_function, kAlwaysParallelize, num_threads);
+  return num_protos;
+}
+
+// Records the layout and the fingerprints of the proto files the map was
+// loaded from or saved to.
+void recordProtoFileState(
+    const std::string& folder_path,
+    const ProtoFileState::VertexFileList& vertex_files, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  ProtoFileState& state = map->getProtoFileState();
+  state.clear();
+  state.fingerprints.resize(internal::kMinNumProtos + vertex_files.size());
+  serializeProtoFilesToStreamFunction(
+      *map, vertex_files,
+      [&state](const size_t task_idx, const ProtoStreamWriter& writer) {
+        CHECK_LT(task_idx, state.fingerprints.size());
+        return common::proto_serialization_helper::computeFingerprint(
+            writer, &state.fingerprints[task_idx]);
+      });
+  state.vertex_files = vertex_files;
+  state.map_folder = folder_path;
+}
+
+// Keeps the vertices of the map in the vertex proto files they were recorded
+// in and appends the new ones in additional vertex proto files.
+void assignVerticesToRecordedFiles(
+    const vi_map::VIMap& map, const ProtoFileState& state,
+    const size_t vertices_per_file,
+    ProtoFileState::VertexFileList* vertex_files) {
+  CHECK_NOTNULL(vertex_files)->clear();
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  std::unordered_set<pose_graph::VertexId> unassigned_vertex_ids(
+      vertex_ids.begin(), vertex_ids.end());
+
+  // Files whose vertices were all removed are kept empty, such that the
+  // indices of the following files don't change.
+  vertex_files->reserve(state.vertex_files.size());
+  for (const pose_graph::VertexIdList& recorded_file : state.vertex_files) {
+    vertex_files->emplace_back();
+    for (const pose_graph::VertexId& vertex_id : recorded_file) {
+      if (unassigned_vertex_ids.erase(vertex_id) > 0u) {
+        vertex_files->back().emplace_back(vertex_id);
+      }
+    }
+  }
+
+  pose_graph::VertexIdList new_vertex_ids;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if (unassigned_vertex_ids.count(vertex_id) > 0u) {
+      new_vertex_ids.emplace_back(vertex_id);
+    }
+  }
+  splitIntoVertexFiles(new_vertex_ids, vertices_per_file, vertex_files);
+}
+
+// Writes only the proto files whose fingerprint differs from the recorded
+// one. The changed files are written next to the existing ones first and
+// replace them once all of them were written, such that a failed save leaves
+// the previous version of the map intact.
+bool saveChangedProtoFiles(
+    const std::string& complete_folder_path,
+    const backend::SaveConfig& config, vi_map::VIMap* map, size_t* num_files) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(num_files);
+  ProtoFileState& state = map->getProtoFileState();
+
+  ProtoFileState::VertexFileList vertex_files;
+  assignVerticesToRecordedFiles(
+      *map, state, config.vertices_per_proto_file, &vertex_files);
+
+  constexpr int kDefaultCompressionLevel = -1;
+  constexpr int kFastCompressionLevel = 1;
+  const char kTemporaryFileSuffix[] = ".tmp";
+  std::vector<uint64_t> fingerprints(
+      internal::kMinNumProtos + vertex_files.size());
+  // Not a std::vector<bool>, the tasks write their elements concurrently.
+  std::vector<unsigned char> is_changed(fingerprints.size(), 0u);
+  *num_files = serializeProtoFilesToStreamFunction(
+      *map, vertex_files,
+      [&](const size_t task_idx, const ProtoStreamWriter& writer) -> bool {
+        CHECK_LT(task_idx, fingerprints.size());
+        if (!common::proto_serialization_helper::computeFingerprint(
+                writer, &fingerprints[task_idx])) {
+          return false;
+        }
+        if (task_idx < state.fingerprints.size() &&
+            state.fingerprints[task_idx] == fingerprints[task_idx]) {
+          return true;
+        }
+        is_changed[task_idx] = 1u;
+        const bool use_fast_compression =
+            FLAGS_vi_map_fast_vertex_compression &&
+            task_idx >= internal::kProtoListVerticesStartIndex;
+        return common::proto_serialization_helper::serializeToFile(
+            complete_folder_path,
+            getFileNameFromIndex(task_idx) + kTemporaryFileSuffix, writer,
+            use_fast_compression ? kFastCompressionLevel
+                                 : kDefaultCompressionLevel);
+      });
+
+  size_t num_changed_files = 0u;
+  for (size_t task_idx = 0u; task_idx < is_changed.size(); ++task_idx) {
+    if (is_changed[task_idx] == 0u) {
+      continue;
+    }
+    const std::string path_to_file = common::concatenateFolderAndFileName(
+        complete_folder_path, getFileNameFromIndex(task_idx));
+    const std::string path_to_temporary_file =
+        path_to_file + kTemporaryFileSuffix;
+    if (std::rename(path_to_temporary_file.c_str(), path_to_file.c_str()) !=
+        0) {
+      LOG(ERROR) << "Could not replace " << path_to_file << " with "
+                 << path_to_temporary_file;
+      state.clear();
+      return false;
+    }
+    ++num_changed_files;
+  }
+  VLOG(1) << "Rewrote " << num_changed_files << " of " << *num_files
+          << " proto files.";
+
+  state.vertex_files.swap(vertex_files);
+  state.fingerprints.swap(fingerprints);
+  return true;
+}
+
+}  // namespace
+
+size_t serializeToStreamFunction(
+    const vi_map::VIMap& map, const backend::SaveConfig& save_config,
+    const std::function<bool(const size_t, const ProtoStreamWriter&)>&
+        function) {
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  ProtoFileState::VertexFileList vertex_files;
+  splitIntoVertexFiles(
+      vertex_ids, save_config.vertices_per_proto_file, &vertex_files);
+  const size_t num_protos =
+      serializeProtoFilesToStreamFunction(map, vertex_files, function);
+  CHECK_EQ(num_protos, internal::numberOfProtos(map, save_config));
+  return num_protos;
+}
+
 void deserializeFromListOfProtos(
     const std::vector<vi_map::proto::VIMap>& list_of_protos,
     vi_map::VIMap* map) {
@@ -495,11 +900,88 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   common::concatenateFolderAndFileName(
       folder_path, internal::kFolderName, &path_to_map_file);
 
+  // Vertex files are read from the columnar snapshot if it has them.
+  const std::string snapshot_folder = snapshot::getSnapshotFolder(folder_path);
+  const bool has_snapshot = common::pathExists(snapshot_folder);
+
   std::mutex map_mutex;
 
+  // The vertices are built without holding the map mutex, each proto file
+  // into its own staging slot, and are added to the map in bulk afterwards.
+  std::vector<std::vector<vi_map::Vertex::UniquePtr>> staged_vertices(
+      number_of_protos);
+  // Format version of each proto file.
+  std::vector<uint32_t> file_format_versions(
+      number_of_protos, getFormatVersionToWrite());
+
+  // Register all vertex proto files up front, such that the vertices can be
+  // deserialized concurrently.
+  VertexPayloadPager::Ptr payload_pager;
+  std::vector<size_t> payload_proto_file_indices(number_of_protos, 0u);
+  if (FLAGS_vi_map_lazy_load_vertex_payloads) {
+    CHECK_GE(FLAGS_vi_map_lazy_load_max_resident_mb, 0.0);
+    constexpr double kNumBytesPerMb = 1024.0 * 1024.0;
+    payload_pager = std::make_shared<VertexPayloadPager>(
+        path_to_map_file,
+        static_cast<size_t>(std::ceil(
+            FLAGS_vi_map_lazy_load_max_resident_mb * kNumBytesPerMb)));
+    for (size_t task_idx = internal::kProtoListVerticesStartIndex;
+         task_idx < number_of_protos; ++task_idx) {
+      payload_proto_file_indices[task_idx] = payload_pager->addProtoFile(
+          list_of_map_proto_filepaths[task_idx].substr(
+              std::strlen(internal::kFolderName) + 1u));
+    }
+  }
+
+  // Deserializes the parsed proto file of the given task.
+  std::function<void(const size_t, const proto::VIMap&)> deserialize_function =
+      [&map, &map_mutex, &staged_vertices, &file_format_versions,
+       &payload_pager, &payload_proto_file_indices,
+       &list_of_map_proto_filepaths](
+          const size_t task_idx, const proto::VIMap& proto) {
+        const uint32_t format_version = getFormatVersion(proto);
+        CHECK_LE(format_version, kCurrentFormatVersion)
+            << "The proto file " << list_of_map_proto_filepaths[task_idx]
+            << " has format version " << format_version
+            << ", but only versions up to " << kCurrentFormatVersion
+            << " are supported. The map was saved by a newer version of "
+            << "maplab.";
+        CHECK_LT(task_idx, file_format_versions.size());
+        file_format_versions[task_idx] = format_version;
+
+        switch (task_idx) {
+          case internal::kProtoListMissionsIndex: {
+            std::lock_guard<std::mutex> guard(map_mutex);
+            deserializeMissionsAndBaseframes(proto, map);
+          } break;
+          case internal::kProtoListEdgesIndex: {
+            std::lock_guard<std::mutex> guard(map_mutex);
+            deserializeEdges(proto, map);
+          } break;
+          case internal::kProtoListLandmarkIndexIndex: {
+            std::lock_guard<std::mutex> guard(map_mutex);
+            deserializeLandmarkIndex(proto, map);
+          } break;
+          case internal::kProtoListOptionalSensorData: {
+            std::lock_guard<std::mutex> guard(map_mutex);
+            deserializeOptionalSensorData(proto, map);
+          } break;
+          default: {
+            CHECK_GE(task_idx, internal::kProtoListVerticesStartIndex);
+            // Only reads the missions and sensors of the map, which are not
+            // modified while the vertices are loaded.
+            CHECK_LT(task_idx, staged_vertices.size());
+            deserializeVerticesWithoutAddingToMap(
+                proto, map, payload_pager, payload_proto_file_indices[task_idx],
+                &staged_vertices[task_idx]);
+          } break;
+        }
+      };
+
   std::function<void(const std::vector<size_t>)> load_function =
-      [&map, list_of_map_proto_filepaths, path_to_map_file, &progress_bar,
-       &map_mutex](const std::vector<size_t> range) {
+      [list_of_map_proto_filepaths, path_to_map_file, &progress_bar,
+       &deserialize_function, &snapshot_folder,
+       has_snapshot](const std::vector<size_t> range) {
         progress_bar.setNumElements(range.size());
         size_t num_processed_tasks = 0u;
 
@@ -519,33 +1001,15 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
 
           if (common::fileExists(complete_path_to_file)) {
             CHECK(!file_name.empty());
-            CHECK(
-                common::proto_serialization_helper::parseProtoFromFile(
-                    path_to_map_file, file_name, &proto));
-
-            switch (task_idx) {
-              case internal::kProtoListMissionsIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeMissionsAndBaseframes(proto, map);
-              } break;
-              case internal::kProtoListEdgesIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeEdges(proto, map);
-              } break;
-              case internal::kProtoListLandmarkIndexIndex: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeLandmarkIndex(proto, map);
-              } break;
-              case internal::kProtoListOptionalSensorData: {
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeOptionalSensorData(proto, map);
-              } break;
-              default: {
-                CHECK_GE(task_idx, internal::kProtoListVerticesStartIndex);
-                std::lock_guard<std::mutex> guard(map_mutex);
-                deserializeVertices(proto, map);
-              } break;
+            const bool is_vertex_file =
+                task_idx >= internal::kProtoListVerticesStartIndex;
+            if (!is_vertex_file || !has_snapshot ||
+                !snapshot::loadVertices(snapshot_folder, file_name, &proto)) {
+              CHECK(
+                  common::proto_serialization_helper::parseProtoFromFile(
+                      path_to_map_file, file_name, &proto));
             }
+            deserialize_function(task_idx, proto);
           } else {
             LOG(FATAL) << "Trying to read a proto file that does not exist!: "
                        << file_name;
@@ -561,16 +1025,79 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   // might depend on edges and can't be inserted into the map without the
   // corresponding vertices being present.
   constexpr bool kAlwaysParallelize = true;
-  constexpr size_t kMaxNumberOfThreads = 8;
-  const size_t num_threads =
-      std::min(common::getNumHardwareThreads(), kMaxNumberOfThreads);
+  const size_t num_threads = common::getNumHardwareThreads();
+
+  // Lazily loaded payloads would all have to be paged in to fingerprint the
+  // proto files.
+  const bool record_proto_file_state =
+      FLAGS_vi_map_incremental_save && !payload_pager;
+  ProtoFileState::VertexFileList loaded_vertex_files;
 
   const size_t end_index = number_of_protos;
   const size_t start_index = internal::kProtoListVerticesStartIndex;
   if (end_index > start_index) {
     VLOG(1) << "Reading vertices...";
-    common::ParallelProcess(
-        start_index, end_index, load_function, kAlwaysParallelize, num_threads);
+    if (has_snapshot) {
+      common::ParallelProcess(
+          start_index, end_index, load_function, kAlwaysParallelize,
+          num_threads);
+    } else {
+      // Reading the next vertex files overlaps with parsing the current ones.
+      // The files are parsed by threads that don't each own a share of them,
+      // so they report to a single progress bar.
+      std::vector<std::string> vertex_file_names;
+      vertex_file_names.reserve(end_index - start_index);
+      for (size_t task_idx = start_index; task_idx < end_index; ++task_idx) {
+        vertex_file_names.emplace_back(
+            list_of_map_proto_filepaths[task_idx].substr(
+                std::strlen(internal::kFolderName) + 1u));
+      }
+      common::ProgressBar vertex_progress_bar(vertex_file_names.size());
+      std::mutex vertex_progress_mutex;
+      size_t num_processed_vertex_files = 0u;
+      CHECK(
+          common::proto_serialization_helper::processFilesWithReadAhead(
+              path_to_map_file, vertex_file_names,
+              [&](const size_t file_idx, const std::string& content) -> bool {
+                proto::VIMap proto;
+                if (!common::proto_serialization_helper::
+                        parseProtoFromFileContent(
+                            content.data(), content.size(), &proto)) {
+                  LOG(ERROR) << "Error parsing the vertex proto file "
+                             << vertex_file_names[file_idx] << ".";
+                  return false;
+                }
+                deserialize_function(start_index + file_idx, proto);
+                if (FLAGS_show_progress_bar) {
+                  std::lock_guard<std::mutex> lock(vertex_progress_mutex);
+                  vertex_progress_bar.update(++num_processed_vertex_files);
+                }
+                return true;
+              },
+              num_threads))
+          << "Failed to load the vertices from " << path_to_map_file << ".";
+    }
+
+    if (record_proto_file_state) {
+      for (size_t task_idx = start_index; task_idx < end_index; ++task_idx) {
+        loaded_vertex_files.emplace_back();
+        loaded_vertex_files.back().reserve(staged_vertices[task_idx].size());
+        for (const vi_map::Vertex::UniquePtr& vertex :
+             staged_vertices[task_idx]) {
+          loaded_vertex_files.back().emplace_back(vertex->id());
+        }
+      }
+    }
+
+    size_t num_vertices = 0u;
+    for (const std::vector<vi_map::Vertex::UniquePtr>& vertices :
+         staged_vertices) {
+      num_vertices += vertices.size();
+    }
+    map->reserveVertices(map->numVertices() + num_vertices);
+    for (std::vector<vi_map::Vertex::UniquePtr>& vertices : staged_vertices) {
+      map->addVertices(&vertices);
+    }
   } else {
     VLOG(1) << "No vertex data found.";
   }
@@ -587,6 +1114,27 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   CHECK(
       backend::resource_map_serialization::loadMapFromFolder(folder_path, map));
 
+  // The recorded fingerprints are those of the files in the format that is
+  // written, files in another format would not be rewritten by an incremental
+  // save if the map is unchanged.
+  const bool has_other_format_version = std::any_of(
+      file_format_versions.begin(), file_format_versions.end(),
+      [](const uint32_t format_version) {
+        return format_version != getFormatVersionToWrite();
+      });
+  if (has_other_format_version) {
+    LOG(WARNING) << "The map in \"" << folder_path << "\" is not stored in "
+                 << "format version " << getFormatVersionToWrite()
+                 << ", saving it rewrites all of its files. Use the "
+                 << "migrate_map command to convert it.";
+  }
+
+  if (record_proto_file_state && !has_other_format_version) {
+    recordProtoFileState(folder_path, loaded_vertex_files, map);
+  } else {
+    map->getProtoFileState().clear();
+  }
+
   LOG(INFO) << "Loaded VIMap from \"" << folder_path << "\".";
   return true;
 }
@@ -611,6 +1159,14 @@ bool saveMapToFolder(
     return false;
   }
 
+  // Lazily loaded vertex payloads are paged in from the proto files that are
+  // about to be overwritten, hence they all have to be loaded and kept.
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    map->getVertex(vertex_id).pinPayload();
+  }
+
   map->setMapFolder(folder_path);
 
   // Serialize the sensors.
@@ -620,15 +1176,78 @@ bool saveMapToFolder(
       &sensors_yaml_filepath);
   map->getSensorManager().serializeToFile(sensors_yaml_filepath);
 
-  const size_t num_files = serializeToFunction(
-      *map, config,
-      [&complete_folder_path](
-          const size_t task_idx, const proto::VIMap& proto) -> bool {
-        const std::string file_name = getFileNameFromIndex(task_idx);
-        CHECK(!file_name.empty());
-        return common::proto_serialization_helper::serializeProtoToFile(
-            complete_folder_path, file_name, proto);
-      });
+  // A snapshot of a previous save would be stale after this one.
+  const std::string snapshot_folder = snapshot::getSnapshotFolder(folder_path);
+  if (!common::removePath(snapshot_folder)) {
+    LOG(ERROR) << "Could not remove the outdated snapshot " << snapshot_folder;
+    return false;
+  }
+  if (config.save_columnar_snapshot && !common::createPath(snapshot_folder)) {
+    LOG(ERROR) << "Could not create the snapshot folder " << snapshot_folder;
+    return false;
+  }
+
+  // Only the proto files that changed since the map was loaded from or saved
+  // to this folder are rewritten, if their content was recorded.
+  const bool save_incrementally = FLAGS_vi_map_incremental_save &&
+                                  !config.save_columnar_snapshot &&
+                                  map->getProtoFileState().isValidForFolder(
+                                      folder_path);
+
+  size_t num_files = 0u;
+  if (save_incrementally) {
+    if (!saveChangedProtoFiles(complete_folder_path, config, map, &num_files)) {
+      LOG(ERROR) << "Could not update the proto files of the map.";
+      return false;
+    }
+  } else if (config.save_columnar_snapshot) {
+    // The snapshot is derived from the complete vertex protos.
+    num_files = serializeToFunction(
+        *map, config,
+        [&complete_folder_path, &snapshot_folder](
+            const size_t task_idx, const proto::VIMap& proto) -> bool {
+          const std::string file_name = getFileNameFromIndex(task_idx);
+          CHECK(!file_name.empty());
+          if (!common::proto_serialization_helper::serializeProtoToFile(
+                  complete_folder_path, file_name, proto)) {
+            return false;
+          }
+          if (task_idx >= internal::kProtoListVerticesStartIndex) {
+            proto::VIMap residual_proto = proto;
+            return snapshot::saveVertices(
+                snapshot_folder, file_name, &residual_proto);
+          }
+          return true;
+        });
+  } else {
+    constexpr int kDefaultCompressionLevel = -1;
+    constexpr int kFastCompressionLevel = 1;
+    num_files = serializeToStreamFunction(
+        *map, config,
+        [&complete_folder_path](
+            const size_t task_idx, const ProtoStreamWriter& writer) -> bool {
+          const std::string file_name = getFileNameFromIndex(task_idx);
+          CHECK(!file_name.empty());
+          const bool use_fast_compression =
+              FLAGS_vi_map_fast_vertex_compression &&
+              task_idx >= internal::kProtoListVerticesStartIndex;
+          return common::proto_serialization_helper::serializeToFile(
+              complete_folder_path, file_name, writer,
+              use_fast_compression ? kFastCompressionLevel
+                                   : kDefaultCompressionLevel);
+        });
+  }
+
+  if (!save_incrementally) {
+    if (FLAGS_vi_map_incremental_save && !config.save_columnar_snapshot) {
+      ProtoFileState::VertexFileList saved_vertex_files;
+      splitIntoVertexFiles(
+          vertex_ids, config.vertices_per_proto_file, &saved_vertex_files);
+      recordProtoFileState(folder_path, saved_vertex_files, map);
+    } else {
+      map->getProtoFileState().clear();
+    }
+  }
 
   // Delete leftover vertex files from previous maps.
   size_t vertex_file_index_to_delete = num_files - internal::kMinNumProtos;
@@ -0,0 +1,394 @@
+#include "vi-map/vi-map-snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <functional>
+#include <vector>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/proto-serialization-helper.h>
+
+namespace vi_map {
+namespace serialization {
+namespace snapshot {
+namespace {
+
+// Column file layout, all values in host byte order:
+//   FileHeader
+//   ColumnHeader[kNumColumns]
+//   per column, each aligned to kColumnAlignmentBytes:
+//     uint32_t number of elements of each array
+//     elements of all arrays, concatenated
+constexpr char kMagic[8] = {'V', 'I', 'M', 'S', 'N', 'A', 'P', '\0'};
+
+// The columns in the order in which the arrays of a vertex are visited.
+enum Column : uint32_t {
+  kVertexPose,
+  kKeypointMeasurements,
+  kKeypointMeasurementSigmas,
+  kDescriptorScales,
+  kKeypointDescriptors,
+  kLandmarkPositions,
+  kNumColumns
+};
+
+constexpr uint32_t kColumnElementSizes[kNumColumns] = {
+    sizeof(double), sizeof(double), sizeof(double),
+    sizeof(double), sizeof(char),   sizeof(double)};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_columns;
+};
+
+struct ColumnHeader {
+  uint32_t column;
+  uint32_t element_size;
+  uint64_t num_arrays;
+  uint64_t counts_offset;
+  uint64_t elements_offset;
+  uint64_t num_element_bytes;
+};
+
+size_t alignOffset(size_t offset) {
+  return (offset + kColumnAlignmentBytes - 1u) / kColumnAlignmentBytes *
+         kColumnAlignmentBytes;
+}
+
+std::string getColumnFilePath(
+    const std::string& snapshot_folder, const std::string& file_name) {
+  return common::concatenateFolderAndFileName(
+      snapshot_folder, file_name + kColumnFileSuffix);
+}
+
+// Visits all dense arrays of the vertices of the proto in column order.
+void forEachDenseArray(
+    const std::function<void(Column, google::protobuf::RepeatedField<double>*)>&
+        double_array_action,
+    const std::function<void(Column, std::string*)>& byte_array_action,
+    vi_map::proto::VIMap* proto) {
+  CHECK(double_array_action);
+  CHECK(byte_array_action);
+  CHECK_NOTNULL(proto);
+  for (vi_map::proto::ViwlsVertex& vertex : *proto->mutable_vertices()) {
+    double_array_action(kVertexPose, vertex.mutable_t_m_i());
+    if (vertex.has_n_visual_frame()) {
+      for (aslam::proto::VisualFrame& frame :
+           *vertex.mutable_n_visual_frame()->mutable_frames()) {
+        double_array_action(
+            kKeypointMeasurements, frame.mutable_keypoint_measurements());
+        double_array_action(
+            kKeypointMeasurementSigmas,
+            frame.mutable_keypoint_measurement_sigmas());
+        double_array_action(
+            kDescriptorScales, frame.mutable_descriptor_scales());
+        byte_array_action(
+            kKeypointDescriptors, frame.mutable_keypoint_descriptors());
+      }
+    }
+    if (vertex.has_landmark_store()) {
+      for (vi_map::proto::Landmark& landmark :
+           *vertex.mutable_landmark_store()->mutable_landmarks()) {
+        double_array_action(kLandmarkPositions, landmark.mutable_position());
+      }
+    }
+  }
+}
+
+class ColumnWriter {
+ public:
+  ColumnWriter() : columns_(kNumColumns) {}
+
+  void add(Column column, const char* data, size_t num_bytes) {
+    CHECK_LT(column, kNumColumns);
+    CHECK_EQ(num_bytes % kColumnElementSizes[column], 0u);
+    columns_[column].counts.push_back(
+        static_cast<uint32_t>(num_bytes / kColumnElementSizes[column]));
+    columns_[column].elements.append(data, num_bytes);
+  }
+
+  bool write(const std::string& file_path) const {
+    FileHeader file_header;
+    std::memcpy(file_header.magic, kMagic, sizeof(kMagic));
+    file_header.version = kVersion;
+    file_header.num_columns = kNumColumns;
+
+    std::vector<ColumnHeader> column_headers(kNumColumns);
+    size_t offset =
+        sizeof(FileHeader) + kNumColumns * sizeof(ColumnHeader);
+    for (uint32_t column = 0u; column < kNumColumns; ++column) {
+      ColumnHeader& column_header = column_headers[column];
+      column_header.column = column;
+      column_header.element_size = kColumnElementSizes[column];
+      column_header.num_arrays = columns_[column].counts.size();
+      offset = alignOffset(offset);
+      column_header.counts_offset = offset;
+      offset += columns_[column].counts.size() * sizeof(uint32_t);
+      offset = alignOffset(offset);
+      column_header.elements_offset = offset;
+      column_header.num_element_bytes = columns_[column].elements.size();
+      offset += columns_[column].elements.size();
+    }
+
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Unable to open " << file_path << " for writing.";
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&file_header), sizeof(FileHeader));
+    file.write(
+        reinterpret_cast<const char*>(column_headers.data()),
+        kNumColumns * sizeof(ColumnHeader));
+    for (uint32_t column = 0u; column < kNumColumns; ++column) {
+      const ColumnHeader& column_header = column_headers[column];
+      pad(column_header.counts_offset, &file);
+      file.write(
+          reinterpret_cast<const char*>(columns_[column].counts.data()),
+          columns_[column].counts.size() * sizeof(uint32_t));
+      pad(column_header.elements_offset, &file);
+      file.write(
+          columns_[column].elements.data(), columns_[column].elements.size());
+    }
+    file.close();
+    if (file.fail()) {
+      LOG(ERROR) << "Failed to write " << file_path;
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  static void pad(size_t offset, std::ofstream* file) {
+    CHECK_NOTNULL(file);
+    const size_t position = static_cast<size_t>(file->tellp());
+    CHECK_LE(position, offset);
+    const std::string padding(offset - position, '\0');
+    file->write(padding.data(), padding.size());
+  }
+
+  struct ColumnData {
+    std::vector<uint32_t> counts;
+    std::string elements;
+  };
+  std::vector<ColumnData> columns_;
+};
+
+// Reads the arrays of the columns in order from a read-only memory mapping of
+// the column file.
+class ColumnReader {
+ public:
+  explicit ColumnReader(const std::string& file_path)
+      : data_(nullptr), num_bytes_(0u), cursors_(kNumColumns) {
+    const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) == 0 && file_stat.st_size > 0) {
+      void* data = mmap(
+          nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ,
+          MAP_PRIVATE, file_descriptor, 0);
+      if (data == MAP_FAILED) {
+        LOG(ERROR) << "Unable to map " << file_path;
+      } else {
+        data_ = static_cast<const char*>(data);
+        num_bytes_ = static_cast<size_t>(file_stat.st_size);
+      }
+    }
+    close(file_descriptor);
+  }
+
+  ~ColumnReader() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), num_bytes_);
+    }
+  }
+
+  // Checks the header and the bounds of all columns.
+  bool isValid() const {
+    if (data_ == nullptr ||
+        num_bytes_ < sizeof(FileHeader) + kNumColumns * sizeof(ColumnHeader)) {
+      return false;
+    }
+    const FileHeader* file_header = reinterpret_cast<const FileHeader*>(data_);
+    if (std::memcmp(file_header->magic, kMagic, sizeof(kMagic)) != 0) {
+      LOG(WARNING) << "Not a vertex snapshot column file.";
+      return false;
+    }
+    if (file_header->version != kVersion ||
+        file_header->num_columns != kNumColumns) {
+      LOG(WARNING) << "Unsupported vertex snapshot version "
+                   << file_header->version << ", expected " << kVersion << ".";
+      return false;
+    }
+    for (uint32_t column = 0u; column < kNumColumns; ++column) {
+      const ColumnHeader& column_header = getColumnHeader(column);
+      if (column_header.column != column ||
+          column_header.element_size != kColumnElementSizes[column] ||
+          column_header.counts_offset +
+                  column_header.num_arrays * sizeof(uint32_t) >
+              num_bytes_ ||
+          column_header.elements_offset + column_header.num_element_bytes >
+              num_bytes_) {
+        LOG(WARNING) << "Corrupt vertex snapshot column " << column << ".";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns the next array of the column, false if the column is exhausted.
+  bool next(Column column, const char** data, size_t* num_bytes) {
+    CHECK_LT(column, kNumColumns);
+    CHECK_NOTNULL(data);
+    CHECK_NOTNULL(num_bytes);
+    const ColumnHeader& column_header = getColumnHeader(column);
+    Cursor& cursor = cursors_[column];
+    if (cursor.array_index >= column_header.num_arrays) {
+      return false;
+    }
+    uint32_t num_elements;
+    std::memcpy(
+        &num_elements,
+        data_ + column_header.counts_offset +
+            cursor.array_index * sizeof(uint32_t),
+        sizeof(uint32_t));
+    *num_bytes = static_cast<size_t>(num_elements) * column_header.element_size;
+    if (cursor.element_byte_offset + *num_bytes >
+        column_header.num_element_bytes) {
+      return false;
+    }
+    *data = data_ + column_header.elements_offset + cursor.element_byte_offset;
+    ++cursor.array_index;
+    cursor.element_byte_offset += *num_bytes;
+    return true;
+  }
+
+  bool isFullyConsumed() const {
+    for (uint32_t column = 0u; column < kNumColumns; ++column) {
+      if (cursors_[column].array_index != getColumnHeader(column).num_arrays) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  const ColumnHeader& getColumnHeader(uint32_t column) const {
+    CHECK_NOTNULL(data_);
+    CHECK_LT(column, kNumColumns);
+    return reinterpret_cast<const ColumnHeader*>(
+        data_ + sizeof(FileHeader))[column];
+  }
+
+  struct Cursor {
+    size_t array_index = 0u;
+    size_t element_byte_offset = 0u;
+  };
+
+  const char* data_;
+  size_t num_bytes_;
+  std::vector<Cursor> cursors_;
+};
+
+}  // namespace
+
+std::string getSnapshotFolder(const std::string& map_folder) {
+  return common::concatenateFolderAndFileName(map_folder, kFolderName);
+}
+
+bool saveVertices(
+    const std::string& snapshot_folder, const std::string& file_name,
+    vi_map::proto::VIMap* proto) {
+  CHECK(!snapshot_folder.empty());
+  CHECK(!file_name.empty());
+  CHECK_NOTNULL(proto);
+
+  ColumnWriter writer;
+  forEachDenseArray(
+      [&writer](Column column, google::protobuf::RepeatedField<double>* array) {
+        writer.add(
+            column, reinterpret_cast<const char*>(array->data()),
+            array->size() * sizeof(double));
+        array->Clear();
+      },
+      [&writer](Column column, std::string* array) {
+        writer.add(column, array->data(), array->size());
+        array->clear();
+      },
+      proto);
+
+  return writer.write(getColumnFilePath(snapshot_folder, file_name)) &&
+         common::proto_serialization_helper::serializeProtoToFile(
+             snapshot_folder, file_name, *proto);
+}
+
+bool loadVertices(
+    const std::string& snapshot_folder, const std::string& file_name,
+    vi_map::proto::VIMap* proto) {
+  CHECK(!snapshot_folder.empty());
+  CHECK(!file_name.empty());
+  CHECK_NOTNULL(proto);
+
+  const std::string column_file_path =
+      getColumnFilePath(snapshot_folder, file_name);
+  if (!common::fileExists(column_file_path) ||
+      !common::fileExists(
+          common::concatenateFolderAndFileName(snapshot_folder, file_name))) {
+    return false;
+  }
+  ColumnReader reader(column_file_path);
+  if (!reader.isValid() ||
+      !common::proto_serialization_helper::parseProtoFromFile(
+          snapshot_folder, file_name, proto)) {
+    proto->Clear();
+    return false;
+  }
+
+  bool success = true;
+  forEachDenseArray(
+      [&reader, &success](
+          Column column, google::protobuf::RepeatedField<double>* array) {
+        const char* data;
+        size_t num_bytes;
+        if (!success || !reader.next(column, &data, &num_bytes)) {
+          success = false;
+          return;
+        }
+        const int num_elements = static_cast<int>(num_bytes / sizeof(double));
+        array->Resize(num_elements, 0.0);
+        if (num_elements > 0) {
+          std::memcpy(array->mutable_data(), data, num_bytes);
+        }
+      },
+      [&reader, &success](Column column, std::string* array) {
+        const char* data;
+        size_t num_bytes;
+        if (!success || !reader.next(column, &data, &num_bytes)) {
+          success = false;
+          return;
+        }
+        array->assign(data, num_bytes);
+      },
+      proto);
+
+  if (!success || !reader.isFullyConsumed()) {
+    LOG(WARNING) << "The vertex snapshot " << file_name << " in "
+                 << snapshot_folder
+                 << " does not match its residual proto file.";
+    proto->Clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace snapshot
+}  // namespace serialization
+}  // namespace vi_map
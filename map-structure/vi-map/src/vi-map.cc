@@ -1,15 +1,22 @@
 #include "vi-map/vi-map.h"
 
+#include <atomic>
 #include <limits>
 #include <queue>
+#include <unordered_set>
+#include <utility>
 
 #include <aslam/common/memory.h>
 #include <aslam/common/time.h>
 #include <map-resources/resource_metadata.pb.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "vi-map/deprecated/vi-map-serialization-deprecated.h"
+#include "vi-map/resource-index.h"
 #include "vi-map/semantics-manager.h"
+#include "vi-map/vertex-payload-pager.h"
 #include "vi-map/vertex.h"
 #include "vi-map/vi-map-serialization.h"
 
@@ -41,8 +48,36 @@ void VIMap::deepCopy(const VIMap& other) {
   ResourceMap::deepCopyFrom(other);
 }
 
-void VIMap::mergeAllMissionsFromMapWithoutResources(
-    const vi_map::VIMap& other) {
+void VIMap::copyPoseGraphFrom(const VIMap& other) {
+  clear();
+  mergeMissionsAndSensorsFromMap(other);
+
+  pose_graph::VertexIdList vertex_ids;
+  other.getAllVertexIds(&vertex_ids);
+  reserveVertices(vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& other_vertex = other.getVertex(vertex_id);
+    vi_map::Vertex::UniquePtr vertex = aligned_unique<vi_map::Vertex>();
+    vertex->setId(vertex_id);
+    vertex->setMissionId(other_vertex.getMissionId());
+    vertex->set_T_M_I(other_vertex.get_T_M_I());
+    vertex->set_v_M(other_vertex.get_v_M());
+    vertex->setAccelBias(other_vertex.getAccelBias());
+    vertex->setGyroBias(other_vertex.getGyroBias());
+    addVertex(std::move(vertex));
+  }
+
+  // Adding the edges one by one registers them with their vertices.
+  pose_graph::EdgeIdList edge_ids;
+  other.getAllEdgeIds(&edge_ids);
+  for (const pose_graph::EdgeId& edge_id : edge_ids) {
+    vi_map::Edge* copied_edge = nullptr;
+    other.getEdgeAs<vi_map::Edge>(edge_id).copyEdgeInto(&copied_edge);
+    addEdge(vi_map::Edge::UniquePtr(CHECK_NOTNULL(copied_edge)));
+  }
+}
+
+void VIMap::mergeMissionsAndSensorsFromMap(const vi_map::VIMap& other) {
   const SensorManager& other_sensor_manager = other.getSensorManager();
 
   // Get all missions from old map and add them into the new map.
@@ -83,41 +118,45 @@ void VIMap::mergeAllMissionsFromMapWithoutResources(
     vi_map::Mission& copied_mission = getMission(other_mission_id);
     copied_mission.setRootVertexId(other_mission.getRootVertexId());
   }
+}
 
-  // Get all vertices and add them into the new map.
+void VIMap::mergeAllMissionsFromMapWithoutResources(
+    const vi_map::VIMap& other) {
+  mergeMissionsAndSensorsFromMap(other);
+
+  // Copy all vertices and edges in parallel and insert them at once. The
+  // copied vertices already reference their edges.
   pose_graph::VertexIdList vertex_ids;
   other.getAllVertexIds(&vertex_ids);
-
-  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-    const vi_map::Vertex& original_vertex = other.getVertex(vertex_id);
-    vi_map::Vertex::UniquePtr copied_vertex =
-        aligned_unique<vi_map::Vertex>(original_vertex);
-    addVertex(std::move(copied_vertex));
-  }
-
-  // Add all edges into the new map.
   pose_graph::EdgeIdList edge_ids;
   other.getAllEdgeIds(&edge_ids);
+  std::vector<pose_graph::Vertex::UniquePtr> copied_vertices(vertex_ids.size());
+  std::vector<pose_graph::Edge::UniquePtr> copied_edges(edge_ids.size());
+  const size_t num_vertices = vertex_ids.size();
+  auto copy_vertices_and_edges = [&](const std::vector<size_t>& range) {
+    for (const size_t idx : range) {
+      if (idx < num_vertices) {
+        const vi_map::Vertex& original_vertex =
+            other.getVertex(vertex_ids[idx]);
+        CHECK(hasMission(original_vertex.getMissionId()));
+        copied_vertices[idx] = aligned_unique<vi_map::Vertex>(original_vertex);
+      } else {
+        const vi_map::Edge& original_edge =
+            other.getEdgeAs<vi_map::Edge>(edge_ids[idx - num_vertices]);
+        vi_map::Edge* copied_edge;
+        original_edge.copyEdgeInto(&copied_edge);
+        copied_edges[idx - num_vertices] =
+            vi_map::Edge::UniquePtr(copied_edge);
+      }
+    }
+  };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_vertices + edge_ids.size(), copy_vertices_and_edges,
+      kAlwaysParallelize, common::getNumHardwareThreads());
+  posegraph.addSubgraph(&copied_vertices, &copied_edges);
 
-  for (const pose_graph::EdgeId& edge_id : edge_ids) {
-    const vi_map::Edge& original_edge = other.getEdgeAs<vi_map::Edge>(edge_id);
-    vi_map::Edge* copied_edge;
-    original_edge.copyEdgeInto(&copied_edge);
-    addEdge(vi_map::Edge::UniquePtr(copied_edge));
-  }
-
-  // Add landmarks into copy of map.
-  const LandmarkIndex& original_landmark_index = other.landmark_index;
-  vi_map::LandmarkIdList landmarks_ids;
-  original_landmark_index.getAllLandmarkIds(&landmarks_ids);
-  for (const vi_map::LandmarkId& landmark_id : landmarks_ids) {
-    CHECK(landmark_id.isValid());
-    const pose_graph::VertexId& original_landmark_store_vertex_id =
-        original_landmark_index.getStoringVertexId(landmark_id);
-    CHECK(hasVertex(original_landmark_store_vertex_id));
-    landmark_index.addLandmarkAndVertexReference(
-        landmark_id, original_landmark_store_vertex_id);
-  }
+  landmark_index.addAllLandmarksFrom(other.landmark_index);
 
   for (const OptionalSensorDataMap::value_type& other_optional_sensor_data :
       other.optional_sensor_data_map_) {
@@ -138,6 +177,40 @@ void VIMap::mergeAllMissionsFromMap(const vi_map::VIMap& other) {
   ResourceMap::mergeFromMap(other);
 }
 
+void VIMap::moveAllMissionsFromMap(vi_map::VIMap* other) {
+  CHECK_NOTNULL(other);
+  CHECK_NE(other, this);
+  VLOG(1) << "Moving all missions from VI-Map.";
+  mergeMissionsAndSensorsFromMap(*other);
+
+  // The vertices and edges are moved, not copied.
+  posegraph.moveAllFrom(&other->posegraph);
+  landmark_index.addAllLandmarksFrom(other->landmark_index);
+
+  for (OptionalSensorDataMap::value_type& other_optional_sensor_data :
+       other->optional_sensor_data_map_) {
+    const MissionId& mission_id = other_optional_sensor_data.first;
+    CHECK(hasMission(mission_id));
+    CHECK(optional_sensor_data_map_.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(mission_id),
+        std::forward_as_tuple(
+            std::move(other_optional_sensor_data.second))).second);
+  }
+  other->optional_sensor_data_map_.clear();
+
+  VLOG(1) << "Copying metadata and resource infos.";
+  ResourceMap::mergeFromMap(*other);
+  other->clear();
+}
+
+void VIMap::reserveForMerge(
+    size_t num_vertices, size_t num_edges, size_t num_landmarks) {
+  posegraph.reserveVertices(num_vertices);
+  posegraph.reserveEdges(num_edges);
+  landmark_index.reserve(num_landmarks);
+}
+
 void VIMap::swap(VIMap* other) {
   CHECK_NOTNULL(other);
   posegraph.swap(&other->posegraph);
@@ -145,6 +218,7 @@ void VIMap::swap(VIMap* other) {
   mission_base_frames.swap(other->mission_base_frames);
   landmark_index.swap(&other->landmark_index);
   optional_sensor_data_map_.swap(other->optional_sensor_data_map_);
+  std::swap(proto_file_state_, other->proto_file_state_);
 }
 
 bool VIMap::hexStringToMissionIdIfValid(
@@ -288,116 +362,248 @@ void VIMap::sparsifyMission(
   CHECK(hasMission(mission_id)) << "The mission " << mission_id << " is not "
                                 << "present or selected.";
 
-  const vi_map::VIMission& mission = getMission(mission_id);
-  const pose_graph::VertexId& root_vertex_id = mission.getRootVertexId();
-
-  pose_graph::VertexId kept_vertex_id = root_vertex_id;
-  pose_graph::VertexId current_vertex_id;
-
-  do {
-    current_vertex_id = kept_vertex_id;
-    VLOG(4) << "Vertex " << kept_vertex_id.hexString() << " : landmark count: "
-            << getVertex(kept_vertex_id).getLandmarks().size();
-    for (int i = 0; i < (every_nth_vertex_to_keep - 1); ++i) {
-      if (getNextVertex(
-              kept_vertex_id, getGraphTraversalEdgeType(mission_id),
-              &current_vertex_id)) {
-        VLOG(4) << "Merging " << i << "th vertex "
-                << current_vertex_id.hexString() << " into "
-                << kept_vertex_id.hexString();
-        mergeNeighboringVertices(kept_vertex_id, current_vertex_id);
-      } else {
-        break;
-      }
+  const pose_graph::Edge::EdgeType traversal_edge_type =
+      getGraphTraversalEdgeType(mission_id);
+
+  // Plan all segments along the graph first, they are then merged at once.
+  std::vector<std::pair<pose_graph::VertexId, pose_graph::VertexIdList>>
+      segments;
+  pose_graph::VertexId current_vertex_id =
+      getMission(mission_id).getRootVertexId();
+  bool has_next_vertex = true;
+  while (has_next_vertex) {
+    const pose_graph::VertexId kept_vertex_id = current_vertex_id;
+    pose_graph::VertexIdList merged_vertex_ids;
+    while (
+        (has_next_vertex = getNextVertex(
+             current_vertex_id, traversal_edge_type, &current_vertex_id)) &&
+        merged_vertex_ids.size() <
+            static_cast<size_t>(every_nth_vertex_to_keep - 1)) {
+      merged_vertex_ids.emplace_back(current_vertex_id);
     }
-  } while (getNextVertex(
-      kept_vertex_id, getGraphTraversalEdgeType(mission_id), &kept_vertex_id));
+    VLOG(4) << "Merging " << merged_vertex_ids.size() << " vertices into "
+            << kept_vertex_id.hexString();
+    segments.emplace_back(kept_vertex_id, merged_vertex_ids);
+  }
+  mergeVertexSegments(segments);
 }
 
-void VIMap::getStatisticsOfMission(
-    const vi_map::MissionId& mission_id,
-    std::vector<size_t>* num_good_landmarks_per_camera,
-    std::vector<size_t>* num_bad_landmarks_per_camera,
-    std::vector<size_t>* num_unknown_landmarks_per_camera,
-    std::vector<size_t>* total_num_landmarks_per_camera, size_t* num_landmarks,
-    size_t* num_vertices, size_t* num_observations, double* duration_s,
-    int64_t* start_time_ns, int64_t* end_time_ns) const {
-  CHECK_NOTNULL(num_good_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(num_bad_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(num_unknown_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(total_num_landmarks_per_camera)->clear();
-  CHECK_NOTNULL(num_observations);
-  CHECK_NOTNULL(duration_s);
-  CHECK_NOTNULL(start_time_ns);
-  CHECK_NOTNULL(end_time_ns);
+void VIMap::getMissionStatistics(
+    const vi_map::MissionId& mission_id, MissionStatistics* statistics) const {
+  CHECK_NOTNULL(statistics);
   CHECK(mission_id.isValid());
-  *num_observations = 0u;
-  *num_vertices = 0u;
-  *num_landmarks = 0u;
+  *statistics = MissionStatistics();
 
   const aslam::NCameraId& ncamera_id =
       sensor_manager_.getNCameraForMission(mission_id).getId();
   CHECK(ncamera_id.isValid());
-  const aslam::NCamera& ncamera = sensor_manager_.getNCamera(ncamera_id);
-  const size_t num_cameras = ncamera.numCameras();
-  num_good_landmarks_per_camera->resize(num_cameras, 0u);
-  num_bad_landmarks_per_camera->resize(num_cameras, 0u);
-  num_unknown_landmarks_per_camera->resize(num_cameras, 0u);
-  total_num_landmarks_per_camera->resize(num_cameras, 0u);
+  const size_t num_cameras =
+      sensor_manager_.getNCamera(ncamera_id).numCameras();
+  statistics->resizeCameras(num_cameras);
 
   pose_graph::VertexIdList vertex_ids;
   getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
-  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
-    const vi_map::Vertex& vertex = getVertex(vertex_id);
-    ++(*num_vertices);
-    *num_landmarks += vertex.getLandmarks().size();
-    for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
-      const KeypointIdentifierList& observations = landmark.getObservations();
-      if (!observations.empty()) {
-        const size_t first_observation_frame_idx =
-            observations.front().frame_id.frame_index;
-        CHECK_LT(first_observation_frame_idx, num_cameras);
-
-        if (landmark.getQuality() == vi_map::Landmark::Quality::kUnknown) {
-          ++((*num_unknown_landmarks_per_camera)[first_observation_frame_idx]);
-        } else if (landmark.getQuality() == vi_map::Landmark::Quality::kBad) {
-          ++((*num_bad_landmarks_per_camera)[first_observation_frame_idx]);
-        } else if (landmark.getQuality() == vi_map::Landmark::Quality::kGood) {
-          ++((*num_good_landmarks_per_camera)[first_observation_frame_idx]);
-        }
-        ++((*total_num_landmarks_per_camera)[first_observation_frame_idx]);
-      }
-    }
 
-    const unsigned int num_frames = vertex.numFrames();
-    for (unsigned int frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
-      if (vertex.isVisualFrameSet(frame_idx) &&
-          vertex.isVisualFrameValid(frame_idx)) {
-        *num_observations +=
-            vertex.getVisualFrame(frame_idx).getNumKeypointMeasurements();
-      }
-    }
-  }
+  // Every block of vertices is counted separately, the distance between two
+  // vertices is counted for the later one.
+  std::mutex statistics_mutex;
+  std::function<void(const std::vector<size_t>&)> count_vertices =
+      [&](const std::vector<size_t>& batch) {
+        MissionStatistics batch_statistics;
+        batch_statistics.resizeCameras(num_cameras);
+        for (const size_t idx : batch) {
+          const vi_map::Vertex& vertex = getVertex(vertex_ids[idx]);
+          ++batch_statistics.num_vertices;
+          batch_statistics.num_landmarks += vertex.getLandmarks().size();
+          for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+            const KeypointIdentifierList& observations =
+                landmark.getObservations();
+            if (observations.empty()) {
+              continue;
+            }
+            // The frame index is the index of the camera in the rig.
+            const size_t camera_idx = observations.front().frame_id.frame_index;
+            CHECK_LT(camera_idx, num_cameras);
+            const vi_map::Landmark::Quality quality = landmark.getQuality();
+            if (quality == vi_map::Landmark::Quality::kUnknown) {
+              ++batch_statistics.num_unknown_landmarks_per_camera[camera_idx];
+            } else if (quality == vi_map::Landmark::Quality::kBad) {
+              ++batch_statistics.num_bad_landmarks_per_camera[camera_idx];
+            } else if (quality == vi_map::Landmark::Quality::kGood) {
+              ++batch_statistics.num_good_landmarks_per_camera[camera_idx];
+            }
+            ++batch_statistics.total_num_landmarks_per_camera[camera_idx];
+          }
+
+          const unsigned int num_frames = vertex.numFrames();
+          for (unsigned int frame_idx = 0; frame_idx < num_frames;
+               ++frame_idx) {
+            if (vertex.isVisualFrameSet(frame_idx) &&
+                vertex.isVisualFrameValid(frame_idx)) {
+              batch_statistics.num_observations +=
+                  vertex.getVisualFrame(frame_idx)
+                      .getNumKeypointMeasurements();
+            }
+          }
+
+          pose_graph::EdgeIdSet outgoing_edges;
+          vertex.getOutgoingEdges(&outgoing_edges);
+          for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+            CHECK(edge_id.isValid());
+            switch (getEdgeType(edge_id)) {
+              case pose_graph::Edge::EdgeType::kOdometry:
+                ++batch_statistics.num_wheel_odometry_edges;
+                break;
+              case pose_graph::Edge::EdgeType::kLoopClosure:
+                ++batch_statistics.num_loop_closure_edges;
+                break;
+              case pose_graph::Edge::EdgeType::kViwls:
+                ++batch_statistics.num_imu_edges;
+                break;
+              default:
+                break;
+            }
+          }
+
+          if (idx > 0u) {
+            const vi_map::Vertex& previous_vertex =
+                getVertex(vertex_ids[idx - 1u]);
+            CHECK_EQ(previous_vertex.getMissionId(), vertex.getMissionId());
+            batch_statistics.distance_travelled_m +=
+                (vertex.get_p_M_I() - previous_vertex.get_p_M_I()).norm();
+          }
+        }
+        std::lock_guard<std::mutex> lock(statistics_mutex);
+        statistics->accumulateCounts(batch_statistics);
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      vertex_ids.size(), count_vertices, kAlwaysParallelize, num_threads);
 
-  *duration_s = 0.0;
-  *start_time_ns = 0;
-  *end_time_ns = 0;
   if (!vertex_ids.empty()) {
     const vi_map::Vertex& first_vertex = getVertex(vertex_ids.front());
     const vi_map::Vertex& last_vertex = getVertex(vertex_ids.back());
     const unsigned int kFirstFrameIndex = 0u;
     if (first_vertex.isFrameIndexValid(kFirstFrameIndex) &&
         last_vertex.isFrameIndexValid(kFirstFrameIndex)) {
-      *start_time_ns = first_vertex.getVisualFrame(kFirstFrameIndex)
-                           .getTimestampNanoseconds();
-      *end_time_ns = last_vertex.getVisualFrame(kFirstFrameIndex)
-                         .getTimestampNanoseconds();
-      *duration_s =
-          aslam::time::nanoSecondsToSeconds(*end_time_ns - *start_time_ns);
+      statistics->start_time_ns = first_vertex.getVisualFrame(kFirstFrameIndex)
+                                      .getTimestampNanoseconds();
+      statistics->end_time_ns = last_vertex.getVisualFrame(kFirstFrameIndex)
+                                    .getTimestampNanoseconds();
+      statistics->duration_s = aslam::time::nanoSecondsToSeconds(
+          statistics->end_time_ns - statistics->start_time_ns);
     }
   }
 }
 
+void VIMap::getMissionMemoryUsage(
+    const vi_map::MissionId& mission_id, MapMemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  CHECK(hasMission(mission_id));
+  *usage = MapMemoryUsage();
+
+  pose_graph::VertexIdList vertex_ids;
+  getAllVertexIdsInMission(mission_id, &vertex_ids);
+
+  std::mutex usage_mutex;
+  std::function<void(const std::vector<size_t>&)> accumulate_vertices =
+      [&](const std::vector<size_t>& batch) {
+        MapMemoryUsage batch_usage;
+        pose_graph::EdgeIdSet outgoing_edges;
+        for (const size_t idx : batch) {
+          const vi_map::Vertex& vertex = getVertex(vertex_ids[idx]);
+          vertex.accumulateMemoryUsage(&batch_usage);
+
+          outgoing_edges.clear();
+          vertex.getOutgoingEdges(&outgoing_edges);
+          for (const pose_graph::EdgeId& edge_id : outgoing_edges) {
+            const vi_map::Edge& edge = getEdgeAs<vi_map::Edge>(edge_id);
+            if (edge.getType() == pose_graph::Edge::EdgeType::kViwls) {
+              batch_usage.imu_edge_bytes += edge.memoryUsageBytes();
+            } else {
+              batch_usage.other_edge_bytes += edge.memoryUsageBytes();
+            }
+          }
+        }
+        std::lock_guard<std::mutex> lock(usage_mutex);
+        usage->accumulate(batch_usage);
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      vertex_ids.size(), accumulate_vertices, kAlwaysParallelize, num_threads);
+
+  const OptionalSensorDataMap::const_iterator optional_sensor_data_it =
+      optional_sensor_data_map_.find(mission_id);
+  if (optional_sensor_data_it != optional_sensor_data_map_.end()) {
+    usage->optional_sensor_data_bytes =
+        optional_sensor_data_it->second.memoryUsageBytes();
+  }
+}
+
+void VIMap::getMemoryUsage(MapMemoryUsage* usage) const {
+  CHECK_NOTNULL(usage);
+  *usage = MapMemoryUsage();
+  vi_map::MissionIdList mission_ids;
+  getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    MapMemoryUsage mission_usage;
+    getMissionMemoryUsage(mission_id, &mission_usage);
+    usage->accumulate(mission_usage);
+  }
+  usage->resource_cache_bytes = getResourceCacheMemoryUsageBytes();
+}
+
+void VIMap::releaseVertexPayloadsOverBudget() {
+  // Maps that were merged from several loaded maps have a pager per map.
+  std::unordered_set<VertexPayloadPager*> payload_pagers;
+  forEachVertex([&payload_pagers](const Vertex& vertex) {
+    if (vertex.getPayloadPager() != nullptr) {
+      payload_pagers.emplace(vertex.getPayloadPager());
+    }
+  });
+  for (VertexPayloadPager* payload_pager : payload_pagers) {
+    payload_pager->releasePayloadsOverBudget();
+  }
+}
+
+void VIMap::getStatisticsOfMission(
+    const vi_map::MissionId& mission_id,
+    std::vector<size_t>* num_good_landmarks_per_camera,
+    std::vector<size_t>* num_bad_landmarks_per_camera,
+    std::vector<size_t>* num_unknown_landmarks_per_camera,
+    std::vector<size_t>* total_num_landmarks_per_camera, size_t* num_landmarks,
+    size_t* num_vertices, size_t* num_observations, double* duration_s,
+    int64_t* start_time_ns, int64_t* end_time_ns) const {
+  CHECK_NOTNULL(num_good_landmarks_per_camera);
+  CHECK_NOTNULL(num_bad_landmarks_per_camera);
+  CHECK_NOTNULL(num_unknown_landmarks_per_camera);
+  CHECK_NOTNULL(total_num_landmarks_per_camera);
+  CHECK_NOTNULL(num_landmarks);
+  CHECK_NOTNULL(num_vertices);
+  CHECK_NOTNULL(num_observations);
+  CHECK_NOTNULL(duration_s);
+  CHECK_NOTNULL(start_time_ns);
+  CHECK_NOTNULL(end_time_ns);
+
+  MissionStatistics statistics;
+  getMissionStatistics(mission_id, &statistics);
+  num_good_landmarks_per_camera->swap(
+      statistics.num_good_landmarks_per_camera);
+  num_bad_landmarks_per_camera->swap(statistics.num_bad_landmarks_per_camera);
+  num_unknown_landmarks_per_camera->swap(
+      statistics.num_unknown_landmarks_per_camera);
+  total_num_landmarks_per_camera->swap(
+      statistics.total_num_landmarks_per_camera);
+  *num_landmarks = statistics.num_landmarks;
+  *num_vertices = statistics.num_vertices;
+  *num_observations = statistics.num_observations;
+  *duration_s = statistics.duration_s;
+  *start_time_ns = statistics.start_time_ns;
+  *end_time_ns = statistics.end_time_ns;
+}
+
 std::string VIMap::printMapStatistics(
     const vi_map::MissionId& mission_id, const unsigned int mission_number,
     const SemanticsManager& semantics) const {
@@ -418,44 +624,8 @@ std::string VIMap::printMapStatistics(
   };
 
   std::string name = semantics.getNameOfMission(mission_id);
-  std::vector<size_t> num_good_landmarks_per_camera;
-  std::vector<size_t> num_bad_landmarks_per_camera;
-  std::vector<size_t> num_unknown_landmarks_per_camera;
-  std::vector<size_t> total_num_landmarks_per_camera;
-  size_t num_landmarks = 0u;
-  size_t num_vertices = 0u;
-  size_t num_observations = 0u;
-  double duration_s = 0.0;
-  int64_t start_time_ns = 0u;
-  int64_t end_time_ns = 0u;
-  getStatisticsOfMission(
-      mission_id, &num_good_landmarks_per_camera, &num_bad_landmarks_per_camera,
-      &num_unknown_landmarks_per_camera, &total_num_landmarks_per_camera,
-      &num_landmarks, &num_vertices, &num_observations, &duration_s,
-      &start_time_ns, &end_time_ns);
-
-  size_t num_wheel_odometry_edges = 0u;
-  size_t num_imu_edges = 0u;
-  size_t num_loop_closure_edges = 0u;
-
-  pose_graph::EdgeIdList edge_ids;
-  getAllEdgeIdsInMissionAlongGraph(mission_id, &edge_ids);
-  for (const pose_graph::EdgeId& edge_id : edge_ids) {
-    CHECK(edge_id.isValid());
-    switch (getEdgeType(edge_id)) {
-      case pose_graph::Edge::EdgeType::kOdometry:
-        ++num_wheel_odometry_edges;
-        break;
-      case pose_graph::Edge::EdgeType::kLoopClosure:
-        ++num_loop_closure_edges;
-        break;
-      case pose_graph::Edge::EdgeType::kViwls:
-        ++num_imu_edges;
-        break;
-      default:
-        break;
-    }
-  }
+  MissionStatistics statistics;
+  getMissionStatistics(mission_id, &statistics);
 
   const vi_map::VIMission& mission = getMission(mission_id);
   stats_text << std::endl;
@@ -523,40 +693,50 @@ std::string VIMap::printMapStatistics(
     print_aligned("GPS WGS Sensor: ", sensor_id.hexString(), 1);
   }
 
-  print_aligned("Vertices:", std::to_string(num_vertices), 1);
+  print_aligned("Vertices:", std::to_string(statistics.num_vertices), 1);
 
-  print_aligned("Landmarks:", std::to_string(num_landmarks), 1);
+  print_aligned("Landmarks:", std::to_string(statistics.num_landmarks), 1);
   print_aligned("Landmarks by first observer backlink:", "", 1);
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     print_aligned(
         "Camera " + std::to_string(camera_idx) + ":",
-        std::to_string(total_num_landmarks_per_camera[camera_idx]) +
-            " (g:" + std::to_string(num_good_landmarks_per_camera[camera_idx]) +
-            " b:" + std::to_string(num_bad_landmarks_per_camera[camera_idx]) +
+        std::to_string(statistics.total_num_landmarks_per_camera[camera_idx]) +
+            " (g:" +
+            std::to_string(
+                statistics.num_good_landmarks_per_camera[camera_idx]) +
+            " b:" +
+            std::to_string(
+                statistics.num_bad_landmarks_per_camera[camera_idx]) +
             " u:" +
-            std::to_string(num_unknown_landmarks_per_camera[camera_idx]) + ")",
+            std::to_string(
+                statistics.num_unknown_landmarks_per_camera[camera_idx]) +
+            ")",
         1);
   }
-  print_aligned("Observations:", std::to_string(num_observations), 1);
+  print_aligned(
+      "Observations:", std::to_string(statistics.num_observations), 1);
   print_aligned("Num edges by type: ", "", 1);
-  print_aligned("IMU: ", std::to_string(num_imu_edges), 1);
+  print_aligned("IMU: ", std::to_string(statistics.num_imu_edges), 1);
+  print_aligned(
+      "Wheel-odometry: ", std::to_string(statistics.num_wheel_odometry_edges),
+      1);
+  print_aligned(
+      "Loop-closure: ", std::to_string(statistics.num_loop_closure_edges), 1);
   print_aligned(
-      "Wheel-odometry: ", std::to_string(num_wheel_odometry_edges), 1);
-  print_aligned("Loop-closure: ", std::to_string(num_loop_closure_edges), 1);
-  double distance = 0;
-  getDistanceTravelledPerMission(mission_id, &distance);
-  print_aligned("Distance travelled [m]:", std::to_string(distance), 1);
+      "Distance travelled [m]:",
+      std::to_string(statistics.distance_travelled_m), 1);
 
   if (!selected_missions_.empty()) {
     const bool is_selected = (selected_missions_.count(mission_id) > 0);
     print_aligned("Selected:", std::to_string(is_selected), 1);
   }
 
-  if (num_vertices > 0) {
-    time_t start_time(aslam::time::nanoSecondsToSeconds(start_time_ns));
+  if (statistics.num_vertices > 0) {
+    time_t start_time(
+        aslam::time::nanoSecondsToSeconds(statistics.start_time_ns));
     std::string start_time_str = common::generateDateString(&start_time);
 
-    time_t end_time(aslam::time::nanoSecondsToSeconds(end_time_ns));
+    time_t end_time(aslam::time::nanoSecondsToSeconds(statistics.end_time_ns));
     std::string end_time_str = common::generateDateString(&end_time);
     print_aligned(
         "Start to end time: ", start_time_str + " to " + end_time_str, 1);
@@ -615,50 +795,13 @@ std::string VIMap::printMapAccumulatedStatistics() const {
   vi_map::MissionIdList all_missions;
   getAllMissionIdsSortedByTimestamp(&all_missions);
 
-  double total_distance_travelled = 0.0;
-  size_t total_num_vertices = 0u;
-  size_t total_num_landmarks = 0u;
-  size_t total_num_observations = 0u;
-  size_t total_num_good_landmarks = 0u;
-  size_t total_num_bad_landmarks = 0u;
-  size_t total_num_unknown_landmarks = 0u;
+  MissionStatistics total_statistics;
   double total_duration_s = 0.0;
-
   for (const vi_map::MissionId& mission_id : all_missions) {
-    std::vector<size_t> num_good_landmarks_per_camera;
-    std::vector<size_t> num_bad_landmarks_per_camera;
-    std::vector<size_t> num_unknown_landmarks_per_camera;
-    std::vector<size_t> total_num_landmarks_per_camera;
-    size_t num_landmarks;
-    size_t num_vertices;
-    size_t num_observations;
-    double duration_s;
-    int64_t start_time_ns;
-    int64_t end_time_ns;
-    getStatisticsOfMission(
-        mission_id, &num_good_landmarks_per_camera,
-        &num_bad_landmarks_per_camera, &num_unknown_landmarks_per_camera,
-        &total_num_landmarks_per_camera, &num_landmarks, &num_vertices,
-        &num_observations, &duration_s, &start_time_ns, &end_time_ns);
-
-    total_num_good_landmarks += std::accumulate(
-        num_good_landmarks_per_camera.begin(),
-        num_good_landmarks_per_camera.end(), 0u);
-    total_num_bad_landmarks += std::accumulate(
-        num_bad_landmarks_per_camera.begin(),
-        num_bad_landmarks_per_camera.end(), 0u);
-    total_num_unknown_landmarks += std::accumulate(
-        num_unknown_landmarks_per_camera.begin(),
-        num_unknown_landmarks_per_camera.end(), 0u);
-    total_num_landmarks += num_landmarks;
-    total_num_observations += num_observations;
-    total_num_vertices += num_vertices;
-
-    total_duration_s += duration_s;
-
-    double distance_travelled;
-    getDistanceTravelledPerMission(mission_id, &distance_travelled);
-    total_distance_travelled += distance_travelled;
+    MissionStatistics statistics;
+    getMissionStatistics(mission_id, &statistics);
+    total_statistics.accumulateCounts(statistics);
+    total_duration_s += statistics.duration_s;
   }
 
   std::stringstream stats_text;
@@ -677,16 +820,20 @@ std::string VIMap::printMapAccumulatedStatistics() const {
 
   stats_text << "Accumulated statistics over all missions:" << std::endl;
   print_aligned("Number of missions:", std::to_string(numMissions()), 1);
-  print_aligned("Vertices:", std::to_string(total_num_vertices), 1);
   print_aligned(
-      "Landmarks:", std::to_string(total_num_landmarks) + " (g:" +
-                        std::to_string(total_num_good_landmarks) + " b:" +
-                        std::to_string(total_num_bad_landmarks) + " u:" +
-                        std::to_string(total_num_unknown_landmarks) + ")",
+      "Vertices:", std::to_string(total_statistics.num_vertices), 1);
+  print_aligned(
+      "Landmarks:",
+      std::to_string(total_statistics.num_landmarks) + " (g:" +
+          std::to_string(total_statistics.getNumGoodLandmarks()) + " b:" +
+          std::to_string(total_statistics.getNumBadLandmarks()) + " u:" +
+          std::to_string(total_statistics.getNumUnknownLandmarks()) + ")",
       1);
-  print_aligned("Observations:", std::to_string(total_num_observations), 1);
   print_aligned(
-      "Distance travelled [m]:", std::to_string(total_distance_travelled), 1);
+      "Observations:", std::to_string(total_statistics.num_observations), 1);
+  print_aligned(
+      "Distance travelled [m]:",
+      std::to_string(total_statistics.distance_travelled_m), 1);
   print_aligned("Duration [s]: ", std::to_string(total_duration_s), 1);
   return stats_text.str();
 }
@@ -1012,42 +1159,246 @@ void VIMap::mergeNeighboringVertices(
     posegraph.removeEdge(edge_between_vertices->id());
   }
 
-  const unsigned int num_frames = next_vertex.numFrames();
-  // We need to track landmarks that get removed in the following loop. This
-  // prevents a crash in the case where a landmark is only observed from one
-  // vertex, but from multiple frames within this vertex. For the first frame,
-  // the landmark will be removed from the map in this case. All subsequent
-  // frames try to also access this landmark, which will fail because it has
-  // been deleted.
-  std::unordered_set<LandmarkId> deleted_landmarks;
-  for (unsigned int frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-    if (!next_vertex.isVisualFrameSet(frame_idx)) {
+  removeVertexFromObservedLandmarks(next_vertex_id);
+
+  // Remove the vertex.
+  posegraph.removeVertex(next_vertex_id);
+}
+
+void VIMap::mergeVerticesIntoVertex(
+    const pose_graph::VertexId& merge_into_vertex_id,
+    const pose_graph::VertexIdList& next_vertex_ids) {
+  CHECK(hasVertex(merge_into_vertex_id));
+  if (next_vertex_ids.empty()) {
+    return;
+  }
+
+  VLOG(4) << "Merging " << next_vertex_ids.size() << " vertices into "
+          << merge_into_vertex_id;
+  mergeVertexSegments({std::make_pair(merge_into_vertex_id, next_vertex_ids)});
+}
+
+void VIMap::planVertexMerge(
+    const pose_graph::VertexId& merge_into_vertex_id,
+    const pose_graph::VertexIdList& next_vertex_ids,
+    VertexMergePlan* plan) const {
+  CHECK_NOTNULL(plan);
+  CHECK(hasVertex(merge_into_vertex_id));
+  CHECK(!next_vertex_ids.empty());
+
+  const pose_graph::Edge::EdgeType traversal_edge_type =
+      getGraphTraversalEdgeType(getVertex(merge_into_vertex_id).getMissionId());
+
+  // Collect the chain of IMU edges from the kept vertex to the vertex after
+  // the merged ones and all other edges of the merged vertices.
+  plan->edge_chain.clear();
+  plan->edge_chain.reserve(next_vertex_ids.size() + 1u);
+  plan->other_edges.clear();
+  pose_graph::VertexId previous_vertex_id = merge_into_vertex_id;
+  for (size_t vertex_idx = 0u; vertex_idx < next_vertex_ids.size();
+       ++vertex_idx) {
+    const pose_graph::VertexId& next_vertex_id = next_vertex_ids[vertex_idx];
+    CHECK(hasVertex(next_vertex_id));
+    pose_graph::VertexId check_vertex_id;
+    getNextVertex(previous_vertex_id, traversal_edge_type, &check_vertex_id);
+    CHECK_EQ(check_vertex_id, next_vertex_id)
+        << "The vertices to merge should follow each other along the graph.";
+    previous_vertex_id = next_vertex_id;
+
+    std::unordered_set<pose_graph::EdgeId> incoming, outgoing;
+    const vi_map::Vertex& next_vertex = getVertex(next_vertex_id);
+    next_vertex.getIncomingEdges(&incoming);
+    next_vertex.getOutgoingEdges(&outgoing);
+    const bool is_last_vertex = vertex_idx + 1u == next_vertex_ids.size();
+
+    size_t num_incoming_viwls_edges = 0u, num_outgoing_viwls_edges = 0u;
+    for (const pose_graph::EdgeId& incoming_edge : incoming) {
+      if (getEdgeType(incoming_edge) == pose_graph::Edge::EdgeType::kViwls) {
+        plan->edge_chain.push_back(
+            &getEdgeAs<vi_map::ViwlsEdge>(incoming_edge));
+        ++num_incoming_viwls_edges;
+      } else {
+        plan->other_edges.insert(incoming_edge);
+      }
+    }
+    for (const pose_graph::EdgeId& outgoing_edge : outgoing) {
+      if (getEdgeType(outgoing_edge) == pose_graph::Edge::EdgeType::kViwls) {
+        // The outgoing IMU edges of all other vertices are the incoming edges
+        // of the following one.
+        if (is_last_vertex) {
+          plan->edge_chain.push_back(
+              &getEdgeAs<vi_map::ViwlsEdge>(outgoing_edge));
+        }
+        ++num_outgoing_viwls_edges;
+      } else {
+        plan->other_edges.insert(outgoing_edge);
+      }
+    }
+    CHECK_LE(num_outgoing_viwls_edges, 1u)
+        << "A vertex can have only one outgoing edge in VIWLS graph";
+    CHECK_EQ(1u, num_incoming_viwls_edges)
+        << "A vertex can have only one incoming edge in VIWLS graph";
+    CHECK(is_last_vertex || num_outgoing_viwls_edges == 1u);
+  }
+
+  plan->has_vertex_after_merged_vertices =
+      plan->edge_chain.back()->to() != next_vertex_ids.back();
+}
+
+void VIMap::mergeVertexSegments(
+    const std::vector<std::pair<pose_graph::VertexId,
+                                pose_graph::VertexIdList>>& segments) {
+  // The segments are merged independently, which requires them to be
+  // disjoint.
+  pose_graph::VertexIdSet merged_vertex_ids;
+  pose_graph::VertexIdSet kept_vertex_ids;
+  for (const std::pair<pose_graph::VertexId, pose_graph::VertexIdList>&
+           segment : segments) {
+    CHECK(kept_vertex_ids.insert(segment.first).second)
+        << "Vertex " << segment.first << " is kept by several segments.";
+    for (const pose_graph::VertexId& vertex_id : segment.second) {
+      CHECK(merged_vertex_ids.insert(vertex_id).second)
+          << "Vertex " << vertex_id << " is merged by several segments.";
+    }
+  }
+  for (const pose_graph::VertexId& vertex_id : kept_vertex_ids) {
+    CHECK_EQ(merged_vertex_ids.count(vertex_id), 0u)
+        << "Vertex " << vertex_id << " is both kept and merged.";
+  }
+  if (merged_vertex_ids.empty()) {
+    return;
+  }
+
+  // Plan all merges, move the landmarks and concatenate the IMU data. Every
+  // segment only reads its own edges and modifies the landmark stores of its
+  // own vertices.
+  std::vector<VertexMergePlan> plans(segments.size());
+  std::function<void(const std::vector<size_t>&)> plan_segments =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t segment_idx : batch) {
+          const pose_graph::VertexId& merge_into_vertex_id =
+              segments[segment_idx].first;
+          const pose_graph::VertexIdList& next_vertex_ids =
+              segments[segment_idx].second;
+          if (next_vertex_ids.empty()) {
+            continue;
+          }
+          VertexMergePlan& plan = plans[segment_idx];
+          planVertexMerge(merge_into_vertex_id, next_vertex_ids, &plan);
+          if (plan.has_vertex_after_merged_vertices) {
+            PoseGraph::concatenateViwlsEdgeChain(
+                plan.edge_chain, &plan.imu_timestamps, &plan.imu_data);
+          }
+          for (const pose_graph::VertexId& next_vertex_id : next_vertex_ids) {
+            moveLandmarksToOtherVertex(next_vertex_id, merge_into_vertex_id);
+          }
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      segments.size(), plan_segments, kAlwaysParallelize, num_threads);
+
+  // Apply the edge rewrites. Other edges may connect the merged vertices of
+  // different segments and are only removed once.
+  std::unordered_set<pose_graph::EdgeId> other_edges;
+  for (const VertexMergePlan& plan : plans) {
+    other_edges.insert(plan.other_edges.begin(), plan.other_edges.end());
+  }
+  for (const pose_graph::EdgeId& edge_id : other_edges) {
+    posegraph.removeEdge(edge_id);
+  }
+  for (size_t segment_idx = 0u; segment_idx < segments.size(); ++segment_idx) {
+    const VertexMergePlan& plan = plans[segment_idx];
+    if (plan.edge_chain.empty()) {
       continue;
     }
-    const size_t num_of_keypoints =
-        next_vertex.observedLandmarkIdsSize(frame_idx);
-    for (size_t i = 0u; i < num_of_keypoints; ++i) {
-      vi_map::LandmarkId landmark_id =
-          next_vertex.getObservedLandmarkId(frame_idx, i);
-
-      if (landmark_id.isValid() && deleted_landmarks.count(landmark_id) == 0u) {
-        vi_map::Landmark& landmark = getLandmark(landmark_id);
-
-        // Check for orphaned landmarks.
-        if (landmark.numberOfObserverVertices() == 1u) {
-          // Our merged vertex is the only vertex seeing this landmark.
-          removeLandmark(landmark_id);
-          deleted_landmarks.emplace(landmark_id);
-        } else {
-          // Remove vertex visibility in landmarks.
-          landmark.removeAllObservationsOfVertex(next_vertex_id);
+    if (plan.has_vertex_after_merged_vertices) {
+      posegraph.replaceViwlsEdgeChain(
+          segments[segment_idx].first, plan.edge_chain, plan.imu_timestamps,
+          plan.imu_data);
+    } else {
+      // The merged vertices were the last ones of the mission, nothing to
+      // link anymore.
+      for (const vi_map::ViwlsEdge* edge : plan.edge_chain) {
+        posegraph.removeEdge(edge->id());
+      }
+    }
+  }
+
+  removeVerticesFromObservedLandmarks(merged_vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : merged_vertex_ids) {
+    posegraph.removeVertex(vertex_id);
+  }
+}
+
+void VIMap::removeVertexFromObservedLandmarks(
+    const pose_graph::VertexId& vertex_id) {
+  removeVerticesFromObservedLandmarks({vertex_id});
+}
+
+void VIMap::removeVerticesFromObservedLandmarks(
+    const pose_graph::VertexIdSet& vertex_ids) {
+  // Collect the observed landmarks, grouped by their storing vertex such that
+  // the landmark stores can be modified in parallel.
+  std::unordered_map<pose_graph::VertexId, LandmarkIdSet>
+      store_vertex_to_landmarks;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = getVertex(vertex_id);
+    const unsigned int num_frames = vertex.numFrames();
+    for (unsigned int frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+      if (!vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      for (const LandmarkId& landmark_id :
+           vertex.getFrameObservedLandmarkIds(frame_idx)) {
+        if (landmark_id.isValid()) {
+          store_vertex_to_landmarks[landmark_index.getStoringVertexId(
+                                        landmark_id)]
+              .insert(landmark_id);
         }
       }
     }
   }
+  const std::vector<std::pair<pose_graph::VertexId, LandmarkIdSet>>
+      store_vertex_landmarks(
+          store_vertex_to_landmarks.begin(), store_vertex_to_landmarks.end());
 
-  // Remove the vertex.
-  posegraph.removeVertex(next_vertex_id);
+  // Remove the observations and collect the landmarks without any observation
+  // left.
+  std::vector<LandmarkIdList> orphaned_landmarks(store_vertex_landmarks.size());
+  const std::function<bool(const KeypointIdentifier&)> is_removed_vertex =
+      [&vertex_ids](const KeypointIdentifier& observation) {
+        return vertex_ids.count(observation.frame_id.vertex_id) > 0u;
+      };
+  std::function<void(const std::vector<size_t>&)> remove_observations =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          vi_map::LandmarkStore& landmark_store =
+              getVertex(store_vertex_landmarks[idx].first).getLandmarks();
+          for (const LandmarkId& landmark_id :
+               store_vertex_landmarks[idx].second) {
+            vi_map::Landmark& landmark =
+                landmark_store.getLandmark(landmark_id);
+            landmark.removeAllObservationsAccordingToPredicate(
+                is_removed_vertex);
+            if (!landmark.hasObservations()) {
+              orphaned_landmarks[idx].push_back(landmark_id);
+            }
+          }
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      store_vertex_landmarks.size(), remove_observations, kAlwaysParallelize,
+      num_threads);
+
+  LandmarkIdSet landmarks_to_remove;
+  for (const LandmarkIdList& landmark_ids : orphaned_landmarks) {
+    landmarks_to_remove.insert(landmark_ids.begin(), landmark_ids.end());
+  }
+  removeLandmarks(landmarks_to_remove);
 }
 
 void VIMap::mergeLandmarks(
@@ -1112,6 +1463,120 @@ void VIMap::mergeLandmarks(
   CHECK_EQ(landmark_index_size_before - 1, landmark_index.numLandmarks());
 }
 
+size_t VIMap::mergeLandmarks(
+    const std::vector<std::pair<vi_map::LandmarkId, vi_map::LandmarkId>>&
+        landmark_id_pairs_to_merge_into) {
+  // Union-find over the landmarks of the pairs, with the "into" landmark as
+  // root of the joined set.
+  std::unordered_map<vi_map::LandmarkId, size_t> landmark_id_to_node;
+  vi_map::LandmarkIdList node_landmark_ids;
+  std::vector<size_t> parents;
+  auto get_node = [&](const vi_map::LandmarkId& landmark_id) -> size_t {
+    const std::pair<std::unordered_map<vi_map::LandmarkId, size_t>::iterator,
+                    bool>
+        insertion = landmark_id_to_node.emplace(landmark_id, parents.size());
+    if (insertion.second) {
+      CHECK(hasLandmark(landmark_id));
+      parents.emplace_back(parents.size());
+      node_landmark_ids.emplace_back(landmark_id);
+    }
+    return insertion.first->second;
+  };
+  auto find_root = [&parents](size_t node) -> size_t {
+    while (parents[node] != node) {
+      parents[node] = parents[parents[node]];
+      node = parents[node];
+    }
+    return node;
+  };
+  for (const std::pair<vi_map::LandmarkId, vi_map::LandmarkId>& pair :
+       landmark_id_pairs_to_merge_into) {
+    const size_t root_to_merge = find_root(get_node(pair.first));
+    const size_t root_into = find_root(get_node(pair.second));
+    if (root_to_merge != root_into) {
+      parents[root_to_merge] = root_into;
+    }
+  }
+
+  std::unordered_map<vi_map::LandmarkId, vi_map::LandmarkId>
+      merged_to_root_landmark_ids;
+  for (size_t node = 0u; node < parents.size(); ++node) {
+    const size_t root = find_root(node);
+    if (root != node) {
+      merged_to_root_landmark_ids.emplace(
+          node_landmark_ids[node], node_landmark_ids[root]);
+    }
+  }
+  if (merged_to_root_landmark_ids.empty()) {
+    return 0u;
+  }
+
+  // Move the observations into the roots, as in the single merge.
+  pose_graph::VertexIdSet observer_vertex_ids;
+  std::unordered_map<pose_graph::VertexId, vi_map::LandmarkIdSet>
+      store_vertex_to_merged_landmark_ids;
+  for (const std::pair<const vi_map::LandmarkId, vi_map::LandmarkId>&
+           merged_to_root : merged_to_root_landmark_ids) {
+    vi_map::Vertex& landmark_vertex_into =
+        getLandmarkStoreVertex(merged_to_root.second);
+    vi_map::Landmark& landmark_into =
+        landmark_vertex_into.getLandmarks().getLandmark(merged_to_root.second);
+    vi_map::Vertex& landmark_vertex_to_merge =
+        getLandmarkStoreVertex(merged_to_root.first);
+    const vi_map::Landmark& landmark_to_merge =
+        landmark_vertex_to_merge.getLandmarks().getLandmark(
+            merged_to_root.first);
+
+    landmark_into.addObservations(landmark_to_merge.getObservations());
+    if (landmark_into.getQuality() != Landmark::Quality::kGood) {
+      if (landmark_to_merge.getQuality() == Landmark::Quality::kGood) {
+        landmark_into.setQuality(Landmark::Quality::kGood);
+      } else {
+        landmark_into.setQuality(Landmark::Quality::kUnknown);
+      }
+    }
+    landmark_to_merge.forEachObservation(
+        [&observer_vertex_ids](const KeypointIdentifier& observation) {
+          observer_vertex_ids.emplace(observation.frame_id.vertex_id);
+        });
+    store_vertex_to_merged_landmark_ids[landmark_vertex_to_merge.id()].emplace(
+        merged_to_root.first);
+  }
+
+  // Every observer vertex is touched by a single thread.
+  const pose_graph::VertexIdList observer_vertex_id_list(
+      observer_vertex_ids.begin(), observer_vertex_ids.end());
+  std::function<void(const std::vector<size_t>&)> rewrite_vertices =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          getVertex(observer_vertex_id_list[idx])
+              .updateIdsInObservedLandmarkIdList(merged_to_root_landmark_ids);
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      observer_vertex_id_list.size(), rewrite_vertices, kAlwaysParallelize,
+      common::getNumHardwareThreads());
+
+  const unsigned int landmark_index_size_before = landmark_index.numLandmarks();
+  for (const std::pair<const pose_graph::VertexId, vi_map::LandmarkIdSet>&
+           store_vertex_landmarks : store_vertex_to_merged_landmark_ids) {
+    CHECK_EQ(
+        getVertex(store_vertex_landmarks.first)
+            .getLandmarks()
+            .removeLandmarks(store_vertex_landmarks.second),
+        store_vertex_landmarks.second.size());
+    for (const vi_map::LandmarkId& landmark_id :
+         store_vertex_landmarks.second) {
+      landmark_index.removeLandmark(landmark_id);
+    }
+  }
+  CHECK_EQ(
+      landmark_index_size_before - merged_to_root_landmark_ids.size(),
+      landmark_index.numLandmarks());
+  return merged_to_root_landmark_ids.size();
+}
+
 void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
   CHECK(hasMission(source_mission_id));
 
@@ -1143,25 +1608,6 @@ void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
   missions.emplace(mission_ptr->id(), std::move(mission_ptr));
   VLOG(1) << "New mission id: " << duplicated_mission_id;
 
-  // Copy posegraph.
-  typedef std::unordered_map<pose_graph::VertexId, pose_graph::VertexId>
-      VertexIdToVertexIdMap;
-  typedef std::unordered_map<pose_graph::EdgeId, pose_graph::EdgeId>
-      EdgeIdToEdgeIdMap;
-  typedef std::unordered_map<vi_map::LandmarkId, vi_map::LandmarkId>
-      LandmarkIdToLandmarkIdMap;
-
-  VertexIdToVertexIdMap source_to_dest_vertex_id_map;
-  EdgeIdToEdgeIdMap source_to_dest_edge_id_map;
-  LandmarkIdToLandmarkIdMap source_to_dest_landmark_id_map;
-  LandmarkIdSet landmarks_not_to_duplicate;
-
-  typedef VertexIdToVertexIdMap::iterator VertexIdToVertexIdIterator;
-  typedef LandmarkIdToLandmarkIdMap::iterator LandmarkIdToLandmarkIdIterator;
-
-  pose_graph::VertexIdList all_source_vertices;
-  getAllVertexIds(&all_source_vertices);
-
   aslam::NCamera::Ptr duplicated_ncamera =
       sensor_manager_.getNCameraForMission(source_mission_id).cloneToShared();
   CHECK(duplicated_ncamera);
@@ -1192,246 +1638,306 @@ void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
     sensor_manager_.addSensor(std::move(cloned_sensor), duplicated_mission_id);
   }
 
-  VLOG(1) << "Adding vertices.";
-  for (const pose_graph::VertexId& vertex_id : all_source_vertices) {
-    const vi_map::Vertex& source_vertex = getVertex(vertex_id);
-    if (source_vertex.getMissionId() == source_mission_id) {
-      pose_graph::VertexId new_vertex_id = vertex_id;
-      common::generateId(&new_vertex_id);
-
-      Eigen::Matrix<double, 6, 1> imu_ba_bw;
-      imu_ba_bw << source_vertex.getAccelBias(), source_vertex.getGyroBias();
-
-      std::vector<LandmarkIdList> landmarks_seen_by_vertex;
-      const size_t num_frames = source_vertex.numFrames();
-      landmarks_seen_by_vertex.resize(num_frames);
-      for (size_t frame_idx = 0u; frame_idx < source_vertex.numFrames();
-           ++frame_idx) {
-        if (!source_vertex.isVisualFrameSet(frame_idx)) {
-          continue;
-        }
-        for (size_t landmark_idx = 0u;
-             landmark_idx < source_vertex.observedLandmarkIdsSize(frame_idx);
-             ++landmark_idx) {
-          const vi_map::LandmarkId& current_landmark_id =
-              source_vertex.getObservedLandmarkId(frame_idx, landmark_idx);
-          vi_map::LandmarkId new_landmark_id = current_landmark_id;
-          if (!current_landmark_id.isValid()) {
-            new_landmark_id.setInvalid();
-          } else {
-            bool should_duplicate = true;
-            if (landmarks_not_to_duplicate.count(current_landmark_id) > 0u) {
-              should_duplicate = false;
-            } else {
-              const bool is_stored_in_source_mission =
-                  (getLandmarkStoreVertex(current_landmark_id).getMissionId() ==
-                   source_mission_id);
-
-              if (!is_stored_in_source_mission) {
-                should_duplicate = false;
-              } else {
-                vi_map::MissionIdSet observer_missions;
-                getLandmarkObserverMissions(
-                    current_landmark_id, &observer_missions);
-                CHECK(!observer_missions.empty())
-                    << "Landmark should have at "
-                    << "least one observer (= one observer mission).";
-                const bool is_observed_by_source_mission_only =
-                    (observer_missions.size() == 1u &&
-                     observer_missions.count(source_mission_id) > 0u);
-
-                if (!is_observed_by_source_mission_only) {
-                  should_duplicate = false;
-                }
-              }
-            }
-
-            if (!should_duplicate) {
-              // The landmark comes from some other mission or is observed
-              // by other missions. We will not generate a new LandmarkId,
-              // but just add observations.
-              new_landmark_id = current_landmark_id;
+  // Precompute the ids of all duplicated vertices, edges and landmarks, such
+  // that the copies can be created independently afterwards.
+  typedef std::unordered_map<pose_graph::VertexId, pose_graph::VertexId>
+      VertexIdToVertexIdMap;
+  typedef std::unordered_map<pose_graph::EdgeId, pose_graph::EdgeId>
+      EdgeIdToEdgeIdMap;
+  typedef std::unordered_map<vi_map::LandmarkId, vi_map::LandmarkId>
+      LandmarkIdToLandmarkIdMap;
 
-              // Add a backlink to the landmark from some other mission.
-              getLandmark(current_landmark_id)
-                  .addObservation(new_vertex_id, frame_idx, landmark_idx);
+  VLOG(1) << "Building the id remap table.";
+  pose_graph::VertexIdList source_vertex_ids;
+  getAllVertexIdsInMission(source_mission_id, &source_vertex_ids);
+  const size_t num_vertices = source_vertex_ids.size();
 
-              landmarks_not_to_duplicate.emplace(current_landmark_id);
-            } else {
-              // This landmark comes from the source mission and is only
-              // observed by the source mission. It should be duplicated.
-              const LandmarkIdToLandmarkIdIterator it =
-                  source_to_dest_landmark_id_map.find(current_landmark_id);
-              if (it != source_to_dest_landmark_id_map.end()) {
-                new_landmark_id = it->second;
-              } else {
-                common::generateId(&new_landmark_id);
-                source_to_dest_landmark_id_map.emplace(
-                    current_landmark_id, new_landmark_id);
-              }
-            }
-          }
-          landmarks_seen_by_vertex[frame_idx].push_back(new_landmark_id);
+  VertexIdToVertexIdMap source_to_dest_vertex_id_map;
+  source_to_dest_vertex_id_map.reserve(num_vertices);
+  pose_graph::EdgeIdSet source_edge_id_set;
+  LandmarkIdSet observed_landmark_id_set;
+  for (const pose_graph::VertexId& vertex_id : source_vertex_ids) {
+    pose_graph::VertexId new_vertex_id;
+    common::generateId(&new_vertex_id);
+    source_to_dest_vertex_id_map.emplace(vertex_id, new_vertex_id);
+
+    const vi_map::Vertex& source_vertex = const_this->getVertex(vertex_id);
+    pose_graph::EdgeIdSet vertex_edge_ids;
+    source_vertex.getAllEdges(&vertex_edge_ids);
+    source_edge_id_set.insert(vertex_edge_ids.begin(), vertex_edge_ids.end());
+    for (size_t frame_idx = 0u; frame_idx < source_vertex.numFrames();
+         ++frame_idx) {
+      if (!source_vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      for (const LandmarkId& landmark_id :
+           source_vertex.getFrameObservedLandmarkIds(frame_idx)) {
+        if (landmark_id.isValid()) {
+          observed_landmark_id_set.insert(landmark_id);
         }
       }
+    }
+  }
 
-      aslam::VisualNFrame::Ptr n_frame(new aslam::VisualNFrame(
-          duplicated_ncamera));
-      CHECK_EQ(duplicated_ncamera->getNumCameras(), num_frames);
-      for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-        if (source_vertex.isVisualFrameSet(frame_idx)) {
-          const aslam::VisualFrame& source_frame =
-              source_vertex.getVisualFrame(frame_idx);
-          aslam::FrameId frame_id = source_frame.getId();
-          common::generateId(&frame_id);
-          aslam::VisualFrame::Ptr visual_frame(new aslam::VisualFrame);
-          visual_frame->setId(frame_id);
-          visual_frame->setTimestampNanoseconds(
-              source_frame.getTimestampNanoseconds());
-          visual_frame->setCameraGeometry(
-              duplicated_ncamera->getCameraShared(frame_idx));
-          visual_frame->setKeypointMeasurements(
-              source_frame.getKeypointMeasurements());
-          visual_frame->setKeypointMeasurementUncertainties(
-              source_frame.getKeypointMeasurementUncertainties());
-          visual_frame->setDescriptors(source_frame.getDescriptors());
-          if (source_frame.hasTrackIds()) {
-            visual_frame->setTrackIds(source_frame.getTrackIds());
+  const pose_graph::EdgeIdList source_edge_ids(
+      source_edge_id_set.begin(), source_edge_id_set.end());
+  EdgeIdToEdgeIdMap source_to_dest_edge_id_map;
+  source_to_dest_edge_id_map.reserve(source_edge_ids.size());
+  for (const pose_graph::EdgeId& edge_id : source_edge_ids) {
+    pose_graph::EdgeId new_edge_id;
+    common::generateId(&new_edge_id);
+    source_to_dest_edge_id_map.emplace(edge_id, new_edge_id);
+  }
+
+  // Only landmarks stored in and observed by the source mission only are
+  // duplicated. All other landmarks get the observations of the duplicated
+  // vertices.
+  const LandmarkIdList observed_landmark_ids(
+      observed_landmark_id_set.begin(), observed_landmark_id_set.end());
+  std::vector<unsigned char> should_duplicate_landmark(
+      observed_landmark_ids.size(), 0u);
+  std::function<void(const std::vector<size_t>&)> classify_landmarks =
+      [&](const std::vector<size_t>& batch) {
+        vi_map::MissionIdSet observer_missions;
+        for (const size_t idx : batch) {
+          const LandmarkId& landmark_id = observed_landmark_ids[idx];
+          if (const_this->getLandmarkStoreVertex(landmark_id).getMissionId() !=
+              source_mission_id) {
+            continue;
           }
-
-          n_frame->setFrame(frame_idx, visual_frame);
+          const_this->getLandmarkObserverMissions(
+              landmark_id, &observer_missions);
+          CHECK(!observer_missions.empty())
+              << "Landmark should have at "
+              << "least one observer (= one observer mission).";
+          should_duplicate_landmark[idx] =
+              observer_missions.size() == 1u &&
+              observer_missions.count(source_mission_id) > 0u;
         }
-      }
-
-      vi_map::Vertex* vertex_ptr(
-          new vi_map::Vertex(
-              new_vertex_id, imu_ba_bw, n_frame, landmarks_seen_by_vertex,
-              duplicated_mission_id));
-
-      vertex_ptr->set_p_M_I(source_vertex.get_p_M_I());
-      vertex_ptr->set_q_M_I(source_vertex.get_q_M_I().normalized());
-      vertex_ptr->set_v_M(source_vertex.get_v_M());
-
-      vertex_ptr->setFrameResourceMap(source_vertex.getFrameResourceMap());
-
-      posegraph.addVertex(vi_map::Vertex::UniquePtr(vertex_ptr));
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      observed_landmark_ids.size(), classify_landmarks, kAlwaysParallelize,
+      num_threads);
 
-      // Our local old-to-new VertexId map.
-      source_to_dest_vertex_id_map.emplace(vertex_id, new_vertex_id);
+  LandmarkIdToLandmarkIdMap source_to_dest_landmark_id_map;
+  for (size_t idx = 0u; idx < observed_landmark_ids.size(); ++idx) {
+    if (should_duplicate_landmark[idx]) {
+      vi_map::LandmarkId new_landmark_id;
+      common::generateId(&new_landmark_id);
+      source_to_dest_landmark_id_map.emplace(
+          observed_landmark_ids[idx], new_landmark_id);
     }
   }
 
-  VLOG(1) << "Adding edges";
-  pose_graph::EdgeIdList all_source_edges;
-  getAllEdgeIds(&all_source_edges);
-  for (const pose_graph::EdgeId& edge_id : all_source_edges) {
-    const vi_map::Edge& source_edge = getEdgeAs<vi_map::Edge>(edge_id);
+  VLOG(1) << "Copying " << num_vertices << " vertices and "
+          << source_edge_ids.size() << " edges.";
+  // The copied vertices reference their edges and store the duplicated
+  // landmarks. Only the source map is read here.
+  std::vector<pose_graph::Vertex::UniquePtr> copied_vertices(num_vertices);
+  std::vector<pose_graph::Edge::UniquePtr> copied_edges(source_edge_ids.size());
+  std::function<void(const std::vector<size_t>&)> copy_vertices_and_edges =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          if (idx >= num_vertices) {
+            const pose_graph::EdgeId& edge_id =
+                source_edge_ids[idx - num_vertices];
+            const vi_map::Edge& source_edge =
+                const_this->getEdgeAs<vi_map::Edge>(edge_id);
+            vi_map::Edge* copied_edge = nullptr;
+            source_edge.copyEdgeInto(&copied_edge);
+            CHECK_NOTNULL(copied_edge);
+            copied_edge->setId(
+                common::getChecked(source_to_dest_edge_id_map, edge_id));
+            copied_edge->setFrom(common::getChecked(
+                source_to_dest_vertex_id_map, source_edge.from()));
+            copied_edge->setTo(common::getChecked(
+                source_to_dest_vertex_id_map, source_edge.to()));
+            copied_edges[idx - num_vertices].reset(copied_edge);
+            continue;
+          }
 
-    const MissionId& mission_id_from =
-        getMissionIdForVertex(source_edge.from());
-    const MissionId& mission_id_to = getMissionIdForVertex(source_edge.to());
-    if (mission_id_from == source_mission_id ||
-        mission_id_to == source_mission_id) {
-      vi_map::Edge* copied_edge = nullptr;
-      source_edge.copyEdgeInto(&copied_edge);
-      CHECK_NOTNULL(copied_edge);
+          const pose_graph::VertexId& vertex_id = source_vertex_ids[idx];
+          const vi_map::Vertex& source_vertex =
+              const_this->getVertex(vertex_id);
+          const pose_graph::VertexId& new_vertex_id =
+              common::getChecked(source_to_dest_vertex_id_map, vertex_id);
+
+          Eigen::Matrix<double, 6, 1> imu_ba_bw;
+          imu_ba_bw << source_vertex.getAccelBias(),
+              source_vertex.getGyroBias();
+
+          const size_t num_frames = source_vertex.numFrames();
+          std::vector<LandmarkIdList> landmarks_seen_by_vertex(num_frames);
+          for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+            if (!source_vertex.isVisualFrameSet(frame_idx)) {
+              continue;
+            }
+            const LandmarkIdList& source_landmark_ids =
+                source_vertex.getFrameObservedLandmarkIds(frame_idx);
+            LandmarkIdList& new_landmark_ids =
+                landmarks_seen_by_vertex[frame_idx];
+            new_landmark_ids.reserve(source_landmark_ids.size());
+            for (const LandmarkId& landmark_id : source_landmark_ids) {
+              const LandmarkIdToLandmarkIdMap::const_iterator it =
+                  source_to_dest_landmark_id_map.find(landmark_id);
+              new_landmark_ids.push_back(
+                  it != source_to_dest_landmark_id_map.end() ? it->second
+                                                             : landmark_id);
+            }
+          }
 
-      pose_graph::EdgeId new_edge_id;
-      common::generateId(&new_edge_id);
+          aslam::VisualNFrame::Ptr n_frame(
+              new aslam::VisualNFrame(duplicated_ncamera));
+          CHECK_EQ(duplicated_ncamera->getNumCameras(), num_frames);
+          for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+            if (source_vertex.isVisualFrameSet(frame_idx)) {
+              const aslam::VisualFrame& source_frame =
+                  source_vertex.getVisualFrame(frame_idx);
+              aslam::FrameId frame_id;
+              common::generateId(&frame_id);
+              aslam::VisualFrame::Ptr visual_frame(new aslam::VisualFrame);
+              visual_frame->setId(frame_id);
+              visual_frame->setTimestampNanoseconds(
+                  source_frame.getTimestampNanoseconds());
+              visual_frame->setCameraGeometry(
+                  duplicated_ncamera->getCameraShared(frame_idx));
+              visual_frame->setKeypointMeasurements(
+                  source_frame.getKeypointMeasurements());
+              visual_frame->setKeypointMeasurementUncertainties(
+                  source_frame.getKeypointMeasurementUncertainties());
+              visual_frame->setDescriptors(source_frame.getDescriptors());
+              if (source_frame.hasTrackIds()) {
+                visual_frame->setTrackIds(source_frame.getTrackIds());
+              }
 
-      copied_edge->setId(new_edge_id);
+              n_frame->setFrame(frame_idx, visual_frame);
+            }
+          }
 
-      VertexIdToVertexIdIterator it_from;
-      it_from = source_to_dest_vertex_id_map.find(source_edge.from());
-      CHECK(it_from != source_to_dest_vertex_id_map.end());
-      copied_edge->setFrom(it_from->second);
+          vi_map::Vertex::UniquePtr vertex_ptr(new vi_map::Vertex(
+              new_vertex_id, imu_ba_bw, n_frame, landmarks_seen_by_vertex,
+              duplicated_mission_id));
 
-      VertexIdToVertexIdIterator it_to;
-      it_to = source_to_dest_vertex_id_map.find(source_edge.to());
-      CHECK(it_to != source_to_dest_vertex_id_map.end());
-      copied_edge->setTo(it_to->second);
+          vertex_ptr->set_p_M_I(source_vertex.get_p_M_I());
+          vertex_ptr->set_q_M_I(source_vertex.get_q_M_I().normalized());
+          vertex_ptr->set_v_M(source_vertex.get_v_M());
 
-      posegraph.addEdge(pose_graph::Edge::UniquePtr(copied_edge));
+          // The duplicated vertices refer to the same resources.
+          vertex_ptr->setFrameResourceMap(source_vertex.getFrameResourceMap());
 
-      // Our local old-to-new EdgeId map.
-      source_to_dest_edge_id_map.insert(std::make_pair(edge_id, new_edge_id));
-    }
-  }
-
-  VLOG(1) << "Setting root vertex.";
-  // Set root vertex.
-  const VertexIdToVertexIdIterator it =
-      source_to_dest_vertex_id_map.find(source_mission.getRootVertexId());
-  CHECK(it != source_to_dest_vertex_id_map.end());
-  getMission(duplicated_mission_id).setRootVertexId(it->second);
-  VLOG(1) << "Set root vertex in the new mission: " << it->second;
-
-  VLOG(1) << "Adding landmarks.";
-  for (const pose_graph::VertexId& vertex_id : all_source_vertices) {
-    const vi_map::Vertex& source_vertex = getVertex(vertex_id);
-    if (source_vertex.getMissionId() == source_mission_id) {
-      VertexIdToVertexIdIterator it;
-      it = source_to_dest_vertex_id_map.find(vertex_id);
-      CHECK(it != source_to_dest_vertex_id_map.end());
-      vi_map::Vertex& new_vertex = getVertex(it->second);
-
-      const vi_map::LandmarkStore& source_landmark_store =
-          source_vertex.getLandmarks();
-      for (const vi_map::Landmark& landmark : source_landmark_store) {
-        bool should_add_new_landmark =
-            !(landmarks_not_to_duplicate.count(landmark.id()) > 0u);
-
-        vi_map::Landmark new_landmark;
-        if (should_add_new_landmark) {
-          new_landmark.set_p_B(landmark.get_p_B());
-          Eigen::Matrix3d covariance;
-          if (landmark.get_p_B_Covariance(&covariance)) {
-            new_landmark.set_p_B_Covariance(covariance);
+          pose_graph::EdgeIdSet edge_ids;
+          source_vertex.getIncomingEdges(&edge_ids);
+          for (const pose_graph::EdgeId& edge_id : edge_ids) {
+            CHECK(vertex_ptr->addIncomingEdge(
+                common::getChecked(source_to_dest_edge_id_map, edge_id)));
+          }
+          source_vertex.getOutgoingEdges(&edge_ids);
+          for (const pose_graph::EdgeId& edge_id : edge_ids) {
+            CHECK(vertex_ptr->addOutgoingEdge(
+                common::getChecked(source_to_dest_edge_id_map, edge_id)));
           }
 
-          vi_map::LandmarkId new_landmark_id;
-          const LandmarkIdToLandmarkIdIterator it =
-              source_to_dest_landmark_id_map.find(landmark.id());
-          CHECK(it != source_to_dest_landmark_id_map.end())
-              << "Landmark with "
-              << "id" << landmark.id() << " is not present in the landmark to "
-              << "landmark duplication map. Possibly it has no observations?";
-
-          new_landmark_id = it->second;
-          new_landmark.setId(new_landmark_id);
-          new_landmark.setQuality(landmark.getQuality());
-        }
-
-        vi_map::Landmark& nonconst_landmark = getLandmark(landmark.id());
-
-        landmark.forEachObservation([&](const KeypointIdentifier& observation) {
-          if (getVertex(observation.frame_id.vertex_id).getMissionId() ==
-              source_mission_id) {
-            VertexIdToVertexIdIterator observer_vertex_it =
-                source_to_dest_vertex_id_map.find(
-                    observation.frame_id.vertex_id);
-            CHECK(observer_vertex_it != source_to_dest_vertex_id_map.end());
-
-            if (should_add_new_landmark) {
-              new_landmark.addObservation(
-                  observer_vertex_it->second, observation.frame_id.frame_index,
-                  observation.keypoint_index);
-            } else {
-              nonconst_landmark.addObservation(
-                  observer_vertex_it->second, observation.frame_id.frame_index,
-                  observation.keypoint_index);
+          for (const vi_map::Landmark& landmark :
+               source_vertex.getLandmarks()) {
+            const LandmarkIdToLandmarkIdMap::const_iterator it =
+                source_to_dest_landmark_id_map.find(landmark.id());
+            if (it == source_to_dest_landmark_id_map.end()) {
+              continue;
+            }
+            vi_map::Landmark new_landmark;
+            new_landmark.setId(it->second);
+            new_landmark.set_p_B(landmark.get_p_B());
+            Eigen::Matrix3d covariance;
+            if (landmark.get_p_B_Covariance(&covariance)) {
+              new_landmark.set_p_B_Covariance(covariance);
             }
+            new_landmark.setQuality(landmark.getQuality());
+            // Duplicated landmarks are only observed by the source mission.
+            landmark.forEachObservation(
+                [&](const KeypointIdentifier& observation) {
+                  new_landmark.addObservation(
+                      common::getChecked(
+                          source_to_dest_vertex_id_map,
+                          observation.frame_id.vertex_id),
+                      observation.frame_id.frame_index,
+                      observation.keypoint_index);
+                });
+            vertex_ptr->getLandmarks().addLandmark(new_landmark);
           }
-        });
 
-        if (should_add_new_landmark) {
-          new_vertex.getLandmarks().addLandmark(new_landmark);
+          copied_vertices[idx] = std::move(vertex_ptr);
+        }
+      };
+  common::ParallelProcess(
+      num_vertices + source_edge_ids.size(), copy_vertices_and_edges,
+      kAlwaysParallelize, num_threads);
+  posegraph.addSubgraph(&copied_vertices, &copied_edges);
+
+  VLOG(1) << "Setting root vertex.";
+  const pose_graph::VertexId& new_root_vertex_id = common::getChecked(
+      source_to_dest_vertex_id_map, source_mission.getRootVertexId());
+  getMission(duplicated_mission_id).setRootVertexId(new_root_vertex_id);
+  VLOG(1) << "Set root vertex in the new mission: " << new_root_vertex_id;
+
+  VLOG(1) << "Adding observations to the landmarks that are not duplicated.";
+  // Grouped by storing vertex, such that the landmark stores can be modified
+  // in parallel.
+  typedef std::vector<std::pair<LandmarkId, KeypointIdentifier>>
+      LandmarkObservationList;
+  std::unordered_map<pose_graph::VertexId, LandmarkObservationList>
+      store_vertex_to_new_observations;
+  for (const pose_graph::VertexId& vertex_id : source_vertex_ids) {
+    const vi_map::Vertex& source_vertex = const_this->getVertex(vertex_id);
+    const pose_graph::VertexId& new_vertex_id =
+        common::getChecked(source_to_dest_vertex_id_map, vertex_id);
+    for (size_t frame_idx = 0u; frame_idx < source_vertex.numFrames();
+         ++frame_idx) {
+      if (!source_vertex.isVisualFrameSet(frame_idx)) {
+        continue;
+      }
+      const LandmarkIdList& landmark_ids =
+          source_vertex.getFrameObservedLandmarkIds(frame_idx);
+      for (size_t keypoint_idx = 0u; keypoint_idx < landmark_ids.size();
+           ++keypoint_idx) {
+        const LandmarkId& landmark_id = landmark_ids[keypoint_idx];
+        if (landmark_id.isValid() &&
+            source_to_dest_landmark_id_map.count(landmark_id) == 0u) {
+          store_vertex_to_new_observations
+              [landmark_index.getStoringVertexId(landmark_id)]
+                  .emplace_back(
+                      landmark_id,
+                      KeypointIdentifier(
+                          new_vertex_id, frame_idx, keypoint_idx));
         }
       }
     }
   }
+  const std::vector<std::pair<pose_graph::VertexId, LandmarkObservationList>>
+      store_vertex_new_observations(
+          store_vertex_to_new_observations.begin(),
+          store_vertex_to_new_observations.end());
+  std::function<void(const std::vector<size_t>&)> add_observations =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          vi_map::LandmarkStore& landmark_store =
+              getVertex(store_vertex_new_observations[idx].first)
+                  .getLandmarks();
+          for (const LandmarkObservationList::value_type& new_observation :
+               store_vertex_new_observations[idx].second) {
+            landmark_store.getLandmark(new_observation.first)
+                .addObservation(new_observation.second);
+          }
+        }
+      };
+  common::ParallelProcess(
+      store_vertex_new_observations.size(), add_observations,
+      kAlwaysParallelize, num_threads);
 
   VLOG(1) << "Updating landmark index tables.";
+  landmark_index.reserve(
+      landmark_index.numLandmarks() + source_to_dest_landmark_id_map.size());
   for (const LandmarkIdToLandmarkIdMap::value_type& source_to_dest_landmark :
        source_to_dest_landmark_id_map) {
     CHECK(source_to_dest_landmark.first.isValid());
@@ -1441,16 +1947,9 @@ void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
     CHECK(hasLandmark(source_to_dest_landmark.first));
     const pose_graph::VertexId& old_store_vertex_id =
         getLandmarkStoreVertexId(source_to_dest_landmark.first);
-
-    vi_map::LandmarkId new_landmark_id = source_to_dest_landmark.second;
-
-    VertexIdToVertexIdIterator it_vertex;
-    it_vertex = source_to_dest_vertex_id_map.find(old_store_vertex_id);
-    CHECK(it_vertex != source_to_dest_vertex_id_map.end());
-    pose_graph::VertexId new_store_vertex_id = it_vertex->second;
-
     landmark_index.addLandmarkAndVertexReference(
-        new_landmark_id, new_store_vertex_id);
+        source_to_dest_landmark.second,
+        common::getChecked(source_to_dest_vertex_id_map, old_store_vertex_id));
   }
   CHECK(checkMapConsistency(*this));
 
@@ -1550,64 +2049,52 @@ void VIMap::removeMission(
   pose_graph::VertexIdList vertices;
   getAllVertexIdsInMission(mission_id, &vertices);
 
-  for (pose_graph::VertexId vertex_id : vertices) {
-    vi_map::Vertex* vertex = getVertexPtr(vertex_id);
-    // Delete all edges.
-    pose_graph::EdgeIdSet incoming_edges;
-    vertex->getIncomingEdges(&incoming_edges);
-    for (pose_graph::EdgeId incoming_edge_id : incoming_edges) {
-      if (hasEdge(incoming_edge_id)) {
-        removeEdge(incoming_edge_id);
-      }
-    }
-    pose_graph::EdgeIdSet outgoing_edges;
-    vertex->getOutgoingEdges(&outgoing_edges);
-    for (pose_graph::EdgeId outgoing_edge_id : outgoing_edges) {
-      if (hasEdge(outgoing_edge_id)) {
-        removeEdge(outgoing_edge_id);
-      }
-    }
-
-    // Delete all landmarks.
-    vi_map::LandmarkIdList landmark_ids;
-    vertex->getStoredLandmarkIdList(&landmark_ids);
-    for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
-      removeLandmark(landmark_id);
-    }
-    CHECK_EQ(0u, vertex->getLandmarks().size());
-
-    // Remove references to global landmarks and landmark backlinks.
-    for (unsigned int frame_idx = 0u; frame_idx < vertex->numFrames();
-         ++frame_idx) {
-      vi_map::LandmarkIdList frame_landmark_ids;
-      vertex->getFrameObservedLandmarkIds(frame_idx, &frame_landmark_ids);
-
-      for (size_t i = 0; i < frame_landmark_ids.size(); ++i) {
-        if (frame_landmark_ids[i].isValid()) {
-          const vi_map::LandmarkId& landmark_id = frame_landmark_ids[i];
-
-          vi_map::Landmark& landmark = getLandmark(landmark_id);
-          landmark.removeAllObservationsOfVertex(vertex_id);
-
-          // Also clean up the global landmark id list in the current vertex
-          // so that we feed a consistent state to the removeVertex method
-          // below.
-          vi_map::LandmarkId invalid_landmark_id;
-          invalid_landmark_id.setInvalid();
-          vertex->setObservedLandmarkId(frame_idx, i, invalid_landmark_id);
-
-          // If the current vertex was the only observer of the landmark stored
-          // in some other mission, we should remove this orphaned landmark.
-          if (getMissionIdForLandmark(landmark_id) != mission_id &&
-              !landmark.hasObservations()) {
-            removeLandmark(landmark.id());
+  // Delete all landmarks of the mission at once, then the observations of the
+  // mission in the landmarks of other missions. Landmarks of other missions
+  // only observed by this mission get orphaned and are removed as well.
+  removeAllLandmarksOfMissions({mission_id});
+  removeVerticesFromObservedLandmarks(
+      pose_graph::VertexIdSet(vertices.begin(), vertices.end()));
+
+  // Clean up the remaining global landmark ids of the vertices so that we
+  // feed a consistent state to the removeVertex method below.
+  vi_map::LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  std::function<void(const std::vector<size_t>&)> invalidate_observations =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          vi_map::Vertex& vertex = getVertex(vertices[idx]);
+          CHECK_EQ(0u, vertex.getLandmarks().size());
+          for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            const size_t num_keypoints =
+                vertex.getFrameObservedLandmarkIds(frame_idx).size();
+            for (size_t i = 0u; i < num_keypoints; ++i) {
+              vertex.setObservedLandmarkId(frame_idx, i, invalid_landmark_id);
+            }
           }
         }
-      }
-    }
-
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      vertices.size(), invalidate_observations, kAlwaysParallelize,
+      num_threads);
+
+  // Delete all edges, each only once, and the vertices.
+  pose_graph::EdgeIdSet edges;
+  for (const pose_graph::VertexId& vertex_id : vertices) {
+    pose_graph::EdgeIdSet vertex_edges;
+    getVertex(vertex_id).getAllEdges(&vertex_edges);
+    edges.insert(vertex_edges.begin(), vertex_edges.end());
+  }
+  for (const pose_graph::EdgeId& edge_id : edges) {
+    removeEdge(edge_id);
+  }
+  for (const pose_graph::VertexId& vertex_id : vertices) {
     removeVertex(vertex_id);
   }
+  posegraph.releaseEmptyObjectPools();
 
   // Set the root vertex to invalid. (Also it's anyway already deleted.)
   pose_graph::VertexId invalid_vertex_id;
@@ -1631,6 +2118,10 @@ void VIMap::removeMissionObject(
     mission_base_frames.erase(mission.getBaseFrameId());
   }
   missions.erase(mission_id);
+  {
+    std::lock_guard<std::mutex> lock(mission_traversals_mutex_);
+    mission_traversals_.erase(mission_id);
+  }
   selected_missions_.erase(mission_id);
 }
 
@@ -1708,26 +2199,56 @@ void VIMap::getAllVertexIdsInMission(
   getAllVertexIdsInMissionAlongGraph(mission_id, vertices);
 }
 
-void VIMap::getAllVertexIdsInMissionAlongGraph(
-    const vi_map::MissionId& mission_id,
-    pose_graph::VertexIdList* vertices) const {
-  CHECK_NOTNULL(vertices);
-  CHECK(hasMission(mission_id));
-  vertices->clear();
+std::shared_ptr<const VIMap::MissionTraversal> VIMap::getMissionTraversal(
+    const vi_map::MissionId& mission_id) const {
+  CHECK(hasMission(mission_id))
+      << "Mission " << mission_id.hexString() << " does not exist";
+  const pose_graph::VertexId& root_vertex_id =
+      getMission(mission_id).getRootVertexId();
+  const pose_graph::Edge::EdgeType traversal_edge_type =
+      getGraphTraversalEdgeType(mission_id);
+  const uint64_t topology_revision = posegraph.getTopologyRevision();
+  {
+    std::lock_guard<std::mutex> lock(mission_traversals_mutex_);
+    const auto it = mission_traversals_.find(mission_id);
+    if (it != mission_traversals_.end() &&
+        it->second->topology_revision == topology_revision &&
+        it->second->root_vertex_id == root_vertex_id &&
+        it->second->traversal_edge_type == traversal_edge_type) {
+      return it->second;
+    }
+  }
 
-  const vi_map::VIMission& mission = getMission(mission_id);
-  pose_graph::VertexId current_vertex_id = mission.getRootVertexId();
+  std::shared_ptr<MissionTraversal> traversal =
+      std::make_shared<MissionTraversal>();
+  traversal->topology_revision = topology_revision;
+  traversal->root_vertex_id = root_vertex_id;
+  traversal->traversal_edge_type = traversal_edge_type;
 
-  // Early exit if the root vertex hasn't been set yet.
-  if (!current_vertex_id.isValid()) {
-    return;
+  pose_graph::VertexId current_vertex_id = root_vertex_id;
+  // The root vertex may not have been set yet.
+  if (current_vertex_id.isValid()) {
+    pose_graph::EdgeIdSet outgoing_edges;
+    do {
+      traversal->vertex_ids.push_back(current_vertex_id);
+      getVertex(current_vertex_id).getOutgoingEdges(&outgoing_edges);
+      traversal->edge_ids.insert(
+          traversal->edge_ids.end(), outgoing_edges.begin(),
+          outgoing_edges.end());
+    } while (getNextVertex(
+        current_vertex_id, traversal_edge_type, &current_vertex_id));
   }
 
-  do {
-    vertices->push_back(current_vertex_id);
-  } while (getNextVertex(
-      current_vertex_id, getGraphTraversalEdgeType(mission_id),
-      &current_vertex_id));
+  std::lock_guard<std::mutex> lock(mission_traversals_mutex_);
+  mission_traversals_[mission_id] = traversal;
+  return traversal;
+}
+
+void VIMap::getAllVertexIdsInMissionAlongGraph(
+    const vi_map::MissionId& mission_id,
+    pose_graph::VertexIdList* vertices) const {
+  CHECK_NOTNULL(vertices);
+  *vertices = getMissionTraversal(mission_id)->vertex_ids;
 }
 
 void VIMap::getAllVertexIdsAlongGraphsSortedByTimestamp(
@@ -1738,8 +2259,8 @@ void VIMap::getAllVertexIdsAlongGraphsSortedByTimestamp(
   getAllMissionIdsSortedByTimestamp(&all_mission_ids);
   CHECK(!all_mission_ids.empty());
   for (const vi_map::MissionId& mission_id : all_mission_ids) {
-    pose_graph::VertexIdList mission_all_vertex_ids;
-    getAllVertexIdsInMissionAlongGraph(mission_id, &mission_all_vertex_ids);
+    const pose_graph::VertexIdList& mission_all_vertex_ids =
+        getMissionTraversal(mission_id)->vertex_ids;
     vertices->insert(
         vertices->end(), mission_all_vertex_ids.cbegin(),
         mission_all_vertex_ids.cend());
@@ -1749,58 +2270,20 @@ void VIMap::getAllVertexIdsAlongGraphsSortedByTimestamp(
 void VIMap::getAllEdgeIdsInMissionAlongGraph(
     const vi_map::MissionId& mission_id, pose_graph::EdgeIdList* edges) const {
   CHECK_NOTNULL(edges);
-  CHECK(hasMission(mission_id))
-      << "Mission " << mission_id.hexString() << " does not exist";
-  edges->clear();
-
-  const vi_map::VIMission& mission = getMission(mission_id);
-  pose_graph::VertexId current_vertex_id = mission.getRootVertexId();
-
-  // Early exit if the root vertex hasn't been set yet.
-  if (!current_vertex_id.isValid()) {
-    return;
-  }
-
-  do {
-    pose_graph::EdgeIdSet outgoing_edges;
-    getVertex(current_vertex_id).getOutgoingEdges(&outgoing_edges);
-    edges->insert(edges->end(), outgoing_edges.begin(), outgoing_edges.end());
-  } while (getNextVertex(
-      current_vertex_id, getGraphTraversalEdgeType(mission_id),
-      &current_vertex_id));
+  *edges = getMissionTraversal(mission_id)->edge_ids;
 }
 
 void VIMap::getAllEdgeIdsInMissionAlongGraph(
     const vi_map::MissionId& mission_id, pose_graph::Edge::EdgeType edge_type,
     pose_graph::EdgeIdList* edges) const {
-  CHECK_NOTNULL(edges);
-  CHECK(hasMission(mission_id))
-      << "Mission " << mission_id.hexString() << " does not exist";
-  edges->clear();
-
-  const vi_map::VIMission& mission = getMission(mission_id);
-  pose_graph::VertexId current_vertex_id = mission.getRootVertexId();
-
-  // Early exit if the root vertex hasn't been set yet.
-  if (!current_vertex_id.isValid()) {
-    return;
+  CHECK_NOTNULL(edges)->clear();
+  const std::shared_ptr<const MissionTraversal> traversal =
+      getMissionTraversal(mission_id);
+  for (const pose_graph::EdgeId& edge_id : traversal->edge_ids) {
+    if (getEdgeType(edge_id) == edge_type) {
+      edges->push_back(edge_id);
+    }
   }
-
-  std::function<bool(pose_graph::EdgeId&)> is_edge_type_different =  // NOLINT
-      [&](const pose_graph::EdgeId& edge_id) {
-        return getEdgeType(edge_id) != edge_type;
-      };
-
-  do {
-    pose_graph::EdgeIdSet outgoing_edges;
-    getVertex(current_vertex_id).getOutgoingEdges(&outgoing_edges);
-    edges->insert(edges->end(), outgoing_edges.begin(), outgoing_edges.end());
-    edges->erase(
-        std::remove_if(edges->begin(), edges->end(), is_edge_type_different),
-        edges->end());
-  } while (getNextVertex(
-      current_vertex_id, getGraphTraversalEdgeType(mission_id),
-      &current_vertex_id));
 }
 
 bool VIMap::hasEdgesOfType(pose_graph::Edge::EdgeType edge_type) const {
@@ -1832,6 +2315,70 @@ void VIMap::getAllLandmarkIdsInMission(
   }
 }
 
+void VIMap::removeLandmarks(const LandmarkIdSet& landmark_ids) {
+  if (landmark_ids.empty()) {
+    return;
+  }
+
+  // Collect the vertices that store or observe the landmarks.
+  pose_graph::VertexIdSet affected_vertex_ids;
+  for (const LandmarkId& landmark_id : landmark_ids) {
+    CHECK(hasLandmark(landmark_id));
+    affected_vertex_ids.insert(landmark_index.getStoringVertexId(landmark_id));
+    for (const KeypointIdentifier& observation :
+         getLandmark(landmark_id).getObservations()) {
+      affected_vertex_ids.insert(observation.frame_id.vertex_id);
+    }
+  }
+  const pose_graph::VertexIdList affected_vertex_id_list(
+      affected_vertex_ids.begin(), affected_vertex_ids.end());
+
+  // Every vertex only touches its own landmark store and observations.
+  LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  std::function<void(const std::vector<size_t>&)> remove_from_vertices =
+      [&](const std::vector<size_t>& batch) {
+        for (const size_t idx : batch) {
+          vi_map::Vertex& vertex = getVertex(affected_vertex_id_list[idx]);
+          vertex.getLandmarks().removeLandmarks(landmark_ids);
+          for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            const LandmarkIdList& observed_landmark_ids =
+                vertex.getFrameObservedLandmarkIds(frame_idx);
+            for (size_t keypoint_idx = 0u;
+                 keypoint_idx < observed_landmark_ids.size(); ++keypoint_idx) {
+              if (landmark_ids.count(observed_landmark_ids[keypoint_idx]) >
+                  0u) {
+                vertex.setObservedLandmarkId(
+                    frame_idx, keypoint_idx, invalid_landmark_id);
+              }
+            }
+          }
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      affected_vertex_id_list.size(), remove_from_vertices, kAlwaysParallelize,
+      num_threads);
+
+  landmark_index.removeLandmarks(landmark_ids);
+}
+
+void VIMap::removeAllLandmarksOfMissions(
+    const vi_map::MissionIdSet& mission_ids) {
+  LandmarkIdSet landmark_ids;
+  for (const MissionId& mission_id : mission_ids) {
+    LandmarkIdList mission_landmark_ids;
+    getAllLandmarkIdsInMission(mission_id, &mission_landmark_ids);
+    landmark_ids.insert(
+        mission_landmark_ids.begin(), mission_landmark_ids.end());
+  }
+  VLOG(1) << "Removing all " << landmark_ids.size() << " landmarks of "
+          << mission_ids.size() << " missions.";
+  removeLandmarks(landmark_ids);
+}
+
 void VIMap::getOutgoingOfType(
     const pose_graph::Edge::EdgeType ref_edge_type,
     const pose_graph::VertexId& current_vertex_id,
@@ -1940,32 +2487,39 @@ void VIMap::forEachMission(
 }
 
 bool VIMap::checkResourceConsistency() const {
+  const ResourceIndex resource_index(*this);
+
   bool consistent = true;
-  pose_graph::VertexIdList vertices;
-  getAllVertexIds(&vertices);
-  std::unordered_set<backend::ResourceId> unique_resources;
-  for (const pose_graph::VertexId& vertex_id : vertices) {
-    const vi_map::Vertex& vertex = getVertex(vertex_id);
-    const vi_map::Vertex::FrameResourceMap& vertex_resource_info =
-        vertex.getFrameResourceMap();
-    for (unsigned int frame_idx = 0u; frame_idx < vertex.numFrames();
-         ++frame_idx) {
-      if (vertex.isVisualFrameSet(frame_idx)) {
-        const backend::ResourceTypeToIdsMap& frame_resource_info =
-            vertex_resource_info[frame_idx];
-        for (const backend::ResourceTypeToIdsMap::value_type&
-                 type_to_resource_ids : frame_resource_info) {
-          for (const backend::ResourceId& resource_id :
-               type_to_resource_ids.second) {
-            const std::unordered_set<backend::ResourceId>::const_iterator it =
-                unique_resources.find(resource_id);
-            if (it != unique_resources.end()) {
-              LOG(ERROR) << "Resource " << resource_id << " is not unique!";
-              consistent = false;
-            } else {
-              unique_resources.insert(resource_id);
-            }
-            backend::ResourceType type = type_to_resource_ids.first;
+  std::vector<uint32_t> frame_resource_rows;
+  for (uint32_t row = 0u; row < resource_index.numRows(); ++row) {
+    if (resource_index.getOwnerType(row) !=
+        ResourceIndex::OwnerType::kFrame) {
+      continue;
+    }
+    const backend::ResourceId& resource_id = resource_index.getResourceId(row);
+    if (resource_index.findRow(resource_id) != row) {
+      LOG(ERROR) << "Resource " << resource_id << " is not unique!";
+      consistent = false;
+    } else {
+      frame_resource_rows.emplace_back(row);
+    }
+  }
+
+  // Loading the resources dominates, hence they are checked in parallel.
+  std::atomic<bool> frame_resources_consistent(true);
+  if (!frame_resource_rows.empty()) {
+    constexpr bool kAlwaysParallelize = true;
+    common::ParallelProcess(
+        frame_resource_rows.size(),
+        [this, &resource_index, &frame_resource_rows,
+         &frame_resources_consistent](const std::vector<size_t>& range) {
+          for (const size_t idx : range) {
+            const uint32_t row = frame_resource_rows[idx];
+            const backend::ResourceId& resource_id =
+                resource_index.getResourceId(row);
+            const backend::ResourceType type =
+                resource_index.getResourceType(row);
+            bool resource_consistent = true;
             switch (type) {
               case backend::ResourceType::kRawImage:
               case backend::ResourceType::kUndistortedImage:
@@ -1978,61 +2532,40 @@ bool VIMap::checkResourceConsistency() const {
               case backend::ResourceType::kRawDepthMap:
               case backend::ResourceType::kOptimizedDepthMap:
               case backend::ResourceType::kDisparityMap:
-                if (!checkResource<cv::Mat>(resource_id, type)) {
-                  LOG(ERROR) << "Resource " << resource_id
-                             << " is in an inconsistent state!";
-                  consistent = false;
-                }
+              case backend::ResourceType::kProjectedDescriptors:
+                resource_consistent = checkResource<cv::Mat>(resource_id, type);
                 break;
               case backend::ResourceType::kPointCloudXYZ:
-                if (!checkResource<resources::PointCloud>(resource_id, type)) {
-                  LOG(ERROR) << "Resource " << resource_id
-                             << " is in an inconsistent state!";
-                  consistent = false;
-                }
-                break;
               case backend::ResourceType::kPointCloudXYZRGBN:
-                if (!checkResource<resources::PointCloud>(resource_id, type)) {
-                  LOG(ERROR) << "Resource " << resource_id
-                             << " is in an inconsistent state!";
-                  consistent = false;
-                }
+                resource_consistent =
+                    checkResource<resources::PointCloud>(resource_id, type);
                 break;
               default:
                 LOG(FATAL) << "Unknown frame resource type: "
                            << static_cast<int>(type);
             }
+            if (!resource_consistent) {
+              LOG(ERROR) << "Resource " << resource_id
+                         << " is in an inconsistent state!";
+              frame_resources_consistent = false;
+            }
           }
-        }
-      }
-    }
+        },
+        kAlwaysParallelize, common::getNumHardwareThreads());
   }
+  consistent &= frame_resources_consistent;
 
-  vi_map::MissionIdList mission_ids;
-  getAllMissionIds(&mission_ids);
-  for (const vi_map::MissionId& mission_id : mission_ids) {
-    const vi_map::VIMission& mission = getMission(mission_id);
-    backend::ResourceIdSet tsdf_resources;
-    mission.getAllResourceIds(
-        backend::ResourceType::kTsdfGridPath, &tsdf_resources);
-    for (const backend::ResourceId& resource_id : tsdf_resources) {
-      consistent &= checkResource<std::string>(
-          resource_id, backend::ResourceType::kTsdfGridPath);
-    }
-    backend::ResourceIdSet occupancy_resources;
-    mission.getAllResourceIds(
-        backend::ResourceType::kOccupancyGridPath, &occupancy_resources);
-    for (const backend::ResourceId& resource_id : occupancy_resources) {
-      consistent &= checkResource<std::string>(
-          resource_id, backend::ResourceType::kOccupancyGridPath);
+  for (uint32_t row = 0u; row < resource_index.numRows(); ++row) {
+    if (resource_index.getOwnerType(row) !=
+        ResourceIndex::OwnerType::kMission) {
+      continue;
     }
-    backend::ResourceIdSet reconstruction_resources;
-    mission.getAllResourceIds(
-        backend::ResourceType::kPmvsReconstructionPath,
-        &reconstruction_resources);
-    for (const backend::ResourceId& resource_id : reconstruction_resources) {
-      consistent &= checkResource<std::string>(
-          resource_id, backend::ResourceType::kPmvsReconstructionPath);
+    const backend::ResourceType type = resource_index.getResourceType(row);
+    if (type == backend::ResourceType::kTsdfGridPath ||
+        type == backend::ResourceType::kOccupancyGridPath ||
+        type == backend::ResourceType::kPmvsReconstructionPath) {
+      consistent &=
+          checkResource<std::string>(resource_index.getResourceId(row), type);
     }
   }
 
@@ -2126,6 +2659,19 @@ void VIMap::deleteResourceIdForMissions(
   }
 }
 
+backend::ResourceId VIMap::reserveFrameResource(
+    const unsigned int frame_idx, const backend::ResourceType& type,
+    Vertex* vertex_ptr) {
+  CHECK_NOTNULL(vertex_ptr);
+  CHECK_LT(static_cast<unsigned int>(frame_idx), vertex_ptr->numFrames());
+  std::lock_guard<std::recursive_mutex> lock(resource_mutex_);
+
+  backend::ResourceId resource_id;
+  common::generateId(&resource_id);
+  vertex_ptr->addFrameResourceIdOfType(frame_idx, type, resource_id);
+  return resource_id;
+}
+
 // NOTE: [ADD_RESOURCE_TYPE] [ADD_RESOURCE_DATA_TYPE] Add a switch case if the
 // resource is a frame resource.
 void VIMap::deleteAllFrameResources(
@@ -2153,6 +2699,7 @@ void VIMap::deleteAllFrameResources(
         case ResourceType::kRawDepthMap:
         case ResourceType::kOptimizedDepthMap:
         case ResourceType::kDisparityMap:
+        case ResourceType::kProjectedDescriptors:
           deleteResource<cv::Mat>(resource_id, type);
           break;
         default:
@@ -0,0 +1,133 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/map-memory-usage.h"
+#include "vi-map/mission-statistics.h"
+#include "vi-map/test/vi-map-generator.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class MissionStatisticsTest : public ::testing::Test {
+ protected:
+  MissionStatisticsTest() : map_(), generator_(map_, 42) {}
+
+  virtual void SetUp() {
+    const pose::Transformation T_G_M;
+    missions_[0] = generator_.createMission(T_G_M);
+    missions_[1] = generator_.createMission(T_G_M);
+
+    // The vertices of each mission are one meter apart.
+    pose_graph::VertexId vertices[kNumVerticesPerMission];
+    for (size_t i = 0u; i < kNumVerticesPerMission; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << static_cast<double>(i), 0.0, 0.0;
+      vertices[i] = generator_.createVertex(missions_[0], T_G_I);
+      generator_.createVertex(missions_[1], T_G_I);
+    }
+
+    // All landmarks are stored in the first mission.
+    for (size_t i = 0u; i < kNumLandmarks; ++i) {
+      const Eigen::Vector3d p_G_fi(static_cast<double>(i), 0.0, 5.0);
+      landmarks_[i] = generator_.createLandmark(
+          p_G_fi, vertices[i % kNumVerticesPerMission],
+          pose_graph::VertexIdList());
+    }
+
+    generator_.generateMap();
+    ASSERT_EQ(map_.numLandmarks(), kNumLandmarks);
+  }
+
+  static constexpr size_t kNumVerticesPerMission = 5u;
+  static constexpr size_t kNumLandmarks = 8u;
+
+  vi_map::MissionId missions_[2];
+  vi_map::LandmarkId landmarks_[kNumLandmarks];
+
+  VIMap map_;
+  VIMapGenerator generator_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+constexpr size_t MissionStatisticsTest::kNumVerticesPerMission;
+constexpr size_t MissionStatisticsTest::kNumLandmarks;
+
+TEST_F(MissionStatisticsTest, CountsVerticesLandmarksAndEdges) {
+  map_.getLandmark(landmarks_[0]).setQuality(Landmark::Quality::kGood);
+  map_.getLandmark(landmarks_[1]).setQuality(Landmark::Quality::kBad);
+
+  MissionStatistics statistics;
+  map_.getMissionStatistics(missions_[0], &statistics);
+  EXPECT_EQ(statistics.num_vertices, kNumVerticesPerMission);
+  EXPECT_EQ(statistics.num_landmarks, kNumLandmarks);
+  EXPECT_EQ(statistics.getNumGoodLandmarks(), 1u);
+  EXPECT_EQ(statistics.getNumBadLandmarks(), 1u);
+  EXPECT_EQ(statistics.getNumUnknownLandmarks(), kNumLandmarks - 2u);
+  EXPECT_EQ(statistics.num_wheel_odometry_edges, kNumVerticesPerMission - 1u);
+  EXPECT_EQ(statistics.num_imu_edges, 0u);
+  EXPECT_NEAR(
+      statistics.distance_travelled_m,
+      static_cast<double>(kNumVerticesPerMission - 1u), 1e-12);
+
+  MissionStatistics other_statistics;
+  map_.getMissionStatistics(missions_[1], &other_statistics);
+  EXPECT_EQ(other_statistics.num_vertices, kNumVerticesPerMission);
+  EXPECT_EQ(other_statistics.num_landmarks, 0u);
+
+  // Same as the previous single-mission accessor.
+  std::vector<size_t> num_good, num_bad, num_unknown, num_total;
+  size_t num_landmarks, num_vertices, num_observations;
+  double duration_s;
+  int64_t start_time_ns, end_time_ns;
+  map_.getStatisticsOfMission(
+      missions_[0], &num_good, &num_bad, &num_unknown, &num_total,
+      &num_landmarks, &num_vertices, &num_observations, &duration_s,
+      &start_time_ns, &end_time_ns);
+  EXPECT_EQ(num_total, statistics.total_num_landmarks_per_camera);
+  EXPECT_EQ(num_landmarks, statistics.num_landmarks);
+  EXPECT_EQ(num_vertices, statistics.num_vertices);
+  EXPECT_EQ(num_observations, statistics.num_observations);
+
+  statistics.accumulateCounts(other_statistics);
+  EXPECT_EQ(statistics.num_vertices, 2u * kNumVerticesPerMission);
+  EXPECT_EQ(statistics.num_landmarks, kNumLandmarks);
+  EXPECT_NEAR(
+      statistics.distance_travelled_m,
+      2.0 * static_cast<double>(kNumVerticesPerMission - 1u), 1e-12);
+}
+
+TEST_F(MissionStatisticsTest, MemoryUsagePerMission) {
+  MapMemoryUsage usage;
+  map_.getMissionMemoryUsage(missions_[0], &usage);
+  MapMemoryUsage other_usage;
+  map_.getMissionMemoryUsage(missions_[1], &other_usage);
+
+  EXPECT_GE(usage.vertex_bytes, kNumVerticesPerMission * sizeof(Vertex));
+  EXPECT_GE(
+      usage.landmark_bytes,
+      other_usage.landmark_bytes + kNumLandmarks * sizeof(Landmark));
+  EXPECT_EQ(usage.imu_edge_bytes, 0u);
+  EXPECT_GT(usage.other_edge_bytes, 0u);
+  EXPECT_EQ(usage.resource_cache_bytes, 0u);
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIdsInMission(missions_[0], &vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  EXPECT_GE(map_.getVertex(vertex_ids[0]).memoryUsageBytes(), sizeof(Vertex));
+
+  MapMemoryUsage total_usage;
+  map_.getMemoryUsage(&total_usage);
+  EXPECT_EQ(
+      total_usage.getTotalBytes(),
+      usage.getTotalBytes() + other_usage.getTotalBytes() +
+          total_usage.resource_cache_bytes);
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,196 @@
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/check-map-consistency.h"
+#include "vi-map/test/vi-map-generator.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class RemoveLandmarksTest : public ::testing::Test {
+ protected:
+  RemoveLandmarksTest() : map_(), generator_(map_, 42) {}
+
+  virtual void SetUp() {
+    const pose::Transformation T_G_M;
+    missions_[0] = generator_.createMission(T_G_M);
+    missions_[1] = generator_.createMission(T_G_M);
+
+    for (size_t i = 0u; i < kNumVertices; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << static_cast<double>(i), 0.0, 0.0;
+      const MissionId& mission_id = missions_[i < kNumVertices / 2u ? 0 : 1];
+      vertices_[i] = generator_.createVertex(mission_id, T_G_I);
+    }
+
+    // Every landmark is stored in one vertex and observed from the next two,
+    // some of the landmarks are observed from both missions.
+    for (size_t i = 0u; i < kNumLandmarks; ++i) {
+      const Eigen::Vector3d p_G_fi(static_cast<double>(i), 0.0, 5.0);
+      const size_t storing_vertex_idx = i % (kNumVertices - 2u);
+      landmarks_[i] = generator_.createLandmark(
+          p_G_fi, vertices_[storing_vertex_idx],
+          {vertices_[storing_vertex_idx + 1u],
+           vertices_[storing_vertex_idx + 2u]});
+    }
+
+    // IMU edges as backbone, such that the vertices can be merged.
+    generator_.generateMap<ViwlsEdge>();
+    ASSERT_EQ(map_.numLandmarks(), kNumLandmarks);
+  }
+
+  size_t numValidObservedLandmarkIds() const {
+    size_t num_valid = 0u;
+    for (const pose_graph::VertexId& vertex_id : vertices_) {
+      num_valid += map_.getVertex(vertex_id)
+                       .numValidObservedLandmarkIdsInAllFrames();
+    }
+    return num_valid;
+  }
+
+  static constexpr size_t kNumVertices = 6u;
+  static constexpr size_t kNumLandmarks = 12u;
+
+  vi_map::MissionId missions_[2];
+  pose_graph::VertexId vertices_[kNumVertices];
+  vi_map::LandmarkId landmarks_[kNumLandmarks];
+
+  VIMap map_;
+  VIMapGenerator generator_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+constexpr size_t RemoveLandmarksTest::kNumVertices;
+constexpr size_t RemoveLandmarksTest::kNumLandmarks;
+
+TEST_F(RemoveLandmarksTest, RemoveLandmarksRemovesStoresAndObservations) {
+  LandmarkIdSet landmarks_to_remove;
+  for (size_t i = 0u; i < kNumLandmarks; i += 2u) {
+    landmarks_to_remove.insert(landmarks_[i]);
+  }
+  const size_t num_valid_observations_before = numValidObservedLandmarkIds();
+
+  map_.removeLandmarks(landmarks_to_remove);
+
+  EXPECT_EQ(map_.numLandmarks(), kNumLandmarks - landmarks_to_remove.size());
+  for (size_t i = 0u; i < kNumLandmarks; ++i) {
+    EXPECT_EQ(map_.hasLandmark(landmarks_[i]), i % 2u == 1u);
+  }
+  // Every landmark has three observations.
+  EXPECT_EQ(
+      numValidObservedLandmarkIds(),
+      num_valid_observations_before - 3u * landmarks_to_remove.size());
+  for (const pose_graph::VertexId& vertex_id : vertices_) {
+    for (const Landmark& landmark : map_.getVertex(vertex_id).getLandmarks()) {
+      EXPECT_EQ(landmarks_to_remove.count(landmark.id()), 0u);
+      EXPECT_EQ(map_.getLandmarkStoreVertexId(landmark.id()), vertex_id);
+    }
+  }
+  EXPECT_TRUE(checkMapConsistency(map_));
+}
+
+TEST_F(RemoveLandmarksTest, RemoveAllLandmarksOfMissions) {
+  LandmarkIdList first_mission_landmark_ids;
+  map_.getAllLandmarkIdsInMission(missions_[0], &first_mission_landmark_ids);
+  ASSERT_FALSE(first_mission_landmark_ids.empty());
+
+  map_.removeAllLandmarksOfMissions({missions_[0]});
+
+  for (const LandmarkId& landmark_id : first_mission_landmark_ids) {
+    EXPECT_FALSE(map_.hasLandmark(landmark_id));
+  }
+  EXPECT_EQ(
+      map_.numLandmarks(), kNumLandmarks - first_mission_landmark_ids.size());
+  EXPECT_TRUE(checkMapConsistency(map_));
+
+  map_.removeAllLandmarksOfMissions({missions_[0], missions_[1]});
+  EXPECT_EQ(map_.numLandmarks(), 0u);
+  EXPECT_EQ(numValidObservedLandmarkIds(), 0u);
+  EXPECT_TRUE(checkMapConsistency(map_));
+}
+
+TEST_F(RemoveLandmarksTest, MergeLandmarksResolvesChains) {
+  const LandmarkIdList landmark_ids(landmarks_, landmarks_ + kNumLandmarks);
+  const size_t num_valid_observations_before = numValidObservedLandmarkIds();
+
+  // 0 -> 1 -> 2 is a chain, the last two pairs are merged already.
+  const std::vector<std::pair<LandmarkId, LandmarkId>> pairs = {
+      {landmark_ids[0], landmark_ids[1]},
+      {landmark_ids[1], landmark_ids[2]},
+      {landmark_ids[5], landmark_ids[6]},
+      {landmark_ids[6], landmark_ids[5]},
+      {landmark_ids[2], landmark_ids[0]}};
+  EXPECT_EQ(map_.mergeLandmarks(pairs), 3u);
+
+  EXPECT_EQ(map_.numLandmarks(), kNumLandmarks - 3u);
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[0]));
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[1]));
+  EXPECT_FALSE(map_.hasLandmark(landmark_ids[5]));
+  // Every landmark has three observations.
+  EXPECT_EQ(map_.getLandmark(landmark_ids[2]).numberOfObservations(), 9u);
+  EXPECT_EQ(map_.getLandmark(landmark_ids[6]).numberOfObservations(), 6u);
+
+  // The observations are moved, not removed.
+  EXPECT_EQ(numValidObservedLandmarkIds(), num_valid_observations_before);
+  for (const pose_graph::VertexId& vertex_id : vertices_) {
+    LandmarkIdList observed_landmark_ids;
+    map_.getVertex(vertex_id).getAllObservedLandmarkIds(
+        &observed_landmark_ids);
+    for (const LandmarkId& landmark_id : observed_landmark_ids) {
+      EXPECT_TRUE(!landmark_id.isValid() || map_.hasLandmark(landmark_id));
+    }
+  }
+}
+
+TEST_F(RemoveLandmarksTest, MergeVertexSegmentsMovesLandmarks) {
+  const size_t num_edges_before = map_.numEdges();
+  LandmarkIdList moved_landmark_ids;
+  map_.getVertex(vertices_[2]).getStoredLandmarkIdList(&moved_landmark_ids);
+  ASSERT_FALSE(moved_landmark_ids.empty());
+
+  // Both segments end with the last vertex of a mission.
+  map_.mergeVertexSegments(
+      {{vertices_[1], {vertices_[2]}}, {vertices_[4], {vertices_[5]}}});
+
+  EXPECT_EQ(map_.numVertices(), kNumVertices - 2u);
+  EXPECT_FALSE(map_.hasVertex(vertices_[2]));
+  EXPECT_FALSE(map_.hasVertex(vertices_[5]));
+  EXPECT_EQ(map_.numEdges(), num_edges_before - 2u);
+  // Every landmark is still observed from one of the remaining vertices.
+  EXPECT_EQ(map_.numLandmarks(), kNumLandmarks);
+  for (const LandmarkId& landmark_id : moved_landmark_ids) {
+    EXPECT_EQ(map_.getLandmarkStoreVertexId(landmark_id), vertices_[1]);
+  }
+  for (size_t i = 0u; i < kNumLandmarks; ++i) {
+    const Landmark& landmark = map_.getLandmark(landmarks_[i]);
+    EXPECT_TRUE(landmark.hasObservations());
+    landmark.forEachObservation([this](const KeypointIdentifier& observation) {
+      EXPECT_TRUE(map_.hasVertex(observation.frame_id.vertex_id));
+    });
+  }
+  EXPECT_TRUE(checkMapConsistency(map_));
+}
+
+TEST_F(RemoveLandmarksTest, RemoveMissionRemovesOrphanedLandmarks) {
+  map_.removeMission(missions_[1], true);
+
+  EXPECT_EQ(map_.numMissions(), 1u);
+  EXPECT_EQ(map_.numVertices(), kNumVertices / 2u);
+  // The landmarks stored in the second vertex are only observed from the
+  // removed mission.
+  for (size_t i = 0u; i < kNumLandmarks; ++i) {
+    const size_t storing_vertex_idx = i % (kNumVertices - 2u);
+    EXPECT_EQ(map_.hasLandmark(landmarks_[i]), storing_vertex_idx < 2u);
+  }
+  EXPECT_TRUE(checkMapConsistency(map_));
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
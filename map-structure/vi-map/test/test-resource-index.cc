@@ -0,0 +1,164 @@
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/resource-index.h"
+#include "vi-map/test/vi-map-generator.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class ResourceIndexTest : public ::testing::Test {
+ protected:
+  ResourceIndexTest() : map_(), generator_(map_, 42) {}
+
+  virtual void SetUp() {
+    const pose::Transformation T_G_M;
+    missions_[0] = generator_.createMission(T_G_M);
+    missions_[1] = generator_.createMission(T_G_M);
+    for (size_t i = 0u; i < kNumVertices; ++i) {
+      pose::Transformation T_G_I;
+      T_G_I.getPosition() << static_cast<double>(i), 0.0, 0.0;
+      const MissionId& mission_id = missions_[i < kNumVertices / 2u ? 0 : 1];
+      vertices_[i] =
+          generator_.createVertex(mission_id, T_G_I, getVertexTimestamp(i));
+    }
+    generator_.generateMap();
+
+    for (size_t i = 0u; i < kNumVertices; ++i) {
+      common::generateId(&frame_resource_ids_[i]);
+      map_.getVertex(vertices_[i])
+          .addFrameResourceIdOfType(
+              0u, backend::ResourceType::kRawImage, frame_resource_ids_[i]);
+    }
+
+    // A resource shared by both missions.
+    common::generateId(&mission_resource_id_);
+    for (const MissionId& mission_id : missions_) {
+      map_.getMission(mission_id)
+          .addResourceId(
+              mission_resource_id_, backend::ResourceType::kTsdfGridPath);
+    }
+
+    VIMission& mission = map_.getMission(missions_[1]);
+    aslam::Camera::ConstPtr camera =
+        aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+    mission.addOptionalCameraWithExtrinsics(*camera, aslam::Transformation());
+    camera_id_ = camera->getId();
+    common::generateId(&camera_resource_id_);
+    mission.addOptionalCameraResourceId(
+        backend::ResourceType::kRawImage, camera_id_, camera_resource_id_,
+        kCameraResourceTimestampNs);
+  }
+
+  static int64_t getVertexTimestamp(size_t vertex_idx) {
+    return 100 * static_cast<int64_t>(vertex_idx + 1u);
+  }
+
+  static constexpr size_t kNumVertices = 6u;
+  // Between the timestamps of the second and third vertex.
+  static constexpr int64_t kCameraResourceTimestampNs = 240;
+
+  vi_map::MissionId missions_[2];
+  pose_graph::VertexId vertices_[kNumVertices];
+  backend::ResourceId frame_resource_ids_[kNumVertices];
+  backend::ResourceId mission_resource_id_;
+  backend::ResourceId camera_resource_id_;
+  aslam::CameraId camera_id_;
+
+  VIMap map_;
+  VIMapGenerator generator_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+constexpr size_t ResourceIndexTest::kNumVertices;
+constexpr int64_t ResourceIndexTest::kCameraResourceTimestampNs;
+
+TEST_F(ResourceIndexTest, FindsOwners) {
+  const ResourceIndex index(map_);
+  EXPECT_EQ(index.numRows(), kNumVertices + 2u + 1u);
+
+  for (size_t i = 0u; i < kNumVertices; ++i) {
+    const uint32_t row = index.findRow(frame_resource_ids_[i]);
+    ASSERT_NE(row, ResourceIndex::kInvalidRow);
+    EXPECT_EQ(index.getOwnerType(row), ResourceIndex::OwnerType::kFrame);
+    EXPECT_EQ(index.getResourceType(row), backend::ResourceType::kRawImage);
+    EXPECT_EQ(index.getVertexId(row), vertices_[i]);
+    EXPECT_EQ(index.getFrameIndex(row), 0u);
+    EXPECT_EQ(
+        index.getMissionId(row), map_.getVertex(vertices_[i]).getMissionId());
+    EXPECT_EQ(index.getTimestampNanoseconds(row), getVertexTimestamp(i));
+    EXPECT_EQ(index.numRowsWithResourceId(frame_resource_ids_[i]), 1u);
+  }
+
+  EXPECT_EQ(index.numRowsWithResourceId(mission_resource_id_), 2u);
+  const uint32_t first_row = index.findRow(mission_resource_id_);
+  ASSERT_NE(first_row, ResourceIndex::kInvalidRow);
+  const uint32_t second_row = index.getNextRowWithSameResourceId(first_row);
+  ASSERT_NE(second_row, ResourceIndex::kInvalidRow);
+  EXPECT_EQ(index.getOwnerType(first_row), ResourceIndex::OwnerType::kMission);
+  EXPECT_NE(index.getMissionId(first_row), index.getMissionId(second_row));
+  EXPECT_EQ(
+      index.getTimestampNanoseconds(first_row), ResourceIndex::kNoTimestamp);
+
+  const uint32_t camera_row = index.findRow(camera_resource_id_);
+  ASSERT_NE(camera_row, ResourceIndex::kInvalidRow);
+  EXPECT_EQ(
+      index.getOwnerType(camera_row),
+      ResourceIndex::OwnerType::kOptionalCamera);
+  EXPECT_EQ(index.getCameraId(camera_row), camera_id_);
+  EXPECT_EQ(index.getMissionId(camera_row), missions_[1]);
+
+  backend::ResourceId unknown_resource_id;
+  common::generateId(&unknown_resource_id);
+  EXPECT_EQ(index.findRow(unknown_resource_id), ResourceIndex::kInvalidRow);
+}
+
+TEST_F(ResourceIndexTest, TemporalQueries) {
+  const ResourceIndex index(map_);
+  const std::vector<uint32_t>& image_rows =
+      index.getRowsOfType(backend::ResourceType::kRawImage);
+  ASSERT_EQ(image_rows.size(), kNumVertices + 1u);
+  for (size_t i = 1u; i < image_rows.size(); ++i) {
+    EXPECT_LE(
+        index.getTimestampNanoseconds(image_rows[i - 1u]),
+        index.getTimestampNanoseconds(image_rows[i]));
+  }
+
+  std::vector<uint32_t> rows;
+  index.getRowsOfTypeInTimeRange(
+      backend::ResourceType::kRawImage, getVertexTimestamp(1u),
+      getVertexTimestamp(3u), &rows);
+  ASSERT_EQ(rows.size(), 4u);
+  EXPECT_EQ(index.getVertexId(rows[0]), vertices_[1]);
+  EXPECT_EQ(index.getResourceId(rows[2]), frame_resource_ids_[2]);
+  EXPECT_EQ(index.getVertexId(rows[3]), vertices_[3]);
+
+  // Closest is the camera resource at 240, then the vertex at 300.
+  uint32_t row = index.findClosestRowOfType(
+      backend::ResourceType::kRawImage, 260, 50);
+  ASSERT_NE(row, ResourceIndex::kInvalidRow);
+  EXPECT_EQ(index.getResourceId(row), camera_resource_id_);
+  row = index.findClosestRowOfType(backend::ResourceType::kRawImage, 280, 50);
+  ASSERT_NE(row, ResourceIndex::kInvalidRow);
+  EXPECT_EQ(index.getVertexId(row), vertices_[2]);
+  EXPECT_EQ(
+      index.findClosestRowOfType(backend::ResourceType::kRawImage, 270, 10),
+      ResourceIndex::kInvalidRow);
+
+  // Mission resources have no timestamp and are not found by time.
+  EXPECT_EQ(
+      index.findClosestRowOfType(backend::ResourceType::kTsdfGridPath, 0, 1000),
+      ResourceIndex::kInvalidRow);
+  EXPECT_GT(index.getMemoryUsageBytes(), 0u);
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
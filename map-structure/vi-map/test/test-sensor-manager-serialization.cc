@@ -142,6 +142,41 @@ TEST_F(SensorManagerTest, YamlSerializationSensorsWithSensorSystems) {
   EXPECT_EQ(sensor_manager_, sensor_manager_deserialized);
 }
 
+TEST_F(SensorManagerTest, MissionSensorsOfTypeAfterDeserialization) {
+  addNCamera();
+  constexpr size_t kNumToAdd = 10u;
+  for (size_t idx = 0u; idx < kNumToAdd; ++idx) {
+    addSensor();
+  }
+
+  sensor_manager_.serializeToFile(
+      static_cast<std::string>(serialization::internal::kYamlSensorsFilename));
+  SensorManager sensor_manager_deserialized;
+  sensor_manager_deserialized.deserializeFromFile(
+      static_cast<std::string>(serialization::internal::kYamlSensorsFilename));
+
+  for (const SensorManager* sensor_manager :
+       {&sensor_manager_, &sensor_manager_deserialized}) {
+    EXPECT_EQ(
+        sensor_manager->getNCameraForMission(mission_id_).getId(),
+        sensor_manager_.getNCameraShared()->getId());
+
+    size_t num_sensors = 0u;
+    for (int type = 0; type < static_cast<int>(SensorType::kInvalidSensor);
+         ++type) {
+      const SensorType sensor_type = static_cast<SensorType>(type);
+      SensorIdSet expected_sensor_ids;
+      sensor_manager->getAllSensorIdsOfType(sensor_type, &expected_sensor_ids);
+      SensorIdSet sensor_ids;
+      sensor_manager->getAllSensorIdsOfTypeAssociatedWithMission(
+          sensor_type, mission_id_, &sensor_ids);
+      EXPECT_TRUE(expected_sensor_ids == sensor_ids);
+      num_sensors += sensor_ids.size();
+    }
+    EXPECT_EQ(kNumToAdd, num_sensors);
+  }
+}
+
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
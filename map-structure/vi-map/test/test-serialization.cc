@@ -1,11 +1,20 @@
+#include <gflags/gflags.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/map-manager-config.h>
 #include <maplab-common/network-common.h>
 #include <maplab-common/test/testing-entrypoint.h>
 
 #include "vi-map/test/vi-map-generator.h"
 #include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vertex-payload-pager.h"
 #include "vi-map/vi-map-serialization.h"
 #include "vi-map/vi-map.h"
 
+DECLARE_bool(vi_map_incremental_save);
+DECLARE_bool(vi_map_lazy_load_vertex_payloads);
+DECLARE_double(vi_map_lazy_load_max_resident_mb);
+DECLARE_int32(vi_map_serialization_vertices_per_chunk);
+
 void deleteRawData(const network::RawMessageDataList& raw_data) {
   for (const network::RawMessageData& raw_data_part : raw_data) {
     delete[] static_cast<uint8_t*>(raw_data_part.first);
@@ -47,4 +56,168 @@ TEST(Serialization, SerializeMapWithOptionalCameraResources) {
   deleteRawData(raw_data);
 }
 
+TEST(Serialization, SaveMapStreamedInChunks) {
+  const std::string map_folder = "SaveMapStreamedInChunks";
+  ASSERT_TRUE(common::removePath(map_folder));
+
+  vi_map::VIMap test_map, loaded_map;
+  vi_map::test::generateMap(&test_map);
+
+  // Vertex proto files that consist of several chunks, the last one partial.
+  const int32_t original_vertices_per_chunk =
+      FLAGS_vi_map_serialization_vertices_per_chunk;
+  FLAGS_vi_map_serialization_vertices_per_chunk = 3;
+  backend::SaveConfig config;
+  config.vertices_per_proto_file = 7u;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(map_folder, config, &test_map));
+  FLAGS_vi_map_serialization_vertices_per_chunk = original_vertices_per_chunk;
+
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &loaded_map));
+  vi_map::test::compareVIMap(test_map, loaded_map);
+  common::removePath(map_folder);
+}
+
+TEST(Serialization, SaveOnlyChangedProtoFiles) {
+  const std::string map_folder = "SaveOnlyChangedProtoFiles";
+  ASSERT_TRUE(common::removePath(map_folder));
+  FLAGS_vi_map_incremental_save = true;
+
+  vi_map::VIMap test_map, loaded_map;
+  vi_map::test::generateMap(&test_map);
+  backend::SaveConfig config;
+  config.vertices_per_proto_file = 5u;
+  config.overwrite_existing_files = true;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(map_folder, config, &test_map));
+  const vi_map::ProtoFileState& state = test_map.getProtoFileState();
+  EXPECT_TRUE(state.isValidForFolder(map_folder));
+  ASSERT_GT(state.vertex_files.size(), 1u);
+  const std::vector<uint64_t> saved_fingerprints = state.fingerprints;
+
+  // Only the vertex file of the modified vertex differs.
+  const pose_graph::VertexId& modified_vertex_id = state.vertex_files[1][0];
+  test_map.getVertex(modified_vertex_id).set_T_M_I(pose::Transformation());
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(map_folder, config, &test_map));
+  ASSERT_EQ(state.fingerprints.size(), saved_fingerprints.size());
+  for (size_t i = 0u; i < saved_fingerprints.size(); ++i) {
+    EXPECT_EQ(
+        state.fingerprints[i] != saved_fingerprints[i],
+        i == vi_map::serialization::internal::kProtoListVerticesStartIndex +
+                 1u);
+  }
+
+  ASSERT_TRUE(
+      vi_map::serialization::loadMapFromFolder(map_folder, &loaded_map));
+  vi_map::test::compareVIMap(test_map, loaded_map);
+  EXPECT_TRUE(loaded_map.getProtoFileState().isValidForFolder(map_folder));
+  EXPECT_EQ(
+      loaded_map.getProtoFileState().vertex_files.size(),
+      state.vertex_files.size());
+
+  FLAGS_vi_map_incremental_save = false;
+  common::removePath(map_folder);
+}
+
+// Saves a generated map with several vertex proto files and loads it again
+// with lazily loaded vertex payloads.
+void saveAndLoadWithLazyPayloads(
+    const std::string& map_folder, const double max_resident_mb,
+    vi_map::VIMap* test_map, vi_map::VIMap* loaded_map) {
+  CHECK_NOTNULL(test_map);
+  CHECK_NOTNULL(loaded_map);
+  ASSERT_TRUE(common::removePath(map_folder));
+  vi_map::test::generateMap(test_map);
+  backend::SaveConfig config;
+  config.vertices_per_proto_file = 5u;
+  ASSERT_TRUE(
+      vi_map::serialization::saveMapToFolder(map_folder, config, test_map));
+
+  FLAGS_vi_map_lazy_load_vertex_payloads = true;
+  FLAGS_vi_map_lazy_load_max_resident_mb = max_resident_mb;
+  ASSERT_TRUE(vi_map::serialization::loadMapFromFolder(map_folder, loaded_map));
+  FLAGS_vi_map_lazy_load_vertex_payloads = false;
+  FLAGS_vi_map_lazy_load_max_resident_mb = 0.0;
+}
+
+size_t getNumVerticesWithResidentPayload(const vi_map::VIMap& map) {
+  size_t num_resident = 0u;
+  map.forEachVertex([&num_resident](const vi_map::Vertex& vertex) {
+    if (vertex.isPayloadResident()) {
+      ++num_resident;
+    }
+  });
+  return num_resident;
+}
+
+TEST(Serialization, LazyLoadVertexPayloads) {
+  const std::string map_folder = "LazyLoadVertexPayloads";
+  vi_map::VIMap test_map, loaded_map;
+  constexpr double kNoBudget = 0.0;
+  saveAndLoadWithLazyPayloads(map_folder, kNoBudget, &test_map, &loaded_map);
+  ASSERT_GT(loaded_map.numVertices(), 5u);
+  EXPECT_EQ(getNumVerticesWithResidentPayload(loaded_map), 0u);
+
+  // The first access pages in the vertices of one proto file.
+  pose_graph::VertexIdList vertex_ids;
+  loaded_map.getAllVertexIds(&vertex_ids);
+  const vi_map::VIMap& const_loaded_map = loaded_map;
+  const vi_map::Vertex& vertex = const_loaded_map.getVertex(vertex_ids.front());
+  EXPECT_EQ(
+      vertex.getVisualNFrame().getNumFrames(),
+      test_map.getVertex(vertex_ids.front()).getVisualNFrame().getNumFrames());
+  EXPECT_TRUE(vertex.isPayloadResident());
+  const size_t num_resident = getNumVerticesWithResidentPayload(loaded_map);
+  EXPECT_GE(num_resident, 1u);
+  EXPECT_LE(num_resident, 5u);
+
+  // Pages in all other payloads.
+  vi_map::test::compareVIMap(test_map, loaded_map);
+  EXPECT_EQ(getNumVerticesWithResidentPayload(loaded_map), vertex_ids.size());
+  common::removePath(map_folder);
+}
+
+TEST(Serialization, ReleaseLazyVertexPayloadsOverBudget) {
+  const std::string map_folder = "ReleaseLazyVertexPayloadsOverBudget";
+  vi_map::VIMap test_map, loaded_map;
+  // Smaller than any proto file.
+  constexpr double kTinyBudgetMb = 1e-6;
+  saveAndLoadWithLazyPayloads(
+      map_folder, kTinyBudgetMb, &test_map, &loaded_map);
+  pose_graph::VertexIdList vertex_ids;
+  loaded_map.getAllVertexIds(&vertex_ids);
+  const vi_map::VIMap& const_loaded_map = loaded_map;
+
+  // Paging in never releases other payloads, even over the budget.
+  const pose_graph::VertexId& read_vertex_id = vertex_ids.front();
+  const_loaded_map.getVertex(read_vertex_id).getVisualNFrame();
+  pose_graph::VertexId modified_vertex_id;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    if (!loaded_map.getVertex(vertex_id).isPayloadResident()) {
+      modified_vertex_id = vertex_id;
+      break;
+    }
+  }
+  ASSERT_TRUE(modified_vertex_id.isValid());
+  loaded_map.getVertex(modified_vertex_id).getVisualNFrame();
+  EXPECT_TRUE(loaded_map.getVertex(read_vertex_id).isPayloadResident());
+  EXPECT_TRUE(loaded_map.getVertex(modified_vertex_id).isPayloadResident());
+
+  // Only the payloads that were not modified are released.
+  loaded_map.releaseVertexPayloadsOverBudget();
+  EXPECT_FALSE(loaded_map.getVertex(read_vertex_id).isPayloadResident());
+  EXPECT_TRUE(loaded_map.getVertex(modified_vertex_id).isPayloadResident());
+  const vi_map::VertexPayloadPager* payload_pager =
+      loaded_map.getVertex(read_vertex_id).getPayloadPager();
+  ASSERT_TRUE(payload_pager != nullptr);
+  EXPECT_GT(payload_pager->getNumResidentBytes(), 0u);
+
+  // Released payloads are paged in again.
+  vi_map::test::compareVIMap(test_map, loaded_map);
+  EXPECT_TRUE(loaded_map.getVertex(read_vertex_id).isPayloadResident());
+  common::removePath(map_folder);
+}
+
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,138 @@
+#include <string>
+
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/map-manager-config.h>
+#include <maplab-common/proto-serialization-helper.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/test/vi-map-generator.h"
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vi-map-serialization.h"
+#include "vi-map/vi-map-snapshot.h"
+#include "vi-map/vi-map.h"
+#include "vi-map/vi_map.pb.h"
+
+namespace vi_map {
+
+class ViMapSnapshotTest : public ::testing::Test {
+ protected:
+  static constexpr const char* kTestFolder = "./vi_map_snapshot_test";
+
+  void SetUp() override {
+    ASSERT_TRUE(common::removePath(kTestFolder));
+    ASSERT_TRUE(common::createPath(kTestFolder));
+  }
+
+  void TearDown() override {
+    common::removePath(kTestFolder);
+  }
+
+  static void fillVerticesProto(proto::VIMap* proto) {
+    CHECK_NOTNULL(proto);
+    constexpr int kNumVertices = 3;
+    for (int vertex_idx = 0; vertex_idx < kNumVertices; ++vertex_idx) {
+      proto->add_vertex_ids();
+      proto::ViwlsVertex* vertex = proto->add_vertices();
+      for (int i = 0; i < 7; ++i) {
+        vertex->add_t_m_i(vertex_idx + 0.1 * i);
+      }
+      vertex->add_v_m(1.0);
+      aslam::proto::VisualFrame* frame =
+          vertex->mutable_n_visual_frame()->add_frames();
+      const int num_keypoints = 5 * vertex_idx;
+      for (int keypoint_idx = 0; keypoint_idx < num_keypoints;
+           ++keypoint_idx) {
+        frame->add_keypoint_measurements(keypoint_idx);
+        frame->add_keypoint_measurements(-keypoint_idx);
+        frame->add_keypoint_measurement_sigmas(0.5 * keypoint_idx);
+        frame->add_descriptor_scales(2.0 * keypoint_idx);
+        frame->add_track_ids(keypoint_idx);
+      }
+      frame->set_keypoint_descriptor_size(4);
+      frame->set_keypoint_descriptors(std::string(4 * num_keypoints, 'd'));
+      frame->set_timestamp(vertex_idx);
+      proto::Landmark* landmark =
+          vertex->mutable_landmark_store()->add_landmarks();
+      landmark->add_position(vertex_idx);
+      landmark->add_position(1.0);
+      landmark->add_position(2.0);
+      landmark->add_covariance(3.0);
+    }
+  }
+};
+
+TEST_F(ViMapSnapshotTest, SaveAndLoadVertices) {
+  proto::VIMap proto;
+  fillVerticesProto(&proto);
+
+  proto::VIMap residual_proto = proto;
+  ASSERT_TRUE(
+      serialization::snapshot::saveVertices(
+          kTestFolder, "vertices0", &residual_proto));
+  // The dense arrays are moved to the column file.
+  EXPECT_EQ(residual_proto.vertices(1).t_m_i_size(), 0);
+  EXPECT_EQ(
+      residual_proto.vertices(1)
+          .n_visual_frame()
+          .frames(0)
+          .keypoint_measurements_size(),
+      0);
+  EXPECT_EQ(residual_proto.vertices(1).v_m_size(), 1);
+
+  proto::VIMap loaded_proto;
+  ASSERT_TRUE(
+      serialization::snapshot::loadVertices(
+          kTestFolder, "vertices0", &loaded_proto));
+  EXPECT_EQ(loaded_proto.SerializeAsString(), proto.SerializeAsString());
+
+  EXPECT_FALSE(
+      serialization::snapshot::loadVertices(
+          kTestFolder, "vertices1", &loaded_proto));
+}
+
+TEST_F(ViMapSnapshotTest, RejectsMismatchingResidualProto) {
+  proto::VIMap proto;
+  fillVerticesProto(&proto);
+  ASSERT_TRUE(
+      serialization::snapshot::saveVertices(kTestFolder, "vertices0", &proto));
+
+  // A residual proto with an additional vertex doesn't match the columns.
+  fillVerticesProto(&proto);
+  ASSERT_TRUE(
+      common::proto_serialization_helper::serializeProtoToFile(
+          kTestFolder, "vertices0", proto));
+  proto::VIMap loaded_proto;
+  EXPECT_FALSE(
+      serialization::snapshot::loadVertices(
+          kTestFolder, "vertices0", &loaded_proto));
+  EXPECT_EQ(loaded_proto.vertices_size(), 0);
+}
+
+TEST_F(ViMapSnapshotTest, SaveAndLoadMapWithSnapshot) {
+  const std::string map_folder = std::string(kTestFolder) + "/test_map";
+  VIMap map;
+  test::generateMap(&map);
+
+  backend::SaveConfig config;
+  config.save_columnar_snapshot = true;
+  ASSERT_TRUE(serialization::saveMapToFolder(map_folder, config, &map));
+  EXPECT_TRUE(
+      common::pathExists(serialization::snapshot::getSnapshotFolder(
+          map_folder)));
+
+  VIMap loaded_map;
+  ASSERT_TRUE(serialization::loadMapFromFolder(map_folder, &loaded_map));
+  test::compareVIMap(map, loaded_map);
+
+  // Saving without a snapshot removes the outdated one.
+  config.save_columnar_snapshot = false;
+  config.overwrite_existing_files = true;
+  ASSERT_TRUE(serialization::saveMapToFolder(map_folder, config, &map));
+  EXPECT_FALSE(
+      common::pathExists(serialization::snapshot::getSnapshotFolder(
+          map_folder)));
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include <aslam/common/memory.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <maplab-common/test/testing-entrypoint.h>
@@ -11,6 +12,8 @@
 #include "vi-map/unique-id.h"
 #include "vi-map/vi_map.pb.h"
 
+DECLARE_int32(vi_map_serialization_format_version);
+
 namespace vi_map {
 
 class LandmarkTest : public ::testing::Test {
@@ -75,8 +78,10 @@ TEST_F(LandmarkTest, TestSerializationNoAppearances) {
   vi_map::proto::Landmark proto_landmark;
   landmark_.serialize(&proto_landmark);
 
+  EXPECT_EQ(proto_landmark.vertex_ids_size(), 0);
   EXPECT_EQ(
-      proto_landmark.vertex_ids_size(), static_cast<int>(num_observations));
+      common::getNumPackedIds(proto_landmark.vertex_ids_packed()),
+      static_cast<int>(num_observations));
   EXPECT_EQ(
       proto_landmark.frame_indices_size(), static_cast<int>(num_observations));
   EXPECT_EQ(
@@ -107,8 +112,10 @@ TEST_F(LandmarkTest, TestSerializationWithAppearances) {
   vi_map::proto::Landmark proto_landmark;
   landmark_.serialize(&proto_landmark);
 
+  EXPECT_EQ(proto_landmark.vertex_ids_size(), 0);
   EXPECT_EQ(
-      proto_landmark.vertex_ids_size(), static_cast<int>(num_observations));
+      common::getNumPackedIds(proto_landmark.vertex_ids_packed()),
+      static_cast<int>(num_observations));
   EXPECT_EQ(
       proto_landmark.frame_indices_size(), static_cast<int>(num_observations));
   EXPECT_EQ(
@@ -122,6 +129,38 @@ TEST_F(LandmarkTest, TestSerializationWithAppearances) {
   EXPECT_TRUE(verifyIncrementalAppearances(deserialized_landmark));
 }
 
+TEST_F(LandmarkTest, TestSerializationFormatVersions) {
+  const size_t num_observations = 100u;
+
+  KeypointIdentifierList observations;
+  generateObservations(num_observations, &observations);
+  landmark_.addObservations(observations);
+  LandmarkId landmark_id;
+  common::generateId(&landmark_id);
+  landmark_.setId(landmark_id);
+
+  vi_map::proto::Landmark packed_proto;
+  landmark_.serialize(&packed_proto);
+
+  // Version 1 stores the vertex ids as messages.
+  const int current_format_version = FLAGS_vi_map_serialization_format_version;
+  FLAGS_vi_map_serialization_format_version = 1;
+  vi_map::proto::Landmark legacy_proto;
+  landmark_.serialize(&legacy_proto);
+  FLAGS_vi_map_serialization_format_version = current_format_version;
+  EXPECT_EQ(legacy_proto.vertex_ids_size(), static_cast<int>(num_observations));
+  EXPECT_EQ(legacy_proto.vertex_ids_packed_size(), 0);
+  EXPECT_LT(packed_proto.ByteSize(), legacy_proto.ByteSize());
+
+  // Both versions are read.
+  Landmark packed_landmark;
+  packed_landmark.deserialize(packed_proto);
+  Landmark legacy_landmark;
+  legacy_landmark.deserialize(legacy_proto);
+  EXPECT_EQ(packed_landmark.getObservations(), observations);
+  EXPECT_EQ(legacy_landmark.getObservations(), observations);
+}
+
 TEST_F(LandmarkTest, TestClearObservationsAndAppearances) {
   const size_t num_observations = 500u;
 
@@ -540,6 +579,44 @@ TEST_F(
   // Frame Index:  {}.
   EXPECT_DEATH(landmark_.getAppearances(), "");
 }
+
+TEST_F(LandmarkTest, CovarianceIsPooledAndCloned) {
+  const size_t num_pooled_covariances =
+      LandmarkCovariance::numPooledCovariances();
+  Eigen::Matrix3d covariance;
+  EXPECT_FALSE(landmark_.get_p_B_Covariance(&covariance));
+  EXPECT_TRUE(covariance.isZero());
+
+  Eigen::Matrix3d expected_covariance;
+  expected_covariance << 1.0, 0.1, 0.2, 0.1, 2.0, 0.3, 0.2, 0.3, 3.0;
+  landmark_.set_p_B_Covariance(expected_covariance);
+  EXPECT_EQ(
+      LandmarkCovariance::numPooledCovariances(), num_pooled_covariances + 1u);
+  ASSERT_TRUE(landmark_.get_p_B_Covariance(&covariance));
+  EXPECT_TRUE(covariance.isApprox(expected_covariance, 1e-6));
+
+  {
+    Landmark copy(landmark_);
+    EXPECT_EQ(copy, landmark_);
+    EXPECT_EQ(
+        LandmarkCovariance::numPooledCovariances(),
+        num_pooled_covariances + 2u);
+
+    proto::Landmark proto;
+    landmark_.serialize(&proto);
+    Landmark deserialized;
+    deserialized.deserialize(proto);
+    EXPECT_EQ(deserialized, landmark_);
+  }
+  EXPECT_EQ(
+      LandmarkCovariance::numPooledCovariances(), num_pooled_covariances + 1u);
+
+  landmark_.unsetCovariance();
+  EXPECT_FALSE(landmark_.get_p_B_Covariance(&covariance));
+  EXPECT_EQ(
+      LandmarkCovariance::numPooledCovariances(), num_pooled_covariances);
+}
+
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
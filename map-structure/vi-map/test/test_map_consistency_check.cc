@@ -43,6 +43,7 @@ class MapConsistencyCheckTest : public ::testing::Test {
   void addMissionUsingAnExistingNCamera(const aslam::NCamera::Ptr& n_cameras);
   void addSecondMission();
   void addLoopClosureEdges();
+  void addLandmarkWithoutBackLink(const pose_graph::VertexId& vertex_id);
 
   std::vector<pose_graph::VertexId> vertex_ids_mission_1_;
   std::vector<pose_graph::VertexId> vertex_ids_mission_2_;
@@ -350,6 +351,25 @@ void MapConsistencyCheckTest::addCommonLandmarkIds(
   }
 }
 
+void MapConsistencyCheckTest::addLandmarkWithoutBackLink(
+    const pose_graph::VertexId& vertex_id) {
+  vi_map::Vertex& vertex = map_.getVertex(vertex_id);
+  vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+  ASSERT_GT(landmark_store.size(), 0);
+
+  vi_map::LandmarkId landmark_id;
+  generateId(&landmark_id);
+
+  vi_map::Landmark landmark;
+  landmark.setId(landmark_id);
+  landmark_store.addLandmark(landmark);
+  addLandmarkAndVertexReference(landmark_id, vertex_id);
+
+  const unsigned int keypoint_index =
+      vertex.numValidObservedLandmarkIds(kVisualFrameIndex);
+  vertex.setObservedLandmarkId(kVisualFrameIndex, keypoint_index, landmark_id);
+}
+
 void MapConsistencyCheckTest::addMissionWithVisualNFrame() {
   static constexpr unsigned int kNumCamerasInMultiframeMission = 5;
   aslam::NCamera::Ptr n_cameras =
@@ -398,22 +418,7 @@ TEST_F(MapConsistencyCheckTest, mapConsistencyMultiVisualFrame) {
 }
 
 TEST_F(MapConsistencyCheckTest, mapInconsistentMissingBackLink) {
-  vi_map::Vertex& vertex0 = map_.getVertex(vertex_ids_mission_1_[2]);
-  vi_map::LandmarkStore& landmark_store = vertex0.getLandmarks();
-  ASSERT_GT(landmark_store.size(), 0);
-
-  vi_map::LandmarkId landmark_id;
-  generateId(&landmark_id);
-
-  vi_map::Landmark landmark;
-  landmark.setId(landmark_id);
-  landmark_store.addLandmark(landmark);
-  addLandmarkAndVertexReference(landmark_id, vertex_ids_mission_1_[2]);
-
-  const unsigned int keypoint_index =
-      vertex0.numValidObservedLandmarkIds(kVisualFrameIndex);
-  vertex0.setObservedLandmarkId(kVisualFrameIndex, keypoint_index, landmark_id);
-
+  addLandmarkWithoutBackLink(vertex_ids_mission_1_[2]);
   EXPECT_FALSE(vi_map::checkMapConsistency(map_));
 }
 
@@ -444,6 +449,61 @@ TEST_F(MapConsistencyCheckTest, MapConsistencyLoopClosureEdges) {
   EXPECT_TRUE(vi_map::checkMapConsistency(map_));
 }
 
+TEST_F(MapConsistencyCheckTest, StructuralOnlyCheckSkipsLandmarks) {
+  addLandmarkWithoutBackLink(vertex_ids_mission_1_[2]);
+  EXPECT_TRUE(
+      vi_map::checkMapConsistency(
+          map_, MapConsistencyCheckLevel::kStructuralOnly));
+  EXPECT_FALSE(
+      vi_map::checkMapConsistency(map_, MapConsistencyCheckLevel::kFull));
+
+  addOrphanedVertex();
+  EXPECT_FALSE(
+      vi_map::checkMapConsistency(
+          map_, MapConsistencyCheckLevel::kStructuralOnly));
+}
+
+TEST_F(MapConsistencyCheckTest, IncrementalCheckOnlyRechecksTouchedItems) {
+  IncrementalMapConsistencyChecker checker(map_);
+  EXPECT_TRUE(checker.check(MapConsistencyCheckLevel::kFull));
+
+  // Untouched items are not checked again.
+  addLandmarkWithoutBackLink(vertex_ids_mission_1_[2]);
+  EXPECT_TRUE(checker.check(MapConsistencyCheckLevel::kFull));
+
+  checker.markVertexTouched(vertex_ids_mission_1_[2]);
+  EXPECT_FALSE(checker.check(MapConsistencyCheckLevel::kFull));
+  // The touched vertex is kept until a check succeeds.
+  EXPECT_FALSE(checker.check(MapConsistencyCheckLevel::kFull));
+  EXPECT_TRUE(checker.check(MapConsistencyCheckLevel::kStructuralOnly));
+
+  // The structure is always checked in full.
+  checker.reset();
+  EXPECT_FALSE(checker.check(MapConsistencyCheckLevel::kFull));
+}
+
+TEST_F(MapConsistencyCheckTest, IncrementalCheckFollowsTouchedLandmarks) {
+  IncrementalMapConsistencyChecker checker(map_);
+  EXPECT_TRUE(checker.check(MapConsistencyCheckLevel::kFull));
+
+  // Duplicate an observation of a landmark. Every observation still points to
+  // the landmark, but its observer now has a back-reference too many.
+  vi_map::Vertex& vertex = map_.getVertex(vertex_ids_mission_1_[1]);
+  vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+  ASSERT_GT(landmark_store.size(), 0);
+  vi_map::Landmark& landmark = *landmark_store.begin();
+  ASSERT_EQ(landmark.numberOfObservations(), 2u);
+  const KeypointIdentifier observation = landmark.getObservations().back();
+  ASSERT_NE(observation.frame_id.vertex_id, vertex_ids_mission_1_[1]);
+  landmark.addObservation(observation);
+  EXPECT_TRUE(checker.check(MapConsistencyCheckLevel::kFull));
+
+  // Marking the landmark is enough to also recheck its observers.
+  checker.markLandmarkTouched(landmark.id());
+  EXPECT_FALSE(checker.check(MapConsistencyCheckLevel::kFull));
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_));
+}
+
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
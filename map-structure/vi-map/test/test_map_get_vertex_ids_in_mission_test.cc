@@ -58,6 +58,31 @@ TEST_F(VIMapTest, TestGetAllVertexIdsInMissionAlongGraph) {
   }
 }
 
+TEST_F(VIMapTest, TestAlongGraphIsUpdatedWhenTopologyChanges) {
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIdsInMissionAlongGraph(missions_[0], &vertex_ids);
+  ASSERT_EQ(vertex_ids.size(), 3u);
+  pose_graph::EdgeIdList edge_ids;
+  map_.getAllEdgeIdsInMissionAlongGraph(missions_[0], &edge_ids);
+  ASSERT_EQ(edge_ids.size(), 2u);
+
+  pose_graph::EdgeIdSet incoming_edges;
+  map_.getVertex(vertices_[2]).getIncomingEdges(&incoming_edges);
+  ASSERT_EQ(incoming_edges.size(), 1u);
+  map_.removeEdge(*incoming_edges.begin());
+
+  map_.getAllVertexIdsInMissionAlongGraph(missions_[0], &vertex_ids);
+  ASSERT_EQ(vertex_ids.size(), 2u);
+  EXPECT_EQ(vertex_ids[0], vertices_[0]);
+  EXPECT_EQ(vertex_ids[1], vertices_[1]);
+  map_.getAllEdgeIdsInMissionAlongGraph(missions_[0], &edge_ids);
+  EXPECT_EQ(edge_ids.size(), 1u);
+
+  // The other mission is not affected.
+  map_.getAllVertexIdsInMissionAlongGraph(missions_[1], &vertex_ids);
+  EXPECT_EQ(vertex_ids.size(), 3u);
+}
+
 }  // namespace vi_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -28,6 +28,65 @@ TEST_F(MergeMapTest, MergeIntoEmptyMap) {
   EXPECT_TRUE(test::compareVIMap(empty_map_, second_map));
 }
 
+TEST_F(MergeMapTest, DeepCopySharesPayloadUntilModified) {
+  vi_map::VIMap copied_map;
+  copied_map.deepCopy(map_);
+  const vi_map::VIMap& original_map = map_;
+
+  pose_graph::VertexIdList vertex_ids;
+  original_map.getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  const vi_map::Vertex& original_vertex =
+      original_map.getVertex(vertex_ids.front());
+  vi_map::Vertex& copied_vertex = copied_map.getVertex(vertex_ids.front());
+  const vi_map::Vertex& const_copied_vertex = copied_vertex;
+  EXPECT_EQ(
+      original_vertex.getVisualNFrameShared(),
+      const_copied_vertex.getVisualNFrameShared());
+
+  // Mutable access copies the visual frames.
+  copied_vertex.getVisualNFrame();
+  EXPECT_NE(
+      original_vertex.getVisualNFrameShared(),
+      const_copied_vertex.getVisualNFrameShared());
+  EXPECT_TRUE(original_vertex.isSameApartFromOutgoingEdges(copied_vertex));
+
+  vi_map::LandmarkIdList landmark_ids;
+  original_map.getAllLandmarkIds(&landmark_ids);
+  ASSERT_FALSE(landmark_ids.empty());
+  const vi_map::LandmarkId& landmark_id = landmark_ids.front();
+  const Eigen::Vector3d p_B = original_map.getLandmark(landmark_id).get_p_B();
+  copied_map.getLandmark(landmark_id).set_p_B(p_B + Eigen::Vector3d::Ones());
+  EXPECT_EQ(original_map.getLandmark(landmark_id).get_p_B(), p_B);
+  EXPECT_NE(copied_map.getLandmark(landmark_id).get_p_B(), p_B);
+}
+
+TEST_F(MergeMapTest, PoseGraphCopyHasNoLandmarks) {
+  vi_map::VIMap pose_graph_copy;
+  pose_graph_copy.copyPoseGraphFrom(map_);
+  EXPECT_EQ(map_.numMissions(), pose_graph_copy.numMissions());
+  EXPECT_EQ(map_.numVertices(), pose_graph_copy.numVertices());
+  EXPECT_EQ(map_.numEdges(), pose_graph_copy.numEdges());
+  EXPECT_EQ(0u, pose_graph_copy.numLandmarks());
+
+  pose_graph::VertexIdList vertex_ids;
+  map_.getAllVertexIds(&vertex_ids);
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    const vi_map::Vertex& vertex = map_.getVertex(vertex_id);
+    const vi_map::Vertex& copied_vertex =
+        pose_graph_copy.getVertex(vertex_id);
+    EXPECT_EQ(vertex.getMissionId(), copied_vertex.getMissionId());
+    EXPECT_EQ(
+        vertex.get_T_M_I().getTransformationMatrix(),
+        copied_vertex.get_T_M_I().getTransformationMatrix());
+    EXPECT_EQ(vertex.get_v_M(), copied_vertex.get_v_M());
+    pose_graph::EdgeIdSet edge_ids, copied_edge_ids;
+    vertex.getAllEdges(&edge_ids);
+    copied_vertex.getAllEdges(&copied_edge_ids);
+    EXPECT_EQ(edge_ids, copied_edge_ids);
+  }
+}
+
 TEST_F(MergeMapTest, MergeIntoSameMap) {
   const std::string kErrorMessage =
       "NCamera with id .* is already associated with mission .*.";
@@ -56,6 +115,26 @@ TEST_F(MergeMapTest, MergeIntoNonEmpty) {
       num_landmarks_before + map_.numLandmarks(), second_map.numLandmarks());
 }
 
+TEST_F(MergeMapTest, MoveIsSameAsMerge) {
+  vi_map::VIMap merged_map;
+  test::generateMap(&merged_map);
+  vi_map::VIMap moved_map;
+  moved_map.deepCopy(merged_map);
+  merged_map.mergeAllMissionsFromMap(map_);
+
+  vi_map::VIMap map_to_move;
+  map_to_move.deepCopy(map_);
+  moved_map.reserveForMerge(
+      merged_map.numVertices(), merged_map.numEdges(),
+      merged_map.numLandmarks());
+  moved_map.moveAllMissionsFromMap(&map_to_move);
+  EXPECT_TRUE(test::compareVIMap(merged_map, moved_map));
+  EXPECT_TRUE(checkMapConsistency(moved_map));
+  EXPECT_EQ(0u, map_to_move.numMissions());
+  EXPECT_EQ(0u, map_to_move.numVertices());
+  EXPECT_EQ(0u, map_to_move.numEdges());
+}
+
 TEST_F(MergeMapTest, MergeMapWithTwoLinkedMissions) {
   vi_map::MissionIdList all_mission_ids;
   map_.getAllMissionIds(&all_mission_ids);
@@ -0,0 +1,103 @@
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+
+#include "vi-map/trajectory-edge.h"
+#include "vi-map/unique-id.h"
+
+namespace vi_map {
+namespace {
+constexpr int kNumSamples = 11;
+constexpr int64_t kSamplePeriodNs = 1000;
+constexpr double kAngularVelocityRadPerNs = 1e-4;
+}  // namespace
+
+class TrajectoryEdgeTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns(1, kNumSamples);
+    Eigen::Matrix<double, 7, Eigen::Dynamic> G_T_I_pq(7, kNumSamples);
+    for (int sample_idx = 0; sample_idx < kNumSamples; ++sample_idx) {
+      const int64_t timestamp_ns = sample_idx * kSamplePeriodNs;
+      timestamps_ns(0, sample_idx) = timestamp_ns;
+      const aslam::Transformation T_G_I = getExpectedPose(timestamp_ns);
+      const Eigen::Quaterniond& q_G_I =
+          T_G_I.getRotation().toImplementation();
+      // Store non-normalized quaternions with alternating signs.
+      const double scale = (sample_idx % 2 == 0) ? 2.0 : -0.5;
+      G_T_I_pq.col(sample_idx) << T_G_I.getPosition(), scale * q_G_I.w(),
+          scale * q_G_I.x(), scale * q_G_I.y(), scale * q_G_I.z();
+    }
+    pose_graph::EdgeId edge_id;
+    common::generateId(&edge_id);
+    pose_graph::VertexId from;
+    common::generateId(&from);
+    pose_graph::VertexId to;
+    common::generateId(&to);
+    edge_ = aligned_unique<TrajectoryEdge>(
+        edge_id, from, to, timestamps_ns, G_T_I_pq, 0u);
+  }
+
+  // Constant velocity and constant rate of turn around z.
+  static aslam::Transformation getExpectedPose(const int64_t timestamp_ns) {
+    const double time = static_cast<double>(timestamp_ns);
+    const Eigen::Quaterniond q_G_I(Eigen::AngleAxisd(
+        kAngularVelocityRadPerNs * time, Eigen::Vector3d::UnitZ()));
+    const Eigen::Vector3d p_G_I(1e-3 * time, -2e-3 * time, 1.0);
+    return aslam::Transformation(pose::Quaternion(q_G_I), p_G_I);
+  }
+
+  TrajectoryEdge::UniquePtr edge_;
+};
+
+TEST_F(TrajectoryEdgeTest, PoseAtTimeIsInterpolated) {
+  const int64_t kLastTimestampNs = (kNumSamples - 1) * kSamplePeriodNs;
+  for (int64_t timestamp_ns = 0; timestamp_ns <= kLastTimestampNs;
+       timestamp_ns += 250) {
+    aslam::Transformation T_G_I;
+    ASSERT_TRUE(edge_->getPoseAtTime(timestamp_ns, &T_G_I));
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        T_G_I, getExpectedPose(timestamp_ns), 1e-9);
+  }
+
+  aslam::Transformation T_G_I;
+  EXPECT_FALSE(edge_->getPoseAtTime(-1, &T_G_I));
+  EXPECT_FALSE(edge_->getPoseAtTime(kLastTimestampNs + 1, &T_G_I));
+}
+
+TEST_F(TrajectoryEdgeTest, ResamplingMatchesSingleQueries) {
+  Eigen::Matrix<int64_t, 1, Eigen::Dynamic> timestamps_ns(1, 6);
+  timestamps_ns << 0, 0, 1, 4500, 9999, 10000;
+  aslam::TransformationVector T_G_I;
+  ASSERT_TRUE(edge_->getPosesAtTimes(timestamps_ns, &T_G_I));
+  ASSERT_EQ(static_cast<int>(T_G_I.size()), timestamps_ns.cols());
+  for (int query_idx = 0; query_idx < timestamps_ns.cols(); ++query_idx) {
+    aslam::Transformation T_G_I_single;
+    ASSERT_TRUE(
+        edge_->getPoseAtTime(timestamps_ns(query_idx), &T_G_I_single));
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(T_G_I[query_idx], T_G_I_single, 1e-12);
+  }
+
+  timestamps_ns(5) = 10001;
+  EXPECT_FALSE(edge_->getPosesAtTimes(timestamps_ns, &T_G_I));
+  EXPECT_TRUE(T_G_I.empty());
+}
+
+TEST_F(TrajectoryEdgeTest, ConvertsAllSamples) {
+  aslam::TransformationVector T_G_I;
+  edge_->getTransformations(&T_G_I);
+  ASSERT_EQ(static_cast<int>(T_G_I.size()), kNumSamples);
+  for (int sample_idx = 0; sample_idx < kNumSamples; ++sample_idx) {
+    EXPECT_NEAR_ASLAM_TRANSFORMATION(
+        T_G_I[sample_idx], getExpectedPose(sample_idx * kSamplePeriodNs),
+        1e-12);
+  }
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
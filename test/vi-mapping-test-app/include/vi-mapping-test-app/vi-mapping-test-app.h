@@ -1,16 +1,24 @@
 #ifndef VI_MAPPING_TEST_APP_VI_MAPPING_TEST_APP_H_
 #define VI_MAPPING_TEST_APP_VI_MAPPING_TEST_APP_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/memory.h>
+#include <console-common/command-profiler.h>
 #include <maplab-common/pose_types.h>
 #include <vi-map/edge.h>
 #include <vi-map/vertex.h>
 #include <vi-map/vi-map.h>
 
+namespace common {
+class Console;
+}  // namespace common
+
 namespace visual_inertial_mapping {
 
 class VIMappingTestApp {
@@ -20,6 +28,20 @@ class VIMappingTestApp {
   typedef AlignedUnorderedMap<vi_map::LandmarkId, Eigen::Vector3d>
       LandmarkIdPositionPairs;
 
+  // A console command of the performance pipeline, the stage name identifies
+  // its baseline.
+  struct PerformanceStage {
+    std::string name;
+    std::string command;
+  };
+  struct PerformanceBaseline {
+    double wall_time_seconds;
+    int64_t peak_rss_delta_kb;
+  };
+  typedef std::unordered_map<std::string, PerformanceBaseline>
+      PerformanceBaselines;
+  typedef std::vector<common::CommandProfiler::Profile> PerformanceProfiles;
+
   VIMappingTestApp();
   virtual ~VIMappingTestApp();
 
@@ -48,6 +70,23 @@ class VIMappingTestApp {
       double min_value, double min_required_fraction) const;
   double getSpecificSwitchVariable(const pose_graph::EdgeId& edge_id) const;
 
+  // Performance mode: runs the stages on the console and profiles each of
+  // them like --console_profile_commands. Stops at the first failing stage.
+  // Afterwards, the map selected in the console is the map of the test app.
+  bool runPerformancePipeline(
+      const std::vector<PerformanceStage>& stages, common::Console* console,
+      PerformanceProfiles* profiles);
+  // Returns false if a stage took more wall time or memory than its baseline
+  // plus the relative tolerance. Stages without baseline are skipped.
+  static bool checkPerformanceAgainstBaselines(
+      const PerformanceProfiles& profiles,
+      const PerformanceBaselines& baselines, double wall_time_tolerance,
+      double memory_tolerance);
+  static bool loadPerformanceBaselines(
+      const std::string& filename, PerformanceBaselines* baselines);
+  static bool savePerformanceBaselines(
+      const PerformanceProfiles& profiles, const std::string& filename);
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
  private:
@@ -0,0 +1,141 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/string-tools.h>
+#include <maplab-console/maplab-console.h>
+
+#include "vi-mapping-test-app/vi-mapping-test-app.h"
+
+// Performance regression check of the mapping pipeline. Runs the console
+// commands of --perf_commands on a map, profiles every stage and compares the
+// wall time and the peak memory increase against the baselines:
+//   vi_mapping_performance_test --perf_map_folder=<map> --ros_free \
+//       --perf_baseline_file=baselines.yaml
+// Without --perf_map_folder, a benchmark map configured by the
+// --benchmark_map_* flags is generated instead. New baselines are written with
+// --perf_write_baseline_file.
+
+DEFINE_string(
+    perf_map_folder, "",
+    "Map the pipeline runs on. A benchmark map is generated if empty.");
+DEFINE_string(
+    perf_output_map_folder, "/tmp/vi_mapping_performance_test_map",
+    "Folder the resulting map is saved to.");
+DEFINE_string(
+    perf_commands,
+    "load --map_folder=<MAP_FOLDER>;optvi;lc;kfh;"
+    "save --map_folder=<OUTPUT_MAP_FOLDER> --overwrite",
+    "Semicolon separated console commands of the pipeline. Each stage is "
+    "named after its command.");
+DEFINE_string(
+    perf_baseline_file, "",
+    "YAML file with the baselines of the stages. Nothing is compared if "
+    "empty.");
+DEFINE_string(
+    perf_write_baseline_file, "",
+    "If set, the measurements are written to this file as new baselines.");
+DEFINE_double(
+    perf_wall_time_tolerance, 0.2,
+    "Allowed relative increase of the wall time of a stage.");
+DEFINE_double(
+    perf_memory_tolerance, 0.2,
+    "Allowed relative increase of the peak memory increase of a stage.");
+
+namespace {
+
+constexpr char kConsoleName[] = "vi-mapping-performance-test";
+constexpr char kBenchmarkMapKey[] = "benchmark_map";
+const std::string kMapFolderTemplate("<MAP_FOLDER>");
+const std::string kOutputMapFolderTemplate("<OUTPUT_MAP_FOLDER>");
+
+void replaceAll(
+    const std::string& from, const std::string& to, std::string* value) {
+  CHECK_NOTNULL(value);
+  for (size_t pos = value->find(from); pos != std::string::npos;
+       pos = value->find(from, pos + to.size())) {
+    value->replace(pos, from.size(), to);
+  }
+}
+
+void getStages(
+    std::vector<visual_inertial_mapping::VIMappingTestApp::PerformanceStage>*
+        stages) {
+  CHECK_NOTNULL(stages)->clear();
+  std::vector<std::string> commands;
+  constexpr bool kRemoveEmpty = true;
+  common::tokenizeString(FLAGS_perf_commands, ';', kRemoveEmpty, &commands);
+  std::unordered_map<std::string, size_t> num_stages_with_name;
+  for (std::string& command : commands) {
+    const size_t begin = command.find_first_not_of(' ');
+    if (begin == std::string::npos) {
+      continue;
+    }
+    command = command.substr(begin, command.find_last_not_of(' ') + 1u - begin);
+    std::string name = command.substr(0u, command.find(' '));
+    if (name == "load" && FLAGS_perf_map_folder.empty()) {
+      command = "generate_benchmark_map --map_key=" +
+                std::string(kBenchmarkMapKey);
+      name = "generate_benchmark_map";
+    }
+    replaceAll(kMapFolderTemplate, FLAGS_perf_map_folder, &command);
+    replaceAll(
+        kOutputMapFolderTemplate, FLAGS_perf_output_map_folder, &command);
+    // Repeated commands get a running number, e.g. optvi and optvi_2.
+    const size_t count = ++num_stages_with_name[name];
+    if (count > 1u) {
+      name += "_" + std::to_string(count);
+    }
+    stages->push_back({name, command});
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+
+  // Parses the flags after loading the plugins.
+  maplab::MapLabConsole console(kConsoleName, argc, argv);
+
+  std::vector<visual_inertial_mapping::VIMappingTestApp::PerformanceStage>
+      stages;
+  getStages(&stages);
+  CHECK(!stages.empty()) << "No commands in --perf_commands.";
+
+  visual_inertial_mapping::VIMappingTestApp test_app;
+  visual_inertial_mapping::VIMappingTestApp::PerformanceProfiles profiles;
+  if (!test_app.runPerformancePipeline(stages, &console, &profiles)) {
+    return 1;
+  }
+  CHECK(test_app.isMapConsistent());
+
+  if (!FLAGS_perf_write_baseline_file.empty() &&
+      !visual_inertial_mapping::VIMappingTestApp::savePerformanceBaselines(
+          profiles, FLAGS_perf_write_baseline_file)) {
+    return 1;
+  }
+  if (FLAGS_perf_baseline_file.empty()) {
+    return 0;
+  }
+  visual_inertial_mapping::VIMappingTestApp::PerformanceBaselines baselines;
+  if (!visual_inertial_mapping::VIMappingTestApp::loadPerformanceBaselines(
+          FLAGS_perf_baseline_file, &baselines)) {
+    return 1;
+  }
+  if (!visual_inertial_mapping::VIMappingTestApp::
+          checkPerformanceAgainstBaselines(
+              profiles, baselines, FLAGS_perf_wall_time_tolerance,
+              FLAGS_perf_memory_tolerance)) {
+    LOG(ERROR) << "Performance regression against " << FLAGS_perf_baseline_file
+               << '.';
+    return 1;
+  }
+  LOG(INFO) << "All stages are within the baselines.";
+  return 0;
+}
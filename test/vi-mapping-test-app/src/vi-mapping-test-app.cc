@@ -1,12 +1,20 @@
 #include "vi-mapping-test-app/vi-mapping-test-app.h"
 
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <iostream>  // NOLINT
 #include <random>
+#include <string>
+#include <vector>
 
+#include <console-common/command-registerer.h>
+#include <console-common/console.h>
 #include <gtest/gtest.h>
 #include <map-manager/map-manager.h>
 #include <maplab-common/test/testing-predicates.h>
 #include <vi-map/check-map-consistency.h>
 #include <vi-map/vi-map.h>
+#include <yaml-cpp/yaml.h>
 
 namespace visual_inertial_mapping {
 
@@ -331,4 +339,108 @@ double VIMappingTestApp::getSpecificSwitchVariable(
   return lc_edge.getSwitchVariable();
 }
 
+bool VIMappingTestApp::runPerformancePipeline(
+    const std::vector<PerformanceStage>& stages, common::Console* console,
+    PerformanceProfiles* profiles) {
+  CHECK_NOTNULL(console);
+  CHECK_NOTNULL(profiles)->clear();
+  profiles->reserve(stages.size());
+  bool success = true;
+  for (const PerformanceStage& stage : stages) {
+    LOG(INFO) << "Running stage " << stage.name << ": " << stage.command;
+    common::CommandProfiler profiler;
+    profiler.start(stage.name);
+    const int status = console->RunCommand(stage.command);
+    profiles->emplace_back();
+    profiler.stop(status, &profiles->back());
+    common::CommandProfiler::print(profiles->back(), &std::cout);
+    if (status != common::kSuccess) {
+      LOG(ERROR) << "Stage " << stage.name << " failed with status " << status
+                 << '.';
+      success = false;
+      break;
+    }
+  }
+  map_key_ = console->getSelectedMapKey();
+  return success;
+}
+
+bool VIMappingTestApp::checkPerformanceAgainstBaselines(
+    const PerformanceProfiles& profiles, const PerformanceBaselines& baselines,
+    double wall_time_tolerance, double memory_tolerance) {
+  CHECK_GE(wall_time_tolerance, 0.0);
+  CHECK_GE(memory_tolerance, 0.0);
+  // Below these, the measurements are dominated by noise.
+  constexpr double kMinComparedWallTimeSeconds = 0.1;
+  constexpr int64_t kMinComparedPeakRssDeltaKb = 10 * 1024;
+
+  bool within_baselines = true;
+  for (const common::CommandProfiler::Profile& profile : profiles) {
+    const PerformanceBaselines::const_iterator it =
+        baselines.find(profile.command);
+    if (it == baselines.end()) {
+      LOG(WARNING) << "No baseline for stage " << profile.command << '.';
+      continue;
+    }
+    const PerformanceBaseline& baseline = it->second;
+    const double max_wall_time_seconds = std::max(
+        kMinComparedWallTimeSeconds,
+        (1.0 + wall_time_tolerance) * baseline.wall_time_seconds);
+    if (profile.wall_time_seconds > max_wall_time_seconds) {
+      LOG(ERROR) << "Stage " << profile.command << " took "
+                 << profile.wall_time_seconds << " s, the baseline is "
+                 << baseline.wall_time_seconds << " s.";
+      within_baselines = false;
+    }
+    const double max_peak_rss_delta_kb = std::max<double>(
+        kMinComparedPeakRssDeltaKb,
+        (1.0 + memory_tolerance) * baseline.peak_rss_delta_kb);
+    if (profile.peak_rss_delta_kb > max_peak_rss_delta_kb) {
+      LOG(ERROR) << "Stage " << profile.command << " increased the peak RSS by "
+                 << profile.peak_rss_delta_kb << " kB, the baseline is "
+                 << baseline.peak_rss_delta_kb << " kB.";
+      within_baselines = false;
+    }
+  }
+  return within_baselines;
+}
+
+bool VIMappingTestApp::loadPerformanceBaselines(
+    const std::string& filename, PerformanceBaselines* baselines) {
+  CHECK(!filename.empty());
+  CHECK_NOTNULL(baselines)->clear();
+  try {
+    const YAML::Node node = YAML::LoadFile(filename);
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      PerformanceBaseline& baseline =
+          (*baselines)[it->first.as<std::string>()];
+      baseline.wall_time_seconds = it->second["wall_time_s"].as<double>();
+      baseline.peak_rss_delta_kb =
+          it->second["peak_rss_delta_kb"].as<int64_t>();
+    }
+  } catch (const std::exception& e) {  // NOLINT
+    LOG(ERROR) << "Failed to read the performance baselines " << filename
+               << ": " << e.what();
+    return false;
+  }
+  return true;
+}
+
+bool VIMappingTestApp::savePerformanceBaselines(
+    const PerformanceProfiles& profiles, const std::string& filename) {
+  CHECK(!filename.empty());
+  YAML::Node node;
+  for (const common::CommandProfiler::Profile& profile : profiles) {
+    node[profile.command]["wall_time_s"] = profile.wall_time_seconds;
+    node[profile.command]["peak_rss_delta_kb"] = profile.peak_rss_delta_kb;
+  }
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << filename << '.';
+    return false;
+  }
+  file << node << std::endl;
+  return file.good();
+}
+
 }  // namespace visual_inertial_mapping
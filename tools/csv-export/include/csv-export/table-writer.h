@@ -0,0 +1,106 @@
+#ifndef CSV_EXPORT_TABLE_WRITER_H_
+#define CSV_EXPORT_TABLE_WRITER_H_
+
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <maplab-common/macros.h>
+
+namespace csv_export {
+
+enum class ColumnType : uint8_t {
+  kInt64 = 0,
+  kUInt64 = 1,
+  kDouble = 2,
+  // Fixed number of bytes per row, e.g. a descriptor. The size is taken from
+  // the first row. In CSV files every byte is written as a separate integer.
+  kBytes = 3
+};
+
+struct ColumnSpec {
+  std::string name;
+  ColumnType type;
+};
+
+// Writes a table row by row into a CSV file, a columnar binary file or both.
+// The values are formatted into a buffer that is written in large chunks,
+// doubles with 15 significant digits as the CSV files written by
+// common::FileLogger.
+//
+// The binary file is laid out in the spirit of Arrow IPC streams, all values
+// in the byte order of the exporting machine:
+//   header:  char[8] "MLCOLTB1", uint32 number of columns, and for every
+//            column uint8 type, uint32 bytes per value, uint32 name length
+//            and the name.
+//   batches: uint64 number of rows, then the values of every column as a
+//            contiguous array. A batch of 0 rows terminates the file.
+// Hence only one batch of rows is kept in memory and every column of a batch
+// can be read with a single memcpy.
+class TableWriter {
+ public:
+  // Writes base_filename + ".csv" and/or base_filename + ".bin".
+  TableWriter(
+      const std::string& base_filename, const std::vector<ColumnSpec>& columns,
+      const bool write_csv, const bool write_binary);
+  ~TableWriter();
+
+  void addInt64(const int64_t value);
+  void addUInt64(const uint64_t value);
+  void addDouble(const double value);
+  // Adds one double column per coefficient, in storage order.
+  template <typename Derived>
+  void addDoubles(const Eigen::DenseBase<Derived>& values) {
+    for (int i = 0; i < values.size(); ++i) {
+      addDouble(values(i));
+    }
+  }
+  void addBytes(const unsigned char* data, const size_t num_bytes);
+  void endRow();
+
+  // Writes the remaining rows and closes the files. Called by the destructor
+  // if necessary.
+  void close();
+
+  size_t numRows() const {
+    return num_rows_;
+  }
+
+ private:
+  static constexpr size_t kCsvBufferSizeBytes = 1u << 20;
+  static constexpr size_t kRowsPerBatch = 1u << 16;
+
+  const ColumnSpec& nextColumn(const ColumnType type);
+  void appendCsvDelimiter();
+  void appendBinary(const void* data, const size_t num_bytes);
+  void flushCsv();
+  void flushBatch();
+  void writeBinaryHeader();
+
+  const std::vector<ColumnSpec> columns_;
+  const bool write_csv_;
+  const bool write_binary_;
+  bool is_open_;
+
+  std::ofstream csv_file_;
+  std::string csv_buffer_;
+
+  std::ofstream binary_file_;
+  bool binary_header_written_;
+  // Bytes per value of every column, 0 for byte columns without any rows.
+  std::vector<uint32_t> value_sizes_bytes_;
+  std::vector<std::vector<char>> column_buffers_;
+  uint64_t num_batch_rows_;
+
+  size_t next_column_;
+  size_t num_rows_;
+
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(TableWriter);
+};
+
+}  // namespace csv_export
+
+#endif  // CSV_EXPORT_TABLE_WRITER_H_
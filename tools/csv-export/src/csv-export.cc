@@ -1,17 +1,22 @@
 #include "csv-export/csv-export.h"
 
-#include <fstream>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <gflags/gflags.h>
 
 #include <descriptor-projection/descriptor-projection.h>
 #include <descriptor-projection/flags.h>
 #include <maplab-common/binary-serialization.h>
 #include <maplab-common/conversions.h>
-#include <maplab-common/file-logger.h>
 #include <maplab-common/file-system-tools.h>
-#include <maplab-common/progress-bar.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/landmark-quality-metrics.h>
 
+#include "csv-export/table-writer.h"
+
 DEFINE_bool(
     only_export_high_quality_landmarks, false,
     "If true export only "
@@ -24,66 +29,152 @@ DEFINE_bool(
     export_projected_descriptor, false,
     "If true export projected "
     "descriptor, otherwise export raw descriptor.");
+DEFINE_string(
+    csv_export_format, "csv",
+    "Format of the exported tables: csv, binary for columnar binary files, "
+    "see csv-export/table-writer.h, or both.");
 
 namespace csv_export {
 namespace {
 
-static constexpr char kDelimiter[] = ", ";
-
 typedef std::unordered_map<pose_graph::VertexId, size_t> VertexIdToIndexMap;
 
-void exportVerticesAndTracksToCsv(
+struct ExportFormat {
+  bool csv;
+  bool binary;
+};
+
+ExportFormat getExportFormatFromFlags() {
+  ExportFormat format;
+  format.csv =
+      FLAGS_csv_export_format == "csv" || FLAGS_csv_export_format == "both";
+  format.binary =
+      FLAGS_csv_export_format == "binary" || FLAGS_csv_export_format == "both";
+  CHECK(format.csv || format.binary)
+      << "Unknown export format \"" << FLAGS_csv_export_format
+      << "\", use csv, binary or both.";
+  return format;
+}
+
+// The vertex and landmark indices are global over all missions, so they are
+// assigned before the tables are written in parallel.
+struct MissionExportData {
+  vi_map::MissionId mission_id;
+  std::string base_path;
+  pose_graph::VertexIdList vertex_ids;
+  vi_map::LandmarkIdList landmark_ids;
+  size_t first_vertex_index;
+  size_t first_landmark_index;
+};
+
+enum class Table : int {
+  kVerticesAndTracks = 0,
+  kLandmarksAndObservations = 1,
+  kImu = 2,
+  kNumTables = 3
+};
+
+std::string getTableBaseFilename(
+    const MissionExportData& mission, const std::string& table_name) {
+  return common::concatenateFolderAndFileName(mission.base_path, table_name);
+}
+
+void getExportedLandmarks(
     const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-    const std::string& base_path, size_t* vertex_index,
-    VertexIdToIndexMap* vertex_id_to_index_map) {
-  CHECK_NOTNULL(vertex_index);
-  CHECK_NOTNULL(vertex_id_to_index_map);
-
-  const std::string path_vertices =
-      common::concatenateFolderAndFileName(base_path, "vertices.csv");
-  common::FileLogger logger_vertices(path_vertices);
-  logger_vertices.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "vertex index", "timestamp [ns]", "position x [m]",
-      "position y [m]", "position z [m]", "quaternion x", "quaternion y",
-      "quaternion z", "quaternion w", "velocity x [m/s]", "velocity y [m/s]",
-      "velocity z [m/s]", "acc bias x [m/s^2]", "acc bias y [m/s^2]",
-      "acc bias z [m/s^2]", "gyro bias x [rad/s]", "gyro bias y [rad/s]",
-      "gyro bias z [rad/s]");
-
-  const std::string path_tracks =
-      common::concatenateFolderAndFileName(base_path, "tracks.csv");
-  common::FileLogger logger_tracks(path_tracks);
-  logger_tracks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "timestamp [ns]", "vertex index", "frame index",
-      "keypoint index", "keypoint measurement 0 [px]",
-      "keypoint measurement 1 [px]", "keypoint measurement uncertainty",
-      "keypoint scale", "keypoint track id");
-
-  const std::string path_descriptor =
-      common::concatenateFolderAndFileName(base_path, "descriptor.csv");
-  common::FileLogger logger_descriptor(path_descriptor);
-  logger_tracks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "Descriptor byte as integer 1-N");
-
-  pose_graph::VertexIdList vertex_ids_in_mission;
-  map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids_in_mission);
-
-  common::ProgressBar progress_bar(vertex_ids_in_mission.size());
-  for (const pose_graph::VertexId& vertex_id : vertex_ids_in_mission) {
+    vi_map::LandmarkIdList* landmark_ids) {
+  CHECK_NOTNULL(landmark_ids)->clear();
+  vi_map::LandmarkIdList all_landmarks_in_mission;
+  map.getAllLandmarkIdsInMission(mission_id, &all_landmarks_in_mission);
+  if (!FLAGS_only_export_high_quality_landmarks) {
+    for (const vi_map::LandmarkId& landmark_id : all_landmarks_in_mission) {
+      if (landmark_id.isValid()) {
+        landmark_ids->push_back(landmark_id);
+      }
+    }
+    return;
+  }
+
+  // Evaluating the quality is the expensive part, the order of the landmarks
+  // is kept.
+  std::vector<char> is_exported(all_landmarks_in_mission.size(), false);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      all_landmarks_in_mission.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t idx : range) {
+          const vi_map::LandmarkId& landmark_id = all_landmarks_in_mission[idx];
+          is_exported[idx] =
+              landmark_id.isValid() &&
+              vi_map::isLandmarkWellConstrained(
+                  map, map.getLandmark(landmark_id));
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
+  for (size_t idx = 0u; idx < all_landmarks_in_mission.size(); ++idx) {
+    if (is_exported[idx]) {
+      landmark_ids->push_back(all_landmarks_in_mission[idx]);
+    }
+  }
+}
+
+void exportVerticesAndTracksToCsv(
+    const vi_map::VIMap& map, const MissionExportData& mission,
+    const ExportFormat& format) {
+  TableWriter vertices_writer(
+      getTableBaseFilename(mission, "vertices"),
+      {{"vertex index", ColumnType::kUInt64},
+       {"timestamp [ns]", ColumnType::kInt64},
+       {"position x [m]", ColumnType::kDouble},
+       {"position y [m]", ColumnType::kDouble},
+       {"position z [m]", ColumnType::kDouble},
+       {"quaternion x", ColumnType::kDouble},
+       {"quaternion y", ColumnType::kDouble},
+       {"quaternion z", ColumnType::kDouble},
+       {"quaternion w", ColumnType::kDouble},
+       {"velocity x [m/s]", ColumnType::kDouble},
+       {"velocity y [m/s]", ColumnType::kDouble},
+       {"velocity z [m/s]", ColumnType::kDouble},
+       {"acc bias x [m/s^2]", ColumnType::kDouble},
+       {"acc bias y [m/s^2]", ColumnType::kDouble},
+       {"acc bias z [m/s^2]", ColumnType::kDouble},
+       {"gyro bias x [rad/s]", ColumnType::kDouble},
+       {"gyro bias y [rad/s]", ColumnType::kDouble},
+       {"gyro bias z [rad/s]", ColumnType::kDouble}},
+      format.csv, format.binary);
+
+  TableWriter tracks_writer(
+      getTableBaseFilename(mission, "tracks"),
+      {{"timestamp [ns]", ColumnType::kInt64},
+       {"vertex index", ColumnType::kUInt64},
+       {"frame index", ColumnType::kUInt64},
+       {"keypoint index", ColumnType::kUInt64},
+       {"keypoint measurement 0 [px]", ColumnType::kDouble},
+       {"keypoint measurement 1 [px]", ColumnType::kDouble},
+       {"keypoint measurement uncertainty", ColumnType::kDouble},
+       {"keypoint scale", ColumnType::kDouble},
+       {"keypoint track id", ColumnType::kInt64}},
+      format.csv, format.binary);
+
+  TableWriter descriptor_writer(
+      getTableBaseFilename(mission, "descriptor"),
+      {{"Descriptor byte as integer 1-N", ColumnType::kBytes}}, format.csv,
+      format.binary);
+
+  size_t vertex_index = mission.first_vertex_index;
+  for (const pose_graph::VertexId& vertex_id : mission.vertex_ids) {
     const vi_map::Vertex& vertex = map.getVertex(vertex_id);
 
     // Write vertex data itself.
     const aslam::Transformation T_G_I = map.getVertex_T_G_I(vertex_id);
-    const Eigen::Vector3d& v_M = vertex.get_v_M();
-    const Eigen::Vector3d& acc_bias = vertex.getAccelBias();
-    const Eigen::Vector3d& gyro_bias = vertex.getGyroBias();
-
-    logger_vertices.writeDataWithDelimiterAndNewLine(
-        kDelimiter, *vertex_index, vertex.getMinTimestampNanoseconds(),
-        T_G_I.getPosition(), T_G_I.getEigenQuaternion(), v_M, acc_bias,
-        gyro_bias);
-
-    vertex_id_to_index_map->emplace(vertex_id, *vertex_index);
+    vertices_writer.addUInt64(vertex_index);
+    vertices_writer.addInt64(vertex.getMinTimestampNanoseconds());
+    vertices_writer.addDoubles(T_G_I.getPosition());
+    // The coefficients are stored as x, y, z, w.
+    vertices_writer.addDoubles(T_G_I.getEigenQuaternion().coeffs());
+    vertices_writer.addDoubles(vertex.get_v_M());
+    vertices_writer.addDoubles(vertex.getAccelBias());
+    vertices_writer.addDoubles(vertex.getGyroBias());
+    vertices_writer.endRow();
 
     // Frame data.
     vertex.forEachFrame(
@@ -101,71 +192,55 @@ void exportVerticesAndTracksToCsv(
           const Eigen::VectorXi& track_ids = frame.getTrackIds();
           for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
                ++keypoint_idx) {
-            logger_tracks.writeDataWithDelimiterAndNewLine(
-                kDelimiter, timestamp_ns, *vertex_index, frame_index,
-                keypoint_idx, keypoint_measurements(0, keypoint_idx),
-                keypoint_measurements(1, keypoint_idx),
-                keypoint_measurment_uncertainties(keypoint_idx),
-                keypoint_scales(keypoint_idx), track_ids(keypoint_idx));
-
-            const unsigned char* descriptor =
-                CHECK_NOTNULL(frame.getDescriptor(keypoint_idx));
-            for (size_t descriptor_idx = 0u;
-                 descriptor_idx < num_bytes_per_descriptor; ++descriptor_idx) {
-              if (descriptor_idx != 0u) {
-                logger_descriptor << kDelimiter;
-              }
-              logger_descriptor
-                  << static_cast<size_t>(descriptor[descriptor_idx]);
-            }
-            logger_descriptor << std::endl;
+            tracks_writer.addInt64(timestamp_ns);
+            tracks_writer.addUInt64(vertex_index);
+            tracks_writer.addUInt64(frame_index);
+            tracks_writer.addUInt64(keypoint_idx);
+            tracks_writer.addDouble(keypoint_measurements(0, keypoint_idx));
+            tracks_writer.addDouble(keypoint_measurements(1, keypoint_idx));
+            tracks_writer.addDouble(
+                keypoint_measurment_uncertainties(keypoint_idx));
+            tracks_writer.addDouble(keypoint_scales(keypoint_idx));
+            tracks_writer.addInt64(track_ids(keypoint_idx));
+            tracks_writer.endRow();
+
+            descriptor_writer.addBytes(
+                CHECK_NOTNULL(frame.getDescriptor(keypoint_idx)),
+                num_bytes_per_descriptor);
+            descriptor_writer.endRow();
           }
         });
 
-    ++(*vertex_index);
-    progress_bar.increment();
+    ++vertex_index;
   }
 }
 
 void exportLandmarksAndObservationsToCsv(
-    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-    const std::string& base_path,
-    const VertexIdToIndexMap& vertex_id_to_index_map, size_t* landmark_index) {
-  CHECK_NOTNULL(landmark_index);
-
-  const std::string path_landmarks =
-      common::concatenateFolderAndFileName(base_path, "landmarks.csv");
-  common::FileLogger logger_landmarks(path_landmarks);
-  logger_landmarks.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "landmark index", "landmark position x [m]",
-      "landmark position y [m]", "landmark position z [m]");
-
-  const std::string path_observations =
-      common::concatenateFolderAndFileName(base_path, "observations.csv");
-  common::FileLogger logger_observations(path_observations);
-  logger_observations.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "vertex index", "frame index", "keypoint index",
-      "landmark index");
-
-  vi_map::LandmarkIdList all_landmarks_in_mission;
-  map.getAllLandmarkIdsInMission(mission_id, &all_landmarks_in_mission);
-  for (const vi_map::LandmarkId& landmark_id : all_landmarks_in_mission) {
-    if (!landmark_id.isValid()) {
-      continue;
-    }
-    if (FLAGS_only_export_high_quality_landmarks) {
-      if (!vi_map::isLandmarkWellConstrained(
-              map, map.getLandmark(landmark_id))) {
-        continue;
-      }
-    }
-
+    const vi_map::VIMap& map, const MissionExportData& mission,
+    const VertexIdToIndexMap& vertex_id_to_index_map,
+    const ExportFormat& format) {
+  TableWriter landmarks_writer(
+      getTableBaseFilename(mission, "landmarks"),
+      {{"landmark index", ColumnType::kUInt64},
+       {"landmark position x [m]", ColumnType::kDouble},
+       {"landmark position y [m]", ColumnType::kDouble},
+       {"landmark position z [m]", ColumnType::kDouble}},
+      format.csv, format.binary);
+
+  TableWriter observations_writer(
+      getTableBaseFilename(mission, "observations"),
+      {{"vertex index", ColumnType::kUInt64},
+       {"frame index", ColumnType::kUInt64},
+       {"keypoint index", ColumnType::kUInt64},
+       {"landmark index", ColumnType::kUInt64}},
+      format.csv, format.binary);
+
+  size_t landmark_index = mission.first_landmark_index;
+  for (const vi_map::LandmarkId& landmark_id : mission.landmark_ids) {
     const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-    const Eigen::Vector3d landmark_position =
-        map.getLandmark_G_p_fi(landmark_id);
-
-    logger_landmarks.writeDataWithDelimiterAndNewLine(
-        kDelimiter, *landmark_index, landmark_position);
+    landmarks_writer.addUInt64(landmark_index);
+    landmarks_writer.addDoubles(map.getLandmark_G_p_fi(landmark_id));
+    landmarks_writer.endRow();
 
     // Write observations.
     const vi_map::KeypointIdentifierList& keypoint_identifier_list =
@@ -177,27 +252,33 @@ void exportLandmarksAndObservationsToCsv(
       const VertexIdToIndexMap::const_iterator it_vertex_id_to_index =
           vertex_id_to_index_map.find(vertex_id);
       CHECK(it_vertex_id_to_index != vertex_id_to_index_map.end());
-      logger_observations.writeDataWithDelimiterAndNewLine(
-          kDelimiter, it_vertex_id_to_index->second,
-          keypoint_identifier.frame_id.frame_index,
-          keypoint_identifier.keypoint_index, *landmark_index);
+      observations_writer.addUInt64(it_vertex_id_to_index->second);
+      observations_writer.addUInt64(keypoint_identifier.frame_id.frame_index);
+      observations_writer.addUInt64(keypoint_identifier.keypoint_index);
+      observations_writer.addUInt64(landmark_index);
+      observations_writer.endRow();
     }
 
-    ++(*landmark_index);
+    ++landmark_index;
   }
 }
 
 void exportImuDataToCsv(
-    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
-    const std::string& base_path) {
-  const std::string path_imu =
-      common::concatenateFolderAndFileName(base_path, "imu.csv");
-  common::FileLogger logger_imu(path_imu);
-  logger_imu.writeDataWithDelimiterAndNewLine(
-      kDelimiter, "timestamp [ns]", "acc x [m/s^2]", "acc y [m/s^2]",
-      "acc z [m/s^2]", "gyro x [rad/s]", "gyro y [rad/s]", "gyro z [rad/s]");
+    const vi_map::VIMap& map, const MissionExportData& mission,
+    const ExportFormat& format) {
+  TableWriter imu_writer(
+      getTableBaseFilename(mission, "imu"),
+      {{"timestamp [ns]", ColumnType::kInt64},
+       {"acc x [m/s^2]", ColumnType::kDouble},
+       {"acc y [m/s^2]", ColumnType::kDouble},
+       {"acc z [m/s^2]", ColumnType::kDouble},
+       {"gyro x [rad/s]", ColumnType::kDouble},
+       {"gyro y [rad/s]", ColumnType::kDouble},
+       {"gyro z [rad/s]", ColumnType::kDouble}},
+      format.csv, format.binary);
   pose_graph::EdgeIdList all_edges_in_mission;
-  map.getAllEdgeIdsInMissionAlongGraph(mission_id, &all_edges_in_mission);
+  map.getAllEdgeIdsInMissionAlongGraph(
+      mission.mission_id, &all_edges_in_mission);
   for (const pose_graph::EdgeId& edge_id : all_edges_in_mission) {
     if (map.getEdgeType(edge_id) == vi_map::Edge::EdgeType::kViwls) {
       const vi_map::ViwlsEdge& viwls_edge =
@@ -210,8 +291,9 @@ void exportImuDataToCsv(
       const int num_measurements = imu_timestamps.cols();
       CHECK_EQ(num_measurements, imu_data.cols());
       for (int i = 0; i < num_measurements; ++i) {
-        logger_imu.writeDataWithDelimiterAndNewLine(
-            kDelimiter, imu_timestamps(i), imu_data.col(i));
+        imu_writer.addInt64(imu_timestamps(i));
+        imu_writer.addDoubles(imu_data.col(i));
+        imu_writer.endRow();
       }
     }
   }
@@ -222,31 +304,67 @@ void exportImuDataToCsv(
 void exportMapToCsv(const vi_map::VIMap& map, const std::string& base_path) {
   CHECK(!base_path.empty());
   CHECK(common::createPath(base_path));
+  const ExportFormat format = getExportFormatFromFlags();
 
   vi_map::MissionIdList all_mission_ids;
   map.getAllMissionIds(&all_mission_ids);
 
+  std::vector<MissionExportData> missions(all_mission_ids.size());
   VertexIdToIndexMap vertex_id_to_index_map;
   size_t vertex_index = 0u;
   size_t landmark_index = 0u;
+  for (size_t mission_idx = 0u; mission_idx < all_mission_ids.size();
+       ++mission_idx) {
+    MissionExportData& mission = missions[mission_idx];
+    mission.mission_id = all_mission_ids[mission_idx];
+    mission.base_path = common::concatenateFolderAndFileName(
+        base_path, mission.mission_id.hexString());
+    CHECK(common::createPath(mission.base_path));
+
+    map.getAllVertexIdsInMissionAlongGraph(
+        mission.mission_id, &mission.vertex_ids);
+    mission.first_vertex_index = vertex_index;
+    for (const pose_graph::VertexId& vertex_id : mission.vertex_ids) {
+      vertex_id_to_index_map.emplace(vertex_id, vertex_index);
+      ++vertex_index;
+    }
 
-  for (const vi_map::MissionId& mission_id : all_mission_ids) {
-    const std::string base_path_for_mission =
-        common::concatenateFolderAndFileName(base_path, mission_id.hexString());
-    CHECK(common::createPath(base_path_for_mission));
-
-    LOG(INFO) << "Exporting data from mission " << mission_id << ".";
-
-    exportVerticesAndTracksToCsv(
-        map, mission_id, base_path_for_mission, &vertex_index,
-        &vertex_id_to_index_map);
+    getExportedLandmarks(map, mission.mission_id, &mission.landmark_ids);
+    mission.first_landmark_index = landmark_index;
+    landmark_index += mission.landmark_ids.size();
+  }
 
-    exportLandmarksAndObservationsToCsv(
-        map, mission_id, base_path_for_mission, vertex_id_to_index_map,
-        &landmark_index);
+  // Every table of every mission goes into its own files, so they are all
+  // written in parallel.
+  constexpr size_t kNumTables = static_cast<size_t>(Table::kNumTables);
+  const size_t num_tasks = kNumTables * missions.size();
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_tasks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t task_idx : range) {
+          const MissionExportData& mission = missions[task_idx / kNumTables];
+          switch (static_cast<Table>(task_idx % kNumTables)) {
+            case Table::kVerticesAndTracks:
+              exportVerticesAndTracksToCsv(map, mission, format);
+              break;
+            case Table::kLandmarksAndObservations:
+              exportLandmarksAndObservationsToCsv(
+                  map, mission, vertex_id_to_index_map, format);
+              break;
+            case Table::kImu:
+              exportImuDataToCsv(map, mission, format);
+              break;
+            default:
+              LOG(FATAL) << "Unknown table.";
+          }
+        }
+      },
+      kAlwaysParallelize, common::getNumHardwareThreads());
 
-    exportImuDataToCsv(map, mission_id, base_path_for_mission);
-  }
+  LOG(INFO) << "Exported " << vertex_index << " vertices and "
+            << landmark_index << " landmarks of " << missions.size()
+            << " missions to " << base_path << '.';
 }
 
 }  // namespace csv_export
@@ -0,0 +1,290 @@
+#include "csv-export/table-writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace csv_export {
+namespace {
+
+constexpr char kCsvDelimiter[] = ", ";
+constexpr char kBinaryMagic[] = "MLCOLTB1";
+
+// Faster than going through iostreams, which is what dominates the export
+// time of large maps.
+void appendUInt64(uint64_t value, std::string* buffer) {
+  CHECK_NOTNULL(buffer);
+  constexpr int kMaxNumDigits = 20;
+  char digits[kMaxNumDigits];
+  int first_digit = kMaxNumDigits;
+  do {
+    digits[--first_digit] = static_cast<char>('0' + value % 10u);
+    value /= 10u;
+  } while (value != 0u);
+  buffer->append(digits + first_digit, kMaxNumDigits - first_digit);
+}
+
+void appendInt64(const int64_t value, std::string* buffer) {
+  CHECK_NOTNULL(buffer);
+  if (value < 0) {
+    buffer->push_back('-');
+    // Negate in unsigned arithmetic, so the smallest int64 doesn't overflow.
+    appendUInt64(0u - static_cast<uint64_t>(value), buffer);
+  } else {
+    appendUInt64(static_cast<uint64_t>(value), buffer);
+  }
+}
+
+void appendDouble(const double value, std::string* buffer) {
+  CHECK_NOTNULL(buffer);
+  // Same format as an ostream with a precision of digits10.
+  char formatted[32];
+  const int num_chars =
+      std::snprintf(formatted, sizeof(formatted), "%.15g", value);
+  CHECK_GT(num_chars, 0);
+  CHECK_LT(static_cast<size_t>(num_chars), sizeof(formatted));
+  buffer->append(formatted, num_chars);
+}
+
+uint32_t getValueSizeBytes(const ColumnType type) {
+  switch (type) {
+    case ColumnType::kInt64:
+      return sizeof(int64_t);
+    case ColumnType::kUInt64:
+      return sizeof(uint64_t);
+    case ColumnType::kDouble:
+      return sizeof(double);
+    case ColumnType::kBytes:
+      // Only known after the first row.
+      return 0u;
+  }
+  LOG(FATAL) << "Unknown column type " << static_cast<int>(type) << '.';
+  return 0u;
+}
+
+template <typename ValueType>
+void writeBinaryValue(const ValueType& value, std::ofstream* file) {
+  CHECK_NOTNULL(file)->write(
+      reinterpret_cast<const char*>(&value), sizeof(ValueType));
+}
+
+}  // namespace
+
+constexpr size_t TableWriter::kCsvBufferSizeBytes;
+constexpr size_t TableWriter::kRowsPerBatch;
+
+TableWriter::TableWriter(
+    const std::string& base_filename, const std::vector<ColumnSpec>& columns,
+    const bool write_csv, const bool write_binary)
+    : columns_(columns),
+      write_csv_(write_csv),
+      write_binary_(write_binary),
+      is_open_(true),
+      binary_header_written_(false),
+      num_batch_rows_(0u),
+      next_column_(0u),
+      num_rows_(0u) {
+  CHECK(!base_filename.empty());
+  CHECK(!columns_.empty());
+  CHECK(write_csv_ || write_binary_);
+
+  if (write_csv_) {
+    const std::string filename = base_filename + ".csv";
+    csv_file_.open(filename, std::ofstream::out | std::ofstream::trunc);
+    CHECK(csv_file_.is_open()) << "Could not open " << filename << '.';
+    csv_buffer_.reserve(kCsvBufferSizeBytes + (1u << 12));
+    for (size_t column_idx = 0u; column_idx < columns_.size(); ++column_idx) {
+      if (column_idx != 0u) {
+        csv_buffer_ += kCsvDelimiter;
+      }
+      csv_buffer_ += columns_[column_idx].name;
+    }
+    csv_buffer_ += '\n';
+  }
+
+  if (write_binary_) {
+    const std::string filename = base_filename + ".bin";
+    binary_file_.open(
+        filename,
+        std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    CHECK(binary_file_.is_open()) << "Could not open " << filename << '.';
+    value_sizes_bytes_.reserve(columns_.size());
+    for (const ColumnSpec& column : columns_) {
+      value_sizes_bytes_.push_back(getValueSizeBytes(column.type));
+    }
+    column_buffers_.resize(columns_.size());
+  }
+}
+
+TableWriter::~TableWriter() {
+  if (is_open_) {
+    close();
+  }
+}
+
+const ColumnSpec& TableWriter::nextColumn(const ColumnType type) {
+  CHECK(is_open_);
+  CHECK_LT(next_column_, columns_.size()) << "Too many values in row.";
+  const ColumnSpec& column = columns_[next_column_];
+  CHECK(column.type == type)
+      << "Wrong value type for column \"" << column.name << "\".";
+  return column;
+}
+
+void TableWriter::appendCsvDelimiter() {
+  if (next_column_ != 0u) {
+    csv_buffer_ += kCsvDelimiter;
+  }
+}
+
+void TableWriter::appendBinary(const void* data, const size_t num_bytes) {
+  std::vector<char>& column_buffer = column_buffers_[next_column_];
+  const char* bytes = static_cast<const char*>(data);
+  column_buffer.insert(column_buffer.end(), bytes, bytes + num_bytes);
+}
+
+void TableWriter::addInt64(const int64_t value) {
+  nextColumn(ColumnType::kInt64);
+  if (write_csv_) {
+    appendCsvDelimiter();
+    appendInt64(value, &csv_buffer_);
+  }
+  if (write_binary_) {
+    appendBinary(&value, sizeof(value));
+  }
+  ++next_column_;
+}
+
+void TableWriter::addUInt64(const uint64_t value) {
+  nextColumn(ColumnType::kUInt64);
+  if (write_csv_) {
+    appendCsvDelimiter();
+    appendUInt64(value, &csv_buffer_);
+  }
+  if (write_binary_) {
+    appendBinary(&value, sizeof(value));
+  }
+  ++next_column_;
+}
+
+void TableWriter::addDouble(const double value) {
+  nextColumn(ColumnType::kDouble);
+  if (write_csv_) {
+    appendCsvDelimiter();
+    appendDouble(value, &csv_buffer_);
+  }
+  if (write_binary_) {
+    appendBinary(&value, sizeof(value));
+  }
+  ++next_column_;
+}
+
+void TableWriter::addBytes(const unsigned char* data, const size_t num_bytes) {
+  CHECK_NOTNULL(data);
+  const ColumnSpec& column = nextColumn(ColumnType::kBytes);
+  if (write_csv_) {
+    for (size_t byte_idx = 0u; byte_idx < num_bytes; ++byte_idx) {
+      if (byte_idx != 0u || next_column_ != 0u) {
+        csv_buffer_ += kCsvDelimiter;
+      }
+      appendUInt64(data[byte_idx], &csv_buffer_);
+    }
+  }
+  if (write_binary_) {
+    uint32_t& value_size_bytes = value_sizes_bytes_[next_column_];
+    if (value_size_bytes == 0u) {
+      CHECK_GT(num_bytes, 0u);
+      CHECK(!binary_header_written_);
+      value_size_bytes = static_cast<uint32_t>(num_bytes);
+    }
+    CHECK_EQ(num_bytes, value_size_bytes)
+        << "The binary format requires the same number of bytes in every row "
+        << "of column \"" << column.name << "\".";
+    appendBinary(data, num_bytes);
+  }
+  ++next_column_;
+}
+
+void TableWriter::endRow() {
+  CHECK(is_open_);
+  CHECK_EQ(next_column_, columns_.size()) << "Too few values in row.";
+  next_column_ = 0u;
+  ++num_rows_;
+
+  if (write_csv_) {
+    csv_buffer_ += '\n';
+    if (csv_buffer_.size() >= kCsvBufferSizeBytes) {
+      flushCsv();
+    }
+  }
+  if (write_binary_) {
+    ++num_batch_rows_;
+    if (num_batch_rows_ >= kRowsPerBatch) {
+      flushBatch();
+    }
+  }
+}
+
+void TableWriter::flushCsv() {
+  csv_file_.write(csv_buffer_.data(), csv_buffer_.size());
+  CHECK(csv_file_.good()) << "Writing the CSV file failed.";
+  csv_buffer_.clear();
+}
+
+void TableWriter::writeBinaryHeader() {
+  CHECK(!binary_header_written_);
+  binary_file_.write(kBinaryMagic, std::strlen(kBinaryMagic));
+  writeBinaryValue(static_cast<uint32_t>(columns_.size()), &binary_file_);
+  for (size_t column_idx = 0u; column_idx < columns_.size(); ++column_idx) {
+    const ColumnSpec& column = columns_[column_idx];
+    writeBinaryValue(static_cast<uint8_t>(column.type), &binary_file_);
+    writeBinaryValue(value_sizes_bytes_[column_idx], &binary_file_);
+    writeBinaryValue(static_cast<uint32_t>(column.name.size()), &binary_file_);
+    binary_file_.write(column.name.data(), column.name.size());
+  }
+  binary_header_written_ = true;
+}
+
+void TableWriter::flushBatch() {
+  if (!binary_header_written_) {
+    writeBinaryHeader();
+  }
+  writeBinaryValue(num_batch_rows_, &binary_file_);
+  for (size_t column_idx = 0u; column_idx < columns_.size(); ++column_idx) {
+    std::vector<char>& column_buffer = column_buffers_[column_idx];
+    CHECK_EQ(
+        column_buffer.size(), num_batch_rows_ * value_sizes_bytes_[column_idx]);
+    binary_file_.write(column_buffer.data(), column_buffer.size());
+    // Keeps the capacity for the next batch.
+    column_buffer.clear();
+  }
+  CHECK(binary_file_.good()) << "Writing the binary file failed.";
+  num_batch_rows_ = 0u;
+}
+
+void TableWriter::close() {
+  CHECK(is_open_);
+  CHECK_EQ(next_column_, 0u) << "Unfinished row.";
+  if (write_csv_) {
+    flushCsv();
+    csv_file_.close();
+  }
+  if (write_binary_) {
+    if (num_batch_rows_ > 0u) {
+      flushBatch();
+    }
+    if (!binary_header_written_) {
+      writeBinaryHeader();
+    }
+    // Terminating empty batch.
+    writeBinaryValue(static_cast<uint64_t>(0u), &binary_file_);
+    CHECK(binary_file_.good()) << "Writing the binary file failed.";
+    binary_file_.close();
+  }
+  is_open_ = false;
+}
+
+}  // namespace csv_export
@@ -60,6 +60,15 @@ void publishVerticesFromPoseVector(
     const PoseVector& poses, const std::string& frame,
     const std::string& name_space, const std::string& topic);
 
+// Publishes every chunk of poses as a single line list marker of axes, which
+// is far cheaper for RViz than one marker per pose. The scale, line width,
+// alpha and color of a chunk are taken from its first pose. Empty chunks
+// delete their marker.
+void publishPoseChunks(
+    const std::vector<PoseVector>& pose_chunks,
+    const std::vector<size_t>& marker_ids, const std::string& frame,
+    const std::string& name_space, const std::string& topic);
+
 void publish3DPointsAsPointCloud(
     const Eigen::Matrix3Xd& points, const visualization::Color& color,
     double alpha, const std::string& frame, const std::string& topic);
@@ -0,0 +1,60 @@
+#ifndef VISUALIZATION_MARKER_CHANGE_TRACKER_H_
+#define VISUALIZATION_MARKER_CHANGE_TRACKER_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <Eigen/Core>
+
+namespace visualization {
+
+// Remembers the coefficients, e.g. the points and colors, of the markers that
+// were last published per topic, so that incremental updates only need to
+// republish the markers that changed. Thread-safe.
+class MarkerChangeTracker {
+ public:
+  MarkerChangeTracker() = default;
+  // Copies the tracked markers, the mutex isn't shared.
+  MarkerChangeTracker(const MarkerChangeTracker& other);
+  MarkerChangeTracker& operator=(const MarkerChangeTracker& other);
+
+  // Returns true and remembers the coefficients if the marker wasn't tracked
+  // yet, if the number of coefficients changed or if any coefficient changed
+  // by more than the tolerance.
+  bool update(
+      const std::string& topic, const size_t marker_id,
+      const Eigen::MatrixXd& coefficients, const double tolerance);
+
+  // Unconditionally remembers the coefficients.
+  void set(
+      const std::string& topic, const size_t marker_id,
+      const Eigen::MatrixXd& coefficients);
+
+  bool isTracked(const std::string& topic, const size_t marker_id) const;
+  void remove(const std::string& topic, const size_t marker_id);
+  void clear();
+
+  size_t size() const;
+
+ private:
+  typedef std::pair<std::string, size_t> MarkerKey;
+  struct MarkerKeyHash {
+    size_t operator()(const MarkerKey& key) const {
+      return std::hash<std::string>()(key.first) ^
+             (std::hash<size_t>()(key.second) << 1u);
+    }
+  };
+
+  typedef std::unordered_map<MarkerKey, Eigen::MatrixXd, MarkerKeyHash>
+      MarkerCoefficientsMap;
+
+  mutable std::mutex mutex_;
+  MarkerCoefficientsMap published_coefficients_;
+};
+
+}  // namespace visualization
+
+#endif  // VISUALIZATION_MARKER_CHANGE_TRACKER_H_
@@ -40,6 +40,16 @@ void getImagePatchesForLandmark(
     bool draw_center_circle, const vi_map::VIMap& map,
     std::vector<cv::Mat>* patches);
 
+// Extracts the patches of all observations of the given landmarks, where
+// (*patches)[i] holds the patches of landmark_ids[i] in the order of its
+// observations. The observations are grouped by frame, such that every image
+// is prefetched, loaded and converted only once, and the frames are processed
+// in parallel.
+void getImagePatchesForLandmarks(
+    const vi_map::LandmarkIdList& landmark_ids, int half_patch_size_pixels,
+    bool draw_bounding_boxes, bool draw_center_circle,
+    const vi_map::VIMap& map, std::vector<std::vector<cv::Mat>>* patches);
+
 void getImagePatchesForLandmark(
     const vi_map::LandmarkId& landmark_id,
     int half_patch_size_pixels, bool draw_bounding_boxes,
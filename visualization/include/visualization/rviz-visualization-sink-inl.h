@@ -14,6 +14,18 @@ template <typename T>
 void RVizVisualizationSink::publishImpl(
     const std::string& topic, const T& message) {
   CHECK(!topic.empty());
+  if (!publish_asynchronously_) {
+    publishSync<T>(topic, message);
+    return;
+  }
+  // The copy of the message is owned by the send function.
+  enqueue(topic, [this, topic, message]() { publishSync<T>(topic, message); });
+}
+
+template <typename T>
+void RVizVisualizationSink::publishSync(
+    const std::string& topic, const T& message) {
+  CHECK(!topic.empty());
 
   std::unique_lock<std::mutex> lock(mutex_);
 
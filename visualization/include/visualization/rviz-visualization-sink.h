@@ -1,15 +1,20 @@
 #ifndef VISUALIZATION_RVIZ_VISUALIZATION_SINK_H_
 #define VISUALIZATION_RVIZ_VISUALIZATION_SINK_H_
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include <glog/logging.h>
 #include <image_transport/image_transport.h>
 #include <opencv2/core/core.hpp>
 #include <ros/ros.h>
+#include <sensor_msgs/Image.h>
 
 namespace visualization {
 
@@ -24,6 +29,12 @@ namespace visualization {
 //         my_image);
 //         visualization_msgs::Marker marker
 //         visualization::RVizVisualizationSink::publish("topic", marker)
+//
+// With --rviz_publish_asynchronously, publish() only copies the message into
+// a queue and a sender thread serializes and sends it, so visualization
+// doesn't block the calling thread. Every topic queues at most
+// --rviz_max_queued_messages_per_topic messages, beyond that its oldest
+// message is dropped.
 class RVizVisualizationSink {
  public:
   explicit RVizVisualizationSink(const RVizVisualizationSink&) = delete;
@@ -38,6 +49,12 @@ class RVizVisualizationSink {
     RVizVisualizationSink::getInstance().publishImpl<T>(topic, message);
   }
 
+  // Blocks until all queued messages are sent. Returns immediately if the
+  // publishing is synchronous.
+  static inline void flush() {
+    RVizVisualizationSink::getInstance().flushImpl();
+  }
+
   // Singleton instance
   static inline RVizVisualizationSink& getInstance() {
     static RVizVisualizationSink instance;
@@ -46,13 +63,23 @@ class RVizVisualizationSink {
 
  private:
   RVizVisualizationSink();
-  ~RVizVisualizationSink() = default;
+  ~RVizVisualizationSink();
 
   template <typename T>
   inline void publishImpl(const std::string& topic, const T& message);
+  // Sends the message on the calling thread.
+  template <typename T>
+  inline void publishSync(const std::string& topic, const T& message);
+
+  void publishImageSync(
+      const std::string& topic, const sensor_msgs::Image& msg);
 
   void initImpl();
 
+  void enqueue(const std::string& topic, std::function<void()>&& send);
+  void senderLoop();
+  void flushImpl();
+
   std::unique_ptr<ros::NodeHandle> node_handle_;
   std::unique_ptr<image_transport::ImageTransport> image_transport_;
 
@@ -76,6 +103,22 @@ class RVizVisualizationSink {
   const bool should_wait_for_subscribers_;
 
   std::mutex mutex_;
+
+  // Asynchronous publishing. Every topic has its own queue of send functions,
+  // the topics with queued messages are served round robin.
+  const bool publish_asynchronously_;
+  const size_t max_queued_messages_per_topic_;
+  typedef std::unordered_map<std::string, std::deque<std::function<void()>>>
+      TopicToMessageQueueMap;
+  TopicToMessageQueueMap queued_messages_;
+  std::deque<std::string> topics_with_queued_messages_;
+  bool is_sending_;
+  bool shutdown_requested_;
+  size_t num_dropped_messages_;
+  std::mutex queue_mutex_;
+  std::condition_variable queue_condition_;
+  std::condition_variable queue_empty_condition_;
+  std::thread sender_thread_;
 };
 
 template <>
@@ -12,6 +12,7 @@
 #include <vi-map/vi-map.h>
 
 #include "visualization/common-rviz-visualization.h"
+#include "visualization/marker-change-tracker.h"
 #include "visualization/viz-primitives.h"
 
 namespace visualization {
@@ -33,6 +34,16 @@ class ViwlsGraphRvizPlotter {
       bool publish_baseframes, bool publish_vertices, bool publish_edges,
       bool publish_landmarks) const;
 
+  // Incremental version of visualizeMap for repeated plots of the same map,
+  // e.g. from the callbacks of an optimization. Only the vertex chunks, edges
+  // and landmarks that changed since they were last published are published.
+  void visualizeMapUpdate(const vi_map::VIMap& map) const;
+
+  // The vertices and landmarks of the maps are decimated with their distance
+  // to this point, see --vis_lod_full_detail_distance_m. Defaults to the
+  // visualization origin.
+  void setLevelOfDetailViewpoint(const Eigen::Vector3d& p_G_viewpoint);
+
   void plotSlidingWindowLocalizationResult(
       const aslam::Transformation& T_G_B, size_t marker_id) const;
 
@@ -65,8 +76,11 @@ class ViwlsGraphRvizPlotter {
       const vi_map::VIMap& map, const pose_graph::EdgeIdList& edges,
       const visualization::Color& color, unsigned int marker_id,
       const std::string& topic_extension) const;
+  // Publishes the vertices of every mission in chunks of consecutive vertices
+  // with one marker per chunk.
   void publishVertices(
       const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const;
+  // Publishes one marker per vertex.
   void publishVertices(
       const vi_map::VIMap& map, const pose_graph::VertexIdList& vertices) const;
   void publishBaseFrames(
@@ -127,8 +141,44 @@ class ViwlsGraphRvizPlotter {
   static const std::string kSensorExtrinsicsTopic;
 
  private:
+  enum class PublishMode { kAll, kOnlyChanged };
+
+  void visualizeMissions(
+      const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+      bool publish_baseframes, bool publish_vertices, bool publish_edges,
+      bool publish_landmarks, const PublishMode mode) const;
+  void publishVertexChunks(
+      const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+      const PublishMode mode) const;
+  void publishEdges(
+      const vi_map::VIMap& map, const vi_map::MissionIdList& missions,
+      const PublishMode mode) const;
+  void publishEdges(
+      const vi_map::VIMap& map, const vi_map::MissionIdList& missions,
+      pose_graph::Edge::EdgeType edge_type, const visualization::Color& color,
+      const PublishMode mode) const;
+  void publishEdges(
+      const vi_map::VIMap& map, const pose_graph::EdgeIdList& edges,
+      const visualization::Color& color, unsigned int marker_id,
+      const std::string& topic_extension, const PublishMode mode) const;
+  void publishLandmarkSpheres(
+      const visualization::SphereVector& spheres, const PublishMode mode) const;
+
+  // Remembers the marker coefficients and returns whether the marker needs
+  // to be published in the given mode.
+  bool needsPublishing(
+      const std::string& topic, const size_t marker_id,
+      const Eigen::MatrixXd& coefficients, const PublishMode mode) const;
+  // The hash decides which of the far away objects are kept, so the same
+  // objects are plotted every time.
+  bool isPlottedAtLevelOfDetail(
+      const Eigen::Vector3d& p_plot, const size_t hash) const;
+
   visualization::LineSegmentVector reference_edges_line_segments_;
   Eigen::Vector3d origin_;
+  // In the plotted frame, i.e. relative to origin_.
+  Eigen::Vector3d lod_viewpoint_;
+  mutable MarkerChangeTracker published_markers_;
 };
 
 }  // namespace visualization
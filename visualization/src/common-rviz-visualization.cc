@@ -363,6 +363,73 @@ void publishVerticesFromPoseVector(
       topic, pose_array);
 }
 
+void publishPoseChunks(
+    const std::vector<PoseVector>& pose_chunks,
+    const std::vector<size_t>& marker_ids, const std::string& frame,
+    const std::string& name_space, const std::string& topic) {
+  CHECK(!topic.empty());
+  CHECK_EQ(pose_chunks.size(), marker_ids.size());
+  if (pose_chunks.empty()) {
+    return;
+  }
+  CHECK(ros::isInitialized())
+      << "ROS hasn't been initialized. Call "
+      << "RVizVisualizationSink::init() in your application code if you intend"
+      << " to use RViz visualizations.";
+
+  const ros::Time now = ros::Time::now();
+  visualization_msgs::MarkerArray marker_array;
+  marker_array.markers.resize(pose_chunks.size());
+  for (size_t chunk_idx = 0u; chunk_idx < pose_chunks.size(); ++chunk_idx) {
+    const PoseVector& poses = pose_chunks[chunk_idx];
+    visualization_msgs::Marker& marker = marker_array.markers[chunk_idx];
+    marker.header.frame_id = frame;
+    marker.header.stamp = now;
+    marker.id = marker_ids[chunk_idx];
+    marker.ns = name_space;
+    if (poses.empty()) {
+      marker.action = visualization_msgs::Marker::DELETE;
+      continue;
+    }
+
+    const Pose& first_pose = poses.front();
+    const bool use_axis_colors = first_pose.color.red == 0u &&
+                                 first_pose.color.green == 0u &&
+                                 first_pose.color.blue == 0u;
+    std_msgs::ColorRGBA axis_colors[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      axis_colors[axis] =
+          use_axis_colors
+              ? createColorRGBA(
+                    axis == 0, axis == 1, axis == 2, first_pose.alpha)
+              : createColorRGBA(
+                    first_pose.color.red / 255.0,
+                    first_pose.color.green / 255.0,
+                    first_pose.color.blue / 255.0, first_pose.alpha);
+    }
+
+    marker.type = visualization_msgs::Marker::LINE_LIST;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.pose.orientation.w = 1.0;
+    marker.scale.x = first_pose.line_width;
+    marker.color = axis_colors[0];
+    marker.points.reserve(6u * poses.size());
+    marker.colors.reserve(6u * poses.size());
+    for (const Pose& pose : poses) {
+      const Eigen::Matrix3d G_R_B = pose.G_q_B.toRotationMatrix();
+      for (int axis = 0; axis < 3; ++axis) {
+        marker.points.push_back(eigenToPoint(pose.G_p_B));
+        marker.points.push_back(
+            eigenToPoint(pose.G_p_B + first_pose.scale * G_R_B.col(axis)));
+        marker.colors.push_back(axis_colors[axis]);
+        marker.colors.push_back(axis_colors[axis]);
+      }
+    }
+  }
+  RVizVisualizationSink::publish<visualization_msgs::MarkerArray>(
+      topic, marker_array);
+}
+
 void publish3DPointsAsPointCloud(
     const Eigen::Matrix3Xd& points_G, const visualization::Color& color,
     double alpha, const std::string& frame, const std::string& topic) {
@@ -0,0 +1,71 @@
+#include "visualization/marker-change-tracker.h"
+
+#include <glog/logging.h>
+
+namespace visualization {
+
+MarkerChangeTracker::MarkerChangeTracker(const MarkerChangeTracker& other) {
+  std::lock_guard<std::mutex> lock(other.mutex_);
+  published_coefficients_ = other.published_coefficients_;
+}
+
+MarkerChangeTracker& MarkerChangeTracker::operator=(
+    const MarkerChangeTracker& other) {
+  if (this != &other) {
+    std::lock(mutex_, other.mutex_);
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock);
+    std::lock_guard<std::mutex> other_lock(other.mutex_, std::adopt_lock);
+    published_coefficients_ = other.published_coefficients_;
+  }
+  return *this;
+}
+
+bool MarkerChangeTracker::update(
+    const std::string& topic, const size_t marker_id,
+    const Eigen::MatrixXd& coefficients, const double tolerance) {
+  CHECK_GE(tolerance, 0.0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const MarkerKey key(topic, marker_id);
+  const MarkerCoefficientsMap::const_iterator it =
+      published_coefficients_.find(key);
+  if (it != published_coefficients_.end() &&
+      it->second.rows() == coefficients.rows() &&
+      it->second.cols() == coefficients.cols() &&
+      (coefficients.size() == 0 ||
+       (it->second - coefficients).cwiseAbs().maxCoeff() <= tolerance)) {
+    return false;
+  }
+  published_coefficients_[key] = coefficients;
+  return true;
+}
+
+void MarkerChangeTracker::set(
+    const std::string& topic, const size_t marker_id,
+    const Eigen::MatrixXd& coefficients) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  published_coefficients_[MarkerKey(topic, marker_id)] = coefficients;
+}
+
+bool MarkerChangeTracker::isTracked(
+    const std::string& topic, const size_t marker_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return published_coefficients_.count(MarkerKey(topic, marker_id)) > 0u;
+}
+
+void MarkerChangeTracker::remove(
+    const std::string& topic, const size_t marker_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  published_coefficients_.erase(MarkerKey(topic, marker_id));
+}
+
+void MarkerChangeTracker::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  published_coefficients_.clear();
+}
+
+size_t MarkerChangeTracker::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return published_coefficients_.size();
+}
+
+}  // namespace visualization
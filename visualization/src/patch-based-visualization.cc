@@ -1,7 +1,15 @@
 #include "visualization/patch-based-visualization.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <map-resources/resource-common.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
@@ -195,44 +203,44 @@ bool getCopyOfImageAsBloatedColorImage(
   }
 }
 
-void getImagePatchesForLandmark(
-    const vi_map::LandmarkId& landmark_id,
-    int half_patch_size_pixels, bool draw_bounding_boxes,
-    bool draw_center_circle, const vi_map::VIMap& map,
-    std::vector<cv::Mat>* patches) {
+namespace {
+// The patch of one observation of a landmark, cut from the image of the frame
+// the request is grouped under.
+struct PatchRequest {
+  size_t landmark_idx;
+  size_t observation_idx;
+  size_t keypoint_index;
+};
+
+struct FramePatchRequests {
+  vi_map::VisualFrameIdentifier frame_id;
+  std::vector<PatchRequest> requests;
+};
+
+void extractPatchesOfFrame(
+    const FramePatchRequests& frame_requests, int half_patch_size_pixels,
+    bool draw_bounding_boxes, bool draw_center_circle,
+    const vi_map::VIMap& map, std::vector<std::vector<cv::Mat>>* patches) {
   CHECK_NOTNULL(patches);
-  CHECK(map.hasLandmark(landmark_id));
-  CHECK_GT(half_patch_size_pixels, 0);
-
-  const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-  const vi_map::KeypointIdentifierList& keypoint_identifiers =
-      landmark.getObservations();
-  const size_t num_observations = keypoint_identifiers.size();
+  const vi_map::Vertex& observer_vertex =
+      map.getVertex(frame_requests.frame_id.vertex_id);
+  const size_t frame_index = frame_requests.frame_id.frame_index;
+  CHECK_LT(frame_index, observer_vertex.numFrames());
+  const aslam::VisualFrame& visual_frame =
+      observer_vertex.getVisualFrame(frame_index);
+  CHECK(visual_frame.hasKeypointMeasurements());
+
+  cv::Mat bloated_map_image;
+  // Bloating the image by half the path size on each side.
+  CHECK(
+      getCopyOfImageAsBloatedColorImage(
+          observer_vertex, frame_index, half_patch_size_pixels, map,
+          &bloated_map_image));
 
-  if (num_observations == 0u) {
-    LOG(WARNING) << "Zero observations for landmark with id "
-                 << landmark_id.hexString();
-    return;
-  }
-  patches->resize(num_observations);
-
-  for (size_t observation_idx = 0u; observation_idx < num_observations;
-       ++observation_idx) {
-    const vi_map::KeypointIdentifier& keypoint_identifier =
-        keypoint_identifiers[observation_idx];
-    const size_t frame_index = keypoint_identifier.frame_id.frame_index;
-
-    const vi_map::Vertex& observer_vertex =
-        map.getVertex(keypoint_identifier.frame_id.vertex_id);
-
-    CHECK_LT(frame_index, observer_vertex.numFrames());
-    const aslam::VisualFrame& visual_frame =
-        observer_vertex.getVisualFrame(frame_index);
-    CHECK(visual_frame.hasKeypointMeasurements());
-    const size_t keypoint_index = keypoint_identifier.keypoint_index;
-    CHECK_LT(keypoint_index, visual_frame.getNumKeypointMeasurements());
+  for (const PatchRequest& request : frame_requests.requests) {
+    CHECK_LT(request.keypoint_index, visual_frame.getNumKeypointMeasurements());
     const Eigen::Vector2d& keypoint =
-        visual_frame.getKeypointMeasurement(keypoint_index);
+        visual_frame.getKeypointMeasurement(request.keypoint_index);
     const int keypoint_x = static_cast<int>(std::round(keypoint(0)));
     const int keypoint_y = static_cast<int>(std::round(keypoint(1)));
     const int keypoint_bloated_x =
@@ -240,38 +248,26 @@ void getImagePatchesForLandmark(
     const int keypoint_bloated_y =
         getBloatedCoordinate<int>(keypoint_y, half_patch_size_pixels);
 
-    cv::Mat bloated_map_image;
-    // Bloating the image by half the path size on each side.
-    CHECK(
-        getCopyOfImageAsBloatedColorImage(
-            observer_vertex, frame_index, half_patch_size_pixels, map,
-            &bloated_map_image));
-
+    cv::Mat& patch =
+        (*patches)[request.landmark_idx][request.observation_idx];
     CHECK(
         getImagePatch(
             bloated_map_image, keypoint_bloated_x, keypoint_bloated_y,
-            half_patch_size_pixels, &(patches->at(observation_idx))));
+            half_patch_size_pixels, &patch));
 
     if (draw_bounding_boxes) {
-      drawBoundingBoxOntoPatch(&(patches->at(observation_idx)));
+      drawBoundingBoxOntoPatch(&patch);
     }
     if (draw_center_circle) {
-      drawCenterCircleOntoPatch(&(patches->at(observation_idx)));
+      drawCenterCircleOntoPatch(&patch);
     }
   }
 }
 
-void getImagePatchesForLandmark(
-    const vi_map::LandmarkId& landmark_id,
-    int half_patch_size_pixels, bool draw_bounding_boxes,
-    bool draw_center_circle, const vi_map::VIMap& map, cv::Mat* patch_row) {
+void assemblePatchRow(
+    const std::vector<cv::Mat>& patches, int half_patch_size_pixels,
+    cv::Mat* patch_row) {
   CHECK_NOTNULL(patch_row);
-
-  std::vector<cv::Mat> patches;
-  getImagePatchesForLandmark(
-      landmark_id, half_patch_size_pixels, draw_bounding_boxes,
-      draw_center_circle, map, &patches);
-
   const int num_patches = static_cast<int>(patches.size());
 
   const int patch_size_pixels = ((2 * half_patch_size_pixels) + 1);
@@ -288,6 +284,123 @@ void getImagePatchesForLandmark(
                 patch_size_pixels)));
   }
 }
+}  // namespace
+
+void getImagePatchesForLandmarks(
+    const vi_map::LandmarkIdList& landmark_ids, int half_patch_size_pixels,
+    bool draw_bounding_boxes, bool draw_center_circle,
+    const vi_map::VIMap& map, std::vector<std::vector<cv::Mat>>* patches) {
+  CHECK_NOTNULL(patches)->clear();
+  CHECK_GT(half_patch_size_pixels, 0);
+  const size_t num_landmarks = landmark_ids.size();
+  patches->resize(num_landmarks);
+
+  // Group the observations by frame, in the order the frames are first
+  // observed.
+  std::vector<FramePatchRequests> frame_requests;
+  std::unordered_map<vi_map::VisualFrameIdentifier, size_t> frame_indices;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_idx];
+    CHECK(map.hasLandmark(landmark_id));
+    const vi_map::KeypointIdentifierList& keypoint_identifiers =
+        map.getLandmark(landmark_id).getObservations();
+    const size_t num_observations = keypoint_identifiers.size();
+    if (num_observations == 0u) {
+      LOG(WARNING) << "Zero observations for landmark with id "
+                   << landmark_id.hexString();
+      continue;
+    }
+    (*patches)[landmark_idx].resize(num_observations);
+
+    for (size_t observation_idx = 0u; observation_idx < num_observations;
+         ++observation_idx) {
+      const vi_map::KeypointIdentifier& keypoint_identifier =
+          keypoint_identifiers[observation_idx];
+      const std::pair<
+          std::unordered_map<vi_map::VisualFrameIdentifier, size_t>::iterator,
+          bool>
+          insertion = frame_indices.emplace(
+              keypoint_identifier.frame_id, frame_requests.size());
+      if (insertion.second) {
+        frame_requests.emplace_back();
+        frame_requests.back().frame_id = keypoint_identifier.frame_id;
+      }
+      frame_requests[insertion.first->second].requests.push_back(
+          PatchRequest{landmark_idx, observation_idx,
+                       keypoint_identifier.keypoint_index});
+    }
+  }
+  const size_t num_frames = frame_requests.size();
+  if (num_frames == 0u) {
+    return;
+  }
+
+  // Load the images into the resource cache in the order they are processed.
+  // The raw color images are only used if there are no grayscale ones.
+  pose_graph::VertexIdList vertex_ids;
+  pose_graph::VertexIdSet added_vertex_ids;
+  for (const FramePatchRequests& frame : frame_requests) {
+    if (added_vertex_ids.emplace(frame.frame_id.vertex_id).second) {
+      vertex_ids.emplace_back(frame.frame_id.vertex_id);
+    }
+  }
+  const vi_map::VisualFrameIdentifier& first_frame_id =
+      frame_requests.front().frame_id;
+  const backend::ResourceType image_type =
+      map.hasFrameResource<cv::Mat>(
+          map.getVertex(first_frame_id.vertex_id),
+          first_frame_id.frame_index, backend::ResourceType::kRawImage)
+          ? backend::ResourceType::kRawImage
+          : backend::ResourceType::kRawColorImage;
+  map.prefetchFrameResources<cv::Mat>(vertex_ids, image_type);
+
+  // Every worker takes the next frame, such that the frames are processed
+  // roughly in the prefetching order. Each frame writes distinct patches.
+  const size_t num_workers = std::min<size_t>(
+      num_frames, common::getNumHardwareThreads());
+  std::atomic<size_t> next_frame_idx(0u);
+  common::ParallelProcess(
+      num_workers,
+      [&](const std::vector<size_t>& /*worker_indices*/) {
+        size_t frame_idx;
+        while ((frame_idx = next_frame_idx++) < num_frames) {
+          extractPatchesOfFrame(
+              frame_requests[frame_idx], half_patch_size_pixels,
+              draw_bounding_boxes, draw_center_circle, map, patches);
+        }
+      },
+      /*always_parallelize=*/true, num_workers);
+}
+
+void getImagePatchesForLandmark(
+    const vi_map::LandmarkId& landmark_id,
+    int half_patch_size_pixels, bool draw_bounding_boxes,
+    bool draw_center_circle, const vi_map::VIMap& map,
+    std::vector<cv::Mat>* patches) {
+  CHECK_NOTNULL(patches);
+  std::vector<std::vector<cv::Mat>> landmark_patches;
+  getImagePatchesForLandmarks(
+      vi_map::LandmarkIdList{landmark_id}, half_patch_size_pixels,
+      draw_bounding_boxes, draw_center_circle, map, &landmark_patches);
+  CHECK_EQ(landmark_patches.size(), 1u);
+  if (!landmark_patches.front().empty()) {
+    patches->swap(landmark_patches.front());
+  }
+}
+
+void getImagePatchesForLandmark(
+    const vi_map::LandmarkId& landmark_id,
+    int half_patch_size_pixels, bool draw_bounding_boxes,
+    bool draw_center_circle, const vi_map::VIMap& map, cv::Mat* patch_row) {
+  CHECK_NOTNULL(patch_row);
+
+  std::vector<cv::Mat> patches;
+  getImagePatchesForLandmark(
+      landmark_id, half_patch_size_pixels, draw_bounding_boxes,
+      draw_center_circle, map, &patches);
+  assemblePatchRow(patches, half_patch_size_pixels, patch_row);
+}
 
 void getBloatedImageCoordinatesOfPatchUpperLeftCorner(
     const Eigen::Vector2d& keypoint, int half_patch_size_pixels,
@@ -368,6 +481,14 @@ void visualizePatchesOfLandmarkKeypointMatches(
   std::vector<cv::Mat> image_rows(num_matches);
   size_t max_num_observations = 0;
 
+  const bool kDrawBoundingBoxForLandmarkPatches = false;
+  const bool kDrawCenterCircle = true;
+  std::vector<std::vector<cv::Mat>> landmark_patches;
+  getImagePatchesForLandmarks(
+      landmark_ids, half_patch_size_pixels,
+      kDrawBoundingBoxForLandmarkPatches, kDrawCenterCircle, map,
+      &landmark_patches);
+
   // Iterating over all matches.
   for (size_t match_idx = 0u; match_idx < num_matches; ++match_idx) {
     const size_t keypoint_index = keypoint_indices[match_idx];
@@ -415,12 +536,9 @@ void visualizePatchesOfLandmarkKeypointMatches(
     query_patch.copyTo(
         image_row(cv::Rect(0, 0, patch_size_pixels, patch_size_pixels)));
 
-    const bool kDrawBoundingBoxForLandmarkPatches = false;
-    const bool kDrawCenterCircle = true;
     cv::Mat landmark_patches_row;
-    getImagePatchesForLandmark(
-        store_landmark_id, half_patch_size_pixels,
-        kDrawBoundingBoxForLandmarkPatches, kDrawCenterCircle, map,
+    assemblePatchRow(
+        landmark_patches[match_idx], half_patch_size_pixels,
         &landmark_patches_row);
 
     int landmark_patches_width = landmark_patches_row.cols;
@@ -519,6 +637,13 @@ void visualizePatchesOfProjectedMatchedLandmarksInVisualFrameImage(
 
   const Eigen::Matrix2Xd& keypoints = frame.getKeypointMeasurements();
 
+  const bool kDrawBoundingBoxes = true;
+  const bool kDrawCenterCircle = true;
+  std::vector<std::vector<cv::Mat>> patches_of_landmarks;
+  getImagePatchesForLandmarks(
+      landmark_ids, half_patch_size_pixels, kDrawBoundingBoxes,
+      kDrawCenterCircle, map, &patches_of_landmarks);
+
   for (size_t match_idx = 0u; match_idx < num_matches; ++match_idx) {
     const size_t keypoint_index = keypoint_indices[match_idx];
     CHECK_LT(static_cast<int>(keypoint_index), keypoints.cols());
@@ -551,12 +676,8 @@ void visualizePatchesOfProjectedMatchedLandmarksInVisualFrameImage(
         landmark_projection_x_upper_left, landmark_projection_y_upper_left, 0,
         0, image_width, image_height);
 
-    std::vector<cv::Mat> landmark_patches;
-    const bool kDrawBoundingBoxes = true;
-    const bool kDrawCenterCircle = true;
-    getImagePatchesForLandmark(
-        landmark_id, half_patch_size_pixels, kDrawBoundingBoxes,
-        kDrawCenterCircle, map, &landmark_patches);
+    const std::vector<cv::Mat>& landmark_patches =
+        patches_of_landmarks[match_idx];
     CHECK_GT(landmark_patches.size(), 0u);
 
     // TODO(mbuerki): Don't just copy the first patch, but copy the one
@@ -725,18 +846,21 @@ void visualizePatchesOfLandmarksInVisualFrameImage(
   size_t num_valid = 0u;
   size_t num_invalid = 0u;
 
+  const bool kDrawBoundingBoxes = true;
+  const bool kDrawCenterCircle = true;
+  std::vector<std::vector<cv::Mat>> patches_of_landmarks;
+  getImagePatchesForLandmarks(
+      landmark_ids, half_patch_size_pixels, kDrawBoundingBoxes,
+      kDrawCenterCircle, map, &patches_of_landmarks);
+
   // Iterate over all landmarks, find their global landmark id, get the patch
   // and put it in the image.
   for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
     vi_map::LandmarkId landmark_id = landmark_ids[landmark_idx];
     CHECK(landmark_id.isValid());
 
-    const bool kDrawBoundingBoxes = true;
-    const bool kDrawCenterCircle = true;
-    std::vector<cv::Mat> landmark_patches;
-    getImagePatchesForLandmark(
-        landmark_id, half_patch_size_pixels, kDrawBoundingBoxes,
-        kDrawCenterCircle, map, &landmark_patches);
+    const std::vector<cv::Mat>& landmark_patches =
+        patches_of_landmarks[landmark_idx];
     CHECK_GT(landmark_patches.size(), 0u);
 
     const Eigen::Vector3d& p_C_landmark = p_C_landmarks.col(landmark_idx);
@@ -1,11 +1,23 @@
 #include "visualization/rviz-visualization-sink.h"
 
+#include <string>
+#include <utility>
+
 #include <glog/logging.h>
 
 DEFINE_bool(
     rviz_wait_for_subscribers, false,
     "If true, every plotting message "
     "will wait a maximum of 5s for a subsrciber if none is visible yet.");
+DEFINE_bool(
+    rviz_publish_asynchronously, false,
+    "If true, the messages are sent by a separate thread and publishing only "
+    "copies the message, so the visualization doesn't slow down the calling "
+    "threads.");
+DEFINE_int32(
+    rviz_max_queued_messages_per_topic, 50,
+    "Maximum number of unsent messages per topic in the asynchronous mode. "
+    "If a topic has more, its oldest unsent message is dropped.");
 
 namespace visualization {
 
@@ -13,8 +25,29 @@ RVizVisualizationSink::RVizVisualizationSink()
     : is_initialized_(false),
       queue_size_(200u),
       latch_(true),
-      should_wait_for_subscribers_(FLAGS_rviz_wait_for_subscribers) {
+      should_wait_for_subscribers_(FLAGS_rviz_wait_for_subscribers),
+      publish_asynchronously_(FLAGS_rviz_publish_asynchronously),
+      max_queued_messages_per_topic_(
+          static_cast<size_t>(FLAGS_rviz_max_queued_messages_per_topic)),
+      is_sending_(false),
+      shutdown_requested_(false),
+      num_dropped_messages_(0u) {
+  CHECK_GT(FLAGS_rviz_max_queued_messages_per_topic, 0);
   initImpl();
+  if (publish_asynchronously_) {
+    sender_thread_ = std::thread(&RVizVisualizationSink::senderLoop, this);
+  }
+}
+
+RVizVisualizationSink::~RVizVisualizationSink() {
+  if (sender_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      shutdown_requested_ = true;
+    }
+    queue_condition_.notify_all();
+    sender_thread_.join();
+  }
 }
 
 void RVizVisualizationSink::initImpl() {
@@ -39,6 +72,78 @@ void RVizVisualizationSink::initImpl() {
   is_initialized_ = true;
 }
 
+void RVizVisualizationSink::enqueue(
+    const std::string& topic, std::function<void()>&& send) {
+  CHECK(send);
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    std::deque<std::function<void()>>& topic_queue = queued_messages_[topic];
+    if (topic_queue.empty()) {
+      topics_with_queued_messages_.push_back(topic);
+    } else if (topic_queue.size() >= max_queued_messages_per_topic_) {
+      topic_queue.pop_front();
+      ++num_dropped_messages_;
+      LOG_EVERY_N(WARNING, 100)
+          << "The visualization can't keep up, dropped "
+          << num_dropped_messages_ << " messages so far, latest on topic "
+          << topic << '.';
+    }
+    topic_queue.emplace_back(std::move(send));
+  }
+  queue_condition_.notify_one();
+}
+
+void RVizVisualizationSink::senderLoop() {
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  while (true) {
+    queue_condition_.wait(lock, [this]() {
+      return shutdown_requested_ || !topics_with_queued_messages_.empty();
+    });
+    if (shutdown_requested_) {
+      // The unsent messages are dropped, ROS might already be shut down.
+      break;
+    }
+
+    // Round robin over the topics, so a topic with many messages doesn't
+    // delay the others.
+    const std::string topic = std::move(topics_with_queued_messages_.front());
+    topics_with_queued_messages_.pop_front();
+    TopicToMessageQueueMap::iterator queue_iterator =
+        queued_messages_.find(topic);
+    CHECK(queue_iterator != queued_messages_.end());
+    CHECK(!queue_iterator->second.empty());
+    std::function<void()> send = std::move(queue_iterator->second.front());
+    queue_iterator->second.pop_front();
+    if (queue_iterator->second.empty()) {
+      queued_messages_.erase(queue_iterator);
+    } else {
+      topics_with_queued_messages_.push_back(topic);
+    }
+
+    is_sending_ = true;
+    lock.unlock();
+    send();
+    lock.lock();
+    is_sending_ = false;
+    if (topics_with_queued_messages_.empty()) {
+      queue_empty_condition_.notify_all();
+    }
+  }
+  is_sending_ = false;
+  queue_empty_condition_.notify_all();
+}
+
+void RVizVisualizationSink::flushImpl() {
+  if (!publish_asynchronously_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  queue_empty_condition_.wait(lock, [this]() {
+    return shutdown_requested_ ||
+           (topics_with_queued_messages_.empty() && !is_sending_);
+  });
+}
+
 template <>
 void RVizVisualizationSink::publishImpl(
     const std::string& topic, const cv::Mat& image) {
@@ -64,6 +169,17 @@ void RVizVisualizationSink::publishImpl(
     return;
   }
 
+  if (publish_asynchronously_) {
+    // The message already holds a copy of the image.
+    enqueue(topic, [this, topic, msg]() { publishImageSync(topic, msg); });
+  } else {
+    publishImageSync(topic, msg);
+  }
+}
+
+void RVizVisualizationSink::publishImageSync(
+    const std::string& topic, const sensor_msgs::Image& msg) {
+  CHECK(!topic.empty());
   {
     std::lock_guard<std::mutex> lock(mutex_);
     // Check whether this topic was already registered, otherwise do so.
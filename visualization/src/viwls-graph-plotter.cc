@@ -74,6 +74,20 @@ DEFINE_int32(
     "Minimum number of observer missions for a landmark to be "
     "visualized.");
 
+DEFINE_int32(
+    vis_vertices_per_marker, 200,
+    "Number of consecutive vertices of a mission that are plotted as a single "
+    "marker.");
+DEFINE_double(
+    vis_lod_full_detail_distance_m, 0.0,
+    "All vertices and landmarks within this distance of the level of detail "
+    "viewpoint are plotted. Farther away, only about every n-th is plotted, "
+    "with n the distance divided by this distance. 0 plots everything.");
+DEFINE_double(
+    vis_update_tolerance_m, 1e-3,
+    "Incremental map plots, e.g. during optimization, only republish markers "
+    "with a coordinate that changed by more than this.");
+
 namespace visualization {
 const std::string ViwlsGraphRvizPlotter::kCamPredictionTopic =
     "cam_predictions";
@@ -104,11 +118,44 @@ const std::string ViwlsGraphRvizPlotter::kSensorExtrinsicsTopic =
     "sensor_extrinsics";
 
 ViwlsGraphRvizPlotter::ViwlsGraphRvizPlotter()
-    : origin_(
-          FLAGS_vis_offset_x_m, FLAGS_vis_offset_y_m, FLAGS_vis_offset_z_m) {}
+    : origin_(FLAGS_vis_offset_x_m, FLAGS_vis_offset_y_m, FLAGS_vis_offset_z_m),
+      lod_viewpoint_(Eigen::Vector3d::Zero()) {}
+
+void ViwlsGraphRvizPlotter::setLevelOfDetailViewpoint(
+    const Eigen::Vector3d& p_G_viewpoint) {
+  lod_viewpoint_ = p_G_viewpoint - origin_;
+}
+
+bool ViwlsGraphRvizPlotter::isPlottedAtLevelOfDetail(
+    const Eigen::Vector3d& p_plot, const size_t hash) const {
+  if (FLAGS_vis_lod_full_detail_distance_m <= 0.0) {
+    return true;
+  }
+  const size_t stride = static_cast<size_t>(
+      (p_plot - lod_viewpoint_).norm() / FLAGS_vis_lod_full_detail_distance_m);
+  return stride <= 1u || hash % stride == 0u;
+}
+
+bool ViwlsGraphRvizPlotter::needsPublishing(
+    const std::string& topic, const size_t marker_id,
+    const Eigen::MatrixXd& coefficients, const PublishMode mode) const {
+  if (mode == PublishMode::kAll) {
+    published_markers_.set(topic, marker_id, coefficients);
+    return true;
+  }
+  CHECK_GE(FLAGS_vis_update_tolerance_m, 0.0);
+  return published_markers_.update(
+      topic, marker_id, coefficients, FLAGS_vis_update_tolerance_m);
+}
 
 void ViwlsGraphRvizPlotter::publishEdges(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const {
+  publishEdges(map, missions, PublishMode::kAll);
+}
+
+void ViwlsGraphRvizPlotter::publishEdges(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& missions,
+    const PublishMode mode) const {
   visualization::Color color;
   color.red = 25;
   color.green = 200;
@@ -118,27 +165,35 @@ void ViwlsGraphRvizPlotter::publishEdges(
     vi_map::MissionIdList single_selected_mission = {mission_id};
     publishEdges(
         map, single_selected_mission, map.getGraphTraversalEdgeType(mission_id),
-        color);
+        color, mode);
   }
   visualization::Color color_green;
   color_green.red = 25;
   color_green.green = 255;
   color_green.blue = 50;
   publishEdges(
-      map, missions, pose_graph::Edge::EdgeType::kLoopClosure, color_green);
+      map, missions, pose_graph::Edge::EdgeType::kLoopClosure, color_green,
+      mode);
 
   visualization::Color color_blue;
   color_blue.red = 50;
   color_blue.green = 25;
   color_blue.blue = 200;
   publishEdges(
-      map, missions, pose_graph::Edge::EdgeType::kOdometry, color_blue);
+      map, missions, pose_graph::Edge::EdgeType::kOdometry, color_blue, mode);
 }
 
 void ViwlsGraphRvizPlotter::publishEdges(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions,
     pose_graph::Edge::EdgeType edge_type,
-    const visualization::Color& color_in) const {
+    const visualization::Color& color) const {
+  publishEdges(map, missions, edge_type, color, PublishMode::kAll);
+}
+
+void ViwlsGraphRvizPlotter::publishEdges(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& missions,
+    pose_graph::Edge::EdgeType edge_type, const visualization::Color& color_in,
+    const PublishMode mode) const {
   visualization::Color color = color_in;
   visualization::LineSegmentVector line_segments;
 
@@ -160,7 +215,7 @@ void ViwlsGraphRvizPlotter::publishEdges(
 
     publishEdges(
         map, edges, color, marker_id,
-        pose_graph::Edge::edgeTypeToString(edge_type));
+        pose_graph::Edge::edgeTypeToString(edge_type), mode);
   }
 }
 
@@ -168,6 +223,29 @@ void ViwlsGraphRvizPlotter::publishEdges(
     const vi_map::VIMap& map, const pose_graph::EdgeIdList& edges,
     const visualization::Color& color, unsigned int marker_id,
     const std::string& topic_extension) const {
+  publishEdges(
+      map, edges, color, marker_id, topic_extension, PublishMode::kAll);
+}
+
+namespace {
+// Endpoints and color of every segment, used to detect changed markers.
+Eigen::MatrixXd getLineSegmentCoefficients(
+    const visualization::LineSegmentVector& line_segments) {
+  Eigen::MatrixXd coefficients(9, line_segments.size());
+  for (size_t idx = 0u; idx < line_segments.size(); ++idx) {
+    const visualization::LineSegment& line_segment = line_segments[idx];
+    coefficients.col(idx) << line_segment.from, line_segment.to,
+        line_segment.color.red, line_segment.color.green,
+        line_segment.color.blue;
+  }
+  return coefficients;
+}
+}  // namespace
+
+void ViwlsGraphRvizPlotter::publishEdges(
+    const vi_map::VIMap& map, const pose_graph::EdgeIdList& edges,
+    const visualization::Color& color, unsigned int marker_id,
+    const std::string& topic_extension, const PublishMode mode) const {
   visualization::LineSegmentVector line_segments;
   visualization::LineSegmentVector lc_transformation_line_segments;
 
@@ -255,29 +333,99 @@ void ViwlsGraphRvizPlotter::publishEdges(
     line_segments.push_back(line_segment);
   }
 
-  if (!line_segments.empty()) {
+  const std::string edge_topic = kEdgeTopic + '/' + topic_extension;
+  if (!line_segments.empty() &&
+      needsPublishing(
+          edge_topic, marker_id, getLineSegmentCoefficients(line_segments),
+          mode)) {
     visualization::publishLines(
         line_segments, marker_id, visualization::kDefaultMapFrame,
-        visualization::kDefaultNamespace, kEdgeTopic + '/' + topic_extension);
+        visualization::kDefaultNamespace, edge_topic);
   }
-  if (!lc_transformation_line_segments.empty()) {
+  const std::string lc_transformation_topic =
+      kEdgeTopic + "/loop_closure_transformations";
+  if (!lc_transformation_line_segments.empty() &&
+      needsPublishing(
+          lc_transformation_topic, marker_id,
+          getLineSegmentCoefficients(lc_transformation_line_segments), mode)) {
     visualization::publishLines(
         lc_transformation_line_segments, marker_id,
         visualization::kDefaultMapFrame, visualization::kDefaultNamespace,
-        kEdgeTopic + "/loop_closure_transformations");
+        lc_transformation_topic);
   }
 }
 
 void ViwlsGraphRvizPlotter::publishVertices(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const {
-  pose_graph::VertexIdList all_vertices;
   for (const vi_map::MissionId& mission_id : missions) {
-    pose_graph::VertexIdList mission_vertices;
-    map.getAllVertexIdsInMission(mission_id, &mission_vertices);
-    all_vertices.insert(
-        all_vertices.end(), mission_vertices.begin(), mission_vertices.end());
+    publishVertexChunks(map, mission_id, PublishMode::kAll);
   }
-  publishVertices(map, all_vertices);
+}
+
+void ViwlsGraphRvizPlotter::publishVertexChunks(
+    const vi_map::VIMap& map, const vi_map::MissionId& mission_id,
+    const PublishMode mode) const {
+  CHECK_GT(FLAGS_vis_vertices_per_marker, 0);
+  const size_t vertices_per_chunk =
+      static_cast<size_t>(FLAGS_vis_vertices_per_marker);
+  // Chunks along the graph are spatially compact and keep their vertices
+  // while the map is optimized.
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIdsInMissionAlongGraph(mission_id, &vertex_ids);
+  const vi_map::MissionBaseFrame& baseframe =
+      map.getMissionBaseFrame(map.getMission(mission_id).getBaseFrameId());
+
+  const size_t first_marker_id = mission_id.hashToSizeT();
+  const size_t num_chunks =
+      (vertex_ids.size() + vertices_per_chunk - 1u) / vertices_per_chunk;
+  std::vector<visualization::PoseVector> chunks_to_publish;
+  std::vector<size_t> marker_ids_to_publish;
+  for (size_t chunk_idx = 0u; chunk_idx < num_chunks; ++chunk_idx) {
+    const size_t begin = chunk_idx * vertices_per_chunk;
+    const size_t end = std::min(begin + vertices_per_chunk, vertex_ids.size());
+
+    visualization::PoseVector poses;
+    poses.reserve(end - begin);
+    Eigen::MatrixXd coefficients(7, end - begin);
+    for (size_t idx = begin; idx < end; ++idx) {
+      const vi_map::Vertex& vertex = map.getVertex(vertex_ids[idx]);
+      visualization::Pose pose;
+      pose.G_p_B = baseframe.transformPointInMissionFrameToGlobalFrame(
+                       vertex.get_p_M_I()) -
+                   origin_;
+      if (!isPlottedAtLevelOfDetail(
+              pose.G_p_B, vertex_ids[idx].hashToSizeT())) {
+        continue;
+      }
+      pose.G_q_B =
+          baseframe.transformRotationInMissionFrameToGlobalFrame(
+              vertex.get_q_M_I());
+      pose.scale = 0.15;
+      pose.line_width = 0.01;
+      pose.alpha = 0.6;
+      coefficients.col(poses.size()) << pose.G_p_B, pose.G_q_B.coeffs();
+      poses.push_back(pose);
+    }
+    coefficients.conservativeResize(Eigen::NoChange, poses.size());
+
+    const size_t marker_id = first_marker_id + chunk_idx;
+    if (needsPublishing(kVertexTopic, marker_id, coefficients, mode)) {
+      chunks_to_publish.push_back(poses);
+      marker_ids_to_publish.push_back(marker_id);
+    }
+  }
+  // Deletes the chunks that remain from a previous plot of a longer mission.
+  for (size_t marker_id = first_marker_id + num_chunks;
+       published_markers_.isTracked(kVertexTopic, marker_id); ++marker_id) {
+    published_markers_.remove(kVertexTopic, marker_id);
+    chunks_to_publish.emplace_back();
+    marker_ids_to_publish.push_back(marker_id);
+  }
+
+  const std::string kNamespace = "vertex_chunks";
+  visualization::publishPoseChunks(
+      chunks_to_publish, marker_ids_to_publish,
+      visualization::kDefaultMapFrame, kNamespace, kVertexTopic);
 }
 
 void ViwlsGraphRvizPlotter::publishVertices(
@@ -353,9 +501,23 @@ void ViwlsGraphRvizPlotter::publishLandmarks(
     const vi_map::VIMap& map, const vi_map::MissionIdList& missions) const {
   visualization::SphereVector spheres;
   appendLandmarksToSphereVector(map, missions, &spheres);
+  publishLandmarkSpheres(spheres, PublishMode::kAll);
+}
 
-  visualization::publishSpheresAsPointCloud(
-      spheres, visualization::kDefaultMapFrame, kLandmarkTopic);
+void ViwlsGraphRvizPlotter::publishLandmarkSpheres(
+    const visualization::SphereVector& spheres, const PublishMode mode) const {
+  Eigen::MatrixXd coefficients(6, spheres.size());
+  for (size_t idx = 0u; idx < spheres.size(); ++idx) {
+    const visualization::Sphere& sphere = spheres[idx];
+    coefficients.col(idx) << sphere.position, sphere.color.red,
+        sphere.color.green, sphere.color.blue;
+  }
+  // The point cloud has no marker id.
+  constexpr size_t kPointCloudId = 0u;
+  if (needsPublishing(kLandmarkTopic, kPointCloudId, coefficients, mode)) {
+    visualization::publishSpheresAsPointCloud(
+        spheres, visualization::kDefaultMapFrame, kLandmarkTopic);
+  }
 }
 
 void ViwlsGraphRvizPlotter::publishLandmarks(
@@ -461,6 +623,10 @@ void ViwlsGraphRvizPlotter::appendLandmarksToSphereVector(
 
       sphere.position =
           baseframe.transformPointInMissionFrameToGlobalFrame(LM_p_fi);
+      if (!isPlottedAtLevelOfDetail(
+              sphere.position, landmark.id().hashToSizeT())) {
+        continue;
+      }
       sphere.radius = 0.03;
       sphere.alpha = 0.8;
 
@@ -800,10 +966,32 @@ void ViwlsGraphRvizPlotter::visualizeMap(
       publish_landmarks);
 }
 
+void ViwlsGraphRvizPlotter::visualizeMapUpdate(
+    const vi_map::VIMap& map) const {
+  vi_map::MissionIdList all_missions;
+  map.getAllMissionIds(&all_missions);
+  constexpr bool kPlotBaseframes = true;
+  constexpr bool kPlotVertices = true;
+  constexpr bool kPlotEdges = true;
+  constexpr bool kPlotLandmarks = true;
+  visualizeMissions(
+      map, all_missions, kPlotBaseframes, kPlotVertices, kPlotEdges,
+      kPlotLandmarks, PublishMode::kOnlyChanged);
+}
+
 void ViwlsGraphRvizPlotter::visualizeMissions(
     const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
     bool publish_baseframes, bool publish_vertices, bool publish_edges,
     bool publish_landmarks) const {
+  visualizeMissions(
+      map, mission_ids, publish_baseframes, publish_vertices, publish_edges,
+      publish_landmarks, PublishMode::kAll);
+}
+
+void ViwlsGraphRvizPlotter::visualizeMissions(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    bool publish_baseframes, bool publish_vertices, bool publish_edges,
+    bool publish_landmarks, const PublishMode mode) const {
   if (mission_ids.empty()) {
     LOG(ERROR) << "No missions in database.";
     return;
@@ -821,10 +1009,10 @@ void ViwlsGraphRvizPlotter::visualizeMissions(
             publishBaseFrames(map, {mission_id});
           }
           if (publish_vertices) {
-            publishVertices(map, {mission_id});
+            publishVertexChunks(map, mission_id, mode);
           }
           if (publish_edges) {
-            publishEdges(map, {mission_id});
+            publishEdges(map, {mission_id}, mode);
           }
           if (publish_landmarks) {
             // The landmarks have to be published together since rviz displays
@@ -845,8 +1033,9 @@ void ViwlsGraphRvizPlotter::visualizeMissions(
   for (const visualization::SphereVector& spheres : mission_spheres) {
     all_spheres.insert(all_spheres.end(), spheres.begin(), spheres.end());
   }
-  visualization::publishSpheresAsPointCloud(
-      all_spheres, visualization::kDefaultMapFrame, kLandmarkTopic);
+  if (publish_landmarks) {
+    publishLandmarkSpheres(all_spheres, mode);
+  }
 }
 
 void ViwlsGraphRvizPlotter::plotSlidingWindowLocalizationResult(
@@ -0,0 +1,68 @@
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "visualization/marker-change-tracker.h"
+
+namespace visualization {
+
+TEST(MarkerChangeTrackerTest, OnlyChangedMarkersNeedPublishing) {
+  MarkerChangeTracker tracker;
+  const std::string kTopic = "vertices";
+  constexpr size_t kMarkerId = 3u;
+  constexpr double kTolerance = 1e-3;
+  const Eigen::MatrixXd coefficients = Eigen::MatrixXd::Random(3, 10);
+
+  EXPECT_FALSE(tracker.isTracked(kTopic, kMarkerId));
+  EXPECT_TRUE(tracker.update(kTopic, kMarkerId, coefficients, kTolerance));
+  EXPECT_TRUE(tracker.isTracked(kTopic, kMarkerId));
+  EXPECT_FALSE(tracker.update(kTopic, kMarkerId, coefficients, kTolerance));
+
+  // Changes within the tolerance are ignored and don't accumulate.
+  Eigen::MatrixXd moved_coefficients = coefficients;
+  moved_coefficients(1, 4) += 0.5 * kTolerance;
+  EXPECT_FALSE(
+      tracker.update(kTopic, kMarkerId, moved_coefficients, kTolerance));
+  moved_coefficients(1, 4) += kTolerance;
+  EXPECT_TRUE(
+      tracker.update(kTopic, kMarkerId, moved_coefficients, kTolerance));
+  EXPECT_FALSE(
+      tracker.update(kTopic, kMarkerId, moved_coefficients, kTolerance));
+
+  // A different number of points is always a change.
+  const Eigen::MatrixXd fewer_coefficients = moved_coefficients.leftCols(5);
+  EXPECT_TRUE(
+      tracker.update(kTopic, kMarkerId, fewer_coefficients, kTolerance));
+
+  // Markers are distinguished by topic and id.
+  EXPECT_TRUE(tracker.update("edges", kMarkerId, coefficients, kTolerance));
+  EXPECT_TRUE(tracker.update(kTopic, kMarkerId + 1u, coefficients, kTolerance));
+  EXPECT_EQ(tracker.size(), 3u);
+
+  // Setting a marker makes it unchanged for the next update.
+  tracker.set(kTopic, kMarkerId, coefficients);
+  EXPECT_FALSE(tracker.update(kTopic, kMarkerId, coefficients, kTolerance));
+
+  tracker.remove(kTopic, kMarkerId);
+  EXPECT_FALSE(tracker.isTracked(kTopic, kMarkerId));
+  EXPECT_TRUE(tracker.update(kTopic, kMarkerId, coefficients, kTolerance));
+
+  tracker.clear();
+  EXPECT_EQ(tracker.size(), 0u);
+}
+
+TEST(MarkerChangeTrackerTest, EmptyMarkers) {
+  MarkerChangeTracker tracker;
+  constexpr double kTolerance = 1e-3;
+  const Eigen::MatrixXd empty_coefficients(3, 0);
+  EXPECT_TRUE(tracker.update("landmarks", 0u, empty_coefficients, kTolerance));
+  EXPECT_FALSE(
+      tracker.update("landmarks", 0u, empty_coefficients, kTolerance));
+
+  MarkerChangeTracker copied_tracker(tracker);
+  EXPECT_TRUE(copied_tracker.isTracked("landmarks", 0u));
+}
+
+}  // namespace visualization
+
+MAPLAB_UNITTEST_ENTRYPOINT